@@ -64,8 +64,9 @@
 #include <string.h>
 #include "tiffio.h"
 
-void TIFFBuildOverviews( TIFF *, int, int *, int, const char *,
-                         int (*)(double,void*), void * );
+void TIFFBuildOverviewsParallel( TIFF *, int, int *, int, const char *,
+                                 int, tmsize_t, int,
+                                 int (*)(double,void*), void * );
 
 /************************************************************************/
 /*                                main()                                */
@@ -77,6 +78,9 @@ int main( int argc, char ** argv )
     int		anOverviews[100];   /* TODO: un-hardwire array length, flexible allocate */
     int		nOverviewCount = 0;
     int		bUseSubIFD = 0;
+    int		nThreads = 0;
+    int		bCascade = 0;
+    tmsize_t	nMemoryBudget = 0;
     TIFF	*hTIFF;
     const char  *pszResampling = "nearest";
 
@@ -85,7 +89,8 @@ int main( int argc, char ** argv )
 /* -------------------------------------------------------------------- */
     if( argc < 2 )
     {
-        printf( "Usage: addtiffo [-r {nearest,average,mode}]\n"
+        printf( "Usage: addtiffo [-r {nearest,average,mode}] [-subifd]\n"
+                "                [-cascade] [-j threads] [-m megabytes]\n"
                 "                tiff_filename [resolution_reductions]\n"
                 "\n"
                 "Example:\n"
@@ -101,12 +106,30 @@ int main( int argc, char ** argv )
             argv++;
             argc--;
         }
+        else if( strcmp(argv[1],"-cascade") == 0 )
+        {
+            bCascade = 1;
+            argv++;
+            argc--;
+        }
         else if( strcmp(argv[1],"-r") == 0 )
         {
             argv += 2;
             argc -= 2;
             pszResampling = *argv;
         }
+        else if( strcmp(argv[1],"-j") == 0 && argc > 2 )
+        {
+            nThreads = atoi(argv[2]);
+            argv += 2;
+            argc -= 2;
+        }
+        else if( strcmp(argv[1],"-m") == 0 && argc > 2 )
+        {
+            nMemoryBudget = (tmsize_t) atoi(argv[2]) * 1024 * 1024;
+            argv += 2;
+            argc -= 2;
+        }
         else
         {
             fprintf( stderr, "Incorrect parameters\n" );
@@ -156,8 +179,10 @@ int main( int argc, char ** argv )
         return( 1 );
     }
 
-    TIFFBuildOverviews( hTIFF, nOverviewCount, anOverviews, bUseSubIFD,
-                        pszResampling, NULL, NULL );
+    TIFFBuildOverviewsParallel( hTIFF, nOverviewCount, anOverviews,
+                                bUseSubIFD, pszResampling,
+                                nThreads, nMemoryBudget, bCascade,
+                                NULL, NULL );
 
     TIFFClose( hTIFF );
 
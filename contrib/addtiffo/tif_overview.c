@@ -53,7 +53,15 @@
 #include <string.h>
 
 #include "tiffio.h"
+#include "tiffiop.h"
 #include "tif_ovrcache.h"
+#include "toolthreads.h"
+
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#elif defined(TIFF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
 
 #ifndef FALSE
 #  define FALSE 0
@@ -69,6 +77,9 @@
 
 void TIFFBuildOverviews( TIFF *, int, int *, int, const char *,
                          int (*)(double,void*), void * );
+void TIFFBuildOverviewsParallel( TIFF *, int, int *, int, const char *,
+                                 int, tmsize_t, int,
+                                 int (*)(double,void*), void * );
 
 /************************************************************************/
 /*                         TIFF_WriteOverview()                         */
@@ -262,6 +273,207 @@ TIFF_SetSample( unsigned char * pabyData, int nPixelBytes, int nSampleFormat,
     }
 }
 
+/************************************************************************/
+/*                         TIFF_Average2x2_8()                          */
+/*                                                                      */
+/*      SIMD averaging of 2x2 windows of adjacent 8 bit samples in      */
+/*      the lines at pabySrc and pabySrc + nLineOffset into adjacent    */
+/*      output samples.  Returns how many of the nCount outputs were    */
+/*      done, the caller completes the row.                             */
+/************************************************************************/
+
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSE2 static uint32
+TIFF_Average2x2_8SSE2( const unsigned char *pabySrc, int nLineOffset,
+                       unsigned char *pabyDst, uint32 nCount )
+
+{
+    const __m128i mask = _mm_set1_epi16( 0xff );
+    uint32      i;
+
+    for( i = 0; i + 8 <= nCount; i += 8 )
+    {
+        __m128i  a = _mm_loadu_si128( (const __m128i *) (pabySrc + 2*i) );
+        __m128i  b = _mm_loadu_si128( (const __m128i *)
+                                      (pabySrc + nLineOffset + 2*i) );
+        __m128i  s;
+
+        s = _mm_add_epi16( _mm_add_epi16( _mm_and_si128( a, mask ),
+                                          _mm_srli_epi16( a, 8 ) ),
+                           _mm_add_epi16( _mm_and_si128( b, mask ),
+                                          _mm_srli_epi16( b, 8 ) ) );
+        s = _mm_srli_epi16( s, 2 );
+        _mm_storel_epi64( (__m128i *) (pabyDst + i),
+                          _mm_packus_epi16( s, s ) );
+    }
+    return i;
+}
+#elif defined(TIFF_SIMD_NEON)
+static uint32
+TIFF_Average2x2_8NEON( const unsigned char *pabySrc, int nLineOffset,
+                       unsigned char *pabyDst, uint32 nCount )
+
+{
+    uint32      i;
+
+    for( i = 0; i + 8 <= nCount; i += 8 )
+    {
+        uint16x8_t s;
+
+        s = vaddq_u16( vpaddlq_u8( vld1q_u8( pabySrc + 2*i ) ),
+                       vpaddlq_u8( vld1q_u8( pabySrc + nLineOffset + 2*i ) ) );
+        vst1_u8( pabyDst + i, vshrn_n_u16( s, 2 ) );
+    }
+    return i;
+}
+#endif
+
+static uint32 TIFF_Average2x2_8( const unsigned char *pabySrc, int nLineOffset,
+                                 unsigned char *pabyDst, uint32 nCount )
+
+{
+#if defined(TIFF_SIMD_X86)
+    if( TIFFGetCPUFeatures() & TIFF_CPU_SSE2 )
+        return TIFF_Average2x2_8SSE2( pabySrc, nLineOffset, pabyDst, nCount );
+#elif defined(TIFF_SIMD_NEON)
+    if( TIFFGetCPUFeatures() & TIFF_CPU_NEON )
+        return TIFF_Average2x2_8NEON( pabySrc, nLineOffset, pabyDst, nCount );
+#endif
+    (void) pabySrc;
+    (void) nLineOffset;
+    (void) pabyDst;
+    (void) nCount;
+    return 0;
+}
+
+/************************************************************************/
+/*                          TIFF_AverageRow*()                          */
+/*                                                                      */
+/*      Box average one row of nCount output samples, nDstOffset        */
+/*      bytes apart, from nOMult x nYSize windows of source samples     */
+/*      nPixelOffset bytes apart in lines nLineOffset bytes apart.      */
+/*      Only the last window may be narrower, nLastXSize samples.       */
+/*      The integer sums are exact and floating point ones are added    */
+/*      in the order TIFF_GetSourceSamples() returns them, so the       */
+/*      results match the generic double precision path.                */
+/************************************************************************/
+
+static void TIFF_AverageRow8( const unsigned char *pabySrc,
+                              int nPixelOffset, int nLineOffset,
+                              unsigned char *pabyDst, int nDstOffset,
+                              uint32 nCount, uint32 nLastXSize,
+                              uint32 nOMult, uint32 nYSize )
+
+{
+    uint32      i = 0, iX, iY;
+
+    if( nOMult == 2 && nYSize == 2 )
+    {
+        uint32  nFull = (nLastXSize == 2) ? nCount : nCount - 1;
+
+        if( nPixelOffset == 1 && nDstOffset == 1 )
+            i = TIFF_Average2x2_8( pabySrc, nLineOffset, pabyDst, nFull );
+
+        for( ; i < nFull; i++ )
+        {
+            const unsigned char *pabyA = pabySrc + 2 * i * nPixelOffset;
+            const unsigned char *pabyB = pabyA + nLineOffset;
+
+            pabyDst[i * nDstOffset] = (unsigned char)
+                ((pabyA[0] + pabyA[nPixelOffset]
+                  + pabyB[0] + pabyB[nPixelOffset]) >> 2);
+        }
+    }
+
+    for( ; i < nCount; i++ )
+    {
+        const unsigned char *pabyWindow = pabySrc + i * nOMult * nPixelOffset;
+        uint32  nXSize = (i == nCount - 1) ? nLastXSize : nOMult;
+        uint32  nTotal = 0;
+
+        for( iY = 0; iY < nYSize; iY++ )
+        {
+            const unsigned char *pabyLine = pabyWindow + iY * nLineOffset;
+
+            for( iX = 0; iX < nXSize; iX++ )
+                nTotal += pabyLine[iX * nPixelOffset];
+        }
+        pabyDst[i * nDstOffset] = (unsigned char) (nTotal / (nXSize * nYSize));
+    }
+}
+
+static void TIFF_AverageRow16( const unsigned char *pabySrc,
+                               int nPixelOffset, int nLineOffset,
+                               unsigned char *pabyDst, int nDstOffset,
+                               uint32 nCount, uint32 nLastXSize,
+                               uint32 nOMult, uint32 nYSize )
+
+{
+    uint32      i = 0, iX, iY;
+
+    if( nOMult == 2 && nYSize == 2 )
+    {
+        uint32  nFull = (nLastXSize == 2) ? nCount : nCount - 1;
+
+        for( ; i < nFull; i++ )
+        {
+            const unsigned char *pabyA = pabySrc + 2 * i * nPixelOffset;
+            const unsigned char *pabyB = pabyA + nLineOffset;
+            uint32  nTotal;
+
+            nTotal = (uint32) *((const uint16 *) pabyA)
+                + *((const uint16 *) (pabyA + nPixelOffset))
+                + *((const uint16 *) pabyB)
+                + *((const uint16 *) (pabyB + nPixelOffset));
+            *((uint16 *) (pabyDst + i * nDstOffset)) = (uint16) (nTotal >> 2);
+        }
+    }
+
+    for( ; i < nCount; i++ )
+    {
+        const unsigned char *pabyWindow = pabySrc + i * nOMult * nPixelOffset;
+        uint32  nXSize = (i == nCount - 1) ? nLastXSize : nOMult;
+        uint64  nTotal = 0;
+
+        for( iY = 0; iY < nYSize; iY++ )
+        {
+            const unsigned char *pabyLine = pabyWindow + iY * nLineOffset;
+
+            for( iX = 0; iX < nXSize; iX++ )
+                nTotal += *((const uint16 *) (pabyLine + iX * nPixelOffset));
+        }
+        *((uint16 *) (pabyDst + i * nDstOffset)) =
+            (uint16) (nTotal / (nXSize * nYSize));
+    }
+}
+
+static void TIFF_AverageRowFloat( const unsigned char *pabySrc,
+                                  int nPixelOffset, int nLineOffset,
+                                  unsigned char *pabyDst, int nDstOffset,
+                                  uint32 nCount, uint32 nLastXSize,
+                                  uint32 nOMult, uint32 nYSize )
+
+{
+    uint32      i, iX, iY;
+
+    for( i = 0; i < nCount; i++ )
+    {
+        const unsigned char *pabyWindow = pabySrc + i * nOMult * nPixelOffset;
+        uint32  nXSize = (i == nCount - 1) ? nLastXSize : nOMult;
+        double  dfTotal = 0;
+
+        for( iY = 0; iY < nYSize; iY++ )
+        {
+            const unsigned char *pabyLine = pabyWindow + iY * nLineOffset;
+
+            for( iX = 0; iX < nXSize; iX++ )
+                dfTotal += *((const float *) (pabyLine + iX * nPixelOffset));
+        }
+        *((float *) (pabyDst + i * nDstOffset)) =
+            (float) (dfTotal / (nXSize * nYSize));
+    }
+}
+
 /************************************************************************/
 /*                          TIFF_DownSample()                           */
 /*                                                                      */
@@ -283,7 +495,7 @@ void TIFF_DownSample( unsigned char *pabySrcTile,
     int         k, nPixelBytes = (nBitsPerPixel) / 8;
     int		nPixelGroupBytes = (nBitsPerPixel+nPixelSkewBits)/8;
     unsigned char *pabySrc, *pabyDst;
-    double      *padfSamples;
+    double      *padfSamples = NULL;
     size_t      tpadfSamples_size, padfSamples_size;
 
     assert( nBitsPerPixel >= 8 );
@@ -304,7 +516,6 @@ void TIFF_DownSample( unsigned char *pabySrcTile,
         /* TODO: This is an error condition */
         return;
     }
-    padfSamples = (double *) malloc(padfSamples_size);
 
 /* ==================================================================== */
 /*      Loop over scanline chunks to process, establishing where the    */
@@ -316,7 +527,7 @@ void TIFF_DownSample( unsigned char *pabySrcTile,
             break;
 
         pabyDst = pabyOTile + ((j+nTYOff)*nOBlockXSize + nTXOff)
-            * nPixelBytes * nPixelGroupBytes;
+            * nPixelGroupBytes;
 
 /* -------------------------------------------------------------------- */
 /*      Handler nearest resampling ... we don't even care about the     */
@@ -331,7 +542,7 @@ void TIFF_DownSample( unsigned char *pabySrcTile,
             {
                 if( i + nTXOff >= nOBlockXSize )
                     break;
-            
+
                 /*
                  * For now use simple subsampling, from the top left corner
                  * of the source block of pixels.
@@ -340,36 +551,72 @@ void TIFF_DownSample( unsigned char *pabySrcTile,
                 for( k = 0; k < nPixelBytes; k++ )
                     pabyDst[k] = pabySrc[k];
 
-                pabyDst += nPixelBytes * nPixelGroupBytes;
+                pabyDst += nPixelGroupBytes;
                 pabySrc += nOMult * nPixelGroupBytes;
             }
         }
 
 /* -------------------------------------------------------------------- */
 /*      Handle the case of averaging.  For this we also have to         */
-/*      handle each sample format we are concerned with.                */
+/*      handle each sample format we are concerned with.  Unsigned      */
+/*      8 and 16 bit and 32 bit floating point samples have kernels     */
+/*      of their own, the others go through doubles.                    */
 /* -------------------------------------------------------------------- */
         else if( strncmp(pszResampling,"averag",6) == 0
                  || strncmp(pszResampling,"AVERAG",6) == 0 )
         {
+            uint32   nCount, nLastXSize, nYSize;
+            int      nLineOffset = nPixelGroupBytes * nBlockXSize;
+
+            if( nTXOff >= nOBlockXSize )
+                break;
+
             pabySrc = pabySrcTile + j*nOMult*nBlockXSize * nPixelGroupBytes;
+            nYSize = MIN((uint32)nOMult,nBlockYSize-j*nOMult);
 
-            for( i = 0; i*nOMult < nBlockXSize; i++ )
+            nCount = (nBlockXSize + nOMult - 1) / nOMult;
+            if( nCount > nOBlockXSize - nTXOff )
+                nCount = nOBlockXSize - nTXOff;
+            nLastXSize = MIN((uint32)nOMult,nBlockXSize-(nCount-1)*nOMult);
+
+            if( nSampleFormat == SAMPLEFORMAT_UINT && nPixelBytes == 1 )
             {
-                double   dfTotal;
-                uint32   nXSize, nYSize, iSample;
+                TIFF_AverageRow8( pabySrc, nPixelGroupBytes, nLineOffset,
+                                  pabyDst, nPixelGroupBytes,
+                                  nCount, nLastXSize, nOMult, nYSize );
+                continue;
+            }
+            if( nSampleFormat == SAMPLEFORMAT_UINT && nPixelBytes == 2 )
+            {
+                TIFF_AverageRow16( pabySrc, nPixelGroupBytes, nLineOffset,
+                                   pabyDst, nPixelGroupBytes,
+                                   nCount, nLastXSize, nOMult, nYSize );
+                continue;
+            }
+            if( nSampleFormat == SAMPLEFORMAT_IEEEFP && nPixelBytes == 4 )
+            {
+                TIFF_AverageRowFloat( pabySrc, nPixelGroupBytes, nLineOffset,
+                                      pabyDst, nPixelGroupBytes,
+                                      nCount, nLastXSize, nOMult, nYSize );
+                continue;
+            }
 
-                if( i + nTXOff >= nOBlockXSize )
-                    break;
+            if( padfSamples == NULL )
+                padfSamples = (double *) malloc(padfSamples_size);
+            if( padfSamples == NULL )
+                break;
 
-                nXSize = MIN((uint32)nOMult,nBlockXSize-i);
-                nYSize = MIN((uint32)nOMult,nBlockYSize-j);
+            for( i = 0; i < nCount; i++ )
+            {
+                double   dfTotal;
+                uint32   nXSize, iSample;
+
+                nXSize = MIN((uint32)nOMult,nBlockXSize-i*nOMult);
 
                 TIFF_GetSourceSamples( padfSamples, pabySrc,
                                        nPixelBytes, nSampleFormat,
                                        nXSize, nYSize,
-                                       nPixelGroupBytes,
-                                       nPixelGroupBytes * nBlockXSize );
+                                       nPixelGroupBytes, nLineOffset );
 
                 dfTotal = 0;
                 for( iSample = 0; iSample < nXSize*nYSize; iSample++ )
@@ -377,11 +624,11 @@ void TIFF_DownSample( unsigned char *pabySrcTile,
                     dfTotal += padfSamples[iSample];
                 }
 
-                TIFF_SetSample( pabyDst, nPixelBytes, nSampleFormat, 
+                TIFF_SetSample( pabyDst, nPixelBytes, nSampleFormat,
                                 dfTotal / (nXSize*nYSize) );
 
                 pabySrc += nOMult * nPixelGroupBytes;
-                pabyDst += nPixelBytes;
+                pabyDst += nPixelGroupBytes;
             }
         }
     }
@@ -559,6 +806,108 @@ void TIFF_DownSample_Subsampled( unsigned char *pabySrcTile, int nSample,
     }
 }
 
+/************************************************************************/
+/*                        TIFF_DownSampleBlock()                        */
+/*                                                                      */
+/*      Downsample one sample of one block of full res data into the    */
+/*      overview held by poRBI.                                         */
+/************************************************************************/
+
+static void TIFF_DownSampleBlock( TIFFOvrCache *poRBI, uint32 nOMult,
+                                  int nPlanarConfig, int bSubsampled,
+                                  int nHorSubsampling, int nVerSubsampling,
+                                  int nBitsPerPixel, int nSamples, int iSample,
+                                  uint32 nSXOff, uint32 nSYOff,
+                                  unsigned char *pabySrcTile,
+                                  uint32 nBlockXSize, uint32 nBlockYSize,
+                                  int nSampleFormat, const char * pszResampling )
+
+{
+    unsigned char *pabyOTile;
+    uint32  nTXOff, nTYOff, nOXOff, nOYOff;
+    uint32  nOBlockXSize = poRBI->nBlockXSize;
+    uint32  nOBlockYSize = poRBI->nBlockYSize;
+    int     nSkewBits, nSampleByteOffset; 
+
+    /*
+     * Fetch the destination overview tile
+     */
+    nOXOff = (nSXOff/nOMult) / nOBlockXSize;
+    nOYOff = (nSYOff/nOMult) / nOBlockYSize;
+
+    if( bSubsampled )
+    {
+        pabyOTile = TIFFGetOvrBlock_Subsampled( poRBI, nOXOff, nOYOff );
+
+        /*
+         * Establish the offset into this tile at which we should
+         * start placing data.
+         */
+        nTXOff = (nSXOff - nOXOff*nOMult*nOBlockXSize) / nOMult;
+        nTYOff = (nSYOff - nOYOff*nOMult*nOBlockYSize) / nOMult;
+
+
+#ifdef DBMALLOC
+        malloc_chain_check( 1 );
+#endif
+        TIFF_DownSample_Subsampled( pabySrcTile, iSample,
+                                    nBlockXSize, nBlockYSize,
+                                    pabyOTile,
+                                    poRBI->nBlockXSize, poRBI->nBlockYSize,
+                                    nTXOff, nTYOff,
+                                    nOMult, pszResampling,
+                                    nHorSubsampling, nVerSubsampling );
+#ifdef DBMALLOC
+        malloc_chain_check( 1 );
+#endif
+
+    }
+    else
+    {
+
+        pabyOTile = TIFFGetOvrBlock( poRBI, nOXOff, nOYOff, iSample );
+
+        /*
+         * Establish the offset into this tile at which we should
+         * start placing data.
+         */
+        nTXOff = (nSXOff - nOXOff*nOMult*nOBlockXSize) / nOMult;
+        nTYOff = (nSYOff - nOYOff*nOMult*nOBlockYSize) / nOMult;
+
+        /*
+         * Figure out the skew (extra space between ``our samples'') and
+         * the byte offset to the first sample.
+         */
+        assert( (nBitsPerPixel % 8) == 0 );
+        if( nPlanarConfig == PLANARCONFIG_SEPARATE )
+        {
+            nSkewBits = 0;
+            nSampleByteOffset = 0;
+        }
+        else
+        {
+            nSkewBits = nBitsPerPixel * (nSamples-1);
+            nSampleByteOffset = (nBitsPerPixel/8) * iSample;
+        }
+
+        /*
+         * Perform the downsampling.
+         */
+#ifdef DBMALLOC
+        malloc_chain_check( 1 );
+#endif
+        TIFF_DownSample( pabySrcTile + nSampleByteOffset,
+                       nBlockXSize, nBlockYSize,
+                       nSkewBits, nBitsPerPixel, pabyOTile,
+                       poRBI->nBlockXSize, poRBI->nBlockYSize,
+                       nTXOff, nTYOff,
+                       nOMult, nSampleFormat, pszResampling );
+#ifdef DBMALLOC
+        malloc_chain_check( 1 );
+#endif
+    }
+}
+
 /************************************************************************/
 /*                      TIFF_ProcessFullResBlock()                      */
 /*                                                                      */
@@ -612,95 +961,266 @@ void TIFF_ProcessFullResBlock( TIFF *hTIFF, int nPlanarConfig,
          */
         for( iOverview = 0; iOverview < nOverviews; iOverview++ )
         {
-            TIFFOvrCache *poRBI = papoRawBIs[iOverview];
-            unsigned char *pabyOTile;
-            uint32  nTXOff, nTYOff, nOXOff, nOYOff, nOMult;
-            uint32  nOBlockXSize = poRBI->nBlockXSize;
-            uint32  nOBlockYSize = poRBI->nBlockYSize;
-            int     nSkewBits, nSampleByteOffset; 
+            TIFF_DownSampleBlock( papoRawBIs[iOverview],
+                                  panOvList[iOverview], nPlanarConfig,
+                                  bSubsampled, nHorSubsampling,
+                                  nVerSubsampling, nBitsPerPixel, nSamples,
+                                  iSample, nSXOff, nSYOff, pabySrcTile,
+                                  nBlockXSize, nBlockYSize,
+                                  nSampleFormat, pszResampling );
+        }
+    }
+}
 
-            /*
-             * Fetch the destination overview tile
-             */
-            nOMult = panOvList[iOverview];
-            nOXOff = (nSXOff/nOMult) / nOBlockXSize;
-            nOYOff = (nSYOff/nOMult) / nOBlockYSize;
+/************************************************************************/
+/*                       TIFF_DownSampleBandRow()                       */
+/*                                                                      */
+/*      Thread function downsampling a row of source blocks of a band   */
+/*      into the overviews.  Every job covers the source blocks that    */
+/*      fall into one column of blocks of one overview, so jobs write   */
+/*      to separate overview blocks, each in the order of the serial    */
+/*      loop of TIFF_ProcessFullResBlock().                             */
+/************************************************************************/
 
-            if( bSubsampled )
-            {
-                pabyOTile = TIFFGetOvrBlock_Subsampled( poRBI, nOXOff, nOYOff );
+typedef struct
+{
+    int         iOverview;
+    int         iFirstBlock;    /* first source block of the band */
+    int         nBlocks;        /* number of source blocks */
+} TIFFOvrJob;
 
-                /*
-                 * Establish the offset into this tile at which we should
-                 * start placing data.
-                 */
-                nTXOff = (nSXOff - nOXOff*nOMult*nOBlockXSize) / nOMult;
-                nTYOff = (nSYOff - nOYOff*nOMult*nOBlockYSize) / nOMult;
+typedef struct
+{
+    TIFFOvrCache **papoRawBIs;
+    int         *panOvList;
+    int         nPlanarConfig, bSubsampled;
+    int         nHorSubsampling, nVerSubsampling;
+    int         nBitsPerPixel, nSamples, nSampleFormat;
+    const char  *pszResampling;
+    uint32      nBlockXSize, nBlockYSize;
+
+    uint32      nBandXOff;      /* first source column of the band */
+    uint32      nSYOff;         /* first source row of the blocks */
+    int         nSrcPlanes;     /* blocks per source block column */
+    unsigned char **papabySrcBlocks;
+
+    TIFFOvrJob  *pasJobs;
+    int         nJobs;
+    int         iNextJob;
+    ToolMutex   *hJobMutex;
+} TIFFOvrBandRow;
+
+static void TIFF_DownSampleBandRow( void *pArg )
 
+{
+    TIFFOvrBandRow *psRow = (TIFFOvrBandRow *) pArg;
 
-#ifdef DBMALLOC
-                malloc_chain_check( 1 );
-#endif
-                TIFF_DownSample_Subsampled( pabySrcTile, iSample,
-                                            nBlockXSize, nBlockYSize,
-                                            pabyOTile,
-                                            poRBI->nBlockXSize, poRBI->nBlockYSize,
-                                            nTXOff, nTYOff,
-                                            nOMult, pszResampling,
-                                            nHorSubsampling, nVerSubsampling );
-#ifdef DBMALLOC
-                malloc_chain_check( 1 );
-#endif
+    for( ;; )
+    {
+        TIFFOvrJob *psJob;
+        int     iJob, iBlock, iSample;
+
+        if( psRow->hJobMutex != NULL )
+            toolMutexLock( psRow->hJobMutex );
+        iJob = psRow->iNextJob++;
+        if( psRow->hJobMutex != NULL )
+            toolMutexUnlock( psRow->hJobMutex );
+        if( iJob >= psRow->nJobs )
+            break;
 
-            }
-            else
+        psJob = psRow->pasJobs + iJob;
+        for( iBlock = psJob->iFirstBlock;
+             iBlock < psJob->iFirstBlock + psJob->nBlocks; iBlock++ )
+        {
+            for( iSample = 0; iSample < psRow->nSamples; iSample++ )
             {
+                int     iPlane = 0;
+
+                if( psRow->nPlanarConfig == PLANARCONFIG_SEPARATE )
+                    iPlane = iSample;
+
+                TIFF_DownSampleBlock(
+                    psRow->papoRawBIs[psJob->iOverview],
+                    psRow->panOvList[psJob->iOverview],
+                    psRow->nPlanarConfig, psRow->bSubsampled,
+                    psRow->nHorSubsampling, psRow->nVerSubsampling,
+                    psRow->nBitsPerPixel, psRow->nSamples, iSample,
+                    psRow->nBandXOff + iBlock * psRow->nBlockXSize,
+                    psRow->nSYOff,
+                    psRow->papabySrcBlocks[iBlock * psRow->nSrcPlanes
+                                           + iPlane],
+                    psRow->nBlockXSize, psRow->nBlockYSize,
+                    psRow->nSampleFormat, psRow->pszResampling );
+            }
+        }
+    }
+}
 
-                pabyOTile = TIFFGetOvrBlock( poRBI, nOXOff, nOYOff, iSample );
+/************************************************************************/
+/*                          TIFF_AddBandJobs()                          */
+/*                                                                      */
+/*      Add to psRow the jobs downsampling its nBlocks source blocks    */
+/*      into overview iOverview, of nOBlockXSize wide blocks.           */
+/************************************************************************/
 
-                /*
-                 * Establish the offset into this tile at which we should
-                 * start placing data.
-                 */
-                nTXOff = (nSXOff - nOXOff*nOMult*nOBlockXSize) / nOMult;
-                nTYOff = (nSYOff - nOYOff*nOMult*nOBlockYSize) / nOMult;
+static void TIFF_AddBandJobs( TIFFOvrBandRow *psRow, int iOverview,
+                              uint32 nOBlockXSize, int nBlocks )
 
-                /*
-                 * Figure out the skew (extra space between ``our samples'') and
-                 * the byte offset to the first sample.
-                 */
-                assert( (nBitsPerPixel % 8) == 0 );
-                if( nPlanarConfig == PLANARCONFIG_SEPARATE )
-                {
-                    nSkewBits = 0;
-                    nSampleByteOffset = 0;
-                }
-                else
-                {
-                    nSkewBits = nBitsPerPixel * (nSamples-1);
-                    nSampleByteOffset = (nBitsPerPixel/8) * iSample;
-                }
+{
+    uint32      nOMult = psRow->panOvList[iOverview];
+    int         iBlock, iLastOXOff = -1;
 
-                /*
-                 * Perform the downsampling.
-                 */
-#ifdef DBMALLOC
-                malloc_chain_check( 1 );
-#endif
-                TIFF_DownSample( pabySrcTile + nSampleByteOffset,
-                               nBlockXSize, nBlockYSize,
-                               nSkewBits, nBitsPerPixel, pabyOTile,
-                               poRBI->nBlockXSize, poRBI->nBlockYSize,
-                               nTXOff, nTYOff,
-                               nOMult, nSampleFormat, pszResampling );
-#ifdef DBMALLOC
-                malloc_chain_check( 1 );
-#endif
-            }
+    for( iBlock = 0; iBlock < nBlocks; iBlock++ )
+    {
+        int     iOXOff = ((psRow->nBandXOff + iBlock * psRow->nBlockXSize)
+                          / nOMult) / nOBlockXSize;
+
+        if( iOXOff != iLastOXOff )
+        {
+            psRow->pasJobs[psRow->nJobs].iOverview = iOverview;
+            psRow->pasJobs[psRow->nJobs].iFirstBlock = iBlock;
+            psRow->pasJobs[psRow->nJobs].nBlocks = 0;
+            psRow->nJobs++;
+            iLastOXOff = iOXOff;
         }
+        psRow->pasJobs[psRow->nJobs-1].nBlocks++;
     }
 }
 
+/************************************************************************/
+/*                          TIFF_RunBandRow()                           */
+/************************************************************************/
+
+static void TIFF_RunBandRow( TIFFOvrBandRow *psRow, int nThreads,
+                             void **papArgs )
+
+{
+    int         i;
+
+    if( psRow->nJobs == 0 )
+        return;
+    psRow->iNextJob = 0;
+    if( psRow->hJobMutex == NULL )
+        nThreads = 1;
+    if( nThreads > psRow->nJobs )
+        nThreads = psRow->nJobs;
+    for( i = 0; i < nThreads; i++ )
+        papArgs[i] = psRow;
+    toolRunThreads( nThreads, TIFF_DownSampleBandRow, papArgs );
+}
+
+/************************************************************************/
+/*                          TIFF_CascadeRow()                           */
+/*                                                                      */
+/*      Called by the cache of an overview with each row of blocks      */
+/*      it is about to write, to downsample the row into the            */
+/*      overviews built from that one rather than from the source       */
+/*      raster.  The row then serves like a row of source blocks.       */
+/************************************************************************/
+
+typedef struct
+{
+    TIFFOvrBandRow sRow;
+    int         nChildren;
+    int         *panChildren;   /* overviews made from this one */
+    int         nThreads;
+    void        **papArgs;
+} TIFFOvrCascade;
+
+static void TIFF_CascadeRow( TIFFOvrCache *poRBI, int iTileY, void *pData )
+
+{
+    TIFFOvrCascade *psCascade = (TIFFOvrCascade *) pData;
+    TIFFOvrBandRow *psRow = &(psCascade->sRow);
+    int         iBlock, iPlane, i;
+
+    for( iBlock = 0; iBlock < poRBI->nBlocksHeld; iBlock++ )
+    {
+        for( iPlane = 0; iPlane < psRow->nSrcPlanes; iPlane++ )
+            psRow->papabySrcBlocks[iBlock * psRow->nSrcPlanes + iPlane] =
+                TIFFGetOvrBlock( poRBI, poRBI->nBlockXOffset + iBlock,
+                                 iTileY, iPlane );
+    }
+
+    psRow->nBandXOff = poRBI->nBlockXOffset * poRBI->nBlockXSize;
+    psRow->nSYOff = iTileY * poRBI->nBlockYSize;
+    psRow->nJobs = 0;
+    for( i = 0; i < psCascade->nChildren; i++ )
+    {
+        int     iOverview = psCascade->panChildren[i];
+        TIFFOvrCache *poChild = psRow->papoRawBIs[iOverview];
+
+        TIFFPrepareOvrRow( poChild, (psRow->nSYOff
+                                     / psRow->panOvList[iOverview])
+                           / poChild->nBlockYSize );
+        TIFF_AddBandJobs( psRow, iOverview, poChild->nBlockXSize,
+                          poRBI->nBlocksHeld );
+    }
+
+    TIFF_RunBandRow( psRow, psCascade->nThreads, psCascade->papArgs );
+}
+
+/************************************************************************/
+/*                         TIFF_GetBandXSize()                          */
+/*                                                                      */
+/*      Choose the width of the vertical bands the source raster is     */
+/*      processed in, so that a row of source blocks of a band and      */
+/*      the two rows of overview blocks cached for it fit in            */
+/*      nMemoryBudget bytes.  Band edges must be on block edges of      */
+/*      every overview, so if none is inside the raster the whole       */
+/*      width is used whatever the budget.                              */
+/************************************************************************/
+
+static uint64 TIFF_GCD( uint64 nA, uint64 nB )
+
+{
+    while( nB != 0 )
+    {
+        uint64  nT = nA % nB;
+
+        nA = nB;
+        nB = nT;
+    }
+    return nA;
+}
+
+static uint32 TIFF_GetBandXSize( uint32 nXSize, uint32 nBlockXSize,
+                                 tmsize_t nSrcBlockBytes,
+                                 int nOverviews, int *panOvList,
+                                 uint32 *panOBlockXSize,
+                                 uint64 *panOBlockBytes,
+                                 tmsize_t nMemoryBudget )
+
+{
+    uint64      nUnit = nBlockXSize, nUnitBytes, nUnits;
+    int         i;
+
+    if( nMemoryBudget <= 0 )
+        return nXSize;
+
+    for( i = 0; i < nOverviews; i++ )
+    {
+        uint64  nEdge = (uint64) panOvList[i] * panOBlockXSize[i];
+
+        nUnit = nUnit / TIFF_GCD( nUnit, nEdge ) * nEdge;
+        if( nUnit >= nXSize )
+            return nXSize;
+    }
+
+    nUnitBytes = (nUnit / nBlockXSize) * nSrcBlockBytes;
+    for( i = 0; i < nOverviews; i++ )
+        nUnitBytes += 2 * (nUnit / ((uint64) panOvList[i] * panOBlockXSize[i]))
+            * panOBlockBytes[i];
+
+    nUnits = (uint64) nMemoryBudget / nUnitBytes;
+    if( nUnits < 1 )
+        nUnits = 1;
+    if( nUnits * nUnit >= nXSize )
+        return nXSize;
+
+    return (uint32) (nUnits * nUnit);
+}
+
 /************************************************************************/
 /*                        TIFF_BuildOverviews()                         */
 /*                                                                      */
@@ -716,6 +1236,39 @@ void TIFFBuildOverviews( TIFF *hTIFF, int nOverviews, int * panOvList,
                          int (*pfnProgress)( double, void * ),
                          void * pProgressData )
 
+{
+    TIFFBuildOverviewsParallel( hTIFF, nOverviews, panOvList, bUseSubIFDs,
+                                pszResampleMethod, 1, 0, FALSE,
+                                pfnProgress, pProgressData );
+}
+
+/************************************************************************/
+/*                     TIFFBuildOverviewsParallel()                     */
+/*                                                                      */
+/*      Same as TIFFBuildOverviews(), on nThreads threads (0 for one    */
+/*      per CPU).  Each row of source blocks is decoded at once, the    */
+/*      columns of overview blocks it falls into are downsampled        */
+/*      concurrently, and each row of overview blocks is compressed     */
+/*      on the threads as it is written.  If nMemoryBudget is not 0,    */
+/*      a tiled raster too wide for the source and overview rows to     */
+/*      fit in that many bytes is processed in vertical bands, which    */
+/*      writes the overview tiles band after band.                      */
+/*                                                                      */
+/*      If bCascade is set, an overview whose factor is a multiple of   */
+/*      that of another one is downsampled from the largest such        */
+/*      overview, a row of blocks at a time as that one is written,     */
+/*      instead of from the source raster.  This is still one pass      */
+/*      through the source raster but does much less resampling.       */
+/************************************************************************/
+
+void TIFFBuildOverviewsParallel( TIFF *hTIFF, int nOverviews, int * panOvList,
+                                 int bUseSubIFDs,
+                                 const char *pszResampleMethod,
+                                 int nThreads, tmsize_t nMemoryBudget,
+                                 int bCascade,
+                                 int (*pfnProgress)( double, void * ),
+                                 void * pProgressData )
+
 {
     TIFFOvrCache	**papoRawBIs;
     uint32		nXSize, nYSize, nBlockXSize, nBlockYSize;
@@ -723,10 +1276,20 @@ void TIFFBuildOverviews( TIFF *hTIFF, int nOverviews, int * panOvList,
         nPlanarConfig, nSampleFormat;
     int         bSubsampled;
     uint16      nHorSubsampling, nVerSubsampling;
-    int			bTiled, nSXOff, nSYOff, i;
-    unsigned char	*pabySrcTile;
+    int			bTiled, i;
+    uint32      nSYOff, nBandXOff, nBandXSize;
     uint16		*panRedMap, *panGreenMap, *panBlueMap;
     TIFFErrorHandler    pfnWarning;
+    toff_t      *panDirOffset;
+    uint32      *panOBlockXSize, *panBlockIDs;
+    uint64      *panOBlockBytes;
+    tmsize_t    nSrcBlockBytes;
+    int         nSrcPlanes, nMaxBandBlocks, bHaveBuffers;
+    unsigned char *pabySrcBlocks, **papabySrcBlocks;
+    void        **papArgs;
+    TIFFOvrBandRow sRow;
+    int         *panParent, *panOvMult, *panOrder;
+    TIFFOvrCascade **papsCascades;
 
     (void) pfnProgress;
     (void) pProgressData;
@@ -831,12 +1394,19 @@ void TIFFBuildOverviews( TIFF *hTIFF, int nOverviews, int * panOvList,
 /* -------------------------------------------------------------------- */
 /*      Initialize overviews.                                           */
 /* -------------------------------------------------------------------- */
+    if( nThreads <= 0 )
+        nThreads = toolGetNumCPUs();
+    if( nThreads > TIFF_MAX_WORKER_THREADS )
+        nThreads = TIFF_MAX_WORKER_THREADS;
+
     papoRawBIs = (TIFFOvrCache **) _TIFFmalloc(nOverviews*sizeof(void*));
+    panDirOffset = (toff_t *) _TIFFmalloc(nOverviews*sizeof(toff_t));
+    panOBlockXSize = (uint32 *) _TIFFmalloc(nOverviews*sizeof(uint32));
+    panOBlockBytes = (uint64 *) _TIFFmalloc(nOverviews*sizeof(uint64));
 
     for( i = 0; i < nOverviews; i++ )
     {
         uint32  nOXSize, nOYSize, nOBlockXSize, nOBlockYSize;
-        toff_t  nDirOffset;
 
         nOXSize = (nXSize + panOvList[i] - 1) / panOvList[i];
         nOYSize = (nYSize + panOvList[i] - 1) / panOvList[i];
@@ -853,7 +1423,7 @@ void TIFFBuildOverviews( TIFF *hTIFF, int nOverviews, int * panOvList,
                 nOBlockYSize = nOBlockYSize + 16 - (nOBlockYSize % 16);
         }
 
-        nDirOffset = TIFF_WriteOverview( hTIFF, nOXSize, nOYSize,
+        panDirOffset[i] = TIFF_WriteOverview( hTIFF, nOXSize, nOYSize,
                                          nBitsPerPixel, nPlanarConfig,
                                          nSamples, nOBlockXSize, nOBlockYSize,
                                          bTiled, nCompressFlag, nPhotometric,
@@ -861,8 +1431,10 @@ void TIFFBuildOverviews( TIFF *hTIFF, int nOverviews, int * panOvList,
                                          panRedMap, panGreenMap, panBlueMap,
                                          bUseSubIFDs,
                                          nHorSubsampling, nVerSubsampling );
-        
-        papoRawBIs[i] = TIFFCreateOvrCache( hTIFF, nDirOffset );
+
+        panOBlockXSize[i] = nOBlockXSize;
+        panOBlockBytes[i] = (uint64) nOBlockXSize * nOBlockYSize
+            * (nBitsPerPixel / 8) * nSamples;
     }
 
     if( panRedMap != NULL )
@@ -871,47 +1443,310 @@ void TIFFBuildOverviews( TIFF *hTIFF, int nOverviews, int * panOvList,
         _TIFFfree( panGreenMap );
         _TIFFfree( panBlueMap );
     }
-    
+
 /* -------------------------------------------------------------------- */
-/*      Allocate a buffer to hold a source block.                       */
+/*      Size the bands, and the overview caches for them.               */
 /* -------------------------------------------------------------------- */
+    nSrcPlanes = (nPlanarConfig == PLANARCONFIG_SEPARATE) ? nSamples : 1;
+    nSrcBlockBytes = bTiled ? TIFFTileSize(hTIFF) : TIFFStripSize(hTIFF);
+
+    nBandXSize = nXSize;
     if( bTiled )
-        pabySrcTile = (unsigned char *) _TIFFmalloc(TIFFTileSize(hTIFF));
+        nBandXSize = TIFF_GetBandXSize( nXSize, nBlockXSize,
+                                        nSrcBlockBytes * nSrcPlanes,
+                                        nOverviews, panOvList,
+                                        panOBlockXSize, panOBlockBytes,
+                                        nMemoryBudget );
+
+    for( i = 0; i < nOverviews; i++ )
+    {
+        int     nMaxBlocksHeld = 0;
+
+        if( nBandXSize < nXSize )
+            nMaxBlocksHeld = nBandXSize / (panOvList[i] * panOBlockXSize[i]);
+
+        papoRawBIs[i] = TIFFCreateOvrCacheEx( hTIFF, panDirOffset[i],
+                                              nMaxBlocksHeld );
+        papoRawBIs[i]->nThreads = nThreads;
+    }
+
+    _TIFFfree( panDirOffset );
+    _TIFFfree( panOBlockBytes );
+
+/* -------------------------------------------------------------------- */
+/*      Find the overview each one is downsampled from (-1 for the      */
+/*      source raster) and the factor relative to it, and an order      */
+/*      of the overviews in which each comes after its parent.          */
+/* -------------------------------------------------------------------- */
+    panParent = (int *) _TIFFmalloc(nOverviews*sizeof(int));
+    panOvMult = (int *) _TIFFmalloc(nOverviews*sizeof(int));
+    panOrder = (int *) _TIFFmalloc(nOverviews*sizeof(int));
+
+    for( i = 0; i < nOverviews; i++ )
+    {
+        int     j, iBest = -1;
+
+        for( j = 0; j < nOverviews && bCascade && !bSubsampled; j++ )
+        {
+            if( panOvList[j] < panOvList[i]
+                && panOvList[i] % panOvList[j] == 0
+                && (iBest < 0 || panOvList[j] > panOvList[iBest]) )
+                iBest = j;
+        }
+        panParent[i] = iBest;
+        panOvMult[i] = panOvList[i];
+        if( iBest >= 0 )
+            panOvMult[i] /= panOvList[iBest];
+
+        for( j = i;
+             j > 0 && bCascade && panOvList[panOrder[j-1]] > panOvList[i];
+             j-- )
+            panOrder[j] = panOrder[j-1];
+        panOrder[j] = i;
+    }
+    
+/* -------------------------------------------------------------------- */
+/*      Allocate buffers to hold a row of source blocks of a band,      */
+/*      and the jobs downsampling them.                                 */
+/* -------------------------------------------------------------------- */
+    nMaxBandBlocks = (nBandXSize + nBlockXSize - 1) / nBlockXSize;
+
+    pabySrcBlocks = (unsigned char *)
+        _TIFFmalloc(nSrcBlockBytes * nSrcPlanes * nMaxBandBlocks);
+    papabySrcBlocks = (unsigned char **)
+        _TIFFmalloc(nSrcPlanes * nMaxBandBlocks * sizeof(unsigned char *));
+    panBlockIDs = (uint32 *)
+        _TIFFmalloc(nSrcPlanes * nMaxBandBlocks * sizeof(uint32));
+    papArgs = (void **) _TIFFmalloc(nThreads * sizeof(void *));
+
+    memset( &sRow, 0, sizeof(sRow) );
+    sRow.pasJobs = (TIFFOvrJob *)
+        _TIFFmalloc(nOverviews * nMaxBandBlocks * sizeof(TIFFOvrJob));
+
+    if( pabySrcBlocks == NULL || papabySrcBlocks == NULL
+        || panBlockIDs == NULL || papArgs == NULL || sRow.pasJobs == NULL )
+    {
+        TIFFErrorExt( TIFFClientdata(hTIFF), "TIFFBuildOverviews",
+                      "Can't allocate memory for source blocks." );
+        bHaveBuffers = FALSE;
+    }
     else
-        pabySrcTile = (unsigned char *) _TIFFmalloc(TIFFStripSize(hTIFF));
+    {
+        for( i = 0; i < nSrcPlanes * nMaxBandBlocks; i++ )
+            papabySrcBlocks[i] = pabySrcBlocks + i * nSrcBlockBytes;
+        bHaveBuffers = TRUE;
+    }
+
+    sRow.papoRawBIs = papoRawBIs;
+    sRow.panOvList = panOvMult;
+    sRow.nPlanarConfig = nPlanarConfig;
+    sRow.bSubsampled = bSubsampled;
+    sRow.nHorSubsampling = nHorSubsampling;
+    sRow.nVerSubsampling = nVerSubsampling;
+    sRow.nBitsPerPixel = nBitsPerPixel;
+    sRow.nSamples = nSamples;
+    sRow.nSampleFormat = nSampleFormat;
+    sRow.pszResampling = pszResampleMethod;
+    sRow.nBlockXSize = nBlockXSize;
+    sRow.nBlockYSize = nBlockYSize;
+    sRow.nSrcPlanes = nSrcPlanes;
+    sRow.papabySrcBlocks = papabySrcBlocks;
+    if( nThreads > 1 )
+        sRow.hJobMutex = toolMutexCreate();
+
+/* -------------------------------------------------------------------- */
+/*      Hook the overviews that others are built from.                  */
+/* -------------------------------------------------------------------- */
+    papsCascades = (TIFFOvrCascade **)
+        _TIFFmalloc(nOverviews * sizeof(TIFFOvrCascade *));
+    for( i = 0; i < nOverviews && papsCascades != NULL; i++ )
+    {
+        TIFFOvrCascade *psCascade;
+        int     j, nMaxBlocks = papoRawBIs[i]->nMaxBlocksHeld;
+
+        papsCascades[i] = NULL;
+        for( j = 0; j < nOverviews && panParent[j] != i; j++ ) {}
+        if( j == nOverviews || !bHaveBuffers )
+            continue;
+
+        psCascade = (TIFFOvrCascade *) _TIFFmalloc(sizeof(TIFFOvrCascade));
+        if( psCascade == NULL )
+            continue;
+        psCascade->sRow = sRow;
+        psCascade->sRow.nBlockXSize = papoRawBIs[i]->nBlockXSize;
+        psCascade->sRow.nBlockYSize = papoRawBIs[i]->nBlockYSize;
+        psCascade->sRow.papabySrcBlocks = (unsigned char **)
+            _TIFFmalloc(nSrcPlanes * nMaxBlocks * sizeof(unsigned char *));
+        psCascade->sRow.pasJobs = (TIFFOvrJob *)
+            _TIFFmalloc(nOverviews * nMaxBlocks * sizeof(TIFFOvrJob));
+        psCascade->panChildren = (int *) _TIFFmalloc(nOverviews*sizeof(int));
+        psCascade->nChildren = 0;
+        psCascade->nThreads = nThreads;
+        psCascade->papArgs = papArgs;
+        if( psCascade->sRow.papabySrcBlocks == NULL
+            || psCascade->sRow.pasJobs == NULL
+            || psCascade->panChildren == NULL )
+        {
+            TIFFErrorExt( TIFFClientdata(hTIFF), "TIFFBuildOverviews",
+                          "Can't allocate memory for overview rows." );
+            bHaveBuffers = FALSE;
+        }
+        else
+        {
+            for( j = 0; j < nOverviews; j++ )
+            {
+                if( panParent[j] == i )
+                    psCascade->panChildren[psCascade->nChildren++] = j;
+            }
+            papoRawBIs[i]->pfnRowReady = TIFF_CascadeRow;
+            papoRawBIs[i]->pRowReadyData = psCascade;
+        }
+        papsCascades[i] = psCascade;
+    }
     
 /* -------------------------------------------------------------------- */
-/*      Loop over the source raster, applying data to the               */
-/*      destination raster.                                             */
+/*      Loop over the source raster, band by band, applying data to     */
+/*      the destination raster.                                         */
 /* -------------------------------------------------------------------- */
-    for( nSYOff = 0; nSYOff < (int) nYSize; nSYOff += nBlockYSize )
+    for( nBandXOff = 0; nBandXOff < nXSize && bHaveBuffers;
+         nBandXOff += nBandXSize )
     {
-        for( nSXOff = 0; nSXOff < (int) nXSize; nSXOff += nBlockXSize )
+        uint32  nBandXEnd = nBandXOff + nBandXSize;
+        int     nBandBlocks, iBlock;
+
+        if( nBandXEnd > nXSize )
+            nBandXEnd = nXSize;
+        nBandBlocks = (nBandXEnd - nBandXOff + nBlockXSize - 1) / nBlockXSize;
+
+        /*
+         * Point the caches at the overview blocks of the band, and
+         * collect the runs of source blocks falling into each column
+         * of overview blocks.
+         */
+        sRow.nBandXOff = nBandXOff;
+        sRow.nJobs = 0;
+        for( i = 0; i < nOverviews; i++ )
+        {
+            uint32  nOMult = panOvList[i];
+            uint32  nOBlockXSize = panOBlockXSize[i];
+
+            if( nBandXSize < nXSize )
+            {
+                int     iFirst = (nBandXOff / nOMult) / nOBlockXSize;
+                int     iEnd = papoRawBIs[i]->nBlocksPerRow;
+
+                if( nBandXEnd < nXSize )
+                    iEnd = (nBandXEnd / nOMult) / nOBlockXSize;
+                TIFFSetOvrCacheColumns( papoRawBIs[i], iFirst, iEnd - iFirst );
+            }
+
+            if( panParent[i] < 0 )
+                TIFF_AddBandJobs( &sRow, i, nOBlockXSize, nBandBlocks );
+        }
+
+        for( nSYOff = 0; nSYOff < nYSize; nSYOff += nBlockYSize )
         {
+            int     nIDs = 0, iPlane;
+
+            /*
+             * Read the row of source blocks of the band.
+             */
+            for( iBlock = 0; iBlock < nBandBlocks; iBlock++ )
+            {
+                for( iPlane = 0; iPlane < nSrcPlanes; iPlane++ )
+                {
+                    if( bTiled )
+                        panBlockIDs[nIDs++] = TIFFComputeTile( hTIFF,
+                            nBandXOff + iBlock * nBlockXSize, nSYOff,
+                            0, (tsample_t) iPlane );
+                    else
+                        panBlockIDs[nIDs++] = TIFFComputeStrip( hTIFF,
+                            nSYOff, (tsample_t) iPlane );
+                }
+            }
+
+            if( bTiled )
+                TIFFReadEncodedTilesParallel( hTIFF, panBlockIDs, nIDs,
+                                              (void **) papabySrcBlocks,
+                                              nSrcBlockBytes, nThreads );
+            else
+                TIFFReadEncodedStripsParallel( hTIFF, panBlockIDs, nIDs,
+                                               (void **) papabySrcBlocks,
+                                               nSrcBlockBytes, nThreads );
+
             /*
-             * Read and resample into the various overview images.
+             * Write out the overview rows that are complete, and
+             * resample into the various overview images.  Rows of
+             * the cascaded overviews are written as their parents'.
              */
-            
-            TIFF_ProcessFullResBlock( hTIFF, nPlanarConfig,
-                                      bSubsampled,nHorSubsampling,nVerSubsampling,
-                                      nOverviews, panOvList,
-                                      nBitsPerPixel, nSamples, papoRawBIs,
-                                      nSXOff, nSYOff, pabySrcTile,
-                                      nBlockXSize, nBlockYSize,
-                                      nSampleFormat, pszResampleMethod );
+            for( i = 0; i < nOverviews; i++ )
+            {
+                if( panParent[i] < 0 )
+                    TIFFPrepareOvrRow( papoRawBIs[i],
+                                       (nSYOff / panOvList[i])
+                                       / papoRawBIs[i]->nBlockYSize );
+            }
+
+            sRow.nSYOff = nSYOff;
+            TIFF_RunBandRow( &sRow, nThreads, papArgs );
+        }
+
+        /*
+         * Write the rest of the overview blocks of the band.
+         */
+        if( nBandXEnd < nXSize )
+        {
+            for( i = 0; i < nOverviews; i++ )
+                TIFFFlushOvrCache( papoRawBIs[panOrder[i]] );
         }
     }
 
-    _TIFFfree( pabySrcTile );
+    /*
+     * Write the rows left, parents first as they feed their children.
+     */
+    for( i = 0; i < nOverviews; i++ )
+        TIFFFlushOvrCache( papoRawBIs[panOrder[i]] );
+
+    if( sRow.hJobMutex != NULL )
+        toolMutexDestroy( sRow.hJobMutex );
+    if( sRow.pasJobs != NULL )
+        _TIFFfree( sRow.pasJobs );
+    if( papArgs != NULL )
+        _TIFFfree( papArgs );
+    if( panBlockIDs != NULL )
+        _TIFFfree( panBlockIDs );
+    if( papabySrcBlocks != NULL )
+        _TIFFfree( papabySrcBlocks );
+    if( pabySrcBlocks != NULL )
+        _TIFFfree( pabySrcBlocks );
+    _TIFFfree( panOBlockXSize );
 
 /* -------------------------------------------------------------------- */
 /*      Cleanup the rawblockedimage files.                              */
 /* -------------------------------------------------------------------- */
     for( i = 0; i < nOverviews; i++ )
     {
+        TIFFOvrCascade *psCascade = papsCascades ? papsCascades[i] : NULL;
+
         TIFFDestroyOvrCache( papoRawBIs[i] );
+        if( psCascade != NULL )
+        {
+            if( psCascade->sRow.papabySrcBlocks != NULL )
+                _TIFFfree( psCascade->sRow.papabySrcBlocks );
+            if( psCascade->sRow.pasJobs != NULL )
+                _TIFFfree( psCascade->sRow.pasJobs );
+            if( psCascade->panChildren != NULL )
+                _TIFFfree( psCascade->panChildren );
+            _TIFFfree( psCascade );
+        }
     }
 
+    if( papsCascades != NULL )
+        _TIFFfree( papsCascades );
+    _TIFFfree( panParent );
+    _TIFFfree( panOvMult );
+    _TIFFfree( panOrder );
+
     if( papoRawBIs != NULL )
         _TIFFfree( papoRawBIs );
 
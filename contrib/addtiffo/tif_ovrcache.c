@@ -40,6 +40,21 @@
 
 TIFFOvrCache *TIFFCreateOvrCache( TIFF *hTIFF, toff_t nDirOffset )
 
+{
+    return TIFFCreateOvrCacheEx( hTIFF, nDirOffset, 0 );
+}
+
+/************************************************************************/
+/*                        TIFFCreateOvrCacheEx()                        */
+/*                                                                      */
+/*      Create an overview cache whose rows hold at most                */
+/*      nMaxBlocksHeld blocks (0 for whole rows), starting with the     */
+/*      first columns of blocks.  See TIFFSetOvrCacheColumns().         */
+/************************************************************************/
+
+TIFFOvrCache *TIFFCreateOvrCacheEx( TIFF *hTIFF, toff_t nDirOffset,
+                                    int nMaxBlocksHeld )
+
 {
     TIFFOvrCache	*psCache;
     toff_t		nBaseDirOffset;
@@ -85,12 +100,21 @@ TIFFOvrCache *TIFFCreateOvrCache( TIFF *hTIFF, toff_t nDirOffset )
     psCache->nBlocksPerColumn = (psCache->nYSize + psCache->nBlockYSize - 1)
         		/ psCache->nBlockYSize;
 
+    if( nMaxBlocksHeld <= 0 || nMaxBlocksHeld > psCache->nBlocksPerRow )
+        nMaxBlocksHeld = psCache->nBlocksPerRow;
+    psCache->nBlockXOffset = 0;
+    psCache->nBlocksHeld = nMaxBlocksHeld;
+    psCache->nMaxBlocksHeld = nMaxBlocksHeld;
+    psCache->nThreads = 1;
+    psCache->pfnRowReady = NULL;
+    psCache->pRowReadyData = NULL;
+
     if (psCache->nPlanarConfig == PLANARCONFIG_SEPARATE)
         psCache->nBytesPerRow = psCache->nBytesPerBlock
-            * psCache->nBlocksPerRow * psCache->nSamples;
+            * psCache->nBlocksHeld * psCache->nSamples;
     else
         psCache->nBytesPerRow =
-            psCache->nBytesPerBlock * psCache->nBlocksPerRow;
+            psCache->nBytesPerBlock * psCache->nBlocksHeld;
 
 
 /* -------------------------------------------------------------------- */
@@ -138,7 +162,17 @@ static void TIFFWriteOvrRow( TIFFOvrCache * psCache )
     int		nRet, iTileX, iTileY = psCache->nBlockOffset;
     unsigned char *pabyData;
     toff_t	nBaseDirOffset;
-    uint32      RowsInStrip;
+    uint32      RowsInStrip, nBlocks;
+    uint32      *panBlockIDs;
+    void        **papabyData;
+    tmsize_t    *panSizes;
+
+/* -------------------------------------------------------------------- */
+/*      Let the row be used, as the source of a smaller overview,       */
+/*      while it is still in the byte order of the platform.            */
+/* -------------------------------------------------------------------- */
+    if( psCache->pfnRowReady != NULL )
+        psCache->pfnRowReady( psCache, iTileY, psCache->pRowReadyData );
 
 /* -------------------------------------------------------------------- */
 /*      If the output cache is multi-byte per sample, and the file      */
@@ -169,74 +203,80 @@ static void TIFFWriteOvrRow( TIFFOvrCache * psCache )
     assert( nRet == 1 );
 
 /* -------------------------------------------------------------------- */
-/*      Write blocks to TIFF file.                                      */
+/*      Write blocks to TIFF file.  They are compressed on              */
+/*      psCache->nThreads threads but written in column order, with     */
+/*      the samples of a column together.                               */
 /* -------------------------------------------------------------------- */
-	for( iTileX = 0; iTileX < psCache->nBlocksPerRow; iTileX++ )
-	{
-		int nTileID;
-
-		if (psCache->nPlanarConfig == PLANARCONFIG_SEPARATE)
-		{
-			int iSample;
-
-			for( iSample = 0; iSample < psCache->nSamples; iSample++ )
-			{
-				pabyData = TIFFGetOvrBlock( psCache, iTileX, iTileY, iSample );
-
-				if( psCache->bTiled )
-				{
-					nTileID = TIFFComputeTile( psCache->hTIFF,
-					    iTileX * psCache->nBlockXSize,
-					    iTileY * psCache->nBlockYSize,
-					    0, (tsample_t) iSample );
-					TIFFWriteEncodedTile( psCache->hTIFF, nTileID,
-					    pabyData,
-					    TIFFTileSize(psCache->hTIFF) );
-				}
-				else
-				{
-					nTileID = TIFFComputeStrip( psCache->hTIFF,
-					    iTileY * psCache->nBlockYSize,
-					    (tsample_t) iSample );
-					RowsInStrip=psCache->nBlockYSize;
-					if ((iTileY+1)*psCache->nBlockYSize>psCache->nYSize)
-						RowsInStrip=psCache->nYSize-iTileY*psCache->nBlockYSize;
-					TIFFWriteEncodedStrip( psCache->hTIFF, nTileID,
-					    pabyData,
-					    TIFFVStripSize(psCache->hTIFF,RowsInStrip) );
-				}
-			}
-
-		}
-		else
-		{
-			pabyData = TIFFGetOvrBlock( psCache, iTileX, iTileY, 0 );
-
-			if( psCache->bTiled )
-			{
-				nTileID = TIFFComputeTile( psCache->hTIFF,
-				    iTileX * psCache->nBlockXSize,
-				    iTileY * psCache->nBlockYSize,
-				    0, 0 );
-				TIFFWriteEncodedTile( psCache->hTIFF, nTileID,
-				    pabyData,
-				    TIFFTileSize(psCache->hTIFF) );
-			}
-			else
-			{
-				nTileID = TIFFComputeStrip( psCache->hTIFF,
-				    iTileY * psCache->nBlockYSize,
-				    0 );
-				RowsInStrip=psCache->nBlockYSize;
-				if ((iTileY+1)*psCache->nBlockYSize>psCache->nYSize)
-					RowsInStrip=psCache->nYSize-iTileY*psCache->nBlockYSize;
-				TIFFWriteEncodedStrip( psCache->hTIFF, nTileID,
-				    pabyData,
-				    TIFFVStripSize(psCache->hTIFF,RowsInStrip) );
-			}
-		}
-	}
-	/* TODO: add checks on error status return of TIFFWriteEncodedTile and TIFFWriteEncodedStrip */
+    nBlocks = psCache->nBlocksHeld;
+    if (psCache->nPlanarConfig == PLANARCONFIG_SEPARATE)
+        nBlocks *= psCache->nSamples;
+
+    panBlockIDs = (uint32 *) _TIFFmalloc(nBlocks * sizeof(uint32));
+    papabyData = (void **) _TIFFmalloc(nBlocks * sizeof(void *));
+    panSizes = (tmsize_t *) _TIFFmalloc(nBlocks * sizeof(tmsize_t));
+    if( panBlockIDs == NULL || papabyData == NULL || panSizes == NULL )
+    {
+        TIFFErrorExt( psCache->hTIFF->tif_clientdata,
+                      psCache->hTIFF->tif_name,
+                      "Can't allocate memory for overview block list." );
+    }
+    else
+    {
+        nBlocks = 0;
+        for( iTileX = psCache->nBlockXOffset;
+             iTileX < psCache->nBlockXOffset + psCache->nBlocksHeld;
+             iTileX++ )
+        {
+            int     iSample, nSamples = 1;
+
+            if (psCache->nPlanarConfig == PLANARCONFIG_SEPARATE)
+                nSamples = psCache->nSamples;
+
+            for( iSample = 0; iSample < nSamples; iSample++ )
+            {
+                papabyData[nBlocks] =
+                    TIFFGetOvrBlock( psCache, iTileX, iTileY, iSample );
+
+                if( psCache->bTiled )
+                {
+                    panBlockIDs[nBlocks] = TIFFComputeTile( psCache->hTIFF,
+                        iTileX * psCache->nBlockXSize,
+                        iTileY * psCache->nBlockYSize,
+                        0, (tsample_t) iSample );
+                    panSizes[nBlocks] = TIFFTileSize(psCache->hTIFF);
+                }
+                else
+                {
+                    panBlockIDs[nBlocks] = TIFFComputeStrip( psCache->hTIFF,
+                        iTileY * psCache->nBlockYSize,
+                        (tsample_t) iSample );
+                    RowsInStrip=psCache->nBlockYSize;
+                    if ((iTileY+1)*psCache->nBlockYSize>psCache->nYSize)
+                        RowsInStrip=psCache->nYSize-iTileY*psCache->nBlockYSize;
+                    panSizes[nBlocks] =
+                        TIFFVStripSize(psCache->hTIFF,RowsInStrip);
+                }
+                nBlocks++;
+            }
+        }
+
+        if( psCache->bTiled )
+            TIFFWriteEncodedTilesParallel( psCache->hTIFF, panBlockIDs,
+                                           nBlocks, papabyData, panSizes,
+                                           psCache->nThreads );
+        else
+            TIFFWriteEncodedStripsParallel( psCache->hTIFF, panBlockIDs,
+                                            nBlocks, papabyData, panSizes,
+                                            psCache->nThreads );
+        /* TODO: add checks on error status return of the block writes */
+    }
+
+    if( panBlockIDs != NULL )
+        _TIFFfree( panBlockIDs );
+    if( papabyData != NULL )
+        _TIFFfree( papabyData );
+    if( panSizes != NULL )
+        _TIFFfree( panSizes );
 
 /* -------------------------------------------------------------------- */
 /*      Rotate buffers.                                                 */
@@ -274,11 +314,14 @@ unsigned char *TIFFGetOvrBlock( TIFFOvrCache *psCache, int iTileX, int iTileY,
         TIFFWriteOvrRow( psCache );
 
     assert( iTileX >= 0 && iTileX < psCache->nBlocksPerRow );
+    assert( iTileX >= psCache->nBlockXOffset
+            && iTileX < psCache->nBlockXOffset + psCache->nBlocksHeld );
     assert( iTileY >= 0 && iTileY < psCache->nBlocksPerColumn );
     assert( iTileY >= psCache->nBlockOffset
             && iTileY < psCache->nBlockOffset+2 );
     assert( iSample >= 0 && iSample < psCache->nSamples );
 
+    iTileX -= psCache->nBlockXOffset;
     if (psCache->nPlanarConfig == PLANARCONFIG_SEPARATE)
         nRowOffset = ((((toff_t) iTileX * psCache->nSamples) + iSample)
                       * psCache->nBytesPerBlock);
@@ -306,12 +349,14 @@ unsigned char *TIFFGetOvrBlock_Subsampled( TIFFOvrCache *psCache,
         TIFFWriteOvrRow( psCache );
 
     assert( iTileX >= 0 && iTileX < psCache->nBlocksPerRow );
+    assert( iTileX >= psCache->nBlockXOffset
+            && iTileX < psCache->nBlockXOffset + psCache->nBlocksHeld );
     assert( iTileY >= 0 && iTileY < psCache->nBlocksPerColumn );
     assert( iTileY >= psCache->nBlockOffset
             && iTileY < psCache->nBlockOffset+2 );
     assert( psCache->nPlanarConfig != PLANARCONFIG_SEPARATE );
 
-    nRowOffset = iTileX * psCache->nBytesPerBlock;
+    nRowOffset = (iTileX - psCache->nBlockXOffset) * psCache->nBytesPerBlock;
 
     if( iTileY == psCache->nBlockOffset )
         return psCache->pabyRow1Blocks + nRowOffset;
@@ -320,14 +365,74 @@ unsigned char *TIFFGetOvrBlock_Subsampled( TIFFOvrCache *psCache,
 }
 
 /************************************************************************/
-/*                        TIFFDestroyOvrCache()                         */
+/*                         TIFFPrepareOvrRow()                          */
+/*                                                                      */
+/*      Write out the rows above row iTileY - 1, so that blocks of      */
+/*      row iTileY can be fetched without the cache doing any I/O,      */
+/*      as when several threads fetch blocks at once.                   */
 /************************************************************************/
 
-void TIFFDestroyOvrCache( TIFFOvrCache * psCache )
+void TIFFPrepareOvrRow( TIFFOvrCache *psCache, int iTileY )
+
+{
+    while( iTileY > psCache->nBlockOffset + 1 )
+        TIFFWriteOvrRow( psCache );
+}
+
+/************************************************************************/
+/*                         TIFFFlushOvrCache()                          */
+/*                                                                      */
+/*      Write out all the rows still to be written.                     */
+/************************************************************************/
+
+void TIFFFlushOvrCache( TIFFOvrCache *psCache )
 
 {
     while( psCache->nBlockOffset < psCache->nBlocksPerColumn )
         TIFFWriteOvrRow( psCache );
+}
+
+/************************************************************************/
+/*                       TIFFSetOvrCacheColumns()                       */
+/*                                                                      */
+/*      Make the cache hold the nBlocks columns of blocks starting at   */
+/*      iFirstBlockX, from the top of the image.  This lets an image    */
+/*      be processed in vertical bands with rows of nMaxBlocksHeld      */
+/*      blocks at most.  The rows of the previous columns must have     */
+/*      been written with TIFFFlushOvrCache().                          */
+/************************************************************************/
+
+void TIFFSetOvrCacheColumns( TIFFOvrCache *psCache,
+                             int iFirstBlockX, int nBlocks )
+
+{
+    assert( iFirstBlockX >= 0
+            && iFirstBlockX + nBlocks <= psCache->nBlocksPerRow );
+    assert( nBlocks > 0 && nBlocks <= psCache->nMaxBlocksHeld );
+
+    psCache->nBlockXOffset = iFirstBlockX;
+    psCache->nBlocksHeld = nBlocks;
+    if (psCache->nPlanarConfig == PLANARCONFIG_SEPARATE)
+        psCache->nBytesPerRow = psCache->nBytesPerBlock
+            * psCache->nBlocksHeld * psCache->nSamples;
+    else
+        psCache->nBytesPerRow =
+            psCache->nBytesPerBlock * psCache->nBlocksHeld;
+
+    _TIFFmemset( psCache->pabyRow1Blocks, 0, psCache->nBytesPerRow );
+    _TIFFmemset( psCache->pabyRow2Blocks, 0, psCache->nBytesPerRow );
+
+    psCache->nBlockOffset = 0;
+}
+
+/************************************************************************/
+/*                        TIFFDestroyOvrCache()                         */
+/************************************************************************/
+
+void TIFFDestroyOvrCache( TIFFOvrCache * psCache )
+
+{
+    TIFFFlushOvrCache( psCache );
 
     _TIFFfree( psCache->pabyRow1Blocks );
     _TIFFfree( psCache->pabyRow2Blocks );
@@ -41,7 +41,9 @@
 extern "C" {
 #endif
     
-typedef struct 
+typedef struct TIFFOvrCache_s TIFFOvrCache;
+
+struct TIFFOvrCache_s
 {
     uint32	nXSize;
     uint32	nYSize;
@@ -58,16 +60,30 @@ typedef struct
     int		nBlocksPerColumn;
 
     int	        nBlockOffset; /* what block is the first in papabyBlocks? */
+    int         nBlockXOffset; /* first block column held in the rows */
+    int         nBlocksHeld;  /* number of block columns held */
+    int         nMaxBlocksHeld; /* columns the rows were allocated for */
     unsigned char *pabyRow1Blocks;
     unsigned char *pabyRow2Blocks;
 
     toff_t	nDirOffset;
     TIFF	*hTIFF;
     int		bTiled;
+    int         nThreads;     /* threads encoding a row, 0 for one per CPU */
+
+    /* called with each row of blocks before it is written */
+    void        (*pfnRowReady)( TIFFOvrCache *, int iTileY, void * );
+    void        *pRowReadyData;
     
-} TIFFOvrCache;
+};
 
 TIFFOvrCache *TIFFCreateOvrCache( TIFF *hTIFF, toff_t nDirOffset );
+TIFFOvrCache *TIFFCreateOvrCacheEx( TIFF *hTIFF, toff_t nDirOffset,
+                                    int nMaxBlocksHeld );
+void           TIFFSetOvrCacheColumns( TIFFOvrCache *psCache,
+                                       int iFirstBlockX, int nBlocks );
+void           TIFFPrepareOvrRow( TIFFOvrCache *psCache, int iTileY );
+void           TIFFFlushOvrCache( TIFFOvrCache *psCache );
 unsigned char *TIFFGetOvrBlock( TIFFOvrCache *psCache, int iTileX, int iTileY,
                                 int iSample );
 unsigned char *TIFFGetOvrBlock_Subsampled( TIFFOvrCache *psCache, int iTileX, int iTileY );
@@ -75,6 +91,9 @@ void           TIFFDestroyOvrCache( TIFFOvrCache * );
 
 void TIFFBuildOverviews( TIFF *, int, int *, int, const char *,
                          int (*)(double,void*), void * );
+void TIFFBuildOverviewsParallel( TIFF *, int, int *, int, const char *,
+                                 int, tmsize_t, int,
+                                 int (*)(double,void*), void * );
 
 void TIFF_ProcessFullResBlock( TIFF *, int, int, int, int, int, int *, int, 
                                int, TIFFOvrCache **, uint32, uint32,
@@ -1,235 +1,249 @@
 // tiff stream interface class implementation
 
+#include <string.h>
+
 #include "tiffstream.h"
 
 const char* TiffStream::m_name = "TiffStream";
 
 TiffStream::TiffStream()
 {
-    m_tif = NULL;
+	m_tif = NULL;
+	m_inStream = NULL;
+	m_outStream = NULL;
+	reset();
+}
 
+TiffStream::~TiffStream()
+{
+	if(m_tif != NULL) TIFFClose(m_tif);
+}
 
-    m_inStream = NULL;
-	m_outStream = NULL;
-	m_ioStream = NULL;
+void
+TiffStream::reset()
+{
+	m_streamStart = 0;
+	m_buffer.clear();
+	m_data = NULL;
+	m_base = NULL;
+	m_size = 0;
+	m_pos = 0;
+	m_readOnly = true;
+}
 
-	m_streamLength = 0;
+TIFF*
+TiffStream::open(const char* mode)
+{
+	m_tif = TIFFClientOpen(m_name,
+			       mode,
+			       reinterpret_cast<thandle_t>(this),
+			       read,
+			       write,
+			       seek,
+			       close,
+			       size,
+			       map,
+			       unmap);
+	return m_tif;
+}
 
-	m_this = reinterpret_cast<thandle_t>(this);
-};
+// Copy the rest of the stream into m_buffer with a single read.
+bool
+TiffStream::loadStream(std::istream* str)
+{
+	m_streamStart = str->tellg();
+	if(m_streamStart == std::streampos(-1)) return false;
+	str->seekg(0, std::ios::end);
+	std::streampos end = str->tellg();
+	str->seekg(m_streamStart);
+	if(end == std::streampos(-1) || !str->good()) return false;
+
+	m_buffer.resize(static_cast<size_t>(end - m_streamStart));
+	if(!m_buffer.empty()) {
+		str->read(reinterpret_cast<char*>(&m_buffer[0]),
+			  static_cast<std::streamsize>(m_buffer.size()));
+		m_buffer.resize(static_cast<size_t>(str->gcount()));
+	}
+	str->clear();
+	m_data = &m_buffer;
+	m_base = m_buffer.empty() ? NULL : &m_buffer[0];
+	m_size = m_buffer.size();
+	return true;
+}
 
-TiffStream::~TiffStream()
-{
-    if(m_tif != NULL) TIFFClose(m_tif);
+// Copy the buffer to the output stream, if any, with a single write.
+bool
+TiffStream::flushStream()
+{
+	if(m_outStream == NULL || m_readOnly) return true;
+	m_outStream->seekp(m_streamStart);
+	if(m_size > 0)
+		m_outStream->write(reinterpret_cast<const char*>(m_base),
+				   static_cast<std::streamsize>(m_size));
+	m_outStream->flush();
+	return m_outStream->good();
 }
 
 TIFF*
-TiffStream::makeFileStream(istream* str)
+TiffStream::makeFileStream(std::istream* str)
 {
-    m_inStream = str;
+	reset();
+	m_inStream = str;
 	m_outStream = NULL;
-	m_ioStream = NULL;
-    m_streamLength = getSize(m_this);
-
-    m_tif =  TIFFClientOpen(m_name, 
-                           "r",
-						   m_this,
-						   read,
-						   write,
-						   seek,
-						   close,
-						   size,
-						   map,
-						   unmap);
-    return m_tif;
+	if(!loadStream(str)) return NULL;
+	return open("r");
 }
 
 TIFF*
-TiffStream::makeFileStream(ostream* str)
+TiffStream::makeFileStream(std::ostream* str)
 {
+	reset();
 	m_inStream = NULL;
-    m_outStream = str;
-	m_ioStream = NULL;
-	m_streamLength = getSize(m_this);
-
-	m_tif =  TIFFClientOpen(m_name, 
-                           "w",
-						   m_this,
-						   read,
-						   write,
-						   seek,
-						   close,
-						   size,
-						   map,
-						   unmap);
-    return m_tif;
+	m_outStream = str;
+	m_streamStart = str->tellp();
+	if(m_streamStart == std::streampos(-1)) return NULL;
+	m_data = &m_buffer;
+	m_readOnly = false;
+	return open("w");
 }
 
 TIFF*
-TiffStream::makeFileStream(iostream* str)
+TiffStream::makeFileStream(std::iostream* str)
+{
+	reset();
+	m_inStream = str;
+	m_outStream = str;
+	if(!loadStream(str)) return NULL;
+	m_readOnly = false;
+	return open("r+");
+}
+
+TIFF*
+TiffStream::makeMemoryStream(const std::vector<uint8>& data)
+{
+	reset();
+	m_inStream = NULL;
+	m_outStream = NULL;
+	m_base = data.empty() ? NULL : &data[0];
+	m_size = data.size();
+	return open("r");
+}
+
+TIFF*
+TiffStream::makeMemoryStream(std::vector<uint8>* data, const char* mode)
 {
+	reset();
 	m_inStream = NULL;
 	m_outStream = NULL;
-    m_ioStream = str;
-	m_streamLength = getSize(m_this);
-
-    m_tif =  TIFFClientOpen(m_name, 
-	                       "r+w",
-						   m_this,
-						   read,
-						   write,
-						   seek,
-						   close,
-						   size,
-						   map,
-						   unmap);
-    return m_tif;
+	m_data = data;
+	if(mode[0] == 'w') data->clear();
+	m_base = data->empty() ? NULL : &(*data)[0];
+	m_size = data->size();
+	m_readOnly = (mode[0] == 'r' && strchr(mode, '+') == NULL);
+	return open(mode);
 }
 
 tsize_t
 TiffStream::read(thandle_t fd, tdata_t buf, tsize_t size)
 {
-	istream* istr;
 	TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
-    if(ts->m_inStream != NULL) {
-	    istr = ts->m_inStream;
-	} else if(ts->m_ioStream != NULL) {
-	    istr = ts->m_ioStream;
-	}
-
-	int remain = ts->m_streamLength - ts->tell(fd);
-	int actual = remain < size ? remain : size;
-	istr->read(reinterpret_cast<char*>(buf), actual);
-    return istr->gcount();
+	if(size <= 0 || ts->m_pos >= ts->m_size) return 0;
+
+	toff_t remain = ts->m_size - ts->m_pos;
+	tsize_t actual = remain < static_cast<toff_t>(size) ?
+	    static_cast<tsize_t>(remain) : size;
+	memcpy(buf, ts->m_base + ts->m_pos, static_cast<size_t>(actual));
+	ts->m_pos += actual;
+	return actual;
 }
 
 tsize_t
 TiffStream::write(thandle_t fd, tdata_t buf, tsize_t size)
 {
 	TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
-	ostream* ostr;
-	if(ts->m_outStream != NULL) {
-	    ostr = ts->m_outStream;
-	} else if(ts->m_ioStream != NULL) {
-	    ostr = ts->m_ioStream;
+	if(ts->m_readOnly || ts->m_data == NULL || size < 0) return -1;
+	if(size == 0) return 0;
+
+	toff_t end = ts->m_pos + size;
+	if(end > ts->m_data->size()) {
+		// grow geometrically, libtiff writes in many small pieces
+		if(end > ts->m_data->capacity())
+			ts->m_data->reserve(static_cast<size_t>(
+			    end > 2 * ts->m_data->capacity() ?
+			    end : 2 * ts->m_data->capacity()));
+		ts->m_data->resize(static_cast<size_t>(end));
 	}
-
-	streampos start = ostr->tellp();
-	ostr->write(reinterpret_cast<const char*>(buf), size);
-	return ostr->tellp() - start;
+	memcpy(&(*ts->m_data)[static_cast<size_t>(ts->m_pos)], buf,
+	       static_cast<size_t>(size));
+	ts->m_base = &(*ts->m_data)[0];
+	ts->m_pos = end;
+	if(end > ts->m_size) ts->m_size = end;
+	return size;
 }
 
 toff_t
 TiffStream::seek(thandle_t fd, toff_t offset, int origin)
 {
-    TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
-    if(ts->seekInt(fd, offset, origin) == true) return offset;
-	else return -1;
+	TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
+	toff_t pos;
+
+	switch(origin) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = ts->m_pos + offset;
+		break;
+	case SEEK_END:
+		pos = ts->m_size + offset;
+		break;
+	default:
+		return static_cast<toff_t>(-1);
+	}
+	// later writes past the end fill the gap with zeros
+	ts->m_pos = pos;
+	return pos;
 }
 
 int
 TiffStream::close(thandle_t fd)
 {
-    TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
-	if(ts->m_inStream != NULL) {
-		ts->m_inStream = NULL;
-		return 0;
-	} else if(ts->m_outStream != NULL) {
-		ts->m_outStream = NULL;
-		return 0;
-	} else if(ts->m_ioStream != NULL) {
-		ts->m_ioStream = NULL;
-		return 0;
-	}
-    return -1;
+	TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
+	int ret = ts->flushStream() ? 0 : -1;
+
+	ts->m_inStream = NULL;
+	ts->m_outStream = NULL;
+	ts->m_buffer.clear();
+	ts->m_base = NULL;
+	ts->m_tif = NULL;
+	return ret;
 }
 
 toff_t
 TiffStream::size(thandle_t fd)
 {
-    TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
-    return ts->getSize(fd);
-}
-
-int 
-TiffStream::map(thandle_t fd, tdata_t* phase, toff_t* psize)
-{
-    return 0;
-}
-
-void
-TiffStream::unmap(thandle_t fd, tdata_t base, tsize_t size)
-{
+	TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
+	return ts->m_size;
 }
 
-unsigned int
-TiffStream::getSize(thandle_t fd)
+// The buffer can only be mapped while nothing writes to it; libtiff only
+// maps files opened read-only anyway.
+int
+TiffStream::map(thandle_t fd, tdata_t* pbase, toff_t* psize)
 {
-	if(!isOpen(fd)) return 0;
-
-    unsigned int pos = tell(fd);
-	seekInt(fd, 0, end);
-	unsigned int size = tell(fd);
-	seekInt(fd, pos, beg);
+	TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
+	if(!ts->m_readOnly || ts->m_base == NULL) return 0;
 
-	return size;
+	*pbase = const_cast<uint8*>(ts->m_base);
+	*psize = ts->m_size;
+	return 1;
 }
 
-unsigned int
-TiffStream::tell(thandle_t fd)
-{
-    TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
-    if(ts->m_inStream != NULL) {
-	    return ts->m_inStream->tellg();
-	} else if(ts->m_outStream != NULL) {
-	    return ts->m_outStream->tellp();
-	} else if(ts->m_ioStream != NULL) {
-		return ts->m_ioStream->tellg();
-	}
-	return 0;
-}
-
-bool
-TiffStream::seekInt(thandle_t fd, unsigned int offset, int origin)
+void
+TiffStream::unmap(thandle_t, tdata_t, toff_t)
 {
-	if(!isOpen(fd)) return false;
-
-	ios::seek_dir org;
-	switch(origin) {
-	case beg: 
-		org = ios::beg;
-		break;
-	case cur: 
-		org = ios::cur;
-		break;
-	case end: 
-		org = ios::end;
-		break;
-	}
-
-	TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
-    if(ts->m_inStream != NULL) {
-	    ts->m_inStream->seekg(offset, org);
-		return true;
-	} else if(ts->m_outStream != NULL) {
-	    ts->m_outStream->seekp(offset, org);
-		return true;
-	} else if(ts->m_ioStream != NULL) {
-	    ts->m_ioStream->seekg(offset, org);
-		ts->m_ioStream->seekp(offset, org);
-		return true;
-	}
-    return false;
 }
-
-bool
-TiffStream::isOpen(thandle_t fd)
-{
-	TiffStream* ts = reinterpret_cast<TiffStream*>(fd);
-	return (ts->m_inStream != NULL ||
-		   ts->m_outStream != NULL ||
-		   ts->m_ioStream != NULL);
-}/*
+/*
  * Local Variables:
  * mode: c++
  * c-basic-offset: 8
@@ -3,61 +3,83 @@
 #ifndef _TIFF_STREAM_H_
 #define _TIFF_STREAM_H_
 
-#include <iostream.h>
+#include <iostream>
+#include <vector>
 
 #include "tiffio.h"
 
+//
+// All i/o goes through one contiguous buffer: either a std::vector the
+// caller owns, used in place, or a copy of a C++ stream taken when the
+// handle is made.  Reads and seeks never reach the stream, and files
+// opened read-only are mapped, so libtiff reads strips and tiles straight
+// out of the buffer.  Data written to a stream is kept in the buffer and
+// copied to the stream by TIFFClose().
+//
 class TiffStream {
 
 public:
-    // ctor/dtor
-    TiffStream();
+	// ctor/dtor
+	TiffStream();
 	~TiffStream();
 
 public:
-    enum SeekDir {
-	    beg,
+	enum SeekDir {
+		beg,
 		cur,
-		end,
-    };
+		end
+	};
 
 public:
-    // factory methods
-    TIFF* makeFileStream(iostream* str);
-	TIFF* makeFileStream(istream* str);
-	TIFF* makeFileStream(ostream* str);
+	// factory methods for streams, read from their current position
+	TIFF* makeFileStream(std::iostream* str);
+	TIFF* makeFileStream(std::istream* str);
+	TIFF* makeFileStream(std::ostream* str);
+
+	// factory methods for memory, used without copying; a vector given
+	// for writing grows as needed and must not be touched until the
+	// handle is closed
+	TIFF* makeMemoryStream(const std::vector<uint8>& data);
+	TIFF* makeMemoryStream(std::vector<uint8>* data, const char* mode);
 
 public:
-    // tiff client methods
+	// tiff client methods
 	static tsize_t read(thandle_t fd, tdata_t buf, tsize_t size);
 	static tsize_t write(thandle_t fd, tdata_t buf, tsize_t size);
 	static toff_t seek(thandle_t fd, toff_t offset, int origin);
 	static toff_t size(thandle_t fd);
 	static int close(thandle_t fd);
-	static int map(thandle_t fd, tdata_t* phase, toff_t* psize);
-	static void unmap(thandle_t fd, tdata_t base, tsize_t size);
+	static int map(thandle_t fd, tdata_t* pbase, toff_t* psize);
+	static void unmap(thandle_t fd, tdata_t base, toff_t size);
 
 public:
-    // query method
+	// query methods
 	TIFF* getTiffHandle() const { return m_tif; }
-	unsigned int getStreamLength() { return m_streamLength; }
+	toff_t getStreamLength() const { return m_size; }
 
 private:
 	// internal methods
-    unsigned int getSize(thandle_t fd);
-	unsigned int tell(thandle_t fd);
-	bool seekInt(thandle_t fd, unsigned int offset, int origin);
-	bool isOpen(thandle_t fd);
+	TIFF* open(const char* mode);
+	bool loadStream(std::istream* str);
+	bool flushStream();
+	void reset();
 
 private:
-	thandle_t m_this;
 	TIFF* m_tif;
 	static const char* m_name;
-	istream* m_inStream;
-	ostream* m_outStream;
-	iostream* m_ioStream;
-	int m_streamLength;
-	
+	std::istream* m_inStream;
+	std::ostream* m_outStream;
+	std::streampos m_streamStart;	// stream position of offset 0
+	std::vector<uint8> m_buffer;	// copy of a stream
+	std::vector<uint8>* m_data;	// buffer written to, or NULL
+	const uint8* m_base;		// buffer read from
+	toff_t m_size;			// # bytes of data
+	toff_t m_pos;			// current offset
+	bool m_readOnly;
+
+	// not copyable, libtiff keeps a pointer to the object
+	TiffStream(const TiffStream&);
+	TiffStream& operator=(const TiffStream&);
 };
 
 #endif // _TIFF_STREAM_H_
@@ -31,13 +31,16 @@
 #include "tif_predict.h"
 #include <math.h>
 
+#define TIFF_SIZE_T_MAX ((size_t) ~ ((size_t)0))
+#define TIFF_TMSIZE_T_MAX (tmsize_t)(TIFF_SIZE_T_MAX >> 1)
+
 uint32
 _TIFFMultiply32(TIFF* tif, uint32 first, uint32 second, const char* where)
 {
 	uint32 bytes = first * second;
 
 	if (second && bytes / second != first) {
-		TIFFErrorExt(tif->tif_clientdata, where, "Integer overflow in %s", where);
+		TIFFErrorExtR(tif, where, "Integer overflow in %s", where);
 		bytes = 0;
 	}
 
@@ -50,7 +53,7 @@ _TIFFMultiply64(TIFF* tif, uint64 first, uint64 second, const char* where)
 	uint64 bytes = first * second;
 
 	if (second && bytes / second != first) {
-		TIFFErrorExt(tif->tif_clientdata, where, "Integer overflow in %s", where);
+		TIFFErrorExtR(tif, where, "Integer overflow in %s", where);
 		bytes = 0;
 	}
 
@@ -58,7 +61,7 @@ _TIFFMultiply64(TIFF* tif, uint64 first, uint64 second, const char* where)
 }
 
 void*
-_TIFFCheckRealloc(TIFF* tif, void* buffer,
+(_TIFFCheckRealloc)(TIFF* tif, void* buffer,
 		  tmsize_t nmemb, tmsize_t elem_size, const char* what)
 {
 	void* cp = NULL;
@@ -68,10 +71,10 @@ _TIFFCheckRealloc(TIFF* tif, void* buffer,
 	 * XXX: Check for integer overflow.
 	 */
 	if (nmemb && elem_size && bytes / elem_size == nmemb)
-		cp = _TIFFrealloc(buffer, bytes);
+		cp = (_TIFFreallocExt)(tif, buffer, bytes);
 
 	if (cp == NULL) {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			     "Failed to allocate memory for %s "
 			     "(%ld elements of %ld bytes each)",
 			     what,(long) nmemb, (long) elem_size);
@@ -80,15 +83,84 @@ _TIFFCheckRealloc(TIFF* tif, void* buffer,
 	return cp;
 }
 
+/*
+ * Return the scratch buffer of tif for slot, making sure it holds at
+ * least size bytes.  The buffers only grow, so that decoding or encoding
+ * a sequence of chunks allocates them once; their contents are not kept
+ * when they grow.  They are freed with the handle.
+ */
+void*
+_TIFFGetScratch(TIFF* tif, int slot, tmsize_t size)
+{
+	static const char module[] = "_TIFFGetScratch";
+
+	assert(slot >= 0 && slot < TIFF_SCRATCH_SLOTS);
+	if (size > tif->tif_scratchsize[slot]) {
+		_TIFFfreeExt(tif, tif->tif_scratch[slot]);
+		tif->tif_scratchsize[slot] = 0;
+		tif->tif_scratch[slot] = _TIFFmallocExt(tif, size);
+		if (tif->tif_scratch[slot] == NULL) {
+			TIFFErrorExtR(tif, module,
+			    "Out of memory allocating " TIFF_SSIZE_FORMAT
+			    " byte work buffer", size);
+			return (NULL);
+		}
+		tif->tif_scratchsize[slot] = size;
+	}
+	return (tif->tif_scratch[slot]);
+}
+
+/*
+ * Like _TIFFGetScratch(), but keep the contents of the buffer, which
+ * grows at least by doubling so that it can be filled incrementally.
+ */
+void*
+_TIFFGrowScratch(TIFF* tif, int slot, tmsize_t size)
+{
+	static const char module[] = "_TIFFGrowScratch";
+	tmsize_t cursize;
+	void* buf;
+
+	assert(slot >= 0 && slot < TIFF_SCRATCH_SLOTS);
+	cursize = tif->tif_scratchsize[slot];
+	if (size <= cursize)
+		return (tif->tif_scratch[slot]);
+	if (cursize <= TIFF_TMSIZE_T_MAX / 2 && size < 2 * cursize)
+		size = 2 * cursize;
+	buf = _TIFFreallocExt(tif, tif->tif_scratch[slot], size);
+	if (buf == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "Out of memory allocating " TIFF_SSIZE_FORMAT
+		    " byte work buffer", size);
+		return (NULL);
+	}
+	tif->tif_scratch[slot] = buf;
+	tif->tif_scratchsize[slot] = size;
+	return (buf);
+}
+
+void
+_TIFFFreeScratch(TIFF* tif)
+{
+	int slot;
+
+	for (slot = 0; slot < TIFF_SCRATCH_SLOTS; slot++) {
+		_TIFFfreeExt(tif, tif->tif_scratch[slot]);
+		tif->tif_scratch[slot] = NULL;
+		tif->tif_scratchsize[slot] = 0;
+	}
+}
+
 void*
-_TIFFCheckMalloc(TIFF* tif, tmsize_t nmemb, tmsize_t elem_size, const char* what)
+(_TIFFCheckMalloc)(TIFF* tif, tmsize_t nmemb, tmsize_t elem_size, const char* what)
 {
-	return _TIFFCheckRealloc(tif, NULL, nmemb, elem_size, what);  
+	return (_TIFFCheckRealloc)(tif, NULL, nmemb, elem_size, what);  
 }
 
 static int
-TIFFDefaultTransferFunction(TIFFDirectory* td)
+TIFFDefaultTransferFunction(TIFF* tif)
 {
+	TIFFDirectory* td = &tif->tif_dir;
 	uint16 **tf = td->td_transferfunction;
 	tmsize_t i, n, nbytes;
 
@@ -98,7 +170,7 @@ TIFFDefaultTransferFunction(TIFFDirectory* td)
 
 	n = ((tmsize_t)1)<<td->td_bitspersample;
 	nbytes = n * sizeof (uint16);
-        tf[0] = (uint16 *)_TIFFmalloc(nbytes);
+        tf[0] = (uint16 *)_TIFFmallocExt(tif, nbytes);
 	if (tf[0] == NULL)
 		return 0;
 	tf[0][0] = 0;
@@ -108,11 +180,11 @@ TIFFDefaultTransferFunction(TIFFDirectory* td)
 	}
 
 	if (td->td_samplesperpixel - td->td_extrasamples > 1) {
-                tf[1] = (uint16 *)_TIFFmalloc(nbytes);
+                tf[1] = (uint16 *)_TIFFmallocExt(tif, nbytes);
 		if(tf[1] == NULL)
 			goto bad;
 		_TIFFmemcpy(tf[1], tf[0], nbytes);
-                tf[2] = (uint16 *)_TIFFmalloc(nbytes);
+                tf[2] = (uint16 *)_TIFFmallocExt(tif, nbytes);
 		if (tf[2] == NULL)
 			goto bad;
 		_TIFFmemcpy(tf[2], tf[0], nbytes);
@@ -121,21 +193,22 @@ TIFFDefaultTransferFunction(TIFFDirectory* td)
 
 bad:
 	if (tf[0])
-		_TIFFfree(tf[0]);
+		_TIFFfreeExt(tif, tf[0]);
 	if (tf[1])
-		_TIFFfree(tf[1]);
+		_TIFFfreeExt(tif, tf[1]);
 	if (tf[2])
-		_TIFFfree(tf[2]);
+		_TIFFfreeExt(tif, tf[2]);
 	tf[0] = tf[1] = tf[2] = 0;
 	return 0;
 }
 
 static int
-TIFFDefaultRefBlackWhite(TIFFDirectory* td)
+TIFFDefaultRefBlackWhite(TIFF* tif)
 {
+	TIFFDirectory* td = &tif->tif_dir;
 	int i;
 
-        td->td_refblackwhite = (float *)_TIFFmalloc(6*sizeof (float));
+        td->td_refblackwhite = (float *)_TIFFmallocExt(tif, 6*sizeof (float));
 	if (td->td_refblackwhite == NULL)
 		return 0;
         if (td->td_photometric == PHOTOMETRIC_YCBCR) {
@@ -214,7 +287,7 @@ TIFFVGetFieldDefaulted(TIFF* tif, uint32 tag, va_list ap)
         TIFFPredictorState* sp = (TIFFPredictorState*) tif->tif_data;
         if( sp == NULL )
         {
-            TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+            TIFFErrorExtR(tif, tif->tif_name,
                          "Cannot get \"Predictor\" tag as plugin is not configured");
             *va_arg(ap, uint16*) = 0;
             return 0;
@@ -281,8 +354,8 @@ TIFFVGetFieldDefaulted(TIFF* tif, uint32 tag, va_list ap)
 		}
 	case TIFFTAG_TRANSFERFUNCTION:
 		if (!td->td_transferfunction[0] &&
-		    !TIFFDefaultTransferFunction(td)) {
-			TIFFErrorExt(tif->tif_clientdata, tif->tif_name, "No space for \"TransferFunction\" tag");
+		    !TIFFDefaultTransferFunction(tif)) {
+			TIFFErrorExtR(tif, tif->tif_name, "No space for \"TransferFunction\" tag");
 			return (0);
 		}
 		*va_arg(ap, uint16 **) = td->td_transferfunction[0];
@@ -292,7 +365,7 @@ TIFFVGetFieldDefaulted(TIFF* tif, uint32 tag, va_list ap)
 		}
 		return (1);
 	case TIFFTAG_REFERENCEBLACKWHITE:
-		if (!td->td_refblackwhite && !TIFFDefaultRefBlackWhite(td))
+		if (!td->td_refblackwhite && !TIFFDefaultRefBlackWhite(tif))
 			return (0);
 		*va_arg(ap, float **) = td->td_refblackwhite;
 		return (1);
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library.
+ *
+ * Block cache for files read through client procedures.
+ *
+ * When enabled with TIFFOpenOptionsSetBlockCache(), TIFFReadFile() and
+ * TIFFSeekFile() on a read-only handle go through a cache of aligned
+ * blocks of the file, replaced in least recently used order.  This is
+ * meant for I/O methods where every read is a costly round trip, such
+ * as HTTP range requests: the many small reads done while parsing
+ * directories then cost one request per block, and the blocks needed
+ * by one read are fetched together.  Reads of a block or more that
+ * start outside the cache go straight to the read method.  Seeking
+ * only moves a position kept here; the seek method is called before
+ * every read that reaches the client.
+ */
+#include "tiffiop.h"
+
+#define	BLOCKCACHE_DEFAULT_SIZE	(16 * 1024)
+#define	BLOCKCACHE_MAX_BLOCKS	(1U << 20)
+#define	BLOCKCACHE_NONE		((uint32) -1)
+
+typedef struct {
+	uint64		block;		/* block number in the file */
+	uint8*		data;
+	tmsize_t	len;		/* valid bytes, less at end of file */
+	uint32		hnext;		/* next entry in hash chain */
+	uint32		prev;		/* LRU list links */
+	uint32		next;
+} TIFFCacheBlock;
+
+struct _TIFFBlockCache {
+	tmsize_t	blocksize;
+	uint32		nblocks;	/* capacity */
+	uint32		used;		/* entries handed out so far */
+	TIFFCacheBlock*	blocks;
+	uint32*		hash;		/* chain heads, hashmask + 1 of them */
+	uint32		hashmask;
+	uint32		head;		/* most recently used */
+	uint32		tail;		/* least recently used */
+	uint64		pos;		/* file position seen by libtiff */
+	uint64		size;		/* file size, once known */
+	int		sizevalid;
+};
+
+#define	BLOCKHASH(bc, b)	((uint32)((b) ^ ((b) >> 16)) & (bc)->hashmask)
+
+static void
+_TIFFBlockCacheUnlink(TIFFBlockCache* bc, uint32 i)
+{
+	TIFFCacheBlock* e = &bc->blocks[i];
+
+	if (e->prev != BLOCKCACHE_NONE)
+		bc->blocks[e->prev].next = e->next;
+	else
+		bc->head = e->next;
+	if (e->next != BLOCKCACHE_NONE)
+		bc->blocks[e->next].prev = e->prev;
+	else
+		bc->tail = e->prev;
+}
+
+static void
+_TIFFBlockCachePush(TIFFBlockCache* bc, uint32 i)
+{
+	TIFFCacheBlock* e = &bc->blocks[i];
+
+	e->prev = BLOCKCACHE_NONE;
+	e->next = bc->head;
+	if (bc->head != BLOCKCACHE_NONE)
+		bc->blocks[bc->head].prev = i;
+	else
+		bc->tail = i;
+	bc->head = i;
+}
+
+/*
+ * Return the entry holding the given block, made the most recently
+ * used one, or BLOCKCACHE_NONE.
+ */
+static uint32
+_TIFFBlockCacheFind(TIFFBlockCache* bc, uint64 block)
+{
+	uint32 i;
+
+	for (i = bc->hash[BLOCKHASH(bc, block)]; i != BLOCKCACHE_NONE;
+	    i = bc->blocks[i].hnext) {
+		if (bc->blocks[i].block == block) {
+			if (bc->head != i) {
+				_TIFFBlockCacheUnlink(bc, i);
+				_TIFFBlockCachePush(bc, i);
+			}
+			return (i);
+		}
+	}
+	return (BLOCKCACHE_NONE);
+}
+
+static void
+_TIFFBlockCacheUnhash(TIFFBlockCache* bc, uint32 i)
+{
+	uint32* link;
+
+	for (link = &bc->hash[BLOCKHASH(bc, bc->blocks[i].block)]; *link != i;
+	    link = &bc->blocks[*link].hnext)
+		;
+	*link = bc->blocks[i].hnext;
+}
+
+static void
+_TIFFBlockCacheHash(TIFFBlockCache* bc, uint32 i, uint64 block)
+{
+	bc->blocks[i].block = block;
+	bc->blocks[i].hnext = bc->hash[BLOCKHASH(bc, block)];
+	bc->hash[BLOCKHASH(bc, block)] = i;
+}
+
+/*
+ * Return an entry to hold the given block, taking a new one while the
+ * cache is not full and the least recently used one afterwards.
+ */
+static uint32
+_TIFFBlockCacheTake(TIFF* tif, TIFFBlockCache* bc, uint64 block)
+{
+	TIFFCacheBlock* e;
+	uint32 i;
+
+	if (bc->used < bc->nblocks) {
+		i = bc->used;
+		e = &bc->blocks[i];
+		e->data = (uint8*) _TIFFmallocExt(tif, bc->blocksize);
+		if (e->data == NULL)
+			return (BLOCKCACHE_NONE);
+		bc->used++;
+	} else {
+		i = bc->tail;
+		e = &bc->blocks[i];
+		_TIFFBlockCacheUnhash(bc, i);
+		_TIFFBlockCacheUnlink(bc, i);
+	}
+	e->len = 0;
+	_TIFFBlockCacheHash(bc, i, block);
+	_TIFFBlockCachePush(bc, i);
+	return (i);
+}
+
+/*
+ * Read count blocks starting with the given one in a single request
+ * and enter those that exist in the cache.  Returns 0 on error.
+ */
+static int
+_TIFFBlockCacheFetch(TIFF* tif, uint64 block, uint32 count)
+{
+	static const char module[] = "_TIFFBlockCacheFetch";
+	TIFFBlockCache* bc = tif->tif_blockcache;
+	uint64 off = block * (uint64) bc->blocksize;
+	uint64 want64 = (uint64) count * (uint64) bc->blocksize;
+	tmsize_t want = (tmsize_t) want64;
+	tmsize_t got, len;
+	uint8* buf;
+	uint32 i, n;
+
+	if (want < 0 || (uint64) want != want64) {
+		TIFFErrorExtR(tif, module, "Integer overflow");
+		return (0);
+	}
+	if (count == 1) {
+		i = _TIFFBlockCacheTake(tif, bc, block);
+		if (i == BLOCKCACHE_NONE) {
+			TIFFErrorExtR(tif, module,
+			    "No space for cache block");
+			return (0);
+		}
+		buf = bc->blocks[i].data;
+	} else {
+		buf = (uint8*) _TIFFmallocExt(tif, want);
+		if (buf == NULL) {
+			TIFFErrorExtR(tif, module,
+			    "No space for cache read buffer");
+			return (0);
+		}
+	}
+	if (_TIFFCallSeekProc(tif, off, SEEK_SET) != off)
+		got = -1;
+	else
+		got = _TIFFCallReadProc(tif, buf, want);
+	if (count == 1) {
+		if (got < 0) {
+			/* forget the block, so that a later read retries */
+			_TIFFBlockCacheUnhash(bc, i);
+			_TIFFBlockCacheHash(bc, i, (uint64) -1);
+			_TIFFBlockCacheUnlink(bc, i);
+			bc->blocks[i].prev = bc->tail;
+			bc->blocks[i].next = BLOCKCACHE_NONE;
+			if (bc->tail != BLOCKCACHE_NONE)
+				bc->blocks[bc->tail].next = i;
+			else
+				bc->head = i;
+			bc->tail = i;
+			return (0);
+		}
+		/* an empty block past the end of the file is kept */
+		bc->blocks[i].len = got;
+		return (1);
+	}
+	for (n = 0; got > 0 && (tmsize_t) n * bc->blocksize < got; n++) {
+		len = got - (tmsize_t) n * bc->blocksize;
+		if (len > bc->blocksize)
+			len = bc->blocksize;
+		i = _TIFFBlockCacheTake(tif, bc, block + n);
+		if (i == BLOCKCACHE_NONE)
+			break;
+		_TIFFmemcpy(bc->blocks[i].data,
+		    buf + (tmsize_t) n * bc->blocksize, len);
+		bc->blocks[i].len = len;
+	}
+	_TIFFfreeExt(tif, buf);
+	return (got >= 0);
+}
+
+tmsize_t
+_TIFFBlockCacheRead(TIFF* tif, void* buf, tmsize_t size)
+{
+	TIFFBlockCache* bc = tif->tif_blockcache;
+	uint8* out = (uint8*) buf;
+	tmsize_t done = 0;
+
+	while (size > 0) {
+		uint64 block = bc->pos / (uint64) bc->blocksize;
+		tmsize_t skip = (tmsize_t)(bc->pos % (uint64) bc->blocksize);
+		TIFFCacheBlock* e;
+		tmsize_t n;
+		uint32 i;
+
+		i = _TIFFBlockCacheFind(bc, block);
+		if (i == BLOCKCACHE_NONE && size >= bc->blocksize) {
+			/* large uncached reads go to the client directly */
+			if (_TIFFCallSeekProc(tif, bc->pos, SEEK_SET) != bc->pos)
+				return (done > 0 ? done : (tmsize_t) -1);
+			n = _TIFFCallReadProc(tif, out, size);
+			if (n < 0)
+				return (done > 0 ? done : (tmsize_t) -1);
+			bc->pos += n;
+			return (done + n);
+		}
+		if (i == BLOCKCACHE_NONE) {
+			/* fetch the missing blocks of the read at once */
+			uint64 last = (bc->pos + size - 1) / (uint64) bc->blocksize;
+			uint32 count = 1;
+
+			while (block + count <= last && count < bc->nblocks &&
+			    _TIFFBlockCacheFind(bc, block + count) == BLOCKCACHE_NONE)
+				count++;
+			if (!_TIFFBlockCacheFetch(tif, block, count))
+				return (done > 0 ? done : (tmsize_t) -1);
+			i = _TIFFBlockCacheFind(bc, block);
+			if (i == BLOCKCACHE_NONE)
+				break;
+		}
+		e = &bc->blocks[i];
+		if (skip >= e->len)
+			break;
+		n = e->len - skip;
+		if (n > size)
+			n = size;
+		_TIFFmemcpy(out, e->data + skip, n);
+		out += n;
+		size -= n;
+		done += n;
+		bc->pos += n;
+		if (skip + n == e->len && e->len < bc->blocksize)
+			break;		/* end of file */
+	}
+	return (done);
+}
+
+uint64
+_TIFFBlockCacheSeek(TIFF* tif, uint64 off, int whence)
+{
+	TIFFBlockCache* bc = tif->tif_blockcache;
+
+	switch (whence) {
+	case SEEK_SET:
+		bc->pos = off;
+		break;
+	case SEEK_CUR:
+		bc->pos += off;
+		break;
+	case SEEK_END:
+		if (!bc->sizevalid) {
+			bc->size = _TIFFCallSeekProc(tif, 0, SEEK_END);
+			if (bc->size == (uint64) -1)
+				return (bc->size);
+			bc->sizevalid = 1;
+		}
+		bc->pos = bc->size + off;
+		break;
+	default:
+		return ((uint64) -1);
+	}
+	return (bc->pos);
+}
+
+/*
+ * Set up a cache of nblocks blocks of blocksize bytes, and fill it
+ * with the first header bytes of the file in one request.
+ */
+int
+_TIFFBlockCacheInit(TIFF* tif, tmsize_t blocksize, uint32 nblocks,
+    tmsize_t header)
+{
+	static const char module[] = "_TIFFBlockCacheInit";
+	TIFFBlockCache* bc;
+	uint32 nhash, i;
+
+	if (blocksize <= 0)
+		blocksize = BLOCKCACHE_DEFAULT_SIZE;
+	if (nblocks > BLOCKCACHE_MAX_BLOCKS)
+		nblocks = BLOCKCACHE_MAX_BLOCKS;
+	for (nhash = 1; nhash < nblocks; nhash <<= 1)
+		;
+	bc = (TIFFBlockCache*) _TIFFmallocExt(tif, sizeof(TIFFBlockCache));
+	if (bc == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for block cache");
+		return (0);
+	}
+	_TIFFmemset(bc, 0, sizeof(TIFFBlockCache));
+	bc->blocksize = blocksize;
+	bc->nblocks = nblocks;
+	bc->hashmask = nhash - 1;
+	bc->head = bc->tail = BLOCKCACHE_NONE;
+	bc->blocks = (TIFFCacheBlock*) _TIFFCheckMalloc(tif, nblocks,
+	    sizeof(TIFFCacheBlock), "for block cache");
+	bc->hash = (uint32*) _TIFFCheckMalloc(tif, nhash, sizeof(uint32),
+	    "for block cache");
+	tif->tif_blockcache = bc;
+	if (bc->blocks == NULL || bc->hash == NULL) {
+		_TIFFFreeBlockCache(tif);
+		return (0);
+	}
+	for (i = 0; i < nhash; i++)
+		bc->hash[i] = BLOCKCACHE_NONE;
+
+	if (header > 0) {
+		tmsize_t count = header / blocksize + (header % blocksize != 0);
+
+		if (count > (tmsize_t) nblocks)
+			count = nblocks;
+		/* failures are reported by the read of the header */
+		(void) _TIFFBlockCacheFetch(tif, 0, (uint32) count);
+	}
+	return (1);
+}
+
+/*
+ * Give the options used to open tif the same block cache geometry,
+ * without the header prefetch.
+ */
+void
+_TIFFBlockCacheOptions(TIFF* tif, TIFFOpenOptions* opts)
+{
+	TIFFBlockCache* bc = tif->tif_blockcache;
+
+	opts->cacheblocksize = bc ? bc->blocksize : 0;
+	opts->cacheblocks = bc ? bc->nblocks : 0;
+	opts->headerprefetch = 0;
+}
+
+void
+_TIFFFreeBlockCache(TIFF* tif)
+{
+	TIFFBlockCache* bc = tif->tif_blockcache;
+	uint32 i;
+
+	if (bc == NULL)
+		return;
+	if (bc->blocks) {
+		for (i = 0; i < bc->used; i++)
+			_TIFFfreeExt(tif, bc->blocks[i].data);
+		_TIFFfreeExt(tif, bc->blocks);
+	}
+	if (bc->hash)
+		_TIFFfreeExt(tif, bc->hash);
+	_TIFFfreeExt(tif, bc);
+	tif->tif_blockcache = NULL;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Cancellation of long reading and writing operations.
+ *
+ * TIFFCancel(), which may be called from any thread, and an expired
+ * deadline make the routines that decode or encode strips and tiles
+ * fail at their next check: on entry, between the row batches of a
+ * predicted chunk, between the output blocks of the Deflate decoder
+ * and between the bands of TIFFRGBAImageGet().  The helper handles of
+ * the parallel routines check the state of the handle they work for.
+ * The state sticks until TIFFResetCancel() so that a caller can tell a
+ * cancelled operation from a failed one with TIFFGetCancelState().
+ */
+#include "tiffiop.h"
+
+void
+TIFFCancel(TIFF* tif)
+{
+	tif->tif_cancel = TIFF_CANCEL_REQUESTED;
+}
+
+/*
+ * Cancel the operations of tif still running seconds from now; 0 or
+ * less removes the deadline.
+ */
+void
+TIFFSetDeadline(TIFF* tif, double seconds)
+{
+	if (seconds <= 0)
+		tif->tif_deadline = 0;
+	else if (seconds >= 1e9)
+		tif->tif_deadline = ~(uint64) 0;
+	else
+		tif->tif_deadline = _TIFFStatsClock() + (uint64) (seconds * 1e9);
+}
+
+void
+TIFFResetCancel(TIFF* tif)
+{
+	tif->tif_cancel = TIFF_CANCEL_NONE;
+	tif->tif_deadline = 0;
+}
+
+int
+TIFFGetCancelState(TIFF* tif)
+{
+	if (tif->tif_cancel == TIFF_CANCEL_NONE && tif->tif_deadline != 0 &&
+	    _TIFFStatsClock() >= tif->tif_deadline)
+		tif->tif_cancel = TIFF_CANCEL_DEADLINE;
+	return (tif->tif_cancel);
+}
+
+/*
+ * Return non-zero, after reporting it, if the operation in progress on
+ * tif is to stop.
+ */
+int
+_TIFFCheckCancel(TIFF* tif, const char* module)
+{
+	TIFF* owner = tif->tif_cancelowner ? tif->tif_cancelowner : tif;
+
+	if (owner->tif_cancel == TIFF_CANCEL_NONE && owner->tif_deadline == 0)
+		return (0);
+	switch (TIFFGetCancelState(owner)) {
+	case TIFF_CANCEL_REQUESTED:
+		TIFFErrorExtR(tif, module, "Operation cancelled");
+		return (1);
+	case TIFF_CANCEL_DEADLINE:
+		TIFFErrorExtR(tif, module, "Deadline exceeded");
+		return (1);
+	default:
+		return (0);
+	}
+}
+
+/*
+ * Make a helper handle, such as a decoding worker, stop when the
+ * operations of tif are cancelled.
+ */
+void
+_TIFFCancelHelper(TIFF* tif, TIFF* helper)
+{
+	helper->tif_cancelowner = tif->tif_cancelowner ? tif->tif_cancelowner : tif;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Decoder checkpoints for random scanline access.
+ *
+ * When enabled with TIFFSetScanlineCheckpoints(), the decoder state of
+ * the strip being read with TIFFReadScanline() is saved every few rows,
+ * by the codec's tif_savestate method.  TIFFSeek() then resumes decoding
+ * at the last checkpoint before the wanted row instead of at the start
+ * of the strip, and skips the remaining rows by decoding them.  Only the
+ * checkpoints of one strip are kept.
+ */
+#include "tiffiop.h"
+
+#define NOSTRIP ((uint32)(-1))       /* undefined state */
+
+typedef struct {
+	uint64		rawoff;		/* strip offset of the next raw byte */
+	void*		state;		/* codec snapshot, NULL if not taken */
+} TIFFCheckpoint;
+
+struct _TIFFCheckpoints {
+	uint32			interval;	/* rows between checkpoints */
+	uint32			strip;		/* strip of points, or NOSTRIP */
+	uint64			diroff;		/* directory of the strip */
+	uint8*			owner;		/* tif_data of the snapshots */
+	TIFFFreeStateMethod	freestate;	/* and their free method */
+	uint32			npoints;	/* # entries in points */
+	TIFFCheckpoint*		points;		/* [k] at row (k+1)*interval */
+};
+
+static void
+_TIFFResetCheckpoints(TIFF* tif)
+{
+	TIFFCheckpoints* ck = tif->tif_checkpoints;
+	uint32 i;
+
+	for (i = 0; i < ck->npoints; i++) {
+		if (ck->points[i].state)
+			(*ck->freestate)(tif, ck->points[i].state);
+	}
+	if (ck->points)
+		_TIFFfreeExt(tif, ck->points);
+	ck->points = NULL;
+	ck->npoints = 0;
+	ck->strip = NOSTRIP;
+}
+
+/*
+ * Return the checkpoints of a strip, dropping those of any other strip,
+ * directory or codec.
+ */
+static TIFFCheckpoints*
+_TIFFStripCheckpoints(TIFF* tif, uint32 strip)
+{
+	TIFFCheckpoints* ck = tif->tif_checkpoints;
+
+	if (ck->strip != strip || ck->diroff != tif->tif_diroff ||
+	    ck->owner != tif->tif_data)
+		_TIFFResetCheckpoints(tif);
+	return (ck);
+}
+
+/* First row of the current strip */
+static uint32
+_TIFFStripRow(TIFF* tif, uint32 strip)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+
+	return (strip % td->td_stripsperimage) * td->td_rowsperstrip;
+}
+
+/*
+ * Find the last checkpoint of strip at or before row.  Returns its
+ * number, counting from 1, with its row and raw data offset, or 0 if
+ * there is none.
+ */
+int
+_TIFFCheckpointFind(TIFF* tif, uint32 strip, uint32 row,
+    uint32* ckrow, uint64* rawoff)
+{
+	TIFFCheckpoints* ck = tif->tif_checkpoints;
+	uint32 k;
+
+	if (ck == NULL || tif->tif_restorestate == NULL)
+		return (0);
+	ck = _TIFFStripCheckpoints(tif, strip);
+	k = (row - _TIFFStripRow(tif, strip)) / ck->interval;
+	if (k > ck->npoints)
+		k = ck->npoints;
+	while (k > 0 && ck->points[k - 1].state == NULL)
+		k--;
+	if (k == 0)
+		return (0);
+	*ckrow = _TIFFStripRow(tif, strip) + k * ck->interval;
+	*rawoff = ck->points[k - 1].rawoff;
+	return ((int) k);
+}
+
+/*
+ * Put the decoder back into the state of a checkpoint returned by
+ * _TIFFCheckpointFind().  The caller positions the raw data.
+ */
+int
+_TIFFCheckpointRestore(TIFF* tif, int which)
+{
+	TIFFCheckpoints* ck = tif->tif_checkpoints;
+
+	return ((*tif->tif_restorestate)(tif, ck->points[which - 1].state));
+}
+
+/*
+ * Called after a row of the current strip is decoded: take a checkpoint
+ * if the next row starts a new interval.
+ */
+void
+_TIFFCheckpointSave(TIFF* tif)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	TIFFCheckpoints* ck = tif->tif_checkpoints;
+	uint32 strip = tif->tif_curstrip;
+	uint32 k, rows;
+
+	if (ck == NULL || tif->tif_savestate == NULL || strip == NOSTRIP ||
+	    (tif->tif_flags & TIFF_NOREADRAW))
+		return;
+	ck = _TIFFStripCheckpoints(tif, strip);
+	k = tif->tif_row - _TIFFStripRow(tif, strip);
+	if (k == 0 || k % ck->interval != 0)
+		return;
+	k = k / ck->interval;
+	if (ck->points == NULL) {
+		rows = td->td_rowsperstrip;
+		if (rows > td->td_imagelength)
+			rows = td->td_imagelength;
+		ck->npoints = rows / ck->interval;
+		if (ck->npoints == 0)
+			return;
+		ck->points = (TIFFCheckpoint*) _TIFFcallocExt(tif,
+		    (tmsize_t) ck->npoints, sizeof(TIFFCheckpoint));
+		if (ck->points == NULL) {
+			ck->npoints = 0;
+			return;
+		}
+		ck->strip = strip;
+		ck->diroff = tif->tif_diroff;
+		ck->owner = tif->tif_data;
+		ck->freestate = tif->tif_freestate;
+	}
+	if (k > ck->npoints || ck->points[k - 1].state != NULL)
+		return;
+	/* Failing to take one only makes seeking slower */
+	ck->points[k - 1].state = (*tif->tif_savestate)(tif);
+	ck->points[k - 1].rawoff = (uint64) tif->tif_rawdataoff +
+	    (uint64)(tif->tif_rawcp - tif->tif_rawdata);
+}
+
+void
+_TIFFFreeCheckpoints(TIFF* tif)
+{
+	if (tif->tif_checkpoints == NULL)
+		return;
+	_TIFFResetCheckpoints(tif);
+	_TIFFfreeExt(tif, tif->tif_checkpoints);
+	tif->tif_checkpoints = NULL;
+}
+
+/*
+ * Keep a decoder checkpoint every interval rows of the strip being read
+ * with TIFFReadScanline(), or stop doing so if interval is 0.  While
+ * enabled, scanlines of compressed strips may be read in any order:
+ * reaching a row decodes at most interval rows past a checkpoint, for
+ * the codecs that can save their state (LZW and Deflate), or the rows
+ * from the start of the strip otherwise.
+ */
+int
+TIFFSetScanlineCheckpoints(TIFF* tif, uint32 interval)
+{
+	static const char module[] = "TIFFSetScanlineCheckpoints";
+	TIFFCheckpoints* ck;
+
+	if (tif->tif_mode != O_RDONLY) {
+		TIFFErrorExtR(tif, module,
+		    "Checkpoints are only supported for files opened read-only");
+		return (0);
+	}
+	_TIFFFreeCheckpoints(tif);
+	if (interval == 0)
+		return (1);
+	ck = (TIFFCheckpoints*) _TIFFmallocExt(tif, sizeof(TIFFCheckpoints));
+	if (ck == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for checkpoint state");
+		return (0);
+	}
+	_TIFFmemset(ck, 0, sizeof(TIFFCheckpoints));
+	ck->interval = interval;
+	ck->strip = NOSTRIP;
+	tif->tif_checkpoints = ck;
+	return (1);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * CRC-32C checksums of the strips and tiles written.
+ *
+ * Handles opened with TIFFOpenOptionsSetChunkChecksums() compute the
+ * CRC-32C (Castagnoli) of the bytes of each strip and tile as they go to
+ * the file, and record them in the ChunkCRC32C tag of the directory, one
+ * LONG per strip/tile like the StripByteCounts.  TIFFVerifyChunks() checks
+ * the raw bytes against them, so the integrity of a file can be checked
+ * at the speed of the disk, without any decoding.  The checksum is done
+ * with the crc32 instructions of SSE4.2 or ARMv8 where available.
+ */
+#include "tiffiop.h"
+
+#if defined(TIFF_SIMD_X86) && defined(_MSC_VER)
+# include <intrin.h>
+#elif defined(TIFF_SIMD_X86)
+# include <nmmintrin.h>
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+# include <arm_acle.h>
+#endif
+
+#define CRC32C_POLY	0x82F63B78U	/* reflected Castagnoli polynomial */
+
+/* the raw data checked at a time when the file is not mapped */
+#define VERIFY_BATCH_CHUNKS	256
+#define VERIFY_BATCH_BYTES	((tmsize_t) 32 << 20)
+
+/* tables for eight bytes at a time, filled in by _TIFFChecksumKernels() */
+static uint32 crctab[8][256];
+static int crctabready = 0;
+
+#if defined(TIFF_SIMD_X86)
+static tmsize_t TIFF_TARGET_SSE42
+crc32cSSE42(uint32* state, const uint8* p, tmsize_t n)
+{
+	tmsize_t i = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+	uint64 c = *state;
+
+	for (; i + 8 <= n; i += 8) {
+		uint64 v;
+
+		_TIFFmemcpy(&v, p + i, 8);
+		c = _mm_crc32_u64(c, v);
+	}
+	*state = (uint32) c;
+#else
+	uint32 c = *state;
+
+	for (; i + 4 <= n; i += 4) {
+		uint32 v;
+
+		_TIFFmemcpy(&v, p + i, 4);
+		c = _mm_crc32_u32(c, v);
+	}
+	*state = c;
+#endif
+	return (i);
+}
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+static tmsize_t
+crc32cARMv8(uint32* state, const uint8* p, tmsize_t n)
+{
+	uint32 c = *state;
+	tmsize_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		uint64 v;
+
+		_TIFFmemcpy(&v, p + i, 8);
+		c = __crc32cd(c, v);
+	}
+	*state = c;
+	return (i);
+}
+#endif
+
+void
+_TIFFChecksumKernels(TIFFKernels* k, int features)
+{
+	uint32 i, c;
+	int j;
+
+	if (!crctabready) {
+		for (i = 0; i < 256; i++) {
+			c = i;
+			for (j = 0; j < 8; j++)
+				c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+			crctab[0][i] = c;
+		}
+		for (i = 0; i < 256; i++)
+			for (j = 1; j < 8; j++)
+				crctab[j][i] = (crctab[j - 1][i] >> 8) ^
+				    crctab[0][crctab[j - 1][i] & 0xff];
+		crctabready = 1;
+	}
+#if defined(TIFF_SIMD_X86)
+	if (features & TIFF_CPU_SSE42)
+		k->crc32c = crc32cSSE42;
+#elif defined(__ARM_FEATURE_CRC32)
+	if (features & TIFF_CPU_CRC32)
+		k->crc32c = crc32cARMv8;
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+/*
+ * Continue the CRC-32C crc of earlier data (0 to start) with n bytes.
+ */
+uint32
+_TIFFCRC32C(uint32 crc, const void* buf, tmsize_t n)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	const uint8* p = (const uint8*) buf;
+	uint32 c = ~crc;
+
+	if (k->crc32c != NULL) {
+		tmsize_t done = (*k->crc32c)(&c, p, n);
+
+		p += done;
+		n -= done;
+	}
+	for (; n >= 8; p += 8, n -= 8) {
+		c ^= (uint32) p[0] | ((uint32) p[1] << 8) |
+		    ((uint32) p[2] << 16) | ((uint32) p[3] << 24);
+		c = crctab[7][c & 0xff] ^ crctab[6][(c >> 8) & 0xff] ^
+		    crctab[5][(c >> 16) & 0xff] ^ crctab[4][c >> 24] ^
+		    crctab[3][p[4]] ^ crctab[2][p[5]] ^
+		    crctab[1][p[6]] ^ crctab[0][p[7]];
+	}
+	for (; n > 0; p++, n--)
+		c = crctab[0][(c ^ *p) & 0xff] ^ (c >> 8);
+	return (~c);
+}
+
+/*
+ * Return the checksums of the directory being written, with room for
+ * strile, starting from those of the ChunkCRC32C tag if the directory
+ * has one.  Returns NULL, having stopped checksumming, if memory runs out.
+ */
+static uint32*
+ChunkCRCs(TIFF* tif, uint32 strile)
+{
+	static const char module[] = "ChunkCRCs";
+	uint32 n = TIFFmax(tif->tif_dir.td_nstrips, strile + 1);
+	uint32* crcs;
+
+	if (tif->tif_chunkcrc != NULL && strile < tif->tif_nchunkcrc)
+		return (tif->tif_chunkcrc);
+	crcs = (uint32*) _TIFFreallocExt(tif, tif->tif_chunkcrc,
+	    (tmsize_t) n * sizeof(uint32));
+	if (crcs == NULL) {
+		TIFFWarningExtR(tif, module,
+		    "Out of memory, checksums of strips/tiles not written");
+		_TIFFFreeChunkCRC(tif);
+		tif->tif_chunkchecksums = 0;
+		return (NULL);
+	}
+	_TIFFmemset(crcs + tif->tif_nchunkcrc, 0,
+	    (tmsize_t)(n - tif->tif_nchunkcrc) * sizeof(uint32));
+	if (tif->tif_chunkcrc == NULL) {
+		uint32 count;
+		uint32* old;
+
+		if (TIFFGetField(tif, TIFFTAG_CHUNKCRC32C, &count, &old))
+			_TIFFmemcpy(crcs, old,
+			    (tmsize_t) TIFFmin(count, n) * sizeof(uint32));
+	}
+	tif->tif_chunkcrc = crcs;
+	tif->tif_nchunkcrc = n;
+	return (crcs);
+}
+
+/*
+ * Add cc bytes written for strip/tile strile to its checksum, which
+ * starts over if fresh is set.
+ */
+void
+_TIFFChunkCRCUpdate(TIFF* tif, uint32 strile, const void* data, tmsize_t cc,
+    int fresh)
+{
+	uint32* crcs = ChunkCRCs(tif, strile);
+
+	if (crcs != NULL)
+		crcs[strile] = _TIFFCRC32C(fresh ? 0 : crcs[strile], data, cc);
+}
+
+/*
+ * Record the checksums in the ChunkCRC32C tag of the directory about to
+ * be written.
+ */
+int
+_TIFFChunkCRCFlush(TIFF* tif)
+{
+	uint32* crcs;
+
+	if (tif->tif_chunkcrc == NULL || tif->tif_dir.td_nstrips == 0)
+		return (1);
+	if ((crcs = ChunkCRCs(tif, tif->tif_dir.td_nstrips - 1)) == NULL)
+		return (1);
+	return (TIFFSetField(tif, TIFFTAG_CHUNKCRC32C,
+	    tif->tif_dir.td_nstrips, crcs));
+}
+
+void
+_TIFFFreeChunkCRC(TIFF* tif)
+{
+	if (tif->tif_chunkcrc != NULL)
+		_TIFFfreeExt(tif, tif->tif_chunkcrc);
+	tif->tif_chunkcrc = NULL;
+	tif->tif_nchunkcrc = 0;
+}
+
+static void
+VerifyResult(uint32 strile, int ok, uint32* bad, uint32 maxbad, int64* nbad)
+{
+	if (ok)
+		return;
+	if (bad != NULL && (uint64) *nbad < maxbad)
+		bad[*nbad] = strile;
+	(*nbad)++;
+}
+
+/*
+ * Check the raw data of every strip and tile of the current directory
+ * against the ChunkCRC32C tag.  Returns the number of strips/tiles whose
+ * data does not match, the first maxbad of which are stored in bad, or -1
+ * if the directory has no checksums or the data cannot be read.  Strips
+ * and tiles with no data are not checked.
+ */
+int64
+TIFFVerifyChunks(TIFF* tif, uint32* bad, uint32 maxbad)
+{
+	static const char module[] = "TIFFVerifyChunks";
+	TIFFDirectory* td = &tif->tif_dir;
+	uint32 chunks[VERIFY_BATCH_CHUNKS];
+	void* bufs[VERIFY_BATCH_CHUNKS];
+	tmsize_t sizes[VERIFY_BATCH_CHUNKS];
+	uint8* data = NULL;
+	tmsize_t datasize = 0;
+	uint32* crcs;
+	uint32 count, strile, next, n, i;
+	uint32 noreadraw = tif->tif_flags & TIFF_NOREADRAW;
+	int64 nbad = 0;
+
+	if (!TIFFGetField(tif, TIFFTAG_CHUNKCRC32C, &count, &crcs) ||
+	    count != td->td_nstrips) {
+		TIFFErrorExtR(tif, module,
+		    "%s: No checksums of the strips/tiles", tif->tif_name);
+		return (-1);
+	}
+	if (!_TIFFHaveStriles(tif))
+		return (-1);
+
+	if (isMapped(tif)) {
+		for (strile = 0; strile < td->td_nstrips; strile++) {
+			uint64 off = TIFFGetStrileOffset(tif, strile);
+			uint64 bc = TIFFGetStrileByteCount(tif, strile);
+
+			if (bc == 0)
+				continue;
+			VerifyResult(strile, bc <= (uint64) tif->tif_size &&
+			    off <= (uint64) tif->tif_size - bc &&
+			    _TIFFCRC32C(0, tif->tif_base + (tmsize_t) off,
+			    (tmsize_t) bc) == crcs[strile], bad, maxbad, &nbad);
+		}
+		return (nbad);
+	}
+
+	/* The raw bytes are wanted here, not data for the decoder */
+	tif->tif_flags &= ~TIFF_NOREADRAW;
+	for (strile = 0; strile < td->td_nstrips; strile = next) {
+		tmsize_t total = 0;
+
+		/* Read a batch of strips/tiles at once, merging their reads */
+		for (n = 0, next = strile; next < td->td_nstrips &&
+		    n < VERIFY_BATCH_CHUNKS; next++) {
+			uint64 bc = TIFFGetStrileByteCount(tif, next);
+
+			if (bc == 0)
+				continue;
+			if ((uint64)(tmsize_t) bc != bc ||
+			    (n > 0 && (uint64) total + bc >
+			    (uint64) VERIFY_BATCH_BYTES))
+				break;
+			chunks[n] = next;
+			sizes[n++] = (tmsize_t) bc;
+			total += (tmsize_t) bc;
+		}
+		if (n == 0) {
+			if (next < td->td_nstrips) {
+				TIFFErrorExtR(tif, module,
+				    "Strip/tile %lu too large",
+				    (unsigned long) next);
+				nbad = -1;
+				break;
+			}
+			continue;
+		}
+		if (total > datasize) {
+			uint8* p = (uint8*) _TIFFreallocExt(tif, data, total);
+
+			if (p == NULL) {
+				TIFFErrorExtR(tif, module,
+				    "Out of memory reading strips/tiles");
+				nbad = -1;
+				break;
+			}
+			data = p;
+			datasize = total;
+		}
+		for (i = 0, total = 0; i < n; i++) {
+			bufs[i] = data + total;
+			total += sizes[i];
+			sizes[i] = (tmsize_t)(-1);
+		}
+		if (!TIFFReadRawChunks(tif, chunks, n, bufs, sizes, -1)) {
+			nbad = -1;
+			break;
+		}
+		for (i = 0; i < n; i++)
+			VerifyResult(chunks[i], sizes[i] ==
+			    (tmsize_t) TIFFGetStrileByteCount(tif, chunks[i]) &&
+			    _TIFFCRC32C(0, bufs[i], sizes[i]) == crcs[chunks[i]],
+			    bad, maxbad, &nbad);
+	}
+	tif->tif_flags |= noreadraw;
+	if (data != NULL)
+		_TIFFfreeExt(tif, data);
+	return (nbad);
+}
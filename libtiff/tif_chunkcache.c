@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Cache of decoded strips and tiles.
+ *
+ * A cache made with TIFFChunkCacheCreate() and attached to read-only
+ * handles with TIFFSetChunkCache() keeps the output of
+ * TIFFReadEncodedStrip() and TIFFReadEncodedTile() for whole chunks, so
+ * that reading them again (as viewers do when the windows they show
+ * overlap) is a copy instead of a read and a decode.  Entries are keyed
+ * by handle, directory offset, chunk number and the codec pseudo-tags
+ * that change the decoded data, and are dropped in least recently used
+ * order to stay within a byte budget.  A cache can be shared by
+ * handles used from different threads; clones made with
+ * TIFFCloneForThread() use the cache and the entries of their template.
+ */
+#include "tiffiop.h"
+
+#define	CHUNKCACHE_MIN_HASH	64
+
+typedef struct _TIFFCachedChunk TIFFCachedChunk;
+
+struct _TIFFCachedChunk {
+	uint64		id;		/* tif_cacheid of the handle */
+	uint64		diroff;
+	uint32		chunk;
+	uint32		variant;	/* see _TIFFDecodeVariant() */
+	tmsize_t	size;		/* bytes of data, which follow */
+	TIFFCachedChunk* hnext;		/* next entry in hash chain */
+	TIFFCachedChunk* prev;		/* LRU list links */
+	TIFFCachedChunk* next;
+};
+
+struct _TIFFChunkCache {
+	TIFFMutex*	mutex;
+	int		refs;		/* caller + attached handles */
+	tmsize_t	maxbytes;
+	tmsize_t	bytes;		/* size of the cached data */
+	TIFFCachedChunk** hash;		/* chain heads, hashmask + 1 of them */
+	uint32		hashmask;
+	uint32		count;		/* # entries */
+	TIFFCachedChunk* head;		/* most recently used */
+	TIFFCachedChunk* tail;		/* least recently used */
+	uint64		hits;
+	uint64		misses;
+};
+
+#define	CHUNKDATA(e)	((uint8*) ((e) + 1))
+
+static uint32
+_TIFFChunkHash(uint64 id, uint64 diroff, uint32 chunk)
+{
+	uint32 h = (uint32) id * 2654435761U;
+
+	h ^= (uint32) diroff ^ (uint32) (diroff >> 32);
+	h ^= chunk * 2246822519U;
+	return (h ^ (h >> 15));
+}
+
+#define	CHUNKHASH(cc, e) \
+	(_TIFFChunkHash((e)->id, (e)->diroff, (e)->chunk) & (cc)->hashmask)
+
+static void
+_TIFFChunkCacheUnlink(TIFFChunkCache* cc, TIFFCachedChunk* e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		cc->head = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		cc->tail = e->prev;
+}
+
+static void
+_TIFFChunkCachePush(TIFFChunkCache* cc, TIFFCachedChunk* e)
+{
+	e->prev = NULL;
+	e->next = cc->head;
+	if (cc->head)
+		cc->head->prev = e;
+	else
+		cc->tail = e;
+	cc->head = e;
+}
+
+static void
+_TIFFChunkCacheRemove(TIFFChunkCache* cc, TIFFCachedChunk* e)
+{
+	TIFFCachedChunk** link;
+
+	for (link = &cc->hash[CHUNKHASH(cc, e)]; *link != e;
+	    link = &(*link)->hnext)
+		;
+	*link = e->hnext;
+	_TIFFChunkCacheUnlink(cc, e);
+	cc->bytes -= e->size;
+	cc->count--;
+	_TIFFfree(e);
+}
+
+/*
+ * Double the hash table once there are more entries than chains, to
+ * keep the chains short.  The table is left as is if that fails.
+ */
+static void
+_TIFFChunkCacheGrow(TIFFChunkCache* cc)
+{
+	uint32 n = 2 * (cc->hashmask + 1), i;
+	TIFFCachedChunk** hash;
+	TIFFCachedChunk* e;
+
+	hash = (TIFFCachedChunk**) _TIFFmalloc(n * sizeof(TIFFCachedChunk*));
+	if (hash == NULL)
+		return;
+	for (i = 0; i < n; i++)
+		hash[i] = NULL;
+	cc->hashmask = n - 1;
+	for (e = cc->head; e != NULL; e = e->next) {
+		e->hnext = hash[CHUNKHASH(cc, e)];
+		hash[CHUNKHASH(cc, e)] = e;
+	}
+	_TIFFfree(cc->hash);
+	cc->hash = hash;
+}
+
+/*
+ * Return the entry for the given chunk of tif, or NULL.
+ */
+static TIFFCachedChunk*
+_TIFFChunkCacheFind(TIFFChunkCache* cc, TIFF* tif, uint32 chunk,
+    uint32 variant)
+{
+	TIFFCachedChunk* e;
+	uint32 h = _TIFFChunkHash(tif->tif_cacheid, tif->tif_diroff, chunk) &
+	    cc->hashmask;
+
+	for (e = cc->hash[h]; e != NULL; e = e->hnext)
+		if (e->chunk == chunk && e->diroff == tif->tif_diroff &&
+		    e->id == tif->tif_cacheid && e->variant == variant)
+			return (e);
+	return (NULL);
+}
+
+TIFFChunkCache*
+TIFFChunkCacheCreate(tmsize_t maxbytes)
+{
+	static const char module[] = "TIFFChunkCacheCreate";
+	TIFFChunkCache* cc;
+	uint32 i;
+
+	cc = (TIFFChunkCache*) _TIFFmalloc(sizeof(TIFFChunkCache));
+	if (cc == NULL) {
+		TIFFErrorExt(0, module, "No space for chunk cache");
+		return (NULL);
+	}
+	_TIFFmemset(cc, 0, sizeof(TIFFChunkCache));
+	cc->refs = 1;
+	cc->maxbytes = maxbytes > 0 ? maxbytes : 0;
+	cc->hashmask = CHUNKCACHE_MIN_HASH - 1;
+	cc->mutex = _TIFFMutexCreate();
+	cc->hash = (TIFFCachedChunk**) _TIFFmalloc(CHUNKCACHE_MIN_HASH *
+	    sizeof(TIFFCachedChunk*));
+	if (cc->mutex == NULL || cc->hash == NULL) {
+		TIFFErrorExt(0, module, "No space for chunk cache");
+		_TIFFMutexDestroy(cc->mutex);
+		if (cc->hash)
+			_TIFFfree(cc->hash);
+		_TIFFfree(cc);
+		return (NULL);
+	}
+	for (i = 0; i < CHUNKCACHE_MIN_HASH; i++)
+		cc->hash[i] = NULL;
+	return (cc);
+}
+
+/*
+ * Drop a reference to cc, freeing it with the last one.
+ */
+static void
+_TIFFChunkCacheUnref(TIFFChunkCache* cc)
+{
+	int refs;
+
+	_TIFFMutexLock(cc->mutex);
+	refs = --cc->refs;
+	_TIFFMutexUnlock(cc->mutex);
+	if (refs > 0)
+		return;
+	while (cc->head != NULL)
+		_TIFFChunkCacheRemove(cc, cc->head);
+	_TIFFfree(cc->hash);
+	_TIFFMutexDestroy(cc->mutex);
+	_TIFFfree(cc);
+}
+
+/*
+ * Release the caller's reference; the cache goes away once no handle
+ * uses it either.
+ */
+void
+TIFFChunkCacheFree(TIFFChunkCache* cc)
+{
+	if (cc != NULL)
+		_TIFFChunkCacheUnref(cc);
+}
+
+void
+TIFFChunkCacheGetStats(TIFFChunkCache* cc, uint64* hits, uint64* misses,
+    tmsize_t* bytes)
+{
+	_TIFFMutexLock(cc->mutex);
+	if (hits)
+		*hits = cc->hits;
+	if (misses)
+		*misses = cc->misses;
+	if (bytes)
+		*bytes = cc->bytes;
+	_TIFFMutexUnlock(cc->mutex);
+}
+
+/*
+ * Give tif a unique key for its entries, shared by its clones.
+ */
+static void
+_TIFFChunkCacheSetId(TIFF* tif)
+{
+	static uint64 lastid = 0;
+
+	if (tif->tif_template != NULL) {
+		tif->tif_cacheid = tif->tif_template->tif_cacheid;
+		return;
+	}
+	_TIFFGlobalLock();
+	if (tif->tif_cacheid == 0)
+		tif->tif_cacheid = ++lastid;
+	_TIFFGlobalUnlock();
+}
+
+/*
+ * Attach cc to tif, replacing any cache it had, or detach the cache if
+ * cc is NULL.  Only handles open for reading can have a cache.
+ */
+int
+TIFFSetChunkCache(TIFF* tif, TIFFChunkCache* cc)
+{
+	static const char module[] = "TIFFSetChunkCache";
+
+	if (cc != NULL && tif->tif_mode != O_RDONLY) {
+		TIFFErrorExtR(tif, module,
+		    "%s: Only handles opened for reading can use a chunk cache",
+		    tif->tif_name);
+		return (0);
+	}
+	if (cc == tif->tif_chunkcache)
+		return (1);
+	if (cc != NULL) {
+		_TIFFMutexLock(cc->mutex);
+		cc->refs++;
+		_TIFFMutexUnlock(cc->mutex);
+		_TIFFChunkCacheSetId(tif);
+	}
+	_TIFFFreeChunkCache(tif);
+	tif->tif_chunkcache = cc;
+	return (1);
+}
+
+/*
+ * Let the clone w of tif use the cache of tif.
+ */
+void
+_TIFFChunkCacheShare(TIFF* tif, TIFF* w)
+{
+	if (tif->tif_chunkcache != NULL)
+		(void) TIFFSetChunkCache(w, tif->tif_chunkcache);
+}
+
+/*
+ * Copy the cached data of the given chunk of tif, up to size bytes
+ * unless size is -1, to buf.  Returns the number of bytes copied, or
+ * -1 if the chunk is not in the cache.
+ */
+tmsize_t
+_TIFFChunkCacheGet(TIFF* tif, uint32 chunk, void* buf, tmsize_t size)
+{
+	TIFFChunkCache* cc = tif->tif_chunkcache;
+	uint32 variant = _TIFFDecodeVariant(tif);
+	TIFFCachedChunk* e;
+
+	_TIFFMutexLock(cc->mutex);
+	e = _TIFFChunkCacheFind(cc, tif, chunk, variant);
+	if (e == NULL) {
+		cc->misses++;
+		_TIFFMutexUnlock(cc->mutex);
+		return ((tmsize_t)(-1));
+	}
+	cc->hits++;
+	if (cc->head != e) {
+		_TIFFChunkCacheUnlink(cc, e);
+		_TIFFChunkCachePush(cc, e);
+	}
+	if (size == (tmsize_t)(-1) || size > e->size)
+		size = e->size;
+	_TIFFmemcpy(buf, CHUNKDATA(e), size);
+	_TIFFMutexUnlock(cc->mutex);
+	return (size);
+}
+
+/*
+ * Enter the size bytes of decoded data of a whole chunk of tif, making
+ * room for it by dropping the least recently used entries.  Chunks
+ * larger than the budget are not cached.
+ */
+void
+_TIFFChunkCachePut(TIFF* tif, uint32 chunk, const void* buf, tmsize_t size)
+{
+	TIFFChunkCache* cc = tif->tif_chunkcache;
+	uint32 variant = _TIFFDecodeVariant(tif);
+	TIFFCachedChunk* e;
+	uint32 h;
+
+	if (size <= 0 || size > cc->maxbytes ||
+	    (size_t) size > ~(size_t) 0 - sizeof(TIFFCachedChunk))
+		return;
+	/* copy the data before taking the lock */
+	e = (TIFFCachedChunk*) _TIFFmalloc(sizeof(TIFFCachedChunk) + size);
+	if (e == NULL)
+		return;
+	e->id = tif->tif_cacheid;
+	e->diroff = tif->tif_diroff;
+	e->chunk = chunk;
+	e->variant = variant;
+	e->size = size;
+	_TIFFmemcpy(CHUNKDATA(e), buf, size);
+
+	_TIFFMutexLock(cc->mutex);
+	if (_TIFFChunkCacheFind(cc, tif, chunk, variant) != NULL) {
+		/* entered by another thread meanwhile */
+		_TIFFMutexUnlock(cc->mutex);
+		_TIFFfree(e);
+		return;
+	}
+	while (cc->tail != NULL && cc->bytes > cc->maxbytes - size)
+		_TIFFChunkCacheRemove(cc, cc->tail);
+	if (cc->count >= cc->hashmask + 1)
+		_TIFFChunkCacheGrow(cc);
+	h = CHUNKHASH(cc, e);
+	e->hnext = cc->hash[h];
+	cc->hash[h] = e;
+	_TIFFChunkCachePush(cc, e);
+	cc->bytes += size;
+	cc->count++;
+	_TIFFMutexUnlock(cc->mutex);
+}
+
+/*
+ * Detach the cache of tif.  The entries of a handle that is not a clone
+ * are dropped, as no other handle can look them up.
+ */
+void
+_TIFFFreeChunkCache(TIFF* tif)
+{
+	TIFFChunkCache* cc = tif->tif_chunkcache;
+	TIFFCachedChunk* e;
+	TIFFCachedChunk* next;
+
+	if (cc == NULL)
+		return;
+	tif->tif_chunkcache = NULL;
+	if (tif->tif_template == NULL) {
+		_TIFFMutexLock(cc->mutex);
+		for (e = cc->head; e != NULL; e = next) {
+			next = e->next;
+			if (e->id == tif->tif_cacheid)
+				_TIFFChunkCacheRemove(cc, e);
+		}
+		_TIFFMutexUnlock(cc->mutex);
+	}
+	_TIFFChunkCacheUnref(cc);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
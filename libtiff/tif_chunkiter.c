@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Iteration over the decoded strips or tiles of a directory.
+ *
+ * TIFFChunkIteratorNext() hands out the chunks of the current directory
+ * one at a time, in chunk number order or in the order of their data in
+ * the file, each with its place in the image.  Chunks are decoded ahead
+ * in batches by _TIFFReadEncodedParallel() on several worker handles.
+ * Several threads may pull chunks from one iterator at once: the thread
+ * that finds the queue of decoded chunks running low decodes the next
+ * batch while the others go on with the chunks already queued, unless
+ * the batch is decoded on the handle itself.  Decoded
+ * data lives in buffers of the iterator, which TIFFChunkIteratorRelease()
+ * recycles and TIFFChunkIteratorEnd() frees.
+ */
+#include "tiffiop.h"
+#include <stdlib.h>
+
+#define	CHUNKITER_AHEAD		4		/* batch chunks per thread */
+#define	CHUNKITER_MAX_BATCH	(64*1024*1024)	/* bytes of a batch */
+
+struct _TIFFChunkIterator {
+	TIFF*		tif;
+	int		tiled;		/* geometry of the directory, */
+	int		separate;	/* set up before any decoding */
+	uint32		perplane;	/* chunks per sample plane */
+	uint32		across;		/* tiles across and down */
+	uint32		down;
+	uint32		chunkwidth;	/* tile size, or rows per strip */
+	uint32		chunklength;
+	uint32		imagewidth;
+	uint32		imagelength;
+	tmsize_t	stride;		/* bytes of a chunk row */
+	tmsize_t	chunksize;	/* bytes of a full chunk */
+	tmsize_t	lastsize;	/* bytes of a strip at the bottom */
+	TIFFMutex*	mutex;		/* protects all below */
+	TIFFCond*	cond;		/* a batch was decoded */
+	uint32*		order;		/* chunks in iteration order */
+	uint32		nchunks;
+	uint32		next;		/* first position not yet decoded */
+	int		nthreads;	/* to decode a batch on */
+	uint32		batch;		/* chunks decoded at a time */
+	tmsize_t	bufsize;	/* bytes of a chunk buffer */
+	uint32*		readypos;	/* queue of decoded chunks: their */
+	void**		readybuf;	/* position in order and buffer */
+	uint32		readyhead;
+	uint32		nready;
+	void**		fillbufs;	/* buffers of the batch decoded */
+	void*		freebufs;	/* list threaded through the buffers */
+	void**		bufs;		/* all buffers, to free them */
+	uint32		nbufs;
+	uint32		bufsalloc;
+	int		filling;	/* a thread decodes a batch */
+	int		failed;
+};
+
+typedef struct {
+	uint64	offset;
+	uint32	chunk;
+} TIFFChunkOffset;
+
+static int
+_TIFFChunkOffsetCompare(const void* a, const void* b)
+{
+	const TIFFChunkOffset* ca = (const TIFFChunkOffset*) a;
+	const TIFFChunkOffset* cb = (const TIFFChunkOffset*) b;
+
+	if (ca->offset != cb->offset)
+		return (ca->offset < cb->offset ? -1 : 1);
+	return (ca->chunk < cb->chunk ? -1 : ca->chunk > cb->chunk);
+}
+
+/*
+ * Set up the iteration over the strips or tiles of the current
+ * directory of tif, in the given TIFFITER_xxx order, decoding them on
+ * up to nthreads threads (one per processor if nthreads <= 0).  The
+ * handle must not be used otherwise until TIFFChunkIteratorEnd().
+ */
+TIFFChunkIterator*
+TIFFChunkIteratorBegin(TIFF* tif, int order, int nthreads)
+{
+	static const char module[] = "TIFFChunkIteratorBegin";
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFChunkIterator* it;
+	tmsize_t bufsize;
+	uint32 i, batch;
+
+	if (tif->tif_mode == O_WRONLY) {
+		TIFFErrorExtR(tif, tif->tif_name, "File not open for reading");
+		return (NULL);
+	}
+	if (order != TIFFITER_CHUNKORDER && order != TIFFITER_FILEORDER) {
+		TIFFErrorExtR(tif, module, "Invalid iteration order %d", order);
+		return (NULL);
+	}
+	if (!_TIFFHaveStriles(tif))
+		return (NULL);
+	bufsize = isTiled(tif) ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	if (bufsize <= 0)
+		return (NULL);
+	if (bufsize < (tmsize_t) sizeof (void*))
+		bufsize = (tmsize_t) sizeof (void*);
+	if (nthreads <= 0)
+		nthreads = _TIFFThreadConcurrency(tif);
+	if (nthreads > TIFF_MAX_WORKER_THREADS)
+		nthreads = TIFF_MAX_WORKER_THREADS;
+	batch = (uint32) nthreads * CHUNKITER_AHEAD;
+	if ((tmsize_t) batch > CHUNKITER_MAX_BATCH / bufsize)
+		batch = (uint32) (CHUNKITER_MAX_BATCH / bufsize);
+	if (batch == 0)
+		batch = 1;
+
+	it = (TIFFChunkIterator*) _TIFFcallocExt(tif, 1,
+	    sizeof (TIFFChunkIterator));
+	if (it == NULL) {
+		TIFFErrorExtR(tif, module, "No space for chunk iterator");
+		return (NULL);
+	}
+	it->tif = tif;
+	it->tiled = isTiled(tif);
+	it->separate = td->td_planarconfig == PLANARCONFIG_SEPARATE;
+	it->perplane = td->td_stripsperimage > 0 ? td->td_stripsperimage : 1;
+	it->imagewidth = td->td_imagewidth;
+	it->imagelength = td->td_imagelength;
+	if (it->tiled) {
+		it->chunkwidth = td->td_tilewidth;
+		it->chunklength = td->td_tilelength;
+		it->across = TIFFhowmany_32(td->td_imagewidth, td->td_tilewidth);
+		it->down = TIFFhowmany_32(td->td_imagelength, td->td_tilelength);
+		it->stride = TIFFTileRowSize(tif);
+		it->chunksize = TIFFTileSize(tif);
+		it->lastsize = it->chunksize;
+	} else {
+		it->chunkwidth = td->td_imagewidth;
+		it->chunklength = TIFFmin(td->td_rowsperstrip,
+		    td->td_imagelength);
+		it->across = it->down = 1;
+		it->stride = TIFFScanlineSize(tif);
+		it->chunksize = TIFFVStripSize(tif, it->chunklength);
+		it->lastsize = it->chunklength == 0 ? it->chunksize :
+		    TIFFVStripSize(tif, td->td_imagelength -
+		    (td->td_imagelength - 1) / it->chunklength *
+		    it->chunklength);
+	}
+	it->nchunks = td->td_nstrips;
+	it->nthreads = nthreads;
+	it->batch = batch;
+	it->bufsize = bufsize;
+	it->mutex = _TIFFMutexCreate();
+	it->cond = _TIFFCondCreate();
+	it->order = (uint32*) _TIFFCheckMalloc(tif, it->nchunks > 0 ?
+	    it->nchunks : 1, sizeof (uint32), "for chunk iteration order");
+	/* up to half a batch is queued when the next one is decoded */
+	it->readypos = (uint32*) _TIFFCheckMalloc(tif, 2 * batch,
+	    sizeof (uint32), "for chunk iterator queue");
+	it->readybuf = (void**) _TIFFCheckMalloc(tif, 2 * batch,
+	    sizeof (void*), "for chunk iterator queue");
+	it->fillbufs = (void**) _TIFFCheckMalloc(tif, batch,
+	    sizeof (void*), "for chunk iterator queue");
+	if (it->mutex == NULL || it->cond == NULL || it->order == NULL ||
+	    it->readypos == NULL || it->readybuf == NULL ||
+	    it->fillbufs == NULL) {
+		TIFFChunkIteratorEnd(it);
+		return (NULL);
+	}
+
+	if (order == TIFFITER_FILEORDER && it->nchunks > 1) {
+		TIFFChunkOffset* offsets = (TIFFChunkOffset*) _TIFFCheckMalloc(
+		    tif, it->nchunks, sizeof (TIFFChunkOffset),
+		    "for chunk offsets");
+		if (offsets == NULL) {
+			TIFFChunkIteratorEnd(it);
+			return (NULL);
+		}
+		for (i = 0; i < it->nchunks; i++) {
+			offsets[i].offset = TIFFGetStrileOffset(tif, i);
+			offsets[i].chunk = i;
+		}
+		qsort(offsets, it->nchunks, sizeof (TIFFChunkOffset),
+		    _TIFFChunkOffsetCompare);
+		for (i = 0; i < it->nchunks; i++)
+			it->order[i] = offsets[i].chunk;
+		_TIFFfreeExt(tif, offsets);
+	} else {
+		for (i = 0; i < it->nchunks; i++)
+			it->order[i] = i;
+	}
+	return (it);
+}
+
+/*
+ * Take a buffer off the free list, or allocate one.
+ */
+static void*
+_TIFFChunkIterTakeBuffer(TIFFChunkIterator* it)
+{
+	TIFF* tif = it->tif;
+	void* buf = it->freebufs;
+
+	if (buf != NULL) {
+		it->freebufs = *(void**) buf;
+		return (buf);
+	}
+	if (it->nbufs == it->bufsalloc) {
+		void** bufs = (void**) _TIFFreallocExt(tif, it->bufs,
+		    (tmsize_t) (it->bufsalloc + 16) * sizeof (void*));
+		if (bufs == NULL)
+			return (NULL);
+		it->bufs = bufs;
+		it->bufsalloc += 16;
+	}
+	buf = _TIFFmallocExt(tif, it->bufsize);
+	if (buf != NULL)
+		it->bufs[it->nbufs++] = buf;
+	return (buf);
+}
+
+static void
+_TIFFChunkIterPutBuffer(TIFFChunkIterator* it, void* buf)
+{
+	*(void**) buf = it->freebufs;
+	it->freebufs = buf;
+}
+
+/*
+ * Decode the next batch of chunks and queue them.  Called and returns
+ * with the lock held, which is dropped while the batch is decoded on
+ * worker handles.  A batch decoded on the handle itself keeps it.
+ */
+static void
+_TIFFChunkIterFill(TIFFChunkIterator* it)
+{
+	static const char module[] = "TIFFChunkIteratorNext";
+	TIFF* tif = it->tif;
+	uint32 first = it->next, n = it->nchunks - it->next, i;
+	int parallel, ok;
+
+	if (n > it->batch)
+		n = it->batch;
+	for (i = 0; i < n; i++) {
+		it->fillbufs[i] = _TIFFChunkIterTakeBuffer(it);
+		if (it->fillbufs[i] == NULL) {
+			TIFFErrorExtR(tif, module,
+			    "No space for decoded strips or tiles");
+			while (i-- > 0)
+				_TIFFChunkIterPutBuffer(it, it->fillbufs[i]);
+			it->failed = 1;
+			return;
+		}
+	}
+	it->next += n;
+	it->filling = 1;
+	parallel = n > 1 && it->nthreads > 1 && _TIFFCanDecodeInParallel(tif);
+	if (parallel)
+		_TIFFMutexUnlock(it->mutex);
+	ok = _TIFFReadEncodedParallel(tif, it->tiled, it->order + first, n,
+	    it->fillbufs, it->bufsize, it->nthreads, module);
+	if (parallel)
+		_TIFFMutexLock(it->mutex);
+	it->filling = 0;
+	for (i = 0; i < n; i++) {
+		if (ok) {
+			uint32 k = (it->readyhead + it->nready) % (2 * it->batch);
+
+			it->readypos[k] = first + i;
+			it->readybuf[k] = it->fillbufs[i];
+			it->nready++;
+		} else
+			_TIFFChunkIterPutBuffer(it, it->fillbufs[i]);
+	}
+	if (!ok)
+		it->failed = 1;
+	_TIFFCondBroadcast(it->cond);
+}
+
+/*
+ * Fill in where strip or tile c is in the image.  Works from the
+ * geometry set up by TIFFChunkIteratorBegin(), without the handle,
+ * which may be decoding the next batch meanwhile.
+ */
+static void
+_TIFFChunkIterGeometry(TIFFChunkIterator* it, uint32 c, TIFFChunk* chunk)
+{
+	uint32 k = c % it->perplane;
+
+	chunk->chunk = c;
+	chunk->sample = it->separate ? (uint16) (c / it->perplane) : 0;
+	chunk->stride = it->stride;
+	chunk->size = it->chunksize;
+	if (it->tiled) {
+		k %= it->across * it->down;	/* same place in each slice */
+		chunk->x = (k % it->across) * it->chunkwidth;
+		chunk->y = (k / it->across) * it->chunklength;
+		chunk->width = TIFFmin(it->chunkwidth,
+		    it->imagewidth - chunk->x);
+		chunk->length = TIFFmin(it->chunklength,
+		    it->imagelength - chunk->y);
+	} else {
+		chunk->x = 0;
+		chunk->y = k * it->chunklength;
+		chunk->width = it->imagewidth;
+		chunk->length = TIFFmin(it->chunklength,
+		    it->imagelength - chunk->y);
+		if (chunk->length < it->chunklength)
+			chunk->size = it->lastsize;
+	}
+}
+
+/*
+ * Return the next decoded strip or tile in *chunk.  Its data stays
+ * valid until it is given back with TIFFChunkIteratorRelease() or the
+ * iterator ends.  May be called from several threads at once, which
+ * then get different chunks.  Returns 1 if a chunk was returned, 0 once
+ * all have been and -1 on error.
+ */
+int
+TIFFChunkIteratorNext(TIFFChunkIterator* it, TIFFChunk* chunk)
+{
+	uint32 pos;
+	void* buf;
+
+	_TIFFMutexLock(it->mutex);
+	for (;;) {
+		if (it->failed) {
+			_TIFFMutexUnlock(it->mutex);
+			return (-1);
+		}
+		if (it->nready > 0)
+			break;
+		if (it->filling)
+			_TIFFCondWait(it->cond, it->mutex);
+		else if (it->next < it->nchunks)
+			_TIFFChunkIterFill(it);
+		else {
+			_TIFFMutexUnlock(it->mutex);
+			return (0);
+		}
+	}
+	pos = it->readypos[it->readyhead];
+	buf = it->readybuf[it->readyhead];
+	it->readyhead = (it->readyhead + 1) % (2 * it->batch);
+	it->nready--;
+	/* Decode ahead while other threads use the queued chunks */
+	if (!it->filling && it->next < it->nchunks &&
+	    it->nready < it->batch / 2)
+		_TIFFChunkIterFill(it);
+	_TIFFMutexUnlock(it->mutex);
+
+	_TIFFChunkIterGeometry(it, it->order[pos], chunk);
+	chunk->buf = buf;
+	return (1);
+}
+
+/*
+ * Give the buffer of a chunk back for the chunks still to come.
+ */
+void
+TIFFChunkIteratorRelease(TIFFChunkIterator* it, TIFFChunk* chunk)
+{
+	if (chunk->buf == NULL)
+		return;
+	_TIFFMutexLock(it->mutex);
+	_TIFFChunkIterPutBuffer(it, chunk->buf);
+	_TIFFMutexUnlock(it->mutex);
+	chunk->buf = NULL;
+}
+
+/*
+ * Free the iterator and the buffers of all the chunks it returned.
+ */
+void
+TIFFChunkIteratorEnd(TIFFChunkIterator* it)
+{
+	TIFF* tif;
+	uint32 i;
+
+	if (it == NULL)
+		return;
+	tif = it->tif;
+	for (i = 0; i < it->nbufs; i++)
+		_TIFFfreeExt(tif, it->bufs[i]);
+	if (it->bufs)
+		_TIFFfreeExt(tif, it->bufs);
+	if (it->order)
+		_TIFFfreeExt(tif, it->order);
+	if (it->readypos)
+		_TIFFfreeExt(tif, it->readypos);
+	if (it->readybuf)
+		_TIFFfreeExt(tif, it->readybuf);
+	if (it->fillbufs)
+		_TIFFfreeExt(tif, it->fillbufs);
+	_TIFFCondDestroy(it->cond);
+	_TIFFMutexDestroy(it->mutex);
+	_TIFFfreeExt(tif, it);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,580 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Sample statistics gathered while writing.
+ *
+ * Handles opened with the 'T' mode flag tally the samples given to
+ * TIFFWriteEncodedStrip(), TIFFWriteEncodedTile() and TIFFWriteScanline()
+ * before they are swabbed, predicted and compressed: the minimum, maximum
+ * and sum of each sample of each strip/tile, and a 256 bin histogram of
+ * each sample of the image.  The parts of the last strip and of the edge
+ * tiles that lie outside the image are left out, and so are NaN values.
+ *
+ * When the directory is written the minima and maxima go to the
+ * ChunkStatistics tag, two doubles for each sample of each strip/tile,
+ * so that readers can get them with TIFFGetChunkStatistics() without
+ * reading the image data.  A strip/tile not tallied has NaN for both, one
+ * holding only NaN values has +Inf and -Inf.  TIFFSelectChunks() goes
+ * through them at once to find the strips/tiles a query has to read.
+ */
+#include "tiffiop.h"
+#include <math.h>
+
+#define NBINS 256
+
+enum {
+	STATS_U8, STATS_I8, STATS_U16, STATS_I16, STATS_U32, STATS_I32,
+	STATS_U64, STATS_I64, STATS_F32, STATS_F64
+};
+
+struct _TIFFChunkStats {
+	int     kind;		/* STATS_*, or -1 if the samples are not handled */
+	int     bytes;		/* bytes per sample */
+	uint16  nsamples;	/* samples of a pixel in each strip/tile */
+	uint16  nplanes;	/* samples of a pixel in the image */
+	uint32  nstriles;	/* # strips/tiles with room in the arrays */
+	double* minmax;		/* minimum and maximum, by strip/tile and sample */
+	double* sum;		/* sum of the samples tallied, likewise */
+	uint64* count;		/* # samples tallied, likewise */
+	uint64* hist;		/* NBINS bins for each sample of the image */
+};
+
+/*
+ * Tally npix pixels of ns samples starting at p into the arrays, indexed
+ * by sample.  The separate loops for single sample data are meant to be
+ * vectorized by the compiler.
+ */
+#define TALLY_INT(name, type, acc, bin)					\
+static void								\
+name(const void* row, uint32 npix, uint16 ns, double* minmax,		\
+    double* sum, uint64* count, uint64* hist)				\
+{									\
+	const type* p = (const type*) row;				\
+	uint16 s;							\
+	uint32 i;							\
+									\
+	for (s = 0; s < ns; s++) {					\
+		type lo = p[s], hi = p[s];				\
+		acc total = 0;						\
+									\
+		if (ns == 1) {						\
+			for (i = 0; i < npix; i++) {			\
+				lo = p[i] < lo ? p[i] : lo;		\
+				hi = p[i] > hi ? p[i] : hi;		\
+				total += (acc) p[i];			\
+			}						\
+			if (hist)					\
+				for (i = 0; i < npix; i++)		\
+					hist[bin(p[i])]++;		\
+		} else {						\
+			for (i = 0; i < npix; i++) {			\
+				type v = p[(tmsize_t) i * ns + s];	\
+				lo = v < lo ? v : lo;			\
+				hi = v > hi ? v : hi;			\
+				total += (acc) v;			\
+				if (hist)				\
+					hist[s * NBINS + bin(v)]++;	\
+			}						\
+		}							\
+		if ((double) lo < minmax[2 * s])			\
+			minmax[2 * s] = (double) lo;			\
+		if ((double) hi > minmax[2 * s + 1])			\
+			minmax[2 * s + 1] = (double) hi;		\
+		sum[s] += (double) total;				\
+		count[s] += npix;					\
+	}								\
+}
+
+#define BIN_U8(v)	(v)
+#define BIN_I8(v)	((v) + 128)
+#define BIN_U16(v)	((v) >> 8)
+#define BIN_I16(v)	(((v) + 32768) >> 8)
+#define BIN_NONE(v)	0
+
+TALLY_INT(TallyU8, uint8, uint64, BIN_U8)
+TALLY_INT(TallyI8, int8, int64, BIN_I8)
+TALLY_INT(TallyU16, uint16, uint64, BIN_U16)
+TALLY_INT(TallyI16, int16, int64, BIN_I16)
+TALLY_INT(TallyU32, uint32, uint64, BIN_NONE)
+TALLY_INT(TallyI32, int32, int64, BIN_NONE)
+TALLY_INT(TallyU64, uint64, double, BIN_NONE)
+TALLY_INT(TallyI64, int64, double, BIN_NONE)
+
+/*
+ * NaN compares false, so it never becomes the minimum or the maximum and
+ * only has to be kept out of the sum and the count.
+ */
+#define TALLY_FLOAT(name, type)						\
+static void								\
+name(const void* row, uint32 npix, uint16 ns, double* minmax,		\
+    double* sum, uint64* count, uint64* hist)				\
+{									\
+	const type* p = (const type*) row;				\
+	uint16 s;							\
+	uint32 i;							\
+									\
+	(void) hist;							\
+	for (s = 0; s < ns; s++) {					\
+		double lo = minmax[2 * s], hi = minmax[2 * s + 1];	\
+		double total = 0;					\
+		uint64 n = 0;						\
+									\
+		for (i = 0; i < npix; i++) {				\
+			type v = p[(tmsize_t) i * ns + s];		\
+			int ok = (v == v);				\
+			lo = v < lo ? v : lo;				\
+			hi = v > hi ? v : hi;				\
+			total += ok ? v : 0;				\
+			n += ok;					\
+		}							\
+		minmax[2 * s] = lo;					\
+		minmax[2 * s + 1] = hi;					\
+		sum[s] += total;					\
+		count[s] += n;						\
+	}								\
+}
+
+TALLY_FLOAT(TallyF32, float)
+TALLY_FLOAT(TallyF64, double)
+
+typedef void (*TallyProc)(const void*, uint32, uint16, double*, double*,
+    uint64*, uint64*);
+
+static const TallyProc tallyProcs[] = {
+	TallyU8, TallyI8, TallyU16, TallyI16, TallyU32, TallyI32,
+	TallyU64, TallyI64, TallyF32, TallyF64
+};
+
+static int
+StatsKind(TIFFDirectory* td)
+{
+	int sf = td->td_sampleformat;
+
+	if (td->td_photometric == PHOTOMETRIC_YCBCR &&
+	    td->td_planarconfig == PLANARCONFIG_CONTIG &&
+	    (td->td_ycbcrsubsampling[0] != 1 || td->td_ycbcrsubsampling[1] != 1))
+		return (-1);
+	if (sf == SAMPLEFORMAT_IEEEFP)
+		return (td->td_bitspersample == 32 ? STATS_F32 :
+		    td->td_bitspersample == 64 ? STATS_F64 : -1);
+	if (sf != SAMPLEFORMAT_UINT && sf != SAMPLEFORMAT_INT &&
+	    sf != SAMPLEFORMAT_VOID)
+		return (-1);
+	switch (td->td_bitspersample) {
+		case 8:
+			return (sf == SAMPLEFORMAT_INT ? STATS_I8 : STATS_U8);
+		case 16:
+			return (sf == SAMPLEFORMAT_INT ? STATS_I16 : STATS_U16);
+		case 32:
+			return (sf == SAMPLEFORMAT_INT ? STATS_I32 : STATS_U32);
+		case 64:
+			return (sf == SAMPLEFORMAT_INT ? STATS_I64 : STATS_U64);
+	}
+	return (-1);
+}
+
+static double
+StatsNaN(void)
+{
+	double zero = 0;
+
+	return (zero / zero);
+}
+
+static void
+StatsUnknown(TIFFChunkStats* st, uint32 from, uint32 to)
+{
+	tmsize_t i;
+
+	for (i = (tmsize_t) from * st->nsamples;
+	    i < (tmsize_t) to * st->nsamples; i++) {
+		st->minmax[2 * i] = st->minmax[2 * i + 1] = StatsNaN();
+		st->sum[i] = 0;
+		st->count[i] = 0;
+	}
+}
+
+/*
+ * Make room for the statistics of all the strips/tiles of the directory.
+ * Returns NULL, having dropped the statistics of the directory, if memory
+ * runs out or the samples are of a kind not handled.
+ */
+TIFFChunkStats*
+_TIFFChunkStatsSetup(TIFF* tif)
+{
+	static const char module[] = "_TIFFChunkStatsSetup";
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFChunkStats* st = tif->tif_chunkstats;
+	uint32 n = td->td_nstrips;
+	tmsize_t nv;
+	double* minmax;
+	double* sum;
+	uint64* count;
+
+	if (!(tif->tif_flags & TIFF_CHUNKSTATS))
+		return (NULL);
+	if (st == NULL) {
+		st = (TIFFChunkStats*) _TIFFcallocExt(tif, 1, sizeof(TIFFChunkStats));
+		if (st == NULL)
+			goto bad;
+		tif->tif_chunkstats = st;
+		st->kind = StatsKind(td);
+		if (st->kind < 0)
+			return (NULL);
+		st->bytes = td->td_bitspersample / 8;
+		st->nplanes = td->td_samplesperpixel;
+		st->nsamples = td->td_planarconfig == PLANARCONFIG_SEPARATE ?
+		    1 : td->td_samplesperpixel;
+		st->hist = (uint64*) _TIFFcallocExt(tif, st->nplanes,
+		    NBINS * sizeof(uint64));
+		if (st->hist == NULL)
+			goto bad;
+	}
+	if (st->kind < 0)
+		return (NULL);
+	if (st->nstriles >= n)
+		return (st);
+	nv = (tmsize_t) n * st->nsamples;
+	minmax = (double*) _TIFFreallocExt(tif, st->minmax, nv * 2 * sizeof(double));
+	if (minmax != NULL)
+		st->minmax = minmax;
+	sum = (double*) _TIFFreallocExt(tif, st->sum, nv * sizeof(double));
+	if (sum != NULL)
+		st->sum = sum;
+	count = (uint64*) _TIFFreallocExt(tif, st->count, nv * sizeof(uint64));
+	if (count != NULL)
+		st->count = count;
+	if (minmax == NULL || sum == NULL || count == NULL)
+		goto bad;
+	StatsUnknown(st, st->nstriles, n);
+	st->nstriles = n;
+	return (st);
+bad:
+	TIFFWarningExtR(tif, module,
+	    "Out of memory, sample statistics not kept for this image");
+	_TIFFFreeChunkStats(tif);
+	tif->tif_chunkstats = (TIFFChunkStats*) _TIFFcallocExt(tif, 1,
+	    sizeof(TIFFChunkStats));
+	if (tif->tif_chunkstats != NULL)
+		tif->tif_chunkstats->kind = -1;
+	return (NULL);
+}
+
+void
+_TIFFFreeChunkStats(TIFF* tif)
+{
+	TIFFChunkStats* st = tif->tif_chunkstats;
+
+	if (st == NULL)
+		return;
+	if (st->minmax)
+		_TIFFfreeExt(tif, st->minmax);
+	if (st->sum)
+		_TIFFfreeExt(tif, st->sum);
+	if (st->count)
+		_TIFFfreeExt(tif, st->count);
+	if (st->hist)
+		_TIFFfreeExt(tif, st->hist);
+	_TIFFfreeExt(tif, st);
+	tif->tif_chunkstats = NULL;
+}
+
+/*
+ * Tally the cc bytes of buf, the rows of strip/tile strile from row on,
+ * starting over if reset is set.  The histogram of the image is updated
+ * under lock if one is given: the encoding workers of
+ * TIFFWriteEncodedTilesParallel() tally different strips/tiles at once,
+ * after _TIFFChunkStatsSetup() was called for all of them.
+ */
+void
+_TIFFChunkStatsTally(TIFF* tif, uint32 strile, const void* buf, tmsize_t cc,
+    uint32 row, int reset, TIFFMutex* lock)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFChunkStats* st;
+	uint32 width, height, depth, nrows, d, r;
+	tmsize_t rowsize, slicesize, off;
+	uint64* hist;
+	double* minmax;
+	uint16 ns, plane, s;
+
+	if ((st = _TIFFChunkStatsSetup(tif)) == NULL || strile >= st->nstriles)
+		return;
+	ns = st->nsamples;
+	plane = 0;
+	if (isTiled(tif)) {
+		uint32 across = TIFFhowmany_32(td->td_imagewidth, td->td_tilewidth);
+		uint32 down = TIFFhowmany_32(td->td_imagelength, td->td_tilelength);
+		uint32 slices = TIFFhowmany_32(td->td_imagedepth, td->td_tiledepth);
+		uint32 perplane = across * down * slices;
+		uint32 t = strile % perplane;
+
+		if (td->td_planarconfig == PLANARCONFIG_SEPARATE)
+			plane = (uint16)(strile / perplane);
+		width = td->td_imagewidth - (t % across) * td->td_tilewidth;
+		if (width > td->td_tilewidth)
+			width = td->td_tilewidth;
+		height = td->td_imagelength -
+		    ((t / across) % down) * td->td_tilelength;
+		if (height > td->td_tilelength)
+			height = td->td_tilelength;
+		depth = td->td_imagedepth - (t / (across * down)) * td->td_tiledepth;
+		if (depth > td->td_tiledepth)
+			depth = td->td_tiledepth;
+		rowsize = TIFFTileRowSize(tif);
+		slicesize = rowsize * td->td_tilelength;
+	} else {
+		uint32 spi = td->td_stripsperimage ? td->td_stripsperimage : 1;
+		uint32 first = (strile % spi) * td->td_rowsperstrip;
+
+		if (td->td_planarconfig == PLANARCONFIG_SEPARATE)
+			plane = (uint16)(strile / spi);
+		width = td->td_imagewidth;
+		height = first < td->td_imagelength ?
+		    td->td_imagelength - first : 0;
+		if (height > td->td_rowsperstrip)
+			height = td->td_rowsperstrip;
+		depth = 1;
+		rowsize = TIFFScanlineSize(tif);
+		slicesize = rowsize * td->td_rowsperstrip;
+	}
+	if ((tmsize_t) width * ns * st->bytes > rowsize)
+		width = (uint32)(rowsize / ((tmsize_t) ns * st->bytes));
+	if (width == 0 || row >= height || plane >= st->nplanes)
+		return;
+
+	minmax = st->minmax + (tmsize_t) 2 * strile * ns;
+	if (reset) {
+		for (s = 0; s < ns; s++) {
+			minmax[2 * s] = HUGE_VAL;
+			minmax[2 * s + 1] = -HUGE_VAL;
+			st->sum[(tmsize_t) strile * ns + s] = 0;
+			st->count[(tmsize_t) strile * ns + s] = 0;
+		}
+	} else if (minmax[0] != minmax[0]) {
+		/* rows of a strip not started over, e.g. after a short write */
+		for (s = 0; s < ns; s++) {
+			minmax[2 * s] = HUGE_VAL;
+			minmax[2 * s + 1] = -HUGE_VAL;
+		}
+	}
+	hist = NULL;
+	if (st->kind <= STATS_I16) {
+		hist = st->hist + (tmsize_t) plane * NBINS;
+		if (lock != NULL)
+			hist = (uint64*) _TIFFcallocExt(tif, ns, NBINS * sizeof(uint64));
+	}
+	for (d = 0, off = 0; d < depth; d++) {
+		nrows = height - (d == 0 ? row : 0);
+		for (r = 0; r < nrows; r++) {
+			off = d * slicesize + (tmsize_t) r * rowsize;
+			if (off + (tmsize_t) width * ns * st->bytes > cc)
+				break;
+			(*tallyProcs[st->kind])((const uint8*) buf + off, width,
+			    ns, minmax, st->sum + (tmsize_t) strile * ns,
+			    st->count + (tmsize_t) strile * ns, hist);
+		}
+		if (r < nrows)
+			break;
+	}
+	if (lock != NULL && hist != NULL) {
+		_TIFFMutexLock(lock);
+		for (s = 0; s < ns; s++)
+			for (r = 0; r < NBINS; r++)
+				st->hist[((tmsize_t) plane + s) * NBINS + r] +=
+				    hist[(tmsize_t) s * NBINS + r];
+		_TIFFMutexUnlock(lock);
+		_TIFFfreeExt(tif, hist);
+	}
+}
+
+/*
+ * Record the minima and maxima tallied in the ChunkStatistics tag of the
+ * directory about to be written.
+ */
+int
+_TIFFChunkStatsFlush(TIFF* tif)
+{
+	TIFFChunkStats* st;
+	uint32 n;
+
+	if ((st = _TIFFChunkStatsSetup(tif)) == NULL)
+		return (1);
+	n = tif->tif_dir.td_nstrips;
+	if ((uint64) n * st->nsamples * 2 > 0xFFFFFFFFU)
+		return (1);
+	return (TIFFSetField(tif, TIFFTAG_CHUNKSTATISTICS,
+	    (uint32)(n * st->nsamples * 2), st->minmax));
+}
+
+/*
+ * Return the minimum and maximum of the sample of strip/tile strile, a
+ * sample of the pixels of the strip/tile, so 0 for separate planes.  The
+ * tallies of the image being written are used if there are any, and the
+ * ChunkStatistics tag of the directory otherwise.  Returns 1 if the
+ * strip/tile was tallied, with min > max if it only held NaN values.
+ */
+int
+TIFFGetChunkStatistics(TIFF* tif, uint32 strile, uint16 sample,
+    double* min, double* max)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFChunkStats* st = tif->tif_chunkstats;
+	const double* minmax;
+	uint16 ns = td->td_planarconfig == PLANARCONFIG_SEPARATE ?
+	    1 : td->td_samplesperpixel;
+	uint32 count;
+	tmsize_t i;
+
+	if (sample >= ns || strile >= td->td_nstrips)
+		return (0);
+	i = (tmsize_t) strile * ns + sample;
+	if (st != NULL && st->kind >= 0 && strile < st->nstriles) {
+		minmax = st->minmax;
+	} else {
+		if (!TIFFGetField(tif, TIFFTAG_CHUNKSTATISTICS, &count, &minmax) ||
+		    (uint64) count < 2 * ((uint64) i + 1))
+			return (0);
+	}
+	if (minmax[2 * i] != minmax[2 * i] || minmax[2 * i + 1] != minmax[2 * i + 1])
+		return (0);
+	if (min)
+		*min = minmax[2 * i];
+	if (max)
+		*max = minmax[2 * i + 1];
+	return (1);
+}
+
+/*
+ * Return the minimum, maximum and mean of a sample of the image being
+ * written, and for 8 and 16 bit integer samples its histogram over 256
+ * bins (the value, or its high byte, offset to unsigned).  Only what was
+ * tallied since the directory was set up counts.  Returns 0 if nothing
+ * was tallied for the sample.
+ */
+int
+TIFFGetImageStatistics(TIFF* tif, uint16 sample, double* min, double* max,
+    double* mean, uint64* histogram)
+{
+	TIFFChunkStats* st = tif->tif_chunkstats;
+	double lo = HUGE_VAL, hi = -HUGE_VAL, total = 0;
+	uint64 n = 0;
+	uint32 strile, first = 0, last;
+	uint16 s = sample;
+
+	if (st == NULL || st->kind < 0 || sample >= st->nplanes)
+		return (0);
+	last = st->nstriles;
+	if (st->nsamples == 1 && st->nplanes > 1) {
+		uint32 per = st->nstriles / st->nplanes;
+
+		first = sample * per;
+		last = first + per;
+		s = 0;
+	}
+	for (strile = first; strile < last; strile++) {
+		tmsize_t i = (tmsize_t) strile * st->nsamples + s;
+
+		if (st->minmax[2 * i] != st->minmax[2 * i])
+			continue;
+		if (st->minmax[2 * i] < lo)
+			lo = st->minmax[2 * i];
+		if (st->minmax[2 * i + 1] > hi)
+			hi = st->minmax[2 * i + 1];
+		total += st->sum[i];
+		n += st->count[i];
+	}
+	if (n == 0)
+		return (0);
+	if (min)
+		*min = lo;
+	if (max)
+		*max = hi;
+	if (mean)
+		*mean = total / (double) n;
+	if (histogram)
+		_TIFFmemcpy(histogram, st->hist + (tmsize_t) sample * NBINS,
+		    NBINS * sizeof(uint64));
+	return (1);
+}
+
+/*
+ * Put in striles the numbers of the strips/tiles holding sample sample of
+ * the image that may have a value within lo..hi or, with
+ * TIFF_SELECT_OUTSIDE, a value outside it, judging by their minima and
+ * maxima.  Strips/tiles without statistics may have anything.  Returns
+ * the number of strips/tiles selected, of which the first maxstriles are
+ * stored.
+ */
+uint32
+TIFFSelectChunks(TIFF* tif, uint16 sample, double lo, double hi, int how,
+    uint32* striles, uint32 maxstriles)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFChunkStats* st = tif->tif_chunkstats;
+	const double* minmax = NULL;
+	uint64 count = 0;
+	uint32 strile, first = 0, last = td->td_nstrips, n = 0;
+	uint16 ns = 1, s = 0;
+
+	if (sample >= td->td_samplesperpixel)
+		return (0);
+	if (td->td_planarconfig == PLANARCONFIG_SEPARATE) {
+		uint32 per = td->td_nstrips / td->td_samplesperpixel;
+
+		first = sample * per;
+		last = first + per;
+	} else {
+		ns = td->td_samplesperpixel;
+		s = sample;
+	}
+	if (st != NULL && st->kind >= 0) {
+		minmax = st->minmax;
+		count = (uint64) 2 * st->nstriles * ns;
+	} else {
+		uint32 nv;
+
+		if (TIFFGetField(tif, TIFFTAG_CHUNKSTATISTICS, &nv, &minmax))
+			count = nv;
+	}
+	for (strile = first; strile < last; strile++) {
+		uint64 i = (uint64) strile * ns + s;
+
+		if (2 * i + 1 < count) {
+			double min = minmax[2 * i], max = minmax[2 * i + 1];
+
+			/* an empty range, of NaN only, is skipped either way */
+			if (min == min && max == max &&
+			    (how == TIFF_SELECT_OUTSIDE ? min >= lo && max <= hi :
+			    min > hi || max < lo))
+				continue;
+		}
+		if (n < maxstriles)
+			striles[n] = strile;
+		n++;
+	}
+	return (n);
+}
@@ -44,16 +44,45 @@
 void
 TIFFCleanup(TIFF* tif)
 {
+	TIFF* tmpl = tif->tif_template;
+	thandle_t io = tif->tif_clientdata;
+
+	/* A template is freed with the last of its clones */
+	_TIFFFreeChunkDecoders(tif);
+	if (_TIFFKeepTemplate(tif, 0))
+		return;
 	/*
          * Flush buffered data and directory (if dirty).
          */
 	if (tif->tif_mode != O_RDONLY)
 		TIFFFlush(tif);
+	_TIFFFreeDecodeWorkers(tif);
+	_TIFFFreeChunkEncoders(tif);
+	_TIFFFreePrefetch(tif);
+	_TIFFFreeCheckpoints(tif);
+	_TIFFFreeDirCache(tif);
+	_TIFFFreeBlockCache(tif);
+	_TIFFFreeChunkCache(tif);
+	(void) _TIFFFreeWriteBuffer(tif);
+	_TIFFFreeStats(tif);
+	_TIFFFreeScratch(tif);
+	_TIFFFreeAllocProfile(tif);
 	(*tif->tif_cleanup)(tif);
+#ifdef JPEG_SUPPORT
+	_TIFFFreeJPEGDecoders(tif);
+#endif
 	TIFFFreeDirectory(tif);
 
 	if (tif->tif_dirlist)
-		_TIFFfree(tif->tif_dirlist);
+		_TIFFfreeExt(tif, tif->tif_dirlist);
+	if (tif->tif_dirset)
+		_TIFFfreeExt(tif, tif->tif_dirset);
+	if (tif->tif_dirindex)
+		_TIFFfreeExt(tif, tif->tif_dirindex);
+	if (tif->tif_ovrindex)
+		_TIFFfreeExt(tif, tif->tif_ovrindex);
+	if (tif->tif_dedup)
+		_TIFFfreeExt(tif, tif->tif_dedup);
 
 	/*
          * Clean up client info links.
@@ -63,44 +92,33 @@ TIFFCleanup(TIFF* tif)
 		TIFFClientInfoLink *psLink = tif->tif_clientinfo;
 
 		tif->tif_clientinfo = psLink->next;
-		_TIFFfree( psLink->name );
-		_TIFFfree( psLink );
+		_TIFFfreeExt(tif,  psLink->name );
+		_TIFFfreeExt(tif,  psLink );
 	}
 
 	if (tif->tif_rawdata && (tif->tif_flags&TIFF_MYBUFFER))
-		_TIFFfree(tif->tif_rawdata);
+		_TIFFfreeExt(tif, tif->tif_rawdata);
 	if (isMapped(tif))
 		TIFFUnmapFileContents(tif, tif->tif_base, (toff_t)tif->tif_size);
 
 	/*
          * Clean up custom fields.
          */
-	if (tif->tif_fields && tif->tif_nfields > 0) {
-		uint32 i;
-
-		for (i = 0; i < tif->tif_nfields; i++) {
-			TIFFField *fld = tif->tif_fields[i];
-			if (fld->field_bit == FIELD_CUSTOM &&
-			    strncmp("Tag ", fld->field_name, 4) == 0) {
-				_TIFFfree(fld->field_name);
-				_TIFFfree(fld);
-			}
-		}
-
-		_TIFFfree(tif->tif_fields);
-	}
+	_TIFFFreeFields(tif);
 
         if (tif->tif_nfieldscompat > 0) {
                 uint32 i;
 
                 for (i = 0; i < tif->tif_nfieldscompat; i++) {
                         if (tif->tif_fieldscompat[i].allocated_size)
-                                _TIFFfree(tif->tif_fieldscompat[i].fields);
+                                _TIFFfreeExt(tif, tif->tif_fieldscompat[i].fields);
                 }
-                _TIFFfree(tif->tif_fieldscompat);
+                _TIFFfreeExt(tif, tif->tif_fieldscompat);
         }
 
-	_TIFFfree(tif);
+	_TIFFFreeHandle(tif);
+	if (tmpl != NULL)
+		_TIFFReleaseTemplate(tmpl, io);
 }
 
 /************************************************************************/
@@ -123,6 +141,10 @@ TIFFClose(TIFF* tif)
 	TIFFCloseProc closeproc = tif->tif_closeproc;
 	thandle_t fd = tif->tif_clientdata;
 
+	/* Idle decoder clones would otherwise keep the handle open */
+	_TIFFFreeChunkDecoders(tif);
+	if (_TIFFKeepTemplate(tif, 1))
+		return;
 	TIFFCleanup(tif);
 	(void) (*closeproc)(fd);
 }
@@ -73,6 +73,15 @@ static int NotConfigured(TIFF*, int);
 #ifndef ZSTD_SUPPORT
 #define TIFFInitZSTD NotConfigured
 #endif
+#ifndef LZ4_SUPPORT
+#define TIFFInitLZ4 NotConfigured
+#endif
+#ifndef LERC_SUPPORT
+#define TIFFInitLERC NotConfigured
+#endif
+#ifndef WEBP_SUPPORT
+#define TIFFInitWebP NotConfigured
+#endif
 
 /*
  * Compression schemes statically built into the library.
@@ -101,6 +110,9 @@ TIFFCodec _TIFFBuiltinCODECS[] = {
     { "SGILog24",	COMPRESSION_SGILOG24,	TIFFInitSGILog },
     { "LZMA",		COMPRESSION_LZMA,	TIFFInitLZMA },
     { "ZSTD",		COMPRESSION_ZSTD,	TIFFInitZSTD },
+    { "LZ4",		COMPRESSION_LZ4,	TIFFInitLZ4 },
+    { "LERC",		COMPRESSION_LERC,	TIFFInitLERC },
+    { "WebP",		COMPRESSION_WEBP,	TIFFInitWebP },
     { NULL,             0,                      NULL }
 };
 
@@ -111,7 +123,7 @@ _notConfigured(TIFF* tif)
         char compression_code[20];
         
         sprintf(compression_code, "%d",tif->tif_dir.td_compression );
-	TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+	TIFFErrorExtR(tif, tif->tif_name,
                      "%s compression support is not configured", 
                      c ? c->name : compression_code );
 	return (0);
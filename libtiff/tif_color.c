@@ -37,6 +37,14 @@
 #include "tiffiop.h"
 #include <math.h>
 
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#elif defined(TIFF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
 /*
  * Convert color value from the CIE L*a*b* 1976 space to CIE XYZ.
  */
@@ -165,6 +173,69 @@ TIFFCIELabToRGBInit(TIFFCIELabToRGB* cielab,
 	return 0;
 }
 
+/*
+ * Fill in the interpolation cube used for 8-bit L*a*b* data by the RGBA
+ * reader.  Every CIELABCUBE_STEP-th value of L* and of a* and b* (offset
+ * by 128) is a node holding, for each of R, G and B, the luminosity
+ * table index of TIFFXYZToRGB() before clipping, in eighths and offset
+ * by CIELABCUBE_BIAS.  The indices are a smooth function of L*a*b*, so
+ * that interpolating them is accurate; tab maps clipped indices to the
+ * display values as TIFFXYZToRGB() does, first for R, then G and B.
+ */
+void
+_TIFFCIELabToRGBCube(TIFFCIELabToRGB* cielab, int16* cube, uint8* tab)
+{
+	float *matrix = &cielab->display.d_mat[0][0];
+	float *Y2v[3];
+	float Y0[3], step[3];
+	uint32 Vrw[3];
+	int l, a, b, c, i;
+
+	Y2v[0] = cielab->Yr2r;
+	Y2v[1] = cielab->Yg2g;
+	Y2v[2] = cielab->Yb2b;
+	Y0[0] = cielab->display.d_Y0R;
+	Y0[1] = cielab->display.d_Y0G;
+	Y0[2] = cielab->display.d_Y0B;
+	step[0] = cielab->rstep;
+	step[1] = cielab->gstep;
+	step[2] = cielab->bstep;
+	Vrw[0] = cielab->display.d_Vrwr;
+	Vrw[1] = cielab->display.d_Vrwg;
+	Vrw[2] = cielab->display.d_Vrwb;
+
+	for (l = 0; l < CIELABCUBE_NODES; l++)
+	    for (a = 0; a < CIELABCUBE_NODES; a++)
+		for (b = 0; b < CIELABCUBE_NODES; b++) {
+			float X, Y, Z, v[3];
+
+			TIFFCIELabToXYZ(cielab, l * CIELABCUBE_STEP,
+			    a * CIELABCUBE_STEP - 128, b * CIELABCUBE_STEP - 128,
+			    &X, &Y, &Z);
+			v[0] = matrix[0] * X + matrix[1] * Y + matrix[2] * Z;
+			v[1] = matrix[3] * X + matrix[4] * Y + matrix[5] * Z;
+			v[2] = matrix[6] * X + matrix[7] * Y + matrix[8] * Z;
+			for (c = 0; c < 3; c++) {
+				float f = (float) floor(8.0 * (v[c] - Y0[c]) / step[c]);
+
+				if (f < -CIELABCUBE_BIAS)
+					f = -CIELABCUBE_BIAS;
+				if (f > 32767 - CIELABCUBE_BIAS)
+					f = 32767 - CIELABCUBE_BIAS;
+				*cube++ = (int16) ((int) f + CIELABCUBE_BIAS);
+			}
+			*cube++ = 0;
+		}
+
+	for (c = 0; c < 3; c++)
+		for (i = 0; i <= cielab->range; i++) {
+			float v = Y2v[c][i];
+			uint32 u = (uint32) (v > 0 ? v + 0.5 : v - 0.5);
+
+			*tab++ = (uint8) TIFFmin(u, Vrw[c]);
+		}
+}
+
 /* 
  * Convert color value from the YCbCr space to CIE XYZ.
  * The colorspace conversion algorithm comes from the IJG v5a code;
@@ -214,6 +285,24 @@ static float CLAMPw(float v, float vmin, float vmax)
     return v;
 }
 
+/*
+ * Fixed point coefficients of the conversion below: Cr for red, Cr
+ * for green, Cb for blue and Cb for green.
+ */
+static void
+YCbCrCoefficients(const float *luma, int32 D[4])
+{
+    float f1 = 2-2*luma[0];
+    float f2 = luma[0]*f1/luma[1];
+    float f3 = 2-2*luma[2];
+    float f4 = luma[2]*f3/luma[1];
+
+    D[0] = FIX(CLAMP(f1,0.0F,2.0F));
+    D[1] = -FIX(CLAMP(f2,0.0F,2.0F));
+    D[2] = FIX(CLAMP(f3,0.0F,2.0F));
+    D[3] = -FIX(CLAMP(f4,0.0F,2.0F));
+}
+
 /*
  * Initialize the YCbCr->RGB conversion tables.  The conversion
  * is done according to the 6.0 spec:
@@ -236,10 +325,6 @@ TIFFYCbCrToRGBInit(TIFFYCbCrToRGB* ycbcr, float *luma, float *refBlackWhite)
     TIFFRGBValue* clamptab;
     int i;
     
-#define LumaRed	    luma[0]
-#define LumaGreen   luma[1]
-#define LumaBlue    luma[2]
-
     clamptab = (TIFFRGBValue*)(
 	(uint8*) ycbcr+TIFFroundup_32(sizeof (TIFFYCbCrToRGB), sizeof (long)));  
     _TIFFmemset(clamptab, 0, 256);		/* v < 0 => 0 */
@@ -253,15 +338,10 @@ TIFFYCbCrToRGBInit(TIFFYCbCrToRGB* ycbcr, float *luma, float *refBlackWhite)
     ycbcr->Cb_g_tab = ycbcr->Cr_g_tab + 256;
     ycbcr->Y_tab = ycbcr->Cb_g_tab + 256;
 
-    { float f1 = 2-2*LumaRed;		int32 D1 = FIX(CLAMP(f1,0.0F,2.0F));
-      float f2 = LumaRed*f1/LumaGreen;	int32 D2 = -FIX(CLAMP(f2,0.0F,2.0F));
-      float f3 = 2-2*LumaBlue;		int32 D3 = FIX(CLAMP(f3,0.0F,2.0F));
-      float f4 = LumaBlue*f3/LumaGreen;	int32 D4 = -FIX(CLAMP(f4,0.0F,2.0F));
+    { int32 D[4];
       int x;
 
-#undef LumaBlue
-#undef LumaGreen
-#undef LumaRed
+      YCbCrCoefficients(luma, D);
       
       /*
        * i is the actual input pixel value in the range 0..255
@@ -278,10 +358,10 @@ TIFFYCbCrToRGBInit(TIFFYCbCrToRGB* ycbcr, float *luma, float *refBlackWhite)
 			    refBlackWhite[3] - 128.0F, 127),
                             -128.0F * 32, 128.0F * 32);
 
-	    ycbcr->Cr_r_tab[i] = (int32)((D1*Cr + ONE_HALF)>>SHIFT);
-	    ycbcr->Cb_b_tab[i] = (int32)((D3*Cb + ONE_HALF)>>SHIFT);
-	    ycbcr->Cr_g_tab[i] = D2*Cr;
-	    ycbcr->Cb_g_tab[i] = D4*Cb + ONE_HALF;
+	    ycbcr->Cr_r_tab[i] = (int32)((D[0]*Cr + ONE_HALF)>>SHIFT);
+	    ycbcr->Cb_b_tab[i] = (int32)((D[2]*Cb + ONE_HALF)>>SHIFT);
+	    ycbcr->Cr_g_tab[i] = D[1]*Cr;
+	    ycbcr->Cb_g_tab[i] = D[3]*Cb + ONE_HALF;
 	    ycbcr->Y_tab[i] =
 		    (int32)CLAMPw(Code2V(x + 128, refBlackWhite[0], refBlackWhite[1], 255),
                                   -128.0F * 32, 128.0F * 32);
@@ -290,6 +370,36 @@ TIFFYCbCrToRGBInit(TIFFYCbCrToRGB* ycbcr, float *luma, float *refBlackWhite)
 
     return 0;
 }
+
+/*
+ * Return the fixed point coefficients D (see YCbCrCoefficients()) of
+ * tables set up by TIFFYCbCrToRGBInit(), for converters that compute
+ *
+ *    R = Y + ((D[0]*Cr + 2^15) >> 16)
+ *    G = Y + ((D[3]*Cb + D[1]*Cr + 2^15) >> 16)
+ *    B = Y + ((D[2]*Cb + 2^15) >> 16)
+ *
+ * with Cb and Cr centered on 0 instead of looking the terms up.  This
+ * only holds, and 1 is returned, if the ReferenceBlackWhite mapping
+ * is the identity; otherwise 0 is returned.
+ */
+int
+_TIFFYCbCrFixedPoint(const TIFFYCbCrToRGB* ycbcr, const float *luma,
+    int32 D[4])
+{
+    int32 i, x;
+
+    YCbCrCoefficients(luma, D);
+    for (i = 0, x = -128; i < 256; i++, x++) {
+	if (ycbcr->Y_tab[i] != i ||
+	    ycbcr->Cr_r_tab[i] != (int32)((D[0]*x + ONE_HALF)>>SHIFT) ||
+	    ycbcr->Cb_b_tab[i] != (int32)((D[2]*x + ONE_HALF)>>SHIFT) ||
+	    ycbcr->Cr_g_tab[i] != D[1]*x ||
+	    ycbcr->Cb_g_tab[i] != D[3]*x + ONE_HALF)
+	    return 0;
+    }
+    return 1;
+}
 #undef	HICLAMP
 #undef	CLAMP
 #undef	Code2V
@@ -297,6 +407,523 @@ TIFFYCbCrToRGBInit(TIFFYCbCrToRGB* ycbcr, float *luma, float *refBlackWhite)
 #undef	ONE_HALF
 #undef	FIX
 
+/*
+ * Weighted sums of 8-bit red, green and blue samples, for the
+ * conversion of RGB images to greyscale: out[i] is the low byte of
+ *
+ *    (weights[0]*r[i*step] + weights[1]*g[i*step] + weights[2]*b[i*step]) >> 8
+ *
+ * computed in int arithmetic.  The kernels handle contiguous samples
+ * (step 3, with g = r + 1 and b = r + 2) and separate planes (step 1),
+ * with weights from 0 to 32767.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSE2
+static __m128i
+rgbGrey16SSE2(__m128i r, __m128i g, __m128i b, __m128i wrg, __m128i wb)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask = _mm_set1_epi32(0xff);
+	__m128i r16[2], g16[2], b16[2], s[4];
+	int i;
+
+	r16[0] = _mm_unpacklo_epi8(r, zero);
+	r16[1] = _mm_unpackhi_epi8(r, zero);
+	g16[0] = _mm_unpacklo_epi8(g, zero);
+	g16[1] = _mm_unpackhi_epi8(g, zero);
+	b16[0] = _mm_unpacklo_epi8(b, zero);
+	b16[1] = _mm_unpackhi_epi8(b, zero);
+	for (i = 0; i < 2; i++) {
+		s[2 * i] = _mm_add_epi32(
+		    _mm_madd_epi16(_mm_unpacklo_epi16(r16[i], g16[i]), wrg),
+		    _mm_madd_epi16(_mm_unpacklo_epi16(b16[i], zero), wb));
+		s[2 * i + 1] = _mm_add_epi32(
+		    _mm_madd_epi16(_mm_unpackhi_epi16(r16[i], g16[i]), wrg),
+		    _mm_madd_epi16(_mm_unpackhi_epi16(b16[i], zero), wb));
+	}
+	for (i = 0; i < 4; i++)
+		s[i] = _mm_and_si128(_mm_srli_epi32(s[i], 8), mask);
+	return (_mm_packus_epi16(_mm_packs_epi32(s[0], s[1]),
+	    _mm_packs_epi32(s[2], s[3])));
+}
+
+TIFF_TARGET_SSE2
+static uint32
+rgbGrey8SSE2(uint8* out, const uint8* r, const uint8* g, const uint8* b,
+    uint32 n, int step, const int32* weights)
+{
+	const __m128i wrg = _mm_set1_epi32((weights[1] << 16) | weights[0]);
+	const __m128i wb = _mm_set1_epi32(weights[2]);
+	uint32 i;
+
+	if (step != 1)
+		return (0);
+	for (i = 0; i + 16 <= n; i += 16)
+		_mm_storeu_si128((__m128i*) (out + i), rgbGrey16SSE2(
+		    _mm_loadu_si128((const __m128i*) (r + i)),
+		    _mm_loadu_si128((const __m128i*) (g + i)),
+		    _mm_loadu_si128((const __m128i*) (b + i)), wrg, wb));
+	return (i);
+}
+
+/*
+ * The 16 pixels of 3 vectors of contiguous samples are sorted by
+ * kind with one shuffle of each vector per kind.
+ */
+TIFF_TARGET_SSSE3
+static uint32
+rgbGrey8SSSE3(uint8* out, const uint8* r, const uint8* g, const uint8* b,
+    uint32 n, int step, const int32* weights)
+{
+	const __m128i wrg = _mm_set1_epi32((weights[1] << 16) | weights[0]);
+	const __m128i wb = _mm_set1_epi32(weights[2]);
+	const __m128i ra = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -128, -128,
+	    -128, -128, -128, -128, -128, -128, -128, -128);
+	const __m128i rb = _mm_setr_epi8(-128, -128, -128, -128, -128, -128,
+	    2, 5, 8, 11, 14, -128, -128, -128, -128, -128);
+	const __m128i rc = _mm_setr_epi8(-128, -128, -128, -128, -128, -128,
+	    -128, -128, -128, -128, -128, 1, 4, 7, 10, 13);
+	const __m128i ga = _mm_setr_epi8(1, 4, 7, 10, 13, -128, -128, -128,
+	    -128, -128, -128, -128, -128, -128, -128, -128);
+	const __m128i gb = _mm_setr_epi8(-128, -128, -128, -128, -128,
+	    0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128);
+	const __m128i gc = _mm_setr_epi8(-128, -128, -128, -128, -128, -128,
+	    -128, -128, -128, -128, -128, 2, 5, 8, 11, 14);
+	const __m128i ba = _mm_setr_epi8(2, 5, 8, 11, 14, -128, -128, -128,
+	    -128, -128, -128, -128, -128, -128, -128, -128);
+	const __m128i bb = _mm_setr_epi8(-128, -128, -128, -128, -128,
+	    1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128);
+	const __m128i bc = _mm_setr_epi8(-128, -128, -128, -128, -128, -128,
+	    -128, -128, -128, -128, 0, 3, 6, 9, 12, 15);
+	uint32 i;
+
+	if (step == 1)
+		return (rgbGrey8SSE2(out, r, g, b, n, step, weights));
+	if (step != 3)
+		return (0);
+	for (i = 0; i + 16 <= n; i += 16, r += 48) {
+		__m128i va = _mm_loadu_si128((const __m128i*) r);
+		__m128i vb = _mm_loadu_si128((const __m128i*) (r + 16));
+		__m128i vc = _mm_loadu_si128((const __m128i*) (r + 32));
+
+		_mm_storeu_si128((__m128i*) (out + i), rgbGrey16SSE2(
+		    _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(va, ra),
+		    _mm_shuffle_epi8(vb, rb)), _mm_shuffle_epi8(vc, rc)),
+		    _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(va, ga),
+		    _mm_shuffle_epi8(vb, gb)), _mm_shuffle_epi8(vc, gc)),
+		    _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(va, ba),
+		    _mm_shuffle_epi8(vb, bb)), _mm_shuffle_epi8(vc, bc)),
+		    wrg, wb));
+	}
+	return (i);
+}
+#elif defined(TIFF_SIMD_NEON)
+static uint8x8_t
+rgbGrey8x8NEON(uint8x8_t r, uint8x8_t g, uint8x8_t b, const int32* weights)
+{
+	uint16x8_t r16 = vmovl_u8(r), g16 = vmovl_u8(g), b16 = vmovl_u8(b);
+	uint32x4_t lo, hi;
+
+	lo = vmull_n_u16(vget_low_u16(r16), (uint16) weights[0]);
+	lo = vmlal_n_u16(lo, vget_low_u16(g16), (uint16) weights[1]);
+	lo = vmlal_n_u16(lo, vget_low_u16(b16), (uint16) weights[2]);
+	hi = vmull_n_u16(vget_high_u16(r16), (uint16) weights[0]);
+	hi = vmlal_n_u16(hi, vget_high_u16(g16), (uint16) weights[1]);
+	hi = vmlal_n_u16(hi, vget_high_u16(b16), (uint16) weights[2]);
+	/* the narrowing moves keep the low bits */
+	return (vmovn_u16(vcombine_u16(vshrn_n_u32(lo, 8),
+	    vshrn_n_u32(hi, 8))));
+}
+
+static uint32
+rgbGrey8NEON(uint8* out, const uint8* r, const uint8* g, const uint8* b,
+    uint32 n, int step, const int32* weights)
+{
+	uint8x16x3_t v;
+	uint32 i;
+
+	if (step != 1 && step != 3)
+		return (0);
+	for (i = 0; i + 16 <= n; i += 16) {
+		if (step == 3)
+			v = vld3q_u8(r + 3 * i);
+		else {
+			v.val[0] = vld1q_u8(r + i);
+			v.val[1] = vld1q_u8(g + i);
+			v.val[2] = vld1q_u8(b + i);
+		}
+		vst1q_u8(out + i, vcombine_u8(
+		    rgbGrey8x8NEON(vget_low_u8(v.val[0]),
+		    vget_low_u8(v.val[1]), vget_low_u8(v.val[2]), weights),
+		    rgbGrey8x8NEON(vget_high_u8(v.val[0]),
+		    vget_high_u8(v.val[1]), vget_high_u8(v.val[2]), weights)));
+	}
+	return (i);
+}
+#endif
+
+/*
+ * Conversion of RGBA pixels, packed as by TIFFRGBAImage, to YCbCr in
+ * 14-bit fixed point.  coeffs[] holds the weights of red, green and
+ * blue in the luminance code, its offset, then the weights in the Cb
+ * and Cr values: y[i] is the clamped luminance code, and cb[i] and
+ * cr[i] are the chrominance values before they are averaged over a
+ * clump and offset.  The kernels take weights from -32768 to 32767.
+ */
+#define	YCBCR_SHIFT	14
+#define	YCBCR_BLOCK	256		/* pixels converted at a time */
+
+#if defined(TIFF_SIMD_X86)
+/*
+ * Weighted sums of the red, green and blue samples of 4 pixels, given
+ * as two vectors of 16-bit samples and weights for one pixel pair.
+ */
+TIFF_TARGET_SSE2
+static __m128i
+rgbSum4SSE2(__m128i lo, __m128i hi, __m128i w)
+{
+	__m128 a = _mm_castsi128_ps(_mm_madd_epi16(lo, w));
+	__m128 b = _mm_castsi128_ps(_mm_madd_epi16(hi, w));
+
+	/* each pixel has a red and green term, then a blue one */
+	return (_mm_add_epi32(
+	    _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))),
+	    _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)))));
+}
+
+TIFF_TARGET_SSE2
+static uint32
+rgbYCbCr8SSE2(uint8* y, int32* cb, int32* cr, const uint32* rgba,
+    uint32 n, const int32* coeffs)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wy = _mm_setr_epi16((int16) coeffs[0],
+	    (int16) coeffs[1], (int16) coeffs[2], 0, (int16) coeffs[0],
+	    (int16) coeffs[1], (int16) coeffs[2], 0);
+	const __m128i wb = _mm_setr_epi16((int16) coeffs[4],
+	    (int16) coeffs[5], (int16) coeffs[6], 0, (int16) coeffs[4],
+	    (int16) coeffs[5], (int16) coeffs[6], 0);
+	const __m128i wr = _mm_setr_epi16((int16) coeffs[7],
+	    (int16) coeffs[8], (int16) coeffs[9], 0, (int16) coeffs[7],
+	    (int16) coeffs[8], (int16) coeffs[9], 0);
+	const __m128i yoff = _mm_set1_epi32(coeffs[3]);
+	uint32 i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m128i v0 = _mm_loadu_si128((const __m128i*) (rgba + i));
+		__m128i v1 = _mm_loadu_si128((const __m128i*) (rgba + i + 4));
+		__m128i p0 = _mm_unpacklo_epi8(v0, zero);
+		__m128i p1 = _mm_unpackhi_epi8(v0, zero);
+		__m128i p2 = _mm_unpacklo_epi8(v1, zero);
+		__m128i p3 = _mm_unpackhi_epi8(v1, zero);
+		__m128i y0, y1;
+
+		y0 = _mm_srai_epi32(_mm_add_epi32(rgbSum4SSE2(p0, p1, wy),
+		    yoff), YCBCR_SHIFT);
+		y1 = _mm_srai_epi32(_mm_add_epi32(rgbSum4SSE2(p2, p3, wy),
+		    yoff), YCBCR_SHIFT);
+		y0 = _mm_packs_epi32(y0, y1);
+		_mm_storel_epi64((__m128i*) (y + i), _mm_packus_epi16(y0, y0));
+		_mm_storeu_si128((__m128i*) (cb + i), rgbSum4SSE2(p0, p1, wb));
+		_mm_storeu_si128((__m128i*) (cb + i + 4),
+		    rgbSum4SSE2(p2, p3, wb));
+		_mm_storeu_si128((__m128i*) (cr + i), rgbSum4SSE2(p0, p1, wr));
+		_mm_storeu_si128((__m128i*) (cr + i + 4),
+		    rgbSum4SSE2(p2, p3, wr));
+	}
+	return (i);
+}
+#elif defined(TIFF_SIMD_NEON) && !defined(WORDS_BIGENDIAN)
+static int32x4_t
+rgbSum4NEON(int32x4_t acc, int16x4_t r, int16x4_t g, int16x4_t b,
+    const int32* w)
+{
+	acc = vmlal_n_s16(acc, r, (int16) w[0]);
+	acc = vmlal_n_s16(acc, g, (int16) w[1]);
+	return (vmlal_n_s16(acc, b, (int16) w[2]));
+}
+
+static uint32
+rgbYCbCr8NEON(uint8* y, int32* cb, int32* cr, const uint32* rgba,
+    uint32 n, const int32* coeffs)
+{
+	const int32x4_t zero = vdupq_n_s32(0);
+	const int32x4_t yoff = vdupq_n_s32(coeffs[3]);
+	uint32 i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		uint8x8x4_t v = vld4_u8((const uint8*) (rgba + i));
+		int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(v.val[0]));
+		int16x8_t g = vreinterpretq_s16_u16(vmovl_u8(v.val[1]));
+		int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(v.val[2]));
+		int16x4_t rl = vget_low_s16(r), rh = vget_high_s16(r);
+		int16x4_t gl = vget_low_s16(g), gh = vget_high_s16(g);
+		int16x4_t bl = vget_low_s16(b), bh = vget_high_s16(b);
+
+		vst1_u8(y + i, vqmovun_s16(vcombine_s16(
+		    vqshrn_n_s32(rgbSum4NEON(yoff, rl, gl, bl, coeffs),
+		    YCBCR_SHIFT),
+		    vqshrn_n_s32(rgbSum4NEON(yoff, rh, gh, bh, coeffs),
+		    YCBCR_SHIFT))));
+		vst1q_s32(cb + i, rgbSum4NEON(zero, rl, gl, bl, coeffs + 4));
+		vst1q_s32(cb + i + 4, rgbSum4NEON(zero, rh, gh, bh, coeffs + 4));
+		vst1q_s32(cr + i, rgbSum4NEON(zero, rl, gl, bl, coeffs + 7));
+		vst1q_s32(cr + i + 4, rgbSum4NEON(zero, rh, gh, bh, coeffs + 7));
+	}
+	return (i);
+}
+#endif
+
+/*
+ * Expansion of 8-bit palette indices to contiguous 8-bit RGB through
+ * a map of 256 entries packed as by TIFFRGBAImage.  The AVX2 kernel
+ * gathers 8 entries at a time; the SSSE3 one loads them one by one.
+ * Both store a few bytes past the pixels they convert, so they stop
+ * short of the end of dst.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSSE3
+static tmsize_t
+palette8SSSE3(uint8* dst, const uint8* src, tmsize_t n, const uint32* map)
+{
+	const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+	    12, 13, 14, -128, -128, -128, -128);
+	tmsize_t i;
+
+	for (i = 0; i + 6 <= n; i += 4)
+		_mm_storeu_si128((__m128i*) (dst + 3 * i), _mm_shuffle_epi8(
+		    _mm_setr_epi32((int) map[src[i]], (int) map[src[i + 1]],
+		    (int) map[src[i + 2]], (int) map[src[i + 3]]), pack));
+	return (i);
+}
+
+TIFF_TARGET_AVX2
+static tmsize_t
+palette8AVX2(uint8* dst, const uint8* src, tmsize_t n, const uint32* map)
+{
+	const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+	    12, 13, 14, -128, -128, -128, -128, 0, 1, 2, 4, 5, 6, 8, 9, 10,
+	    12, 13, 14, -128, -128, -128, -128);
+	tmsize_t i;
+
+	for (i = 0; i + 10 <= n; i += 8) {
+		__m256i v = _mm256_i32gather_epi32((const int*) map,
+		    _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+		    (const __m128i*) (src + i))), 4);
+
+		v = _mm256_shuffle_epi8(v, pack);
+		_mm_storeu_si128((__m128i*) (dst + 3 * i),
+		    _mm256_castsi256_si128(v));
+		_mm_storeu_si128((__m128i*) (dst + 3 * i + 12),
+		    _mm256_extracti128_si256(v, 1));
+	}
+	return (i);
+}
+#endif
+
+void
+_TIFFColorKernels(TIFFKernels* k, int features)
+{
+#if defined(TIFF_SIMD_X86)
+	if (features & TIFF_CPU_SSSE3)
+		k->rgbGrey8 = rgbGrey8SSSE3;
+	else if (features & TIFF_CPU_SSE2)
+		k->rgbGrey8 = rgbGrey8SSE2;
+	if (features & TIFF_CPU_SSE2)
+		k->rgbYCbCr8 = rgbYCbCr8SSE2;
+	if (features & TIFF_CPU_AVX2)
+		k->palette8 = palette8AVX2;
+	else if (features & TIFF_CPU_SSSE3)
+		k->palette8 = palette8SSSE3;
+#elif defined(TIFF_SIMD_NEON)
+	if (features & TIFF_CPU_NEON)
+		k->rgbGrey8 = rgbGrey8NEON;
+#if !defined(WORDS_BIGENDIAN)
+	if (features & TIFF_CPU_NEON)
+		k->rgbYCbCr8 = rgbYCbCr8NEON;
+#endif
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+/*
+ * Convert n RGB pixels to 8-bit grey levels, each the sum of its red,
+ * green and blue samples times weights[0], weights[1] and weights[2]
+ * divided by 256.  The samples of pixel i are at r, g and b offset by
+ * i * step bytes, so that both contiguous (step 3) and separated
+ * (step 1) samples can be converted.
+ */
+void
+TIFFRGBToGrey8(uint8* out, const uint8* r, const uint8* g, const uint8* b,
+    uint32 n, int step, const int32 weights[3])
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	uint32 i = 0;
+	tmsize_t o;
+
+	if (k->rgbGrey8 != NULL &&
+	    weights[0] >= 0 && weights[0] <= 32767 &&
+	    weights[1] >= 0 && weights[1] <= 32767 &&
+	    weights[2] >= 0 && weights[2] <= 32767)
+		i = (*k->rgbGrey8)(out, r, g, b, n, step, weights);
+	for (o = (tmsize_t) i * step; i < n; i++, o += step)
+		out[i] = (uint8) ((weights[0] * r[o] + weights[1] * g[o] +
+		    weights[2] * b[o]) >> 8);
+}
+
+static int32
+ycbcrFixed(double v)
+{
+	v *= 1 << YCBCR_SHIFT;
+	return ((int32) (v < 0 ? v - 0.5 : v + 0.5));
+}
+
+/* A chrominance code from the sum of the values of n pixels */
+static uint8
+ycbcrChroma(int32 sum, uint32 n, int32 offset)
+{
+	int32 v = sum + (int32) n * offset;
+
+	if (v < 0)
+		return (0);
+	v = (v / (int32) n) >> YCBCR_SHIFT;
+	return ((uint8) (v > 255 ? 255 : v));
+}
+
+/*
+ * Convert nrows rows of width RGBA pixels, packed as by TIFFRGBAImage,
+ * to 8-bit YCbCr data subsampled by hs and vs (1, 2 or 4) as they are
+ * stored in a contiguous strip: each clump of hs x vs luminance codes
+ * is followed by the Cb and Cr codes of its average color.  Row r of
+ * the pixels is at raster + r * stride.  Clumps that go past the right
+ * or bottom edge are padded with the code of zero luminance and their
+ * chrominance is that of their pixels within the image.  The codes are
+ * computed in fixed point from the luminance coefficients and the
+ * reference black and white of the YCbCr image.
+ */
+void
+TIFFRGBAToYCbCr8(uint8* out, const uint32* raster, tmsize_t stride,
+    uint32 width, uint32 nrows, int hs, int vs, const float luma[3],
+    const float refBlackWhite[6])
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	uint32 clumpsize = (uint32) (hs * vs + 2);
+	uint32 nclumps = (width + hs - 1) / hs;
+	double ys = (refBlackWhite[1] - refBlackWhite[0]) / 255.0;
+	double cbs = (refBlackWhite[3] - refBlackWhite[2]) / 127.0 /
+	    (2.0 - 2.0 * luma[2]);
+	double crs = (refBlackWhite[5] - refBlackWhite[4]) / 127.0 /
+	    (2.0 - 2.0 * luma[0]);
+	int32 coeffs[10], cboff, croff, zero;
+	uint8 y[YCBCR_BLOCK], yzero;
+	int32 cb[YCBCR_BLOCK], cr[YCBCR_BLOCK];
+	int32 sums[2 * YCBCR_BLOCK];
+	uint32 row, x0, i, c, j;
+	int usekernel = k->rgbYCbCr8 != NULL;
+	int kk;
+
+	coeffs[0] = ycbcrFixed(luma[0] * ys);
+	coeffs[1] = ycbcrFixed(luma[1] * ys);
+	coeffs[2] = ycbcrFixed(luma[2] * ys);
+	coeffs[3] = ycbcrFixed(refBlackWhite[0] + 0.5);
+	coeffs[4] = ycbcrFixed(-luma[0] * cbs);
+	coeffs[5] = ycbcrFixed(-luma[1] * cbs);
+	coeffs[6] = ycbcrFixed((1.0 - luma[2]) * cbs);
+	coeffs[7] = ycbcrFixed((1.0 - luma[0]) * crs);
+	coeffs[8] = ycbcrFixed(-luma[1] * crs);
+	coeffs[9] = ycbcrFixed(-luma[2] * crs);
+	cboff = ycbcrFixed(refBlackWhite[2] + 0.5);
+	croff = ycbcrFixed(refBlackWhite[4] + 0.5);
+	zero = coeffs[3] >> YCBCR_SHIFT;
+	yzero = (uint8) (zero < 0 ? 0 : zero > 255 ? 255 : zero);
+	for (i = 0; i < 10; i++)
+		if (i != 3 && (coeffs[i] < -32768 || coeffs[i] > 32767))
+			usekernel = 0;
+
+	for (row = 0; row < nrows; row += vs, out += nclumps * clumpsize) {
+		uint32 ch = nrows - row < (uint32) vs ? nrows - row : (uint32) vs;
+
+		for (x0 = 0; x0 < width; x0 += YCBCR_BLOCK) {
+			uint32 n = width - x0 < YCBCR_BLOCK ?
+			    width - x0 : YCBCR_BLOCK;
+			uint32 nc = (n + hs - 1) / hs;
+			uint8* op = out + (x0 / hs) * clumpsize;
+
+			_TIFFmemset(sums, 0, 2 * nc * sizeof (int32));
+			for (kk = 0; kk < vs; kk++) {
+				if ((uint32) kk < ch) {
+					const uint32* rp = raster +
+					    (tmsize_t) (row + kk) * stride + x0;
+
+					i = usekernel ? (*k->rgbYCbCr8)(y, cb,
+					    cr, rp, n, coeffs) : 0;
+					for (; i < n; i++) {
+						int32 R = TIFFGetR(rp[i]);
+						int32 G = TIFFGetG(rp[i]);
+						int32 B = TIFFGetB(rp[i]);
+						int32 v = (coeffs[0] * R +
+						    coeffs[1] * G +
+						    coeffs[2] * B + coeffs[3]) >>
+						    YCBCR_SHIFT;
+
+						y[i] = (uint8) (v < 0 ? 0 :
+						    v > 255 ? 255 : v);
+						cb[i] = coeffs[4] * R +
+						    coeffs[5] * G + coeffs[6] * B;
+						cr[i] = coeffs[7] * R +
+						    coeffs[8] * G + coeffs[9] * B;
+					}
+				}
+				for (c = 0; c < nc; c++) {
+					uint8* cp = op + c * clumpsize + kk * hs;
+
+					for (j = 0; j < (uint32) hs; j++) {
+						i = c * hs + j;
+						if ((uint32) kk >= ch || i >= n) {
+							cp[j] = yzero;
+							continue;
+						}
+						cp[j] = y[i];
+						sums[2 * c] += cb[i];
+						sums[2 * c + 1] += cr[i];
+					}
+				}
+			}
+			for (c = 0; c < nc; c++) {
+				uint8* cp = op + c * clumpsize + hs * vs;
+				uint32 cw = n - c * hs < (uint32) hs ?
+				    n - c * hs : (uint32) hs;
+
+				cp[0] = ycbcrChroma(sums[2 * c], ch * cw, cboff);
+				cp[1] = ycbcrChroma(sums[2 * c + 1], ch * cw,
+				    croff);
+			}
+		}
+	}
+}
+
+/*
+ * Expand n 8-bit palette indices to contiguous 8-bit RGB samples, with
+ * a map of 256 colors packed as by TIFFRGBAImage (alpha is ignored).
+ */
+void
+TIFFPaletteToRGB8(uint8* dst, const uint8* src, tmsize_t n,
+    const uint32 map[256])
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	tmsize_t i = k->palette8 != NULL ? (*k->palette8)(dst, src, n, map) : 0;
+
+	for (dst += 3 * i; i < n; i++, dst += 3) {
+		uint32 v = map[src[i]];
+
+		dst[0] = (uint8) TIFFGetR(v);
+		dst[1] = (uint8) TIFFGetG(v);
+		dst[2] = (uint8) TIFFGetB(v);
+	}
+}
+
 /* vim: set ts=8 sts=8 sw=8 noet: */
 /*
  * Local Variables:
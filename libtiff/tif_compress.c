@@ -35,11 +35,11 @@ TIFFNoEncode(TIFF* tif, const char* method)
 	const TIFFCodec* c = TIFFFindCODEC(tif->tif_dir.td_compression);
 
 	if (c) {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			     "%s %s encoding is not implemented",
 			     c->name, method);
 	} else {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			"Compression scheme %u %s encoding is not implemented",
 			     tif->tif_dir.td_compression, method);
 	}
@@ -73,11 +73,11 @@ TIFFNoDecode(TIFF* tif, const char* method)
 	const TIFFCodec* c = TIFFFindCODEC(tif->tif_dir.td_compression);
 
 	if (c)
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			     "%s %s decoding is not implemented",
 			     c->name, method);
 	else
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			     "Compression scheme %u %s decoding is not implemented",
 			     tif->tif_dir.td_compression, method);
 	return (0);
@@ -115,7 +115,7 @@ int
 _TIFFNoSeek(TIFF* tif, uint32 off)
 {
 	(void) off;
-	TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+	TIFFErrorExtR(tif, tif->tif_name,
 		     "Compression algorithm does not support random access");
 	return (0);
 }
@@ -127,6 +127,31 @@ _TIFFNoPreCode(TIFF* tif, uint16 s)
 	return (1);
 }
 
+/*
+ * Return non-zero if cc bytes is the size of the whole current strip
+ * or tile, i.e. the codec is not being driven a scanline at a time.
+ * Codecs with a faster one-shot interface use this to pick it.
+ */
+int
+_TIFFIsWholeChunk(TIFF* tif, tmsize_t cc)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+
+	if (isTiled(tif))
+		return (TIFFTileSize64(tif) == (uint64) cc);
+	else {
+		uint32 strip_height;
+
+		if (tif->tif_row >= td->td_imagelength ||
+		    tif->tif_row % td->td_rowsperstrip != 0)
+			return (0);
+		strip_height = td->td_imagelength - tif->tif_row;
+		if (strip_height > td->td_rowsperstrip)
+			strip_height = td->td_rowsperstrip;
+		return (TIFFVStripSize64(tif, strip_height) == (uint64) cc);
+	}
+}
+
 static int _TIFFtrue(TIFF* tif) { (void) tif; return (1); }
 static void _TIFFvoid(TIFF* tif) { (void) tif; }
 
@@ -149,6 +174,9 @@ _TIFFSetDefaultCompressionState(TIFF* tif)
 	tif->tif_encodetile = _TIFFNoTileEncode;  
 	tif->tif_close = _TIFFvoid;
 	tif->tif_seek = _TIFFNoSeek;
+	tif->tif_savestate = NULL;
+	tif->tif_restorestate = NULL;
+	tif->tif_freestate = NULL;
 	tif->tif_cleanup = _TIFFvoid;
 	tif->tif_defstripsize = _TIFFDefaultStripSize;
 	tif->tif_deftilesize = _TIFFDefaultTileSize;
@@ -181,8 +209,27 @@ typedef struct _codec {
 } codec_t;
 static codec_t* registeredCODECS = NULL;
 
-const TIFFCodec*
-TIFFFindCODEC(uint16 scheme)
+/*
+ * Codecs indexed by scheme, so that TIFFFindCODEC() does not scan the
+ * lists on every directory read.  The index has a page of 256 entries
+ * for each value of the high byte of the scheme that has codecs; an
+ * entry points at the codec TIFFFindCODEC() returns for its scheme.
+ * Pages and entries are only changed under the global lock, and a page
+ * is filled in before it is published, so lookups need no lock.  Pages
+ * are never freed.  Should a page not be allocated, the index is marked
+ * incomplete and lookups scan the lists under the lock instead.
+ */
+#define	CODEC_PAGES	256
+#define	CODEC_PAGESIZE	256
+
+typedef const TIFFCodec* volatile codecpage_t[CODEC_PAGESIZE];
+static codecpage_t* volatile codecIndex[CODEC_PAGES];
+static volatile int codecIndexReady = 0;
+static volatile int codecIndexBroken = 0;
+
+/* The codec for scheme from the lists; the global lock is held */
+static const TIFFCodec*
+TIFFScanCODECs(uint16 scheme)
 {
 	const TIFFCodec* c;
 	codec_t* cd;
@@ -196,6 +243,60 @@ TIFFFindCODEC(uint16 scheme)
 	return ((const TIFFCodec*) 0);
 }
 
+/* Bring the entry of scheme up to date; the global lock is held */
+static void
+TIFFIndexCODEC(uint16 scheme)
+{
+	codecpage_t* page = codecIndex[scheme / CODEC_PAGESIZE];
+	const TIFFCodec* c = TIFFScanCODECs(scheme);
+
+	if (page == NULL) {
+		if (c == NULL)
+			return;
+		page = (codecpage_t*) _TIFFmalloc(sizeof (codecpage_t));
+		if (page == NULL) {
+			codecIndexBroken = 1;
+			return;
+		}
+		_TIFFmemset((void*) page, 0, sizeof (codecpage_t));
+		(*page)[scheme % CODEC_PAGESIZE] = c;
+		codecIndex[scheme / CODEC_PAGESIZE] = page;
+	} else
+		(*page)[scheme % CODEC_PAGESIZE] = c;
+}
+
+static void
+TIFFSetupCODECIndex(void)
+{
+	const TIFFCodec* c;
+
+	_TIFFGlobalLock();
+	if (!codecIndexReady) {
+		for (c = _TIFFBuiltinCODECS; c->name; c++)
+			TIFFIndexCODEC(c->scheme);
+		codecIndexReady = 1;
+	}
+	_TIFFGlobalUnlock();
+}
+
+const TIFFCodec*
+TIFFFindCODEC(uint16 scheme)
+{
+	const TIFFCodec* c;
+	codecpage_t* page;
+
+	if (!codecIndexReady)
+		TIFFSetupCODECIndex();
+	if (codecIndexBroken) {
+		_TIFFGlobalLock();
+		c = TIFFScanCODECs(scheme);
+		_TIFFGlobalUnlock();
+		return (c);
+	}
+	page = codecIndex[scheme / CODEC_PAGESIZE];
+	return (page != NULL ? (*page)[scheme % CODEC_PAGESIZE] : NULL);
+}
+
 TIFFCodec*
 TIFFRegisterCODEC(uint16 scheme, const char* name, TIFFInitMethod init)
 {
@@ -209,8 +310,13 @@ TIFFRegisterCODEC(uint16 scheme, const char* name, TIFFInitMethod init)
 		strcpy(cd->info->name, name);
 		cd->info->scheme = scheme;
 		cd->info->init = init;
+		if (!codecIndexReady)
+			TIFFSetupCODECIndex();
+		_TIFFGlobalLock();
 		cd->next = registeredCODECS;
 		registeredCODECS = cd;
+		TIFFIndexCODEC(scheme);
+		_TIFFGlobalUnlock();
 	} else {
 		TIFFErrorExt(0, "TIFFRegisterCODEC",
 		    "No space to register compression scheme %s", name);
@@ -225,12 +331,18 @@ TIFFUnRegisterCODEC(TIFFCodec* c)
 	codec_t* cd;
 	codec_t** pcd;
 
+	if (!codecIndexReady)
+		TIFFSetupCODECIndex();
+	_TIFFGlobalLock();
 	for (pcd = &registeredCODECS; (cd = *pcd) != NULL; pcd = &cd->next)
 		if (cd->info == c) {
 			*pcd = cd->next;
+			TIFFIndexCODEC(c->scheme);
+			_TIFFGlobalUnlock();
 			_TIFFfree(cd);
 			return;
 		}
+	_TIFFGlobalUnlock();
 	TIFFErrorExt(0, "TIFFUnRegisterCODEC",
 	    "Cannot remove compression scheme %s; not registered", c->name);
 }
@@ -256,17 +368,20 @@ TIFFGetConfiguredCODECs()
 	TIFFCodec* codecs = NULL;
 	TIFFCodec* new_codecs;
 
+	_TIFFGlobalLock();
 	for (cd = registeredCODECS; cd; cd = cd->next) {
 		new_codecs = (TIFFCodec *)
 			_TIFFrealloc(codecs, i * sizeof(TIFFCodec));
 		if (!new_codecs) {
+			_TIFFGlobalUnlock();
 			_TIFFfree (codecs);
 			return NULL;
 		}
 		codecs = new_codecs;
-		_TIFFmemcpy(codecs + i - 1, cd, sizeof(TIFFCodec));
+		_TIFFmemcpy(codecs + i - 1, cd->info, sizeof(TIFFCodec));
 		i++;
 	}
+	_TIFFGlobalUnlock();
 	for (c = _TIFFBuiltinCODECS; c->name; c++) {
 		if (TIFFIsCODECConfigured(c->scheme)) {
 			new_codecs = (TIFFCodec *)
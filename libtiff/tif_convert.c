@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Reading of strips and tiles converted to another sample type.
+ *
+ * A chunk is decoded and then converted a block of samples at a time,
+ * so each block is converted while it is still in the cache.  When the
+ * converted samples are at least as large as the decoded ones, the
+ * chunk is decoded into the end of the caller's buffer and converted
+ * in place towards its start: the samples written never reach those
+ * not yet read.
+ */
+#include "tiffiop.h"
+#include <string.h>
+
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#endif
+
+#define	CONVERT_BLOCK	256		/* samples converted at a time */
+
+/* decoded sample types */
+enum {
+	CVT_UINT8, CVT_INT8, CVT_UINT16, CVT_INT16,
+	CVT_UINT32, CVT_INT32, CVT_FLOAT
+};
+
+typedef void (*TIFFConvertProc)(void* dst, const void* src, tmsize_t n,
+    double scale, double offset);
+
+/*
+ * Integer results are rounded to the nearest value and clamped to the
+ * range of the type; NaN becomes 0.
+ */
+static uint8
+toUInt8(double v)
+{
+	if (!(v > 0.0))
+		return (0);
+	return (v >= 255.0 ? 255 : (uint8) (v + 0.5));
+}
+
+static uint16
+toUInt16(double v)
+{
+	if (!(v > 0.0))
+		return (0);
+	return (v >= 65535.0 ? 65535 : (uint16) (v + 0.5));
+}
+
+static int16
+toInt16(double v)
+{
+	if (v != v)
+		return (0);
+	if (v <= -32768.0)
+		return (-32768);
+	if (v >= 32767.0)
+		return (32767);
+	return (v < 0.0 ? (int16) (v - 0.5) : (int16) (v + 0.5));
+}
+
+#define	CONVERTPROC(name, itype, otype, store)				\
+static void								\
+name(void* dst, const void* src, tmsize_t n, double scale, double offset) \
+{									\
+	const itype* ip = (const itype*) src;				\
+	otype* op = (otype*) dst;					\
+	tmsize_t i;							\
+									\
+	for (i = 0; i < n; i++)						\
+		op[i] = store((double) ip[i] * scale + offset);		\
+}
+
+#define	CONVERTPROCS(in, itype)						\
+CONVERTPROC(in##ToUInt8, itype, uint8, toUInt8)				\
+CONVERTPROC(in##ToUInt16, itype, uint16, toUInt16)			\
+CONVERTPROC(in##ToInt16, itype, int16, toInt16)
+
+CONVERTPROCS(uint8, uint8)
+CONVERTPROCS(int8, int8)
+CONVERTPROCS(uint16, uint16)
+CONVERTPROCS(int16, int16)
+CONVERTPROCS(uint32, uint32)
+CONVERTPROCS(int32, int32)
+CONVERTPROCS(float, float)
+
+/*
+ * Float results are computed in single precision, as the SIMD kernels
+ * do; these may handle a leading part of the samples.
+ */
+#define	FLOATPROC(name, itype, kernel)					\
+static void								\
+name(void* dst, const void* src, tmsize_t n, double scale, double offset) \
+{									\
+	const itype* ip = (const itype*) src;				\
+	float* op = (float*) dst;					\
+	float fscale = (float) scale, foffset = (float) offset;	\
+	tmsize_t i = kernel;						\
+									\
+	for (; i < n; i++)						\
+		op[i] = (float) ip[i] * fscale + foffset;		\
+}
+
+#define	KERNEL(name) \
+	(_TIFFGetKernels()->name != NULL ? \
+	    (*_TIFFGetKernels()->name)(op, ip, n, fscale, foffset) : 0)
+
+FLOATPROC(uint8ToFloat, uint8, KERNEL(uint8ToFloat))
+FLOATPROC(int8ToFloat, int8, 0)
+FLOATPROC(uint16ToFloat, uint16, KERNEL(uint16ToFloat))
+FLOATPROC(int16ToFloat, int16, KERNEL(int16ToFloat))
+FLOATPROC(uint32ToFloat, uint32, 0)
+FLOATPROC(int32ToFloat, int32, 0)
+FLOATPROC(floatToFloat, float, 0)
+
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSE2
+static tmsize_t
+uint8ToFloatSSE2(float* dst, const uint8* src, tmsize_t n, float scale,
+    float offset)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 s = _mm_set1_ps(scale);
+	const __m128 o = _mm_set1_ps(offset);
+	tmsize_t i;
+	__m128i x, w;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		x = _mm_loadu_si128((const __m128i*) (src + i));
+		w = _mm_unpacklo_epi8(x, zero);
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+		    _mm_unpacklo_epi16(w, zero)), s), o));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+		    _mm_unpackhi_epi16(w, zero)), s), o));
+		w = _mm_unpackhi_epi8(x, zero);
+		_mm_storeu_ps(dst + i + 8, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+		    _mm_unpacklo_epi16(w, zero)), s), o));
+		_mm_storeu_ps(dst + i + 12, _mm_add_ps(_mm_mul_ps(
+		    _mm_cvtepi32_ps(_mm_unpackhi_epi16(w, zero)), s), o));
+	}
+	return (i);
+}
+
+TIFF_TARGET_SSE2
+static tmsize_t
+uint16ToFloatSSE2(float* dst, const uint16* src, tmsize_t n, float scale,
+    float offset)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 s = _mm_set1_ps(scale);
+	const __m128 o = _mm_set1_ps(offset);
+	tmsize_t i;
+	__m128i x;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		x = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+		    _mm_unpacklo_epi16(x, zero)), s), o));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+		    _mm_unpackhi_epi16(x, zero)), s), o));
+	}
+	return (i);
+}
+
+TIFF_TARGET_SSE2
+static tmsize_t
+int16ToFloatSSE2(float* dst, const int16* src, tmsize_t n, float scale,
+    float offset)
+{
+	const __m128 s = _mm_set1_ps(scale);
+	const __m128 o = _mm_set1_ps(offset);
+	tmsize_t i;
+	__m128i x;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		/* sign extension: the value in the top half, shifted down */
+		x = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+		    _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), s), o));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+		    _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), s), o));
+	}
+	return (i);
+}
+#endif
+
+void
+_TIFFConvertKernels(TIFFKernels* k, int features)
+{
+#if defined(TIFF_SIMD_X86)
+	if (features & TIFF_CPU_SSE2) {
+		k->uint8ToFloat = uint8ToFloatSSE2;
+		k->uint16ToFloat = uint16ToFloatSSE2;
+		k->int16ToFloat = int16ToFloatSSE2;
+	}
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+/* [decoded type][TIFF_BYTE, TIFF_SHORT, TIFF_SSHORT, TIFF_FLOAT] */
+static const TIFFConvertProc convertProcs[7][4] = {
+	{ uint8ToUInt8, uint8ToUInt16, uint8ToInt16, uint8ToFloat },
+	{ int8ToUInt8, int8ToUInt16, int8ToInt16, int8ToFloat },
+	{ uint16ToUInt8, uint16ToUInt16, uint16ToInt16, uint16ToFloat },
+	{ int16ToUInt8, int16ToUInt16, int16ToInt16, int16ToFloat },
+	{ uint32ToUInt8, uint32ToUInt16, uint32ToInt16, uint32ToFloat },
+	{ int32ToUInt8, int32ToUInt16, int32ToInt16, int32ToFloat },
+	{ floatToUInt8, floatToUInt16, floatToInt16, floatToFloat },
+};
+
+/*
+ * Return the decoded sample type of the current directory, or -1 with
+ * an error if it cannot be converted.
+ */
+static int
+decodedType(TIFF* tif, const char* module)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	int sf = td->td_sampleformat;
+
+	switch (td->td_bitspersample) {
+	case 8:
+		if (sf == SAMPLEFORMAT_UINT || sf == SAMPLEFORMAT_INT)
+			return (sf == SAMPLEFORMAT_UINT ? CVT_UINT8 : CVT_INT8);
+		break;
+	case 16:
+		if (sf == SAMPLEFORMAT_UINT || sf == SAMPLEFORMAT_INT)
+			return (sf == SAMPLEFORMAT_UINT ? CVT_UINT16 : CVT_INT16);
+		break;
+	case 32:
+		if (sf == SAMPLEFORMAT_UINT || sf == SAMPLEFORMAT_INT)
+			return (sf == SAMPLEFORMAT_UINT ? CVT_UINT32 : CVT_INT32);
+		if (sf == SAMPLEFORMAT_IEEEFP)
+			return (CVT_FLOAT);
+		break;
+	}
+	TIFFErrorExtR(tif, module,
+	    "Cannot convert %d-bit samples of sample format %d",
+	    td->td_bitspersample, sf);
+	return (-1);
+}
+
+static tmsize_t
+readChunkAs(TIFF* tif, uint32 chunk, void* buf, tmsize_t size,
+    TIFFDataType type, double scale, double offset, int tiles,
+    const char* module)
+{
+	static const int outsizes[4] = { 1, 2, 2, 4 };
+	static const int sametype[4] = { CVT_UINT8, CVT_UINT16, CVT_INT16,
+					 CVT_FLOAT };
+	TIFFDirectory *td = &tif->tif_dir;
+	tmsize_t maxsamples, n, i, block;
+	tmsize_t (*readchunk)(TIFF*, uint32, void*, tmsize_t);
+	int in, out, isz, osz;
+	uint8 *src, *dst;
+	union {
+		uint8	b[CONVERT_BLOCK * 4];
+		double	align;
+	} tmp;
+
+	if (tiles != isTiled(tif)) {
+		TIFFErrorExtR(tif, module, tiles ?
+		    "Can not read tiles from a striped image" :
+		    "Can not read scanlines from a tiled image");
+		return ((tmsize_t)(-1));
+	}
+	switch (type) {
+	case TIFF_BYTE: out = 0; break;
+	case TIFF_SHORT: out = 1; break;
+	case TIFF_SSHORT: out = 2; break;
+	case TIFF_FLOAT: out = 3; break;
+	default:
+		TIFFErrorExtR(tif, module,
+		    "Cannot convert samples to data type %d", (int) type);
+		return ((tmsize_t)(-1));
+	}
+	if ((in = decodedType(tif, module)) < 0)
+		return ((tmsize_t)(-1));
+	readchunk = tiles ? TIFFReadEncodedTile : TIFFReadEncodedStrip;
+	isz = td->td_bitspersample / 8;
+	osz = outsizes[out];
+	if (size != (tmsize_t)(-1))
+		size -= size % osz;		/* whole samples only */
+	if (in == sametype[out] && scale == 1.0 && offset == 0.0)
+		return ((*readchunk)(tif, chunk, buf, size));
+
+	if (tiles)
+		maxsamples = TIFFTileSize(tif) / isz;
+	else {
+		/* the last strip of an image may be short */
+		uint32 rows = td->td_rowsperstrip, row;
+
+		if (chunk >= td->td_nstrips) {
+			TIFFErrorExtR(tif, module,
+			    "%lu: Strip out of range, max %lu",
+			    (unsigned long) chunk,
+			    (unsigned long) td->td_nstrips);
+			return ((tmsize_t)(-1));
+		}
+		row = (chunk % td->td_stripsperimage) * rows;
+		if (rows > td->td_imagelength - row)
+			rows = td->td_imagelength - row;
+		maxsamples = TIFFVStripSize(tif, rows) / isz;
+	}
+	if (maxsamples == 0)
+		return ((tmsize_t)(-1));
+	if (size != (tmsize_t)(-1) && size / osz < maxsamples)
+		maxsamples = size / osz;
+	if (osz >= isz) {
+		dst = (uint8*) buf;
+		src = dst + maxsamples * (osz - isz);
+	} else {
+		src = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_CONVERT,
+		    maxsamples * isz);
+		if (src == NULL)
+			return ((tmsize_t)(-1));
+		dst = (uint8*) buf;
+	}
+	n = (*readchunk)(tif, chunk, src, maxsamples * isz);
+	if (n == (tmsize_t)(-1))
+		return (n);
+	n /= isz;
+	for (i = 0; i < n; i += block) {
+		block = n - i < CONVERT_BLOCK ? n - i : CONVERT_BLOCK;
+		/* copied out first, as the output may overwrite it */
+		_TIFFmemcpy(tmp.b, src + i * isz, block * isz);
+		(*convertProcs[in][out])(dst + i * osz, tmp.b, block,
+		    scale, offset);
+	}
+	return (n * osz);
+}
+
+/*
+ * Read and decode a tile or strip like TIFFReadEncodedTile() and
+ * TIFFReadEncodedStrip(), and convert its samples to type (TIFF_BYTE,
+ * TIFF_SHORT, TIFF_SSHORT or TIFF_FLOAT) as value * scale + offset.
+ * Returns the size of the converted data, or -1 on error.
+ */
+tmsize_t
+TIFFReadEncodedTileAs(TIFF* tif, uint32 tile, void* buf, tmsize_t size,
+    TIFFDataType type, double scale, double offset)
+{
+	return (readChunkAs(tif, tile, buf, size, type, scale, offset, 1,
+	    "TIFFReadEncodedTileAs"));
+}
+
+tmsize_t
+TIFFReadEncodedStripAs(TIFF* tif, uint32 strip, void* buf, tmsize_t size,
+    TIFFDataType type, double scale, double offset)
+{
+	return (readChunkAs(tif, strip, buf, size, type, scale, offset, 0,
+	    "TIFFReadEncodedStripAs"));
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library.
+ *
+ * Run time detection of the SIMD instruction sets used by the
+ * optimized code paths of the library, and the table of kernels
+ * selected from them.
+ */
+#include "tiffiop.h"
+
+#if defined(TIFF_SIMD_X86) && defined(_MSC_VER)
+# include <intrin.h>
+#elif defined(TIFF_SIMD_X86)
+# include <cpuid.h>
+#endif
+
+static int cpufeatures = -1;
+
+/*
+ * Return the instruction sets the CPU (and operating system) support.
+ */
+static int
+TIFFDetectCPUFeatures(void)
+{
+	int features = cpufeatures;
+
+	if (features >= 0)
+		return (features);
+	features = 0;
+#if defined(TIFF_SIMD_X86) && defined(_MSC_VER)
+	{
+		int info[4];
+
+		__cpuid(info, 0);
+		if (info[0] >= 1) {
+			int maxleaf = info[0];
+
+			__cpuid(info, 1);
+			if (info[3] & (1 << 26))
+				features |= TIFF_CPU_SSE2;
+			if (info[2] & (1 << 9))
+				features |= TIFF_CPU_SSSE3;
+			if (info[2] & (1 << 20))
+				features |= TIFF_CPU_SSE42;
+			/* AVX2 also needs the OS to save the ymm registers */
+			if (maxleaf >= 7 && (info[2] & (1 << 27)) &&
+			    (_xgetbv(0) & 0x6) == 0x6) {
+				__cpuidex(info, 7, 0);
+				if (info[1] & (1 << 5))
+					features |= TIFF_CPU_AVX2;
+			}
+		}
+	}
+#elif defined(TIFF_SIMD_X86)
+	{
+		unsigned int eax, ebx, ecx, edx;
+
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+			if (edx & (1U << 26))
+				features |= TIFF_CPU_SSE2;
+			if (ecx & (1U << 9))
+				features |= TIFF_CPU_SSSE3;
+			if (ecx & (1U << 20))
+				features |= TIFF_CPU_SSE42;
+			/* AVX2 also needs the OS to save the ymm registers */
+			if (ecx & (1U << 27)) {
+				unsigned int xcr0, xcr0hi;
+
+				__asm__ __volatile__ ("xgetbv"
+				    : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));
+				(void) xcr0hi;
+				if ((xcr0 & 0x6) == 0x6 &&
+				    __get_cpuid_max(0, NULL) >= 7) {
+					__cpuid_count(7, 0, eax, ebx, ecx, edx);
+					if (ebx & (1U << 5))
+						features |= TIFF_CPU_AVX2;
+				}
+			}
+		}
+	}
+#elif defined(TIFF_SIMD_NEON)
+	/* NEON code is only built when the target mandates it */
+	features |= TIFF_CPU_NEON;
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+	/* likewise for the CRC32 instructions */
+	features |= TIFF_CPU_CRC32;
+#endif
+	cpufeatures = features;
+	return (features);
+}
+
+/*
+ * The kernel table and the features it was set up for.  The table is
+ * filled in once, on first use (TIFFClientOpen() makes sure that
+ * happens early), and again on each TIFFSetCPUFeatures() call.
+ */
+static TIFFKernels kernels;
+static int activefeatures;
+static volatile int kernelsready = 0;
+
+static void
+TIFFSetupKernels(int features)
+{
+	TIFFKernels k;
+
+	_TIFFmemset(&k, 0, sizeof (k));
+	_TIFFSwabKernels(&k, features);
+	_TIFFPredictorKernels(&k, features);
+	_TIFFRGBAImageKernels(&k, features);
+	_TIFFDirReadKernels(&k, features);
+	_TIFFOrientKernels(&k, features);
+	_TIFFColorKernels(&k, features);
+	_TIFFUnpackKernels(&k, features);
+	_TIFFConvertKernels(&k, features);
+	_TIFFInterleaveKernels(&k, features);
+	_TIFFChecksumKernels(&k, features);
+	kernels = k;
+	activefeatures = features;
+	kernelsready = 1;
+}
+
+const TIFFKernels*
+_TIFFGetKernels(void)
+{
+	if (!kernelsready) {
+		_TIFFGlobalLock();
+		if (!kernelsready)
+			TIFFSetupKernels(TIFFDetectCPUFeatures());
+		_TIFFGlobalUnlock();
+	}
+	return (&kernels);
+}
+
+/*
+ * Return the instruction sets the optimized code paths may use.
+ */
+int
+_TIFFCPUFeatures(void)
+{
+	(void) _TIFFGetKernels();
+	return (activefeatures);
+}
+
+int
+TIFFGetCPUFeatures(void)
+{
+	return (_TIFFCPUFeatures());
+}
+
+/*
+ * Restrict the optimized code paths to the given instruction sets,
+ * or allow all those the CPU supports with TIFF_CPU_ALL.  Returns the
+ * features that are now in use.
+ */
+int
+TIFFSetCPUFeatures(int features)
+{
+	_TIFFGlobalLock();
+	TIFFSetupKernels(TIFFDetectCPUFeatures() & features);
+	_TIFFGlobalUnlock();
+	return (activefeatures);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library.
+ *
+ * Digest of the decoded image data of a directory.
+ */
+#include "tiffiop.h"
+
+/*
+ * The digest is the 64-bit xxHash (seed 0) of the image data as it
+ * would be written uncompressed in one strip per sample plane: the
+ * rows of each plane from top to bottom, each packed to a whole number
+ * of bytes with the padding bits cleared, and samples of 16, 24, 32
+ * or 64 bits in little-endian byte order.  Strips are decoded in
+ * batches of at least DIGEST_BATCHSIZE bytes and tiles a row of tiles
+ * at a time, on several threads, and hashed in image order.
+ */
+#define	DIGEST_BATCHSIZE	((tmsize_t) 8 * 1024 * 1024)
+
+#define	DIGEST_C(hi, lo)	(((uint64)(hi) << 32) | (uint64)(lo))
+#define	PRIME64_1	DIGEST_C(0x9E3779B1, 0x85EBCA87)
+#define	PRIME64_2	DIGEST_C(0xC2B2AE3D, 0x27D4EB4F)
+#define	PRIME64_3	DIGEST_C(0x165667B1, 0x9E3779F9)
+#define	PRIME64_4	DIGEST_C(0x85EBCA77, 0xC2B2AE63)
+#define	PRIME64_5	DIGEST_C(0x27D4EB2F, 0x165667C5)
+#define	ROTL64(x, r)	(((x) << (r)) | ((x) >> (64 - (r))))
+
+typedef struct {
+	uint64	v[4];		/* lane accumulators */
+	uint64	total;		/* bytes hashed so far */
+	uint8	mem[32];	/* pending bytes of a partial stripe */
+	uint32	memsize;
+} TIFFDigestState;
+
+static uint64
+read64(const uint8* p)
+{
+	return ((uint64) p[0] | ((uint64) p[1] << 8) |
+	    ((uint64) p[2] << 16) | ((uint64) p[3] << 24) |
+	    ((uint64) p[4] << 32) | ((uint64) p[5] << 40) |
+	    ((uint64) p[6] << 48) | ((uint64) p[7] << 56));
+}
+
+static uint32
+read32(const uint8* p)
+{
+	return ((uint32) p[0] | ((uint32) p[1] << 8) |
+	    ((uint32) p[2] << 16) | ((uint32) p[3] << 24));
+}
+
+static uint64
+digestRound(uint64 acc, uint64 lane)
+{
+	acc += lane * PRIME64_2;
+	acc = ROTL64(acc, 31);
+	return (acc * PRIME64_1);
+}
+
+static uint64
+digestMerge(uint64 acc, uint64 v)
+{
+	acc ^= digestRound(0, v);
+	return (acc * PRIME64_1 + PRIME64_4);
+}
+
+static void
+digestInit(TIFFDigestState* st)
+{
+	st->v[0] = PRIME64_1 + PRIME64_2;
+	st->v[1] = PRIME64_2;
+	st->v[2] = 0;
+	st->v[3] = (uint64) 0 - PRIME64_1;
+	st->total = 0;
+	st->memsize = 0;
+}
+
+static void
+digestUpdate(TIFFDigestState* st, const uint8* p, tmsize_t n)
+{
+	st->total += (uint64) n;
+	if (st->memsize + n < 32) {
+		_TIFFmemcpy(st->mem + st->memsize, p, n);
+		st->memsize += (uint32) n;
+		return;
+	}
+	if (st->memsize > 0) {
+		uint32 fill = 32 - st->memsize;
+
+		_TIFFmemcpy(st->mem + st->memsize, p, fill);
+		st->v[0] = digestRound(st->v[0], read64(st->mem));
+		st->v[1] = digestRound(st->v[1], read64(st->mem + 8));
+		st->v[2] = digestRound(st->v[2], read64(st->mem + 16));
+		st->v[3] = digestRound(st->v[3], read64(st->mem + 24));
+		p += fill;
+		n -= fill;
+		st->memsize = 0;
+	}
+	for (; n >= 32; p += 32, n -= 32) {
+		st->v[0] = digestRound(st->v[0], read64(p));
+		st->v[1] = digestRound(st->v[1], read64(p + 8));
+		st->v[2] = digestRound(st->v[2], read64(p + 16));
+		st->v[3] = digestRound(st->v[3], read64(p + 24));
+	}
+	if (n > 0) {
+		_TIFFmemcpy(st->mem, p, n);
+		st->memsize = (uint32) n;
+	}
+}
+
+static uint64
+digestFinal(const TIFFDigestState* st)
+{
+	const uint8* p = st->mem;
+	uint32 n = st->memsize;
+	uint64 h;
+
+	if (st->total >= 32) {
+		h = ROTL64(st->v[0], 1) + ROTL64(st->v[1], 7) +
+		    ROTL64(st->v[2], 12) + ROTL64(st->v[3], 18);
+		h = digestMerge(h, st->v[0]);
+		h = digestMerge(h, st->v[1]);
+		h = digestMerge(h, st->v[2]);
+		h = digestMerge(h, st->v[3]);
+	} else
+		h = st->v[2] + PRIME64_5;
+	h += st->total;
+	for (; n >= 8; p += 8, n -= 8) {
+		h ^= digestRound(0, read64(p));
+		h = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+	if (n >= 4) {
+		h ^= (uint64) read32(p) * PRIME64_1;
+		h = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+		n -= 4;
+	}
+	for (; n > 0; p++, n--) {
+		h ^= (uint64) *p * PRIME64_5;
+		h = ROTL64(h, 11) * PRIME64_1;
+	}
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return (h);
+}
+
+/*
+ * 64-bit xxHash of size bytes, as used to find identical strips and tiles
+ * when writing.
+ */
+uint64
+_TIFFHash64(const void* buf, tmsize_t size)
+{
+	TIFFDigestState st;
+
+	digestInit(&st);
+	digestUpdate(&st, (const uint8*) buf, size);
+	return (digestFinal(&st));
+}
+
+/*
+ * Bring the n decoded bytes at buf into little-endian sample order.
+ */
+static void
+digestSwab(TIFF* tif, uint8* buf, tmsize_t n)
+{
+#ifdef WORDS_BIGENDIAN
+	switch (tif->tif_dir.td_bitspersample) {
+	case 16:
+		TIFFSwabArrayOfShort((uint16*) buf, n / 2);
+		break;
+	case 24:
+		TIFFSwabArrayOfTriples(buf, n / 3);
+		break;
+	case 32:
+		TIFFSwabArrayOfLong((uint32*) buf, n / 4);
+		break;
+	case 64:
+		TIFFSwabArrayOfLong8((uint64*) buf, n / 8);
+		break;
+	}
+#else
+	(void) tif; (void) buf; (void) n;
+#endif
+}
+
+/*
+ * Hash the first rowbits bits of a row of rowsize bytes.
+ */
+static void
+digestRow(TIFFDigestState* st, const uint8* row, uint64 rowbits)
+{
+	tmsize_t n = (tmsize_t) (rowbits / 8);
+
+	digestUpdate(st, row, n);
+	if (rowbits % 8) {
+		uint8 last = (uint8) (row[n] &
+		    (0xff << (8 - (int) (rowbits % 8))));
+
+		digestUpdate(st, &last, 1);
+	}
+}
+
+static int
+digestStrips(TIFF* tif, TIFFDigestState* st, uint64 rowbits, int nthreads)
+{
+	static const char module[] = "TIFFDigestDirectory";
+	TIFFDirectory *td = &tif->tif_dir;
+	uint32 nstrips = td->td_nstrips, nbatch, i, n, s, r;
+	uint32 rps = td->td_rowsperstrip;
+	uint32 stripsperplane = TIFFNumberOfStrips(tif);
+	tmsize_t stripsize = TIFFStripSize(tif), scanline = TIFFScanlineSize(tif);
+	/* Subsampled YCbCr rows do not pack, and are hashed as blocks */
+	int whole = (uint64) scanline * 8 == rowbits ||
+	    (uint64) scanline != (rowbits + 7) / 8;
+	uint32* list = NULL;
+	void** bufs = NULL;
+	int ret = 0;
+
+	if (stripsize == 0 || scanline == 0)
+		return (0);
+	if (td->td_planarconfig == PLANARCONFIG_SEPARATE)
+		stripsperplane /= td->td_samplesperpixel;
+	if (rps > td->td_imagelength)
+		rps = td->td_imagelength;
+	nbatch = (uint32) (DIGEST_BATCHSIZE / stripsize);
+	if (nbatch < (uint32) nthreads)
+		nbatch = (uint32) nthreads;
+	if (nbatch == 0)
+		nbatch = 1;
+	if (nbatch > nstrips)
+		nbatch = nstrips;
+	list = (uint32*) _TIFFCheckMalloc(tif, nbatch, sizeof (uint32), module);
+	bufs = (void**) _TIFFCheckMalloc(tif, nbatch, sizeof (void*), module);
+	if (list == NULL || bufs == NULL)
+		goto done;
+	_TIFFmemset(bufs, 0, nbatch * sizeof (void*));
+	for (i = 0; i < nbatch; i++) {
+		bufs[i] = _TIFFmallocExt(tif, stripsize);
+		if (bufs[i] == NULL) {
+			TIFFErrorExtR(tif, module,
+			    "No space for strip buffers");
+			goto done;
+		}
+	}
+	for (s = 0; s < nstrips; s += n) {
+		n = nstrips - s < nbatch ? nstrips - s : nbatch;
+		for (i = 0; i < n; i++)
+			list[i] = s + i;
+		if (!TIFFReadEncodedStripsParallel(tif, list, n, bufs, -1,
+		    nthreads))
+			goto done;
+		for (i = 0; i < n; i++) {
+			uint32 row = ((s + i) % stripsperplane) * rps;
+			uint32 nrows = td->td_imagelength - row < rps ?
+			    td->td_imagelength - row : rps;
+			uint8* buf = (uint8*) bufs[i];
+
+			if (whole) {
+				tmsize_t size = TIFFVStripSize(tif, nrows);
+
+				digestSwab(tif, buf, size);
+				digestUpdate(st, buf, size);
+				continue;
+			}
+			for (r = 0; r < nrows; r++, buf += scanline)
+				digestRow(st, buf, rowbits);
+		}
+	}
+	ret = 1;
+done:
+	if (bufs) {
+		for (i = 0; i < nbatch; i++)
+			if (bufs[i])
+				_TIFFfreeExt(tif, bufs[i]);
+		_TIFFfreeExt(tif, bufs);
+	}
+	if (list)
+		_TIFFfreeExt(tif, list);
+	return (ret);
+}
+
+static int
+digestTiles(TIFF* tif, TIFFDigestState* st, uint64 pixelbits, int nthreads)
+{
+	static const char module[] = "TIFFDigestDirectory";
+	TIFFDirectory *td = &tif->tif_dir;
+	uint32 tw = td->td_tilewidth, tl = td->td_tilelength;
+	uint32 across = TIFFhowmany_32(td->td_imagewidth, tw);
+	uint16 nplanes = td->td_planarconfig == PLANARCONFIG_SEPARATE ?
+	    td->td_samplesperpixel : 1;
+	tmsize_t tilesize = TIFFTileSize(tif), rowsize = TIFFTileRowSize(tif);
+	uint32 i, y, r, nrows;
+	uint16 s;
+	uint32* list = NULL;
+	void** bufs = NULL;
+	int ret = 0;
+
+	if (tilesize == 0 || rowsize == 0)
+		return (0);
+	if ((uint64) rowsize * 8 != tw * pixelbits) {
+		TIFFErrorExtR(tif, module,
+		    "Can not digest subsampled tiles");
+		return (0);
+	}
+	list = (uint32*) _TIFFCheckMalloc(tif, across, sizeof (uint32), module);
+	bufs = (void**) _TIFFCheckMalloc(tif, across, sizeof (void*), module);
+	if (list == NULL || bufs == NULL)
+		goto done;
+	_TIFFmemset(bufs, 0, across * sizeof (void*));
+	for (i = 0; i < across; i++) {
+		bufs[i] = _TIFFmallocExt(tif, tilesize);
+		if (bufs[i] == NULL) {
+			TIFFErrorExtR(tif, module,
+			    "No space for tile buffers");
+			goto done;
+		}
+	}
+	for (s = 0; s < nplanes; s++)
+		for (y = 0; y < td->td_imagelength; y += tl) {
+			for (i = 0; i < across; i++)
+				list[i] = TIFFComputeTile(tif, i * tw, y, 0, s);
+			if (!TIFFReadEncodedTilesParallel(tif, list, across,
+			    bufs, -1, nthreads))
+				goto done;
+			for (i = 0; i < across; i++)
+				digestSwab(tif, (uint8*) bufs[i], tilesize);
+			nrows = td->td_imagelength - y < tl ?
+			    td->td_imagelength - y : tl;
+			for (r = 0; r < nrows; r++) {
+				/* Whole tiles, then what is left of the last */
+				for (i = 0; i + 1 < across; i++)
+					digestUpdate(st, (uint8*) bufs[i] +
+					    (tmsize_t) r * rowsize, rowsize);
+				digestRow(st, (uint8*) bufs[i] +
+				    (tmsize_t) r * rowsize,
+				    (td->td_imagewidth - i * tw) * pixelbits);
+			}
+		}
+	ret = 1;
+done:
+	if (bufs) {
+		for (i = 0; i < across; i++)
+			if (bufs[i])
+				_TIFFfreeExt(tif, bufs[i]);
+		_TIFFfreeExt(tif, bufs);
+	}
+	if (list)
+		_TIFFfreeExt(tif, list);
+	return (ret);
+}
+
+/*
+ * Compute the digest of the decoded image data of the current
+ * directory, decoding on up to nthreads threads (one per processor
+ * if nthreads <= 0).  Equal images give equal digests whatever their
+ * compression and strip or tile layout, as long as the samples keep
+ * the same planar configuration.  Returns 1 on success and 0 on error.
+ */
+int
+TIFFDigestDirectory(TIFF* tif, uint64* digest, int nthreads)
+{
+	static const char module[] = "TIFFDigestDirectory";
+	TIFFDirectory *td = &tif->tif_dir;
+	TIFFDigestState st;
+	uint64 pixelbits;
+	int ret;
+
+	if (tif->tif_mode == O_WRONLY) {
+		TIFFErrorExtR(tif, module,
+		    "File not open for reading");
+		return (0);
+	}
+	if (td->td_imagedepth > 1) {
+		TIFFErrorExtR(tif, module,
+		    "Can not digest images with more than one slice");
+		return (0);
+	}
+	if (nthreads <= 0)
+		nthreads = _TIFFThreadConcurrency(tif);
+	pixelbits = td->td_bitspersample;
+	if (td->td_planarconfig == PLANARCONFIG_CONTIG)
+		pixelbits *= td->td_samplesperpixel;
+	digestInit(&st);
+	if (td->td_imagewidth == 0 || td->td_imagelength == 0)
+		ret = 1;
+	else if (isTiled(tif))
+		ret = digestTiles(tif, &st, pixelbits, nthreads);
+	else
+		ret = digestStrips(tif, &st, td->td_imagewidth * pixelbits,
+		    nthreads);
+	if (ret)
+		*digest = digestFinal(&st);
+	return (ret);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -40,43 +40,56 @@
 #define DATATYPE_IEEEFP		3       /* !IEEE floating point data */
 
 static void
-setByteArray(void** vpp, void* vp, size_t nmemb, size_t elem_size)
+setByteArray(TIFF* tif, void** vpp, void* vp, size_t nmemb, size_t elem_size)
 {
 	if (*vpp) {
-		_TIFFfree(*vpp);
+		_TIFFfreeExt(tif, *vpp);
 		*vpp = 0;
 	}
 	if (vp) {
 		tmsize_t bytes = (tmsize_t)(nmemb * elem_size);
 		if (elem_size && bytes / elem_size == nmemb)
-			*vpp = (void*) _TIFFmalloc(bytes);
+			*vpp = (void*) _TIFFmallocExt(tif, bytes);
 		if (*vpp)
 			_TIFFmemcpy(*vpp, vp, bytes);
 	}
 }
 void _TIFFsetByteArray(void** vpp, void* vp, uint32 n)
-    { setByteArray(vpp, vp, n, 1); }
+    { setByteArray(NULL, vpp, vp, n, 1); }
 void _TIFFsetString(char** cpp, char* cp)
-    { setByteArray((void**) cpp, (void*) cp, strlen(cp)+1, 1); }
-static void _TIFFsetNString(char** cpp, char* cp, uint32 n)
-    { setByteArray((void**) cpp, (void*) cp, n, 1); }
+    { setByteArray(NULL, (void**) cpp, (void*) cp, strlen(cp)+1, 1); }
 void _TIFFsetShortArray(uint16** wpp, uint16* wp, uint32 n)
-    { setByteArray((void**) wpp, (void*) wp, n, sizeof (uint16)); }
+    { setByteArray(NULL, (void**) wpp, (void*) wp, n, sizeof (uint16)); }
 void _TIFFsetLongArray(uint32** lpp, uint32* lp, uint32 n)
-    { setByteArray((void**) lpp, (void*) lp, n, sizeof (uint32)); }
-static void _TIFFsetLong8Array(uint64** lpp, uint64* lp, uint32 n)
-    { setByteArray((void**) lpp, (void*) lp, n, sizeof (uint64)); }
+    { setByteArray(NULL, (void**) lpp, (void*) lp, n, sizeof (uint32)); }
 void _TIFFsetFloatArray(float** fpp, float* fp, uint32 n)
-    { setByteArray((void**) fpp, (void*) fp, n, sizeof (float)); }
+    { setByteArray(NULL, (void**) fpp, (void*) fp, n, sizeof (float)); }
 void _TIFFsetDoubleArray(double** dpp, double* dp, uint32 n)
-    { setByteArray((void**) dpp, (void*) dp, n, sizeof (double)); }
+    { setByteArray(NULL, (void**) dpp, (void*) dp, n, sizeof (double)); }
+
+/*
+ * Variants allocating through the handle's allocator, for data that
+ * is owned by the handle.
+ */
+void _TIFFsetByteArrayExt(TIFF* tif, void** vpp, void* vp, uint32 n)
+    { setByteArray(tif, vpp, vp, n, 1); }
+static void _TIFFsetNStringExt(TIFF* tif, char** cpp, char* cp, uint32 n)
+    { setByteArray(tif, (void**) cpp, (void*) cp, n, 1); }
+static void _TIFFsetLong8ArrayExt(TIFF* tif, uint64** lpp, uint64* lp, uint32 n)
+    { setByteArray(tif, (void**) lpp, (void*) lp, n, sizeof (uint64)); }
+void _TIFFsetShortArrayExt(TIFF* tif, uint16** wpp, uint16* wp, uint32 n)
+    { setByteArray(tif, (void**) wpp, (void*) wp, n, sizeof (uint16)); }
+void _TIFFsetFloatArrayExt(TIFF* tif, float** fpp, float* fp, uint32 n)
+    { setByteArray(tif, (void**) fpp, (void*) fp, n, sizeof (float)); }
+void _TIFFsetDoubleArrayExt(TIFF* tif, double** dpp, double* dp, uint32 n)
+    { setByteArray(tif, (void**) dpp, (void*) dp, n, sizeof (double)); }
 
 static void
-setDoubleArrayOneValue(double** vpp, double value, size_t nmemb)
+setDoubleArrayOneValue(TIFF* tif, double** vpp, double value, size_t nmemb)
 {
 	if (*vpp)
-		_TIFFfree(*vpp);
-	*vpp = _TIFFmalloc(nmemb*sizeof(double));
+		_TIFFfreeExt(tif, *vpp);
+	*vpp = _TIFFmallocExt(tif, nmemb*sizeof(double));
 	if (*vpp)
 	{
 		while (nmemb--)
@@ -88,11 +101,12 @@ setDoubleArrayOneValue(double** vpp, double value, size_t nmemb)
  * Install extra samples information.
  */
 static int
-setExtraSamples(TIFFDirectory* td, va_list ap, uint32* v)
+setExtraSamples(TIFF* tif, va_list ap, uint32* v)
 {
 /* XXX: Unassociated alpha data == 999 is a known Corel Draw bug, see below */
 #define EXTRASAMPLE_COREL_UNASSALPHA 999 
 
+	TIFFDirectory* td = &tif->tif_dir;
 	uint16* va;
 	uint32 i;
 
@@ -117,7 +131,7 @@ setExtraSamples(TIFFDirectory* td, va_list ap, uint32* v)
 		}
 	}
 	td->td_extrasamples = (uint16) *v;
-	_TIFFsetShortArray(&td->td_sampleinfo, va, td->td_extrasamples);
+	_TIFFsetShortArrayExt(tif, &td->td_sampleinfo, va, td->td_extrasamples);
 	return 1;
 
 #undef EXTRASAMPLE_COREL_UNASSALPHA
@@ -145,7 +159,7 @@ checkInkNamesString(TIFF* tif, uint32 slen, const char* s)
 		return ((uint32)(cp-s));
 	}
 bad:
-	TIFFErrorExt(tif->tif_clientdata, "TIFFSetField",
+	TIFFErrorExtR(tif, "TIFFSetField",
 	    "%s: Invalid InkNames value; expecting %d names, found %d",
 	    tif->tif_name,
 	    td->td_samplesperpixel,
@@ -269,20 +283,20 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
             /* See http://bugzilla.maptools.org/show_bug.cgi?id=2500 */
             if( td->td_sminsamplevalue != NULL )
             {
-                TIFFWarningExt(tif->tif_clientdata,module,
+                TIFFWarningExtR(tif,module,
                     "SamplesPerPixel tag value is changing, "
                     "but SMinSampleValue tag was read with a different value. Cancelling it");
                 TIFFClrFieldBit(tif,FIELD_SMINSAMPLEVALUE);
-                _TIFFfree(td->td_sminsamplevalue);
+                _TIFFfreeExt(tif, td->td_sminsamplevalue);
                 td->td_sminsamplevalue = NULL;
             }
             if( td->td_smaxsamplevalue != NULL )
             {
-                TIFFWarningExt(tif->tif_clientdata,module,
+                TIFFWarningExtR(tif,module,
                     "SamplesPerPixel tag value is changing, "
                     "but SMaxSampleValue tag was read with a different value. Cancelling it");
                 TIFFClrFieldBit(tif,FIELD_SMAXSAMPLEVALUE);
-                _TIFFfree(td->td_smaxsamplevalue);
+                _TIFFfreeExt(tif, td->td_smaxsamplevalue);
                 td->td_smaxsamplevalue = NULL;
             }
         }
@@ -306,15 +320,15 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 		break;
 	case TIFFTAG_SMINSAMPLEVALUE:
 		if (tif->tif_flags & TIFF_PERSAMPLE)
-			_TIFFsetDoubleArray(&td->td_sminsamplevalue, va_arg(ap, double*), td->td_samplesperpixel);
+			_TIFFsetDoubleArrayExt(tif, &td->td_sminsamplevalue, va_arg(ap, double*), td->td_samplesperpixel);
 		else
-			setDoubleArrayOneValue(&td->td_sminsamplevalue, va_arg(ap, double), td->td_samplesperpixel);
+			setDoubleArrayOneValue(tif, &td->td_sminsamplevalue, va_arg(ap, double), td->td_samplesperpixel);
 		break;
 	case TIFFTAG_SMAXSAMPLEVALUE:
 		if (tif->tif_flags & TIFF_PERSAMPLE)
-			_TIFFsetDoubleArray(&td->td_smaxsamplevalue, va_arg(ap, double*), td->td_samplesperpixel);
+			_TIFFsetDoubleArrayExt(tif, &td->td_smaxsamplevalue, va_arg(ap, double*), td->td_samplesperpixel);
 		else
-			setDoubleArrayOneValue(&td->td_smaxsamplevalue, va_arg(ap, double), td->td_samplesperpixel);
+			setDoubleArrayOneValue(tif, &td->td_smaxsamplevalue, va_arg(ap, double), td->td_samplesperpixel);
 		break;
 	case TIFFTAG_XRESOLUTION:
         dblval = va_arg(ap, double);
@@ -356,19 +370,19 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 		break;
 	case TIFFTAG_COLORMAP:
 		v32 = (uint32)(1L<<td->td_bitspersample);
-		_TIFFsetShortArray(&td->td_colormap[0], va_arg(ap, uint16*), v32);
-		_TIFFsetShortArray(&td->td_colormap[1], va_arg(ap, uint16*), v32);
-		_TIFFsetShortArray(&td->td_colormap[2], va_arg(ap, uint16*), v32);
+		_TIFFsetShortArrayExt(tif, &td->td_colormap[0], va_arg(ap, uint16*), v32);
+		_TIFFsetShortArrayExt(tif, &td->td_colormap[1], va_arg(ap, uint16*), v32);
+		_TIFFsetShortArrayExt(tif, &td->td_colormap[2], va_arg(ap, uint16*), v32);
 		break;
 	case TIFFTAG_EXTRASAMPLES:
-		if (!setExtraSamples(td, ap, &v))
+		if (!setExtraSamples(tif, ap, &v))
 			goto badvalue;
 		break;
 	case TIFFTAG_MATTEING:
 		td->td_extrasamples =  (((uint16) va_arg(ap, uint16_vap)) != 0);
 		if (td->td_extrasamples) {
 			uint16 sv = EXTRASAMPLE_ASSOCALPHA;
-			_TIFFsetShortArray(&td->td_sampleinfo, &sv, 1);
+			_TIFFsetShortArrayExt(tif, &td->td_sampleinfo, &sv, 1);
 		}
 		break;
 	case TIFFTAG_TILEWIDTH:
@@ -376,7 +390,7 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 		if (v32 % 16) {
 			if (tif->tif_mode != O_RDONLY)
 				goto badvalue32;
-			TIFFWarningExt(tif->tif_clientdata, tif->tif_name,
+			TIFFWarningExtR(tif, tif->tif_name,
 				"Nonstandard tile width %d, convert file", v32);
 		}
 		td->td_tilewidth = v32;
@@ -387,7 +401,7 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 		if (v32 % 16) {
 			if (tif->tif_mode != O_RDONLY)
 				goto badvalue32;
-			TIFFWarningExt(tif->tif_clientdata, tif->tif_name,
+			TIFFWarningExtR(tif, tif->tif_name,
 			    "Nonstandard tile length %d, convert file", v32);
 		}
 		td->td_tilelength = v32;
@@ -433,10 +447,10 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 	case TIFFTAG_SUBIFD:
 		if ((tif->tif_flags & TIFF_INSUBIFD) == 0) {
 			td->td_nsubifd = (uint16) va_arg(ap, uint16_vap);
-			_TIFFsetLong8Array(&td->td_subifd, (uint64*) va_arg(ap, uint64*),
+			_TIFFsetLong8ArrayExt(tif, &td->td_subifd, (uint64*) va_arg(ap, uint64*),
 			    (uint32) td->td_nsubifd);
 		} else {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				     "%s: Sorry, cannot nest SubIFDs",
 				     tif->tif_name);
 			status = 0;
@@ -452,12 +466,12 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 	case TIFFTAG_TRANSFERFUNCTION:
 		v = (td->td_samplesperpixel - td->td_extrasamples) > 1 ? 3 : 1;
 		for (i = 0; i < v; i++)
-			_TIFFsetShortArray(&td->td_transferfunction[i],
+			_TIFFsetShortArrayExt(tif, &td->td_transferfunction[i],
 			    va_arg(ap, uint16*), 1U<<td->td_bitspersample);
 		break;
 	case TIFFTAG_REFERENCEBLACKWHITE:
 		/* XXX should check for null range */
-		_TIFFsetFloatArray(&td->td_refblackwhite, va_arg(ap, float*), 6);
+		_TIFFsetFloatArrayExt(tif, &td->td_refblackwhite, va_arg(ap, float*), 6);
 		break;
 	case TIFFTAG_INKNAMES:
 		v = (uint16) va_arg(ap, uint16_vap);
@@ -465,7 +479,7 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 		v = checkInkNamesString(tif, v, s);
 		status = v > 0;
 		if( v > 0 ) {
-			_TIFFsetNString(&td->td_inknames, s, v);
+			_TIFFsetNStringExt(tif, &td->td_inknames, s, v);
 			td->td_inknameslen = v;
 		}
 		break;
@@ -490,7 +504,7 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 		 * compression schemes and codec-specific tags are blindly copied.
 		 */
 		if(fip->field_bit != FIELD_CUSTOM) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "%s: Invalid %stag \"%s\" (not supported by codec)",
 			    tif->tif_name, isPseudoTag(tag) ? "pseudo-" : "",
 			    fip->field_name);
@@ -506,7 +520,7 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 			if (td->td_customValues[iCustom].info->field_tag == tag) {
 				tv = td->td_customValues + iCustom;
 				if (tv->value != NULL) {
-					_TIFFfree(tv->value);
+					_TIFFfreeExt(tif, tv->value);
 					tv->value = NULL;
 				}
 				break;
@@ -521,10 +535,10 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 
 			td->td_customValueCount++;
 			new_customValues = (TIFFTagValue *)
-			    _TIFFrealloc(td->td_customValues,
+			    _TIFFreallocExt(tif, td->td_customValues,
 			    sizeof(TIFFTagValue) * td->td_customValueCount);
 			if (!new_customValues) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				    "%s: Failed to allocate space for list of custom values",
 				    tif->tif_name);
 				status = 0;
@@ -545,7 +559,7 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 		tv_size = _TIFFDataSize(fip->field_type);
 		if (tv_size == 0) {
 			status = 0;
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "%s: Bad field type %d for \"%s\"",
 			    tif->tif_name, fip->field_type,
 			    fip->field_name);
@@ -568,7 +582,7 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 				ma=(uint32)(strlen(mb)+1);
 			}
 			tv->count=ma;
-			setByteArray(&tv->value,mb,ma,1);
+			setByteArray(tif, &tv->value,mb,ma,1);
 		}
 		else
 		{
@@ -587,7 +601,7 @@ _TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 
 			if (tv->count == 0) {
 				status = 0;
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "%s: Null count for \"%s\" (type "
 					     "%d, writecount %d, passcount %d)",
 					     tif->tif_name,
@@ -716,7 +730,7 @@ end:
 badvalue:
         {
 		const TIFFField* fip2=TIFFFieldWithTag(tif,tag);
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		     "%s: Bad value %u for \"%s\" tag",
 		     tif->tif_name, v,
 		     fip2 ? fip2->field_name : "Unknown");
@@ -726,7 +740,7 @@ badvalue:
 badvalue32:
         {
 		const TIFFField* fip2=TIFFFieldWithTag(tif,tag);
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		     "%s: Bad value %u for \"%s\" tag",
 		     tif->tif_name, v32,
 		     fip2 ? fip2->field_name : "Unknown");
@@ -736,7 +750,7 @@ badvalue32:
 badvaluedouble:
         {
         const TIFFField* fip2=TIFFFieldWithTag(tif,tag);
-        TIFFErrorExt(tif->tif_clientdata, module,
+        TIFFErrorExtR(tif, module,
              "%s: Bad value %f for \"%s\" tag",
              tif->tif_name, dblval,
              fip2 ? fip2->field_name : "Unknown");
@@ -759,7 +773,7 @@ OkToChangeTag(TIFF* tif, uint32 tag)
 {
 	const TIFFField* fip = TIFFFindField(tif, tag, TIFF_ANY);
 	if (!fip) {			/* unknown tag */
-		TIFFErrorExt(tif->tif_clientdata, "TIFFSetField", "%s: Unknown %stag %u",
+		TIFFErrorExtR(tif, "TIFFSetField", "%s: Unknown %stag %u",
 		    tif->tif_name, isPseudoTag(tag) ? "pseudo-" : "", tag);
 		return (0);
 	}
@@ -771,11 +785,16 @@ OkToChangeTag(TIFF* tif, uint32 tag)
 		 * to those tags that don't/shouldn't affect the
 		 * compression and/or format of the data.
 		 */
-		TIFFErrorExt(tif->tif_clientdata, "TIFFSetField",
+		TIFFErrorExtR(tif, "TIFFSetField",
 		    "%s: Cannot modify tag \"%s\" while writing",
 		    tif->tif_name, fip->field_name);
 		return (0);
 	}
+	/* Pseudo-tags only change the codec state of the handle */
+	if (!isPseudoTag(tag) && !_TIFFCheckUnshared(tif, 1, "TIFFSetField"))
+		return (0);
+	/* TIFFEncodeChunk() workers copied the old settings */
+	tif->tif_encodergen++;
 	return (1);
 }
 
@@ -810,6 +829,13 @@ TIFFUnsetField(TIFF* tif, uint32 tag)
     if( !fip )
         return 0;
 
+    if( !isPseudoTag(tag) && !_TIFFCheckUnshared(tif, 1, "TIFFUnsetField") )
+        return 0;
+    tif->tif_encodergen++;
+
+    if( td->td_ndeferredtags )
+        _TIFFFetchDeferredTag(tif, tag);
+
     if( fip->field_bit != FIELD_CUSTOM )
         TIFFClrFieldBit(tif, fip->field_bit);
     else
@@ -826,7 +852,7 @@ TIFFUnsetField(TIFF* tif, uint32 tag)
 
         if( i < td->td_customValueCount )
         {
-            _TIFFfree(tv->value);
+            _TIFFfreeExt(tif, tv->value);
             for( ; i < td->td_customValueCount-1; i++) {
                 td->td_customValues[i] = td->td_customValues[i+1];
             }
@@ -848,6 +874,9 @@ TIFFUnsetField(TIFF* tif, uint32 tag)
 int
 TIFFVSetField(TIFF* tif, uint32 tag, va_list ap)
 {
+	/* Read a deferred value first so that it cannot override this one */
+	if (tif->tif_dir.td_ndeferredtags)
+		_TIFFFetchDeferredTag(tif, tag);
 	return OkToChangeTag(tif, tag) ?
 	    (*tif->tif_tagmethods.vsetfield)(tif, tag, ap) : 0;
 }
@@ -889,7 +918,7 @@ _TIFFVGetField(TIFF* tif, uint32 tag, va_list ap)
                 /* Fixes http://bugzilla.maptools.org/show_bug.cgi?id=2599 */
                 if( val > td->td_samplesperpixel )
                 {
-                    TIFFWarningExt(tif->tif_clientdata,"_TIFFVGetField",
+                    TIFFWarningExtR(tif,"_TIFFVGetField",
                                    "Truncating NumberOfInks from %u to %u",
                                    val, td->td_samplesperpixel);
                     val = td->td_samplesperpixel;
@@ -1001,13 +1030,21 @@ _TIFFVGetField(TIFF* tif, uint32 tag, va_list ap)
 			break;
 		case TIFFTAG_STRIPOFFSETS:
 		case TIFFTAG_TILEOFFSETS:
-			_TIFFFillStriles( tif );
-			*va_arg(ap, uint64**) = td->td_stripoffset;
-			break;
 		case TIFFTAG_STRIPBYTECOUNTS:
 		case TIFFTAG_TILEBYTECOUNTS:
+			if (td->td_strilewindow != NULL) {
+				TIFFErrorExtR(tif, tif->tif_name,
+				    "%s: Strip/tile arrays are streamed to the file, "
+				    "use TIFFGetStrileOffset()", fip->field_name);
+				ret_val = 0;
+				break;
+			}
 			_TIFFFillStriles( tif );
-			*va_arg(ap, uint64**) = td->td_stripbytecount;
+			if (standard_tag == TIFFTAG_STRIPOFFSETS ||
+			    standard_tag == TIFFTAG_TILEOFFSETS)
+				*va_arg(ap, uint64**) = td->td_stripoffset;
+			else
+				*va_arg(ap, uint64**) = td->td_stripbytecount;
 			break;
 		case TIFFTAG_MATTEING:
 			*va_arg(ap, uint16*) =
@@ -1091,7 +1128,7 @@ _TIFFVGetField(TIFF* tif, uint32 tag, va_list ap)
 				 */
 				if( fip->field_bit != FIELD_CUSTOM )
 				{
-					TIFFErrorExt(tif->tif_clientdata, "_TIFFVGetField",
+					TIFFErrorExtR(tif, "_TIFFVGetField",
 					    "%s: Invalid %stag \"%s\" "
 					    "(not supported by codec)",
 					    tif->tif_name,
@@ -1232,14 +1269,18 @@ TIFFGetField(TIFF* tif, uint32 tag, ...)
 int
 TIFFVGetField(TIFF* tif, uint32 tag, va_list ap)
 {
-	const TIFFField* fip = TIFFFindField(tif, tag, TIFF_ANY);
+	const TIFFField* fip;
+
+	if (tif->tif_dir.td_ndeferredtags)
+		_TIFFFetchDeferredTag(tif, tag);
+	fip = TIFFFindField(tif, tag, TIFF_ANY);
 	return (fip && (isPseudoTag(tag) || TIFFFieldSet(tif, fip->field_bit)) ?
 	    (*tif->tif_tagmethods.vgetfield)(tif, tag, ap) : 0);
 }
 
 #define	CleanupField(member) {		\
     if (td->member) {			\
-	_TIFFfree(td->member);		\
+	_TIFFfreeExt(tif, td->member);		\
 	td->member = 0;			\
     }					\
 }
@@ -1253,6 +1294,16 @@ TIFFFreeDirectory(TIFF* tif)
 	TIFFDirectory *td = &tif->tif_dir;
 	int            i;
 
+	tif->tif_encodergen++;
+	_TIFFFreeTileRows(tif);
+	_TIFFFreeChunkStats(tif);
+	_TIFFFreeChunkCRC(tif);
+	/* The directory of a clone belongs to its template */
+	if (tif->tif_shareddir) {
+		_TIFFmemset(td, 0, sizeof(TIFFDirectory));
+		tif->tif_shareddir = 0;
+		return;
+	}
 	_TIFFmemset(td->td_fieldsset, 0, FIELD_SETLONGS);
 	CleanupField(td_sminsamplevalue);
 	CleanupField(td_smaxsamplevalue);
@@ -1266,6 +1317,7 @@ TIFFFreeDirectory(TIFF* tif)
 	CleanupField(td_transferfunction[0]);
 	CleanupField(td_transferfunction[1]);
 	CleanupField(td_transferfunction[2]);
+	_TIFFFreeStrileWindow(tif);
 	CleanupField(td_stripoffset);
 	CleanupField(td_stripbytecount);
 	TIFFClrFieldBit(tif, FIELD_YCBCRSUBSAMPLING);
@@ -1274,16 +1326,17 @@ TIFFFreeDirectory(TIFF* tif)
 	/* Cleanup custom tag values */
 	for( i = 0; i < td->td_customValueCount; i++ ) {
 		if (td->td_customValues[i].value)
-			_TIFFfree(td->td_customValues[i].value);
+			_TIFFfreeExt(tif, td->td_customValues[i].value);
 	}
 
 	td->td_customValueCount = 0;
 	CleanupField(td_customValues);
+	CleanupField(td_deferredtags);
+	td->td_ndeferredtags = 0;
 
-#if defined(DEFER_STRILE_LOAD)
+        _TIFFFreeStrilePages(tif);
         _TIFFmemset( &(td->td_stripoffset_entry), 0, sizeof(TIFFDirEntry));
         _TIFFmemset( &(td->td_stripbytecount_entry), 0, sizeof(TIFFDirEntry));
-#endif        
 }
 #undef CleanupField
 
@@ -1314,6 +1367,8 @@ TIFFCreateDirectory(TIFF* tif)
 	tif->tif_diroff = 0;
 	tif->tif_nextdiroff = 0;
 	tif->tif_curoff = 0;
+	tif->tif_dirreserveoff = 0;
+	tif->tif_dirreservesize = 0;
 	tif->tif_row = (uint32) -1;
 	tif->tif_curstrip = (uint32) -1;
 
@@ -1335,6 +1390,8 @@ TIFFCreateCustomDirectory(TIFF* tif, const TIFFFieldArray* infoarray)
 	tif->tif_diroff = 0;
 	tif->tif_nextdiroff = 0;
 	tif->tif_curoff = 0;
+	tif->tif_dirreserveoff = 0;
+	tif->tif_dirreservesize = 0;
 	tif->tif_row = (uint32) -1;
 	tif->tif_curstrip = (uint32) -1;
 
@@ -1393,9 +1450,9 @@ TIFFDefaultDirectory(TIFF* tif)
 
 		for (i = 0; i < tif->tif_nfieldscompat; i++) {
 				if (tif->tif_fieldscompat[i].allocated_size)
-						_TIFFfree(tif->tif_fieldscompat[i].fields);
+						_TIFFfreeExt(tif, tif->tif_fieldscompat[i].fields);
 		}
-		_TIFFfree(tif->tif_fieldscompat);
+		_TIFFfreeExt(tif, tif->tif_fieldscompat);
 		tif->tif_nfieldscompat = 0;
 		tif->tif_fieldscompat = NULL;
 	}
@@ -1438,7 +1495,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 			poffb=poffa+sizeof(uint16);
 			if (((uint64)poffa!=poff)||(poffb<poffa)||(poffb<(tmsize_t)sizeof(uint16))||(poffb>tif->tif_size))
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Error fetching directory count");
+				TIFFErrorExtR(tif,module,"Error fetching directory count");
                                   *nextdir=0;
 				return(0);
 			}
@@ -1449,7 +1506,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 			poffd=poffc+sizeof(uint32);
 			if ((poffc<poffb)||(poffc<dircount*12)||(poffd<poffc)||(poffd<(tmsize_t)sizeof(uint32))||(poffd>tif->tif_size))
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Error fetching directory link");
+				TIFFErrorExtR(tif,module,"Error fetching directory link");
 				return(0);
 			}
 			if (off!=NULL)
@@ -1468,7 +1525,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 			poffb=poffa+sizeof(uint64);
 			if (((uint64)poffa!=poff)||(poffb<poffa)||(poffb<(tmsize_t)sizeof(uint64))||(poffb>tif->tif_size))
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Error fetching directory count");
+				TIFFErrorExtR(tif,module,"Error fetching directory count");
 				return(0);
 			}
 			_TIFFmemcpy(&dircount64,tif->tif_base+poffa,sizeof(uint64));
@@ -1476,7 +1533,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 				TIFFSwabLong8(&dircount64);
 			if (dircount64>0xFFFF)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Sanity check on directory count failed");
+				TIFFErrorExtR(tif,module,"Sanity check on directory count failed");
 				return(0);
 			}
 			dircount16=(uint16)dircount64;
@@ -1484,7 +1541,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 			poffd=poffc+sizeof(uint64);
 			if ((poffc<poffb)||(poffc<dircount16*20)||(poffd<poffc)||(poffd<(tmsize_t)sizeof(uint64))||(poffd>tif->tif_size))
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Error fetching directory link");
+				TIFFErrorExtR(tif,module,"Error fetching directory link");
 				return(0);
 			}
 			if (off!=NULL)
@@ -1503,7 +1560,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 			uint32 nextdir32;
 			if (!SeekOK(tif, *nextdir) ||
 			    !ReadOK(tif, &dircount, sizeof (uint16))) {
-				TIFFErrorExt(tif->tif_clientdata, module, "%s: Error fetching directory count",
+				TIFFErrorExtR(tif, module, "%s: Error fetching directory count",
 				    tif->tif_name);
 				return (0);
 			}
@@ -1516,7 +1573,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 				(void) TIFFSeekFile(tif,
 				    dircount*12, SEEK_CUR);
 			if (!ReadOK(tif, &nextdir32, sizeof (uint32))) {
-				TIFFErrorExt(tif->tif_clientdata, module, "%s: Error fetching directory link",
+				TIFFErrorExtR(tif, module, "%s: Error fetching directory link",
 				    tif->tif_name);
 				return (0);
 			}
@@ -1530,7 +1587,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 			uint16 dircount16;
 			if (!SeekOK(tif, *nextdir) ||
 			    !ReadOK(tif, &dircount64, sizeof (uint64))) {
-				TIFFErrorExt(tif->tif_clientdata, module, "%s: Error fetching directory count",
+				TIFFErrorExtR(tif, module, "%s: Error fetching directory count",
 				    tif->tif_name);
 				return (0);
 			}
@@ -1538,7 +1595,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 				TIFFSwabLong8(&dircount64);
 			if (dircount64>0xFFFF)
 			{
-				TIFFErrorExt(tif->tif_clientdata, module, "Error fetching directory count");
+				TIFFErrorExtR(tif, module, "Error fetching directory count");
 				return(0);
 			}
 			dircount16 = (uint16)dircount64;
@@ -1549,7 +1606,7 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 				(void) TIFFSeekFile(tif,
 				    dircount16*20, SEEK_CUR);
 			if (!ReadOK(tif, nextdir, sizeof (uint64))) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
                                              "%s: Error fetching directory link",
 				    tif->tif_name);
 				return (0);
@@ -1561,6 +1618,132 @@ TIFFAdvanceDirectory(TIFF* tif, uint64* nextdir, uint64* off)
 	}
 }
 
+/*
+ * The offsets of the directories of the main IFD chain are remembered
+ * as they are first seen, so that seeking back to a directory does not
+ * require walking the chain from the header again.  Entry 0 is the
+ * first directory; each further entry is the link field of the
+ * directory found at the previous one.
+ */
+static uint64
+_TIFFFirstDirOffset(TIFF* tif)
+{
+	if (!(tif->tif_flags&TIFF_BIGTIFF))
+		return (tif->tif_header.classic.tiff_diroff);
+	else
+		return (tif->tif_header.big.tiff_diroff);
+}
+
+static int
+_TIFFAppendDirIndex(TIFF* tif, uint64 diroff)
+{
+	if (tif->tif_ndirindex == 65535)
+		return (0);
+	if (tif->tif_ndirindex >= tif->tif_dirindexsize) {
+		uint32 size = tif->tif_dirindexsize ?
+		    2 * tif->tif_dirindexsize : 16;
+		uint64* dirindex;
+
+		if (size > 65535)
+			size = 65535;
+		dirindex = (uint64*) _TIFFCheckRealloc(tif, tif->tif_dirindex,
+		    size, sizeof(uint64), "for directory index");
+		if (dirindex == NULL)
+			return (0);
+		tif->tif_dirindex = dirindex;
+		tif->tif_dirindexsize = size;
+	}
+	tif->tif_dirindex[tif->tif_ndirindex++] = diroff;
+	return (1);
+}
+
+/*
+ * Forget all known directory offsets, e.g. once the chain changed.
+ */
+void
+_TIFFResetDirIndex(TIFF* tif)
+{
+	tif->tif_ndirindex = 0;
+	tif->tif_dirindexdone = 0;
+}
+
+static int
+_TIFFSeedDirIndex(TIFF* tif)
+{
+	uint64 first;
+
+	if (tif->tif_ndirindex > 0)
+		return (1);
+	first = _TIFFFirstDirOffset(tif);
+	return (first != 0 && _TIFFAppendDirIndex(tif, first));
+}
+
+/*
+ * Record that the directory at diroff, which is number dirn if it is
+ * part of the main chain, links to nextdiroff.
+ */
+void
+_TIFFLinkDirIndex(TIFF* tif, uint16 dirn, uint64 diroff, uint64 nextdiroff)
+{
+	if (!_TIFFSeedDirIndex(tif))
+		return;
+	if ((uint32) dirn + 1 != tif->tif_ndirindex ||
+	    tif->tif_dirindex[dirn] != diroff || tif->tif_dirindexdone)
+		return;
+	if (nextdiroff == 0)
+		tif->tif_dirindexdone = 1;
+	else
+		(void) _TIFFAppendDirIndex(tif, nextdiroff);
+}
+
+/*
+ * Record that the directory at diroff was just linked at the end of the
+ * main chain after the one at prevdiroff, or as the first directory if
+ * prevdiroff is 0.  A complete index stays complete, so that counting
+ * the directories of a file being written does not walk the chain;
+ * any other index is dropped.
+ */
+void
+_TIFFAppendDirIndexLink(TIFF* tif, uint64 prevdiroff, uint64 diroff)
+{
+	if (prevdiroff == 0) {
+		_TIFFResetDirIndex(tif);
+		if (_TIFFAppendDirIndex(tif, diroff))
+			tif->tif_dirindexdone = 1;
+		return;
+	}
+	if (!tif->tif_dirindexdone || tif->tif_ndirindex == 0 ||
+	    tif->tif_dirindex[tif->tif_ndirindex - 1] != prevdiroff ||
+	    !_TIFFAppendDirIndex(tif, diroff))
+		_TIFFResetDirIndex(tif);
+}
+
+/*
+ * Walk the main chain from the last known directory until directory
+ * dirn is known or the end of the chain is reached, recording the
+ * offsets seen.  Returns 0 on a read error.
+ */
+static int
+_TIFFExtendDirIndex(TIFF* tif, uint32 dirn)
+{
+	uint64 diroff, nextdir;
+	uint16 n;
+
+	if (!_TIFFSeedDirIndex(tif))
+		return (1);		/* no directory at all */
+	while (tif->tif_ndirindex <= dirn && !tif->tif_dirindexdone) {
+		n = (uint16) (tif->tif_ndirindex - 1);
+		diroff = nextdir = tif->tif_dirindex[n];
+		if (!TIFFAdvanceDirectory(tif, &nextdir, NULL))
+			return (0);
+		_TIFFLinkDirIndex(tif, n, diroff, nextdir);
+		if (tif->tif_ndirindex == (uint32) n + 1 &&
+		    !tif->tif_dirindexdone)
+			break;		/* index is full */
+	}
+	return (1);
+}
+
 /*
  * Count the number of directories in a file.
  */
@@ -1568,27 +1751,80 @@ uint16
 TIFFNumberOfDirectories(TIFF* tif)
 {
 	static const char module[] = "TIFFNumberOfDirectories";
-	uint64 nextdir;
-	uint16 n;
-	if (!(tif->tif_flags&TIFF_BIGTIFF))
-		nextdir = tif->tif_header.classic.tiff_diroff;
-	else
-		nextdir = tif->tif_header.big.tiff_diroff;
-	n = 0;
-	while (nextdir != 0 && TIFFAdvanceDirectory(tif, &nextdir, NULL))
-        {
-                if (n != 65535) {
-                        ++n;
-                }
-		else
-                {
-                        TIFFErrorExt(tif->tif_clientdata, module,
-                                     "Directory count exceeded 65535 limit,"
-                                     " giving up on counting.");
-                        return (65535);
-                }
-        }
-	return (n);
+
+	if (!_TIFFExtendDirIndex(tif, 65535)) {
+		/* Count the directories read successfully */
+		return (tif->tif_ndirindex > 0 ?
+		    (uint16) (tif->tif_ndirindex - 1) : 0);
+	}
+	if (tif->tif_ndirindex == 65535 && !tif->tif_dirindexdone)
+	{
+		TIFFErrorExtR(tif, module,
+			     "Directory count exceeded 65535 limit,"
+			     " giving up on counting.");
+	}
+	return (tif->tif_ndirindex);
+}
+
+/*
+ * Record the offsets of all directories of the main chain in one
+ * forward scan, so that any of them can be made current in constant
+ * time.
+ */
+int
+TIFFBuildDirectoryIndex(TIFF* tif)
+{
+	return (_TIFFExtendDirIndex(tif, 65535));
+}
+
+/*
+ * Copy up to maxcount known directory offsets, starting with the first
+ * directory, into offsets.  Returns the number of offsets known.
+ */
+uint16
+TIFFGetDirectoryIndex(TIFF* tif, uint64* offsets, uint16 maxcount)
+{
+	uint16 n = tif->tif_ndirindex < maxcount ? tif->tif_ndirindex : maxcount;
+
+	if (n > 0)
+		_TIFFmemcpy(offsets, tif->tif_dirindex, n * sizeof(uint64));
+	return (tif->tif_ndirindex);
+}
+
+/*
+ * Replace the known directory offsets by the count entries of offsets,
+ * typically obtained from TIFFGetDirectoryIndex() on the same file.
+ * The offsets are trusted as far as they are used; only basic sanity
+ * checks are done here.
+ */
+int
+TIFFSetDirectoryIndex(TIFF* tif, const uint64* offsets, uint16 count)
+{
+	static const char module[] = "TIFFSetDirectoryIndex";
+	uint16 i;
+
+	if (count > 0 && offsets[0] != _TIFFFirstDirOffset(tif)) {
+		TIFFErrorExtR(tif, module,
+		    "%s: Directory index does not match the file header",
+		    tif->tif_name);
+		return (0);
+	}
+	for (i = 0; i < count; i++) {
+		if (offsets[i] == 0) {
+			TIFFErrorExtR(tif, module,
+			    "%s: Null offset for directory %d in index",
+			    tif->tif_name, (int) i);
+			return (0);
+		}
+	}
+	_TIFFResetDirIndex(tif);
+	for (i = 0; i < count; i++) {
+		if (!_TIFFAppendDirIndex(tif, offsets[i])) {
+			_TIFFResetDirIndex(tif);
+			return (0);
+		}
+	}
+	return (1);
 }
 
 /*
@@ -1601,13 +1837,18 @@ TIFFSetDirectory(TIFF* tif, uint16 dirn)
 	uint64 nextdir;
 	uint16 n;
 
-	if (!(tif->tif_flags&TIFF_BIGTIFF))
-		nextdir = tif->tif_header.classic.tiff_diroff;
-	else
-		nextdir = tif->tif_header.big.tiff_diroff;
-	for (n = dirn; n > 0 && nextdir != 0; n--)
-		if (!TIFFAdvanceDirectory(tif, &nextdir, NULL))
-			return (0);
+	if (!_TIFFCheckUnshared(tif, 0, "TIFFSetDirectory"))
+		return (0);
+	if (!_TIFFExtendDirIndex(tif, dirn))
+		return (0);
+	if (dirn < tif->tif_ndirindex) {
+		nextdir = tif->tif_dirindex[dirn];
+		n = 0;
+	} else {
+		/* The chain ends early, or the index could not grow */
+		nextdir = 0;
+		n = (uint16) (dirn - tif->tif_ndirindex);
+	}
 	tif->tif_nextdiroff = nextdir;
 	/*
 	 * Set curdir to the actual directory index.  The
@@ -1632,6 +1873,8 @@ TIFFSetDirectory(TIFF* tif, uint16 dirn)
 int
 TIFFSetSubDirectory(TIFF* tif, uint64 diroff)
 {
+	if (!_TIFFCheckUnshared(tif, 0, "TIFFSetSubDirectory"))
+		return (0);
 	tif->tif_nextdiroff = diroff;
 	/*
 	 * Reset tif_dirnumber counter and start new list of seen directories.
@@ -1660,6 +1903,259 @@ TIFFLastDirectory(TIFF* tif)
 	return (tif->tif_nextdiroff == 0);
 }
 
+/*
+ * The reduced-resolution images of an image, found through its SubIFD
+ * tag or following it in the chain with the FILETYPE_REDUCEDIMAGE bit
+ * of SubfileType set, are indexed the first time they are asked for.
+ * Level 0 is the image itself and the others are sorted largest first,
+ * so that a level can be picked and made current without walking any
+ * directories.  Transparency masks are skipped.
+ */
+static int
+_TIFFAppendOverview(TIFF* tif, uint32* size, uint16 dirn)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	TIFFOverviewEntry* entry;
+
+	if (tif->tif_novrindex >= *size) {
+		uint32 n = *size ? 2 * *size : 8;
+		TIFFOverviewEntry* ovrindex;
+
+		ovrindex = (TIFFOverviewEntry*) _TIFFCheckRealloc(tif,
+		    tif->tif_ovrindex, n, sizeof(TIFFOverviewEntry),
+		    "for overview index");
+		if (ovrindex == NULL)
+			return (0);
+		tif->tif_ovrindex = ovrindex;
+		*size = n;
+	}
+	entry = &tif->tif_ovrindex[tif->tif_novrindex++];
+	entry->diroff = tif->tif_diroff;
+	entry->width = td->td_imagewidth;
+	entry->length = td->td_imagelength;
+	entry->dirn = dirn;
+	return (1);
+}
+
+static int
+_TIFFReadOverviewDirectory(TIFF* tif, uint64 diroff)
+{
+	tif->tif_nextdiroff = diroff;
+	if (!TIFFReadDirectory(tif))
+		return (0);
+	return (tif->tif_diroff == diroff);
+}
+
+static int
+_TIFFBuildOverviewIndex(TIFF* tif)
+{
+	static const char module[] = "TIFFGetOverviewCount";
+	TIFFDirectory *td = &tif->tif_dir;
+	uint64 base = tif->tif_diroff;
+	uint16 basedirn = tif->tif_curdir;
+	uint32 basewidth = td->td_imagewidth, size = 0, i, j;
+	uint64 *subifd = NULL, nextdiroff = tif->tif_nextdiroff;
+	uint16 nsubifd = td->td_nsubifd, n;
+	int ok = 1;
+
+	if (base == 0) {
+		TIFFErrorExtR(tif, module,
+		    "%s: No directory has been read", tif->tif_name);
+		return (0);
+	}
+	if (!_TIFFCheckUnshared(tif, 0, module))
+		return (0);
+	tif->tif_ovrbase = 0;
+	tif->tif_novrindex = 0;
+	if (!_TIFFAppendOverview(tif, &size, basedirn))
+		return (0);
+	if (nsubifd > 0) {
+		subifd = (uint64*) _TIFFCheckMalloc(tif, nsubifd,
+		    sizeof(uint64), "for SubIFD offsets");
+		if (subifd == NULL)
+			return (0);
+		_TIFFmemcpy(subifd, td->td_subifd, nsubifd * sizeof(uint64));
+	}
+	for (n = 0; ok && n < nsubifd; n++) {
+		tif->tif_dirnumber = 0;
+		if (!_TIFFReadOverviewDirectory(tif, subifd[n]))
+			continue;
+		if ((td->td_subfiletype & FILETYPE_REDUCEDIMAGE) &&
+		    !(td->td_subfiletype & FILETYPE_MASK) &&
+		    td->td_imagewidth <= basewidth)
+			ok = _TIFFAppendOverview(tif, &size, basedirn);
+	}
+	tif->tif_dirnumber = 0;
+	for (n = 1; ok && nextdiroff != 0; n++) {
+		tif->tif_curdir = (uint16) (basedirn + n - 1);
+		if (!_TIFFReadOverviewDirectory(tif, nextdiroff) ||
+		    !(td->td_subfiletype & (FILETYPE_REDUCEDIMAGE|FILETYPE_MASK)))
+			break;
+		if ((td->td_subfiletype & FILETYPE_REDUCEDIMAGE) &&
+		    !(td->td_subfiletype & FILETYPE_MASK) &&
+		    td->td_imagewidth <= basewidth)
+			ok = _TIFFAppendOverview(tif, &size,
+			    (uint16) (basedirn + n));
+		nextdiroff = tif->tif_nextdiroff;
+	}
+	if (subifd)
+		_TIFFfreeExt(tif, subifd);
+
+	/* Largest first; there are only a few */
+	for (i = 2; i < tif->tif_novrindex; i++) {
+		TIFFOverviewEntry entry = tif->tif_ovrindex[i];
+
+		for (j = i; j > 1 &&
+		    tif->tif_ovrindex[j - 1].width < entry.width; j--)
+			tif->tif_ovrindex[j] = tif->tif_ovrindex[j - 1];
+		tif->tif_ovrindex[j] = entry;
+	}
+
+	/* Back to the image we started from */
+	tif->tif_curdir = (uint16) (basedirn - 1);
+	tif->tif_dirnumber = 0;
+	if (!_TIFFReadOverviewDirectory(tif, base)) {
+		tif->tif_novrindex = 0;
+		return (0);
+	}
+	if (!ok) {
+		tif->tif_novrindex = 0;
+		return (0);
+	}
+	tif->tif_ovrbase = base;
+	return (1);
+}
+
+/*
+ * Make sure the overview index is the one of the current image, or of
+ * the image whose overview is current.
+ */
+static int
+_TIFFCheckOverviewIndex(TIFF* tif)
+{
+	uint32 i;
+
+	if (tif->tif_ovrbase != 0) {
+		for (i = 0; i < tif->tif_novrindex; i++)
+			if (tif->tif_ovrindex[i].diroff == tif->tif_diroff)
+				return (1);
+	}
+	return (_TIFFBuildOverviewIndex(tif));
+}
+
+/*
+ * Forget the overview index, e.g. once directories were written.
+ */
+void
+_TIFFResetOverviewIndex(TIFF* tif)
+{
+	tif->tif_ovrbase = 0;
+	tif->tif_novrindex = 0;
+}
+
+/*
+ * Return the number of reduced-resolution images of the current image,
+ * or -1 on error.
+ */
+int
+TIFFGetOverviewCount(TIFF* tif)
+{
+	if (!_TIFFCheckOverviewIndex(tif))
+		return (-1);
+	return ((int) tif->tif_novrindex - 1);
+}
+
+/*
+ * Return the size and directory offset of overview level, with level 0
+ * the full resolution image.
+ */
+int
+TIFFGetOverviewInfo(TIFF* tif, int level, uint32* width, uint32* length,
+    uint64* diroff)
+{
+	static const char module[] = "TIFFGetOverviewInfo";
+	const TIFFOverviewEntry* entry;
+
+	if (!_TIFFCheckOverviewIndex(tif))
+		return (0);
+	if (level < 0 || (uint32) level >= tif->tif_novrindex) {
+		TIFFErrorExtR(tif, module,
+		    "%s: Overview level %d out of range", tif->tif_name, level);
+		return (0);
+	}
+	entry = &tif->tif_ovrindex[level];
+	if (width)
+		*width = entry->width;
+	if (length)
+		*length = entry->length;
+	if (diroff)
+		*diroff = entry->diroff;
+	return (1);
+}
+
+/*
+ * Return the smallest overview level that is at least scale times the
+ * size of the full resolution image, or -1 on error.
+ */
+int
+TIFFGetOverviewForScale(TIFF* tif, double scale)
+{
+	static const char module[] = "TIFFGetOverviewForScale";
+	const TIFFOverviewEntry* ovr;
+	double width, length;
+	uint32 lo, hi;
+
+	if (!_TIFFCheckOverviewIndex(tif))
+		return (-1);
+	if (!(scale > 0.0)) {
+		TIFFErrorExtR(tif, module,
+		    "%s: Invalid scale %g", tif->tif_name, scale);
+		return (-1);
+	}
+	ovr = tif->tif_ovrindex;
+	width = ovr[0].width * scale;
+	length = ovr[0].length * scale;
+	/* Levels are sorted by decreasing width, and level 0 always fits */
+	lo = 0;
+	hi = tif->tif_novrindex;
+	while (hi - lo > 1) {
+		uint32 mid = lo + (hi - lo) / 2;
+
+		if (ovr[mid].width >= width && ovr[mid].length >= length)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return ((int) lo);
+}
+
+/*
+ * Make overview level the current directory, with level 0 the full
+ * resolution image.
+ */
+int
+TIFFOpenOverview(TIFF* tif, int level)
+{
+	static const char module[] = "TIFFOpenOverview";
+	const TIFFOverviewEntry* entry;
+
+	if (!_TIFFCheckOverviewIndex(tif))
+		return (0);
+	if (level < 0 || (uint32) level >= tif->tif_novrindex) {
+		TIFFErrorExtR(tif, module,
+		    "%s: Overview level %d out of range", tif->tif_name, level);
+		return (0);
+	}
+	entry = &tif->tif_ovrindex[level];
+	if (entry->diroff == tif->tif_diroff)
+		return (1);
+	if (!_TIFFCheckUnshared(tif, 0, module))
+		return (0);
+	tif->tif_curdir = (uint16) (entry->dirn - 1);
+	tif->tif_dirnumber = 0;
+	return (_TIFFReadOverviewDirectory(tif, entry->diroff));
+}
+
 /*
  * Unlink the specified directory from the directory chain.
  */
@@ -1672,10 +2168,11 @@ TIFFUnlinkDirectory(TIFF* tif, uint16 dirn)
 	uint16 n;
 
 	if (tif->tif_mode == O_RDONLY) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
                              "Can not unlink directory in read-only file");
 		return (0);
 	}
+	tif->tif_lastdiroff = 0;
 	/*
 	 * Go to the directory before the one we want
 	 * to unlink and nab the offset of the link
@@ -1693,7 +2190,7 @@ TIFFUnlinkDirectory(TIFF* tif, uint16 dirn)
 	}
 	for (n = dirn-1; n > 0; n--) {
 		if (nextdir == 0) {
-			TIFFErrorExt(tif->tif_clientdata, module, "Directory %d does not exist", dirn);
+			TIFFErrorExtR(tif, module, "Directory %d does not exist", dirn);
 			return (0);
 		}
 		if (!TIFFAdvanceDirectory(tif, &nextdir, &off))
@@ -1719,7 +2216,7 @@ TIFFUnlinkDirectory(TIFF* tif, uint16 dirn)
 		if (tif->tif_flags & TIFF_SWAB)
 			TIFFSwabLong(&nextdir32);
 		if (!WriteOK(tif, &nextdir32, sizeof (uint32))) {
-			TIFFErrorExt(tif->tif_clientdata, module, "Error writing directory link");
+			TIFFErrorExtR(tif, module, "Error writing directory link");
 			return (0);
 		}
 	}
@@ -1728,7 +2225,7 @@ TIFFUnlinkDirectory(TIFF* tif, uint16 dirn)
 		if (tif->tif_flags & TIFF_SWAB)
 			TIFFSwabLong8(&nextdir);
 		if (!WriteOK(tif, &nextdir, sizeof (uint64))) {
-			TIFFErrorExt(tif->tif_clientdata, module, "Error writing directory link");
+			TIFFErrorExtR(tif, module, "Error writing directory link");
 			return (0);
 		}
 	}
@@ -1739,9 +2236,11 @@ TIFFUnlinkDirectory(TIFF* tif, uint16 dirn)
 	 * means that the caller can only append to the directory
 	 * chain.
 	 */
+	_TIFFResetDirIndex(tif);
+	_TIFFResetOverviewIndex(tif);
 	(*tif->tif_cleanup)(tif);
 	if ((tif->tif_flags & TIFF_MYBUFFER) && tif->tif_rawdata) {
-		_TIFFfree(tif->tif_rawdata);
+		_TIFFfreeExt(tif, tif->tif_rawdata);
 		tif->tif_rawdata = NULL;
 		tif->tif_rawcc = 0;
                 tif->tif_rawdataoff = 0;
@@ -28,6 +28,8 @@
  * ``Library-private'' Directory-related Definitions.
  */
 
+typedef struct _TIFFStrileWindow TIFFStrileWindow;  /* see tif_strilewindow.c */
+
 typedef struct {
 	const TIFFField *info;
 	int             count;
@@ -96,10 +98,13 @@ typedef struct {
 	uint64* td_stripoffset;
 	uint64* td_stripbytecount;
 	int     td_stripbytecountsorted; /* is the bytecount array sorted ascending? */
-#if defined(DEFER_STRILE_LOAD)
         TIFFDirEntry td_stripoffset_entry;    /* for deferred loading */
         TIFFDirEntry td_stripbytecount_entry; /* for deferred loading */
-#endif
+	void**  td_stripoffsetpages;     /* on demand loaded pieces of */
+	void**  td_stripbytecountpages;  /* the arrays, if not loaded */
+	uint32  td_stripnpages;          /* # entries in the page tables */
+	TIFFStrileWindow* td_strilewindow; /* arrays streamed to the file, */
+	uint32  td_strilefirst;          /* or NULL; first entry held */
 	uint16  td_nsubifd;
 	uint64* td_subifd;
 	/* YCbCr parameters */
@@ -114,6 +119,8 @@ typedef struct {
 
 	int     td_customValueCount;
         TIFFTagValue *td_customValues;
+	TIFFDirEntry* td_deferredtags;   /* custom tags not read yet */
+	uint32  td_ndeferredtags;
 } TIFFDirectory;
 
 /*
@@ -254,9 +261,14 @@ extern "C" {
 extern const TIFFFieldArray* _TIFFGetFields(void);
 extern const TIFFFieldArray* _TIFFGetExifFields(void);
 extern void _TIFFSetupFields(TIFF* tif, const TIFFFieldArray* infoarray);
+extern void _TIFFFreeFields(TIFF* tif);
 extern void _TIFFPrintFieldInfo(TIFF*, FILE*);
 
-extern int _TIFFFillStriles(TIFF*);        
+extern int _TIFFFillStriles(TIFF*);
+extern int _TIFFHaveStriles(TIFF*);
+extern void _TIFFFreeStrilePages(TIFF*);        
+extern void _TIFFFetchDeferredTag(TIFF*, uint32);
+extern void _TIFFFetchDeferredTags(TIFF*);
 
 typedef enum {
 	tfiatImage,
@@ -287,6 +299,7 @@ struct _TIFFField {
 };
 
 extern int _TIFFMergeFields(TIFF*, const TIFFField[], uint32);
+extern uint32 _TIFFFindFieldIndex(TIFF*, uint32);
 extern const TIFFField* _TIFFFindOrRegisterField(TIFF *, uint32, TIFFDataType);
 extern  TIFFField* _TIFFCreateAnonField(TIFF *, uint32, TIFFDataType);
 extern int _TIFFCheckFieldIsValidForCodec(TIFF *tif, ttag_t tag);
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Directory cache.
+ *
+ * When enabled with TIFFSetDirectoryCache(), the directory being left by
+ * TIFFReadDirectory() is not freed but put aside with its codec state:
+ * the parsed tags, the tag tables merged by the codec and the codec's
+ * private data, decoder set up.  Reading a directory put aside makes it
+ * current again without reading the file or initializing the codec.
+ * Entries are replaced in least recently used order.  A directory whose
+ * tags were set after it was read is freed as usual, since reading it
+ * again would not give the same state.
+ */
+#include "tiffiop.h"
+
+/* flags that describe the current directory rather than the handle */
+#define DIRCACHE_FLAGS (TIFF_ISTILED|TIFF_UPSAMPLED|TIFF_NOBITREV| \
+	TIFF_NOREADRAW|TIFF_CHUNKYSTRIP|TIFF_CODERSETUP)
+
+/*
+ * The members of struct tiff that belong to the current directory.
+ */
+#define DIRCACHE_MEMBERS \
+	M(TIFFDirectory, tif_dir) \
+	M(int, tif_decodestatus) \
+	M(TIFFBoolMethod, tif_fixuptags) \
+	M(TIFFBoolMethod, tif_setupdecode) \
+	M(TIFFPreMethod, tif_predecode) \
+	M(TIFFBoolMethod, tif_setupencode) \
+	M(int, tif_encodestatus) \
+	M(TIFFPreMethod, tif_preencode) \
+	M(TIFFBoolMethod, tif_postencode) \
+	M(TIFFCodeMethod, tif_decoderow) \
+	M(TIFFCodeMethod, tif_encoderow) \
+	M(TIFFCodeMethod, tif_decodestrip) \
+	M(TIFFCodeMethod, tif_encodestrip) \
+	M(TIFFCodeMethod, tif_decodetile) \
+	M(TIFFCodeMethod, tif_encodetile) \
+	M(TIFFVoidMethod, tif_close) \
+	M(TIFFSeekMethod, tif_seek) \
+	M(TIFFSaveStateMethod, tif_savestate) \
+	M(TIFFRestoreStateMethod, tif_restorestate) \
+	M(TIFFFreeStateMethod, tif_freestate) \
+	M(TIFFVoidMethod, tif_cleanup) \
+	M(TIFFStripMethod, tif_defstripsize) \
+	M(TIFFTileMethod, tif_deftilesize) \
+	M(uint8*, tif_data) \
+	M(tmsize_t, tif_scanlinesize) \
+	M(tmsize_t, tif_scanlineskew) \
+	M(tmsize_t, tif_tilesize) \
+	M(TIFFPostMethod, tif_postdecode) \
+	M(TIFFField**, tif_fields) \
+	M(size_t, tif_nfields) \
+	M(const TIFFField*, tif_foundfield) \
+	M(uint32*, tif_fieldshash) \
+	M(uint32, tif_fieldshashmask) \
+	M(TIFFTagMethods, tif_tagmethods) \
+	M(TIFFFieldArray*, tif_fieldscompat) \
+	M(size_t, tif_nfieldscompat)
+
+typedef struct {
+	uint64		diroff;		/* directory kept, 0 if none */
+	uint64		nextdiroff;	/* and its link */
+	uint32		flags;		/* its DIRCACHE_FLAGS */
+	uint32		lastuse;	/* for replacement */
+#define M(type, member) type member;
+	DIRCACHE_MEMBERS
+#undef M
+} TIFFDirCacheEntry;
+
+struct _TIFFDirCache {
+	uint32			nentries;
+	uint32			clock;		/* bumped at every use */
+	uint64			curoff;		/* directory current, 0 if not */
+	uint64			curnext;	/* kept, and its link */
+	uint32			curgen;		/* tif_encodergen once read */
+	TIFFDirCacheEntry*	entries;
+};
+
+static void
+_TIFFDirCacheExchange(TIFF* tif, TIFFDirCacheEntry* e)
+{
+	uint32 flags = tif->tif_flags & DIRCACHE_FLAGS;
+
+#define M(type, member) { \
+	type tmp = tif->member; \
+	tif->member = e->member; \
+	e->member = tmp; \
+}
+	DIRCACHE_MEMBERS
+#undef M
+	tif->tif_flags = (tif->tif_flags & ~DIRCACHE_FLAGS) | e->flags;
+	e->flags = flags;
+}
+
+/*
+ * Free the directory and codec state that is current in tif.
+ */
+static void
+_TIFFDirCacheFreeCurrent(TIFF* tif)
+{
+	(*tif->tif_cleanup)(tif);
+	TIFFFreeDirectory(tif);
+	_TIFFFreeFields(tif);
+	if (tif->tif_nfieldscompat > 0) {
+		uint32 i;
+
+		for (i = 0; i < tif->tif_nfieldscompat; i++) {
+			if (tif->tif_fieldscompat[i].allocated_size)
+				_TIFFfreeExt(tif, tif->tif_fieldscompat[i].fields);
+		}
+		_TIFFfreeExt(tif, tif->tif_fieldscompat);
+		tif->tif_nfieldscompat = 0;
+		tif->tif_fieldscompat = NULL;
+	}
+}
+
+/* Free the state kept in an entry, and empty it */
+static void
+_TIFFDirCacheEvict(TIFF* tif, TIFFDirCacheEntry* e)
+{
+	if (e->diroff == 0)
+		return;
+	_TIFFDirCacheExchange(tif, e);
+	_TIFFDirCacheFreeCurrent(tif);
+	_TIFFDirCacheExchange(tif, e);
+	_TIFFmemset(e, 0, sizeof(TIFFDirCacheEntry));
+}
+
+/*
+ * Put the current directory aside, unless it cannot be kept or the only
+ * entry holds the directory wanted.  The handle is left with a default
+ * directory.
+ */
+static void
+_TIFFDirCachePut(TIFF* tif)
+{
+	TIFFDirCache* dc = tif->tif_dircache;
+	TIFFDirCacheEntry* e = NULL;
+	uint32 i;
+
+	if (dc->curoff == 0 || dc->curgen != tif->tif_encodergen ||
+	    tif->tif_shareddir ||
+	    tif->tif_dir.td_compression == COMPRESSION_OJPEG ||
+	    (tif->tif_flags & (TIFF_NOREADRAW|TIFF_DIRTYDIRECT)) != 0)
+		return;
+	for (i = 0; i < dc->nentries; i++) {
+		TIFFDirCacheEntry* c = &dc->entries[i];
+
+		if (c->diroff == dc->curoff) {
+			/* a copy of the directory was read while it was kept */
+			e = c;
+			break;
+		}
+		if (c->diroff == tif->tif_diroff)
+			continue;
+		if (e == NULL || c->diroff == 0 ||
+		    (e->diroff != 0 && c->lastuse < e->lastuse))
+			e = c;
+	}
+	if (e == NULL)
+		return;
+	_TIFFDirCacheEvict(tif, e);
+	_TIFFDirCacheExchange(tif, e);
+	e->diroff = dc->curoff;
+	e->nextdiroff = dc->curnext;
+	e->lastuse = ++dc->clock;
+	dc->curoff = 0;
+	/* what the handle has after closing a codec */
+	_TIFFmemset(&tif->tif_dir, 0, sizeof(TIFFDirectory));
+	tif->tif_fields = NULL;
+	tif->tif_nfields = 0;
+	tif->tif_foundfield = NULL;
+	tif->tif_fieldshash = NULL;
+	tif->tif_fieldshashmask = 0;
+	tif->tif_fieldscompat = NULL;
+	tif->tif_nfieldscompat = 0;
+	tif->tif_data = NULL;
+	_TIFFSetDefaultCompressionState(tif);
+	tif->tif_flags &= ~DIRCACHE_FLAGS;
+	(void) TIFFDefaultDirectory(tif);
+}
+
+/*
+ * Called by TIFFReadDirectory() once tif_diroff is the directory to
+ * read: put the current directory aside and make the wanted one
+ * current if it was kept.  Returns 1 if it was, with tif_nextdiroff set.
+ */
+int
+_TIFFDirCacheSwitch(TIFF* tif)
+{
+	TIFFDirCache* dc = tif->tif_dircache;
+	TIFFDirCacheEntry* wanted = NULL;
+	uint32 i;
+
+	_TIFFDirCachePut(tif);
+	for (i = 0; i < dc->nentries; i++) {
+		if (dc->entries[i].diroff == tif->tif_diroff) {
+			wanted = &dc->entries[i];
+			break;
+		}
+	}
+	if (wanted == NULL)
+		return (0);
+	_TIFFDirCacheFreeCurrent(tif);
+	_TIFFDirCacheExchange(tif, wanted);
+	tif->tif_nextdiroff = wanted->nextdiroff;
+	_TIFFmemset(wanted, 0, sizeof(TIFFDirCacheEntry));
+	/* as TIFFReadDirectory() leaves a directory it has read */
+	tif->tif_flags &= ~(TIFF_BEENWRITING|TIFF_BUF4WRITE|
+	    TIFF_DIRTYDIRECT|TIFF_DIRTYSTRIP);
+	tif->tif_row = (uint32) -1;
+	tif->tif_curstrip = (uint32) -1;
+	tif->tif_col = (uint32) -1;
+	tif->tif_curtile = (uint32) -1;
+	TIFFStatsAdd(tif, directoriescached, 1);
+	return (1);
+}
+
+/*
+ * Called when TIFFReadDirectory() returns: the directory read may be
+ * put aside when the next one is read.
+ */
+void
+_TIFFDirCacheRead(TIFF* tif, int ok)
+{
+	TIFFDirCache* dc = tif->tif_dircache;
+
+	dc->curoff = ok ? tif->tif_diroff : 0;
+	dc->curnext = tif->tif_nextdiroff;
+	dc->curgen = tif->tif_encodergen;
+}
+
+void
+_TIFFFreeDirCache(TIFF* tif)
+{
+	TIFFDirCache* dc = tif->tif_dircache;
+	uint32 i;
+
+	if (dc == NULL)
+		return;
+	for (i = 0; i < dc->nentries; i++)
+		_TIFFDirCacheEvict(tif, &dc->entries[i]);
+	_TIFFfreeExt(tif, dc->entries);
+	_TIFFfreeExt(tif, dc);
+	tif->tif_dircache = NULL;
+}
+
+/*
+ * Keep up to ndirs directories read with TIFFReadDirectory(),
+ * TIFFSetDirectory() or TIFFSetSubDirectory() besides the current one,
+ * with their codec state, or stop doing so if ndirs is 0.
+ */
+int
+TIFFSetDirectoryCache(TIFF* tif, uint32 ndirs)
+{
+	static const char module[] = "TIFFSetDirectoryCache";
+	TIFFDirCache* dc;
+
+	if (tif->tif_mode != O_RDONLY) {
+		TIFFErrorExtR(tif, module,
+		    "The directory cache is only supported for files opened read-only");
+		return (0);
+	}
+	_TIFFFreeDirCache(tif);
+	if (ndirs == 0)
+		return (1);
+	dc = (TIFFDirCache*) _TIFFmallocExt(tif, sizeof(TIFFDirCache));
+	if (dc == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for directory cache");
+		return (0);
+	}
+	_TIFFmemset(dc, 0, sizeof(TIFFDirCache));
+	dc->entries = (TIFFDirCacheEntry*) _TIFFCheckMalloc(tif, ndirs,
+	    sizeof(TIFFDirCacheEntry), "for directory cache");
+	if (dc->entries == NULL) {
+		_TIFFfreeExt(tif, dc);
+		return (0);
+	}
+	_TIFFmemset(dc->entries, 0, ndirs * sizeof(TIFFDirCacheEntry));
+	dc->nentries = ndirs;
+	tif->tif_dircache = dc;
+	return (1);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -214,6 +214,8 @@ tiffFields[] = {
         { TIFFTAG_STRIPROWCOUNTS, -1, -1, TIFF_LONG, 0, TIFF_SETGET_C16_UINT32, TIFF_SETGET_UNDEFINED, FIELD_CUSTOM, 0, 1, "StripRowCounts", NULL },
         { TIFFTAG_IMAGELAYER, 2, 2, TIFF_LONG, 0, TIFF_SETGET_C0_UINT32, TIFF_SETGET_UNDEFINED, FIELD_CUSTOM, 0, 0, "ImageLayer", NULL },
 	/* end TIFF/FX tags */
+	{ TIFFTAG_CHUNKSTATISTICS, -3, -3, TIFF_DOUBLE, 0, TIFF_SETGET_C32_DOUBLE, TIFF_SETGET_UNDEFINED, FIELD_CUSTOM, 1, 1, "ChunkStatistics", NULL },
+	{ TIFFTAG_CHUNKCRC32C, -3, -3, TIFF_LONG, 0, TIFF_SETGET_C32_UINT32, TIFF_SETGET_UNDEFINED, FIELD_CUSTOM, 1, 1, "ChunkCRC32C", NULL },
 	/* begin pseudo tags */
 };
 
@@ -313,8 +315,12 @@ _TIFFGetExifFields(void)
 	return(&exifFieldArray);
 }
 
+/*
+ * Free the registered tag table, with the anonymous fields made for
+ * unknown tags.
+ */
 void
-_TIFFSetupFields(TIFF* tif, const TIFFFieldArray* fieldarray)
+_TIFFFreeFields(TIFF* tif)
 {
 	if (tif->tif_fields && tif->tif_nfields > 0) {
 		uint32 i;
@@ -323,17 +329,28 @@ _TIFFSetupFields(TIFF* tif, const TIFFFieldArray* fieldarray)
 			TIFFField *fld = tif->tif_fields[i];
 			if (fld->field_bit == FIELD_CUSTOM &&
 				strncmp("Tag ", fld->field_name, 4) == 0) {
-					_TIFFfree(fld->field_name);
-					_TIFFfree(fld);
+					_TIFFfreeExt(tif, fld->field_name);
+					_TIFFfreeExt(tif, fld);
 				}
 		}
 
-		_TIFFfree(tif->tif_fields);
-		tif->tif_fields = NULL;
-		tif->tif_nfields = 0;
+		_TIFFfreeExt(tif, tif->tif_fields);
 	}
+	tif->tif_fields = NULL;
+	tif->tif_nfields = 0;
+	tif->tif_foundfield = NULL;
+	if (tif->tif_fieldshash)
+		_TIFFfreeExt(tif, tif->tif_fieldshash);
+	tif->tif_fieldshash = NULL;
+	tif->tif_fieldshashmask = 0;
+}
+
+void
+_TIFFSetupFields(TIFF* tif, const TIFFFieldArray* fieldarray)
+{
+	_TIFFFreeFields(tif);
 	if (!_TIFFMergeFields(tif, fieldarray->fields, fieldarray->count)) {
-		TIFFErrorExt(tif->tif_clientdata, "_TIFFSetupFields",
+		TIFFErrorExtR(tif, "_TIFFSetupFields",
 			     "Setting up field info failed");
 	}
 }
@@ -365,13 +382,74 @@ tagNameCompare(const void* a, const void* b)
 			0 : ((int)tb->field_type - (int)ta->field_type);
 }
 
+/*
+ * Tag lookups go through an open addressing hash table mapping each
+ * distinct tag to the first of its entries in the sorted tif_fields
+ * array.  It is rebuilt whenever fields are merged.
+ */
+#define	FIELDHASH(tag, mask)	(((uint32)(tag) * 2654435761U) & (mask))
+
+static int
+_TIFFBuildFieldsHash(TIFF* tif)
+{
+	uint32 size = 16, i;
+
+	while (size < 2 * tif->tif_nfields)
+		size <<= 1;
+	if (size - 1 != tif->tif_fieldshashmask || !tif->tif_fieldshash) {
+		if (tif->tif_fieldshash)
+			_TIFFfreeExt(tif, tif->tif_fieldshash);
+		tif->tif_fieldshashmask = 0;
+		tif->tif_fieldshash = (uint32*)
+			_TIFFCheckMalloc(tif, size, sizeof(uint32),
+					 "for fields hash table");
+		if (!tif->tif_fieldshash)
+			return 0;
+		tif->tif_fieldshashmask = size - 1;
+	}
+	_TIFFmemset(tif->tif_fieldshash, 0, size * sizeof(uint32));
+	for (i = 0; i < tif->tif_nfields; i++) {
+		uint32 tag = tif->tif_fields[i]->field_tag;
+		uint32 h;
+
+		if (i > 0 && tif->tif_fields[i - 1]->field_tag == tag)
+			continue;
+		h = FIELDHASH(tag, tif->tif_fieldshashmask);
+		while (tif->tif_fieldshash[h] != 0)
+			h = (h + 1) & tif->tif_fieldshashmask;
+		tif->tif_fieldshash[h] = i + 1;
+	}
+	return 1;
+}
+
+/*
+ * Return the index of the first entry of tif_fields for tag, or
+ * (uint32) -1 if the tag is not registered.
+ */
+uint32
+_TIFFFindFieldIndex(TIFF* tif, uint32 tag)
+{
+	uint32 h, i;
+
+	if (!tif->tif_fieldshash)
+		return ((uint32) -1);
+	h = FIELDHASH(tag, tif->tif_fieldshashmask);
+	while ((i = tif->tif_fieldshash[h]) != 0) {
+		if (tif->tif_fields[i - 1]->field_tag == tag)
+			return (i - 1);
+		h = (h + 1) & tif->tif_fieldshashmask;
+	}
+	return ((uint32) -1);
+}
+
 int
 _TIFFMergeFields(TIFF* tif, const TIFFField info[], uint32 n)
 {
 	static const char module[] = "_TIFFMergeFields";
 	static const char reason[] = "for fields array";
-	/* TIFFField** tp; */
-	uint32 i;
+	TIFFField** added;
+	uint32 i, nadded = 0;
+	size_t j, k;
 
         tif->tif_foundfield = NULL;
 
@@ -386,27 +464,52 @@ _TIFFMergeFields(TIFF* tif, const TIFFField info[], uint32 n)
 					 reason);
 	}
 	if (!tif->tif_fields) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Failed to allocate fields array");
 		return 0;
 	}
 
-	/* tp = tif->tif_fields + tif->tif_nfields; */
+	/*
+	 * Collect the definitions that aren't already present at the end
+	 * of the array, sort them by tag number and merge them with the
+	 * already sorted entries, starting from the top.
+	 */
+	added = tif->tif_fields + tif->tif_nfields;
 	for (i = 0; i < n; i++) {
-		const TIFFField *fip =
-			TIFFFindField(tif, info[i].field_tag, TIFF_ANY);
-
-                /* only add definitions that aren't already present */
-		if (!fip) {
-                        tif->tif_fields[tif->tif_nfields] = (TIFFField *) (info+i);
-                        tif->tif_nfields++;
-                }
+		if (_TIFFFindFieldIndex(tif, info[i].field_tag) == (uint32) -1)
+			added[nadded++] = (TIFFField *) (info+i);
 	}
+	if (nadded > 1)
+		qsort(added, nadded, sizeof(TIFFField *), tagCompare);
+	if (nadded > 0 && tif->tif_nfields > 0 &&
+	    tagCompare(&tif->tif_fields[tif->tif_nfields - 1], &added[0]) > 0) {
+		TIFFField** tmp = (TIFFField**)
+			_TIFFCheckMalloc(tif, nadded, sizeof(TIFFField *), reason);
+
+		if (!tmp)
+			return 0;
+		_TIFFmemcpy(tmp, added, nadded * sizeof(TIFFField *));
+		j = tif->tif_nfields;
+		k = nadded;
+		while (k > 0) {
+			if (j > 0 &&
+			    tagCompare(&tif->tif_fields[j - 1], &tmp[k - 1]) > 0) {
+				tif->tif_fields[j + k - 1] = tif->tif_fields[j - 1];
+				j--;
+			} else {
+				tif->tif_fields[j + k - 1] = tmp[k - 1];
+				k--;
+			}
+		}
+		_TIFFfreeExt(tif, tmp);
+	}
+	tif->tif_nfields += nadded;
 
-        /* Sort the field info by tag number */
-	qsort(tif->tif_fields, tif->tif_nfields,
-	      sizeof(TIFFField *), tagCompare);
-
+	if (!_TIFFBuildFieldsHash(tif)) {
+		TIFFErrorExtR(tif, module,
+			     "Failed to allocate fields hash table");
+		return 0;
+	}
 	return n;
 }
 
@@ -505,26 +608,26 @@ _TIFFDataSize(TIFFDataType type)
 const TIFFField*
 TIFFFindField(TIFF* tif, uint32 tag, TIFFDataType dt)
 {
-	TIFFField key = {0, 0, 0, TIFF_NOTYPE, 0, 0, 0, 0, 0, 0, NULL, NULL};
-	TIFFField* pkey = &key;
-	const TIFFField **ret;
+	uint32 i;
+
 	if (tif->tif_foundfield && tif->tif_foundfield->field_tag == tag &&
 	    (dt == TIFF_ANY || dt == tif->tif_foundfield->field_type))
 		return tif->tif_foundfield;
 
-	/* If we are invoked with no field information, then just return. */
-	if (!tif->tif_fields)
+	i = _TIFFFindFieldIndex(tif, tag);
+	if (i == (uint32) -1)
 		return NULL;
-
-	/* NB: use sorted search (e.g. binary search) */
-
-	key.field_tag = tag;
-	key.field_type = dt;
-
-	ret = (const TIFFField **) bsearch(&pkey, tif->tif_fields,
-					   tif->tif_nfields,
-					   sizeof(TIFFField *), tagCompare);
-	return tif->tif_foundfield = (ret ? *ret : NULL);
+	/* Entries for the same tag are adjacent */
+	if (dt != TIFF_ANY) {
+		while (i < tif->tif_nfields &&
+		       tif->tif_fields[i]->field_tag == tag &&
+		       tif->tif_fields[i]->field_type != dt)
+			i++;
+		if (i == tif->tif_nfields ||
+		    tif->tif_fields[i]->field_tag != tag)
+			return NULL;
+	}
+	return tif->tif_foundfield = tif->tif_fields[i];
 }
 
 static const TIFFField*
@@ -559,7 +662,7 @@ TIFFFieldWithTag(TIFF* tif, uint32 tag)
 {
 	const TIFFField* fip = TIFFFindField(tif, tag, TIFF_ANY);
 	if (!fip) {
-		TIFFErrorExt(tif->tif_clientdata, "TIFFFieldWithTag",
+		TIFFErrorExtR(tif, "TIFFFieldWithTag",
 			     "Internal error, unknown tag 0x%x",
 			     (unsigned int) tag);
 	}
@@ -572,7 +675,7 @@ TIFFFieldWithName(TIFF* tif, const char *field_name)
 	const TIFFField* fip =
 		_TIFFFindFieldByName(tif, field_name, TIFF_ANY);
 	if (!fip) {
-		TIFFErrorExt(tif->tif_clientdata, "TIFFFieldWithName",
+		TIFFErrorExtR(tif, "TIFFFieldWithName",
 			     "Internal error, unknown tag %s", field_name);
 	}
 	return (fip);
@@ -636,7 +739,7 @@ _TIFFCreateAnonField(TIFF *tif, uint32 tag, TIFFDataType field_type)
 	TIFFField *fld;
 	(void) tif;
 
-	fld = (TIFFField *) _TIFFmalloc(sizeof (TIFFField));
+	fld = (TIFFField *) _TIFFmallocExt(tif, sizeof (TIFFField));
 	if (fld == NULL)
 	    return NULL;
 	_TIFFmemset(fld, 0, sizeof(TIFFField));
@@ -708,9 +811,9 @@ _TIFFCreateAnonField(TIFF *tif, uint32 tag, TIFFDataType field_type)
 	fld->field_bit = FIELD_CUSTOM;
 	fld->field_oktochange = TRUE;
 	fld->field_passcount = TRUE;
-	fld->field_name = (char *) _TIFFmalloc(32);
+	fld->field_name = (char *) _TIFFmallocExt(tif, 32);
 	if (fld->field_name == NULL) {
-	    _TIFFfree(fld);
+	    _TIFFfreeExt(tif, fld);
 	    return NULL;
 	}
 	fld->field_subfields = NULL;
@@ -904,7 +1007,7 @@ TIFFMergeFieldInfo(TIFF* tif, const TIFFFieldInfo info[], uint32 n)
 					 reason);
 	}
 	if (!tif->tif_fieldscompat) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Failed to allocate fields array");
 		return -1;
 	}
@@ -917,7 +1020,7 @@ TIFFMergeFieldInfo(TIFF* tif, const TIFFFieldInfo info[], uint32 n)
 		(TIFFField *)_TIFFCheckMalloc(tif, n, sizeof(TIFFField),
 					      reason);
 	if (!tif->tif_fieldscompat[nfields].fields) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Failed to allocate fields array");
 		return -1;
 	}
@@ -946,7 +1049,7 @@ TIFFMergeFieldInfo(TIFF* tif, const TIFFFieldInfo info[], uint32 n)
 	}
 
 	if (!_TIFFMergeFields(tif, tif->tif_fieldscompat[nfields].fields, n)) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Setting up field info failed");
 		return -1;
 	}
@@ -977,6 +1080,8 @@ _TIFFCheckFieldIsValidForCodec(TIFF *tif, ttag_t tag)
 	    case TIFFTAG_CONSECUTIVEBADFAXLINES:
 	    case TIFFTAG_GROUP3OPTIONS:
 	    case TIFFTAG_GROUP4OPTIONS:
+	    /* LERC */
+	    case TIFFTAG_LERC_PARAMETERS:
 		break;
 	    default:
 		return 1;
@@ -1056,6 +1161,17 @@ _TIFFCheckFieldIsValidForCodec(TIFF *tif, ttag_t tag)
 		if (tag == TIFFTAG_PREDICTOR)
 		    return 1;
 		break;
+	    case COMPRESSION_LZ4:
+		if (tag == TIFFTAG_PREDICTOR)
+		    return 1;
+		break;
+	    case COMPRESSION_LERC:
+		if (tag == TIFFTAG_LERC_PARAMETERS)
+		    return 1;
+		break;
+	    case COMPRESSION_WEBP:
+		/* No codec-specific tags */
+		break;
 
 	}
 	return 0;
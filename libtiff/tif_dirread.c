@@ -41,6 +41,12 @@
 #include <float.h>
 #include <stdlib.h>
 
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#elif defined(TIFF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
 #define IGNORE 0          /* tag placeholder used below */
 #define FAILED_FII    ((uint32) -1)
 
@@ -149,6 +155,9 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryCheckRangeLong8Slong8(int64 valu
 static enum TIFFReadDirEntryErr TIFFReadDirEntryCheckRangeSlong8Long8(uint64 value);
 
 static enum TIFFReadDirEntryErr TIFFReadDirEntryData(TIFF* tif, uint64 offset, tmsize_t size, void* dest);
+static int TIFFReadDirEntryDataAhead(TIFF* tif, uint64 offset, tmsize_t size, void* dest);
+static void TIFFReadDirDataAhead(TIFF* tif, TIFFDirEntry* dir, uint16 dircount);
+static void TIFFFreeDirData(TIFF* tif);
 static void TIFFReadDirEntryOutputErr(TIFF* tif, enum TIFFReadDirEntryErr err, const char* module, const char* tagname, int recover);
 
 static void TIFFReadDirectoryCheckOrder(TIFF* tif, TIFFDirEntry* dir, uint16 dircount);
@@ -158,16 +167,31 @@ static void TIFFReadDirectoryFindFieldInfo(TIFF* tif, uint16 tagid, uint32* fii)
 static int EstimateStripByteCounts(TIFF* tif, TIFFDirEntry* dir, uint16 dircount);
 static void MissingRequired(TIFF*, const char*);
 static int TIFFCheckDirOffset(TIFF* tif, uint64 diroff);
+static TIFFDirSetEntry* TIFFDirSetFind(TIFF* tif, uint64 diroff);
 static int CheckDirCount(TIFF*, TIFFDirEntry*, uint32);
 static uint16 TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir, uint64* nextdiroff);
 static int TIFFFetchNormalTag(TIFF*, TIFFDirEntry*, int recover);
+static int TIFFDeferTag(TIFF*, TIFFDirEntry*, uint16);
 static int TIFFFetchStripThing(TIFF* tif, TIFFDirEntry* dir, uint32 nstrips, uint64** lpp);
 static int TIFFFetchSubjectDistance(TIFF*, TIFFDirEntry*);
 static void ChopUpSingleUncompressedStrip(TIFF*);
+static void ChopUpSingleUncompressedTile(TIFF*);
+static int IsChunkyReadCompression(uint16);
 static uint64 TIFFReadUInt64(const uint8 *value);
 
 static int _TIFFFillStrilesInternal( TIFF *tif, int loadStripByteCount );
 
+/*
+ * Strip/tile arrays are read when first needed, rather than with the
+ * directory, if the library was configured so or the file was opened
+ * with the 'O' flag.
+ */
+#if defined(DEFER_STRILE_LOAD)
+#define isDeferredStriles(tif) 1
+#else
+#define isDeferredStriles(tif) (((tif)->tif_flags&TIFF_LAZYSTRILELOAD)!=0)
+#endif
+
 typedef union _UInt64Aligned_t
 {
         double d;
@@ -196,6 +220,207 @@ static uint64 TIFFReadUInt64(const uint8 *value)
 	return result.l;
 }
 
+/*
+ * Bulk conversions of entry arrays, used once the whole array has
+ * been byte swapped.  Offset and byte count arrays of ClassicTIFF
+ * files are SHORT or LONG and are widened to uint64 when a directory
+ * is read, so those and the FLOAT to double conversion have SIMD
+ * kernels; the signed types are checked for negative values with one
+ * pass over the array, after which they are widened as unsigned.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSE2
+static tmsize_t
+shortToLong8SSE2(uint64* dst, const uint16* src, tmsize_t n)
+{
+	const __m128i z = _mm_setzero_si128();
+	tmsize_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i lo = _mm_unpacklo_epi16(x, z);
+		__m128i hi = _mm_unpackhi_epi16(x, z);
+
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_unpacklo_epi32(lo, z));
+		_mm_storeu_si128((__m128i*) (dst + i + 2), _mm_unpackhi_epi32(lo, z));
+		_mm_storeu_si128((__m128i*) (dst + i + 4), _mm_unpacklo_epi32(hi, z));
+		_mm_storeu_si128((__m128i*) (dst + i + 6), _mm_unpackhi_epi32(hi, z));
+	}
+	return (i);
+}
+
+TIFF_TARGET_SSE2
+static tmsize_t
+longToLong8SSE2(uint64* dst, const uint32* src, tmsize_t n)
+{
+	const __m128i z = _mm_setzero_si128();
+	tmsize_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_unpacklo_epi32(x, z));
+		_mm_storeu_si128((__m128i*) (dst + i + 2), _mm_unpackhi_epi32(x, z));
+	}
+	return (i);
+}
+
+TIFF_TARGET_SSE2
+static tmsize_t
+floatToDoubleSSE2(double* dst, const float* src, tmsize_t n)
+{
+	tmsize_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128 x = _mm_loadu_ps(src + i);
+
+		_mm_storeu_pd(dst + i, _mm_cvtps_pd(x));
+		_mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+	}
+	return (i);
+}
+#elif defined(TIFF_SIMD_NEON)
+static tmsize_t
+shortToLong8NEON(uint64* dst, const uint16* src, tmsize_t n)
+{
+	tmsize_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		uint32x4_t x = vmovl_u16(vld1_u16(src + i));
+
+		vst1q_u64(dst + i, vmovl_u32(vget_low_u32(x)));
+		vst1q_u64(dst + i + 2, vmovl_u32(vget_high_u32(x)));
+	}
+	return (i);
+}
+
+static tmsize_t
+longToLong8NEON(uint64* dst, const uint32* src, tmsize_t n)
+{
+	tmsize_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		uint32x4_t x = vld1q_u32(src + i);
+
+		vst1q_u64(dst + i, vmovl_u32(vget_low_u32(x)));
+		vst1q_u64(dst + i + 2, vmovl_u32(vget_high_u32(x)));
+	}
+	return (i);
+}
+
+#if defined(__aarch64__)
+static tmsize_t
+floatToDoubleNEON(double* dst, const float* src, tmsize_t n)
+{
+	tmsize_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		float32x4_t x = vld1q_f32(src + i);
+
+		vst1q_f64(dst + i, vcvt_f64_f32(vget_low_f32(x)));
+		vst1q_f64(dst + i + 2, vcvt_high_f64_f32(x));
+	}
+	return (i);
+}
+#endif
+#endif
+
+void
+_TIFFDirReadKernels(TIFFKernels* k, int features)
+{
+#if defined(TIFF_SIMD_X86)
+	if (features & TIFF_CPU_SSE2) {
+		k->shortToLong8 = shortToLong8SSE2;
+		k->longToLong8 = longToLong8SSE2;
+		k->floatToDouble = floatToDoubleSSE2;
+	}
+#elif defined(TIFF_SIMD_NEON)
+	if (features & TIFF_CPU_NEON) {
+		k->shortToLong8 = shortToLong8NEON;
+		k->longToLong8 = longToLong8NEON;
+#if defined(__aarch64__)
+		k->floatToDouble = floatToDoubleNEON;
+#endif
+	}
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+static void
+TIFFReadDirEntryShortsToLong8(uint64* dst, const uint16* src, uint32 count)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	tmsize_t n = 0;
+
+	if (k->shortToLong8 != NULL)
+		n = (*k->shortToLong8)(dst, src, count);
+	for (; n < (tmsize_t) count; n++)
+		dst[n] = (uint64) src[n];
+}
+
+static void
+TIFFReadDirEntryLongsToLong8(uint64* dst, const uint32* src, uint32 count)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	tmsize_t n = 0;
+
+	if (k->longToLong8 != NULL)
+		n = (*k->longToLong8)(dst, src, count);
+	for (; n < (tmsize_t) count; n++)
+		dst[n] = (uint64) src[n];
+}
+
+static void
+TIFFReadDirEntryFloatsToDouble(double* dst, const float* src, uint32 count)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	tmsize_t n = 0;
+
+	if (k->floatToDouble != NULL)
+		n = (*k->floatToDouble)(dst, src, count);
+	for (; n < (tmsize_t) count; n++)
+		dst[n] = (double) src[n];
+}
+
+/*
+ * Return TIFFReadDirEntryErrRange if any of the signed values is
+ * negative.  The sign bits are accumulated without branches.
+ */
+static enum TIFFReadDirEntryErr
+TIFFReadDirEntryCheckRangeSshorts(const int16* m, uint32 count)
+{
+	uint16 acc = 0;
+	uint32 n;
+
+	for (n = 0; n < count; n++)
+		acc |= (uint16) m[n];
+	return ((acc & 0x8000) ? TIFFReadDirEntryErrRange : TIFFReadDirEntryErrOk);
+}
+
+static enum TIFFReadDirEntryErr
+TIFFReadDirEntryCheckRangeSlongs(const int32* m, uint32 count)
+{
+	uint32 acc = 0;
+	uint32 n;
+
+	for (n = 0; n < count; n++)
+		acc |= (uint32) m[n];
+	return ((acc & 0x80000000U) ? TIFFReadDirEntryErrRange : TIFFReadDirEntryErrOk);
+}
+
+static enum TIFFReadDirEntryErr
+TIFFReadDirEntryCheckRangeSlong8s(const int64* m, uint32 count)
+{
+	uint64 acc = 0;
+	uint32 n;
+
+	for (n = 0; n < count; n++)
+		acc |= (uint64) m[n];
+	return ((acc >> 63) ? TIFFReadDirEntryErrRange : TIFFReadDirEntryErrOk);
+}
+
 static enum TIFFReadDirEntryErr TIFFReadDirEntryByte(TIFF* tif, TIFFDirEntry* direntry, uint8* value)
 {
 	enum TIFFReadDirEntryErr err;
@@ -781,6 +1006,15 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryDataAndRealloc(
 
         assert( !isMapped(tif) );
 
+        if (tif->tif_ndirspans) {
+                void* new_dest = _TIFFreallocExt(tif, *pdest, size);
+
+                if (new_dest == NULL)
+                        return TIFFReadDirEntryErrAlloc;
+                *pdest = new_dest;
+                if (TIFFReadDirEntryDataAhead(tif, offset, size, *pdest))
+                        return TIFFReadDirEntryErrOk;
+        }
         if (!SeekOK(tif,offset))
                 return(TIFFReadDirEntryErrIo);
 
@@ -803,11 +1037,11 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryDataAndRealloc(
             }
 #endif
 
-            new_dest = (uint8*) _TIFFrealloc(
+            new_dest = (uint8*) _TIFFreallocExt(tif,
                             *pdest, already_read + to_read);
             if( new_dest == NULL )
             {
-                TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+                TIFFErrorExtR(tif, tif->tif_name,
                             "Failed to allocate memory for %s "
                             "(%ld elements of %ld bytes each)",
                             "TIFFReadDirEntryArray",
@@ -891,7 +1125,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryArrayWithLimit(
 				err=TIFFReadDirEntryDataAndRealloc(tif,(uint64)offset,(tmsize_t)datasize,&data);
 			if (err!=TIFFReadDirEntryErrOk)
 			{
-				_TIFFfree(data);
+				_TIFFfreeExt(tif, data);
 				return(err);
 			}
 		}
@@ -912,7 +1146,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryArrayWithLimit(
 				err=TIFFReadDirEntryDataAndRealloc(tif,(uint64)offset,(tmsize_t)datasize,&data);
 			if (err!=TIFFReadDirEntryErrOk)
 			{
-				_TIFFfree(data);
+				_TIFFfreeExt(tif, data);
 				return(err);
 			}
 		}
@@ -972,7 +1206,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryByteArray(TIFF* tif, TIFFDirEntr
 					err=TIFFReadDirEntryCheckRangeByteSbyte(*m);
 					if (err!=TIFFReadDirEntryErrOk)
 					{
-						_TIFFfree(origdata);
+						_TIFFfreeExt(tif, origdata);
 						return(err);
 					}
 					m++;
@@ -981,10 +1215,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryByteArray(TIFF* tif, TIFFDirEntr
 				return(TIFFReadDirEntryErrOk);
 			}
 	}
-	data=(uint8*)_TIFFmalloc(count);
+	data=(uint8*)_TIFFmallocExt(tif, count);
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -1098,10 +1332,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryByteArray(TIFF* tif, TIFFDirEntr
 			}
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	if (err!=TIFFReadDirEntryErrOk)
 	{
-		_TIFFfree(data);
+		_TIFFfreeExt(tif, data);
 		return(err);
 	}
 	*value=data;
@@ -1148,7 +1382,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySbyteArray(TIFF* tif, TIFFDirEnt
 					err=TIFFReadDirEntryCheckRangeSbyteByte(*m);
 					if (err!=TIFFReadDirEntryErrOk)
 					{
-						_TIFFfree(origdata);
+						_TIFFfreeExt(tif, origdata);
 						return(err);
 					}
 					m++;
@@ -1160,10 +1394,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySbyteArray(TIFF* tif, TIFFDirEnt
 			*value=(int8*)origdata;
 			return(TIFFReadDirEntryErrOk);
 	}
-	data=(int8*)_TIFFmalloc(count);
+	data=(int8*)_TIFFmallocExt(tif, count);
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -1277,10 +1511,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySbyteArray(TIFF* tif, TIFFDirEnt
 			}
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	if (err!=TIFFReadDirEntryErrOk)
 	{
-		_TIFFfree(data);
+		_TIFFfreeExt(tif, data);
 		return(err);
 	}
 	*value=data;
@@ -1321,30 +1555,21 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryShortArray(TIFF* tif, TIFFDirEnt
 				TIFFSwabArrayOfShort(*value,count);  
 			return(TIFFReadDirEntryErrOk);
 		case TIFF_SSHORT:
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabArrayOfShort((uint16*)origdata,count);
+			err=TIFFReadDirEntryCheckRangeSshorts((int16*)origdata,count);
+			if (err!=TIFFReadDirEntryErrOk)
 			{
-				int16* m;
-				uint32 n;
-				m=(int16*)origdata;
-				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabShort((uint16*)m);
-					err=TIFFReadDirEntryCheckRangeShortSshort(*m);
-					if (err!=TIFFReadDirEntryErrOk)
-					{
-						_TIFFfree(origdata);
-						return(err);
-					}
-					m++;
-				}
-				*value=(uint16*)origdata;
-				return(TIFFReadDirEntryErrOk);
+				_TIFFfreeExt(tif, origdata);
+				return(err);
 			}
+			*value=(uint16*)origdata;
+			return(TIFFReadDirEntryErrOk);
 	}
-	data=(uint16*)_TIFFmalloc(count*2);
+	data=(uint16*)_TIFFmallocExt(tif, count*2);
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -1449,10 +1674,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryShortArray(TIFF* tif, TIFFDirEnt
 			}
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	if (err!=TIFFReadDirEntryErrOk)
 	{
-		_TIFFfree(data);
+		_TIFFfreeExt(tif, data);
 		return(err);
 	}
 	*value=data;
@@ -1499,7 +1724,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySshortArray(TIFF* tif, TIFFDirEn
 					err=TIFFReadDirEntryCheckRangeSshortShort(*m);
 					if (err!=TIFFReadDirEntryErrOk)
 					{
-						_TIFFfree(origdata);
+						_TIFFfreeExt(tif, origdata);
 						return(err);
 					}
 					m++;
@@ -1513,10 +1738,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySshortArray(TIFF* tif, TIFFDirEn
 				TIFFSwabArrayOfShort((uint16*)(*value),count);
 			return(TIFFReadDirEntryErrOk);
 	}
-	data=(int16*)_TIFFmalloc(count*2);
+	data=(int16*)_TIFFmallocExt(tif, count*2);
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -1616,10 +1841,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySshortArray(TIFF* tif, TIFFDirEn
 			}
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	if (err!=TIFFReadDirEntryErrOk)
 	{
-		_TIFFfree(data);
+		_TIFFfreeExt(tif, data);
 		return(err);
 	}
 	*value=data;
@@ -1660,30 +1885,21 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryLongArray(TIFF* tif, TIFFDirEntr
 				TIFFSwabArrayOfLong(*value,count);
 			return(TIFFReadDirEntryErrOk);
 		case TIFF_SLONG:
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabArrayOfLong((uint32*)origdata,count);
+			err=TIFFReadDirEntryCheckRangeSlongs((int32*)origdata,count);
+			if (err!=TIFFReadDirEntryErrOk)
 			{
-				int32* m;
-				uint32 n;
-				m=(int32*)origdata;
-				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabLong((uint32*)m);
-					err=TIFFReadDirEntryCheckRangeLongSlong(*m);
-					if (err!=TIFFReadDirEntryErrOk)
-					{
-						_TIFFfree(origdata);
-						return(err);
-					}
-					m++;
-				}
-				*value=(uint32*)origdata;
-				return(TIFFReadDirEntryErrOk);
+				_TIFFfreeExt(tif, origdata);
+				return(err);
 			}
+			*value=(uint32*)origdata;
+			return(TIFFReadDirEntryErrOk);
 	}
-	data=(uint32*)_TIFFmalloc(count*4);
+	data=(uint32*)_TIFFmallocExt(tif, count*4);
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -1785,10 +2001,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryLongArray(TIFF* tif, TIFFDirEntr
 			}
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	if (err!=TIFFReadDirEntryErrOk)
 	{
-		_TIFFfree(data);
+		_TIFFfreeExt(tif, data);
 		return(err);
 	}
 	*value=data;
@@ -1835,7 +2051,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySlongArray(TIFF* tif, TIFFDirEnt
 					err=TIFFReadDirEntryCheckRangeSlongLong(*m);
 					if (err!=TIFFReadDirEntryErrOk)
 					{
-						_TIFFfree(origdata);
+						_TIFFfreeExt(tif, origdata);
 						return(err);
 					}
 					m++;
@@ -1849,10 +2065,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySlongArray(TIFF* tif, TIFFDirEnt
 				TIFFSwabArrayOfLong((uint32*)(*value),count);
 			return(TIFFReadDirEntryErrOk);
 	}
-	data=(int32*)_TIFFmalloc(count*4);
+	data=(int32*)_TIFFmallocExt(tif, count*4);
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -1946,10 +2162,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySlongArray(TIFF* tif, TIFFDirEnt
 			}
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	if (err!=TIFFReadDirEntryErrOk)
 	{
-		_TIFFfree(data);
+		_TIFFfreeExt(tif, data);
 		return(err);
 	}
 	*value=data;
@@ -1991,30 +2207,21 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryLong8ArrayWithLimit(
 				TIFFSwabArrayOfLong8(*value,count);
 			return(TIFFReadDirEntryErrOk);
 		case TIFF_SLONG8:
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabArrayOfLong8((uint64*)origdata,count);
+			err=TIFFReadDirEntryCheckRangeSlong8s((int64*)origdata,count);
+			if (err!=TIFFReadDirEntryErrOk)
 			{
-				int64* m;
-				uint32 n;
-				m=(int64*)origdata;
-				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabLong8((uint64*)m);
-					err=TIFFReadDirEntryCheckRangeLong8Slong8(*m);
-					if (err!=TIFFReadDirEntryErrOk)
-					{
-						_TIFFfree(origdata);
-						return(err);
-					}
-					m++;
-				}
-				*value=(uint64*)origdata;
-				return(TIFFReadDirEntryErrOk);
+				_TIFFfreeExt(tif, origdata);
+				return(err);
 			}
+			*value=(uint64*)origdata;
+			return(TIFFReadDirEntryErrOk);
 	}
-	data=(uint64*)_TIFFmalloc(count*8);
+	data=(uint64*)_TIFFmallocExt(tif, count*8);
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -2047,76 +2254,36 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryLong8ArrayWithLimit(
 			}
 			break;
 		case TIFF_SHORT:
-			{
-				uint16* ma;
-				uint64* mb;
-				uint32 n;
-				ma=(uint16*)origdata;
-				mb=data;
-				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabShort(ma);
-					*mb++=(uint64)(*ma++);
-				}
-			}
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabArrayOfShort((uint16*)origdata,count);
+			TIFFReadDirEntryShortsToLong8(data,(uint16*)origdata,count);
 			break;
 		case TIFF_SSHORT:
-			{
-				int16* ma;
-				uint64* mb;
-				uint32 n;
-				ma=(int16*)origdata;
-				mb=data;
-				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabShort((uint16*)ma);
-					err=TIFFReadDirEntryCheckRangeLong8Sshort(*ma);
-					if (err!=TIFFReadDirEntryErrOk)
-						break;
-					*mb++=(uint64)(*ma++);
-				}
-			}
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabArrayOfShort((uint16*)origdata,count);
+			err=TIFFReadDirEntryCheckRangeSshorts((int16*)origdata,count);
+			if (err!=TIFFReadDirEntryErrOk)
+				break;
+			TIFFReadDirEntryShortsToLong8(data,(uint16*)origdata,count);
 			break;
 		case TIFF_LONG:
-			{
-				uint32* ma;
-				uint64* mb;
-				uint32 n;
-				ma=(uint32*)origdata;
-				mb=data;
-				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabLong(ma);
-					*mb++=(uint64)(*ma++);
-				}
-			}
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabArrayOfLong((uint32*)origdata,count);
+			TIFFReadDirEntryLongsToLong8(data,(uint32*)origdata,count);
 			break;
 		case TIFF_SLONG:
-			{
-				int32* ma;
-				uint64* mb;
-				uint32 n;
-				ma=(int32*)origdata;
-				mb=data;
-				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabLong((uint32*)ma);
-					err=TIFFReadDirEntryCheckRangeLong8Slong(*ma);
-					if (err!=TIFFReadDirEntryErrOk)
-						break;
-					*mb++=(uint64)(*ma++);
-				}
-			}
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabArrayOfLong((uint32*)origdata,count);
+			err=TIFFReadDirEntryCheckRangeSlongs((int32*)origdata,count);
+			if (err!=TIFFReadDirEntryErrOk)
+				break;
+			TIFFReadDirEntryLongsToLong8(data,(uint32*)origdata,count);
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	if (err!=TIFFReadDirEntryErrOk)
 	{
-		_TIFFfree(data);
+		_TIFFfreeExt(tif, data);
 		return(err);
 	}
 	*value=data;
@@ -2168,7 +2335,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySlong8Array(TIFF* tif, TIFFDirEn
 					err=TIFFReadDirEntryCheckRangeSlong8Long8(*m);
 					if (err!=TIFFReadDirEntryErrOk)
 					{
-						_TIFFfree(origdata);
+						_TIFFfreeExt(tif, origdata);
 						return(err);
 					}
 					m++;
@@ -2182,10 +2349,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySlong8Array(TIFF* tif, TIFFDirEn
 				TIFFSwabArrayOfLong8((uint64*)(*value),count);
 			return(TIFFReadDirEntryErrOk);
 	}
-	data=(int64*)_TIFFmalloc(count*8);
+	data=(int64*)_TIFFmallocExt(tif, count*8);
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -2273,7 +2440,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntrySlong8Array(TIFF* tif, TIFFDirEn
 			}
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	*value=data;
 	return(TIFFReadDirEntryErrOk);
 }
@@ -2317,10 +2484,10 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryFloatArray(TIFF* tif, TIFFDirEnt
 			*value=(float*)origdata;
 			return(TIFFReadDirEntryErrOk);
 	}
-	data=(float*)_TIFFmalloc(count*sizeof(float));
+	data=(float*)_TIFFmallocExt(tif, count*sizeof(float));
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -2517,7 +2684,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryFloatArray(TIFF* tif, TIFFDirEnt
 			}
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	*value=data;
 	return(TIFFReadDirEntryErrOk);
 }
@@ -2562,10 +2729,10 @@ TIFFReadDirEntryDoubleArray(TIFF* tif, TIFFDirEntry* direntry, double** value)
 			*value=(double*)origdata;
 			return(TIFFReadDirEntryErrOk);
 	}
-	data=(double*)_TIFFmalloc(count*sizeof(double));
+	data=(double*)_TIFFmallocExt(tif, count*sizeof(double));
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
@@ -2597,14 +2764,12 @@ TIFFReadDirEntryDoubleArray(TIFF* tif, TIFFDirEntry* direntry, double** value)
 				uint16* ma;
 				double* mb;
 				uint32 n;
+				if (tif->tif_flags&TIFF_SWAB)
+					TIFFSwabArrayOfShort((uint16*)origdata,count);
 				ma=(uint16*)origdata;
 				mb=data;
 				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabShort(ma);
 					*mb++=(double)(*ma++);
-				}
 			}
 			break;
 		case TIFF_SSHORT:
@@ -2627,14 +2792,12 @@ TIFFReadDirEntryDoubleArray(TIFF* tif, TIFFDirEntry* direntry, double** value)
 				uint32* ma;
 				double* mb;
 				uint32 n;
+				if (tif->tif_flags&TIFF_SWAB)
+					TIFFSwabArrayOfLong((uint32*)origdata,count);
 				ma=(uint32*)origdata;
 				mb=data;
 				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabLong(ma);
 					*mb++=(double)(*ma++);
-				}
 			}
 			break;
 		case TIFF_SLONG:
@@ -2741,21 +2904,13 @@ TIFFReadDirEntryDoubleArray(TIFF* tif, TIFFDirEntry* direntry, double** value)
 			}
 			break;
 		case TIFF_FLOAT:
-			{
-				float* ma;
-				double* mb;
-				uint32 n;
-				if (tif->tif_flags&TIFF_SWAB)
-					TIFFSwabArrayOfLong((uint32*)origdata,count);  
-				TIFFCvtIEEEFloatToNative(tif,count,(float*)origdata);
-				ma=(float*)origdata;
-				mb=data;
-				for (n=0; n<count; n++)
-					*mb++=(double)(*ma++);
-			}
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabArrayOfLong((uint32*)origdata,count);  
+			TIFFCvtIEEEFloatToNative(tif,count,(float*)origdata);
+			TIFFReadDirEntryFloatsToDouble(data,(float*)origdata,count);
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	*value=data;
 	return(TIFFReadDirEntryErrOk);
 }
@@ -2791,32 +2946,22 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryIfd8Array(TIFF* tif, TIFFDirEntr
 				TIFFSwabArrayOfLong8(*value,count);
 			return(TIFFReadDirEntryErrOk);
 	}
-	data=(uint64*)_TIFFmalloc(count*8);
+	data=(uint64*)_TIFFmallocExt(tif, count*8);
 	if (data==0)
 	{
-		_TIFFfree(origdata);
+		_TIFFfreeExt(tif, origdata);
 		return(TIFFReadDirEntryErrAlloc);
 	}
 	switch (direntry->tdir_type)
 	{
 		case TIFF_LONG:
 		case TIFF_IFD:
-			{
-				uint32* ma;
-				uint64* mb;
-				uint32 n;
-				ma=(uint32*)origdata;
-				mb=data;
-				for (n=0; n<count; n++)
-				{
-					if (tif->tif_flags&TIFF_SWAB)
-						TIFFSwabLong(ma);
-					*mb++=(uint64)(*ma++);
-				}
-			}
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabArrayOfLong((uint32*)origdata,count);
+			TIFFReadDirEntryLongsToLong8(data,(uint32*)origdata,count);
 			break;
 	}
-	_TIFFfree(origdata);
+	_TIFFfreeExt(tif, origdata);
 	*value=data;
 	return(TIFFReadDirEntryErrOk);
 }
@@ -2845,7 +2990,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryPersampleShort(TIFF* tif, TIFFDi
 		}
 		nb--;
 	}
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(err);
 }
 
@@ -2874,7 +3019,7 @@ static enum TIFFReadDirEntryErr TIFFReadDirEntryPersampleDouble(TIFF* tif, TIFFD
 		}
 		nb--;
 	}
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(err);
 }
 #endif
@@ -3397,6 +3542,8 @@ TIFFReadDirEntryData(TIFF* tif, uint64 offset, tmsize_t size, void* dest)
 {
 	assert(size>0);
 	if (!isMapped(tif)) {
+		if (TIFFReadDirEntryDataAhead(tif,offset,size,dest))
+			return(TIFFReadDirEntryErrOk);
 		if (!SeekOK(tif,offset))
 			return(TIFFReadDirEntryErrIo);
 		if (!ReadOK(tif,dest,size))
@@ -3417,42 +3564,212 @@ TIFFReadDirEntryData(TIFF* tif, uint64 offset, tmsize_t size, void* dest)
 	return(TIFFReadDirEntryErrOk);
 }
 
-static void TIFFReadDirEntryOutputErr(TIFF* tif, enum TIFFReadDirEntryErr err, const char* module, const char* tagname, int recover)
+/*
+ * When the file is not mapped, the out-of-line data of the entries of
+ * the directory being read is read ahead, the ranges close to each other
+ * being joined into spans read with one call each.  Entries larger than
+ * DIRDATA_MAXENTRY and data past DIRDATA_MAXTOTAL are left to be read
+ * alone, as are tags whose reading is deferred.
+ */
+#define DIRDATA_MAXENTRY	(64 * 1024)
+#define DIRDATA_MAXGAP		4096	/* bytes read to join two ranges */
+#define DIRDATA_MAXTOTAL	(1024 * 1024)
+
+struct _TIFFDirDataSpan {
+	uint64		offset;
+	tmsize_t	size;
+	uint8*		data;
+};
+
+static int
+TIFFDirDataSpanCompare(const void* a, const void* b)
 {
-	if (!recover) {
-		switch (err) {
-			case TIFFReadDirEntryErrCount:
-				TIFFErrorExt(tif->tif_clientdata, module,
-					     "Incorrect count for \"%s\"",
-					     tagname);
-				break;
-			case TIFFReadDirEntryErrType:
-				TIFFErrorExt(tif->tif_clientdata, module,
-					     "Incompatible type for \"%s\"",
-					     tagname);
-				break;
-			case TIFFReadDirEntryErrIo:
-				TIFFErrorExt(tif->tif_clientdata, module,
-					     "IO error during reading of \"%s\"",
-					     tagname);
+	const TIFFDirDataSpan* sa = (const TIFFDirDataSpan*) a;
+	const TIFFDirDataSpan* sb = (const TIFFDirDataSpan*) b;
+
+	return (sa->offset < sb->offset ? -1 : sa->offset > sb->offset);
+}
+
+static int
+TIFFDirDataIsDeferred(TIFF* tif, uint16 tag)
+{
+	const TIFFField* fip;
+
+	switch (tag) {
+		case TIFFTAG_STRIPOFFSETS:
+		case TIFFTAG_STRIPBYTECOUNTS:
+		case TIFFTAG_TILEOFFSETS:
+		case TIFFTAG_TILEBYTECOUNTS:
+			return isDeferredStriles(tif);
+	}
+	if (!(tif->tif_flags&TIFF_DEFERTAGS))
+		return 0;
+	fip = TIFFFindField(tif, tag, TIFF_ANY);
+	return (fip == NULL || fip->field_bit == FIELD_CUSTOM);
+}
+
+static void
+TIFFReadDirDataAhead(TIFF* tif, TIFFDirEntry* dir, uint16 dircount)
+{
+	TIFFDirDataSpan* spans;
+	uint8* data;
+	uint32 nranges = 0, n, m, i;
+	tmsize_t total = 0, pos = 0;
+	uint16 di;
+
+	if (isMapped(tif) || dircount < 2)
+		return;
+	spans = (TIFFDirDataSpan*) _TIFFmallocExt(tif,
+	    dircount * sizeof(TIFFDirDataSpan));
+	if (spans == NULL)
+		return;
+	for (di = 0; di < dircount; di++) {
+		TIFFDirEntry* dp = &dir[di];
+		int width = TIFFDataWidth((TIFFDataType) dp->tdir_type);
+		uint64 size, offset;
+
+		if (width == 0 || dp->tdir_count > (uint64) (DIRDATA_MAXENTRY / width))
+			continue;
+		size = dp->tdir_count * width;
+		if (size <= ((tif->tif_flags&TIFF_BIGTIFF) ? 8 : 4) ||
+		    TIFFDirDataIsDeferred(tif, dp->tdir_tag))
+			continue;
+		if (tif->tif_flags&TIFF_BIGTIFF) {
+			offset = dp->tdir_offset.toff_long8;
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabLong8(&offset);
+		} else {
+			uint32 offset32 = dp->tdir_offset.toff_long;
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabLong(&offset32);
+			offset = offset32;
+		}
+		if (offset > ~(uint64) 0 - size)
+			continue;
+		spans[nranges].offset = offset;
+		spans[nranges].size = (tmsize_t) size;
+		nranges++;
+	}
+	if (nranges < 2) {
+		_TIFFfreeExt(tif, spans);
+		return;
+	}
+
+	/* Join the ranges that overlap or are close */
+	qsort(spans, nranges, sizeof(TIFFDirDataSpan), TIFFDirDataSpanCompare);
+	for (i = 1, m = 0; i < nranges; i++) {
+		uint64 end = spans[m].offset + spans[m].size;
+		uint64 iend = spans[i].offset + spans[i].size;
+
+		if ((spans[i].offset <= end ||
+		     spans[i].offset - end <= DIRDATA_MAXGAP) &&
+		    iend - spans[m].offset <= DIRDATA_MAXTOTAL) {
+			if (iend > end)
+				spans[m].size = (tmsize_t) (iend - spans[m].offset);
+		} else
+			spans[++m] = spans[i];
+	}
+	n = m + 1;
+	for (m = 0; m < n && spans[m].size <= DIRDATA_MAXTOTAL - total; m++)
+		total += spans[m].size;
+	n = m;
+	/* Nothing to gain if no two ranges were joined */
+	if (n == nranges || n == 0 ||
+	    (data = (uint8*) _TIFFmallocExt(tif, total)) == NULL) {
+		_TIFFfreeExt(tif, spans);
+		return;
+	}
+
+	/* Spans that cannot be read are left to the entries */
+	for (i = 0, m = 0; i < n; i++) {
+		if (!SeekOK(tif, spans[i].offset) ||
+		    !ReadOK(tif, data + pos, spans[i].size))
+			continue;
+		spans[m].offset = spans[i].offset;
+		spans[m].size = spans[i].size;
+		spans[m].data = data + pos;
+		pos += spans[m].size;
+		m++;
+	}
+	tif->tif_dirspans = spans;
+	tif->tif_ndirspans = m;
+	tif->tif_dirspandata = data;
+}
+
+/*
+ * Copy size bytes at offset from the data read ahead, if they are there.
+ */
+static int
+TIFFReadDirEntryDataAhead(TIFF* tif, uint64 offset, tmsize_t size, void* dest)
+{
+	TIFFDirDataSpan* spans = tif->tif_dirspans;
+	uint32 lo = 0, hi = tif->tif_ndirspans;
+
+	/* Find the first span ending after offset */
+	while (lo < hi) {
+		uint32 mid = lo + (hi - lo) / 2;
+
+		if (spans[mid].offset + spans[mid].size <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == tif->tif_ndirspans || spans[lo].offset > offset ||
+	    size > spans[lo].size ||
+	    offset - spans[lo].offset > (uint64) (spans[lo].size - size))
+		return 0;
+	_TIFFmemcpy(dest, spans[lo].data + (offset - spans[lo].offset), size);
+	return 1;
+}
+
+static void
+TIFFFreeDirData(TIFF* tif)
+{
+	if (tif->tif_dirspans) {
+		_TIFFfreeExt(tif, tif->tif_dirspans);
+		_TIFFfreeExt(tif, tif->tif_dirspandata);
+		tif->tif_dirspans = NULL;
+		tif->tif_dirspandata = NULL;
+		tif->tif_ndirspans = 0;
+	}
+}
+
+static void TIFFReadDirEntryOutputErr(TIFF* tif, enum TIFFReadDirEntryErr err, const char* module, const char* tagname, int recover)
+{
+	if (!recover) {
+		switch (err) {
+			case TIFFReadDirEntryErrCount:
+				TIFFErrorExtR(tif, module,
+					     "Incorrect count for \"%s\"",
+					     tagname);
+				break;
+			case TIFFReadDirEntryErrType:
+				TIFFErrorExtR(tif, module,
+					     "Incompatible type for \"%s\"",
+					     tagname);
+				break;
+			case TIFFReadDirEntryErrIo:
+				TIFFErrorExtR(tif, module,
+					     "IO error during reading of \"%s\"",
+					     tagname);
 				break;
 			case TIFFReadDirEntryErrRange:
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "Incorrect value for \"%s\"",
 					     tagname);
 				break;
 			case TIFFReadDirEntryErrPsdif:
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 			"Cannot handle different values per sample for \"%s\"",
 					     tagname);
 				break;
 			case TIFFReadDirEntryErrSizesan:
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				"Sanity check on size of \"%s\" value failed",
 					     tagname);
 				break;
 			case TIFFReadDirEntryErrAlloc:
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "Out of memory reading of \"%s\"",
 					     tagname);
 				break;
@@ -3463,37 +3780,37 @@ static void TIFFReadDirEntryOutputErr(TIFF* tif, enum TIFFReadDirEntryErr err, c
 	} else {
 		switch (err) {
 			case TIFFReadDirEntryErrCount:
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 				"Incorrect count for \"%s\"; tag ignored",
 					     tagname);
 				break;
 			case TIFFReadDirEntryErrType:
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 				"Incompatible type for \"%s\"; tag ignored",
 					       tagname);
 				break;
 			case TIFFReadDirEntryErrIo:
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 			"IO error during reading of \"%s\"; tag ignored",
 					       tagname);
 				break;
 			case TIFFReadDirEntryErrRange:
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 				"Incorrect value for \"%s\"; tag ignored",
 					       tagname);
 				break;
 			case TIFFReadDirEntryErrPsdif:
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 	"Cannot handle different values per sample for \"%s\"; tag ignored",
 					       tagname);
 				break;
 			case TIFFReadDirEntryErrSizesan:
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 		"Sanity check on size of \"%s\" value failed; tag ignored",
 					       tagname);
 				break;
 			case TIFFReadDirEntryErrAlloc:
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 				"Out of memory reading of \"%s\"; tag ignored",
 					       tagname);
 				break;
@@ -3505,11 +3822,10 @@ static void TIFFReadDirEntryOutputErr(TIFF* tif, enum TIFFReadDirEntryErr err, c
 }
 
 /*
- * Read the next TIFF directory from a file and convert it to the internal
- * format. We read directories sequentially.
+ * TIFFReadDirectory() without the statistics and trace events.
  */
-int
-TIFFReadDirectory(TIFF* tif)
+static int
+TIFFReadDirectory1(TIFF* tif)
 {
 	static const char module[] = "TIFFReadDirectory";
 	TIFFDirEntry* dir;
@@ -3524,17 +3840,25 @@ TIFFReadDirectory(TIFF* tif)
 	tif->tif_diroff=tif->tif_nextdiroff;
 	if (!TIFFCheckDirOffset(tif,tif->tif_nextdiroff))
 		return 0;           /* last offset or bad offset (IFD looping) */
+	if (tif->tif_dircache != NULL && _TIFFDirCacheSwitch(tif)) {
+		tif->tif_curdir++;
+		_TIFFLinkDirIndex(tif,tif->tif_curdir,tif->tif_diroff,
+		    tif->tif_nextdiroff);
+		return 1;
+	}
 	(*tif->tif_cleanup)(tif);   /* cleanup any previous compression state */
 	tif->tif_curdir++;
         nextdiroff = tif->tif_nextdiroff;
 	dircount=TIFFFetchDirectory(tif,nextdiroff,&dir,&tif->tif_nextdiroff);
 	if (!dircount)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,
+		TIFFErrorExtR(tif,module,
 		    "Failed to read directory at offset " TIFF_UINT64_FORMAT,nextdiroff);
 		return 0;
 	}
+	_TIFFLinkDirIndex(tif,tif->tif_curdir,nextdiroff,tif->tif_nextdiroff);
 	TIFFReadDirectoryCheckOrder(tif,dir,dircount);
+	TIFFReadDirDataAhead(tif,dir,dircount);
 
         /*
          * Mark duplicates of any tag to be ignored (bugzilla 1994)
@@ -3629,7 +3953,7 @@ TIFFReadDirectory(TIFF* tif)
 			TIFFReadDirectoryFindFieldInfo(tif,dp->tdir_tag,&fii);
 			if (fii == FAILED_FII)
 			{
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 				    "Unknown field with tag %d (0x%x) encountered",
 				    dp->tdir_tag,dp->tdir_tag);
                                 /* the following knowingly leaks the 
@@ -3639,7 +3963,7 @@ TIFFReadDirectory(TIFF* tif)
 						dp->tdir_tag,
 						(TIFFDataType) dp->tdir_type),
 					1)) {
-					TIFFWarningExt(tif->tif_clientdata,
+					TIFFWarningExtR(tif,
 					    module,
 					    "Registering anonymous field with tag %d (0x%x) failed",
 					    dp->tdir_tag,
@@ -3708,7 +4032,7 @@ TIFFReadDirectory(TIFF* tif)
 			if ((dp!=0)&&(dp->tdir_count==1))
 			{
 				tif->tif_dir.td_planarconfig=PLANARCONFIG_CONTIG;
-				TIFFWarningExt(tif->tif_clientdata,module,
+				TIFFWarningExtR(tif,module,
 				    "Planarconfig tag value assumed incorrect, "
 				    "assuming data is contig instead of chunky");
 			}
@@ -3736,7 +4060,7 @@ TIFFReadDirectory(TIFF* tif)
 		tif->tif_flags |= TIFF_ISTILED;
 	}
 	if (!tif->tif_dir.td_nstrips) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Cannot handle zero number of %s",
 		    isTiled(tif) ? "tiles" : "strips");
 		goto bad;
@@ -3830,20 +4154,22 @@ TIFFReadDirectory(TIFF* tif)
 					tif->tif_flags |= TIFF_PERSAMPLE;
 					m = TIFFSetField(tif,dp->tdir_tag,data);
 					tif->tif_flags = saved_flags;
-					_TIFFfree(data);
+					_TIFFfreeExt(tif, data);
 					if (!m)
 						goto bad;
 				}
 				break;
 			case TIFFTAG_STRIPOFFSETS:
 			case TIFFTAG_TILEOFFSETS:
-#if defined(DEFER_STRILE_LOAD)
-                                _TIFFmemcpy( &(tif->tif_dir.td_stripoffset_entry),
-                                             dp, sizeof(TIFFDirEntry) );
-#else                          
+                                if( isDeferredStriles(tif) )
+                                {
+                                    _TIFFmemcpy( &(tif->tif_dir.td_stripoffset_entry),
+                                                 dp, sizeof(TIFFDirEntry) );
+                                    break;
+                                }
                                 if( tif->tif_dir.td_stripoffset != NULL )
                                 {
-                                    TIFFErrorExt(tif->tif_clientdata, module,
+                                    TIFFErrorExtR(tif, module,
                                         "tif->tif_dir.td_stripoffset is "
                                         "already allocated. Likely duplicated "
                                         "StripOffsets/TileOffsets tag");
@@ -3851,17 +4177,18 @@ TIFFReadDirectory(TIFF* tif)
                                 }
 				if (!TIFFFetchStripThing(tif,dp,tif->tif_dir.td_nstrips,&tif->tif_dir.td_stripoffset))  
 					goto bad;
-#endif                                
 				break;
 			case TIFFTAG_STRIPBYTECOUNTS:
 			case TIFFTAG_TILEBYTECOUNTS:
-#if defined(DEFER_STRILE_LOAD)
-                                _TIFFmemcpy( &(tif->tif_dir.td_stripbytecount_entry),
-                                             dp, sizeof(TIFFDirEntry) );
-#else                          
+                                if( isDeferredStriles(tif) )
+                                {
+                                    _TIFFmemcpy( &(tif->tif_dir.td_stripbytecount_entry),
+                                                 dp, sizeof(TIFFDirEntry) );
+                                    break;
+                                }
                                 if( tif->tif_dir.td_stripbytecount != NULL )
                                 {
-                                    TIFFErrorExt(tif->tif_clientdata, module,
+                                    TIFFErrorExtR(tif, module,
                                         "tif->tif_dir.td_stripbytecount is "
                                         "already allocated. Likely duplicated "
                                         "StripByteCounts/TileByteCounts tag");
@@ -3869,7 +4196,6 @@ TIFFReadDirectory(TIFF* tif)
                                 }
                                 if (!TIFFFetchStripThing(tif,dp,tif->tif_dir.td_nstrips,&tif->tif_dir.td_stripbytecount))  
 					goto bad;
-#endif                                
 				break;
 			case TIFFTAG_COLORMAP:
 			case TIFFTAG_TRANSFERFUNCTION:
@@ -3887,7 +4213,7 @@ TIFFReadDirectory(TIFF* tif)
                     if( !bitspersample_read )
                     {
                         fip = TIFFFieldWithTag(tif,dp->tdir_tag);
-                        TIFFWarningExt(tif->tif_clientdata,module,
+                        TIFFWarningExtR(tif,module,
                                        "Ignoring %s since BitsPerSample tag not found",
                                        fip ? fip->field_name : "unknown tagname");
                         continue;
@@ -3898,7 +4224,7 @@ TIFFReadDirectory(TIFF* tif)
 					if (tif->tif_dir.td_bitspersample > 24)
 					{
 					    fip = TIFFFieldWithTag(tif,dp->tdir_tag);
-					    TIFFWarningExt(tif->tif_clientdata,module,
+					    TIFFWarningExtR(tif,module,
 						"Ignoring %s because BitsPerSample=%d>24",
 						fip ? fip->field_name : "unknown tagname",
 						tif->tif_dir.td_bitspersample);
@@ -3927,7 +4253,7 @@ TIFFReadDirectory(TIFF* tif)
 					else
 					{
 						TIFFSetField(tif,dp->tdir_tag,value,value+incrementpersample,value+2*incrementpersample);
-						_TIFFfree(value);
+						_TIFFfreeExt(tif, value);
 					}
 				}
 				break;
@@ -3951,7 +4277,8 @@ TIFFReadDirectory(TIFF* tif)
 				break;
 /* END REV 4.0 COMPATIBILITY */
 			default:
-				(void) TIFFFetchNormalTag(tif, dp, TRUE);
+				if (!TIFFDeferTag(tif, dp, dircount))
+					(void) TIFFFetchNormalTag(tif, dp, TRUE);
 				break;
 		}
 	}
@@ -3975,7 +4302,7 @@ TIFFReadDirectory(TIFF* tif)
 	{
 		if (!TIFFFieldSet(tif,FIELD_PHOTOMETRIC))
 		{
-			TIFFWarningExt(tif->tif_clientdata, module,
+			TIFFWarningExtR(tif, module,
 			    "Photometric tag is missing, assuming data is YCbCr");
 			if (!TIFFSetField(tif,TIFFTAG_PHOTOMETRIC,PHOTOMETRIC_YCBCR))
 				goto bad;
@@ -3983,13 +4310,13 @@ TIFFReadDirectory(TIFF* tif)
 		else if (tif->tif_dir.td_photometric==PHOTOMETRIC_RGB)
 		{
 			tif->tif_dir.td_photometric=PHOTOMETRIC_YCBCR;
-			TIFFWarningExt(tif->tif_clientdata, module,
+			TIFFWarningExtR(tif, module,
 			    "Photometric tag value assumed incorrect, "
 			    "assuming data is YCbCr instead of RGB");
 		}
 		if (!TIFFFieldSet(tif,FIELD_BITSPERSAMPLE))
 		{
-			TIFFWarningExt(tif->tif_clientdata,module,
+			TIFFWarningExtR(tif,module,
 			    "BitsPerSample tag is missing, assuming 8 bits per sample");
 			if (!TIFFSetField(tif,TIFFTAG_BITSPERSAMPLE,8))
 				goto bad;
@@ -3998,7 +4325,7 @@ TIFFReadDirectory(TIFF* tif)
 		{
 			if (tif->tif_dir.td_photometric==PHOTOMETRIC_RGB)
 			{
-				TIFFWarningExt(tif->tif_clientdata,module,
+				TIFFWarningExtR(tif,module,
 				    "SamplesPerPixel tag is missing, "
 				    "assuming correct SamplesPerPixel value is 3");
 				if (!TIFFSetField(tif,TIFFTAG_SAMPLESPERPIXEL,3))
@@ -4006,7 +4333,7 @@ TIFFReadDirectory(TIFF* tif)
 			}
 			if (tif->tif_dir.td_photometric==PHOTOMETRIC_YCBCR)
 			{
-				TIFFWarningExt(tif->tif_clientdata,module,
+				TIFFWarningExtR(tif,module,
 				    "SamplesPerPixel tag is missing, "
 				    "applying correct SamplesPerPixel value of 3");
 				if (!TIFFSetField(tif,TIFFTAG_SAMPLESPERPIXEL,3))
@@ -4061,7 +4388,7 @@ TIFFReadDirectory(TIFF* tif)
 			    MissingRequired(tif, "StripByteCounts");
 			    goto bad;
 			}
-			TIFFWarningExt(tif->tif_clientdata, module,
+			TIFFWarningExtR(tif, module,
 				"TIFF directory is missing required "
 				"\"StripByteCounts\" field, calculating from imagelength");
 			if (EstimateStripByteCounts(tif, dir, dircount) < 0)
@@ -4099,13 +4426,13 @@ TIFFReadDirectory(TIFF* tif)
 			 * correct value is!  Try and handle the simple case
 			 * of estimating the size of a one strip image.
 			 */
-			TIFFWarningExt(tif->tif_clientdata, module,
+			TIFFWarningExtR(tif, module,
 			    "Bogus \"StripByteCounts\" field, ignoring and calculating from imagelength");
 			if(EstimateStripByteCounts(tif, dir, dircount) < 0)
 			    goto bad;
 
-#if !defined(DEFER_STRILE_LOAD)
-		} else if (tif->tif_dir.td_planarconfig == PLANARCONFIG_CONTIG
+		} else if (!isDeferredStriles(tif)
+			   && tif->tif_dir.td_planarconfig == PLANARCONFIG_CONTIG
 			   && tif->tif_dir.td_nstrips > 2
 			   && tif->tif_dir.td_compression == COMPRESSION_NONE
 			   && tif->tif_dir.td_stripbytecount[0] != tif->tif_dir.td_stripbytecount[1]
@@ -4121,16 +4448,15 @@ TIFFReadDirectory(TIFF* tif)
                          * as it would always force us to load the strip/tile
                          * information.
 			 */
-			TIFFWarningExt(tif->tif_clientdata, module,
+			TIFFWarningExtR(tif, module,
 			    "Wrong \"StripByteCounts\" field, ignoring and calculating from imagelength");
 			if (EstimateStripByteCounts(tif, dir, dircount) < 0)
 			    goto bad;
-#endif /* !defined(DEFER_STRILE_LOAD) */                        
 		}
 	}
 	if (dir)
 	{
-		_TIFFfree(dir);
+		_TIFFfreeExt(tif, dir);
 		dir=NULL;
 	}
 	if (!TIFFFieldSet(tif, FIELD_MAXSAMPLEVALUE))
@@ -4145,8 +4471,7 @@ TIFFReadDirectory(TIFF* tif)
 	 * bytecounts array. See also comments for TIFFAppendToStrip()
 	 * function in tif_write.c.
 	 */
-#if !defined(DEFER_STRILE_LOAD)        
-	if (tif->tif_dir.td_nstrips > 1) {
+	if (!isDeferredStriles(tif) && tif->tif_dir.td_nstrips > 1) {
 		uint32 strip;
 
 		tif->tif_dir.td_stripbytecountsorted = 1;
@@ -4158,7 +4483,6 @@ TIFFReadDirectory(TIFF* tif)
 			}
 		}
 	}
-#endif /* !defined(DEFER_STRILE_LOAD) */
         
 	/*
 	 * An opportunity for compression mode dependent tag fixup
@@ -4183,6 +4507,29 @@ TIFFReadDirectory(TIFF* tif)
             return 0;
 		ChopUpSingleUncompressedStrip(tif);
     }
+	else if ((tif->tif_dir.td_planarconfig==PLANARCONFIG_CONTIG)&&
+	    (tif->tif_dir.td_nstrips==1)&&
+	    (tif->tif_dir.td_compression==COMPRESSION_NONE)&&
+	    (tif->tif_mode==O_RDONLY)&&
+	    ((tif->tif_flags&(TIFF_STRIPCHOP|TIFF_ISTILED))==(TIFF_STRIPCHOP|TIFF_ISTILED)))
+    {
+        if ( !_TIFFFillStriles(tif) || !tif->tif_dir.td_stripbytecount )
+            return 0;
+		ChopUpSingleUncompressedTile(tif);
+    }
+
+	/*
+	 * A compressed strip cannot be cut up, but the scanline interface
+	 * can read a large one piece by piece rather than loading it whole,
+	 * for codecs that decode from wherever the raw data stops.
+	 */
+	tif->tif_flags &= ~TIFF_CHUNKYSTRIP;
+	if ((tif->tif_dir.td_stripsperimage==1)&&
+	    IsChunkyReadCompression(tif->tif_dir.td_compression)&&
+	    ((tif->tif_flags&(TIFF_STRIPCHOP|TIFF_ISTILED))==TIFF_STRIPCHOP)&&
+	    _TIFFFillStriles(tif)&&tif->tif_dir.td_stripbytecount&&
+	    tif->tif_dir.td_stripbytecount[0] > CHUNKY_STRIP_MIN_BYTES)
+		tif->tif_flags |= TIFF_CHUNKYSTRIP;
 
         /*
          * Clear the dirty directory flag. 
@@ -4201,7 +4548,7 @@ TIFFReadDirectory(TIFF* tif)
 
 	tif->tif_scanlinesize = TIFFScanlineSize(tif);
 	if (!tif->tif_scanlinesize) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Cannot handle zero scanline size");
 		return (0);
 	}
@@ -4209,13 +4556,13 @@ TIFFReadDirectory(TIFF* tif)
 	if (isTiled(tif)) {
 		tif->tif_tilesize = TIFFTileSize(tif);
 		if (!tif->tif_tilesize) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			     "Cannot handle zero tile size");
 			return (0);
 		}
 	} else {
 		if (!TIFFStripSize(tif)) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Cannot handle zero strip size");
 			return (0);
 		}
@@ -4223,10 +4570,45 @@ TIFFReadDirectory(TIFF* tif)
 	return (1);
 bad:
 	if (dir)
-		_TIFFfree(dir);
+		_TIFFfreeExt(tif, dir);
 	return (0);
 }
 
+/*
+ * Read the next TIFF directory from a file and convert it to the internal
+ * format. We read directories sequentially.
+ */
+int
+TIFFReadDirectory(TIFF* tif)
+{
+	uint64 start;
+	int ret;
+
+	if (!_TIFFCheckUnshared(tif, 0, "TIFFReadDirectory"))
+		return (0);
+	if (tif->tif_stats == NULL && tif->tif_traceproc == NULL) {
+		ret = TIFFReadDirectory1(tif);
+		TIFFFreeDirData(tif);
+		if (tif->tif_dircache)
+			_TIFFDirCacheRead(tif, ret);
+		return (ret);
+	}
+	_TIFFTrace(tif, TIFF_TRACE_READDIR, TIFF_TRACE_BEGIN, 0, 0);
+	start = tif->tif_stats ? _TIFFStatsClock() : 0;
+	ret = TIFFReadDirectory1(tif);
+	TIFFFreeDirData(tif);
+	if (tif->tif_dircache)
+		_TIFFDirCacheRead(tif, ret);
+	if (tif->tif_stats) {
+		tif->tif_stats->directorytime += _TIFFStatsClock() - start;
+		if (ret)
+			tif->tif_stats->directoriesread++;
+	}
+	_TIFFTrace(tif, TIFF_TRACE_READDIR,
+	    ret ? TIFF_TRACE_END : TIFF_TRACE_FAIL, 0, 0);
+	return (ret);
+}
+
 static void
 TIFFReadDirectoryCheckOrder(TIFF* tif, TIFFDirEntry* dir, uint16 dircount)
 {
@@ -4239,7 +4621,7 @@ TIFFReadDirectoryCheckOrder(TIFF* tif, TIFFDirEntry* dir, uint16 dircount)
 	{
 		if (o->tdir_tag<m)
 		{
-			TIFFWarningExt(tif->tif_clientdata,module,
+			TIFFWarningExtR(tif,module,
 			    "Invalid TIFF directory; tags are not sorted in ascending order");
 			break;
 		}
@@ -4264,33 +4646,7 @@ TIFFReadDirectoryFindEntry(TIFF* tif, TIFFDirEntry* dir, uint16 dircount, uint16
 static void
 TIFFReadDirectoryFindFieldInfo(TIFF* tif, uint16 tagid, uint32* fii)
 {
-	int32 ma,mb,mc;
-	ma=-1;
-	mc=(int32)tif->tif_nfields;
-	while (1)
-	{
-		if (ma+1==mc)
-		{
-			*fii = FAILED_FII;
-			return;
-		}
-		mb=(ma+mc)/2;
-		if (tif->tif_fields[mb]->field_tag==(uint32)tagid)
-			break;
-		if (tif->tif_fields[mb]->field_tag<(uint32)tagid)
-			ma=mb;
-		else
-			mc=mb;
-	}
-	while (1)
-	{
-		if (mb==0)
-			break;
-		if (tif->tif_fields[mb-1]->field_tag!=(uint32)tagid)
-			break;
-		mb--;
-	}
-	*fii=mb;
+	*fii = _TIFFFindFieldIndex(tif, (uint32) tagid);
 }
 
 /*
@@ -4308,30 +4664,33 @@ TIFFReadCustomDirectory(TIFF* tif, toff_t diroff,
 	uint16 di;
 	const TIFFField* fip;
 	uint32 fii;
+	if (!_TIFFCheckUnshared(tif, 0, module))
+		return 0;
 	_TIFFSetupFields(tif, infoarray);
 	dircount=TIFFFetchDirectory(tif,diroff,&dir,NULL);
 	if (!dircount)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,
+		TIFFErrorExtR(tif,module,
 		    "Failed to read custom directory at offset " TIFF_UINT64_FORMAT,diroff);
 		return 0;
 	}
 	TIFFFreeDirectory(tif);
 	_TIFFmemset(&tif->tif_dir, 0, sizeof(TIFFDirectory));
 	TIFFReadDirectoryCheckOrder(tif,dir,dircount);
+	TIFFReadDirDataAhead(tif,dir,dircount);
 	for (di=0, dp=dir; di<dircount; di++, dp++)
 	{
 		TIFFReadDirectoryFindFieldInfo(tif,dp->tdir_tag,&fii);
 		if (fii == FAILED_FII)
 		{
-			TIFFWarningExt(tif->tif_clientdata, module,
+			TIFFWarningExtR(tif, module,
 			    "Unknown field with tag %d (0x%x) encountered",
 			    dp->tdir_tag, dp->tdir_tag);
 			if (!_TIFFMergeFields(tif, _TIFFCreateAnonField(tif,
 						dp->tdir_tag,
 						(TIFFDataType) dp->tdir_type),
 					     1)) {
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 				    "Registering anonymous field with tag %d (0x%x) failed",
 				    dp->tdir_tag, dp->tdir_tag);
 				dp->tdir_tag=IGNORE;
@@ -4361,7 +4720,7 @@ TIFFReadCustomDirectory(TIFF* tif, toff_t diroff,
 				}
 				if (fii==0xFFFF)
 				{
-					TIFFWarningExt(tif->tif_clientdata, module,
+					TIFFWarningExtR(tif, module,
 					    "Wrong data type %d for \"%s\"; tag ignored",
 					    dp->tdir_type,fip->field_name);
 					dp->tdir_tag=IGNORE;
@@ -4395,8 +4754,9 @@ TIFFReadCustomDirectory(TIFF* tif, toff_t diroff,
 			}
 		}
 	}
+	TIFFFreeDirData(tif);
 	if (dir)
-		_TIFFfree(dir);
+		_TIFFfreeExt(tif, dir);
 	return 1;
 }
 
@@ -4412,6 +4772,152 @@ TIFFReadEXIFDirectory(TIFF* tif, toff_t diroff)
 	return TIFFReadCustomDirectory(tif, diroff, exifFieldArray);  
 }
 
+#define	DIROFFHASH(off, mask) \
+	(((uint32)((off) ^ ((off) >> 32)) * 2654435761U) & (mask))
+
+/*
+ * Add diroff to the set of visited directories.  Returns 0 if it was
+ * already there, -1 if out of memory.
+ */
+static int
+TIFFScanMarkDirectory(TIFF* tif, uint64** pset, uint32* pmask, uint32* pn,
+    uint64 diroff)
+{
+	uint32 h;
+
+	if (2 * (*pn + 1) > *pmask) {
+		uint32 mask = *pmask ? 2 * *pmask + 1 : 63;
+		uint64* set = (uint64*) _TIFFcallocExt(tif, mask + 1, sizeof(uint64));
+		uint32 i;
+
+		if (set == NULL)
+			return (-1);
+		for (i = 0; *pset != NULL && i <= *pmask; i++) {
+			if ((*pset)[i] != 0) {
+				h = DIROFFHASH((*pset)[i], mask);
+				while (set[h] != 0)
+					h = (h + 1) & mask;
+				set[h] = (*pset)[i];
+			}
+		}
+		if (*pset)
+			_TIFFfreeExt(tif, *pset);
+		*pset = set;
+		*pmask = mask;
+	}
+	h = DIROFFHASH(diroff, *pmask);
+	while ((*pset)[h] != 0) {
+		if ((*pset)[h] == diroff)
+			return (0);
+		h = (h + 1) & *pmask;
+	}
+	(*pset)[h] = diroff;
+	(*pn)++;
+	return (1);
+}
+
+/*
+ * Walk the chain of image directories and report the raw entries of
+ * each one to proc, without reading any tag value or touching the
+ * current directory.  proc returns 0 to stop the scan.  Returns 0 if
+ * a directory cannot be read or the chain loops, 1 otherwise.
+ */
+int
+TIFFScanDirectories(TIFF* tif, TIFFScanDirectoryProc proc, void* clientdata)
+{
+	static const char module[] = "TIFFScanDirectories";
+	uint64 savediroff = tif->tif_diroff;
+	uint64 diroff, nextdiroff;
+	uint64* seen = NULL;
+	uint32 seenmask = 0, nseen = 0;
+	TIFFScanEntry* entries = NULL;
+	uint16 maxentries = 0;
+	uint16 dirnum = 0;
+	int ret = 1;
+
+	if (!(tif->tif_flags&TIFF_BIGTIFF))
+		diroff = tif->tif_header.classic.tiff_diroff;
+	else
+		diroff = tif->tif_header.big.tiff_diroff;
+	while (diroff != 0) {
+		TIFFDirEntry* dir = NULL;
+		uint16 dircount, i;
+		int r;
+
+		if (dirnum == 65535) {
+			TIFFErrorExtR(tif, module,
+			    "Too many directories");
+			ret = 0;
+			break;
+		}
+		r = TIFFScanMarkDirectory(tif, &seen, &seenmask, &nseen, diroff);
+		if (r <= 0) {
+			TIFFErrorExtR(tif, module, r < 0 ?
+			    "Out of memory" : "Cycle in the directory chain");
+			ret = 0;
+			break;
+		}
+		dircount = TIFFFetchDirectory(tif, diroff, &dir, &nextdiroff);
+		if (dircount == 0) {
+			if (dir)
+				_TIFFfreeExt(tif, dir);
+			ret = 0;
+			break;
+		}
+		if (dircount > maxentries) {
+			TIFFScanEntry* e = (TIFFScanEntry*) _TIFFCheckRealloc(tif,
+			    entries, dircount, sizeof(TIFFScanEntry),
+			    "for directory entries");
+
+			if (e == NULL) {
+				_TIFFfreeExt(tif, dir);
+				ret = 0;
+				break;
+			}
+			entries = e;
+			maxentries = dircount;
+		}
+		for (i = 0; i < dircount; i++) {
+			TIFFDirEntry* dp = &dir[i];
+			TIFFScanEntry* e = &entries[i];
+			int width = TIFFDataWidth((TIFFDataType) dp->tdir_type);
+			uint64 limit = (tif->tif_flags&TIFF_BIGTIFF) ? 8 : 4;
+
+			e->tag = dp->tdir_tag;
+			e->type = dp->tdir_type;
+			e->count = dp->tdir_count;
+			e->isinline = width > 0 && dp->tdir_count <= limit / width;
+			_TIFFmemset(e->value, 0, sizeof(e->value));
+			_TIFFmemcpy(e->value, &dp->tdir_offset, (tmsize_t) limit);
+			if (e->isinline)
+				e->offset = 0;
+			else if (!(tif->tif_flags&TIFF_BIGTIFF)) {
+				uint32 off = dp->tdir_offset.toff_long;
+
+				if (tif->tif_flags&TIFF_SWAB)
+					TIFFSwabLong(&off);
+				e->offset = off;
+			} else {
+				e->offset = dp->tdir_offset.toff_long8;
+				if (tif->tif_flags&TIFF_SWAB)
+					TIFFSwabLong8(&e->offset);
+			}
+		}
+		_TIFFfreeExt(tif, dir);
+		if (!(*proc)(tif, clientdata, dirnum, diroff, dircount,
+		    entries, nextdiroff))
+			break;
+		dirnum++;
+		diroff = nextdiroff;
+	}
+	if (entries)
+		_TIFFfreeExt(tif, entries);
+	if (seen)
+		_TIFFfreeExt(tif, seen);
+	tif->tif_diroff = savediroff;
+	return (ret);
+}
+
 static int
 EstimateStripByteCounts(TIFF* tif, TIFFDirEntry* dir, uint16 dircount)
 {
@@ -4426,7 +4932,7 @@ EstimateStripByteCounts(TIFF* tif, TIFFDirEntry* dir, uint16 dircount)
             return -1;
 
 	if (td->td_stripbytecount)
-		_TIFFfree(td->td_stripbytecount);
+		_TIFFfreeExt(tif, td->td_stripbytecount);
 	td->td_stripbytecount = (uint64*)
 	    _TIFFCheckMalloc(tif, td->td_nstrips, sizeof (uint64),
 		"for \"StripByteCounts\" array");
@@ -4449,7 +4955,7 @@ EstimateStripByteCounts(TIFF* tif, TIFFDirEntry* dir, uint16 dircount)
 			uint64 datasize;
 			typewidth = TIFFDataWidth((TIFFDataType) dp->tdir_type);
 			if (typewidth == 0) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				    "Cannot determine size of unknown tag type %d",
 				    dp->tdir_type);
 				return -1;
@@ -4508,56 +5014,114 @@ MissingRequired(TIFF* tif, const char* tagname)
 {
 	static const char module[] = "MissingRequired";
 
-	TIFFErrorExt(tif->tif_clientdata, module,
+	TIFFErrorExtR(tif, module,
 	    "TIFF directory is missing required \"%s\" field",
 	    tagname);
 }
 
+/*
+ * The slot of tif_dirset where diroff is, or where it would go: the first
+ * one on its probe sequence that holds diroff or no offset of the current
+ * generation.  Offsets are only added within a generation, so an offset
+ * is never found past a free slot.
+ */
+static TIFFDirSetEntry*
+TIFFDirSetFind(TIFF* tif, uint64 diroff)
+{
+	uint32 i = DIROFFHASH(diroff, tif->tif_dirsetmask);
+
+	for (;;) {
+		TIFFDirSetEntry* e = &tif->tif_dirset[i];
+
+		if (e->gen != tif->tif_dirsetgen || e->diroff == diroff)
+			return (e);
+		i = (i + 1) & tif->tif_dirsetmask;
+	}
+}
+
 /*
  * Check the directory offset against the list of already seen directory
  * offsets. This is a trick to prevent IFD looping. The one can create TIFF
  * file with looped directory pointers. We will maintain a list of already
- * seen directories and check every IFD offset against that list.
+ * seen directories, and a hash set of the same offsets to check every IFD
+ * offset against in constant time.
  */
 static int
 TIFFCheckDirOffset(TIFF* tif, uint64 diroff)
 {
-	uint16 n;
+	static const char module[] = "TIFFCheckDirOffset";
+	TIFFDirSetEntry* e;
 
 	if (diroff == 0)			/* no more directories */
 		return 0;
-	if (tif->tif_dirnumber == 65535) {
-	    TIFFErrorExt(tif->tif_clientdata, "TIFFCheckDirOffset",
-			 "Cannot handle more than 65535 TIFF directories");
+	if (tif->tif_dirnumber == 0xFFFFFFFFU) {
+	    TIFFErrorExtR(tif, module,
+			 "Cannot handle more than %u TIFF directories",
+			 0xFFFFFFFFU);
 	    return 0;
 	}
-
-	for (n = 0; n < tif->tif_dirnumber && tif->tif_dirlist; n++) {
-		if (tif->tif_dirlist[n] == diroff)
+	if (tif->tif_dirnumber == 0) {
+		/* A new list was started: forget the offsets of the old one */
+		if (++tif->tif_dirsetgen == 0) {
+			if (tif->tif_dirset)
+				_TIFFmemset(tif->tif_dirset, 0,
+				    ((tmsize_t) tif->tif_dirsetmask + 1) *
+				    sizeof(TIFFDirSetEntry));
+			tif->tif_dirsetgen = 1;
+		}
+	} else if (tif->tif_dirset) {
+		e = TIFFDirSetFind(tif, diroff);
+		if (e->gen == tif->tif_dirsetgen)
 			return 0;
 	}
 
-	tif->tif_dirnumber++;
-
-	if (tif->tif_dirlist == NULL || tif->tif_dirnumber > tif->tif_dirlistsize) {
+	if (tif->tif_dirlist == NULL || tif->tif_dirnumber >= tif->tif_dirlistsize) {
+		uint32 size = tif->tif_dirlistsize >= 0x80000000U ?
+		    0xFFFFFFFFU : 2 * tif->tif_dirlistsize;
 		uint64* new_dirlist;
 
-		/*
-		 * XXX: Reduce memory allocation granularity of the dirlist
-		 * array.
-		 */
+		if (size < 16)
+			size = 16;
 		new_dirlist = (uint64*)_TIFFCheckRealloc(tif, tif->tif_dirlist,
-		    tif->tif_dirnumber, 2 * sizeof(uint64), "for IFD list");
+		    size, sizeof(uint64), "for IFD list");
 		if (!new_dirlist)
 			return 0;
-		if( tif->tif_dirnumber >= 32768 )
-		    tif->tif_dirlistsize = 65535;
-		else
-		    tif->tif_dirlistsize = 2 * tif->tif_dirnumber;
+		tif->tif_dirlistsize = size;
 		tif->tif_dirlist = new_dirlist;
 	}
+	/* Keep the hash set at most half full */
+	if (tif->tif_dirset == NULL ||
+	    tif->tif_dirnumber >= (tif->tif_dirsetmask + 1) / 2) {
+		uint32 nslots = tif->tif_dirset ?
+		    2 * (tif->tif_dirsetmask + 1) : 64;
+		uint32 n;
+
+		if (nslots == 0) {
+			TIFFErrorExtR(tif, module, "Too many TIFF directories");
+			return 0;
+		}
+		if (tif->tif_dirset)
+			_TIFFfreeExt(tif, tif->tif_dirset);
+		tif->tif_dirset = (TIFFDirSetEntry*) _TIFFcallocExt(tif,
+		    nslots, sizeof(TIFFDirSetEntry));
+		if (!tif->tif_dirset) {
+			TIFFErrorExtR(tif, module, "No space for IFD set");
+			tif->tif_dirsetmask = 0;
+			return 0;
+		}
+		tif->tif_dirsetmask = nslots - 1;
+		tif->tif_dirsetgen = 1;
+		for (n = 0; n < tif->tif_dirnumber; n++) {
+			e = TIFFDirSetFind(tif, tif->tif_dirlist[n]);
+			e->diroff = tif->tif_dirlist[n];
+			e->gen = tif->tif_dirsetgen;
+		}
+	}
 
-	tif->tif_dirlist[tif->tif_dirnumber - 1] = diroff;
+	e = TIFFDirSetFind(tif, diroff);
+	e->diroff = diroff;
+	e->gen = tif->tif_dirsetgen;
+	tif->tif_dirlist[tif->tif_dirnumber++] = diroff;
 
 	return 1;
 }
@@ -4571,14 +5135,14 @@ CheckDirCount(TIFF* tif, TIFFDirEntry* dir, uint32 count)
 {
 	if ((uint64)count > dir->tdir_count) {
 		const TIFFField* fip = TIFFFieldWithTag(tif, dir->tdir_tag);
-		TIFFWarningExt(tif->tif_clientdata, tif->tif_name,
+		TIFFWarningExtR(tif, tif->tif_name,
 	"incorrect count for field \"%s\" (" TIFF_UINT64_FORMAT ", expecting %u); tag ignored",
 		    fip ? fip->field_name : "unknown tagname",
 		    dir->tdir_count, count);
 		return (0);
 	} else if ((uint64)count < dir->tdir_count) {
 		const TIFFField* fip = TIFFFieldWithTag(tif, dir->tdir_tag);
-		TIFFWarningExt(tif->tif_clientdata, tif->tif_name,
+		TIFFWarningExtR(tif, tif->tif_name,
 	"incorrect count for field \"%s\" (" TIFF_UINT64_FORMAT ", expecting %u); tag trimmed",
 		    fip ? fip->field_name : "unknown tagname",
 		    dir->tdir_count, count);
@@ -4614,7 +5178,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 		*nextdiroff = 0;
 	if (!isMapped(tif)) {
 		if (!SeekOK(tif, tif->tif_diroff)) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				"%s: Seek error accessing TIFF directory",
 				tif->tif_name);
 			return 0;
@@ -4622,7 +5186,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 		if (!(tif->tif_flags&TIFF_BIGTIFF))
 		{
 			if (!ReadOK(tif, &dircount16, sizeof (uint16))) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				    "%s: Can not read TIFF directory count",
 				    tif->tif_name);
 				return 0;
@@ -4631,7 +5195,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 				TIFFSwabShort(&dircount16);
 			if (dircount16>4096)
 			{
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				    "Sanity check on directory count failed, this is probably not a valid IFD offset");
 				return 0;
 			}
@@ -4639,7 +5203,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 		} else {
 			uint64 dircount64;
 			if (!ReadOK(tif, &dircount64, sizeof (uint64))) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					"%s: Can not read TIFF directory count",
 					tif->tif_name);
 				return 0;
@@ -4648,7 +5212,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 				TIFFSwabLong8(&dircount64);
 			if (dircount64>4096)
 			{
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				    "Sanity check on directory count failed, this is probably not a valid IFD offset");
 				return 0;
 			}
@@ -4660,10 +5224,10 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 		if (origdir == NULL)
 			return 0;
 		if (!ReadOK(tif, origdir, (tmsize_t)(dircount16*dirsize))) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				"%.100s: Can not read TIFF directory",
 				tif->tif_name);
-			_TIFFfree(origdir);
+			_TIFFfreeExt(tif, origdir);
 			return 0;
 		}
 		/*
@@ -4692,7 +5256,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 		tmsize_t off = (tmsize_t) tif->tif_diroff;
 		if ((uint64)off!=tif->tif_diroff)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Can not read TIFF directory count");
+			TIFFErrorExtR(tif,module,"Can not read TIFF directory count");
 			return(0);
 		}
 
@@ -4709,7 +5273,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 		{
 			m=off+sizeof(uint16);
 			if ((m<off)||(m<(tmsize_t)sizeof(uint16))||(m>tif->tif_size)) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					"Can not read TIFF directory count");
 				return 0;
 			} else {
@@ -4721,7 +5285,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 				TIFFSwabShort(&dircount16);
 			if (dircount16>4096)
 			{
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				    "Sanity check on directory count failed, this is probably not a valid IFD offset");
 				return 0;
 			}
@@ -4732,7 +5296,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 			uint64 dircount64;
 			m=off+sizeof(uint64);
 			if ((m<off)||(m<(tmsize_t)sizeof(uint64))||(m>tif->tif_size)) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					"Can not read TIFF directory count");
 				return 0;
 			} else {
@@ -4744,7 +5308,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 				TIFFSwabLong8(&dircount64);
 			if (dircount64>4096)
 			{
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				    "Sanity check on directory count failed, this is probably not a valid IFD offset");
 				return 0;
 			}
@@ -4753,7 +5317,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 		}
 		if (dircount16 == 0 )
 		{
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			             "Sanity check on directory count failed, zero tag directories not supported");
 			return 0;
 		}
@@ -4764,9 +5328,9 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 			return 0;
 		m=off+dircount16*dirsize;
 		if ((m<off)||(m<(tmsize_t)(dircount16*dirsize))||(m>tif->tif_size)) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				     "Can not read TIFF directory");
-			_TIFFfree(origdir);
+			_TIFFfreeExt(tif, origdir);
 			return 0;
 		} else {
 			_TIFFmemcpy(origdir, tif->tif_base + off,
@@ -4805,7 +5369,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 						"to read TIFF directory");
 	if (dir==0)
 	{
-		_TIFFfree(origdir);
+		_TIFFfreeExt(tif, origdir);
 		return 0;
 	}
 	ma=(uint8*)origdir;
@@ -4840,7 +5404,7 @@ TIFFFetchDirectory(TIFF* tif, uint64 diroff, TIFFDirEntry** pdir,
 		}
 		mb++;
 	}
-	_TIFFfree(origdir);
+	_TIFFfreeExt(tif, origdir);
 	*pdir = dir;
 	return dircount16;
 }
@@ -4858,7 +5422,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 	TIFFReadDirectoryFindFieldInfo(tif,dp->tdir_tag,&fii);
         if( fii == FAILED_FII )
         {
-            TIFFErrorExt(tif->tif_clientdata, "TIFFFetchNormalTag",
+            TIFFErrorExtR(tif, "TIFFFetchNormalTag",
                          "No definition found for tag %d",
                          dp->tdir_tag);
             return 0;
@@ -4892,30 +5456,30 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						mb++;
 					}
 					if (mb+1<(uint32)dp->tdir_count)
-						TIFFWarningExt(tif->tif_clientdata,module,"ASCII value for tag \"%s\" contains null byte in value; value incorrectly truncated during reading due to implementation limitations",fip->field_name);
+						TIFFWarningExtR(tif,module,"ASCII value for tag \"%s\" contains null byte in value; value incorrectly truncated during reading due to implementation limitations",fip->field_name);
 					else if (mb+1>(uint32)dp->tdir_count)
 					{
 						uint8* o;
-						TIFFWarningExt(tif->tif_clientdata,module,"ASCII value for tag \"%s\" does not end in null byte",fip->field_name);
+						TIFFWarningExtR(tif,module,"ASCII value for tag \"%s\" does not end in null byte",fip->field_name);
 						if ((uint32)dp->tdir_count+1!=dp->tdir_count+1)
 							o=NULL;
 						else
-							o=_TIFFmalloc((uint32)dp->tdir_count+1);
+							o=_TIFFmallocExt(tif, (uint32)dp->tdir_count+1);
 						if (o==NULL)
 						{
 							if (data!=NULL)
-								_TIFFfree(data);
+								_TIFFfreeExt(tif, data);
 							return(0);
 						}
 						_TIFFmemcpy(o,data,(uint32)dp->tdir_count);
 						o[(uint32)dp->tdir_count]=0;
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						data=o;
 					}
 					n=TIFFSetField(tif,dp->tdir_tag,data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!n)
 						return(0);
 				}
@@ -5018,7 +5582,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 				assert(fip->field_readcount==2);
 				assert(fip->field_passcount==0);
 				if (dp->tdir_count!=2) {
-					TIFFWarningExt(tif->tif_clientdata,module,
+					TIFFWarningExtR(tif,module,
 						       "incorrect count for field \"%s\", expected 2, got %d",
 						       fip->field_name,(int)dp->tdir_count);
 					return(0);
@@ -5028,7 +5592,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 				{
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,data[0],data[1]);
-					_TIFFfree(data);
+					_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5040,7 +5604,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 				assert(fip->field_readcount>=1);
 				assert(fip->field_passcount==0);
 				if (dp->tdir_count!=(uint64)fip->field_readcount) {
-					TIFFWarningExt(tif->tif_clientdata,module,
+					TIFFWarningExtR(tif,module,
 						       "incorrect count for field \"%s\", expected %d, got %d",
 						       fip->field_name,(int) fip->field_readcount, (int)dp->tdir_count);
 					return 0;
@@ -5053,7 +5617,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5075,7 +5639,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5097,7 +5661,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5119,7 +5683,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5141,12 +5705,12 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
                         if( dp->tdir_count > 0 && data[dp->tdir_count-1] != '\0' )
                         {
-                            TIFFWarningExt(tif->tif_clientdata,module,"ASCII value for tag \"%s\" does not end in null byte. Forcing it to be null",fip->field_name);
+                            TIFFWarningExtR(tif,module,"ASCII value for tag \"%s\" does not end in null byte. Forcing it to be null",fip->field_name);
                             data[dp->tdir_count-1] = '\0';
                         }
 						m=TIFFSetField(tif,dp->tdir_tag,(uint16)(dp->tdir_count),data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5168,7 +5732,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,(uint16)(dp->tdir_count),data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5190,7 +5754,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,(uint16)(dp->tdir_count),data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5212,7 +5776,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,(uint16)(dp->tdir_count),data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5234,7 +5798,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,(uint16)(dp->tdir_count),data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5256,7 +5820,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,(uint16)(dp->tdir_count),data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5278,7 +5842,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,(uint16)(dp->tdir_count),data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5300,7 +5864,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 						int m;
 						m=TIFFSetField(tif,dp->tdir_tag,(uint16)(dp->tdir_count),data);
 						if (data!=0)
-							_TIFFfree(data);
+							_TIFFfreeExt(tif, data);
 						if (!m)
 							return(0);
 					}
@@ -5318,12 +5882,12 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
                     if( dp->tdir_count > 0 && data[dp->tdir_count-1] != '\0' )
                     {
-                        TIFFWarningExt(tif->tif_clientdata,module,"ASCII value for tag \"%s\" does not end in null byte. Forcing it to be null",fip->field_name);
+                        TIFFWarningExtR(tif,module,"ASCII value for tag \"%s\" does not end in null byte. Forcing it to be null",fip->field_name);
                         data[dp->tdir_count-1] = '\0';
                     }
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5340,7 +5904,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5357,7 +5921,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5374,7 +5938,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5391,7 +5955,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5408,7 +5972,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5425,7 +5989,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5442,7 +6006,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5459,7 +6023,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5476,7 +6040,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5493,7 +6057,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5510,7 +6074,7 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 					int m;
 					m=TIFFSetField(tif,dp->tdir_tag,(uint32)(dp->tdir_count),data);
 					if (data!=0)
-						_TIFFfree(data);
+						_TIFFfreeExt(tif, data);
 					if (!m)
 						return(0);
 				}
@@ -5528,6 +6092,75 @@ TIFFFetchNormalTag(TIFF* tif, TIFFDirEntry* dp, int recover)
 	return(1);
 }
 
+/*
+ * In fast open mode ('F' flag) custom tags, which do not affect how the
+ * image data is laid out or decoded, are kept as raw directory entries
+ * and read when first accessed.  Returns 1 if the tag was deferred.
+ */
+static int
+TIFFDeferTag(TIFF* tif, TIFFDirEntry* dp, uint16 dircount)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	const TIFFField* fip;
+
+	if (!(tif->tif_flags&TIFF_DEFERTAGS))
+		return 0;
+	fip = TIFFFindField(tif, dp->tdir_tag, TIFF_ANY);
+	if (fip == NULL || fip->field_bit != FIELD_CUSTOM)
+		return 0;
+	if (td->td_deferredtags == NULL) {
+		td->td_deferredtags = (TIFFDirEntry*) _TIFFCheckMalloc(tif,
+		    dircount, sizeof(TIFFDirEntry), "for deferred tags");
+		if (td->td_deferredtags == NULL)
+			return 0;
+	}
+	td->td_deferredtags[td->td_ndeferredtags++] = *dp;
+	return 1;
+}
+
+static void
+TIFFFetchDeferredEntry(TIFF* tif, uint32 i)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFDirEntry de = td->td_deferredtags[i];
+	uint32 dirty = tif->tif_flags & TIFF_DIRTYDIRECT;
+
+	/* Drop the entry first, TIFFSetField() would look it up again */
+	td->td_ndeferredtags--;
+	memmove(td->td_deferredtags + i, td->td_deferredtags + i + 1,
+	    (td->td_ndeferredtags - i) * sizeof(TIFFDirEntry));
+	(void) TIFFFetchNormalTag(tif, &de, TRUE);
+	/* Values read from the file do not make the directory dirty */
+	tif->tif_flags = (tif->tif_flags & ~TIFF_DIRTYDIRECT) | dirty;
+}
+
+/*
+ * Read the value of a deferred tag, if any.
+ */
+void
+_TIFFFetchDeferredTag(TIFF* tif, uint32 tag)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	uint32 i;
+
+	for (i = 0; i < td->td_ndeferredtags; i++) {
+		if (td->td_deferredtags[i].tdir_tag == tag) {
+			TIFFFetchDeferredEntry(tif, i);
+			return;
+		}
+	}
+}
+
+/*
+ * Read all deferred tags, in directory order.
+ */
+void
+_TIFFFetchDeferredTags(TIFF* tif)
+{
+	while (tif->tif_dir.td_ndeferredtags)
+		TIFFFetchDeferredEntry(tif, 0);
+}
+
 /*
  * Fetch a set of offsets or lengths.
  * While this routine says "strips", in fact it's also used for tiles.
@@ -5560,18 +6193,18 @@ TIFFFetchStripThing(TIFF* tif, TIFFDirEntry* dir, uint32 nstrips, uint64** lpp)
 
 		if( nstrips > max_nstrips )
 		{
-			_TIFFfree(data);
+			_TIFFfreeExt(tif, data);
 			return(0);
 		}
 
 		resizeddata=(uint64*)_TIFFCheckMalloc(tif,nstrips,sizeof(uint64),"for strip array");
 		if (resizeddata==0) {
-			_TIFFfree(data);
+			_TIFFfreeExt(tif, data);
 			return(0);
 		}
                 _TIFFmemcpy(resizeddata,data,(uint32)dir->tdir_count*sizeof(uint64));
                 _TIFFmemset(resizeddata+(uint32)dir->tdir_count,0,(nstrips-(uint32)dir->tdir_count)*sizeof(uint64));
-		_TIFFfree(data);
+		_TIFFfreeExt(tif, data);
 		data=resizeddata;
 	}
 	*lpp=data;
@@ -5716,9 +6349,9 @@ ChopUpSingleUncompressedStrip(TIFF* tif)
 		 * the original one strip information.
 		 */
 		if (newcounts != NULL)
-			_TIFFfree(newcounts);
+			_TIFFfreeExt(tif, newcounts);
 		if (newoffsets != NULL)
-			_TIFFfree(newoffsets);
+			_TIFFfreeExt(tif, newoffsets);
 		return;
 	}
 	/*
@@ -5739,13 +6372,109 @@ ChopUpSingleUncompressedStrip(TIFF* tif)
 	td->td_stripsperimage = td->td_nstrips = nstrips;
 	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
 
-	_TIFFfree(td->td_stripbytecount);
-	_TIFFfree(td->td_stripoffset);
+	_TIFFfreeExt(tif, td->td_stripbytecount);
+	_TIFFfreeExt(tif, td->td_stripoffset);
 	td->td_stripbytecount = newcounts;
 	td->td_stripoffset = newoffsets;
 	td->td_stripbytecountsorted = 1;
 }
 
+/*
+ * Replace a single tile of uncompressed data by a column of tiles of the
+ * same width, each approximately STRIP_SIZE_DEFAULT bytes.  The new tile
+ * length divides the old one so that every tile is complete, even if it
+ * is not a multiple of 16; TileLength is changed accordingly.
+ */
+static void
+ChopUpSingleUncompressedTile(TIFF* tif)
+{
+	register TIFFDirectory *td = &tif->tif_dir;
+	uint64 bytecount;
+	uint64 offset;
+	uint64 rowbytes;
+	uint64 tilebytes;
+	uint32 tilelength;
+	uint32 tile;
+	uint32 ntiles;
+	uint64* newcounts;
+	uint64* newoffsets;
+
+	assert(td->td_planarconfig == PLANARCONFIG_CONTIG);
+	/* Subsampled YCbCr tiles hold blocks of rows */
+	if (td->td_imagedepth > 1 || td->td_tiledepth > 1 ||
+	    (td->td_photometric == PHOTOMETRIC_YCBCR && !isUpSampled(tif)))
+		return;
+	bytecount = td->td_stripbytecount[0];
+	offset = td->td_stripoffset[0];
+	rowbytes = TIFFTileRowSize64(tif);
+	if (rowbytes == 0 || td->td_tilelength == 0)
+		return;
+	if (rowbytes >= STRIP_SIZE_DEFAULT)
+		tilelength = 1;
+	else
+		tilelength = (uint32) (STRIP_SIZE_DEFAULT / rowbytes);
+	if (tilelength >= td->td_tilelength)
+		return;
+	while (td->td_tilelength % tilelength != 0)
+		tilelength--;
+	tilebytes = rowbytes * tilelength;
+	ntiles = TIFFhowmany_32(td->td_imagelength, tilelength);
+	if (ntiles <= 1)
+		return;
+	/* Leave truncated data alone, the tiles would be short */
+	if (bytecount / tilebytes < ntiles)
+		return;
+
+	/* As for strips, make sure that the file is as big as needed */
+	if (ntiles > 1000000 &&
+	    (offset >= TIFFGetFileSize(tif) ||
+	     tilebytes > (TIFFGetFileSize(tif) - offset) / (ntiles - 1)))
+		return;
+
+	newcounts = (uint64*) _TIFFCheckMalloc(tif, ntiles, sizeof (uint64),
+				"for chopped \"TileByteCounts\" array");
+	newoffsets = (uint64*) _TIFFCheckMalloc(tif, ntiles, sizeof (uint64),
+				"for chopped \"TileOffsets\" array");
+	if (newcounts == NULL || newoffsets == NULL) {
+		if (newcounts != NULL)
+			_TIFFfreeExt(tif, newcounts);
+		if (newoffsets != NULL)
+			_TIFFfreeExt(tif, newoffsets);
+		return;
+	}
+	for (tile = 0; tile < ntiles; tile++) {
+		newcounts[tile] = tilebytes;
+		newoffsets[tile] = offset;
+		offset += tilebytes;
+	}
+	td->td_tilelength = tilelength;
+	td->td_stripsperimage = td->td_nstrips = ntiles;
+
+	_TIFFfreeExt(tif, td->td_stripbytecount);
+	_TIFFfreeExt(tif, td->td_stripoffset);
+	td->td_stripbytecount = newcounts;
+	td->td_stripoffset = newoffsets;
+	td->td_stripbytecountsorted = 1;
+}
+
+/*
+ * Codecs whose row decoding consumes the raw data incrementally, so that
+ * TIFFReadScanline() can feed them a strip a few rows at a time.
+ */
+static int
+IsChunkyReadCompression(uint16 compression)
+{
+	switch (compression) {
+	case COMPRESSION_LZW:
+	case COMPRESSION_ADOBE_DEFLATE:
+	case COMPRESSION_DEFLATE:
+	case COMPRESSION_PACKBITS:
+		return (1);
+	default:
+		return (0);
+	}
+}
+
 int _TIFFFillStriles( TIFF *tif )
 {
     return _TIFFFillStrilesInternal( tif, 1 );
@@ -5753,16 +6482,21 @@ int _TIFFFillStriles( TIFF *tif )
 
 static int _TIFFFillStrilesInternal( TIFF *tif, int loadStripByteCount )
 {
-#if defined(DEFER_STRILE_LOAD)
         register TIFFDirectory *td = &tif->tif_dir;
         int return_value = 1;
 
+        if( !isDeferredStriles(tif) )
+                return 1;
+
         if( td->td_stripoffset != NULL )
                 return 1;
 
         if( td->td_stripoffset_entry.tdir_count == 0 )
                 return 0;
 
+        /* The whole arrays supersede the pieces loaded so far */
+        _TIFFFreeStrilePages(tif);
+
         if (!TIFFFetchStripThing(tif,&(td->td_stripoffset_entry),
                                  td->td_nstrips,&td->td_stripoffset))
         {
@@ -5793,13 +6527,309 @@ static int _TIFFFillStrilesInternal( TIFF *tif, int loadStripByteCount )
 	}
 
         return return_value;
-#else /* !defined(DEFER_STRILE_LOAD) */
-        (void) tif;
-        (void) loadStripByteCount;
+}
+
+/*
+ * Return non-zero if the offsets and byte counts of the strips/tiles
+ * of the current directory are available, loading them if needed
+ * unless they can be loaded piecewise on demand.
+ */
+int _TIFFHaveStriles( TIFF *tif )
+{
+        TIFFDirectory *td = &tif->tif_dir;
+
+        if( (tif->tif_flags&TIFF_LAZYSTRILELOAD) && td->td_stripoffset == NULL &&
+            td->td_stripoffset_entry.tdir_count != 0 &&
+            td->td_stripbytecount_entry.tdir_count != 0 )
+                return 1;
+        return _TIFFFillStriles(tif) && td->td_stripoffset != NULL &&
+            td->td_stripbytecount != NULL;
+}
+
+/*
+ * On demand loading reads the arrays in pages of this many entries.
+ * Pages of SHORT and LONG arrays, as found in ClassicTIFF files, hold
+ * uint32 values and those of LONG8 arrays uint64 values; the values
+ * are widened to uint64 when returned.  The arrays of a memory mapped
+ * file are not copied at all: values are read from the mapping.
+ */
+#define STRILE_PAGE_SIZE 1024
+
+#define TIFFStrileTypeSize(dp) \
+        ((dp)->tdir_type == TIFF_SHORT ? 2U : \
+         (dp)->tdir_type == TIFF_LONG ? 4U : \
+         (dp)->tdir_type == TIFF_LONG8 ? 8U : 0U)
+#define TIFFStrilePageWidth(dp) ((dp)->tdir_type == TIFF_LONG8 ? 8U : 4U)
+
+void _TIFFFreeStrilePages( TIFF *tif )
+{
+        TIFFDirectory *td = &tif->tif_dir;
+        uint32 i;
+
+        for (i = 0; i < td->td_stripnpages; i++)
+        {
+                if (td->td_stripoffsetpages[i])
+                        _TIFFfreeExt(tif, td->td_stripoffsetpages[i]);
+                if (td->td_stripbytecountpages[i])
+                        _TIFFfreeExt(tif, td->td_stripbytecountpages[i]);
+        }
+        if (td->td_stripoffsetpages)
+                _TIFFfreeExt(tif, td->td_stripoffsetpages);
+        if (td->td_stripbytecountpages)
+                _TIFFfreeExt(tif, td->td_stripbytecountpages);
+        td->td_stripoffsetpages = NULL;
+        td->td_stripbytecountpages = NULL;
+        td->td_stripnpages = 0;
+}
+
+/*
+ * Return the file offset of the values of a StripOffsets or
+ * StripByteCounts entry, or 0 if the array cannot be read piecewise,
+ * in which case the whole arrays have to be loaded.
+ */
+static uint64
+TIFFStrileArrayOffset(TIFF* tif, TIFFDirEntry* dp)
+{
+        TIFFDirectory *td = &tif->tif_dir;
+        uint32 typesize = TIFFStrileTypeSize(dp);
+        uint64 offset;
+
+        /* Short arrays and arrays stored within the entry are rare and small */
+        if (typesize == 0 || dp->tdir_count < (uint64)td->td_nstrips ||
+            dp->tdir_count * typesize <= ((tif->tif_flags&TIFF_BIGTIFF) ? 8U : 4U))
+                return 0;
+        if (!(tif->tif_flags&TIFF_BIGTIFF))
+        {
+                uint32 offset32 = dp->tdir_offset.toff_long;
+                if (tif->tif_flags&TIFF_SWAB)
+                        TIFFSwabLong(&offset32);
+                offset = offset32;
+        }
+        else
+        {
+                offset = dp->tdir_offset.toff_long8;
+                if (tif->tif_flags&TIFF_SWAB)
+                        TIFFSwabLong8(&offset);
+        }
+        return offset;
+}
+
+/*
+ * Decode the value at raw of a StripOffsets or StripByteCounts array.
+ */
+static uint64
+TIFFStrileRawValue(TIFF* tif, const uint8* raw, uint32 typesize)
+{
+        switch (typesize)
+        {
+                case 2:
+                {
+                        uint16 v;
+                        _TIFFmemcpy(&v, raw, 2);
+                        if (tif->tif_flags&TIFF_SWAB)
+                                TIFFSwabShort(&v);
+                        return v;
+                }
+                case 4:
+                {
+                        uint32 v;
+                        _TIFFmemcpy(&v, raw, 4);
+                        if (tif->tif_flags&TIFF_SWAB)
+                                TIFFSwabLong(&v);
+                        return v;
+                }
+                default:
+                {
+                        uint64 v;
+                        _TIFFmemcpy(&v, raw, 8);
+                        if (tif->tif_flags&TIFF_SWAB)
+                                TIFFSwabLong8(&v);
+                        return v;
+                }
+        }
+}
+
+/*
+ * Read entry strile of a StripOffsets or StripByteCounts array from
+ * the mapping of the file.  Returns 0 if the array is not within the
+ * mapping.
+ */
+static int
+TIFFGetStrileFromMap(TIFF* tif, TIFFDirEntry* dp, uint32 strile, uint64* value)
+{
+        uint32 typesize = TIFFStrileTypeSize(dp);
+        uint64 offset = TIFFStrileArrayOffset(tif, dp);
+        uint64 size = (uint64)tif->tif_dir.td_nstrips * typesize;
+
+        if (offset == 0 || offset > (uint64)tif->tif_size ||
+            size > (uint64)tif->tif_size - offset)
+                return 0;
+        *value = TIFFStrileRawValue(tif, tif->tif_base + offset +
+                                    (uint64)strile * typesize, typesize);
         return 1;
-#endif 
 }
 
+/*
+ * Read the page of a StripOffsets or StripByteCounts array that holds
+ * entry strile.  Returns 0 if the entry cannot be read piecewise, in
+ * which case the whole arrays have to be loaded.
+ */
+static int
+TIFFFetchStrilePage(TIFF* tif, TIFFDirEntry* dp, uint32 page, void** ppage)
+{
+        static const char module[] = "TIFFFetchStrilePage";
+        TIFFDirectory *td = &tif->tif_dir;
+        uint32 first = page * STRILE_PAGE_SIZE;
+        uint32 n = td->td_nstrips - first;
+        uint32 typesize = TIFFStrileTypeSize(dp);
+        uint32 width = TIFFStrilePageWidth(dp);
+        uint32 i;
+        uint64 offset = TIFFStrileArrayOffset(tif, dp);
+        uint8* values;
+        uint8* raw;
+        enum TIFFReadDirEntryErr err;
+
+        if (offset == 0)
+                return 0;
+        if (n > STRILE_PAGE_SIZE)
+                n = STRILE_PAGE_SIZE;
+        values = (uint8*) _TIFFCheckMalloc(tif, n, width,
+                                           "for strip array page");
+        if (values == NULL)
+                return 0;
+        /* Read into the tail of the page, then widen in place */
+        raw = values + n * (width - typesize);
+        err = TIFFReadDirEntryData(tif, offset + (uint64)first * typesize,
+                                   (tmsize_t)n * typesize, raw);
+        if (err != TIFFReadDirEntryErrOk)
+        {
+                const TIFFField* fip = TIFFFieldWithTag(tif,dp->tdir_tag);
+                TIFFReadDirEntryOutputErr(tif,err,module,
+                                          fip ? fip->field_name : "unknown tagname",0);
+                _TIFFfreeExt(tif, values);
+                return 0;
+        }
+        for (i = 0; i < n; i++)
+        {
+                uint64 v = TIFFStrileRawValue(tif, raw + i * typesize, typesize);
+                if (width == 4)
+                        ((uint32*)values)[i] = (uint32)v;
+                else
+                        ((uint64*)values)[i] = v;
+        }
+        *ppage = values;
+        return 1;
+}
+
+static uint64
+_TIFFGetStrileValue(TIFF* tif, uint32 strile, int bytecounts, int* pbErr)
+{
+        static const char module[] = "TIFFGetStrileValue";
+        TIFFDirectory *td = &tif->tif_dir;
+        TIFFDirEntry* dp;
+        void** pages;
+        uint32 page;
+        uint64 value;
+
+        if (pbErr)
+                *pbErr = 0;
+        if (strile >= td->td_nstrips)
+        {
+                if (pbErr)
+                        *pbErr = 1;
+                return 0;
+        }
+        if (td->td_strilewindow != NULL)
+        {
+                if (!_TIFFHoldStrile(tif, strile, 0))
+                {
+                        if (pbErr)
+                                *pbErr = 1;
+                        return 0;
+                }
+                return bytecounts ?
+                    td->td_stripbytecount[TIFFStrileIndex(tif, strile)] :
+                    td->td_stripoffset[TIFFStrileIndex(tif, strile)];
+        }
+        if (td->td_stripoffset == NULL && (tif->tif_flags&TIFF_LAZYSTRILELOAD) &&
+            td->td_stripoffset_entry.tdir_count != 0 &&
+            td->td_stripbytecount_entry.tdir_count != 0)
+        {
+                dp = bytecounts ? &td->td_stripbytecount_entry :
+                                  &td->td_stripoffset_entry;
+                if (isMapped(tif) && TIFFGetStrileFromMap(tif, dp, strile, &value))
+                        return value;
+                if (td->td_stripnpages == 0)
+                {
+                        uint32 npages = TIFFhowmany_32(td->td_nstrips, STRILE_PAGE_SIZE);
+
+                        td->td_stripoffsetpages = (void**)
+                            _TIFFcallocExt(tif, npages, sizeof(void*));
+                        td->td_stripbytecountpages = (void**)
+                            _TIFFcallocExt(tif, npages, sizeof(void*));
+                        if (td->td_stripoffsetpages == NULL ||
+                            td->td_stripbytecountpages == NULL)
+                        {
+                                TIFFErrorExtR(tif, module,
+                                             "No space for strip array page table");
+                                _TIFFFreeStrilePages(tif);
+                                if (pbErr)
+                                        *pbErr = 1;
+                                return 0;
+                        }
+                        td->td_stripnpages = npages;
+                }
+                pages = bytecounts ? td->td_stripbytecountpages :
+                                     td->td_stripoffsetpages;
+                page = strile / STRILE_PAGE_SIZE;
+                if (pages[page] != NULL ||
+                    TIFFFetchStrilePage(tif, dp, page, &pages[page]))
+                {
+                        if (TIFFStrilePageWidth(dp) == 4)
+                                return ((uint32*)pages[page])[strile % STRILE_PAGE_SIZE];
+                        return ((uint64*)pages[page])[strile % STRILE_PAGE_SIZE];
+                }
+                /* Fall back to loading the whole arrays */
+        }
+        if (!_TIFFFillStriles(tif) ||
+            (bytecounts ? td->td_stripbytecount : td->td_stripoffset) == NULL)
+        {
+                if (pbErr)
+                        *pbErr = 1;
+                return 0;
+        }
+        return bytecounts ? td->td_stripbytecount[strile] :
+                            td->td_stripoffset[strile];
+}
+
+/*
+ * Return the file offset and byte count of a strip or tile, loading
+ * only the needed part of the arrays in on demand mode.  0 is returned
+ * on error, which is signalled through *pbErr in the WithErr variants.
+ */
+uint64
+TIFFGetStrileOffsetWithErr(TIFF* tif, uint32 strile, int* pbErr)
+{
+        return _TIFFGetStrileValue(tif, strile, 0, pbErr);
+}
+
+uint64
+TIFFGetStrileByteCountWithErr(TIFF* tif, uint32 strile, int* pbErr)
+{
+        return _TIFFGetStrileValue(tif, strile, 1, pbErr);
+}
+
+uint64
+TIFFGetStrileOffset(TIFF* tif, uint32 strile)
+{
+        return _TIFFGetStrileValue(tif, strile, 0, NULL);
+}
+
+uint64
+TIFFGetStrileByteCount(TIFF* tif, uint32 strile)
+{
+        return _TIFFGetStrileValue(tif, strile, 1, NULL);
+}
 
 /* vim: set ts=8 sts=8 sw=8 noet: */
 /*
@@ -38,7 +38,8 @@ extern void TIFFCvtNativeToIEEEFloat(TIFF* tif, uint32 n, float* fp);
 extern void TIFFCvtNativeToIEEEDouble(TIFF* tif, uint32 n, double* dp);
 #endif
 
-static int TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff);
+static int TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff, int inplace);
+static int TIFFWriteDirectorySec1(TIFF* tif, int isimage, int imagedone, uint64* pdiroff, int inplace);
 
 static int TIFFWriteDirectoryTagSampleformatArray(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, uint16 tag, uint32 count, double* value);
 #if 0
@@ -167,8 +168,13 @@ static int TIFFWriteDirectoryTagCheckedIfdArray(TIFF* tif, uint32* ndir, TIFFDir
 static int TIFFWriteDirectoryTagCheckedIfd8Array(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, uint16 tag, uint32 count, uint64* value);
 
 static int TIFFWriteDirectoryTagData(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, uint16 tag, uint16 datatype, uint32 count, uint32 datalength, void* data);
+static int TIFFWriteDirectoryTagStrileArray(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, uint16 tag, int bytecounts);
+static int TIFFWriteDirectoryBlock(TIFF* tif, uint64 off, const void* data, uint32 size);
+static int TIFFWriteDirectoryInPlace(TIFF* tif, TIFFDirEntry* dir, uint32 ndir, const uint8* dirmem);
 
 static int TIFFLinkDirectory(TIFF*);
+static int TIFFUnlinkCurrentDirectory(TIFF*);
+static int TIFFSetAsideDirectorySpace(TIFF*, uint64, const char*);
 
 /*
  * Write the contents of the current directory
@@ -179,7 +185,7 @@ static int TIFFLinkDirectory(TIFF*);
 int
 TIFFWriteDirectory(TIFF* tif)
 {
-	return TIFFWriteDirectorySec(tif,TRUE,TRUE,NULL);
+	return TIFFWriteDirectorySec(tif,TRUE,TRUE,NULL,FALSE);
 }
 
 /*
@@ -195,37 +201,177 @@ TIFFCheckpointDirectory(TIFF* tif)
 	/* Setup the strips arrays, if they haven't already been. */
 	if (tif->tif_dir.td_stripoffset == NULL)
 	    (void) TIFFSetupStrips(tif);
-	rc = TIFFWriteDirectorySec(tif,TRUE,FALSE,NULL);
+	rc = TIFFWriteDirectorySec(tif,TRUE,FALSE,NULL,FALSE);
 	(void) TIFFSetWriteOffset(tif, TIFFSeekFile(tif, 0, SEEK_END));
 	return rc;
 }
 
+/*
+ * Write the current directory ahead of its image data, with strip or
+ * tile arrays that have room for all of it but are zero, and setup to
+ * create a new subfile like TIFFWriteDirectory().  The data is written
+ * later, after selecting the directory again with TIFFSetDirectory();
+ * the arrays are then updated in place by TIFFFlush() or TIFFClose().
+ * Reserving every directory before writing any data gives the layout
+ * of cloud optimized files: header, directories and their arrays
+ * first, then the image data in the order it is written.
+ */
+int
+TIFFReserveDirectory(TIFF* tif)
+{
+	static const char module[] = "TIFFReserveDirectory";
+
+	if (tif->tif_diroff != 0) {
+		TIFFErrorExtR(tif, module,
+		    "Directory has already been written");
+		return (0);
+	}
+	if (!TIFFWriteCheck(tif, isTiled(tif), module))
+		return (0);
+	/*
+	 * Have the codec add the fields it derives from the image
+	 * parameters, such as JPEGTables, now rather than when the data
+	 * is written, which would move the directory to the end of the
+	 * file.
+	 */
+	if ((tif->tif_flags & TIFF_CODERSETUP) == 0) {
+		if (!(*tif->tif_setupencode)(tif))
+			return (0);
+		tif->tif_flags |= TIFF_CODERSETUP;
+	}
+	/* The arrays are updated in place later */
+	_TIFFSequentialHold(tif);
+	return TIFFWriteDirectorySec(tif,TRUE,TRUE,NULL,FALSE);
+}
+
+/*
+ * Set aside size bytes at the end of the file for the current
+ * directory, its entries and all their out-of-line data.  Whenever the
+ * directory is written afterwards, by TIFFCheckpointDirectory(),
+ * TIFFRewriteDirectory(), TIFFWriteDirectory() or TIFFFlush(), it is
+ * put there again as long as it fits, instead of at the end of the
+ * file.  A directory that outgrows the space is moved to a new space
+ * of twice the size at the end of the file.
+ */
+int
+TIFFReserveDirectorySpace(TIFF* tif, tmsize_t size)
+{
+	static const char module[] = "TIFFReserveDirectorySpace";
+
+	if (tif->tif_mode == O_RDONLY) {
+		TIFFErrorExtR(tif, module,
+		    "File not open for writing");
+		return (0);
+	}
+	if (tif->tif_diroff != 0) {
+		TIFFErrorExtR(tif, module,
+		    "Directory has already been written");
+		return (0);
+	}
+	if (tif->tif_flags & TIFF_INSUBIFD) {
+		TIFFErrorExtR(tif, module,
+		    "Can not reserve space for a SubIFD");
+		return (0);
+	}
+	/*
+	 * A strip or tile in progress continues at the current write
+	 * offset, which would then be inside the reserved space.
+	 */
+	if (tif->tif_flags & TIFF_BEENWRITING) {
+		TIFFErrorExtR(tif, module,
+		    "Directory space must be reserved before writing image data");
+		return (0);
+	}
+	if (size < ((tif->tif_flags&TIFF_BIGTIFF) ? 16 : 6)) {
+		TIFFErrorExtR(tif, module,
+		    "%ld bytes is too small for a directory", (long) size);
+		return (0);
+	}
+	return TIFFSetAsideDirectorySpace(tif, (uint64) size, module);
+}
+
+static int
+TIFFSetAsideDirectorySpace(TIFF* tif, uint64 size, const char* module)
+{
+	uint8 zeros[512];
+	uint64 off, end;
+	tmsize_t n;
+
+	off = (TIFFSeekFile(tif, 0, SEEK_END) + 1) & (~((toff_t)1));
+	end = off + size;
+	if (!(tif->tif_flags&TIFF_BIGTIFF) && end > 0xFFFFFFFFU) {
+		TIFFErrorExtR(tif, module,
+		    "Maximum TIFF file size exceeded");
+		return (0);
+	}
+	if (!SeekOK(tif, off)) {
+		TIFFErrorExtR(tif, module,
+		    "IO error reserving directory space");
+		return (0);
+	}
+	_TIFFmemset(zeros, 0, sizeof(zeros));
+	while (size > 0) {
+		n = size < sizeof(zeros) ? (tmsize_t) size :
+		    (tmsize_t) sizeof(zeros);
+		if (!WriteOK(tif, zeros, n)) {
+			TIFFErrorExtR(tif, module,
+			    "IO error reserving directory space");
+			return (0);
+		}
+		size -= (uint64) n;
+	}
+	tif->tif_dirreserveoff = off;
+	tif->tif_dirreservesize = end - off;
+	return (1);
+}
+
 int
 TIFFWriteCustomDirectory(TIFF* tif, uint64* pdiroff)
 {
-	return TIFFWriteDirectorySec(tif,FALSE,FALSE,pdiroff);
+	return TIFFWriteDirectorySec(tif,FALSE,FALSE,pdiroff,FALSE);
 }
 
 /*
  * Similar to TIFFWriteDirectory(), but if the directory has already
  * been written once, it is relocated to the end of the file, in case it
  * has changed in size.  Note that this will result in the loss of the
- * previously used directory space. 
+ * previously used directory space, unless it was set aside with
+ * TIFFReserveDirectorySpace(): the directory is then rewritten there.
  */ 
 int
 TIFFRewriteDirectory( TIFF *tif )
 {
-	static const char module[] = "TIFFRewriteDirectory";
-
 	/* We don't need to do anything special if it hasn't been written. */
-	if( tif->tif_diroff == 0 )
+	if( tif->tif_diroff == 0 || isDirReserved(tif) )
 		return TIFFWriteDirectory( tif );
 
+	/* Update the directory where it is if the new values fit there */
+	if( (tif->tif_flags & TIFF_INPLACEUPDATE) && !TIFFFieldSet(tif, FIELD_SUBIFD) )
+		return TIFFWriteDirectorySec(tif,TRUE,TRUE,NULL,TRUE);
+
+	if (!TIFFUnlinkCurrentDirectory(tif))
+		return (0);
+
 	/*
-	 * Find and zero the pointer to this directory, so that TIFFLinkDirectory
-	 * will cause it to be added after this directories current pre-link.
+	 * Now use TIFFWriteDirectory() normally.
 	 */
 
+	return TIFFWriteDirectory( tif );
+}
+
+/*
+ * Find and zero the pointer to the current directory, so that
+ * TIFFLinkDirectory will cause it to be added after this directories
+ * current pre-link.
+ */
+static int
+TIFFUnlinkCurrentDirectory(TIFF* tif)
+{
+	static const char module[] = "TIFFUnlinkCurrentDirectory";
+
+	/* The chain may end elsewhere now */
+	tif->tif_lastdiroff = 0;
+	_TIFFResetDirIndex(tif);
 	if (!(tif->tif_flags&TIFF_BIGTIFF))
 	{
 		if (tif->tif_header.classic.tiff_diroff == tif->tif_diroff)
@@ -236,7 +382,7 @@ TIFFRewriteDirectory( TIFF *tif )
 			TIFFSeekFile(tif,4,SEEK_SET);
 			if (!WriteOK(tif, &(tif->tif_header.classic.tiff_diroff),4))
 			{
-				TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+				TIFFErrorExtR(tif, tif->tif_name,
 				    "Error updating TIFF header");
 				return (0);
 			}
@@ -251,7 +397,7 @@ TIFFRewriteDirectory( TIFF *tif )
 
 				if (!SeekOK(tif, nextdir) ||
 				    !ReadOK(tif, &dircount, 2)) {
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					     "Error fetching directory count");
 					return (0);
 				}
@@ -260,7 +406,7 @@ TIFFRewriteDirectory( TIFF *tif )
 				(void) TIFFSeekFile(tif,
 				    nextdir+2+dircount*12, SEEK_SET);
 				if (!ReadOK(tif, &nextnextdir, 4)) {
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					     "Error fetching directory link");
 					return (0);
 				}
@@ -273,7 +419,7 @@ TIFFRewriteDirectory( TIFF *tif )
 					(void) TIFFSeekFile(tif,
 					    nextdir+2+dircount*12, SEEK_SET);
 					if (!WriteOK(tif, &m, 4)) {
-						TIFFErrorExt(tif->tif_clientdata, module,
+						TIFFErrorExtR(tif, module,
 						     "Error writing directory link");
 						return (0);
 					}
@@ -294,7 +440,7 @@ TIFFRewriteDirectory( TIFF *tif )
 			TIFFSeekFile(tif,8,SEEK_SET);
 			if (!WriteOK(tif, &(tif->tif_header.big.tiff_diroff),8))
 			{
-				TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+				TIFFErrorExtR(tif, tif->tif_name,
 				    "Error updating TIFF header");
 				return (0);
 			}
@@ -310,7 +456,7 @@ TIFFRewriteDirectory( TIFF *tif )
 
 				if (!SeekOK(tif, nextdir) ||
 				    !ReadOK(tif, &dircount64, 8)) {
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					     "Error fetching directory count");
 					return (0);
 				}
@@ -318,7 +464,7 @@ TIFFRewriteDirectory( TIFF *tif )
 					TIFFSwabLong8(&dircount64);
 				if (dircount64>0xFFFF)
 				{
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					     "Sanity check on tag count failed, likely corrupt TIFF");
 					return (0);
 				}
@@ -326,7 +472,7 @@ TIFFRewriteDirectory( TIFF *tif )
 				(void) TIFFSeekFile(tif,
 				    nextdir+8+dircount*20, SEEK_SET);
 				if (!ReadOK(tif, &nextnextdir, 8)) {
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					     "Error fetching directory link");
 					return (0);
 				}
@@ -339,7 +485,7 @@ TIFFRewriteDirectory( TIFF *tif )
 					(void) TIFFSeekFile(tif,
 					    nextdir+8+dircount*20, SEEK_SET);
 					if (!WriteOK(tif, &m, 8)) {
-						TIFFErrorExt(tif->tif_clientdata, module,
+						TIFFErrorExtR(tif, module,
 						     "Error writing directory link");
 						return (0);
 					}
@@ -350,16 +496,28 @@ TIFFRewriteDirectory( TIFF *tif )
 			}
 		}
 	}
+	return (1);
+}
 
-	/*
-	 * Now use TIFFWriteDirectory() normally.
-	 */
+static int
+TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff,
+    int inplace)
+{
+	int ret;
 
-	return TIFFWriteDirectory( tif );
+	if (tif->tif_traceproc == NULL)
+		return (TIFFWriteDirectorySec1(tif, isimage, imagedone, pdiroff,
+		    inplace));
+	_TIFFTrace(tif, TIFF_TRACE_WRITEDIR, TIFF_TRACE_BEGIN, 0, 0);
+	ret = TIFFWriteDirectorySec1(tif, isimage, imagedone, pdiroff, inplace);
+	_TIFFTrace(tif, TIFF_TRACE_WRITEDIR,
+	    ret ? TIFF_TRACE_END : TIFF_TRACE_FAIL, 0, 0);
+	return (ret);
 }
 
 static int
-TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
+TIFFWriteDirectorySec1(TIFF* tif, int isimage, int imagedone, uint64* pdiroff,
+    int inplace)
 {
 	static const char module[] = "TIFFWriteDirectorySec";
 	uint32 ndir;
@@ -367,8 +525,18 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 	uint32 dirsize;
 	void* dirmem;
 	uint32 m;
+	uint64 reservesize;
 	if (tif->tif_mode == O_RDONLY)
 		return (1);
+	/* Scanlines held for an incomplete row of tiles go first */
+	if ((isimage)&&(!_TIFFFlushTileRows(tif)))
+		return (0);
+	if ((isimage)&&(tif->tif_flags&TIFF_CHUNKSTATS)&&(!_TIFFChunkStatsFlush(tif)))
+		return (0);
+	if ((isimage)&&(tif->tif_chunkchecksums)&&(!_TIFFChunkCRCFlush(tif)))
+		return (0);
+	/* The images may change; the directory index is kept up to date */
+	_TIFFResetOverviewIndex(tif);
 
         _TIFFFillStriles( tif );
         
@@ -384,7 +552,7 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 			tif->tif_flags &= ~TIFF_POSTENCODE;
 			if (!(*tif->tif_postencode)(tif))
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,
+				TIFFErrorExtR(tif,module,
 				    "Error post-encoding before directory write");
 				return (0);
 			}
@@ -402,14 +570,14 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 		{
 		    if( !TIFFFlushData1(tif) )
                     {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Error flushing data before directory write");
 			return (0);
                     }
 		}
 		if ((tif->tif_flags & TIFF_MYBUFFER) && tif->tif_rawdata)
 		{
-			_TIFFfree(tif->tif_rawdata);
+			_TIFFfreeExt(tif, tif->tif_rawdata);
 			tif->tif_rawdata = NULL;
 			tif->tif_rawcc = 0;
 			tif->tif_rawdatasize = 0;
@@ -418,6 +586,17 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 		}
 		tif->tif_flags &= ~(TIFF_BEENWRITING|TIFF_BUFFERSETUP);
 	}
+	/* Switch a growing ClassicTIFF file to BigTIFF, see tif_promote.c */
+	if (!_TIFFPromoteDirectories(tif,module))
+		return (0);
+retry:
+	/*
+	 * A directory with reserved space is linked there when written
+	 * first, and overwritten there afterwards.
+	 */
+	reservesize=0;
+	if ((isimage)&&((tif->tif_diroff==0)||(tif->tif_diroff==tif->tif_dirreserveoff)))
+		reservesize=tif->tif_dirreservesize;
 	dir=NULL;
 	dirmem=NULL;
 	dirsize=0;
@@ -524,7 +703,13 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 				if (!TIFFWriteDirectoryTagShortArray(tif,&ndir,dir,TIFFTAG_PAGENUMBER,2,&tif->tif_dir.td_pagenumber[0]))
 					goto bad;
 			}
-			if (TIFFFieldSet(tif,FIELD_STRIPBYTECOUNTS))
+			if (TIFFFieldSet(tif,FIELD_STRIPBYTECOUNTS) &&
+			    tif->tif_dir.td_strilewindow!=NULL)
+			{
+				if (!TIFFWriteDirectoryTagStrileArray(tif,&ndir,dir,isTiled(tif)?TIFFTAG_TILEBYTECOUNTS:TIFFTAG_STRIPBYTECOUNTS,1))
+					goto bad;
+			}
+			else if (TIFFFieldSet(tif,FIELD_STRIPBYTECOUNTS))
 			{
 				if (!isTiled(tif))
 				{
@@ -537,7 +722,13 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 						goto bad;
 				}
 			}
-			if (TIFFFieldSet(tif,FIELD_STRIPOFFSETS))
+			if (TIFFFieldSet(tif,FIELD_STRIPOFFSETS) &&
+			    tif->tif_dir.td_strilewindow!=NULL)
+			{
+				if (!TIFFWriteDirectoryTagStrileArray(tif,&ndir,dir,isTiled(tif)?TIFFTAG_TILEOFFSETS:TIFFTAG_STRIPOFFSETS,0))
+					goto bad;
+			}
+			else if (TIFFFieldSet(tif,FIELD_STRIPOFFSETS))
 			{
 				if (!isTiled(tif))
 				{
@@ -779,10 +970,10 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 		}
 		if (dir!=NULL)
 			break;
-		dir=_TIFFmalloc(ndir*sizeof(TIFFDirEntry));
+		dir=_TIFFmallocExt(tif, ndir*sizeof(TIFFDirEntry));
 		if (dir==NULL)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+			TIFFErrorExtR(tif,module,"Out of memory");
 			goto bad;
 		}
 		if (isimage)
@@ -803,13 +994,19 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 			tif->tif_dataoff=(uint32)tif->tif_dataoff;
 		if ((tif->tif_dataoff<tif->tif_diroff)||(tif->tif_dataoff<(uint64)dirsize))
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Maximum TIFF file size exceeded");
+			TIFFErrorExtR(tif,module,"Maximum TIFF file size exceeded");
 			goto bad;
 		}
 		if (tif->tif_dataoff&1)
 			tif->tif_dataoff++;
+		tif->tif_dataend=tif->tif_diroff+dirsize;
 		if (isimage)
 			tif->tif_curdir++;
+		if ((reservesize!=0)&&(tif->tif_dataoff>tif->tif_dirreserveoff+tif->tif_dirreservesize))
+		{
+			tif->tif_dirreservesize=0;
+			goto bad;
+		}
 	}
 	if (isimage)
 	{
@@ -821,7 +1018,7 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 			{
 				if( na == ndir )
                                 {
-                                    TIFFErrorExt(tif->tif_clientdata,module,
+                                    TIFFErrorExtR(tif,module,
                                                  "Cannot find SubIFD tag");
                                     goto bad;
                                 }
@@ -834,10 +1031,10 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 				tif->tif_subifdoff=tif->tif_diroff+8+na*20+12;
 		}
 	}
-	dirmem=_TIFFmalloc(dirsize);
+	dirmem=_TIFFmallocExt(tif, dirsize);
 	if (dirmem==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		goto bad;
 	}
 	if (!(tif->tif_flags&TIFF_BIGTIFF))
@@ -909,21 +1106,100 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 		if (tif->tif_flags&TIFF_SWAB)
 			TIFFSwabLong8((uint64*)n);
 	}
-	_TIFFfree(dir);
-	dir=NULL;
-	if (!SeekOK(tif,tif->tif_diroff))
+	if (inplace)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"IO error writing directory");
-		goto bad;
+		int n=TIFFWriteDirectoryInPlace(tif,dir,ndir,(uint8*)dirmem);
+		if (n==0)
+			goto bad;
+		if (n<0)
+		{
+			/*
+			 * Does not fit: move the directory and the data prepared
+			 * for it in the directory block to the end of the file.
+			 * The values cannot be encoded again as some of the
+			 * arrays have been swabbed in place.
+			 */
+			uint64 olddiroff=tif->tif_diroff;
+			uint64 delta;
+			if (!TIFFUnlinkCurrentDirectory(tif)||!TIFFLinkDirectory(tif))
+				goto bad;
+			delta=tif->tif_diroff-olddiroff;
+			if (!(tif->tif_flags&TIFF_BIGTIFF)&&
+			    (tif->tif_dataend+delta>0xFFFFFFFFU))
+			{
+				TIFFErrorExtR(tif,module,"Maximum TIFF file size exceeded");
+				goto bad;
+			}
+			for (m=0; m<ndir; m++)
+			{
+				if (dir[m].tdir_count*(uint64)TIFFDataWidth((TIFFDataType)dir[m].tdir_type)<=
+				    (uint64)((tif->tif_flags&TIFF_BIGTIFF)?8:4))
+					continue;
+				if (!(tif->tif_flags&TIFF_BIGTIFF))
+				{
+					uint32 na;
+					_TIFFmemcpy(&na,&dir[m].tdir_offset,4);
+					if (tif->tif_flags&TIFF_SWAB)
+						TIFFSwabLong(&na);
+					na+=(uint32)delta;
+					if (tif->tif_flags&TIFF_SWAB)
+						TIFFSwabLong(&na);
+					_TIFFmemcpy((uint8*)dirmem+2+m*12+8,&na,4);
+				}
+				else
+				{
+					uint64 na=dir[m].tdir_offset.toff_long8;
+					if (tif->tif_flags&TIFF_SWAB)
+						TIFFSwabLong8(&na);
+					na+=delta;
+					if (tif->tif_flags&TIFF_SWAB)
+						TIFFSwabLong8(&na);
+					_TIFFmemcpy((uint8*)dirmem+8+m*20+12,&na,8);
+				}
+			}
+			tif->tif_dataoff+=delta;
+			tif->tif_dataend+=delta;
+			inplace=0;
+		}
 	}
-	if (!WriteOK(tif,dirmem,(tmsize_t)dirsize))
+	_TIFFfreeExt(tif, dir);
+	dir=NULL;
+	if (!inplace)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"IO error writing directory");
-		goto bad;
+		/*
+		 * The tag data have been stored after the room left for the
+		 * directory, which is written along with them in one go.
+		 */
+		if (!TIFFWriteDirectoryBlock(tif,tif->tif_diroff,dirmem,dirsize))
+			goto bad;
+		if (!SeekOK(tif,tif->tif_diroff))
+		{
+			TIFFErrorExtR(tif,module,"IO error writing directory");
+			goto bad;
+		}
+		if (!WriteOK(tif,tif->tif_scratch[TIFF_SCRATCH_DIRECTORY],
+		    (tmsize_t)(tif->tif_dataend-tif->tif_diroff)))
+		{
+			TIFFErrorExtR(tif,module,"IO error writing directory");
+			goto bad;
+		}
 	}
-	_TIFFfree(dirmem);
+	_TIFFfreeExt(tif, dirmem);
+	dirmem=NULL;
+	/* Make the directory readable from the file now */
+	if (!_TIFFWriteBufferFlush(tif))
+		goto bad;
 	if (imagedone)
 	{
+		/*
+		 * Nothing before a finished top-level directory changes any
+		 * more, so a stream can send it.
+		 */
+		if ((isimage)&&(pdiroff==NULL)&&
+		    ((tif->tif_flags&TIFF_INSUBIFD)==0)&&
+		    (!TIFFFieldSet(tif,FIELD_SUBIFD))&&
+		    (!_TIFFSequentialCommit(tif,tif->tif_diroff)))
+			return(0);
 		TIFFFreeDirectory(tif);
 		tif->tif_flags &= ~TIFF_DIRTYDIRECT;
 		tif->tif_flags &= ~TIFF_DIRTYSTRIP;
@@ -937,9 +1213,24 @@ TIFFWriteDirectorySec(TIFF* tif, int isimage, int imagedone, uint64* pdiroff)
 	return(1);
 bad:
 	if (dir!=NULL)
-		_TIFFfree(dir);
+		_TIFFfreeExt(tif, dir);
 	if (dirmem!=NULL)
-		_TIFFfree(dirmem);
+		_TIFFfreeExt(tif, dirmem);
+	if ((reservesize!=0)&&(tif->tif_dirreservesize==0))
+	{
+		/*
+		 * Outgrew the reserved space; start over in a larger one so
+		 * that the image data written after it remains untouched.
+		 */
+		TIFFWarningExtR(tif,module,
+		    "Directory does not fit in its reserved space, moving it to the end of the file");
+		tif->tif_curdir--;
+		if (TIFFFieldSet(tif,FIELD_SUBIFD))
+			tif->tif_subifdoff=0;
+		if ((TIFFUnlinkCurrentDirectory(tif))&&
+		    (TIFFSetAsideDirectorySpace(tif,2*reservesize,module)))
+			goto retry;
+	}
 	return(0);
 }
 
@@ -1013,10 +1304,10 @@ TIFFWriteDirectoryTagSampleformatArray(TIFF* tif, uint32* ndir, TIFFDirEntry* di
 	void* conv;
 	uint32 i;
 	int ok;
-	conv = _TIFFmalloc(count*sizeof(double));
+	conv = _TIFFmallocExt(tif, count*sizeof(double));
 	if (conv == NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "Out of memory");
+		TIFFErrorExtR(tif, module, "Out of memory");
 		return (0);
 	}
 
@@ -1078,7 +1369,7 @@ TIFFWriteDirectoryTagSampleformatArray(TIFF* tif, uint32* ndir, TIFFDirEntry* di
 			ok = 0;
 	}
 
-	_TIFFfree(conv);
+	_TIFFfreeExt(tif, conv);
 	return (ok);
 }
 
@@ -1173,16 +1464,16 @@ TIFFWriteDirectoryTagBytePerSample(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, u
 		(*ndir)++;
 		return(1);
 	}
-	m=_TIFFmalloc(tif->tif_dir.td_samplesperpixel*sizeof(uint8));
+	m=_TIFFmallocExt(tif, tif->tif_dir.td_samplesperpixel*sizeof(uint8));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=m, nb=0; nb<tif->tif_dir.td_samplesperpixel; na++, nb++)
 		*na=value;
 	o=TIFFWriteDirectoryTagCheckedByteArray(tif,ndir,dir,tag,tif->tif_dir.td_samplesperpixel,m);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 #endif
@@ -1225,16 +1516,16 @@ TIFFWriteDirectoryTagSbytePerSample(TIFF* tif, uint32* ndir, TIFFDirEntry* dir,
 		(*ndir)++;
 		return(1);
 	}
-	m=_TIFFmalloc(tif->tif_dir.td_samplesperpixel*sizeof(int8));
+	m=_TIFFmallocExt(tif, tif->tif_dir.td_samplesperpixel*sizeof(int8));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=m, nb=0; nb<tif->tif_dir.td_samplesperpixel; na++, nb++)
 		*na=value;
 	o=TIFFWriteDirectoryTagCheckedSbyteArray(tif,ndir,dir,tag,tif->tif_dir.td_samplesperpixel,m);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 #endif
@@ -1274,16 +1565,16 @@ TIFFWriteDirectoryTagShortPerSample(TIFF* tif, uint32* ndir, TIFFDirEntry* dir,
 		(*ndir)++;
 		return(1);
 	}
-	m=_TIFFmalloc(tif->tif_dir.td_samplesperpixel*sizeof(uint16));
+	m=_TIFFmallocExt(tif, tif->tif_dir.td_samplesperpixel*sizeof(uint16));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=m, nb=0; nb<tif->tif_dir.td_samplesperpixel; na++, nb++)
 		*na=value;
 	o=TIFFWriteDirectoryTagCheckedShortArray(tif,ndir,dir,tag,tif->tif_dir.td_samplesperpixel,m);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 
@@ -1325,16 +1616,16 @@ TIFFWriteDirectoryTagSshortPerSample(TIFF* tif, uint32* ndir, TIFFDirEntry* dir,
 		(*ndir)++;
 		return(1);
 	}
-	m=_TIFFmalloc(tif->tif_dir.td_samplesperpixel*sizeof(int16));
+	m=_TIFFmallocExt(tif, tif->tif_dir.td_samplesperpixel*sizeof(int16));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=m, nb=0; nb<tif->tif_dir.td_samplesperpixel; na++, nb++)
 		*na=value;
 	o=TIFFWriteDirectoryTagCheckedSshortArray(tif,ndir,dir,tag,tif->tif_dir.td_samplesperpixel,m);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 #endif
@@ -1375,16 +1666,16 @@ TIFFWriteDirectoryTagLongPerSample(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, u
 		(*ndir)++;
 		return(1);
 	}
-	m=_TIFFmalloc(tif->tif_dir.td_samplesperpixel*sizeof(uint32));
+	m=_TIFFmallocExt(tif, tif->tif_dir.td_samplesperpixel*sizeof(uint32));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=m, nb=0; nb<tif->tif_dir.td_samplesperpixel; na++, nb++)
 		*na=value;
 	o=TIFFWriteDirectoryTagCheckedLongArray(tif,ndir,dir,tag,tif->tif_dir.td_samplesperpixel,m);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 #endif
@@ -1427,16 +1718,16 @@ TIFFWriteDirectoryTagSlongPerSample(TIFF* tif, uint32* ndir, TIFFDirEntry* dir,
 		(*ndir)++;
 		return(1);
 	}
-	m=_TIFFmalloc(tif->tif_dir.td_samplesperpixel*sizeof(int32));
+	m=_TIFFmallocExt(tif, tif->tif_dir.td_samplesperpixel*sizeof(int32));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=m, nb=0; nb<tif->tif_dir.td_samplesperpixel; na++, nb++)
 		*na=value;
 	o=TIFFWriteDirectoryTagCheckedSlongArray(tif,ndir,dir,tag,tif->tif_dir.td_samplesperpixel,m);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 #endif
@@ -1557,16 +1848,16 @@ static int TIFFWriteDirectoryTagFloatPerSample(TIFF* tif, uint32* ndir, TIFFDirE
 		(*ndir)++;
 		return(1);
 	}
-	m=_TIFFmalloc(tif->tif_dir.td_samplesperpixel*sizeof(float));
+	m=_TIFFmallocExt(tif, tif->tif_dir.td_samplesperpixel*sizeof(float));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=m, nb=0; nb<tif->tif_dir.td_samplesperpixel; na++, nb++)
 		*na=value;
 	o=TIFFWriteDirectoryTagCheckedFloatArray(tif,ndir,dir,tag,tif->tif_dir.td_samplesperpixel,m);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 #endif
@@ -1606,16 +1897,16 @@ static int TIFFWriteDirectoryTagDoublePerSample(TIFF* tif, uint32* ndir, TIFFDir
 		(*ndir)++;
 		return(1);
 	}
-	m=_TIFFmalloc(tif->tif_dir.td_samplesperpixel*sizeof(double));
+	m=_TIFFmallocExt(tif, tif->tif_dir.td_samplesperpixel*sizeof(double));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=m, nb=0; nb<tif->tif_dir.td_samplesperpixel; na++, nb++)
 		*na=value;
 	o=TIFFWriteDirectoryTagCheckedDoubleArray(tif,ndir,dir,tag,tif->tif_dir.td_samplesperpixel,m);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 #endif
@@ -1692,10 +1983,10 @@ TIFFWriteDirectoryTagLongLong8Array(TIFF* tif, uint32* ndir, TIFFDirEntry* dir,
     ** and convert to long format.
     */
 
-    p = _TIFFmalloc(count*sizeof(uint32));
+    p = _TIFFmallocExt(tif, count*sizeof(uint32));
     if (p==NULL)
     {
-        TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+        TIFFErrorExtR(tif,module,"Out of memory");
         return(0);
     }
 
@@ -1703,16 +1994,16 @@ TIFFWriteDirectoryTagLongLong8Array(TIFF* tif, uint32* ndir, TIFFDirEntry* dir,
     {
         if (*ma>0xFFFFFFFF)
         {
-            TIFFErrorExt(tif->tif_clientdata,module,
+            TIFFErrorExtR(tif,module,
                          "Attempt to write value larger than 0xFFFFFFFF in Classic TIFF file.");
-            _TIFFfree(p);
+            _TIFFfreeExt(tif, p);
             return(0);
         }
         *q= (uint32)(*ma);
     }
 
     o=TIFFWriteDirectoryTagCheckedLongArray(tif,ndir,dir,tag,count,p);
-    _TIFFfree(p);
+    _TIFFfreeExt(tif, p);
 
     return(o);
 }
@@ -1750,10 +2041,10 @@ TIFFWriteDirectoryTagIfdIfd8Array(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, ui
     ** and convert to long format.
     */
 
-    p = _TIFFmalloc(count*sizeof(uint32));
+    p = _TIFFmallocExt(tif, count*sizeof(uint32));
     if (p==NULL)
     {
-        TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+        TIFFErrorExtR(tif,module,"Out of memory");
         return(0);
     }
 
@@ -1761,16 +2052,16 @@ TIFFWriteDirectoryTagIfdIfd8Array(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, ui
     {
         if (*ma>0xFFFFFFFF)
         {
-            TIFFErrorExt(tif->tif_clientdata,module,
+            TIFFErrorExtR(tif,module,
                          "Attempt to write value larger than 0xFFFFFFFF in Classic TIFF file.");
-            _TIFFfree(p);
+            _TIFFfreeExt(tif, p);
             return(0);
         }
         *q= (uint32)(*ma);
     }
 
     o=TIFFWriteDirectoryTagCheckedIfdArray(tif,ndir,dir,tag,count,p);
-    _TIFFfree(p);
+    _TIFFfreeExt(tif, p);
 
     return(o);
 }
@@ -1804,31 +2095,31 @@ TIFFWriteDirectoryTagShortLongLong8Array(TIFF* tif, uint32* ndir, TIFFDirEntry*
 	{
 		uint16* p;
 		uint16* q;
-		p=_TIFFmalloc(count*sizeof(uint16));
+		p=_TIFFmallocExt(tif, count*sizeof(uint16));
 		if (p==NULL)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+			TIFFErrorExtR(tif,module,"Out of memory");
 			return(0);
 		}
 		for (ma=value, mb=0, q=p; mb<count; ma++, mb++, q++)
 			*q=(uint16)(*ma);
 		o=TIFFWriteDirectoryTagCheckedShortArray(tif,ndir,dir,tag,count,p);
-		_TIFFfree(p);
+		_TIFFfreeExt(tif, p);
 	}
 	else if (n==1)
 	{
 		uint32* p;
 		uint32* q;
-		p=_TIFFmalloc(count*sizeof(uint32));
+		p=_TIFFmallocExt(tif, count*sizeof(uint32));
 		if (p==NULL)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+			TIFFErrorExtR(tif,module,"Out of memory");
 			return(0);
 		}
 		for (ma=value, mb=0, q=p; mb<count; ma++, mb++, q++)
 			*q=(uint32)(*ma);
 		o=TIFFWriteDirectoryTagCheckedLongArray(tif,ndir,dir,tag,count,p);
-		_TIFFfree(p);
+		_TIFFfreeExt(tif, p);
 	}
 	else
 	{
@@ -1851,17 +2142,17 @@ TIFFWriteDirectoryTagColormap(TIFF* tif, uint32* ndir, TIFFDirEntry* dir)
 		return(1);
 	}
 	m=(1<<tif->tif_dir.td_bitspersample);
-	n=_TIFFmalloc(3*m*sizeof(uint16));
+	n=_TIFFmallocExt(tif, 3*m*sizeof(uint16));
 	if (n==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	_TIFFmemcpy(&n[0],tif->tif_dir.td_colormap[0],m*sizeof(uint16));
 	_TIFFmemcpy(&n[m],tif->tif_dir.td_colormap[1],m*sizeof(uint16));
 	_TIFFmemcpy(&n[2*m],tif->tif_dir.td_colormap[2],m*sizeof(uint16));
 	o=TIFFWriteDirectoryTagCheckedShortArray(tif,ndir,dir,TIFFTAG_COLORMAP,3*m,n);
-	_TIFFfree(n);
+	_TIFFfreeExt(tif, n);
 	return(o);
 }
 
@@ -1900,10 +2191,10 @@ TIFFWriteDirectoryTagTransferfunction(TIFF* tif, uint32* ndir, TIFFDirEntry* dir
 	}
 	if (n==0)
 		n=1;
-	o=_TIFFmalloc(n*m*sizeof(uint16));
+	o=_TIFFmallocExt(tif, n*m*sizeof(uint16));
 	if (o==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	_TIFFmemcpy(&o[0],tif->tif_dir.td_transferfunction[0],m*sizeof(uint16));
@@ -1912,7 +2203,7 @@ TIFFWriteDirectoryTagTransferfunction(TIFF* tif, uint32* ndir, TIFFDirEntry* dir
 	if (n>2)
 		_TIFFmemcpy(&o[2*m],tif->tif_dir.td_transferfunction[2],m*sizeof(uint16));
 	p=TIFFWriteDirectoryTagCheckedShortArray(tif,ndir,dir,TIFFTAG_TRANSFERFUNCTION,n*m,o);
-	_TIFFfree(o);
+	_TIFFfreeExt(tif, o);
 	return(p);
 }
 
@@ -1936,10 +2227,10 @@ TIFFWriteDirectoryTagSubifd(TIFF* tif, uint32* ndir, TIFFDirEntry* dir)
 		uint64* pa;
 		uint32* pb;
 		uint16 p;
-		o=_TIFFmalloc(tif->tif_dir.td_nsubifd*sizeof(uint32));
+		o=_TIFFmallocExt(tif, tif->tif_dir.td_nsubifd*sizeof(uint32));
 		if (o==NULL)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+			TIFFErrorExtR(tif,module,"Out of memory");
 			return(0);
 		}
 		pa=tif->tif_dir.td_subifd;
@@ -1951,14 +2242,14 @@ TIFFWriteDirectoryTagSubifd(TIFF* tif, uint32* ndir, TIFFDirEntry* dir)
                         /* Could happen if an classicTIFF has a SubIFD of type LONG8 (which is illegal) */
                         if( *pa > 0xFFFFFFFFUL)
                         {
-                            TIFFErrorExt(tif->tif_clientdata,module,"Illegal value for SubIFD tag");
-                            _TIFFfree(o);
+                            TIFFErrorExtR(tif,module,"Illegal value for SubIFD tag");
+                            _TIFFfreeExt(tif, o);
                             return(0);
                         }
 			*pb++=(uint32)(*pa++);
 		}
 		n=TIFFWriteDirectoryTagCheckedIfdArray(tif,ndir,dir,TIFFTAG_SUBIFD,tif->tif_dir.td_nsubifd,o);
-		_TIFFfree(o);
+		_TIFFfreeExt(tif, o);
 	}
 	else
 		n=TIFFWriteDirectoryTagCheckedIfd8Array(tif,ndir,dir,TIFFTAG_SUBIFD,tif->tif_dir.td_nsubifd,tif->tif_dir.td_subifd);
@@ -2122,7 +2413,7 @@ TIFFWriteDirectoryTagCheckedLong8(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, ui
 	uint64 m;
 	assert(sizeof(uint64)==8);
 	if( !(tif->tif_flags&TIFF_BIGTIFF) ) {
-		TIFFErrorExt(tif->tif_clientdata,"TIFFWriteDirectoryTagCheckedLong8","LONG8 not allowed for ClassicTIFF");
+		TIFFErrorExtR(tif,"TIFFWriteDirectoryTagCheckedLong8","LONG8 not allowed for ClassicTIFF");
 		return(0);
 	}
 	m=value;
@@ -2138,7 +2429,7 @@ TIFFWriteDirectoryTagCheckedLong8Array(TIFF* tif, uint32* ndir, TIFFDirEntry* di
 	assert(count<0x20000000);
 	assert(sizeof(uint64)==8);
 	if( !(tif->tif_flags&TIFF_BIGTIFF) ) {
-		TIFFErrorExt(tif->tif_clientdata,"TIFFWriteDirectoryTagCheckedLong8Array","LONG8 not allowed for ClassicTIFF");
+		TIFFErrorExtR(tif,"TIFFWriteDirectoryTagCheckedLong8Array","LONG8 not allowed for ClassicTIFF");
 		return(0);
 	}
 	if (tif->tif_flags&TIFF_SWAB)
@@ -2153,7 +2444,7 @@ TIFFWriteDirectoryTagCheckedSlong8(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, u
 	int64 m;
 	assert(sizeof(int64)==8);
 	if( !(tif->tif_flags&TIFF_BIGTIFF) ) {
-		TIFFErrorExt(tif->tif_clientdata,"TIFFWriteDirectoryTagCheckedSlong8","SLONG8 not allowed for ClassicTIFF");
+		TIFFErrorExtR(tif,"TIFFWriteDirectoryTagCheckedSlong8","SLONG8 not allowed for ClassicTIFF");
 		return(0);
 	}
 	m=value;
@@ -2169,7 +2460,7 @@ TIFFWriteDirectoryTagCheckedSlong8Array(TIFF* tif, uint32* ndir, TIFFDirEntry* d
 	assert(count<0x20000000);
 	assert(sizeof(int64)==8);
 	if( !(tif->tif_flags&TIFF_BIGTIFF) ) {
-		TIFFErrorExt(tif->tif_clientdata,"TIFFWriteDirectoryTagCheckedSlong8Array","SLONG8 not allowed for ClassicTIFF");
+		TIFFErrorExtR(tif,"TIFFWriteDirectoryTagCheckedSlong8Array","SLONG8 not allowed for ClassicTIFF");
 		return(0);
 	}
 	if (tif->tif_flags&TIFF_SWAB)
@@ -2185,12 +2476,12 @@ TIFFWriteDirectoryTagCheckedRational(TIFF* tif, uint32* ndir, TIFFDirEntry* dir,
 	assert(sizeof(uint32)==4);
         if( value < 0 )
         {
-            TIFFErrorExt(tif->tif_clientdata,module,"Negative value is illegal");
+            TIFFErrorExtR(tif,module,"Negative value is illegal");
             return 0;
         }
         else if( value != value )
         {
-            TIFFErrorExt(tif->tif_clientdata,module,"Not-a-number value is illegal");
+            TIFFErrorExtR(tif,module,"Not-a-number value is illegal");
             return 0;
         }
 	else if (value==0.0)
@@ -2231,10 +2522,10 @@ TIFFWriteDirectoryTagCheckedRationalArray(TIFF* tif, uint32* ndir, TIFFDirEntry*
 	uint32 nc;
 	int o;
 	assert(sizeof(uint32)==4);
-	m=_TIFFmalloc(count*2*sizeof(uint32));
+	m=_TIFFmallocExt(tif, count*2*sizeof(uint32));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=value, nb=m, nc=0; nc<count; na++, nb+=2, nc++)
@@ -2264,7 +2555,7 @@ TIFFWriteDirectoryTagCheckedRationalArray(TIFF* tif, uint32* ndir, TIFFDirEntry*
 	if (tif->tif_flags&TIFF_SWAB)
 		TIFFSwabArrayOfLong(m,count*2);
 	o=TIFFWriteDirectoryTagData(tif,ndir,dir,tag,TIFF_RATIONAL,count,count*8,&m[0]);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 
@@ -2278,10 +2569,10 @@ TIFFWriteDirectoryTagCheckedSrationalArray(TIFF* tif, uint32* ndir, TIFFDirEntry
 	uint32 nc;
 	int o;
 	assert(sizeof(int32)==4);
-	m=_TIFFmalloc(count*2*sizeof(int32));
+	m=_TIFFmallocExt(tif, count*2*sizeof(int32));
 	if (m==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(tif,module,"Out of memory");
 		return(0);
 	}
 	for (na=value, nb=m, nc=0; nc<count; na++, nb+=2, nc++)
@@ -2326,7 +2617,7 @@ TIFFWriteDirectoryTagCheckedSrationalArray(TIFF* tif, uint32* ndir, TIFFDirEntry
 	if (tif->tif_flags&TIFF_SWAB)
 		TIFFSwabArrayOfLong((uint32*)m,count*2);
 	o=TIFFWriteDirectoryTagData(tif,ndir,dir,tag,TIFF_SRATIONAL,count,count*8,&m[0]);
-	_TIFFfree(m);
+	_TIFFfreeExt(tif, m);
 	return(o);
 }
 
@@ -2435,20 +2726,18 @@ TIFFWriteDirectoryTagData(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, uint16 tag
 			nb=(uint32)nb;
 		if ((nb<na)||(nb<datalength))
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Maximum TIFF file size exceeded");
+			TIFFErrorExtR(tif,module,"Maximum TIFF file size exceeded");
 			return(0);
 		}
-		if (!SeekOK(tif,na))
+		if ((isDirReserved(tif))&&(nb>tif->tif_dirreserveoff+tif->tif_dirreservesize))
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"IO error writing tag data");
+			/* TIFFWriteDirectorySec() writes it elsewhere */
+			tif->tif_dirreservesize=0;
 			return(0);
 		}
 		assert(datalength<0x80000000UL);
-		if (!WriteOK(tif,data,(tmsize_t)datalength))
-		{
-			TIFFErrorExt(tif->tif_clientdata,module,"IO error writing tag data");
+		if (!TIFFWriteDirectoryBlock(tif,na,data,datalength))
 			return(0);
-		}
 		tif->tif_dataoff=nb;
 		if (tif->tif_dataoff&1)
 			tif->tif_dataoff++;
@@ -2471,6 +2760,265 @@ TIFFWriteDirectoryTagData(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, uint16 tag
 	return(1);
 }
 
+/*
+ * Point the entry of a strip/tile array streamed to the file at the
+ * array, after writing out the part of it held in memory.
+ */
+static int
+TIFFWriteDirectoryTagStrileArray(TIFF* tif, uint32* ndir, TIFFDirEntry* dir, uint16 tag, int bytecounts)
+{
+	uint64 off;
+	uint32 m;
+	if (dir==NULL)
+	{
+		(*ndir)++;
+		return(1);
+	}
+	if (!_TIFFFlushStrileWindow(tif))
+		return(0);
+	off=_TIFFStrileArrayOffset(tif,bytecounts);
+	m=0;
+	while (m<(*ndir))
+	{
+		assert(dir[m].tdir_tag!=tag);
+		if (dir[m].tdir_tag>tag)
+			break;
+		m++;
+	}
+	if (m<(*ndir))
+	{
+		uint32 n;
+		for (n=*ndir; n>m; n--)
+			dir[n]=dir[n-1];
+	}
+	dir[m].tdir_tag=tag;
+	dir[m].tdir_count=tif->tif_dir.td_nstrips;
+	dir[m].tdir_offset.toff_long8 = 0;
+	/* the array never fits in the entry, there is more than one strile */
+	if (!(tif->tif_flags&TIFF_BIGTIFF))
+	{
+		uint32 o;
+		o=(uint32)off;
+		if (tif->tif_flags&TIFF_SWAB)
+			TIFFSwabLong(&o);
+		dir[m].tdir_type=TIFF_LONG;
+		_TIFFmemcpy(&dir[m].tdir_offset,&o,4);
+	}
+	else
+	{
+		dir[m].tdir_type=TIFF_LONG8;
+		dir[m].tdir_offset.toff_long8 = off;
+		if (tif->tif_flags&TIFF_SWAB)
+			TIFFSwabLong8(&dir[m].tdir_offset.toff_long8);
+	}
+	(*ndir)++;
+	return(1);
+}
+
+/*
+ * Store size bytes of data at file offset off in the block that is
+ * written at tif_diroff when the directory is complete, instead of
+ * seeking and writing each out-of-line tag value on its own.  Padding
+ * left before off is cleared.
+ */
+static int
+TIFFWriteDirectoryBlock(TIFF* tif, uint64 off, const void* data, uint32 size)
+{
+	static const char module[] = "TIFFWriteDirectoryBlock";
+	uint64 start = off - tif->tif_diroff;
+	uint64 end = start + size;
+	uint64 filled = tif->tif_dataend - tif->tif_diroff;
+	uint8* block;
+
+	if (end != (uint64)(tmsize_t)end || (tmsize_t)end < 0)
+	{
+		TIFFErrorExtR(tif,module,"Directory too large");
+		return(0);
+	}
+	block=(uint8*)_TIFFGrowScratch(tif,TIFF_SCRATCH_DIRECTORY,(tmsize_t)end);
+	if (block==NULL)
+		return(0);
+	if (start>filled)
+		_TIFFmemset(block+filled,0,(tmsize_t)(start-filled));
+	_TIFFmemcpy(block+start,data,size);
+	if (off+size>tif->tif_dataend)
+		tif->tif_dataend=off+size;
+	return(1);
+}
+
+/*
+ * Update the directory already at tif_diroff with the entries in dir
+ * (serialized in dirmem, their out-of-line values in the directory
+ * block) without moving it: this works when the tags are the same
+ * ones as in the file and each value fits in its entry or in the
+ * room of the value it replaces.  Only the entries and values that
+ * actually change are written, the link to the next directory is
+ * left alone.  Returns 1 on success, -1 if the directory has to be
+ * relocated instead and 0 on error.
+ */
+static int
+TIFFWriteDirectoryInPlace(TIFF* tif, TIFFDirEntry* dir, uint32 ndir,
+    const uint8* dirmem)
+{
+	static const char module[] = "TIFFWriteDirectoryInPlace";
+	int bigtiff = (tif->tif_flags&TIFF_BIGTIFF) != 0;
+	uint32 headersize = bigtiff ? 8 : 2;
+	uint32 entrysize = bigtiff ? 20 : 12;
+	uint32 inlinesize = bigtiff ? 8 : 4;
+	uint8* block = (uint8*)tif->tif_scratch[TIFF_SCRATCH_DIRECTORY];
+	uint8* old = NULL;
+	uint8* value = NULL;
+	uint64* oldoff = NULL;
+	uint64 count;
+	uint32 m;
+	int ret = 0;
+
+	if (!SeekOK(tif,tif->tif_diroff))
+		goto ioerror;
+	if (bigtiff)
+	{
+		if (!ReadOK(tif,&count,8))
+			goto ioerror;
+		if (tif->tif_flags&TIFF_SWAB)
+			TIFFSwabLong8(&count);
+	}
+	else
+	{
+		uint16 count16;
+		if (!ReadOK(tif,&count16,2))
+			goto ioerror;
+		if (tif->tif_flags&TIFF_SWAB)
+			TIFFSwabShort(&count16);
+		count = count16;
+	}
+	if (count != ndir)
+		return(-1);
+	old = (uint8*)_TIFFCheckMalloc(tif, ndir, entrysize, module);
+	oldoff = (uint64*)_TIFFCheckMalloc(tif, ndir, sizeof(uint64), module);
+	if (old == NULL || oldoff == NULL)
+		goto done;
+	if (!ReadOK(tif,old,(tmsize_t)ndir*entrysize))
+		goto ioerror;
+
+	/* First make sure that everything fits before writing anything */
+	for (m=0; m<ndir; m++)
+	{
+		const uint8* e = old+m*entrysize;
+		uint16 tag, type;
+		uint64 newsize, oldsize;
+		int width;
+
+		_TIFFmemcpy(&tag,e,2);
+		_TIFFmemcpy(&type,e+2,2);
+		if (tif->tif_flags&TIFF_SWAB)
+		{
+			TIFFSwabShort(&tag);
+			TIFFSwabShort(&type);
+		}
+		if (tag != dir[m].tdir_tag)
+			goto relocate;
+		newsize = dir[m].tdir_count*(uint64)TIFFDataWidth((TIFFDataType)dir[m].tdir_type);
+		oldoff[m] = 0;
+		if (newsize <= inlinesize)
+			continue;
+		width = TIFFDataWidth((TIFFDataType)type);
+		if (bigtiff)
+		{
+			_TIFFmemcpy(&count,e+4,8);
+			_TIFFmemcpy(&oldoff[m],e+12,8);
+			if (tif->tif_flags&TIFF_SWAB)
+			{
+				TIFFSwabLong8(&count);
+				TIFFSwabLong8(&oldoff[m]);
+			}
+		}
+		else
+		{
+			uint32 v;
+			_TIFFmemcpy(&v,e+4,4);
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabLong(&v);
+			count = v;
+			_TIFFmemcpy(&v,e+8,4);
+			if (tif->tif_flags&TIFF_SWAB)
+				TIFFSwabLong(&v);
+			oldoff[m] = v;
+		}
+		if (width == 0 || count > ~((uint64)0)/(uint64)width)
+			goto relocate;
+		oldsize = count*(uint64)width;
+		if (oldsize <= inlinesize || newsize > oldsize)
+			goto relocate;
+	}
+
+	for (m=0; m<ndir; m++)
+	{
+		const uint8* e = dirmem+headersize+m*entrysize;
+		uint8 entry[20];
+
+		_TIFFmemcpy(entry,e,entrysize);
+		if (oldoff[m] != 0)
+		{
+			uint64 newoff;
+			tmsize_t size = (tmsize_t)(dir[m].tdir_count*
+			    TIFFDataWidth((TIFFDataType)dir[m].tdir_type));
+
+			if (bigtiff)
+			{
+				newoff = dir[m].tdir_offset.toff_long8;
+				if (tif->tif_flags&TIFF_SWAB)
+					TIFFSwabLong8(&newoff);
+			}
+			else
+			{
+				uint32 v = dir[m].tdir_offset.toff_long;
+				if (tif->tif_flags&TIFF_SWAB)
+					TIFFSwabLong(&v);
+				newoff = v;
+			}
+			value = (uint8*)_TIFFreallocExt(tif, value, size);
+			if (value == NULL)
+			{
+				TIFFErrorExtR(tif,module,"Out of memory");
+				goto done;
+			}
+			if (!SeekOK(tif,oldoff[m]) || !ReadOK(tif,value,size))
+				goto ioerror;
+			if (_TIFFmemcmp(value,block+(newoff-tif->tif_diroff),size) != 0)
+			{
+				if (!SeekOK(tif,oldoff[m]) ||
+				    !WriteOK(tif,block+(newoff-tif->tif_diroff),size))
+					goto ioerror;
+			}
+			/* Keep pointing at the old value */
+			_TIFFmemcpy(entry+entrysize-inlinesize,
+			    old+m*entrysize+entrysize-inlinesize,inlinesize);
+		}
+		if (_TIFFmemcmp(entry,old+m*entrysize,entrysize) != 0)
+		{
+			if (!SeekOK(tif,tif->tif_diroff+headersize+m*entrysize) ||
+			    !WriteOK(tif,entry,entrysize))
+				goto ioerror;
+		}
+	}
+	ret = 1;
+	goto done;
+
+relocate:
+	ret = -1;
+	goto done;
+ioerror:
+	TIFFErrorExtR(tif,module,"IO error updating directory");
+done:
+	if (old)
+		_TIFFfreeExt(tif, old);
+	if (oldoff)
+		_TIFFfreeExt(tif, oldoff);
+	if (value)
+		_TIFFfreeExt(tif, value);
+	return(ret);
+}
+
 /*
  * Link the current directory into the directory chain for the file.
  */
@@ -2479,7 +3027,10 @@ TIFFLinkDirectory(TIFF* tif)
 {
 	static const char module[] = "TIFFLinkDirectory";
 
-	tif->tif_diroff = (TIFFSeekFile(tif,0,SEEK_END)+1) & (~((toff_t)1));
+	if (tif->tif_dirreservesize != 0)
+		tif->tif_diroff = tif->tif_dirreserveoff;
+	else
+		tif->tif_diroff = (TIFFSeekFile(tif,0,SEEK_END)+1) & (~((toff_t)1));
 
 	/*
 	 * Handle SubIFDs
@@ -2494,7 +3045,7 @@ TIFFLinkDirectory(TIFF* tif)
 				TIFFSwabLong(&m);
 			(void) TIFFSeekFile(tif, tif->tif_subifdoff, SEEK_SET);
 			if (!WriteOK(tif, &m, 4)) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				     "Error writing SubIFD directory link");
 				return (0);
 			}
@@ -2517,7 +3068,7 @@ TIFFLinkDirectory(TIFF* tif)
 				TIFFSwabLong8(&m);
 			(void) TIFFSeekFile(tif, tif->tif_subifdoff, SEEK_SET);
 			if (!WriteOK(tif, &m, 8)) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				     "Error writing SubIFD directory link");
 				return (0);
 			}
@@ -2548,23 +3099,27 @@ TIFFLinkDirectory(TIFF* tif)
 			tif->tif_header.classic.tiff_diroff = (uint32) tif->tif_diroff;
 			(void) TIFFSeekFile(tif,4, SEEK_SET);
 			if (!WriteOK(tif, &m, 4)) {
-				TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+				TIFFErrorExtR(tif, tif->tif_name,
 					     "Error writing TIFF header");
 				return (0);
 			}
+			tif->tif_lastdiroff = tif->tif_diroff;
+			_TIFFAppendDirIndexLink(tif, 0, tif->tif_diroff);
 			return (1);
 		}
 		/*
-		 * Not the first directory, search to the last and append.
+		 * Not the first directory, search to the last and append,
+		 * starting from the last one linked by this handle if any.
 		 */
-		nextdir = tif->tif_header.classic.tiff_diroff;
+		nextdir = tif->tif_lastdiroff != 0 ? (uint32) tif->tif_lastdiroff :
+		    tif->tif_header.classic.tiff_diroff;
 		while(1) {
 			uint16 dircount;
 			uint32 nextnextdir;
 
 			if (!SeekOK(tif, nextdir) ||
 			    !ReadOK(tif, &dircount, 2)) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "Error fetching directory count");
 				return (0);
 			}
@@ -2573,7 +3128,7 @@ TIFFLinkDirectory(TIFF* tif)
 			(void) TIFFSeekFile(tif,
 			    nextdir+2+dircount*12, SEEK_SET);
 			if (!ReadOK(tif, &nextnextdir, 4)) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "Error fetching directory link");
 				return (0);
 			}
@@ -2584,7 +3139,7 @@ TIFFLinkDirectory(TIFF* tif)
 				(void) TIFFSeekFile(tif,
 				    nextdir+2+dircount*12, SEEK_SET);
 				if (!WriteOK(tif, &m, 4)) {
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					     "Error writing directory link");
 					return (0);
 				}
@@ -2592,6 +3147,7 @@ TIFFLinkDirectory(TIFF* tif)
 			}
 			nextdir=nextnextdir;
 		}
+		_TIFFAppendDirIndexLink(tif, nextdir, tif->tif_diroff);
 	}
 	else
 	{
@@ -2607,16 +3163,20 @@ TIFFLinkDirectory(TIFF* tif)
 			tif->tif_header.big.tiff_diroff = tif->tif_diroff;
 			(void) TIFFSeekFile(tif,8, SEEK_SET);
 			if (!WriteOK(tif, &m, 8)) {
-				TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+				TIFFErrorExtR(tif, tif->tif_name,
 					     "Error writing TIFF header");
 				return (0);
 			}
+			tif->tif_lastdiroff = tif->tif_diroff;
+			_TIFFAppendDirIndexLink(tif, 0, tif->tif_diroff);
 			return (1);
 		}
 		/*
-		 * Not the first directory, search to the last and append.
+		 * Not the first directory, search to the last and append,
+		 * starting from the last one linked by this handle if any.
 		 */
-		nextdir = tif->tif_header.big.tiff_diroff;
+		nextdir = tif->tif_lastdiroff != 0 ? tif->tif_lastdiroff :
+		    tif->tif_header.big.tiff_diroff;
 		while(1) {
 			uint64 dircount64;
 			uint16 dircount;
@@ -2624,7 +3184,7 @@ TIFFLinkDirectory(TIFF* tif)
 
 			if (!SeekOK(tif, nextdir) ||
 			    !ReadOK(tif, &dircount64, 8)) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "Error fetching directory count");
 				return (0);
 			}
@@ -2632,7 +3192,7 @@ TIFFLinkDirectory(TIFF* tif)
 				TIFFSwabLong8(&dircount64);
 			if (dircount64>0xFFFF)
 			{
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "Sanity check on tag count failed, likely corrupt TIFF");
 				return (0);
 			}
@@ -2640,7 +3200,7 @@ TIFFLinkDirectory(TIFF* tif)
 			(void) TIFFSeekFile(tif,
 			    nextdir+8+dircount*20, SEEK_SET);
 			if (!ReadOK(tif, &nextnextdir, 8)) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "Error fetching directory link");
 				return (0);
 			}
@@ -2651,7 +3211,7 @@ TIFFLinkDirectory(TIFF* tif)
 				(void) TIFFSeekFile(tif,
 				    nextdir+8+dircount*20, SEEK_SET);
 				if (!WriteOK(tif, &m, 8)) {
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					     "Error writing directory link");
 					return (0);
 				}
@@ -2659,7 +3219,9 @@ TIFFLinkDirectory(TIFF* tif)
 			}
 			nextdir=nextnextdir;
 		}
+		_TIFFAppendDirIndexLink(tif, nextdir, tif->tif_diroff);
 	}
+	tif->tif_lastdiroff = tif->tif_diroff;
 	return (1);
 }
 
@@ -2689,6 +3251,7 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
     uint16 entry_type = 0;
     uint64 entry_count = 0;
     uint64 entry_offset = 0;
+    uint64 entry_size;
     int    value_in_entry = 0;
     uint64 read_offset;
     uint8 *buf_to_write = NULL;
@@ -2704,14 +3267,14 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
 /* -------------------------------------------------------------------- */
     if( isMapped(tif) )
     {
-        TIFFErrorExt( tif->tif_clientdata, module, 
+        TIFFErrorExtR( tif, module, 
                       "Memory mapped files not currently supported for this operation." );
         return 0;
     }
 
     if( tif->tif_diroff == 0 )
     {
-        TIFFErrorExt( tif->tif_clientdata, module, 
+        TIFFErrorExtR( tif, module, 
                       "Attempt to reset field on directory not already on disk." );
         return 0;
     }
@@ -2720,7 +3283,7 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
 /*      Read the directory entry count.                                 */
 /* -------------------------------------------------------------------- */
     if (!SeekOK(tif, tif->tif_diroff)) {
-        TIFFErrorExt(tif->tif_clientdata, module,
+        TIFFErrorExtR(tif, module,
                      "%s: Seek error accessing TIFF directory",
                      tif->tif_name);
         return 0;
@@ -2731,7 +3294,7 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
     if (!(tif->tif_flags&TIFF_BIGTIFF))
     {
         if (!ReadOK(tif, &dircount, sizeof (uint16))) {
-            TIFFErrorExt(tif->tif_clientdata, module,
+            TIFFErrorExtR(tif, module,
                          "%s: Can not read TIFF directory count",
                          tif->tif_name);
             return 0;
@@ -2743,7 +3306,7 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
     } else {
         uint64 dircount64;
         if (!ReadOK(tif, &dircount64, sizeof (uint64))) {
-            TIFFErrorExt(tif->tif_clientdata, module,
+            TIFFErrorExtR(tif, module,
                          "%s: Can not read TIFF directory count",
                          tif->tif_name);
             return 0;
@@ -2761,7 +3324,7 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
     while( dircount > 0 )
     {
         if (!ReadOK(tif, direntry_raw, dirsize)) {
-            TIFFErrorExt(tif->tif_clientdata, module,
+            TIFFErrorExtR(tif, module,
                          "%s: Can not read TIFF directory entry.",
                          tif->tif_name);
             return 0;
@@ -2775,11 +3338,12 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
             break;
 
         read_offset += dirsize;
+        dircount--;
     }
 
     if( entry_tag != tag )
     {
-        TIFFErrorExt(tif->tif_clientdata, module,
+        TIFFErrorExtR(tif, module,
                      "%s: Could not find tag %d.",
                      tif->tif_name, tag );
         return 0;
@@ -2856,8 +3420,8 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
                 (int32) ((int64 *) data)[i];
             if( (int64) ((int32 *) buf_to_write)[i] != ((int64 *) data)[i] )
             {
-                _TIFFfree( buf_to_write );
-                TIFFErrorExt( tif->tif_clientdata, module, 
+                _TIFFfreeExt(tif,  buf_to_write );
+                TIFFErrorExtR( tif, module, 
                               "Value exceeds 32bit range of output type." );
                 return 0;
             }
@@ -2874,8 +3438,8 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
                 (uint32) ((uint64 *) data)[i];
             if( (uint64) ((uint32 *) buf_to_write)[i] != ((uint64 *) data)[i] )
             {
-                _TIFFfree( buf_to_write );
-                TIFFErrorExt( tif->tif_clientdata, module, 
+                _TIFFfreeExt(tif,  buf_to_write );
+                TIFFErrorExtR( tif, module, 
                               "Value exceeds 32bit range of output type." );
                 return 0;
             }
@@ -2895,6 +3459,13 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
 /* -------------------------------------------------------------------- */
 /*      Is this a value that fits into the directory entry?             */
 /* -------------------------------------------------------------------- */
+    entry_size = 0;
+    if( TIFFDataWidth((TIFFDataType) entry_type) != 0
+        && entry_count <= ~((uint64)0) / TIFFDataWidth((TIFFDataType) entry_type) )
+        entry_size = entry_count * TIFFDataWidth((TIFFDataType) entry_type);
+    if( entry_size <= (uint64)((tif->tif_flags&TIFF_BIGTIFF) ? 8 : 4) )
+        entry_size = 0;
+
     if (!(tif->tif_flags&TIFF_BIGTIFF))
     {
         if( TIFFDataWidth(datatype) * count <= 4 )
@@ -2920,33 +3491,45 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
     if( entry_count == (uint64)count && entry_type == (uint16) datatype )
     {
         if (!SeekOK(tif, entry_offset)) {
-            _TIFFfree( buf_to_write );
-            TIFFErrorExt(tif->tif_clientdata, module,
+            _TIFFfreeExt(tif,  buf_to_write );
+            TIFFErrorExtR(tif, module,
                          "%s: Seek error accessing TIFF directory",
                          tif->tif_name);
             return 0;
         }
         if (!WriteOK(tif, buf_to_write, count*TIFFDataWidth(datatype))) {
-            _TIFFfree( buf_to_write );
-            TIFFErrorExt(tif->tif_clientdata, module,
+            _TIFFfreeExt(tif,  buf_to_write );
+            TIFFErrorExtR(tif, module,
                          "Error writing directory link");
             return (0);
         }
 
-        _TIFFfree( buf_to_write );
+        _TIFFfreeExt(tif,  buf_to_write );
         return 1;
     }
 
 /* -------------------------------------------------------------------- */
-/*      Otherwise, we write the new tag data at the end of the file.    */
+/*      Otherwise, we write the new tag data over the old values if     */
+/*      they take as much room, or at the end of the file.              */
 /* -------------------------------------------------------------------- */
     if( !value_in_entry )
     {
-        entry_offset = TIFFSeekFile(tif,0,SEEK_END);
+        if( entry_size >= (uint64)(count*TIFFDataWidth(datatype)) )
+        {
+            if (!SeekOK(tif, entry_offset)) {
+                _TIFFfreeExt(tif,  buf_to_write );
+                TIFFErrorExtR(tif, module,
+                             "%s: Seek error accessing TIFF directory",
+                             tif->tif_name);
+                return 0;
+            }
+        }
+        else
+            entry_offset = TIFFSeekFile(tif,0,SEEK_END);
         
         if (!WriteOK(tif, buf_to_write, count*TIFFDataWidth(datatype))) {
-            _TIFFfree( buf_to_write );
-            TIFFErrorExt(tif->tif_clientdata, module,
+            _TIFFfreeExt(tif,  buf_to_write );
+            TIFFErrorExtR(tif, module,
                          "Error writing directory link");
             return (0);
         }
@@ -2956,13 +3539,14 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
         memcpy( &entry_offset, buf_to_write, count*TIFFDataWidth(datatype));
     }
 
-    _TIFFfree( buf_to_write );
+    _TIFFfreeExt(tif,  buf_to_write );
     buf_to_write = 0;
 
 /* -------------------------------------------------------------------- */
 /*      Adjust the directory entry.                                     */
 /* -------------------------------------------------------------------- */
     entry_type = datatype;
+    entry_count = (uint64)count;
     memcpy( direntry_raw + 2, &entry_type, sizeof(uint16) );
     if (tif->tif_flags&TIFF_SWAB)
         TIFFSwabShort( (uint16 *) (direntry_raw + 2) );
@@ -2996,7 +3580,7 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
 /*      Write the directory entry out to disk.                          */
 /* -------------------------------------------------------------------- */
     if (!SeekOK(tif, read_offset )) {
-        TIFFErrorExt(tif->tif_clientdata, module,
+        TIFFErrorExtR(tif, module,
                      "%s: Seek error accessing TIFF directory",
                      tif->tif_name);
         return 0;
@@ -3004,7 +3588,7 @@ _TIFFRewriteField(TIFF* tif, uint16 tag, TIFFDataType in_datatype,
 
     if (!WriteOK(tif, direntry_raw,dirsize))
     {
-        TIFFErrorExt(tif->tif_clientdata, module,
+        TIFFErrorExtR(tif, module,
                      "%s: Can not write TIFF directory entry.",
                      tif->tif_name);
         return 0;
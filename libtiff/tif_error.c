@@ -77,6 +77,37 @@ TIFFErrorExt(thandle_t fd, const char* module, const char* fmt, ...)
 	}
 }
 
+/*
+ * Report an error of a handle: to its own handler first, then, unless
+ * that returns non-zero, to the global handlers.
+ */
+void
+TIFFErrorExtR(TIFF* tif, const char* module, const char* fmt, ...)
+{
+	va_list ap;
+	if (tif != NULL && tif->tif_errorhandler) {
+		int stop;
+
+		va_start(ap, fmt);
+		stop = (*tif->tif_errorhandler)(tif,
+		    tif->tif_errorhandler_user_data, module, fmt, ap);
+		va_end(ap);
+		if (stop)
+			return;
+	}
+	if (_TIFFerrorHandler) {
+		va_start(ap, fmt);
+		(*_TIFFerrorHandler)(module, fmt, ap);
+		va_end(ap);
+	}
+	if (_TIFFerrorHandlerExt) {
+		va_start(ap, fmt);
+		(*_TIFFerrorHandlerExt)(tif ? tif->tif_clientdata : 0,
+		    module, fmt, ap);
+		va_end(ap);
+	}
+}
+
 /*
  * Local Variables:
  * mode: c
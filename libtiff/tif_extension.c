@@ -36,6 +36,8 @@ int TIFFGetTagListCount( TIFF *tif )
 {
     TIFFDirectory* td = &tif->tif_dir;
     
+    if( td->td_ndeferredtags )
+        _TIFFFetchDeferredTags(tif);
     return td->td_customValueCount;
 }
 
@@ -44,6 +46,8 @@ uint32 TIFFGetTagListEntry( TIFF *tif, int tag_index )
 {
     TIFFDirectory* td = &tif->tif_dir;
 
+    if( td->td_ndeferredtags )
+        _TIFFFetchDeferredTags(tif);
     if( tag_index < 0 || tag_index >= td->td_customValueCount )
         return (uint32)(-1);
     else
@@ -97,10 +101,10 @@ void TIFFSetClientInfo( TIFF *tif, void *data, const char *name )
     ** Create a new link.
     */
 
-    psLink = (TIFFClientInfoLink *) _TIFFmalloc(sizeof(TIFFClientInfoLink));
+    psLink = (TIFFClientInfoLink *) _TIFFmallocExt(tif, sizeof(TIFFClientInfoLink));
     assert (psLink != NULL);
     psLink->next = tif->tif_clientinfo;
-    psLink->name = (char *) _TIFFmalloc((tmsize_t)(strlen(name)+1));
+    psLink->name = (char *) _TIFFmallocExt(tif, (tmsize_t)(strlen(name)+1));
     assert (psLink->name != NULL);
     strcpy(psLink->name, name);
     psLink->data = data;
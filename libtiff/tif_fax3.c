@@ -37,6 +37,33 @@
  *      Copyright (C) 1990, 1995  Frank D. Cringle.
  */
 #include "tif_fax3.h"
+
+/*
+ * FAX3_FAST_DECODE selects a faster G3/G4 decoder, which produces the
+ * same output as the original one.  Its bit accumulator is refilled
+ * with as many whole bytes as fit rather than one byte per code, and
+ * long runs are filled with memset().  Define it to 0 to build the
+ * original byte-at-a-time decoder.
+ */
+#ifndef FAX3_FAST_DECODE
+#define FAX3_FAST_DECODE 1
+#endif
+
+#if FAX3_FAST_DECODE && SIZEOF_UNSIGNED_LONG == 8
+typedef uint64 Fax3BitAcc;
+#else
+typedef uint32 Fax3BitAcc;
+#endif
+
+/*
+ * FAX3_FAST_ENCODE likewise selects a faster encoder with the same
+ * output: pixel spans are measured 64 bits at a time and codes are
+ * written to the output buffer without a per-code function call.
+ */
+#ifndef FAX3_FAST_ENCODE
+#define FAX3_FAST_ENCODE 1
+#endif
+
 #define	G3CODES
 #include "t4.h"
 #include <stdio.h>
@@ -68,10 +95,12 @@ typedef struct {
 
 	/* Decoder state info */
 	const unsigned char* bitmap;	/* bit reversal table */
-	uint32	data;			/* current i/o byte/word */
+	Fax3BitAcc data;		/* current i/o byte/word */
 	int	bit;			/* current i/o bit in byte */
 	int	EOLcnt;			/* count of EOL codes recognized */
 	TIFFFaxFillFunc fill;		/* fill routine */
+	TIFFFaxRunsFunc runsfunc;	/* run-length callback, if any */
+	void*	runsdata;		/* client data for runsfunc */
 	uint32*	runs;			/* b&w runs for current/previous row */
 	uint32*	refruns;		/* runs for reference line */
 	uint32*	curruns;		/* runs for current line */
@@ -81,6 +110,10 @@ typedef struct {
 	unsigned char*	refline;	/* reference line for 2d decoding */
 	int	k;			/* #rows left that can be 2d encoded */
 	int	maxk;			/* max #rows that can be 2d encoded */
+	int	refvalid;		/* refruns lists changes of refline */
+	const uint32* encruns;		/* runs to encode, see TIFFWriteFaxRuns */
+	uint32	nencruns;		/* # entries in encruns */
+	unsigned char* runsrow;		/* scanline for TIFFWriteFaxRuns */
 
 	int line;
 } Fax3CodecState;
@@ -103,7 +136,7 @@ typedef struct {
     Fax3CodecState* sp = DecoderState(tif);				\
     int a0;				/* reference element */		\
     int lastx = sp->b.rowpixels;	/* last element in row */	\
-    uint32 BitAcc;			/* bit accumulator */		\
+    Fax3BitAcc BitAcc;			/* bit accumulator */		\
     int BitsAvail;			/* # valid bits in BitAcc */	\
     int RunLength;			/* length of current run */	\
     unsigned char* cp;			/* next byte of input data */	\
@@ -138,6 +171,31 @@ typedef struct {
     tif->tif_rawcp = (uint8*) cp;					\
 } while (0)
 
+#if FAX3_FAST_DECODE
+/*
+ * Make at least n bits available.  While the input lasts, the
+ * accumulator is topped up with whole bytes; the bits it holds are
+ * consumed in the same order as with the byte-wise macros, so only
+ * the input pointer runs ahead.  Near the end of the data this falls
+ * back to the byte-wise logic, including its zero padding.
+ */
+#define NeedBitsWide(n,eoflab) do {					\
+    if (BitsAvail < (n)) {						\
+	if (ep - cp >= (tmsize_t) sizeof(Fax3BitAcc)) {			\
+	    do {							\
+		BitAcc |= ((Fax3BitAcc) bitmap[*cp++])<<BitsAvail;	\
+		BitsAvail += 8;						\
+	    } while (BitsAvail <= (int) (8 * sizeof(Fax3BitAcc)) - 8);	\
+	} else								\
+	    NeedBits16Bytewise(n,eoflab);				\
+    }									\
+} while (0)
+#undef NeedBits8
+#undef NeedBits16
+#define NeedBits8(n,eoflab)	NeedBitsWide(n,eoflab)
+#define NeedBits16(n,eoflab)	NeedBitsWide(n,eoflab)
+#endif
+
 /*
  * Setup state for decoding a strip.
  */
@@ -177,7 +235,7 @@ Fax3PreDecode(TIFF* tif, uint16 s)
 static void
 Fax3Unexpected(const char* module, TIFF* tif, uint32 line, uint32 a0)
 {
-	TIFFErrorExt(tif->tif_clientdata, module, "Bad code word at line %u of %s %u (x %u)",
+	TIFFErrorExtR(tif, module, "Bad code word at line %u of %s %u (x %u)",
 	    line, isTiled(tif) ? "tile" : "strip",
 	    (isTiled(tif) ? tif->tif_curtile : tif->tif_curstrip),
 	    a0);
@@ -187,7 +245,7 @@ Fax3Unexpected(const char* module, TIFF* tif, uint32 line, uint32 a0)
 static void
 Fax3Extension(const char* module, TIFF* tif, uint32 line, uint32 a0)
 {
-	TIFFErrorExt(tif->tif_clientdata, module,
+	TIFFErrorExtR(tif, module,
 	    "Uncompressed data (not supported) at line %u of %s %u (x %u)",
 	    line, isTiled(tif) ? "tile" : "strip",
 	    (isTiled(tif) ? tif->tif_curtile : tif->tif_curstrip),
@@ -198,7 +256,7 @@ Fax3Extension(const char* module, TIFF* tif, uint32 line, uint32 a0)
 static void
 Fax3BadLength(const char* module, TIFF* tif, uint32 line, uint32 a0, uint32 lastx)
 {
-	TIFFWarningExt(tif->tif_clientdata, module, "%s at line %u of %s %u (got %u, expected %u)",
+	TIFFWarningExtR(tif, module, "%s at line %u of %s %u (got %u, expected %u)",
 	    a0 < lastx ? "Premature EOL" : "Line length mismatch",
 	    line, isTiled(tif) ? "tile" : "strip",
 	    (isTiled(tif) ? tif->tif_curtile : tif->tif_curstrip),
@@ -209,7 +267,7 @@ Fax3BadLength(const char* module, TIFF* tif, uint32 line, uint32 a0, uint32 last
 static void
 Fax3PrematureEOF(const char* module, TIFF* tif, uint32 line, uint32 a0)
 {
-	TIFFWarningExt(tif->tif_clientdata, module, "Premature EOF at line %u of %s %u (x %u)",
+	TIFFWarningExtR(tif, module, "Premature EOF at line %u of %s %u (x %u)",
 	    line, isTiled(tif) ? "tile" : "strip",
 	    (isTiled(tif) ? tif->tif_curtile : tif->tif_curstrip),
 	    a0);
@@ -218,6 +276,44 @@ Fax3PrematureEOF(const char* module, TIFF* tif, uint32 line, uint32 a0)
 
 #define	Nop
 
+/*
+ * Output a decoded row: expand the runs into buf or, when a
+ * TIFFTAG_FAXRUNSFUNC callback is installed, hand them to it instead.
+ */
+#define	FILL_ROW()							\
+    (sp->runsfunc != NULL ?						\
+	Fax3PutRuns(tif, sp, thisrun, pa, (uint32) lastx) :		\
+	((*sp->fill)(buf, thisrun, pa, lastx), 1))
+
+/*
+ * Pass the runs of a decoded row to the TIFFTAG_FAXRUNSFUNC callback.
+ * The runs are first normalized as _TIFFFax3fillruns does: padded to
+ * an even count (white first) and clipped so that they add up to lastx.
+ */
+static int
+Fax3PutRuns(TIFF* tif, Fax3CodecState* sp, uint32* runs, uint32* erun,
+    uint32 lastx)
+{
+	static const char module[] = "Fax3PutRuns";
+	uint32* rp;
+	uint32 x = 0;
+
+	if ((erun-runs)&1)
+	    *erun++ = 0;
+	for (rp = runs; rp < erun; rp++) {
+		if (x + *rp > lastx || *rp > lastx)
+			*rp = lastx - x;
+		x += *rp;
+	}
+	if (!(*sp->runsfunc)(sp->runsdata, (uint32) sp->line, runs,
+	    (uint32) (erun - runs), lastx)) {
+		TIFFErrorExtR(tif, module,
+		    "Run-length callback failed at row %d", sp->line);
+		return (0);
+	}
+	return (1);
+}
+
 /*
  * Decode the requested amount of G3 1D-encoded data.
  */
@@ -228,7 +324,7 @@ Fax3Decode1D(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 	(void) s;
 	if (occ % sp->b.rowbytes)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "Fractional scanlines cannot be read");
+		TIFFErrorExtR(tif, module, "Fractional scanlines cannot be read");
 		return (-1);
 	}
 	CACHE_STATE(tif, sp);
@@ -238,13 +334,16 @@ Fax3Decode1D(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 		RunLength = 0;
 		pa = thisrun;
 #ifdef FAX3_DEBUG
-		printf("\nBitAcc=%08X, BitsAvail = %d\n", BitAcc, BitsAvail);
+		printf("\nBitAcc=%08lX, BitsAvail = %d\n", (unsigned long) BitAcc, BitsAvail);
 		printf("-------------------- %d\n", tif->tif_row);
 		fflush(stdout);
 #endif
 		SYNC_EOL(EOF1D);
 		EXPAND1D(EOF1Da);
-		(*sp->fill)(buf, thisrun, pa, lastx);
+		if (!FILL_ROW()) {
+			UNCACHE_STATE(tif, sp);
+			return (-1);
+		}
 		buf += sp->b.rowbytes;
 		occ -= sp->b.rowbytes;
 		sp->line++;
@@ -252,7 +351,7 @@ Fax3Decode1D(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 	EOF1D:				/* premature EOF */
 		CLEANUP_RUNS();
 	EOF1Da:				/* premature EOF */
-		(*sp->fill)(buf, thisrun, pa, lastx);
+		(void) FILL_ROW();
 		UNCACHE_STATE(tif, sp);
 		return (-1);
 	}
@@ -272,7 +371,7 @@ Fax3Decode2D(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 	(void) s;
 	if (occ % sp->b.rowbytes)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "Fractional scanlines cannot be read");
+		TIFFErrorExtR(tif, module, "Fractional scanlines cannot be read");
 		return (-1);
 	}
 	CACHE_STATE(tif, sp);
@@ -281,8 +380,8 @@ Fax3Decode2D(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 		RunLength = 0;
 		pa = thisrun = sp->curruns;
 #ifdef FAX3_DEBUG
-		printf("\nBitAcc=%08X, BitsAvail = %d EOLcnt = %d",
-		    BitAcc, BitsAvail, EOLcnt);
+		printf("\nBitAcc=%08lX, BitsAvail = %d EOLcnt = %d",
+		    (unsigned long) BitAcc, BitsAvail, EOLcnt);
 #endif
 		SYNC_EOL(EOF2D);
 		NeedBits8(1, EOF2D);
@@ -299,7 +398,10 @@ Fax3Decode2D(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 			EXPAND1D(EOF2Da);
 		else
 			EXPAND2D(EOF2Da);
-		(*sp->fill)(buf, thisrun, pa, lastx);
+		if (!FILL_ROW()) {
+			UNCACHE_STATE(tif, sp);
+			return (-1);
+		}
 		SETVALUE(0);		/* imaginary change for reference */
 		SWAP(uint32*, sp->curruns, sp->refruns);
 		buf += sp->b.rowbytes;
@@ -309,7 +411,7 @@ Fax3Decode2D(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 	EOF2D:				/* premature EOF */
 		CLEANUP_RUNS();
 	EOF2Da:				/* premature EOF */
-		(*sp->fill)(buf, thisrun, pa, lastx);
+		(void) FILL_ROW();
 		UNCACHE_STATE(tif, sp);
 		return (-1);
 	}
@@ -388,6 +490,11 @@ Fax3Decode2D(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
     }
 #endif
 
+#if FAX3_FAST_DECODE
+/* Shortest black span, in bytes, filled with memset() */
+#define FAX3_MEMSET_MIN	32
+#endif
+
 /*
  * Bit-fill a row according to the white/black
  * runs generated during G3/G4 decoding.
@@ -404,11 +511,21 @@ _TIFFFax3fillruns(unsigned char* buf, uint32* runs, uint32* erun, uint32 lastx)
 
 	if ((erun-runs)&1)
 	    *erun++ = 0;
+#if FAX3_FAST_DECODE
+	/*
+	 * Clear the whole row up front; white runs then only need to
+	 * advance x.  Bits past lastx in the last byte are preserved.
+	 */
+	_TIFFmemset(buf, 0x00, lastx >> 3);
+	if (lastx & 7)
+	    buf[lastx >> 3] &= 0xff >> (lastx & 7);
+#endif
 	x = 0;
 	for (; runs < erun; runs += 2) {
 	    run = runs[0];
 	    if (x+run > lastx || run > lastx )
 		run = runs[0] = (uint32) (lastx - x);
+#if !FAX3_FAST_DECODE
 	    if (run) {
 		cp = buf + (x>>3);
 		bx = x&7;
@@ -439,8 +556,9 @@ _TIFFFax3fillruns(unsigned char* buf, uint32* runs, uint32* erun, uint32 lastx)
 			cp[0] &= 0xff >> run;
 		} else
 		    cp[0] &= ~(_fillmasks[run]>>bx);
-		x += runs[0];
 	    }
+#endif
+	    x += runs[0];
 	    run = runs[1];
 	    if (x+run > lastx || run > lastx )
 		run = runs[1] = lastx - x;
@@ -453,6 +571,13 @@ _TIFFFax3fillruns(unsigned char* buf, uint32* runs, uint32* erun, uint32 lastx)
 			run -= 8-bx;
 		    }
 		    if( (n = run>>3) != 0 ) {	/* multiple bytes to fill */
+#if FAX3_FAST_DECODE
+			if (n >= FAX3_MEMSET_MIN) {
+			    _TIFFmemset(cp, 0xff, n);
+			    cp += n;
+			    n = 0;
+			} else
+#endif
 			if ((n/sizeof (long)) > 1) {
 			    /*
 			     * Align to longword boundary and fill.
@@ -509,7 +634,7 @@ Fax3SetupState(TIFF* tif)
 	uint32 rowpixels, nruns;
 
 	if (td->td_bitspersample != 1) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Bits/sample must be 1 for Group 3/4 encoding/decoding");
 		return (0);
 	}
@@ -544,7 +669,7 @@ Fax3SetupState(TIFF* tif)
 		nruns = TIFFSafeMultiply(uint32,nruns,2);
 	}
 	if ((nruns == 0) || (TIFFSafeMultiply(uint32,nruns,2) == 0)) {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			     "Row pixels integer overflow (rowpixels %u)",
 			     rowpixels);
 		return (0);
@@ -577,9 +702,9 @@ Fax3SetupState(TIFF* tif)
 		 * is referenced.  The reference line must
 		 * be initialized to be ``white'' (done elsewhere).
 		 */
-		esp->refline = (unsigned char*) _TIFFmalloc(rowbytes);
+		esp->refline = (unsigned char*) _TIFFmallocExt(tif, rowbytes);
 		if (esp->refline == NULL) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "No space for Group 3/4 reference line");
 			return (0);
 		}
@@ -764,6 +889,7 @@ Fax3PreEncode(TIFF* tif, uint16 s)
 	 */
 	if (sp->refline)
 		_TIFFmemset(sp->refline, 0x00, sp->b.rowbytes);
+	sp->refvalid = 0;
 	if (is2DEncoding(sp)) {
 		float res = tif->tif_dir.td_yresolution;
 		/*
@@ -786,6 +912,7 @@ Fax3PreEncode(TIFF* tif, uint16 s)
 	return (1);
 }
 
+#if !FAX3_FAST_ENCODE
 static const unsigned char zeroruns[256] = {
     8, 7, 6, 6, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4,	/* 0x00 - 0x0f */
     3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,	/* 0x10 - 0x1f */
@@ -822,17 +949,83 @@ static const unsigned char oneruns[256] = {
     3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,	/* 0xe0 - 0xef */
     4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 7, 8,	/* 0xf0 - 0xff */
 };
+#endif
 
 /*
  * On certain systems it pays to inline
  * the routines that find pixel spans.
  */
-#ifdef VAXC
+#if defined(VAXC) && !FAX3_FAST_ENCODE
 static	int32 find0span(unsigned char*, int32, int32);
 static	int32 find1span(unsigned char*, int32, int32);
 #pragma inline(find0span,find1span)
 #endif
 
+#if FAX3_FAST_ENCODE
+#if defined(__GNUC__) && (__GNUC__ >= 4)
+#define	Fax3CountLeadingZeros(w)	__builtin_clzll(w)
+#else
+static int
+Fax3CountLeadingZeros(uint64 w)
+{
+	int n = 0;
+
+	while ((w >> 63) == 0) {
+		w <<= 1;
+		n++;
+	}
+	return (n);
+}
+#endif
+
+/*
+ * Find a span of ones (flip all ones) or zeros (flip zero)
+ * starting at bit bs.  Each step looks at the 64 bits that
+ * follow the current position, most significant bit first,
+ * and never reads past the byte holding bit be-1.
+ */
+inline static int32
+findspan(unsigned char* bp, int32 bs, int32 be, uint64 flip)
+{
+	int32 bits = be - bs;
+	int32 span = 0;
+	int32 nbytes;
+	int n, i;
+	uint64 w;
+
+	if (bits <= 0)
+		return (0);
+	bp += bs>>3;
+	n = bs & 7;
+	for (;;) {
+		nbytes = (n + bits - span + 7) >> 3;
+		if (nbytes >= 8)
+			w = ((uint64) bp[0] << 56) | ((uint64) bp[1] << 48) |
+			    ((uint64) bp[2] << 40) | ((uint64) bp[3] << 32) |
+			    ((uint64) bp[4] << 24) | ((uint64) bp[5] << 16) |
+			    ((uint64) bp[6] << 8) | (uint64) bp[7];
+		else {
+			w = 0;
+			for (i = 0; i < nbytes; i++)
+				w |= (uint64) bp[i] << (56 - 8*i);
+		}
+		w = (w ^ flip) << n;
+		if (w != 0) {
+			span += Fax3CountLeadingZeros(w);
+			break;
+		}
+		span += 64 - n;
+		if (span >= bits)
+			break;
+		bp += 8;
+		n = 0;
+	}
+	return (span > bits ? bits : span);
+}
+
+#define	find0span(bp, bs, be)	findspan(bp, bs, be, 0)
+#define	find1span(bp, bs, be)	findspan(bp, bs, be, ~(uint64) 0)
+#else
 /*
  * Find a span of ones or zeros using the supplied
  * table.  The ``base'' of the bit string is supplied
@@ -961,6 +1154,7 @@ find1span(unsigned char* bp, int32 bs, int32 be)
 	}
 	return (span);
 }
+#endif
 
 /*
  * Return the offset of the next bit in the range
@@ -977,6 +1171,20 @@ find1span(unsigned char* bp, int32 bs, int32 be)
 #define	finddiff2(_cp, _bs, _be, _color) \
 	(_bs < _be ? finddiff(_cp,_bs,_be,_color) : _be)
 
+/*
+ * Pad the output to a byte or word boundary at the
+ * end of a 1d-encoded row when the mode asks for it.
+ */
+#define	Fax3AlignRow(tif, sp) {						\
+	if ((sp)->b.mode & (FAXMODE_BYTEALIGN|FAXMODE_WORDALIGN)) {	\
+		if ((sp)->bit != 8)		/* byte-align */	\
+			Fax3FlushBits(tif, sp);				\
+		if (((sp)->b.mode&FAXMODE_WORDALIGN) &&			\
+		    !isAligned((tif)->tif_rawcp, uint16))		\
+			Fax3FlushBits(tif, sp);				\
+	}								\
+}
+
 /*
  * 1d-encode a row of pixels.  The encoding is
  * a sequence of all-white or all-black spans
@@ -1001,13 +1209,7 @@ Fax3Encode1DRow(TIFF* tif, unsigned char* bp, uint32 bits)
 		if (bs >= bits)
 			break;
 	}
-	if (sp->b.mode & (FAXMODE_BYTEALIGN|FAXMODE_WORDALIGN)) {
-		if (sp->bit != 8)			/* byte-align */
-			Fax3FlushBits(tif, sp);
-		if ((sp->b.mode&FAXMODE_WORDALIGN) &&
-		    !isAligned(tif->tif_rawcp, uint16))
-			Fax3FlushBits(tif, sp);
-	}
+	Fax3AlignRow(tif, sp);
 	return (1);
 }
 
@@ -1025,6 +1227,182 @@ static const tableentry vcodes[7] = {
     { 7, 0x02, 0 }	/* 0000 010 */
 };
 
+#if FAX3_FAST_ENCODE
+/*
+ * List the changing elements of a row, that is the positions
+ * of the pixels whose color differs from the pixel on their
+ * left (an imaginary white pixel for the first one).  Even
+ * entries are changes to black.  The list is terminated by
+ * three copies of bits.
+ */
+static void
+Fax3FindChanges(unsigned char* bp, uint32 bits, uint32* ch)
+{
+	static const uint64 msb = (uint64) 1 << 63;
+	uint64 w, t, prev = 0;
+	uint32 x, left, pos;
+	int i, n;
+
+	for (x = 0; x < bits; x += 64, bp += 8) {
+		left = bits - x;
+		if (left >= 64)
+			w = ((uint64) bp[0] << 56) | ((uint64) bp[1] << 48) |
+			    ((uint64) bp[2] << 40) | ((uint64) bp[3] << 32) |
+			    ((uint64) bp[4] << 24) | ((uint64) bp[5] << 16) |
+			    ((uint64) bp[6] << 8) | (uint64) bp[7];
+		else {
+			w = 0;
+			for (i = 0; i < (int) ((left + 7) >> 3); i++)
+				w |= (uint64) bp[i] << (56 - 8*i);
+			w &= ~(~(uint64) 0 >> left);	/* drop pad bits */
+		}
+		/* one bit set for each pixel that differs from its left neighbour */
+		t = w ^ ((w >> 1) | (prev << 63));
+		prev = w & 1;
+		while (t != 0) {
+			n = Fax3CountLeadingZeros(t);
+			pos = x + n;
+			if (pos >= bits)
+				break;
+			*ch++ = pos;
+			t &= ~(msb >> n);
+		}
+	}
+	ch[0] = ch[1] = ch[2] = bits;
+}
+
+/*
+ * 2d-encode a row given as changing elements in sp->curruns
+ * against the reference line changes in sp->refruns.  Consult
+ * the CCITT documentation for the algorithm.
+ *
+ * This produces the same codes as the bitmap version below,
+ * but finds a1, a2, b1 and b2 by walking the changing elements
+ * of both rows instead of re-scanning the pixels at every
+ * step.  The color of a0 is the parity of the number of
+ * changes up to it.  Mode codes are written straight into
+ * the output buffer.
+ */
+static int
+Fax3Encode2DChanges(TIFF* tif, uint32 bits)
+{
+#define	PUTCODE(te) {							\
+	code = (te)->code;						\
+	length = (te)->length;						\
+	_PutBits(tif, code, length);					\
+}
+	Fax3CodecState* sp = EncoderState(tif);
+	uint32* ch = sp->curruns;
+	uint32* rch = sp->refruns;
+	uint32 ia = 0, ib = 0, jb = 0;
+	uint32 a0 = 0, a1, a2, b1, b2;
+	int color;
+	unsigned int bit = sp->bit;
+	int data = sp->data;
+	unsigned int code, length;
+
+	a1 = ch[0];
+	b1 = rch[0];
+	for (;;) {
+		b2 = (b1 < bits ? rch[jb+1] : bits);
+		if (b2 >= a1) {
+			int32 d = (b1 >= a1 && b1 - a1 <= 3U) ? (int32)(b1 - a1):
+			          (b1 < a1 && a1 - b1 <= 3U) ? -(int32)(a1 - b1) : 0x7FFFFFFF;
+			if (!(-3 <= d && d <= 3)) {	/* horizontal mode */
+				a2 = (a1 < bits ? ch[ia+1] : bits);
+				PUTCODE(&horizcode);
+				sp->data = data;
+				sp->bit = bit;
+				if (a0+a1 == 0 || (ia & 1) == 0) {
+					putspan(tif, a1-a0, TIFFFaxWhiteCodes);
+					putspan(tif, a2-a1, TIFFFaxBlackCodes);
+				} else {
+					putspan(tif, a1-a0, TIFFFaxBlackCodes);
+					putspan(tif, a2-a1, TIFFFaxWhiteCodes);
+				}
+				data = sp->data;
+				bit = sp->bit;
+				a0 = a2;
+			} else {			/* vertical mode */
+				PUTCODE(&vcodes[d+3]);
+				a0 = a1;
+			}
+		} else {				/* pass mode */
+			PUTCODE(&passcode);
+			a0 = b2;
+		}
+		if (a0 >= bits)
+			break;
+		/* a1: next change after a0 */
+		while (ch[ia] <= a0)
+			ia++;
+		a1 = ch[ia];
+		/* b1: next change after a0 to the color opposite a0's */
+		color = (int)(ia & 1);
+		while (rch[ib] <= a0)
+			ib++;
+		jb = ib + ((int)((ib & 1) ^ 1) == color);
+		b1 = rch[jb];
+	}
+	sp->data = data;
+	sp->bit = bit;
+	return (1);
+#undef PUTCODE
+}
+
+/*
+ * 2d-encode a row of pixels.  The changes of the reference
+ * line are kept from the previous row whenever possible.
+ */
+static int
+Fax3Encode2DRow(TIFF* tif, unsigned char* bp, unsigned char* rp, uint32 bits)
+{
+	Fax3CodecState* sp = EncoderState(tif);
+
+	Fax3FindChanges(bp, bits, sp->curruns);
+	if (!sp->refvalid)
+		Fax3FindChanges(rp, bits, sp->refruns);
+	return (Fax3Encode2DChanges(tif, bits));
+}
+
+/*
+ * 1d-encode a row given as changing elements in sp->curruns.
+ */
+static int
+Fax3Encode1DChanges(TIFF* tif, uint32 bits)
+{
+	Fax3CodecState* sp = EncoderState(tif);
+	uint32* ch = sp->curruns;
+	uint32 bs = 0;
+
+	for (;;) {
+		putspan(tif, ch[0] - bs, TIFFFaxWhiteCodes);
+		bs = ch[0];
+		if (bs >= bits)
+			break;
+		putspan(tif, ch[1] - bs, TIFFFaxBlackCodes);
+		bs = ch[1];
+		if (bs >= bits)
+			break;
+		ch += 2;
+	}
+	Fax3AlignRow(tif, sp);
+	return (1);
+}
+
+/*
+ * The reference line has been replaced: by the row just
+ * 2d-encoded, whose changes are then reused for the next
+ * row, or by other data.
+ */
+#define	Fax3RefLineIsRow(sp) {						\
+	uint32* t = (sp)->refruns;					\
+	(sp)->refruns = (sp)->curruns;					\
+	(sp)->curruns = t;						\
+	(sp)->refvalid = 1;						\
+}
+#define	Fax3RefLineChanged(sp)	((sp)->refvalid = 0)
+#else
 /*
  * 2d-encode a row of pixels.  Consult the CCITT
  * documentation for the algorithm.
@@ -1075,6 +1453,83 @@ Fax3Encode2DRow(TIFF* tif, unsigned char* bp, unsigned char* rp, uint32 bits)
 #undef PIXEL
 }
 
+#define	Fax3RefLineIsRow(sp)
+#define	Fax3RefLineChanged(sp)
+#endif
+
+/*
+ * Turn the alternating white/black runs passed to TIFFWriteFaxRuns
+ * into the changing elements of the row, in the format produced by
+ * Fax3FindChanges.  Empty runs merge their neighbours, the runs are
+ * clipped at bits and any pixels they leave uncovered are white.
+ */
+static void
+Fax3RunsToChanges(const uint32* runs, uint32 nruns, uint32 bits, uint32* ch)
+{
+	uint32 i, x = 0, run;
+	int color = 0;
+
+	for (i = 0; i < nruns && x < bits; i++) {
+		run = runs[i];
+		if (run == 0)
+			continue;
+		if ((int)(i & 1) != color) {
+			*ch++ = x;
+			color ^= 1;
+		}
+		x = (run > bits - x ? bits : x + run);
+	}
+	if (color && x < bits)
+		*ch++ = x;
+	ch[0] = ch[1] = ch[2] = bits;
+}
+
+#if FAX3_FAST_ENCODE
+/*
+ * Encode the row passed to TIFFWriteFaxRuns straight from its
+ * changing elements; the pixels are never looked at.  The row
+ * is left in sp->refruns as the reference for the next one.
+ */
+static int
+Fax3EncodeRuns(TIFF* tif, int is2d)
+{
+	Fax3CodecState* sp = EncoderState(tif);
+	uint32 bits = sp->b.rowpixels;
+
+	Fax3RunsToChanges(sp->encruns, sp->nencruns, bits, sp->curruns);
+	sp->encruns = NULL;
+	if (is2d) {
+		if (!sp->refvalid)
+			Fax3FindChanges(sp->refline, bits, sp->refruns);
+		if (!Fax3Encode2DChanges(tif, bits))
+			return (0);
+	} else if (!Fax3Encode1DChanges(tif, bits))
+		return (0);
+	if (sp->refruns)
+		Fax3RefLineIsRow(sp);
+	return (1);
+}
+#else
+/*
+ * Expand the row passed to TIFFWriteFaxRuns into
+ * the scanline buffer for the bitmap encoder.
+ */
+static void
+Fax3ExpandRuns(Fax3CodecState* sp, unsigned char* bp)
+{
+	uint32 bits = sp->b.rowpixels;
+	uint32* ch = sp->curruns;
+	uint32 x;
+
+	Fax3RunsToChanges(sp->encruns, sp->nencruns, bits, ch);
+	_TIFFmemset(bp, 0, sp->b.rowbytes);
+	for (; ch[0] < bits; ch += 2)
+		for (x = ch[0]; x < ch[1]; x++)
+			bp[x>>3] |= 0x80 >> (x&7);
+	sp->encruns = NULL;
+}
+#endif
+
 /*
  * Encode a buffer of pixels.
  */
@@ -1086,9 +1541,31 @@ Fax3Encode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	(void) s;
 	if (cc % sp->b.rowbytes)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "Fractional scanlines cannot be written");
+		TIFFErrorExtR(tif, module, "Fractional scanlines cannot be written");
 		return (0);
 	}
+#if FAX3_FAST_ENCODE
+	if (sp->encruns != NULL) {		/* one row from TIFFWriteFaxRuns */
+		if ((sp->b.mode & FAXMODE_NOEOL) == 0)
+			Fax3PutEOL(tif);
+		if (!is2DEncoding(sp))
+			return (Fax3EncodeRuns(tif, 0));
+		if (!Fax3EncodeRuns(tif, sp->tag == G3_2D))
+			return (0);
+		if (sp->tag == G3_1D)
+			sp->tag = G3_2D;
+		else
+			sp->k--;
+		if (sp->k == 0) {
+			sp->tag = G3_1D;
+			sp->k = sp->maxk-1;
+		}
+		return (1);
+	}
+#else
+	if (sp->encruns != NULL)
+		Fax3ExpandRuns(sp, bp);
+#endif
 	while (cc > 0) {
 		if ((sp->b.mode & FAXMODE_NOEOL) == 0)
 			Fax3PutEOL(tif);
@@ -1097,11 +1574,13 @@ Fax3Encode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 				if (!Fax3Encode1DRow(tif, bp, sp->b.rowpixels))
 					return (0);
 				sp->tag = G3_2D;
+				Fax3RefLineChanged(sp);
 			} else {
 				if (!Fax3Encode2DRow(tif, bp, sp->refline,
 				    sp->b.rowpixels))
 					return (0);
 				sp->k--;
+				Fax3RefLineIsRow(sp);
 			}
 			if (sp->k == 0) {
 				sp->tag = G3_1D;
@@ -1159,11 +1638,13 @@ Fax3Cleanup(TIFF* tif)
 	tif->tif_tagmethods.printdir = sp->b.printdir;
 
 	if (sp->runs)
-		_TIFFfree(sp->runs);
+		_TIFFfreeExt(tif, sp->runs);
 	if (sp->refline)
-		_TIFFfree(sp->refline);
+		_TIFFfreeExt(tif, sp->refline);
+	if (sp->runsrow)
+		_TIFFfreeExt(tif, sp->runsrow);
 
-	_TIFFfree(tif->tif_data);
+	_TIFFfreeExt(tif, tif->tif_data);
 	tif->tif_data = NULL;
 
 	_TIFFSetDefaultCompressionState(tif);
@@ -1178,6 +1659,7 @@ Fax3Cleanup(TIFF* tif)
 static const TIFFField faxFields[] = {
     { TIFFTAG_FAXMODE, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, FALSE, FALSE, "FaxMode", NULL },
     { TIFFTAG_FAXFILLFUNC, 0, 0, TIFF_ANY, 0, TIFF_SETGET_OTHER, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, FALSE, FALSE, "FaxFillFunc", NULL },
+    { TIFFTAG_FAXRUNSFUNC, 0, 0, TIFF_ANY, 0, TIFF_SETGET_OTHER, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, FALSE, FALSE, "FaxRunsFunc", NULL },
     { TIFFTAG_BADFAXLINES, 1, 1, TIFF_LONG, 0, TIFF_SETGET_UINT32, TIFF_SETGET_UINT32, FIELD_BADFAXLINES, TRUE, FALSE, "BadFaxLines", NULL },
     { TIFFTAG_CLEANFAXDATA, 1, 1, TIFF_SHORT, 0, TIFF_SETGET_UINT16, TIFF_SETGET_UINT16, FIELD_CLEANFAXDATA, TRUE, FALSE, "CleanFaxData", NULL },
     { TIFFTAG_CONSECUTIVEBADFAXLINES, 1, 1, TIFF_LONG, 0, TIFF_SETGET_UINT32, TIFF_SETGET_UINT32, FIELD_BADFAXRUN, TRUE, FALSE, "ConsecutiveBadFaxLines", NULL }};
@@ -1204,6 +1686,10 @@ Fax3VSetField(TIFF* tif, uint32 tag, va_list ap)
 	case TIFFTAG_FAXFILLFUNC:
 		DecoderState(tif)->fill = va_arg(ap, TIFFFaxFillFunc);
 		return 1;			/* NB: pseudo tag */
+	case TIFFTAG_FAXRUNSFUNC:
+		DecoderState(tif)->runsfunc = va_arg(ap, TIFFFaxRunsFunc);
+		DecoderState(tif)->runsdata = va_arg(ap, void*);
+		return 1;			/* NB: pseudo tag */
 	case TIFFTAG_GROUP3OPTIONS:
 		/* XXX: avoid reading options if compression mismatches. */
 		if (tif->tif_dir.td_compression == COMPRESSION_CCITTFAX3)
@@ -1250,6 +1736,10 @@ Fax3VGetField(TIFF* tif, uint32 tag, va_list ap)
 	case TIFFTAG_FAXFILLFUNC:
 		*va_arg(ap, TIFFFaxFillFunc*) = DecoderState(tif)->fill;
 		break;
+	case TIFFTAG_FAXRUNSFUNC:
+		*va_arg(ap, TIFFFaxRunsFunc*) = DecoderState(tif)->runsfunc;
+		*va_arg(ap, void**) = DecoderState(tif)->runsdata;
+		break;
 	case TIFFTAG_GROUP3OPTIONS:
 	case TIFFTAG_GROUP4OPTIONS:
 		*va_arg(ap, uint32*) = sp->groupoptions;
@@ -1337,7 +1827,7 @@ InitCCITTFax3(TIFF* tif)
 	 * Merge codec-specific tag information.
 	 */
 	if (!_TIFFMergeFields(tif, faxFields, TIFFArrayCount(faxFields))) {
-		TIFFErrorExt(tif->tif_clientdata, "InitCCITTFax3",
+		TIFFErrorExtR(tif, "InitCCITTFax3",
 			"Merging common CCITT Fax codec-specific tags failed");
 		return 0;
 	}
@@ -1346,10 +1836,10 @@ InitCCITTFax3(TIFF* tif)
 	 * Allocate state block so tag methods have storage to record values.
 	 */
 	tif->tif_data = (uint8*)
-		_TIFFmalloc(sizeof (Fax3CodecState));
+		_TIFFmallocExt(tif, sizeof (Fax3CodecState));
 
 	if (tif->tif_data == NULL) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "No space for state block");
 		return (0);
 	}
@@ -1406,7 +1896,7 @@ TIFFInitCCITTFax3(TIFF* tif, int scheme)
 		 */
 		if (!_TIFFMergeFields(tif, fax3Fields,
 				      TIFFArrayCount(fax3Fields))) {
-			TIFFErrorExt(tif->tif_clientdata, "TIFFInitCCITTFax3",
+			TIFFErrorExtR(tif, "TIFFInitCCITTFax3",
 			"Merging CCITT Fax 3 codec-specific tags failed");
 			return 0;
 		}
@@ -1435,7 +1925,7 @@ Fax4Decode(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 	(void) s;
 	if (occ % sp->b.rowbytes)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "Fractional scanlines cannot be read");
+		TIFFErrorExtR(tif, module, "Fractional scanlines cannot be read");
 		return (-1);
 	}
 	CACHE_STATE(tif, sp);
@@ -1446,14 +1936,17 @@ Fax4Decode(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 		pb = sp->refruns;
 		b1 = *pb++;
 #ifdef FAX3_DEBUG
-		printf("\nBitAcc=%08X, BitsAvail = %d\n", BitAcc, BitsAvail);
+		printf("\nBitAcc=%08lX, BitsAvail = %d\n", (unsigned long) BitAcc, BitsAvail);
 		printf("-------------------- %d\n", tif->tif_row);
 		fflush(stdout);
 #endif
 		EXPAND2D(EOFG4);
                 if (EOLcnt)
                     goto EOFG4;
-		(*sp->fill)(buf, thisrun, pa, lastx);
+		if (!FILL_ROW()) {
+			UNCACHE_STATE(tif, sp);
+			return (-1);
+		}
 		SETVALUE(0);		/* imaginary change for reference */
 		SWAP(uint32*, sp->curruns, sp->refruns);
 		buf += sp->b.rowbytes;
@@ -1468,7 +1961,7 @@ Fax4Decode(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
                     fputs( "Bad EOFB\n", stderr );
 #endif                
                 ClrBits( 13 );
-		(*sp->fill)(buf, thisrun, pa, lastx);
+		(void) FILL_ROW();
 		UNCACHE_STATE(tif, sp);
 		return ( sp->line ? 1 : -1);	/* don't error on badly-terminated strips */
 	}
@@ -1488,13 +1981,21 @@ Fax4Encode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	(void) s;
 	if (cc % sp->b.rowbytes)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "Fractional scanlines cannot be written");
+		TIFFErrorExtR(tif, module, "Fractional scanlines cannot be written");
 		return (0);
 	}
+#if FAX3_FAST_ENCODE
+	if (sp->encruns != NULL)		/* one row from TIFFWriteFaxRuns */
+		return (Fax3EncodeRuns(tif, 1));
+#else
+	if (sp->encruns != NULL)
+		Fax3ExpandRuns(sp, bp);
+#endif
 	while (cc > 0) {
 		if (!Fax3Encode2DRow(tif, bp, sp->refline, sp->b.rowpixels))
 			return (0);
 		_TIFFmemcpy(sp->refline, bp, sp->b.rowbytes);
+		Fax3RefLineIsRow(sp);
 		bp += sp->b.rowbytes;
 		cc -= sp->b.rowbytes;
 	}
@@ -1524,7 +2025,7 @@ TIFFInitCCITTFax4(TIFF* tif, int scheme)
 		 */
 		if (!_TIFFMergeFields(tif, fax4Fields,
 				      TIFFArrayCount(fax4Fields))) {
-			TIFFErrorExt(tif->tif_clientdata, "TIFFInitCCITTFax4",
+			TIFFErrorExtR(tif, "TIFFInitCCITTFax4",
 			"Merging CCITT Fax 4 codec-specific tags failed");
 			return 0;
 		}
@@ -1549,6 +2050,17 @@ TIFFInitCCITTFax4(TIFF* tif, int scheme)
  * (Compression algorithms 2 and 32771)
  */
 
+#if FAX3_FAST_DECODE
+/*
+ * The byte and word alignment done at the end of RLE rows is defined in
+ * terms of the byte-wise refill, so keep using it here.
+ */
+#undef NeedBits8
+#undef NeedBits16
+#define NeedBits8(n,eoflab)	NeedBits8Bytewise(n,eoflab)
+#define NeedBits16(n,eoflab)	NeedBits16Bytewise(n,eoflab)
+#endif
+
 /*
  * Decode the requested amount of RLE-encoded data.
  */
@@ -1560,7 +2072,7 @@ Fax3DecodeRLE(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 	(void) s;
 	if (occ % sp->b.rowbytes)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "Fractional scanlines cannot be read");
+		TIFFErrorExtR(tif, module, "Fractional scanlines cannot be read");
 		return (-1);
 	}
 	CACHE_STATE(tif, sp);
@@ -1570,12 +2082,15 @@ Fax3DecodeRLE(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 		RunLength = 0;
 		pa = thisrun;
 #ifdef FAX3_DEBUG
-		printf("\nBitAcc=%08X, BitsAvail = %d\n", BitAcc, BitsAvail);
+		printf("\nBitAcc=%08lX, BitsAvail = %d\n", (unsigned long) BitAcc, BitsAvail);
 		printf("-------------------- %d\n", tif->tif_row);
 		fflush(stdout);
 #endif
 		EXPAND1D(EOFRLE);
-		(*sp->fill)(buf, thisrun, pa, lastx);
+		if (!FILL_ROW()) {
+			UNCACHE_STATE(tif, sp);
+			return (-1);
+		}
 		/*
 		 * Cleanup at the end of the row.
 		 */
@@ -1593,7 +2108,7 @@ Fax3DecodeRLE(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 		sp->line++;
 		continue;
 	EOFRLE:				/* premature EOF */
-		(*sp->fill)(buf, thisrun, pa, lastx);
+		(void) FILL_ROW();
 		UNCACHE_STATE(tif, sp);
 		return (-1);
 	}
@@ -1634,6 +2149,60 @@ TIFFInitCCITTRLEW(TIFF* tif, int scheme)
 	} else
 		return (0);
 }
+
+/*
+ * Write a row of a Group 3 or Group 4 image given as alternating
+ * white and black run lengths, white first, as they are handed to
+ * a TIFFTAG_FAXRUNSFUNC callback.  The row is encoded from the runs
+ * without being expanded to pixels; otherwise this works just like
+ * TIFFWriteScanline and the two may be mixed freely.
+ */
+int
+TIFFWriteFaxRuns(TIFF* tif, uint32 row, const uint32* runs, uint32 nruns)
+{
+	static const char module[] = "TIFFWriteFaxRuns";
+	Fax3CodecState* sp;
+	int status;
+
+	if (tif->tif_dir.td_compression != COMPRESSION_CCITTFAX3 &&
+	    tif->tif_dir.td_compression != COMPRESSION_CCITTFAX4) {
+		TIFFErrorExtR(tif, module,
+		    "Runs can only be written with Group 3 or 4 compression");
+		return (-1);
+	}
+	if (runs == NULL) {
+		TIFFErrorExtR(tif, module, "No runs given");
+		return (-1);
+	}
+	sp = EncoderState(tif);
+	if (sp->runsrow == NULL) {
+		tmsize_t size = TIFFScanlineSize(tif);
+		if (size == 0)
+			return (-1);
+		sp->runsrow = (unsigned char*) _TIFFmallocExt(tif, size);
+		if (sp->runsrow == NULL) {
+			TIFFErrorExtR(tif, module,
+			    "No space for scanline buffer");
+			return (-1);
+		}
+		_TIFFmemset(sp->runsrow, 0, size);
+	}
+	/* the codec picks the runs up in place of the scanline */
+	sp->encruns = runs;
+	sp->nencruns = nruns;
+	status = TIFFWriteScanline(tif, sp->runsrow, row, 0);
+	sp->encruns = NULL;
+	return (status);
+}
+#else /* CCITT_SUPPORT */
+int
+TIFFWriteFaxRuns(TIFF* tif, uint32 row, const uint32* runs, uint32 nruns)
+{
+	(void) row; (void) runs; (void) nruns;
+	TIFFErrorExtR(tif, "TIFFWriteFaxRuns",
+	    "CCITT compression support is not configured");
+	return (-1);
+}
 #endif /* CCITT_SUPPORT */
 
 /* vim: set ts=8 sts=8 sw=8 noet: */
@@ -133,8 +133,7 @@ extern const TIFFFaxTabEnt TIFFFaxBlackTable[];
  * we should be called again and get a premature EOF error;
  * otherwise we should get the right answer.
  */
-#ifndef NeedBits8
-#define NeedBits8(n,eoflab) do {					\
+#define NeedBits8Bytewise(n,eoflab) do {				\
     if (BitsAvail < (n)) {						\
 	if (EndOfData()) {						\
 	    if (BitsAvail == 0)			/* no valid bits */	\
@@ -146,9 +145,7 @@ extern const TIFFFaxTabEnt TIFFFaxBlackTable[];
 	}								\
     }									\
 } while (0)
-#endif
-#ifndef NeedBits16
-#define NeedBits16(n,eoflab) do {					\
+#define NeedBits16Bytewise(n,eoflab) do {				\
     if (BitsAvail < (n)) {						\
 	if (EndOfData()) {						\
 	    if (BitsAvail == 0)			/* no valid bits */	\
@@ -168,6 +165,11 @@ extern const TIFFFaxTabEnt TIFFFaxBlackTable[];
 	}								\
     }									\
 } while (0)
+#ifndef NeedBits8
+#define NeedBits8(n,eoflab)	NeedBits8Bytewise(n,eoflab)
+#endif
+#ifndef NeedBits16
+#define NeedBits16(n,eoflab)	NeedBits16Bytewise(n,eoflab)
 #endif
 #define GetBits(n)	(BitAcc & ((1<<(n))-1))
 #define ClrBits(n) do {							\
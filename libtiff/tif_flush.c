@@ -35,6 +35,16 @@ TIFFFlush(TIFF* tif)
 
     if (!TIFFFlushData(tif))
         return (0);
+
+    /* Strip/tile arrays streamed to the file are updated in place; a
+       directory already written points at them and needs no rewrite */
+    if( tif->tif_dir.td_strilewindow != NULL )
+    {
+        if (!_TIFFFlushStrileWindow(tif))
+            return (0);
+        if (tif->tif_diroff != 0)
+            tif->tif_flags &= ~TIFF_DIRTYSTRIP;
+    }
                 
     /* In update (r+) mode we try to detect the case where 
        only the strip/tile map has been altered, and we try to 
@@ -43,7 +53,8 @@ TIFFFlush(TIFF* tif)
                 
     if( (tif->tif_flags & TIFF_DIRTYSTRIP)
         && !(tif->tif_flags & TIFF_DIRTYDIRECT) 
-        && tif->tif_mode == O_RDWR )
+        && tif->tif_mode == O_RDWR
+        && !isDirReserved(tif) )
     {
         uint64  *offsets=NULL, *sizes=NULL;
 
@@ -58,7 +69,7 @@ TIFFFlush(TIFF* tif)
             {
                 tif->tif_flags &= ~TIFF_DIRTYSTRIP;
                 tif->tif_flags &= ~TIFF_BEENWRITING;
-                return 1;
+                return _TIFFWriteBufferFlush(tif);
             }
         }
         else
@@ -72,7 +83,7 @@ TIFFFlush(TIFF* tif)
             {
                 tif->tif_flags &= ~TIFF_DIRTYSTRIP;
                 tif->tif_flags &= ~TIFF_BEENWRITING;
-                return 1;
+                return _TIFFWriteBufferFlush(tif);
             }
         }
     }
@@ -81,7 +92,7 @@ TIFFFlush(TIFF* tif)
         && !TIFFRewriteDirectory(tif))
         return (0);
 
-    return (1);
+    return (_TIFFWriteBufferFlush(tif));
 }
 
 /*
@@ -98,6 +109,8 @@ TIFFFlushData(TIFF* tif)
 {
 	if ((tif->tif_flags & TIFF_BEENWRITING) == 0)
 		return (1);
+	if (!_TIFFFlushTileRows(tif))
+		return (0);
 	if (tif->tif_flags & TIFF_POSTENCODE) {
 		tif->tif_flags &= ~TIFF_POSTENCODE;
 		if (!(*tif->tif_postencode)(tif))
@@ -30,12 +30,20 @@
 #include "tiffiop.h"
 #include <stdio.h>
 
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#elif defined(TIFF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
 static int gtTileContig(TIFFRGBAImage*, uint32*, uint32, uint32);
 static int gtTileSeparate(TIFFRGBAImage*, uint32*, uint32, uint32);
 static int gtStripContig(TIFFRGBAImage*, uint32*, uint32, uint32);
 static int gtStripSeparate(TIFFRGBAImage*, uint32*, uint32, uint32);
 static int PickContigCase(TIFFRGBAImage*);
 static int PickSeparateCase(TIFFRGBAImage*);
+static int setorientation(TIFFRGBAImage*);
 
 static int BuildMapUaToAa(TIFFRGBAImage* img);
 static int BuildMapBitdepth16To8(TIFFRGBAImage* img);
@@ -214,38 +222,38 @@ void
 TIFFRGBAImageEnd(TIFFRGBAImage* img)
 {
 	if (img->Map) {
-		_TIFFfree(img->Map);
+		_TIFFfreeExt(img->tif, img->Map);
 		img->Map = NULL;
 	}
 	if (img->BWmap) {
-		_TIFFfree(img->BWmap);
+		_TIFFfreeExt(img->tif, img->BWmap);
 		img->BWmap = NULL;
 	}
 	if (img->PALmap) {
-		_TIFFfree(img->PALmap);
+		_TIFFfreeExt(img->tif, img->PALmap);
 		img->PALmap = NULL;
 	}
 	if (img->ycbcr) {
-		_TIFFfree(img->ycbcr);
+		_TIFFfreeExt(img->tif, img->ycbcr);
 		img->ycbcr = NULL;
 	}
 	if (img->cielab) {
-		_TIFFfree(img->cielab);
+		_TIFFfreeExt(img->tif, img->cielab);
 		img->cielab = NULL;
 	}
 	if (img->UaToAa) {
-		_TIFFfree(img->UaToAa);
+		_TIFFfreeExt(img->tif, img->UaToAa);
 		img->UaToAa = NULL;
 	}
 	if (img->Bitdepth16To8) {
-		_TIFFfree(img->Bitdepth16To8);
+		_TIFFfreeExt(img->tif, img->Bitdepth16To8);
 		img->Bitdepth16To8 = NULL;
 	}
 
 	if( img->redcmap ) {
-		_TIFFfree( img->redcmap );
-		_TIFFfree( img->greencmap );
-		_TIFFfree( img->bluecmap );
+		_TIFFfreeExt(img->tif,  img->redcmap );
+		_TIFFfreeExt(img->tif,  img->greencmap );
+		_TIFFfreeExt(img->tif,  img->bluecmap );
                 img->redcmap = img->greencmap = img->bluecmap = NULL;
 	}
 }
@@ -365,9 +373,9 @@ TIFFRGBAImageBegin(TIFFRGBAImage* img, TIFF* tif, int stop, char emsg[1024])
 
 			/* copy the colormaps so we can modify them */
 			n_color = (1U << img->bitspersample);
-			img->redcmap = (uint16 *) _TIFFmalloc(sizeof(uint16)*n_color);
-			img->greencmap = (uint16 *) _TIFFmalloc(sizeof(uint16)*n_color);
-			img->bluecmap = (uint16 *) _TIFFmalloc(sizeof(uint16)*n_color);
+			img->redcmap = (uint16 *) _TIFFmallocExt(tif, sizeof(uint16)*n_color);
+			img->greencmap = (uint16 *) _TIFFmallocExt(tif, sizeof(uint16)*n_color);
+			img->bluecmap = (uint16 *) _TIFFmallocExt(tif, sizeof(uint16)*n_color);
 			if( !img->redcmap || !img->greencmap || !img->bluecmap ) {
 				sprintf(emsg, "Out of memory for colormap copy");
                                 goto fail_return;
@@ -500,17 +508,135 @@ int
 TIFFRGBAImageGet(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 {
     if (img->get == NULL) {
-		TIFFErrorExt(img->tif->tif_clientdata, TIFFFileName(img->tif), "No \"get\" routine setup");
+		TIFFErrorExtR(img->tif, TIFFFileName(img->tif), "No \"get\" routine setup");
 		return (0);
 	}
 	if (img->put.any == NULL) {
-		TIFFErrorExt(img->tif->tif_clientdata, TIFFFileName(img->tif),
+		TIFFErrorExtR(img->tif, TIFFFileName(img->tif),
 		"No \"put\" routine setupl; probably can not handle image format");
 		return (0);
     }
     return (*img->get)(img, raster, w, h);
 }
 
+typedef struct {
+	TIFFRGBAImage	img;		/* copy of the caller's state */
+	uint32*		raster;
+	uint32		w, h;
+	uint32		band;		/* rows per band */
+	int		flip;
+	TIFFMutex*	jobmutex;	/* protects next and failed */
+	uint32*		next;		/* first row of the next band */
+	int*		failed;
+} TIFFRGBAJob;
+
+static void
+gtParallelThread(void* arg)
+{
+	TIFFRGBAJob* job = (TIFFRGBAJob*) arg;
+	TIFFRGBAImage* img = &job->img;
+	uint32 row_offset = img->row_offset;
+
+	for (;;) {
+		uint32 r0, nrow;
+		int ok;
+
+		_TIFFMutexLock(job->jobmutex);
+		r0 = *job->next;
+		if (r0 >= job->h || *job->failed) {
+			_TIFFMutexUnlock(job->jobmutex);
+			break;
+		}
+		/* bands end on strip or tile boundaries of the image */
+		nrow = job->band - (r0 + row_offset) % job->band;
+		if (nrow > job->h - r0)
+			nrow = job->h - r0;
+		*job->next = r0 + nrow;
+		_TIFFMutexUnlock(job->jobmutex);
+
+		img->row_offset = row_offset + r0;
+		ok = (*img->get)(img, job->raster + (tmsize_t)job->w *
+		    ((job->flip & FLIP_VERTICALLY) ? job->h - r0 - nrow : r0),
+		    job->w, nrow);
+		if (!ok) {
+			_TIFFMutexLock(job->jobmutex);
+			*job->failed = 1;
+			_TIFFMutexUnlock(job->jobmutex);
+			break;
+		}
+	}
+}
+
+/*
+ * Like TIFFRGBAImageGet(), but with bands of strips or tiles decoded
+ * and converted by up to nthreads threads (the number of processors
+ * if nthreads <= 0).  Images that cannot be read concurrently are
+ * handled by TIFFRGBAImageGet().
+ */
+int
+TIFFRGBAImageGetParallel(TIFFRGBAImage* img, uint32* raster, uint32 w,
+    uint32 h, int nthreads)
+{
+	TIFF* tif = img->tif;
+	TIFFRGBAJob* jobs = NULL;
+	void** args = NULL;
+	TIFFMutex* jobmutex = NULL;
+	uint32 band, next = 0;
+	int failed = 0, flip, t;
+
+	if (img->get == NULL || img->put.any == NULL)
+		return (TIFFRGBAImageGet(img, raster, w, h));
+	if (nthreads <= 0)
+		nthreads = _TIFFThreadConcurrency(tif);
+	if (nthreads > TIFF_MAX_WORKER_THREADS)
+		nthreads = TIFF_MAX_WORKER_THREADS;
+	if (isTiled(tif))
+		TIFFGetField(tif, TIFFTAG_TILELENGTH, &band);
+	else
+		TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &band);
+	if (band == 0 || band > img->height)
+		band = img->height;
+	/* a few bands per thread, each a whole number of strips or tiles */
+	if (band < h / (4 * (uint32) nthreads))
+		band *= h / (4 * (uint32) nthreads) / band;
+	if ((uint32) nthreads > h / band + 1)
+		nthreads = (int)(h / band + 1);
+	if (nthreads > 1 && _TIFFCanDecodeInParallel(tif) &&
+	    _TIFFGetDecodeWorkers(tif, nthreads) &&
+	    (jobmutex = _TIFFMutexCreate()) != NULL) {
+		jobs = (TIFFRGBAJob*) _TIFFmallocExt(tif, nthreads * sizeof(TIFFRGBAJob));
+		args = (void**) _TIFFmallocExt(tif, nthreads * sizeof(void*));
+	}
+	if (jobs == NULL || args == NULL) {
+		if (jobs)
+			_TIFFfreeExt(tif, jobs);
+		if (args)
+			_TIFFfreeExt(tif, args);
+		_TIFFMutexDestroy(jobmutex);
+		return (TIFFRGBAImageGet(img, raster, w, h));
+	}
+
+	flip = setorientation(img);
+	for (t = 0; t < nthreads; t++) {
+		jobs[t].img = *img;
+		jobs[t].img.tif = tif->tif_workers[t];
+		jobs[t].raster = raster;
+		jobs[t].w = w;
+		jobs[t].h = h;
+		jobs[t].band = band;
+		jobs[t].flip = flip;
+		jobs[t].jobmutex = jobmutex;
+		jobs[t].next = &next;
+		jobs[t].failed = &failed;
+		args[t] = &jobs[t];
+	}
+	_TIFFRunTasks(tif, nthreads, gtParallelThread, args);
+	_TIFFfreeExt(tif, jobs);
+	_TIFFfreeExt(tif, args);
+	_TIFFMutexDestroy(jobmutex);
+	return (!failed);
+}
+
 /*
  * Read the specified image into an ABGR-format rastertaking in account
  * specified orientation.
@@ -531,7 +657,7 @@ TIFFReadRGBAImageOriented(TIFF* tif,
 			rwidth, img.height);
 		TIFFRGBAImageEnd(&img);
 	} else {
-		TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif), "%s", emsg);
+		TIFFErrorExtR(tif, TIFFFileName(tif), "%s", emsg);
 		ok = 0;
     }
     return (ok);
@@ -610,6 +736,53 @@ setorientation(TIFFRGBAImage* img)
 	}
 }
 
+/*
+ * Read a tile or strip for one of the get routines, allocating *buf
+ * of bufsize bytes if it is NULL.  On a worker handle of
+ * TIFFRGBAImageGetParallel() the raw data is fetched through the
+ * handle the worker was opened from.
+ */
+static tmsize_t
+gtReadTile(TIFF* tif, void** buf, tmsize_t bufsize, uint32 x, uint32 y,
+    uint16 s)
+{
+	if (tif->tif_master == NULL)
+		return (_TIFFReadTileAndAllocBuffer(tif, buf, bufsize,
+		    x, y, 0, s));
+	if (!TIFFCheckTile(tif, x, y, 0, s))
+		return ((tmsize_t)(-1));
+	if (*buf == NULL) {
+		*buf = _TIFFmallocExt(tif, bufsize);
+		if (*buf == NULL) {
+			TIFFErrorExtR(tif, TIFFFileName(tif),
+			    "No space for tile buffer");
+			return ((tmsize_t)(-1));
+		}
+		_TIFFmemset(*buf, 0, bufsize);
+	}
+	return (_TIFFReadEncodedShared(tif, TIFFComputeTile(tif, x, y, 0, s),
+	    *buf, (tmsize_t)(-1)));
+}
+
+static tmsize_t
+gtReadStrip(TIFF* tif, uint32 strip, void** buf, tmsize_t bufsize,
+    tmsize_t size)
+{
+	if (tif->tif_master == NULL)
+		return (_TIFFReadEncodedStripAndAllocBuffer(tif, strip, buf,
+		    bufsize, size));
+	if (*buf == NULL) {
+		*buf = _TIFFmallocExt(tif, bufsize);
+		if (*buf == NULL) {
+			TIFFErrorExtR(tif, TIFFFileName(tif),
+			    "No space for strip buffer");
+			return ((tmsize_t)(-1));
+		}
+		_TIFFmemset(*buf, 0, bufsize);
+	}
+	return (_TIFFReadEncodedShared(tif, strip, *buf, size));
+}
+
 /*
  * Get an tile-organized image that has
  *	PlanarConfiguration contiguous if SamplesPerPixel > 1
@@ -636,7 +809,7 @@ gtTileContig(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 
     bufsize = TIFFTileSize(tif);
     if (bufsize == 0) {
-        TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif), "%s", "No space for tile buffer");
+        TIFFErrorExtR(tif, TIFFFileName(tif), "%s", "No space for tile buffer");
         return (0);
     }
 
@@ -661,6 +834,11 @@ gtTileContig(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
     leftmost_toskew = toskew + leftmost_fromskew;
     for (row = 0; ret != 0 && row < h; row += nrow)
     {
+        if (_TIFFCheckCancel(tif, TIFFFileName(tif)))
+        {
+            ret = 0;
+            break;
+        }
         rowstoread = th - (row + img->row_offset) % th;
     	nrow = (row + rowstoread > h ? h - row : rowstoread);
 	fromskew = leftmost_fromskew;
@@ -670,8 +848,8 @@ gtTileContig(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 	col = img->col_offset;
 	while (tocol < w)
         {
-	    if (_TIFFReadTileAndAllocBuffer(tif, (void**) &buf, bufsize, col,
-			     row+img->row_offset, 0, 0)==(tmsize_t)(-1) &&
+	    if (gtReadTile(tif, (void**) &buf, bufsize, col,
+			     row+img->row_offset, 0)==(tmsize_t)(-1) &&
                 (buf == NULL || img->stoponerr))
             {
                 ret = 0;
@@ -701,7 +879,7 @@ gtTileContig(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 
         y += ((flip & FLIP_VERTICALLY) ? -(int32) nrow : (int32) nrow);
     }
-    _TIFFfree(buf);
+    _TIFFfreeExt(tif, buf);
 
     if (flip & FLIP_HORIZONTALLY) {
 	    uint32 line;
@@ -757,7 +935,7 @@ gtTileSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 	tilesize = TIFFTileSize(tif);  
 	bufsize = TIFFSafeMultiply(tmsize_t,alpha?4:3,tilesize);
 	if (bufsize == 0) {
-		TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif), "Integer overflow in %s", "gtTileSeparate");
+		TIFFErrorExtR(tif, TIFFFileName(tif), "Integer overflow in %s", "gtTileSeparate");
 		return (0);
 	}
 
@@ -795,6 +973,10 @@ gtTileSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 	leftmost_toskew = toskew + leftmost_fromskew;
 	for (row = 0; ret != 0 && row < h; row += nrow)
 	{
+		if (_TIFFCheckCancel(tif, TIFFFileName(tif))) {
+			ret = 0;
+			break;
+		}
 		rowstoread = th - (row + img->row_offset) % th;
 		nrow = (row + rowstoread > h ? h - row : rowstoread);
 		fromskew = leftmost_fromskew;
@@ -806,9 +988,9 @@ gtTileSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 		{
                         if( buf == NULL )
                         {
-                            if (_TIFFReadTileAndAllocBuffer(
+                            if (gtReadTile(
                                     tif, (void**) &buf, bufsize, col,
-                                    row+img->row_offset,0,0)==(tmsize_t)(-1)
+                                    row+img->row_offset,0)==(tmsize_t)(-1)
                                 && (buf == NULL || img->stoponerr))
                             {
                                     ret = 0;
@@ -827,31 +1009,31 @@ gtTileSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
                                 pa = (alpha?(p2+tilesize):NULL);
                             }
                         }
-			else if (TIFFReadTile(tif, p0, col,  
-			    row+img->row_offset,0,0)==(tmsize_t)(-1) && img->stoponerr)
+			else if (gtReadTile(tif, (void**) &p0, 0, col,
+			    row+img->row_offset,0)==(tmsize_t)(-1) && img->stoponerr)
 			{
 				ret = 0;
 				break;
 			}
 			if (colorchannels > 1 
-                            && TIFFReadTile(tif, p1, col,  
-                                            row+img->row_offset,0,1) == (tmsize_t)(-1) 
+                            && gtReadTile(tif, (void**) &p1, 0, col,
+                                            row+img->row_offset,1) == (tmsize_t)(-1) 
                             && img->stoponerr)
 			{
 				ret = 0;
 				break;
 			}
 			if (colorchannels > 1 
-                            && TIFFReadTile(tif, p2, col,  
-                                            row+img->row_offset,0,2) == (tmsize_t)(-1) 
+                            && gtReadTile(tif, (void**) &p2, 0, col,
+                                            row+img->row_offset,2) == (tmsize_t)(-1) 
                             && img->stoponerr)
 			{
 				ret = 0;
 				break;
 			}
 			if (alpha
-                            && TIFFReadTile(tif,pa,col,  
-                                            row+img->row_offset,0,colorchannels) == (tmsize_t)(-1) 
+                            && gtReadTile(tif, (void**) &pa, 0, col,
+                                            row+img->row_offset,colorchannels) == (tmsize_t)(-1) 
                             && img->stoponerr)
                         {
                             ret = 0;
@@ -901,7 +1083,7 @@ gtTileSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 		}
 	}
 
-	_TIFFfree(buf);
+	_TIFFfreeExt(tif, buf);
 	return (ret);
 }
 
@@ -929,7 +1111,7 @@ gtStripContig(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 
 	TIFFGetFieldDefaulted(tif, TIFFTAG_YCBCRSUBSAMPLING, &subsamplinghor, &subsamplingver);
 	if( subsamplingver == 0 ) {
-		TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif), "Invalid vertical YCbCr subsampling");
+		TIFFErrorExtR(tif, TIFFFileName(tif), "Invalid vertical YCbCr subsampling");
 		return (0);
 	}
 	
@@ -950,12 +1132,16 @@ gtStripContig(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 	fromskew = (w < imagewidth ? imagewidth - w : 0);
 	for (row = 0; row < h; row += nrow)
 	{
+		if (_TIFFCheckCancel(tif, TIFFFileName(tif))) {
+			ret = 0;
+			break;
+		}
 		rowstoread = rowsperstrip - (row + img->row_offset) % rowsperstrip;
 		nrow = (row + rowstoread > h ? h - row : rowstoread);
 		nrowsub = nrow;
 		if ((nrowsub%subsamplingver)!=0)
 			nrowsub+=subsamplingver-nrowsub%subsamplingver;
-		if (_TIFFReadEncodedStripAndAllocBuffer(tif,
+		if (gtReadStrip(tif,
 		    TIFFComputeStrip(tif,row+img->row_offset, 0),
 		    (void**)(&buf),
                     maxstripsize,
@@ -989,7 +1175,7 @@ gtStripContig(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 		}
 	}
 
-	_TIFFfree(buf);
+	_TIFFfreeExt(tif, buf);
 	return (ret);
 }
 
@@ -1021,7 +1207,7 @@ gtStripSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 	stripsize = TIFFStripSize(tif);  
 	bufsize = TIFFSafeMultiply(tmsize_t,alpha?4:3,stripsize);
 	if (bufsize == 0) {
-		TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif), "Integer overflow in %s", "gtStripSeparate");
+		TIFFErrorExtR(tif, TIFFFileName(tif), "Integer overflow in %s", "gtStripSeparate");
 		return (0);
 	}
 
@@ -1053,12 +1239,16 @@ gtStripSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 	fromskew = (w < imagewidth ? imagewidth - w : 0);
 	for (row = 0; row < h; row += nrow)
 	{
+		if (_TIFFCheckCancel(tif, TIFFFileName(tif))) {
+			ret = 0;
+			break;
+		}
 		rowstoread = rowsperstrip - (row + img->row_offset) % rowsperstrip;
 		nrow = (row + rowstoread > h ? h - row : rowstoread);
 		offset_row = row + img->row_offset;
                 if( buf == NULL )
                 {
-                    if (_TIFFReadEncodedStripAndAllocBuffer(
+                    if (gtReadStrip(
                             tif, TIFFComputeStrip(tif, offset_row, 0),
                             (void**) &buf, bufsize,
                             ((row + img->row_offset)%rowsperstrip + nrow) * scanline)==(tmsize_t)(-1)
@@ -1080,24 +1270,24 @@ gtStripSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
                         pa = (alpha?(p2+stripsize):NULL);
                     }
                 }
-		else if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, offset_row, 0),
-		    p0, ((row + img->row_offset)%rowsperstrip + nrow) * scanline)==(tmsize_t)(-1)
+		else if (gtReadStrip(tif, TIFFComputeStrip(tif, offset_row, 0),
+		    (void**) &p0, 0, ((row + img->row_offset)%rowsperstrip + nrow) * scanline)==(tmsize_t)(-1)
 		    && img->stoponerr)
 		{
 			ret = 0;
 			break;
 		}
 		if (colorchannels > 1 
-                    && TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, offset_row, 1),
-                                            p1, ((row + img->row_offset)%rowsperstrip + nrow) * scanline) == (tmsize_t)(-1)
+                    && gtReadStrip(tif, TIFFComputeStrip(tif, offset_row, 1),
+                                            (void**) &p1, 0, ((row + img->row_offset)%rowsperstrip + nrow) * scanline) == (tmsize_t)(-1)
 		    && img->stoponerr)
 		{
 			ret = 0;
 			break;
 		}
 		if (colorchannels > 1 
-                    && TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, offset_row, 2),
-                                            p2, ((row + img->row_offset)%rowsperstrip + nrow) * scanline) == (tmsize_t)(-1)
+                    && gtReadStrip(tif, TIFFComputeStrip(tif, offset_row, 2),
+                                            (void**) &p2, 0, ((row + img->row_offset)%rowsperstrip + nrow) * scanline) == (tmsize_t)(-1)
 		    && img->stoponerr)
 		{
 			ret = 0;
@@ -1105,8 +1295,8 @@ gtStripSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 		}
 		if (alpha)
 		{
-			if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, offset_row, colorchannels),
-			    pa, ((row + img->row_offset)%rowsperstrip + nrow) * scanline)==(tmsize_t)(-1)
+			if (gtReadStrip(tif, TIFFComputeStrip(tif, offset_row, colorchannels),
+			    (void**) &pa, 0, ((row + img->row_offset)%rowsperstrip + nrow) * scanline)==(tmsize_t)(-1)
 			    && img->stoponerr)
 			{
 				ret = 0;
@@ -1138,7 +1328,7 @@ gtStripSeparate(TIFFRGBAImage* img, uint32* raster, uint32 w, uint32 h)
 		}
 	}
 
-	_TIFFfree(buf);
+	_TIFFfreeExt(tif, buf);
 	return (ret);
 }
 
@@ -1227,6 +1417,790 @@ static void name(\
     unsigned char* pp \
 )
 
+/*
+ * SIMD packing of 8-bit samples into ABGR pixels for the most common
+ * cases.  Each kernel packs a prefix of the w pixels of a row and
+ * returns the number it handled; the put routine packs the rest.
+ * The byte order of a packed pixel in memory is R, G, B, A, so these
+ * are only used on little-endian hosts.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSE2
+static uint32
+packRGB8SSE2(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel)
+{
+	const __m128i a1 = _mm_set1_epi32((int) A1);
+	uint32 x;
+
+	if (samplesperpixel != 4)
+		return (0);
+	for (x = 0; x + 4 <= w; x += 4, pp += 16)
+		_mm_storeu_si128((__m128i*) (cp + x), _mm_or_si128(
+		    _mm_loadu_si128((const __m128i*) pp), a1));
+	return (x);
+}
+
+/*
+ * 16 RGB triples fill 3 vectors; each group of 4 is moved to the low
+ * 12 bytes of a vector and spread into 4 pixels.
+ */
+TIFF_TARGET_SSSE3
+static uint32
+packRGB8SSSE3(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel)
+{
+	const __m128i a1 = _mm_set1_epi32((int) A1);
+	const __m128i m = _mm_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128,
+	    6, 7, 8, -128, 9, 10, 11, -128);
+	uint32 x;
+	__m128i a, b, c;
+
+	if (samplesperpixel != 3)
+		return (packRGB8SSE2(cp, pp, w, samplesperpixel));
+	for (x = 0; x + 16 <= w; x += 16, pp += 48) {
+		a = _mm_loadu_si128((const __m128i*) pp);
+		b = _mm_loadu_si128((const __m128i*) (pp + 16));
+		c = _mm_loadu_si128((const __m128i*) (pp + 32));
+		_mm_storeu_si128((__m128i*) (cp + x), _mm_or_si128(
+		    _mm_shuffle_epi8(a, m), a1));
+		_mm_storeu_si128((__m128i*) (cp + x + 4), _mm_or_si128(
+		    _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), m), a1));
+		_mm_storeu_si128((__m128i*) (cp + x + 8), _mm_or_si128(
+		    _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), m), a1));
+		_mm_storeu_si128((__m128i*) (cp + x + 12), _mm_or_si128(
+		    _mm_shuffle_epi8(_mm_srli_si128(c, 4), m), a1));
+	}
+	return (x);
+}
+
+/*
+ * Premultiply 2 pixels widened to 16 bits by their alpha exactly like
+ * the UaToAa table does: (v*a+127)/255, with the division by 255
+ * done as (x+1+(x>>8))>>8, which is exact for x < 65536.
+ */
+TIFF_TARGET_SSE2
+static __m128i
+premultiply2SSE2(__m128i v)
+{
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v,
+	    _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+	v = _mm_add_epi16(_mm_mullo_epi16(v, a), _mm_set1_epi16(127));
+	v = _mm_add_epi16(v, _mm_add_epi16(_mm_srli_epi16(v, 8),
+	    _mm_set1_epi16(1)));
+	return (_mm_srli_epi16(v, 8));
+}
+
+TIFF_TARGET_SSE2
+static uint32
+packRGBUA8SSE2(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel)
+{
+	const __m128i a1 = _mm_set1_epi32((int) A1);
+	const __m128i zero = _mm_setzero_si128();
+	uint32 x;
+	__m128i v, p;
+
+	if (samplesperpixel != 4)
+		return (0);
+	for (x = 0; x + 4 <= w; x += 4, pp += 16) {
+		v = _mm_loadu_si128((const __m128i*) pp);
+		p = _mm_packus_epi16(
+		    premultiply2SSE2(_mm_unpacklo_epi8(v, zero)),
+		    premultiply2SSE2(_mm_unpackhi_epi8(v, zero)));
+		_mm_storeu_si128((__m128i*) (cp + x), _mm_or_si128(
+		    _mm_andnot_si128(a1, p), _mm_and_si128(a1, v)));
+	}
+	return (x);
+}
+
+/*
+ * 8-bit grey levels are mapped to themselves (MinIsBlack) or to their
+ * complement (MinIsWhite), so the BWmap lookup is an exclusive or.
+ */
+TIFF_TARGET_SSE2
+static uint32
+packGrey8SSE2(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel,
+    int invert)
+{
+	const __m128i inv = _mm_set1_epi8((char) (invert ? 0xff : 0));
+	const __m128i ff = _mm_set1_epi8((char) 0xff);
+	const __m128i lo = _mm_set1_epi16(0xff);
+	uint32 x;
+	__m128i v, gg, ga;
+
+	if (samplesperpixel != 1 && samplesperpixel != 2)
+		return (0);
+	for (x = 0; x + 16 <= w; x += 16) {
+		if (samplesperpixel == 1) {
+			v = _mm_loadu_si128((const __m128i*) pp);
+			pp += 16;
+		} else {
+			v = _mm_packus_epi16(_mm_and_si128(lo,
+			    _mm_loadu_si128((const __m128i*) pp)),
+			    _mm_and_si128(lo,
+			    _mm_loadu_si128((const __m128i*) (pp + 16))));
+			pp += 32;
+		}
+		v = _mm_xor_si128(v, inv);
+		gg = _mm_unpacklo_epi8(v, v);
+		ga = _mm_unpacklo_epi8(v, ff);
+		_mm_storeu_si128((__m128i*) (cp + x),
+		    _mm_unpacklo_epi16(gg, ga));
+		_mm_storeu_si128((__m128i*) (cp + x + 4),
+		    _mm_unpackhi_epi16(gg, ga));
+		gg = _mm_unpackhi_epi8(v, v);
+		ga = _mm_unpackhi_epi8(v, ff);
+		_mm_storeu_si128((__m128i*) (cp + x + 8),
+		    _mm_unpacklo_epi16(gg, ga));
+		_mm_storeu_si128((__m128i*) (cp + x + 12),
+		    _mm_unpackhi_epi16(gg, ga));
+	}
+	return (x);
+}
+#elif defined(TIFF_SIMD_NEON) && !defined(WORDS_BIGENDIAN)
+static uint32
+packRGB8NEON(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel)
+{
+	uint32 x;
+	uint8x16x3_t v3;
+	uint8x16x4_t v;
+
+	if (samplesperpixel != 3 && samplesperpixel != 4)
+		return (0);
+	v.val[3] = vdupq_n_u8(0xff);
+	for (x = 0; x + 16 <= w; x += 16, pp += 16 * samplesperpixel) {
+		if (samplesperpixel == 3) {
+			v3 = vld3q_u8(pp);
+			v.val[0] = v3.val[0];
+			v.val[1] = v3.val[1];
+			v.val[2] = v3.val[2];
+		} else {
+			v = vld4q_u8(pp);
+			v.val[3] = vdupq_n_u8(0xff);
+		}
+		vst4q_u8((uint8*) (cp + x), v);
+	}
+	return (x);
+}
+
+/*
+ * (v*a+127)/255 as in the UaToAa table; see premultiply2SSE2().
+ */
+static uint8x8_t
+premultiply8NEON(uint8x8_t v, uint8x8_t a)
+{
+	uint16x8_t t = vaddq_u16(vmull_u8(v, a), vdupq_n_u16(127));
+
+	return (vshrn_n_u16(vsraq_n_u16(vaddq_u16(t, vdupq_n_u16(1)), t, 8), 8));
+}
+
+static uint32
+packRGBUA8NEON(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel)
+{
+	uint32 x;
+	uint8x16x4_t v;
+	int i;
+
+	if (samplesperpixel != 4)
+		return (0);
+	for (x = 0; x + 16 <= w; x += 16, pp += 64) {
+		v = vld4q_u8(pp);
+		for (i = 0; i < 3; i++)
+			v.val[i] = vcombine_u8(
+			    premultiply8NEON(vget_low_u8(v.val[i]),
+			    vget_low_u8(v.val[3])),
+			    premultiply8NEON(vget_high_u8(v.val[i]),
+			    vget_high_u8(v.val[3])));
+		vst4q_u8((uint8*) (cp + x), v);
+	}
+	return (x);
+}
+
+static uint32
+packGrey8NEON(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel,
+    int invert)
+{
+	const uint8x16_t inv = vdupq_n_u8(invert ? 0xff : 0);
+	uint32 x;
+	uint8x16_t g;
+	uint8x16x4_t v;
+
+	if (samplesperpixel != 1 && samplesperpixel != 2)
+		return (0);
+	v.val[3] = vdupq_n_u8(0xff);
+	for (x = 0; x + 16 <= w; x += 16, pp += 16 * samplesperpixel) {
+		g = samplesperpixel == 1 ? vld1q_u8(pp) : vld2q_u8(pp).val[0];
+		g = veorq_u8(g, inv);
+		v.val[0] = g;
+		v.val[1] = g;
+		v.val[2] = g;
+		vst4q_u8((uint8*) (cp + x), v);
+	}
+	return (x);
+}
+#endif
+
+/*
+ * SIMD YCbCr to RGB conversion of rows of 8-bit packed YCbCr blocks
+ * with 1x1, 2x1 and 2x2 subsampling, using the fixed point form of
+ * the conversion given by _TIFFYCbCrFixedPoint().  The kernel
+ * converts a prefix of the w pixels of the row(s) at cp (and cp2
+ * with 2x2 subsampling, unless it is NULL) and returns the number of
+ * pixels it handled, always a multiple of 16.
+ */
+#if defined(TIFF_SIMD_X86)
+typedef struct {
+	__m128i r, rh;		/* Cr and 2 by (D1 low, 2^14), D1 high */
+	__m128i b, bh;		/* Cb and 2 by (D3 low, 2^14), D3 high */
+	__m128i g, gbh, grh;	/* Cb and Cr by (D4 low, D2 low), highs */
+} YCbCrCoefSSE2;
+
+/*
+ * Each coefficient is split as D = H*2^16 + L with L signed 16 bit,
+ * so that (D*x + 2^15) >> 16 = H*x + ((L*x + 2^15) >> 16) can be
+ * computed with 16 bit multiplies.
+ */
+#define	COEFHI(d)	((int16) (((d) + 32768) >> 16))
+#define	COEFLO(d)	((int16) ((d) - COEFHI(d) * 65536))
+
+TIFF_TARGET_SSE2
+static void
+ycbcrCoefSSE2(YCbCrCoefSSE2* k, const int32* D)
+{
+	k->r = _mm_set_epi16(16384, COEFLO(D[0]), 16384, COEFLO(D[0]),
+	    16384, COEFLO(D[0]), 16384, COEFLO(D[0]));
+	k->rh = _mm_set1_epi16(COEFHI(D[0]));
+	k->b = _mm_set_epi16(16384, COEFLO(D[2]), 16384, COEFLO(D[2]),
+	    16384, COEFLO(D[2]), 16384, COEFLO(D[2]));
+	k->bh = _mm_set1_epi16(COEFHI(D[2]));
+	k->g = _mm_set_epi16(COEFLO(D[1]), COEFLO(D[3]), COEFLO(D[1]),
+	    COEFLO(D[3]), COEFLO(D[1]), COEFLO(D[3]), COEFLO(D[1]),
+	    COEFLO(D[3]));
+	k->gbh = _mm_set1_epi16(COEFHI(D[3]));
+	k->grh = _mm_set1_epi16(COEFHI(D[1]));
+}
+
+/*
+ * Red, green and blue offsets of 8 pairs of centered chroma values.
+ */
+TIFF_TARGET_SSE2
+static void
+ycbcrOffsetsSSE2(const YCbCrCoefSSE2* k, __m128i cb, __m128i cr,
+    __m128i* ro, __m128i* go, __m128i* bo)
+{
+	const __m128i two = _mm_set1_epi16(2);
+	const __m128i half = _mm_set1_epi32(32768);
+
+	*ro = _mm_add_epi16(_mm_packs_epi32(
+	    _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(cr, two), k->r), 16),
+	    _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(cr, two), k->r), 16)),
+	    _mm_mullo_epi16(cr, k->rh));
+	*bo = _mm_add_epi16(_mm_packs_epi32(
+	    _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(cb, two), k->b), 16),
+	    _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(cb, two), k->b), 16)),
+	    _mm_mullo_epi16(cb, k->bh));
+	*go = _mm_add_epi16(_mm_packs_epi32(
+	    _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(
+	    _mm_unpacklo_epi16(cb, cr), k->g), half), 16),
+	    _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(
+	    _mm_unpackhi_epi16(cb, cr), k->g), half), 16)),
+	    _mm_add_epi16(_mm_mullo_epi16(cb, k->gbh),
+	    _mm_mullo_epi16(cr, k->grh)));
+}
+
+/*
+ * Store 16 pixels given their luma and the offsets of the first and
+ * last 8 of them; the sums are clamped by the saturating packs.
+ */
+TIFF_TARGET_SSE2
+static void
+ycbcrStoreSSE2(uint32* cp, __m128i y, const __m128i* o)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ff = _mm_set1_epi8((char) 0xff);
+	__m128i yl = _mm_unpacklo_epi8(y, zero);
+	__m128i yh = _mm_unpackhi_epi8(y, zero);
+	__m128i r = _mm_packus_epi16(_mm_add_epi16(yl, o[0]),
+	    _mm_add_epi16(yh, o[1]));
+	__m128i g = _mm_packus_epi16(_mm_add_epi16(yl, o[2]),
+	    _mm_add_epi16(yh, o[3]));
+	__m128i b = _mm_packus_epi16(_mm_add_epi16(yl, o[4]),
+	    _mm_add_epi16(yh, o[5]));
+	__m128i rg = _mm_unpacklo_epi8(r, g);
+	__m128i ba = _mm_unpacklo_epi8(b, ff);
+
+	_mm_storeu_si128((__m128i*) cp, _mm_unpacklo_epi16(rg, ba));
+	_mm_storeu_si128((__m128i*) (cp + 4), _mm_unpackhi_epi16(rg, ba));
+	rg = _mm_unpackhi_epi8(r, g);
+	ba = _mm_unpackhi_epi8(b, ff);
+	_mm_storeu_si128((__m128i*) (cp + 8), _mm_unpacklo_epi16(rg, ba));
+	_mm_storeu_si128((__m128i*) (cp + 12), _mm_unpackhi_epi16(rg, ba));
+}
+
+/*
+ * Offsets of 8 chroma pairs, each shared by 2 horizontal pixels.
+ */
+TIFF_TARGET_SSE2
+static void
+ycbcrOffsets2SSE2(const YCbCrCoefSSE2* k, __m128i cb, __m128i cr,
+    __m128i* o)
+{
+	__m128i ro, go, bo;
+
+	ycbcrOffsetsSSE2(k, cb, cr, &ro, &go, &bo);
+	o[0] = _mm_unpacklo_epi16(ro, ro);
+	o[1] = _mm_unpackhi_epi16(ro, ro);
+	o[2] = _mm_unpacklo_epi16(go, go);
+	o[3] = _mm_unpackhi_epi16(go, go);
+	o[4] = _mm_unpacklo_epi16(bo, bo);
+	o[5] = _mm_unpackhi_epi16(bo, bo);
+}
+
+/*
+ * 2x1 blocks are Y0 Y1 Cb Cr, i.e. one 32 bit word.
+ */
+TIFF_TARGET_SSE2
+static uint32
+ycbcr8SSE2(uint32* cp, uint32* cp2, const uint8* pp, uint32 w,
+    int hs, int vs, const int32* D)
+{
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i lo = _mm_set1_epi16(0xff);
+	YCbCrCoefSSE2 k;
+	uint32 x;
+	__m128i v0, v1, c, o[6];
+
+	(void) cp2;
+	if (hs != 2 || vs != 1)
+		return (0);
+	ycbcrCoefSSE2(&k, D);
+	for (x = 0; x + 16 <= w; x += 16, pp += 32) {
+		v0 = _mm_loadu_si128((const __m128i*) pp);
+		v1 = _mm_loadu_si128((const __m128i*) (pp + 16));
+		c = _mm_packs_epi32(_mm_srai_epi32(v0, 16),
+		    _mm_srai_epi32(v1, 16));
+		ycbcrOffsets2SSE2(&k, _mm_sub_epi16(_mm_and_si128(c, lo), c128),
+		    _mm_sub_epi16(_mm_srli_epi16(c, 8), c128), o);
+		ycbcrStoreSSE2(cp + x, _mm_packs_epi32(
+		    _mm_srai_epi32(_mm_slli_epi32(v0, 16), 16),
+		    _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16)), o);
+	}
+	return (x);
+}
+
+/*
+ * 1x1 and 2x2 blocks are 3 and 6 bytes long, so 16 of the first and
+ * 8 of the second fill 3 vectors.  Each group of 12 bytes is moved to
+ * the low part of a vector, its samples sorted by kind into 32 bit
+ * lanes and the 4 groups transposed.
+ */
+TIFF_TARGET_SSSE3
+static void
+ycbcrLoad48SSSE3(const uint8* pp, __m128i m, __m128i* g)
+{
+	__m128i a = _mm_loadu_si128((const __m128i*) pp);
+	__m128i b = _mm_loadu_si128((const __m128i*) (pp + 16));
+	__m128i c = _mm_loadu_si128((const __m128i*) (pp + 32));
+	__m128i g0 = _mm_shuffle_epi8(a, m);
+	__m128i g1 = _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), m);
+	__m128i g2 = _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), m);
+	__m128i g3 = _mm_shuffle_epi8(_mm_srli_si128(c, 4), m);
+	__m128i t0 = _mm_unpacklo_epi32(g0, g1);
+	__m128i t1 = _mm_unpacklo_epi32(g2, g3);
+	__m128i t2 = _mm_unpackhi_epi32(g0, g1);
+	__m128i t3 = _mm_unpackhi_epi32(g2, g3);
+
+	g[0] = _mm_unpacklo_epi64(t0, t1);
+	g[1] = _mm_unpackhi_epi64(t0, t1);
+	g[2] = _mm_unpacklo_epi64(t2, t3);
+}
+
+TIFF_TARGET_SSSE3
+static uint32
+ycbcr8SSSE3(uint32* cp, uint32* cp2, const uint8* pp, uint32 w,
+    int hs, int vs, const int32* D)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c128 = _mm_set1_epi16(128);
+	YCbCrCoefSSE2 k;
+	uint32 x;
+	__m128i g[3], c, o[6];
+
+	if (hs == 2 && vs == 1)
+		return (ycbcr8SSE2(cp, cp2, pp, w, hs, vs, D));
+	ycbcrCoefSSE2(&k, D);
+	if (hs == 1 && vs == 1) {
+		/* g[0] is Y, g[1] Cb and g[2] Cr of 16 pixels */
+		const __m128i m = _mm_setr_epi8(0, 3, 6, 9, 1, 4, 7, 10,
+		    2, 5, 8, 11, -128, -128, -128, -128);
+
+		for (x = 0; x + 16 <= w; x += 16, pp += 48) {
+			ycbcrLoad48SSSE3(pp, m, g);
+			ycbcrOffsetsSSE2(&k,
+			    _mm_sub_epi16(_mm_unpacklo_epi8(g[1], zero), c128),
+			    _mm_sub_epi16(_mm_unpacklo_epi8(g[2], zero), c128),
+			    &o[0], &o[2], &o[4]);
+			ycbcrOffsetsSSE2(&k,
+			    _mm_sub_epi16(_mm_unpackhi_epi8(g[1], zero), c128),
+			    _mm_sub_epi16(_mm_unpackhi_epi8(g[2], zero), c128),
+			    &o[1], &o[3], &o[5]);
+			ycbcrStoreSSE2(cp + x, g[0], o);
+		}
+		return (x);
+	}
+	if (hs == 2 && vs == 2) {
+		/*
+		 * g[0] and g[1] are the Y of 16 pixels of each row,
+		 * g[2] the Cb Cb Cr Cr of pairs of blocks, sorted
+		 * into 8 Cb then 8 Cr by ms.
+		 */
+		const __m128i m = _mm_setr_epi8(0, 1, 6, 7, 2, 3, 8, 9,
+		    4, 10, 5, 11, -128, -128, -128, -128);
+		const __m128i ms = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13,
+		    2, 3, 6, 7, 10, 11, 14, 15);
+
+		for (x = 0; x + 16 <= w; x += 16, pp += 48) {
+			ycbcrLoad48SSSE3(pp, m, g);
+			c = _mm_shuffle_epi8(g[2], ms);
+			ycbcrOffsets2SSE2(&k,
+			    _mm_sub_epi16(_mm_unpacklo_epi8(c, zero), c128),
+			    _mm_sub_epi16(_mm_unpackhi_epi8(c, zero), c128), o);
+			ycbcrStoreSSE2(cp + x, g[0], o);
+			if (cp2 != NULL)
+				ycbcrStoreSSE2(cp2 + x, g[1], o);
+		}
+		return (x);
+	}
+	return (0);
+}
+#undef	COEFHI
+#undef	COEFLO
+#elif defined(TIFF_SIMD_NEON) && !defined(WORDS_BIGENDIAN)
+/*
+ * (D*x + 2^15) >> 16 for 8 centered chroma values.
+ */
+static int16x8_t
+ycbcrTermNEON(int16x8_t x, int32 d)
+{
+	const int32x4_t half = vdupq_n_s32(32768);
+
+	return (vcombine_s16(
+	    vshrn_n_s32(vmlaq_n_s32(half, vmovl_s16(vget_low_s16(x)), d), 16),
+	    vshrn_n_s32(vmlaq_n_s32(half, vmovl_s16(vget_high_s16(x)), d), 16)));
+}
+
+/*
+ * (Db*cb + Dr*cr + 2^15) >> 16 for 8 centered chroma pairs.
+ */
+static int16x8_t
+ycbcrTerm2NEON(int16x8_t cb, int16x8_t cr, int32 db, int32 dr)
+{
+	const int32x4_t half = vdupq_n_s32(32768);
+
+	return (vcombine_s16(
+	    vshrn_n_s32(vmlaq_n_s32(vmlaq_n_s32(half,
+	    vmovl_s16(vget_low_s16(cb)), db),
+	    vmovl_s16(vget_low_s16(cr)), dr), 16),
+	    vshrn_n_s32(vmlaq_n_s32(vmlaq_n_s32(half,
+	    vmovl_s16(vget_high_s16(cb)), db),
+	    vmovl_s16(vget_high_s16(cr)), dr), 16)));
+}
+
+static int16x8_t
+ycbcrCenterNEON(uint8x8_t c)
+{
+	return (vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(c)),
+	    vdupq_n_s16(128)));
+}
+
+/*
+ * Clamped sums of 16 luma values and the offsets of the first and
+ * last 8 of them.
+ */
+static uint8x16_t
+ycbcrSumNEON(uint8x16_t y, int16x8_t ol, int16x8_t oh)
+{
+	return (vcombine_u8(
+	    vqmovun_s16(vaddq_s16(vreinterpretq_s16_u16(
+	    vmovl_u8(vget_low_u8(y))), ol)),
+	    vqmovun_s16(vaddq_s16(vreinterpretq_s16_u16(
+	    vmovl_u8(vget_high_u8(y))), oh))));
+}
+
+/*
+ * Store 16 pixels; o holds the offsets of 8 chroma pairs, each shared
+ * by 2 horizontal pixels.
+ */
+static void
+ycbcrStore2NEON(uint32* cp, uint8x16_t y, const int16x8_t* o)
+{
+	uint8x16x4_t v;
+	int16x8x2_t d;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		d = vzipq_s16(o[i], o[i]);
+		v.val[i] = ycbcrSumNEON(y, d.val[0], d.val[1]);
+	}
+	v.val[3] = vdupq_n_u8(0xff);
+	vst4q_u8((uint8*) cp, v);
+}
+
+static uint32
+ycbcr8NEON(uint32* cp, uint32* cp2, const uint8* pp, uint32 w,
+    int hs, int vs, const int32* D)
+{
+	uint32 x;
+	uint8x16x4_t v;
+	int16x8_t cb, cr, o[3];
+
+	if (hs == 1 && vs == 1) {
+		uint8x16x3_t s;
+		int16x8_t cbh, crh;
+
+		v.val[3] = vdupq_n_u8(0xff);
+		for (x = 0; x + 16 <= w; x += 16, pp += 48) {
+			s = vld3q_u8(pp);
+			cb = ycbcrCenterNEON(vget_low_u8(s.val[1]));
+			cbh = ycbcrCenterNEON(vget_high_u8(s.val[1]));
+			cr = ycbcrCenterNEON(vget_low_u8(s.val[2]));
+			crh = ycbcrCenterNEON(vget_high_u8(s.val[2]));
+			v.val[0] = ycbcrSumNEON(s.val[0],
+			    ycbcrTermNEON(cr, D[0]), ycbcrTermNEON(crh, D[0]));
+			v.val[1] = ycbcrSumNEON(s.val[0],
+			    ycbcrTerm2NEON(cb, cr, D[3], D[1]),
+			    ycbcrTerm2NEON(cbh, crh, D[3], D[1]));
+			v.val[2] = ycbcrSumNEON(s.val[0],
+			    ycbcrTermNEON(cb, D[2]), ycbcrTermNEON(cbh, D[2]));
+			vst4q_u8((uint8*) (cp + x), v);
+		}
+		return (x);
+	}
+	if (hs == 2 && vs == 1) {
+		/* 8 blocks of Y0 Y1 Cb Cr as 16 bit Y0|Y1 and Cb|Cr */
+		uint16x8x2_t s;
+
+		for (x = 0; x + 16 <= w; x += 16, pp += 32) {
+			s = vld2q_u16((const uint16*) pp);
+			cb = ycbcrCenterNEON(vmovn_u16(s.val[1]));
+			cr = ycbcrCenterNEON(vshrn_n_u16(s.val[1], 8));
+			o[0] = ycbcrTermNEON(cr, D[0]);
+			o[1] = ycbcrTerm2NEON(cb, cr, D[3], D[1]);
+			o[2] = ycbcrTermNEON(cb, D[2]);
+			ycbcrStore2NEON(cp + x, vreinterpretq_u8_u16(s.val[0]), o);
+		}
+		return (x);
+	}
+	if (hs == 2 && vs == 2) {
+		/* 8 blocks of Y00 Y01 Y10 Y11 Cb Cr as 3 16 bit values */
+		uint16x8x3_t s;
+
+		for (x = 0; x + 16 <= w; x += 16, pp += 48) {
+			s = vld3q_u16((const uint16*) pp);
+			cb = ycbcrCenterNEON(vmovn_u16(s.val[2]));
+			cr = ycbcrCenterNEON(vshrn_n_u16(s.val[2], 8));
+			o[0] = ycbcrTermNEON(cr, D[0]);
+			o[1] = ycbcrTerm2NEON(cb, cr, D[3], D[1]);
+			o[2] = ycbcrTermNEON(cb, D[2]);
+			ycbcrStore2NEON(cp + x, vreinterpretq_u8_u16(s.val[0]), o);
+			if (cp2 != NULL)
+				ycbcrStore2NEON(cp2 + x,
+				    vreinterpretq_u8_u16(s.val[1]), o);
+		}
+		return (x);
+	}
+	(void) v;
+	return (0);
+}
+#endif
+
+/*
+ * 8-bit CIE L*a*b* through the cube of _TIFFCIELabToRGBCube(), one
+ * pixel at a time with the 4 values of a node in parallel.  The nodes
+ * for b* and b*+8 are adjacent, so each of the 4 loads brings in a
+ * pair that is interpolated first; the interpolation is the same
+ * sequence of rounded steps as cielabCubePixel().
+ */
+#if defined(TIFF_SIMD_X86)
+#define	CIELAB_DA	(4 * CIELABCUBE_NODES)
+#define	CIELAB_DL	(4 * CIELABCUBE_NODES * CIELABCUBE_NODES)
+
+/*
+ * (v0*(8-f) + v1*f + 4) >> 3 for the 4 values of v0 and v1, given as
+ * the two halves of x.
+ */
+TIFF_TARGET_SSE2 static __m128i
+cielabLerpSSE2(__m128i x, uint32 f)
+{
+	const __m128i four = _mm_set1_epi32(4);
+
+	x = _mm_unpacklo_epi16(x, _mm_srli_si128(x, 8));
+	x = _mm_madd_epi16(x, _mm_set1_epi32((int)((f << 16) | (8 - f))));
+	return (_mm_srli_epi32(_mm_add_epi32(x, four), 3));
+}
+
+TIFF_TARGET_SSE2 static uint32
+cielab8SSE2(uint32* cp, const uint8* pp, uint32 w, const int16* cube,
+    const uint8* tab)
+{
+	const __m128i bias = _mm_set1_epi16(CIELABCUBE_BIAS / 8);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i range = _mm_set1_epi16(CIELABTORGB_TABLE_RANGE);
+	uint32 x;
+
+	for (x = 0; x < w; x++, pp += 3) {
+		uint32 l = pp[0], a = pp[1] ^ 0x80, b = pp[2] ^ 0x80;
+		const int16* n = cube + 4 * (((l >> 3) * CIELABCUBE_NODES +
+		    (a >> 3)) * CIELABCUBE_NODES + (b >> 3));
+		__m128i s00, s01, s10, s11, i;
+		int16 idx[8];
+
+		s00 = cielabLerpSSE2(_mm_loadu_si128((const __m128i*) n), b & 7);
+		s01 = cielabLerpSSE2(_mm_loadu_si128((const __m128i*)
+		    (n + CIELAB_DA)), b & 7);
+		s10 = cielabLerpSSE2(_mm_loadu_si128((const __m128i*)
+		    (n + CIELAB_DL)), b & 7);
+		s11 = cielabLerpSSE2(_mm_loadu_si128((const __m128i*)
+		    (n + CIELAB_DL + CIELAB_DA)), b & 7);
+		s00 = cielabLerpSSE2(_mm_packs_epi32(s00, s01), a & 7);
+		s10 = cielabLerpSSE2(_mm_packs_epi32(s10, s11), a & 7);
+		i = cielabLerpSSE2(_mm_packs_epi32(s00, s10), l & 7);
+		i = _mm_sub_epi16(_mm_packs_epi32(_mm_srli_epi32(i, 3), zero),
+		    bias);
+		i = _mm_min_epi16(_mm_max_epi16(i, zero), range);
+		_mm_storeu_si128((__m128i*) idx, i);
+		cp[x] = PACK(tab[idx[0]],
+		    tab[CIELABTORGB_TABLE_RANGE + 1 + idx[1]],
+		    tab[2 * (CIELABTORGB_TABLE_RANGE + 1) + idx[2]]);
+	}
+	return (x);
+}
+#undef	CIELAB_DA
+#undef	CIELAB_DL
+#elif defined(TIFF_SIMD_NEON) && !defined(WORDS_BIGENDIAN)
+#define	CIELAB_DA	(4 * CIELABCUBE_NODES)
+#define	CIELAB_DL	(4 * CIELABCUBE_NODES * CIELABCUBE_NODES)
+
+static int32x4_t
+cielabLerpNEON(int16x4_t v0, int16x4_t v1, int16 f)
+{
+	return (vrshrq_n_s32(vmlal_n_s16(vmull_n_s16(v0, (int16)(8 - f)),
+	    v1, f), 3));
+}
+
+static int32x4_t
+cielabPairNEON(const int16* n, int16 f)
+{
+	int16x8_t x = vld1q_s16(n);
+
+	return (cielabLerpNEON(vget_low_s16(x), vget_high_s16(x), f));
+}
+
+static uint32
+cielab8NEON(uint32* cp, const uint8* pp, uint32 w, const int16* cube,
+    const uint8* tab)
+{
+	uint32 x;
+
+	for (x = 0; x < w; x++, pp += 3) {
+		uint32 l = pp[0], a = pp[1] ^ 0x80, b = pp[2] ^ 0x80;
+		const int16* n = cube + 4 * (((l >> 3) * CIELABCUBE_NODES +
+		    (a >> 3)) * CIELABCUBE_NODES + (b >> 3));
+		int32x4_t s00, s01, s10, s11, s;
+		int16x4_t i;
+		int16 idx[4];
+
+		s00 = cielabPairNEON(n, (int16)(b & 7));
+		s01 = cielabPairNEON(n + CIELAB_DA, (int16)(b & 7));
+		s10 = cielabPairNEON(n + CIELAB_DL, (int16)(b & 7));
+		s11 = cielabPairNEON(n + CIELAB_DL + CIELAB_DA, (int16)(b & 7));
+		s00 = cielabLerpNEON(vmovn_s32(s00), vmovn_s32(s01),
+		    (int16)(a & 7));
+		s10 = cielabLerpNEON(vmovn_s32(s10), vmovn_s32(s11),
+		    (int16)(a & 7));
+		s = cielabLerpNEON(vmovn_s32(s00), vmovn_s32(s10),
+		    (int16)(l & 7));
+		i = vsub_s16(vshrn_n_s32(s, 3), vdup_n_s16(CIELABCUBE_BIAS / 8));
+		i = vmin_s16(vmax_s16(i, vdup_n_s16(0)),
+		    vdup_n_s16(CIELABTORGB_TABLE_RANGE));
+		vst1_s16(idx, i);
+		cp[x] = PACK(tab[idx[0]],
+		    tab[CIELABTORGB_TABLE_RANGE + 1 + idx[1]],
+		    tab[2 * (CIELABTORGB_TABLE_RANGE + 1) + idx[2]]);
+	}
+	return (x);
+}
+#undef	CIELAB_DA
+#undef	CIELAB_DL
+#endif
+
+void
+_TIFFRGBAImageKernels(TIFFKernels* k, int features)
+{
+#if defined(TIFF_SIMD_X86)
+	if (features & TIFF_CPU_SSE2) {
+		k->packRGB8 = packRGB8SSE2;
+		k->packRGBUA8 = packRGBUA8SSE2;
+		k->packGrey8 = packGrey8SSE2;
+		k->ycbcr8 = ycbcr8SSE2;
+		k->cielab8 = cielab8SSE2;
+	}
+	if ((features & (TIFF_CPU_SSE2|TIFF_CPU_SSSE3)) ==
+	    (TIFF_CPU_SSE2|TIFF_CPU_SSSE3)) {
+		k->packRGB8 = packRGB8SSSE3;
+		k->ycbcr8 = ycbcr8SSSE3;
+	}
+#elif defined(TIFF_SIMD_NEON) && !defined(WORDS_BIGENDIAN)
+	if (features & TIFF_CPU_NEON) {
+		k->packRGB8 = packRGB8NEON;
+		k->packRGBUA8 = packRGBUA8NEON;
+		k->packGrey8 = packGrey8NEON;
+		k->ycbcr8 = ycbcr8NEON;
+		k->cielab8 = cielab8NEON;
+	}
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+static uint32
+packRGB8SIMD(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return (k->packRGB8 != NULL ?
+	    (*k->packRGB8)(cp, pp, w, samplesperpixel) : 0);
+}
+
+static uint32
+packRGBUA8SIMD(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return (k->packRGBUA8 != NULL ?
+	    (*k->packRGBUA8)(cp, pp, w, samplesperpixel) : 0);
+}
+
+static uint32
+packGrey8SIMD(uint32* cp, const uint8* pp, uint32 w, int samplesperpixel,
+    int invert)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return (k->packGrey8 != NULL ?
+	    (*k->packGrey8)(cp, pp, w, samplesperpixel, invert) : 0);
+}
+
+static uint32
+cielab8SIMD(uint32* cp, const uint8* pp, uint32 w, const int16* cube,
+    const uint8* tab)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return (k->cielab8 != NULL ?
+	    (*k->cielab8)(cp, pp, w, cube, tab) : 0);
+}
+
 /*
  * 8-bit palette => colormap/RGB
  */
@@ -1305,10 +2279,14 @@ DECLAREContigPutFunc(putgreytile)
 {
     int samplesperpixel = img->samplesperpixel;
     uint32** BWmap = img->BWmap;
+    int invert = img->photometric == PHOTOMETRIC_MINISWHITE;
 
     (void) y;
     for( ; h > 0; --h) {
-	for (x = w; x > 0; --x)
+	x = packGrey8SIMD(cp, pp, w, samplesperpixel, invert);
+	cp += x;
+	pp += x * samplesperpixel;
+	for (x = w - x; x > 0; --x)
         {
 	    *cp++ = BWmap[*pp][0];
             pp += samplesperpixel;
@@ -1421,10 +2399,13 @@ DECLAREContigPutFunc(putRGBcontig8bittile)
 {
     int samplesperpixel = img->samplesperpixel;
 
-    (void) x; (void) y;
+    (void) y;
     fromskew *= samplesperpixel;
     for( ; h > 0; --h) {
-	UNROLL8(w, NOP,
+	x = packRGB8SIMD(cp, pp, w, samplesperpixel);
+	cp += x;
+	pp += x * samplesperpixel;
+	UNROLL8(w - x, NOP,
 	    *cp++ = PACK(pp[0], pp[1], pp[2]);
 	    pp += samplesperpixel);
 	cp += toskew;
@@ -1443,6 +2424,17 @@ DECLAREContigPutFunc(putRGBAAcontig8bittile)
     (void) x; (void) y;
     fromskew *= samplesperpixel;
     for( ; h > 0; --h) {
+#ifndef WORDS_BIGENDIAN
+	/* the samples are already in the order of a packed pixel */
+	if (samplesperpixel == 4) {
+	    _TIFFmemcpy(cp, pp, (tmsize_t) w * 4);
+	    cp += w;
+	    pp += (size_t) w * 4;
+	    cp += toskew;
+	    pp += fromskew;
+	    continue;
+	}
+#endif
 	UNROLL8(w, NOP,
 	    *cp++ = PACK4(pp[0], pp[1], pp[2], pp[3]);
 	    pp += samplesperpixel);
@@ -1463,7 +2455,10 @@ DECLAREContigPutFunc(putRGBUAcontig8bittile)
 	for( ; h > 0; --h) {
 		uint32 r, g, b, a;
 		uint8* m;
-		for (x = w; x > 0; --x) {
+		x = packRGBUA8SIMD(cp, pp, w, samplesperpixel);
+		cp += x;
+		pp += x * samplesperpixel;
+		for (x = w - x; x > 0; --x) {
 			a = pp[3];
 			m = img->UaToAa+((size_t) a<<8);
 			r = m[pp[0]];
@@ -1744,24 +2739,67 @@ DECLARESepPutFunc(putRGBUAseparate16bittile)
 	}
 }
 
+/*
+ * The conversion state of img->cielab is followed by the interpolation
+ * cube of _TIFFCIELabToRGBCube() and its display value tables.
+ */
+#define	CIELabCube(img) \
+	((int16*) ((uint8*) (img)->cielab + \
+	    TIFFroundup_32(sizeof (TIFFCIELabToRGB), 16)))
+#define	CIELabCubeTab(img) \
+	((uint8*) CIELabCube(img) + CIELABCUBE_SIZE)
+
+/*
+ * (v0*(8-f) + v1*f + 4) >> 3
+ */
+#define	CIELabLerp(v0, v1, f)	(((v0) * (8 - (f)) + (v1) * (f) + 4) >> 3)
+
+/*
+ * Trilinear interpolation of the luminosity indices at the 8 nodes
+ * around an 8-bit L*a*b* value, then the display value lookup.
+ */
+static uint32
+cielabCubePixel(const int16* cube, const uint8* tab, const uint8* pp)
+{
+	const int da = 4 * CIELABCUBE_NODES;
+	const int dl = 4 * CIELABCUBE_NODES * CIELABCUBE_NODES;
+	uint32 l = pp[0], a = pp[1] ^ 0x80, b = pp[2] ^ 0x80;
+	int fl = (int)(l & 7), fa = (int)(a & 7), fb = (int)(b & 7);
+	const int16* n = cube + 4 * (((l >> 3) * CIELABCUBE_NODES +
+	    (a >> 3)) * CIELABCUBE_NODES + (b >> 3));
+	int c, v[3];
+
+	for (c = 0; c < 3; c++, n++) {
+		int s00 = CIELabLerp(n[0], n[4], fb);
+		int s01 = CIELabLerp(n[da], n[da + 4], fb);
+		int s10 = CIELabLerp(n[dl], n[dl + 4], fb);
+		int s11 = CIELabLerp(n[dl + da], n[dl + da + 4], fb);
+		int i = (CIELabLerp(CIELabLerp(s00, s01, fa),
+		    CIELabLerp(s10, s11, fa), fl) >> 3) - CIELABCUBE_BIAS / 8;
+
+		i = TIFFmin(TIFFmax(i, 0), CIELABTORGB_TABLE_RANGE);
+		v[c] = tab[c * (CIELABTORGB_TABLE_RANGE + 1) + i];
+	}
+	return (PACK(v[0], v[1], v[2]));
+}
+
 /*
  * 8-bit packed CIE L*a*b 1976 samples => RGB
  */
 DECLAREContigPutFunc(putcontig8bitCIELab)
 {
-	float X, Y, Z;
-	uint32 r, g, b;
+	const int16* cube = CIELabCube(img);
+	const uint8* tab = CIELabCubeTab(img);
+	uint32 n;
+
 	(void) y;
 	fromskew *= 3;
 	for( ; h > 0; --h) {
-		for (x = w; x > 0; --x) {
-			TIFFCIELabToXYZ(img->cielab,
-					(unsigned char)pp[0],
-					(signed char)pp[1],
-					(signed char)pp[2],
-					&X, &Y, &Z);
-			TIFFXYZToRGB(img->cielab, X, Y, Z, &r, &g, &b);
-			*cp++ = PACK(r, g, b);
+		n = cielab8SIMD(cp, pp, w, cube, tab);
+		cp += n;
+		pp += 3 * n;
+		for (x = w - n; x > 0; --x) {
+			*cp++ = cielabCubePixel(cube, tab, pp);
 			pp += 3;
 		}
 		cp += toskew;
@@ -1779,6 +2817,32 @@ DECLAREContigPutFunc(putcontig8bitCIELab)
 	dst = PACK(r, g, b);						\
 }
 
+/*
+ * The conversion tables of img->ycbcr are followed by a flag telling
+ * whether they have the fixed point form of _TIFFYCbCrFixedPoint(),
+ * and its coefficients.
+ */
+#define	YCbCrTableSize						\
+	(TIFFroundup_32(sizeof (TIFFYCbCrToRGB), sizeof (long))	\
+	 + 4*256*sizeof (TIFFRGBValue)				\
+	 + 2*256*sizeof (int)					\
+	 + 3*256*sizeof (int32))
+#define	YCbCrFixed(img)	((int32*) ((uint8*) (img)->ycbcr + YCbCrTableSize))
+
+static uint32
+ycbcr8SIMD(TIFFRGBAImage* img, uint32* cp, uint32* cp2, const uint8* pp,
+    uint32 w, int hs, int vs)
+{
+	const int32* fixed = YCbCrFixed(img);
+	const TIFFKernels* k;
+
+	if (!fixed[0])
+		return (0);
+	k = _TIFFGetKernels();
+	return (k->ycbcr8 != NULL ?
+	    (*k->ycbcr8)(cp, cp2, pp, w, hs, vs, fixed + 1) : 0);
+}
+
 /*
  * 8-bit packed YCbCr samples => RGB 
  * This function is generic for different sampling sizes, 
@@ -2098,7 +3162,11 @@ DECLAREContigPutFunc(putcontig8bitYCbCr22tile)
 	fromskew = (fromskew / 2) * (2*2+2);
 	cp2 = cp+w+toskew;
 	while (h>=2) {
-		x = w;
+		x = ycbcr8SIMD(img, cp, cp2, pp, w, 2, 2);
+		cp += x;
+		cp2 += x;
+		pp += (x/2)*6;
+		x = w - x;
 		while (x>=2) {
 			uint32 Cb = pp[4];
 			uint32 Cr = pp[5];
@@ -2126,7 +3194,10 @@ DECLAREContigPutFunc(putcontig8bitYCbCr22tile)
 		h-=2;
 	}
 	if (h==1) {
-		x = w;
+		x = ycbcr8SIMD(img, cp, NULL, pp, w, 2, 2);
+		cp += x;
+		pp += (x/2)*6;
+		x = w - x;
 		while (x>=2) {
 			uint32 Cb = pp[4];
 			uint32 Cr = pp[5];
@@ -2153,7 +3224,10 @@ DECLAREContigPutFunc(putcontig8bitYCbCr21tile)
 	(void) y;
 	fromskew = (fromskew / 2) * (2*1+2);
 	do {
-		x = w>>1;
+		x = ycbcr8SIMD(img, cp, NULL, pp, w, 2, 1);
+		cp += x;
+		pp += (x/2)*4;
+		x = (w - x)>>1;
 		while(x>0) {
 			int32 Cb = pp[2];
 			int32 Cr = pp[3];
@@ -2228,15 +3302,19 @@ DECLAREContigPutFunc(putcontig8bitYCbCr11tile)
 	(void) y;
 	fromskew = (fromskew / 1) * (1 * 1 + 2);
 	do {
-		x = w; /* was x = w>>1; patched 2000/09/25 warmerda@home.com */
-		do {
+		x = ycbcr8SIMD(img, cp, NULL, pp, w, 1, 1);
+		cp += x;
+		pp += x*3;
+		x = w - x; /* was x = w>>1; patched 2000/09/25 warmerda@home.com */
+		while (x > 0) {
 			int32 Cb = pp[1];
 			int32 Cr = pp[2];
 
 			YCbCrtoRGB(*cp++, pp[0]);
 
 			pp += 3;
-		} while (--x);
+			x--;
+		}
 		cp += toskew;
 		pp += fromskew;
 	} while (--h);
@@ -2276,14 +3354,10 @@ initYCbCrConversion(TIFFRGBAImage* img)
 	float *luma, *refBlackWhite;
 
 	if (img->ycbcr == NULL) {
-		img->ycbcr = (TIFFYCbCrToRGB*) _TIFFmalloc(
-		    TIFFroundup_32(sizeof (TIFFYCbCrToRGB), sizeof (long))  
-		    + 4*256*sizeof (TIFFRGBValue)
-		    + 2*256*sizeof (int)
-		    + 3*256*sizeof (int32)
-		    );
+		img->ycbcr = (TIFFYCbCrToRGB*) _TIFFmallocExt(img->tif,
+		    YCbCrTableSize + 5*sizeof (int32));
 		if (img->ycbcr == NULL) {
-			TIFFErrorExt(img->tif->tif_clientdata, module,
+			TIFFErrorExtR(img->tif, module,
 			    "No space for YCbCr->RGB conversion state");
 			return (0);
 		}
@@ -2300,7 +3374,7 @@ initYCbCrConversion(TIFFRGBAImage* img)
             luma[1] == 0.0 ||
             luma[2] != luma[2] )
         {
-            TIFFErrorExt(img->tif->tif_clientdata, module,
+            TIFFErrorExtR(img->tif, module,
                 "Invalid values for YCbCrCoefficients tag");
             return (0);
         }
@@ -2312,13 +3386,15 @@ initYCbCrConversion(TIFFRGBAImage* img)
             !isInRefBlackWhiteRange(refBlackWhite[4]) ||
             !isInRefBlackWhiteRange(refBlackWhite[5]) )
         {
-            TIFFErrorExt(img->tif->tif_clientdata, module,
+            TIFFErrorExtR(img->tif, module,
                 "Invalid values for ReferenceBlackWhite tag");
             return (0);
         }
 
 	if (TIFFYCbCrToRGBInit(img->ycbcr, luma, refBlackWhite) < 0)
 		return(0);
+	YCbCrFixed(img)[0] = _TIFFYCbCrFixedPoint(img->ycbcr, luma,
+	    YCbCrFixed(img) + 1);
 	return (1);
 }
 
@@ -2332,16 +3408,18 @@ initCIELabConversion(TIFFRGBAImage* img)
 
 	TIFFGetFieldDefaulted(img->tif, TIFFTAG_WHITEPOINT, &whitePoint);
 	if (whitePoint[1] == 0.0f ) {
-		TIFFErrorExt(img->tif->tif_clientdata, module,
+		TIFFErrorExtR(img->tif, module,
 		    "Invalid value for WhitePoint tag.");
 		return NULL;
         }
 
 	if (!img->cielab) {
 		img->cielab = (TIFFCIELabToRGB *)
-			_TIFFmalloc(sizeof(TIFFCIELabToRGB));
+			_TIFFmallocExt(img->tif,
+			    TIFFroundup_32(sizeof(TIFFCIELabToRGB), 16) +
+			    CIELABCUBE_SIZE + CIELABCUBE_TABSIZE);
 		if (!img->cielab) {
-			TIFFErrorExt(img->tif->tif_clientdata, module,
+			TIFFErrorExtR(img->tif, module,
 			    "No space for CIE L*a*b*->RGB conversion state.");
 			return NULL;
 		}
@@ -2352,11 +3430,12 @@ initCIELabConversion(TIFFRGBAImage* img)
 	refWhite[2] = (1.0F - whitePoint[0] - whitePoint[1])
 		      / whitePoint[1] * refWhite[1];
 	if (TIFFCIELabToRGBInit(img->cielab, &display_sRGB, refWhite) < 0) {
-		TIFFErrorExt(img->tif->tif_clientdata, module,
+		TIFFErrorExtR(img->tif, module,
 		    "Failed to initialize CIE L*a*b*->RGB conversion state.");
-		_TIFFfree(img->cielab);
+		_TIFFfreeExt(img->tif, img->cielab);
 		return NULL;
 	}
+	_TIFFCIELabToRGBCube(img->cielab, CIELabCube(img), CIELabCubeTab(img));
 
 	return putcontig8bitCIELab;
 }
@@ -2380,10 +3459,10 @@ makebwmap(TIFFRGBAImage* img)
     if( nsamples == 0 )
         nsamples = 1;
 
-    img->BWmap = (uint32**) _TIFFmalloc(
+    img->BWmap = (uint32**) _TIFFmallocExt(img->tif,
 	256*sizeof (uint32 *)+(256*nsamples*sizeof(uint32)));
     if (img->BWmap == NULL) {
-		TIFFErrorExt(img->tif->tif_clientdata, TIFFFileName(img->tif), "No space for B&W mapping table");
+		TIFFErrorExtR(img->tif, TIFFFileName(img->tif), "No space for B&W mapping table");
 		return (0);
     }
     p = (uint32*)(img->BWmap + 256);
@@ -2438,9 +3517,9 @@ setupMap(TIFFRGBAImage* img)
     if( img->bitspersample == 16 )
         range = (int32) 255;
 
-    img->Map = (TIFFRGBValue*) _TIFFmalloc((range+1) * sizeof (TIFFRGBValue));
+    img->Map = (TIFFRGBValue*) _TIFFmallocExt(img->tif, (range+1) * sizeof (TIFFRGBValue));
     if (img->Map == NULL) {
-		TIFFErrorExt(img->tif->tif_clientdata, TIFFFileName(img->tif),
+		TIFFErrorExtR(img->tif, TIFFFileName(img->tif),
 			"No space for photometric conversion table");
 		return (0);
     }
@@ -2461,7 +3540,7 @@ setupMap(TIFFRGBAImage* img)
 	if (!makebwmap(img))
 	    return (0);
 	/* no longer need Map, free it */
-	_TIFFfree(img->Map);
+	_TIFFfreeExt(img->tif, img->Map);
 	img->Map = NULL;
     }
     return (1);
@@ -2516,10 +3595,10 @@ makecmap(TIFFRGBAImage* img)
     uint32 *p;
     int i;
 
-    img->PALmap = (uint32**) _TIFFmalloc(
+    img->PALmap = (uint32**) _TIFFmallocExt(img->tif,
 	256*sizeof (uint32 *)+(256*nsamples*sizeof(uint32)));
     if (img->PALmap == NULL) {
-		TIFFErrorExt(img->tif->tif_clientdata, TIFFFileName(img->tif), "No space for Palette mapping table");
+		TIFFErrorExtR(img->tif, TIFFFileName(img->tif), "No space for Palette mapping table");
 		return (0);
 	}
     p = (uint32*)(img->PALmap + 256);
@@ -2584,7 +3663,7 @@ buildMap(TIFFRGBAImage* img)
 	if (checkcmap(img) == 16)
 	    cvtcmap(img);
 	else
-	    TIFFWarningExt(img->tif->tif_clientdata, TIFFFileName(img->tif), "Assuming 8-bit colormap");
+	    TIFFWarningExtR(img->tif, TIFFFileName(img->tif), "Assuming 8-bit colormap");
 	/*
 	 * Use mapping table and colormap to construct
 	 * unpacking tables for samples < 8 bits.
@@ -2830,10 +3909,10 @@ BuildMapUaToAa(TIFFRGBAImage* img)
 	uint8* m;
 	uint16 na,nv;
 	assert(img->UaToAa==NULL);
-	img->UaToAa=_TIFFmalloc(65536);
+	img->UaToAa=_TIFFmallocExt(img->tif, 65536);
 	if (img->UaToAa==NULL)
 	{
-		TIFFErrorExt(img->tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(img->tif,module,"Out of memory");
 		return(0);
 	}
 	m=img->UaToAa;
@@ -2852,10 +3931,10 @@ BuildMapBitdepth16To8(TIFFRGBAImage* img)
 	uint8* m;
 	uint32 n;
 	assert(img->Bitdepth16To8==NULL);
-	img->Bitdepth16To8=_TIFFmalloc(65536);
+	img->Bitdepth16To8=_TIFFmallocExt(img->tif, 65536);
 	if (img->Bitdepth16To8==NULL)
 	{
-		TIFFErrorExt(img->tif->tif_clientdata,module,"Out of memory");
+		TIFFErrorExtR(img->tif,module,"Out of memory");
 		return(0);
 	}
 	m=img->Bitdepth16To8;
@@ -2891,7 +3970,7 @@ TIFFReadRGBAStripExt(TIFF* tif, uint32 row, uint32 * raster, int stop_on_error)
 
     if( TIFFIsTiled( tif ) )
     {
-		TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif),
+		TIFFErrorExtR(tif, TIFFFileName(tif),
                   "Can't use TIFFReadRGBAStrip() with tiled file.");
 	return (0);
     }
@@ -2899,7 +3978,7 @@ TIFFReadRGBAStripExt(TIFF* tif, uint32 row, uint32 * raster, int stop_on_error)
     TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsperstrip);
     if( (row % rowsperstrip) != 0 )
     {
-		TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif),
+		TIFFErrorExtR(tif, TIFFFileName(tif),
 				"Row passed to TIFFReadRGBAStrip() must be first in a strip.");
 		return (0);
     }
@@ -2918,7 +3997,7 @@ TIFFReadRGBAStripExt(TIFF* tif, uint32 row, uint32 * raster, int stop_on_error)
         
 	TIFFRGBAImageEnd(&img);
     } else {
-		TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif), "%s", emsg);
+		TIFFErrorExtR(tif, TIFFFileName(tif), "%s", emsg);
 		ok = 0;
     }
     
@@ -2956,7 +4035,7 @@ TIFFReadRGBATileExt(TIFF* tif, uint32 col, uint32 row, uint32 * raster, int stop
     
     if( !TIFFIsTiled( tif ) )
     {
-		TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif),
+		TIFFErrorExtR(tif, TIFFFileName(tif),
 				  "Can't use TIFFReadRGBATile() with stripped file.");
 		return (0);
     }
@@ -2965,7 +4044,7 @@ TIFFReadRGBATileExt(TIFF* tif, uint32 col, uint32 row, uint32 * raster, int stop
     TIFFGetFieldDefaulted(tif, TIFFTAG_TILELENGTH, &tile_ysize);
     if( (col % tile_xsize) != 0 || (row % tile_ysize) != 0 )
     {
-		TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif),
+		TIFFErrorExtR(tif, TIFFFileName(tif),
                   "Row/col passed to TIFFReadRGBATile() must be top"
                   "left corner of a tile.");
 	return (0);
@@ -2977,7 +4056,7 @@ TIFFReadRGBATileExt(TIFF* tif, uint32 col, uint32 row, uint32 * raster, int stop
     
     if (!TIFFRGBAImageOK(tif, emsg) 
 	|| !TIFFRGBAImageBegin(&img, tif, stop_on_error, emsg)) {
-	    TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif), "%s", emsg);
+	    TIFFErrorExtR(tif, TIFFFileName(tif), "%s", emsg);
 	    return( 0 );
     }
 
@@ -3036,6 +4115,676 @@ TIFFReadRGBATileExt(TIFF* tif, uint32 col, uint32 row, uint32 * raster, int stop
     return (ok);
 }
 
+/*
+ * State of TIFFReadRGBAImageScaled().  Each output pixel is the average
+ * of a box of input pixels; boxes are accumulated one input row at a
+ * time, in top to bottom order, so only one output row is pending.
+ */
+typedef struct {
+	uint32	inw, inh;	/* input size, after any DCT reduction */
+	uint32	outw, outh;
+	uint32*	raster;		/* bottom left origin, as TIFFReadRGBAImage */
+	uint32*	xbox;		/* first and last+1 column of each box */
+	uint64*	acc;		/* per channel sums of the pending row */
+	uint32	oy;		/* pending output row */
+	int	hflip;
+} TIFFRGBAScaler;
+
+static uint32
+boxStart(uint32 o, uint32 in, uint32 out)
+{
+	return ((uint32)((uint64) o * in / out));
+}
+
+static uint32
+boxEnd(uint32 o, uint32 in, uint32 out)
+{
+	uint32 start = boxStart(o, in, out);
+	uint32 end = boxStart(o + 1, in, out);
+
+	return (end > start ? end : start + 1);
+}
+
+/*
+ * Add the input row shown at vy to the pending output row, and emit
+ * every output row whose box ends with it.
+ */
+static void
+scaleRow(TIFFRGBAScaler* sc, const uint32* row, uint32 vy)
+{
+	uint32 ox, x;
+	uint32 y0, y1;
+
+	for (ox = 0; ox < sc->outw; ox++) {
+		uint64* acc = sc->acc + 4 * ox;
+
+		for (x = sc->xbox[2*ox]; x < sc->xbox[2*ox+1]; x++) {
+			uint32 v = row[sc->hflip ? sc->inw - 1 - x : x];
+
+			acc[0] += TIFFGetR(v);
+			acc[1] += TIFFGetG(v);
+			acc[2] += TIFFGetB(v);
+			acc[3] += TIFFGetA(v);
+		}
+	}
+	while (sc->oy < sc->outh &&
+	    (y1 = boxEnd(sc->oy, sc->inh, sc->outh)) == vy + 1) {
+		uint32* cp = sc->raster + (tmsize_t)(sc->outh - 1 - sc->oy) * sc->outw;
+
+		y0 = boxStart(sc->oy, sc->inh, sc->outh);
+		for (ox = 0; ox < sc->outw; ox++) {
+			uint64* acc = sc->acc + 4 * ox;
+			uint64 n = (uint64)(sc->xbox[2*ox+1] - sc->xbox[2*ox]) *
+			    (y1 - y0);
+
+			cp[ox] = PACK4((acc[0] + n / 2) / n, (acc[1] + n / 2) / n,
+			    (acc[2] + n / 2) / n, (acc[3] + n / 2) / n);
+		}
+		/* when enlarging, the next box may be this same row */
+		if (++sc->oy < sc->outh &&
+		    boxStart(sc->oy, sc->inh, sc->outh) > vy)
+			_TIFFmemset(sc->acc, 0, 4 * sc->outw * sizeof (uint64));
+	}
+}
+
+/*
+ * Return the factor by which the JPEG codec can reduce the image in the
+ * inverse DCT without going below the requested size, and configure the
+ * codec for it.  Only 8-bit RGB and greyscale data without extra
+ * samples, which the codec returns as is, are handled.
+ */
+static uint32
+scaledJPEGDenom(TIFFRGBAImage* img, uint32 outw, uint32 outh, uint32 bandh)
+{
+	TIFF* tif = img->tif;
+	TIFFDirectory* td = &tif->tif_dir;
+	uint32 denom, tw = img->width;
+	int value;
+
+	if (td->td_compression != COMPRESSION_JPEG || img->bitspersample != 8 ||
+	    !img->isContig || td->td_extrasamples != 0 ||
+	    !((img->photometric == PHOTOMETRIC_RGB && img->samplesperpixel == 3) ||
+	      (img->photometric == PHOTOMETRIC_MINISBLACK && img->samplesperpixel == 1)) ||
+	    !TIFFGetField(tif, TIFFTAG_JPEGSCALEDENOM, &value) || value != 1)
+		return (1);
+	if (isTiled(tif))
+		TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tw);
+	for (denom = 8; denom > 1; denom /= 2) {
+		if (img->width / denom >= outw && img->height / denom >= outh &&
+		    tw % denom == 0 && bandh % denom == 0 &&
+		    TIFFSetField(tif, TIFFTAG_JPEGSCALEDENOM, (int) denom))
+			return (denom);
+	}
+	return (1);
+}
+
+/*
+ * Read the band of strips or tiles starting at row r0, decoded at
+ * 1/denom of their size, into band as ABGR pixels.
+ */
+static int
+readScaledJPEGBand(TIFFRGBAImage* img, uint8* chunk, uint32* band,
+    uint32 inw, uint32 r0, uint32 nrow, uint32 denom)
+{
+	TIFF* tif = img->tif;
+	uint32 tw = img->width, col, x, y;
+	uint32 rows = TIFFhowmany_32(nrow, denom);
+	int spp = img->samplesperpixel;
+
+	if (isTiled(tif))
+		TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tw);
+	for (col = 0; col < img->width; col += tw) {
+		uint32 cw = tw / denom, x0 = col / denom, n;
+
+		if ((isTiled(tif) ?
+		     TIFFReadEncodedTile(tif, TIFFComputeTile(tif, col, r0, 0, 0),
+		         chunk, (tmsize_t)(-1)) :
+		     TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, r0, 0),
+		         chunk, (tmsize_t)(-1))) == (tmsize_t)(-1))
+			return (0);
+		if (!isTiled(tif))
+			cw = inw;
+		n = (cw < inw - x0 ? cw : inw - x0);
+		for (y = 0; y < rows; y++) {
+			const uint8* pp = chunk + (tmsize_t) y * cw * spp;
+			uint32* cp = band + (tmsize_t) y * inw + x0;
+
+			if (spp == 3) {
+				for (x = 0; x < n; x++, pp += 3)
+					cp[x] = PACK(pp[0], pp[1], pp[2]);
+			} else {
+				for (x = 0; x < n; x++)
+					cp[x] = PACK(pp[x], pp[x], pp[x]);
+			}
+		}
+	}
+	return (1);
+}
+
+/*
+ * Read the image reduced or enlarged to outw by outh pixels into an
+ * ABGR-format raster with bottom left origin.  Pixels are averaged over
+ * boxes of the full image as each band of strips or tiles is decoded,
+ * so only one band of the input is held in memory.  JPEG data is
+ * reduced by up to a factor of 8 by the codec first when possible.
+ */
+int
+TIFFReadRGBAImageScaled(TIFF* tif, uint32 outw, uint32 outh, uint32* raster,
+    int stop)
+{
+	static const char module[] = "TIFFReadRGBAImageScaled";
+	char emsg[1024] = "";
+	TIFFRGBAImage img;
+	TIFFRGBAScaler sc;
+	uint32* band = NULL;
+	uint8* chunk = NULL;
+	uint32 bandh, nbands, denom, k, ox;
+	tmsize_t bandsize;
+	int flip, ok = 1;
+
+	if (outw == 0 || outh == 0) {
+		TIFFErrorExtR(tif, module,
+		    "Invalid output size %lux%lu",
+		    (unsigned long) outw, (unsigned long) outh);
+		return (0);
+	}
+	if (!TIFFRGBAImageOK(tif, emsg) ||
+	    !TIFFRGBAImageBegin(&img, tif, stop, emsg)) {
+		TIFFErrorExtR(tif, TIFFFileName(tif), "%s", emsg);
+		return (0);
+	}
+	/* flips are done here, the bands are read in file order */
+	img.req_orientation = ORIENTATION_TOPLEFT;
+	flip = setorientation(&img);
+	img.req_orientation = img.orientation;
+
+	if (isTiled(tif))
+		TIFFGetField(tif, TIFFTAG_TILELENGTH, &bandh);
+	else
+		TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &bandh);
+	if (bandh == 0 || bandh > img.height)
+		bandh = img.height;
+	denom = scaledJPEGDenom(&img, outw, outh, bandh);
+
+	_TIFFmemset(&sc, 0, sizeof (sc));
+	sc.inw = TIFFhowmany_32(img.width, denom);
+	sc.inh = TIFFhowmany_32(img.height, denom);
+	sc.outw = outw;
+	sc.outh = outh;
+	sc.raster = raster;
+	sc.hflip = (flip & FLIP_HORIZONTALLY) != 0;
+	bandsize = TIFFSafeMultiply(tmsize_t, (tmsize_t) sc.inw,
+	    TIFFhowmany_32(bandh, denom));
+	bandsize = TIFFSafeMultiply(tmsize_t, bandsize, sizeof (uint32));
+	if (bandsize != 0) {
+		band = (uint32*) _TIFFmallocExt(tif, bandsize);
+		sc.xbox = (uint32*) _TIFFmallocExt(tif, 2 * outw * sizeof (uint32));
+		sc.acc = (uint64*) _TIFFmallocExt(tif, 4 * outw * sizeof (uint64));
+		if (denom != 1)
+			chunk = (uint8*) _TIFFmallocExt(tif, isTiled(tif) ?
+			    TIFFTileSize(tif) : TIFFStripSize(tif));
+	}
+	if (band == NULL || sc.xbox == NULL || sc.acc == NULL ||
+	    (denom != 1 && chunk == NULL)) {
+		TIFFErrorExtR(tif, module,
+		    "No space for scaling buffers");
+		ok = 0;
+		goto done;
+	}
+	for (ox = 0; ox < outw; ox++) {
+		sc.xbox[2*ox] = boxStart(ox, sc.inw, outw);
+		sc.xbox[2*ox+1] = boxEnd(ox, sc.inw, outw);
+	}
+	_TIFFmemset(sc.acc, 0, 4 * outw * sizeof (uint64));
+
+	nbands = TIFFhowmany_32(img.height, bandh);
+	for (k = 0; k < nbands; k++) {
+		uint32 bi = (flip & FLIP_VERTICALLY) ? nbands - 1 - k : k;
+		uint32 r0 = bi * bandh;
+		uint32 nrow = (bandh < img.height - r0 ? bandh : img.height - r0);
+		uint32 rows = TIFFhowmany_32(nrow, denom), i;
+
+		_TIFFmemset(band, 0, bandsize);
+		img.row_offset = r0;
+		if (!(denom == 1 ?
+		      TIFFRGBAImageGet(&img, band, img.width, nrow) :
+		      readScaledJPEGBand(&img, chunk, band, sc.inw, r0, nrow,
+		          denom))) {
+			ok = 0;
+			if (stop)
+				break;
+		}
+		for (i = 0; i < rows; i++) {
+			uint32 fy = (flip & FLIP_VERTICALLY) ? rows - 1 - i : i;
+			uint32 vy = r0 / denom + fy;
+
+			if (flip & FLIP_VERTICALLY)
+				vy = sc.inh - 1 - vy;
+			scaleRow(&sc, band + (tmsize_t) fy * sc.inw, vy);
+		}
+	}
+
+done:
+	if (denom != 1)
+		TIFFSetField(tif, TIFFTAG_JPEGSCALEDENOM, 1);
+	if (band)
+		_TIFFfreeExt(tif, band);
+	if (chunk)
+		_TIFFfreeExt(tif, chunk);
+	if (sc.xbox)
+		_TIFFfreeExt(tif, sc.xbox);
+	if (sc.acc)
+		_TIFFfreeExt(tif, sc.acc);
+	TIFFRGBAImageEnd(&img);
+	return (ok);
+}
+
+struct _TIFFRGBAIterator {
+	TIFFRGBAImage	img;		/* tables are built once */
+	uint32*		band;		/* one band of raster rows */
+	uint32		bandh;		/* rows per strip or tile */
+	uint32		nbands;
+	uint32		next;		/* bands returned so far */
+	int		flip;
+};
+
+/*
+ * Set up the reading of the image in bands of whole strips or tiles,
+ * returned in the row order of a raster with the given orientation.
+ * Each band is converted into a buffer owned by the iterator, so memory
+ * use does not depend on the image height.
+ */
+TIFFRGBAIterator*
+TIFFRGBAIteratorBegin(TIFF* tif, int orientation, int stop, char emsg[1024])
+{
+	TIFFRGBAIterator* it;
+	tmsize_t bandsize;
+
+	it = (TIFFRGBAIterator*) _TIFFmallocExt(tif, sizeof (TIFFRGBAIterator));
+	if (it == NULL) {
+		sprintf(emsg, "No space for RGBA iterator");
+		return (NULL);
+	}
+	if (!TIFFRGBAImageOK(tif, emsg) ||
+	    !TIFFRGBAImageBegin(&it->img, tif, stop, emsg)) {
+		_TIFFfreeExt(tif, it);
+		return (NULL);
+	}
+	it->img.req_orientation = (uint16) orientation;
+	it->flip = setorientation(&it->img);
+	if (isTiled(tif))
+		TIFFGetField(tif, TIFFTAG_TILELENGTH, &it->bandh);
+	else
+		TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &it->bandh);
+	if (it->bandh == 0 || it->bandh > it->img.height)
+		it->bandh = it->img.height;
+	it->nbands = TIFFhowmany_32(it->img.height, it->bandh);
+	it->next = 0;
+	bandsize = TIFFSafeMultiply(tmsize_t, (tmsize_t) it->img.width,
+	    it->bandh);
+	bandsize = TIFFSafeMultiply(tmsize_t, bandsize, sizeof (uint32));
+	it->band = bandsize ? (uint32*) _TIFFmallocExt(tif, bandsize) : NULL;
+	if (it->band == NULL) {
+		sprintf(emsg, "No space for RGBA band of %lu rows",
+		    (unsigned long) it->bandh);
+		TIFFRGBAImageEnd(&it->img);
+		_TIFFfreeExt(tif, it);
+		return (NULL);
+	}
+	return (it);
+}
+
+/*
+ * Convert the next band.  On return *raster points to *nrows rows of
+ * the image width, starting with raster row *row.  Returns 1 if a band
+ * was converted, 0 once the whole image has been returned and -1 on
+ * error.
+ */
+int
+TIFFRGBAIteratorNext(TIFFRGBAIterator* it, uint32** raster, uint32* row,
+    uint32* nrows)
+{
+	TIFFRGBAImage* img = &it->img;
+	uint32 bi, r0, n;
+
+	if (it->next >= it->nbands)
+		return (0);
+	/* a raster flipped vertically starts with the last band */
+	bi = (it->flip & FLIP_VERTICALLY) ? it->nbands - 1 - it->next : it->next;
+	it->next++;
+	r0 = bi * it->bandh;
+	n = (it->bandh < img->height - r0 ? it->bandh : img->height - r0);
+	img->row_offset = r0;
+	if (!TIFFRGBAImageGet(img, it->band, img->width, n) && img->stoponerr)
+		return (-1);
+	*raster = it->band;
+	*row = (it->flip & FLIP_VERTICALLY) ? img->height - r0 - n : r0;
+	*nrows = n;
+	return (1);
+}
+
+void
+TIFFRGBAIteratorEnd(TIFFRGBAIterator* it)
+{
+	TIFF* tif;
+
+	if (it == NULL)
+		return;
+	tif = it->img.tif;
+	_TIFFfreeExt(tif, it->band);
+	TIFFRGBAImageEnd(&it->img);
+	_TIFFfreeExt(tif, it);
+}
+
+/*
+ * 16 bits per channel output.  The get routines and the conversions
+ * picked by TIFFRGBAImageBegin() are reused: the get routine is handed
+ * the caller's raster as if it held 32-bit pixels, and the put routines
+ * below store each pixel at the same pixel offset of the real, 64-bit
+ * raster.  RGB and greyscale data of 8 or 16 bits are converted
+ * directly; any other image goes through its 8-bit put routine, whose
+ * output is widened.
+ */
+typedef struct {
+	TIFFRGBAImage	img;		/* copy of the caller's state */
+	uint32*		base;		/* raster seen by the get routine */
+	uint64*		raster;		/* raster actually written */
+	union {
+	    tileContigRoutine contig;
+	    tileSeparateRoutine separate;
+	} put8;				/* 8-bit conversion to widen */
+	uint32*		scratch;	/* output of put8 */
+	tmsize_t	scratchsize;	/* in pixels */
+	int		failed;
+} TIFFRGBA64Image;
+
+#define	PACK64(r,g,b,a)	\
+	((uint64)(r)|((uint64)(g)<<16)|((uint64)(b)<<32)|((uint64)(a)<<48))
+#define	A64(v, a)	(((v) * (a) + 32767) / 65535)
+#define	RGBA64Out(img, cp) \
+	(((TIFFRGBA64Image*)(img))->raster + \
+	    ((cp) - ((TIFFRGBA64Image*)(img))->base))
+
+static int
+isRGBA64Direct(TIFFRGBAImage* img)
+{
+	if (img->bitspersample != 8 && img->bitspersample != 16)
+		return (0);
+	switch (img->photometric) {
+	case PHOTOMETRIC_RGB:
+		return (img->samplesperpixel >= 3);
+	case PHOTOMETRIC_MINISWHITE:
+	case PHOTOMETRIC_MINISBLACK:
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ * 8 or 16-bit RGB or greyscale samples, with optional alpha.
+ */
+static void
+putcontig64(TIFFRGBAImage* img, uint32* cp, uint32 x, uint32 y,
+    uint32 w, uint32 h, int32 fromskew, int32 toskew, unsigned char* pp)
+{
+	uint64* op = RGBA64Out(img, cp);
+	int samplesperpixel = img->samplesperpixel;
+	int wide = img->bitspersample == 16;
+	int grey = img->photometric != PHOTOMETRIC_RGB;
+	int og = grey ? 0 : 1, ob = grey ? 0 : 2, oa = grey ? 1 : 3;
+	int alpha = samplesperpixel > oa ? img->alpha : 0;
+	uint32 inv = img->photometric == PHOTOMETRIC_MINISWHITE ? 0xffff : 0;
+	tmsize_t stride = (tmsize_t) samplesperpixel * (wide ? 2 : 1);
+
+	(void) y;
+	for( ; h > 0; --h) {
+		for (x = w; x > 0; --x) {
+			uint32 r, g, b, a = 0xffff;
+
+			if (wide) {
+				const uint16* wp = (const uint16*) pp;
+
+				r = wp[0]; g = wp[og]; b = wp[ob];
+				if (alpha)
+					a = wp[oa];
+			} else {
+				r = pp[0] * 257; g = pp[og] * 257;
+				b = pp[ob] * 257;
+				if (alpha)
+					a = pp[oa] * 257;
+			}
+			r ^= inv; g ^= inv; b ^= inv;
+			if (alpha == EXTRASAMPLE_UNASSALPHA) {
+				r = A64(r, a); g = A64(g, a); b = A64(b, a);
+			}
+			*op++ = PACK64(r, g, b, a);
+			pp += stride;
+		}
+		op += toskew;
+		pp += fromskew * stride;
+	}
+}
+
+/*
+ * 8 or 16-bit unpacked RGB or greyscale samples, with optional alpha.
+ */
+static void
+putseparate64(TIFFRGBAImage* img, uint32* cp, uint32 x, uint32 y,
+    uint32 w, uint32 h, int32 fromskew, int32 toskew,
+    unsigned char* r, unsigned char* g, unsigned char* b, unsigned char* a)
+{
+	uint64* op = RGBA64Out(img, cp);
+	int alpha = a ? img->alpha : 0;
+	uint32 inv = img->photometric == PHOTOMETRIC_MINISWHITE ? 0xffff : 0;
+	tmsize_t i, rowsize = (tmsize_t) w + fromskew;
+
+	(void) x; (void) y;
+	for( ; h > 0; --h) {
+		for (i = 0; i < (tmsize_t) w; i++) {
+			uint32 vr, vg, vb, va = 0xffff;
+
+			if (img->bitspersample == 16) {
+				vr = ((const uint16*) r)[i];
+				vg = ((const uint16*) g)[i];
+				vb = ((const uint16*) b)[i];
+				if (alpha)
+					va = ((const uint16*) a)[i];
+			} else {
+				vr = r[i] * 257; vg = g[i] * 257;
+				vb = b[i] * 257;
+				if (alpha)
+					va = a[i] * 257;
+			}
+			vr ^= inv; vg ^= inv; vb ^= inv;
+			if (alpha == EXTRASAMPLE_UNASSALPHA) {
+				vr = A64(vr, va); vg = A64(vg, va);
+				vb = A64(vb, va);
+			}
+			*op++ = PACK64(vr, vg, vb, va);
+		}
+		op += toskew;
+		i = rowsize * (img->bitspersample / 8);
+		r += i; g += i; b += i;
+		if (a)
+			a += i;
+	}
+}
+
+/*
+ * Make room for w x h pixels of 8-bit put routine output.
+ */
+static uint32*
+getRGBA64Scratch(TIFFRGBA64Image* im, uint32 w, uint32 h)
+{
+	tmsize_t n = TIFFSafeMultiply(tmsize_t, (tmsize_t) w, h);
+
+	if (n > im->scratchsize) {
+		tmsize_t size = TIFFSafeMultiply(tmsize_t, n, sizeof (uint32));
+		uint32* p = size ? (uint32*) _TIFFreallocExt(im->img.tif,
+		    im->scratch, size) : NULL;
+
+		if (p == NULL) {
+			TIFFErrorExtR(im->img.tif,
+			    TIFFFileName(im->img.tif),
+			    "No space for RGBA64 conversion buffer");
+			im->failed = 1;
+			return (NULL);
+		}
+		im->scratch = p;
+		im->scratchsize = n;
+	}
+	return (im->scratch);
+}
+
+/*
+ * Widen the pixels of w x h 8-bit put routine output.
+ */
+static void
+widenRGBA64(uint64* op, const uint32* sp, uint32 w, uint32 h, int32 toskew)
+{
+	uint32 x;
+
+	for( ; h > 0; --h) {
+		for (x = w; x > 0; --x) {
+			uint32 v = *sp++;
+
+			*op++ = PACK64(TIFFGetR(v) * 257, TIFFGetG(v) * 257,
+			    TIFFGetB(v) * 257, TIFFGetA(v) * 257);
+		}
+		op += toskew;
+	}
+}
+
+static void
+putcontig64from8(TIFFRGBAImage* img, uint32* cp, uint32 x, uint32 y,
+    uint32 w, uint32 h, int32 fromskew, int32 toskew, unsigned char* pp)
+{
+	TIFFRGBA64Image* im = (TIFFRGBA64Image*) img;
+	uint32* sp = getRGBA64Scratch(im, w, h);
+
+	if (sp == NULL)
+		return;
+	(*im->put8.contig)(img, sp, x, y, w, h, fromskew, 0, pp);
+	widenRGBA64(RGBA64Out(img, cp), sp, w, h, toskew);
+}
+
+static void
+putseparate64from8(TIFFRGBAImage* img, uint32* cp, uint32 x, uint32 y,
+    uint32 w, uint32 h, int32 fromskew, int32 toskew,
+    unsigned char* r, unsigned char* g, unsigned char* b, unsigned char* a)
+{
+	TIFFRGBA64Image* im = (TIFFRGBA64Image*) img;
+	uint32* sp = getRGBA64Scratch(im, w, h);
+
+	if (sp == NULL)
+		return;
+	(*im->put8.separate)(img, sp, x, y, w, h, fromskew, 0, r, g, b, a);
+	widenRGBA64(RGBA64Out(img, cp), sp, w, h, toskew);
+}
+
+/*
+ * Like TIFFRGBAImageGet(), but with 16 bits per channel.  Each pixel
+ * of the raster holds R, G, B and A from the least significant 16 bits
+ * up, as extracted by TIFFGetR64() and friends.
+ */
+int
+TIFFRGBAImageGet64(TIFFRGBAImage* img, uint64* raster, uint32 w, uint32 h)
+{
+	static const uint16 orientations[] = {
+		ORIENTATION_TOPLEFT, ORIENTATION_TOPRIGHT,
+		ORIENTATION_BOTRIGHT, ORIENTATION_BOTLEFT
+	};
+	TIFFRGBA64Image im;
+	int ok, flip;
+
+	if (img->get == NULL || img->put.any == NULL)
+		return (TIFFRGBAImageGet(img, (uint32*) raster, w, h));
+	im.img = *img;
+	im.base = (uint32*) raster;
+	im.raster = raster;
+	im.scratch = NULL;
+	im.scratchsize = 0;
+	im.failed = 0;
+	if (img->isContig) {
+		im.put8.contig = img->put.contig;
+		im.img.put.contig = isRGBA64Direct(img) ?
+		    putcontig64 : putcontig64from8;
+	} else {
+		im.put8.separate = img->put.separate;
+		im.img.put.separate = isRGBA64Direct(img) ?
+		    putseparate64 : putseparate64from8;
+	}
+	/*
+	 * The get routines mirror rows as 32-bit pixels, so they are
+	 * asked for the vertical flip only and rows are mirrored here.
+	 */
+	flip = setorientation(img);
+	if (flip & FLIP_HORIZONTALLY) {
+		size_t i;
+
+		for (i = 0; i < TIFFArrayCount(orientations); i++) {
+			im.img.req_orientation = orientations[i];
+			if (setorientation(&im.img) == (flip & FLIP_VERTICALLY))
+				break;
+		}
+	}
+	ok = (*im.img.get)(&im.img, im.base, w, h) && !im.failed;
+	if (im.scratch)
+		_TIFFfreeExt(img->tif, im.scratch);
+	if (ok && (flip & FLIP_HORIZONTALLY)) {
+		uint32 line;
+
+		for (line = 0; line < h; line++) {
+			uint64* left = raster + (tmsize_t) line * w;
+			uint64* right = left + w - 1;
+
+			while (left < right) {
+				uint64 temp = *left;
+				*left++ = *right;
+				*right-- = temp;
+			}
+		}
+	}
+	return (ok);
+}
+
+/*
+ * Read the specified image into a raster of 16 bits per channel RGBA
+ * pixels with the given orientation.
+ */
+int
+TIFFReadRGBA64ImageOriented(TIFF* tif, uint32 rwidth, uint32 rheight,
+    uint64* raster, int orientation, int stop)
+{
+	char emsg[1024] = "";
+	TIFFRGBAImage img;
+	int ok;
+
+	if (TIFFRGBAImageOK(tif, emsg) &&
+	    TIFFRGBAImageBegin(&img, tif, stop, emsg)) {
+		img.req_orientation = (uint16) orientation;
+		ok = TIFFRGBAImageGet64(&img,
+		    raster + (tmsize_t)(rheight - img.height) * rwidth,
+		    rwidth, img.height);
+		TIFFRGBAImageEnd(&img);
+	} else {
+		TIFFErrorExtR(tif, TIFFFileName(tif), "%s", emsg);
+		ok = 0;
+	}
+	return (ok);
+}
+
+/*
+ * As TIFFReadRGBAImage(), with 16 bits per channel.
+ */
+int
+TIFFReadRGBA64Image(TIFF* tif, uint32 rwidth, uint32 rheight,
+    uint64* raster, int stop)
+{
+	return (TIFFReadRGBA64ImageOriented(tif, rwidth, rheight, raster,
+	    ORIENTATION_BOTLEFT, stop));
+}
+
 /* vim: set ts=8 sts=8 sw=8 noet: */
 /*
  * Local Variables:
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Reading and writing the strips and tiles of PLANARCONFIG_SEPARATE
+ * images as interleaved (contiguous) pixels.
+ *
+ * The strips or tiles of all the planes at one place in the image are
+ * decoded into a scratch buffer and interleaved into the caller's
+ * buffer in a single pass; writing splits the caller's pixels into the
+ * planes the same way before encoding them.
+ */
+#include "tiffiop.h"
+
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+/*
+ * SIMD kernels, for 2 to 4 planes of 1, 2, 4 or 8-byte samples.  Each
+ * step moves one vector of every plane, 16 / size pixels, with byte
+ * shuffles whose masks are computed for the plane count and sample
+ * size.  The kernels return the number of pixels they did.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSSE3
+static tmsize_t
+interleaveSSSE3(uint8* dst, uint8* const* planes, tmsize_t n, int nplanes,
+    int size)
+{
+	int8 masks[4][4][16];		/* [output vector][plane][byte] */
+	__m128i m[4][4], in[4], x;
+	tmsize_t step = 16 / size, i;
+	int k, p, j;
+
+	for (k = 0; k < nplanes; k++)
+		for (p = 0; p < nplanes; p++)
+			for (j = 0; j < 16; j++) {
+				int g = 16 * k + j, s = g / size;
+
+				masks[k][p][j] = (int8) (s % nplanes == p ?
+				    (s / nplanes) * size + g % size : -128);
+			}
+	for (k = 0; k < nplanes; k++)
+		for (p = 0; p < nplanes; p++)
+			m[k][p] = _mm_loadu_si128((const __m128i*) masks[k][p]);
+	for (i = 0; i + step <= n; i += step, dst += 16 * nplanes) {
+		for (p = 0; p < nplanes; p++)
+			in[p] = _mm_loadu_si128(
+			    (const __m128i*) (planes[p] + i * size));
+		for (k = 0; k < nplanes; k++) {
+			x = _mm_shuffle_epi8(in[0], m[k][0]);
+			for (p = 1; p < nplanes; p++)
+				x = _mm_or_si128(x,
+				    _mm_shuffle_epi8(in[p], m[k][p]));
+			_mm_storeu_si128((__m128i*) (dst + 16 * k), x);
+		}
+	}
+	return (i);
+}
+
+TIFF_TARGET_SSSE3
+static tmsize_t
+deinterleaveSSSE3(uint8* const* planes, const uint8* src, tmsize_t n,
+    int nplanes, int size)
+{
+	int8 masks[4][4][16];		/* [plane][input vector][byte] */
+	__m128i m[4][4], in[4], x;
+	tmsize_t step = 16 / size, i;
+	int k, p, j;
+
+	for (p = 0; p < nplanes; p++)
+		for (k = 0; k < nplanes; k++)
+			for (j = 0; j < 16; j++) {
+				int g = ((j / size) * nplanes + p) * size +
+				    j % size;
+
+				masks[p][k][j] = (int8) (g / 16 == k ?
+				    g % 16 : -128);
+			}
+	for (p = 0; p < nplanes; p++)
+		for (k = 0; k < nplanes; k++)
+			m[p][k] = _mm_loadu_si128((const __m128i*) masks[p][k]);
+	for (i = 0; i + step <= n; i += step, src += 16 * nplanes) {
+		for (k = 0; k < nplanes; k++)
+			in[k] = _mm_loadu_si128(
+			    (const __m128i*) (src + 16 * k));
+		for (p = 0; p < nplanes; p++) {
+			x = _mm_shuffle_epi8(in[0], m[p][0]);
+			for (k = 1; k < nplanes; k++)
+				x = _mm_or_si128(x,
+				    _mm_shuffle_epi8(in[k], m[p][k]));
+			_mm_storeu_si128((__m128i*) (planes[p] + i * size), x);
+		}
+	}
+	return (i);
+}
+#endif
+
+void
+_TIFFInterleaveKernels(TIFFKernels* k, int features)
+{
+#if defined(TIFF_SIMD_X86)
+	if ((features & (TIFF_CPU_SSE2|TIFF_CPU_SSSE3)) ==
+	    (TIFF_CPU_SSE2|TIFF_CPU_SSSE3)) {
+		k->interleave = interleaveSSSE3;
+		k->deinterleave = deinterleaveSSSE3;
+	}
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+#define	MOVESAMPLES(type, dst, dstep, src, sstep, n) {			\
+	type* d = (type*) (dst);					\
+	const type* s = (const type*) (src);				\
+	for (i = 0; i < (n); i++, d += (dstep), s += (sstep))		\
+		*d = *s;						\
+}
+
+/*
+ * Copy n samples of size bytes, stepping dstep and sstep samples
+ * between them.
+ */
+static void
+moveSamples(uint8* dst, tmsize_t dstep, const uint8* src, tmsize_t sstep,
+    tmsize_t n, int size)
+{
+	tmsize_t i;
+
+	switch (size) {
+	case 1: MOVESAMPLES(uint8, dst, dstep, src, sstep, n); break;
+	case 2: MOVESAMPLES(uint16, dst, dstep, src, sstep, n); break;
+	case 4: MOVESAMPLES(uint32, dst, dstep, src, sstep, n); break;
+	default: MOVESAMPLES(uint64, dst, dstep, src, sstep, n); break;
+	}
+}
+
+/*
+ * Interleave n pixels from nplanes planes lying stride bytes apart in
+ * one buffer, and the reverse.
+ */
+static void
+interleave(uint8* dst, uint8* planes, tmsize_t stride, tmsize_t n,
+    int nplanes, int size)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	tmsize_t done = 0;
+	int p;
+
+	if (k->interleave != NULL && nplanes <= 4) {
+		uint8* v[4];
+
+		for (p = 0; p < nplanes; p++)
+			v[p] = planes + p * stride;
+		done = (*k->interleave)(dst, v, n, nplanes, size);
+	}
+	for (p = 0; p < nplanes; p++)
+		moveSamples(dst + (done * nplanes + p) * size, nplanes,
+		    planes + p * stride + done * size, 1, n - done, size);
+}
+
+static void
+deinterleave(uint8* planes, tmsize_t stride, const uint8* src, tmsize_t n,
+    int nplanes, int size)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	tmsize_t done = 0;
+	int p;
+
+	if (k->deinterleave != NULL && nplanes <= 4) {
+		uint8* v[4];
+
+		for (p = 0; p < nplanes; p++)
+			v[p] = planes + p * stride;
+		done = (*k->deinterleave)(v, src, n, nplanes, size);
+	}
+	for (p = 0; p < nplanes; p++)
+		moveSamples(planes + p * stride + done * size, 1,
+		    src + (done * nplanes + p) * size, nplanes, n - done, size);
+}
+
+/*
+ * Check that the chunks of the current directory can be interleaved;
+ * returns 0 for a contiguous image, the size of a sample for a
+ * separate one, or -1 with an error.
+ */
+static int
+interleaveCheck(TIFF* tif, int tiles, const char* module)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+
+	if (tiles != (isTiled(tif) != 0)) {
+		TIFFErrorExtR(tif, module, tiles ?
+		    "Can not use tiles with a striped image" :
+		    "Can not use strips with a tiled image");
+		return (-1);
+	}
+	if (td->td_planarconfig != PLANARCONFIG_SEPARATE ||
+	    td->td_samplesperpixel == 1)
+		return (0);
+	if (td->td_bitspersample != 8 && td->td_bitspersample != 16 &&
+	    td->td_bitspersample != 32 && td->td_bitspersample != 64) {
+		TIFFErrorExtR(tif, module,
+		    "Cannot interleave %d-bit samples", td->td_bitspersample);
+		return (-1);
+	}
+	return (td->td_bitspersample / 8);
+}
+
+/* Number of chunks in a plane */
+static uint32
+planeChunks(TIFF* tif, int tiles)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+
+	if (tiles)
+		return (td->td_nstrips / td->td_samplesperpixel);
+	return (td->td_stripsperimage);
+}
+
+static tmsize_t
+readInterleaved(TIFF* tif, uint32 chunk, void* buf, tmsize_t size,
+    int tiles, const char* module)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	tmsize_t (*readchunk)(TIFF*, uint32, void*, tmsize_t);
+	tmsize_t planesize, n, got;
+	int ss, nplanes = td->td_samplesperpixel, p;
+	uint8* scratch;
+
+	readchunk = tiles ? TIFFReadEncodedTile : TIFFReadEncodedStrip;
+	if ((ss = interleaveCheck(tif, tiles, module)) <= 0)
+		return (ss < 0 ? (tmsize_t)(-1) :
+		    (*readchunk)(tif, chunk, buf, size));
+	if (chunk >= planeChunks(tif, tiles)) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: Chunk out of range, max %lu", (unsigned long) chunk,
+		    (unsigned long) planeChunks(tif, tiles));
+		return ((tmsize_t)(-1));
+	}
+	planesize = tiles ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	if (planesize == 0)
+		return ((tmsize_t)(-1));
+	if (size != (tmsize_t)(-1) && size / nplanes < planesize)
+		planesize = (size / (nplanes * ss)) * ss;
+	scratch = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_PLANES,
+	    planesize * nplanes);
+	if (scratch == NULL)
+		return ((tmsize_t)(-1));
+	n = planesize;
+	for (p = 0; p < nplanes; p++) {
+		got = (*readchunk)(tif, chunk + p * planeChunks(tif, tiles),
+		    scratch + p * planesize, planesize);
+		if (got == (tmsize_t)(-1))
+			return (got);
+		if (got < n)
+			n = got;
+	}
+	n /= ss;
+	interleave((uint8*) buf, scratch, planesize, n, nplanes, ss);
+	return (n * nplanes * ss);
+}
+
+static tmsize_t
+writeInterleaved(TIFF* tif, uint32 chunk, void* data, tmsize_t cc,
+    int tiles, const char* module)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	tmsize_t (*writechunk)(TIFF*, uint32, void*, tmsize_t);
+	tmsize_t planesize;
+	int ss, nplanes = td->td_samplesperpixel, p;
+	uint8* scratch;
+
+	writechunk = tiles ? TIFFWriteEncodedTile : TIFFWriteEncodedStrip;
+	if (!TIFFWriteCheck(tif, tiles, module))	/* sets up the strips */
+		return ((tmsize_t)(-1));
+	if ((ss = interleaveCheck(tif, tiles, module)) <= 0)
+		return (ss < 0 ? (tmsize_t)(-1) :
+		    (*writechunk)(tif, chunk, data, cc));
+	if (chunk >= planeChunks(tif, tiles)) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: Chunk out of range, max %lu", (unsigned long) chunk,
+		    (unsigned long) planeChunks(tif, tiles));
+		return ((tmsize_t)(-1));
+	}
+	planesize = (cc / (nplanes * ss)) * ss;
+	scratch = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_PLANES,
+	    planesize * nplanes);
+	if (scratch == NULL)
+		return ((tmsize_t)(-1));
+	deinterleave(scratch, planesize, (const uint8*) data, planesize / ss,
+	    nplanes, ss);
+	for (p = 0; p < nplanes; p++) {
+		if ((*writechunk)(tif, chunk + p * planeChunks(tif, tiles),
+		    scratch + p * planesize, planesize) == (tmsize_t)(-1))
+			return ((tmsize_t)(-1));
+	}
+	return (planesize * nplanes);
+}
+
+/*
+ * Read strip or tile number chunk of the first plane of the image and
+ * the matching ones of the other planes, and return their samples
+ * interleaved, as in a PLANARCONFIG_CONTIG image.  Contiguous images
+ * are read as by TIFFReadEncodedStrip() and TIFFReadEncodedTile().
+ */
+tmsize_t
+TIFFReadEncodedStripInterleaved(TIFF* tif, uint32 strip, void* buf,
+    tmsize_t size)
+{
+	return (readInterleaved(tif, strip, buf, size, 0,
+	    "TIFFReadEncodedStripInterleaved"));
+}
+
+tmsize_t
+TIFFReadEncodedTileInterleaved(TIFF* tif, uint32 tile, void* buf,
+    tmsize_t size)
+{
+	return (readInterleaved(tif, tile, buf, size, 1,
+	    "TIFFReadEncodedTileInterleaved"));
+}
+
+/*
+ * Write cc bytes of interleaved pixels as strip or tile number chunk of
+ * each plane of the image.
+ */
+tmsize_t
+TIFFWriteEncodedStripInterleaved(TIFF* tif, uint32 strip, void* data,
+    tmsize_t cc)
+{
+	return (writeInterleaved(tif, strip, data, cc, 0,
+	    "TIFFWriteEncodedStripInterleaved"));
+}
+
+tmsize_t
+TIFFWriteEncodedTileInterleaved(TIFF* tif, uint32 tile, void* data,
+    tmsize_t cc)
+{
+	return (writeInterleaved(tif, tile, data, cc, 1,
+	    "TIFFWriteEncodedTileInterleaved"));
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -35,33 +35,71 @@
 #ifdef JBIG_SUPPORT
 #include "jbig.h"
 
+/*
+ * The decoder is kept between calls, so a strip read a scanline at a time
+ * is decoded once and its rows are copied straight out of the decoder's
+ * image, which is released as soon as the last row has been given back.
+ */
+typedef struct {
+	struct jbg_dec_state decoder;
+	int		decoder_active;	/* decoder holds a decoded strip */
+	unsigned char*	image;		/* decoded rows */
+	tmsize_t	image_size;
+	tmsize_t	image_pos;	/* bytes given back */
+} JBIGState;
+
+#define	JBIGGetState(tif)	((JBIGState*)(tif)->tif_data)
+
+static void JBIGReleaseDecoder(TIFF* tif)
+{
+	JBIGState* sp = JBIGGetState(tif);
+
+	if (sp->decoder_active)
+	{
+		jbg_dec_free(&sp->decoder);
+		sp->decoder_active = 0;
+	}
+	sp->image = NULL;
+	sp->image_size = 0;
+	sp->image_pos = 0;
+}
+
 static int JBIGSetupDecode(TIFF* tif)
 {
 	if (TIFFNumberOfStrips(tif) != 1)
 	{
-		TIFFErrorExt(tif->tif_clientdata, "JBIG", "Multistrip images not supported in decoder");
+		TIFFErrorExtR(tif, "JBIG", "Multistrip images not supported in decoder");
 		return 0;
 	}
 
 	return 1;
 }
 
-static int JBIGDecode(TIFF* tif, uint8* buffer, tmsize_t size, uint16 s)
+static int JBIGPreDecode(TIFF* tif, uint16 s)
 {
-	struct jbg_dec_state decoder;
+	(void) s;
+	JBIGReleaseDecoder(tif);
+	return 1;
+}
+
+/*
+ * Decode the raw data of the strip, all of which has been read.
+ */
+static int JBIGDecodeStrip(TIFF* tif)
+{
+	JBIGState* sp = JBIGGetState(tif);
 	int decodeStatus = 0;
-	unsigned char* pImage = NULL;
-	(void) size, (void) s;
 
 	if (isFillOrder(tif, tif->tif_dir.td_fillorder))
 	{
-		TIFFReverseBits(tif->tif_rawdata, tif->tif_rawdatasize);
+		TIFFReverseBits(tif->tif_rawcp, tif->tif_rawcc);
 	}
 
-	jbg_dec_init(&decoder);
+	jbg_dec_init(&sp->decoder);
+	sp->decoder_active = 1;
 
 #if defined(HAVE_JBG_NEWLEN)
-	jbg_newlen(tif->tif_rawdata, (size_t)tif->tif_rawdatasize);
+	jbg_newlen(tif->tif_rawcp, (size_t)tif->tif_rawcc);
 	/*
 	 * I do not check the return status of jbg_newlen because even if this
 	 * function fails it does not necessarily mean that decoding the image
@@ -74,8 +112,13 @@ static int JBIGDecode(TIFF* tif, uint8* buffer, tmsize_t size, uint16 s)
 	 */
 #endif /* HAVE_JBG_NEWLEN */
 
-	decodeStatus = jbg_dec_in(&decoder, (unsigned char*)tif->tif_rawdata,
-				  (size_t)tif->tif_rawdatasize, NULL);
+	decodeStatus = jbg_dec_in(&sp->decoder, (unsigned char*)tif->tif_rawcp,
+				  (size_t)tif->tif_rawcc, NULL);
+	/* Leave the raw data as read, the strip may be decoded again */
+	if (isFillOrder(tif, tif->tif_dir.td_fillorder))
+	{
+		TIFFReverseBits(tif->tif_rawcp, tif->tif_rawcc);
+	}
 	if (JBG_EOK != decodeStatus)
 	{
 		/*
@@ -83,7 +126,7 @@ static int JBIGDecode(TIFF* tif, uint8* buffer, tmsize_t size, uint16 s)
 		 * JBIG-KIT. Since the 2.0 the error reporting functions were
 		 * changed. We will handle both cases here.
 		 */
-		TIFFErrorExt(tif->tif_clientdata,
+		TIFFErrorExtR(tif,
 			     "JBIG", "Error (%d) decoding: %s",
 			     decodeStatus,
 #if defined(JBG_EN)
@@ -92,13 +135,52 @@ static int JBIGDecode(TIFF* tif, uint8* buffer, tmsize_t size, uint16 s)
 			     jbg_strerror(decodeStatus)
 #endif
 			     );
-		jbg_dec_free(&decoder);
+		JBIGReleaseDecoder(tif);
+		return 0;
+	}
+	if (jbg_dec_getwidth(&sp->decoder) != tif->tif_dir.td_imagewidth)
+	{
+		TIFFErrorExtR(tif, "JBIG",
+			     "Decoded image is %lu pixels wide instead of %lu",
+			     jbg_dec_getwidth(&sp->decoder),
+			     (unsigned long) tif->tif_dir.td_imagewidth);
+		JBIGReleaseDecoder(tif);
 		return 0;
 	}
 
-	pImage = jbg_dec_getimage(&decoder, 0);
-	_TIFFmemcpy(buffer, pImage, jbg_dec_getsize(&decoder));
-	jbg_dec_free(&decoder);
+	sp->image = jbg_dec_getimage(&sp->decoder, 0);
+	sp->image_size = (tmsize_t)jbg_dec_getsize(&sp->decoder);
+	sp->image_pos = 0;
+	tif->tif_rawcp += tif->tif_rawcc;
+	tif->tif_rawcc = 0;
+	return 1;
+}
+
+static int JBIGDecode(TIFF* tif, uint8* buffer, tmsize_t size, uint16 s)
+{
+	JBIGState* sp = JBIGGetState(tif);
+	(void) s;
+
+	if (!sp->decoder_active && !JBIGDecodeStrip(tif))
+	{
+		return 0;
+	}
+	if (size > sp->image_size - sp->image_pos)
+	{
+		TIFFErrorExtR(tif, "JBIG",
+			     "Not enough data at scanline %lu (short %lu bytes)",
+			     (unsigned long) tif->tif_row,
+			     (unsigned long) (size - (sp->image_size - sp->image_pos)));
+		JBIGReleaseDecoder(tif);
+		return 0;
+	}
+
+	_TIFFmemcpy(buffer, sp->image + sp->image_pos, size);
+	sp->image_pos += size;
+	if (sp->image_pos == sp->image_size)
+	{
+		JBIGReleaseDecoder(tif);
+	}
 	return 1;
 }
 
@@ -106,7 +188,7 @@ static int JBIGSetupEncode(TIFF* tif)
 {
 	if (TIFFNumberOfStrips(tif) != 1)
 	{
-		TIFFErrorExt(tif->tif_clientdata, "JBIG", "Multistrip images not supported in encoder");
+		TIFFErrorExtR(tif, "JBIG", "Multistrip images not supported in encoder");
 		return 0;
 	}
 
@@ -177,10 +259,28 @@ static int JBIGEncode(TIFF* tif, uint8* buffer, tmsize_t size, uint16 s)
 	return 1;
 }
 
+static void JBIGCleanup(TIFF* tif)
+{
+	JBIGReleaseDecoder(tif);
+	_TIFFfreeExt(tif, tif->tif_data);
+	tif->tif_data = NULL;
+
+	_TIFFSetDefaultCompressionState(tif);
+}
+
 int TIFFInitJBIG(TIFF* tif, int scheme)
 {
 	assert(scheme == COMPRESSION_JBIG);
 
+	tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof(JBIGState));
+	if (tif->tif_data == NULL)
+	{
+		TIFFErrorExtR(tif, "TIFFInitJBIG",
+			     "No space for JBIG state block");
+		return 0;
+	}
+	_TIFFmemset(tif->tif_data, 0, sizeof(JBIGState));
+
 	/*
 	 * These flags are set so the JBIG Codec can control when to reverse
 	 * bits and when not to and to allow the jbig decoder and bit reverser
@@ -191,10 +291,13 @@ int TIFFInitJBIG(TIFF* tif, int scheme)
 
 	/* Setup the function pointers for encode, decode, and cleanup. */
 	tif->tif_setupdecode = JBIGSetupDecode;
+	tif->tif_predecode = JBIGPreDecode;
+	tif->tif_decoderow = JBIGDecode;
 	tif->tif_decodestrip = JBIGDecode;
 
 	tif->tif_setupencode = JBIGSetupEncode;
 	tif->tif_encodestrip = JBIGEncode;
+	tif->tif_cleanup = JBIGCleanup;
 
 	return 1;
 }
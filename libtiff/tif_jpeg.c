@@ -26,6 +26,7 @@
 #define VC_EXTRALEAN
 
 #include "tiffiop.h"
+#include <stddef.h>
 #include <stdlib.h>
 
 #ifdef JPEG_SUPPORT
@@ -47,6 +48,7 @@
 int TIFFFillStrip(TIFF* tif, uint32 strip);
 int TIFFFillTile(TIFF* tif, uint32 tile);
 int TIFFReInitJPEG_12( TIFF *tif, int scheme, int is_encode );
+void TIFFFreeJPEGDecoder_12( TIFF *tif );
 int TIFFJPEGIsFullStripRequired_12(TIFF* tif);
 
 /* We undefine FAR to avoid conflict with JPEG definition */
@@ -176,6 +178,7 @@ typedef struct {
 	int		jpegquality;	/* Compression quality level */
 	int		jpegcolormode;	/* Auto RGB<=>YCbCr convert? */
 	int		jpegtablesmode;	/* What to put in JPEGTables */
+	int		jpegscaledenom;	/* Decode at 1/N of full size */
 
         int             ycbcrsampling_fetched;
         int             max_allowed_scan_number;
@@ -183,12 +186,34 @@ typedef struct {
 
 #define	JState(tif)	((JPEGState*)(tif)->tif_data)
 
+/*
+ * The decompressor of a state block is kept in the handle when its
+ * directory is left, and the block reused by the next JPEG directory of
+ * the same precision, so reading a series of images does not create and
+ * destroy a libjpeg object for each.  tif_jpeg_12.c builds this file a
+ * second time, with the 12 bit libjpeg, which has a slot of its own.
+ */
+#if defined(TIFFInitJPEG)
+#define	JPEG_DECODER_SLOT	1
+#else
+#define	JPEG_DECODER_SLOT	0
+#endif
+
+/* The private part of the state, moved between blocks of a precision */
+#define	JPEG_STATE_TAIL	offsetof(JPEGState, tif)
+
 static int JPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s);
 static int JPEGDecodeRaw(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s);
 static int JPEGEncode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s);
 static int JPEGEncodeRaw(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s);
 static int JPEGInitializeLibJPEG(TIFF * tif, int decode );
+static int JPEGParkDecoder(TIFF* tif, JPEGState* sp);
 static int DecodeRowError(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s);
+static int DecodeScaledRowError(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s);
+static int DecodePlanesRowError(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s);
+#if !JPEG_LIB_MK1_OR_12BIT
+static int JPEGDecodePlanes(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s);
+#endif
 
 #define	FIELD_JPEGTABLES	(FIELD_CODEC+0)
 
@@ -196,7 +221,8 @@ static const TIFFField jpegFields[] = {
     { TIFFTAG_JPEGTABLES, -3, -3, TIFF_UNDEFINED, 0, TIFF_SETGET_C32_UINT8, TIFF_SETGET_C32_UINT8, FIELD_JPEGTABLES, FALSE, TRUE, "JPEGTables", NULL },
     { TIFFTAG_JPEGQUALITY, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, TRUE, FALSE, "", NULL },
     { TIFFTAG_JPEGCOLORMODE, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, FALSE, FALSE, "", NULL },
-    { TIFFTAG_JPEGTABLESMODE, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, FALSE, FALSE, "", NULL }
+    { TIFFTAG_JPEGTABLESMODE, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, FALSE, FALSE, "", NULL },
+    { TIFFTAG_JPEGSCALEDENOM, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, FALSE, FALSE, "", NULL }
 };
 
 /*
@@ -220,7 +246,7 @@ TIFFjpeg_error_exit(j_common_ptr cinfo)
 	char buffer[JMSG_LENGTH_MAX];
 
 	(*cinfo->err->format_message) (cinfo, buffer);
-	TIFFErrorExt(sp->tif->tif_clientdata, "JPEGLib", "%s", buffer);		/* display the error message */
+	TIFFErrorExtR(sp->tif, "JPEGLib", "%s", buffer);		/* display the error message */
 	jpeg_abort(cinfo);			/* clean up libjpeg state */
 	LONGJMP(sp->exit_jmpbuf, 1);		/* return to libtiff caller */
 }
@@ -236,7 +262,7 @@ TIFFjpeg_output_message(j_common_ptr cinfo)
 	char buffer[JMSG_LENGTH_MAX];
 
 	(*cinfo->err->format_message) (cinfo, buffer);
-	TIFFWarningExt(((JPEGState *) cinfo)->tif->tif_clientdata, "JPEGLib", "%s", buffer);
+	TIFFWarningExtR(((JPEGState *) cinfo)->tif, "JPEGLib", "%s", buffer);
 }
 
 /* Avoid the risk of denial-of-service on crafted JPEGs with an insane */
@@ -252,7 +278,7 @@ TIFFjpeg_progress_monitor(j_common_ptr cinfo)
             ((j_decompress_ptr)cinfo)->input_scan_number;
         if (scan_no >= sp->max_allowed_scan_number)
         {
-            TIFFErrorExt(((JPEGState *) cinfo)->tif->tif_clientdata, 
+            TIFFErrorExtR(((JPEGState *) cinfo)->tif,
                      "TIFFjpeg_progress_monitor",
                      "Scan number %d exceeds maximum scans (%d). This limit "
                      "can be raised through the LIBTIFF_JPEG_MAX_ALLOWED_SCAN_NUMBER "
@@ -516,7 +542,7 @@ tables_empty_output_buffer(j_compress_ptr cinfo)
 	void* newbuf;
 
 	/* the entire buffer has been filled; enlarge it by 1000 bytes */
-	newbuf = _TIFFrealloc((void*) sp->jpegtables,
+	newbuf = _TIFFreallocExt(sp->tif, (void*) sp->jpegtables,
 			      (tmsize_t) (sp->jpegtables_length + 1000));
 	if (newbuf == NULL)
 		ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 100);
@@ -545,12 +571,12 @@ TIFFjpeg_tables_dest(JPEGState* sp, TIFF* tif)
 	 * Initial size is 1000 bytes, which is usually adequate.
 	 */
 	if (sp->jpegtables)
-		_TIFFfree(sp->jpegtables);
+		_TIFFfreeExt(tif, sp->jpegtables);
 	sp->jpegtables_length = 1000;
-	sp->jpegtables = (void*) _TIFFmalloc((tmsize_t) sp->jpegtables_length);
+	sp->jpegtables = (void*) _TIFFmallocExt(tif, (tmsize_t) sp->jpegtables_length);
 	if (sp->jpegtables == NULL) {
 		sp->jpegtables_length = 0;
-		TIFFErrorExt(sp->tif->tif_clientdata, "TIFFjpeg_tables_dest", "No space for JPEGTables");
+		TIFFErrorExtR(sp->tif, "TIFFjpeg_tables_dest", "No space for JPEGTables");
 		return (0);
 	}
 	sp->cinfo.c.dest = &sp->dest;
@@ -781,11 +807,8 @@ JPEGFixupTagsSubsampling(TIFF* tif)
 	static const char module[] = "JPEGFixupTagsSubsampling";
 	struct JPEGFixupTagsSubsamplingData m;
 
-        _TIFFFillStriles( tif );
-        
-        if( tif->tif_dir.td_stripbytecount == NULL
-            || tif->tif_dir.td_stripoffset == NULL
-            || tif->tif_dir.td_stripbytecount[0] == 0 )
+        if( !_TIFFHaveStriles( tif )
+            || TIFFGetStrileByteCount(tif, 0) == 0 )
         {
             /* Do not even try to check if the first strip/tile does not
                yet exist, as occurs when GDAL has created a new NULL file
@@ -795,22 +818,22 @@ JPEGFixupTagsSubsampling(TIFF* tif)
 
 	m.tif=tif;
 	m.buffersize=2048;
-	m.buffer=_TIFFmalloc(m.buffersize);
+	m.buffer=_TIFFmallocExt(tif, m.buffersize);
 	if (m.buffer==NULL)
 	{
-		TIFFWarningExt(tif->tif_clientdata,module,
+		TIFFWarningExtR(tif,module,
 		    "Unable to allocate memory for auto-correcting of subsampling values; auto-correcting skipped");
 		return;
 	}
 	m.buffercurrentbyte=NULL;
 	m.bufferbytesleft=0;
-	m.fileoffset=tif->tif_dir.td_stripoffset[0];
+	m.fileoffset=TIFFGetStrileOffset(tif, 0);
 	m.filepositioned=0;
-	m.filebytesleft=tif->tif_dir.td_stripbytecount[0];
+	m.filebytesleft=TIFFGetStrileByteCount(tif, 0);
 	if (!JPEGFixupTagsSubsamplingSec(&m))
-		TIFFWarningExt(tif->tif_clientdata,module,
+		TIFFWarningExtR(tif,module,
 		    "Unable to auto-correct subsampling values, likely corrupt JPEG compressed data in first strip/tile; auto-correcting skipped");
-	_TIFFfree(m.buffer);
+	_TIFFfreeExt(tif, m.buffer);
 }
 
 static int
@@ -900,7 +923,7 @@ JPEGFixupTagsSubsamplingSec(struct JPEGFixupTagsSubsamplingData* data)
 							return(0);
 						if (p!=0x11)
 						{
-							TIFFWarningExt(data->tif->tif_clientdata,module,
+							TIFFWarningExtR(data->tif,module,
 							    "Subsampling values inside JPEG compressed data have no TIFF equivalent, auto-correction of TIFF subsampling values failed");
 							return(1);
 						}
@@ -908,13 +931,13 @@ JPEGFixupTagsSubsamplingSec(struct JPEGFixupTagsSubsamplingData* data)
 					}
 					if (((ph!=1)&&(ph!=2)&&(ph!=4))||((pv!=1)&&(pv!=2)&&(pv!=4)))
 					{
-						TIFFWarningExt(data->tif->tif_clientdata,module,
+						TIFFWarningExtR(data->tif,module,
 						    "Subsampling values inside JPEG compressed data have no TIFF equivalent, auto-correction of TIFF subsampling values failed");
 						return(1);
 					}
 					if ((ph!=data->tif->tif_dir.td_ycbcrsubsampling[0])||(pv!=data->tif->tif_dir.td_ycbcrsubsampling[1]))
 					{
-						TIFFWarningExt(data->tif->tif_clientdata,module,
+						TIFFWarningExtR(data->tif,module,
 						    "Auto-corrected former TIFF subsampling values [%d,%d] to match subsampling values inside JPEG compressed data [%d,%d]",
 						    (int)data->tif->tif_dir.td_ycbcrsubsampling[0],
 						    (int)data->tif->tif_dir.td_ycbcrsubsampling[1],
@@ -1003,6 +1026,45 @@ JPEGFixupTagsSubsamplingSkip(struct JPEGFixupTagsSubsamplingData* data, uint16 s
 #endif
 
 
+#if defined(JPEG_DUAL_MODE_8_12) && !defined(TIFFInitJPEG)
+/*
+ * Hand a 12 bit directory over to the code built with the 12 bit libjpeg.
+ * If this block holds an 8 bit libjpeg object, the tag values move to the
+ * idle 12 bit block of the handle, or a new one, and this block is kept
+ * for the next 8 bit directory.
+ */
+static int
+JPEGSwitchTo12(TIFF* tif, int is_encode)
+{
+	JPEGState* sp = JState(tif);
+	JPEGState* sp12 = (JPEGState*) tif->tif_jpegdecoders[1];
+
+	if (sp12 == NULL && sp->cinfo_initialized) {
+		sp12 = (JPEGState*) _TIFFmallocExt(tif, sizeof (JPEGState));
+		if (sp12 == NULL) {
+			TIFFErrorExtR(tif, "JPEGSwitchTo12",
+				     "No space for JPEG state block");
+			return 0;
+		}
+		_TIFFmemset(sp12, 0, sizeof (JPEGState));
+	}
+	if (sp12 != NULL) {
+		tif->tif_jpegdecoders[1] = NULL;
+		_TIFFmemcpy((uint8*) sp12 + JPEG_STATE_TAIL,
+			    (uint8*) sp + JPEG_STATE_TAIL,
+			    sizeof (JPEGState) - JPEG_STATE_TAIL);
+		sp->jpegtables = NULL;		/* now owned by sp12 */
+		if (!JPEGParkDecoder(tif, sp)) {
+			if (sp->cinfo_initialized)
+				TIFFjpeg_destroy(sp);
+			_TIFFfreeExt(tif, sp);
+		}
+		tif->tif_data = (uint8*) sp12;
+	}
+	return TIFFReInitJPEG_12( tif, COMPRESSION_JPEG, is_encode );
+}
+#endif
+
 static int
 JPEGSetupDecode(TIFF* tif)
 {
@@ -1011,7 +1073,7 @@ JPEGSetupDecode(TIFF* tif)
 
 #if defined(JPEG_DUAL_MODE_8_12) && !defined(TIFFInitJPEG)
         if( tif->tif_dir.td_bitspersample == 12 )
-            return TIFFReInitJPEG_12( tif, COMPRESSION_JPEG, 0 );
+            return JPEGSwitchTo12( tif, 0 );
 #endif
 
 	JPEGInitializeLibJPEG( tif, TRUE );
@@ -1019,11 +1081,17 @@ JPEGSetupDecode(TIFF* tif)
 	assert(sp != NULL);
 	assert(sp->cinfo.comm.is_decompressor);
 
-	/* Read JPEGTables if it is present */
+	/*
+	 * Read JPEGTables if it is present.  This is done once per
+	 * directory: libjpeg keeps the parsed quantization and Huffman
+	 * tables across the jpeg_abort() done in JPEGPreDecode(), so the
+	 * abbreviated stream of each strip/tile only carries its frame and
+	 * scan headers.
+	 */
 	if (TIFFFieldSet(tif,FIELD_JPEGTABLES)) {
 		TIFFjpeg_tables_src(sp);
 		if(TIFFjpeg_read_header(sp,FALSE) != JPEG_HEADER_TABLES_ONLY) {
-			TIFFErrorExt(tif->tif_clientdata, "JPEGSetupDecode", "Bogus JPEGTables field");
+			TIFFErrorExtR(tif, "JPEGSetupDecode", "Bogus JPEGTables field");
 			return (0);
 		}
 	}
@@ -1094,7 +1162,7 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 	TIFFDirectory *td = &tif->tif_dir;
 	static const char module[] = "JPEGPreDecode";
 	uint32 segment_width, segment_height;
-	int downsampled_output;
+	int downsampled_output, planar_output;
 	int ci;
 
 	assert(sp != NULL);
@@ -1145,7 +1213,7 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 	}
 	if (sp->cinfo.d.image_width < segment_width ||
 	    sp->cinfo.d.image_height < segment_height) {
-		TIFFWarningExt(tif->tif_clientdata, module,
+		TIFFWarningExtR(tif, module,
 			       "Improper JPEG strip/tile size, "
 			       "expected %dx%d, got %dx%d",
 			       segment_width, segment_height,
@@ -1160,7 +1228,7 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 		/* but their JPEG codestream has still the maximum strip */
 		/* height. Warn about this as this is non compliant, but */
 		/* we can safely recover from that. */
-		TIFFWarningExt(tif->tif_clientdata, module,
+		TIFFWarningExtR(tif, module,
 			     "JPEG strip size exceeds expected dimensions,"
 			     " expected %dx%d, got %dx%d",
 			     segment_width, segment_height,
@@ -1174,7 +1242,7 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 		 * return, some potential security issues arise. Catch this
 		 * case and error out.
 		 */
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "JPEG strip/tile size exceeds expected dimensions,"
 			     " expected %dx%d, got %dx%d",
 			     segment_width, segment_height,
@@ -1184,19 +1252,19 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 	if (sp->cinfo.d.num_components !=
 	    (td->td_planarconfig == PLANARCONFIG_CONTIG ?
 	     td->td_samplesperpixel : 1)) {
-		TIFFErrorExt(tif->tif_clientdata, module, "Improper JPEG component count");
+		TIFFErrorExtR(tif, module, "Improper JPEG component count");
 		return (0);
 	}
 #ifdef JPEG_LIB_MK1
 	if (12 != td->td_bitspersample && 8 != td->td_bitspersample) {
-		TIFFErrorExt(tif->tif_clientdata, module, "Improper JPEG data precision");
+		TIFFErrorExtR(tif, module, "Improper JPEG data precision");
 		return (0);
 	}
 	sp->cinfo.d.data_precision = td->td_bitspersample;
 	sp->cinfo.d.bits_in_jsample = td->td_bitspersample;
 #else
 	if (sp->cinfo.d.data_precision != td->td_bitspersample) {
-		TIFFErrorExt(tif->tif_clientdata, module, "Improper JPEG data precision");
+		TIFFErrorExtR(tif, module, "Improper JPEG data precision");
 		return (0);
 	}
 #endif
@@ -1225,7 +1293,7 @@ JPEGPreDecode(TIFF* tif, uint16 s)
             if( nRequiredMemory > TIFF_LIBJPEG_LARGEST_MEM_ALLOC &&
                 getenv("LIBTIFF_ALLOW_LARGE_LIBJPEG_MEM_ALLOC") == NULL )
             {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                         "Reading this strip would require libjpeg to allocate "
                         "at least %u bytes. "
                         "This is disabled since above the %u threshold. "
@@ -1245,7 +1313,7 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 		/* Component 0 should have expected sampling factors */
 		if (sp->cinfo.d.comp_info[0].h_samp_factor != sp->h_sampling ||
 		    sp->cinfo.d.comp_info[0].v_samp_factor != sp->v_sampling) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				       "Improper JPEG sampling factors %d,%d\n"
 				       "Apparently should be %d,%d.",
 				       sp->cinfo.d.comp_info[0].h_samp_factor,
@@ -1257,7 +1325,7 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 		for (ci = 1; ci < sp->cinfo.d.num_components; ci++) {
 			if (sp->cinfo.d.comp_info[ci].h_samp_factor != 1 ||
 			    sp->cinfo.d.comp_info[ci].v_samp_factor != 1) {
-				TIFFErrorExt(tif->tif_clientdata, module, "Improper JPEG sampling factors");
+				TIFFErrorExtR(tif, module, "Improper JPEG sampling factors");
 				return (0);
 			}
 		}
@@ -1265,11 +1333,12 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 		/* PC 2's single component should have sampling factors 1,1 */
 		if (sp->cinfo.d.comp_info[0].h_samp_factor != 1 ||
 		    sp->cinfo.d.comp_info[0].v_samp_factor != 1) {
-			TIFFErrorExt(tif->tif_clientdata, module, "Improper JPEG sampling factors");
+			TIFFErrorExtR(tif, module, "Improper JPEG sampling factors");
 			return (0);
 		}
 	}
 	downsampled_output = FALSE;
+	planar_output = FALSE;
 	if (td->td_planarconfig == PLANARCONFIG_CONTIG &&
 	    sp->photometric == PHOTOMETRIC_YCBCR &&
 	    sp->jpegcolormode == JPEGCOLORMODE_RGB) {
@@ -1284,6 +1353,18 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 		    (sp->h_sampling != 1 || sp->v_sampling != 1))
 			downsampled_output = TRUE;
 		/* XXX what about up-sampling? */
+		if (td->td_planarconfig == PLANARCONFIG_CONTIG &&
+		    sp->photometric == PHOTOMETRIC_YCBCR &&
+		    sp->jpegcolormode == JPEGCOLORMODE_PLANES) {
+#if JPEG_LIB_MK1_OR_12BIT
+			TIFFErrorExtR(tif, module,
+			    "JPEGCOLORMODE_PLANES is only supported for 8 bit data");
+			return (0);
+#else
+			downsampled_output = TRUE;
+			planar_output = TRUE;
+#endif
+		}
 	}
 	if (downsampled_output) {
 		/* Need to use raw-data interface to libjpeg */
@@ -1294,6 +1375,13 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 		tif->tif_decoderow = DecodeRowError;
 		tif->tif_decodestrip = JPEGDecodeRaw;
 		tif->tif_decodetile = JPEGDecodeRaw;
+#if !JPEG_LIB_MK1_OR_12BIT
+		if (planar_output) {
+			tif->tif_decoderow = DecodePlanesRowError;
+			tif->tif_decodestrip = JPEGDecodePlanes;
+			tif->tif_decodetile = JPEGDecodePlanes;
+		}
+#endif
 	} else {
 		/* Use normal interface to libjpeg */
 		sp->cinfo.d.raw_data_out = FALSE;
@@ -1301,9 +1389,29 @@ JPEGPreDecode(TIFF* tif, uint16 s)
 		tif->tif_decodestrip = JPEGDecode;
 		tif->tif_decodetile = JPEGDecode;  
 	}
+	if (sp->jpegscaledenom != 1) {
+		/*
+		 * Let the IDCT produce a reduced size image directly.
+		 * libjpeg only does this through its normal interface.
+		 */
+		if (downsampled_output) {
+			TIFFErrorExtR(tif, module,
+			    "Reduced size decoding of subsampled YCbCr data "
+			    "requires JPEGCOLORMODE_RGB");
+			return (0);
+		}
+		sp->cinfo.d.scale_num = 1;
+		sp->cinfo.d.scale_denom = sp->jpegscaledenom;
+		tif->tif_decoderow = DecodeScaledRowError;
+	}
 	/* Start JPEG decompressor */
 	if (!TIFFjpeg_start_decompress(sp))
 		return (0);
+	if (sp->jpegscaledenom != 1)
+		sp->bytesperline = (tmsize_t)
+		    TIFFhowmany8_64((uint64) sp->cinfo.d.output_width *
+				    sp->cinfo.d.output_components *
+				    td->td_bitspersample);
 	/* Allocate downsampled-data buffers if needed */
 	if (downsampled_output) {
 		if (!alloc_downsampled_buffers(tif, sp->cinfo.d.comp_info,
@@ -1338,11 +1446,11 @@ JPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
         
 	nrows = cc / sp->bytesperline;
 	if (cc % sp->bytesperline)
-		TIFFWarningExt(tif->tif_clientdata, tif->tif_name,
+		TIFFWarningExtR(tif, tif->tif_name,
                                "fractional scanline not read");
 
-	if( nrows > (tmsize_t) sp->cinfo.d.image_height )
-		nrows = sp->cinfo.d.image_height;
+	if( nrows > (tmsize_t) sp->cinfo.d.output_height )
+		nrows = sp->cinfo.d.output_height;
 
 	/* data is expected to be read in multiples of a scanline */
 	if (nrows)
@@ -1375,6 +1483,24 @@ JPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 #endif /* !JPEG_LIB_MK1_OR_12BIT */
 
 #if JPEG_LIB_MK1_OR_12BIT
+/*
+ * Pack n 12 bit samples, two to three bytes, the last one to two bytes
+ * if n is odd.
+ */
+static void
+JPEGPack12(uint8* out, const JSAMPLE* in, tmsize_t n)
+{
+	for (; n >= 2; n -= 2, in += 2, out += 3) {
+		out[0] = (uint8)((in[0] & 0xff0) >> 4);
+		out[1] = (uint8)(((in[0] & 0xf) << 4) | ((in[1] & 0xf00) >> 8));
+		out[2] = (uint8)(in[1] & 0xff);
+	}
+	if (n > 0) {
+		out[0] = (uint8)((in[0] & 0xff0) >> 4);
+		out[1] = (uint8)((in[0] & 0xf) << 4);
+	}
+}
+
 /*ARGSUSED*/ static int
 JPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 {
@@ -1394,11 +1520,11 @@ JPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
         
 	nrows = cc / sp->bytesperline;
 	if (cc % sp->bytesperline)
-		TIFFWarningExt(tif->tif_clientdata, tif->tif_name,
+		TIFFWarningExtR(tif, tif->tif_name,
                                "fractional scanline not read");
 
-	if( nrows > (tmsize_t) sp->cinfo.d.image_height )
-		nrows = sp->cinfo.d.image_height;
+	if( nrows > (tmsize_t) sp->cinfo.d.output_height )
+		nrows = sp->cinfo.d.output_height;
 
 	/* data is expected to be read in multiples of a scanline */
 	if (nrows)
@@ -1412,8 +1538,11 @@ JPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
                 if( sp->cinfo.d.data_precision == 12 )
                 {
                         line_work_buf = (JSAMPROW)
-                                _TIFFmalloc(sizeof(short) * sp->cinfo.d.output_width
+                                _TIFFGetScratch(tif, TIFF_SCRATCH_CODEC,
+                                            sizeof(short) * sp->cinfo.d.output_width
                                             * sp->cinfo.d.num_components );
+                        if( line_work_buf == NULL )
+                                return (0);
                 }
 
                do
@@ -1431,21 +1560,9 @@ JPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 
                                if( sp->cinfo.d.data_precision == 12 )
                                {
-                                       int value_pairs = (sp->cinfo.d.output_width
-                                                          * sp->cinfo.d.num_components) / 2;
-                                       int iPair;
-
-                                       for( iPair = 0; iPair < value_pairs; iPair++ )
-                                       {
-                                               unsigned char *out_ptr =
-                                                       ((unsigned char *) buf) + iPair * 3;
-                                               JSAMPLE *in_ptr = line_work_buf + iPair * 2;
-
-                                               out_ptr[0] = (unsigned char)((in_ptr[0] & 0xff0) >> 4);
-                                               out_ptr[1] = (unsigned char)(((in_ptr[0] & 0xf) << 4)
-                                                       | ((in_ptr[1] & 0xf00) >> 8));
-                                               out_ptr[2] = (unsigned char)(((in_ptr[1] & 0xff) >> 0));
-                                       }
+                                       JPEGPack12( buf, line_work_buf,
+                                                   (tmsize_t) sp->cinfo.d.output_width
+                                                   * sp->cinfo.d.num_components );
                                }
                                else if( sp->cinfo.d.data_precision == 8 )
                                {
@@ -1465,9 +1582,6 @@ JPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
                        buf += sp->bytesperline;
                        cc -= sp->bytesperline;
                } while (--nrows > 0);
-
-               if( line_work_buf != NULL )
-                       _TIFFfree( line_work_buf );
         }
 
         /* Update information on consumed data */
@@ -1488,11 +1602,104 @@ DecodeRowError(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
     (void) cc;
     (void) s;
 
-    TIFFErrorExt(tif->tif_clientdata, "TIFFReadScanline",
+    TIFFErrorExtR(tif, "TIFFReadScanline",
                  "scanline oriented access is not supported for downsampled JPEG compressed images, consider enabling TIFF_JPEGCOLORMODE as JPEGCOLORMODE_RGB." );
     return 0;
 }
 
+/*ARGSUSED*/ static int
+DecodeScaledRowError(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
+
+{
+    (void) buf;
+    (void) cc;
+    (void) s;
+
+    TIFFErrorExtR(tif, "TIFFReadScanline",
+                 "scanline oriented access is not supported when TIFFTAG_JPEGSCALEDENOM is set, read whole strips or tiles instead." );
+    return 0;
+}
+
+/*ARGSUSED*/ static int
+DecodePlanesRowError(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
+
+{
+    (void) buf;
+    (void) cc;
+    (void) s;
+
+    TIFFErrorExtR(tif, "TIFFReadScanline",
+                 "scanline oriented access is not supported with JPEGCOLORMODE_PLANES, read whole strips or tiles instead." );
+    return 0;
+}
+
+#if !JPEG_LIB_MK1_OR_12BIT
+/*
+ * Decode a chunk of pixels.
+ * Returned data is one plane per component, each at its own sampling:
+ * the Y plane followed by the Cb and Cr planes, rows packed without
+ * padding.  The planes are copied straight from libjpeg's raw data
+ * buffers, without interleaving into clumps.
+ */
+/*ARGSUSED*/ static int
+JPEGDecodePlanes(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
+{
+	JPEGState *sp = JState(tif);
+	TIFFDirectory *td = &tif->tif_dir;
+	jpeg_component_info *compptr;
+	uint8* planes[MAX_COMPONENTS];
+	uint32 planerows[MAX_COMPONENTS];
+	int maxv = sp->cinfo.d.max_v_samp_factor;
+	uint32 nrows, row;
+	tmsize_t needed = 0;
+	int ci;
+	(void) s;
+
+	nrows = sp->cinfo.d.image_height;
+	/* For last strip, limit number of rows to its truncated height */
+	if (nrows > td->td_imagelength - tif->tif_row && !isTiled(tif))
+		nrows = td->td_imagelength - tif->tif_row;
+
+	for (ci = 0, compptr = sp->cinfo.d.comp_info;
+	     ci < sp->cinfo.d.num_components; ci++, compptr++) {
+		planerows[ci] = TIFFhowmany_32(nrows * compptr->v_samp_factor,
+					       maxv);
+		planes[ci] = buf + needed;
+		needed += (tmsize_t) planerows[ci] * compptr->downsampled_width;
+	}
+	if (cc < needed) {
+		TIFFErrorExtR(tif, "JPEGDecodePlanes",
+			     "application buffer not large enough for all data.");
+		return 0;
+	}
+
+	for (row = 0; row < nrows; row += maxv * DCTSIZE) {
+		int n = maxv * DCTSIZE;
+
+		if (TIFFjpeg_read_raw_data(sp, sp->ds_buffer, n) != n)
+			return (0);
+		for (ci = 0, compptr = sp->cinfo.d.comp_info;
+		     ci < sp->cinfo.d.num_components; ci++, compptr++) {
+			JDIMENSION width = compptr->downsampled_width;
+			uint32 first = row / maxv * compptr->v_samp_factor;
+			uint32 count = compptr->v_samp_factor * DCTSIZE;
+			uint32 r;
+
+			if (count > planerows[ci] - first)
+				count = planerows[ci] - first;
+			for (r = 0; r < count; r++)
+				_TIFFmemcpy(planes[ci] + (tmsize_t)(first + r) * width,
+					    sp->ds_buffer[ci][r], width);
+		}
+	}
+	tif->tif_row += nrows;
+
+	/* Close down the decompressor if done. */
+	return sp->cinfo.d.output_scanline < sp->cinfo.d.output_height
+		|| TIFFjpeg_finish_decompress(sp);
+}
+#endif /* !JPEG_LIB_MK1_OR_12BIT */
+
 /*
  * Decode a chunk of pixels.
  * Returned data is downsampled per sampling factors.
@@ -1518,24 +1725,28 @@ JPEGDecodeRaw(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 		/* Cb,Cr both have sampling factors 1, so this is correct */
 		JDIMENSION clumps_per_line = sp->cinfo.d.comp_info[1].downsampled_width;            
 		int samples_per_clump = sp->samplesperclump;
+		/* One line of clumps covers v_sampling rows of the image */
+		tmsize_t bytesperclumpline = (tmsize_t) TIFFhowmany8_64(
+		    (uint64) clumps_per_line * samples_per_clump *
+		    td->td_bitspersample);
 
 #if defined(JPEG_LIB_MK1_OR_12BIT)
-		unsigned short* tmpbuf = _TIFFmalloc(sizeof(unsigned short) *
-						     sp->cinfo.d.output_width *
-						     sp->cinfo.d.num_components);
-		if(tmpbuf==NULL) {
-                        TIFFErrorExt(tif->tif_clientdata, "JPEGDecodeRaw",
-				     "Out of memory");
+		/* one line of clumps, unpacked */
+		tmsize_t samples_per_clumpline =
+		    (tmsize_t) clumps_per_line * samples_per_clump;
+		JSAMPLE* tmpbuf = _TIFFGetScratch(tif, TIFF_SCRATCH_CODEC,
+						  sizeof(JSAMPLE) *
+						  samples_per_clumpline);
+		if(tmpbuf==NULL)
 			return 0;
-                }
 #endif
 
 		do {
 			jpeg_component_info *compptr;
 			int ci, clumpoffset;
 
-                        if( cc < sp->bytesperline ) {
-				TIFFErrorExt(tif->tif_clientdata, "JPEGDecodeRaw",
+                        if( cc < bytesperclumpline ) {
+				TIFFErrorExtR(tif, "JPEGDecodeRaw",
 					     "application buffer not large enough for all data.");
 				return 0;
                         }
@@ -1567,7 +1778,7 @@ JPEGDecodeRaw(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 #else
 					JSAMPLE *outptr = (JSAMPLE*)buf + clumpoffset;
 					if (cc < (tmsize_t) (clumpoffset + samples_per_clump*(clumps_per_line-1) + hsamp)) {
-						TIFFErrorExt(tif->tif_clientdata, "JPEGDecodeRaw",
+						TIFFErrorExtR(tif, "JPEGDecodeRaw",
 							     "application buffer not large enough for all data, possible subsampling issue");
 						return 0;
 					}
@@ -1597,27 +1808,15 @@ JPEGDecodeRaw(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 			{
 				if (sp->cinfo.d.data_precision == 8)
 				{
-					int i=0;
-					int len = sp->cinfo.d.output_width * sp->cinfo.d.num_components;
-					for (i=0; i<len; i++)
+					tmsize_t i;
+					for (i=0; i<samples_per_clumpline; i++)
 					{
 						((unsigned char*)buf)[i] = tmpbuf[i] & 0xff;
 					}
 				}
 				else
 				{         /* 12-bit */
-					int value_pairs = (sp->cinfo.d.output_width
-							   * sp->cinfo.d.num_components) / 2;
-					int iPair;
-					for( iPair = 0; iPair < value_pairs; iPair++ )
-					{
-						unsigned char *out_ptr = ((unsigned char *) buf) + iPair * 3;
-						JSAMPLE *in_ptr = (JSAMPLE *) (tmpbuf + iPair * 2);
-						out_ptr[0] = (unsigned char)((in_ptr[0] & 0xff0) >> 4);
-						out_ptr[1] = (unsigned char)(((in_ptr[0] & 0xf) << 4)
-							| ((in_ptr[1] & 0xf00) >> 8));
-						out_ptr[2] = (unsigned char)(((in_ptr[1] & 0xff) >> 0));
-					}
+					JPEGPack12(buf, tmpbuf, samples_per_clumpline);
 				}
 			}
 #endif
@@ -1625,16 +1824,12 @@ JPEGDecodeRaw(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 			sp->scancount ++;
 			tif->tif_row += sp->v_sampling;
 
-			buf += sp->bytesperline;
-			cc -= sp->bytesperline;
+			buf += bytesperclumpline;
+			cc -= bytesperclumpline;
 
 			nrows -= sp->v_sampling;
 		} while (nrows > 0);
 
-#if defined(JPEG_LIB_MK1_OR_12BIT)
-		_TIFFfree(tmpbuf);
-#endif
-
 	}
 
 	/* Close down the decompressor if done. */
@@ -1728,7 +1923,7 @@ JPEGSetupEncode(TIFF* tif)
 
 #if defined(JPEG_DUAL_MODE_8_12) && !defined(TIFFInitJPEG)
         if( tif->tif_dir.td_bitspersample == 12 )
-            return TIFFReInitJPEG_12( tif, COMPRESSION_JPEG, 1 );
+            return JPEGSwitchTo12( tif, 1 );
 #endif
 
         JPEGInitializeLibJPEG( tif, FALSE );
@@ -1736,6 +1931,12 @@ JPEGSetupEncode(TIFF* tif)
 	assert(sp != NULL);
 	assert(!sp->cinfo.comm.is_decompressor);
 
+	if (sp->jpegcolormode == JPEGCOLORMODE_PLANES) {
+		TIFFErrorExtR(tif, module,
+			     "JPEGCOLORMODE_PLANES is only supported for reading");
+		return (0);
+	}
+
 	sp->photometric = td->td_photometric;
 
 	/*
@@ -1774,13 +1975,13 @@ JPEGSetupEncode(TIFF* tif)
 		sp->v_sampling = td->td_ycbcrsubsampling[1];
                 if( sp->h_sampling == 0 || sp->v_sampling == 0 )
                 {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                             "Invalig horizontal/vertical sampling value");
                     return (0);
                 }
                 if( td->td_bitspersample > 16 )
                 {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                                  "BitsPerSample %d not allowed for JPEG",
                                  td->td_bitspersample);
                     return (0);
@@ -1810,7 +2011,7 @@ JPEGSetupEncode(TIFF* tif)
 		break;
 	case PHOTOMETRIC_PALETTE:		/* disallowed by Tech Note */
 	case PHOTOMETRIC_MASK:
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			  "PhotometricInterpretation %d not allowed for JPEG",
 			  (int) sp->photometric);
 		return (0);
@@ -1835,7 +2036,7 @@ JPEGSetupEncode(TIFF* tif)
 	if (td->td_bitspersample != BITS_IN_JSAMPLE )
 #endif
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "BitsPerSample %d not allowed for JPEG",
+		TIFFErrorExtR(tif, module, "BitsPerSample %d not allowed for JPEG",
 			  (int) td->td_bitspersample);
 		return (0);
 	}
@@ -1845,13 +2046,13 @@ JPEGSetupEncode(TIFF* tif)
 #endif
 	if (isTiled(tif)) {
 		if ((td->td_tilelength % (sp->v_sampling * DCTSIZE)) != 0) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				  "JPEG tile height must be multiple of %d",
 				  sp->v_sampling * DCTSIZE);
 			return (0);
 		}
 		if ((td->td_tilewidth % (sp->h_sampling * DCTSIZE)) != 0) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				  "JPEG tile width must be multiple of %d",
 				  sp->h_sampling * DCTSIZE);
 			return (0);
@@ -1859,7 +2060,7 @@ JPEGSetupEncode(TIFF* tif)
 	} else {
 		if (td->td_rowsperstrip < td->td_imagelength &&
 		    (td->td_rowsperstrip % (sp->v_sampling * DCTSIZE)) != 0) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				  "RowsPerStrip must be multiple of %d for JPEG",
 				  sp->v_sampling * DCTSIZE);
 			return (0);
@@ -1932,7 +2133,7 @@ JPEGPreEncode(TIFF* tif, uint16 s)
 		segment_height = TIFFhowmany_32(segment_height, sp->v_sampling);
 	}
 	if (segment_width > 65535 || segment_height > 65535) {
-		TIFFErrorExt(tif->tif_clientdata, module, "Strip/tile too large for JPEG");
+		TIFFErrorExtR(tif, module, "Strip/tile too large for JPEG");
 		return (0);
 	}
 	sp->cinfo.c.image_width = segment_width;
@@ -2044,7 +2245,7 @@ JPEGEncode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 	/* data is expected to be supplied in multiples of a scanline */
 	nrows = cc / sp->bytesperline;
 	if (cc % sp->bytesperline)
-            TIFFWarningExt(tif->tif_clientdata, tif->tif_name, 
+            TIFFWarningExtR(tif, tif->tif_name, 
                            "fractional scanline discarded");
 
         /* The last strip will be limited to image size */
@@ -2054,15 +2255,10 @@ JPEGEncode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
         if( sp->cinfo.c.data_precision == 12 )
         {
             line16_count = (int)((sp->bytesperline * 2) / 3);
-            line16 = (short *) _TIFFmalloc(sizeof(short) * line16_count);
+            line16 = (short *) _TIFFGetScratch(tif, TIFF_SCRATCH_CODEC,
+                                               sizeof(short) * line16_count);
             if (!line16)
-            {
-                TIFFErrorExt(tif->tif_clientdata,
-			     "JPEGEncode",
-                             "Failed to allocate memory");
-
                 return 0;
-            }
         }
             
 	while (nrows-- > 0) {
@@ -2096,11 +2292,6 @@ JPEGEncode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
             buf += sp->bytesperline;
 	}
 
-        if( sp->cinfo.c.data_precision == 12 )
-        {
-            _TIFFfree( line16 );
-        }
-            
 	return (1);
 }
 
@@ -2132,7 +2323,7 @@ JPEGEncodeRaw(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 
 	nrows = ( cc / bytesperclumpline ) * sp->v_sampling;
 	if (cc % bytesperclumpline)
-		TIFFWarningExt(tif->tif_clientdata, tif->tif_name, "fractional scanline discarded");
+		TIFFWarningExtR(tif, tif->tif_name, "fractional scanline discarded");
 
 	/* Cb,Cr both have sampling factors 1, so this is correct */
 	clumps_per_line = sp->cinfo.c.comp_info[1].downsampled_width;
@@ -2227,6 +2418,59 @@ JPEGPostEncode(TIFF* tif)
 	return (TIFFjpeg_finish_compress(JState(tif)));
 }
 
+/*
+ * Keep the state block of a decompressor in the handle for the next
+ * directory, unless the slot is taken.  Returns 1 if it was kept.
+ */
+static int
+JPEGParkDecoder(TIFF* tif, JPEGState* sp)
+{
+	if (!sp->cinfo_initialized || !sp->cinfo.comm.is_decompressor ||
+	    tif->tif_jpegdecoders[JPEG_DECODER_SLOT] != NULL)
+		return 0;
+	/* back to the start state, whatever the last chunk left */
+	if (!TIFFjpeg_abort(sp))
+		return 0;
+	if (sp->jpegtables) {
+		_TIFFfreeExt(tif, sp->jpegtables);
+		sp->jpegtables = NULL;
+	}
+	tif->tif_jpegdecoders[JPEG_DECODER_SLOT] = sp;
+	return 1;
+}
+
+static void
+JPEGFreeDecoder(TIFF* tif)
+{
+	JPEGState *sp = (JPEGState*) tif->tif_jpegdecoders[JPEG_DECODER_SLOT];
+
+	if (sp != NULL) {
+		tif->tif_jpegdecoders[JPEG_DECODER_SLOT] = NULL;
+		TIFFjpeg_destroy(sp);
+		_TIFFfreeExt(tif, sp);
+	}
+}
+
+#if !defined(TIFFInitJPEG)
+/*
+ * Release the decompressors kept by the handle, when it is closed.
+ */
+void
+_TIFFFreeJPEGDecoders(TIFF* tif)
+{
+	JPEGFreeDecoder(tif);
+#if defined(JPEG_DUAL_MODE_8_12)
+	TIFFFreeJPEGDecoder_12(tif);
+#endif
+}
+#else
+void
+TIFFFreeJPEGDecoder_12(TIFF* tif)
+{
+	JPEGFreeDecoder(tif);
+}
+#endif
+
 static void
 JPEGCleanup(TIFF* tif)
 {
@@ -2237,11 +2481,13 @@ JPEGCleanup(TIFF* tif)
 	tif->tif_tagmethods.vgetfield = sp->vgetparent;
 	tif->tif_tagmethods.vsetfield = sp->vsetparent;
 	tif->tif_tagmethods.printdir = sp->printdir;
-        if( sp->cinfo_initialized )
-                TIFFjpeg_destroy(sp);	/* release libjpeg resources */
-        if (sp->jpegtables)		/* tag value */
-                _TIFFfree(sp->jpegtables);
-	_TIFFfree(tif->tif_data);	/* release local state */
+	if (!JPEGParkDecoder(tif, sp)) {
+		if( sp->cinfo_initialized )
+			TIFFjpeg_destroy(sp);	/* release libjpeg resources */
+		if (sp->jpegtables)		/* tag value */
+			_TIFFfreeExt(tif, sp->jpegtables);
+		_TIFFfreeExt(tif, tif->tif_data);	/* release local state */
+	}
 	tif->tif_data = NULL;
 
 	_TIFFSetDefaultCompressionState(tif);
@@ -2298,7 +2544,7 @@ JPEGVSetField(TIFF* tif, uint32 tag, va_list ap)
 			/* XXX */
 			return (0);
 		}
-		_TIFFsetByteArray(&sp->jpegtables, va_arg(ap, void*), v32);
+		_TIFFsetByteArrayExt(tif, &sp->jpegtables, va_arg(ap, void*), v32);
 		sp->jpegtables_length = v32;
 		TIFFSetFieldBit(tif, FIELD_JPEGTABLES);
 		break;
@@ -2318,6 +2564,15 @@ JPEGVSetField(TIFF* tif, uint32 tag, va_list ap)
 	case TIFFTAG_JPEGTABLESMODE:
 		sp->jpegtablesmode = (int) va_arg(ap, int);
 		return (1);			/* pseudo tag */
+	case TIFFTAG_JPEGSCALEDENOM:
+		v32 = (uint32) va_arg(ap, int);
+		if (v32 != 1 && v32 != 2 && v32 != 4 && v32 != 8) {
+			TIFFErrorExtR(tif, "JPEGVSetField",
+			    "JPEGScaleDenom should be 1, 2, 4 or 8");
+			return (0);
+		}
+		sp->jpegscaledenom = (int) v32;
+		return (1);			/* pseudo tag */
 	case TIFFTAG_YCBCRSUBSAMPLING:
 		/* mark the fact that we have a real ycbcrsubsampling! */
 		sp->ycbcrsampling_fetched = 1;
@@ -2358,6 +2613,9 @@ JPEGVGetField(TIFF* tif, uint32 tag, va_list ap)
 		case TIFFTAG_JPEGTABLESMODE:
 			*va_arg(ap, int*) = sp->jpegtablesmode;
 			break;
+		case TIFFTAG_JPEGSCALEDENOM:
+			*va_arg(ap, int*) = sp->jpegscaledenom;
+			break;
 		default:
 			return (*sp->vgetparent)(tif, tag, ap);
 	}
@@ -2488,23 +2746,32 @@ TIFFInitJPEG(TIFF* tif, int scheme)
 	 * Merge codec-specific tag information.
 	 */
 	if (!_TIFFMergeFields(tif, jpegFields, TIFFArrayCount(jpegFields))) {
-		TIFFErrorExt(tif->tif_clientdata,
+		TIFFErrorExtR(tif,
 			     "TIFFInitJPEG",
 			     "Merging JPEG codec-specific tags failed");
 		return 0;
 	}
 
 	/*
-	 * Allocate state block so tag methods have storage to record values.
+	 * Allocate state block so tag methods have storage to record values,
+	 * or take the one kept with its decompressor by an earlier directory.
 	 */
-	tif->tif_data = (uint8*) _TIFFmalloc(sizeof (JPEGState));
+	sp = (JPEGState*) tif->tif_jpegdecoders[JPEG_DECODER_SLOT];
+	if (sp != NULL) {
+		tif->tif_jpegdecoders[JPEG_DECODER_SLOT] = NULL;
+		_TIFFmemset((uint8*) sp + JPEG_STATE_TAIL, 0,
+			    sizeof (JPEGState) - JPEG_STATE_TAIL);
+		tif->tif_data = (uint8*) sp;
+	} else {
+		tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof (JPEGState));
 
-	if (tif->tif_data == NULL) {
-		TIFFErrorExt(tif->tif_clientdata,
-			     "TIFFInitJPEG", "No space for JPEG state block");
-		return 0;
+		if (tif->tif_data == NULL) {
+			TIFFErrorExtR(tif,
+				     "TIFFInitJPEG", "No space for JPEG state block");
+			return 0;
+		}
+		_TIFFmemset(tif->tif_data, 0, sizeof(JPEGState));
 	}
-        _TIFFmemset(tif->tif_data, 0, sizeof(JPEGState));
 
 	sp = JState(tif);
 	sp->tif = tif;				/* back link */
@@ -2525,6 +2792,7 @@ TIFFInitJPEG(TIFF* tif, int scheme)
 	sp->jpegquality = 75;			/* Default IJG quality */
 	sp->jpegcolormode = JPEGCOLORMODE_RAW;
 	sp->jpegtablesmode = JPEGTABLESMODE_QUANT | JPEGTABLESMODE_HUFF;
+	sp->jpegscaledenom = 1;
         sp->ycbcrsampling_fetched = 0;
 
 	/*
@@ -2549,8 +2817,6 @@ TIFFInitJPEG(TIFF* tif, int scheme)
 	tif->tif_deftilesize = JPEGDefaultTileSize;
 	tif->tif_flags |= TIFF_NOBITREV;	/* no bit reversal, please */
 
-        sp->cinfo_initialized = FALSE;
-
 	/*
         ** Create a JPEGTables field if no directory has yet been created. 
         ** We do this just to ensure that sufficient space is reserved for
@@ -2569,14 +2835,14 @@ here hopefully is harmless.
             TIFFSetFieldBit(tif, FIELD_JPEGTABLES);
 */
             sp->jpegtables_length = SIZE_OF_JPEGTABLES;
-            sp->jpegtables = (void *) _TIFFmalloc(sp->jpegtables_length);
+            sp->jpegtables = (void *) _TIFFmallocExt(tif, sp->jpegtables_length);
             if (sp->jpegtables)
             {
                 _TIFFmemset(sp->jpegtables, 0, SIZE_OF_JPEGTABLES);
             }
             else
             {
-                TIFFErrorExt(tif->tif_clientdata,
+                TIFFErrorExtR(tif,
 			     "TIFFInitJPEG",
                              "Failed to allocate memory for JPEG tables");
                 return 0;
@@ -50,7 +50,10 @@ int TIFFReInitJPEG_12( TIFF *tif, int scheme, int is_encode )
     tif->tif_deftilesize = JPEGDefaultTileSize;
     tif->tif_flags |= TIFF_NOBITREV;	/* no bit reversal, please */
 
-    sp->cinfo_initialized = FALSE;
+    /*
+     * The block is either new, or was kept with a 12 bit decompressor by
+     * an earlier directory, see JPEGSwitchTo12() in tif_jpeg.c.
+     */
 
     if( is_encode )
         return JPEGSetupEncode(tif);
@@ -0,0 +1,1073 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include "tiffiop.h"
+#ifdef LERC_SUPPORT
+/*
+ * TIFF Library.
+ *
+ * LERC Compression Support
+ *
+ * LERC (Limited Error Raster Compression) is Esri's codec for elevation
+ * and other scientific rasters: every decoded value is within
+ * TIFFTAG_LERC_MAXZERROR of the original, 0 meaning lossless.  Each strip
+ * or tile is encoded as one LERC blob, with all samples of a pixel
+ * together for contiguous data, optionally compressed further with
+ * Deflate or ZSTD.  The codec version and the additional compression are
+ * recorded in the LercParameters tag.  Floating point pixels whose
+ * samples are all NaN are left out through the blob's validity mask and
+ * come back as NaN; masked pixels of other data decode as zero.  A blob
+ * can only be decoded whole, so a strip read a scanline at a time is
+ * decoded once into a buffer the rows are then copied from, and data
+ * written a scanline at a time is gathered until the end of the strip.
+ * LERC does its own prediction, so the predictor tag is not used.
+ */
+
+#include "Lerc_c_api.h"
+#ifdef ZIP_SUPPORT
+#include "zlib.h"
+#endif
+#ifdef ZSTD_SUPPORT
+#include "zstd.h"
+#endif
+
+#include <stdio.h>
+
+/* LERC data types */
+#define LERC_DT_CHAR	0
+#define LERC_DT_UCHAR	1
+#define LERC_DT_SHORT	2
+#define LERC_DT_USHORT	3
+#define LERC_DT_INT	4
+#define LERC_DT_UINT	5
+#define LERC_DT_FLOAT	6
+#define LERC_DT_DOUBLE	7
+
+/* Entries of the lerc_getBlobInfo() array used here */
+#define LERC_INFO_DATATYPE	1
+#define LERC_INFO_DEPTH		2
+#define LERC_INFO_COLS		3
+#define LERC_INFO_ROWS		4
+#define LERC_INFO_BANDS		5
+#define LERC_INFO_VALIDPIXELS	6
+#define LERC_INFO_COUNT		9
+
+/*
+ * State block for each open TIFF file using LERC compression/decompression.
+ */
+typedef struct {
+        double          maxzerror;              /* max error per value */
+        int             lerc_version;           /* LERC codec version */
+        int             additional_compression; /* LERC_ADD_COMPRESSION_* */
+        int             zipquality;             /* Deflate level */
+        int             zstd_compress_level;    /* ZSTD level */
+        unsigned int    datatype;               /* LERC_DT_* of samples */
+        int             depth;                  /* samples per pixel */
+        uint32          width;                  /* pixels per row */
+        tmsize_t        rowbytes;               /* bytes per row */
+        uint8*          buffer;                 /* gathered or decoded data */
+        tmsize_t        buffer_size;
+        tmsize_t        buffer_used;            /* bytes gathered or decoded */
+        tmsize_t        buffer_pos;             /* bytes given back */
+        uint8*          mask;                   /* one byte per pixel */
+        tmsize_t        mask_size;
+        uint8*          blob;                   /* LERC blob */
+        tmsize_t        blob_size;
+        uint8*          zbuf;                   /* Deflate or ZSTD output */
+        tmsize_t        zbuf_size;
+        int             chunk_done;             /* chunk fully processed */
+        int             state;                  /* state flags */
+#define LSTATE_INIT_DECODE 0x01
+#define LSTATE_INIT_ENCODE 0x02
+
+        TIFFVGetMethod  vgetparent;            /* super-class method */
+        TIFFVSetMethod  vsetparent;            /* super-class method */
+} LERCState;
+
+#define LState(tif)             ((LERCState*) (tif)->tif_data)
+#define DecoderState(tif)       LState(tif)
+#define EncoderState(tif)       LState(tif)
+
+static int LERCEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s);
+static int LERCDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s);
+
+static int
+LERCFixupTags(TIFF* tif)
+{
+        (void) tif;
+        return 1;
+}
+
+/*
+ * Grow a work buffer to at least size bytes.
+ */
+static int
+LERCGrowBuffer(TIFF* tif, uint8** buf, tmsize_t* bufsize, tmsize_t size,
+               const char* module, const char* what)
+{
+        if( *bufsize < size ) {
+                uint8* p = (uint8*) _TIFFreallocExt(tif, *buf, size);
+                if( p == NULL ) {
+                        TIFFErrorExtR(tif, module,
+                                     "No space for LERC %s", what);
+                        return 0;
+                }
+                *buf = p;
+                *bufsize = size;
+        }
+        return 1;
+}
+
+/*
+ * Take the codec version and the additional compression from an
+ * LercParameters array.
+ */
+static int
+LERCSetParameters(TIFF* tif, uint32 count, const uint32* params,
+                  const char* module)
+{
+        LERCState* sp = LState(tif);
+
+        if( count < 2 || params == NULL ) {
+                TIFFErrorExtR(tif, module,
+                             "LercParameters should have at least 2 values");
+                return 0;
+        }
+        switch( params[1] ) {
+        case LERC_ADD_COMPRESSION_NONE:
+        case LERC_ADD_COMPRESSION_DEFLATE:
+        case LERC_ADD_COMPRESSION_ZSTD:
+                break;
+        default:
+                TIFFErrorExtR(tif, module,
+                             "Unknown LERC additional compression %lu",
+                             (unsigned long) params[1]);
+                return 0;
+        }
+        sp->lerc_version = (int) params[0];
+        sp->additional_compression = (int) params[1];
+        return 1;
+}
+
+/*
+ * Record the codec version and the additional compression in the
+ * LercParameters tag.
+ */
+static int
+LERCUpdateParameters(TIFF* tif)
+{
+        LERCState* sp = LState(tif);
+        uint32 params[2];
+
+        params[0] = (uint32) sp->lerc_version;
+        params[1] = (uint32) sp->additional_compression;
+        return TIFFSetField(tif, TIFFTAG_LERC_PARAMETERS, 2, params);
+}
+
+/*
+ * Work out the LERC layout of a strip or tile: one band of width pixels
+ * per row, with all samples of a pixel together for contiguous data.
+ */
+static int
+LERCSetupLayout(TIFF* tif, const char* module)
+{
+        LERCState* sp = LState(tif);
+        TIFFDirectory* td = &tif->tif_dir;
+        uint16 sampleformat = td->td_sampleformat;
+
+        if( sampleformat == SAMPLEFORMAT_VOID )
+                sampleformat = SAMPLEFORMAT_UINT;
+        switch( td->td_bitspersample ) {
+        case 8:
+                if( sampleformat == SAMPLEFORMAT_UINT )
+                        sp->datatype = LERC_DT_UCHAR;
+                else if( sampleformat == SAMPLEFORMAT_INT )
+                        sp->datatype = LERC_DT_CHAR;
+                else
+                        goto bad;
+                break;
+        case 16:
+                if( sampleformat == SAMPLEFORMAT_UINT )
+                        sp->datatype = LERC_DT_USHORT;
+                else if( sampleformat == SAMPLEFORMAT_INT )
+                        sp->datatype = LERC_DT_SHORT;
+                else
+                        goto bad;
+                break;
+        case 32:
+                if( sampleformat == SAMPLEFORMAT_UINT )
+                        sp->datatype = LERC_DT_UINT;
+                else if( sampleformat == SAMPLEFORMAT_INT )
+                        sp->datatype = LERC_DT_INT;
+                else if( sampleformat == SAMPLEFORMAT_IEEEFP )
+                        sp->datatype = LERC_DT_FLOAT;
+                else
+                        goto bad;
+                break;
+        case 64:
+                if( sampleformat == SAMPLEFORMAT_IEEEFP )
+                        sp->datatype = LERC_DT_DOUBLE;
+                else
+                        goto bad;
+                break;
+        default:
+                goto bad;
+        }
+
+        sp->depth = td->td_planarconfig == PLANARCONFIG_CONTIG ?
+            td->td_samplesperpixel : 1;
+        sp->width = isTiled(tif) ? td->td_tilewidth : td->td_imagewidth;
+        sp->rowbytes = (tmsize_t) sp->width * sp->depth *
+            (td->td_bitspersample / 8);
+        if( sp->width == 0 || sp->width > 0x7FFFFFFFU ||
+            sp->rowbytes / sp->width / sp->depth !=
+            (tmsize_t) (td->td_bitspersample / 8) ) {
+                TIFFErrorExtR(tif, module,
+                             "Strip or tile too large for LERC");
+                return 0;
+        }
+        return 1;
+bad:
+        TIFFErrorExtR(tif, module,
+                     "LERC cannot handle %d bit samples of sample format %d",
+                     td->td_bitspersample, td->td_sampleformat);
+        return 0;
+}
+
+/*
+ * Largest number of rows in a strip or tile.
+ */
+static uint32
+LERCMaxRows(TIFF* tif)
+{
+        TIFFDirectory* td = &tif->tif_dir;
+
+        if( isTiled(tif) )
+                return td->td_tilelength;
+        return td->td_rowsperstrip < td->td_imagelength ?
+            td->td_rowsperstrip : td->td_imagelength;
+}
+
+static int
+LERCSetupDecode(TIFF* tif)
+{
+        static const char module[] = "LERCSetupDecode";
+        LERCState* sp = DecoderState(tif);
+        uint32 count;
+        uint32* params;
+
+        assert(sp != NULL);
+
+        /* The directory may have been shared without passing through
+         * LERCVSetField */
+        if( TIFFGetField(tif, TIFFTAG_LERC_PARAMETERS, &count, &params) &&
+            !LERCSetParameters(tif, count, params, module) )
+                return 0;
+        if( !LERCSetupLayout(tif, module) )
+                return 0;
+        /* LERC decodes to native byte order */
+        tif->tif_postdecode = _TIFFNoPostDecode;
+
+        sp->state = LSTATE_INIT_DECODE;
+        return 1;
+}
+
+/*
+ * Setup state for decoding a strip.
+ */
+static int
+LERCPreDecode(TIFF* tif, uint16 s)
+{
+        LERCState* sp = DecoderState(tif);
+
+        (void) s;
+        assert(sp != NULL);
+
+        if( (sp->state & LSTATE_INIT_DECODE) == 0 &&
+            !tif->tif_setupdecode(tif) )
+                return 0;
+
+        sp->buffer_used = 0;
+        sp->buffer_pos = 0;
+        sp->chunk_done = 0;
+        return 1;
+}
+
+/*
+ * Largest LERC blob accepted for a chunk, to bound what Deflate and ZSTD
+ * data can expand to.
+ */
+static tmsize_t
+LERCMaxBlobSize(TIFF* tif)
+{
+        LERCState* sp = LState(tif);
+        tmsize_t size = sp->rowbytes * (tmsize_t) LERCMaxRows(tif);
+
+        return size + size / 2 + (tmsize_t) sp->width * LERCMaxRows(tif) +
+            65536;
+}
+
+/*
+ * Undo the additional compression of the raw data, leaving the LERC blob
+ * in sp->blob.
+ */
+static int
+LERCUncompress(TIFF* tif, const char* module, tmsize_t* blobcc)
+{
+        LERCState* sp = DecoderState(tif);
+        tmsize_t maxsize = LERCMaxBlobSize(tif);
+
+        switch( sp->additional_compression ) {
+#ifdef ZIP_SUPPORT
+        case LERC_ADD_COMPRESSION_DEFLATE:
+        {
+                z_stream strm;
+                tmsize_t size = tif->tif_rawcc * 4 + 1024;
+                tmsize_t used = 0;
+                int ret;
+
+                if( size > maxsize )
+                        size = maxsize;
+                _TIFFmemset(&strm, 0, sizeof(strm));
+                if( inflateInit(&strm) != Z_OK ) {
+                        TIFFErrorExtR(tif, module,
+                                     "Cannot initialize Deflate decoder: %s",
+                                     strm.msg ? strm.msg : "(null)");
+                        return 0;
+                }
+                strm.next_in = tif->tif_rawcp;
+                strm.avail_in = (uInt) tif->tif_rawcc;
+                if( (tmsize_t) strm.avail_in != tif->tif_rawcc ) {
+                        inflateEnd(&strm);
+                        TIFFErrorExtR(tif, module,
+                                     "Strip or tile too large");
+                        return 0;
+                }
+                for( ;; ) {
+                        if( !LERCGrowBuffer(tif, &sp->blob, &sp->blob_size,
+                                            size, module, "blob buffer") ) {
+                                inflateEnd(&strm);
+                                return 0;
+                        }
+                        strm.next_out = sp->blob + used;
+                        strm.avail_out = (uInt) (size - used);
+                        ret = inflate(&strm, Z_FINISH);
+                        used = size - strm.avail_out;
+                        if( ret == Z_STREAM_END )
+                                break;
+                        if( (ret != Z_OK && ret != Z_BUF_ERROR) ||
+                            strm.avail_in == 0 || size >= maxsize ) {
+                                TIFFErrorExtR(tif, module,
+                                    "Decoding error at scanline %lu: %s",
+                                    (unsigned long) tif->tif_row,
+                                    strm.msg ? strm.msg : "corrupted data");
+                                inflateEnd(&strm);
+                                return 0;
+                        }
+                        size = size * 2 < maxsize ? size * 2 : maxsize;
+                }
+                inflateEnd(&strm);
+                *blobcc = used;
+                return 1;
+        }
+#endif
+#ifdef ZSTD_SUPPORT
+        case LERC_ADD_COMPRESSION_ZSTD:
+        {
+                unsigned long long size;
+                size_t zstd_ret;
+
+                size = ZSTD_getFrameContentSize(tif->tif_rawcp,
+                                                (size_t) tif->tif_rawcc);
+                if( size == ZSTD_CONTENTSIZE_UNKNOWN ||
+                    size == ZSTD_CONTENTSIZE_ERROR ||
+                    size > (unsigned long long) maxsize ) {
+                        TIFFErrorExtR(tif, module,
+                            "Invalid ZSTD data at scanline %lu",
+                            (unsigned long) tif->tif_row);
+                        return 0;
+                }
+                if( !LERCGrowBuffer(tif, &sp->blob, &sp->blob_size,
+                                    (tmsize_t) size + 1, module,
+                                    "blob buffer") )
+                        return 0;
+                zstd_ret = ZSTD_decompress(sp->blob, (size_t) size,
+                                           tif->tif_rawcp,
+                                           (size_t) tif->tif_rawcc);
+                if( ZSTD_isError(zstd_ret) ) {
+                        TIFFErrorExtR(tif, module,
+                                     "Error in ZSTD_decompress(): %s",
+                                     ZSTD_getErrorName(zstd_ret));
+                        return 0;
+                }
+                *blobcc = (tmsize_t) zstd_ret;
+                return 1;
+        }
+#endif
+        default:
+                TIFFErrorExtR(tif, module,
+                    "LERC additional compression %d is not configured",
+                    sp->additional_compression);
+                return 0;
+        }
+}
+
+/*
+ * Set the samples of pixels missing from the mask: NaN for floating point
+ * data, zero otherwise.
+ */
+static void
+LERCFillMasked(LERCState* sp, uint8* data, tmsize_t npixels)
+{
+        tmsize_t bps = sp->rowbytes / sp->width / sp->depth;
+        tmsize_t i;
+        int j;
+
+        for( i = 0; i < npixels; i++ ) {
+                uint8* p;
+
+                if( sp->mask[i] )
+                        continue;
+                p = data + i * sp->depth * bps;
+                if( sp->datatype == LERC_DT_FLOAT ) {
+                        uint32 nan = 0x7FC00000U;	/* quiet NaN */
+                        for( j = 0; j < sp->depth; j++ )
+                                _TIFFmemcpy(p + j * 4, &nan, 4);
+                } else if( sp->datatype == LERC_DT_DOUBLE ) {
+                        uint64 nan = (uint64) 0x7FF80000U << 32;
+                        for( j = 0; j < sp->depth; j++ )
+                                _TIFFmemcpy(p + j * 8, &nan, 8);
+                } else
+                        _TIFFmemset(p, 0, sp->depth * bps);
+        }
+}
+
+static int
+LERCDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
+{
+        static const char module[] = "LERCDecode";
+        LERCState* sp = DecoderState(tif);
+        const uint8* blob;
+        tmsize_t blobcc;
+        unsigned int info[LERC_INFO_COUNT];
+        lerc_status ret;
+        uint32 rows;
+        tmsize_t npixels, size;
+        int nmasks;
+        uint8* dst;
+
+        (void) s;
+        assert(sp != NULL);
+        assert(sp->state == LSTATE_INIT_DECODE);
+
+        if( sp->chunk_done )
+                goto copy;
+
+        if( sp->additional_compression == LERC_ADD_COMPRESSION_NONE ) {
+                blob = tif->tif_rawcp;
+                blobcc = tif->tif_rawcc;
+        } else {
+                if( !LERCUncompress(tif, module, &blobcc) )
+                        return 0;
+                blob = sp->blob;
+        }
+        if( (tmsize_t) (unsigned int) blobcc != blobcc ) {
+                TIFFErrorExtR(tif, module,
+                             "Strip or tile too large for LERC");
+                return 0;
+        }
+
+        /* Check the blob matches the image layout before decoding it */
+        _TIFFmemset(info, 0, sizeof(info));
+        ret = lerc_getBlobInfo(blob, (unsigned int) blobcc, info, NULL,
+                               LERC_INFO_COUNT, 0);
+        if( ret != 0 ) {
+                TIFFErrorExtR(tif, module,
+                             "Invalid LERC data at scanline %lu (error %u)",
+                             (unsigned long) tif->tif_row, ret);
+                return 0;
+        }
+        rows = info[LERC_INFO_ROWS];
+        if( info[LERC_INFO_DATATYPE] != sp->datatype ||
+            info[LERC_INFO_DEPTH] != (unsigned int) sp->depth ||
+            info[LERC_INFO_COLS] != sp->width ||
+            info[LERC_INFO_BANDS] != 1 ||
+            rows == 0 || rows > LERCMaxRows(tif) ) {
+                TIFFErrorExtR(tif, module,
+                    "LERC blob of type %u with %u x %u x %u values does not "
+                    "match the image layout",
+                    info[LERC_INFO_DATATYPE], info[LERC_INFO_DEPTH],
+                    info[LERC_INFO_COLS], rows);
+                return 0;
+        }
+        npixels = (tmsize_t) sp->width * rows;
+        size = sp->rowbytes * rows;
+        nmasks = info[LERC_INFO_VALIDPIXELS] < (unsigned int) npixels;
+        if( nmasks && !LERCGrowBuffer(tif, &sp->mask, &sp->mask_size,
+                                      npixels, module, "mask buffer") )
+                return 0;
+
+        /*
+         * Decode a whole strip or tile straight into the caller's buffer,
+         * anything else once into a buffer it is handed out from.
+         */
+        if( size == occ && _TIFFIsWholeChunk(tif, occ) )
+                dst = op;
+        else {
+                if( !LERCGrowBuffer(tif, &sp->buffer, &sp->buffer_size, size,
+                                    module, "strip buffer") )
+                        return 0;
+                dst = sp->buffer;
+        }
+        ret = lerc_decode(blob, (unsigned int) blobcc, nmasks,
+                          nmasks ? sp->mask : NULL, sp->depth,
+                          (int) sp->width, (int) rows, 1, sp->datatype, dst);
+        if( ret != 0 ) {
+                TIFFErrorExtR(tif, module,
+                             "Decoding error at scanline %lu (error %u)",
+                             (unsigned long) tif->tif_row, ret);
+                return 0;
+        }
+        if( nmasks )
+                LERCFillMasked(sp, dst, npixels);
+        tif->tif_rawcp += tif->tif_rawcc;
+        tif->tif_rawcc = 0;
+        sp->chunk_done = 1;
+        if( dst == op )
+                return 1;
+        sp->buffer_used = size;
+        sp->buffer_pos = 0;
+
+copy:
+        if( sp->buffer_used - sp->buffer_pos < occ ) {
+                TIFFErrorExtR(tif, module,
+                    "Not enough data at scanline %lu (short %lu bytes)",
+                    (unsigned long) tif->tif_row,
+                    (unsigned long) (occ - (sp->buffer_used - sp->buffer_pos)));
+                return 0;
+        }
+        _TIFFmemcpy(op, sp->buffer + sp->buffer_pos, occ);
+        sp->buffer_pos += occ;
+        return 1;
+}
+
+static int
+LERCSetupEncode(TIFF* tif)
+{
+        static const char module[] = "LERCSetupEncode";
+        LERCState* sp = EncoderState(tif);
+
+        assert(sp != NULL);
+
+        if( !LERCSetupLayout(tif, module) )
+                return 0;
+        if( sp->additional_compression == LERC_ADD_COMPRESSION_DEFLATE ) {
+#ifndef ZIP_SUPPORT
+                TIFFErrorExtR(tif, module,
+                             "Deflate support is not configured");
+                return 0;
+#endif
+        } else if( sp->additional_compression == LERC_ADD_COMPRESSION_ZSTD ) {
+#ifndef ZSTD_SUPPORT
+                TIFFErrorExtR(tif, module,
+                             "ZSTD support is not configured");
+                return 0;
+#endif
+        }
+        if( !LERCUpdateParameters(tif) )
+                return 0;
+        /* LERC encodes native byte order values */
+        tif->tif_postdecode = _TIFFNoPostDecode;
+
+        sp->state = LSTATE_INIT_ENCODE;
+        return 1;
+}
+
+/*
+ * Reset encoding state at the start of a strip.
+ */
+static int
+LERCPreEncode(TIFF* tif, uint16 s)
+{
+        LERCState *sp = EncoderState(tif);
+
+        (void) s;
+        assert(sp != NULL);
+        if( sp->state != LSTATE_INIT_ENCODE &&
+            !tif->tif_setupencode(tif) )
+                return 0;
+
+        sp->buffer_used = 0;
+        sp->chunk_done = 0;
+        return 1;
+}
+
+/*
+ * Append n bytes to the raw data buffer, flushing it as it fills up.
+ */
+static int
+LERCAppendRaw(TIFF* tif, const uint8* src, tmsize_t n)
+{
+        while( n > 0 ) {
+                tmsize_t chunk = tif->tif_rawdatasize - tif->tif_rawcc;
+
+                if( chunk == 0 ) {
+                        if( !TIFFFlushData1(tif) )
+                                return 0;
+                        continue;
+                }
+                if( chunk > n )
+                        chunk = n;
+                _TIFFmemcpy(tif->tif_rawcp, src, chunk);
+                tif->tif_rawcp += chunk;
+                tif->tif_rawcc += chunk;
+                src += chunk;
+                n -= chunk;
+        }
+        return 1;
+}
+
+/*
+ * Build the validity mask of floating point data, a pixel being invalid
+ * when all its samples are NaN.  Returns the number of masks (0 when all
+ * pixels are valid, 1 otherwise) or -1 on error.
+ */
+static int
+LERCBuildMask(TIFF* tif, const uint8* data, tmsize_t npixels,
+              const char* module)
+{
+        LERCState *sp = EncoderState(tif);
+        tmsize_t i, invalid = 0;
+        int j, nans;
+
+        if( sp->datatype != LERC_DT_FLOAT && sp->datatype != LERC_DT_DOUBLE )
+                return 0;
+        for( i = 0; i < npixels; i++ ) {
+                nans = 0;
+                for( j = 0; j < sp->depth; j++ ) {
+                        if( sp->datatype == LERC_DT_FLOAT ) {
+                                float v;
+                                _TIFFmemcpy(&v, data + (i * sp->depth + j) * 4,
+                                            4);
+                                nans += v != v;
+                        } else {
+                                double v;
+                                _TIFFmemcpy(&v, data + (i * sp->depth + j) * 8,
+                                            8);
+                                nans += v != v;
+                        }
+                }
+                if( nans == 0 ) {
+                        if( invalid > 0 )
+                                sp->mask[i] = 1;
+                        continue;
+                }
+                if( nans != sp->depth ) {
+                        TIFFErrorExtR(tif, module,
+                            "LERC cannot store pixels with only some samples "
+                            "NaN at scanline %lu",
+                            (unsigned long) (tif->tif_row + i / sp->width));
+                        return -1;
+                }
+                if( invalid++ == 0 ) {
+                        if( !LERCGrowBuffer(tif, &sp->mask, &sp->mask_size,
+                                            npixels, module, "mask buffer") )
+                                return -1;
+                        _TIFFmemset(sp->mask, 1, i);
+                }
+                sp->mask[i] = 0;
+        }
+        return invalid > 0;
+}
+
+/*
+ * Encode cc bytes of whole rows as one LERC blob, compress it further if
+ * asked to and append it to the raw data buffer.
+ */
+static int
+LERCCompressChunk(TIFF* tif, const uint8* data, tmsize_t cc)
+{
+        static const char module[] = "LERCEncode";
+        LERCState *sp = EncoderState(tif);
+        tmsize_t rows = cc / sp->rowbytes;
+        tmsize_t npixels = (tmsize_t) sp->width * rows;
+        unsigned int written = 0, needed;
+        lerc_status ret;
+        int nmasks;
+
+        if( cc % sp->rowbytes != 0 || rows > 0x7FFFFFFF ) {
+                TIFFErrorExtR(tif, module,
+                             "LERC can only encode whole rows");
+                return 0;
+        }
+        if( (nmasks = LERCBuildMask(tif, data, npixels, module)) < 0 )
+                return 0;
+
+        /*
+         * Try a buffer a bit larger than the data first: that leaves room
+         * for the mask and headers of incompressible data.  Otherwise ask
+         * LERC for the size needed.
+         */
+        if( !LERCGrowBuffer(tif, &sp->blob, &sp->blob_size,
+                            cc + cc / 8 + npixels / 8 + 4096, module,
+                            "blob buffer") )
+                return 0;
+        if( (tmsize_t) (unsigned int) sp->blob_size != sp->blob_size ) {
+                TIFFErrorExtR(tif, module,
+                             "Strip or tile too large for LERC");
+                return 0;
+        }
+        ret = lerc_encodeForVersion(data, sp->lerc_version, sp->datatype,
+                                    sp->depth, (int) sp->width, (int) rows, 1,
+                                    nmasks, nmasks ? sp->mask : NULL,
+                                    sp->maxzerror, sp->blob,
+                                    (unsigned int) sp->blob_size, &written);
+        if( ret != 0 ) {
+                ret = lerc_computeCompressedSizeForVersion(data,
+                    sp->lerc_version, sp->datatype, sp->depth,
+                    (int) sp->width, (int) rows, 1, nmasks,
+                    nmasks ? sp->mask : NULL, sp->maxzerror, &needed);
+                if( ret == 0 ) {
+                        if( !LERCGrowBuffer(tif, &sp->blob, &sp->blob_size,
+                                            (tmsize_t) needed, module,
+                                            "blob buffer") )
+                                return 0;
+                        ret = lerc_encodeForVersion(data, sp->lerc_version,
+                            sp->datatype, sp->depth, (int) sp->width,
+                            (int) rows, 1, nmasks, nmasks ? sp->mask : NULL,
+                            sp->maxzerror, sp->blob,
+                            (unsigned int) sp->blob_size, &written);
+                }
+        }
+        if( ret != 0 ) {
+                TIFFErrorExtR(tif, module,
+                             "LERC encoding failed at scanline %lu (error %u)",
+                             (unsigned long) tif->tif_row, ret);
+                return 0;
+        }
+
+        switch( sp->additional_compression ) {
+#ifdef ZIP_SUPPORT
+        case LERC_ADD_COMPRESSION_DEFLATE:
+        {
+                uLongf zcc = compressBound((uLong) written);
+
+                if( !LERCGrowBuffer(tif, &sp->zbuf, &sp->zbuf_size,
+                                    (tmsize_t) zcc, module, "Deflate buffer") )
+                        return 0;
+                if( compress2(sp->zbuf, &zcc, sp->blob, (uLong) written,
+                              sp->zipquality) != Z_OK ) {
+                        TIFFErrorExtR(tif, module,
+                                     "Deflate encoding failed at scanline %lu",
+                                     (unsigned long) tif->tif_row);
+                        return 0;
+                }
+                if( !LERCAppendRaw(tif, sp->zbuf, (tmsize_t) zcc) )
+                        return 0;
+                break;
+        }
+#endif
+#ifdef ZSTD_SUPPORT
+        case LERC_ADD_COMPRESSION_ZSTD:
+        {
+                size_t zcc = ZSTD_compressBound(written);
+
+                if( !LERCGrowBuffer(tif, &sp->zbuf, &sp->zbuf_size,
+                                    (tmsize_t) zcc, module, "ZSTD buffer") )
+                        return 0;
+                zcc = ZSTD_compress(sp->zbuf, zcc, sp->blob, written,
+                                    sp->zstd_compress_level);
+                if( ZSTD_isError(zcc) ) {
+                        TIFFErrorExtR(tif, module,
+                                     "Error in ZSTD_compress(): %s",
+                                     ZSTD_getErrorName(zcc));
+                        return 0;
+                }
+                if( !LERCAppendRaw(tif, sp->zbuf, (tmsize_t) zcc) )
+                        return 0;
+                break;
+        }
+#endif
+        default:
+                if( !LERCAppendRaw(tif, sp->blob, (tmsize_t) written) )
+                        return 0;
+                break;
+        }
+        sp->chunk_done = 1;
+        return 1;
+}
+
+/*
+ * Encode a chunk of pixels.
+ */
+static int
+LERCEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
+{
+        static const char module[] = "LERCEncode";
+        LERCState *sp = EncoderState(tif);
+        tmsize_t size;
+
+        assert(sp != NULL);
+        assert(sp->state == LSTATE_INIT_ENCODE);
+
+        (void) s;
+
+        if( sp->chunk_done ) {
+                TIFFErrorExtR(tif, module,
+                             "Strip or tile already compressed");
+                return 0;
+        }
+
+        /* A whole strip or tile is compressed on the spot */
+        if( sp->buffer_used == 0 && _TIFFIsWholeChunk(tif, cc) )
+                return LERCCompressChunk(tif, bp, cc);
+
+        size = sp->rowbytes * (tmsize_t) LERCMaxRows(tif);
+        if( !LERCGrowBuffer(tif, &sp->buffer, &sp->buffer_size, size,
+                            module, "strip buffer") )
+                return 0;
+        if( cc > size - sp->buffer_used ) {
+                TIFFErrorExtR(tif, module,
+                             "More data than fits in a strip or tile");
+                return 0;
+        }
+        _TIFFmemcpy(sp->buffer + sp->buffer_used, bp, cc);
+        sp->buffer_used += cc;
+        return 1;
+}
+
+/*
+ * Finish off an encoded strip by compressing the data gathered.
+ */
+static int
+LERCPostEncode(TIFF* tif)
+{
+        LERCState *sp = EncoderState(tif);
+
+        if( sp->chunk_done || sp->buffer_used == 0 )
+                return 1;
+        if( !LERCCompressChunk(tif, sp->buffer, sp->buffer_used) )
+                return 0;
+        sp->buffer_used = 0;
+        return 1;
+}
+
+static void
+LERCCleanup(TIFF* tif)
+{
+        LERCState* sp = LState(tif);
+
+        assert(sp != 0);
+
+        tif->tif_tagmethods.vgetfield = sp->vgetparent;
+        tif->tif_tagmethods.vsetfield = sp->vsetparent;
+
+        if (sp->buffer)
+            _TIFFfreeExt(tif, sp->buffer);
+        if (sp->mask)
+            _TIFFfreeExt(tif, sp->mask);
+        if (sp->blob)
+            _TIFFfreeExt(tif, sp->blob);
+        if (sp->zbuf)
+            _TIFFfreeExt(tif, sp->zbuf);
+        _TIFFfreeExt(tif, sp);
+        tif->tif_data = NULL;
+
+        _TIFFSetDefaultCompressionState(tif);
+}
+
+static int
+LERCVSetField(TIFF* tif, uint32 tag, va_list ap)
+{
+	static const char module[] = "LERCVSetField";
+        LERCState* sp = LState(tif);
+        uint32 count;
+        uint32* params;
+        double d;
+        int v;
+
+        switch (tag) {
+        case TIFFTAG_LERC_MAXZERROR:
+                d = va_arg(ap, double);
+                if( !(d >= 0) ) {
+                    TIFFErrorExtR(tif, module,
+                                 "LERC_MAXZERROR should be positive or 0");
+                    return 0;
+                }
+                sp->maxzerror = d;
+                return 1;
+        case TIFFTAG_LERC_VERSION:
+                v = (int) va_arg(ap, int);
+                if( v != LERC_VERSION_2_4 ) {
+                    TIFFErrorExtR(tif, module,
+                                 "Unsupported LERC version %d", v);
+                    return 0;
+                }
+                sp->lerc_version = v;
+                return LERCUpdateParameters(tif);
+        case TIFFTAG_LERC_ADD_COMPRESSION:
+                v = (int) va_arg(ap, int);
+                if( v != LERC_ADD_COMPRESSION_NONE &&
+                    v != LERC_ADD_COMPRESSION_DEFLATE &&
+                    v != LERC_ADD_COMPRESSION_ZSTD ) {
+                    TIFFErrorExtR(tif, module,
+                                 "Unknown LERC additional compression %d", v);
+                    return 0;
+                }
+                sp->additional_compression = v;
+                return LERCUpdateParameters(tif);
+        case TIFFTAG_ZIPQUALITY:
+                sp->zipquality = (int) va_arg(ap, int);
+                return 1;
+        case TIFFTAG_ZSTD_LEVEL:
+                sp->zstd_compress_level = (int) va_arg(ap, int);
+                return 1;
+        case TIFFTAG_LERC_PARAMETERS:
+                /* Store the tag, then pick the values out of it */
+                if( !(*sp->vsetparent)(tif, tag, ap) )
+                        return 0;
+                if( !TIFFGetField(tif, TIFFTAG_LERC_PARAMETERS,
+                                  &count, &params) )
+                        return 0;
+                return LERCSetParameters(tif, count, params, module);
+        default:
+                return (*sp->vsetparent)(tif, tag, ap);
+        }
+        /*NOTREACHED*/
+}
+
+static int
+LERCVGetField(TIFF* tif, uint32 tag, va_list ap)
+{
+        LERCState* sp = LState(tif);
+
+        switch (tag) {
+        case TIFFTAG_LERC_MAXZERROR:
+                *va_arg(ap, double*) = sp->maxzerror;
+                break;
+        case TIFFTAG_LERC_VERSION:
+                *va_arg(ap, int*) = sp->lerc_version;
+                break;
+        case TIFFTAG_LERC_ADD_COMPRESSION:
+                *va_arg(ap, int*) = sp->additional_compression;
+                break;
+        case TIFFTAG_ZIPQUALITY:
+                *va_arg(ap, int*) = sp->zipquality;
+                break;
+        case TIFFTAG_ZSTD_LEVEL:
+                *va_arg(ap, int*) = sp->zstd_compress_level;
+                break;
+        default:
+                return (*sp->vgetparent)(tif, tag, ap);
+        }
+        return 1;
+}
+
+static const TIFFField LERCFields[] = {
+        { TIFFTAG_LERC_PARAMETERS, TIFF_VARIABLE2, TIFF_VARIABLE2,
+          TIFF_LONG, 0, TIFF_SETGET_C32_UINT32, TIFF_SETGET_UNDEFINED,
+          FIELD_CUSTOM, TRUE, TRUE, "LercParameters", NULL },
+        { TIFFTAG_LERC_MAXZERROR, 0, 0, TIFF_ANY, 0, TIFF_SETGET_DOUBLE,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, FALSE, "LercMaxZError", NULL },
+        { TIFFTAG_LERC_VERSION, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, FALSE, FALSE, "LercVersion", NULL },
+        { TIFFTAG_LERC_ADD_COMPRESSION, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, FALSE, FALSE, "LercAdditionalCompression", NULL },
+        { TIFFTAG_ZIPQUALITY, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, FALSE, "", NULL },
+        { TIFFTAG_ZSTD_LEVEL, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, FALSE, "ZSTD compression_level", NULL },
+};
+
+int
+TIFFInitLERC(TIFF* tif, int scheme)
+{
+        static const char module[] = "TIFFInitLERC";
+        LERCState* sp;
+
+        assert( scheme == COMPRESSION_LERC );
+
+        /*
+        * Merge codec-specific tag information.
+        */
+        if (!_TIFFMergeFields(tif, LERCFields, TIFFArrayCount(LERCFields))) {
+                TIFFErrorExtR(tif, module,
+                            "Merging LERC codec-specific tags failed");
+                return 0;
+        }
+
+        /*
+        * Allocate state block so tag methods have storage to record values.
+        */
+        tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof(LERCState));
+        if (tif->tif_data == NULL)
+                goto bad;
+        sp = LState(tif);
+        _TIFFmemset(sp, 0, sizeof(LERCState));
+
+        /*
+        * Override parent get/set field methods.
+        */
+        sp->vgetparent = tif->tif_tagmethods.vgetfield;
+        tif->tif_tagmethods.vgetfield = LERCVGetField;	/* hook for codec tags */
+        sp->vsetparent = tif->tif_tagmethods.vsetfield;
+        tif->tif_tagmethods.vsetfield = LERCVSetField;	/* hook for codec tags */
+
+        /* Default values for codec-specific fields */
+        sp->maxzerror = 0.0;			/* lossless */
+        sp->lerc_version = LERC_VERSION_2_4;
+        sp->additional_compression = LERC_ADD_COMPRESSION_NONE;
+        sp->zipquality = -1;			/* Z_DEFAULT_COMPRESSION */
+        sp->zstd_compress_level = 9;		/* default comp. level */
+        sp->state = 0;
+
+        /*
+        * Install codec methods.
+        */
+        tif->tif_fixuptags = LERCFixupTags;
+        tif->tif_setupdecode = LERCSetupDecode;
+        tif->tif_predecode = LERCPreDecode;
+        tif->tif_decoderow = LERCDecode;
+        tif->tif_decodestrip = LERCDecode;
+        tif->tif_decodetile = LERCDecode;
+        tif->tif_setupencode = LERCSetupEncode;
+        tif->tif_preencode = LERCPreEncode;
+        tif->tif_postencode = LERCPostEncode;
+        tif->tif_encoderow = LERCEncode;
+        tif->tif_encodestrip = LERCEncode;
+        tif->tif_encodetile = LERCEncode;
+        tif->tif_cleanup = LERCCleanup;
+        return 1;
+bad:
+        TIFFErrorExtR(tif, module,
+                    "No space for LERC state block");
+        return 0;
+}
+#endif /* LERC_SUPPORT */
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
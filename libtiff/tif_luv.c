@@ -164,6 +164,8 @@ struct logLuvState {
 	uint8*                  tbuf;           /* translation buffer */
 	tmsize_t                tbuflen;        /* buffer length */
 	void (*tfunc)(LogLuvState*, uint8*, tmsize_t);
+	double*                 ytab;           /* LogL to Y decode table */
+	double*                 uvtab;          /* (u',v') decode table */
 
 	TIFFVSetMethod          vgetparent;     /* super-class method */
 	TIFFVSetMethod          vsetparent;     /* super-class method */
@@ -202,7 +204,7 @@ LogL16Decode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 		tp = (int16*) op;
 	else {
 		if(sp->tbuflen < npixels) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 						 "Translation buffer too short");
 			return (0);
 		}
@@ -231,12 +233,12 @@ LogL16Decode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 		}
 		if (i != npixels) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Not enough data at row %lu (short %I64d pixels)",
 				     (unsigned long) tif->tif_row,
 				     (unsigned __int64) (npixels - i));
 #else
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Not enough data at row %lu (short %llu pixels)",
 				     (unsigned long) tif->tif_row,
 				     (unsigned long long) (npixels - i));
@@ -275,7 +277,7 @@ LogLuvDecode24(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 		tp = (uint32 *)op;
 	else {
 		if(sp->tbuflen < npixels) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 						 "Translation buffer too short");
 			return (0);
 		}
@@ -293,12 +295,12 @@ LogLuvDecode24(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 	tif->tif_rawcc = cc;
 	if (i != npixels) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			"Not enough data at row %lu (short %I64d pixels)",
 			     (unsigned long) tif->tif_row,
 			     (unsigned __int64) (npixels - i));
 #else
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			"Not enough data at row %lu (short %llu pixels)",
 			     (unsigned long) tif->tif_row,
 			     (unsigned long long) (npixels - i));
@@ -336,7 +338,7 @@ LogLuvDecode32(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 		tp = (uint32*) op;
 	else {
 		if(sp->tbuflen < npixels) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 						 "Translation buffer too short");
 			return (0);
 		}
@@ -365,12 +367,12 @@ LogLuvDecode32(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 		}
 		if (i != npixels) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			"Not enough data at row %lu (short %I64d pixels)",
 				     (unsigned long) tif->tif_row,
 				     (unsigned __int64) (npixels - i));
 #else
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			"Not enough data at row %lu (short %llu pixels)",
 				     (unsigned long) tif->tif_row,
 				     (unsigned long long) (npixels - i));
@@ -456,7 +458,7 @@ LogL16Encode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	else {
 		tp = (int16*) sp->tbuf;
 		if(sp->tbuflen < npixels) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 						 "Translation buffer too short");
 			return (0);
 		}
@@ -550,7 +552,7 @@ LogLuvEncode24(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	else {
 		tp = (uint32*) sp->tbuf;
 		if(sp->tbuflen < npixels) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 						 "Translation buffer too short");
 			return (0);
 		}
@@ -608,7 +610,7 @@ LogLuvEncode32(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	else {
 		tp = (uint32*) sp->tbuf;
 		if(sp->tbuflen < npixels) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 						 "Translation buffer too short");
 			return (0);
 		}
@@ -778,12 +780,28 @@ LogL16fromY(double Y, int em)	/* get 16-bit LogL from Y */
 	return (0);
 }
 
+/*
+ * LogL16toY() through the table built by LogLuvSetupTables(), which
+ * holds LogL16toY(Le) for each non-negative 15-bit Le.
+ */
+#define LogL16toYTab(t, p16) \
+	((((p16) & 0x8000) && ((p16) & 0x7fff)) ? \
+	    -(t)[(p16) & 0x7fff] : (t)[(p16) & 0x7fff])
+
 static void
 L16toY(LogLuvState* sp, uint8* op, tmsize_t n)
 {
 	int16* l16 = (int16*) sp->tbuf;
 	float* yp = (float*) op;
+	const double* ytab = sp->ytab;
 
+	if (ytab != NULL) {
+		while (n-- > 0) {
+			int p16 = *l16++;
+			*yp++ = (float)LogL16toYTab(ytab, p16);
+		}
+		return;
+	}
 	while (n-- > 0)
 		*yp++ = (float)LogL16toY(*l16++);
 }
@@ -793,9 +811,12 @@ L16toGry(LogLuvState* sp, uint8* op, tmsize_t n)
 {
 	int16* l16 = (int16*) sp->tbuf;
 	uint8* gp = (uint8*) op;
+	const double* ytab = sp->ytab;
 
 	while (n-- > 0) {
-		double Y = LogL16toY(*l16++);
+		int p16 = *l16++;
+		double Y = ytab != NULL ? LogL16toYTab(ytab, p16) :
+		    LogL16toY(p16);
 		*gp++ = (uint8) ((Y <= 0.) ? 0 : (Y >= 1.) ? 255 : (int)(256.*sqrt(Y)));
 	}
 }
@@ -964,6 +985,20 @@ uv_decode(double *up, double *vp, int c)	/* decode (u',v') index */
 	return (0);
 }
 
+static void
+LuvtoXYZ(double L, double u, double v, float XYZ[3])	/* L > 0 */
+{
+	double	s, x, y;
+
+	s = 1./(6.*u - 16.*v + 12.);
+	x = 9.*u * s;
+	y = 4.*v * s;
+					/* convert to XYZ */
+	XYZ[0] = (float)(x/y * L);
+	XYZ[1] = (float)L;
+	XYZ[2] = (float)((1.-x-y)/y * L);
+}
+
 #if !LOGLUV_PUBLIC
 static
 #endif
@@ -971,7 +1006,7 @@ void
 LogLuv24toXYZ(uint32 p, float XYZ[3])
 {
 	int	Ce;
-	double	L, u, v, s, x, y;
+	double	L, u, v;
 					/* decode luminance */
 	L = LogL10toY(p>>14 & 0x3ff);
 	if (L <= 0.) {
@@ -983,13 +1018,7 @@ LogLuv24toXYZ(uint32 p, float XYZ[3])
 	if (uv_decode(&u, &v, Ce) < 0) {
 		u = U_NEU; v = V_NEU;
 	}
-	s = 1./(6.*u - 16.*v + 12.);
-	x = 9.*u * s;
-	y = 4.*v * s;
-					/* convert to XYZ */
-	XYZ[0] = (float)(x/y * L);
-	XYZ[1] = (float)L;
-	XYZ[2] = (float)((1.-x-y)/y * L);
+	LuvtoXYZ(L, u, v, XYZ);
 }
 
 #if !LOGLUV_PUBLIC
@@ -1018,6 +1047,31 @@ LogLuv24fromXYZ(float XYZ[3], int em)
 	return (Le << 14 | Ce);
 }
 
+/*
+ * LogLuv24toXYZ() using the decode tables when they are available.
+ */
+static void
+Luv24Decode(LogLuvState* sp, uint32 p, float XYZ[3])
+{
+	int	Ce;
+	double	L;
+
+	if (sp->ytab == NULL || sp->uvtab == NULL) {
+		LogLuv24toXYZ(p, XYZ);
+		return;
+	}
+	L = sp->ytab[p>>14 & 0x3ff];
+	if (L <= 0.) {
+		XYZ[0] = XYZ[1] = XYZ[2] = 0.;
+		return;
+	}
+	Ce = p & 0x3fff;
+	if (Ce < UV_NDIVS)
+		LuvtoXYZ(L, sp->uvtab[2*Ce], sp->uvtab[2*Ce+1], XYZ);
+	else
+		LuvtoXYZ(L, U_NEU, V_NEU, XYZ);
+}
+
 static void
 Luv24toXYZ(LogLuvState* sp, uint8* op, tmsize_t n)
 {
@@ -1025,7 +1079,7 @@ Luv24toXYZ(LogLuvState* sp, uint8* op, tmsize_t n)
 	float* xyz = (float*) op;
 
 	while (n-- > 0) {
-		LogLuv24toXYZ(*luv, xyz);
+		Luv24Decode(sp, *luv, xyz);
 		xyz += 3;
 		luv++;
 	}
@@ -1039,9 +1093,13 @@ Luv24toLuv48(LogLuvState* sp, uint8* op, tmsize_t n)
 
 	while (n-- > 0) {
 		double u, v;
+		int Ce = *luv & 0x3fff;
 
 		*luv3++ = (int16)((*luv >> 12 & 0xffd) + 13314);
-		if (uv_decode(&u, &v, *luv&0x3fff) < 0) {
+		if (sp->uvtab != NULL && Ce < UV_NDIVS) {
+			u = sp->uvtab[2*Ce];
+			v = sp->uvtab[2*Ce+1];
+		} else if (uv_decode(&u, &v, Ce) < 0) {
 			u = U_NEU;
 			v = V_NEU;
 		}
@@ -1060,7 +1118,7 @@ Luv24toRGB(LogLuvState* sp, uint8* op, tmsize_t n)
 	while (n-- > 0) {
 		float xyz[3];
 
-		LogLuv24toXYZ(*luv++, xyz);
+		Luv24Decode(sp, *luv++, xyz);
 		XYZtoRGB24(xyz, rgb);
 		rgb += 3;
 	}
@@ -1111,7 +1169,7 @@ static
 void
 LogLuv32toXYZ(uint32 p, float XYZ[3])
 {
-	double	L, u, v, s, x, y;
+	double	L, u, v;
 					/* decode luminance */
 	L = LogL16toY((int)p >> 16);
 	if (L <= 0.) {
@@ -1121,13 +1179,7 @@ LogLuv32toXYZ(uint32 p, float XYZ[3])
 					/* decode color */
 	u = 1./UVSCALE * ((p>>8 & 0xff) + .5);
 	v = 1./UVSCALE * ((p & 0xff) + .5);
-	s = 1./(6.*u - 16.*v + 12.);
-	x = 9.*u * s;
-	y = 4.*v * s;
-					/* convert to XYZ */
-	XYZ[0] = (float)(x/y * L);
-	XYZ[1] = (float)L;
-	XYZ[2] = (float)((1.-x-y)/y * L);
+	LuvtoXYZ(L, u, v, XYZ);
 }
 
 #if !LOGLUV_PUBLIC
@@ -1159,6 +1211,30 @@ LogLuv32fromXYZ(float XYZ[3], int em)
 	return (Le << 16 | ue << 8 | ve);
 }
 
+/*
+ * LogLuv32toXYZ() using the luminance table when it is available.
+ */
+static void
+Luv32Decode(LogLuvState* sp, uint32 p, float XYZ[3])
+{
+	int	p16;
+	double	L, u, v;
+
+	if (sp->ytab == NULL) {
+		LogLuv32toXYZ(p, XYZ);
+		return;
+	}
+	p16 = (int)p >> 16;
+	L = LogL16toYTab(sp->ytab, p16);
+	if (L <= 0.) {
+		XYZ[0] = XYZ[1] = XYZ[2] = 0.;
+		return;
+	}
+	u = 1./UVSCALE * ((p>>8 & 0xff) + .5);
+	v = 1./UVSCALE * ((p & 0xff) + .5);
+	LuvtoXYZ(L, u, v, XYZ);
+}
+
 static void
 Luv32toXYZ(LogLuvState* sp, uint8* op, tmsize_t n)
 {
@@ -1166,7 +1242,7 @@ Luv32toXYZ(LogLuvState* sp, uint8* op, tmsize_t n)
 	float* xyz = (float*) op;
 
 	while (n-- > 0) {
-		LogLuv32toXYZ(*luv++, xyz);
+		Luv32Decode(sp, *luv++, xyz);
 		xyz += 3;
 	}
 }
@@ -1198,7 +1274,7 @@ Luv32toRGB(LogLuvState* sp, uint8* op, tmsize_t n)
 	while (n-- > 0) {
 		float xyz[3];
 
-		LogLuv32toXYZ(*luv++, xyz);
+		Luv32Decode(sp, *luv++, xyz);
 		XYZtoRGB24(xyz, rgb);
 		rgb += 3;
 	}
@@ -1245,6 +1321,55 @@ _logLuvNop(LogLuvState* sp, uint8* op, tmsize_t n)
 	(void) sp; (void) op; (void) n;
 }
 
+static void
+LogLuvFreeTables(TIFF* tif)
+{
+	LogLuvState* sp = DecoderState(tif);
+
+	if (sp->ytab) {
+		_TIFFfreeExt(tif, sp->ytab);
+		sp->ytab = NULL;
+	}
+	if (sp->uvtab) {
+		_TIFFfreeExt(tif, sp->uvtab);
+		sp->uvtab = NULL;
+	}
+}
+
+/*
+ * Build the tables that let the decoding conversions avoid a call to
+ * exp() per pixel (ybits is the width of the luminance code, 10 or 15,
+ * or 0 for none) and the binary search of uv_decode().  The entries
+ * are computed by the same routines, so results are unchanged.  If
+ * memory is short the conversions go without them.
+ */
+static void
+LogLuvSetupTables(TIFF* tif, int ybits, int uv)
+{
+	LogLuvState* sp = DecoderState(tif);
+	int i;
+
+	LogLuvFreeTables(tif);
+	if (ybits) {
+		sp->ytab = (double*) _TIFFmallocExt(tif,
+		    ((tmsize_t) 1 << ybits) * sizeof (double));
+		if (sp->ytab != NULL) {
+			for (i = 0; i < (1 << ybits); i++)
+				sp->ytab[i] = ybits == 10 ?
+				    LogL10toY(i) : LogL16toY(i);
+		}
+	}
+	if (uv) {
+		sp->uvtab = (double*) _TIFFmallocExt(tif,
+		    2 * UV_NDIVS * sizeof (double));
+		if (sp->uvtab != NULL) {
+			for (i = 0; i < UV_NDIVS; i++)
+				uv_decode(&sp->uvtab[2*i],
+				    &sp->uvtab[2*i+1], i);
+		}
+	}
+}
+
 static int
 LogL16GuessDataFmt(TIFFDirectory *td)
 {
@@ -1288,7 +1413,7 @@ LogL16InitState(TIFF* tif)
 
 	if( td->td_samplesperpixel != 1 )
 	{
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		             "Sorry, can not handle LogL image with %s=%d",
 			     "Samples/pixel", td->td_samplesperpixel);
 		return 0;
@@ -1308,7 +1433,7 @@ LogL16InitState(TIFF* tif)
 		sp->pixel_size = sizeof (uint8);
 		break;
 	default:
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "No support for converting user data format to LogL");
 		return (0);
 	}
@@ -1319,8 +1444,8 @@ LogL16InitState(TIFF* tif)
         else
             sp->tbuflen = multiply_ms(td->td_imagewidth, td->td_imagelength);
 	if (multiply_ms(sp->tbuflen, sizeof (int16)) == 0 ||
-	    (sp->tbuf = (uint8*) _TIFFmalloc(sp->tbuflen * sizeof (int16))) == NULL) {
-		TIFFErrorExt(tif->tif_clientdata, module, "No space for SGILog translation buffer");
+	    (sp->tbuf = (uint8*) _TIFFmallocExt(tif, sp->tbuflen * sizeof (int16))) == NULL) {
+		TIFFErrorExtR(tif, module, "No space for SGILog translation buffer");
 		return (0);
 	}
 	return (1);
@@ -1390,7 +1515,7 @@ LogLuvInitState(TIFF* tif)
 
 	/* for some reason, we can't do this in TIFFInitLogLuv */
 	if (td->td_planarconfig != PLANARCONFIG_CONTIG) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "SGILog compression cannot handle non-contiguous data");
 		return (0);
 	}
@@ -1410,7 +1535,7 @@ LogLuvInitState(TIFF* tif)
 		sp->pixel_size = 3*sizeof (uint8);
 		break;
 	default:
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "No support for converting user data format to LogLuv");
 		return (0);
 	}
@@ -1421,8 +1546,8 @@ LogLuvInitState(TIFF* tif)
         else
             sp->tbuflen = multiply_ms(td->td_imagewidth, td->td_imagelength);
 	if (multiply_ms(sp->tbuflen, sizeof (uint32)) == 0 ||
-	    (sp->tbuf = (uint8*) _TIFFmalloc(sp->tbuflen * sizeof (uint32))) == NULL) {
-		TIFFErrorExt(tif->tif_clientdata, module, "No space for SGILog translation buffer");
+	    (sp->tbuf = (uint8*) _TIFFmallocExt(tif, sp->tbuflen * sizeof (uint32))) == NULL) {
+		TIFFErrorExtR(tif, module, "No space for SGILog translation buffer");
 		return (0);
 	}
 	return (1);
@@ -1452,12 +1577,15 @@ LogLuvSetupDecode(TIFF* tif)
 			switch (sp->user_datafmt) {
 			case SGILOGDATAFMT_FLOAT:
 				sp->tfunc = Luv24toXYZ;  
+				LogLuvSetupTables(tif, 10, 1);
 				break;
 			case SGILOGDATAFMT_16BIT:
 				sp->tfunc = Luv24toLuv48;  
+				LogLuvSetupTables(tif, 0, 1);
 				break;
 			case SGILOGDATAFMT_8BIT:
 				sp->tfunc = Luv24toRGB;
+				LogLuvSetupTables(tif, 10, 1);
 				break;
 			}
 		} else {
@@ -1465,12 +1593,14 @@ LogLuvSetupDecode(TIFF* tif)
 			switch (sp->user_datafmt) {
 			case SGILOGDATAFMT_FLOAT:
 				sp->tfunc = Luv32toXYZ;
+				LogLuvSetupTables(tif, 15, 0);
 				break;
 			case SGILOGDATAFMT_16BIT:
 				sp->tfunc = Luv32toLuv48;
 				break;
 			case SGILOGDATAFMT_8BIT:
 				sp->tfunc = Luv32toRGB;
+				LogLuvSetupTables(tif, 15, 0);
 				break;
 			}
 		}
@@ -1482,14 +1612,16 @@ LogLuvSetupDecode(TIFF* tif)
 		switch (sp->user_datafmt) {
 		case SGILOGDATAFMT_FLOAT:
 			sp->tfunc = L16toY;
+			LogLuvSetupTables(tif, 15, 0);
 			break;
 		case SGILOGDATAFMT_8BIT:
 			sp->tfunc = L16toGry;
+			LogLuvSetupTables(tif, 15, 0);
 			break;
 		}
 		return (1);
 	default:
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Inappropriate photometric interpretation %d for SGILog compression; %s",
 		    td->td_photometric, "must be either LogLUV or LogL");
 		break;
@@ -1553,7 +1685,7 @@ LogLuvSetupEncode(TIFF* tif)
 		}
 		break;
 	default:
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Inappropriate photometric interpretation %d for SGILog compression; %s",
 		    td->td_photometric, "must be either LogLUV or LogL");
 		break;
@@ -1561,7 +1693,7 @@ LogLuvSetupEncode(TIFF* tif)
 	sp->encoder_state = 1;
 	return (1);
 notsupported:
-	TIFFErrorExt(tif->tif_clientdata, module,
+	TIFFErrorExtR(tif, module,
 	    "SGILog compression supported only for %s, or raw data",
 	    td->td_photometric == PHOTOMETRIC_LOGL ? "Y, L" : "XYZ, Luv");
 	return (0);
@@ -1604,8 +1736,9 @@ LogLuvCleanup(TIFF* tif)
 	tif->tif_tagmethods.vsetfield = sp->vsetparent;
 
 	if (sp->tbuf)
-		_TIFFfree(sp->tbuf);
-	_TIFFfree(sp);
+		_TIFFfreeExt(tif, sp->tbuf);
+	LogLuvFreeTables(tif);
+	_TIFFfreeExt(tif, sp);
 	tif->tif_data = NULL;
 
 	_TIFFSetDefaultCompressionState(tif);
@@ -1646,7 +1779,7 @@ LogLuvVSetField(TIFF* tif, uint32 tag, va_list ap)
 			fmt = SAMPLEFORMAT_UINT;
 			break;
 		default:
-			TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+			TIFFErrorExtR(tif, tif->tif_name,
 			    "Unknown data format %d for LogLuv compression",
 			    sp->user_datafmt);
 			return (0);
@@ -1663,7 +1796,7 @@ LogLuvVSetField(TIFF* tif, uint32 tag, va_list ap)
 		sp->encode_meth = (int) va_arg(ap, int);
 		if (sp->encode_meth != SGILOGENCODE_NODITHER &&
 		    sp->encode_meth != SGILOGENCODE_RANDITHER) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Unknown encoding %d for LogLuv compression",
 			    sp->encode_meth);
 			return (0);
@@ -1706,7 +1839,7 @@ TIFFInitSGILog(TIFF* tif, int scheme)
 	 */
 	if (!_TIFFMergeFields(tif, LogLuvFields,
 			      TIFFArrayCount(LogLuvFields))) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Merging SGILog codec-specific tags failed");
 		return 0;
 	}
@@ -1714,7 +1847,7 @@ TIFFInitSGILog(TIFF* tif, int scheme)
 	/*
 	 * Allocate state block so tag methods have storage to record values.
 	 */
-	tif->tif_data = (uint8*) _TIFFmalloc(sizeof (LogLuvState));
+	tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof (LogLuvState));
 	if (tif->tif_data == NULL)
 		goto bad;
 	sp = (LogLuvState*) tif->tif_data;
@@ -1749,7 +1882,7 @@ TIFFInitSGILog(TIFF* tif, int scheme)
 
 	return (1);
 bad:
-	TIFFErrorExt(tif->tif_clientdata, module,
+	TIFFErrorExtR(tif, module,
 		     "%s: No space for LogLuv state block", tif->tif_name);
 	return (0);
 }
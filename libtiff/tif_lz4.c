@@ -0,0 +1,550 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include "tiffiop.h"
+#ifdef LZ4_SUPPORT
+/*
+ * TIFF Library.
+ *
+ * LZ4 Compression Support
+ *
+ * Each strip or tile is stored as a single LZ4 block, with no framing:
+ * the decoded size is known from the image layout.  Whole strips and
+ * tiles are compressed and decompressed with one call, straight between
+ * the caller's buffer and the raw data buffer.  Data given a scanline at
+ * a time is gathered until the end of the strip before being compressed,
+ * and a strip read a scanline at a time is decompressed once into a
+ * buffer the rows are then copied from.  A block can only be decoded
+ * whole, so scanline reading of unmapped files does not work in builds
+ * with CHUNKY_STRIP_READ_SUPPORT.  TIFFTAG_LZ4_LEVEL selects between the
+ * fast encoder and LZ4HC; the encoder states are kept for the life of
+ * the handle.
+ */
+
+#include "tif_predict.h"
+#include "lz4.h"
+#include "lz4hc.h"
+
+#include <stdio.h>
+
+#ifndef LZ4HC_CLEVEL_MAX
+#define LZ4HC_CLEVEL_MAX 12
+#endif
+
+/*
+ * State block for each open TIFF file using LZ4 compression/decompression.
+ */
+typedef struct {
+        TIFFPredictorState predict;
+        int             compression_level;      /* <0 fast, 0 default, >0 HC */
+        void*           fast_state;             /* LZ4_compress_fast_extState */
+        void*           hc_state;               /* LZ4_compress_HC_extStateHC */
+        uint8*          buffer;                 /* gathered or decoded data */
+        tmsize_t        buffer_size;
+        tmsize_t        buffer_used;            /* bytes gathered or decoded */
+        tmsize_t        buffer_pos;             /* bytes given back */
+        uint8*          cbuf;                   /* compressed chunk, if */
+        tmsize_t        cbuf_size;              /* ... tif_rawdata is small */
+        int             chunk_done;             /* chunk fully processed */
+        int             state;                  /* state flags */
+#define LSTATE_INIT_DECODE 0x01
+#define LSTATE_INIT_ENCODE 0x02
+
+        TIFFVGetMethod  vgetparent;            /* super-class method */
+        TIFFVSetMethod  vsetparent;            /* super-class method */
+} LZ4State;
+
+#define LState(tif)             ((LZ4State*) (tif)->tif_data)
+#define DecoderState(tif)       LState(tif)
+#define EncoderState(tif)       LState(tif)
+
+static int LZ4Encode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s);
+static int LZ4Decode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s);
+
+static int
+LZ4FixupTags(TIFF* tif)
+{
+        (void) tif;
+        return 1;
+}
+
+/*
+ * Make sure the strip or tile buffer can hold a whole chunk.
+ */
+static int
+LZ4SetupBuffer(TIFF* tif, const char* module)
+{
+        LZ4State* sp = LState(tif);
+        tmsize_t size = isTiled(tif) ? TIFFTileSize(tif) : TIFFStripSize(tif);
+
+        if( size <= 0 )
+            return 0;
+        if( size > LZ4_MAX_INPUT_SIZE ) {
+            TIFFErrorExtR(tif, module,
+                         "Strip or tile too large for LZ4 (%lu bytes)",
+                         (unsigned long) size);
+            return 0;
+        }
+        if( sp->buffer_size < size ) {
+            uint8* buffer = (uint8*) _TIFFreallocExt(tif, sp->buffer, size);
+            if( buffer == NULL ) {
+                TIFFErrorExtR(tif, module,
+                             "No space for LZ4 strip buffer");
+                return 0;
+            }
+            sp->buffer = buffer;
+            sp->buffer_size = size;
+        }
+        return 1;
+}
+
+static int
+LZ4SetupDecode(TIFF* tif)
+{
+        LZ4State* sp = DecoderState(tif);
+
+        assert(sp != NULL);
+
+        sp->state = LSTATE_INIT_DECODE;
+        return 1;
+}
+
+/*
+ * Setup state for decoding a strip.
+ */
+static int
+LZ4PreDecode(TIFF* tif, uint16 s)
+{
+        LZ4State* sp = DecoderState(tif);
+
+        (void) s;
+        assert(sp != NULL);
+
+        if( (sp->state & LSTATE_INIT_DECODE) == 0 )
+            tif->tif_setupdecode(tif);
+
+        sp->buffer_used = 0;
+        sp->buffer_pos = 0;
+        sp->chunk_done = 0;
+        return 1;
+}
+
+static int
+LZ4Decode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
+{
+        static const char module[] = "LZ4Decode";
+        LZ4State* sp = DecoderState(tif);
+        int n;
+
+        (void) s;
+        assert(sp != NULL);
+        assert(sp->state == LSTATE_INIT_DECODE);
+
+        if( tif->tif_rawcc > LZ4_MAX_INPUT_SIZE ) {
+                TIFFErrorExtR(tif, module,
+                             "Strip or tile too large for LZ4 (%lu bytes)",
+                             (unsigned long) tif->tif_rawcc);
+                return 0;
+        }
+
+        /*
+         * Decode a whole strip or tile straight into the caller's buffer.
+         * If that does not produce exactly the expected amount of data,
+         * start over below, which reports errors and tolerates over-long
+         * chunks.
+         */
+        if( !sp->chunk_done && occ <= LZ4_MAX_INPUT_SIZE &&
+            _TIFFIsWholeChunk(tif, occ) ) {
+                n = LZ4_decompress_safe((const char*) tif->tif_rawcp,
+                                        (char*) op, (int) tif->tif_rawcc,
+                                        (int) occ);
+                if( n == occ ) {
+                        tif->tif_rawcp += tif->tif_rawcc;
+                        tif->tif_rawcc = 0;
+                        sp->chunk_done = 1;
+                        return 1;
+                }
+        }
+
+        /* Otherwise decode the chunk once and hand it out in pieces */
+        if( !sp->chunk_done ) {
+                if( !LZ4SetupBuffer(tif, module) )
+                        return 0;
+                n = LZ4_decompress_safe((const char*) tif->tif_rawcp,
+                                        (char*) sp->buffer,
+                                        (int) tif->tif_rawcc,
+                                        (int) sp->buffer_size);
+                if( n < 0 ) {
+                        TIFFErrorExtR(tif, module,
+                            "Corrupted LZ4 data at scanline %lu",
+                            (unsigned long) tif->tif_row);
+                        return 0;
+                }
+                tif->tif_rawcp += tif->tif_rawcc;
+                tif->tif_rawcc = 0;
+                sp->buffer_used = n;
+                sp->buffer_pos = 0;
+                sp->chunk_done = 1;
+        }
+        if( sp->buffer_used - sp->buffer_pos < occ ) {
+                TIFFErrorExtR(tif, module,
+                    "Not enough data at scanline %lu (short %lu bytes)",
+                    (unsigned long) tif->tif_row,
+                    (unsigned long) (occ - (sp->buffer_used - sp->buffer_pos)));
+                return 0;
+        }
+        _TIFFmemcpy(op, sp->buffer + sp->buffer_pos, occ);
+        sp->buffer_pos += occ;
+        return 1;
+}
+
+static int
+LZ4SetupEncode(TIFF* tif)
+{
+        LZ4State* sp = EncoderState(tif);
+
+        assert(sp != NULL);
+
+        sp->state = LSTATE_INIT_ENCODE;
+        return 1;
+}
+
+/*
+ * Reset encoding state at the start of a strip.
+ */
+static int
+LZ4PreEncode(TIFF* tif, uint16 s)
+{
+        LZ4State *sp = EncoderState(tif);
+
+        (void) s;
+        assert(sp != NULL);
+        if( sp->state != LSTATE_INIT_ENCODE )
+            tif->tif_setupencode(tif);
+
+        sp->buffer_used = 0;
+        sp->chunk_done = 0;
+        return 1;
+}
+
+/*
+ * Compress cc bytes of data as one block and leave the result in the
+ * raw data buffer, flushing it first if it is too small.
+ */
+static int
+LZ4CompressChunk(TIFF* tif, const uint8* data, tmsize_t cc)
+{
+        static const char module[] = "LZ4Encode";
+        LZ4State *sp = EncoderState(tif);
+        tmsize_t bound = (tmsize_t) LZ4_compressBound((int) cc);
+        tmsize_t avail = tif->tif_rawdatasize - tif->tif_rawcc;
+        char* dst;
+        int n;
+
+        if( bound <= 0 ) {
+                TIFFErrorExtR(tif, module,
+                             "Strip or tile too large for LZ4 (%lu bytes)",
+                             (unsigned long) cc);
+                return 0;
+        }
+        if( bound <= avail )
+                dst = (char*) tif->tif_rawcp;
+        else {
+                if( sp->cbuf_size < bound ) {
+                        uint8* cbuf = (uint8*) _TIFFreallocExt(tif, sp->cbuf,
+                                                               bound);
+                        if( cbuf == NULL ) {
+                                TIFFErrorExtR(tif, module,
+                                    "No space for LZ4 output buffer");
+                                return 0;
+                        }
+                        sp->cbuf = cbuf;
+                        sp->cbuf_size = bound;
+                }
+                dst = (char*) sp->cbuf;
+        }
+
+        if( sp->compression_level > 0 ) {
+                if( sp->hc_state == NULL ) {
+                        sp->hc_state = _TIFFmallocExt(tif,
+                            (tmsize_t) LZ4_sizeofStateHC());
+                        if( sp->hc_state == NULL ) {
+                                TIFFErrorExtR(tif, module,
+                                    "No space for LZ4HC state");
+                                return 0;
+                        }
+                }
+                n = LZ4_compress_HC_extStateHC(sp->hc_state,
+                                               (const char*) data, dst,
+                                               (int) cc, (int) bound,
+                                               sp->compression_level);
+        } else {
+                if( sp->fast_state == NULL ) {
+                        sp->fast_state = _TIFFmallocExt(tif,
+                            (tmsize_t) LZ4_sizeofState());
+                        if( sp->fast_state == NULL ) {
+                                TIFFErrorExtR(tif, module,
+                                    "No space for LZ4 state");
+                                return 0;
+                        }
+                }
+                n = LZ4_compress_fast_extState(sp->fast_state,
+                                               (const char*) data, dst,
+                                               (int) cc, (int) bound,
+                                               sp->compression_level < 0 ?
+                                               -sp->compression_level : 1);
+        }
+        if( n <= 0 ) {
+                TIFFErrorExtR(tif, module,
+                             "LZ4 compression failed at scanline %lu",
+                             (unsigned long) tif->tif_row);
+                return 0;
+        }
+
+        if( dst == (char*) tif->tif_rawcp ) {
+                tif->tif_rawcp += n;
+                tif->tif_rawcc += n;
+        } else {
+                const uint8* src = sp->cbuf;
+                tmsize_t left = n;
+
+                while( left > 0 ) {
+                        tmsize_t chunk = tif->tif_rawdatasize - tif->tif_rawcc;
+
+                        if( chunk == 0 ) {
+                                if( !TIFFFlushData1(tif) )
+                                        return 0;
+                                continue;
+                        }
+                        if( chunk > left )
+                                chunk = left;
+                        _TIFFmemcpy(tif->tif_rawcp, src, chunk);
+                        tif->tif_rawcp += chunk;
+                        tif->tif_rawcc += chunk;
+                        src += chunk;
+                        left -= chunk;
+                }
+        }
+        sp->chunk_done = 1;
+        return 1;
+}
+
+/*
+ * Encode a chunk of pixels.
+ */
+static int
+LZ4Encode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
+{
+        static const char module[] = "LZ4Encode";
+        LZ4State *sp = EncoderState(tif);
+
+        assert(sp != NULL);
+        assert(sp->state == LSTATE_INIT_ENCODE);
+
+        (void) s;
+
+        if( sp->chunk_done ) {
+                TIFFErrorExtR(tif, module,
+                             "Strip or tile already compressed");
+                return 0;
+        }
+
+        /* A whole strip or tile is compressed on the spot */
+        if( sp->buffer_used == 0 && cc <= LZ4_MAX_INPUT_SIZE &&
+            _TIFFIsWholeChunk(tif, cc) )
+                return LZ4CompressChunk(tif, bp, cc);
+
+        if( !LZ4SetupBuffer(tif, module) )
+                return 0;
+        if( cc > sp->buffer_size - sp->buffer_used ) {
+                TIFFErrorExtR(tif, module,
+                             "More data than fits in a strip or tile");
+                return 0;
+        }
+        _TIFFmemcpy(sp->buffer + sp->buffer_used, bp, cc);
+        sp->buffer_used += cc;
+        return 1;
+}
+
+/*
+ * Finish off an encoded strip by compressing the data gathered.
+ */
+static int
+LZ4PostEncode(TIFF* tif)
+{
+        LZ4State *sp = EncoderState(tif);
+
+        if( sp->chunk_done || sp->buffer_used == 0 )
+                return 1;
+        if( !LZ4CompressChunk(tif, sp->buffer, sp->buffer_used) )
+                return 0;
+        sp->buffer_used = 0;
+        return 1;
+}
+
+static void
+LZ4Cleanup(TIFF* tif)
+{
+        LZ4State* sp = LState(tif);
+
+        assert(sp != 0);
+
+        (void)TIFFPredictorCleanup(tif);
+
+        tif->tif_tagmethods.vgetfield = sp->vgetparent;
+        tif->tif_tagmethods.vsetfield = sp->vsetparent;
+
+        if (sp->fast_state)
+            _TIFFfreeExt(tif, sp->fast_state);
+        if (sp->hc_state)
+            _TIFFfreeExt(tif, sp->hc_state);
+        if (sp->buffer)
+            _TIFFfreeExt(tif, sp->buffer);
+        if (sp->cbuf)
+            _TIFFfreeExt(tif, sp->cbuf);
+        _TIFFfreeExt(tif, sp);
+        tif->tif_data = NULL;
+
+        _TIFFSetDefaultCompressionState(tif);
+}
+
+static int
+LZ4VSetField(TIFF* tif, uint32 tag, va_list ap)
+{
+	static const char module[] = "LZ4VSetField";
+        LZ4State* sp = LState(tif);
+        int v;
+
+        switch (tag) {
+        case TIFFTAG_LZ4_LEVEL:
+                v = (int) va_arg(ap, int);
+                if( v > LZ4HC_CLEVEL_MAX ) {
+                    TIFFErrorExtR(tif, module,
+                                 "LZ4_LEVEL should be at most %d",
+                                 LZ4HC_CLEVEL_MAX);
+                    return 0;
+                }
+                sp->compression_level = v;
+                return 1;
+        default:
+                return (*sp->vsetparent)(tif, tag, ap);
+        }
+        /*NOTREACHED*/
+}
+
+static int
+LZ4VGetField(TIFF* tif, uint32 tag, va_list ap)
+{
+        LZ4State* sp = LState(tif);
+
+        switch (tag) {
+        case TIFFTAG_LZ4_LEVEL:
+                *va_arg(ap, int*) = sp->compression_level;
+                break;
+        default:
+                return (*sp->vgetparent)(tif, tag, ap);
+        }
+        return 1;
+}
+
+static const TIFFField LZ4Fields[] = {
+        { TIFFTAG_LZ4_LEVEL, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, FALSE, "LZ4 compression_level", NULL },
+};
+
+int
+TIFFInitLZ4(TIFF* tif, int scheme)
+{
+        static const char module[] = "TIFFInitLZ4";
+        LZ4State* sp;
+
+        assert( scheme == COMPRESSION_LZ4 );
+
+        /*
+        * Merge codec-specific tag information.
+        */
+        if (!_TIFFMergeFields(tif, LZ4Fields, TIFFArrayCount(LZ4Fields))) {
+                TIFFErrorExtR(tif, module,
+                            "Merging LZ4 codec-specific tags failed");
+                return 0;
+        }
+
+        /*
+        * Allocate state block so tag methods have storage to record values.
+        */
+        tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof(LZ4State));
+        if (tif->tif_data == NULL)
+                goto bad;
+        sp = LState(tif);
+
+        /*
+        * Override parent get/set field methods.
+        */
+        sp->vgetparent = tif->tif_tagmethods.vgetfield;
+        tif->tif_tagmethods.vgetfield = LZ4VGetField;	/* hook for codec tags */
+        sp->vsetparent = tif->tif_tagmethods.vsetfield;
+        tif->tif_tagmethods.vsetfield = LZ4VSetField;	/* hook for codec tags */
+
+        /* Default values for codec-specific fields */
+        sp->compression_level = 0;		/* fast encoder */
+        sp->fast_state = NULL;
+        sp->hc_state = NULL;
+        sp->buffer = NULL;
+        sp->buffer_size = 0;
+        sp->buffer_used = 0;
+        sp->buffer_pos = 0;
+        sp->cbuf = NULL;
+        sp->cbuf_size = 0;
+        sp->chunk_done = 0;
+        sp->state = 0;
+
+        /*
+        * Install codec methods.
+        */
+        tif->tif_fixuptags = LZ4FixupTags;
+        tif->tif_setupdecode = LZ4SetupDecode;
+        tif->tif_predecode = LZ4PreDecode;
+        tif->tif_decoderow = LZ4Decode;
+        tif->tif_decodestrip = LZ4Decode;
+        tif->tif_decodetile = LZ4Decode;
+        tif->tif_setupencode = LZ4SetupEncode;
+        tif->tif_preencode = LZ4PreEncode;
+        tif->tif_postencode = LZ4PostEncode;
+        tif->tif_encoderow = LZ4Encode;
+        tif->tif_encodestrip = LZ4Encode;
+        tif->tif_encodetile = LZ4Encode;
+        tif->tif_cleanup = LZ4Cleanup;
+        /*
+        * Setup predictor setup.
+        */
+        (void) TIFFPredictorInit(tif);
+        return 1;
+bad:
+        TIFFErrorExtR(tif, module,
+                    "No space for LZ4 state block");
+        return 0;
+}
+#endif /* LZ4_SUPPORT */
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
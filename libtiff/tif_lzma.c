@@ -31,6 +31,11 @@
  * You need an LZMA2 SDK to link with. See http://tukaani.org/xz/ for details.
  *
  * The codec is derived from ZLIB codec (tif_zip.c).
+ *
+ * With liblzma 5.2.0 or later, TIFFTAG_LZMA_THREADS selects the
+ * multithreaded encoder, which splits each strip or tile in blocks
+ * compressed in parallel.  The result is a regular multi-block .xz
+ * stream that any LZMA2 reader can decode.
  */
 
 #include "tif_predict.h"
@@ -38,6 +43,15 @@
 
 #include <stdio.h>
 
+#if LZMA_VERSION >= 50020002
+#define LZMA_HAVE_MT 1
+#else
+#define LZMA_HAVE_MT 0
+#endif
+
+/* Smallest block handed to a thread; smaller ones hurt compression */
+#define LZMA_MIN_BLOCK_SIZE ((uint64) 1 << 20)
+
 /*
  * State block for each open TIFF file using LZMA2 compression/decompression.
  */
@@ -49,6 +63,7 @@ typedef struct {
 	lzma_options_lzma opt_lzma;		/* LZMA2 filter options */
 	int             preset;			/* compression level */
 	lzma_check	check;			/* type of the integrity check */
+	int             threads;		/* encoder threads, 0 = single */
 	int             state;			/* state flags */
 #define LSTATE_INIT_DECODE 0x01
 #define LSTATE_INIT_ENCODE 0x02
@@ -140,7 +155,7 @@ LZMAPreDecode(TIFF* tif, uint16 s)
 	sp->stream.next_in = tif->tif_rawdata;
 	sp->stream.avail_in = (size_t) tif->tif_rawcc;
 	if ((tmsize_t)sp->stream.avail_in != tif->tif_rawcc) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Liblzma cannot deal with buffers this size");
 		return 0;
 	}
@@ -151,7 +166,7 @@ LZMAPreDecode(TIFF* tif, uint16 s)
 	 */
 	ret = lzma_stream_decoder(&sp->stream, (uint64_t)-1, 0);
 	if (ret != LZMA_OK) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Error initializing the stream decoder, %s",
 			     LZMAStrerror(ret));
 		return 0;
@@ -175,7 +190,7 @@ LZMADecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 	sp->stream.next_out = op;
 	sp->stream.avail_out = (size_t) occ;
 	if ((tmsize_t)sp->stream.avail_out != occ) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Liblzma cannot deal with buffers this size");
 		return 0;
 	}
@@ -195,7 +210,7 @@ LZMADecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 			lzma_ret r = lzma_stream_decoder(&sp->stream,
 							 lzma_memusage(&sp->stream), 0);
 			if (r != LZMA_OK) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "Error initializing the stream decoder, %s",
 					     LZMAStrerror(r));
 				break;
@@ -205,14 +220,14 @@ LZMADecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 			continue;
 		}
 		if (ret != LZMA_OK) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Decoding error at scanline %lu, %s",
 			    (unsigned long) tif->tif_row, LZMAStrerror(ret));
 			break;
 		}
 	} while (sp->stream.avail_out > 0);
 	if (sp->stream.avail_out != 0) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Not enough data at scanline %lu (short %lu bytes)",
 		    (unsigned long) tif->tif_row, (unsigned long) sp->stream.avail_out);
 		return 0;
@@ -256,10 +271,35 @@ LZMAPreEncode(TIFF* tif, uint16 s)
 	sp->stream.next_out = tif->tif_rawdata;
 	sp->stream.avail_out = (size_t)tif->tif_rawdatasize;
 	if ((tmsize_t)sp->stream.avail_out != tif->tif_rawdatasize) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Liblzma cannot deal with buffers this size");
 		return 0;
 	}
+#if LZMA_HAVE_MT
+	if (sp->threads > 1) {
+		uint64 chunksize = isTiled(tif) ?
+		    TIFFTileSize64(tif) : TIFFStripSize64(tif);
+		lzma_mt mt;
+		lzma_ret ret;
+
+		/* Split the chunk evenly between the threads */
+		memset(&mt, 0, sizeof(mt));
+		mt.threads = (uint32_t) sp->threads;
+		mt.block_size = (chunksize + sp->threads - 1) / sp->threads;
+		if (mt.block_size < LZMA_MIN_BLOCK_SIZE)
+			mt.block_size = LZMA_MIN_BLOCK_SIZE;
+		mt.filters = sp->filters;
+		mt.check = sp->check;
+		ret = lzma_stream_encoder_mt(&sp->stream, &mt);
+		if (ret == LZMA_OK)
+			return 1;
+		TIFFWarningExtR(tif, module,
+			       "Cannot use %d encoder threads, %s; "
+			       "encoding on the calling thread",
+			       sp->threads, LZMAStrerror(ret));
+		sp->threads = 0;
+	}
+#endif
 	return (lzma_stream_encoder(&sp->stream, sp->filters, sp->check) == LZMA_OK);
 }
 
@@ -279,14 +319,14 @@ LZMAEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	sp->stream.next_in = bp;
 	sp->stream.avail_in = (size_t) cc;
 	if ((tmsize_t)sp->stream.avail_in != cc) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Liblzma cannot deal with buffers this size");
 		return 0;
 	}
 	do {
 		lzma_ret ret = lzma_code(&sp->stream, LZMA_RUN);
 		if (ret != LZMA_OK) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				"Encoding error at scanline %lu, %s",
 				(unsigned long) tif->tif_row, LZMAStrerror(ret));
 			return 0;
@@ -327,7 +367,7 @@ LZMAPostEncode(TIFF* tif)
 			}
 			break;
 		default:
-			TIFFErrorExt(tif->tif_clientdata, module, "Liblzma error: %s",
+			TIFFErrorExtR(tif, module, "Liblzma error: %s",
 				     LZMAStrerror(ret));
 			return 0;
 		}
@@ -351,7 +391,7 @@ LZMACleanup(TIFF* tif)
 		lzma_end(&sp->stream);
 		sp->state = 0;
 	}
-	_TIFFfree(sp);
+	_TIFFfreeExt(tif, sp);
 	tif->tif_data = NULL;
 
 	_TIFFSetDefaultCompressionState(tif);
@@ -372,12 +412,28 @@ LZMAVSetField(TIFF* tif, uint32 tag, va_list ap)
 							   sp->filters,
 							   sp->check);
 			if (ret != LZMA_OK) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 					     "Liblzma error: %s",
 					     LZMAStrerror(ret));
 			}
 		}
 		return 1;
+	case TIFFTAG_LZMA_THREADS:
+		sp->threads = (int) va_arg(ap, int);
+#if LZMA_HAVE_MT
+		if (sp->threads < 0) {
+			TIFFErrorExtR(tif, module,
+				     "LZMA_THREADS should not be negative");
+			sp->threads = 0;
+			return 0;
+		}
+		return 1;
+#else
+		sp->threads = 0;
+		TIFFErrorExtR(tif, module,
+			     "Multithreaded encoding requires liblzma 5.2.0 or later");
+		return 0;
+#endif
 	default:
 		return (*sp->vsetparent)(tif, tag, ap);
 	}
@@ -393,6 +449,9 @@ LZMAVGetField(TIFF* tif, uint32 tag, va_list ap)
 	case TIFFTAG_LZMAPRESET:
 		*va_arg(ap, int*) = sp->preset;
 		break;
+	case TIFFTAG_LZMA_THREADS:
+		*va_arg(ap, int*) = sp->threads;
+		break;
 	default:
 		return (*sp->vgetparent)(tif, tag, ap);
 	}
@@ -402,6 +461,8 @@ LZMAVGetField(TIFF* tif, uint32 tag, va_list ap)
 static const TIFFField lzmaFields[] = {
 	{ TIFFTAG_LZMAPRESET, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED,
 		FIELD_PSEUDO, TRUE, FALSE, "LZMA2 Compression Preset", NULL },
+	{ TIFFTAG_LZMA_THREADS, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED,
+		FIELD_PSEUDO, TRUE, FALSE, "LZMA2 Encoder Threads", NULL },
 };
 
 int
@@ -417,7 +478,7 @@ TIFFInitLZMA(TIFF* tif, int scheme)
 	 * Merge codec-specific tag information.
 	 */
 	if (!_TIFFMergeFields(tif, lzmaFields, TIFFArrayCount(lzmaFields))) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Merging LZMA2 codec-specific tags failed");
 		return 0;
 	}
@@ -425,7 +486,7 @@ TIFFInitLZMA(TIFF* tif, int scheme)
 	/*
 	 * Allocate state block so tag methods have storage to record values.
 	 */
-	tif->tif_data = (uint8*) _TIFFmalloc(sizeof(LZMAState));
+	tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof(LZMAState));
 	if (tif->tif_data == NULL)
 		goto bad;
 	sp = LState(tif);
@@ -442,6 +503,7 @@ TIFFInitLZMA(TIFF* tif, int scheme)
 	/* Default values for codec-specific fields */
 	sp->preset = LZMA_PRESET_DEFAULT;		/* default comp. level */
 	sp->check = LZMA_CHECK_NONE;
+	sp->threads = 0;
 	sp->state = 0;
 
 	/* Data filters. So far we are using delta and LZMA2 filters only. */
@@ -482,9 +544,10 @@ TIFFInitLZMA(TIFF* tif, int scheme)
 	 * Setup predictor setup.
 	 */
 	(void) TIFFPredictorInit(tif);
+	sp->predict.batchdecode = 1;
 	return 1;
 bad:
-	TIFFErrorExt(tif->tif_clientdata, module,
+	TIFFErrorExtR(tif, module,
 		     "No space for LZMA2 state block");
 	return 0;
 }
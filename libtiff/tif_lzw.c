@@ -37,6 +37,7 @@
 #include "tif_predict.h"
 
 #include <stdio.h>
+#include <string.h>
 
 /*
  * NB: The 5.0 spec describes a different algorithm than Aldus
@@ -74,6 +75,8 @@
 #define CODE_MAX        MAXCODE(BITS_MAX)
 #define HSIZE           9001L           /* 91% occupancy */
 #define HSHIFT          (13-8)
+#define FHBITS          14              /* LZWENCODEMODE_FAST table */
+#define FHSIZE          (1L<<FHBITS)    /* 23% occupancy at most */
 #ifdef LZW_COMPAT
 /* NB: +1024 is for compatibility with old files */
 #define CSIZE           (MAXCODE(BITS_MAX)+1024L)
@@ -112,6 +115,13 @@ typedef struct {
 	long	hash;
 	hcode_t	code;
 } hash_t;
+/*
+ * LZWENCODEMODE_FAST keeps the prefix code/next character key in the
+ * upper 20 bits and the code in the lower 12 bits of a single word;
+ * 0 marks a free slot since no code below CODE_FIRST is ever stored.
+ */
+typedef uint32 fhash_t;
+#define FHASH(fcode)    ((uint32)((fcode) * 2654435761U) >> (32-FHBITS))
 
 /*
  * Decoding-specific state.
@@ -121,6 +131,7 @@ typedef struct code_ent {
 	unsigned short	length;		/* string len, including this token */
 	unsigned char	value;		/* data value */
 	unsigned char	firstchar;	/* first token of string */
+	uint32		offset;		/* where string was last output */
 } code_t;
 
 typedef int (*decodeFunc)(TIFF*, uint8*, tmsize_t, uint16);
@@ -150,6 +161,12 @@ typedef struct {
 	long    enc_outcount;		/* encoded (output) bytes */
 	uint8*  enc_rawlimit;		/* bound on tif_rawdata buffer */
 	hash_t* enc_hashtab;		/* kept separate for small machines */
+	fhash_t* enc_fhashtab;		/* LZWENCODEMODE_FAST hash table */
+	int     enc_mode;		/* LZWENCODEMODE_* */
+	int     enc_fast;		/* mode of the current strip or tile */
+
+	TIFFVGetMethod vgetparent;	/* super-class method */
+	TIFFVSetMethod vsetparent;	/* super-class method */
 } LZWCodecState;
 
 #define LZWState(tif)		((LZWBaseState*) (tif)->tif_data)
@@ -173,7 +190,7 @@ static void cl_hash(LZWCodecState*);
  */
 #define	NextCode(_tif, _sp, _bp, _code, _get) {				\
 	if ((_sp)->dec_bitsleft < (uint64)nbits) {			\
-		TIFFWarningExt(_tif->tif_clientdata, module,		\
+		TIFFWarningExtR(_tif, module,		\
 		    "LZWDecode: Strip %d not terminated with EOI code", \
 		    _tif->tif_curstrip);				\
 		_code = CODE_EOI;					\
@@ -206,15 +223,21 @@ LZWSetupDecode(TIFF* tif)
 		 * Allocate state block so tag methods have storage to record
 		 * values.
 		*/
-		tif->tif_data = (uint8*) _TIFFmalloc(sizeof(LZWCodecState));
+		tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof(LZWCodecState));
 		if (tif->tif_data == NULL)
 		{
-			TIFFErrorExt(tif->tif_clientdata, module, "No space for LZW state block");
+			TIFFErrorExtR(tif, module, "No space for LZW state block");
 			return (0);
 		}
 
 		DecoderState(tif)->dec_codetab = NULL;
 		DecoderState(tif)->dec_decode = NULL;
+		EncoderState(tif)->enc_hashtab = NULL;
+		EncoderState(tif)->enc_fhashtab = NULL;
+		EncoderState(tif)->enc_mode = LZWENCODEMODE_COMPAT;
+		EncoderState(tif)->enc_fast = 0;
+		EncoderState(tif)->vgetparent = NULL;
+		EncoderState(tif)->vsetparent = NULL;
 
 		/*
 		 * Setup predictor setup.
@@ -227,9 +250,9 @@ LZWSetupDecode(TIFF* tif)
 	assert(sp != NULL);
 
 	if (sp->dec_codetab == NULL) {
-		sp->dec_codetab = (code_t*)_TIFFmalloc(CSIZE*sizeof (code_t));
+		sp->dec_codetab = (code_t*)_TIFFmallocExt(tif, CSIZE*sizeof (code_t));
 		if (sp->dec_codetab == NULL) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				     "No space for LZW code table");
 			return (0);
 		}
@@ -277,7 +300,7 @@ LZWPreDecode(TIFF* tif, uint16 s)
 	    tif->tif_rawdata[0] == 0 && (tif->tif_rawdata[1] & 0x1)) {
 #ifdef LZW_COMPAT
 		if (!sp->dec_decode) {
-			TIFFWarningExt(tif->tif_clientdata, module,
+			TIFFWarningExtR(tif, module,
 			    "Old-style LZW codes, convert file");
 			/*
 			 * Override default decoding methods with
@@ -300,7 +323,7 @@ LZWPreDecode(TIFF* tif, uint16 s)
 		sp->lzw_maxcode = MAXCODE(BITS_MIN);
 #else /* !LZW_COMPAT */
 		if (!sp->dec_decode) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Old-style LZW codes not supported");
 			sp->dec_decode = LZWDecode;
 		}
@@ -335,22 +358,63 @@ LZWPreDecode(TIFF* tif, uint16 s)
 
 /*
  * Decode a "hunk of data".
+ *
+ * Input is read 32 bits at a time while at least 4 bytes remain, so a
+ * single refill yields two or three codes; the unused whole bytes are
+ * given back when returning.  Close to the end of the data bytes are
+ * read one at a time, exactly as needed.
  */
 #define	GetNextCode(sp, bp, code) {				\
-	nextdata = (nextdata<<8) | *(bp)++;			\
-	nextbits += 8;						\
 	if (nextbits < nbits) {					\
-		nextdata = (nextdata<<8) | *(bp)++;		\
-		nextbits += 8;					\
+		if (bpend - (bp) >= 4) {			\
+			nextdata = (nextdata<<32) |		\
+			    ((uint64)(bp)[0] << 24) |		\
+			    ((uint64)(bp)[1] << 16) |		\
+			    ((uint64)(bp)[2] << 8) | (bp)[3];	\
+			(bp) += 4;				\
+			nextbits += 32;				\
+		} else {					\
+			nextdata = (nextdata<<8) | *(bp)++;	\
+			nextbits += 8;				\
+			if (nextbits < nbits) {			\
+				nextdata = (nextdata<<8) | *(bp)++;\
+				nextbits += 8;			\
+			}					\
+		}						\
 	}							\
 	code = (hcode_t)((nextdata >> (nextbits-nbits)) & nbitsmask);	\
 	nextbits -= nbits;					\
 }
 
+/*
+ * Copy n bytes with at most two fixed size moves for short strings,
+ * which are the most frequent, rather than calling memcpy().
+ */
+#define	CopyString(dst, src, n) {				\
+	if ((n) < 4) {						\
+		(dst)[0] = (src)[0];				\
+		(dst)[(n) / 2] = (src)[(n) / 2];		\
+		(dst)[(n) - 1] = (src)[(n) - 1];		\
+	} else if ((n) < 8) {					\
+		uint32 _a, _b;					\
+		memcpy(&_a, (src), 4);				\
+		memcpy(&_b, (src) + (n) - 4, 4);		\
+		memcpy((dst), &_a, 4);				\
+		memcpy((dst) + (n) - 4, &_b, 4);		\
+	} else if ((n) <= 16) {					\
+		uint64 _a, _b;					\
+		memcpy(&_a, (src), 8);				\
+		memcpy(&_b, (src) + (n) - 8, 8);		\
+		memcpy((dst), &_a, 8);				\
+		memcpy((dst) + (n) - 8, &_b, 8);		\
+	} else							\
+		_TIFFmemcpy((dst), (src), (n));			\
+}
+
 static void
 codeLoop(TIFF* tif, const char* module)
 {
-	TIFFErrorExt(tif->tif_clientdata, module,
+	TIFFErrorExtR(tif, module,
 	    "Bogus encoding, loop in the code table; scanline %d",
 	    tif->tif_row);
 }
@@ -363,12 +427,14 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 	char *op = (char*) op0;
 	long occ = (long) occ0;
 	char *tp;
-	unsigned char *bp;
+	unsigned char *bp, *bpend;
 	hcode_t code;
 	int len;
 	long nbits, nextbits, nbitsmask;
-        unsigned long nextdata;
+	uint64 nextdata;
 	code_t *codep, *free_entp, *maxcodep, *oldcodep;
+	code_t *validp;
+	char *oldop = op;
 
 	(void) s;
 	assert(sp != NULL);
@@ -424,6 +490,7 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 	}
 
 	bp = (unsigned char *)tif->tif_rawcp;
+	bpend = bp + tif->tif_rawcc;
 #ifdef LZW_CHECKEOS
 	sp->dec_bitsleft = (((uint64)tif->tif_rawcc) << 3);
 #endif
@@ -435,6 +502,18 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 	free_entp = sp->dec_free_entp;
 	maxcodep = sp->dec_maxcodep;
 
+	/*
+	 * Table entries from validp up to free_entp hold the offset in
+	 * op0 where their string was last written, so that it can be
+	 * copied rather than rebuilt from the linked list.  The entry
+	 * made for the first code of this call refers to output from a
+	 * previous call and is not usable; neither is anything when the
+	 * offsets would not fit.
+	 */
+	validp = sp->dec_codetab + CSIZE;
+	if ((uint64) occ0 <= 0xffffffffU && free_entp < validp)
+		validp = free_entp + 1;
+
 	while (occ > 0) {
 		NextCode(tif, sp, bp, code, GetNextCode);
 		if (code == CODE_EOI)
@@ -442,8 +521,6 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 		if (code == CODE_CLEAR) {
 			do {
 				free_entp = sp->dec_codetab + CODE_FIRST;
-				_TIFFmemset(free_entp, 0,
-					    (CSIZE - CODE_FIRST) * sizeof (code_t));
 				nbits = BITS_MIN;
 				nbitsmask = MAXCODE(BITS_MIN);
 				maxcodep = sp->dec_codetab + nbitsmask-1;
@@ -452,11 +529,14 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 			if (code == CODE_EOI)
 				break;
 			if (code > CODE_CLEAR) {
-				TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+				TIFFErrorExtR(tif, tif->tif_name,
 				"LZWDecode: Corrupted LZW table at scanline %d",
 					     tif->tif_row);
 				return (0);
 			}
+			if (validp != sp->dec_codetab + CSIZE)
+				validp = sp->dec_codetab + CODE_FIRST;
+			oldop = op;
 			*op++ = (char)code;
 			occ--;
 			oldcodep = sp->dec_codetab + code;
@@ -469,7 +549,7 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 		 */
 		if (free_entp < &sp->dec_codetab[0] ||
 		    free_entp >= &sp->dec_codetab[CSIZE]) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Corrupted LZW table at scanline %d",
 			    tif->tif_row);
 			return (0);
@@ -478,7 +558,7 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 		free_entp->next = oldcodep;
 		if (free_entp->next < &sp->dec_codetab[0] ||
 		    free_entp->next >= &sp->dec_codetab[CSIZE]) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Corrupted LZW table at scanline %d",
 			    tif->tif_row);
 			return (0);
@@ -487,6 +567,7 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 		free_entp->length = free_entp->next->length+1;
 		free_entp->value = (codep < free_entp) ?
 		    codep->firstchar : free_entp->firstchar;
+		free_entp->offset = (uint32) (oldop - (char*) op0);
 		if (++free_entp > maxcodep) {
 			if (++nbits > BITS_MAX)		/* should not happen */
 				nbits = BITS_MAX;
@@ -494,13 +575,18 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 			maxcodep = sp->dec_codetab + nbitsmask-1;
 		}
 		oldcodep = codep;
+		oldop = op;
 		if (code >= 256) {
 			/*
 			 * Code maps to a string, copy string
 			 * value to output (written in reverse).
 			 */
-			if(codep->length == 0) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+			/*
+			 * Entries past free_entp are left over from before
+			 * the last CODE_CLEAR and must not be used.
+			 */
+			if(codep >= free_entp || codep->length == 0) {
+				TIFFErrorExtR(tif, module,
 				    "Wrong length of decoded string: "
 				    "data probably corrupted at scanline %d",
 				    tif->tif_row);
@@ -530,6 +616,21 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 				break;
 			}
 			len = codep->length;
+			if (codep >= validp && codep < free_entp) {
+				/*
+				 * The string is already in the output:
+				 * all of it but its last byte, which is
+				 * only being written now when the code
+				 * is the entry just added.
+				 */
+				const char* from = (char*) op0 + codep->offset;
+
+				CopyString(op, from, len - 1);
+				op[len - 1] = (char) codep->value;
+				op += len;
+				occ -= len;
+				continue;
+			}
 			tp = op + len;
 			do {
 				int t;
@@ -551,10 +652,18 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 		}
 	}
 
+	/*
+	 * Give back the whole bytes read ahead.
+	 */
+	while (nextbits >= 8) {
+		bp--;
+		nextdata >>= 8;
+		nextbits -= 8;
+	}
 	tif->tif_rawcc -= (tmsize_t)( (uint8*) bp - tif->tif_rawcp );
 	tif->tif_rawcp = (uint8*) bp;
 	sp->lzw_nbits = (unsigned short) nbits;
-	sp->lzw_nextdata = nextdata;
+	sp->lzw_nextdata = (unsigned long) nextdata;
 	sp->lzw_nextbits = nextbits;
 	sp->dec_nbitsmask = nbitsmask;
 	sp->dec_oldcodep = oldcodep;
@@ -563,11 +672,11 @@ LZWDecode(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 
 	if (occ > 0) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			"Not enough data at scanline %d (short %I64d bytes)",
 			     tif->tif_row, (unsigned __int64) occ);
 #else
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			"Not enough data at scanline %d (short %llu bytes)",
 			     tif->tif_row, (unsigned long long) occ);
 #endif
@@ -682,7 +791,7 @@ LZWDecodeCompat(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 			if (code == CODE_EOI)
 				break;
 			if (code > CODE_CLEAR) {
-				TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+				TIFFErrorExtR(tif, tif->tif_name,
 				"LZWDecode: Corrupted LZW table at scanline %d",
 					     tif->tif_row);
 				return (0);
@@ -699,7 +808,7 @@ LZWDecodeCompat(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 		 */
 		if (free_entp < &sp->dec_codetab[0] ||
 		    free_entp >= &sp->dec_codetab[CSIZE]) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Corrupted LZW table at scanline %d", tif->tif_row);
 			return (0);
 		}
@@ -707,7 +816,7 @@ LZWDecodeCompat(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 		free_entp->next = oldcodep;
 		if (free_entp->next < &sp->dec_codetab[0] ||
 		    free_entp->next >= &sp->dec_codetab[CSIZE]) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Corrupted LZW table at scanline %d", tif->tif_row);
 			return (0);
 		}
@@ -728,7 +837,7 @@ LZWDecodeCompat(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 			 * value to output (written in reverse).
 			 */
 			if(codep->length == 0) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				    "Wrong length of decoded "
 				    "string: data probably corrupted at scanline %d",
 				    tif->tif_row);
@@ -778,11 +887,11 @@ LZWDecodeCompat(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 
 	if (occ > 0) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			"Not enough data at scanline %d (short %I64d bytes)",
 			     tif->tif_row, (unsigned __int64) occ);
 #else
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			"Not enough data at scanline %d (short %llu bytes)",
 			     tif->tif_row, (unsigned long long) occ);
 #endif
@@ -792,6 +901,97 @@ LZWDecodeCompat(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 }
 #endif /* LZW_COMPAT */
 
+/*
+ * Decoder checkpoints: the code table entries in use and the bit
+ * reader state.  Table links are kept as pointers, so a snapshot is
+ * only restored into the table it was taken from.
+ */
+typedef struct {
+	code_t*         codetab;        /* table of the snapshot */
+	unsigned short  nbits;
+	unsigned short  maxcode;
+	unsigned short  free_ent;
+	unsigned long   nextdata;
+	long            nextbits;
+	long            nbitsmask;
+	long            restart;
+	tmsize_t        codep;          /* table indices */
+	tmsize_t        oldcodep;
+	tmsize_t        free_entp;
+	tmsize_t        maxcodep;
+	code_t          entries[1];     /* CODE_FIRST up to free_entp */
+} LZWSnapshot;
+
+static void*
+LZWSaveState(TIFF* tif)
+{
+	LZWCodecState *sp = DecoderState(tif);
+	LZWSnapshot* ss;
+	tmsize_t n;
+
+	if (sp->dec_codetab == NULL)
+		return (NULL);
+	n = sp->dec_free_entp - (sp->dec_codetab + CODE_FIRST);
+	if (n < 0)
+		n = 0;
+	ss = (LZWSnapshot*) _TIFFmallocExt(tif, sizeof(LZWSnapshot) +
+	    n * sizeof(code_t));
+	if (ss == NULL)
+		return (NULL);
+	ss->codetab = sp->dec_codetab;
+	ss->nbits = sp->lzw_nbits;
+	ss->maxcode = sp->lzw_maxcode;
+	ss->free_ent = sp->lzw_free_ent;
+	ss->nextdata = sp->lzw_nextdata;
+	ss->nextbits = sp->lzw_nextbits;
+	ss->nbitsmask = sp->dec_nbitsmask;
+	ss->restart = sp->dec_restart;
+	ss->codep = sp->dec_restart ? sp->dec_codep - sp->dec_codetab : 0;
+	ss->oldcodep = sp->dec_oldcodep - sp->dec_codetab;
+	ss->free_entp = sp->dec_free_entp - sp->dec_codetab;
+	ss->maxcodep = sp->dec_maxcodep - sp->dec_codetab;
+	_TIFFmemcpy(ss->entries, sp->dec_codetab + CODE_FIRST,
+	    n * sizeof(code_t));
+	return (ss);
+}
+
+static int
+LZWRestoreState(TIFF* tif, void* state)
+{
+	LZWCodecState *sp = DecoderState(tif);
+	LZWSnapshot* ss = (LZWSnapshot*) state;
+	tmsize_t n;
+
+	if (sp->dec_codetab == NULL || sp->dec_codetab != ss->codetab)
+		return (0);
+	n = ss->free_entp - CODE_FIRST;
+	if (n < 0)
+		n = 0;
+	_TIFFmemcpy(sp->dec_codetab + CODE_FIRST, ss->entries,
+	    n * sizeof(code_t));
+	/* As in LZWPreDecode(), unused entries must read as empty */
+	_TIFFmemset(sp->dec_codetab + CODE_FIRST + n, 0,
+	    (CSIZE - CODE_FIRST - n) * sizeof(code_t));
+	sp->lzw_nbits = ss->nbits;
+	sp->lzw_maxcode = ss->maxcode;
+	sp->lzw_free_ent = ss->free_ent;
+	sp->lzw_nextdata = ss->nextdata;
+	sp->lzw_nextbits = ss->nextbits;
+	sp->dec_nbitsmask = ss->nbitsmask;
+	sp->dec_restart = ss->restart;
+	sp->dec_codep = sp->dec_codetab + ss->codep;
+	sp->dec_oldcodep = sp->dec_codetab + ss->oldcodep;
+	sp->dec_free_entp = sp->dec_codetab + ss->free_entp;
+	sp->dec_maxcodep = sp->dec_codetab + ss->maxcodep;
+	return (1);
+}
+
+static void
+LZWFreeState(TIFF* tif, void* state)
+{
+	_TIFFfreeExt(tif, state);
+}
+
 /*
  * LZW Encoding.
  */
@@ -803,9 +1003,22 @@ LZWSetupEncode(TIFF* tif)
 	LZWCodecState* sp = EncoderState(tif);
 
 	assert(sp != NULL);
-	sp->enc_hashtab = (hash_t*) _TIFFmalloc(HSIZE*sizeof (hash_t));
+	if (sp->enc_mode == LZWENCODEMODE_FAST) {
+		if (sp->enc_fhashtab == NULL)
+			sp->enc_fhashtab = (fhash_t*) _TIFFmallocExt(tif,
+			    FHSIZE*sizeof (fhash_t));
+		if (sp->enc_fhashtab == NULL) {
+			TIFFErrorExtR(tif, module,
+				     "No space for LZW hash table");
+			return (0);
+		}
+		return (1);
+	}
+	if (sp->enc_hashtab == NULL)
+		sp->enc_hashtab = (hash_t*) _TIFFmallocExt(tif,
+		    HSIZE*sizeof (hash_t));
 	if (sp->enc_hashtab == NULL) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "No space for LZW hash table");
 		return (0);
 	}
@@ -823,9 +1036,12 @@ LZWPreEncode(TIFF* tif, uint16 s)
 	(void) s;
 	assert(sp != NULL);
 
-	if( sp->enc_hashtab == NULL )
+	sp->enc_fast = (sp->enc_mode == LZWENCODEMODE_FAST);
+	if( (sp->enc_fast ?
+	     (void*) sp->enc_fhashtab : (void*) sp->enc_hashtab) == NULL )
         {
-            tif->tif_setupencode( tif );
+            if( !tif->tif_setupencode( tif ) )
+                return (0);
         }
 
 	sp->lzw_nbits = BITS_MIN;
@@ -887,7 +1103,9 @@ LZWEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 {
 	register LZWCodecState *sp = EncoderState(tif);
 	register long fcode;
-	register hash_t *hp;
+	register hash_t *hp = NULL;
+	register fhash_t *fhp = NULL;
+	fhash_t *fhashtab;
 	register int h, c;
 	hcode_t ent;
 	long disp;
@@ -902,7 +1120,8 @@ LZWEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	if (sp == NULL)
 		return (0);
 
-        assert(sp->enc_hashtab != NULL);
+	fhashtab = sp->enc_fast ? sp->enc_fhashtab : NULL;
+        assert(sp->enc_hashtab != NULL || fhashtab != NULL);
 
 	/*
 	 * Load local state.
@@ -931,6 +1150,25 @@ LZWEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	while (cc > 0) {
 		c = *bp++; cc--; incount++;
 		fcode = ((long)c << BITS_MAX) + ent;
+		if (fhashtab) {
+			/*
+			 * Linear probing in a table small enough to stay
+			 * in cache; one compare tells a hit from a miss
+			 * once the slot is known to be used.
+			 */
+			fhash_t e, key = (fhash_t) fcode << BITS_MAX;
+
+			h = (int) FHASH(fcode);
+			while ((e = fhashtab[h]) != 0) {
+				if ((e & ~(fhash_t) CODE_MAX) == key) {
+					ent = (hcode_t) (e & CODE_MAX);
+					goto hit;
+				}
+				h = (h + 1) & (FHSIZE - 1);
+			}
+			fhp = &fhashtab[h];
+			goto miss;
+		}
 		h = (c << HSHIFT) ^ ent;	/* xor hashing */
 #ifdef _WINDOWS
 		/*
@@ -965,6 +1203,7 @@ LZWEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 				}
 			} while (hp->hash >= 0);
 		}
+	miss:
 		/*
 		 * New entry, emit code and add to table.
 		 */
@@ -982,8 +1221,12 @@ LZWEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 		}
 		PutNextCode(op, ent);
 		ent = (hcode_t)c;
-		hp->code = (hcode_t)(free_ent++);
-		hp->hash = fcode;
+		if (fhashtab)
+			*fhp = ((fhash_t) fcode << BITS_MAX) | (fhash_t) free_ent++;
+		else {
+			hp->code = (hcode_t)(free_ent++);
+			hp->hash = fcode;
+		}
 		if (free_ent == CODE_MAX-1) {
 			/* table is full, emit clear code and reset */
 			cl_hash(sp);
@@ -1103,9 +1346,14 @@ LZWPostEncode(TIFF* tif)
 static void
 cl_hash(LZWCodecState* sp)
 {
-	register hash_t *hp = &sp->enc_hashtab[HSIZE-1];
+	register hash_t *hp;
 	register long i = HSIZE-8;
 
+	if (sp->enc_fast) {
+		_TIFFmemset(sp->enc_fhashtab, 0, FHSIZE*sizeof (fhash_t));
+		return;
+	}
+	hp = &sp->enc_hashtab[HSIZE-1];
 	do {
 		i -= 8;
 		hp[-7].hash = -1;
@@ -1130,33 +1378,108 @@ LZWCleanup(TIFF* tif)
 	assert(tif->tif_data != 0);
 
 	if (DecoderState(tif)->dec_codetab)
-		_TIFFfree(DecoderState(tif)->dec_codetab);
+		_TIFFfreeExt(tif, DecoderState(tif)->dec_codetab);
 
 	if (EncoderState(tif)->enc_hashtab)
-		_TIFFfree(EncoderState(tif)->enc_hashtab);
+		_TIFFfreeExt(tif, EncoderState(tif)->enc_hashtab);
+
+	if (EncoderState(tif)->enc_fhashtab)
+		_TIFFfreeExt(tif, EncoderState(tif)->enc_fhashtab);
 
-	_TIFFfree(tif->tif_data);
+	if (EncoderState(tif)->vgetparent) {
+		tif->tif_tagmethods.vgetfield = EncoderState(tif)->vgetparent;
+		tif->tif_tagmethods.vsetfield = EncoderState(tif)->vsetparent;
+	}
+
+	_TIFFfreeExt(tif, tif->tif_data);
 	tif->tif_data = NULL;
 
 	_TIFFSetDefaultCompressionState(tif);
 }
 
+static int
+LZWVSetField(TIFF* tif, uint32 tag, va_list ap)
+{
+	static const char module[] = "LZWVSetField";
+	LZWCodecState* sp = EncoderState(tif);
+
+	switch (tag) {
+	case TIFFTAG_LZWENCODEMODE:
+		{
+			int mode = (int) va_arg(ap, int);
+
+			if (mode != LZWENCODEMODE_COMPAT &&
+			    mode != LZWENCODEMODE_FAST) {
+				TIFFErrorExtR(tif, module,
+				    "Unknown LZW encoding mode %d", mode);
+				return (0);
+			}
+			/* Takes effect from the next strip or tile */
+			sp->enc_mode = mode;
+		}
+		return (1);
+	default:
+		return (*sp->vsetparent)(tif, tag, ap);
+	}
+	/*NOTREACHED*/
+}
+
+static int
+LZWVGetField(TIFF* tif, uint32 tag, va_list ap)
+{
+	LZWCodecState* sp = EncoderState(tif);
+
+	switch (tag) {
+	case TIFFTAG_LZWENCODEMODE:
+		*va_arg(ap, int*) = sp->enc_mode;
+		break;
+	default:
+		return (*sp->vgetparent)(tif, tag, ap);
+	}
+	return (1);
+}
+
+static const TIFFField lzwFields[] = {
+    { TIFFTAG_LZWENCODEMODE, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, TRUE, FALSE, "", NULL },
+};
+
 int
 TIFFInitLZW(TIFF* tif, int scheme)
 {
 	static const char module[] = "TIFFInitLZW";
 	assert(scheme == COMPRESSION_LZW);
+
+	/*
+	 * Merge codec-specific tag information.
+	 */
+	if (!_TIFFMergeFields(tif, lzwFields, TIFFArrayCount(lzwFields))) {
+		TIFFErrorExtR(tif, module,
+			     "Merging LZW codec-specific tags failed");
+		return 0;
+	}
+
 	/*
 	 * Allocate state block so tag methods have storage to record values.
 	 */
-	tif->tif_data = (uint8*) _TIFFmalloc(sizeof (LZWCodecState));
+	tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof (LZWCodecState));
 	if (tif->tif_data == NULL)
 		goto bad;
 	DecoderState(tif)->dec_codetab = NULL;
 	DecoderState(tif)->dec_decode = NULL;
 	EncoderState(tif)->enc_hashtab = NULL;
+	EncoderState(tif)->enc_fhashtab = NULL;
+	EncoderState(tif)->enc_mode = LZWENCODEMODE_COMPAT;
+	EncoderState(tif)->enc_fast = 0;
         LZWState(tif)->rw_mode = tif->tif_mode;
 
+	/*
+	 * Override parent get/set field methods.
+	 */
+	EncoderState(tif)->vgetparent = tif->tif_tagmethods.vgetfield;
+	tif->tif_tagmethods.vgetfield = LZWVGetField; /* hook for codec tags */
+	EncoderState(tif)->vsetparent = tif->tif_tagmethods.vsetfield;
+	tif->tif_tagmethods.vsetfield = LZWVSetField; /* hook for codec tags */
+
 	/*
 	 * Install codec methods.
 	 */
@@ -1166,6 +1489,9 @@ TIFFInitLZW(TIFF* tif, int scheme)
 	tif->tif_decoderow = LZWDecode;
 	tif->tif_decodestrip = LZWDecode;
 	tif->tif_decodetile = LZWDecode;
+	tif->tif_savestate = LZWSaveState;
+	tif->tif_restorestate = LZWRestoreState;
+	tif->tif_freestate = LZWFreeState;
 	tif->tif_setupencode = LZWSetupEncode;
 	tif->tif_preencode = LZWPreEncode;
 	tif->tif_postencode = LZWPostEncode;
@@ -1177,9 +1503,10 @@ TIFFInitLZW(TIFF* tif, int scheme)
 	 * Setup predictor setup.
 	 */
 	(void) TIFFPredictorInit(tif);
+	LZWState(tif)->predict.batchdecode = 1;
 	return (1);
 bad:
-	TIFFErrorExt(tif->tif_clientdata, module, 
+	TIFFErrorExtR(tif, module, 
 		     "No space for LZW state block");
 	return (0);
 }
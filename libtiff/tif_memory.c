@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library.
+ *
+ * In-memory files.
+ *
+ * TIFFOpenMemory() opens a TIFF held in a buffer.  Read-only handles
+ * use the caller's buffer as the memory-mapped image of the file, so
+ * that strips and tiles are decoded from it without being copied.
+ * Other handles work on a private copy that grows geometrically as
+ * data are written; TIFFCloseMemory() hands it over to the caller.
+ */
+#include "tiffiop.h"
+
+#define TIFF_SIZE_T_MAX ((size_t) ~ ((size_t)0))
+#define TIFF_TMSIZE_T_MAX (tmsize_t)(TIFF_SIZE_T_MAX >> 1)
+
+typedef struct {
+	uint8*    base;        /* file contents */
+	tmsize_t  size;        /* length of the file */
+	tmsize_t  alloc;       /* bytes allocated at base, 0 if borrowed */
+	uint64    off;         /* current position */
+	void**    pbuf;        /* where TIFFCloseMemory() wants the buffer */
+	tmsize_t* psize;
+} TIFFMemFile;
+
+/*
+ * Make room for at least size bytes, doubling the allocation so that
+ * a file written in small pieces is copied a logarithmic number of
+ * times.
+ */
+static int
+_tiffMemGrow(TIFFMemFile* m, tmsize_t size)
+{
+	tmsize_t alloc = m->alloc > 0 ? m->alloc : 64 * 1024;
+	uint8* base;
+
+	while (alloc < size) {
+		if (alloc > TIFF_TMSIZE_T_MAX / 2) {
+			alloc = size;
+			break;
+		}
+		alloc *= 2;
+	}
+	base = (uint8*) _TIFFrealloc(m->base, alloc);
+	if (base == NULL)
+		return (0);
+	m->base = base;
+	m->alloc = alloc;
+	return (1);
+}
+
+static tmsize_t
+_tiffMemReadProc(thandle_t h, void* buf, tmsize_t size)
+{
+	TIFFMemFile* m = (TIFFMemFile*) h;
+	tmsize_t n;
+
+	if (size < 0)
+		return (-1);
+	if (m->off >= (uint64) m->size)
+		return (0);
+	n = m->size - (tmsize_t) m->off;
+	if (n > size)
+		n = size;
+	_TIFFmemcpy(buf, m->base + (tmsize_t) m->off, n);
+	m->off += (uint64) n;
+	return (n);
+}
+
+static tmsize_t
+_tiffMemReadAtProc(thandle_t h, void* buf, tmsize_t size, toff_t off)
+{
+	TIFFMemFile* m = (TIFFMemFile*) h;
+	tmsize_t n;
+
+	if (size < 0)
+		return (-1);
+	if (off >= (uint64) m->size)
+		return (0);
+	n = m->size - (tmsize_t) off;
+	if (n > size)
+		n = size;
+	_TIFFmemcpy(buf, m->base + (tmsize_t) off, n);
+	return (n);
+}
+
+static tmsize_t
+_tiffMemWriteProc(thandle_t h, void* buf, tmsize_t size)
+{
+	TIFFMemFile* m = (TIFFMemFile*) h;
+	tmsize_t end;
+
+	if (m->alloc == 0 || size < 0 ||
+	    m->off > (uint64) (TIFF_TMSIZE_T_MAX - size))
+		return (-1);
+	end = (tmsize_t) m->off + size;
+	if (end > m->alloc && !_tiffMemGrow(m, end))
+		return (-1);
+	/* a write past the end leaves a hole of zeroes */
+	if ((tmsize_t) m->off > m->size)
+		_TIFFmemset(m->base + m->size, 0, (tmsize_t) m->off - m->size);
+	_TIFFmemcpy(m->base + (tmsize_t) m->off, buf, size);
+	m->off = (uint64) end;
+	if (end > m->size)
+		m->size = end;
+	return (size);
+}
+
+static toff_t
+_tiffMemSeekProc(thandle_t h, toff_t off, int whence)
+{
+	TIFFMemFile* m = (TIFFMemFile*) h;
+	uint64 base;
+
+	switch (whence) {
+	case SEEK_SET:
+		base = 0;
+		break;
+	case SEEK_CUR:
+		base = m->off;
+		break;
+	case SEEK_END:
+		base = (uint64) m->size;
+		break;
+	default:
+		return ((toff_t) -1);
+	}
+	/* offsets are signed for SEEK_CUR and SEEK_END */
+	if ((int64) off < 0 && (uint64) -(int64) off > base)
+		return ((toff_t) -1);
+	m->off = base + off;
+	return (m->off);
+}
+
+static int
+_tiffMemCloseProc(thandle_t h)
+{
+	TIFFMemFile* m = (TIFFMemFile*) h;
+
+	if (m->pbuf != NULL) {
+		*m->pbuf = m->base;
+		if (m->psize != NULL)
+			*m->psize = m->size;
+	} else if (m->alloc != 0)
+		_TIFFfree(m->base);
+	_TIFFfree(m);
+	return (0);
+}
+
+static toff_t
+_tiffMemSizeProc(thandle_t h)
+{
+	return ((toff_t) ((TIFFMemFile*) h)->size);
+}
+
+static int
+_tiffMemMapProc(thandle_t h, void** pbase, toff_t* psize)
+{
+	TIFFMemFile* m = (TIFFMemFile*) h;
+
+	*pbase = m->base;
+	*psize = (toff_t) m->size;
+	return (1);
+}
+
+static void
+_tiffMemUnmapProc(thandle_t h, void* base, toff_t size)
+{
+	(void) h; (void) base; (void) size;
+}
+
+/*
+ * Open the size bytes at buf as a TIFF file.  In read-only mode the
+ * buffer is used in place and must stay untouched until the handle is
+ * closed.  In the other modes the contents are copied (a new file is
+ * empty, whatever buf holds) and buf may be NULL.
+ */
+TIFF*
+TIFFOpenMemory(void* buf, tmsize_t size, const char* mode)
+{
+	return (TIFFOpenMemoryExt(buf, size, mode, NULL));
+}
+
+TIFF*
+TIFFOpenMemoryExt(void* buf, tmsize_t size, const char* mode,
+    TIFFOpenOptions* opts)
+{
+	static const char module[] = "TIFFOpenMemory";
+	TIFFMemFile* m;
+	TIFF* tif;
+	int om;
+
+	om = _TIFFgetMode(mode, module);
+	if (om == -1)
+		return ((TIFF*)0);
+	if (size < 0 || (buf == NULL && size != 0) ||
+	    (buf == NULL && om == O_RDONLY)) {
+		TIFFErrorExt(0, module, "Invalid memory buffer");
+		return ((TIFF*)0);
+	}
+	m = (TIFFMemFile*) _TIFFmalloc(sizeof (TIFFMemFile));
+	if (m == NULL) {
+		TIFFErrorExt(0, module, "Out of memory");
+		return ((TIFF*)0);
+	}
+	_TIFFmemset(m, 0, sizeof (TIFFMemFile));
+	if (om == O_RDONLY) {
+		m->base = (uint8*) buf;
+		m->size = size;
+	} else {
+		if (om & O_TRUNC)
+			size = 0;
+		if (!_tiffMemGrow(m, size)) {
+			TIFFErrorExt(0, module, "Out of memory");
+			_TIFFfree(m);
+			return ((TIFF*)0);
+		}
+		if (size > 0)
+			_TIFFmemcpy(m->base, buf, size);
+		m->size = size;
+	}
+	tif = TIFFClientOpenExt("MemoryFile", mode, (thandle_t) m,
+	    _tiffMemReadProc, _tiffMemWriteProc,
+	    _tiffMemSeekProc, _tiffMemCloseProc, _tiffMemSizeProc,
+	    _tiffMemMapProc, _tiffMemUnmapProc, opts);
+	if (tif == NULL) {
+		if (m->alloc != 0)
+			_TIFFfree(m->base);
+		_TIFFfree(m);
+		return ((TIFF*)0);
+	}
+	tif->tif_readatproc = _tiffMemReadAtProc;
+	return (tif);
+}
+
+/*
+ * Close a handle opened by TIFFOpenMemory(), storing the file in
+ * *pbuf and its length in *psize.  Unless the handle was read-only,
+ * the buffer now belongs to the caller, who releases it with
+ * _TIFFfree().
+ */
+int
+TIFFCloseMemory(TIFF* tif, void** pbuf, tmsize_t* psize)
+{
+	static const char module[] = "TIFFCloseMemory";
+	TIFFMemFile* m;
+
+	if (tif->tif_closeproc != _tiffMemCloseProc) {
+		TIFFErrorExtR(tif, module,
+		    "%s: Not an in-memory file", tif->tif_name);
+		TIFFClose(tif);
+		return (0);
+	}
+	m = (TIFFMemFile*) tif->tif_clientdata;
+	m->pbuf = pbuf;
+	m->psize = psize;
+	TIFFClose(tif);
+	return (1);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
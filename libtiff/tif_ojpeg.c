@@ -115,7 +115,10 @@
    reason for much of the complicated restart-and-position stuff inside OJPEGPreDecode.
    Applications would do well accessing all striles in order, as this will result in
    a single sequential scan of the input stream, and no restarting of LibJpeg decoding
-   session.
+   session. The exception is the usual case of each strile being a restart interval
+   of its own, with the compressed data read from the striles: then a LibJpeg session
+   can be started at any strile, see OJPEGPreDecodeStartAtStrile, and strile offsets
+   serve as the index of the restart points.
 */
 
 #define WIN32_LEAN_AND_MEAN
@@ -278,6 +281,7 @@ typedef struct {
 	uint8* actable[4];
 	uint16 restart_interval;
 	uint8 restart_index;
+	uint8 restart_at_strile;  /* every strile is one restart interval, decoding may start at any */
 	uint8 sof_log;
 	uint8 sof_marker_id;
 	uint32 sof_x;
@@ -342,6 +346,7 @@ static void OJPEGPrintDir(TIFF* tif, FILE* fd, long flags);
 static int OJPEGFixupTags(TIFF* tif);
 static int OJPEGSetupDecode(TIFF* tif);
 static int OJPEGPreDecode(TIFF* tif, uint16 s);
+static int OJPEGPreDecodeStartAtStrile(TIFF* tif, uint16 s, uint32 m);
 static int OJPEGPreDecodeSkipRaw(TIFF* tif);
 static int OJPEGPreDecodeSkipScanlines(TIFF* tif);
 static int OJPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s);
@@ -426,16 +431,16 @@ TIFFInitOJPEG(TIFF* tif, int scheme)
 	 * Merge codec-specific tag information.
 	 */
 	if (!_TIFFMergeFields(tif, ojpegFields, TIFFArrayCount(ojpegFields))) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Merging Old JPEG codec-specific tags failed");
 		return 0;
 	}
 
 	/* state block */
-	sp=_TIFFmalloc(sizeof(OJPEGState));
+	sp=_TIFFmallocExt(tif, sizeof(OJPEGState));
 	if (sp==NULL)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"No space for OJPEG state block");
+		TIFFErrorExtR(tif,module,"No space for OJPEG state block");
 		return(0);
 	}
 	_TIFFmemset(sp,0,sizeof(OJPEGState));
@@ -550,7 +555,7 @@ OJPEGVSetField(TIFF* tif, uint32 tag, va_list ap)
 			{
 				if (ma>3)
 				{
-					TIFFErrorExt(tif->tif_clientdata,module,"JpegQTables tag has incorrect count");
+					TIFFErrorExtR(tif,module,"JpegQTables tag has incorrect count");
 					return(0);
 				}
 				sp->qtable_offset_count=(uint8)ma;
@@ -565,7 +570,7 @@ OJPEGVSetField(TIFF* tif, uint32 tag, va_list ap)
 			{
 				if (ma>3)
 				{
-					TIFFErrorExt(tif->tif_clientdata,module,"JpegDcTables tag has incorrect count");
+					TIFFErrorExtR(tif,module,"JpegDcTables tag has incorrect count");
 					return(0);
 				}
 				sp->dctable_offset_count=(uint8)ma;
@@ -580,7 +585,7 @@ OJPEGVSetField(TIFF* tif, uint32 tag, va_list ap)
 			{
 				if (ma>3)
 				{
-					TIFFErrorExt(tif->tif_clientdata,module,"JpegAcTables tag has incorrect count");
+					TIFFErrorExtR(tif,module,"JpegAcTables tag has incorrect count");
 					return(0);
 				}
 				sp->actable_offset_count=(uint8)ma;
@@ -657,7 +662,7 @@ static int
 OJPEGSetupDecode(TIFF* tif)
 {
 	static const char module[]="OJPEGSetupDecode";
-	TIFFWarningExt(tif->tif_clientdata,module,"Depreciated and troublesome old-style JPEG compression mode, please convert to new-style JPEG compression and notify vendor of writing software");
+	TIFFWarningExtR(tif,module,"Depreciated and troublesome old-style JPEG compression mode, please convert to new-style JPEG compression and notify vendor of writing software");
 	return(1);
 }
 
@@ -688,6 +693,24 @@ OJPEGPreDecode(TIFF* tif, uint16 s)
 			OJPEGLibjpegSessionAbort(tif);
 		sp->writeheader_done=0;
 	}
+	if (((sp->writeheader_done==0) || (sp->write_curstrile<m)) &&
+	    (OJPEGPreDecodeStartAtStrile(tif,s,m)!=0))
+	{
+		/* a new session reads the strile's data right after the header */
+		if (sp->libjpeg_session_active!=0)
+			OJPEGLibjpegSessionAbort(tif);
+		sp->plane_sample_offset=(uint8)s;
+		sp->write_cursample=s;
+		sp->write_curstrile=m;
+		sp->in_buffer_source=osibsStrile;
+		sp->in_buffer_next_strile=m;
+		sp->in_buffer_file_pos_log=0;
+		sp->in_buffer_file_togo=0;
+		sp->in_buffer_togo=0;
+		sp->in_buffer_cur=0;
+		if (OJPEGWriteHeaderInfo(tif)==0)
+			return(0);
+	}
 	if (sp->writeheader_done==0)
 	{
 		sp->plane_sample_offset=(uint8)s;
@@ -725,6 +748,28 @@ OJPEGPreDecode(TIFF* tif, uint16 s)
 	return(1);
 }
 
+/* Striles that start a restart interval of their own, of a plane whose data
+   is read from the striles, can be decoded without decoding the striles before
+   them: the header is composed again and followed by the data of the strile.
+   Random access then no longer means decoding from the start of the plane. */
+static int
+OJPEGPreDecodeStartAtStrile(TIFF* tif, uint16 s, uint32 m)
+{
+	OJPEGState* sp=(OJPEGState*)tif->tif_data;
+	uint64 offset;
+	if (sp->restart_at_strile==0)
+		return(0);
+	if ((m<=s*tif->tif_dir.td_stripsperimage) || (m<sp->sos_end[s].in_buffer_next_strile) || (m>=sp->in_buffer_strile_count))
+		return(0);
+	if ((sp->sos_end[s].in_buffer_source!=osibsStrile) &&
+	    ((sp->sos_end[s].in_buffer_source!=osibsJpegInterchangeFormat) || (sp->sos_end[s].in_buffer_file_togo!=0)))
+		return(0);
+	offset=TIFFGetStrileOffset(tif,m);
+	if ((offset==0) || (offset>=sp->file_size) || (TIFFGetStrileByteCount(tif,m)==0))
+		return(0);
+	return(1);
+}
+
 static int
 OJPEGPreDecodeSkipRaw(TIFF* tif)
 {
@@ -766,10 +811,10 @@ OJPEGPreDecodeSkipScanlines(TIFF* tif)
 	uint32 m;
 	if (sp->skip_buffer==NULL)
 	{
-		sp->skip_buffer=_TIFFmalloc(sp->bytes_per_line);
+		sp->skip_buffer=_TIFFmallocExt(tif, sp->bytes_per_line);
 		if (sp->skip_buffer==NULL)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+			TIFFErrorExtR(tif,module,"Out of memory");
 			return(0);
 		}
 	}
@@ -789,7 +834,7 @@ OJPEGDecode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 	(void)s;
         if( !sp->decoder_ok )
         {
-            TIFFErrorExt(tif->tif_clientdata,module,"Cannot decode: decoder not correctly initialized");
+            TIFFErrorExtR(tif,module,"Cannot decode: decoder not correctly initialized");
             return 0;
         }
 	if (sp->libjpeg_jpeg_query_style==0)
@@ -821,7 +866,7 @@ OJPEGDecodeRaw(TIFF* tif, uint8* buf, tmsize_t cc)
 	uint8 sx,sy;
 	if (cc%sp->bytes_per_line!=0)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Fractional scanline not read");
+		TIFFErrorExtR(tif,module,"Fractional scanline not read");
 		return(0);
 	}
 	assert(cc>0);
@@ -869,7 +914,7 @@ OJPEGDecodeScanlines(TIFF* tif, uint8* buf, tmsize_t cc)
 	tmsize_t n;
 	if (cc%sp->bytes_per_line!=0)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Fractional scanline not read");
+		TIFFErrorExtR(tif,module,"Fractional scanline not read");
 		return(0);
 	}
 	assert(cc>0);
@@ -904,7 +949,7 @@ static int
 OJPEGSetupEncode(TIFF* tif)
 {
 	static const char module[]="OJPEGSetupEncode";
-	TIFFErrorExt(tif->tif_clientdata,module,"OJPEG encoding not supported; use new-style JPEG compression instead");
+	TIFFErrorExtR(tif,module,"OJPEG encoding not supported; use new-style JPEG compression instead");
 	return(0);
 }
 
@@ -913,7 +958,7 @@ OJPEGPreEncode(TIFF* tif, uint16 s)
 {
 	static const char module[]="OJPEGPreEncode";
 	(void)s;
-	TIFFErrorExt(tif->tif_clientdata,module,"OJPEG encoding not supported; use new-style JPEG compression instead");
+	TIFFErrorExtR(tif,module,"OJPEG encoding not supported; use new-style JPEG compression instead");
 	return(0);
 }
 
@@ -924,7 +969,7 @@ OJPEGEncode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 	(void)buf;
 	(void)cc;
 	(void)s;
-	TIFFErrorExt(tif->tif_clientdata,module,"OJPEG encoding not supported; use new-style JPEG compression instead");
+	TIFFErrorExtR(tif,module,"OJPEG encoding not supported; use new-style JPEG compression instead");
 	return(0);
 }
 
@@ -932,7 +977,7 @@ static int
 OJPEGPostEncode(TIFF* tif)
 {
 	static const char module[]="OJPEGPostEncode";
-	TIFFErrorExt(tif->tif_clientdata,module,"OJPEG encoding not supported; use new-style JPEG compression instead");
+	TIFFErrorExtR(tif,module,"OJPEG encoding not supported; use new-style JPEG compression instead");
 	return(0);
 }
 
@@ -946,38 +991,38 @@ OJPEGCleanup(TIFF* tif)
 		tif->tif_tagmethods.vsetfield=sp->vsetparent;
 		tif->tif_tagmethods.printdir=sp->printdir;
 		if (sp->qtable[0]!=0)
-			_TIFFfree(sp->qtable[0]);
+			_TIFFfreeExt(tif, sp->qtable[0]);
 		if (sp->qtable[1]!=0)
-			_TIFFfree(sp->qtable[1]);
+			_TIFFfreeExt(tif, sp->qtable[1]);
 		if (sp->qtable[2]!=0)
-			_TIFFfree(sp->qtable[2]);
+			_TIFFfreeExt(tif, sp->qtable[2]);
 		if (sp->qtable[3]!=0)
-			_TIFFfree(sp->qtable[3]);
+			_TIFFfreeExt(tif, sp->qtable[3]);
 		if (sp->dctable[0]!=0)
-			_TIFFfree(sp->dctable[0]);
+			_TIFFfreeExt(tif, sp->dctable[0]);
 		if (sp->dctable[1]!=0)
-			_TIFFfree(sp->dctable[1]);
+			_TIFFfreeExt(tif, sp->dctable[1]);
 		if (sp->dctable[2]!=0)
-			_TIFFfree(sp->dctable[2]);
+			_TIFFfreeExt(tif, sp->dctable[2]);
 		if (sp->dctable[3]!=0)
-			_TIFFfree(sp->dctable[3]);
+			_TIFFfreeExt(tif, sp->dctable[3]);
 		if (sp->actable[0]!=0)
-			_TIFFfree(sp->actable[0]);
+			_TIFFfreeExt(tif, sp->actable[0]);
 		if (sp->actable[1]!=0)
-			_TIFFfree(sp->actable[1]);
+			_TIFFfreeExt(tif, sp->actable[1]);
 		if (sp->actable[2]!=0)
-			_TIFFfree(sp->actable[2]);
+			_TIFFfreeExt(tif, sp->actable[2]);
 		if (sp->actable[3]!=0)
-			_TIFFfree(sp->actable[3]);
+			_TIFFfreeExt(tif, sp->actable[3]);
 		if (sp->libjpeg_session_active!=0)
 			OJPEGLibjpegSessionAbort(tif);
 		if (sp->subsampling_convert_ycbcrbuf!=0)
-			_TIFFfree(sp->subsampling_convert_ycbcrbuf);
+			_TIFFfreeExt(tif, sp->subsampling_convert_ycbcrbuf);
 		if (sp->subsampling_convert_ycbcrimage!=0)
-			_TIFFfree(sp->subsampling_convert_ycbcrimage);
+			_TIFFfreeExt(tif, sp->subsampling_convert_ycbcrimage);
 		if (sp->skip_buffer!=0)
-			_TIFFfree(sp->skip_buffer);
-		_TIFFfree(sp);
+			_TIFFfreeExt(tif, sp->skip_buffer);
+		_TIFFfreeExt(tif, sp);
 		tif->tif_data=NULL;
 		_TIFFSetDefaultCompressionState(tif);
 	}
@@ -997,7 +1042,7 @@ OJPEGSubsamplingCorrect(TIFF* tif)
 	    (tif->tif_dir.td_photometric!=PHOTOMETRIC_ITULAB)))
 	{
 		if (sp->subsampling_tag!=0)
-			TIFFWarningExt(tif->tif_clientdata,module,"Subsampling tag not appropriate for this Photometric and/or SamplesPerPixel");
+			TIFFWarningExtR(tif,module,"Subsampling tag not appropriate for this Photometric and/or SamplesPerPixel");
 		sp->subsampling_hor=1;
 		sp->subsampling_ver=1;
 		sp->subsampling_force_desubsampling_inside_decompression=0;
@@ -1018,21 +1063,21 @@ OJPEGSubsamplingCorrect(TIFF* tif)
 		if (((sp->subsampling_hor!=mh) || (sp->subsampling_ver!=mv)) && (sp->subsampling_force_desubsampling_inside_decompression==0))
 		{
 			if (sp->subsampling_tag==0)
-				TIFFWarningExt(tif->tif_clientdata,module,"Subsampling tag is not set, yet subsampling inside JPEG data [%d,%d] does not match default values [2,2]; assuming subsampling inside JPEG data is correct",sp->subsampling_hor,sp->subsampling_ver);
+				TIFFWarningExtR(tif,module,"Subsampling tag is not set, yet subsampling inside JPEG data [%d,%d] does not match default values [2,2]; assuming subsampling inside JPEG data is correct",sp->subsampling_hor,sp->subsampling_ver);
 			else
-				TIFFWarningExt(tif->tif_clientdata,module,"Subsampling inside JPEG data [%d,%d] does not match subsampling tag values [%d,%d]; assuming subsampling inside JPEG data is correct",sp->subsampling_hor,sp->subsampling_ver,mh,mv);
+				TIFFWarningExtR(tif,module,"Subsampling inside JPEG data [%d,%d] does not match subsampling tag values [%d,%d]; assuming subsampling inside JPEG data is correct",sp->subsampling_hor,sp->subsampling_ver,mh,mv);
 		}
 		if (sp->subsampling_force_desubsampling_inside_decompression!=0)
 		{
 			if (sp->subsampling_tag==0)
-				TIFFWarningExt(tif->tif_clientdata,module,"Subsampling tag is not set, yet subsampling inside JPEG data does not match default values [2,2] (nor any other values allowed in TIFF); assuming subsampling inside JPEG data is correct and desubsampling inside JPEG decompression");
+				TIFFWarningExtR(tif,module,"Subsampling tag is not set, yet subsampling inside JPEG data does not match default values [2,2] (nor any other values allowed in TIFF); assuming subsampling inside JPEG data is correct and desubsampling inside JPEG decompression");
 			else
-				TIFFWarningExt(tif->tif_clientdata,module,"Subsampling inside JPEG data does not match subsampling tag values [%d,%d] (nor any other values allowed in TIFF); assuming subsampling inside JPEG data is correct and desubsampling inside JPEG decompression",mh,mv);
+				TIFFWarningExtR(tif,module,"Subsampling inside JPEG data does not match subsampling tag values [%d,%d] (nor any other values allowed in TIFF); assuming subsampling inside JPEG data is correct and desubsampling inside JPEG decompression",mh,mv);
 		}
 		if (sp->subsampling_force_desubsampling_inside_decompression==0)
 		{
 			if (sp->subsampling_hor<sp->subsampling_ver)
-				TIFFWarningExt(tif->tif_clientdata,module,"Subsampling values [%d,%d] are not allowed in TIFF",sp->subsampling_hor,sp->subsampling_ver);
+				TIFFWarningExtR(tif,module,"Subsampling values [%d,%d] are not allowed in TIFF",sp->subsampling_hor,sp->subsampling_ver);
 		}
 	}
 	sp->subsamplingcorrect_done=1;
@@ -1070,7 +1115,7 @@ OJPEGReadHeaderInfo(TIFF* tif)
 	{
 		if (tif->tif_dir.td_samplesperpixel!=3)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"SamplesPerPixel %d not supported for this compression scheme",sp->samples_per_pixel);
+			TIFFErrorExtR(tif,module,"SamplesPerPixel %d not supported for this compression scheme",sp->samples_per_pixel);
 			return(0);
 		}
 		sp->samples_per_pixel=3;
@@ -1084,13 +1129,15 @@ OJPEGReadHeaderInfo(TIFF* tif)
 	{
 		if (sp->strile_length%(sp->subsampling_ver*8)!=0)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Incompatible vertical subsampling and image strip/tile length");
+			TIFFErrorExtR(tif,module,"Incompatible vertical subsampling and image strip/tile length");
 			return(0);
 		}
 		sp->restart_interval=(uint16)(((sp->strile_width+sp->subsampling_hor*8-1)/(sp->subsampling_hor*8))*(sp->strile_length/(sp->subsampling_ver*8)));
 	}
 	if (OJPEGReadHeaderInfoSec(tif)==0)
 		return(0);
+	if ((sp->strile_length<sp->image_length) && (sp->restart_interval==(uint16)(((sp->strile_width+sp->subsampling_hor*8-1)/(sp->subsampling_hor*8))*(sp->strile_length/(sp->subsampling_ver*8)))))
+		sp->restart_at_strile=1;
 	sp->sos_end[0].log=1;
 	sp->sos_end[0].in_buffer_source=sp->in_buffer_source;
 	sp->sos_end[0].in_buffer_next_strile=sp->in_buffer_next_strile;
@@ -1162,6 +1209,8 @@ OJPEGWriteHeaderInfo(TIFF* tif)
 		return 0;
 	sp->out_state=ososSoi;
 	sp->restart_index=0;
+	/* a session abandoned inside a partial strile may have left lines */
+	sp->subsampling_convert_state=0;
 	jpeg_std_error(&(sp->libjpeg_jpeg_error_mgr));
 	sp->libjpeg_jpeg_error_mgr.output_message=OJPEGLibjpegJpegErrorMgrOutputMessage;
 	sp->libjpeg_jpeg_error_mgr.error_exit=OJPEGLibjpegJpegErrorMgrErrorExit;
@@ -1197,20 +1246,20 @@ OJPEGWriteHeaderInfo(TIFF* tif)
 			sp->subsampling_convert_ybuflen=sp->subsampling_convert_ylinelen*sp->subsampling_convert_ylines;
 			sp->subsampling_convert_cbuflen=sp->subsampling_convert_clinelen*sp->subsampling_convert_clines;
 			sp->subsampling_convert_ycbcrbuflen=sp->subsampling_convert_ybuflen+2*sp->subsampling_convert_cbuflen;
-			sp->subsampling_convert_ycbcrbuf=_TIFFmalloc(sp->subsampling_convert_ycbcrbuflen);
+			sp->subsampling_convert_ycbcrbuf=_TIFFmallocExt(tif, sp->subsampling_convert_ycbcrbuflen);
 			if (sp->subsampling_convert_ycbcrbuf==0)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+				TIFFErrorExtR(tif,module,"Out of memory");
 				return(0);
 			}
 			sp->subsampling_convert_ybuf=sp->subsampling_convert_ycbcrbuf;
 			sp->subsampling_convert_cbbuf=sp->subsampling_convert_ybuf+sp->subsampling_convert_ybuflen;
 			sp->subsampling_convert_crbuf=sp->subsampling_convert_cbbuf+sp->subsampling_convert_cbuflen;
 			sp->subsampling_convert_ycbcrimagelen=3+sp->subsampling_convert_ylines+2*sp->subsampling_convert_clines;
-			sp->subsampling_convert_ycbcrimage=_TIFFmalloc(sp->subsampling_convert_ycbcrimagelen*sizeof(uint8*));
+			sp->subsampling_convert_ycbcrimage=_TIFFmallocExt(tif, sp->subsampling_convert_ycbcrimagelen*sizeof(uint8*));
 			if (sp->subsampling_convert_ycbcrimage==0)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+				TIFFErrorExtR(tif,module,"Out of memory");
 				return(0);
 			}
 			m=sp->subsampling_convert_ycbcrimage;
@@ -1321,7 +1370,7 @@ OJPEGReadHeaderInfoSec(TIFF* tif)
 				if (n<2)
 				{
 					if (sp->subsamplingcorrect==0)
-						TIFFErrorExt(tif->tif_clientdata,module,"Corrupt JPEG data");
+						TIFFErrorExtR(tif,module,"Corrupt JPEG data");
 					return(0);
 				}
 				if (n>2)
@@ -1355,7 +1404,7 @@ OJPEGReadHeaderInfoSec(TIFF* tif)
 					return(0);
 				break;
 			default:
-				TIFFErrorExt(tif->tif_clientdata,module,"Unknown marker type %d in JPEG data",m);
+				TIFFErrorExtR(tif,module,"Unknown marker type %d in JPEG data",m);
 				return(0);
 		}
 	} while(m!=JPEG_MARKER_SOS);
@@ -1396,7 +1445,7 @@ OJPEGReadHeaderInfoSecStreamDri(TIFF* tif)
 		return(0);
 	if (m!=4)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Corrupt DRI marker in JPEG data");
+		TIFFErrorExtR(tif,module,"Corrupt DRI marker in JPEG data");
 		return(0);
 	}
 	if (OJPEGReadWord(sp,&m)==0)
@@ -1420,7 +1469,7 @@ OJPEGReadHeaderInfoSecStreamDqt(TIFF* tif)
 	if (m<=2)
 	{
 		if (sp->subsamplingcorrect==0)
-			TIFFErrorExt(tif->tif_clientdata,module,"Corrupt DQT marker in JPEG data");
+			TIFFErrorExtR(tif,module,"Corrupt DQT marker in JPEG data");
 		return(0);
 	}
 	if (sp->subsamplingcorrect!=0)
@@ -1432,14 +1481,14 @@ OJPEGReadHeaderInfoSecStreamDqt(TIFF* tif)
 		{
 			if (m<65)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Corrupt DQT marker in JPEG data");
+				TIFFErrorExtR(tif,module,"Corrupt DQT marker in JPEG data");
 				return(0);
 			}
 			na=sizeof(uint32)+69;
-			nb=_TIFFmalloc(na);
+			nb=_TIFFmallocExt(tif, na);
 			if (nb==0)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+				TIFFErrorExtR(tif,module,"Out of memory");
 				return(0);
 			}
 			*(uint32*)nb=na;
@@ -1448,18 +1497,18 @@ OJPEGReadHeaderInfoSecStreamDqt(TIFF* tif)
 			nb[sizeof(uint32)+2]=0;
 			nb[sizeof(uint32)+3]=67;
 			if (OJPEGReadBlock(sp,65,&nb[sizeof(uint32)+4])==0) {
-				_TIFFfree(nb);
+				_TIFFfreeExt(tif, nb);
 				return(0);
 			}
 			o=nb[sizeof(uint32)+4]&15;
 			if (3<o)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Corrupt DQT marker in JPEG data");
-				_TIFFfree(nb);
+				TIFFErrorExtR(tif,module,"Corrupt DQT marker in JPEG data");
+				_TIFFfreeExt(tif, nb);
 				return(0);
 			}
 			if (sp->qtable[o]!=0)
-				_TIFFfree(sp->qtable[o]);
+				_TIFFfreeExt(tif, sp->qtable[o]);
 			sp->qtable[o]=nb;
 			m-=65;
 		} while(m>0);
@@ -1483,7 +1532,7 @@ OJPEGReadHeaderInfoSecStreamDht(TIFF* tif)
 	if (m<=2)
 	{
 		if (sp->subsamplingcorrect==0)
-			TIFFErrorExt(tif->tif_clientdata,module,"Corrupt DHT marker in JPEG data");
+			TIFFErrorExtR(tif,module,"Corrupt DHT marker in JPEG data");
 		return(0);
 	}
 	if (sp->subsamplingcorrect!=0)
@@ -1493,10 +1542,10 @@ OJPEGReadHeaderInfoSecStreamDht(TIFF* tif)
 	else
 	{
 		na=sizeof(uint32)+2+m;
-		nb=_TIFFmalloc(na);
+		nb=_TIFFmallocExt(tif, na);
 		if (nb==0)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+			TIFFErrorExtR(tif,module,"Out of memory");
 			return(0);
 		}
 		*(uint32*)nb=na;
@@ -1505,7 +1554,7 @@ OJPEGReadHeaderInfoSecStreamDht(TIFF* tif)
 		nb[sizeof(uint32)+2]=(m>>8);
 		nb[sizeof(uint32)+3]=(m&255);
 		if (OJPEGReadBlock(sp,m-2,&nb[sizeof(uint32)+4])==0) {
-                        _TIFFfree(nb);
+                        _TIFFfreeExt(tif, nb);
 			return(0);
                 }
 		o=nb[sizeof(uint32)+4];
@@ -1513,31 +1562,31 @@ OJPEGReadHeaderInfoSecStreamDht(TIFF* tif)
 		{
 			if (3<o)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Corrupt DHT marker in JPEG data");
-                                _TIFFfree(nb);
+				TIFFErrorExtR(tif,module,"Corrupt DHT marker in JPEG data");
+                                _TIFFfreeExt(tif, nb);
 				return(0);
 			}
 			if (sp->dctable[o]!=0)
-				_TIFFfree(sp->dctable[o]);
+				_TIFFfreeExt(tif, sp->dctable[o]);
 			sp->dctable[o]=nb;
 		}
 		else
 		{
 			if ((o&240)!=16)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Corrupt DHT marker in JPEG data");
-                                _TIFFfree(nb);
+				TIFFErrorExtR(tif,module,"Corrupt DHT marker in JPEG data");
+                                _TIFFfreeExt(tif, nb);
 				return(0);
 			}
 			o&=15;
 			if (3<o)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Corrupt DHT marker in JPEG data");
-                                _TIFFfree(nb);
+				TIFFErrorExtR(tif,module,"Corrupt DHT marker in JPEG data");
+                                _TIFFfreeExt(tif, nb);
 				return(0);
 			}
 			if (sp->actable[o]!=0)
-				_TIFFfree(sp->actable[o]);
+				_TIFFfreeExt(tif, sp->actable[o]);
 			sp->actable[o]=nb;
 		}
 	}
@@ -1557,7 +1606,7 @@ OJPEGReadHeaderInfoSecStreamSof(TIFF* tif, uint8 marker_id)
 	uint16 q;
 	if (sp->sof_log!=0)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Corrupt JPEG data");
+		TIFFErrorExtR(tif,module,"Corrupt JPEG data");
 		return(0);
 	}
 	if (sp->subsamplingcorrect==0)
@@ -1568,14 +1617,14 @@ OJPEGReadHeaderInfoSecStreamSof(TIFF* tif, uint8 marker_id)
 	if (m<11)
 	{
 		if (sp->subsamplingcorrect==0)
-			TIFFErrorExt(tif->tif_clientdata,module,"Corrupt SOF marker in JPEG data");
+			TIFFErrorExtR(tif,module,"Corrupt SOF marker in JPEG data");
 		return(0);
 	}
 	m-=8;
 	if (m%3!=0)
 	{
 		if (sp->subsamplingcorrect==0)
-			TIFFErrorExt(tif->tif_clientdata,module,"Corrupt SOF marker in JPEG data");
+			TIFFErrorExtR(tif,module,"Corrupt SOF marker in JPEG data");
 		return(0);
 	}
 	n=m/3;
@@ -1583,7 +1632,7 @@ OJPEGReadHeaderInfoSecStreamSof(TIFF* tif, uint8 marker_id)
 	{
 		if (n!=sp->samples_per_pixel)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"JPEG compressed data indicates unexpected number of samples");
+			TIFFErrorExtR(tif,module,"JPEG compressed data indicates unexpected number of samples");
 			return(0);
 		}
 	}
@@ -1593,7 +1642,7 @@ OJPEGReadHeaderInfoSecStreamSof(TIFF* tif, uint8 marker_id)
 	if (o!=8)
 	{
 		if (sp->subsamplingcorrect==0)
-			TIFFErrorExt(tif->tif_clientdata,module,"JPEG compressed data indicates unexpected number of bits per sample");
+			TIFFErrorExtR(tif,module,"JPEG compressed data indicates unexpected number of bits per sample");
 		return(0);
 	}
 	/* Y: Number of lines, X: Number of samples per line */
@@ -1606,7 +1655,7 @@ OJPEGReadHeaderInfoSecStreamSof(TIFF* tif, uint8 marker_id)
 			return(0);
 		if (((uint32)p<sp->image_length) && ((uint32)p<sp->strile_length_total))
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"JPEG compressed data indicates unexpected height");
+			TIFFErrorExtR(tif,module,"JPEG compressed data indicates unexpected height");
 			return(0);
 		}
 		sp->sof_y=p;
@@ -1615,12 +1664,12 @@ OJPEGReadHeaderInfoSecStreamSof(TIFF* tif, uint8 marker_id)
 			return(0);
 		if (((uint32)p<sp->image_width) && ((uint32)p<sp->strile_width))
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"JPEG compressed data indicates unexpected width");
+			TIFFErrorExtR(tif,module,"JPEG compressed data indicates unexpected width");
 			return(0);
 		}
 		if ((uint32)p>sp->strile_width)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"JPEG compressed data image width exceeds expected image width");
+			TIFFErrorExtR(tif,module,"JPEG compressed data image width exceeds expected image width");
 			return(0);
 		}
 		sp->sof_x=p;
@@ -1631,7 +1680,7 @@ OJPEGReadHeaderInfoSecStreamSof(TIFF* tif, uint8 marker_id)
 	if (o!=n)
 	{
 		if (sp->subsamplingcorrect==0)
-			TIFFErrorExt(tif->tif_clientdata,module,"Corrupt SOF marker in JPEG data");
+			TIFFErrorExtR(tif,module,"Corrupt SOF marker in JPEG data");
 		return(0);
 	}
 	/* per component stuff */
@@ -1671,7 +1720,7 @@ OJPEGReadHeaderInfoSecStreamSof(TIFF* tif, uint8 marker_id)
 				{
 					if (o!=((sp->subsampling_hor<<4)|sp->subsampling_ver))
 					{
-						TIFFErrorExt(tif->tif_clientdata,module,"JPEG compressed data indicates unexpected subsampling values");
+						TIFFErrorExtR(tif,module,"JPEG compressed data indicates unexpected subsampling values");
 						return(0);
 					}
 				}
@@ -1679,7 +1728,7 @@ OJPEGReadHeaderInfoSecStreamSof(TIFF* tif, uint8 marker_id)
 				{
 					if (o!=17)
 					{
-						TIFFErrorExt(tif->tif_clientdata,module,"JPEG compressed data indicates unexpected subsampling values");
+						TIFFErrorExtR(tif,module,"JPEG compressed data indicates unexpected subsampling values");
 						return(0);
 					}
 				}
@@ -1708,7 +1757,7 @@ OJPEGReadHeaderInfoSecStreamSos(TIFF* tif)
 	assert(sp->subsamplingcorrect==0);
 	if (sp->sof_log==0)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Corrupt SOS marker in JPEG data");
+		TIFFErrorExtR(tif,module,"Corrupt SOS marker in JPEG data");
 		return(0);
 	}
 	/* Ls */
@@ -1716,7 +1765,7 @@ OJPEGReadHeaderInfoSecStreamSos(TIFF* tif)
 		return(0);
 	if (m!=6+sp->samples_per_pixel_per_plane*2)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Corrupt SOS marker in JPEG data");
+		TIFFErrorExtR(tif,module,"Corrupt SOS marker in JPEG data");
 		return(0);
 	}
 	/* Ns */
@@ -1724,7 +1773,7 @@ OJPEGReadHeaderInfoSecStreamSos(TIFF* tif)
 		return(0);
 	if (n!=sp->samples_per_pixel_per_plane)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Corrupt SOS marker in JPEG data");
+		TIFFErrorExtR(tif,module,"Corrupt SOS marker in JPEG data");
 		return(0);
 	}
 	/* Cs, Td, and Ta */
@@ -1756,7 +1805,7 @@ OJPEGReadHeaderInfoSecTablesQTable(TIFF* tif)
 	uint32 p;
 	if (sp->qtable_offset[0]==0)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Missing JPEG tables");
+		TIFFErrorExtR(tif,module,"Missing JPEG tables");
 		return(0);
 	}
 	sp->in_buffer_file_pos_log=0;
@@ -1768,15 +1817,15 @@ OJPEGReadHeaderInfoSecTablesQTable(TIFF* tif)
 			{
 				if (sp->qtable_offset[m]==sp->qtable_offset[n])
 				{
-					TIFFErrorExt(tif->tif_clientdata,module,"Corrupt JpegQTables tag value");
+					TIFFErrorExtR(tif,module,"Corrupt JpegQTables tag value");
 					return(0);
 				}
 			}
 			oa=sizeof(uint32)+69;
-			ob=_TIFFmalloc(oa);
+			ob=_TIFFmallocExt(tif, oa);
 			if (ob==0)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+				TIFFErrorExtR(tif,module,"Out of memory");
 				return(0);
 			}
 			*(uint32*)ob=oa;
@@ -1789,11 +1838,11 @@ OJPEGReadHeaderInfoSecTablesQTable(TIFF* tif)
 			p=(uint32)TIFFReadFile(tif,&ob[sizeof(uint32)+5],64);
 			if (p!=64)
                         {
-                                _TIFFfree(ob);
+                                _TIFFfreeExt(tif, ob);
 				return(0);
                         }
 			if (sp->qtable[m]!=0)
-				_TIFFfree(sp->qtable[m]);
+				_TIFFfreeExt(tif, sp->qtable[m]);
 			sp->qtable[m]=ob;
 			sp->sof_tq[m]=m;
 		}
@@ -1817,7 +1866,7 @@ OJPEGReadHeaderInfoSecTablesDcTable(TIFF* tif)
 	uint8* rb;
 	if (sp->dctable_offset[0]==0)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Missing JPEG tables");
+		TIFFErrorExtR(tif,module,"Missing JPEG tables");
 		return(0);
 	}
 	sp->in_buffer_file_pos_log=0;
@@ -1829,7 +1878,7 @@ OJPEGReadHeaderInfoSecTablesDcTable(TIFF* tif)
 			{
 				if (sp->dctable_offset[m]==sp->dctable_offset[n])
 				{
-					TIFFErrorExt(tif->tif_clientdata,module,"Corrupt JpegDcTables tag value");
+					TIFFErrorExtR(tif,module,"Corrupt JpegDcTables tag value");
 					return(0);
 				}
 			}
@@ -1841,10 +1890,10 @@ OJPEGReadHeaderInfoSecTablesDcTable(TIFF* tif)
 			for (n=0; n<16; n++)
 				q+=o[n];
 			ra=sizeof(uint32)+21+q;
-			rb=_TIFFmalloc(ra);
+			rb=_TIFFmallocExt(tif, ra);
 			if (rb==0)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+				TIFFErrorExtR(tif,module,"Out of memory");
 				return(0);
 			}
 			*(uint32*)rb=ra;
@@ -1858,11 +1907,11 @@ OJPEGReadHeaderInfoSecTablesDcTable(TIFF* tif)
 			p=(uint32)TIFFReadFile(tif,&(rb[sizeof(uint32)+21]),q);
 			if (p!=q)
                         {
-                                _TIFFfree(rb);
+                                _TIFFfreeExt(tif, rb);
 				return(0);
                         }
 			if (sp->dctable[m]!=0)
-				_TIFFfree(sp->dctable[m]);
+				_TIFFfreeExt(tif, sp->dctable[m]);
 			sp->dctable[m]=rb;
 			sp->sos_tda[m]=(m<<4);
 		}
@@ -1886,7 +1935,7 @@ OJPEGReadHeaderInfoSecTablesAcTable(TIFF* tif)
 	uint8* rb;
 	if (sp->actable_offset[0]==0)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Missing JPEG tables");
+		TIFFErrorExtR(tif,module,"Missing JPEG tables");
 		return(0);
 	}
 	sp->in_buffer_file_pos_log=0;
@@ -1898,7 +1947,7 @@ OJPEGReadHeaderInfoSecTablesAcTable(TIFF* tif)
 			{
 				if (sp->actable_offset[m]==sp->actable_offset[n])
 				{
-					TIFFErrorExt(tif->tif_clientdata,module,"Corrupt JpegAcTables tag value");
+					TIFFErrorExtR(tif,module,"Corrupt JpegAcTables tag value");
 					return(0);
 				}
 			}
@@ -1910,10 +1959,10 @@ OJPEGReadHeaderInfoSecTablesAcTable(TIFF* tif)
 			for (n=0; n<16; n++)
 				q+=o[n];
 			ra=sizeof(uint32)+21+q;
-			rb=_TIFFmalloc(ra);
+			rb=_TIFFmallocExt(tif, ra);
 			if (rb==0)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Out of memory");
+				TIFFErrorExtR(tif,module,"Out of memory");
 				return(0);
 			}
 			*(uint32*)rb=ra;
@@ -1927,11 +1976,11 @@ OJPEGReadHeaderInfoSecTablesAcTable(TIFF* tif)
 			p=(uint32)TIFFReadFile(tif,&(rb[sizeof(uint32)+21]),q);
 			if (p!=q)
                         {
-                                _TIFFfree(rb);
+                                _TIFFfreeExt(tif, rb);
 				return(0);
                         }
 			if (sp->actable[m]!=0)
-				_TIFFfree(sp->actable[m]);
+				_TIFFfreeExt(tif, sp->actable[m]);
 			sp->actable[m]=rb;
 			sp->sos_tda[m]=(sp->sos_tda[m]|m);
 		}
@@ -2008,7 +2057,7 @@ OJPEGReadBufferFill(OJPEGState* sp)
 						else
 						{
 							if (sp->tif->tif_dir.td_stripbytecount == 0) {
-								TIFFErrorExt(sp->tif->tif_clientdata,sp->tif->tif_name,"Strip byte counts are missing");
+								TIFFErrorExtR(sp->tif,sp->tif->tif_name,"Strip byte counts are missing");
 								return(0);
 							}
 							sp->in_buffer_file_togo=sp->tif->tif_dir.td_stripbytecount[sp->in_buffer_next_strile];
@@ -2482,7 +2531,7 @@ OJPEGLibjpegJpegErrorMgrOutputMessage(jpeg_common_struct* cinfo)
 {
 	char buffer[JMSG_LENGTH_MAX];
 	(*cinfo->err->format_message)(cinfo,buffer);
-	TIFFWarningExt(((TIFF*)(cinfo->client_data))->tif_clientdata,"LibJpeg","%s",buffer);
+	TIFFWarningExtR((TIFF*)(cinfo->client_data),"LibJpeg","%s",buffer);
 }
 
 static void
@@ -2490,7 +2539,7 @@ OJPEGLibjpegJpegErrorMgrErrorExit(jpeg_common_struct* cinfo)
 {
 	char buffer[JMSG_LENGTH_MAX];
 	(*cinfo->err->format_message)(cinfo,buffer);
-	TIFFErrorExt(((TIFF*)(cinfo->client_data))->tif_clientdata,"LibJpeg","%s",buffer);
+	TIFFErrorExtR((TIFF*)(cinfo->client_data),"LibJpeg","%s",buffer);
 	jpeg_encap_unwind((TIFF*)(cinfo->client_data));
 }
 
@@ -2509,7 +2558,7 @@ OJPEGLibjpegJpegSourceMgrFillInputBuffer(jpeg_decompress_struct* cinfo)
 	uint32 len=0U;
 	if (OJPEGWriteStream(tif,&mem,&len)==0)
 	{
-		TIFFErrorExt(tif->tif_clientdata,"LibJpeg","Premature end of JPEG data");
+		TIFFErrorExtR(tif,"LibJpeg","Premature end of JPEG data");
 		jpeg_encap_unwind(tif);
 	}
 	sp->libjpeg_jpeg_source_mgr.bytes_in_buffer=len;
@@ -2522,7 +2571,7 @@ OJPEGLibjpegJpegSourceMgrSkipInputData(jpeg_decompress_struct* cinfo, long num_b
 {
 	TIFF* tif=(TIFF*)cinfo->client_data;
 	(void)num_bytes;
-	TIFFErrorExt(tif->tif_clientdata,"LibJpeg","Unexpected error");
+	TIFFErrorExtR(tif,"LibJpeg","Unexpected error");
 	jpeg_encap_unwind(tif);
 }
 
@@ -2535,7 +2584,7 @@ OJPEGLibjpegJpegSourceMgrResyncToRestart(jpeg_decompress_struct* cinfo, int desi
 {
 	TIFF* tif=(TIFF*)cinfo->client_data;
 	(void)desired;
-	TIFFErrorExt(tif->tif_clientdata,"LibJpeg","Unexpected error");
+	TIFFErrorExtR(tif,"LibJpeg","Unexpected error");
 	jpeg_encap_unwind(tif);
 	return(0);
 }
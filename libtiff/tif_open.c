@@ -27,6 +27,9 @@
  */
 #include "tiffiop.h"
 
+#define TIFF_SIZE_T_MAX ((size_t) ~ ((size_t)0))
+#define TIFF_TMSIZE_T_MAX (tmsize_t)(TIFF_SIZE_T_MAX >> 1)
+
 /*
  * Dummy functions to fill the omitted client procedures.
  */
@@ -67,6 +70,547 @@ _TIFFgetMode(const char* mode, const char* module)
 	return (m);
 }
 
+/*
+ * Options controlling how a TIFF handle is created.
+ */
+TIFFOpenOptions*
+TIFFOpenOptionsAlloc(void)
+{
+	TIFFOpenOptions* opts = (TIFFOpenOptions*) _TIFFmalloc(sizeof(TIFFOpenOptions));
+
+	if (opts != NULL)
+		_TIFFmemset(opts, 0, sizeof(TIFFOpenOptions));
+	return (opts);
+}
+
+void
+TIFFOpenOptionsFree(TIFFOpenOptions* opts)
+{
+	_TIFFfree(opts);
+}
+
+/*
+ * Route every allocation made on behalf of handles opened with opts
+ * through the given callbacks, which receive ctx as first argument.
+ * Passing a NULL callback restores the default _TIFFmalloc() family.
+ */
+void
+TIFFOpenOptionsSetAllocator(TIFFOpenOptions* opts, TIFFMallocProc mallocproc,
+    TIFFReallocProc reallocproc, TIFFFreeProc freeproc, void* ctx)
+{
+	if (mallocproc == NULL || reallocproc == NULL || freeproc == NULL) {
+		mallocproc = NULL;
+		reallocproc = NULL;
+		freeproc = NULL;
+		ctx = NULL;
+	}
+	opts->mallocproc = mallocproc;
+	opts->reallocproc = reallocproc;
+	opts->freeproc = freeproc;
+	opts->allocctx = ctx;
+}
+
+/*
+ * Limit the total amount of memory that handles opened with opts may
+ * have allocated at any one time; 0 means no limit.
+ */
+void
+TIFFOpenOptionsSetMaxCumulatedMemAlloc(TIFFOpenOptions* opts, tmsize_t max)
+{
+	opts->maxmemalloc = max > 0 ? max : 0;
+}
+
+/*
+ * Align every block allocated on behalf of handles opened with opts,
+ * including their I/O and codec buffers, on a multiple of alignment
+ * bytes, a power of two up to TIFF_MAX_BUFFER_ALIGNMENT.  0 or any
+ * other value leaves the alignment to the allocator.
+ */
+void
+TIFFOpenOptionsSetBufferAlignment(TIFFOpenOptions* opts, tmsize_t alignment)
+{
+	if (alignment <= 0 || alignment > TIFF_MAX_BUFFER_ALIGNMENT ||
+	    (alignment & (alignment - 1)) != 0)
+		alignment = 0;
+	opts->memalign = alignment;
+}
+
+/*
+ * Give the handle a method that reads size bytes at offset off of the
+ * file without using or changing the position maintained by the seek
+ * method, so that it may be called by several threads at once.  It
+ * returns the number of bytes read, or -1 on error.  When present,
+ * worker threads fetch raw strips and tiles with it instead of taking
+ * turns with the seek and read methods.
+ */
+void
+TIFFOpenOptionsSetReadAtProc(TIFFOpenOptions* opts, TIFFReadAtProc readatproc)
+{
+	opts->readatproc = readatproc;
+}
+
+/*
+ * Make TIFFOpenExt() write files opened for writing or updating with
+ * O_DIRECT where it can, through an aligned staging buffer, so that the
+ * image data does not go through the page cache.  Ignored where
+ * O_DIRECT or pwrite() is not available.
+ */
+void
+TIFFOpenOptionsSetDirectIO(TIFFOpenOptions* opts, int enable)
+{
+	opts->directio = enable != 0;
+}
+
+/*
+ * Tell the operating system how TIFFOpenExt() and TIFFFdOpenExt() will
+ * read the file, one of the TIFF_ACCESS_* values, so that it can tune
+ * its read-ahead and caching for it.
+ */
+void
+TIFFOpenOptionsSetAccessPattern(TIFFOpenOptions* opts, int pattern)
+{
+	opts->accesspattern = pattern;
+}
+
+/*
+ * Limit the data that TIFFOpenSequential() holds in memory until it can be
+ * sent; beyond it the data goes to a temporary file.  0 selects the
+ * default of 16MB, a negative limit keeps everything in memory.
+ */
+void
+TIFFOpenOptionsSetSpillLimit(TIFFOpenOptions* opts, tmsize_t limit)
+{
+	opts->spilllimit = limit;
+}
+
+/*
+ * Make handles opened for writing record the CRC-32C of the data of
+ * each strip and tile in the ChunkCRC32C tag, for TIFFVerifyChunks().
+ */
+void
+TIFFOpenOptionsSetChunkChecksums(TIFFOpenOptions* opts, int enable)
+{
+	opts->chunkchecksums = enable != 0;
+}
+
+/*
+ * Make TIFFOpenExt() and TIFFFdOpenExt() keep the file position in the
+ * handle and read and write with pread() and pwrite(), leaving the
+ * file offset of the descriptor alone, so that several handles may be
+ * opened on one descriptor or on duplicates of it.  Ignored where
+ * pread() is not available.
+ */
+void
+TIFFOpenOptionsSetPositionalIO(TIFFOpenOptions* opts, int positional)
+{
+	opts->positionalio = positional != 0;
+}
+
+/*
+ * Give the handle a method that reserves storage for len bytes of the
+ * file from offset off, without changing the size of the file, for
+ * TIFFPreallocate().  It returns 1 if the space was reserved.
+ * TIFFOpenExt() and TIFFFdOpenExt() provide one where the system can
+ * do this, such as fallocate() on Linux.
+ */
+void
+TIFFOpenOptionsSetPreallocateProc(TIFFOpenOptions* opts,
+    TIFFPreallocateProc preallocateproc)
+{
+	opts->preallocateproc = preallocateproc;
+}
+
+/*
+ * Give the handle a method that performs a set of positional reads,
+ * possibly all at once, without using or changing the position
+ * maintained by the seek method.  It sets the result of every request
+ * to the number of bytes read, or -1 on error, and returns 1 if all
+ * requests were attempted and 0 otherwise.  When present,
+ * TIFFReadRawChunks() hands it the byte ranges it would otherwise
+ * read one at a time.
+ */
+void
+TIFFOpenOptionsSetReadBatchProc(TIFFOpenOptions* opts,
+    TIFFReadBatchProc readbatchproc)
+{
+	opts->readbatchproc = readbatchproc;
+}
+
+/*
+ * Make read-only handles read the file through a cache of nblocks
+ * blocks of blocksize bytes, or of 16 KB if blocksize is 0, which are
+ * replaced in least recently used order.  Seeking then only changes a
+ * position kept by the handle, and the read method is called once for
+ * each block or set of adjacent blocks missing from the cache, or for
+ * reads of a block or more.  Meant for I/O methods where every read
+ * is slow whatever its size, such as remote files read by range
+ * requests.  0 blocks disables the cache.
+ */
+void
+TIFFOpenOptionsSetBlockCache(TIFFOpenOptions* opts, tmsize_t blocksize,
+    uint32 nblocks)
+{
+	opts->cacheblocksize = blocksize > 0 ? blocksize : 0;
+	opts->cacheblocks = nblocks;
+}
+
+/*
+ * Load the first size bytes of the file into the block cache with a
+ * single read when the handle is opened, so that the header, the
+ * first directory and often its strip or tile arrays arrive at once.
+ * Limited to the capacity of the cache; ignored without one.
+ */
+void
+TIFFOpenOptionsSetHeaderPrefetch(TIFFOpenOptions* opts, tmsize_t size)
+{
+	opts->headerprefetch = size > 0 ? size : 0;
+}
+
+/*
+ * Make handles open for writing collect writes that follow each other
+ * in the file in a buffer of size bytes, and pass them to the write
+ * method together.  The buffer is written out before reads, when a
+ * directory is written, and by TIFFFlush() and TIFFClose().  Meant for
+ * I/O methods where every write is slow whatever its size, such as
+ * files on network file systems.  0 disables the buffer.
+ */
+void
+TIFFOpenOptionsSetWriteBuffer(TIFFOpenOptions* opts, tmsize_t size)
+{
+	opts->writebuffersize = size > 0 ? size : 0;
+}
+
+/*
+ * Make handles open for writing hand full write buffers to a thread
+ * that writes them in the background, keeping up to nbuffers buffers
+ * of the size set with TIFFOpenOptionsSetWriteBuffer(), or of
+ * TIFF_WRITEBEHIND_BUFFER_SIZE bytes, so that encoding overlaps
+ * writing.  Errors are reported by the next flush.  0 or 1 writes on
+ * the calling thread.
+ */
+void
+TIFFOpenOptionsSetWriteBehind(TIFFOpenOptions* opts, int nbuffers)
+{
+	opts->writebehind = nbuffers > 1 ? nbuffers : 0;
+}
+
+/*
+ * Make TIFFDefaultStripSize() and TIFFDefaultTileSize() aim at strips
+ * and tiles of size bytes, or at a size chosen for the codec with
+ * TIFF_CHUNKSIZE_AUTO, rather than at STRIP_SIZE_DEFAULT bytes and
+ * 256x256 tiles.  0 restores these.
+ */
+void
+TIFFOpenOptionsSetChunkSize(TIFFOpenOptions* opts, tmsize_t size)
+{
+	opts->chunksize = size > 0 || size == TIFF_CHUNKSIZE_AUTO ? size : 0;
+}
+
+/*
+ * Make directories written with more than entries strips or tiles keep
+ * only entries of their offsets and byte counts in memory, the arrays
+ * being set aside in the file before the image data and updated there
+ * as the data are written.  0, the default, keeps the whole arrays.
+ */
+void
+TIFFOpenOptionsSetStrileWindow(TIFFOpenOptions* opts, uint32 entries)
+{
+	opts->strilewindow = entries;
+}
+
+/*
+ * Make the parallel routines of handles run their tasks on pool, rather
+ * than on the default pool or on threads they start themselves.  The
+ * structure is copied; NULL restores the default.
+ */
+void
+TIFFOpenOptionsSetThreadPool(TIFFOpenOptions* opts, const TIFFThreadPool* pool)
+{
+	if (pool != NULL && pool->submit != NULL)
+		opts->threadpool = *pool;
+	else
+		_TIFFmemset(&opts->threadpool, 0, sizeof(TIFFThreadPool));
+}
+
+/*
+ * Make handles count the calls to their I/O methods, the strips and
+ * tiles they code and the time spent in the codec, for
+ * TIFFGetStatistics().
+ */
+void
+TIFFOpenOptionsSetStatistics(TIFFOpenOptions* opts, int enable)
+{
+	opts->statistics = enable != 0;
+}
+
+/*
+ * Give handles their own error and warning handlers, called with
+ * user_data before the global ones; a handler returning non-zero keeps
+ * the global handlers from being called.  The messages of a handle no
+ * longer need the handle to be found from the client data, nor the
+ * global handlers to be locked by threads using different handles.
+ */
+void
+TIFFOpenOptionsSetErrorHandlerExtR(TIFFOpenOptions* opts,
+    TIFFErrorHandlerExtR handler, void* user_data)
+{
+	opts->errorhandler = handler;
+	opts->errorhandler_user_data = user_data;
+}
+
+void
+TIFFOpenOptionsSetWarningHandlerExtR(TIFFOpenOptions* opts,
+    TIFFErrorHandlerExtR handler, void* user_data)
+{
+	opts->warnhandler = handler;
+	opts->warnhandler_user_data = user_data;
+}
+
+/*
+ * Drop the warnings of handles, before their arguments are formatted
+ * by any handler.  Warnings are enabled by default.
+ */
+void
+TIFFOpenOptionsSetWarnings(TIFFOpenOptions* opts, int enable)
+{
+	opts->nowarnings = !enable;
+}
+
+/*
+ * Return the number of bytes currently allocated on behalf of the
+ * handle and the largest such number seen since it was opened.  Only
+ * handles opened with a TIFFOpenOptions object keep track of their
+ * memory; 0 is returned for the others.
+ */
+void
+TIFFGetMemoryUsage(TIFF* tif, tmsize_t* current, tmsize_t* peak)
+{
+	TIFF* acct = tif->tif_memaccount;
+	tmsize_t cur = 0, max = 0;
+
+	if (acct != NULL) {
+		if (acct->tif_memmutex)
+			_TIFFMutexLock(acct->tif_memmutex);
+		cur = acct->tif_curmemalloc;
+		max = acct->tif_peakmemalloc;
+		if (acct->tif_memmutex)
+			_TIFFMutexUnlock(acct->tif_memmutex);
+	}
+	if (current)
+		*current = cur;
+	if (peak)
+		*peak = max;
+}
+
+/*
+ * Handles that keep track of their memory prefix every block with a
+ * header recording its size and, for handles with a buffer alignment,
+ * its distance from the start of the block actually allocated, which
+ * then has room for the padding.  The header is large enough to keep
+ * the returned pointer suitably aligned for any type.
+ */
+#define	TIFF_MEMHDR_SIZE	16
+#define	MEMHDR_SIZE(p)		(((tmsize_t*) (p))[-2])
+#define	MEMHDR_OFFSET(p)	(((tmsize_t*) (p))[-1])
+
+/*
+ * Padding allocated with each block of the handle for its alignment.
+ */
+static tmsize_t
+_TIFFMemPadding(TIFF* tif)
+{
+	tmsize_t align = tif->tif_memaccount->tif_memalign;
+
+	return (align > 0 ? align - 1 : 0);
+}
+
+/*
+ * Return where the data goes in the raw block base, which has room for
+ * the header and padding.
+ */
+static uint8*
+_TIFFPlaceBlock(TIFF* tif, uint8* base)
+{
+	tmsize_t align = tif->tif_memaccount->tif_memalign;
+	uint8* p = base + TIFF_MEMHDR_SIZE;
+
+	if (align > 0)
+		p += (align - (tmsize_t) ((size_t) p & (size_t) (align - 1))) &
+		    (align - 1);
+	return (p);
+}
+
+static void*
+_TIFFRawMalloc(TIFF* tif, tmsize_t s)
+{
+	if (tif->tif_mallocproc == NULL)
+		return (_TIFFmalloc(s));
+	return ((*tif->tif_mallocproc)(tif->tif_allocctx, s));
+}
+
+static void*
+_TIFFRawRealloc(TIFF* tif, void* p, tmsize_t s)
+{
+	if (tif->tif_mallocproc == NULL)
+		return (_TIFFrealloc(p, s));
+	return ((*tif->tif_reallocproc)(tif->tif_allocctx, p, s));
+}
+
+static void
+_TIFFRawFree(TIFF* tif, void* p)
+{
+	if (tif->tif_mallocproc == NULL)
+		_TIFFfree(p);
+	else
+		(*tif->tif_freeproc)(tif->tif_allocctx, p);
+}
+
+/*
+ * Charge delta bytes to the handle's account, failing if that would
+ * exceed its limit.
+ */
+static int
+_TIFFChargeMemory(TIFF* tif, tmsize_t delta, tmsize_t request)
+{
+	static const char module[] = "_TIFFmallocExt";
+	TIFF* acct = tif->tif_memaccount;
+	int ok = 1;
+
+	/* The mutex only exists while helper handles may allocate */
+	if (acct->tif_memmutex)
+		_TIFFMutexLock(acct->tif_memmutex);
+	if (delta > 0 && acct->tif_maxmemalloc > 0 &&
+	    delta > acct->tif_maxmemalloc - acct->tif_curmemalloc)
+		ok = 0;
+	else {
+		acct->tif_curmemalloc += delta;
+		if (acct->tif_curmemalloc > acct->tif_peakmemalloc)
+			acct->tif_peakmemalloc = acct->tif_curmemalloc;
+	}
+	if (acct->tif_memmutex)
+		_TIFFMutexUnlock(acct->tif_memmutex);
+	if (!ok)
+		TIFFErrorExtR(tif, module,
+		    "Memory allocation of %lld bytes is beyond the %lld byte "
+		    "limit set for this handle",
+		    (long long) request, (long long) acct->tif_maxmemalloc);
+	return (ok);
+}
+
+/*
+ * Memory allocation for data owned by a handle.  These use the
+ * allocator the handle was opened with, if any, and enforce its
+ * memory limit; tif may be NULL.
+ */
+void*
+(_TIFFmallocExt)(TIFF* tif, tmsize_t s)
+{
+	uint8* p;
+	uint8* q;
+	tmsize_t pad;
+
+	if (tif == NULL || (tif->tif_mallocproc == NULL &&
+	    tif->tif_memaccount == NULL))
+		return (_TIFFmalloc(s));
+	if (s <= 0)
+		return ((void*) NULL);
+	if (tif->tif_memaccount == NULL)
+		return (_TIFFRawMalloc(tif, s));
+	pad = _TIFFMemPadding(tif);
+	if (s > TIFF_TMSIZE_T_MAX - TIFF_MEMHDR_SIZE - pad ||
+	    !_TIFFChargeMemory(tif, s, s))
+		return ((void*) NULL);
+	p = (uint8*) _TIFFRawMalloc(tif, s + TIFF_MEMHDR_SIZE + pad);
+	if (p == NULL) {
+		_TIFFChargeMemory(tif, -s, 0);
+		return ((void*) NULL);
+	}
+	q = _TIFFPlaceBlock(tif, p);
+	MEMHDR_SIZE(q) = s;
+	MEMHDR_OFFSET(q) = (tmsize_t) (q - p);
+	return (q);
+}
+
+void*
+(_TIFFcallocExt)(TIFF* tif, tmsize_t nmemb, tmsize_t siz)
+{
+	void* p;
+
+	if (tif == NULL || (tif->tif_mallocproc == NULL &&
+	    tif->tif_memaccount == NULL))
+		return (_TIFFcalloc(nmemb, siz));
+	if (nmemb <= 0 || siz <= 0 || nmemb > TIFF_TMSIZE_T_MAX / siz)
+		return ((void*) NULL);
+	p = (_TIFFmallocExt)(tif, nmemb * siz);
+	if (p != NULL)
+		_TIFFmemset(p, 0, nmemb * siz);
+	return (p);
+}
+
+void*
+(_TIFFreallocExt)(TIFF* tif, void* p, tmsize_t s)
+{
+	uint8* base;
+	uint8* q;
+	tmsize_t old, offset, pad;
+
+	if (tif == NULL || (tif->tif_mallocproc == NULL &&
+	    tif->tif_memaccount == NULL))
+		return (_TIFFrealloc(p, s));
+	if (tif->tif_memaccount == NULL)
+		return (_TIFFRawRealloc(tif, p, s));
+	if (p == NULL)
+		return ((_TIFFmallocExt)(tif, s));
+	pad = _TIFFMemPadding(tif);
+	if (s <= 0 || s > TIFF_TMSIZE_T_MAX - TIFF_MEMHDR_SIZE - pad)
+		return ((void*) NULL);
+	old = MEMHDR_SIZE(p);
+	offset = MEMHDR_OFFSET(p);
+	if (!_TIFFChargeMemory(tif, s - old, s))
+		return ((void*) NULL);
+	base = (uint8*) _TIFFRawRealloc(tif, (uint8*) p - offset,
+	    s + TIFF_MEMHDR_SIZE + pad);
+	if (base == NULL) {
+		_TIFFChargeMemory(tif, old - s, 0);
+		return ((void*) NULL);
+	}
+	/* The allocator may have moved the data off the alignment */
+	q = _TIFFPlaceBlock(tif, base);
+	if (q != base + offset)
+		memmove(q, base + offset, (size_t) (old < s ? old : s));
+	MEMHDR_SIZE(q) = s;
+	MEMHDR_OFFSET(q) = (tmsize_t) (q - base);
+	return (q);
+}
+
+void
+_TIFFfreeExt(TIFF* tif, void* p)
+{
+	uint8* base;
+
+	if (tif == NULL || (tif->tif_mallocproc == NULL &&
+	    tif->tif_memaccount == NULL))
+		_TIFFfree(p);
+	else if (p != NULL && tif->tif_memaccount == NULL)
+		_TIFFRawFree(tif, p);
+	else if (p != NULL) {
+		base = (uint8*) p - MEMHDR_OFFSET(p);
+		_TIFFChargeMemory(tif, -MEMHDR_SIZE(p), 0);
+		_TIFFRawFree(tif, base);
+	}
+}
+
+/*
+ * Release the TIFF structure itself, which is not accounted for.
+ */
+void
+_TIFFFreeHandle(TIFF* tif)
+{
+	if (tif->tif_memaccount == tif)
+		_TIFFMutexDestroy(tif->tif_memmutex);
+	_TIFFRawFree(tif, tif);
+}
+
 TIFF*
 TIFFClientOpen(
 	const char* name, const char* mode,
@@ -79,9 +623,28 @@ TIFFClientOpen(
 	TIFFMapFileProc mapproc,
 	TIFFUnmapFileProc unmapproc
 )
+{
+	return (TIFFClientOpenExt(name, mode, clientdata, readproc, writeproc,
+	    seekproc, closeproc, sizeproc, mapproc, unmapproc, NULL));
+}
+
+TIFF*
+TIFFClientOpenExt(
+	const char* name, const char* mode,
+	thandle_t clientdata,
+	TIFFReadWriteProc readproc,
+	TIFFReadWriteProc writeproc,
+	TIFFSeekProc seekproc,
+	TIFFCloseProc closeproc,
+	TIFFSizeProc sizeproc,
+	TIFFMapFileProc mapproc,
+	TIFFUnmapFileProc unmapproc,
+	TIFFOpenOptions* opts
+)
 {
 	static const char module[] = "TIFFClientOpen";
 	TIFF *tif;
+	tmsize_t size;
 	int m;
 	const char* cp;
 
@@ -111,15 +674,39 @@ TIFFClientOpen(
 		#endif
 	}
 
+	/* Pick the optimized kernels before any data is processed */
+	(void) _TIFFGetKernels();
+
 	m = _TIFFgetMode(mode, module);
 	if (m == -1)
 		goto bad2;
-	tif = (TIFF *)_TIFFmalloc((tmsize_t)(sizeof (TIFF) + strlen(name) + 1));
+	size = (tmsize_t)(sizeof (TIFF) + strlen(name) + 1);
+	if (opts != NULL && opts->mallocproc != NULL)
+		tif = (TIFF *)(*opts->mallocproc)(opts->allocctx, size);
+	else
+		tif = (TIFF *)_TIFFmalloc(size);
 	if (tif == NULL) {
 		TIFFErrorExt(clientdata, module, "%s: Out of memory (TIFF structure)", name);
 		goto bad2;
 	}
 	_TIFFmemset(tif, 0, sizeof (*tif));
+	if (opts != NULL) {
+		tif->tif_mallocproc = opts->mallocproc;
+		tif->tif_reallocproc = opts->reallocproc;
+		tif->tif_freeproc = opts->freeproc;
+		tif->tif_allocctx = opts->allocctx;
+		/* Helper handles share the account of their master */
+		tif->tif_memaccount = opts->memaccount ? opts->memaccount : tif;
+		tif->tif_maxmemalloc = opts->maxmemalloc;
+		tif->tif_memalign = opts->memalign;
+		tif->tif_readatproc = opts->readatproc;
+		tif->tif_readbatchproc = opts->readbatchproc;
+		tif->tif_preallocateproc = opts->preallocateproc;
+		tif->tif_errorhandler = opts->errorhandler;
+		tif->tif_errorhandler_user_data = opts->errorhandler_user_data;
+		tif->tif_warnhandler = opts->warnhandler;
+		tif->tif_warnhandler_user_data = opts->warnhandler_user_data;
+	}
 	tif->tif_name = (char *)tif + sizeof (TIFF);
 	strcpy(tif->tif_name, name);
 	tif->tif_mode = m &~ (O_CREAT|O_TRUNC);
@@ -129,7 +716,7 @@ TIFFClientOpen(
 	tif->tif_row = (uint32) -1;		/* read/write pre-increment */
 	tif->tif_clientdata = clientdata;
 	if (!readproc || !writeproc || !seekproc || !closeproc || !sizeproc) {
-		TIFFErrorExt(clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "One of the client procedures is NULL pointer.");
 		goto bad2;
 	}
@@ -155,6 +742,8 @@ TIFFClientOpen(
 	tif->tif_flags = FILLORDER_MSB2LSB;
 	if (m == O_RDONLY )
 		tif->tif_flags |= TIFF_MAPPED;
+	if (opts != NULL && opts->nowarnings)
+		tif->tif_flags |= TIFF_NOWARNINGS;
 
 	#ifdef STRIPCHOP_DEFAULT
 	if (m == O_RDONLY || m == O_RDWR)
@@ -179,6 +768,11 @@ TIFFClientOpen(
 	 * 'C' enable strip chopping support when reading
 	 * 'c' disable strip chopping support
 	 * 'h' read TIFF header only, do not load the first IFD
+	 * 'O' load strip/tile offsets and byte counts on demand, in pieces
+	 * 'F' fast open: read the tags not needed to decode images on demand
+	 * 'S' sparse writing: leave strips/tiles holding only zeros out
+	 * 'D' deduplicated writing: identical strips/tiles share their data
+	 * 'T' tally the samples written, see TIFFGetImageStatistics()
 	 * '4' ClassicTIFF for creating a file (default)
 	 * '8' BigTIFF for creating a file
 	 *
@@ -212,6 +806,30 @@ TIFFClientOpen(
 	 * application-transparent and as such can cause problems.  The 'c'
 	 * option permits applications that only want to look at the tags,
 	 * for example, to get the unadulterated TIFF tag information.
+	 *
+	 * The 'O' flag makes opening files with a huge number of strips
+	 * or tiles cheap: only the pieces of the StripOffsets and
+	 * StripByteCounts arrays that are actually used are read, until
+	 * something needs the whole arrays.
+	 *
+	 * The 'F' flag is meant for applications that open many files
+	 * to look at a few tags only: big blobs like ICC profiles, XMP
+	 * or GeoTIFF arrays are not read until asked for with
+	 * TIFFGetField().
+	 *
+	 * The 'S' flag makes TIFFWriteEncodedStrip() and TIFFWriteEncodedTile()
+	 * write nothing for strips and tiles whose data is all zeros, leaving
+	 * their offset and byte count at 0 as GDAL does for sparse files;
+	 * such strips and tiles read back as zeros.
+	 *
+	 * The 'D' flag makes strips and tiles whose encoded data is the same
+	 * as that of one already written point at that data instead of
+	 * appending a copy.  Readers need no support for this.
+	 *
+	 * The 'T' flag keeps the minimum, maximum and sum of the samples of
+	 * each strip and tile written, and a histogram of the image, and
+	 * records the minima and maxima in the ChunkStatistics tag, sparing
+	 * applications a second pass over the data.
 	 */
 	for (cp = mode; *cp; cp++)
 		switch (*cp) {
@@ -258,18 +876,64 @@ TIFFClientOpen(
 			case 'h':
 				tif->tif_flags |= TIFF_HEADERONLY;
 				break;
+			case 'O':
+				if (m == O_RDONLY)
+					tif->tif_flags |= TIFF_LAZYSTRILELOAD;
+				break;
+			case 'F':
+				if (m == O_RDONLY)
+					tif->tif_flags |= TIFF_DEFERTAGS;
+				break;
+			case 'I':
+				if (m == O_RDWR)
+					tif->tif_flags |= TIFF_INPLACEUPDATE;
+				break;
+			case 'S':
+				if (m != O_RDONLY)
+					tif->tif_flags |= TIFF_SPARSEWRITE;
+				break;
+			case 'D':
+				if (m != O_RDONLY)
+					tif->tif_flags |= TIFF_DEDUPWRITE;
+				break;
+			case 'T':
+				if (m != O_RDONLY)
+					tif->tif_flags |= TIFF_CHUNKSTATS;
+				break;
 			case '8':
 				if (m&O_CREAT)
 					tif->tif_flags |= TIFF_BIGTIFF;
 				break;
+			case 'A':
+				if (m&O_CREAT)
+					tif->tif_promote = TIFF_PROMOTE_AUTO;
+				break;
 		}
+	if (opts != NULL && opts->statistics && !_TIFFStatsInit(tif))
+		goto bad;
+	if (opts != NULL && opts->cacheblocks > 0 && m == O_RDONLY &&
+	    !_TIFFBlockCacheInit(tif, opts->cacheblocksize, opts->cacheblocks,
+	    opts->headerprefetch))
+		goto bad;
+	if (opts != NULL) {
+		tif->tif_chunksize = opts->chunksize;
+		tif->tif_strilewindow = opts->strilewindow;
+		tif->tif_threadpool = opts->threadpool;
+		tif->tif_chunkchecksums = opts->chunkchecksums && m != O_RDONLY;
+	}
+	if (opts != NULL && (opts->writebuffersize > 0 ||
+	    opts->writebehind > 1) && m != O_RDONLY &&
+	    !_TIFFWriteBufferInit(tif, opts->writebuffersize > 0 ?
+	    opts->writebuffersize : TIFF_WRITEBEHIND_BUFFER_SIZE,
+	    opts->writebehind))
+		goto bad;
 	/*
 	 * Read in TIFF header.
 	 */
 	if ((m & O_TRUNC) ||
 	    !ReadOK(tif, &tif->tif_header, sizeof (TIFFHeaderClassic))) {
 		if (tif->tif_mode == O_RDONLY) {
-			TIFFErrorExt(tif->tif_clientdata, name,
+			TIFFErrorExtR(tif, name,
 			    "Cannot read TIFF header");
 			goto bad;
 		}
@@ -313,10 +977,27 @@ TIFFClientOpen(
 		 */
 		TIFFSeekFile( tif, 0, SEEK_SET );
 		if (!WriteOK(tif, &tif->tif_header, (tmsize_t)(tif->tif_header_size))) {
-			TIFFErrorExt(tif->tif_clientdata, name,
+			TIFFErrorExtR(tif, name,
 			    "Error writing TIFF header");
 			goto bad;
 		}
+		/*
+		 * A ClassicTIFF file that may become BigTIFF leaves room
+		 * for the larger header, which is rewritten in place, so
+		 * nothing is sent from a stream before it is closed.
+		 */
+		if (tif->tif_flags & TIFF_BIGTIFF)
+			tif->tif_promote = TIFF_PROMOTE_NONE;
+		if (tif->tif_promote == TIFF_PROMOTE_AUTO) {
+			static uint8 zeros[sizeof (TIFFHeaderBig) -
+			    sizeof (TIFFHeaderClassic)] = { 0 };
+			if (!WriteOK(tif, zeros, (tmsize_t) sizeof (zeros))) {
+				TIFFErrorExtR(tif, name,
+				    "Error writing TIFF header");
+				goto bad;
+			}
+			_TIFFSequentialHold(tif);
+		}
 		/*
 		 * Setup the byte order handling.
 		 */
@@ -340,6 +1021,8 @@ TIFFClientOpen(
 		tif->tif_dirnumber = 0;
 		return (tif);
 	}
+	/* Only a file created here has room for a BigTIFF header */
+	tif->tif_promote = TIFF_PROMOTE_NONE;
 	/*
 	 * Setup the byte order handling.
 	 */
@@ -353,11 +1036,11 @@ TIFFClientOpen(
 	    tif->tif_header.common.tiff_magic != MDI_LITTLEENDIAN
 	    #endif
 	    ) {
-		TIFFErrorExt(tif->tif_clientdata, name,
+		TIFFErrorExtR(tif, name,
 		    "Not a TIFF or MDI file, bad magic number %d (0x%x)",
 	    #else
 	    ) {
-		TIFFErrorExt(tif->tif_clientdata, name,
+		TIFFErrorExtR(tif, name,
 		    "Not a TIFF file, bad magic number %d (0x%x)",
 	    #endif
 		    tif->tif_header.common.tiff_magic,
@@ -377,7 +1060,7 @@ TIFFClientOpen(
 		TIFFSwabShort(&tif->tif_header.common.tiff_version);
 	if ((tif->tif_header.common.tiff_version != TIFF_VERSION_CLASSIC)&&
 	    (tif->tif_header.common.tiff_version != TIFF_VERSION_BIG)) {
-		TIFFErrorExt(tif->tif_clientdata, name,
+		TIFFErrorExtR(tif, name,
 		    "Not a TIFF file, bad version number %d (0x%x)",
 		    tif->tif_header.common.tiff_version,
 		    tif->tif_header.common.tiff_version);
@@ -393,7 +1076,7 @@ TIFFClientOpen(
 	{
 		if (!ReadOK(tif, ((uint8*)(&tif->tif_header) + sizeof(TIFFHeaderClassic)), (sizeof(TIFFHeaderBig)-sizeof(TIFFHeaderClassic))))
 		{
-			TIFFErrorExt(tif->tif_clientdata, name,
+			TIFFErrorExtR(tif, name,
 			    "Cannot read TIFF header");
 			goto bad;
 		}
@@ -404,7 +1087,7 @@ TIFFClientOpen(
 		}
 		if (tif->tif_header.big.tiff_offsetsize != 8)
 		{
-			TIFFErrorExt(tif->tif_clientdata, name,
+			TIFFErrorExtR(tif, name,
 			    "Not a TIFF file, bad BigTIFF offsetsize %d (0x%x)",
 			    tif->tif_header.big.tiff_offsetsize,
 			    tif->tif_header.big.tiff_offsetsize);
@@ -412,7 +1095,7 @@ TIFFClientOpen(
 		}
 		if (tif->tif_header.big.tiff_unused != 0)
 		{
-			TIFFErrorExt(tif->tif_clientdata, name,
+			TIFFErrorExtR(tif, name,
 			    "Not a TIFF file, bad BigTIFF unused %d (0x%x)",
 			    tif->tif_header.big.tiff_unused,
 			    tif->tif_header.big.tiff_unused);
@@ -578,6 +1261,40 @@ TIFFIsTiled(TIFF* tif)
 	return (isTiled(tif));
 }
 
+/*
+ * Fill info with the core fields of the current directory, as
+ * TIFFGetField() would return them, straight from the directory.  The
+ * fields are the ones the library itself works with; codecs that change
+ * how data is returned, such as JPEG with JPEGCOLORMODE_RGB, do not
+ * change them here either.
+ */
+void
+TIFFGetImageInfo(TIFF* tif, TIFFImageInfo* info)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+
+	info->imagewidth = td->td_imagewidth;
+	info->imagelength = td->td_imagelength;
+	info->imagedepth = td->td_imagedepth;
+	info->tiled = isTiled(tif) ? 1 : 0;
+	info->tilewidth = info->tiled ? td->td_tilewidth : 0;
+	info->tilelength = info->tiled ? td->td_tilelength : 0;
+	info->tiledepth = td->td_tiledepth;
+	info->rowsperstrip = td->td_rowsperstrip;
+	info->nstrips = td->td_nstrips;
+	info->stripsperimage = td->td_stripsperimage;
+	info->subfiletype = td->td_subfiletype;
+	info->bitspersample = td->td_bitspersample;
+	info->samplesperpixel = td->td_samplesperpixel;
+	info->extrasamples = td->td_extrasamples;
+	info->sampleformat = td->td_sampleformat;
+	info->planarconfig = td->td_planarconfig;
+	info->photometric = td->td_photometric;
+	info->compression = td->td_compression;
+	info->fillorder = td->td_fillorder;
+	info->orientation = td->td_orientation;
+}
+
 /*
  * Return current row being read/written.
  */
@@ -0,0 +1,705 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library.
+ *
+ * Physical application of the Orientation tag: re-arrangement of
+ * pixels into the top-left orientation, and copying of a directory
+ * with its image re-oriented.
+ */
+#include "tiffiop.h"
+
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#elif defined(TIFF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Transposed pixels are moved in square blocks of ORIENT_BLOCK pixels
+ * so that the source and destination rows of a block stay in the
+ * cache.  TIFFReorientDirectory() works through bands of output rows
+ * no larger than ORIENT_BANDSIZE bytes (but at least a row of strips
+ * or tiles).
+ */
+#define	ORIENT_BLOCK	32
+#define	ORIENT_BANDSIZE	((tmsize_t) 8 * 1024 * 1024)
+
+/*
+ * Block transpose kernels: element j of row i of the destination block,
+ * at dst + i * dststep, is element i of the source row at
+ * src + j * srcstep.  Each interleave of register i with register
+ * i + n/2 rotates the bits of (register number, element number) left
+ * by one, so log2(n) rounds transpose an n by n block.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSE2 static void
+transpose8SSE2(const uint8* src, tmsize_t srcstep, uint8* dst, tmsize_t dststep)
+{
+	__m128i a[16], b[16];
+	int i, round;
+
+	for (i = 0; i < 16; i++)
+		a[i] = _mm_loadu_si128((const __m128i*)(src + i * srcstep));
+	for (round = 0; round < 4; round++) {
+		for (i = 0; i < 8; i++) {
+			b[2 * i] = _mm_unpacklo_epi8(a[i], a[i + 8]);
+			b[2 * i + 1] = _mm_unpackhi_epi8(a[i], a[i + 8]);
+		}
+		for (i = 0; i < 16; i++)
+			a[i] = b[i];
+	}
+	for (i = 0; i < 16; i++)
+		_mm_storeu_si128((__m128i*)(dst + i * dststep), a[i]);
+}
+
+TIFF_TARGET_SSE2 static void
+transpose16SSE2(const uint8* src, tmsize_t srcstep, uint8* dst, tmsize_t dststep)
+{
+	__m128i a[8], b[8];
+	int i, round;
+
+	for (i = 0; i < 8; i++)
+		a[i] = _mm_loadu_si128((const __m128i*)(src + i * srcstep));
+	for (round = 0; round < 3; round++) {
+		for (i = 0; i < 4; i++) {
+			b[2 * i] = _mm_unpacklo_epi16(a[i], a[i + 4]);
+			b[2 * i + 1] = _mm_unpackhi_epi16(a[i], a[i + 4]);
+		}
+		for (i = 0; i < 8; i++)
+			a[i] = b[i];
+	}
+	for (i = 0; i < 8; i++)
+		_mm_storeu_si128((__m128i*)(dst + i * dststep), a[i]);
+}
+#elif defined(TIFF_SIMD_NEON)
+static void
+transpose8NEON(const uint8* src, tmsize_t srcstep, uint8* dst, tmsize_t dststep)
+{
+	uint8x16_t a[16], b[16];
+	uint8x16x2_t z;
+	int i, round;
+
+	for (i = 0; i < 16; i++)
+		a[i] = vld1q_u8(src + i * srcstep);
+	for (round = 0; round < 4; round++) {
+		for (i = 0; i < 8; i++) {
+			z = vzipq_u8(a[i], a[i + 8]);
+			b[2 * i] = z.val[0];
+			b[2 * i + 1] = z.val[1];
+		}
+		for (i = 0; i < 16; i++)
+			a[i] = b[i];
+	}
+	for (i = 0; i < 16; i++)
+		vst1q_u8(dst + i * dststep, a[i]);
+}
+
+static void
+transpose16NEON(const uint8* src, tmsize_t srcstep, uint8* dst, tmsize_t dststep)
+{
+	uint16x8_t a[8], b[8];
+	uint16x8x2_t z;
+	int i, round;
+
+	for (i = 0; i < 8; i++)
+		a[i] = vreinterpretq_u16_u8(vld1q_u8(src + i * srcstep));
+	for (round = 0; round < 3; round++) {
+		for (i = 0; i < 4; i++) {
+			z = vzipq_u16(a[i], a[i + 4]);
+			b[2 * i] = z.val[0];
+			b[2 * i + 1] = z.val[1];
+		}
+		for (i = 0; i < 8; i++)
+			a[i] = b[i];
+	}
+	for (i = 0; i < 8; i++)
+		vst1q_u8(dst + i * dststep, vreinterpretq_u8_u16(a[i]));
+}
+#endif
+
+void
+_TIFFOrientKernels(TIFFKernels* k, int features)
+{
+#if defined(TIFF_SIMD_X86)
+	if (features & TIFF_CPU_SSE2) {
+		k->transpose8 = transpose8SSE2;
+		k->transpose16 = transpose16SSE2;
+	}
+#elif defined(TIFF_SIMD_NEON)
+	if (features & TIFF_CPU_NEON) {
+		k->transpose8 = transpose8NEON;
+		k->transpose16 = transpose16NEON;
+	}
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+/*
+ * Return the stored column and row of the pixel that an image of
+ * width by length pixels with the given orientation shows at column
+ * x and row y.
+ */
+static void
+orientSource(uint16 orientation, uint32 width, uint32 length,
+    uint32 x, uint32 y, uint32* col, uint32* row)
+{
+	switch (orientation) {
+	case ORIENTATION_TOPRIGHT:
+		*col = width - 1 - x; *row = y; break;
+	case ORIENTATION_BOTRIGHT:
+		*col = width - 1 - x; *row = length - 1 - y; break;
+	case ORIENTATION_BOTLEFT:
+		*col = x; *row = length - 1 - y; break;
+	case ORIENTATION_LEFTTOP:
+		*col = y; *row = x; break;
+	case ORIENTATION_RIGHTTOP:
+		*col = y; *row = length - 1 - x; break;
+	case ORIENTATION_RIGHTBOT:
+		*col = width - 1 - y; *row = length - 1 - x; break;
+	case ORIENTATION_LEFTBOT:
+		*col = width - 1 - y; *row = x; break;
+	default:
+		*col = x; *row = y; break;
+	}
+}
+
+/*
+ * Copy the w by h pixels of pixsize bytes at src, whose rows are
+ * srcstride bytes apart, to dst as they are shown with the given
+ * orientation, that is re-arranged into ORIENTATION_TOPLEFT.  The
+ * result has h by w pixels for the orientations from
+ * ORIENTATION_LEFTTOP on, w by h pixels otherwise; its rows are
+ * dststride bytes apart.  For example ORIENTATION_RIGHTTOP rotates the
+ * pixels by 90 degrees clockwise and ORIENTATION_TOPRIGHT mirrors
+ * them.  src and dst must not overlap.
+ */
+void
+TIFFOrientPixels(uint8* dst, tmsize_t dststride, const uint8* src,
+    tmsize_t srcstride, uint32 w, uint32 h, uint32 pixsize, int orientation)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	void (*transpose)(const uint8*, tmsize_t, uint8*, tmsize_t) = NULL;
+	tmsize_t ps = (tmsize_t) pixsize;
+	tmsize_t xstep, ystep;
+	const uint8* origin = src;
+	const uint8* s;
+	uint8* d;
+	uint32 dw = w, dh = h, x, y, x0, y0, x1, y1, i, n = 0;
+
+	if (w == 0 || h == 0 || pixsize == 0)
+		return;
+	/* Source steps to the next destination column and row */
+	switch (orientation) {
+	case ORIENTATION_TOPRIGHT:
+		origin += (tmsize_t)(w - 1) * ps;
+		xstep = -ps; ystep = srcstride;
+		break;
+	case ORIENTATION_BOTRIGHT:
+		origin += (tmsize_t)(h - 1) * srcstride + (tmsize_t)(w - 1) * ps;
+		xstep = -ps; ystep = -srcstride;
+		break;
+	case ORIENTATION_BOTLEFT:
+		origin += (tmsize_t)(h - 1) * srcstride;
+		xstep = ps; ystep = -srcstride;
+		break;
+	case ORIENTATION_LEFTTOP:
+		xstep = srcstride; ystep = ps;
+		break;
+	case ORIENTATION_RIGHTTOP:
+		origin += (tmsize_t)(h - 1) * srcstride;
+		xstep = -srcstride; ystep = ps;
+		break;
+	case ORIENTATION_RIGHTBOT:
+		origin += (tmsize_t)(h - 1) * srcstride + (tmsize_t)(w - 1) * ps;
+		xstep = -srcstride; ystep = -ps;
+		break;
+	case ORIENTATION_LEFTBOT:
+		origin += (tmsize_t)(w - 1) * ps;
+		xstep = srcstride; ystep = -ps;
+		break;
+	default:
+		xstep = ps; ystep = srcstride;
+		break;
+	}
+
+	if (orientation < ORIENTATION_LEFTTOP ||
+	    orientation > ORIENTATION_LEFTBOT) {
+		/* Rows stay rows: copy or reverse them one at a time */
+		for (y = 0; y < dh; y++) {
+			s = origin + (tmsize_t) y * ystep;
+			d = dst + (tmsize_t) y * dststride;
+			if (xstep > 0) {
+				_TIFFmemcpy(d, s, (tmsize_t) dw * ps);
+				continue;
+			}
+			for (x = 0; x < dw; x++, s -= ps, d += ps)
+				for (i = 0; i < pixsize; i++)
+					d[i] = s[i];
+		}
+		return;
+	}
+
+	dw = h;
+	dh = w;
+	if (pixsize == 1 && k->transpose8) {
+		transpose = k->transpose8;
+		n = 16;
+	} else if (pixsize == 2 && k->transpose16) {
+		transpose = k->transpose16;
+		n = 8;
+	}
+	for (y0 = 0; y0 < dh; y0 += ORIENT_BLOCK) {
+		y1 = dh - y0 > ORIENT_BLOCK ? y0 + ORIENT_BLOCK : dh;
+		for (x0 = 0; x0 < dw; x0 += ORIENT_BLOCK) {
+			x1 = dw - x0 > ORIENT_BLOCK ? x0 + ORIENT_BLOCK : dw;
+			if (transpose && y1 - y0 == ORIENT_BLOCK &&
+			    x1 - x0 == ORIENT_BLOCK) {
+				/*
+				 * Source pixels of a destination column are
+				 * adjacent; when they run upwards the block is
+				 * stored from its last row up.
+				 */
+				for (y = y0; y < y1; y += n) {
+					uint32 yr = ystep > 0 ? y : y + n - 1;
+
+					for (x = x0; x < x1; x += n)
+						transpose(origin +
+						    (tmsize_t) x * xstep +
+						    (tmsize_t) yr * ystep, xstep,
+						    dst + (tmsize_t) yr * dststride +
+						    (tmsize_t) x * ps,
+						    ystep > 0 ? dststride : -dststride);
+				}
+				continue;
+			}
+			for (y = y0; y < y1; y++) {
+				s = origin + (tmsize_t) x0 * xstep +
+				    (tmsize_t) y * ystep;
+				d = dst + (tmsize_t) y * dststride +
+				    (tmsize_t) x0 * ps;
+				for (x = x0; x < x1; x++, s += xstep, d += ps)
+					for (i = 0; i < pixsize; i++)
+						d[i] = s[i];
+			}
+		}
+	}
+}
+
+/*
+ * Tags copied as they are by TIFFReorientDirectory().
+ */
+static const struct {
+	uint32 tag;
+	int count;			/* 1, 2 or -1 for an array */
+	TIFFDataType type;
+} orientTags[] = {
+	{ TIFFTAG_SUBFILETYPE,		1, TIFF_LONG },
+	{ TIFFTAG_THRESHHOLDING,	1, TIFF_SHORT },
+	{ TIFFTAG_DOCUMENTNAME,		1, TIFF_ASCII },
+	{ TIFFTAG_IMAGEDESCRIPTION,	1, TIFF_ASCII },
+	{ TIFFTAG_MAKE,			1, TIFF_ASCII },
+	{ TIFFTAG_MODEL,		1, TIFF_ASCII },
+	{ TIFFTAG_MINSAMPLEVALUE,	1, TIFF_SHORT },
+	{ TIFFTAG_MAXSAMPLEVALUE,	1, TIFF_SHORT },
+	{ TIFFTAG_PAGENAME,		1, TIFF_ASCII },
+	{ TIFFTAG_RESOLUTIONUNIT,	1, TIFF_SHORT },
+	{ TIFFTAG_PAGENUMBER,		2, TIFF_SHORT },
+	{ TIFFTAG_SOFTWARE,		1, TIFF_ASCII },
+	{ TIFFTAG_DATETIME,		1, TIFF_ASCII },
+	{ TIFFTAG_ARTIST,		1, TIFF_ASCII },
+	{ TIFFTAG_HOSTCOMPUTER,		1, TIFF_ASCII },
+	{ TIFFTAG_WHITEPOINT,		-1, TIFF_RATIONAL },
+	{ TIFFTAG_PRIMARYCHROMATICITIES,-1, TIFF_RATIONAL },
+	{ TIFFTAG_HALFTONEHINTS,	2, TIFF_SHORT },
+	{ TIFFTAG_INKSET,		1, TIFF_SHORT },
+	{ TIFFTAG_DOTRANGE,		2, TIFF_SHORT },
+	{ TIFFTAG_TARGETPRINTER,	1, TIFF_ASCII },
+	{ TIFFTAG_SAMPLEFORMAT,		1, TIFF_SHORT },
+	{ TIFFTAG_YCBCRCOEFFICIENTS,	-1, TIFF_RATIONAL },
+	{ TIFFTAG_YCBCRPOSITIONING,	1, TIFF_SHORT },
+	{ TIFFTAG_REFERENCEBLACKWHITE,	-1, TIFF_RATIONAL },
+	{ TIFFTAG_SMINSAMPLEVALUE,	1, TIFF_DOUBLE },
+	{ TIFFTAG_SMAXSAMPLEVALUE,	1, TIFF_DOUBLE },
+	{ TIFFTAG_STONITS,		1, TIFF_DOUBLE },
+	{ TIFFTAG_COPYRIGHT,		1, TIFF_ASCII },
+};
+#define	NORIENTTAGS	(sizeof (orientTags) / sizeof (orientTags[0]))
+
+static int
+orientCopyTag(TIFF* in, TIFF* out, uint32 tag, int count, TIFFDataType type)
+{
+	switch (type) {
+	case TIFF_SHORT:
+		if (count == 1) {
+			uint16 v;
+			if (TIFFGetField(in, tag, &v))
+				return TIFFSetField(out, tag, v);
+		} else {
+			uint16 v1, v2;
+			if (TIFFGetField(in, tag, &v1, &v2))
+				return TIFFSetField(out, tag, v1, v2);
+		}
+		break;
+	case TIFF_LONG:
+		{
+			uint32 v;
+			if (TIFFGetField(in, tag, &v))
+				return TIFFSetField(out, tag, v);
+		}
+		break;
+	case TIFF_RATIONAL:
+		{
+			float* v;
+			if (TIFFGetField(in, tag, &v))
+				return TIFFSetField(out, tag, v);
+		}
+		break;
+	case TIFF_ASCII:
+		{
+			char* v;
+			if (TIFFGetField(in, tag, &v))
+				return TIFFSetField(out, tag, v);
+		}
+		break;
+	case TIFF_DOUBLE:
+		{
+			double v;
+			if (TIFFGetField(in, tag, &v))
+				return TIFFSetField(out, tag, v);
+		}
+		break;
+	default:
+		break;
+	}
+	return (1);
+}
+
+/*
+ * Set up the current directory of out for the re-oriented copy of the
+ * current directory of in, whose Photometric is photometric after any
+ * JPEG color conversion.
+ */
+static int
+orientSetupDirectory(TIFF* in, TIFF* out, int transposed,
+    uint16 photometric)
+{
+	TIFFDirectory* td = &in->tif_dir;
+	TIFFDirectory* otd = &out->tif_dir;
+	uint16 compression = otd->td_compression;
+	uint16 predictor, count, *extra, *red, *green, *blue;
+	uint32 length, tw, tl, rowsperstrip;
+	float xres, yres;
+	void* icc;
+	size_t i;
+
+	if (!TIFFSetField(out, TIFFTAG_IMAGEWIDTH,
+		transposed ? td->td_imagelength : td->td_imagewidth) ||
+	    !TIFFSetField(out, TIFFTAG_IMAGELENGTH,
+		transposed ? td->td_imagewidth : td->td_imagelength) ||
+	    !TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, td->td_bitspersample) ||
+	    !TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL,
+		td->td_samplesperpixel) ||
+	    !TIFFSetField(out, TIFFTAG_PLANARCONFIG, td->td_planarconfig) ||
+	    !TIFFSetField(out, TIFFTAG_PHOTOMETRIC, photometric) ||
+	    !TIFFSetField(out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT))
+		return (0);
+	for (i = 0; i < NORIENTTAGS; i++)
+		if (!orientCopyTag(in, out, orientTags[i].tag,
+		    orientTags[i].count, orientTags[i].type))
+			return (0);
+	if (TIFFGetField(in, TIFFTAG_EXTRASAMPLES, &count, &extra) &&
+	    !TIFFSetField(out, TIFFTAG_EXTRASAMPLES, count, extra))
+		return (0);
+	if (TIFFGetField(in, TIFFTAG_COLORMAP, &red, &green, &blue) &&
+	    !TIFFSetField(out, TIFFTAG_COLORMAP, red, green, blue))
+		return (0);
+	if (TIFFGetField(in, TIFFTAG_ICCPROFILE, &length, &icc) &&
+	    !TIFFSetField(out, TIFFTAG_ICCPROFILE, length, icc))
+		return (0);
+	/* The pixel spacing follows the axes */
+	if (TIFFGetField(in, TIFFTAG_XRESOLUTION, &xres) &&
+	    !TIFFSetField(out, transposed ? TIFFTAG_YRESOLUTION :
+		TIFFTAG_XRESOLUTION, xres))
+		return (0);
+	if (TIFFGetField(in, TIFFTAG_YRESOLUTION, &yres) &&
+	    !TIFFSetField(out, transposed ? TIFFTAG_XRESOLUTION :
+		TIFFTAG_YRESOLUTION, yres))
+		return (0);
+
+	/* Keep a compression scheme that the caller chose */
+	if (compression == COMPRESSION_NONE)
+		compression = td->td_compression;
+	if (!TIFFSetField(out, TIFFTAG_COMPRESSION, compression))
+		return (0);
+	if (compression == td->td_compression &&
+	    TIFFGetField(in, TIFFTAG_PREDICTOR, &predictor) &&
+	    predictor != PREDICTOR_NONE &&
+	    !TIFFSetField(out, TIFFTAG_PREDICTOR, predictor))
+		return (0);
+	if (compression == COMPRESSION_JPEG &&
+	    photometric == PHOTOMETRIC_YCBCR) {
+		if (!TIFFSetField(out, TIFFTAG_YCBCRSUBSAMPLING,
+			td->td_ycbcrsubsampling[0], td->td_ycbcrsubsampling[1]) ||
+		    !TIFFSetField(out, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB))
+			return (0);
+	}
+
+	/* Keep tiles or strips that the caller chose, else use those of in */
+	if (TIFFFieldSet(out, FIELD_TILEDIMENSIONS))
+		return (1);
+	if (!TIFFFieldSet(out, FIELD_ROWSPERSTRIP) && isTiled(in)) {
+		tw = transposed ? td->td_tilelength : td->td_tilewidth;
+		tl = transposed ? td->td_tilewidth : td->td_tilelength;
+		return (TIFFSetField(out, TIFFTAG_TILEWIDTH, tw) &&
+		    TIFFSetField(out, TIFFTAG_TILELENGTH, tl));
+	}
+	if (TIFFFieldSet(out, FIELD_ROWSPERSTRIP))
+		return (1);
+	rowsperstrip = transposed || isTiled(in) ? TIFFDefaultStripSize(out, 0) :
+	    td->td_rowsperstrip;
+	return (TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rowsperstrip));
+}
+
+/*
+ * Write the band of nrows output rows from row in band, whose rows
+ * are rowsize bytes apart, to the strips or tiles of sample plane s.
+ */
+static int
+orientWriteBand(TIFF* out, uint8* band, tmsize_t rowsize, uint32 row,
+    uint32 nrows, uint16 s, uint8* tilebuf, tmsize_t tilesize,
+    tmsize_t pixsize)
+{
+	TIFFDirectory* td = &out->tif_dir;
+	uint32 r, x, i, n, ncols;
+
+	if (!isTiled(out)) {
+		uint32 rps = td->td_rowsperstrip;
+
+		for (r = 0; r < nrows; r += rps) {
+			n = nrows - r < rps ? nrows - r : rps;
+			if (TIFFWriteEncodedStrip(out,
+			    TIFFComputeStrip(out, row + r, s),
+			    band + (tmsize_t) r * rowsize,
+			    (tmsize_t) n * rowsize) == (tmsize_t)(-1))
+				return (0);
+		}
+		return (1);
+	}
+	for (r = 0; r < nrows; r += td->td_tilelength) {
+		n = nrows - r < td->td_tilelength ? nrows - r : td->td_tilelength;
+		for (x = 0; x < td->td_imagewidth; x += td->td_tilewidth) {
+			tmsize_t tilerow = (tmsize_t) td->td_tilewidth * pixsize;
+
+			ncols = td->td_imagewidth - x < td->td_tilewidth ?
+			    td->td_imagewidth - x : td->td_tilewidth;
+			if (ncols < td->td_tilewidth || n < td->td_tilelength)
+				_TIFFmemset(tilebuf, 0, tilesize);
+			for (i = 0; i < n; i++)
+				_TIFFmemcpy(tilebuf + i * tilerow,
+				    band + (tmsize_t)(r + i) * rowsize +
+				    (tmsize_t) x * pixsize,
+				    (tmsize_t) ncols * pixsize);
+			if (TIFFWriteEncodedTile(out,
+			    TIFFComputeTile(out, x, row + r, 0, s),
+			    tilebuf, tilesize) == (tmsize_t)(-1))
+				return (0);
+		}
+	}
+	return (1);
+}
+
+/*
+ * Write the image of the current directory of in to a new directory of
+ * out with the pixels re-arranged as the given orientation shows them,
+ * or as the Orientation tag of in shows them if orientation is 0.  The
+ * copy has ORIENTATION_TOPLEFT, the image structure, colormap,
+ * resolution (swapped for transposed orientations) and descriptive
+ * tags of in, and its strips or tiles (transposed too).  A compression
+ * scheme other than none, and tiles or RowsPerStrip, that were set on
+ * out beforehand are kept, as are any other tags set on out.  The
+ * image is read with TIFFReadRegion() and written in bands of output
+ * rows, so memory use does not depend on the image size.  Returns 1
+ * on success and 0 on error.
+ */
+int
+TIFFReorientDirectory(TIFF* in, TIFF* out, int orientation)
+{
+	static const char module[] = "TIFFReorientDirectory";
+	TIFFDirectory* td = &in->tif_dir;
+	TIFFDirectory* otd;
+	uint16 o = (uint16)(orientation ? orientation : td->td_orientation);
+	uint16 photometric = td->td_photometric;
+	uint16 nplanes, s;
+	uint32 width = td->td_imagewidth, length = td->td_imagelength;
+	uint32 owidth, olength, chunkrows, bandrows, row, nrows;
+	uint32 c0, r0, c1, r1;
+	int jpegcolormode = -1, transposed, ret = 0;
+	tmsize_t pixsize, rowsize, bandsize, tilesize = 0;
+	uint8 *srcbuf = NULL, *band = NULL, *tilebuf = NULL;
+
+	if (o < ORIENTATION_TOPLEFT || o > ORIENTATION_LEFTBOT) {
+		TIFFErrorExtR(in, module,
+		    "Invalid orientation %d", (int) o);
+		return (0);
+	}
+	if (out->tif_mode == O_RDONLY) {
+		TIFFErrorExtR(out, module,
+		    "%s: File not open for writing", out->tif_name);
+		return (0);
+	}
+	if (td->td_bitspersample == 0 || (td->td_bitspersample % 8) != 0) {
+		TIFFErrorExtR(in, module,
+		    "Can not re-orient images with %d bits per sample",
+		    (int) td->td_bitspersample);
+		return (0);
+	}
+	if (td->td_compression == COMPRESSION_OJPEG) {
+		TIFFErrorExtR(in, module,
+		    "Can not re-orient old-style JPEG images");
+		return (0);
+	}
+	if (photometric == PHOTOMETRIC_YCBCR) {
+		if (td->td_compression == COMPRESSION_JPEG) {
+			/* Read RGB, and write it as YCbCr again with JPEG */
+			TIFFGetField(in, TIFFTAG_JPEGCOLORMODE, &jpegcolormode);
+			if (!TIFFSetField(in, TIFFTAG_JPEGCOLORMODE,
+			    JPEGCOLORMODE_RGB))
+				return (0);
+			if (out->tif_dir.td_compression != COMPRESSION_NONE &&
+			    out->tif_dir.td_compression != COMPRESSION_JPEG)
+				photometric = PHOTOMETRIC_RGB;
+		} else if (td->td_ycbcrsubsampling[0] != 1 ||
+		    td->td_ycbcrsubsampling[1] != 1) {
+			TIFFErrorExtR(in, module,
+			    "Can not re-orient subsampled YCbCr images");
+			return (0);
+		}
+	}
+
+	transposed = o >= ORIENTATION_LEFTTOP;
+	owidth = transposed ? length : width;
+	olength = transposed ? width : length;
+	if (!orientSetupDirectory(in, out, transposed, photometric))
+		goto done;
+	otd = &out->tif_dir;
+
+	pixsize = td->td_bitspersample / 8;
+	nplanes = 1;
+	if (td->td_planarconfig == PLANARCONFIG_SEPARATE)
+		nplanes = td->td_samplesperpixel;
+	else
+		pixsize *= td->td_samplesperpixel;
+	rowsize = (tmsize_t) owidth * pixsize;
+	if (rowsize / pixsize != (tmsize_t) owidth) {
+		TIFFErrorExtR(in, module, "Integer overflow");
+		goto done;
+	}
+	chunkrows = isTiled(out) ? otd->td_tilelength : otd->td_rowsperstrip;
+	if (chunkrows == 0 || chunkrows > olength)
+		chunkrows = olength;
+	bandrows = chunkrows;
+	if ((tmsize_t) chunkrows * rowsize < ORIENT_BANDSIZE)
+		bandrows *= (uint32)(ORIENT_BANDSIZE /
+		    ((tmsize_t) chunkrows * rowsize));
+	if (bandrows > olength)
+		bandrows = olength;
+	bandsize = (tmsize_t) bandrows * rowsize;
+	if (bandsize / rowsize != (tmsize_t) bandrows) {
+		TIFFErrorExtR(in, module, "Integer overflow");
+		goto done;
+	}
+	srcbuf = (uint8*) _TIFFmallocExt(in, bandsize);
+	band = (uint8*) _TIFFmallocExt(in, bandsize);
+	if (isTiled(out)) {
+		tilesize = TIFFTileSize(out);
+		if (tilesize < (tmsize_t) otd->td_tilewidth *
+		    otd->td_tilelength * pixsize) {
+			TIFFErrorExtR(out, module,
+			    "Can not write subsampled tiles");
+			goto done;
+		}
+		tilebuf = (uint8*) _TIFFmallocExt(in, tilesize);
+	}
+	if (srcbuf == NULL || band == NULL ||
+	    (isTiled(out) && tilebuf == NULL)) {
+		TIFFErrorExtR(in, module,
+		    "No space for re-orientation buffers");
+		goto done;
+	}
+
+	for (row = 0; row < olength; row += bandrows) {
+		nrows = olength - row < bandrows ? olength - row : bandrows;
+		/* The stored area of in that shows as these rows */
+		orientSource(o, width, length, 0, row, &c0, &r0);
+		orientSource(o, width, length, owidth - 1, row + nrows - 1,
+		    &c1, &r1);
+		if (c1 < c0) {
+			uint32 t = c0; c0 = c1; c1 = t;
+		}
+		if (r1 < r0) {
+			uint32 t = r0; r0 = r1; r1 = t;
+		}
+		for (s = 0; s < nplanes; s++) {
+			if (!TIFFReadRegion(in, c0, r0, c1 - c0 + 1,
+			    r1 - r0 + 1, s, srcbuf, 0))
+				goto done;
+			TIFFOrientPixels(band, rowsize, srcbuf,
+			    (tmsize_t)(c1 - c0 + 1) * pixsize, c1 - c0 + 1,
+			    r1 - r0 + 1, (uint32) pixsize, o);
+			if (!orientWriteBand(out, band, rowsize, row, nrows, s,
+			    tilebuf, tilesize, pixsize)) {
+				TIFFErrorExtR(out, module,
+				    "Can not write rows %lu to %lu",
+				    (unsigned long) row,
+				    (unsigned long)(row + nrows - 1));
+				goto done;
+			}
+		}
+	}
+	ret = TIFFWriteDirectory(out);
+
+done:
+	if (jpegcolormode != -1)
+		TIFFSetField(in, TIFFTAG_JPEGCOLORMODE, jpegcolormode);
+	if (srcbuf)
+		_TIFFfreeExt(in, srcbuf);
+	if (band)
+		_TIFFfreeExt(in, band);
+	if (tilebuf)
+		_TIFFfreeExt(in, tilebuf);
+	return (ret);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -30,13 +30,50 @@
  * PackBits Compression Algorithm Support
  */
 #include <stdio.h>
+#include <string.h>
+
+/*
+ * The run detector of the encoder compares 8 bytes at a time;
+ * PackBitsWord() is an unaligned load and HasZeroByte() is
+ * non-zero if any byte of its argument is 0.
+ */
+#define	PackBitsWord(w, p)	memcpy(&(w), (p), sizeof (uint64))
+#define	ONES64		(~(uint64) 0 / 0xff)	/* 0x0101...01 */
+#define	HasZeroByte(v)	(((v) - ONES64) & ~(v) & (ONES64 << 7))
+
+/*
+ * Return the number of bytes, at most max, from the start of
+ * bp that are each followed by a different byte (or by the end
+ * of the data), i.e. that would be encoded one by one as part
+ * of a literal.
+ */
+static tmsize_t
+PackBitsCountLiteral(const uint8* bp, tmsize_t cc, tmsize_t max)
+{
+	tmsize_t i = 0;
+	uint64 w0, w1;
+
+	if (max > cc)
+		max = cc;
+	while (i + 8 < cc && i + 8 <= max) {
+		PackBitsWord(w0, bp + i);
+		PackBitsWord(w1, bp + i + 1);
+		w0 ^= w1;
+		if (HasZeroByte(w0))
+			break;
+		i += 8;
+	}
+	while (i < max && (i + 1 == cc || bp[i] != bp[i + 1]))
+		i++;
+	return (i);
+}
 
 static int
 PackBitsPreEncode(TIFF* tif, uint16 s)
 {
 	(void) s;
 
-        tif->tif_data = (uint8*)_TIFFmalloc(sizeof(tmsize_t));
+        tif->tif_data = (uint8*)_TIFFmallocExt(tif, sizeof(tmsize_t));
 	if (tif->tif_data == NULL)
 		return (0);
 	/*
@@ -53,7 +90,7 @@ static int
 PackBitsPostEncode(TIFF* tif)
 {
         if (tif->tif_data)
-            _TIFFfree(tif->tif_data);
+            _TIFFfreeExt(tif, tif->tif_data);
 	return (1);
 }
 
@@ -80,9 +117,40 @@ PackBitsEncode(TIFF* tif, uint8* buf, tmsize_t cc, uint16 s)
 		/*
 		 * Find the longest string of identical bytes.
 		 */
+		if (state == LITERAL) {
+			/*
+			 * Append bytes that don't start a run to the
+			 * current literal in one go.  The result is the
+			 * same as taking them one at a time below.
+			 */
+			tmsize_t max = 127 - *lastliteral;
+
+			if (max > ep - op - 3)
+				max = ep - op - 3;
+			if (max > 0 && (n = (long)
+			    PackBitsCountLiteral(bp, cc, max)) > 0) {
+				_TIFFmemcpy(op, bp, n);
+				op += n;
+				bp += n;
+				cc -= n;
+				if ((*lastliteral += (uint8) n) == 127)
+					state = BASE;
+				continue;
+			}
+		}
 		b = *bp++;
 		cc--;
 		n = 1;
+		if (cc >= 8 && b == *bp) {
+			uint64 run = ONES64 * (uint64) b;
+			uint64 w;
+
+			for (; cc >= 8; cc -= 8, bp += 8, n += 8) {
+				PackBitsWord(w, bp);
+				if (w != run)
+					break;
+			}
+		}
 		for (; cc > 0 && b == *bp; cc--, bp++)
 			n++;
 	again:
@@ -237,33 +305,33 @@ PackBitsDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 			n = -n + 1;
 			if( occ < (tmsize_t)n )
 			{
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 				    "Discarding %lu bytes to avoid buffer overrun",
 				    (unsigned long) ((tmsize_t)n - occ));
 				n = (long)occ;
 			}
 			if( cc == 0 )
 			{
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 					       "Terminating PackBitsDecode due to lack of data.");
 				break;
 			}
 			occ -= n;
 			b = *bp++;
 			cc--;
-			while (n-- > 0)
-				*op++ = (uint8) b;
+			_TIFFmemset(op, b, n);
+			op += n;
 		} else {		/* copy next n+1 bytes literally */
 			if (occ < (tmsize_t)(n + 1))
 			{
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 				    "Discarding %lu bytes to avoid buffer overrun",
 				    (unsigned long) ((tmsize_t)n - occ + 1));
 				n = (long)occ - 1;
 			}
 			if (cc < (tmsize_t) (n+1)) 
 			{
-				TIFFWarningExt(tif->tif_clientdata, module,
+				TIFFWarningExtR(tif, module,
 					       "Terminating PackBitsDecode due to lack of data.");
 				break;
 			}
@@ -275,7 +343,7 @@ PackBitsDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 	tif->tif_rawcp = (uint8*) bp;
 	tif->tif_rawcc = cc;
 	if (occ > 0) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Not enough data for scanline %lu",
 		    (unsigned long) tif->tif_row);
 		return (0);
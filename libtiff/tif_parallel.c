@@ -0,0 +1,1921 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Multi-threaded decoding and encoding of strips and tiles.
+ *
+ * A TIFF handle carries per-directory codec state and is not safe to
+ * share between threads.  To decode several strips or tiles at once,
+ * a set of private read-only ``worker'' handles is opened on the same
+ * client data and positioned on the current directory.  Raw reads go
+ * through the caller's handle under a mutex (or, for memory-mapped
+ * files, straight out of the mapping without locking), while the
+ * decompression itself runs concurrently on the workers.  Workers are
+ * cached on the handle and released by TIFFCleanup().
+ */
+#include "tiffiop.h"
+
+#define	TIFF_SIZE_T_MAX		((size_t) ~ ((size_t)0))
+#define	TIFF_TMSIZE_T_MAX	(tmsize_t)(TIFF_SIZE_T_MAX >> 1)
+
+/*
+ * Codec pseudo-tags that change what a decoder produces and that
+ * must therefore be mirrored from the caller's handle to the workers.
+ */
+static const struct {
+	uint16	compression;
+	uint32	tag;
+} decodeTags[] = {
+	{ COMPRESSION_JPEG,		TIFFTAG_JPEGCOLORMODE },
+	{ COMPRESSION_JPEG,		TIFFTAG_JPEGSCALEDENOM },
+	{ COMPRESSION_PIXARLOG,		TIFFTAG_PIXARLOGDATAFMT },
+	{ COMPRESSION_SGILOG,		TIFFTAG_SGILOGDATAFMT },
+	{ COMPRESSION_SGILOG24,		TIFFTAG_SGILOGDATAFMT },
+};
+
+typedef struct {
+	TIFF*		worker;		/* private decoding handle */
+	const uint32*	striles;	/* strips/tiles to decode */
+	uint32		nstriles;
+	void**		bufs;		/* one output buffer per entry */
+	tmsize_t	bufsize;
+	TIFFMutex*	jobmutex;	/* protects next and failed */
+	uint32*		next;		/* next entry to be picked up */
+	int*		failed;		/* set on first error */
+} TIFFDecodeJob;
+
+static int
+_tiffWorkerCloseProc(thandle_t fd)
+{
+	(void) fd;
+	return (0);
+}
+
+/*
+ * Workers allocate through the same callbacks as the caller's handle
+ * and charge their memory to its account, which then needs a lock,
+ * and report through its error and warning handlers.
+ * *popts is set to the options to open workers with, NULL for the
+ * defaults.  Returns 0 if the lock cannot be created.
+ */
+static int
+_TIFFWorkerOptions(TIFF* tif, TIFFOpenOptions* opts, TIFFOpenOptions** popts)
+{
+	TIFF* acct = tif->tif_memaccount;
+
+	*popts = NULL;
+	if (acct == NULL && tif->tif_stats == NULL &&
+	    tif->tif_errorhandler == NULL && tif->tif_warnhandler == NULL &&
+	    !(tif->tif_flags & TIFF_NOWARNINGS))
+		return (1);
+	_TIFFmemset(opts, 0, sizeof(TIFFOpenOptions));
+	opts->statistics = tif->tif_stats != NULL;
+	/* workers report through the handlers of the caller's handle */
+	opts->errorhandler = tif->tif_errorhandler;
+	opts->errorhandler_user_data = tif->tif_errorhandler_user_data;
+	opts->warnhandler = tif->tif_warnhandler;
+	opts->warnhandler_user_data = tif->tif_warnhandler_user_data;
+	opts->nowarnings = (tif->tif_flags & TIFF_NOWARNINGS) != 0;
+	*popts = opts;
+	if (acct == NULL)
+		return (1);
+	if (acct->tif_memmutex == NULL &&
+	    (acct->tif_memmutex = _TIFFMutexCreate()) == NULL)
+		return (0);
+	opts->mallocproc = tif->tif_mallocproc;
+	opts->reallocproc = tif->tif_reallocproc;
+	opts->freeproc = tif->tif_freeproc;
+	opts->allocctx = tif->tif_allocctx;
+	opts->maxmemalloc = 0;
+	opts->memaccount = acct;
+	return (1);
+}
+
+void
+_TIFFFreeDecodeWorkers(TIFF* tif)
+{
+	int i;
+
+	for (i = 0; i < tif->tif_nworkers; i++)
+		TIFFCleanup(tif->tif_workers[i]);
+	if (tif->tif_workers)
+		_TIFFfreeExt(tif, tif->tif_workers);
+	tif->tif_workers = NULL;
+	tif->tif_nworkers = 0;
+	tif->tif_workersdiroff = 0;
+	if (tif->tif_iomutex) {
+		_TIFFMutexDestroy(tif->tif_iomutex);
+		tif->tif_iomutex = NULL;
+	}
+	if (tif->tif_decodemutex) {
+		_TIFFMutexDestroy(tif->tif_decodemutex);
+		tif->tif_decodemutex = NULL;
+	}
+	/* raw data buffer of a worker */
+	if (tif->tif_sharedraw) {
+		_TIFFfreeExt(tif, tif->tif_sharedraw);
+		tif->tif_sharedraw = NULL;
+		tif->tif_sharedrawsize = 0;
+	}
+}
+
+static TIFF*
+_TIFFOpenDecodeWorker(TIFF* tif)
+{
+	TIFFOpenOptions opts, *popts;
+	TIFF* w;
+	char mode[8];
+
+	if (!_TIFFWorkerOptions(tif, &opts, &popts))
+		return (NULL);
+	/* cached handles keep no file position to open the worker at */
+	if (popts != NULL)
+		_TIFFBlockCacheOptions(tif, popts);
+	strcpy(mode, "rhm");
+	strcat(mode, (tif->tif_flags & TIFF_STRIPCHOP) ? "C" : "c");
+	if (tif->tif_flags & TIFF_LAZYSTRILELOAD)
+		strcat(mode, "O");
+	/* TIFFClientOpen() reads the header from the current position */
+	if (!SeekOK(tif, 0))
+		return (NULL);
+	w = TIFFClientOpenExt(tif->tif_name, mode, tif->tif_clientdata,
+	    tif->tif_readproc, tif->tif_writeproc, tif->tif_seekproc,
+	    _tiffWorkerCloseProc, tif->tif_sizeproc,
+	    tif->tif_mapproc, tif->tif_unmapproc, popts);
+	if (w == NULL)
+		return (NULL);
+	w->tif_flags = (w->tif_flags & ~TIFF_FILLORDER) |
+	    (tif->tif_flags & TIFF_FILLORDER);
+	w->tif_master = tif;
+	if (!TIFFSetSubDirectory(w, tif->tif_diroff) || !_TIFFHaveStriles(w)) {
+		TIFFCleanup(w);
+		return (NULL);
+	}
+	return (w);
+}
+
+/*
+ * Make sure at least n worker handles positioned on the current
+ * directory are available, and bring their codec settings in line
+ * with those of the caller's handle.
+ */
+int
+_TIFFGetDecodeWorkers(TIFF* tif, int n)
+{
+	TIFF** workers;
+	size_t i;
+	int j;
+
+	if (tif->tif_workers != NULL && tif->tif_workersdiroff != tif->tif_diroff)
+		_TIFFFreeDecodeWorkers(tif);
+	if (tif->tif_iomutex == NULL) {
+		tif->tif_iomutex = _TIFFMutexCreate();
+		if (tif->tif_iomutex == NULL)
+			return (0);
+	}
+	if (n > tif->tif_nworkers) {
+		workers = (TIFF**) _TIFFreallocExt(tif, tif->tif_workers,
+		    n * sizeof(TIFF*));
+		if (workers == NULL)
+			return (0);
+		tif->tif_workers = workers;
+		while (tif->tif_nworkers < n) {
+			TIFF* w = _TIFFOpenDecodeWorker(tif);
+			if (w == NULL)
+				return (0);
+			tif->tif_workers[tif->tif_nworkers++] = w;
+		}
+		tif->tif_workersdiroff = tif->tif_diroff;
+	}
+	for (i = 0; i < TIFFArrayCount(decodeTags); i++) {
+		int value;
+
+		if (decodeTags[i].compression != tif->tif_dir.td_compression ||
+		    !TIFFGetField(tif, decodeTags[i].tag, &value))
+			continue;
+		for (j = 0; j < n; j++)
+			TIFFSetField(tif->tif_workers[j], decodeTags[i].tag, value);
+	}
+	for (j = 0; j < n; j++) {
+		_TIFFTraceHelper(tif, tif->tif_workers[j]);
+		_TIFFCancelHelper(tif, tif->tif_workers[j]);
+		_TIFFAllocProfileHelper(tif, tif->tif_workers[j]);
+	}
+	return (1);
+}
+
+/*
+ * Return a value that differs between settings of the codec pseudo-tags
+ * that change what the decoder of the current directory produces.
+ */
+uint32
+_TIFFDecodeVariant(TIFF* tif)
+{
+	uint32 variant = 0;
+	size_t i;
+
+	for (i = 0; i < TIFFArrayCount(decodeTags); i++) {
+		int value;
+
+		if (decodeTags[i].compression == tif->tif_dir.td_compression &&
+		    TIFFGetField(tif, decodeTags[i].tag, &value))
+			variant = variant * 31 + (uint32) value + 1;
+	}
+	return (variant);
+}
+
+/*
+ * Return non-zero if strips or tiles of the current directory can be
+ * decoded by worker handles.  Codecs that do their own I/O cannot
+ * share the file between handles, and a directory being modified
+ * cannot be re-read by the workers.
+ */
+int
+_TIFFCanDecodeInParallel(TIFF* tif)
+{
+	return (_TIFFHaveThreads() &&
+	    (tif->tif_flags & (TIFF_NOREADRAW|TIFF_DIRTYDIRECT)) == 0);
+}
+
+/*
+ * Decode a strip or tile on a worker handle, into a buffer of bufsize
+ * bytes (-1 for a whole chunk).  The raw data is read through the
+ * handle the worker was opened from.  Returns the number of decoded
+ * bytes, or -1 on error.
+ */
+tmsize_t
+_TIFFReadEncodedShared(TIFF* worker, uint32 strile, void* buf,
+    tmsize_t bufsize)
+{
+	static const char module[] = "_TIFFReadEncodedShared";
+	TIFF* tif = worker->tif_master;
+	TIFFDirectory* td = &tif->tif_dir;
+	uint64 bytecount;
+	tmsize_t chunksize, nread;
+	uint8* raw;
+
+	if (_TIFFCheckCancel(worker, module))
+		return ((tmsize_t)(-1));
+	if (strile >= td->td_nstrips) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: Strip/tile out of range, max %lu",
+		    (unsigned long) strile, (unsigned long) td->td_nstrips);
+		return ((tmsize_t)(-1));
+	}
+	if (_TIFFIsSparseStrile(tif, strile))
+		return (_TIFFReadEncodedChunkFromBuffer(worker, strile, NULL, 0,
+		    buf, bufsize));
+	bytecount = TIFFGetStrileByteCount(tif, strile);
+	if ((int64)bytecount <= 0) {
+		TIFFErrorExtR(tif, module,
+		    "Invalid strip/tile byte count, strip/tile %lu",
+		    (unsigned long) strile);
+		return ((tmsize_t)(-1));
+	}
+	/* Same sanity limit as TIFFFillStrip() and TIFFFillTile() */
+	chunksize = isTiled(tif) ? tif->tif_tilesize : TIFFStripSize(worker);
+	if (bytecount > 1024 * 1024 && chunksize != 0 &&
+	    (bytecount - 4096) / 10 > (uint64)chunksize)
+		bytecount = (uint64)chunksize * 10 + 4096;
+	if ((uint64)(tmsize_t)bytecount != bytecount) {
+		TIFFErrorExtR(tif, module, "Integer overflow");
+		return ((tmsize_t)(-1));
+	}
+
+	if (isMapped(tif) &&
+	    (isFillOrder(tif, td->td_fillorder)
+	     || (tif->tif_flags & TIFF_NOBITREV))) {
+		/*
+		 * Reference the raw data in the mapping directly.  The
+		 * mapping is never modified, so no locking is needed.
+		 */
+		if (bytecount > (uint64)tif->tif_size ||
+		    TIFFGetStrileOffset(tif, strile) > (uint64)tif->tif_size - bytecount) {
+			TIFFErrorExtR(tif, module,
+			    "Read error on strip/tile %lu",
+			    (unsigned long) strile);
+			return ((tmsize_t)(-1));
+		}
+		raw = tif->tif_base + (tmsize_t)TIFFGetStrileOffset(tif, strile);
+		nread = (tmsize_t)bytecount;
+	} else {
+		if ((tmsize_t)bytecount > worker->tif_sharedrawsize) {
+			uint8* p = (uint8*) _TIFFreallocExt(worker,
+			    worker->tif_sharedraw, (tmsize_t)bytecount);
+			if (p == NULL) {
+				TIFFErrorExtR(tif, module,
+				    "No space for raw data buffer");
+				return ((tmsize_t)(-1));
+			}
+			worker->tif_sharedraw = p;
+			worker->tif_sharedrawsize = (tmsize_t)bytecount;
+		}
+		_TIFFTrace(worker, TIFF_TRACE_FILL, TIFF_TRACE_BEGIN, strile,
+		    bytecount);
+		if (tif->tif_readatproc != NULL) {
+			/* Positional reads need no locking */
+			nread = (*tif->tif_readatproc)(tif->tif_clientdata,
+			    worker->tif_sharedraw, (tmsize_t)bytecount,
+			    TIFFGetStrileOffset(tif, strile));
+			TIFFStatsAdd(worker, readcalls, 1);
+			if (nread > 0)
+				TIFFStatsAdd(worker, readbytes, (uint64) nread);
+			if (nread != (tmsize_t)bytecount) {
+				TIFFErrorExtR(tif, module,
+				    "Read error on strip/tile %lu",
+				    (unsigned long) strile);
+				nread = -1;
+			}
+		} else {
+			_TIFFMutexLock(tif->tif_iomutex);
+			if (isTiled(tif))
+				nread = TIFFReadRawTile(tif, strile,
+				    worker->tif_sharedraw, (tmsize_t)bytecount);
+			else
+				nread = TIFFReadRawStrip(tif, strile,
+				    worker->tif_sharedraw, (tmsize_t)bytecount);
+			_TIFFMutexUnlock(tif->tif_iomutex);
+		}
+		_TIFFTrace(worker, TIFF_TRACE_FILL,
+		    nread > 0 ? TIFF_TRACE_END : TIFF_TRACE_FAIL, strile, bytecount);
+		if (nread <= 0)
+			return ((tmsize_t)(-1));
+		raw = worker->tif_sharedraw;
+	}
+	return (_TIFFReadEncodedChunkFromBuffer(worker, strile, raw, nread,
+	    buf, bufsize));
+}
+
+static void
+_TIFFDecodeThread(void* arg)
+{
+	TIFFDecodeJob* job = (TIFFDecodeJob*) arg;
+	uint32 i;
+
+	for (;;) {
+		_TIFFMutexLock(job->jobmutex);
+		if (*job->failed || *job->next >= job->nstriles) {
+			_TIFFMutexUnlock(job->jobmutex);
+			break;
+		}
+		i = (*job->next)++;
+		_TIFFMutexUnlock(job->jobmutex);
+
+		if (_TIFFReadEncodedShared(job->worker, job->striles[i],
+		    job->bufs[i], job->bufsize) == (tmsize_t)(-1)) {
+			_TIFFMutexLock(job->jobmutex);
+			*job->failed = 1;
+			_TIFFMutexUnlock(job->jobmutex);
+			break;
+		}
+	}
+}
+
+/*
+ * Decode the listed strips or tiles into bufs on up to nthreads worker
+ * handles, for TIFFReadEncodedTilesParallel(),
+ * TIFFReadEncodedStripsParallel() and the chunk iterator.
+ */
+int
+_TIFFReadEncodedParallel(TIFF* tif, int tiles, const uint32* striles,
+    uint32 nstriles, void** bufs, tmsize_t bufsize, int nthreads,
+    const char* module)
+{
+	TIFFDecodeJob* jobs = NULL;
+	void** args = NULL;
+	TIFFMutex* jobmutex = NULL;
+	uint32 next = 0, i;
+	int failed = 0, t;
+
+	if (tif->tif_mode == O_WRONLY) {
+		TIFFErrorExtR(tif, tif->tif_name,
+		    "File not open for reading");
+		return (0);
+	}
+	if (tiles ^ isTiled(tif)) {
+		TIFFErrorExtR(tif, tif->tif_name, tiles ?
+		    "Can not read tiles from a stripped image" :
+		    "Can not read strips from a tiled image");
+		return (0);
+	}
+	/* The workers read the file with the client procedures */
+	if (!_TIFFWriteBufferFlush(tif))
+		return (0);
+	if (nstriles == 0)
+		return (1);
+	if (striles == NULL || bufs == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No strip/tile list or output buffers given");
+		return (0);
+	}
+	if (!_TIFFHaveStriles(tif))
+		return (0);
+
+	if (nthreads <= 0)
+		nthreads = _TIFFThreadConcurrency(tif);
+	if (nthreads > TIFF_MAX_WORKER_THREADS)
+		nthreads = TIFF_MAX_WORKER_THREADS;
+	if ((uint32)nthreads > nstriles)
+		nthreads = (int)nstriles;
+
+	if (nthreads > 1 && _TIFFCanDecodeInParallel(tif) &&
+	    _TIFFGetDecodeWorkers(tif, nthreads) &&
+	    (jobmutex = _TIFFMutexCreate()) != NULL) {
+		jobs = (TIFFDecodeJob*) _TIFFmallocExt(tif, nthreads * sizeof(TIFFDecodeJob));
+		args = (void**) _TIFFmallocExt(tif, nthreads * sizeof(void*));
+	}
+	if (jobs == NULL || args == NULL) {
+		if (jobs)
+			_TIFFfreeExt(tif, jobs);
+		if (args)
+			_TIFFfreeExt(tif, args);
+		_TIFFMutexDestroy(jobmutex);
+		for (i = 0; i < nstriles; i++) {
+			tmsize_t n = tiles ?
+			    TIFFReadEncodedTile(tif, striles[i], bufs[i], bufsize) :
+			    TIFFReadEncodedStrip(tif, striles[i], bufs[i], bufsize);
+			if (n == (tmsize_t)(-1))
+				return (0);
+		}
+		return (1);
+	}
+
+	for (t = 0; t < nthreads; t++) {
+		jobs[t].worker = tif->tif_workers[t];
+		jobs[t].striles = striles;
+		jobs[t].nstriles = nstriles;
+		jobs[t].bufs = bufs;
+		jobs[t].bufsize = bufsize;
+		jobs[t].jobmutex = jobmutex;
+		jobs[t].next = &next;
+		jobs[t].failed = &failed;
+		args[t] = &jobs[t];
+	}
+	_TIFFRunTasks(tif, nthreads, _TIFFDecodeThread, args);
+	for (t = 0; t < nthreads; t++)
+		_TIFFStatsMerge(tif, tif->tif_workers[t], 1);
+	_TIFFfreeExt(tif, jobs);
+	_TIFFfreeExt(tif, args);
+	_TIFFMutexDestroy(jobmutex);
+	return (!failed);
+}
+
+/*
+ * Decode the listed tiles into bufs[0..ntiles-1] using up to nthreads
+ * threads (one per processor if nthreads <= 0).  Each buffer must be
+ * able to hold bufsize bytes, or a full tile if bufsize is -1.
+ * Returns 1 if every tile was decoded, 0 otherwise.
+ */
+int
+TIFFReadEncodedTilesParallel(TIFF* tif, const uint32* tiles, uint32 ntiles,
+    void** bufs, tmsize_t bufsize, int nthreads)
+{
+	static const char module[] = "TIFFReadEncodedTilesParallel";
+
+	return (_TIFFReadEncodedParallel(tif, 1, tiles, ntiles, bufs, bufsize,
+	    nthreads, module));
+}
+
+/*
+ * Strip counterpart of TIFFReadEncodedTilesParallel().
+ */
+int
+TIFFReadEncodedStripsParallel(TIFF* tif, const uint32* strips, uint32 nstrips,
+    void** bufs, tmsize_t bufsize, int nthreads)
+{
+	static const char module[] = "TIFFReadEncodedStripsParallel";
+
+	return (_TIFFReadEncodedParallel(tif, 0, strips, nstrips, bufs, bufsize,
+	    nthreads, module));
+}
+
+/*
+ * Decoding of strips and tiles fetched by the caller.
+ *
+ * TIFFDecodeChunk() decodes on clones of the handle, made with
+ * TIFFCloneForThread() and so sharing its directory, each serving one
+ * call at a time.  Idle clones are pooled on the handle for the next
+ * calls.  As clones pin the directory of their template, the pool is
+ * emptied before the directory is changed.
+ */
+
+/*
+ * Return the lock *pm of a pool of handles, creating it on first use.
+ */
+static TIFFMutex*
+_TIFFPoolLock(TIFFMutex** pm)
+{
+	TIFFMutex* m;
+
+	_TIFFGlobalLock();
+	if (*pm == NULL)
+		*pm = _TIFFMutexCreate();
+	m = *pm;
+	_TIFFGlobalUnlock();
+	return (m);
+}
+
+static TIFF*
+_TIFFTakeChunkDecoder(TIFF* tif)
+{
+	TIFF* w;
+	size_t i;
+
+	_TIFFMutexLock(tif->tif_decodemutex);
+	if (tif->tif_ndecoders > 0) {
+		w = tif->tif_decoders[--tif->tif_ndecoders];
+		for (i = 0; i < TIFFArrayCount(decodeTags); i++) {
+			int value, current;
+
+			if (decodeTags[i].compression == tif->tif_dir.td_compression &&
+			    TIFFGetField(tif, decodeTags[i].tag, &value) &&
+			    (!TIFFGetField(w, decodeTags[i].tag, &current) ||
+			     current != value))
+				TIFFSetField(w, decodeTags[i].tag, value);
+		}
+		_TIFFTraceHelper(tif, w);
+	} else {
+		/* cloning may load the deferred tags and striles of tif */
+		w = TIFFCloneForThread(tif);
+	}
+	if (w != NULL)
+		_TIFFCancelHelper(tif, w);
+	_TIFFMutexUnlock(tif->tif_decodemutex);
+	return (w);
+}
+
+static void
+_TIFFReturnChunkDecoder(TIFF* tif, TIFF* w)
+{
+	int kept = 1;
+
+	_TIFFMutexLock(tif->tif_decodemutex);
+	_TIFFStatsMerge(tif, w, 0);
+	if (tif->tif_ndecoders == tif->tif_decodersalloc) {
+		TIFF** decoders = (TIFF**) _TIFFreallocExt(tif, tif->tif_decoders,
+		    (tif->tif_decodersalloc + 4) * sizeof(TIFF*));
+		if (decoders == NULL)
+			kept = 0;
+		else {
+			tif->tif_decoders = decoders;
+			tif->tif_decodersalloc += 4;
+		}
+	}
+	if (kept)
+		tif->tif_decoders[tif->tif_ndecoders++] = w;
+	_TIFFMutexUnlock(tif->tif_decodemutex);
+	/* closing a clone may free tif, so never with the lock held */
+	if (!kept)
+		TIFFCleanup(w);
+}
+
+/*
+ * Close the idle clones of the decoder pool of tif.
+ */
+void
+_TIFFFreeChunkDecoders(TIFF* tif)
+{
+	TIFF** decoders;
+	int i, n;
+
+	if (tif->tif_decodemutex == NULL)
+		return;
+	_TIFFMutexLock(tif->tif_decodemutex);
+	decoders = tif->tif_decoders;
+	n = tif->tif_ndecoders;
+	tif->tif_decoders = NULL;
+	tif->tif_ndecoders = 0;
+	tif->tif_decodersalloc = 0;
+	_TIFFMutexUnlock(tif->tif_decodemutex);
+	if (decoders == NULL)
+		return;
+	for (i = 0; i < n; i++)
+		TIFFCleanup(decoders[i]);
+	_TIFFfreeExt(tif, decoders);
+}
+
+/*
+ * Decode strip or tile chunk of the current directory from the rawsize
+ * compressed bytes at raw, which the caller has fetched itself (see
+ * TIFFGetStripInfo()), into a buffer of size bytes (-1 for a whole
+ * chunk).  No I/O is done and neither raw nor the raw data buffer of
+ * the handle is modified.  Several threads may call this on the same
+ * handle at once as long as nothing else uses it meanwhile; handles
+ * that cannot be cloned, such as those open for writing, decode one
+ * call at a time.  Returns the number of decoded bytes, or -1 on error.
+ */
+tmsize_t
+TIFFDecodeChunk(TIFF* tif, uint32 chunk, const void* raw, tmsize_t rawsize,
+    void* buf, tmsize_t size)
+{
+	static const char module[] = "TIFFDecodeChunk";
+	TIFFMutex* m;
+	TIFF* w;
+	void* in = (void*) raw;
+	tmsize_t n;
+	int shared;
+
+	if (tif->tif_mode == O_WRONLY) {
+		TIFFErrorExtR(tif, tif->tif_name,
+		    "File not open for reading");
+		return ((tmsize_t)(-1));
+	}
+	if (raw == NULL || rawsize <= 0) {
+		TIFFErrorExtR(tif, module,
+		    "No raw data given for strip/tile %lu",
+		    (unsigned long) chunk);
+		return ((tmsize_t)(-1));
+	}
+	if ((m = _TIFFPoolLock(&tif->tif_decodemutex)) == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for decoder lock");
+		return ((tmsize_t)(-1));
+	}
+	shared = tif->tif_mode == O_RDONLY &&
+	    tif->tif_dir.td_compression != COMPRESSION_OJPEG &&
+	    (tif->tif_flags & (TIFF_NOREADRAW|TIFF_DIRTYDIRECT)) == 0;
+	if (shared) {
+		if ((w = _TIFFTakeChunkDecoder(tif)) == NULL)
+			return ((tmsize_t)(-1));
+	} else {
+		_TIFFMutexLock(m);
+		w = tif;
+	}
+
+	/* The data is bit reversed in place, so reverse a copy */
+	if (!isFillOrder(w, w->tif_dir.td_fillorder) &&
+	    (w->tif_flags & TIFF_NOBITREV) == 0) {
+		if (rawsize > w->tif_sharedrawsize) {
+			uint8* p = (uint8*) _TIFFreallocExt(w, w->tif_sharedraw,
+			    rawsize);
+			if (p == NULL) {
+				TIFFErrorExtR(tif, module,
+				    "No space for raw data buffer");
+				in = NULL;
+			} else {
+				w->tif_sharedraw = p;
+				w->tif_sharedrawsize = rawsize;
+			}
+		}
+		if (in != NULL) {
+			_TIFFmemcpy(w->tif_sharedraw, raw, rawsize);
+			in = w->tif_sharedraw;
+		}
+	}
+	n = in == NULL ? (tmsize_t)(-1) :
+	    _TIFFReadEncodedChunkFromBuffer(w, chunk, in, rawsize, buf, size);
+
+	if (shared)
+		_TIFFReturnChunkDecoder(tif, w);
+	else
+		_TIFFMutexUnlock(m);
+	return (n);
+}
+
+/*
+ * Multi-threaded encoding.
+ *
+ * Each worker is a private write handle configured like the caller's
+ * handle, whose output goes to an in-memory stream.  Workers compress
+ * whole strips or tiles concurrently; the compressed chunks are then
+ * appended to the caller's file with TIFFWriteRawStrip() or
+ * TIFFWriteRawTile() in submission order, so the file layout is the
+ * same as with serial writes.
+ */
+
+/*
+ * Codec pseudo-tags that change what an encoder produces.
+ */
+static const struct {
+	uint16	compression;
+	uint32	tag;
+} encodeTags[] = {
+	{ COMPRESSION_ADOBE_DEFLATE,	TIFFTAG_ZIPQUALITY },
+	{ COMPRESSION_DEFLATE,		TIFFTAG_ZIPQUALITY },
+	{ COMPRESSION_JPEG,		TIFFTAG_JPEGQUALITY },
+	{ COMPRESSION_JPEG,		TIFFTAG_JPEGCOLORMODE },
+	{ COMPRESSION_JPEG,		TIFFTAG_JPEGTABLESMODE },
+	{ COMPRESSION_LZMA,		TIFFTAG_LZMAPRESET },
+	{ COMPRESSION_ZSTD,		TIFFTAG_ZSTD_LEVEL },
+	{ COMPRESSION_LZ4,		TIFFTAG_LZ4_LEVEL },
+	{ COMPRESSION_WEBP,		TIFFTAG_WEBP_LEVEL },
+	{ COMPRESSION_WEBP,		TIFFTAG_WEBP_LOSSLESS },
+};
+
+typedef struct {
+	TIFF*		owner;		/* handle whose allocator is used */
+	uint8*		data;
+	tmsize_t	size;		/* bytes in the stream */
+	tmsize_t	alloc;
+	tmsize_t	pos;
+} TIFFEncodeStream;
+
+typedef struct {
+	uint8*		data;		/* stream buffer holding the chunk */
+	tmsize_t	offset;
+	tmsize_t	size;
+} TIFFEncodedChunk;
+
+typedef struct {
+	TIFF*		worker;		/* private encoding handle */
+	TIFFEncodeStream stream;	/* its output */
+	const uint32*	striles;	/* strips/tiles to encode */
+	uint32		nstriles;
+	void**		bufs;		/* one input buffer per entry */
+	const tmsize_t*	sizes;
+	TIFFEncodedChunk* chunks;	/* one result per entry */
+	TIFFMutex*	jobmutex;	/* protects next and failed */
+	uint32*		next;		/* next entry to be picked up */
+	int*		failed;		/* set on first error */
+} TIFFEncodeJob;
+
+static tmsize_t
+_tiffStreamReadProc(thandle_t fd, void* buf, tmsize_t size)
+{
+	(void) fd; (void) buf; (void) size;
+	return (0);
+}
+
+static tmsize_t
+_tiffStreamWriteProc(thandle_t fd, void* buf, tmsize_t size)
+{
+	TIFFEncodeStream* s = (TIFFEncodeStream*) fd;
+
+	if (size < 0 || s->pos > TIFF_TMSIZE_T_MAX - size)
+		return (-1);
+	if (s->pos + size > s->alloc) {
+		tmsize_t alloc = s->alloc ? s->alloc : 64 * 1024;
+		uint8* p;
+
+		while (alloc < s->pos + size)
+			alloc = alloc > TIFF_TMSIZE_T_MAX / 2 ?
+			    s->pos + size : alloc * 2;
+		p = (uint8*) _TIFFreallocExt(s->owner, s->data, alloc);
+		if (p == NULL)
+			return (-1);
+		s->data = p;
+		s->alloc = alloc;
+	}
+	_TIFFmemcpy(s->data + s->pos, buf, size);
+	s->pos += size;
+	if (s->pos > s->size)
+		s->size = s->pos;
+	return (size);
+}
+
+static uint64
+_tiffStreamSeekProc(thandle_t fd, uint64 off, int whence)
+{
+	TIFFEncodeStream* s = (TIFFEncodeStream*) fd;
+	int64 base = whence == SEEK_CUR ? s->pos :
+	    whence == SEEK_END ? s->size : 0;
+	int64 pos = base + (int64) off;
+
+	if (pos < 0 || (uint64) pos > (uint64) TIFF_TMSIZE_T_MAX)
+		return ((uint64) -1);
+	s->pos = (tmsize_t) pos;
+	return ((uint64) pos);
+}
+
+static uint64
+_tiffStreamSizeProc(thandle_t fd)
+{
+	return ((uint64) ((TIFFEncodeStream*) fd)->size);
+}
+
+static int
+_tiffStreamMapProc(thandle_t fd, void** base, toff_t* size)
+{
+	(void) fd; (void) base; (void) size;
+	return (0);
+}
+
+static void
+_tiffStreamUnmapProc(thandle_t fd, void* base, toff_t size)
+{
+	(void) fd; (void) base; (void) size;
+}
+
+/*
+ * Return non-zero if chunks produced by the codec do not depend on
+ * anything but the directory settings mirrored to the workers.  Codecs
+ * that update the directory while encoding (CCITT options) and those
+ * with nothing to gain are encoded serially.  JPEG workers are given
+ * the caller's JPEGTables, so their abbreviated streams refer to the
+ * tables that end up in the file.
+ */
+static int
+_TIFFCanEncodeInParallel(uint16 compression)
+{
+	switch (compression) {
+	case COMPRESSION_LZW:
+	case COMPRESSION_PACKBITS:
+	case COMPRESSION_ADOBE_DEFLATE:
+	case COMPRESSION_DEFLATE:
+	case COMPRESSION_JPEG:
+	case COMPRESSION_LZMA:
+	case COMPRESSION_ZSTD:
+	case COMPRESSION_LZ4:
+	case COMPRESSION_WEBP:
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ * Open a worker writing to stream with the same image layout and
+ * codec settings as tif, or with compression and predictor instead of
+ * those of tif if they are not 0.
+ */
+static TIFF*
+_TIFFOpenEncodeWorker(TIFF* tif, TIFFEncodeStream* stream, int tiles,
+    uint16 compression, uint16 predictor, const char* module)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFOpenOptions opts, *popts;
+	TIFF* w;
+	char mode[8];
+	uint16 v16, sub[2];
+	uint32 count;
+	void* tables;
+	size_t i;
+	int value;
+
+	if (!_TIFFWorkerOptions(tif, &opts, &popts))
+		return (NULL);
+	strcpy(mode, "w");
+	strcat(mode, tif->tif_header.common.tiff_magic == TIFF_BIGENDIAN ?
+	    "b" : "l");
+	if (tif->tif_flags & TIFF_BIGTIFF)
+		strcat(mode, "8");
+	w = TIFFClientOpenExt(tif->tif_name, mode, (thandle_t) stream,
+	    _tiffStreamReadProc, _tiffStreamWriteProc, _tiffStreamSeekProc,
+	    _tiffWorkerCloseProc, _tiffStreamSizeProc,
+	    _tiffStreamMapProc, _tiffStreamUnmapProc, popts);
+	if (w == NULL)
+		return (NULL);
+	w->tif_flags = (w->tif_flags & ~TIFF_FILLORDER) |
+	    (tif->tif_flags & TIFF_FILLORDER);
+	TIFFSetField(w, TIFFTAG_IMAGEWIDTH, td->td_imagewidth);
+	TIFFSetField(w, TIFFTAG_IMAGELENGTH, td->td_imagelength);
+	TIFFSetField(w, TIFFTAG_BITSPERSAMPLE, td->td_bitspersample);
+	TIFFSetField(w, TIFFTAG_SAMPLESPERPIXEL, td->td_samplesperpixel);
+	TIFFSetField(w, TIFFTAG_SAMPLEFORMAT, td->td_sampleformat);
+	TIFFSetField(w, TIFFTAG_PLANARCONFIG, td->td_planarconfig);
+	TIFFSetField(w, TIFFTAG_FILLORDER, td->td_fillorder);
+	if (TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &v16)) {
+		TIFFSetField(w, TIFFTAG_PHOTOMETRIC, v16);
+		if (v16 == PHOTOMETRIC_YCBCR) {
+			TIFFGetFieldDefaulted(tif, TIFFTAG_YCBCRSUBSAMPLING,
+			    &sub[0], &sub[1]);
+			TIFFSetField(w, TIFFTAG_YCBCRSUBSAMPLING, sub[0], sub[1]);
+		}
+	}
+	if (tiles) {
+		TIFFSetField(w, TIFFTAG_TILEWIDTH, td->td_tilewidth);
+		TIFFSetField(w, TIFFTAG_TILELENGTH, td->td_tilelength);
+		TIFFSetField(w, TIFFTAG_TILEDEPTH, td->td_tiledepth);
+		TIFFSetField(w, TIFFTAG_IMAGEDEPTH, td->td_imagedepth);
+	} else
+		TIFFSetField(w, TIFFTAG_ROWSPERSTRIP, td->td_rowsperstrip);
+	if (compression == 0)
+		compression = td->td_compression;
+	TIFFSetField(w, TIFFTAG_COMPRESSION, compression);
+	if (predictor != 0)
+		TIFFSetField(w, TIFFTAG_PREDICTOR, predictor);
+	else if (TIFFGetField(tif, TIFFTAG_PREDICTOR, &v16))
+		TIFFSetField(w, TIFFTAG_PREDICTOR, v16);
+	for (i = 0; i < TIFFArrayCount(encodeTags); i++) {
+		if (encodeTags[i].compression == compression &&
+		    compression == td->td_compression &&
+		    TIFFGetField(tif, encodeTags[i].tag, &value))
+			TIFFSetField(w, encodeTags[i].tag, value);
+	}
+	if (compression == COMPRESSION_JPEG &&
+	    TIFFGetField(tif, TIFFTAG_JPEGTABLES, &count, &tables))
+		TIFFSetField(w, TIFFTAG_JPEGTABLES, count, tables);
+	/* tif has no strips set up yet when choosing its compression */
+	if (!TIFFWriteCheck(w, tiles, module) || (td->td_nstrips != 0 &&
+	    w->tif_dir.td_nstrips != td->td_nstrips)) {
+		TIFFCleanup(w);
+		return (NULL);
+	}
+	_TIFFTraceHelper(tif, w);
+	_TIFFCancelHelper(tif, w);
+	_TIFFAllocProfileHelper(tif, w);
+	return (w);
+}
+
+static int
+_TIFFEncodeOne(TIFFEncodeJob* job, uint32 strile, void* buf, tmsize_t size,
+    TIFFEncodedChunk* chunk)
+{
+	TIFF* w = job->worker;
+	TIFFDirectory* td = &w->tif_dir;
+	tmsize_t n;
+
+	/*
+	 * Start every chunk on an empty stream, as a fresh strip/tile.  The
+	 * stream starts at offset 1: a chunk flushed in several pieces would
+	 * be restarted by TIFFAppendToStrip() at each piece if it had been
+	 * placed at offset 0, which marks a strip/tile not yet written.
+	 */
+	job->stream.size = job->stream.pos = 1;
+	/* Tally the samples for the caller's handle while they are at hand */
+	if (job->stream.owner->tif_flags & TIFF_CHUNKSTATS)
+		_TIFFChunkStatsTally(job->stream.owner, strile, buf, size, 0, 1,
+		    job->jobmutex);
+	td->td_stripoffset[strile] = 0;
+	td->td_stripbytecount[strile] = 0;
+	w->tif_curoff = 0;
+	n = isTiled(w) ? TIFFWriteEncodedTile(w, strile, buf, size) :
+	    TIFFWriteEncodedStrip(w, strile, buf, size);
+	if (n == (tmsize_t)(-1))
+		return (0);
+	/* Hand the stream buffer over to the result */
+	chunk->data = job->stream.data;
+	chunk->offset = (tmsize_t) td->td_stripoffset[strile];
+	chunk->size = (tmsize_t) td->td_stripbytecount[strile];
+	job->stream.data = NULL;
+	job->stream.alloc = job->stream.size = job->stream.pos = 0;
+	return (1);
+}
+
+static void
+_TIFFEncodeThread(void* arg)
+{
+	TIFFEncodeJob* job = (TIFFEncodeJob*) arg;
+	uint32 i;
+
+	for (;;) {
+		_TIFFMutexLock(job->jobmutex);
+		if (*job->failed || *job->next >= job->nstriles) {
+			_TIFFMutexUnlock(job->jobmutex);
+			break;
+		}
+		i = (*job->next)++;
+		_TIFFMutexUnlock(job->jobmutex);
+
+		if (!_TIFFEncodeOne(job, job->striles[i], job->bufs[i],
+		    job->sizes[i], &job->chunks[i])) {
+			_TIFFMutexLock(job->jobmutex);
+			*job->failed = 1;
+			_TIFFMutexUnlock(job->jobmutex);
+			break;
+		}
+	}
+}
+
+static int
+_TIFFWriteEncodedParallel(TIFF* tif, int tiles, const uint32* striles,
+    uint32 nstriles, void** bufs, const tmsize_t* sizes, int nthreads,
+    const char* module)
+{
+	TIFFEncodeJob* jobs = NULL;
+	TIFFEncodedChunk* chunks = NULL;
+	void** args = NULL;
+	TIFFMutex* jobmutex = NULL;
+	uint32 next = 0, i;
+	int failed = 0, t, nstarted = 0;
+
+	if (!TIFFWriteCheck(tif, tiles, module))
+		return (0);
+	if (nstriles == 0)
+		return (1);
+	if (striles == NULL || bufs == NULL || sizes == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No strip/tile list or input buffers given");
+		return (0);
+	}
+
+	if (nthreads <= 0)
+		nthreads = _TIFFThreadConcurrency(tif);
+	if (nthreads > TIFF_MAX_WORKER_THREADS)
+		nthreads = TIFF_MAX_WORKER_THREADS;
+	if ((uint32)nthreads > nstriles)
+		nthreads = (int)nstriles;
+	/* Growing the image is left to the serial code */
+	for (i = 0; i < nstriles; i++)
+		if (striles[i] >= tif->tif_dir.td_nstrips)
+			nthreads = 1;
+	/*
+	 * Set up the caller's codec before the workers, which copy what it
+	 * derives once per directory (JPEGTables).
+	 */
+	if ((tif->tif_flags & TIFF_CODERSETUP) == 0) {
+		if (!(*tif->tif_setupencode)(tif))
+			return (0);
+		tif->tif_flags |= TIFF_CODERSETUP;
+	}
+
+	if (nthreads > 1 && _TIFFHaveThreads() &&
+	    _TIFFCanEncodeInParallel(tif->tif_dir.td_compression) &&
+	    (jobmutex = _TIFFMutexCreate()) != NULL) {
+		jobs = (TIFFEncodeJob*) _TIFFmallocExt(tif, nthreads * sizeof(TIFFEncodeJob));
+		args = (void**) _TIFFmallocExt(tif, nthreads * sizeof(void*));
+		chunks = (TIFFEncodedChunk*) _TIFFmallocExt(tif,
+		    (tmsize_t) nstriles * sizeof(TIFFEncodedChunk));
+		if (jobs && args && chunks) {
+			_TIFFmemset(jobs, 0, nthreads * sizeof(TIFFEncodeJob));
+			_TIFFmemset(chunks, 0,
+			    (tmsize_t) nstriles * sizeof(TIFFEncodedChunk));
+			for (t = 0; t < nthreads; t++) {
+				jobs[t].stream.owner = tif;
+				jobs[t].worker = _TIFFOpenEncodeWorker(tif,
+				    &jobs[t].stream, tiles, 0, 0, module);
+				if (jobs[t].worker == NULL)
+					break;
+				jobs[t].worker->tif_flags |=
+				    tif->tif_flags & TIFF_SPARSEWRITE;
+				nstarted++;
+			}
+		}
+	}
+	if (nstarted < 2) {
+		for (t = 0; t < nstarted; t++) {
+			TIFFCleanup(jobs[t].worker);
+			if (jobs[t].stream.data)
+				_TIFFfreeExt(tif, jobs[t].stream.data);
+		}
+		if (jobs)
+			_TIFFfreeExt(tif, jobs);
+		if (args)
+			_TIFFfreeExt(tif, args);
+		if (chunks)
+			_TIFFfreeExt(tif, chunks);
+		_TIFFMutexDestroy(jobmutex);
+		for (i = 0; i < nstriles; i++) {
+			tmsize_t n = tiles ?
+			    TIFFWriteEncodedTile(tif, striles[i], bufs[i], sizes[i]) :
+			    TIFFWriteEncodedStrip(tif, striles[i], bufs[i], sizes[i]);
+			if (n == (tmsize_t)(-1))
+				return (0);
+		}
+		return (1);
+	}
+
+	/* The workers tally into arrays made big enough beforehand */
+	if (tif->tif_flags & TIFF_CHUNKSTATS)
+		(void) _TIFFChunkStatsSetup(tif);
+	for (t = 0; t < nstarted; t++) {
+		jobs[t].striles = striles;
+		jobs[t].nstriles = nstriles;
+		jobs[t].bufs = bufs;
+		jobs[t].sizes = sizes;
+		jobs[t].chunks = chunks;
+		jobs[t].jobmutex = jobmutex;
+		jobs[t].next = &next;
+		jobs[t].failed = &failed;
+		args[t] = &jobs[t];
+	}
+	_TIFFRunTasks(tif, nstarted, _TIFFEncodeThread, args);
+	for (t = 0; t < nstarted; t++) {
+		/* the I/O of the workers only went to their memory stream */
+		_TIFFStatsMerge(tif, jobs[t].worker, 0);
+		jobs[t].worker->tif_traceproc = NULL;
+		TIFFCleanup(jobs[t].worker);
+		if (jobs[t].stream.data)
+			_TIFFfreeExt(tif, jobs[t].stream.data);
+	}
+
+	for (i = 0; i < nstriles; i++) {
+		TIFFEncodedChunk* c = &chunks[i];
+
+		if (!failed && c->size == 0 &&
+		    (tif->tif_flags & TIFF_SPARSEWRITE))
+			_TIFFWriteSparseStrile(tif, striles[i]);
+		else if (!failed && c->size > 0 && (tiles ?
+		    TIFFWriteRawTile(tif, striles[i], c->data + c->offset, c->size) :
+		    TIFFWriteRawStrip(tif, striles[i], c->data + c->offset, c->size))
+		    == (tmsize_t)(-1))
+			failed = 1;
+		if (c->data)
+			_TIFFfreeExt(tif, c->data);
+	}
+	_TIFFfreeExt(tif, chunks);
+	_TIFFfreeExt(tif, jobs);
+	_TIFFfreeExt(tif, args);
+	_TIFFMutexDestroy(jobmutex);
+	return (!failed);
+}
+
+/*
+ * Compress the listed tiles from bufs[0..ntiles-1], sizes[i] bytes
+ * each, using up to nthreads threads (one per processor if nthreads
+ * <= 0), and write them to the file in list order.  As with
+ * TIFFWriteEncodedTile() the input buffers may be byte-swapped in
+ * place.  Returns 1 if every tile was written, 0 otherwise.
+ */
+int
+TIFFWriteEncodedTilesParallel(TIFF* tif, const uint32* tiles, uint32 ntiles,
+    void** bufs, const tmsize_t* sizes, int nthreads)
+{
+	static const char module[] = "TIFFWriteEncodedTilesParallel";
+
+	return (_TIFFWriteEncodedParallel(tif, 1, tiles, ntiles, bufs, sizes,
+	    nthreads, module));
+}
+
+/*
+ * Strip counterpart of TIFFWriteEncodedTilesParallel().
+ */
+int
+TIFFWriteEncodedStripsParallel(TIFF* tif, const uint32* strips, uint32 nstrips,
+    void** bufs, const tmsize_t* sizes, int nthreads)
+{
+	static const char module[] = "TIFFWriteEncodedStripsParallel";
+
+	return (_TIFFWriteEncodedParallel(tif, 0, strips, nstrips, bufs, sizes,
+	    nthreads, module));
+}
+
+/*
+ * Encoding of strips and tiles for the caller.
+ *
+ * TIFFEncodeChunk() compresses on encoding workers like those above,
+ * each serving one call at a time and pooled on the handle for the
+ * next calls.  The workers copy the settings of the directory, so the
+ * pool is renewed whenever a tag is set: that bumps tif_encodergen, and
+ * workers made for an older generation are then closed, rather than
+ * reused, the next time one is needed.
+ */
+struct _TIFFChunkEncoder {
+	TIFF*		worker;		/* private encoding handle */
+	TIFFEncodeStream stream;	/* its output */
+	uint32		gen;		/* tif_encodergen it was made for */
+};
+
+static void
+_TIFFCloseChunkEncoder(TIFF* tif, TIFFChunkEncoder* e)
+{
+	e->worker->tif_traceproc = NULL;
+	TIFFCleanup(e->worker);
+	if (e->stream.data)
+		_TIFFfreeExt(tif, e->stream.data);
+	_TIFFfreeExt(tif, e);
+}
+
+static TIFFChunkEncoder*
+_TIFFTakeChunkEncoder(TIFF* tif, const char* module)
+{
+	TIFFChunkEncoder* e = NULL;
+	int tiles = isTiled(tif);
+
+	_TIFFMutexLock(tif->tif_encodemutex);
+	while (e == NULL && tif->tif_nencoders > 0) {
+		e = tif->tif_encoders[--tif->tif_nencoders];
+		if (e->gen != tif->tif_encodergen) {
+			_TIFFCloseChunkEncoder(tif, e);
+			e = NULL;
+		}
+	}
+	/*
+	 * Set up the caller's handle for writing once per generation, as
+	 * the workers copy what its codec derives (JPEGTables); this may
+	 * set tags and so starts the generation the workers are made for.
+	 */
+	if (e == NULL && tif->tif_encodersetup != tif->tif_encodergen + 1) {
+		if (!TIFFWriteCheck(tif, tiles, module))
+			goto done;
+		if ((tif->tif_flags & TIFF_CODERSETUP) == 0) {
+			if (!(*tif->tif_setupencode)(tif))
+				goto done;
+			tif->tif_flags |= TIFF_CODERSETUP;
+		}
+		tif->tif_encodersetup = tif->tif_encodergen + 1;
+	}
+	if (e == NULL) {
+		e = (TIFFChunkEncoder*) _TIFFmallocExt(tif,
+		    sizeof(TIFFChunkEncoder));
+		if (e == NULL) {
+			TIFFErrorExtR(tif, module,
+			    "No space for encoding worker");
+			goto done;
+		}
+		_TIFFmemset(e, 0, sizeof(TIFFChunkEncoder));
+		e->stream.owner = tif;
+		e->gen = tif->tif_encodergen;
+		e->worker = _TIFFOpenEncodeWorker(tif, &e->stream, tiles,
+		    0, 0, module);
+		if (e->worker == NULL) {
+			_TIFFfreeExt(tif, e);
+			e = NULL;
+			goto done;
+		}
+	}
+	_TIFFTraceHelper(tif, e->worker);
+	_TIFFCancelHelper(tif, e->worker);
+done:
+	_TIFFMutexUnlock(tif->tif_encodemutex);
+	return (e);
+}
+
+static void
+_TIFFReturnChunkEncoder(TIFF* tif, TIFFChunkEncoder* e)
+{
+	_TIFFMutexLock(tif->tif_encodemutex);
+	/* the I/O of the worker only went to its memory stream */
+	_TIFFStatsMerge(tif, e->worker, 0);
+	if (tif->tif_nencoders == tif->tif_encodersalloc) {
+		TIFFChunkEncoder** encoders = (TIFFChunkEncoder**)
+		    _TIFFreallocExt(tif, tif->tif_encoders,
+		    (tif->tif_encodersalloc + 4) * sizeof(TIFFChunkEncoder*));
+		if (encoders == NULL) {
+			_TIFFCloseChunkEncoder(tif, e);
+			e = NULL;
+		} else {
+			tif->tif_encoders = encoders;
+			tif->tif_encodersalloc += 4;
+		}
+	}
+	if (e != NULL)
+		tif->tif_encoders[tif->tif_nencoders++] = e;
+	_TIFFMutexUnlock(tif->tif_encodemutex);
+}
+
+/*
+ * Close the encoding workers of tif, along with the lock of the pool.
+ */
+void
+_TIFFFreeChunkEncoders(TIFF* tif)
+{
+	int i;
+
+	for (i = 0; i < tif->tif_nencoders; i++)
+		_TIFFCloseChunkEncoder(tif, tif->tif_encoders[i]);
+	if (tif->tif_encoders)
+		_TIFFfreeExt(tif, tif->tif_encoders);
+	tif->tif_encoders = NULL;
+	tif->tif_nencoders = 0;
+	tif->tif_encodersalloc = 0;
+	if (tif->tif_encodemutex) {
+		_TIFFMutexDestroy(tif->tif_encodemutex);
+		tif->tif_encodemutex = NULL;
+	}
+}
+
+/*
+ * Compress size bytes of data at buf as strip or tile chunk of the
+ * current directory, applying the predictor and codec as
+ * TIFFWriteEncodedStrip() or TIFFWriteEncodedTile() would (buf may be
+ * byte-swapped or differenced in place), and store the result in the
+ * outsize bytes at out instead of writing it.  The chunk can then be
+ * added to the file, in any order, with TIFFWriteRawStrip() or
+ * TIFFWriteRawTile().  Once a first call for the directory has
+ * returned, calls may overlap each other and raw writes of encoded
+ * chunks on the same handle.  Returns the number of bytes stored, or
+ * -1 on error, including when out is too small.
+ */
+tmsize_t
+TIFFEncodeChunk(TIFF* tif, uint32 chunk, void* buf, tmsize_t size,
+    void* out, tmsize_t outsize)
+{
+	static const char module[] = "TIFFEncodeChunk";
+	uint16 compression = tif->tif_dir.td_compression;
+	TIFFChunkEncoder* e;
+	TIFFDirectory* td;
+	tmsize_t n, offset;
+
+	if (tif->tif_mode == O_RDONLY) {
+		TIFFErrorExtR(tif, module,
+		    "File not open for writing");
+		return ((tmsize_t)(-1));
+	}
+	if (compression != COMPRESSION_NONE &&
+	    !_TIFFCanEncodeInParallel(compression)) {
+		const TIFFCodec* c = TIFFFindCODEC(compression);
+
+		TIFFErrorExtR(tif, module,
+		    "%s compression cannot encode a strip or tile by itself",
+		    c ? c->name : "This");
+		return ((tmsize_t)(-1));
+	}
+	if (_TIFFPoolLock(&tif->tif_encodemutex) == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for encoder lock");
+		return ((tmsize_t)(-1));
+	}
+	if ((e = _TIFFTakeChunkEncoder(tif, module)) == NULL)
+		return ((tmsize_t)(-1));
+	/* Growing the image needs the directory of the caller */
+	if (chunk >= e->worker->tif_dir.td_nstrips) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: Strip/tile out of range, max %lu",
+		    (unsigned long) chunk,
+		    (unsigned long) e->worker->tif_dir.td_nstrips);
+		_TIFFReturnChunkEncoder(tif, e);
+		return ((tmsize_t)(-1));
+	}
+
+	/* The stream starts at offset 1, see _TIFFEncodeOne() */
+	td = &e->worker->tif_dir;
+	e->stream.size = e->stream.pos = 1;
+	td->td_stripoffset[chunk] = 0;
+	td->td_stripbytecount[chunk] = 0;
+	e->worker->tif_curoff = 0;
+	n = isTiled(tif) ? TIFFWriteEncodedTile(e->worker, chunk, buf, size) :
+	    TIFFWriteEncodedStrip(e->worker, chunk, buf, size);
+	if (n != (tmsize_t)(-1)) {
+		offset = (tmsize_t) td->td_stripoffset[chunk];
+		n = (tmsize_t) td->td_stripbytecount[chunk];
+		if (n > outsize || out == NULL) {
+			TIFFErrorExtR(tif, module,
+			    "Output buffer too small for the %ld bytes of "
+			    "strip/tile %lu", (long) n, (unsigned long) chunk);
+			n = (tmsize_t)(-1);
+		} else
+			_TIFFmemcpy(out, e->stream.data + offset, n);
+	}
+	_TIFFReturnChunkEncoder(tif, e);
+	return (n);
+}
+
+/*
+ * Trial encoding.
+ *
+ * TIFFChooseCompression() compresses sample strips/tiles with each
+ * candidate codec and predictor in turn, on a private worker like
+ * those of TIFFEncodeChunk(), and sets the candidate costing least on
+ * the directory.  The cost of a candidate is the size of its output
+ * plus the time it took, weighted by the caller.
+ */
+static const struct {
+	uint16	compression;
+	uint16	predictor;
+} trialCandidates[] = {
+	{ COMPRESSION_ADOBE_DEFLATE,	PREDICTOR_NONE },
+	{ COMPRESSION_ADOBE_DEFLATE,	PREDICTOR_HORIZONTAL },
+	{ COMPRESSION_ADOBE_DEFLATE,	PREDICTOR_FLOATINGPOINT },
+	{ COMPRESSION_ADOBE_DEFLATE,	PREDICTOR_SHUFFLE },
+	{ COMPRESSION_ZSTD,		PREDICTOR_NONE },
+	{ COMPRESSION_ZSTD,		PREDICTOR_HORIZONTAL },
+	{ COMPRESSION_ZSTD,		PREDICTOR_FLOATINGPOINT },
+	{ COMPRESSION_ZSTD,		PREDICTOR_SHUFFLE },
+	{ COMPRESSION_LZMA,		PREDICTOR_NONE },
+	{ COMPRESSION_LZMA,		PREDICTOR_HORIZONTAL },
+	{ COMPRESSION_LZMA,		PREDICTOR_FLOATINGPOINT },
+	{ COMPRESSION_LZMA,		PREDICTOR_SHUFFLE },
+	{ COMPRESSION_LZ4,		PREDICTOR_NONE },
+	{ COMPRESSION_LZ4,		PREDICTOR_HORIZONTAL },
+	{ COMPRESSION_LZ4,		PREDICTOR_FLOATINGPOINT },
+	{ COMPRESSION_LZ4,		PREDICTOR_SHUFFLE },
+};
+
+/*
+ * Whether predictor suits the samples of td, as PredictorSetup() checks,
+ * leaving out differencing of floating point samples as integers.
+ */
+static int
+_TIFFTrialPredictorFits(TIFFDirectory* td, uint16 predictor)
+{
+	uint16 bps = td->td_bitspersample;
+
+	switch (predictor) {
+	case PREDICTOR_NONE:
+		return (1);
+	case PREDICTOR_HORIZONTAL:
+		return (td->td_sampleformat != SAMPLEFORMAT_IEEEFP &&
+		    (bps == 8 || bps == 16 || bps == 32 || bps == 64));
+	case PREDICTOR_FLOATINGPOINT:
+		if (td->td_sampleformat != SAMPLEFORMAT_IEEEFP)
+			return (0);
+		/* FALLTHROUGH */
+	case PREDICTOR_SHUFFLE:
+		return (bps == 16 || bps == 24 || bps == 32 || bps == 64);
+	}
+	return (0);
+}
+
+/*
+ * Choose the compression and predictor of the current directory, before
+ * any of its image data is written, by encoding the nchunks strips or
+ * tiles listed in chunks, of sizes[i] bytes at bufs[i], with each
+ * candidate: Deflate, ZSTD, LZMA and LZ4, as configured, each with every
+ * predictor suiting the samples.  The candidate with the smallest output
+ * size in bytes plus bytespersecond times its encoding time in seconds
+ * is set with TIFFSetField(); a bytespersecond of 0 picks the smallest
+ * output.  The buffers are left as they were.  Returns 1 if a candidate
+ * was set, 0 on error or if none could encode the samples.
+ */
+int
+TIFFChooseCompression(TIFF* tif, const uint32* chunks, uint32 nchunks,
+    void** bufs, const tmsize_t* sizes, double bytespersecond)
+{
+	static const char module[] = "TIFFChooseCompression";
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFEncodeStream stream;
+	TIFF* w;
+	uint8* scratch = NULL;
+	tmsize_t maxsize = 0;
+	uint64 start, bytes;
+	double cost, best = 0;
+	size_t c, found = TIFFArrayCount(trialCandidates);
+	uint32 i;
+	int tiles = isTiled(tif), ok = 0;
+
+	if (tif->tif_mode == O_RDONLY) {
+		TIFFErrorExtR(tif, module,
+		    "File not open for writing");
+		return (0);
+	}
+	if (tif->tif_flags & TIFF_BEENWRITING) {
+		TIFFErrorExtR(tif, module,
+		    "Cannot change compression once image data is written");
+		return (0);
+	}
+	if (nchunks == 0 || chunks == NULL || bufs == NULL || sizes == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No strip/tile list or input buffers given");
+		return (0);
+	}
+	if (!TIFFFieldSet(tif, FIELD_IMAGEDIMENSIONS)) {
+		TIFFErrorExtR(tif, module,
+		    "Must set \"ImageWidth\" before writing data");
+		return (0);
+	}
+	/* as TIFFWriteCheck() does, for the workers to copy */
+	if (td->td_samplesperpixel == 1 &&
+	    !TIFFFieldSet(tif, FIELD_PLANARCONFIG))
+		td->td_planarconfig = PLANARCONFIG_CONTIG;
+	for (i = 0; i < nchunks; i++)
+		if (sizes[i] > maxsize)
+			maxsize = sizes[i];
+	/* encoding may swab or difference its input in place */
+	scratch = (uint8*) _TIFFmallocExt(tif, maxsize > 0 ? maxsize : 1);
+	if (scratch == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for trial encoding buffer");
+		return (0);
+	}
+	_TIFFmemset(&stream, 0, sizeof(stream));
+	stream.owner = tif;
+
+	for (c = 0; c < TIFFArrayCount(trialCandidates); c++) {
+		if (!TIFFIsCODECConfigured(trialCandidates[c].compression) ||
+		    !_TIFFTrialPredictorFits(td, trialCandidates[c].predictor))
+			continue;
+		w = _TIFFOpenEncodeWorker(tif, &stream, tiles,
+		    trialCandidates[c].compression,
+		    trialCandidates[c].predictor, module);
+		if (w == NULL)
+			continue;
+		bytes = 0;
+		start = _TIFFStatsClock();
+		for (i = 0; i < nchunks; i++) {
+			if (chunks[i] >= w->tif_dir.td_nstrips)
+				break;
+			/* see _TIFFEncodeOne() */
+			stream.size = stream.pos = 1;
+			w->tif_dir.td_stripoffset[chunks[i]] = 0;
+			w->tif_dir.td_stripbytecount[chunks[i]] = 0;
+			w->tif_curoff = 0;
+			_TIFFmemcpy(scratch, bufs[i], sizes[i]);
+			if ((tiles ? TIFFWriteEncodedTile(w, chunks[i], scratch,
+			    sizes[i]) : TIFFWriteEncodedStrip(w, chunks[i],
+			    scratch, sizes[i])) == (tmsize_t)(-1))
+				break;
+			bytes += w->tif_dir.td_stripbytecount[chunks[i]];
+		}
+		cost = (double) bytes + bytespersecond *
+		    (double) (_TIFFStatsClock() - start) / 1e9;
+		w->tif_traceproc = NULL;
+		TIFFCleanup(w);
+		if (i < nchunks)
+			continue;
+		if (found == TIFFArrayCount(trialCandidates) || cost < best) {
+			found = c;
+			best = cost;
+		}
+	}
+	if (stream.data)
+		_TIFFfreeExt(tif, stream.data);
+	_TIFFfreeExt(tif, scratch);
+
+	if (found == TIFFArrayCount(trialCandidates)) {
+		TIFFErrorExtR(tif, module,
+		    "No candidate compression could encode the strips/tiles");
+		return (0);
+	}
+	ok = TIFFSetField(tif, TIFFTAG_COMPRESSION,
+	    trialCandidates[found].compression);
+	if (ok)
+		ok = TIFFSetField(tif, TIFFTAG_PREDICTOR,
+		    trialCandidates[found].predictor);
+	return (ok);
+}
+
+/*
+ * Handles cloned for other threads.
+ *
+ * TIFFCloneForThread() makes a read-only handle on the current
+ * directory of another one without reading the directory again: the
+ * clone uses the directory of its template as is (arrays, strile
+ * arrays and tag values are not copied) and only gets its own codec
+ * state and file position.  The template is reference counted: its
+ * directory cannot change while it has clones, and closing it is
+ * deferred until the last of them is closed.  A clone that moves to
+ * another directory reads it into storage of its own.
+ */
+typedef struct {
+	TIFF*		tmpl;		/* handle cloned from */
+	uint64		pos;		/* file position of the clone */
+} TIFFCloneIO;
+
+static tmsize_t
+_tiffCloneReadAtProc(thandle_t fd, void* buf, tmsize_t size, toff_t off)
+{
+	TIFF* tif = ((TIFFCloneIO*) fd)->tmpl;
+	tmsize_t n;
+
+	if (tif->tif_readatproc != NULL)
+		return ((*tif->tif_readatproc)(tif->tif_clientdata, buf, size,
+		    off));
+	/* seek+read on the file of the template, serialized */
+	_TIFFMutexLock(tif->tif_iomutex);
+	if ((*tif->tif_seekproc)(tif->tif_clientdata, off, SEEK_SET) != off)
+		n = -1;
+	else
+		n = (*tif->tif_readproc)(tif->tif_clientdata, buf, size);
+	_TIFFMutexUnlock(tif->tif_iomutex);
+	return (n);
+}
+
+static tmsize_t
+_tiffCloneReadProc(thandle_t fd, void* buf, tmsize_t size)
+{
+	TIFFCloneIO* io = (TIFFCloneIO*) fd;
+	tmsize_t n;
+
+	n = _tiffCloneReadAtProc(fd, buf, size, io->pos);
+	if (n > 0)
+		io->pos += n;
+	return (n);
+}
+
+static tmsize_t
+_tiffCloneWriteProc(thandle_t fd, void* buf, tmsize_t size)
+{
+	(void) fd; (void) buf; (void) size;
+	return ((tmsize_t)(-1));
+}
+
+static uint64
+_tiffCloneSeekProc(thandle_t fd, uint64 off, int whence)
+{
+	TIFFCloneIO* io = (TIFFCloneIO*) fd;
+	TIFF* tif = io->tmpl;
+
+	switch (whence) {
+	case SEEK_SET:
+		io->pos = off;
+		break;
+	case SEEK_CUR:
+		io->pos += off;
+		break;
+	case SEEK_END:
+		io->pos = (*tif->tif_sizeproc)(tif->tif_clientdata) + off;
+		break;
+	}
+	return (io->pos);
+}
+
+static uint64
+_tiffCloneSizeProc(thandle_t fd)
+{
+	TIFF* tif = ((TIFFCloneIO*) fd)->tmpl;
+
+	return ((*tif->tif_sizeproc)(tif->tif_clientdata));
+}
+
+/*
+ * Clones of a memory mapped template use its mapping.
+ */
+static int
+_tiffCloneMapProc(thandle_t fd, void** base, toff_t* size)
+{
+	TIFF* tif = ((TIFFCloneIO*) fd)->tmpl;
+
+	if (!isMapped(tif))
+		return (0);
+	*base = tif->tif_base;
+	*size = (toff_t) tif->tif_size;
+	return (1);
+}
+
+static void
+_tiffCloneUnmapProc(thandle_t fd, void* base, toff_t size)
+{
+	(void) fd; (void) base; (void) size;
+}
+
+/*
+ * Give the clone w the value of the codec tag fip of tif.  Returns 0
+ * for tags of a type that is not handled.
+ */
+static int
+_TIFFCloneCodecField(TIFF* w, TIFF* tif, const TIFFField* fip)
+{
+	uint32 tag = fip->field_tag;
+
+	switch (fip->set_field_type) {
+	case TIFF_SETGET_UINT16:
+		{
+			uint16 v;
+			return (TIFFGetField(tif, tag, &v) &&
+			    TIFFSetField(w, tag, v));
+		}
+	case TIFF_SETGET_UINT32:
+		{
+			uint32 v;
+			return (TIFFGetField(tif, tag, &v) &&
+			    TIFFSetField(w, tag, v));
+		}
+	case TIFF_SETGET_DOUBLE:
+		{
+			double v;
+			return (TIFFGetField(tif, tag, &v) &&
+			    TIFFSetField(w, tag, v));
+		}
+	case TIFF_SETGET_ASCII:
+		{
+			char* v;
+			return (TIFFGetField(tif, tag, &v) &&
+			    TIFFSetField(w, tag, v));
+		}
+	case TIFF_SETGET_C16_UINT8:
+		{
+			uint16 n;
+			void* v;
+			return (TIFFGetField(tif, tag, &n, &v) &&
+			    TIFFSetField(w, tag, n, v));
+		}
+	case TIFF_SETGET_C32_UINT8:
+		{
+			uint32 n;
+			void* v;
+			return (TIFFGetField(tif, tag, &n, &v) &&
+			    TIFFSetField(w, tag, (uint32) n, v));
+		}
+	default:
+		return (0);
+	}
+}
+
+/*
+ * Set up the codec of the clone w, whose directory is still its own,
+ * with the settings of tif.  The values of codec tags live in the
+ * codec state, not in the directory, so they are copied.
+ */
+static int
+_TIFFCloneCodec(TIFF* w, TIFF* tif)
+{
+	static const char module[] = "TIFFCloneForThread";
+	uint32 i;
+
+	if (!TIFFSetField(w, TIFFTAG_COMPRESSION, tif->tif_dir.td_compression))
+		return (0);
+	for (i = 0; i < tif->tif_nfields; i++) {
+		const TIFFField* fip = tif->tif_fields[i];
+
+		if (fip->field_bit < FIELD_CODEC ||
+		    !TIFFFieldSet(tif, fip->field_bit))
+			continue;
+		if (!_TIFFCloneCodecField(w, tif, fip)) {
+			TIFFErrorExtR(tif, module,
+			    "%s: Cannot copy the value of %s",
+			    tif->tif_name, fip->field_name);
+			return (0);
+		}
+	}
+	/*
+	 * Some data format pseudo-tags adjust the directory, which is
+	 * replaced by that of tif afterwards
+	 */
+	for (i = 0; i < TIFFArrayCount(decodeTags); i++) {
+		int value;
+
+		if (decodeTags[i].compression == tif->tif_dir.td_compression &&
+		    TIFFGetField(tif, decodeTags[i].tag, &value))
+			TIFFSetField(w, decodeTags[i].tag, value);
+	}
+	return (1);
+}
+
+/*
+ * Register with the clone w the tags of tif it does not know, which
+ * the tag values it shares with tif may refer to.  Anonymous fields
+ * are freed with their handle, so w gets its own.
+ */
+static int
+_TIFFCloneFields(TIFF* w, TIFF* tif)
+{
+	uint32 i;
+
+	for (i = 0; i < tif->tif_nfields; i++) {
+		const TIFFField* fip = tif->tif_fields[i];
+
+		if (fip->field_bit != FIELD_CUSTOM ||
+		    TIFFFindField(w, fip->field_tag, TIFF_ANY) != NULL)
+			continue;
+		if (strncmp("Tag ", fip->field_name, 4) == 0) {
+			TIFFField* anon = _TIFFCreateAnonField(w,
+			    fip->field_tag, fip->field_type);
+
+			if (anon == NULL || !_TIFFMergeFields(w, anon, 1))
+				return (0);
+		} else if (!_TIFFMergeFields(w, fip, 1))
+			return (0);
+	}
+	return (1);
+}
+
+TIFF*
+TIFFCloneForThread(TIFF* tif)
+{
+	static const char module[] = "TIFFCloneForThread";
+	TIFFOpenOptions opts, *popts;
+	TIFFCloneIO* io;
+	TIFF* w;
+	char mode[8];
+
+	if (tif->tif_mode != O_RDONLY) {
+		TIFFErrorExtR(tif, module,
+		    "%s: Only handles opened for reading can be cloned",
+		    tif->tif_name);
+		return (NULL);
+	}
+	if (tif->tif_dir.td_compression == COMPRESSION_OJPEG ||
+	    (tif->tif_flags & (TIFF_NOREADRAW|TIFF_DIRTYDIRECT)) != 0) {
+		TIFFErrorExtR(tif, module,
+		    "%s: The current directory cannot be shared",
+		    tif->tif_name);
+		return (NULL);
+	}
+	/* Nothing is loaded into a shared directory afterwards */
+	_TIFFFetchDeferredTags(tif);
+	if (!_TIFFFillStriles(tif) || tif->tif_dir.td_stripoffset == NULL ||
+	    tif->tif_dir.td_stripbytecount == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "%s: Cannot load the strip/tile arrays", tif->tif_name);
+		return (NULL);
+	}
+	if (tif->tif_readatproc == NULL && tif->tif_iomutex == NULL &&
+	    (tif->tif_iomutex = _TIFFMutexCreate()) == NULL)
+		return (NULL);
+	if (!_TIFFWorkerOptions(tif, &opts, &popts))
+		return (NULL);
+	if (popts == NULL) {
+		_TIFFmemset(&opts, 0, sizeof(TIFFOpenOptions));
+		popts = &opts;
+	}
+	/* lets the parallel APIs be used on the clone too */
+	popts->readatproc = _tiffCloneReadAtProc;
+	io = (TIFFCloneIO*) _TIFFmallocExt(tif, sizeof(TIFFCloneIO));
+	if (io == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for clone state");
+		return (NULL);
+	}
+	io->tmpl = tif;
+	io->pos = 0;
+	strcpy(mode, "rh");
+	strcat(mode, isMapped(tif) ? "M" : "m");
+	strcat(mode, (tif->tif_flags & TIFF_STRIPCHOP) ? "C" : "c");
+	w = TIFFClientOpenExt(tif->tif_name, mode, (thandle_t) io,
+	    _tiffCloneReadProc, _tiffCloneWriteProc, _tiffCloneSeekProc,
+	    _tiffWorkerCloseProc, _tiffCloneSizeProc,
+	    _tiffCloneMapProc, _tiffCloneUnmapProc, popts);
+	if (w == NULL) {
+		_TIFFfreeExt(tif, io);
+		return (NULL);
+	}
+	_TIFFGlobalLock();
+	tif->tif_nclones++;
+	_TIFFGlobalUnlock();
+	w->tif_template = tif;
+	if (!TIFFDefaultDirectory(w) || !_TIFFCloneFields(w, tif) ||
+	    !_TIFFCloneCodec(w, tif)) {
+		TIFFCleanup(w);
+		return (NULL);
+	}
+	TIFFFreeDirectory(w);
+	_TIFFmemcpy(&w->tif_dir, &tif->tif_dir, sizeof(TIFFDirectory));
+	w->tif_shareddir = 1;
+	w->tif_flags &= ~(TIFF_FILLORDER|TIFF_ISTILED|TIFF_UPSAMPLED|
+	    TIFF_DIRTYDIRECT);
+	w->tif_flags |= tif->tif_flags &
+	    (TIFF_FILLORDER|TIFF_ISTILED|TIFF_UPSAMPLED);
+	w->tif_postdecode = tif->tif_postdecode;
+	w->tif_threadpool = tif->tif_threadpool;
+	w->tif_curdir = tif->tif_curdir;
+	w->tif_diroff = tif->tif_diroff;
+	w->tif_nextdiroff = tif->tif_nextdiroff;
+	w->tif_row = (uint32) -1;
+	w->tif_curstrip = (uint32) -1;
+	w->tif_col = (uint32) -1;
+	w->tif_curtile = (uint32) -1;
+	w->tif_scanlinesize = tif->tif_scanlinesize;
+	w->tif_tilesize = tif->tif_tilesize;
+	w->tif_rawcc = (tmsize_t) -1;
+	w->tif_flags |= TIFF_BUFFERSETUP;
+	_TIFFTraceHelper(tif, w);
+	_TIFFAllocProfileHelper(tif, w);
+	_TIFFChunkCacheShare(tif, w);
+	return (w);
+}
+
+/*
+ * Called by TIFFCleanup() and TIFFClose(): a template that still has
+ * clones is kept, to be freed (and closed if close is set) by the last
+ * of them.  Returns 1 if the handle is kept.
+ */
+int
+_TIFFKeepTemplate(TIFF* tif, int close)
+{
+	int kept = 0;
+
+	_TIFFGlobalLock();
+	if (tif->tif_nclones > 0) {
+		if (close)
+			tif->tif_closepending = 2;
+		else if (tif->tif_closepending == 0)
+			tif->tif_closepending = 1;
+		kept = 1;
+	}
+	_TIFFGlobalUnlock();
+	return (kept);
+}
+
+/*
+ * Drop the reference that a clone, already freed, had on its template
+ * tif, and free the I/O state io of the clone.
+ */
+void
+_TIFFReleaseTemplate(TIFF* tif, thandle_t io)
+{
+	int pending = 0;
+
+	_TIFFfreeExt(tif, io);
+	_TIFFGlobalLock();
+	if (--tif->tif_nclones == 0)
+		pending = tif->tif_closepending;
+	_TIFFGlobalUnlock();
+	if (pending == 2)
+		TIFFClose(tif);
+	else if (pending == 1)
+		TIFFCleanup(tif);
+}
+
+/*
+ * Return 0, after reporting an error, if the directory of the handle
+ * is shared with clones and so cannot change.  A clone can move to
+ * another directory, but not modify the one it shares (set modify).
+ */
+int
+_TIFFCheckUnshared(TIFF* tif, int modify, const char* module)
+{
+	int nclones;
+
+	if (tif->tif_mode != O_RDONLY)
+		return (1);
+	_TIFFFreeChunkDecoders(tif);
+	_TIFFGlobalLock();
+	nclones = tif->tif_nclones;
+	_TIFFGlobalUnlock();
+	if (nclones == 0 && !(modify && tif->tif_shareddir))
+		return (1);
+	TIFFErrorExtR(tif, module,
+	    "%s: Directory is shared with cloned handles", tif->tif_name);
+	return (0);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -477,8 +477,23 @@ typedef	struct {
 	
 } PixarLogState;
 
+/*
+ * The companding tables depend on nothing but the constants above, so
+ * they are built once, on first use, and shared read-only by all
+ * handles for the life of the process.
+ */
+static struct {
+    int     built;
+    float  *ToLinearF;
+    uint16 *ToLinear16;
+    unsigned char *ToLinear8;
+    uint16 *FromLT2;
+    uint16 *From14;
+    uint16 *From8;
+} PixarLogTables;
+
 static int
-PixarLogMakeTables(PixarLogState *sp)
+PixarLogBuildTables(void)
 {
 
 /*
@@ -508,8 +523,6 @@ PixarLogMakeTables(PixarLogState *sp)
     b = exp(-c*ONE);	/* multiplicative scale factor [b*exp(c*ONE) = 1] */
     linstep = b*c*exp(1.);
 
-    LogK1 = (float)(1./c);	/* if (v >= 2)  token = k1*log(v*k2) */
-    LogK2 = (float)(1./b);
     lt2size = (int)(2./linstep) + 1;
     FromLT2 = (uint16 *)_TIFFmalloc(lt2size*sizeof(uint16));
     From14 = (uint16 *)_TIFFmalloc(16384*sizeof(uint16));
@@ -525,15 +538,12 @@ PixarLogMakeTables(PixarLogState *sp)
 	if (ToLinearF) _TIFFfree(ToLinearF);
 	if (ToLinear16) _TIFFfree(ToLinear16);
 	if (ToLinear8) _TIFFfree(ToLinear8);
-	sp->FromLT2 = NULL;
-	sp->From14 = NULL;
-	sp->From8 = NULL;
-	sp->ToLinearF = NULL;
-	sp->ToLinear16 = NULL;
-	sp->ToLinear8 = NULL;
 	return 0;
     }
 
+    LogK1 = (float)(1./c);	/* if (v >= 2)  token = k1*log(v*k2) */
+    LogK2 = (float)(1./b);
+
     j = 0;
 
     for (i = 0; i < nlin; i++)  {
@@ -581,12 +591,41 @@ PixarLogMakeTables(PixarLogState *sp)
 
     Fltsize = (float)(lt2size/2);
 
-    sp->ToLinearF = ToLinearF;
-    sp->ToLinear16 = ToLinear16;
-    sp->ToLinear8 = ToLinear8;
-    sp->FromLT2 = FromLT2;
-    sp->From14 = From14;
-    sp->From8 = From8;
+    PixarLogTables.ToLinearF = ToLinearF;
+    PixarLogTables.ToLinear16 = ToLinear16;
+    PixarLogTables.ToLinear8 = ToLinear8;
+    PixarLogTables.FromLT2 = FromLT2;
+    PixarLogTables.From14 = From14;
+    PixarLogTables.From8 = From8;
+    PixarLogTables.built = 1;
+
+    return 1;
+}
+
+static int
+PixarLogMakeTables(TIFF* tif, PixarLogState *sp)
+{
+    int ok;
+
+    (void) tif;
+    _TIFFGlobalLock();
+    ok = PixarLogTables.built || PixarLogBuildTables();
+    _TIFFGlobalUnlock();
+    if (!ok) {
+	sp->FromLT2 = NULL;
+	sp->From14 = NULL;
+	sp->From8 = NULL;
+	sp->ToLinearF = NULL;
+	sp->ToLinear16 = NULL;
+	sp->ToLinear8 = NULL;
+	return 0;
+    }
+    sp->ToLinearF = PixarLogTables.ToLinearF;
+    sp->ToLinear16 = PixarLogTables.ToLinear16;
+    sp->ToLinear8 = PixarLogTables.ToLinear8;
+    sp->FromLT2 = PixarLogTables.FromLT2;
+    sp->From14 = PixarLogTables.From14;
+    sp->From8 = PixarLogTables.From8;
 
     return 1;
 }
@@ -699,27 +738,27 @@ PixarLogSetupDecode(TIFF* tif)
 	tbuf_size = add_ms(tbuf_size, sizeof(uint16) * sp->stride);
 	if (tbuf_size == 0)
 		return (0);   /* TODO: this is an error return without error report through TIFFErrorExt */
-	sp->tbuf = (uint16 *) _TIFFmalloc(tbuf_size);
+	sp->tbuf = (uint16 *) _TIFFmallocExt(tif, tbuf_size);
 	if (sp->tbuf == NULL)
 		return (0);
 	sp->tbuf_size = tbuf_size;
 	if (sp->user_datafmt == PIXARLOGDATAFMT_UNKNOWN)
 		sp->user_datafmt = PixarLogGuessDataFmt(td);
 	if (sp->user_datafmt == PIXARLOGDATAFMT_UNKNOWN) {
-                _TIFFfree(sp->tbuf);
+                _TIFFfreeExt(tif, sp->tbuf);
                 sp->tbuf = NULL;
                 sp->tbuf_size = 0;
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			"PixarLog compression can't handle bits depth/data format combination (depth: %d)", 
 			td->td_bitspersample);
 		return (0);
 	}
 
 	if (inflateInit(&sp->stream) != Z_OK) {
-                _TIFFfree(sp->tbuf);
+                _TIFFfreeExt(tif, sp->tbuf);
                 sp->tbuf = NULL;
                 sp->tbuf_size = 0;
-		TIFFErrorExt(tif->tif_clientdata, module, "%s", sp->stream.msg ? sp->stream.msg : "(null)");
+		TIFFErrorExtR(tif, module, "%s", sp->stream.msg ? sp->stream.msg : "(null)");
 		return (0);
 	} else {
 		sp->state |= PLSTATE_INIT;
@@ -746,7 +785,7 @@ PixarLogPreDecode(TIFF* tif, uint16 s)
 	sp->stream.avail_in = (uInt) tif->tif_rawcc;
 	if ((tmsize_t)sp->stream.avail_in != tif->tif_rawcc)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "ZLib cannot deal with buffers this size");
+		TIFFErrorExtR(tif, module, "ZLib cannot deal with buffers this size");
 		return (0);
 	}
 	return (inflateReset(&sp->stream) == Z_OK);
@@ -777,7 +816,7 @@ PixarLogDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 		nsamples = occ;
 		break;
 	default:
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			"%d bit input not supported in PixarLog",
 			td->td_bitspersample);
 		return 0;
@@ -799,13 +838,13 @@ PixarLogDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 	sp->stream.avail_out = (uInt) (nsamples * sizeof(uint16));
 	if (sp->stream.avail_out != nsamples * sizeof(uint16))
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "ZLib cannot deal with buffers this size");
+		TIFFErrorExtR(tif, module, "ZLib cannot deal with buffers this size");
 		return (0);
 	}
 	/* Check that we will not fill more than what was allocated */
 	if ((tmsize_t)sp->stream.avail_out > sp->tbuf_size)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "sp->stream.avail_out > sp->tbuf_size");
+		TIFFErrorExtR(tif, module, "sp->stream.avail_out > sp->tbuf_size");
 		return (0);
 	}
 	do {
@@ -814,7 +853,7 @@ PixarLogDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 			break;			/* XXX */
 		}
 		if (state == Z_DATA_ERROR) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Decoding error at scanline %lu, %s",
 			    (unsigned long) tif->tif_row, sp->stream.msg ? sp->stream.msg : "(null)");
 			if (inflateSync(&sp->stream) != Z_OK)
@@ -822,7 +861,7 @@ PixarLogDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 			continue;
 		}
 		if (state != Z_OK) {
-			TIFFErrorExt(tif->tif_clientdata, module, "ZLib error: %s",
+			TIFFErrorExtR(tif, module, "ZLib error: %s",
 			    sp->stream.msg ? sp->stream.msg : "(null)");
 			return (0);
 		}
@@ -830,7 +869,7 @@ PixarLogDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 
 	/* hopefully, we got all the bytes we needed */
 	if (sp->stream.avail_out != 0) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Not enough data at scanline %lu (short " TIFF_UINT64_FORMAT " bytes)",
 		    (unsigned long) tif->tif_row, (TIFF_UINT64_T) sp->stream.avail_out);
 		return (0);
@@ -850,7 +889,7 @@ PixarLogDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 	 * that but still salvage as much data as possible.
 	 */
 	if (nsamples % llen) { 
-		TIFFWarningExt(tif->tif_clientdata, module,
+		TIFFWarningExtR(tif, module,
 			"stride %lu is not a multiple of sample count, "
 			"%lu, data truncated.", (unsigned long) llen, (unsigned long) nsamples);
 		nsamples -= nsamples % llen;
@@ -889,7 +928,7 @@ PixarLogDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 			op += llen * sizeof(unsigned char);
 			break;
 		default:
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				  "Unsupported bits/sample: %d",
 				  td->td_bitspersample);
 			return (0);
@@ -917,18 +956,18 @@ PixarLogSetupEncode(TIFF* tif)
 				      td->td_rowsperstrip), sizeof(uint16));
 	if (tbuf_size == 0)
 		return (0);  /* TODO: this is an error return without error report through TIFFErrorExt */
-	sp->tbuf = (uint16 *) _TIFFmalloc(tbuf_size);
+	sp->tbuf = (uint16 *) _TIFFmallocExt(tif, tbuf_size);
 	if (sp->tbuf == NULL)
 		return (0);
 	if (sp->user_datafmt == PIXARLOGDATAFMT_UNKNOWN)
 		sp->user_datafmt = PixarLogGuessDataFmt(td);
 	if (sp->user_datafmt == PIXARLOGDATAFMT_UNKNOWN) {
-		TIFFErrorExt(tif->tif_clientdata, module, "PixarLog compression can't handle %d bit linear encodings", td->td_bitspersample);
+		TIFFErrorExtR(tif, module, "PixarLog compression can't handle %d bit linear encodings", td->td_bitspersample);
 		return (0);
 	}
 
 	if (deflateInit(&sp->stream, sp->quality) != Z_OK) {
-		TIFFErrorExt(tif->tif_clientdata, module, "%s", sp->stream.msg ? sp->stream.msg : "(null)");
+		TIFFErrorExtR(tif, module, "%s", sp->stream.msg ? sp->stream.msg : "(null)");
 		return (0);
 	} else {
 		sp->state |= PLSTATE_INIT;
@@ -955,7 +994,7 @@ PixarLogPreEncode(TIFF* tif, uint16 s)
 	sp->stream.avail_out = (uInt)tif->tif_rawdatasize;
 	if ((tmsize_t)sp->stream.avail_out != tif->tif_rawdatasize)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "ZLib cannot deal with buffers this size");
+		TIFFErrorExtR(tif, module, "ZLib cannot deal with buffers this size");
 		return (0);
 	}
 	return (deflateReset(&sp->stream) == Z_OK);
@@ -1145,7 +1184,7 @@ PixarLogEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 		n = cc;
 		break;
 	default:
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			"%d bit input not supported in PixarLog",
 			td->td_bitspersample);
 		return 0;
@@ -1155,7 +1194,7 @@ PixarLogEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
     /* Check against the number of elements (of size uint16) of sp->tbuf */
     if( n > (tmsize_t)(td->td_rowsperstrip * llen) )
     {
-        TIFFErrorExt(tif->tif_clientdata, module,
+        TIFFErrorExtR(tif, module,
                      "Too many input bytes provided");
         return 0;
     }
@@ -1178,7 +1217,7 @@ PixarLogEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 			bp += llen * sizeof(unsigned char);
 			break;
 		default:
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				"%d bit input not supported in PixarLog",
 				td->td_bitspersample);
 			return 0;
@@ -1193,14 +1232,14 @@ PixarLogEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	sp->stream.avail_in = (uInt) (n * sizeof(uint16));
 	if ((sp->stream.avail_in / sizeof(uint16)) != (uInt) n)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "ZLib cannot deal with buffers this size");
 		return (0);
 	}
 
 	do {
 		if (deflate(&sp->stream, Z_NO_FLUSH) != Z_OK) {
-			TIFFErrorExt(tif->tif_clientdata, module, "Encoder error: %s",
+			TIFFErrorExtR(tif, module, "Encoder error: %s",
 			    sp->stream.msg ? sp->stream.msg : "(null)");
 			return (0);
 		}
@@ -1242,7 +1281,7 @@ PixarLogPostEncode(TIFF* tif)
 		    }
 		    break;
 		default:
-			TIFFErrorExt(tif->tif_clientdata, module, "ZLib error: %s",
+			TIFFErrorExtR(tif, module, "ZLib error: %s",
 			sp->stream.msg ? sp->stream.msg : "(null)");
 		    return (0);
 		}
@@ -1292,12 +1331,6 @@ PixarLogCleanup(TIFF* tif)
 	tif->tif_tagmethods.vgetfield = sp->vgetparent;
 	tif->tif_tagmethods.vsetfield = sp->vsetparent;
 
-	if (sp->FromLT2) _TIFFfree(sp->FromLT2);
-	if (sp->From14) _TIFFfree(sp->From14);
-	if (sp->From8) _TIFFfree(sp->From8);
-	if (sp->ToLinearF) _TIFFfree(sp->ToLinearF);
-	if (sp->ToLinear16) _TIFFfree(sp->ToLinear16);
-	if (sp->ToLinear8) _TIFFfree(sp->ToLinear8);
 	if (sp->state&PLSTATE_INIT) {
 		if (tif->tif_mode == O_RDONLY)
 			inflateEnd(&sp->stream);
@@ -1305,8 +1338,8 @@ PixarLogCleanup(TIFF* tif)
 			deflateEnd(&sp->stream);
 	}
 	if (sp->tbuf)
-		_TIFFfree(sp->tbuf);
-	_TIFFfree(sp);
+		_TIFFfreeExt(tif, sp->tbuf);
+	_TIFFfreeExt(tif, sp);
 	tif->tif_data = NULL;
 
 	_TIFFSetDefaultCompressionState(tif);
@@ -1325,7 +1358,7 @@ PixarLogVSetField(TIFF* tif, uint32 tag, va_list ap)
 		if (tif->tif_mode != O_RDONLY && (sp->state&PLSTATE_INIT)) {
 			if (deflateParams(&sp->stream,
 			    sp->quality, Z_DEFAULT_STRATEGY) != Z_OK) {
-				TIFFErrorExt(tif->tif_clientdata, module, "ZLib error: %s",
+				TIFFErrorExtR(tif, module, "ZLib error: %s",
 					sp->stream.msg ? sp->stream.msg : "(null)");
 				return (0);
 			}
@@ -1411,7 +1444,7 @@ TIFFInitPixarLog(TIFF* tif, int scheme)
 	 */
 	if (!_TIFFMergeFields(tif, pixarlogFields,
 			      TIFFArrayCount(pixarlogFields))) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Merging PixarLog codec-specific tags failed");
 		return 0;
 	}
@@ -1419,7 +1452,7 @@ TIFFInitPixarLog(TIFF* tif, int scheme)
 	/*
 	 * Allocate state block so tag methods have storage to record values.
 	 */
-	tif->tif_data = (uint8*) _TIFFmalloc(sizeof (PixarLogState));
+	tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof (PixarLogState));
 	if (tif->tif_data == NULL)
 		goto bad;
 	sp = (PixarLogState*) tif->tif_data;
@@ -1463,11 +1496,11 @@ TIFFInitPixarLog(TIFF* tif, int scheme)
 	/*
 	 * build the companding tables 
 	 */
-	PixarLogMakeTables(sp);
+	PixarLogMakeTables(tif, sp);
 
 	return (1);
 bad:
-	TIFFErrorExt(tif->tif_clientdata, module,
+	TIFFErrorExtR(tif, module,
 		     "No space for PixarLog state block");
 	return (0);
 }
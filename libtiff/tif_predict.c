@@ -30,20 +30,33 @@
 #include "tiffiop.h"
 #include "tif_predict.h"
 
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#elif defined(TIFF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
 #define	PredictorState(tif)	((TIFFPredictorState*) (tif)->tif_data)
 
 static int horAcc8(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int horAcc16(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int horAcc32(TIFF* tif, uint8* cp0, tmsize_t cc);
+static int horAcc64(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int swabHorAcc16(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int swabHorAcc32(TIFF* tif, uint8* cp0, tmsize_t cc);
+static int swabHorAcc64(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int horDiff8(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int horDiff16(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int horDiff32(TIFF* tif, uint8* cp0, tmsize_t cc);
+static int horDiff64(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int swabHorDiff16(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int swabHorDiff32(TIFF* tif, uint8* cp0, tmsize_t cc);
+static int swabHorDiff64(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int fpAcc(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int fpDiff(TIFF* tif, uint8* cp0, tmsize_t cc);
+static int byteUnshuffle(TIFF* tif, uint8* cp0, tmsize_t cc);
+static int byteShuffle(TIFF* tif, uint8* cp0, tmsize_t cc);
 static int PredictorDecodeRow(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s);
 static int PredictorDecodeTile(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s);
 static int PredictorEncodeRow(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s);
@@ -64,8 +77,9 @@ PredictorSetup(TIFF* tif)
 		case PREDICTOR_HORIZONTAL:
 			if (td->td_bitspersample != 8
 			    && td->td_bitspersample != 16
-			    && td->td_bitspersample != 32) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+			    && td->td_bitspersample != 32
+			    && td->td_bitspersample != 64) {
+				TIFFErrorExtR(tif, module,
 				    "Horizontal differencing \"Predictor\" not supported with %d-bit samples",
 				    td->td_bitspersample);
 				return 0;
@@ -73,7 +87,7 @@ PredictorSetup(TIFF* tif)
 			break;
 		case PREDICTOR_FLOATINGPOINT:
 			if (td->td_sampleformat != SAMPLEFORMAT_IEEEFP) {
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 				    "Floating point \"Predictor\" not supported with %d data format",
 				    td->td_sampleformat);
 				return 0;
@@ -82,14 +96,25 @@ PredictorSetup(TIFF* tif)
                             && td->td_bitspersample != 24
                             && td->td_bitspersample != 32
                             && td->td_bitspersample != 64) { /* Should 64 be allowed? */
-                                TIFFErrorExt(tif->tif_clientdata, module,
+                                TIFFErrorExtR(tif, module,
                                              "Floating point \"Predictor\" not supported with %d-bit samples",
                                              td->td_bitspersample);
 				return 0;
                             }
 			break;
+		case PREDICTOR_SHUFFLE:
+			if (td->td_bitspersample != 16
+			    && td->td_bitspersample != 24
+			    && td->td_bitspersample != 32
+			    && td->td_bitspersample != 64) {
+				TIFFErrorExtR(tif, module,
+				    "Byte shuffle \"Predictor\" not supported with %d-bit samples",
+				    td->td_bitspersample);
+				return 0;
+			}
+			break;
 		default:
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "\"Predictor\" value %d not supported",
 			    sp->predictor);
 			return 0;
@@ -126,6 +151,7 @@ PredictorSetupDecode(TIFF* tif)
 			case 8:  sp->decodepfunc = horAcc8; break;
 			case 16: sp->decodepfunc = horAcc16; break;
 			case 32: sp->decodepfunc = horAcc32; break;
+			case 64: sp->decodepfunc = horAcc64; break;
 		}
 		/*
 		 * Override default decoding method with one that does the
@@ -155,12 +181,15 @@ PredictorSetupDecode(TIFF* tif)
             } else if (sp->decodepfunc == horAcc32) {
 				sp->decodepfunc = swabHorAcc32;
 				tif->tif_postdecode = _TIFFNoPostDecode;
+            } else if (sp->decodepfunc == horAcc64) {
+				sp->decodepfunc = swabHorAcc64;
+				tif->tif_postdecode = _TIFFNoPostDecode;
             }
 		}
 	}
 
-	else if (sp->predictor == 3) {
-		sp->decodepfunc = fpAcc;
+	else if (sp->predictor == 3 || sp->predictor == PREDICTOR_SHUFFLE) {
+		sp->decodepfunc = sp->predictor == 3 ? fpAcc : byteUnshuffle;
 		/*
 		 * Override default decoding method with one that does the
 		 * predictor stuff.
@@ -176,8 +205,8 @@ PredictorSetupDecode(TIFF* tif)
                 }
 		/*
 		 * The data should not be swapped outside of the floating
-		 * point predictor, the accumulation routine should return
-		 * byres in the native order.
+		 * point and shuffle predictors, the accumulation routine
+		 * should return bytes in the native order.
 		 */
 		if (tif->tif_flags & TIFF_SWAB) {
 			tif->tif_postdecode = _TIFFNoPostDecode;
@@ -205,6 +234,7 @@ PredictorSetupEncode(TIFF* tif)
 			case 8:  sp->encodepfunc = horDiff8; break;
 			case 16: sp->encodepfunc = horDiff16; break;
 			case 32: sp->encodepfunc = horDiff32; break;
+			case 64: sp->encodepfunc = horDiff64; break;
 		}
 		/*
 		 * Override default encoding method with one that does the
@@ -234,12 +264,15 @@ PredictorSetupEncode(TIFF* tif)
                     } else if (sp->encodepfunc == horDiff32) {
                             sp->encodepfunc = swabHorDiff32;
                             tif->tif_postdecode = _TIFFNoPostDecode;
+                    } else if (sp->encodepfunc == horDiff64) {
+                            sp->encodepfunc = swabHorDiff64;
+                            tif->tif_postdecode = _TIFFNoPostDecode;
                     }
                 }
         }
 
-	else if (sp->predictor == 3) {
-		sp->encodepfunc = fpDiff;
+	else if (sp->predictor == 3 || sp->predictor == PREDICTOR_SHUFFLE) {
+		sp->encodepfunc = sp->predictor == 3 ? fpDiff : byteShuffle;
 		/*
 		 * Override default encoding method with one that does the
 		 * predictor stuff.
@@ -275,6 +308,751 @@ PredictorSetupEncode(TIFF* tif)
 /* - when storing into the byte stream, we explicitly mask with 0xff so */
 /*   as to make icc -check=conversions happy (not necessary by the standard) */
 
+/*
+ * SIMD versions of the 8 and 16-bit horizontal predictor.
+ *
+ * Accumulation is a running sum per channel: within a vector it is
+ * computed with log2(lanes/stride) shifted adds, then the last sums of
+ * the previous vector are added to every lane.  Differencing has no
+ * such dependency and works for any stride, going backwards through
+ * the row like the scalar code.  All routines take the whole row and
+ * finish it with scalar code.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSE2
+static void
+horAcc8SSE2(uint8* cp, tmsize_t cc, tmsize_t stride)
+{
+	uint8* p = cp + stride;
+	tmsize_t n = cc - stride;
+	__m128i x, c;
+
+	if (stride == 1) {
+		c = _mm_set1_epi8((char) cp[0]);
+		for (; n >= 16; n -= 16, p += 16) {
+			x = _mm_loadu_si128((const __m128i*) p);
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi8(x, c);
+			_mm_storeu_si128((__m128i*) p, x);
+			c = _mm_srli_si128(x, 15);
+			c = _mm_unpacklo_epi8(c, c);
+			c = _mm_shuffle_epi32(_mm_unpacklo_epi16(c, c), 0);
+		}
+	} else if (stride == 2) {
+		uint16 v;
+
+		_TIFFmemcpy(&v, cp, 2);
+		c = _mm_set1_epi16((short) v);
+		for (; n >= 16; n -= 16, p += 16) {
+			x = _mm_loadu_si128((const __m128i*) p);
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi8(x, c);
+			_mm_storeu_si128((__m128i*) p, x);
+			c = _mm_shufflehi_epi16(x, 0xff);
+			c = _mm_unpackhi_epi64(c, c);
+		}
+	} else if (stride == 4) {
+		uint32 v;
+
+		_TIFFmemcpy(&v, cp, 4);
+		c = _mm_set1_epi32((int) v);
+		for (; n >= 16; n -= 16, p += 16) {
+			x = _mm_loadu_si128((const __m128i*) p);
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi8(x, c);
+			_mm_storeu_si128((__m128i*) p, x);
+			c = _mm_shuffle_epi32(x, 0xff);
+		}
+	}
+	for (; n > 0; n--, p++)
+		p[0] = (uint8) ((p[0] + p[-stride]) & 0xff);
+}
+
+TIFF_TARGET_SSSE3
+static void
+horAcc8SSSE3(uint8* cp, tmsize_t cc)
+{
+	uint8* p = cp + 3;
+	tmsize_t n = cc - 3;
+	const __m128i last = _mm_setr_epi8(13, 14, 15, 13, 14, 15, 13, 14,
+	    15, 13, 14, 15, 13, 14, 15, 13);
+	__m128i x, c;
+
+	c = _mm_setr_epi8((char) cp[0], (char) cp[1], (char) cp[2],
+	    (char) cp[0], (char) cp[1], (char) cp[2], (char) cp[0],
+	    (char) cp[1], (char) cp[2], (char) cp[0], (char) cp[1],
+	    (char) cp[2], (char) cp[0], (char) cp[1], (char) cp[2],
+	    (char) cp[0]);
+	for (; n >= 16; n -= 16, p += 16) {
+		x = _mm_loadu_si128((const __m128i*) p);
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 12));
+		x = _mm_add_epi8(x, c);
+		_mm_storeu_si128((__m128i*) p, x);
+		/* 16 is not a multiple of 3: rotate the channels */
+		c = _mm_shuffle_epi8(x, last);
+	}
+	for (; n > 0; n--, p++)
+		p[0] = (uint8) ((p[0] + p[-3]) & 0xff);
+}
+
+TIFF_TARGET_SSE2
+static void
+horAcc16SSE2(uint16* wp, tmsize_t wc, tmsize_t stride)
+{
+	uint16* p = wp + stride;
+	tmsize_t n = wc - stride;
+	__m128i x, c;
+
+	if (stride == 1) {
+		c = _mm_set1_epi16((short) wp[0]);
+		for (; n >= 8; n -= 8, p += 8) {
+			x = _mm_loadu_si128((const __m128i*) p);
+			x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+			x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi16(x, c);
+			_mm_storeu_si128((__m128i*) p, x);
+			c = _mm_shufflehi_epi16(x, 0xff);
+			c = _mm_unpackhi_epi64(c, c);
+		}
+	} else if (stride == 2) {
+		uint32 v;
+
+		_TIFFmemcpy(&v, wp, 4);
+		c = _mm_set1_epi32((int) v);
+		for (; n >= 8; n -= 8, p += 8) {
+			x = _mm_loadu_si128((const __m128i*) p);
+			x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi16(x, c);
+			_mm_storeu_si128((__m128i*) p, x);
+			c = _mm_shuffle_epi32(x, 0xff);
+		}
+	} else if (stride == 4) {
+		c = _mm_loadl_epi64((const __m128i*) wp);
+		c = _mm_unpacklo_epi64(c, c);
+		for (; n >= 8; n -= 8, p += 8) {
+			x = _mm_loadu_si128((const __m128i*) p);
+			x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi16(x, c);
+			_mm_storeu_si128((__m128i*) p, x);
+			c = _mm_unpackhi_epi64(x, x);
+		}
+	}
+	for (; n > 0; n--, p++)
+		p[0] = (uint16) ((p[0] + p[-stride]) & 0xffff);
+}
+
+TIFF_TARGET_SSSE3
+static void
+horAcc16SSSE3(uint16* wp, tmsize_t wc)
+{
+	uint16* p = wp + 3;
+	tmsize_t n = wc - 3;
+	const __m128i last = _mm_setr_epi8(10, 11, 12, 13, 14, 15, 10, 11,
+	    12, 13, 14, 15, 10, 11, 12, 13);
+	__m128i x, c;
+
+	c = _mm_setr_epi16((short) wp[0], (short) wp[1], (short) wp[2],
+	    (short) wp[0], (short) wp[1], (short) wp[2], (short) wp[0],
+	    (short) wp[1]);
+	for (; n >= 8; n -= 8, p += 8) {
+		x = _mm_loadu_si128((const __m128i*) p);
+		x = _mm_add_epi16(x, _mm_slli_si128(x, 6));
+		x = _mm_add_epi16(x, _mm_slli_si128(x, 12));
+		x = _mm_add_epi16(x, c);
+		_mm_storeu_si128((__m128i*) p, x);
+		c = _mm_shuffle_epi8(x, last);
+	}
+	for (; n > 0; n--, p++)
+		p[0] = (uint16) ((p[0] + p[-3]) & 0xffff);
+}
+
+TIFF_TARGET_SSE2
+static void
+horDiff8SSE2(uint8* cp, tmsize_t cc, tmsize_t stride)
+{
+	uint8* p = cp + cc;
+	tmsize_t n = cc - stride;
+
+	for (; n >= 16; n -= 16) {
+		__m128i x, y;
+
+		p -= 16;
+		x = _mm_loadu_si128((const __m128i*) p);
+		y = _mm_loadu_si128((const __m128i*) (p - stride));
+		_mm_storeu_si128((__m128i*) p, _mm_sub_epi8(x, y));
+	}
+	while (n-- > 0) {
+		p--;
+		p[0] = (uint8) ((p[0] - p[-stride]) & 0xff);
+	}
+}
+
+TIFF_TARGET_SSE2
+static void
+horDiff16SSE2(uint16* wp, tmsize_t wc, tmsize_t stride)
+{
+	uint16* p = wp + wc;
+	tmsize_t n = wc - stride;
+
+	for (; n >= 8; n -= 8) {
+		__m128i x, y;
+
+		p -= 8;
+		x = _mm_loadu_si128((const __m128i*) p);
+		y = _mm_loadu_si128((const __m128i*) (p - stride));
+		_mm_storeu_si128((__m128i*) p, _mm_sub_epi16(x, y));
+	}
+	while (n-- > 0) {
+		p--;
+		p[0] = (uint16) ((p[0] - p[-stride]) & 0xffff);
+	}
+}
+
+/*
+ * Kernel entries: the SSSE3 variants add stride 3 to the SSE2 ones.
+ */
+static int
+horAcc8KernelSSE2(uint8* cp, tmsize_t cc, tmsize_t stride)
+{
+	if (stride != 1 && stride != 2 && stride != 4)
+		return 0;
+	horAcc8SSE2(cp, cc, stride);
+	return 1;
+}
+
+static int
+horAcc8KernelSSSE3(uint8* cp, tmsize_t cc, tmsize_t stride)
+{
+	if (stride != 3)
+		return horAcc8KernelSSE2(cp, cc, stride);
+	horAcc8SSSE3(cp, cc);
+	return 1;
+}
+
+static int
+horAcc16KernelSSE2(uint16* wp, tmsize_t wc, tmsize_t stride)
+{
+	if (stride != 1 && stride != 2 && stride != 4)
+		return 0;
+	horAcc16SSE2(wp, wc, stride);
+	return 1;
+}
+
+static int
+horAcc16KernelSSSE3(uint16* wp, tmsize_t wc, tmsize_t stride)
+{
+	if (stride != 3)
+		return horAcc16KernelSSE2(wp, wc, stride);
+	horAcc16SSSE3(wp, wc);
+	return 1;
+}
+
+static int
+horDiff8KernelSSE2(uint8* cp, tmsize_t cc, tmsize_t stride)
+{
+	horDiff8SSE2(cp, cc, stride);
+	return 1;
+}
+
+static int
+horDiff16KernelSSE2(uint16* wp, tmsize_t wc, tmsize_t stride)
+{
+	horDiff16SSE2(wp, wc, stride);
+	return 1;
+}
+
+/*
+ * The floating point and byte shuffle predictors store the bytes of
+ * each sample in separate planes, most significant first.  planes[k]
+ * below is the plane holding byte k of the samples in memory order.
+ * These return the number of samples done, a multiple of 16.
+ */
+TIFF_TARGET_SSE2
+static tmsize_t
+fpMergeBytesSSE2(uint8* cp, const uint8* const* planes, tmsize_t wc,
+    uint32 bps)
+{
+	tmsize_t i = 0;
+
+	if (bps == 2) {
+		for (; i + 16 <= wc; i += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i*) (planes[0] + i));
+			__m128i b = _mm_loadu_si128((const __m128i*) (planes[1] + i));
+			__m128i* out = (__m128i*) (cp + 2 * i);
+
+			_mm_storeu_si128(out, _mm_unpacklo_epi8(a, b));
+			_mm_storeu_si128(out + 1, _mm_unpackhi_epi8(a, b));
+		}
+	} else if (bps == 4) {
+		for (; i + 16 <= wc; i += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i*) (planes[0] + i));
+			__m128i b = _mm_loadu_si128((const __m128i*) (planes[1] + i));
+			__m128i c = _mm_loadu_si128((const __m128i*) (planes[2] + i));
+			__m128i d = _mm_loadu_si128((const __m128i*) (planes[3] + i));
+			__m128i ab = _mm_unpacklo_epi8(a, b);
+			__m128i cd = _mm_unpacklo_epi8(c, d);
+			__m128i* out = (__m128i*) (cp + 4 * i);
+
+			_mm_storeu_si128(out, _mm_unpacklo_epi16(ab, cd));
+			_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(ab, cd));
+			ab = _mm_unpackhi_epi8(a, b);
+			cd = _mm_unpackhi_epi8(c, d);
+			_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(ab, cd));
+			_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(ab, cd));
+		}
+	} else if (bps == 8) {
+		for (; i + 16 <= wc; i += 16) {
+			__m128i v[8], s01, s23, s45, s67, q0, q1;
+			__m128i* out = (__m128i*) (cp + 8 * i);
+			int k, half;
+
+			for (k = 0; k < 8; k++)
+				v[k] = _mm_loadu_si128((const __m128i*) (planes[k] + i));
+			for (half = 0; half < 2; half++, out += 4) {
+				if (half == 0) {
+					s01 = _mm_unpacklo_epi8(v[0], v[1]);
+					s23 = _mm_unpacklo_epi8(v[2], v[3]);
+					s45 = _mm_unpacklo_epi8(v[4], v[5]);
+					s67 = _mm_unpacklo_epi8(v[6], v[7]);
+				} else {
+					s01 = _mm_unpackhi_epi8(v[0], v[1]);
+					s23 = _mm_unpackhi_epi8(v[2], v[3]);
+					s45 = _mm_unpackhi_epi8(v[4], v[5]);
+					s67 = _mm_unpackhi_epi8(v[6], v[7]);
+				}
+				q0 = _mm_unpacklo_epi16(s01, s23);
+				q1 = _mm_unpacklo_epi16(s45, s67);
+				_mm_storeu_si128(out, _mm_unpacklo_epi32(q0, q1));
+				_mm_storeu_si128(out + 1, _mm_unpackhi_epi32(q0, q1));
+				q0 = _mm_unpackhi_epi16(s01, s23);
+				q1 = _mm_unpackhi_epi16(s45, s67);
+				_mm_storeu_si128(out + 2, _mm_unpacklo_epi32(q0, q1));
+				_mm_storeu_si128(out + 3, _mm_unpackhi_epi32(q0, q1));
+			}
+		}
+	}
+	return i;
+}
+
+TIFF_TARGET_SSSE3
+static tmsize_t
+fpSplitBytesSSSE3(uint8* const* planes, const uint8* cp, tmsize_t wc,
+    uint32 bps)
+{
+	tmsize_t i = 0;
+
+	if (bps == 2) {
+		/* Even bytes are the low halves of the words */
+		const __m128i m = _mm_set1_epi16(0xff);
+
+		for (; i + 16 <= wc; i += 16) {
+			const __m128i* in = (const __m128i*) (cp + 2 * i);
+			__m128i v0 = _mm_loadu_si128(in);
+			__m128i v1 = _mm_loadu_si128(in + 1);
+
+			_mm_storeu_si128((__m128i*) (planes[0] + i),
+			    _mm_packus_epi16(_mm_and_si128(v0, m),
+			    _mm_and_si128(v1, m)));
+			_mm_storeu_si128((__m128i*) (planes[1] + i),
+			    _mm_packus_epi16(_mm_srli_epi16(v0, 8),
+			    _mm_srli_epi16(v1, 8)));
+		}
+	} else if (bps == 4) {
+		/* Group the bytes of 4 samples, then transpose 4x4 words */
+		const __m128i m = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13,
+		    2, 6, 10, 14, 3, 7, 11, 15);
+
+		for (; i + 16 <= wc; i += 16) {
+			const __m128i* in = (const __m128i*) (cp + 4 * i);
+			__m128i v0 = _mm_shuffle_epi8(_mm_loadu_si128(in), m);
+			__m128i v1 = _mm_shuffle_epi8(_mm_loadu_si128(in + 1), m);
+			__m128i v2 = _mm_shuffle_epi8(_mm_loadu_si128(in + 2), m);
+			__m128i v3 = _mm_shuffle_epi8(_mm_loadu_si128(in + 3), m);
+			__m128i t0 = _mm_unpacklo_epi32(v0, v1);
+			__m128i t1 = _mm_unpackhi_epi32(v0, v1);
+			__m128i t2 = _mm_unpacklo_epi32(v2, v3);
+			__m128i t3 = _mm_unpackhi_epi32(v2, v3);
+
+			_mm_storeu_si128((__m128i*) (planes[0] + i), _mm_unpacklo_epi64(t0, t2));
+			_mm_storeu_si128((__m128i*) (planes[1] + i), _mm_unpackhi_epi64(t0, t2));
+			_mm_storeu_si128((__m128i*) (planes[2] + i), _mm_unpacklo_epi64(t1, t3));
+			_mm_storeu_si128((__m128i*) (planes[3] + i), _mm_unpackhi_epi64(t1, t3));
+		}
+	} else if (bps == 8) {
+		/* Pair the bytes of 2 samples, then transpose 8x8 halfwords */
+		const __m128i m = _mm_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11,
+		    4, 12, 5, 13, 6, 14, 7, 15);
+
+		for (; i + 16 <= wc; i += 16) {
+			const __m128i* in = (const __m128i*) (cp + 8 * i);
+			__m128i v[8], a[8], b[8];
+			int k;
+
+			for (k = 0; k < 8; k++)
+				v[k] = _mm_shuffle_epi8(_mm_loadu_si128(in + k), m);
+			for (k = 0; k < 8; k += 2) {
+				a[k] = _mm_unpacklo_epi16(v[k], v[k + 1]);
+				a[k + 1] = _mm_unpackhi_epi16(v[k], v[k + 1]);
+			}
+			for (k = 0; k < 8; k += 4) {
+				b[k] = _mm_unpacklo_epi32(a[k], a[k + 2]);
+				b[k + 1] = _mm_unpackhi_epi32(a[k], a[k + 2]);
+				b[k + 2] = _mm_unpacklo_epi32(a[k + 1], a[k + 3]);
+				b[k + 3] = _mm_unpackhi_epi32(a[k + 1], a[k + 3]);
+			}
+			for (k = 0; k < 4; k++) {
+				_mm_storeu_si128((__m128i*) (planes[2 * k] + i),
+				    _mm_unpacklo_epi64(b[k], b[k + 4]));
+				_mm_storeu_si128((__m128i*) (planes[2 * k + 1] + i),
+				    _mm_unpackhi_epi64(b[k], b[k + 4]));
+			}
+		}
+	}
+	return i;
+}
+#elif defined(TIFF_SIMD_NEON)
+static uint8x16_t
+horAccNEON8(uint8x16_t x, uint8x16_t c)
+{
+	const uint8x16_t z = vdupq_n_u8(0);
+
+	x = vaddq_u8(x, vextq_u8(z, x, 15));
+	x = vaddq_u8(x, vextq_u8(z, x, 14));
+	x = vaddq_u8(x, vextq_u8(z, x, 12));
+	x = vaddq_u8(x, vextq_u8(z, x, 8));
+	return vaddq_u8(x, c);
+}
+
+static uint16x8_t
+horAccNEON16(uint16x8_t x, uint16x8_t c)
+{
+	const uint16x8_t z = vdupq_n_u16(0);
+
+	x = vaddq_u16(x, vextq_u16(z, x, 7));
+	x = vaddq_u16(x, vextq_u16(z, x, 6));
+	x = vaddq_u16(x, vextq_u16(z, x, 4));
+	return vaddq_u16(x, c);
+}
+
+/*
+ * With interleaved loads each vector holds consecutive samples of a
+ * single channel, so every stride reduces to the stride 1 case.
+ */
+static int
+horAcc8NEON(uint8* cp, tmsize_t cc, tmsize_t stride)
+{
+	uint8* p = cp + stride;
+	tmsize_t n = cc - stride;
+
+	if (stride == 1) {
+		uint8x16_t x, c = vdupq_n_u8(cp[0]);
+
+		for (; n >= 16; n -= 16, p += 16) {
+			x = horAccNEON8(vld1q_u8(p), c);
+			vst1q_u8(p, x);
+			c = vdupq_n_u8(vgetq_lane_u8(x, 15));
+		}
+	} else if (stride == 3) {
+		uint8x16x3_t x, c;
+		int i;
+
+		for (i = 0; i < 3; i++)
+			c.val[i] = vdupq_n_u8(cp[i]);
+		for (; n >= 48; n -= 48, p += 48) {
+			x = vld3q_u8(p);
+			for (i = 0; i < 3; i++) {
+				x.val[i] = horAccNEON8(x.val[i], c.val[i]);
+				c.val[i] = vdupq_n_u8(vgetq_lane_u8(x.val[i], 15));
+			}
+			vst3q_u8(p, x);
+		}
+	} else if (stride == 4) {
+		uint8x16x4_t x, c;
+		int i;
+
+		for (i = 0; i < 4; i++)
+			c.val[i] = vdupq_n_u8(cp[i]);
+		for (; n >= 64; n -= 64, p += 64) {
+			x = vld4q_u8(p);
+			for (i = 0; i < 4; i++) {
+				x.val[i] = horAccNEON8(x.val[i], c.val[i]);
+				c.val[i] = vdupq_n_u8(vgetq_lane_u8(x.val[i], 15));
+			}
+			vst4q_u8(p, x);
+		}
+	} else
+		return 0;
+	for (; n > 0; n--, p++)
+		p[0] = (uint8) ((p[0] + p[-stride]) & 0xff);
+	return 1;
+}
+
+static int
+horAcc16NEON(uint16* wp, tmsize_t wc, tmsize_t stride)
+{
+	uint16* p = wp + stride;
+	tmsize_t n = wc - stride;
+
+	if (stride == 1) {
+		uint16x8_t x, c = vdupq_n_u16(wp[0]);
+
+		for (; n >= 8; n -= 8, p += 8) {
+			x = horAccNEON16(vld1q_u16(p), c);
+			vst1q_u16(p, x);
+			c = vdupq_n_u16(vgetq_lane_u16(x, 7));
+		}
+	} else if (stride == 3) {
+		uint16x8x3_t x, c;
+		int i;
+
+		for (i = 0; i < 3; i++)
+			c.val[i] = vdupq_n_u16(wp[i]);
+		for (; n >= 24; n -= 24, p += 24) {
+			x = vld3q_u16(p);
+			for (i = 0; i < 3; i++) {
+				x.val[i] = horAccNEON16(x.val[i], c.val[i]);
+				c.val[i] = vdupq_n_u16(vgetq_lane_u16(x.val[i], 7));
+			}
+			vst3q_u16(p, x);
+		}
+	} else if (stride == 4) {
+		uint16x8x4_t x, c;
+		int i;
+
+		for (i = 0; i < 4; i++)
+			c.val[i] = vdupq_n_u16(wp[i]);
+		for (; n >= 32; n -= 32, p += 32) {
+			x = vld4q_u16(p);
+			for (i = 0; i < 4; i++) {
+				x.val[i] = horAccNEON16(x.val[i], c.val[i]);
+				c.val[i] = vdupq_n_u16(vgetq_lane_u16(x.val[i], 7));
+			}
+			vst4q_u16(p, x);
+		}
+	} else
+		return 0;
+	for (; n > 0; n--, p++)
+		p[0] = (uint16) ((p[0] + p[-stride]) & 0xffff);
+	return 1;
+}
+
+static int
+horDiff8NEON(uint8* cp, tmsize_t cc, tmsize_t stride)
+{
+	uint8* p = cp + cc;
+	tmsize_t n = cc - stride;
+
+	for (; n >= 16; n -= 16) {
+		p -= 16;
+		vst1q_u8(p, vsubq_u8(vld1q_u8(p), vld1q_u8(p - stride)));
+	}
+	while (n-- > 0) {
+		p--;
+		p[0] = (uint8) ((p[0] - p[-stride]) & 0xff);
+	}
+	return 1;
+}
+
+static int
+horDiff16NEON(uint16* wp, tmsize_t wc, tmsize_t stride)
+{
+	uint16* p = wp + wc;
+	tmsize_t n = wc - stride;
+
+	for (; n >= 8; n -= 8) {
+		p -= 8;
+		vst1q_u16(p, vsubq_u16(vld1q_u16(p), vld1q_u16(p - stride)));
+	}
+	while (n-- > 0) {
+		p--;
+		p[0] = (uint16) ((p[0] - p[-stride]) & 0xffff);
+	}
+	return 1;
+}
+
+/*
+ * The floating point predictor stores the bytes of each sample in
+ * separate planes, most significant first.  planes[k] below is the
+ * plane holding byte k of the samples in memory order.  These return
+ * the number of samples done, a multiple of 16.  Doubles go through
+ * 4-way interleaving of byte pairs (k, k + 4).
+ */
+static tmsize_t
+fpMergeBytesNEON(uint8* cp, const uint8* const* planes, tmsize_t wc,
+    uint32 bps)
+{
+	tmsize_t i = 0;
+
+	if (bps == 2) {
+		for (; i + 16 <= wc; i += 16) {
+			uint8x16x2_t v;
+
+			v.val[0] = vld1q_u8(planes[0] + i);
+			v.val[1] = vld1q_u8(planes[1] + i);
+			vst2q_u8(cp + 2 * i, v);
+		}
+	} else if (bps == 4) {
+		for (; i + 16 <= wc; i += 16) {
+			uint8x16x4_t v;
+			int k;
+
+			for (k = 0; k < 4; k++)
+				v.val[k] = vld1q_u8(planes[k] + i);
+			vst4q_u8(cp + 4 * i, v);
+		}
+	} else if (bps == 8) {
+		for (; i + 16 <= wc; i += 16) {
+			uint8x16x4_t lo, hi;
+			int k;
+
+			for (k = 0; k < 4; k++) {
+				uint8x16x2_t z = vzipq_u8(vld1q_u8(planes[k] + i),
+				    vld1q_u8(planes[k + 4] + i));
+				lo.val[k] = z.val[0];
+				hi.val[k] = z.val[1];
+			}
+			vst4q_u8(cp + 8 * i, lo);
+			vst4q_u8(cp + 8 * i + 64, hi);
+		}
+	}
+	return i;
+}
+
+static tmsize_t
+fpSplitBytesNEON(uint8* const* planes, const uint8* cp, tmsize_t wc,
+    uint32 bps)
+{
+	tmsize_t i = 0;
+
+	if (bps == 2) {
+		for (; i + 16 <= wc; i += 16) {
+			uint8x16x2_t v = vld2q_u8(cp + 2 * i);
+
+			vst1q_u8(planes[0] + i, v.val[0]);
+			vst1q_u8(planes[1] + i, v.val[1]);
+		}
+	} else if (bps == 4) {
+		for (; i + 16 <= wc; i += 16) {
+			uint8x16x4_t v = vld4q_u8(cp + 4 * i);
+			int k;
+
+			for (k = 0; k < 4; k++)
+				vst1q_u8(planes[k] + i, v.val[k]);
+		}
+	} else if (bps == 8) {
+		for (; i + 16 <= wc; i += 16) {
+			uint8x16x4_t lo = vld4q_u8(cp + 8 * i);
+			uint8x16x4_t hi = vld4q_u8(cp + 8 * i + 64);
+			int k;
+
+			for (k = 0; k < 4; k++) {
+				uint8x16x2_t u = vuzpq_u8(lo.val[k], hi.val[k]);
+				vst1q_u8(planes[k] + i, u.val[0]);
+				vst1q_u8(planes[k + 4] + i, u.val[1]);
+			}
+		}
+	}
+	return i;
+}
+#endif
+
+void
+_TIFFPredictorKernels(TIFFKernels* k, int features)
+{
+#if defined(TIFF_SIMD_X86)
+	if (features & TIFF_CPU_SSE2) {
+		k->horAcc8 = horAcc8KernelSSE2;
+		k->horAcc16 = horAcc16KernelSSE2;
+		k->horDiff8 = horDiff8KernelSSE2;
+		k->horDiff16 = horDiff16KernelSSE2;
+		k->fpMergeBytes = fpMergeBytesSSE2;
+		if (features & TIFF_CPU_SSSE3) {
+			k->horAcc8 = horAcc8KernelSSSE3;
+			k->horAcc16 = horAcc16KernelSSSE3;
+			k->fpSplitBytes = fpSplitBytesSSSE3;
+		}
+	}
+#elif defined(TIFF_SIMD_NEON)
+	if (features & TIFF_CPU_NEON) {
+		k->horAcc8 = horAcc8NEON;
+		k->horAcc16 = horAcc16NEON;
+		k->horDiff8 = horDiff8NEON;
+		k->horDiff16 = horDiff16NEON;
+		k->fpMergeBytes = fpMergeBytesNEON;
+		k->fpSplitBytes = fpSplitBytesNEON;
+	}
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+/*
+ * Run the kernel for the CPU if there is one; 0 means the caller
+ * must do the work.
+ */
+static int
+horAcc8SIMD(uint8* cp, tmsize_t cc, tmsize_t stride)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return k->horAcc8 != NULL && (*k->horAcc8)(cp, cc, stride);
+}
+
+static int
+horAcc16SIMD(uint16* wp, tmsize_t wc, tmsize_t stride)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return k->horAcc16 != NULL && (*k->horAcc16)(wp, wc, stride);
+}
+
+static int
+horDiff8SIMD(uint8* cp, tmsize_t cc, tmsize_t stride)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return k->horDiff8 != NULL && (*k->horDiff8)(cp, cc, stride);
+}
+
+static int
+horDiff16SIMD(uint16* wp, tmsize_t wc, tmsize_t stride)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return k->horDiff16 != NULL && (*k->horDiff16)(wp, wc, stride);
+}
+
+static tmsize_t
+fpMergeBytesSIMD(uint8* cp, const uint8* const* planes, tmsize_t wc,
+    uint32 bps)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return k->fpMergeBytes != NULL ?
+	    (*k->fpMergeBytes)(cp, planes, wc, bps) : 0;
+}
+
+static tmsize_t
+fpSplitBytesSIMD(uint8* const* planes, const uint8* cp, tmsize_t wc,
+    uint32 bps)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return k->fpSplitBytes != NULL ?
+	    (*k->fpSplitBytes)(planes, cp, wc, bps) : 0;
+}
+
 TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW
 static int
 horAcc8(TIFF* tif, uint8* cp0, tmsize_t cc)
@@ -284,11 +1062,13 @@ horAcc8(TIFF* tif, uint8* cp0, tmsize_t cc)
 	unsigned char* cp = (unsigned char*) cp0;
     if((cc%stride)!=0)
     {
-        TIFFErrorExt(tif->tif_clientdata, "horAcc8",
+        TIFFErrorExtR(tif, "horAcc8",
                      "%s", "(cc%stride)!=0");
         return 0;
     }
 
+	if (cc > stride && horAcc8SIMD(cp, cc, stride))
+		return 1;
 	if (cc > stride) {
 		/*
 		 * Pipeline the most common cases.
@@ -333,74 +1113,194 @@ horAcc8(TIFF* tif, uint8* cp0, tmsize_t cc)
 	return 1;
 }
 
-static int
-swabHorAcc16(TIFF* tif, uint8* cp0, tmsize_t cc)
-{
-	uint16* wp = (uint16*) cp0;
-	tmsize_t wc = cc / 2;
+/*
+ * Horizontal accumulation and differencing of 16, 32 and 64-bit samples,
+ * all made from the same code.  The swab variants, for files of the
+ * other byte order, swap the bytes of each sample as it is accumulated
+ * or once it is differenced, in the same pass.  When the CPU has a SIMD
+ * kernel for the width, the row is swapped on its own and the kernel
+ * does the rest.
+ */
+#define	SWAB16(v)	((uint16) (((v) >> 8) | ((v) << 8)))
+#define	SWAB32(v)	((((v) >> 24) & 0xff) | (((v) >> 8) & 0xff00) | \
+			 (((v) & 0xff00) << 8) | ((v) << 24))
+#define	SWAB64(v)	(((uint64) SWAB32((uint32) (v)) << 32) | \
+			 SWAB32((uint32) ((v) >> 32)))
+#define	NOSWAB(v)	(v)
+
+#define	HORACC_LOOP(type, swab) {					\
+	tmsize_t i;							\
+	for (i = 0; i < stride; i++)					\
+		wp[i] = swab(wp[i]);					\
+	for (; i < wc; i++)						\
+		wp[i] = (type) (swab(wp[i]) + wp[i - stride]);		\
+}
 
-        TIFFSwabArrayOfShort(wp, wc);
-        return horAcc16(tif, cp0, cc);
+#define	HORDIFF_LOOP(type, swab) {					\
+	tmsize_t i;							\
+	for (i = wc - 1; i >= stride; i--)				\
+		wp[i] = swab((type) (wp[i] - wp[i - stride]));		\
+	for (; i >= 0; i--)						\
+		wp[i] = swab(wp[i]);					\
 }
 
-TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW
-static int
-horAcc16(TIFF* tif, uint8* cp0, tmsize_t cc)
-{
-	tmsize_t stride = PredictorState(tif)->stride;
-	uint16* wp = (uint16*) cp0;
-	tmsize_t wc = cc / 2;
+#define	HORPREDICTOR(bits, type, swabarray, acckernel, hasacc, diffkernel, hasdiff) \
+TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW					\
+static int								\
+horAcc##bits(TIFF* tif, uint8* cp0, tmsize_t cc)			\
+{									\
+	tmsize_t stride = PredictorState(tif)->stride;			\
+	type* wp = (type*) cp0;						\
+	tmsize_t wc = cc / (bits / 8);					\
+									\
+	if ((cc % ((bits / 8) * stride)) != 0) {			\
+		TIFFErrorExtR(tif, "horAcc" #bits, "%s",		\
+		    "(cc%(" #bits "/8*stride))!=0");			\
+		return 0;						\
+	}								\
+	if (wc > stride && !acckernel(wp, wc, stride))			\
+		HORACC_LOOP(type, NOSWAB)				\
+	return 1;							\
+}									\
+									\
+TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW					\
+static int								\
+swabHorAcc##bits(TIFF* tif, uint8* cp0, tmsize_t cc)			\
+{									\
+	tmsize_t stride = PredictorState(tif)->stride;			\
+	type* wp = (type*) cp0;						\
+	tmsize_t wc = cc / (bits / 8);					\
+									\
+	if ((cc % ((bits / 8) * stride)) != 0) {			\
+		TIFFErrorExtR(tif, "swabHorAcc" #bits, "%s",		\
+		    "(cc%(" #bits "/8*stride))!=0");			\
+		return 0;						\
+	}								\
+	if (wc <= stride || hasacc) {					\
+		swabarray(wp, wc);					\
+		return horAcc##bits(tif, cp0, cc);			\
+	}								\
+	HORACC_LOOP(type, SWAB##bits)					\
+	return 1;							\
+}									\
+									\
+TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW					\
+static int								\
+horDiff##bits(TIFF* tif, uint8* cp0, tmsize_t cc)			\
+{									\
+	tmsize_t stride = PredictorState(tif)->stride;			\
+	type* wp = (type*) cp0;						\
+	tmsize_t wc = cc / (bits / 8);					\
+									\
+	if ((cc % ((bits / 8) * stride)) != 0) {			\
+		TIFFErrorExtR(tif, "horDiff" #bits, "%s",		\
+		    "(cc%(" #bits "/8*stride))!=0");			\
+		return 0;						\
+	}								\
+	if (wc > stride && !diffkernel(wp, wc, stride))			\
+		HORDIFF_LOOP(type, NOSWAB)				\
+	return 1;							\
+}									\
+									\
+TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW					\
+static int								\
+swabHorDiff##bits(TIFF* tif, uint8* cp0, tmsize_t cc)			\
+{									\
+	tmsize_t stride = PredictorState(tif)->stride;			\
+	type* wp = (type*) cp0;						\
+	tmsize_t wc = cc / (bits / 8);					\
+									\
+	if ((cc % ((bits / 8) * stride)) != 0) {			\
+		TIFFErrorExtR(tif, "swabHorDiff" #bits, "%s",		\
+		    "(cc%(" #bits "/8*stride))!=0");			\
+		return 0;						\
+	}								\
+	if (wc <= stride || hasdiff) {					\
+		if (!horDiff##bits(tif, cp0, cc))			\
+			return 0;					\
+		swabarray(wp, wc);					\
+		return 1;						\
+	}								\
+	HORDIFF_LOOP(type, SWAB##bits)					\
+	return 1;							\
+}
 
-    if((cc%(2*stride))!=0)
-    {
-        TIFFErrorExt(tif->tif_clientdata, "horAcc16",
-                     "%s", "cc%(2*stride))!=0");
-        return 0;
-    }
+#define	NOKERNEL(wp, wc, stride)	0
 
-	if (wc > stride) {
-		wc -= stride;
-		do {
-			REPEAT4(stride, wp[stride] = (uint16)(((unsigned int)wp[stride] + (unsigned int)wp[0]) & 0xffff); wp++)
-			wc -= stride;
-		} while (wc > 0);
+HORPREDICTOR(16, uint16, TIFFSwabArrayOfShort,
+    horAcc16SIMD, _TIFFGetKernels()->horAcc16 != NULL,
+    horDiff16SIMD, _TIFFGetKernels()->horDiff16 != NULL)
+HORPREDICTOR(32, uint32, TIFFSwabArrayOfLong,
+    NOKERNEL, 0, NOKERNEL, 0)
+HORPREDICTOR(64, uint64, TIFFSwabArrayOfLong8,
+    NOKERNEL, 0, NOKERNEL, 0)
+
+static void
+fpPlanes(const uint8* tmp, tmsize_t wc, uint32 bps, const uint8** planes)
+{
+	uint32 byte;
+
+	for (byte = 0; byte < bps; byte++) {
+		#if WORDS_BIGENDIAN
+		planes[byte] = tmp + byte * wc;
+		#else
+		planes[byte] = tmp + (bps - byte - 1) * wc;
+		#endif
 	}
-	return 1;
 }
 
-static int
-swabHorAcc32(TIFF* tif, uint8* cp0, tmsize_t cc)
+/*
+ * Gather the wc samples of bps bytes each from the byte planes in
+ * tmp into cp.
+ */
+static void
+fpMerge(uint8* cp, const uint8* tmp, tmsize_t wc, uint32 bps)
 {
-	uint32* wp = (uint32*) cp0;
-	tmsize_t wc = cc / 4;
+	const uint8* planes[8];
+	tmsize_t count = 0;
 
-        TIFFSwabArrayOfLong(wp, wc);
-	return horAcc32(tif, cp0, cc);
+	if (bps <= 8) {
+		fpPlanes(tmp, wc, bps, planes);
+		count = fpMergeBytesSIMD(cp, planes, wc, bps);
+	}
+	for (; count < wc; count++) {
+		uint32 byte;
+		for (byte = 0; byte < bps; byte++) {
+			#if WORDS_BIGENDIAN
+			cp[bps * count + byte] = tmp[byte * wc + count];
+			#else
+			cp[bps * count + byte] =
+				tmp[(bps - byte - 1) * wc + count];
+			#endif
+		}
+	}
 }
 
-TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW
-static int
-horAcc32(TIFF* tif, uint8* cp0, tmsize_t cc)
+/*
+ * Scatter the wc samples of bps bytes each in tmp to byte planes in
+ * cp, most significant first.
+ */
+static void
+fpSplit(uint8* cp, const uint8* tmp, tmsize_t wc, uint32 bps)
 {
-	tmsize_t stride = PredictorState(tif)->stride;
-	uint32* wp = (uint32*) cp0;
-	tmsize_t wc = cc / 4;
+	const uint8* planes[8];
+	tmsize_t count = 0;
 
-    if((cc%(4*stride))!=0)
-    {
-        TIFFErrorExt(tif->tif_clientdata, "horAcc32",
-                     "%s", "cc%(4*stride))!=0");
-        return 0;
-    }
-
-	if (wc > stride) {
-		wc -= stride;
-		do {
-			REPEAT4(stride, wp[stride] += wp[0]; wp++)
-			wc -= stride;
-		} while (wc > 0);
+	if (bps <= 8) {
+		fpPlanes(cp, wc, bps, planes);
+		count = fpSplitBytesSIMD((uint8* const*) planes, tmp, wc, bps);
+	}
+	for (; count < wc; count++) {
+		uint32 byte;
+		for (byte = 0; byte < bps; byte++) {
+			#if WORDS_BIGENDIAN
+			cp[byte * wc + count] = tmp[bps * count + byte];
+			#else
+			cp[(bps - byte - 1) * wc + count] =
+				tmp[bps * count + byte];
+			#endif
+		}
 	}
-	return 1;
 }
 
 /*
@@ -418,38 +1318,76 @@ fpAcc(TIFF* tif, uint8* cp0, tmsize_t cc)
 
     if(cc%(bps*stride)!=0)
     {
-        TIFFErrorExt(tif->tif_clientdata, "fpAcc",
+        TIFFErrorExtR(tif, "fpAcc",
                      "%s", "cc%(bps*stride))!=0");
         return 0;
     }
 
-    tmp = (uint8 *)_TIFFmalloc(cc);
+    tmp = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_PREDICTOR, cc);
 	if (!tmp)
 		return 0;
 
-	while (count > stride) {
-		REPEAT4(stride, cp[stride] =
-                        (unsigned char) ((cp[stride] + cp[0]) & 0xff); cp++)
-		count -= stride;
+	if (!(cc > stride && horAcc8SIMD(cp, cc, stride))) {
+		while (count > stride) {
+			REPEAT4(stride, cp[stride] =
+				(unsigned char) ((cp[stride] + cp[0]) & 0xff); cp++)
+			count -= stride;
+		}
 	}
 
 	_TIFFmemcpy(tmp, cp0, cc);
-	cp = (uint8 *) cp0;
-	for (count = 0; count < wc; count++) {
-		uint32 byte;
-		for (byte = 0; byte < bps; byte++) {
-			#if WORDS_BIGENDIAN
-			cp[bps * count + byte] = tmp[byte * wc + count];
-			#else
-			cp[bps * count + byte] =
-				tmp[(bps - byte - 1) * wc + count];
-			#endif
-		}
-	}
-	_TIFFfree(tmp);
+	fpMerge(cp0, tmp, wc, bps);
     return 1;
 }
 
+/*
+ * Byte shuffle predictor decoding routine: the bytes of each sample
+ * are stored in separate planes as with the floating point predictor,
+ * but without differencing.
+ */
+static int
+byteUnshuffle(TIFF* tif, uint8* cp0, tmsize_t cc)
+{
+	uint32 bps = tif->tif_dir.td_bitspersample / 8;
+	uint8 *tmp;
+
+    if((cc%bps)!=0)
+    {
+        TIFFErrorExtR(tif, "byteUnshuffle",
+                     "%s", "(cc%bps)!=0");
+        return 0;
+    }
+
+    tmp = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_PREDICTOR, cc);
+	if (!tmp)
+		return 0;
+
+	_TIFFmemcpy(tmp, cp0, cc);
+	fpMerge(cp0, tmp, cc / bps, bps);
+    return 1;
+}
+
+/*
+ * Apply the predictor routine to the rows of rowsize bytes in op0,
+ * timing it for handles that keep statistics.
+ */
+static int
+PredictorUndo(TIFF* tif, uint8* op0, tmsize_t occ0, tmsize_t rowsize)
+{
+	TIFFPredictorState *sp = PredictorState(tif);
+	uint64 start = tif->tif_stats ? _TIFFStatsClock() : 0;
+
+	while (occ0 > 0) {
+		if( !(*sp->decodepfunc)(tif, op0, rowsize) )
+			return 0;
+		occ0 -= rowsize;
+		op0 += rowsize;
+	}
+	if (tif->tif_stats)
+		tif->tif_stats->predictortime += _TIFFStatsClock() - start;
+	return 1;
+}
+
 /*
  * Decode a scanline and apply the predictor routine.
  */
@@ -463,7 +1401,9 @@ PredictorDecodeRow(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 	assert(sp->decodepfunc != NULL);  
 
 	if ((*sp->decoderow)(tif, op0, occ0, s)) {
-		return (*sp->decodepfunc)(tif, op0, occ0);
+		if (occ0 <= 0)
+			return (*sp->decodepfunc)(tif, op0, occ0);
+		return PredictorUndo(tif, op0, occ0, occ0);
 	} else
 		return 0;
 }
@@ -483,23 +1423,43 @@ PredictorDecodeTile(TIFF* tif, uint8* op0, tmsize_t occ0, uint16 s)
 	assert(sp != NULL);
 	assert(sp->decodetile != NULL);
 
+	/*
+	 * A codec that keeps its state between calls can be driven a batch
+	 * of rows at a time, so that each batch is still in cache when the
+	 * predictor runs over it.
+	 */
+	if (sp->batchdecode && sp->rowsize > 0 && occ0 % sp->rowsize == 0 &&
+	    occ0 > TIFF_BATCH_SIZE) {
+		tmsize_t rowsize = sp->rowsize;
+		tmsize_t batch = (TIFF_BATCH_SIZE / rowsize) * rowsize;
+
+		assert(sp->decodepfunc != NULL);
+		if (batch == 0)
+			batch = rowsize;
+		while (occ0 > 0) {
+			tmsize_t cc = occ0 < batch ? occ0 : batch;
+
+			if (!(*sp->decodetile)(tif, op0, cc, s) ||
+			    !PredictorUndo(tif, op0, cc, rowsize) ||
+			    _TIFFCheckCancel(tif, "PredictorDecodeTile"))
+				return 0;
+			occ0 -= cc;
+			op0 += cc;
+		}
+		return 1;
+	}
+
 	if ((*sp->decodetile)(tif, op0, occ0, s)) {
 		tmsize_t rowsize = sp->rowsize;
 		assert(rowsize > 0);
 		if((occ0%rowsize) !=0)
         {
-            TIFFErrorExt(tif->tif_clientdata, "PredictorDecodeTile",
+            TIFFErrorExtR(tif, "PredictorDecodeTile",
                          "%s", "occ0%rowsize != 0");
             return 0;
         }
 		assert(sp->decodepfunc != NULL);
-		while (occ0 > 0) {
-			if( !(*sp->decodepfunc)(tif, op0, rowsize) )
-                return 0;
-			occ0 -= rowsize;
-			op0 += rowsize;
-		}
-		return 1;
+		return PredictorUndo(tif, op0, occ0, rowsize);
 	} else
 		return 0;
 }
@@ -514,11 +1474,13 @@ horDiff8(TIFF* tif, uint8* cp0, tmsize_t cc)
 
     if((cc%stride)!=0)
     {
-        TIFFErrorExt(tif->tif_clientdata, "horDiff8",
+        TIFFErrorExtR(tif, "horDiff8",
                      "%s", "(cc%stride)!=0");
         return 0;
     }
 
+	if (cc > stride && horDiff8SIMD(cp, cc, stride))
+		return 1;
 	if (cc > stride) {
 		cc -= stride;
 		/*
@@ -558,86 +1520,6 @@ horDiff8(TIFF* tif, uint8* cp0, tmsize_t cc)
 	return 1;
 }
 
-TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW
-static int
-horDiff16(TIFF* tif, uint8* cp0, tmsize_t cc)
-{
-	TIFFPredictorState* sp = PredictorState(tif);
-	tmsize_t stride = sp->stride;
-	uint16 *wp = (uint16*) cp0;
-	tmsize_t wc = cc/2;
-
-    if((cc%(2*stride))!=0)
-    {
-        TIFFErrorExt(tif->tif_clientdata, "horDiff8",
-                     "%s", "(cc%(2*stride))!=0");
-        return 0;
-    }
-
-	if (wc > stride) {
-		wc -= stride;
-		wp += wc - 1;
-		do {
-			REPEAT4(stride, wp[stride] = (uint16)(((unsigned int)wp[stride] - (unsigned int)wp[0]) & 0xffff); wp--)
-			wc -= stride;
-		} while (wc > 0);
-	}
-	return 1;
-}
-
-static int
-swabHorDiff16(TIFF* tif, uint8* cp0, tmsize_t cc)
-{
-    uint16* wp = (uint16*) cp0;
-    tmsize_t wc = cc / 2;
-
-    if( !horDiff16(tif, cp0, cc) )
-        return 0;
-
-    TIFFSwabArrayOfShort(wp, wc);
-    return 1;
-}
-
-TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW
-static int
-horDiff32(TIFF* tif, uint8* cp0, tmsize_t cc)
-{
-	TIFFPredictorState* sp = PredictorState(tif);
-	tmsize_t stride = sp->stride;
-	uint32 *wp = (uint32*) cp0;
-	tmsize_t wc = cc/4;
-
-    if((cc%(4*stride))!=0)
-    {
-        TIFFErrorExt(tif->tif_clientdata, "horDiff32",
-                     "%s", "(cc%(4*stride))!=0");
-        return 0;
-    }
-
-	if (wc > stride) {
-		wc -= stride;
-		wp += wc - 1;
-		do {
-			REPEAT4(stride, wp[stride] -= wp[0]; wp--)
-			wc -= stride;
-		} while (wc > 0);
-	}
-	return 1;
-}
-
-static int
-swabHorDiff32(TIFF* tif, uint8* cp0, tmsize_t cc)
-{
-    uint32* wp = (uint32*) cp0;
-    tmsize_t wc = cc / 4;
-
-    if( !horDiff32(tif, cp0, cc) )
-        return 0;
-
-    TIFFSwabArrayOfLong(wp, wc);
-    return 1;
-}
-
 /*
  * Floating point predictor differencing routine.
  */
@@ -654,29 +1536,20 @@ fpDiff(TIFF* tif, uint8* cp0, tmsize_t cc)
 
     if((cc%(bps*stride))!=0)
     {
-        TIFFErrorExt(tif->tif_clientdata, "fpDiff",
+        TIFFErrorExtR(tif, "fpDiff",
                      "%s", "(cc%(bps*stride))!=0");
         return 0;
     }
 
-    tmp = (uint8 *)_TIFFmalloc(cc);
+    tmp = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_PREDICTOR, cc);
 	if (!tmp)
 		return 0;
 
 	_TIFFmemcpy(tmp, cp0, cc);
-	for (count = 0; count < wc; count++) {
-		uint32 byte;
-		for (byte = 0; byte < bps; byte++) {
-			#if WORDS_BIGENDIAN
-			cp[byte * wc + count] = tmp[bps * count + byte];
-			#else
-			cp[(bps - byte - 1) * wc + count] =
-				tmp[bps * count + byte];
-			#endif
-		}
-	}
-	_TIFFfree(tmp);
+	fpSplit(cp, tmp, wc, bps);
 
+	if (cc > stride && horDiff8SIMD(cp0, cc, stride))
+		return 1;
 	cp = (uint8 *) cp0;
 	cp += cc - stride - 1;
 	for (count = cc; count > stride; count -= stride)
@@ -684,6 +1557,31 @@ fpDiff(TIFF* tif, uint8* cp0, tmsize_t cc)
     return 1;
 }
 
+/*
+ * Byte shuffle predictor encoding routine.
+ */
+static int
+byteShuffle(TIFF* tif, uint8* cp0, tmsize_t cc)
+{
+	uint32 bps = tif->tif_dir.td_bitspersample / 8;
+	uint8 *tmp;
+
+    if((cc%bps)!=0)
+    {
+        TIFFErrorExtR(tif, "byteShuffle",
+                     "%s", "(cc%bps)!=0");
+        return 0;
+    }
+
+    tmp = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_PREDICTOR, cc);
+	if (!tmp)
+		return 0;
+
+	_TIFFmemcpy(tmp, cp0, cc);
+	fpSplit(cp0, tmp, cc / bps, bps);
+    return 1;
+}
+
 static int
 PredictorEncodeRow(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 {
@@ -702,12 +1600,10 @@ PredictorEncodeRow(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 static int
 PredictorEncodeTile(TIFF* tif, uint8* bp0, tmsize_t cc0, uint16 s)
 {
-	static const char module[] = "PredictorEncodeTile";
 	TIFFPredictorState *sp = PredictorState(tif);
         uint8 *working_copy;
 	tmsize_t cc = cc0, rowsize;
 	unsigned char* bp;
-        int result_code;
 
 	assert(sp != NULL);
 	assert(sp->encodepfunc != NULL);
@@ -716,15 +1612,11 @@ PredictorEncodeTile(TIFF* tif, uint8* bp0, tmsize_t cc0, uint16 s)
         /* 
          * Do predictor manipulation in a working buffer to avoid altering
          * the callers buffer. http://trac.osgeo.org/gdal/ticket/1965
+         * The buffer is kept by the handle for the next tiles.
          */
-        working_copy = (uint8*) _TIFFmalloc(cc0);
+        working_copy = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_ENCODE, cc0);
         if( working_copy == NULL )
-        {
-            TIFFErrorExt(tif->tif_clientdata, module, 
-                         "Out of memory allocating " TIFF_SSIZE_FORMAT " byte temp buffer.",
-                         cc0 );
             return 0;
-        }
         memcpy( working_copy, bp0, cc0 );
         bp = working_copy;
 
@@ -732,9 +1624,8 @@ PredictorEncodeTile(TIFF* tif, uint8* bp0, tmsize_t cc0, uint16 s)
 	assert(rowsize > 0);
 	if((cc0%rowsize)!=0)
     {
-        TIFFErrorExt(tif->tif_clientdata, "PredictorEncodeTile",
+        TIFFErrorExtR(tif, "PredictorEncodeTile",
                      "%s", "(cc0%rowsize)!=0");
-        _TIFFfree( working_copy );
         return 0;
     }
 	while (cc > 0) {
@@ -742,11 +1633,7 @@ PredictorEncodeTile(TIFF* tif, uint8* bp0, tmsize_t cc0, uint16 s)
 		cc -= rowsize;
 		bp += rowsize;
 	}
-	result_code = (*sp->encodetile)(tif, working_copy, cc0, s);
-
-        _TIFFfree( working_copy );
-
-        return result_code;
+	return (*sp->encodetile)(tif, working_copy, cc0, s);
 }
 
 #define	FIELD_PREDICTOR	(FIELD_CODEC+0)		/* XXX */
@@ -805,6 +1692,7 @@ PredictorPrintDir(TIFF* tif, FILE* fd, long flags)
 			case 1: fprintf(fd, "none "); break;
 			case 2: fprintf(fd, "horizontal differencing "); break;
 			case 3: fprintf(fd, "floating point predictor "); break;
+			case PREDICTOR_SHUFFLE: fprintf(fd, "byte shuffle "); break;
 		}
 		fprintf(fd, "%d (0x%x)\n", sp->predictor, sp->predictor);
 	}
@@ -824,7 +1712,7 @@ TIFFPredictorInit(TIFF* tif)
 	 */
 	if (!_TIFFMergeFields(tif, predictFields,
 			      TIFFArrayCount(predictFields))) {
-		TIFFErrorExt(tif->tif_clientdata, "TIFFPredictorInit",
+		TIFFErrorExtR(tif, "TIFFPredictorInit",
 		    "Merging Predictor codec-specific tags failed");
 		return 0;
 	}
@@ -850,6 +1738,7 @@ TIFFPredictorInit(TIFF* tif)
 	sp->predictor = 1;			/* default value */
 	sp->encodepfunc = NULL;			/* no predictor routine */
 	sp->decodepfunc = NULL;			/* no predictor routine */
+	sp->batchdecode = 0;			/* decode whole chunks */
 	return 1;
 }
 
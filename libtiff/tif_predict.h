@@ -55,6 +55,8 @@ typedef struct {
 	TIFFPrintMethod printdir;	/* super-class method */
 	TIFFBoolMethod  setupdecode;	/* super-class method */
 	TIFFBoolMethod  setupencode;	/* super-class method */
+
+	int             batchdecode;	/* parent can decode a chunk in pieces */
 } TIFFPredictorState;
 
 #if defined(__cplusplus)
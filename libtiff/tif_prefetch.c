@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Read-ahead of strips and tiles.
+ *
+ * When enabled with TIFFSetPrefetch(), every strip or tile loaded by
+ * TIFFFillStrip()/TIFFFillTile() is followed by a request for the raw
+ * data of the next few chunks, so that I/O overlaps with decoding.
+ * If the I/O layer provides a read-ahead hint method (posix_fadvise()
+ * for descriptors opened by tif_unix.c), the operating system is told
+ * which ranges will be needed.  Otherwise the data is read into
+ * private buffers by a helper thread; the next raw read waits for the
+ * helper first (see TIFFSeekFile()), so the file position is never
+ * used concurrently.
+ */
+#include "tiffiop.h"
+
+#define	TIFF_MAX_PREFETCH	16
+
+typedef struct {
+	uint32		strile;
+	uint64		offset;
+	tmsize_t	size;		/* bytes wanted/held */
+	uint8*		buf;
+	tmsize_t	bufsize;
+	int		state;		/* one of the PREFETCH_ values */
+} TIFFPrefetchSlot;
+
+#define	PREFETCH_EMPTY		0
+#define	PREFETCH_PENDING	1	/* to be read by the helper */
+#define	PREFETCH_VALID		2	/* data available */
+
+struct _TIFFPrefetch {
+	TIFF*			tif;
+	uint32			depth;		/* # chunks to read ahead */
+	TIFFPrefetchSlot	slots[TIFF_MAX_PREFETCH];
+	TIFFThread*		thread;		/* running helper, if any */
+};
+
+/*
+ * Helper thread body: read the pending slots.  This bypasses
+ * TIFFSeekFile(), which would otherwise wait for ourselves, and
+ * TIFFReadFile(), whose block cache belongs to the calling thread.
+ */
+static void
+_TIFFPrefetchThread(void* arg)
+{
+	TIFFPrefetch* pf = (TIFFPrefetch*) arg;
+	TIFF* tif = pf->tif;
+	uint32 i;
+	int failed = 0;
+
+	for (i = 0; i < pf->depth; i++) {
+		TIFFPrefetchSlot* slot = &pf->slots[i];
+
+		if (slot->state != PREFETCH_PENDING)
+			continue;
+		slot->state = PREFETCH_EMPTY;
+		if (failed)
+			continue;
+		if (_TIFFCallSeekProc(tif, slot->offset, SEEK_SET) !=
+		    slot->offset ||
+		    _TIFFCallReadProc(tif, slot->buf, slot->size) !=
+		    slot->size) {
+			failed = 1;	/* the regular read will report it */
+			continue;
+		}
+		slot->state = PREFETCH_VALID;
+	}
+}
+
+void
+_TIFFPrefetchWait(TIFF* tif)
+{
+	TIFFPrefetch* pf = tif->tif_prefetch;
+
+	if (pf != NULL && pf->thread != NULL) {
+		_TIFFThreadJoin(pf->thread);
+		pf->thread = NULL;
+	}
+}
+
+/*
+ * Satisfy a raw read of size bytes of the given strip or tile into
+ * tif_rawdata from the read-ahead buffers.  Returns 1 if the data was
+ * available, 0 if it must be read from the file.
+ */
+int
+_TIFFPrefetchTake(TIFF* tif, uint32 strile, tmsize_t size)
+{
+	TIFFPrefetch* pf = tif->tif_prefetch;
+	TIFFPrefetchSlot* slot = NULL;
+	uint32 i;
+
+	if (pf == NULL)
+		return (0);
+	_TIFFPrefetchWait(tif);
+	for (i = 0; i < pf->depth; i++) {
+		if (pf->slots[i].state == PREFETCH_VALID &&
+		    pf->slots[i].strile == strile) {
+			slot = &pf->slots[i];
+			break;
+		}
+	}
+	if (slot == NULL)
+		return (0);
+	slot->state = PREFETCH_EMPTY;
+	if (slot->offset != TIFFGetStrileOffset(tif, strile) ||
+	    slot->size != size)
+		return (0);
+	if (tif->tif_flags & TIFF_MYBUFFER) {
+		/* Swap buffers rather than copying */
+		uint8* buf = tif->tif_rawdata;
+		tmsize_t bufsize = tif->tif_rawdatasize;
+
+		tif->tif_rawdata = slot->buf;
+		tif->tif_rawdatasize = slot->bufsize;
+		slot->buf = buf;
+		slot->bufsize = buf ? bufsize : 0;
+	} else {
+		if (size > tif->tif_rawdatasize)
+			return (0);
+		_TIFFmemcpy(tif->tif_rawdata, slot->buf, size);
+	}
+	return (1);
+}
+
+/*
+ * Called after the raw data of a strip or tile has been loaded:
+ * start reading ahead the chunks that follow it.
+ */
+void
+_TIFFPrefetchSchedule(TIFF* tif, uint32 strile)
+{
+	TIFFPrefetch* pf = tif->tif_prefetch;
+	TIFFDirectory* td = &tif->tif_dir;
+	tmsize_t chunksize;
+	uint32 i, j, next;
+	int pending = 0;
+
+	if (pf == NULL || isMapped(tif) || !_TIFFHaveStriles(tif))
+		return;
+	_TIFFPrefetchWait(tif);
+	chunksize = isTiled(tif) ? TIFFTileSize(tif) : TIFFStripSize(tif);
+
+	/* Forget about chunks outside of the new window */
+	for (i = 0; i < pf->depth; i++) {
+		TIFFPrefetchSlot* slot = &pf->slots[i];
+
+		if (slot->state == PREFETCH_VALID &&
+		    (slot->strile <= strile || slot->strile - strile > pf->depth))
+			slot->state = PREFETCH_EMPTY;
+	}
+
+	for (next = strile + 1;
+	     next < td->td_nstrips && next - strile <= pf->depth; next++) {
+		uint64 bytecount = TIFFGetStrileByteCount(tif, next);
+		TIFFPrefetchSlot* slot = NULL;
+
+		/* Skip chunks that TIFFFillStrip() would clamp or reject */
+		if ((int64)bytecount <= 0 ||
+		    (bytecount > 1024 * 1024 && chunksize != 0 &&
+		     (bytecount - 4096) / 10 > (uint64)chunksize) ||
+		    (uint64)(tmsize_t)bytecount != bytecount)
+			continue;
+
+		if (tif->tif_readaheadproc != NULL) {
+			(*tif->tif_readaheadproc)(tif->tif_clientdata,
+			    TIFFGetStrileOffset(tif, next), bytecount);
+			continue;
+		}
+		if (!_TIFFHaveThreads())
+			return;
+
+		for (j = 0; j < pf->depth; j++) {
+			if (pf->slots[j].state == PREFETCH_VALID &&
+			    pf->slots[j].strile == next)
+				break;
+		}
+		if (j < pf->depth)
+			continue;	/* already there */
+		for (j = 0; j < pf->depth; j++) {
+			if (pf->slots[j].state == PREFETCH_EMPTY) {
+				slot = &pf->slots[j];
+				break;
+			}
+		}
+		if (slot == NULL)
+			break;
+		if ((tmsize_t)bytecount > slot->bufsize) {
+			uint8* buf = (uint8*) _TIFFreallocExt(tif, slot->buf,
+			    (tmsize_t)TIFFroundup_64(bytecount, 1024));
+			if (buf == NULL)
+				break;
+			slot->buf = buf;
+			slot->bufsize = (tmsize_t)TIFFroundup_64(bytecount, 1024);
+		}
+		slot->strile = next;
+		slot->offset = TIFFGetStrileOffset(tif, next);
+		slot->size = (tmsize_t)bytecount;
+		slot->state = PREFETCH_PENDING;
+		pending = 1;
+	}
+
+	if (pending) {
+		pf->thread = _TIFFThreadCreate(_TIFFPrefetchThread, pf);
+		if (pf->thread == NULL) {
+			for (i = 0; i < pf->depth; i++) {
+				if (pf->slots[i].state == PREFETCH_PENDING)
+					pf->slots[i].state = PREFETCH_EMPTY;
+			}
+		}
+	}
+}
+
+void
+_TIFFFreePrefetch(TIFF* tif)
+{
+	TIFFPrefetch* pf = tif->tif_prefetch;
+	uint32 i;
+
+	if (pf == NULL)
+		return;
+	_TIFFPrefetchWait(tif);
+	for (i = 0; i < TIFF_MAX_PREFETCH; i++) {
+		if (pf->slots[i].buf)
+			_TIFFfreeExt(tif, pf->slots[i].buf);
+	}
+	_TIFFfreeExt(tif, pf);
+	tif->tif_prefetch = NULL;
+}
+
+/*
+ * Enable reading ahead of the next nchunks strips or tiles while the
+ * current one is being decoded, or disable it if nchunks is 0.
+ * Read-ahead only applies to files that are not memory-mapped.
+ */
+int
+TIFFSetPrefetch(TIFF* tif, uint32 nchunks)
+{
+	static const char module[] = "TIFFSetPrefetch";
+	TIFFPrefetch* pf;
+
+	if (tif->tif_mode != O_RDONLY) {
+		TIFFErrorExtR(tif, module,
+		    "Read-ahead is only supported for files opened read-only");
+		return (0);
+	}
+	_TIFFFreePrefetch(tif);
+	if (nchunks == 0)
+		return (1);
+	if (nchunks > TIFF_MAX_PREFETCH)
+		nchunks = TIFF_MAX_PREFETCH;
+	pf = (TIFFPrefetch*) _TIFFmallocExt(tif, sizeof(TIFFPrefetch));
+	if (pf == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for read-ahead state");
+		return (0);
+	}
+	_TIFFmemset(pf, 0, sizeof(TIFFPrefetch));
+	pf->tif = tif;
+	pf->depth = nchunks;
+	tif->tif_prefetch = pf;
+	return (1);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -237,6 +237,8 @@ TIFFPrintDirectory(TIFF* tif, FILE* fd, long flags)
 	char *sep;
 	long l, n;
 
+	if (td->td_ndeferredtags)
+		_TIFFFetchDeferredTags(tif);
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
 	fprintf(fd, "TIFF Directory at offset 0x%I64x (%I64u)\n",
 		(unsigned __int64) tif->tif_diroff,
@@ -624,12 +626,12 @@ TIFFPrintDirectory(TIFF* tif, FILE* fd, long flags)
 					if(TIFFGetField(tif, tag, &raw_data) != 1)
 						continue;
 				} else {
-					raw_data = _TIFFmalloc(
+					raw_data = _TIFFmallocExt(tif,
 					    _TIFFDataSize(fip->field_type)
 					    * value_count);
 					mem_alloc = 1;
 					if(TIFFGetField(tif, tag, raw_data) != 1) {
-						_TIFFfree(raw_data);
+						_TIFFfreeExt(tif, raw_data);
 						continue;
 					}
 				}
@@ -645,7 +647,7 @@ TIFFPrintDirectory(TIFF* tif, FILE* fd, long flags)
 				_TIFFPrintField(fd, fip, value_count, raw_data);
 
 			if(mem_alloc)
-				_TIFFfree(raw_data);
+				_TIFFfreeExt(tif, raw_data);
 		}
 	}
         
@@ -661,18 +663,27 @@ TIFFPrintDirectory(TIFF* tif, FILE* fd, long flags)
 		fprintf(fd, "  %lu %s:\n",
 		    (unsigned long) td->td_nstrips,
 		    isTiled(tif) ? "Tiles" : "Strips");
-		for (s = 0; s < td->td_nstrips; s++)
+		for (s = 0; s < td->td_nstrips; s++) {
+			uint64 off = 0, bc = 0;
+			if (td->td_strilewindow != NULL) {
+				off = TIFFGetStrileOffset(tif, s);
+				bc = TIFFGetStrileByteCount(tif, s);
+			} else {
+				if (td->td_stripoffset)
+					off = td->td_stripoffset[s];
+				if (td->td_stripbytecount)
+					bc = td->td_stripbytecount[s];
+			}
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
 			fprintf(fd, "    %3lu: [%8I64u, %8I64u]\n",
 			    (unsigned long) s,
-			    td->td_stripoffset ? (unsigned __int64) td->td_stripoffset[s] : 0,
-			    td->td_stripbytecount ? (unsigned __int64) td->td_stripbytecount[s] : 0);
+			    (unsigned __int64) off, (unsigned __int64) bc);
 #else
 			fprintf(fd, "    %3lu: [%8llu, %8llu]\n",
 			    (unsigned long) s,
-			    td->td_stripoffset ? (unsigned long long) td->td_stripoffset[s] : 0,
-			    td->td_stripbytecount ? (unsigned long long) td->td_stripbytecount[s] : 0);
+			    (unsigned long long) off, (unsigned long long) bc);
 #endif
+		}
 	}
 }
 
@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Switching a ClassicTIFF file being written to BigTIFF.
+ *
+ * A file created with the "A" mode flag starts as ClassicTIFF, with
+ * room for a BigTIFF header.  When a strip or tile, a reserved strip or
+ * tile array or a directory would end past the 4 GiB that 32-bit
+ * offsets can reach, _TIFFPromoteIfNeeded() switches the handle to
+ * BigTIFF: everything written from then on has 64-bit offsets.  The
+ * directories already in the file are converted when the next one is
+ * written, by _TIFFPromoteDirectories(): each is copied to the end of
+ * the file in the BigTIFF layout, with the values of 5 to 8 bytes moved
+ * into their entry and the directories they point at (SubIFDs, EXIF,
+ * GPS) converted as well, and the header is rewritten in place.  The
+ * tag data and the image data stay where they are.
+ */
+#include "tiffiop.h"
+
+#define	PROMOTE_MAX_DEPTH	4	/* SubIFDs of SubIFDs... */
+#define	PROMOTE_MAX_CHAIN	65535	/* directories in a chain */
+
+/*
+ * Switch to BigTIFF if end is past what ClassicTIFF can address and
+ * the handle was opened to do so.  Returns 0 after reporting an error
+ * if the switch is not possible; otherwise the caller goes on, and
+ * checks the limits of the format in effect as before.
+ */
+int
+_TIFFPromoteIfNeeded(TIFF* tif, uint64 end, const char* module)
+{
+	if (tif->tif_promote != TIFF_PROMOTE_AUTO || end <= 0xFFFFFFFFU)
+		return (1);
+	if (tif->tif_dirreservesize != 0) {
+		TIFFErrorExtR(tif, module,
+		    "Cannot switch to BigTIFF with directories reserved");
+		return (0);
+	}
+	if (tif->tif_dir.td_strilewindow != NULL) {
+		TIFFErrorExtR(tif, module, "Cannot switch to BigTIFF while "
+		    "strip/tile arrays are streamed to the file");
+		return (0);
+	}
+	if ((tif->tif_flags & TIFF_INSUBIFD) || tif->tif_nsubifd != 0) {
+		TIFFErrorExtR(tif, module,
+		    "Cannot switch to BigTIFF while writing SubIFDs");
+		return (0);
+	}
+	tif->tif_flags |= TIFF_BIGTIFF;
+	tif->tif_promote = TIFF_PROMOTE_PENDING;
+	return (1);
+}
+
+/*
+ * An upper bound of the size of the current directory and its tag
+ * data, with 64-bit offsets.
+ */
+static uint64
+_TIFFDirectorySizeBound(TIFF* tif)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	uint64 size;
+	int i;
+
+	/* header, entries of the fields kept in td and small arrays */
+	size = 16 + 16 + 20 * (uint64) (FIELD_LAST + td->td_customValueCount)
+	    + 64 * 1024;
+	if (td->td_strilewindow == NULL)
+		size += 2 * 8 * (uint64) td->td_nstrips;
+	if (td->td_bitspersample <= 16) {
+		uint64 n = (uint64) 1 << td->td_bitspersample;
+		if (TIFFFieldSet(tif, FIELD_COLORMAP))
+			size += 3 * 2 * n;
+		if (TIFFFieldSet(tif, FIELD_TRANSFERFUNCTION))
+			size += 3 * 2 * n;
+	}
+	size += 8 * 8 * (uint64) td->td_samplesperpixel;
+	size += (uint64) td->td_inknameslen + 8 * (uint64) td->td_nsubifd;
+	for (i = 0; i < td->td_customValueCount; i++) {
+		TIFFTagValue* tv = td->td_customValues + i;
+		size += (uint64) tv->count *
+		    (uint64) TIFFDataWidth(tv->info->field_type) + 2;
+	}
+	return (size);
+}
+
+static int
+_TIFFPromoteRead(TIFF* tif, uint64 off, void* buf, tmsize_t size,
+    const char* module)
+{
+	if (!SeekOK(tif, off) || !ReadOK(tif, buf, size)) {
+		TIFFErrorExtR(tif, module,
+		    "Read error converting directories to BigTIFF");
+		return (0);
+	}
+	return (1);
+}
+
+/* Write size bytes at the end of the file, on a word boundary */
+static uint64
+_TIFFPromoteAppend(TIFF* tif, void* buf, tmsize_t size,
+    const char* module)
+{
+	uint64 off = (TIFFSeekFile(tif, 0, SEEK_END) + 1) & ~((uint64) 1);
+
+	if (!SeekOK(tif, off) || !WriteOK(tif, buf, size)) {
+		TIFFErrorExtR(tif, module,
+		    "Write error converting directories to BigTIFF");
+		return (0);
+	}
+	return (off);
+}
+
+static int _TIFFPromoteChain(TIFF* tif, uint64 first, uint64 skip, int depth,
+    uint64* pfirst, uint64* plast, int* pskipped, const char* module);
+
+/*
+ * Convert the 4-byte directory offsets of an entry to 8-byte ones,
+ * converting the directories they point at.  value is the entry value
+ * in the file: the offset itself for one directory, otherwise the
+ * offset of the array.
+ */
+static int
+_TIFFPromoteIfdEntry(TIFF* tif, uint32 count, const uint8* value,
+    int depth, uint8* out, const char* module)
+{
+	uint32* offs;
+	uint64* newoffs;
+	uint32 i, off;
+	uint64 last;
+	int skipped, ok = 0;
+
+	offs = (uint32*) _TIFFCheckMalloc(tif, count, 4, module);
+	newoffs = (uint64*) _TIFFCheckMalloc(tif, count, 8, module);
+	if (offs == NULL || newoffs == NULL)
+		goto done;
+	if (count == 1)
+		_TIFFmemcpy(offs, value, 4);
+	else {
+		_TIFFmemcpy(&off, value, 4);
+		if (tif->tif_flags & TIFF_SWAB)
+			TIFFSwabLong(&off);
+		if (!_TIFFPromoteRead(tif, off, offs, (tmsize_t) count * 4,
+		    module))
+			goto done;
+	}
+	if (tif->tif_flags & TIFF_SWAB)
+		TIFFSwabArrayOfLong(offs, count);
+	for (i = 0; i < count; i++) {
+		newoffs[i] = 0;
+		if (offs[i] != 0 && !_TIFFPromoteChain(tif, offs[i], 0,
+		    depth + 1, &newoffs[i], &last, &skipped, module))
+			goto done;
+	}
+	if (tif->tif_flags & TIFF_SWAB)
+		TIFFSwabArrayOfLong8(newoffs, count);
+	if (count == 1)
+		_TIFFmemcpy(out, newoffs, 8);
+	else {
+		uint64 arrayoff = _TIFFPromoteAppend(tif, newoffs,
+		    (tmsize_t) count * 8, module);
+		if (arrayoff == 0)
+			goto done;
+		if (tif->tif_flags & TIFF_SWAB)
+			TIFFSwabLong8(&arrayoff);
+		_TIFFmemcpy(out, &arrayoff, 8);
+	}
+	ok = 1;
+done:
+	_TIFFfreeExt(tif, offs);
+	_TIFFfreeExt(tif, newoffs);
+	return (ok);
+}
+
+/*
+ * Copy the classic directory at off to the end of the file in the
+ * BigTIFF layout, linked to next, and return its offset in *pnew.
+ */
+static int
+_TIFFPromoteDirectory(TIFF* tif, uint64 off, uint64 next, int depth,
+    uint64* pnew, const char* module)
+{
+	uint16 n, i;
+	uint64 n64;
+	uint8* in = NULL;
+	uint8* out = NULL;
+	int ok = 0;
+
+	if (!_TIFFPromoteRead(tif, off, &n, 2, module))
+		return (0);
+	if (tif->tif_flags & TIFF_SWAB)
+		TIFFSwabShort(&n);
+	in = (uint8*) _TIFFCheckMalloc(tif, n, 12, module);
+	out = (uint8*) _TIFFCheckMalloc(tif, 8 + 20 * (tmsize_t) n + 8, 1,
+	    module);
+	if ((n > 0 && in == NULL) || out == NULL)
+		goto done;
+	if (n > 0 && !_TIFFPromoteRead(tif, off + 2, in, 12 * (tmsize_t) n,
+	    module))
+		goto done;
+	_TIFFmemset(out, 0, 8 + 20 * (tmsize_t) n + 8);
+	n64 = n;
+	if (tif->tif_flags & TIFF_SWAB)
+		TIFFSwabLong8(&n64);
+	_TIFFmemcpy(out, &n64, 8);
+	for (i = 0; i < n; i++) {
+		const uint8* e = in + 12 * (size_t) i;
+		uint8* o = out + 8 + 20 * (size_t) i;
+		uint16 tag, type;
+		uint32 count;
+		uint64 count64, size;
+
+		_TIFFmemcpy(&tag, e, 2);
+		_TIFFmemcpy(&type, e + 2, 2);
+		_TIFFmemcpy(&count, e + 4, 4);
+		if (tif->tif_flags & TIFF_SWAB) {
+			TIFFSwabShort(&tag);
+			TIFFSwabShort(&type);
+			TIFFSwabLong(&count);
+		}
+		count64 = count;
+		if (tif->tif_flags & TIFF_SWAB)
+			TIFFSwabLong8(&count64);
+		_TIFFmemcpy(o, e, 4);               /* tag and type */
+		_TIFFmemcpy(o + 4, &count64, 8);
+		size = (uint64) count * TIFFDataWidth((TIFFDataType) type);
+		if ((type == TIFF_LONG || type == TIFF_IFD) && count > 0 &&
+		    count <= 0xFFFF && depth < PROMOTE_MAX_DEPTH &&
+		    (type == TIFF_IFD || tag == TIFFTAG_SUBIFD ||
+		     tag == TIFFTAG_EXIFIFD || tag == TIFFTAG_GPSIFD ||
+		     tag == TIFFTAG_INTEROPERABILITYIFD)) {
+			uint16 ifd8 = TIFF_IFD8;
+			if (tif->tif_flags & TIFF_SWAB)
+				TIFFSwabShort(&ifd8);
+			_TIFFmemcpy(o + 2, &ifd8, 2);
+			if (!_TIFFPromoteIfdEntry(tif, count, e + 8, depth,
+			    o + 12, module))
+				goto done;
+		} else if (size <= 4) {
+			_TIFFmemcpy(o + 12, e + 8, 4);
+		} else if (size <= 8) {
+			uint32 valoff;
+			_TIFFmemcpy(&valoff, e + 8, 4);
+			if (tif->tif_flags & TIFF_SWAB)
+				TIFFSwabLong(&valoff);
+			if (!_TIFFPromoteRead(tif, valoff, o + 12,
+			    (tmsize_t) size, module))
+				goto done;
+		} else {
+			uint32 valoff;
+			uint64 valoff64;
+			_TIFFmemcpy(&valoff, e + 8, 4);
+			if (tif->tif_flags & TIFF_SWAB)
+				TIFFSwabLong(&valoff);
+			valoff64 = valoff;
+			if (tif->tif_flags & TIFF_SWAB)
+				TIFFSwabLong8(&valoff64);
+			_TIFFmemcpy(o + 12, &valoff64, 8);
+		}
+	}
+	if (tif->tif_flags & TIFF_SWAB)
+		TIFFSwabLong8(&next);
+	_TIFFmemcpy(out + 8 + 20 * (size_t) n, &next, 8);
+	*pnew = _TIFFPromoteAppend(tif, out, 8 + 20 * (tmsize_t) n + 8,
+	    module);
+	ok = *pnew != 0;
+done:
+	_TIFFfreeExt(tif, in);
+	_TIFFfreeExt(tif, out);
+	return (ok);
+}
+
+/*
+ * Convert the chain of classic directories starting at first, up to
+ * skip if it is in it, which must then be its last directory (*pskipped
+ * is set then).  The offsets of the first and last converted
+ * directories are returned in *pfirst and *plast, 0 if there are none.
+ */
+static int
+_TIFFPromoteChain(TIFF* tif, uint64 first, uint64 skip, int depth,
+    uint64* pfirst, uint64* plast, int* pskipped, const char* module)
+{
+	uint64* offs = NULL;
+	uint32 n = 0, alloc = 0;
+	uint64 off, next;
+	int ok = 0;
+
+	*pfirst = *plast = 0;
+	*pskipped = 0;
+	for (off = first; off != 0; ) {
+		uint16 count;
+		uint32 link;
+
+		if (off == skip) {
+			if (!_TIFFPromoteRead(tif, off, &count, 2, module))
+				goto done;
+			if (tif->tif_flags & TIFF_SWAB)
+				TIFFSwabShort(&count);
+			if (!_TIFFPromoteRead(tif, off + 2 + 12 * (uint64) count,
+			    &link, 4, module))
+				goto done;
+			if (link != 0) {
+				TIFFErrorExtR(tif, module, "Cannot switch to "
+				    "BigTIFF when rewriting a directory other "
+				    "than the last one");
+				goto done;
+			}
+			*pskipped = 1;
+			break;
+		}
+		if (n == PROMOTE_MAX_CHAIN) {
+			TIFFErrorExtR(tif, module,
+			    "Directory chain too long or looping");
+			goto done;
+		}
+		if (n == alloc) {
+			uint64* p;
+			alloc = alloc ? 2 * alloc : 16;
+			p = (uint64*) _TIFFCheckRealloc(tif, offs, alloc, 8,
+			    module);
+			if (p == NULL)
+				goto done;
+			offs = p;
+		}
+		offs[n++] = off;
+		if (!_TIFFPromoteRead(tif, off, &count, 2, module))
+			goto done;
+		if (tif->tif_flags & TIFF_SWAB)
+			TIFFSwabShort(&count);
+		if (!_TIFFPromoteRead(tif, off + 2 + 12 * (uint64) count,
+		    &link, 4, module))
+			goto done;
+		if (tif->tif_flags & TIFF_SWAB)
+			TIFFSwabLong(&link);
+		off = link;
+	}
+	/* Backwards, so that each directory can link to the next */
+	next = 0;
+	while (n > 0) {
+		if (!_TIFFPromoteDirectory(tif, offs[--n], next, depth, &next,
+		    module))
+			goto done;
+		if (*plast == 0)
+			*plast = next;
+	}
+	*pfirst = next;
+	ok = 1;
+done:
+	_TIFFfreeExt(tif, offs);
+	return (ok);
+}
+
+/*
+ * Called before a directory is written: switch to BigTIFF if the
+ * directory could end past 4 GiB, and convert the directories written
+ * so far once the handle has switched.
+ */
+int
+_TIFFPromoteDirectories(TIFF* tif, const char* module)
+{
+	TIFFHeaderBig header;
+	uint64 first, last;
+	int skipped;
+
+	if (tif->tif_promote == TIFF_PROMOTE_AUTO &&
+	    !_TIFFPromoteIfNeeded(tif, TIFFSeekFile(tif, 0, SEEK_END) +
+	    _TIFFDirectorySizeBound(tif), module))
+		return (0);
+	if (tif->tif_promote != TIFF_PROMOTE_PENDING)
+		return (1);
+
+	/*
+	 * The current directory, if written before by
+	 * TIFFCheckpointDirectory() for instance, is left out and written
+	 * anew after the others.
+	 */
+	if (!_TIFFPromoteChain(tif, tif->tif_header.classic.tiff_diroff,
+	    tif->tif_diroff, 0, &first, &last, &skipped, module))
+		return (0);
+	if (skipped)
+		tif->tif_diroff = 0;
+
+	header.tiff_magic = tif->tif_header.common.tiff_magic;
+	header.tiff_version = TIFF_VERSION_BIG;
+	header.tiff_offsetsize = 8;
+	header.tiff_unused = 0;
+	header.tiff_diroff = first;
+	tif->tif_header.big = header;
+	tif->tif_header_size = sizeof (TIFFHeaderBig);
+	if (tif->tif_flags & TIFF_SWAB) {
+		TIFFSwabShort(&header.tiff_version);
+		TIFFSwabShort(&header.tiff_offsetsize);
+		TIFFSwabLong8(&header.tiff_diroff);
+	}
+	if (!SeekOK(tif, 0) || !WriteOK(tif, &header, sizeof (header))) {
+		TIFFErrorExtR(tif, module, "Error writing BigTIFF header");
+		return (0);
+	}
+	tif->tif_lastdiroff = last;
+	tif->tif_promote = TIFF_PROMOTE_NONE;
+	_TIFFResetDirIndex(tif);
+	_TIFFResetOverviewIndex(tif);
+	return (1);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
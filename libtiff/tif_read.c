@@ -28,6 +28,7 @@
  */
 #include "tiffiop.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 #define TIFF_SIZE_T_MAX ((size_t) ~ ((size_t)0))
 #define TIFF_TMSIZE_T_MAX (tmsize_t)(TIFF_SIZE_T_MAX >> 1)
@@ -37,6 +38,8 @@ int TIFFFillTile(TIFF* tif, uint32 tile);
 static int TIFFStartStrip(TIFF* tif, uint32 strip);
 static int TIFFStartTile(TIFF* tif, uint32 tile);
 static int TIFFCheckRead(TIFF*, int);
+static tmsize_t TIFFReadSparse(void* buf, tmsize_t size, tmsize_t chunksize);
+static void TIFFUndoRawChunk(TIFF* tif, uint8* buf, tmsize_t size);
 static tmsize_t
 TIFFReadRawStrip1(TIFF* tif, uint32 strip, void* buf, tmsize_t size,const char* module);
 static tmsize_t
@@ -85,23 +88,24 @@ static int TIFFReadAndRealloc( TIFF* tif, tmsize_t size,
                 tif->tif_rawdatasize = (tmsize_t)TIFFroundup_64(
                         (uint64)already_read + to_read + rawdata_offset, 1024);
                 if (tif->tif_rawdatasize==0) {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                                 "Invalid buffer size");
                     return 0;
                 }
-                new_rawdata = (uint8*) _TIFFrealloc(
+                new_rawdata = (uint8*) _TIFFreallocExt(tif,
                                 tif->tif_rawdata, tif->tif_rawdatasize);
                 if( new_rawdata == 0 )
                 {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                         "No space for data buffer at scanline %lu",
                         (unsigned long) tif->tif_row);
-                    _TIFFfree(tif->tif_rawdata);
+                    _TIFFfreeExt(tif, tif->tif_rawdata);
                     tif->tif_rawdata = 0;
                     tif->tif_rawdatasize = 0;
                     return 0;
                 }
                 tif->tif_rawdata = new_rawdata;
+                TIFFStatsAdd(tif, rawbufferallocs, 1);
             }
 
             bytes_read = TIFFReadFile(tif,
@@ -113,7 +117,7 @@ static int TIFFReadAndRealloc( TIFF* tif, tmsize_t size,
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
                 if( is_strip )
                 {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                         "Read error at scanline %lu; got %I64u bytes, "
                         "expected %I64u",
                                         (unsigned long) tif->tif_row,
@@ -122,7 +126,7 @@ static int TIFFReadAndRealloc( TIFF* tif, tmsize_t size,
                 }
                 else
                 {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                         "Read error at row %lu, col %lu, tile %lu; "
                         "got %I64u bytes, expected %I64u",
                                         (unsigned long) tif->tif_row,
@@ -134,7 +138,7 @@ static int TIFFReadAndRealloc( TIFF* tif, tmsize_t size,
 #else
                 if( is_strip )
                 {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                         "Read error at scanline %lu; got %llu bytes, "
                         "expected %llu",
                                         (unsigned long) tif->tif_row,
@@ -143,7 +147,7 @@ static int TIFFReadAndRealloc( TIFF* tif, tmsize_t size,
                 }
                 else
                 {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                         "Read error at row %lu, col %lu, tile %lu; "
                         "got %llu bytes, expected %llu",
                                         (unsigned long) tif->tif_row,
@@ -171,7 +175,7 @@ TIFFFillStripPartial( TIFF *tif, int strip, tmsize_t read_ahead, int restart )
         tmsize_t read_ahead_mod;
         /* tmsize_t bytecountm; */
         
-        if (!_TIFFFillStriles( tif ) || !tif->tif_dir.td_stripbytecount)
+        if (!_TIFFHaveStriles(tif))
             return 0;
         
         /*
@@ -193,7 +197,7 @@ TIFFFillStripPartial( TIFF *tif, int strip, tmsize_t read_ahead, int restart )
                 
                 tif->tif_curstrip = NOSTRIP;
                 if ((tif->tif_flags & TIFF_MYBUFFER) == 0) {
-                        TIFFErrorExt(tif->tif_clientdata, module,
+                        TIFFErrorExtR(tif, module,
                                      "Data buffer too small to hold part of strip %lu",
                                      (unsigned long) strip);
                         return (0);
@@ -224,11 +228,11 @@ TIFFFillStripPartial( TIFF *tif, int strip, tmsize_t read_ahead, int restart )
         /*
         ** Seek to the point in the file where more data should be read.
         */
-        read_offset = td->td_stripoffset[strip]
+        read_offset = TIFFGetStrileOffset(tif, strip)
                 + tif->tif_rawdataoff + tif->tif_rawdataloaded;
 
         if (!SeekOK(tif, read_offset)) {
-                TIFFErrorExt(tif->tif_clientdata, module,
+                TIFFErrorExtR(tif, module,
                              "Seek error at scanline %lu, strip %lu",
                              (unsigned long) tif->tif_row, (unsigned long) strip);
                 return 0;
@@ -241,10 +245,10 @@ TIFFFillStripPartial( TIFF *tif, int strip, tmsize_t read_ahead, int restart )
                 to_read = read_ahead_mod - unused_data;
         else
                 to_read = tif->tif_rawdatasize - unused_data;
-        if( (uint64) to_read > td->td_stripbytecount[strip] 
+        if( (uint64) to_read > TIFFGetStrileByteCount(tif, strip) 
             - tif->tif_rawdataoff - tif->tif_rawdataloaded )
         {
-                to_read = (tmsize_t) td->td_stripbytecount[strip]
+                to_read = (tmsize_t) TIFFGetStrileByteCount(tif, strip)
                         - tif->tif_rawdataoff - tif->tif_rawdataloaded;
         }
 
@@ -283,7 +287,7 @@ TIFFFillStripPartial( TIFF *tif, int strip, tmsize_t read_ahead, int restart )
             /* For JPEG, if there are multiple scans (can generally be known */
             /* with the  read_ahead used), we need to read the whole strip */
             if( tif->tif_dir.td_compression==COMPRESSION_JPEG &&
-                (uint64)tif->tif_rawcc < td->td_stripbytecount[strip] )
+                (uint64)tif->tif_rawcc < TIFFGetStrileByteCount(tif, strip) )
             {
                 if( TIFFJPEGIsFullStripRequired(tif) )
                 {
@@ -300,13 +304,43 @@ TIFFFillStripPartial( TIFF *tif, int strip, tmsize_t read_ahead, int restart )
         }
 }
 
+/*
+ * Decode and drop the rows of the current strip up to row, for codecs
+ * that cannot skip them otherwise.  Checkpoints are taken on the way.
+ */
+static int
+TIFFSkipRows(TIFF* tif, uint32 strip, uint32 row, uint16 sample,
+    tmsize_t read_ahead)
+{
+	uint8* buf;
+
+	buf = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_SEEK,
+	    tif->tif_scanlinesize);
+	if (buf == NULL)
+		return (0);
+	while (tif->tif_row < row) {
+		if (read_ahead > 0 &&
+		    ((tif->tif_rawdata + tif->tif_rawdataloaded) - tif->tif_rawcp) < read_ahead &&
+		    (uint64) tif->tif_rawdataoff + tif->tif_rawdataloaded <
+		    TIFFGetStrileByteCount(tif, strip) &&
+		    !TIFFFillStripPartial(tif, strip, read_ahead, 0))
+			return (0);
+		if (!_TIFFCallDecode(tif, tif_decoderow, buf,
+		    tif->tif_scanlinesize, sample))
+			return (0);
+		tif->tif_row++;
+		_TIFFCheckpointSave(tif);
+	}
+	return (1);
+}
+
 /*
  * Seek to a random row+sample in a file.
  *
  * Only used by TIFFReadScanline, and is only used on
  * strip organized files.  We do some tricky stuff to try
  * and avoid reading the whole compressed raw data for big
- * strips.
+ * strips.  Returns 2 if the row is in a sparse strip.
  */
 static int
 TIFFSeek(TIFF* tif, uint32 row, uint16 sample )
@@ -315,12 +349,15 @@ TIFFSeek(TIFF* tif, uint32 row, uint16 sample )
 	uint32 strip;
         int    whole_strip;
 	tmsize_t read_ahead = 0;
+	uint32 ckrow;
+	uint64 rawoff;
+	int which;
 
         /*
         ** Establish what strip we are working from.
         */
 	if (row >= td->td_imagelength) {	/* out of range */
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 		    "%lu: Row out of range, max %lu",
 		    (unsigned long) row,
 		    (unsigned long) td->td_imagelength);
@@ -328,7 +365,7 @@ TIFFSeek(TIFF* tif, uint32 row, uint16 sample )
 	}
 	if (td->td_planarconfig == PLANARCONFIG_SEPARATE) {
 		if (sample >= td->td_samplesperpixel) {
-			TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+			TIFFErrorExtR(tif, tif->tif_name,
 			    "%lu: Sample out of range, max %lu",
 			    (unsigned long) sample, (unsigned long) td->td_samplesperpixel);
 			return (0);
@@ -337,17 +374,23 @@ TIFFSeek(TIFF* tif, uint32 row, uint16 sample )
 	} else
 		strip = row / td->td_rowsperstrip;
 
+	/* The rows of a sparse strip read as zeros, the strip is not loaded */
+	if (_TIFFIsSparseStrile(tif, strip))
+		return (2);
+
         /*
          * Do we want to treat this strip as one whole chunk or
          * read it a few lines at a time?
          */
 #if defined(CHUNKY_STRIP_READ_SUPPORT)
-        if (!_TIFFFillStriles( tif ) || !tif->tif_dir.td_stripbytecount)
+        if (!_TIFFHaveStriles(tif))
             return 0;
-        whole_strip = tif->tif_dir.td_stripbytecount[strip] < 10
+        whole_strip = TIFFGetStrileByteCount(tif, strip) < 10
                 || isMapped(tif);
 #else
-        whole_strip = 1;
+        /* Large compressed single strips, see TIFFReadDirectory() */
+        whole_strip = (tif->tif_flags & TIFF_CHUNKYSTRIP) == 0
+                || isMapped(tif);
 #endif
         
         if( !whole_strip )
@@ -390,10 +433,43 @@ TIFFSeek(TIFF* tif, uint32 row, uint16 sample )
         else if( !whole_strip )
         {
                 if( ((tif->tif_rawdata + tif->tif_rawdataloaded) - tif->tif_rawcp) < read_ahead 
-                    && (uint64) tif->tif_rawdataoff+tif->tif_rawdataloaded < td->td_stripbytecount[strip] )
+                    && (uint64) tif->tif_rawdataoff+tif->tif_rawdataloaded < TIFFGetStrileByteCount(tif, strip) )
+                {
+                        if( !TIFFFillStripPartial(tif,strip,read_ahead,0) )
+                                return 0;
+                }
+        }
+
+        /*
+         * With checkpoints, resume decoding at the last one before the
+         * row when that is closer than the current position.
+         */
+        if (tif->tif_checkpoints != NULL && row != tif->tif_row &&
+            (which = _TIFFCheckpointFind(tif, strip, row, &ckrow, &rawoff)) != 0 &&
+            (row < tif->tif_row || ckrow > tif->tif_row) )
+        {
+                if( !_TIFFCheckpointRestore(tif, which) )
+                {
+                        /* The decoder state is lost, restart below */
+                        tif->tif_row = (uint32) -1;
+                }
+                else if( rawoff >= (uint64) tif->tif_rawdataoff &&
+                    rawoff <= (uint64) tif->tif_rawdataoff + tif->tif_rawdataloaded )
+                {
+                        tif->tif_rawcp = tif->tif_rawdata +
+                                (tmsize_t)(rawoff - tif->tif_rawdataoff);
+                        tif->tif_rawcc = tif->tif_rawdataoff +
+                                tif->tif_rawdataloaded - (tmsize_t) rawoff;
+                        tif->tif_row = ckrow;
+                }
+                else
                 {
+                        /* Only part of the strip is loaded, read from there */
+                        tif->tif_rawdataoff = (tmsize_t) rawoff;
+                        tif->tif_rawdataloaded = 0;
                         if( !TIFFFillStripPartial(tif,strip,read_ahead,0) )
                                 return 0;
+                        tif->tif_row = ckrow;
                 }
         }
 
@@ -426,7 +502,11 @@ TIFFSeek(TIFF* tif, uint32 row, uint16 sample )
 
                 /* TODO: Will this really work with partial buffers? */
                 
-		if (!(*tif->tif_seek)(tif, row - tif->tif_row))
+		if (tif->tif_checkpoints != NULL &&
+		    tif->tif_seek == _TIFFNoSeek) {
+			if (!TIFFSkipRows(tif, strip, row, sample, read_ahead))
+				return (0);
+		} else if (!(*tif->tif_seek)(tif, row - tif->tif_row))
 			return (0);
 		tif->tif_row = row;
 	}
@@ -439,21 +519,27 @@ TIFFReadScanline(TIFF* tif, void* buf, uint32 row, uint16 sample)
 {
 	int e;
 
-	if (!TIFFCheckRead(tif, 0))
+	if (!TIFFCheckRead(tif, 0) || _TIFFCheckCancel(tif, "TIFFReadScanline"))
 		return (-1);
-	if( (e = TIFFSeek(tif, row, sample)) != 0) {
+	if( (e = TIFFSeek(tif, row, sample)) == 2) {
+		_TIFFmemset(buf, 0, tif->tif_scanlinesize);
+		e = 1;
+	} else if (e != 0) {
 		/*
 		 * Decompress desired row into user buffer.
 		 */
-		e = (*tif->tif_decoderow)
-		    (tif, (uint8*) buf, tif->tif_scanlinesize, sample);  
+		e = _TIFFCallDecode(tif, tif_decoderow,
+		    (uint8*) buf, tif->tif_scanlinesize, sample);
 
 		/* we are now poised at the beginning of the next row */
 		tif->tif_row = row + 1;
 
-		if (e)
-			(*tif->tif_postdecode)(tif, (uint8*) buf,
-			    tif->tif_scanlinesize);  
+		if (e) {
+			if (tif->tif_checkpoints)
+				_TIFFCheckpointSave(tif);
+			_TIFFCallPostDecode(tif, (uint8*) buf,
+			    tif->tif_scanlinesize);
+		}
 	}
 	return (e > 0 ? 1 : -1);
 }
@@ -476,7 +562,7 @@ static tmsize_t TIFFReadEncodedStripGetStripSize(TIFF* tif, uint32 strip, uint16
 		return((tmsize_t)(-1));
 	if (strip>=td->td_nstrips)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,
+		TIFFErrorExtR(tif,module,
 		    "%lu: Strip out of range, max %lu",(unsigned long)strip,
 		    (unsigned long)td->td_nstrips);
 		return((tmsize_t)(-1));
@@ -501,17 +587,21 @@ static tmsize_t TIFFReadEncodedStripGetStripSize(TIFF* tif, uint32 strip, uint16
  * Read a strip of data and decompress the specified
  * amount into the user-supplied buffer.
  */
-tmsize_t
-TIFFReadEncodedStrip(TIFF* tif, uint32 strip, void* buf, tmsize_t size)
+static tmsize_t
+TIFFReadEncodedStrip1(TIFF* tif, uint32 strip, void* buf, tmsize_t size)
 {
 	static const char module[] = "TIFFReadEncodedStrip";
 	TIFFDirectory *td = &tif->tif_dir;
 	tmsize_t stripsize;
 	uint16 plane;
 
+	if (_TIFFCheckCancel(tif, module))
+		return((tmsize_t)(-1));
 	stripsize=TIFFReadEncodedStripGetStripSize(tif, strip, &plane);
 	if (stripsize==((tmsize_t)(-1)))
 		return((tmsize_t)(-1));
+	if (_TIFFIsSparseStrile(tif, strip))
+		return (TIFFReadSparse(buf, size, stripsize));
 
     /* shortcut to avoid an extra memcpy() */
     if( td->td_compression == COMPRESSION_NONE &&
@@ -522,11 +612,8 @@ TIFFReadEncodedStrip(TIFF* tif, uint32 strip, void* buf, tmsize_t size)
         if (TIFFReadRawStrip1(tif, strip, buf, stripsize, module) != stripsize)
             return ((tmsize_t)(-1));
 
-        if (!isFillOrder(tif, td->td_fillorder) &&
-            (tif->tif_flags & TIFF_NOBITREV) == 0)
-            TIFFReverseBits(buf,stripsize);
-
-        (*tif->tif_postdecode)(tif,buf,stripsize);
+        TIFFUndoRawChunk(tif, (uint8*) buf, stripsize);
+        TIFFStatsAdd(tif, stripsdecoded, 1);
         return (stripsize);
     }
 
@@ -534,14 +621,40 @@ TIFFReadEncodedStrip(TIFF* tif, uint32 strip, void* buf, tmsize_t size)
 		stripsize=size;
 	if (!TIFFFillStrip(tif,strip))
 		return((tmsize_t)(-1));
-	if ((*tif->tif_decodestrip)(tif,buf,stripsize,plane)<=0)
+	if (_TIFFCallDecode(tif,tif_decodestrip,buf,stripsize,plane)<=0)
 		return((tmsize_t)(-1));
-	(*tif->tif_postdecode)(tif,buf,stripsize);
+	_TIFFCallPostDecode(tif,buf,stripsize);
 	return(stripsize);
 }
 
+/*
+ * Decoded strips are looked up in, and whole strips entered into, the
+ * chunk cache of the handle if it has one.
+ */
+tmsize_t
+TIFFReadEncodedStrip(TIFF* tif, uint32 strip, void* buf, tmsize_t size)
+{
+	tmsize_t stripsize, n;
+
+	if (tif->tif_chunkcache == NULL)
+		return (TIFFReadEncodedStrip1(tif, strip, buf, size));
+	stripsize = TIFFReadEncodedStripGetStripSize(tif, strip, NULL);
+	if (stripsize == (tmsize_t)(-1))
+		return ((tmsize_t)(-1));
+	/* sparse strips cost nothing to read */
+	if (_TIFFIsSparseStrile(tif, strip))
+		return (TIFFReadSparse(buf, size, stripsize));
+	n = _TIFFChunkCacheGet(tif, strip, buf, size);
+	if (n != (tmsize_t)(-1))
+		return (n);
+	n = TIFFReadEncodedStrip1(tif, strip, buf, size);
+	if (n == stripsize)
+		_TIFFChunkCachePut(tif, strip, buf, n);
+	return (n);
+}
+
 /* Variant of TIFFReadEncodedStrip() that does 
- * * if *buf == NULL, *buf = _TIFFmalloc(bufsizetoalloc) only after TIFFFillStrip() has
+ * * if *buf == NULL, *buf = _TIFFmallocExt(tif, bufsizetoalloc) only after TIFFFillStrip() has
  *   succeeded. This avoid excessive memory allocation in case of truncated
  *   file.
  * * calls regular TIFFReadEncodedStrip() if *buf != NULL
@@ -553,31 +666,48 @@ _TIFFReadEncodedStripAndAllocBuffer(TIFF* tif, uint32 strip,
 {
     tmsize_t this_stripsize;
     uint16 plane;
+    int sparse;
 
+    if( *buf == NULL && tif->tif_chunkcache != NULL )
+    {
+        /* The cache copies into a buffer allocated up front */
+        *buf = _TIFFmallocExt(tif, bufsizetoalloc);
+        if (*buf == NULL) {
+                TIFFErrorExtR(tif, TIFFFileName(tif),
+                             "No space for strip buffer");
+                return((tmsize_t)(-1));
+        }
+        _TIFFmemset(*buf, 0, bufsizetoalloc);
+    }
     if( *buf != NULL )
     {
         return TIFFReadEncodedStrip(tif, strip, *buf, size_to_read);
     }
 
+    if (_TIFFCheckCancel(tif, TIFFFileName(tif)))
+            return((tmsize_t)(-1));
     this_stripsize=TIFFReadEncodedStripGetStripSize(tif, strip, &plane);
     if (this_stripsize==((tmsize_t)(-1)))
             return((tmsize_t)(-1));
 
     if ((size_to_read!=(tmsize_t)(-1))&&(size_to_read<this_stripsize))
             this_stripsize=size_to_read;
-    if (!TIFFFillStrip(tif,strip))
+    sparse = _TIFFIsSparseStrile(tif, strip);
+    if (!sparse && !TIFFFillStrip(tif,strip))
             return((tmsize_t)(-1));
 
-    *buf = _TIFFmalloc(bufsizetoalloc);
+    *buf = _TIFFmallocExt(tif, bufsizetoalloc);
     if (*buf == NULL) {
-            TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif), "No space for strip buffer");
+            TIFFErrorExtR(tif, TIFFFileName(tif), "No space for strip buffer");
             return((tmsize_t)(-1));
     }
     _TIFFmemset(*buf, 0, bufsizetoalloc);
+    if (sparse)
+            return (this_stripsize);
 
-    if ((*tif->tif_decodestrip)(tif,*buf,this_stripsize,plane)<=0)
+    if (_TIFFCallDecode(tif,tif_decodestrip,*buf,this_stripsize,plane)<=0)
             return((tmsize_t)(-1));
-    (*tif->tif_postdecode)(tif,*buf,this_stripsize);
+    _TIFFCallPostDecode(tif,*buf,this_stripsize);
     return(this_stripsize);
 
 
@@ -587,17 +717,16 @@ static tmsize_t
 TIFFReadRawStrip1(TIFF* tif, uint32 strip, void* buf, tmsize_t size,
     const char* module)
 {
-	TIFFDirectory *td = &tif->tif_dir;
 
-    if (!_TIFFFillStriles( tif ))
+    if (!_TIFFHaveStriles(tif))
         return ((tmsize_t)(-1));
         
 	assert((tif->tif_flags&TIFF_NOREADRAW)==0);
 	if (!isMapped(tif)) {
 		tmsize_t cc;
 
-		if (!SeekOK(tif, td->td_stripoffset[strip])) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+		if (!SeekOK(tif, TIFFGetStrileOffset(tif, strip))) {
+			TIFFErrorExtR(tif, module,
 			    "Seek error at scanline %lu, strip %lu",
 			    (unsigned long) tif->tif_row, (unsigned long) strip);
 			return ((tmsize_t)(-1));
@@ -605,13 +734,13 @@ TIFFReadRawStrip1(TIFF* tif, uint32 strip, void* buf, tmsize_t size,
 		cc = TIFFReadFile(tif, buf, size);
 		if (cc != size) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 		"Read error at scanline %lu; got %I64u bytes, expected %I64u",
 				     (unsigned long) tif->tif_row,
 				     (unsigned __int64) cc,
 				     (unsigned __int64) size);
 #else
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 		"Read error at scanline %lu; got %llu bytes, expected %llu",
 				     (unsigned long) tif->tif_row,
 				     (unsigned long long) cc,
@@ -622,8 +751,8 @@ TIFFReadRawStrip1(TIFF* tif, uint32 strip, void* buf, tmsize_t size,
 	} else {
 		tmsize_t ma = 0;
 		tmsize_t n;
-		if ((td->td_stripoffset[strip] > (uint64)TIFF_TMSIZE_T_MAX)||
-                    ((ma=(tmsize_t)td->td_stripoffset[strip])>tif->tif_size))
+		if ((TIFFGetStrileOffset(tif, strip) > (uint64)TIFF_TMSIZE_T_MAX)||
+                    ((ma=(tmsize_t)TIFFGetStrileOffset(tif, strip))>tif->tif_size))
                 {
                     n=0;
                 }
@@ -641,14 +770,14 @@ TIFFReadRawStrip1(TIFF* tif, uint32 strip, void* buf, tmsize_t size,
                 }
 		if (n!=size) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 	"Read error at scanline %lu, strip %lu; got %I64u bytes, expected %I64u",
 				     (unsigned long) tif->tif_row,
 				     (unsigned long) strip,
 				     (unsigned __int64) n,
 				     (unsigned __int64) size);
 #else
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 	"Read error at scanline %lu, strip %lu; got %llu bytes, expected %llu",
 				     (unsigned long) tif->tif_row,
 				     (unsigned long) strip,
@@ -667,22 +796,28 @@ static tmsize_t
 TIFFReadRawStripOrTile2(TIFF* tif, uint32 strip_or_tile, int is_strip,
                         tmsize_t size, const char* module)
 {
-        TIFFDirectory *td = &tif->tif_dir;
 
         assert( !isMapped(tif) );
         assert((tif->tif_flags&TIFF_NOREADRAW)==0);
 
-        if (!SeekOK(tif, td->td_stripoffset[strip_or_tile])) {
+        if( tif->tif_prefetch &&
+            _TIFFPrefetchTake( tif, strip_or_tile, size ) )
+        {
+            _TIFFPrefetchSchedule( tif, strip_or_tile );
+            return (size);
+        }
+
+        if (!SeekOK(tif, TIFFGetStrileOffset(tif, strip_or_tile))) {
             if( is_strip )
             {
-                TIFFErrorExt(tif->tif_clientdata, module,
+                TIFFErrorExtR(tif, module,
                     "Seek error at scanline %lu, strip %lu",
                     (unsigned long) tif->tif_row,
                     (unsigned long) strip_or_tile);
             }
             else
             {
-                TIFFErrorExt(tif->tif_clientdata, module,
+                TIFFErrorExtR(tif, module,
                     "Seek error at row %lu, col %lu, tile %lu",
                     (unsigned long) tif->tif_row,
                     (unsigned long) tif->tif_col,
@@ -697,6 +832,9 @@ TIFFReadRawStripOrTile2(TIFF* tif, uint32 strip_or_tile, int is_strip,
             return ((tmsize_t)(-1));
         }
 
+        if( tif->tif_prefetch )
+            _TIFFPrefetchSchedule( tif, strip_or_tile );
+
         return (size);
 }
 
@@ -714,7 +852,7 @@ TIFFReadRawStrip(TIFF* tif, uint32 strip, void* buf, tmsize_t size)
 	if (!TIFFCheckRead(tif, 0))
 		return ((tmsize_t)(-1));
 	if (strip >= td->td_nstrips) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		     "%lu: Strip out of range, max %lu",
 		     (unsigned long) strip,
 		     (unsigned long) td->td_nstrips);
@@ -722,19 +860,19 @@ TIFFReadRawStrip(TIFF* tif, uint32 strip, void* buf, tmsize_t size)
 	}
 	if (tif->tif_flags&TIFF_NOREADRAW)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Compression scheme does not support access to raw uncompressed data");
 		return ((tmsize_t)(-1));
 	}
-	bytecount = td->td_stripbytecount[strip];
+	bytecount = TIFFGetStrileByteCount(tif, strip);
 	if ((int64)bytecount <= 0) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "%I64u: Invalid strip byte count, strip %lu",
 			     (unsigned __int64) bytecount,
 			     (unsigned long) strip);
 #else
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "%llu: Invalid strip byte count, strip %lu",
 			     (unsigned long long) bytecount,
 			     (unsigned long) strip);
@@ -743,7 +881,7 @@ TIFFReadRawStrip(TIFF* tif, uint32 strip, void* buf, tmsize_t size)
 	}
 	bytecountm = (tmsize_t)bytecount;
 	if ((uint64)bytecountm!=bytecount) {
-		TIFFErrorExt(tif->tif_clientdata, module, "Integer overflow");
+		TIFFErrorExtR(tif, module, "Integer overflow");
 		return ((tmsize_t)(-1));
 	}
 	if (size != (tmsize_t)(-1) && size < bytecountm)
@@ -752,29 +890,72 @@ TIFFReadRawStrip(TIFF* tif, uint32 strip, void* buf, tmsize_t size)
 }
 
 /*
- * Read the specified strip and setup for decoding. The data buffer is
- * expanded, as necessary, to hold the strip's data.
+ * Tell the system how the mapped file image is about to be accessed:
+ * strips are normally read in order, while tiles are better left to
+ * the default read-around of page faults (declaring them random makes
+ * every fault read a single page).  With willneed the len bytes at
+ * off are also scheduled for reading at once, which pays off when
+ * several chunks are wanted together.
  */
-int
-TIFFFillStrip(TIFF* tif, uint32 strip)
+static void
+TIFFAdviseMapping(TIFF* tif, uint64 off, uint64 len, int willneed)
+{
+	int advice = isTiled(tif) ? TIFF_MAP_NORMAL : TIFF_MAP_SEQUENTIAL;
+
+	if (tif->tif_mapadviceproc == NULL)
+		return;
+	if (tif->tif_mapadvice != advice) {
+		(*tif->tif_mapadviceproc)(tif->tif_clientdata, tif->tif_base,
+		    tif->tif_size, advice);
+		tif->tif_mapadvice = advice;
+	}
+	if (willneed && len != 0)
+		(*tif->tif_mapadviceproc)(tif->tif_clientdata,
+		    tif->tif_base + (tmsize_t)off, (tmsize_t)len,
+		    TIFF_MAP_WILLNEED);
+}
+
+/*
+ * Call fill for strile, reporting it to the trace callback.
+ */
+static int
+TIFFFillTraced(TIFF* tif, uint32 strile, int (*fill)(TIFF*, uint32))
+{
+	uint64 bytes = 0;
+	int ret;
+
+	if (strile < tif->tif_dir.td_nstrips)
+		bytes = TIFFGetStrileByteCount(tif, strile);
+	_TIFFTrace(tif, TIFF_TRACE_FILL, TIFF_TRACE_BEGIN, strile, bytes);
+	ret = (*fill)(tif, strile);
+	_TIFFTrace(tif, TIFF_TRACE_FILL, ret ? TIFF_TRACE_END : TIFF_TRACE_FAIL,
+	    strile, bytes);
+	return (ret);
+}
+
+/*
+ * TIFFFillStrip() without the trace events.
+ */
+static int
+TIFFFillStrip1(TIFF* tif, uint32 strip)
 {
 	static const char module[] = "TIFFFillStrip";
 	TIFFDirectory *td = &tif->tif_dir;
 
-        if (!_TIFFFillStriles( tif ) || !tif->tif_dir.td_stripbytecount)
+        if (!_TIFFHaveStriles(tif))
             return 0;
 
 	if ((tif->tif_flags&TIFF_NOREADRAW)==0)
 	{
-		uint64 bytecount = td->td_stripbytecount[strip];
+		uint64 bytecount = TIFFGetStrileByteCount(tif, strip);
 		if ((int64)bytecount <= 0) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				"Invalid strip byte count %I64u, strip %lu",
 				     (unsigned __int64) bytecount,
 				     (unsigned long) strip);
 #else
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				"Invalid strip byte count %llu, strip %lu",
 				     (unsigned long long) bytecount,
 				     (unsigned long) strip);
@@ -797,13 +978,13 @@ TIFFFillStrip(TIFF* tif, uint32 strip)
 				if( (int64)newbytecount >= 0 )
 				{
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-					TIFFWarningExt(tif->tif_clientdata, module,
+					TIFFWarningExtR(tif, module,
 					  "Too large strip byte count %I64u, strip %lu. Limiting to %I64u",
 					     (unsigned __int64) bytecount,
 					     (unsigned long) strip,
 					     (unsigned __int64) newbytecount);
 #else
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					  "Too large strip byte count %llu, strip %lu. Limiting to %llu",
 					     (unsigned long long) bytecount,
 					     (unsigned long) strip,
@@ -819,38 +1000,40 @@ TIFFFillStrip(TIFF* tif, uint32 strip)
 			 * We must check for overflow, potentially causing
 			 * an OOB read. Instead of simple
 			 *
-			 *  td->td_stripoffset[strip]+bytecount > tif->tif_size
+			 *  TIFFGetStrileOffset(tif, strip)+bytecount > tif->tif_size
 			 *
 			 * comparison (which can overflow) we do the following
 			 * two comparisons:
 			 */
 			if (bytecount > (uint64)tif->tif_size ||
-			    td->td_stripoffset[strip] > (uint64)tif->tif_size - bytecount) {
+			    TIFFGetStrileOffset(tif, strip) > (uint64)tif->tif_size - bytecount) {
 				/*
 				 * This error message might seem strange, but
 				 * it's what would happen if a read were done
 				 * instead.
 				 */
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 
 					"Read error on strip %lu; "
 					"got %I64u bytes, expected %I64u",
 					(unsigned long) strip,
-					(unsigned __int64) tif->tif_size - td->td_stripoffset[strip],
+					(unsigned __int64) tif->tif_size - TIFFGetStrileOffset(tif, strip),
 					(unsigned __int64) bytecount);
 #else
-				TIFFErrorExt(tif->tif_clientdata, module,
+				TIFFErrorExtR(tif, module,
 
 					"Read error on strip %lu; "
 					"got %llu bytes, expected %llu",
 					(unsigned long) strip,
-					(unsigned long long) tif->tif_size - td->td_stripoffset[strip],
+					(unsigned long long) tif->tif_size - TIFFGetStrileOffset(tif, strip),
 					(unsigned long long) bytecount);
 #endif
 				tif->tif_curstrip = NOSTRIP;
 				return (0);
 			}
+			TIFFAdviseMapping(tif, TIFFGetStrileOffset(tif, strip),
+			    bytecount, 0);
 		}
 
 		if (isMapped(tif) &&
@@ -868,13 +1051,13 @@ TIFFFillStrip(TIFF* tif, uint32 strip)
 			 * fault since the file is mapped read-only).
 			 */
 			if ((tif->tif_flags & TIFF_MYBUFFER) && tif->tif_rawdata) {
-				_TIFFfree(tif->tif_rawdata);
+				_TIFFfreeExt(tif, tif->tif_rawdata);
 				tif->tif_rawdata = NULL;
 				tif->tif_rawdatasize = 0;
 			}
 			tif->tif_flags &= ~TIFF_MYBUFFER;
 			tif->tif_rawdatasize = (tmsize_t)bytecount;
-			tif->tif_rawdata = tif->tif_base + (tmsize_t)td->td_stripoffset[strip];
+			tif->tif_rawdata = tif->tif_base + (tmsize_t)TIFFGetStrileOffset(tif, strip);
                         tif->tif_rawdataoff = 0;
                         tif->tif_rawdataloaded = (tmsize_t) bytecount;
 
@@ -895,13 +1078,13 @@ TIFFFillStrip(TIFF* tif, uint32 strip)
 			bytecountm=(tmsize_t)bytecount;
 			if ((uint64)bytecountm!=bytecount)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Integer overflow");
+				TIFFErrorExtR(tif,module,"Integer overflow");
 				return(0);
 			}
 			if (bytecountm > tif->tif_rawdatasize) {
 				tif->tif_curstrip = NOSTRIP;
 				if ((tif->tif_flags & TIFF_MYBUFFER) == 0) {
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					    "Data buffer too small to hold strip %lu",
 					    (unsigned long) strip);
 					return (0);
@@ -948,6 +1131,18 @@ TIFFFillStrip(TIFF* tif, uint32 strip)
 	return (TIFFStartStrip(tif, strip));
 }
 
+/*
+ * Read the specified strip and setup for decoding. The data buffer is
+ * expanded, as necessary, to hold the strip's data.
+ */
+int
+TIFFFillStrip(TIFF* tif, uint32 strip)
+{
+	if (tif->tif_traceproc == NULL)
+		return (TIFFFillStrip1(tif, strip));
+	return (TIFFFillTraced(tif, strip, TIFFFillStrip1));
+}
+
 /*
  * Tile-oriented Read Support
  * Contributed by Nancy Cam (Silicon Graphics).
@@ -970,21 +1165,23 @@ TIFFReadTile(TIFF* tif, void* buf, uint32 x, uint32 y, uint32 z, uint16 s)
  * Read a tile of data and decompress the specified
  * amount into the user-supplied buffer.
  */
-tmsize_t
-TIFFReadEncodedTile(TIFF* tif, uint32 tile, void* buf, tmsize_t size)
+static tmsize_t
+TIFFReadEncodedTile1(TIFF* tif, uint32 tile, void* buf, tmsize_t size)
 {
 	static const char module[] = "TIFFReadEncodedTile";
 	TIFFDirectory *td = &tif->tif_dir;
 	tmsize_t tilesize = tif->tif_tilesize;
 
-	if (!TIFFCheckRead(tif, 1))
+	if (!TIFFCheckRead(tif, 1) || _TIFFCheckCancel(tif, module))
 		return ((tmsize_t)(-1));
 	if (tile >= td->td_nstrips) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "%lu: Tile out of range, max %lu",
 		    (unsigned long) tile, (unsigned long) td->td_nstrips);
 		return ((tmsize_t)(-1));
 	}
+	if (_TIFFIsSparseStrile(tif, tile))
+		return (TIFFReadSparse(buf, size, tilesize));
 
     /* shortcut to avoid an extra memcpy() */
     if( td->td_compression == COMPRESSION_NONE &&
@@ -995,11 +1192,8 @@ TIFFReadEncodedTile(TIFF* tif, uint32 tile, void* buf, tmsize_t size)
         if (TIFFReadRawTile1(tif, tile, buf, tilesize, module) != tilesize)
             return ((tmsize_t)(-1));
 
-        if (!isFillOrder(tif, td->td_fillorder) &&
-            (tif->tif_flags & TIFF_NOBITREV) == 0)
-            TIFFReverseBits(buf,tilesize);
-
-        (*tif->tif_postdecode)(tif,buf,tilesize);
+        TIFFUndoRawChunk(tif, (uint8*) buf, tilesize);
+        TIFFStatsAdd(tif, tilesdecoded, 1);
         return (tilesize);
     }
 
@@ -1007,16 +1201,39 @@ TIFFReadEncodedTile(TIFF* tif, uint32 tile, void* buf, tmsize_t size)
 		size = tilesize;
 	else if (size > tilesize)
 		size = tilesize;
-	if (TIFFFillTile(tif, tile) && (*tif->tif_decodetile)(tif,
+	if (TIFFFillTile(tif, tile) && _TIFFCallDecode(tif, tif_decodetile,
 	    (uint8*) buf, size, (uint16)(tile/td->td_stripsperimage))) {
-		(*tif->tif_postdecode)(tif, (uint8*) buf, size);
+		_TIFFCallPostDecode(tif, (uint8*) buf, size);
 		return (size);
 	} else
 		return ((tmsize_t)(-1));
 }
 
+/*
+ * Tile counterpart of TIFFReadEncodedStrip() with a chunk cache.
+ */
+tmsize_t
+TIFFReadEncodedTile(TIFF* tif, uint32 tile, void* buf, tmsize_t size)
+{
+	tmsize_t n;
+
+	if (tif->tif_chunkcache == NULL)
+		return (TIFFReadEncodedTile1(tif, tile, buf, size));
+	/* errors are reported by the uncached read */
+	if (!isTiled(tif) || tile >= tif->tif_dir.td_nstrips ||
+	    _TIFFIsSparseStrile(tif, tile))
+		return (TIFFReadEncodedTile1(tif, tile, buf, size));
+	n = _TIFFChunkCacheGet(tif, tile, buf, size);
+	if (n != (tmsize_t)(-1))
+		return (n);
+	n = TIFFReadEncodedTile1(tif, tile, buf, size);
+	if (n == tif->tif_tilesize)
+		_TIFFChunkCachePut(tif, tile, buf, n);
+	return (n);
+}
+
 /* Variant of TIFFReadTile() that does 
- * * if *buf == NULL, *buf = _TIFFmalloc(bufsizetoalloc) only after TIFFFillTile() has
+ * * if *buf == NULL, *buf = _TIFFmallocExt(tif, bufsizetoalloc) only after TIFFFillTile() has
  *   succeeded. This avoid excessive memory allocation in case of truncated
  *   file.
  * * calls regular TIFFReadEncodedTile() if *buf != NULL
@@ -1035,7 +1252,7 @@ _TIFFReadTileAndAllocBuffer(TIFF* tif,
 }
 
 /* Variant of TIFFReadEncodedTile() that does 
- * * if *buf == NULL, *buf = _TIFFmalloc(bufsizetoalloc) only after TIFFFillTile() has
+ * * if *buf == NULL, *buf = _TIFFmallocExt(tif, bufsizetoalloc) only after TIFFFillTile() has
  *   succeeded. This avoid excessive memory allocation in case of truncated
  *   file.
  * * calls regular TIFFReadEncodedTile() if *buf != NULL
@@ -1048,27 +1265,40 @@ _TIFFReadEncodedTileAndAllocBuffer(TIFF* tif, uint32 tile,
     static const char module[] = "_TIFFReadEncodedTileAndAllocBuffer";
     TIFFDirectory *td = &tif->tif_dir;
     tmsize_t tilesize = tif->tif_tilesize;
+    int sparse;
 
+    if( *buf == NULL && tif->tif_chunkcache != NULL )
+    {
+        /* The cache copies into a buffer allocated up front */
+        *buf = _TIFFmallocExt(tif, bufsizetoalloc);
+        if (*buf == NULL) {
+                TIFFErrorExtR(tif, TIFFFileName(tif),
+                             "No space for tile buffer");
+                return((tmsize_t)(-1));
+        }
+        _TIFFmemset(*buf, 0, bufsizetoalloc);
+    }
     if( *buf != NULL )
     {
         return TIFFReadEncodedTile(tif, tile, *buf, size_to_read);
     }
 
-    if (!TIFFCheckRead(tif, 1))
+    if (!TIFFCheckRead(tif, 1) || _TIFFCheckCancel(tif, module))
             return ((tmsize_t)(-1));
     if (tile >= td->td_nstrips) {
-            TIFFErrorExt(tif->tif_clientdata, module,
+            TIFFErrorExtR(tif, module,
                 "%lu: Tile out of range, max %lu",
                 (unsigned long) tile, (unsigned long) td->td_nstrips);
             return ((tmsize_t)(-1));
     }
 
-    if (!TIFFFillTile(tif,tile))
+    sparse = _TIFFIsSparseStrile(tif, tile);
+    if (!sparse && !TIFFFillTile(tif,tile))
             return((tmsize_t)(-1));
 
-    *buf = _TIFFmalloc(bufsizetoalloc);
+    *buf = _TIFFmallocExt(tif, bufsizetoalloc);
     if (*buf == NULL) {
-            TIFFErrorExt(tif->tif_clientdata, TIFFFileName(tif),
+            TIFFErrorExtR(tif, TIFFFileName(tif),
                          "No space for tile buffer");
             return((tmsize_t)(-1));
     }
@@ -1078,9 +1308,11 @@ _TIFFReadEncodedTileAndAllocBuffer(TIFF* tif, uint32 tile,
         size_to_read = tilesize;
     else if (size_to_read > tilesize)
         size_to_read = tilesize;
-    if( (*tif->tif_decodetile)(tif,
+    if (sparse)
+        return (size_to_read);
+    if( _TIFFCallDecode(tif, tif_decodetile,
         (uint8*) *buf, size_to_read, (uint16)(tile/td->td_stripsperimage))) {
-        (*tif->tif_postdecode)(tif, (uint8*) *buf, size_to_read);
+        _TIFFCallPostDecode(tif, (uint8*) *buf, size_to_read);
         return (size_to_read);
     } else
         return ((tmsize_t)(-1));
@@ -1089,17 +1321,16 @@ _TIFFReadEncodedTileAndAllocBuffer(TIFF* tif, uint32 tile,
 static tmsize_t
 TIFFReadRawTile1(TIFF* tif, uint32 tile, void* buf, tmsize_t size, const char* module)
 {
-	TIFFDirectory *td = &tif->tif_dir;
 
-    if (!_TIFFFillStriles( tif ))
+    if (!_TIFFHaveStriles(tif))
         return ((tmsize_t)(-1));
 
 	assert((tif->tif_flags&TIFF_NOREADRAW)==0);
 	if (!isMapped(tif)) {
 		tmsize_t cc;
 
-		if (!SeekOK(tif, td->td_stripoffset[tile])) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+		if (!SeekOK(tif, TIFFGetStrileOffset(tif, tile))) {
+			TIFFErrorExtR(tif, module,
 			    "Seek error at row %lu, col %lu, tile %lu",
 			    (unsigned long) tif->tif_row,
 			    (unsigned long) tif->tif_col,
@@ -1109,14 +1340,14 @@ TIFFReadRawTile1(TIFF* tif, uint32 tile, void* buf, tmsize_t size, const char* m
 		cc = TIFFReadFile(tif, buf, size);
 		if (cc != size) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 	"Read error at row %lu, col %lu; got %I64u bytes, expected %I64u",
 				     (unsigned long) tif->tif_row,
 				     (unsigned long) tif->tif_col,
 				     (unsigned __int64) cc,
 				     (unsigned __int64) size);
 #else
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 	"Read error at row %lu, col %lu; got %llu bytes, expected %llu",
 				     (unsigned long) tif->tif_row,
 				     (unsigned long) tif->tif_col,
@@ -1128,9 +1359,9 @@ TIFFReadRawTile1(TIFF* tif, uint32 tile, void* buf, tmsize_t size, const char* m
 	} else {
 		tmsize_t ma,mb;
 		tmsize_t n;
-		ma=(tmsize_t)td->td_stripoffset[tile];
+		ma=(tmsize_t)TIFFGetStrileOffset(tif, tile);
 		mb=ma+size;
-		if ((td->td_stripoffset[tile] > (uint64)TIFF_TMSIZE_T_MAX)||(ma>tif->tif_size))
+		if ((TIFFGetStrileOffset(tif, tile) > (uint64)TIFF_TMSIZE_T_MAX)||(ma>tif->tif_size))
 			n=0;
 		else if ((mb<ma)||(mb<size)||(mb>tif->tif_size))
 			n=tif->tif_size-ma;
@@ -1138,7 +1369,7 @@ TIFFReadRawTile1(TIFF* tif, uint32 tile, void* buf, tmsize_t size, const char* m
 			n=size;
 		if (n!=size) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 "Read error at row %lu, col %lu, tile %lu; got %I64u bytes, expected %I64u",
 				     (unsigned long) tif->tif_row,
 				     (unsigned long) tif->tif_col,
@@ -1146,7 +1377,7 @@ TIFFReadRawTile1(TIFF* tif, uint32 tile, void* buf, tmsize_t size, const char* m
 				     (unsigned __int64) n,
 				     (unsigned __int64) size);
 #else
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 "Read error at row %lu, col %lu, tile %lu; got %llu bytes, expected %llu",
 				     (unsigned long) tif->tif_row,
 				     (unsigned long) tif->tif_col,
@@ -1175,53 +1406,703 @@ TIFFReadRawTile(TIFF* tif, uint32 tile, void* buf, tmsize_t size)
 	if (!TIFFCheckRead(tif, 1))
 		return ((tmsize_t)(-1));
 	if (tile >= td->td_nstrips) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "%lu: Tile out of range, max %lu",
 		    (unsigned long) tile, (unsigned long) td->td_nstrips);
 		return ((tmsize_t)(-1));
 	}
 	if (tif->tif_flags&TIFF_NOREADRAW)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		"Compression scheme does not support access to raw uncompressed data");
 		return ((tmsize_t)(-1));
 	}
-	bytecount64 = td->td_stripbytecount[tile];
+	bytecount64 = TIFFGetStrileByteCount(tif, tile);
 	if (size != (tmsize_t)(-1) && (uint64)size < bytecount64)
 		bytecount64 = (uint64)size;
 	bytecountm = (tmsize_t)bytecount64;
 	if ((uint64)bytecountm!=bytecount64)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Integer overflow");
+		TIFFErrorExtR(tif,module,"Integer overflow");
 		return ((tmsize_t)(-1));
 	}
 	return (TIFFReadRawTile1(tif, tile, buf, bytecountm, module));
 }
 
 /*
- * Read the specified tile and setup for decoding. The data buffer is
- * expanded, as necessary, to hold the tile's data.
+ * Return a pointer to the raw (undecoded) data of a strip or tile
+ * inside the memory-mapped file image, avoiding the copy done by
+ * TIFFReadRawStrip() and TIFFReadRawTile().  The pointer remains
+ * valid until the file is closed and must not be written through.
+ * Returns 0 if the file is not memory-mapped (callers may then fall
+ * back to the copying interfaces) or if the chunk is invalid.
  */
+static int
+TIFFGetMappedRawChunk(TIFF* tif, uint32 strile, int tiles,
+    const void** ptr, tmsize_t* size, const char* module)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	uint64 offset, bytecount;
+
+	if (!TIFFCheckRead(tif, tiles))
+		return (0);
+	if (!isMapped(tif))
+		return (0);
+	if (!_TIFFHaveStriles(tif))
+		return (0);
+	if (strile >= td->td_nstrips) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: %s out of range, max %lu", (unsigned long) strile,
+		    tiles ? "Tile" : "Strip", (unsigned long) td->td_nstrips);
+		return (0);
+	}
+	offset = TIFFGetStrileOffset(tif, strile);
+	bytecount = TIFFGetStrileByteCount(tif, strile);
+	if ((int64)bytecount <= 0 || bytecount > (uint64)tif->tif_size ||
+	    offset > (uint64)tif->tif_size - bytecount) {
+		TIFFErrorExtR(tif, module,
+		    "Invalid offset or byte count, %s %lu",
+		    tiles ? "tile" : "strip", (unsigned long) strile);
+		return (0);
+	}
+	*ptr = tif->tif_base + (tmsize_t)offset;
+	*size = (tmsize_t)bytecount;
+	return (1);
+}
+
 int
-TIFFFillTile(TIFF* tif, uint32 tile)
+TIFFGetMappedRawStrip(TIFF* tif, uint32 strip, const void** ptr, tmsize_t* size)
+{
+	static const char module[] = "TIFFGetMappedRawStrip";
+
+	return (TIFFGetMappedRawChunk(tif, strip, 0, ptr, size, module));
+}
+
+int
+TIFFGetMappedRawTile(TIFF* tif, uint32 tile, const void** ptr, tmsize_t* size)
+{
+	static const char module[] = "TIFFGetMappedRawTile";
+
+	return (TIFFGetMappedRawChunk(tif, tile, 1, ptr, size, module));
+}
+
+/*
+ * Split-phase reading: TIFFGetStripInfo() and TIFFGetTileInfo() tell
+ * where the raw bytes of a chunk are and how large it is decoded, without
+ * doing any i/o beyond loading the strile arrays.  The caller fetches the
+ * bytes however it likes (asynchronously, from a cache, ...) and decodes
+ * them with TIFFReadEncodedStripFromBuffer() or
+ * TIFFReadEncodedTileFromBuffer(), which do no i/o at all.  Decoding
+ * uses the codec state of the handle; handles from TIFFCloneForThread()
+ * let several threads decode chunks of one directory at the same time.
+ */
+static int
+TIFFGetChunkInfo(TIFF* tif, uint32 strile, int tiles, TIFFChunkInfo* info,
+    const char* module)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	int err = 0;
+
+	if (!TIFFCheckRead(tif, tiles))
+		return (0);
+	if (strile >= td->td_nstrips) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: %s out of range, max %lu", (unsigned long) strile,
+		    tiles ? "Tile" : "Strip", (unsigned long) td->td_nstrips);
+		return (0);
+	}
+	info->offset = TIFFGetStrileOffsetWithErr(tif, strile, &err);
+	if (!err)
+		info->bytecount = TIFFGetStrileByteCountWithErr(tif, strile, &err);
+	if (err)
+		return (0);
+	info->compression = td->td_compression;
+	info->size = tiles ? TIFFTileSize(tif) :
+	    TIFFReadEncodedStripGetStripSize(tif, strile, NULL);
+	return (info->size > 0);
+}
+
+int
+TIFFGetStripInfo(TIFF* tif, uint32 strip, TIFFChunkInfo* info)
+{
+	static const char module[] = "TIFFGetStripInfo";
+
+	return (TIFFGetChunkInfo(tif, strip, 0, info, module));
+}
+
+int
+TIFFGetTileInfo(TIFF* tif, uint32 tile, TIFFChunkInfo* info)
+{
+	static const char module[] = "TIFFGetTileInfo";
+
+	return (TIFFGetChunkInfo(tif, tile, 1, info, module));
+}
+
+/*
+ * Decode raw bytes fetched by the caller into buf, as
+ * TIFFReadEncodedStrip() and TIFFReadEncodedTile() would after reading
+ * them.  The raw buffer is bit reversed in place for files whose
+ * FillOrder requires it.
+ */
+tmsize_t
+TIFFReadEncodedStripFromBuffer(TIFF* tif, uint32 strip, void* raw,
+    tmsize_t rawsize, void* buf, tmsize_t size)
+{
+	if (!TIFFCheckRead(tif, 0))
+		return ((tmsize_t)(-1));
+	return (_TIFFReadEncodedChunkFromBuffer(tif, strip, raw, rawsize,
+	    buf, size));
+}
+
+tmsize_t
+TIFFReadEncodedTileFromBuffer(TIFF* tif, uint32 tile, void* raw,
+    tmsize_t rawsize, void* buf, tmsize_t size)
+{
+	if (!TIFFCheckRead(tif, 1))
+		return ((tmsize_t)(-1));
+	return (_TIFFReadEncodedChunkFromBuffer(tif, tile, raw, rawsize,
+	    buf, size));
+}
+
+/*
+ * Read the raw data of a set of strips or tiles.  The requests are
+ * sorted by file offset and byte ranges that are contiguous, or
+ * separated by at most maxgap bytes, are fetched with a single read
+ * (up to RAWCHUNK_MAX_MERGE bytes at a time), which greatly reduces
+ * the number of I/O operations when neighbouring chunks are read
+ * from slow or remote storage.  On input sizes[i] is the size of
+ * bufs[i] (or -1 to read the whole chunk); on output it holds the
+ * number of bytes stored.  A negative maxgap selects a default gap.
+ * Returns 1 on success and 0 if any chunk could not be read.
+ *
+ * If the handle has a batched read method, up to RAWCHUNK_MAX_BATCH
+ * ranges are handed to it at once instead, so that it may have them
+ * all in flight together.
+ */
+#define RAWCHUNK_DEFAULT_GAP (16 * 1024)
+#define RAWCHUNK_MAX_MERGE (16 * 1024 * 1024)
+#define RAWCHUNK_MAX_BATCH 64
+
+typedef struct {
+	uint64   offset;
+	tmsize_t size;
+	uint32   index;
+} TIFFRawChunkRequest;
+
+static int
+TIFFRawChunkCompare(const void* a, const void* b)
+{
+	const TIFFRawChunkRequest* ra = (const TIFFRawChunkRequest*) a;
+	const TIFFRawChunkRequest* rb = (const TIFFRawChunkRequest*) b;
+
+	if (ra->offset != rb->offset)
+		return (ra->offset < rb->offset ? -1 : 1);
+	return (ra->index < rb->index ? -1 : ra->index > rb->index);
+}
+
+/*
+ * Return the end of the range of sorted requests starting at reqs[i],
+ * extended with the following requests while the gap and the total
+ * length stay small enough, and store its end offset in *pend.
+ */
+static uint32
+TIFFRawChunkRange(const TIFFRawChunkRequest* reqs, uint32 i, uint32 nchunks,
+    tmsize_t maxgap, uint64* pend)
+{
+	uint64 start = reqs[i].offset;
+	uint64 end = start + (uint64)reqs[i].size;
+	uint32 j;
+
+	for (j = i + 1; j < nchunks; j++) {
+		uint64 chunkend = reqs[j].offset + (uint64)reqs[j].size;
+
+		if (reqs[j].offset > end + (uint64)maxgap ||
+		    TIFFmax(end, chunkend) - start > RAWCHUNK_MAX_MERGE)
+			break;
+		if (chunkend > end)
+			end = chunkend;
+	}
+	*pend = end;
+	return (j);
+}
+
+/*
+ * Read the sorted requests through the batched read method.  Ranges of
+ * a single chunk go straight into its buffer and merged ranges into
+ * one shared buffer, so a batch ends when it has RAWCHUNK_MAX_BATCH
+ * ranges or its merged ranges would exceed RAWCHUNK_MAX_MERGE bytes.
+ */
+static int
+TIFFReadRawChunksBatch(TIFF* tif, const uint32* chunks,
+    const TIFFRawChunkRequest* reqs, uint32 nchunks, void** bufs,
+    tmsize_t* sizes, tmsize_t maxgap, const char* module)
+{
+	TIFFIORequest ios[RAWCHUNK_MAX_BATCH];
+	uint32 first[RAWCHUNK_MAX_BATCH + 1];
+	uint8* merged = NULL;
+	tmsize_t mergedsize = 0;
+	uint32 i, j, k, n, r;
+	int ret = 0;
+
+	for (i = 0; i < nchunks; i = first[n]) {
+		tmsize_t used = 0;
+		uint64 end;
+
+		/* Collect the ranges of the batch */
+		for (n = 0, k = i; k < nchunks && n < RAWCHUNK_MAX_BATCH; n++) {
+			j = TIFFRawChunkRange(reqs, k, nchunks, maxgap, &end);
+			ios[n].offset = reqs[k].offset;
+			ios[n].size = (tmsize_t)(end - reqs[k].offset);
+			ios[n].result = -1;
+			if (j != k + 1) {
+				if (n > 0 && used + ios[n].size > RAWCHUNK_MAX_MERGE)
+					break;
+				used += ios[n].size;
+			}
+			first[n] = k;
+			k = j;
+		}
+		first[n] = k;
+		if (used > mergedsize) {
+			uint8* p = (uint8*) _TIFFreallocExt(tif, merged, used);
+			if (p == NULL) {
+				TIFFErrorExtR(tif, module,
+				    "No space for raw data buffer");
+				goto done;
+			}
+			merged = p;
+			mergedsize = used;
+		}
+		used = 0;
+		for (r = 0; r < n; r++) {
+			if (first[r + 1] == first[r] + 1)
+				ios[r].buf = bufs[reqs[first[r]].index];
+			else {
+				ios[r].buf = merged + used;
+				used += ios[r].size;
+			}
+		}
+
+		TIFFStatsAdd(tif, readcalls, 1);
+		if (!(*tif->tif_readbatchproc)(tif->tif_clientdata, ios, n))
+			r = 0;
+		else
+			for (r = 0; r < n && ios[r].result == ios[r].size; r++)
+				;
+		if (r < n) {
+			TIFFErrorExtR(tif, module,
+			    "Read error at strip/tile %lu",
+			    (unsigned long) chunks[reqs[first[r]].index]);
+			goto done;
+		}
+		for (r = 0; r < n; r++) {
+			TIFFStatsAdd(tif, readbytes, (uint64) ios[r].size);
+			for (k = first[r]; k < first[r + 1]; k++) {
+				if (first[r + 1] != first[r] + 1)
+					_TIFFmemcpy(bufs[reqs[k].index],
+					    (uint8*) ios[r].buf +
+					    (tmsize_t)(reqs[k].offset - ios[r].offset),
+					    reqs[k].size);
+				sizes[reqs[k].index] = reqs[k].size;
+			}
+		}
+	}
+	ret = 1;
+
+done:
+	if (merged)
+		_TIFFfreeExt(tif, merged);
+	return (ret);
+}
+
+int
+TIFFReadRawChunks(TIFF* tif, const uint32* chunks, uint32 nchunks,
+    void** bufs, tmsize_t* sizes, tmsize_t maxgap)
+{
+	static const char module[] = "TIFFReadRawChunks";
+	TIFFDirectory *td = &tif->tif_dir;
+	TIFFRawChunkRequest* reqs;
+	uint8* merged = NULL;
+	tmsize_t mergedsize = 0;
+	uint32 i, j, k;
+	int ret = 0;
+
+	if (tif->tif_mode == O_WRONLY) {
+		TIFFErrorExtR(tif, tif->tif_name, "File not open for reading");
+		return (0);
+	}
+	if (tif->tif_flags&TIFF_NOREADRAW)
+	{
+		TIFFErrorExtR(tif, module,
+		    "Compression scheme does not support access to raw uncompressed data");
+		return (0);
+	}
+	if (nchunks == 0)
+		return (1);
+	if (!_TIFFHaveStriles(tif))
+		return (0);
+	if (maxgap < 0)
+		maxgap = RAWCHUNK_DEFAULT_GAP;
+	else if (maxgap > RAWCHUNK_MAX_MERGE)
+		maxgap = RAWCHUNK_MAX_MERGE;
+
+	reqs = (TIFFRawChunkRequest*) _TIFFCheckMalloc(tif, nchunks,
+	    sizeof(TIFFRawChunkRequest), "for raw chunk requests");
+	if (reqs == NULL)
+		return (0);
+	for (i = 0; i < nchunks; i++) {
+		uint32 chunk = chunks[i];
+		uint64 bytecount;
+
+		if (chunk >= td->td_nstrips) {
+			TIFFErrorExtR(tif, module,
+			    "%lu: Strip/tile out of range, max %lu",
+			    (unsigned long) chunk, (unsigned long) td->td_nstrips);
+			goto done;
+		}
+		bytecount = TIFFGetStrileByteCount(tif, chunk);
+		if ((int64)bytecount <= 0 ||
+		    (uint64)(tmsize_t)bytecount != bytecount ||
+		    TIFFGetStrileOffset(tif, chunk) > ((uint64)(-1)) / 2) {
+			TIFFErrorExtR(tif, module,
+			    "Invalid byte count, strip/tile %lu",
+			    (unsigned long) chunk);
+			goto done;
+		}
+		reqs[i].offset = TIFFGetStrileOffset(tif, chunk);
+		reqs[i].size = (tmsize_t)bytecount;
+		if (sizes[i] != (tmsize_t)(-1) && sizes[i] < reqs[i].size)
+			reqs[i].size = sizes[i];
+		reqs[i].index = i;
+	}
+
+	/* Memory-mapped data needs no merging: just copy out of the map,
+	   after asking for all of it to be paged in */
+	if (isMapped(tif)) {
+		for (i = 0; i < nchunks; i++)
+			if (reqs[i].offset < (uint64)tif->tif_size)
+				TIFFAdviseMapping(tif, reqs[i].offset,
+				    TIFFmin((uint64)reqs[i].size,
+				    (uint64)tif->tif_size - reqs[i].offset), 1);
+		for (i = 0; i < nchunks; i++) {
+			if (TIFFReadRawStrip1(tif, chunks[i], bufs[i],
+			    reqs[i].size, module) != reqs[i].size)
+				goto done;
+			sizes[i] = reqs[i].size;
+		}
+		ret = 1;
+		goto done;
+	}
+
+	qsort(reqs, nchunks, sizeof(TIFFRawChunkRequest), TIFFRawChunkCompare);
+	/* The batched reads bypass TIFFReadFile() */
+	if (!_TIFFWriteBufferFlush(tif))
+		goto done;
+	if (tif->tif_readbatchproc != NULL) {
+		ret = TIFFReadRawChunksBatch(tif, chunks, reqs, nchunks,
+		    bufs, sizes, maxgap, module);
+		goto done;
+	}
+	for (i = 0; i < nchunks; i = j) {
+		uint64 start = reqs[i].offset;
+		uint64 end;
+		tmsize_t length, cc;
+
+		j = TIFFRawChunkRange(reqs, i, nchunks, maxgap, &end);
+		length = (tmsize_t)(end - start);
+
+		if (!SeekOK(tif, start)) {
+			TIFFErrorExtR(tif, module,
+			    "Seek error at strip/tile %lu",
+			    (unsigned long) chunks[reqs[i].index]);
+			goto done;
+		}
+		if (j == i + 1) {
+			/* A single chunk is read straight into its buffer */
+			cc = TIFFReadFile(tif, bufs[reqs[i].index], length);
+		} else {
+			if (length > mergedsize) {
+				uint8* p = (uint8*) _TIFFreallocExt(tif, merged, length);
+				if (p == NULL) {
+					TIFFErrorExtR(tif, module,
+					    "No space for raw data buffer");
+					goto done;
+				}
+				merged = p;
+				mergedsize = length;
+			}
+			cc = TIFFReadFile(tif, merged, length);
+		}
+		if (cc != length) {
+			TIFFErrorExtR(tif, module,
+			    "Read error at strip/tile %lu",
+			    (unsigned long) chunks[reqs[i].index]);
+			goto done;
+		}
+		for (k = i; k < j; k++) {
+			if (j != i + 1)
+				_TIFFmemcpy(bufs[reqs[k].index],
+				    merged + (tmsize_t)(reqs[k].offset - start),
+				    reqs[k].size);
+			sizes[reqs[k].index] = reqs[k].size;
+		}
+	}
+	ret = 1;
+
+done:
+	if (merged)
+		_TIFFfreeExt(tif, merged);
+	_TIFFfreeExt(tif, reqs);
+	return (ret);
+}
+
+/*
+ * Region-oriented Read Support.
+ */
+
+/*
+ * Return the size in bytes of one pixel of the data returned by
+ * TIFFReadRegion(), or 0 if the layout is not supported.  Only
+ * byte-aligned samples are handled, and the decoded rows must not be
+ * subsampled, so that every column starts at a byte boundary.
+ */
+static tmsize_t
+TIFFRegionPixelSize(TIFF* tif, uint16 sample, const char* module)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	uint64 pixsize, rowsize, width;
+
+	if (td->td_bitspersample == 0 || (td->td_bitspersample % 8) != 0) {
+		TIFFErrorExtR(tif, module,
+		    "Region reads require a multiple of 8 bits per sample, got %d",
+		    td->td_bitspersample);
+		return (0);
+	}
+	pixsize = td->td_bitspersample / 8;
+	if (td->td_planarconfig == PLANARCONFIG_CONTIG)
+		pixsize *= td->td_samplesperpixel;
+	else if (sample >= td->td_samplesperpixel) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: Sample out of range, max %lu",
+		    (unsigned long) sample, (unsigned long) td->td_samplesperpixel);
+		return (0);
+	}
+	if (isTiled(tif)) {
+		rowsize = TIFFTileRowSize64(tif);
+		width = td->td_tilewidth;
+	} else {
+		rowsize = TIFFScanlineSize64(tif);
+		width = td->td_imagewidth;
+	}
+	if (rowsize == 0 || rowsize != width * pixsize) {
+		TIFFErrorExtR(tif, module,
+		    "Region reads are not supported for subsampled data");
+		return (0);
+	}
+	return ((tmsize_t) pixsize);
+}
+
+static int
+TIFFReadRegionTiles(TIFF* tif, uint32 x, uint32 y, uint32 w, uint32 h,
+    uint16 sample, uint8* buf, tmsize_t stride, tmsize_t pixsize)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	tmsize_t rowsize = TIFFTileRowSize(tif);
+	uint32 tw = td->td_tilewidth, tl = td->td_tilelength;
+	uint32 row, col, r;
+	uint8* scratch;
+	int cached = tif->tif_chunkcache != NULL;
+	int ret = 0;
+
+	scratch = (uint8*) _TIFFmallocExt(tif, tif->tif_tilesize);
+	if (scratch == NULL) {
+		TIFFErrorExtR(tif, "TIFFReadRegion",
+		    "No space for tile buffer");
+		return (0);
+	}
+	for (row = y / tl; row <= (y + h - 1) / tl; row++) {
+		uint32 ty = row * tl;
+		uint32 r0 = ty < y ? y - ty : 0;
+		uint32 r1 = y + h - ty < tl ? y + h - ty : tl;
+
+		for (col = x / tw; col <= (x + w - 1) / tw; col++) {
+			uint32 tx = col * tw;
+			uint32 c0 = tx < x ? x - tx : 0;
+			uint32 c1 = x + w - tx < tw ? x + w - tx : tw;
+			uint8* dst = buf + (tmsize_t)(ty + r0 - y) * stride +
+			    (tmsize_t)(tx + c0 - x) * pixsize;
+
+			/*
+			 * Only decode the tile rows that the region covers,
+			 * unless the whole tile goes into the chunk cache
+			 */
+			if (TIFFReadEncodedTile(tif,
+			    TIFFComputeTile(tif, tx, ty, 0, sample), scratch,
+			    cached ? (tmsize_t)(-1) : (tmsize_t) r1 * rowsize)
+			    == (tmsize_t)(-1))
+				goto done;
+			for (r = r0; r < r1; r++, dst += stride)
+				_TIFFmemcpy(dst, scratch + (tmsize_t) r * rowsize +
+				    (tmsize_t) c0 * pixsize,
+				    (tmsize_t)(c1 - c0) * pixsize);
+		}
+	}
+	ret = 1;
+done:
+	_TIFFfreeExt(tif, scratch);
+	return (ret);
+}
+
+static int
+TIFFReadRegionStrips(TIFF* tif, uint32 x, uint32 y, uint32 w, uint32 h,
+    uint16 sample, uint8* buf, tmsize_t stride, tmsize_t pixsize)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	tmsize_t scanline = TIFFScanlineSize(tif);
+	uint32 rps = td->td_rowsperstrip;
+	int canseek = tif->tif_seek != _TIFFNoSeek;
+	int cached = tif->tif_chunkcache != NULL;
+	uint32 s, r;
+	uint8* scratch = NULL;
+	int ret = 0;
+
+	if (rps > td->td_imagelength)
+		rps = td->td_imagelength;
+	for (s = y / rps; s <= (y + h - 1) / rps; s++) {
+		uint32 sy = s * rps;
+		uint32 r0 = sy < y ? y - sy : 0;
+		uint32 r1 = y + h - sy < rps ? y + h - sy : rps;
+		uint32 strip = TIFFComputeStrip(tif, sy, sample);
+		uint8* dst = buf + (tmsize_t)(sy + r0 - y) * stride;
+
+		/* Strips are decoded whole into the chunk cache, if any */
+		if (!cached && r0 == 0 && x == 0 && w == td->td_imagewidth &&
+		    stride == scanline) {
+			/* Whole rows: decode straight into the caller's buffer */
+			if (TIFFReadEncodedStrip(tif, strip, dst,
+			    (tmsize_t) r1 * scanline) == (tmsize_t)(-1))
+				goto done;
+			continue;
+		}
+		if (scratch == NULL) {
+			scratch = (uint8*) _TIFFmallocExt(tif, TIFFStripSize(tif));
+			if (scratch == NULL) {
+				TIFFErrorExtR(tif, "TIFFReadRegion",
+				    "No space for strip buffer");
+				goto done;
+			}
+		}
+		if (r0 > 0 && canseek && !cached) {
+			/*
+			 * The codec can skip rows, so let the scanline
+			 * machinery read and decode only rows r0..r1-1.
+			 * Force a restart in case the decoder state was left
+			 * behind by a strip read.
+			 */
+			tif->tif_curstrip = NOSTRIP;
+			for (r = r0; r < r1; r++, dst += stride) {
+				if (TIFFReadScanline(tif, scratch, sy + r,
+				    sample) == -1)
+					goto done;
+				_TIFFmemcpy(dst, scratch + (tmsize_t) x * pixsize,
+				    (tmsize_t) w * pixsize);
+			}
+		} else {
+			/* Decode the strip up to the last row needed */
+			if (TIFFReadEncodedStrip(tif, strip, scratch,
+			    cached ? (tmsize_t)(-1) : (tmsize_t) r1 * scanline)
+			    == (tmsize_t)(-1))
+				goto done;
+			for (r = r0; r < r1; r++, dst += stride)
+				_TIFFmemcpy(dst, scratch + (tmsize_t) r * scanline +
+				    (tmsize_t) x * pixsize, (tmsize_t) w * pixsize);
+		}
+	}
+	ret = 1;
+done:
+	if (scratch)
+		_TIFFfreeExt(tif, scratch);
+	return (ret);
+}
+
+/*
+ * Read and decode the w x h pixel rectangle whose upper-left corner is
+ * at (x,y) into buf, storing consecutive rows stride bytes apart (0
+ * packs the rows).  For PlanarConfiguration=2 only the given sample
+ * plane is returned; for tiled images only the first slice is read.
+ * Each strip or tile that intersects the region is decoded once and
+ * only up to its last row inside the region; rows that precede the
+ * region in a strip are skipped without decoding when the codec
+ * supports it.  With a chunk cache, whole strips and tiles are decoded
+ * so that they can be cached.  Returns 1 on success and 0 on error.
+ */
+int
+TIFFReadRegion(TIFF* tif, uint32 x, uint32 y, uint32 w, uint32 h,
+    uint16 sample, void* buf, tmsize_t stride)
+{
+	static const char module[] = "TIFFReadRegion";
+	TIFFDirectory *td = &tif->tif_dir;
+	tmsize_t pixsize;
+	uint64 rowbytes;
+
+	if (!TIFFCheckRead(tif, isTiled(tif)))
+		return (0);
+	if (w == 0 || h == 0 || x >= td->td_imagewidth ||
+	    w > td->td_imagewidth - x || y >= td->td_imagelength ||
+	    h > td->td_imagelength - y) {
+		TIFFErrorExtR(tif, module,
+		    "Region %lux%lu at %lu,%lu is outside the %lux%lu image",
+		    (unsigned long) w, (unsigned long) h,
+		    (unsigned long) x, (unsigned long) y,
+		    (unsigned long) td->td_imagewidth,
+		    (unsigned long) td->td_imagelength);
+		return (0);
+	}
+	if ((pixsize = TIFFRegionPixelSize(tif, sample, module)) == 0)
+		return (0);
+	rowbytes = (uint64) w * pixsize;
+	if ((uint64)(tmsize_t) rowbytes != rowbytes) {
+		TIFFErrorExtR(tif, module, "Integer overflow");
+		return (0);
+	}
+	if (stride == 0)
+		stride = (tmsize_t) rowbytes;
+	else if (stride < (tmsize_t) rowbytes) {
+		TIFFErrorExtR(tif, module,
+		    "Row stride %ld is smaller than the region row size",
+		    (long) stride);
+		return (0);
+	}
+	if (isTiled(tif))
+		return (TIFFReadRegionTiles(tif, x, y, w, h, sample,
+		    (uint8*) buf, stride, pixsize));
+	return (TIFFReadRegionStrips(tif, x, y, w, h, sample,
+	    (uint8*) buf, stride, pixsize));
+}
+
+/*
+ * TIFFFillTile() without the trace events.
+ */
+static int
+TIFFFillTile1(TIFF* tif, uint32 tile)
 {
 	static const char module[] = "TIFFFillTile";
 	TIFFDirectory *td = &tif->tif_dir;
 
-        if (!_TIFFFillStriles( tif ) || !tif->tif_dir.td_stripbytecount)
+        if (!_TIFFHaveStriles(tif))
             return 0;
 
 	if ((tif->tif_flags&TIFF_NOREADRAW)==0)
 	{
-		uint64 bytecount = td->td_stripbytecount[tile];
+		uint64 bytecount = TIFFGetStrileByteCount(tif, tile);
 		if ((int64)bytecount <= 0) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				"%I64u: Invalid tile byte count, tile %lu",
 				     (unsigned __int64) bytecount,
 				     (unsigned long) tile);
 #else
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 				"%llu: Invalid tile byte count, tile %lu",
 				     (unsigned long long) bytecount,
 				     (unsigned long) tile);
@@ -1244,13 +2125,13 @@ TIFFFillTile(TIFF* tif, uint32 tile)
 				if( (int64)newbytecount >= 0 )
 				{
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-					TIFFWarningExt(tif->tif_clientdata, module,
+					TIFFWarningExtR(tif, module,
 					  "Too large tile byte count %I64u, tile %lu. Limiting to %I64u",
 					     (unsigned __int64) bytecount,
 					     (unsigned long) tile,
 					     (unsigned __int64) newbytecount);
 #else
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					  "Too large tile byte count %llu, tile %lu. Limiting to %llu",
 					     (unsigned long long) bytecount,
 					     (unsigned long) tile,
@@ -1266,16 +2147,18 @@ TIFFFillTile(TIFF* tif, uint32 tile)
 			 * We must check for overflow, potentially causing
 			 * an OOB read. Instead of simple
 			 *
-			 *  td->td_stripoffset[tile]+bytecount > tif->tif_size
+			 *  TIFFGetStrileOffset(tif, tile)+bytecount > tif->tif_size
 			 *
 			 * comparison (which can overflow) we do the following
 			 * two comparisons:
 			 */
 			if (bytecount > (uint64)tif->tif_size ||
-			    td->td_stripoffset[tile] > (uint64)tif->tif_size - bytecount) {
+			    TIFFGetStrileOffset(tif, tile) > (uint64)tif->tif_size - bytecount) {
 				tif->tif_curtile = NOTILE;
 				return (0);
 			}
+			TIFFAdviseMapping(tif, TIFFGetStrileOffset(tif, tile),
+			    bytecount, 0);
 		}
 
 		if (isMapped(tif) &&
@@ -1293,7 +2176,7 @@ TIFFFillTile(TIFF* tif, uint32 tile)
 			 * fault since the file is mapped read-only).
 			 */
 			if ((tif->tif_flags & TIFF_MYBUFFER) && tif->tif_rawdata) {
-				_TIFFfree(tif->tif_rawdata);
+				_TIFFfreeExt(tif, tif->tif_rawdata);
 				tif->tif_rawdata = NULL;
 				tif->tif_rawdatasize = 0;
 			}
@@ -1301,7 +2184,7 @@ TIFFFillTile(TIFF* tif, uint32 tile)
 
 			tif->tif_rawdatasize = (tmsize_t)bytecount;
 			tif->tif_rawdata =
-				tif->tif_base + (tmsize_t)td->td_stripoffset[tile];
+				tif->tif_base + (tmsize_t)TIFFGetStrileOffset(tif, tile);
                         tif->tif_rawdataoff = 0;
                         tif->tif_rawdataloaded = (tmsize_t) bytecount;
 			tif->tif_flags |= TIFF_BUFFERMMAP;
@@ -1315,13 +2198,13 @@ TIFFFillTile(TIFF* tif, uint32 tile)
 			bytecountm=(tmsize_t)bytecount;
 			if ((uint64)bytecountm!=bytecount)
 			{
-				TIFFErrorExt(tif->tif_clientdata,module,"Integer overflow");
+				TIFFErrorExtR(tif,module,"Integer overflow");
 				return(0);
 			}
 			if (bytecountm > tif->tif_rawdatasize) {
 				tif->tif_curtile = NOTILE;
 				if ((tif->tif_flags & TIFF_MYBUFFER) == 0) {
-					TIFFErrorExt(tif->tif_clientdata, module,
+					TIFFErrorExtR(tif, module,
 					    "Data buffer too small to hold tile %lu",
 					    (unsigned long) tile);
 					return (0);
@@ -1369,6 +2252,18 @@ TIFFFillTile(TIFF* tif, uint32 tile)
 	return (TIFFStartTile(tif, tile));
 }
 
+/*
+ * Read the specified tile and setup for decoding. The data buffer is
+ * expanded, as necessary, to hold the tile's data.
+ */
+int
+TIFFFillTile(TIFF* tif, uint32 tile)
+{
+	if (tif->tif_traceproc == NULL)
+		return (TIFFFillTile1(tif, tile));
+	return (TIFFFillTraced(tif, tile, TIFFFillTile1));
+}
+
 /*
  * Setup the raw data buffer in preparation for
  * reading a strip of raw data.  If the buffer
@@ -1388,7 +2283,7 @@ TIFFReadBufferSetup(TIFF* tif, void* bp, tmsize_t size)
 
 	if (tif->tif_rawdata) {
 		if (tif->tif_flags & TIFF_MYBUFFER)
-			_TIFFfree(tif->tif_rawdata);
+			_TIFFfreeExt(tif, tif->tif_rawdata);
 		tif->tif_rawdata = NULL;
 		tif->tif_rawdatasize = 0;
 	}
@@ -1399,17 +2294,18 @@ TIFFReadBufferSetup(TIFF* tif, void* bp, tmsize_t size)
 	} else {
 		tif->tif_rawdatasize = (tmsize_t)TIFFroundup_64((uint64)size, 1024);
 		if (tif->tif_rawdatasize==0) {
-		    TIFFErrorExt(tif->tif_clientdata, module,
+		    TIFFErrorExtR(tif, module,
 				 "Invalid buffer size");
 		    return (0);
 		}
 		/* Initialize to zero to avoid uninitialized buffers in case of */
                 /* short reads (http://bugzilla.maptools.org/show_bug.cgi?id=2651) */
-		tif->tif_rawdata = (uint8*) _TIFFcalloc(1, tif->tif_rawdatasize);
+		tif->tif_rawdata = (uint8*) _TIFFcallocExt(tif, 1, tif->tif_rawdatasize);
 		tif->tif_flags |= TIFF_MYBUFFER;
+		TIFFStatsAdd(tif, rawbufferallocs, 1);
 	}
 	if (tif->tif_rawdata == NULL) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "No space for data buffer at scanline %lu",
 		    (unsigned long) tif->tif_row);
 		tif->tif_rawdatasize = 0;
@@ -1427,7 +2323,7 @@ TIFFStartStrip(TIFF* tif, uint32 strip)
 {
 	TIFFDirectory *td = &tif->tif_dir;
 
-        if (!_TIFFFillStriles( tif ) || !tif->tif_dir.td_stripbytecount)
+        if (!_TIFFHaveStriles(tif))
             return 0;
 
 	if ((tif->tif_flags & TIFF_CODERSETUP) == 0) {
@@ -1450,8 +2346,9 @@ TIFFStartStrip(TIFF* tif, uint32 strip)
 		if( tif->tif_rawdataloaded > 0 )
 			tif->tif_rawcc = tif->tif_rawdataloaded;
 		else
-			tif->tif_rawcc = (tmsize_t)td->td_stripbytecount[strip];
+			tif->tif_rawcc = (tmsize_t)TIFFGetStrileByteCount(tif, strip);
 	}
+	TIFFStatsAdd(tif, stripsdecoded, 1);
 	return ((*tif->tif_predecode)(tif,
 			(uint16)(strip / td->td_stripsperimage)));
 }
@@ -1467,7 +2364,7 @@ TIFFStartTile(TIFF* tif, uint32 tile)
 	TIFFDirectory *td = &tif->tif_dir;
         uint32 howmany32;
 
-        if (!_TIFFFillStriles( tif ) || !tif->tif_dir.td_stripbytecount)
+        if (!_TIFFHaveStriles(tif))
                 return 0;
 
 	if ((tif->tif_flags & TIFF_CODERSETUP) == 0) {
@@ -1478,13 +2375,13 @@ TIFFStartTile(TIFF* tif, uint32 tile)
 	tif->tif_curtile = tile;
         howmany32=TIFFhowmany_32(td->td_imagewidth, td->td_tilewidth);
         if (howmany32 == 0) {
-                 TIFFErrorExt(tif->tif_clientdata,module,"Zero tiles");
+                 TIFFErrorExtR(tif,module,"Zero tiles");
                 return 0;
         }
 	tif->tif_row = (tile % howmany32) * td->td_tilelength;
         howmany32=TIFFhowmany_32(td->td_imagelength, td->td_tilelength);
         if (howmany32 == 0) {
-                TIFFErrorExt(tif->tif_clientdata,module,"Zero tiles");
+                TIFFErrorExtR(tif,module,"Zero tiles");
                 return 0;
         }
 	tif->tif_col = (tile % howmany32) * td->td_tilewidth;
@@ -1500,21 +2397,108 @@ TIFFStartTile(TIFF* tif, uint32 tile)
 		if( tif->tif_rawdataloaded > 0 )
 			tif->tif_rawcc = tif->tif_rawdataloaded;
 		else
-			tif->tif_rawcc = (tmsize_t)td->td_stripbytecount[tile];
+			tif->tif_rawcc = (tmsize_t)TIFFGetStrileByteCount(tif, tile);
 	}
+	TIFFStatsAdd(tif, tilesdecoded, 1);
 	return ((*tif->tif_predecode)(tif,
 			(uint16)(tile/td->td_stripsperimage)));
 }
 
+/*
+ * Decode a strip or tile whose raw (still compressed) bytes have
+ * already been fetched by the caller into inbuf.  The handle's own
+ * raw data buffer is left untouched, which lets several handles
+ * sharing one file descriptor decode concurrently while only the
+ * raw reads are serialized.  If bit reversal is required, inbuf is
+ * reversed in place, so it must be writable in that case.  Returns
+ * the number of decoded bytes, or -1 on error.
+ */
+tmsize_t
+_TIFFReadEncodedChunkFromBuffer(TIFF* tif, uint32 strile,
+                                void* inbuf, tmsize_t insize,
+                                void* outbuf, tmsize_t outsize)
+{
+	static const char module[] = "_TIFFReadEncodedChunkFromBuffer";
+	TIFFDirectory *td = &tif->tif_dir;
+	uint32 old_flags = tif->tif_flags;
+	tmsize_t old_rawdatasize = tif->tif_rawdatasize;
+	uint8* old_rawdata = tif->tif_rawdata;
+	tmsize_t chunksize;
+	uint16 plane;
+	int ok;
+
+	if (!TIFFCheckRead(tif, isTiled(tif)) || _TIFFCheckCancel(tif, module))
+		return ((tmsize_t)(-1));
+	if (tif->tif_flags&TIFF_NOREADRAW)
+	{
+		TIFFErrorExtR(tif, module,
+		"Compression scheme does not support access to raw uncompressed data");
+		return ((tmsize_t)(-1));
+	}
+	if (strile >= td->td_nstrips) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: Strip/tile out of range, max %lu",
+		    (unsigned long) strile, (unsigned long) td->td_nstrips);
+		return ((tmsize_t)(-1));
+	}
+	if (isTiled(tif)) {
+		chunksize = tif->tif_tilesize;
+		plane = (uint16)(strile/td->td_stripsperimage);
+	} else {
+		chunksize = TIFFReadEncodedStripGetStripSize(tif, strile, &plane);
+		if (chunksize == (tmsize_t)(-1))
+			return ((tmsize_t)(-1));
+	}
+	if (outsize != (tmsize_t)(-1) && outsize < chunksize)
+		chunksize = outsize;
+	if (insize == 0 && _TIFFIsSparseStrile(tif, strile))
+		return (TIFFReadSparse(outbuf, chunksize, chunksize));
+
+	tif->tif_flags &= ~TIFF_MYBUFFER;
+	tif->tif_flags |= TIFF_BUFFERMMAP;
+	tif->tif_rawdata = (uint8*) inbuf;
+	tif->tif_rawdatasize = insize;
+	tif->tif_rawdataoff = 0;
+	tif->tif_rawdataloaded = insize;
+
+	if (!isFillOrder(tif, td->td_fillorder) &&
+	    (tif->tif_flags & TIFF_NOBITREV) == 0)
+		TIFFReverseBits(inbuf, insize);
+
+	if (isTiled(tif))
+		ok = TIFFStartTile(tif, strile) &&
+		    _TIFFCallDecode(tif, tif_decodetile, (uint8*) outbuf,
+		    chunksize, plane);
+	else
+		ok = TIFFStartStrip(tif, strile) &&
+		    _TIFFCallDecode(tif, tif_decodestrip, (uint8*) outbuf,
+		    chunksize, plane) > 0;
+	if (ok)
+		_TIFFCallPostDecode(tif, (uint8*) outbuf, chunksize);
+
+	tif->tif_flags = (tif->tif_flags & ~(TIFF_MYBUFFER|TIFF_BUFFERMMAP)) |
+	    (old_flags & (TIFF_MYBUFFER|TIFF_BUFFERMMAP));
+	tif->tif_rawdata = old_rawdata;
+	tif->tif_rawdatasize = old_rawdatasize;
+	tif->tif_rawdataoff = 0;
+	tif->tif_rawdataloaded = 0;
+	tif->tif_rawcp = tif->tif_rawdata;
+	tif->tif_rawcc = 0;
+	tif->tif_curstrip = NOSTRIP;
+	tif->tif_curtile = NOTILE;
+
+	return (ok ? chunksize : (tmsize_t)(-1));
+}
+
 static int
 TIFFCheckRead(TIFF* tif, int tiles)
 {
 	if (tif->tif_mode == O_WRONLY) {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name, "File not open for reading");
+		TIFFErrorExtR(tif, tif->tif_name, "File not open for reading");
 		return (0);
 	}
 	if (tiles ^ isTiled(tif)) {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name, tiles ?
+		TIFFErrorExtR(tif, tif->tif_name, tiles ?
 		    "Can not read tiles from a stripped image" :
 		    "Can not read scanlines from a tiled image");
 		return (0);
@@ -1522,6 +2506,64 @@ TIFFCheckRead(TIFF* tif, int tiles)
 	return (1);
 }
 
+/*
+ * Return 1 if the strip or tile has a zero offset or byte count, as
+ * sparse files leave the ones that only hold zeros; they read as zeros
+ * without any I/O or decoding.
+ */
+int
+_TIFFIsSparseStrile(TIFF* tif, uint32 strile)
+{
+	int err = 0;
+
+	if ((tif->tif_flags&TIFF_NOREADRAW) || !_TIFFHaveStriles(tif))
+		return (0);
+	if (TIFFGetStrileByteCountWithErr(tif, strile, &err) == 0 && !err)
+		return (1);
+	return (!err && TIFFGetStrileOffsetWithErr(tif, strile, &err) == 0 &&
+	    !err);
+}
+
+/*
+ * Bit reverse and byte swap an uncompressed chunk read straight into
+ * the caller's buffer.  When both are needed they are done a batch at
+ * a time so that the data is only brought into cache once.
+ */
+static void
+TIFFUndoRawChunk(TIFF* tif, uint8* buf, tmsize_t size)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	tmsize_t n;
+
+	if (isFillOrder(tif, td->td_fillorder) ||
+	    (tif->tif_flags & TIFF_NOBITREV) != 0) {
+		_TIFFCallPostDecode(tif, buf, size);
+		return;
+	}
+	if (tif->tif_postdecode == _TIFFNoPostDecode) {
+		TIFFReverseBits(buf, size);
+		return;
+	}
+	for (; size > 0; size -= n, buf += n) {
+		n = size < TIFF_BATCH_SIZE ? size : TIFF_BATCH_SIZE;
+		TIFFReverseBits(buf, n);
+		_TIFFCallPostDecode(tif, buf, n);
+	}
+}
+
+/*
+ * Fill the size bytes asked for, up to chunksize, of a sparse strip
+ * or tile.
+ */
+static tmsize_t
+TIFFReadSparse(void* buf, tmsize_t size, tmsize_t chunksize)
+{
+	if (size == (tmsize_t)(-1) || size > chunksize)
+		size = chunksize;
+	_TIFFmemset(buf, 0, size);
+	return (size);
+}
+
 void
 _TIFFNoPostDecode(TIFF* tif, uint8* buf, tmsize_t cc)
 {
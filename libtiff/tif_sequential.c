@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library.
+ *
+ * Writing to outputs that cannot seek, such as pipes and sockets.
+ *
+ * TIFFOpenSequential() gives the library a seekable file whose start is
+ * passed on to the caller's write method as soon as it cannot change
+ * any more: the header and everything before a directory once that
+ * directory has been written.  The rest is kept in memory, or in a
+ * temporary file once it grows beyond a limit, and sent when the
+ * handle is closed.  The output of a multi-page file thus starts with
+ * the first page, and only one page at a time is held back.
+ */
+#include "tiffiop.h"
+#include <stdio.h>
+
+#define TIFF_SPILL_LIMIT_DEFAULT ((tmsize_t) 16 << 20)
+#define TIFF_SEQ_COPY         (64 * 1024)
+
+typedef struct {
+	thandle_t         clientdata;  /* of the caller's methods */
+	TIFFReadWriteProc writeproc;
+	TIFFCloseProc     closeproc;   /* or NULL */
+	uint64            sent;        /* bytes passed to writeproc */
+	uint64            size;        /* length of the file */
+	uint64            off;         /* current position */
+	uint8*            buf;         /* bytes from sent on, unless spilled */
+	tmsize_t          alloc;
+	FILE*             spill;       /* bytes from spilloff on, or NULL */
+	uint64            spilloff;
+	tmsize_t          limit;       /* bytes kept in memory, <0: no limit */
+	int               hold;        /* send nothing before closing */
+	int               failed;      /* writeproc or the spill file failed */
+} TIFFSeqFile;
+
+static int
+_tiffSeqGrow(TIFFSeqFile* s, tmsize_t size)
+{
+	tmsize_t alloc = s->alloc > 0 ? s->alloc : 64 * 1024;
+	uint8* buf;
+
+	while (alloc < size)
+		alloc = alloc > size / 2 ? size : alloc * 2;
+	buf = (uint8*) _TIFFrealloc(s->buf, alloc);
+	if (buf == NULL)
+		return (0);
+	s->buf = buf;
+	s->alloc = alloc;
+	return (1);
+}
+
+/*
+ * Move what is held in memory to a temporary file.
+ */
+static int
+_tiffSeqSpill(TIFFSeqFile* s)
+{
+	tmsize_t held = (tmsize_t)(s->size - s->sent);
+
+	s->spill = tmpfile();
+	if (s->spill == NULL)
+		return (0);
+	s->spilloff = s->sent;
+	if (held > 0 &&
+	    fwrite(s->buf, 1, (size_t) held, s->spill) != (size_t) held) {
+		fclose(s->spill);
+		s->spill = NULL;
+		return (0);
+	}
+	_TIFFfree(s->buf);
+	s->buf = NULL;
+	s->alloc = 0;
+	return (1);
+}
+
+/*
+ * Copy len bytes at file offset off to or from wherever they are held.
+ */
+static int
+_tiffSeqAccess(TIFFSeqFile* s, uint64 off, void* data, tmsize_t len,
+    int write)
+{
+	if (s->spill == NULL) {
+		uint8* p = s->buf + (off - s->sent);
+
+		if (write)
+			_TIFFmemcpy(p, data, len);
+		else
+			_TIFFmemcpy(data, p, len);
+		return (1);
+	}
+	if (_TIFF_fseek_f(s->spill, (_TIFF_off_t)(off - s->spilloff),
+	    SEEK_SET) != 0)
+		return (0);
+	if (write)
+		return (fwrite(data, 1, (size_t) len, s->spill) ==
+		    (size_t) len);
+	return (fread(data, 1, (size_t) len, s->spill) == (size_t) len);
+}
+
+/*
+ * Pass the file up to offset end on to the caller, and drop it.  Once
+ * little enough is left of a spilled file it is taken back into
+ * memory.
+ */
+static int
+_tiffSeqSend(TIFFSeqFile* s, uint64 end)
+{
+	uint8 copy[TIFF_SEQ_COPY];
+
+	if (s->failed)
+		return (0);
+	while (s->sent < end) {
+		tmsize_t n = (tmsize_t)(end - s->sent);
+		uint8* p;
+
+		if (s->spill != NULL) {
+			if (n > TIFF_SEQ_COPY)
+				n = TIFF_SEQ_COPY;
+			if (!_tiffSeqAccess(s, s->sent, copy, n, 0))
+				goto bad;
+			p = copy;
+		} else
+			p = s->buf;
+		if ((*s->writeproc)(s->clientdata, p, n) != n)
+			goto bad;
+		if (s->spill == NULL && s->size > s->sent + (uint64) n)
+			memmove(s->buf, s->buf + n,
+			    (size_t)(s->size - s->sent - (uint64) n));
+		s->sent += (uint64) n;
+	}
+	if (s->spill != NULL &&
+	    (s->limit < 0 || s->size - s->sent <= (uint64) s->limit / 2)) {
+		tmsize_t held = (tmsize_t)(s->size - s->sent);
+
+		if (held > 0 && !_tiffSeqGrow(s, held))
+			return (1);	/* stays spilled */
+		if (held > 0 && !_tiffSeqAccess(s, s->sent, s->buf, held, 0))
+			goto bad;
+		fclose(s->spill);
+		s->spill = NULL;
+	}
+	return (1);
+bad:
+	s->failed = 1;
+	return (0);
+}
+
+static tmsize_t
+_tiffSeqReadProc(thandle_t h, void* buf, tmsize_t size)
+{
+	TIFFSeqFile* s = (TIFFSeqFile*) h;
+
+	if (s->off < s->sent) {
+		TIFFErrorExt(s->clientdata, "TIFFOpenSequential",
+		    "Can not read back data that has been sent");
+		return (-1);
+	}
+	if (s->off >= s->size)
+		return (0);
+	if ((uint64) size > s->size - s->off)
+		size = (tmsize_t)(s->size - s->off);
+	if (!_tiffSeqAccess(s, s->off, buf, size, 0))
+		return (-1);
+	s->off += (uint64) size;
+	return (size);
+}
+
+static tmsize_t
+_tiffSeqWriteProc(thandle_t h, void* buf, tmsize_t size)
+{
+	TIFFSeqFile* s = (TIFFSeqFile*) h;
+	uint64 end = s->off + (uint64) size;
+
+	if (s->off < s->sent) {
+		TIFFErrorExt(s->clientdata, "TIFFOpenSequential",
+		    "Can not rewrite data that has been sent");
+		return (-1);
+	}
+	if (s->spill == NULL && s->limit >= 0 &&
+	    end - s->sent > (uint64) s->limit && !_tiffSeqSpill(s)) {
+		TIFFErrorExt(s->clientdata, "TIFFOpenSequential",
+		    "Can not create a temporary file");
+		return (-1);
+	}
+	if (s->spill == NULL) {
+		if ((uint64)(tmsize_t)(end - s->sent) != end - s->sent ||
+		    ((tmsize_t)(end - s->sent) > s->alloc &&
+		    !_tiffSeqGrow(s, (tmsize_t)(end - s->sent)))) {
+			TIFFErrorExt(s->clientdata, "TIFFOpenSequential",
+			    "Out of memory");
+			return (-1);
+		}
+		/* a seek beyond the end leaves a hole of zeros */
+		if (s->off > s->size)
+			_TIFFmemset(s->buf + (s->size - s->sent), 0,
+			    (tmsize_t)(s->off - s->size));
+	}
+	if (!_tiffSeqAccess(s, s->off, buf, size, 1)) {
+		TIFFErrorExt(s->clientdata, "TIFFOpenSequential",
+		    "Write error on the temporary file");
+		return (-1);
+	}
+	s->off = end;
+	if (end > s->size)
+		s->size = end;
+	return (size);
+}
+
+static uint64
+_tiffSeqSeekProc(thandle_t h, uint64 off, int whence)
+{
+	TIFFSeqFile* s = (TIFFSeqFile*) h;
+
+	switch (whence) {
+	case SEEK_CUR:
+		off += s->off;
+		break;
+	case SEEK_END:
+		off += s->size;
+		break;
+	}
+	s->off = off;
+	return (off);
+}
+
+static int
+_tiffSeqCloseProc(thandle_t h)
+{
+	TIFFSeqFile* s = (TIFFSeqFile*) h;
+	int ret;
+
+	s->hold = 0;
+	ret = _tiffSeqSend(s, s->size) ? 0 : -1;
+	if (ret != 0)
+		TIFFErrorExt(s->clientdata, "TIFFOpenSequential",
+		    "Write error on the stream");
+	if (s->spill != NULL)
+		fclose(s->spill);
+	_TIFFfree(s->buf);
+	if (s->closeproc != NULL && (*s->closeproc)(s->clientdata) != 0)
+		ret = -1;
+	_TIFFfree(s);
+	return (ret);
+}
+
+static uint64
+_tiffSeqSizeProc(thandle_t h)
+{
+	return (((TIFFSeqFile*) h)->size);
+}
+
+static int
+_tiffSeqMapProc(thandle_t h, void** pbase, toff_t* psize)
+{
+	(void) h; (void) pbase; (void) psize;
+	return (0);
+}
+
+static void
+_tiffSeqUnmapProc(thandle_t h, void* base, toff_t size)
+{
+	(void) h; (void) base; (void) size;
+}
+
+/*
+ * Open a TIFF file for writing to an output that cannot seek.  Data is
+ * passed to writeproc, with clientdata, strictly in order, and
+ * closeproc, if not NULL, is called when the handle is closed.  Only
+ * mode "w" (with its modifiers) is supported.
+ */
+TIFF*
+TIFFOpenSequential(const char* name, const char* mode, thandle_t clientdata,
+    TIFFReadWriteProc writeproc, TIFFCloseProc closeproc,
+    TIFFOpenOptions* opts)
+{
+	static const char module[] = "TIFFOpenSequential";
+	TIFFSeqFile* s;
+	TIFF* tif;
+
+	if (mode[0] != 'w') {
+		TIFFErrorExt(clientdata, module,
+		    "%s: A stream can only be opened with mode \"w\"", name);
+		return ((TIFF*)0);
+	}
+	s = (TIFFSeqFile*) _TIFFmalloc(sizeof (TIFFSeqFile));
+	if (s == NULL) {
+		TIFFErrorExt(clientdata, module, "Out of memory");
+		return ((TIFF*)0);
+	}
+	_TIFFmemset(s, 0, sizeof (TIFFSeqFile));
+	s->clientdata = clientdata;
+	s->writeproc = writeproc;
+	s->closeproc = closeproc;
+	s->limit = TIFF_SPILL_LIMIT_DEFAULT;
+	if (opts != NULL && opts->spilllimit != 0)
+		s->limit = opts->spilllimit;
+	tif = TIFFClientOpenExt(name, mode, (thandle_t) s,
+	    _tiffSeqReadProc, _tiffSeqWriteProc,
+	    _tiffSeqSeekProc, _tiffSeqCloseProc, _tiffSeqSizeProc,
+	    _tiffSeqMapProc, _tiffSeqUnmapProc, opts);
+	if (tif == NULL) {
+		if (s->spill != NULL)
+			fclose(s->spill);
+		_TIFFfree(s->buf);
+		_TIFFfree(s);
+		return ((TIFF*)0);
+	}
+	return (tif);
+}
+
+/*
+ * Pass everything before file offset off on to the output of a handle
+ * opened by TIFFOpenSequential(); a no-op for other handles.
+ */
+int
+_TIFFSequentialCommit(TIFF* tif, uint64 off)
+{
+	TIFFSeqFile* s;
+
+	if (tif->tif_closeproc != _tiffSeqCloseProc)
+		return (1);
+	s = (TIFFSeqFile*) tif->tif_clientdata;
+	if (s->hold || off <= s->sent)
+		return (1);
+	if (!_tiffSeqSend(s, off)) {
+		TIFFErrorExtR(tif, tif->tif_name, "Write error on the stream");
+		return (0);
+	}
+	return (1);
+}
+
+/*
+ * Keep everything written to a stream until the handle is closed, for
+ * directories that are written ahead of their data and updated later.
+ */
+void
+_TIFFSequentialHold(TIFF* tif)
+{
+	if (tif->tif_closeproc == _tiffSeqCloseProc)
+		((TIFFSeqFile*) tif->tif_clientdata)->hold = 1;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
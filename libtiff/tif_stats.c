@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Per-handle statistics and tracing.
+ *
+ * Handles opened with TIFFOpenOptionsSetStatistics() count the calls
+ * made to their I/O methods and the bytes moved, the strips and tiles
+ * coded, and the time spent in the codec methods and in reading
+ * directories, for TIFFGetStatistics().  Handles given a callback with
+ * TIFFSetTraceCallback() report the beginning and end of the same
+ * stages to it.  The I/O methods and the codec methods are called
+ * through the macros of tiffiop.h, which only come here for such
+ * handles.
+ *
+ * In builds configured with ALLOC_PROFILE, the allocation macros of
+ * tiffiop.h also record the allocations made for each handle by call
+ * site, and TIFFClose() reports them as warnings, largest total first.
+ */
+#include "tiffiop.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+/*
+ * Return a monotonic time in nanoseconds.
+ */
+uint64
+_TIFFStatsClock(void)
+{
+#if defined(_WIN32)
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return ((uint64) (now.QuadPart / freq.QuadPart) * 1000000000U +
+	    (uint64) (now.QuadPart % freq.QuadPart) * 1000000000U /
+	    (uint64) freq.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return (0);
+	return ((uint64) ts.tv_sec * 1000000000U + (uint64) ts.tv_nsec);
+#else
+	return ((uint64) clock() * (1000000000U / CLOCKS_PER_SEC));
+#endif
+}
+
+tmsize_t
+_TIFFStatsRead(TIFF* tif, void* buf, tmsize_t size)
+{
+	tmsize_t n = (*tif->tif_readproc)(tif->tif_clientdata, buf, size);
+
+	tif->tif_stats->readcalls++;
+	if (n > 0)
+		tif->tif_stats->readbytes += (uint64) n;
+	return (n);
+}
+
+tmsize_t
+_TIFFStatsWrite(TIFF* tif, void* buf, tmsize_t size)
+{
+	tmsize_t n = (*tif->tif_writeproc)(tif->tif_clientdata, buf, size);
+
+	tif->tif_stats->writecalls++;
+	if (n > 0)
+		tif->tif_stats->writebytes += (uint64) n;
+	return (n);
+}
+
+uint64
+_TIFFStatsSeek(TIFF* tif, uint64 off, int whence)
+{
+	tif->tif_stats->seekcalls++;
+	return ((*tif->tif_seekproc)(tif->tif_clientdata, off, whence));
+}
+
+/*
+ * Call a codec method for the TIFF_TRACE_DECODE or TIFF_TRACE_ENCODE
+ * stage, timing and reporting it.
+ */
+int
+_TIFFStatsCode(TIFF* tif, TIFFCodeMethod method, uint8* buf, tmsize_t cc,
+    uint16 s, int stage)
+{
+	uint32 strile = isTiled(tif) ? tif->tif_curtile : tif->tif_curstrip;
+	uint64 start = 0;
+	int ret;
+
+	_TIFFTrace(tif, stage, TIFF_TRACE_BEGIN, strile, cc);
+	if (tif->tif_stats)
+		start = _TIFFStatsClock();
+	ret = (*method)(tif, buf, cc, s);
+	if (tif->tif_stats) {
+		uint64 elapsed = _TIFFStatsClock() - start;
+
+		if (stage == TIFF_TRACE_DECODE)
+			tif->tif_stats->decodetime += elapsed;
+		else
+			tif->tif_stats->encodetime += elapsed;
+	}
+	_TIFFTrace(tif, stage, ret > 0 ? TIFF_TRACE_END : TIFF_TRACE_FAIL,
+	    strile, cc);
+	return (ret);
+}
+
+void
+_TIFFStatsPostDecode(TIFF* tif, uint8* buf, tmsize_t cc)
+{
+	uint64 start = _TIFFStatsClock();
+
+	(*tif->tif_postdecode)(tif, buf, cc);
+	tif->tif_stats->postdecodetime += _TIFFStatsClock() - start;
+}
+
+int
+_TIFFStatsInit(TIFF* tif)
+{
+	tif->tif_stats = (TIFFStatistics*) _TIFFmallocExt(tif,
+	    sizeof(TIFFStatistics));
+	if (tif->tif_stats == NULL) {
+		TIFFErrorExtR(tif, "_TIFFStatsInit",
+		    "No space for statistics");
+		return (0);
+	}
+	_TIFFmemset(tif->tif_stats, 0, sizeof(TIFFStatistics));
+	return (1);
+}
+
+/*
+ * Add the counts of a helper handle, such as a decoding worker, to
+ * those of tif and clear them.  The I/O counts are left out unless io
+ * is set, for helpers that do not access the file of tif.
+ */
+void
+_TIFFStatsMerge(TIFF* tif, TIFF* helper, int io)
+{
+	TIFFStatistics* to = tif->tif_stats;
+	TIFFStatistics* from = helper->tif_stats;
+
+	if (to == NULL || from == NULL)
+		return;
+	if (io) {
+		to->readcalls += from->readcalls;
+		to->readbytes += from->readbytes;
+		to->writecalls += from->writecalls;
+		to->writebytes += from->writebytes;
+		to->seekcalls += from->seekcalls;
+	}
+	to->stripsdecoded += from->stripsdecoded;
+	to->tilesdecoded += from->tilesdecoded;
+	to->stripsencoded += from->stripsencoded;
+	to->tilesencoded += from->tilesencoded;
+	to->decodetime += from->decodetime;
+	to->predictortime += from->predictortime;
+	to->postdecodetime += from->postdecodetime;
+	to->encodetime += from->encodetime;
+	to->rawbufferallocs += from->rawbufferallocs;
+	to->directoriesread += from->directoriesread;
+	to->directorytime += from->directorytime;
+	to->directoriescached += from->directoriescached;
+	_TIFFmemset(from, 0, sizeof(TIFFStatistics));
+}
+
+void
+_TIFFFreeStats(TIFF* tif)
+{
+	if (tif->tif_stats) {
+		_TIFFfreeExt(tif, tif->tif_stats);
+		tif->tif_stats = NULL;
+	}
+}
+
+void
+_TIFFTraceEvent(TIFF* tif, int stage, int phase, uint32 strile, uint64 bytes)
+{
+	(*tif->tif_traceproc)(tif->tif_traceowner ? tif->tif_traceowner : tif,
+	    tif->tif_tracedata, stage, phase, strile, bytes);
+}
+
+/*
+ * Make a helper handle, such as a decoding worker, report to the trace
+ * callback of tif on its behalf.
+ */
+void
+_TIFFTraceHelper(TIFF* tif, TIFF* helper)
+{
+	helper->tif_traceproc = tif->tif_traceproc;
+	helper->tif_tracedata = tif->tif_tracedata;
+	helper->tif_traceowner = tif->tif_traceowner ? tif->tif_traceowner : tif;
+}
+
+/*
+ * Call proc at the beginning and end of the stages of tif: reading and
+ * decoding strips and tiles, encoding them, and reading and writing
+ * directories.  NULL removes the callback.
+ */
+void
+TIFFSetTraceCallback(TIFF* tif, TIFFTraceProc proc, void* clientdata)
+{
+	tif->tif_traceproc = proc;
+	tif->tif_tracedata = clientdata;
+}
+
+/*
+ * Copy the counts kept for tif since it was opened to *stats.  Returns
+ * 0, and clears *stats, if the handle was not opened with
+ * TIFFOpenOptionsSetStatistics().
+ */
+int
+TIFFGetStatistics(TIFF* tif, TIFFStatistics* stats)
+{
+	if (tif->tif_stats == NULL) {
+		_TIFFmemset(stats, 0, sizeof(TIFFStatistics));
+		return (0);
+	}
+	_TIFFmemcpy(stats, tif->tif_stats, sizeof(TIFFStatistics));
+	return (1);
+}
+
+/*
+ * Allocation profile: a hash table of the call sites, with open
+ * addressing.  Its own memory is not accounted to the handle.
+ */
+typedef struct {
+	const char*	file;		/* NULL for a free slot */
+	int		line;
+	uint64		count;
+	uint64		bytes;
+	tmsize_t	largest;
+} TIFFAllocSite;
+
+struct _TIFFAllocProfile {
+	TIFFAllocSite*	sites;
+	uint32		nsites;		/* slots used */
+	uint32		size;		/* slots, a power of 2 */
+	TIFFMutex*	mutex;		/* for helper handles, or NULL */
+};
+
+static uint32
+_TIFFAllocSiteHash(const char* file, int line)
+{
+	uint32 h = (uint32) line;
+
+	/* __FILE__ may expand to different copies of the same name */
+	while (*file)
+		h = h * 31 + (unsigned char) *file++;
+	return (h);
+}
+
+static TIFFAllocSite*
+_TIFFFindAllocSite(TIFFAllocProfile* prof, const char* file, int line)
+{
+	uint32 i = _TIFFAllocSiteHash(file, line) & (prof->size - 1);
+
+	while (prof->sites[i].file != NULL && (prof->sites[i].line != line ||
+	    (prof->sites[i].file != file &&
+	     strcmp(prof->sites[i].file, file) != 0)))
+		i = (i + 1) & (prof->size - 1);
+	return (&prof->sites[i]);
+}
+
+/*
+ * Grow the table of prof so that one more site fits.
+ */
+static int
+_TIFFGrowAllocProfile(TIFFAllocProfile* prof)
+{
+	TIFFAllocSite* old = prof->sites;
+	uint32 oldsize = prof->size, i;
+
+	if (prof->nsites + 1 <= prof->size / 2)
+		return (1);
+	prof->size = oldsize ? 2 * oldsize : 64;
+	prof->sites = (TIFFAllocSite*) _TIFFcalloc(prof->size,
+	    sizeof(TIFFAllocSite));
+	if (prof->sites == NULL) {
+		prof->sites = old;
+		prof->size = oldsize;
+		return (0);
+	}
+	for (i = 0; i < oldsize; i++) {
+		if (old[i].file != NULL)
+			*_TIFFFindAllocSite(prof, old[i].file, old[i].line) =
+			    old[i];
+	}
+	_TIFFfree(old);
+	return (1);
+}
+
+static void
+_TIFFAddAllocSite(TIFFAllocProfile* prof, const char* file, int line,
+		  uint64 count, uint64 bytes, tmsize_t largest)
+{
+	TIFFAllocSite* site;
+
+	if (!_TIFFGrowAllocProfile(prof))
+		return;
+	site = _TIFFFindAllocSite(prof, file, line);
+	if (site->file == NULL) {
+		site->file = file;
+		site->line = line;
+		prof->nsites++;
+	}
+	site->count += count;
+	site->bytes += bytes;
+	if (largest > site->largest)
+		site->largest = largest;
+}
+
+static TIFFAllocProfile*
+_TIFFGetAllocProfile(TIFF* tif)
+{
+	if (tif->tif_allocprofile == NULL)
+		tif->tif_allocprofile = (TIFFAllocProfile*)
+		    _TIFFcalloc(1, sizeof(TIFFAllocProfile));
+	return (tif->tif_allocprofile);
+}
+
+/*
+ * Record an allocation of size bytes for tif made at file:line, on the
+ * profile of the handle that owns tif if it is a helper handle.
+ */
+static void
+_TIFFRecordAlloc(TIFF* tif, tmsize_t size, const char* file, int line)
+{
+	TIFFAllocProfile* prof;
+
+	if (tif == NULL)
+		return;
+	if (tif->tif_allocowner)
+		tif = tif->tif_allocowner;
+	if ((prof = _TIFFGetAllocProfile(tif)) == NULL)
+		return;
+	if (prof->mutex)
+		_TIFFMutexLock(prof->mutex);
+	_TIFFAddAllocSite(prof, file, line, 1, (uint64) size, size);
+	if (prof->mutex)
+		_TIFFMutexUnlock(prof->mutex);
+}
+
+/*
+ * The allocation functions called by the macros of tiffiop.h in builds
+ * configured with ALLOC_PROFILE.
+ */
+void*
+_TIFFmallocSite(TIFF* tif, tmsize_t s, const char* file, int line)
+{
+	void* p = (_TIFFmallocExt)(tif, s);
+
+	if (p != NULL)
+		_TIFFRecordAlloc(tif, s, file, line);
+	return (p);
+}
+
+void*
+_TIFFcallocSite(TIFF* tif, tmsize_t nmemb, tmsize_t siz, const char* file,
+		int line)
+{
+	void* p = (_TIFFcallocExt)(tif, nmemb, siz);
+
+	if (p != NULL)
+		_TIFFRecordAlloc(tif, nmemb * siz, file, line);
+	return (p);
+}
+
+void*
+_TIFFreallocSite(TIFF* tif, void* p, tmsize_t s, const char* file, int line)
+{
+	p = (_TIFFreallocExt)(tif, p, s);
+	if (p != NULL)
+		_TIFFRecordAlloc(tif, s, file, line);
+	return (p);
+}
+
+void*
+_TIFFCheckReallocSite(TIFF* tif, void* buffer, tmsize_t nmemb,
+		      tmsize_t elem_size, const char* what, const char* file,
+		      int line)
+{
+	void* p = (_TIFFCheckRealloc)(tif, buffer, nmemb, elem_size, what);
+
+	if (p != NULL)
+		_TIFFRecordAlloc(tif, nmemb * elem_size, file, line);
+	return (p);
+}
+
+/*
+ * Make a helper handle, such as a decoding worker, record its
+ * allocations on the profile of tif, moving those made while it was
+ * opened.  Called before the helper is used from other threads.
+ */
+void
+_TIFFAllocProfileHelper(TIFF* tif, TIFF* helper)
+{
+	TIFFAllocProfile* from = helper->tif_allocprofile;
+	TIFFAllocProfile* prof;
+	uint32 i;
+
+	if (tif->tif_allocowner)
+		tif = tif->tif_allocowner;
+	helper->tif_allocowner = tif;
+	if ((prof = _TIFFGetAllocProfile(tif)) == NULL)
+		return;
+	if (prof->mutex == NULL && _TIFFHaveThreads())
+		prof->mutex = _TIFFMutexCreate();
+	if (from == NULL)
+		return;
+	if (prof->mutex)
+		_TIFFMutexLock(prof->mutex);
+	for (i = 0; i < from->size; i++) {
+		if (from->sites[i].file != NULL)
+			_TIFFAddAllocSite(prof, from->sites[i].file,
+			    from->sites[i].line, from->sites[i].count,
+			    from->sites[i].bytes, from->sites[i].largest);
+	}
+	if (prof->mutex)
+		_TIFFMutexUnlock(prof->mutex);
+	helper->tif_allocprofile = NULL;
+	_TIFFfree(from->sites);
+	_TIFFfree(from);
+}
+
+static int
+_TIFFAllocSiteCompare(const void* a, const void* b)
+{
+	const TIFFAllocSite* sa = (const TIFFAllocSite*) a;
+	const TIFFAllocSite* sb = (const TIFFAllocSite*) b;
+
+	if (sa->bytes != sb->bytes)
+		return (sa->bytes < sb->bytes ? 1 : -1);
+	return (sa->count < sb->count ? 1 : sa->count > sb->count ? -1 : 0);
+}
+
+/*
+ * Report the allocation profile of tif, if any, and free it.
+ */
+void
+_TIFFFreeAllocProfile(TIFF* tif)
+{
+	static const char module[] = "TIFFClose";
+	TIFFAllocProfile* prof = tif->tif_allocprofile;
+	uint32 i, n = 0;
+
+	if (prof == NULL)
+		return;
+	tif->tif_allocprofile = NULL;
+	/* Pack the used slots at the start of the table */
+	for (i = 0; i < prof->size; i++) {
+		if (prof->sites[i].file != NULL)
+			prof->sites[n++] = prof->sites[i];
+	}
+	if (n > 0) {
+		qsort(prof->sites, n, sizeof(TIFFAllocSite),
+		    _TIFFAllocSiteCompare);
+		TIFFWarningExtR(tif, module,
+		    "%s: allocations by call site:", tif->tif_name);
+	}
+	for (i = 0; i < n; i++)
+		TIFFWarningExtR(tif, module,
+		    "%s:%d: %llu allocations, %llu bytes, largest %lld",
+		    prof->sites[i].file, prof->sites[i].line,
+		    (unsigned long long) prof->sites[i].count,
+		    (unsigned long long) prof->sites[i].bytes,
+		    (long long) prof->sites[i].largest);
+	if (prof->mutex)
+		_TIFFMutexDestroy(prof->mutex);
+	_TIFFfree(prof->sites);
+	_TIFFfree(prof);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -27,6 +27,8 @@
  */
 #include "tiffiop.h"
 #include <iostream>
+#include <new>
+#include <sstream>
 
 #ifndef __VMS
 using namespace std;
@@ -73,9 +75,42 @@ using namespace std;
     basic_ostream& ostream::write(const char *str, streamsize count)
 */
 
+/*
+  Reads from an istream go through a cache of one TIFFIS_BLOCK sized,
+  block aligned piece of the stream, and seeks only move a position
+  kept in tiffis_data; the stream is repositioned when a read needs
+  it.  The many small reads done for directories then cost a copy
+  rather than a call into the streambuf, which may be slow for custom
+  streambufs.  Reads of a block or more go straight to the caller's
+  buffer.
+*/
+#define TIFFIS_BLOCK (64 * 1024)
+
 struct tiffis_data;
 struct tiffos_data;
 
+/*
+  The get area of a std::stringbuf (and of a C++23 std::spanbuf) holds
+  the whole character sequence, so such streams can serve as the
+  memory-mapped image of the file.  eback(), gptr() and egptr() are
+  protected, but may be reached through member pointers formed in a
+  derived class.
+*/
+struct tiffis_getarea : public streambuf
+{
+	static void get(streambuf* sb, char** begin, char** cur, char** end)
+	{
+		typedef char* (streambuf::*area)() const;
+		area eb = &tiffis_getarea::eback;
+		area gp = &tiffis_getarea::gptr;
+		area eg = &tiffis_getarea::egptr;
+
+		*begin = (sb->*eb)();
+		*cur = (sb->*gp)();
+		*end = (sb->*eg)();
+	}
+};
+
 extern "C" {
 
 	static tmsize_t _tiffosReadProc(thandle_t, void*, tmsize_t);
@@ -89,6 +124,7 @@ extern "C" {
 	static int      _tiffosCloseProc(thandle_t fd);
 	static int      _tiffisCloseProc(thandle_t fd);
 	static int 	_tiffDummyMapProc(thandle_t , void** base, toff_t* size );
+	static int 	_tiffisMapProc(thandle_t fd, void** base, toff_t* size);
 	static void     _tiffDummyUnmapProc(thandle_t , void* base, toff_t size );
 	static TIFF*    _tiffStreamOpen(const char* name, const char* mode, void *fd);
 
@@ -96,6 +132,16 @@ struct tiffis_data
 {
 	istream	*stream;
         ios::pos_type start_pos;
+	uint64	pos;			// position seen by libtiff
+	uint64	streampos;		// position of the stream
+	int	streamposvalid;		// streampos is known
+	char	*buf;			// cached block, or NULL
+	uint64	bufoff;			// offset of buf in the file
+	tmsize_t buflen;		// valid bytes in buf
+	uint64	end;			// stream length, if endvalid
+	int	endvalid;
+	char	*mapbase;		// file data in the get area, or NULL
+	tmsize_t mapsize;
 };
 
 struct tiffos_data
@@ -110,19 +156,102 @@ _tiffosReadProc(thandle_t, void*, tmsize_t)
         return 0;
 }
 
-static tmsize_t
-_tiffisReadProc(thandle_t fd, void* buf, tmsize_t size)
+/*
+ * Move the stream to offset off of the file, unless it is there.
+ */
+static int
+_tiffisSeekStream(tiffis_data* data, uint64 off)
 {
-        tiffis_data	*data = reinterpret_cast<tiffis_data *>(fd);
+	if (data->streamposvalid && data->streampos == off)
+		return 1;
+
+	// Compute 64-bit offset and verify that it does not overflow
+	uint64 new_offset = static_cast<uint64>(data->start_pos) + off;
+	ios::off_type offset = static_cast<ios::off_type>(new_offset);
+	if (static_cast<uint64>(offset) != new_offset)
+		return 0;
+
+	// a short read at the end of the stream must not fail the seek
+	data->stream->clear(data->stream->rdstate() & ios::badbit);
+	data->stream->seekg(offset, ios::beg);
+	data->streamposvalid = !data->stream->fail();
+	data->streampos = off;
+	return data->streamposvalid;
+}
 
+/*
+ * Read from the current position of the stream.
+ */
+static tmsize_t
+_tiffisReadStream(tiffis_data* data, char* buf, tmsize_t size)
+{
         // Verify that type does not overflow.
         streamsize request_size = size;
         if (static_cast<tmsize_t>(request_size) != size)
           return static_cast<tmsize_t>(-1);
 
-        data->stream->read((char *) buf, request_size);
+        data->stream->read(buf, request_size);
+	tmsize_t n = static_cast<tmsize_t>(data->stream->gcount());
+	data->streampos += n;
+	if (n < size)
+		data->stream->clear(data->stream->rdstate() & ios::badbit);
+	return n;
+}
 
-        return static_cast<tmsize_t>(data->stream->gcount());
+static tmsize_t
+_tiffisReadProc(thandle_t fd, void* buf, tmsize_t size)
+{
+        tiffis_data	*data = reinterpret_cast<tiffis_data *>(fd);
+	char		*out = reinterpret_cast<char *>(buf);
+	tmsize_t	done = 0;
+
+	if (size < 0)
+		return static_cast<tmsize_t>(-1);
+	while (size > 0) {
+		tmsize_t n;
+
+		if (data->buflen > 0 && data->pos >= data->bufoff &&
+		    data->pos - data->bufoff < static_cast<uint64>(data->buflen)) {
+			// served from the cached block
+			tmsize_t skip = static_cast<tmsize_t>(data->pos - data->bufoff);
+			n = data->buflen - skip;
+			if (n > size)
+				n = size;
+			memcpy(out, data->buf + skip, n);
+		} else {
+			if (data->buf == NULL && size < TIFFIS_BLOCK)
+				data->buf = new (std::nothrow) char[TIFFIS_BLOCK];
+			if (data->buf == NULL || size >= TIFFIS_BLOCK) {
+				// large read: straight into the caller's buffer
+				if (!_tiffisSeekStream(data, data->pos))
+					break;
+				n = _tiffisReadStream(data, out, size);
+				if (n > 0) {
+					done += n;
+					data->pos += n;
+				}
+				break;
+			}
+			// load the block holding the position
+			uint64 blockoff = data->pos - data->pos % TIFFIS_BLOCK;
+			data->buflen = 0;
+			if (!_tiffisSeekStream(data, blockoff))
+				break;
+			n = _tiffisReadStream(data, data->buf, TIFFIS_BLOCK);
+			if (n <= 0)
+				break;
+			data->bufoff = blockoff;
+			data->buflen = n;
+			if (data->pos - blockoff >= static_cast<uint64>(n))
+				break;		// end of the stream
+			continue;
+		}
+		out += n;
+		size -= n;
+		done += n;
+		data->pos += n;
+	}
+	return done;
 }
 
 static tmsize_t
@@ -243,14 +372,32 @@ _tiffosSeekProc(thandle_t fd, uint64 off, int whence)
 		}
 	}
 
-	return static_cast<uint64>(os->tellp());
+	return static_cast<uint64>(os->tellp() - data->start_pos);
+}
+
+/*
+ * Return the length of the stream, from its beginning.
+ */
+static uint64
+_tiffisStreamEnd(tiffis_data* data)
+{
+	if (!data->endvalid) {
+		data->stream->clear(data->stream->rdstate() & ios::badbit);
+		data->stream->seekg(0, ios::end);
+		data->end = static_cast<uint64>(data->stream->tellg());
+		data->endvalid = !data->stream->fail();
+		data->streamposvalid = 0;
+	}
+	return data->end;
 }
 
 static uint64
 _tiffisSeekProc(thandle_t fd, uint64 off, int whence)
 {
 	tiffis_data	*data = reinterpret_cast<tiffis_data *>(fd);
+	uint64		base;
 
+	// Only the position is changed; the stream follows on the next read
 	switch(whence) {
 	case SEEK_SET:
 		{
@@ -262,32 +409,28 @@ _tiffisSeekProc(thandle_t fd, uint64 off, int whence)
 			if (static_cast<uint64>(offset) != new_offset)
 				return static_cast<uint64>(-1);
 
-			data->stream->seekg(offset, ios::beg);
-			break;
+			data->pos = off;
+			return data->pos;
 		}
 	case SEEK_CUR:
-		{
-			// Verify that value does not overflow
-			ios::off_type offset = static_cast<ios::off_type>(off);
-			if (static_cast<uint64>(offset) != off)
-				return static_cast<uint64>(-1);
-
-			data->stream->seekg(offset, ios::cur);
-			break;
-		}
+		base = data->pos;
+		break;
 	case SEEK_END:
-		{
-			// Verify that value does not overflow
-			ios::off_type offset = static_cast<ios::off_type>(off);
-			if (static_cast<uint64>(offset) != off)
-				return static_cast<uint64>(-1);
-
-			data->stream->seekg(offset, ios::end);
-			break;
-		}
+		base = _tiffisStreamEnd(data);
+		if (!data->endvalid ||
+		    base < static_cast<uint64>(data->start_pos))
+			return static_cast<uint64>(-1);
+		base -= static_cast<uint64>(data->start_pos);
+		break;
+	default:
+		return static_cast<uint64>(-1);
 	}
-
-	return (uint64) (data->stream->tellg() - data->start_pos);
+	// offsets are signed for SEEK_CUR and SEEK_END
+	if (static_cast<int64>(off) < 0 &&
+	    static_cast<uint64>(-static_cast<int64>(off)) > base)
+		return static_cast<uint64>(-1);
+	data->pos = base + off;
+	return data->pos;
 }
 
 static uint64
@@ -309,14 +452,8 @@ static uint64
 _tiffisSizeProc(thandle_t fd)
 {
 	tiffis_data	*data = reinterpret_cast<tiffis_data *>(fd);
-	ios::pos_type	pos = data->stream->tellg();
-	ios::pos_type	len;
 
-	data->stream->seekg(0, ios::end);
-	len = data->stream->tellg();
-	data->stream->seekg(pos);
-
-	return (uint64) len;
+	return _tiffisStreamEnd(data);
 }
 
 static int
@@ -330,8 +467,14 @@ _tiffosCloseProc(thandle_t fd)
 static int
 _tiffisCloseProc(thandle_t fd)
 {
+	tiffis_data	*data = reinterpret_cast<tiffis_data *>(fd);
+
 	// Our stream was not allocated by us, so it shouldn't be closed by us.
-	delete reinterpret_cast<tiffis_data *>(fd);
+	// Leave it at the position libtiff had reached, as without caching.
+	if (!data->stream->bad())
+		_tiffisSeekStream(data, data->pos);
+	delete[] data->buf;
+	delete data;
 	return 0;
 }
 
@@ -350,6 +493,48 @@ _tiffDummyUnmapProc(thandle_t , void* base, toff_t size )
 	(void) size;
 }
 
+static int
+_tiffisMapProc(thandle_t fd, void** base, toff_t* size)
+{
+	tiffis_data	*data = reinterpret_cast<tiffis_data *>(fd);
+
+	if (data->mapbase == NULL)
+		return (0);
+	*base = data->mapbase;
+	*size = static_cast<toff_t>(data->mapsize);
+	return (1);
+}
+
+/*
+ * Find the file data in the get area of a string or span buffer that
+ * holds all of the stream, from its beginning to its end.
+ */
+static void
+_tiffisFindMapping(tiffis_data* data)
+{
+	streambuf	*sb = data->stream->rdbuf();
+	char		*begin, *cur, *end;
+
+	data->mapbase = NULL;
+	data->mapsize = 0;
+	if (sb == NULL || static_cast<streamoff>(data->start_pos) < 0)
+		return;
+	if (dynamic_cast<stringbuf *>(sb) == NULL
+#ifdef __cpp_lib_spanstream
+	    && dynamic_cast<spanbuf *>(sb) == NULL
+#endif
+	    )
+		return;
+	tiffis_getarea::get(sb, &begin, &cur, &end);
+	if (begin == NULL ||
+	    cur - begin != static_cast<ptrdiff_t>(static_cast<streamoff>(data->start_pos)) ||
+	    static_cast<uint64>(end - begin) != _tiffisStreamEnd(data) ||
+	    !data->endvalid)
+		return;
+	data->mapbase = cur;
+	data->mapsize = static_cast<tmsize_t>(end - cur);
+}
+
 /*
  * Open a TIFF file descriptor for read/writing.
  */
@@ -380,6 +565,15 @@ _tiffStreamOpen(const char* name, const char* mode, void *fd)
 		tiffis_data	*data = new tiffis_data;
 		data->stream = reinterpret_cast<istream *>(fd);
 		data->start_pos = data->stream->tellg();
+		data->pos = 0;
+		data->streampos = 0;
+		data->streamposvalid = 1;
+		data->buf = NULL;
+		data->bufoff = 0;
+		data->buflen = 0;
+		data->end = 0;
+		data->endvalid = 0;
+		_tiffisFindMapping(data);
 		// Open for reading.
 		tif = TIFFClientOpen(name, mode,
 				reinterpret_cast<thandle_t>(data),
@@ -388,9 +582,11 @@ _tiffStreamOpen(const char* name, const char* mode, void *fd)
 				_tiffisSeekProc,
                                 _tiffisCloseProc,
 				_tiffisSizeProc,
-				_tiffDummyMapProc,
+				_tiffisMapProc,
                                 _tiffDummyUnmapProc);
 		if (!tif) {
+			_tiffisSeekStream(data, 0);
+			delete[] data->buf;
 			delete data;
 		}
 	}
@@ -419,8 +615,9 @@ TIFFStreamOpen(const char* name, ostream *os)
 TIFF*
 TIFFStreamOpen(const char* name, istream *is)
 {
-	// NB: We don't support mapped files with streams so add 'm'
-	return _tiffStreamOpen(name, "rm", is);
+	// NB: Only string and span buffers can be mapped, see
+	// _tiffisFindMapping(); for other streams mapping is refused
+	return _tiffStreamOpen(name, "r", is);
 }
 
 /* vim: set ts=8 sts=8 sw=8 noet: */
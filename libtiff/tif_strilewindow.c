@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Strip/tile arrays streamed to the file.
+ *
+ * With TIFFOpenOptionsSetStrileWindow(), a directory written with more
+ * strips or tiles than the window gets room for its offset and byte
+ * count arrays at the end of the file before any of its image data.
+ * td_stripoffset and td_stripbytecount then only hold the entries of a
+ * window of striles, aligned on its size and starting at
+ * td_strilefirst: TIFFStrileIndex() gives the place of a strile held
+ * with _TIFFHoldStrile().  Holding a strile outside the window writes
+ * the window out to its place in the arrays, if it was changed, and
+ * reads the window of the strile in.  The directory points at the
+ * arrays in the file instead of carrying them.
+ */
+#include "tiffiop.h"
+
+struct _TIFFStrileWindow {
+	uint32  size;           /* entries held */
+	uint32  end;            /* striles from here on were never written */
+	int     dirty;          /* the entries held changed */
+	uint64  offsetsoff;     /* file offset of the offset array */
+	uint64  bytecountsoff;  /* file offset of the byte count array */
+	uint8*  buf;            /* entries in their file form */
+};
+
+#define	StrileEntrySize(tif) (((tif)->tif_flags & TIFF_BIGTIFF) ? 8 : 4)
+
+/*
+ * Allocate the window and set the arrays aside at the end of the file,
+ * zero filled, for TIFFSetupStrips().
+ */
+int
+_TIFFSetupStrileWindow(TIFF* tif)
+{
+	static const char module[] = "TIFFSetupStrileWindow";
+	TIFFDirectory* td = &tif->tif_dir;
+	uint32 size = tif->tif_strilewindow;
+	tmsize_t es;
+	uint64 arraysize;
+	TIFFStrileWindow* w;
+	uint64 off, end;
+
+	/* The entry size cannot change once the arrays are set aside */
+	if (!_TIFFPromoteIfNeeded(tif, TIFFSeekFile(tif, 0, SEEK_END) + 1 +
+	    2 * 4 * (uint64) td->td_nstrips, module))
+		return (0);
+	es = StrileEntrySize(tif);
+	arraysize = (uint64) td->td_nstrips * (uint64) es;
+	w = (TIFFStrileWindow*) _TIFFcallocExt(tif, 1,
+	    sizeof (TIFFStrileWindow));
+	td->td_stripoffset = (uint64*) _TIFFcallocExt(tif, size,
+	    sizeof (uint64));
+	td->td_stripbytecount = (uint64*) _TIFFcallocExt(tif, size,
+	    sizeof (uint64));
+	if (w != NULL)
+		w->buf = (uint8*) _TIFFcallocExt(tif, size, es);
+	if (w == NULL || w->buf == NULL || td->td_stripoffset == NULL ||
+	    td->td_stripbytecount == NULL) {
+		TIFFErrorExtR(tif, module, "No space for strip/tile window");
+		goto bad;
+	}
+	w->size = size;
+	td->td_strilewindow = w;
+	td->td_strilefirst = 0;
+
+	/* The arrays are written over in place later */
+	_TIFFSequentialHold(tif);
+	off = TIFFSeekFile(tif, 0, SEEK_END);
+	end = off + (off & 1) + 2 * arraysize;
+	if (!(tif->tif_flags & TIFF_BIGTIFF) && end > 0xFFFFFFFFU) {
+		TIFFErrorExtR(tif, module, "Maximum TIFF file size exceeded");
+		goto bad;
+	}
+	w->offsetsoff = off + (off & 1);
+	w->bytecountsoff = w->offsetsoff + arraysize;
+	/* w->buf is still all zeros */
+	while (off < end) {
+		tmsize_t n = (tmsize_t) size * es;
+
+		if ((uint64) n > end - off)
+			n = (tmsize_t) (end - off);
+		if (!WriteOK(tif, w->buf, n)) {
+			TIFFErrorExtR(tif, module,
+			    "Write error reserving strip/tile arrays");
+			goto bad;
+		}
+		off += (uint64) n;
+	}
+	return (1);
+bad:
+	if (w != NULL && td->td_strilewindow == NULL) {
+		_TIFFfreeExt(tif, w->buf);
+		_TIFFfreeExt(tif, w);
+	}
+	_TIFFFreeStrileWindow(tif);
+	_TIFFfreeExt(tif, td->td_stripoffset);
+	_TIFFfreeExt(tif, td->td_stripbytecount);
+	td->td_stripoffset = NULL;
+	td->td_stripbytecount = NULL;
+	return (0);
+}
+
+/*
+ * Write the entries held to the arrays in the file, or read them from
+ * there, leaving the file position where it was for the strip or tile
+ * being appended to.
+ */
+static int
+_TIFFStrileWindowIO(TIFF* tif, int writing)
+{
+	static const char module[] = "TIFFStrileWindowIO";
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFStrileWindow* w = td->td_strilewindow;
+	uint32 n = td->td_nstrips - td->td_strilefirst;
+	tmsize_t es = StrileEntrySize(tif);
+	uint64 pos = TIFFSeekFile(tif, 0, SEEK_CUR);
+	uint32 i;
+	int a;
+
+	if (n > w->size)
+		n = w->size;
+	for (a = 0; a < 2; a++) {
+		uint64* values = a ? td->td_stripbytecount : td->td_stripoffset;
+		uint64 off = (a ? w->bytecountsoff : w->offsetsoff) +
+		    (uint64) td->td_strilefirst * (uint64) es;
+
+		if (writing) {
+			for (i = 0; i < n; i++) {
+				if (es == 8) {
+					((uint64*) w->buf)[i] = values[i];
+					continue;
+				}
+				if (values[i] > 0xFFFFFFFFU) {
+					TIFFErrorExtR(tif, module,
+					    "Attempt to write value larger than 0xFFFFFFFF in Classic TIFF file.");
+					return (0);
+				}
+				((uint32*) w->buf)[i] = (uint32) values[i];
+			}
+			if (tif->tif_flags & TIFF_SWAB) {
+				if (es == 8)
+					TIFFSwabArrayOfLong8((uint64*) w->buf, n);
+				else
+					TIFFSwabArrayOfLong((uint32*) w->buf, n);
+			}
+			if (!SeekOK(tif, off) ||
+			    !WriteOK(tif, w->buf, (tmsize_t) n * es)) {
+				TIFFErrorExtR(tif, module,
+				    "Write error updating strip/tile arrays");
+				return (0);
+			}
+		} else {
+			if (!SeekOK(tif, off) ||
+			    !ReadOK(tif, w->buf, (tmsize_t) n * es)) {
+				TIFFErrorExtR(tif, module,
+				    "Read error loading strip/tile arrays");
+				return (0);
+			}
+			if (tif->tif_flags & TIFF_SWAB) {
+				if (es == 8)
+					TIFFSwabArrayOfLong8((uint64*) w->buf, n);
+				else
+					TIFFSwabArrayOfLong((uint32*) w->buf, n);
+			}
+			for (i = 0; i < n; i++)
+				values[i] = es == 8 ? ((uint64*) w->buf)[i] :
+				    (uint64) ((uint32*) w->buf)[i];
+		}
+	}
+	if (writing && td->td_strilefirst + n > w->end)
+		w->end = td->td_strilefirst + n;
+	if (!SeekOK(tif, pos)) {
+		TIFFErrorExtR(tif, module, "Seek error updating strip/tile arrays");
+		return (0);
+	}
+	return (1);
+}
+
+/*
+ * Make the entries of strile available at TIFFStrileIndex(tif, strile)
+ * in td_stripoffset and td_stripbytecount, if the arrays are streamed,
+ * and note whether the caller may modify them.
+ */
+int
+_TIFFHoldStrile(TIFF* tif, uint32 strile, int modify)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFStrileWindow* w = td->td_strilewindow;
+
+	if (w == NULL)
+		return (1);
+	if (strile - td->td_strilefirst >= w->size) {
+		if (!_TIFFFlushStrileWindow(tif))
+			return (0);
+		td->td_strilefirst = strile - strile % w->size;
+		if (td->td_strilefirst >= w->end) {
+			/* still as reserved */
+			_TIFFmemset(td->td_stripoffset, 0,
+			    (tmsize_t) w->size * sizeof (uint64));
+			_TIFFmemset(td->td_stripbytecount, 0,
+			    (tmsize_t) w->size * sizeof (uint64));
+		} else if (!_TIFFStrileWindowIO(tif, 0)) {
+			/* hold nothing rather than wrong entries */
+			td->td_strilefirst = td->td_nstrips;
+			return (0);
+		}
+	}
+	if (modify)
+		w->dirty = 1;
+	return (1);
+}
+
+/*
+ * Write the entries held to the arrays in the file if they changed.
+ */
+int
+_TIFFFlushStrileWindow(TIFF* tif)
+{
+	TIFFStrileWindow* w = tif->tif_dir.td_strilewindow;
+
+	if (w == NULL || !w->dirty)
+		return (1);
+	if (!_TIFFStrileWindowIO(tif, 1))
+		return (0);
+	w->dirty = 0;
+	return (1);
+}
+
+/*
+ * Return the file offset of the byte count array if bytecounts is set,
+ * and of the offset array otherwise.
+ */
+uint64
+_TIFFStrileArrayOffset(TIFF* tif, int bytecounts)
+{
+	TIFFStrileWindow* w = tif->tif_dir.td_strilewindow;
+
+	return (bytecounts ? w->bytecountsoff : w->offsetsoff);
+}
+
+/*
+ * Forget the window; the arrays it holds are freed with the directory.
+ */
+void
+_TIFFFreeStrileWindow(TIFF* tif)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+
+	if (td->td_strilewindow == NULL)
+		return;
+	_TIFFfreeExt(tif, td->td_strilewindow->buf);
+	_TIFFfreeExt(tif, td->td_strilewindow);
+	td->td_strilewindow = NULL;
+	td->td_strilefirst = 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -42,7 +42,7 @@ TIFFComputeStrip(TIFF* tif, uint32 row, uint16 sample)
 	strip = row / td->td_rowsperstrip;
 	if (td->td_planarconfig == PLANARCONFIG_SEPARATE) {
 		if (sample >= td->td_samplesperpixel) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "%lu: Sample out of range, max %lu",
 			    (unsigned long) sample, (unsigned long) td->td_samplesperpixel);
 			return (0);
@@ -99,7 +99,7 @@ TIFFVStripSize64(TIFF* tif, uint32 nrows)
 		uint64 samplingrow_size;
 		if(td->td_samplesperpixel!=3)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,
+			TIFFErrorExtR(tif,module,
 			    "Invalid td_samplesperpixel value");
 			return 0;
 		}
@@ -108,7 +108,7 @@ TIFFVStripSize64(TIFF* tif, uint32 nrows)
 		if ((ycbcrsubsampling[0] != 1 && ycbcrsubsampling[0] != 2 && ycbcrsubsampling[0] != 4)
 		    ||(ycbcrsubsampling[1] != 1 && ycbcrsubsampling[1] != 2 && ycbcrsubsampling[1] != 4))
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,
+			TIFFErrorExtR(tif,module,
 				     "Invalid YCbCr subsampling (%dx%d)", 
 				     ycbcrsubsampling[0], 
 				     ycbcrsubsampling[1] );
@@ -134,7 +134,7 @@ TIFFVStripSize(TIFF* tif, uint32 nrows)
 	n=(tmsize_t)m;
 	if ((uint64)n!=m)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Integer overflow");
+		TIFFErrorExtR(tif,module,"Integer overflow");
 		n=0;
 	}
 	return(n);
@@ -147,18 +147,17 @@ uint64
 TIFFRawStripSize64(TIFF* tif, uint32 strip)
 {
 	static const char module[] = "TIFFRawStripSize64";
-	TIFFDirectory* td = &tif->tif_dir;
-	uint64 bytecount = td->td_stripbytecount[strip];
+	uint64 bytecount = TIFFGetStrileByteCount(tif, strip);
 
 	if (bytecount == 0)
 	{
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "%I64u: Invalid strip byte count, strip %lu",
 			     (unsigned __int64) bytecount,
 			     (unsigned long) strip);
 #else
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "%llu: Invalid strip byte count, strip %lu",
 			     (unsigned long long) bytecount,
 			     (unsigned long) strip);
@@ -182,7 +181,7 @@ TIFFRawStripSize(TIFF* tif, uint32 strip)
 		n=(tmsize_t)m;
 		if ((uint64)n!=m)
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,"Integer overflow");
+			TIFFErrorExtR(tif,module,"Integer overflow");
 			n=0;
 		}
 	}
@@ -216,7 +215,7 @@ TIFFStripSize(TIFF* tif)
 	n=(tmsize_t)m;
 	if ((uint64)n!=m)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Integer overflow");
+		TIFFErrorExtR(tif,module,"Integer overflow");
 		n=0;
 	}
 	return(n);
@@ -234,6 +233,31 @@ TIFFDefaultStripSize(TIFF* tif, uint32 request)
 	return (*tif->tif_defstripsize)(tif, request);
 }
 
+/*
+ * The uncompressed size of the strips and tiles that the defaults aim
+ * at.  Codecs that look for matches over a long window compress larger
+ * chunks better, and chunks of a few hundred kilobytes keep the number
+ * of reads and strile array entries down for the others.
+ */
+uint64
+_TIFFChunkSize(TIFF* tif)
+{
+	if (tif->tif_chunksize != TIFF_CHUNKSIZE_AUTO)
+		return (tif->tif_chunksize > 0 ?
+		    (uint64) tif->tif_chunksize : STRIP_SIZE_DEFAULT);
+	switch (tif->tif_dir.td_compression) {
+	case COMPRESSION_ADOBE_DEFLATE:
+	case COMPRESSION_DEFLATE:
+	case COMPRESSION_ZSTD:
+	case COMPRESSION_LZMA:
+	case COMPRESSION_LZ4:
+	case COMPRESSION_LERC:
+		return (1024 * 1024);
+	default:
+		return (256 * 1024);
+	}
+}
+
 uint32
 _TIFFDefaultStripSize(TIFF* tif, uint32 s)
 {
@@ -241,16 +265,20 @@ _TIFFDefaultStripSize(TIFF* tif, uint32 s)
 		/*
 		 * If RowsPerStrip is unspecified, try to break the
 		 * image up into strips that are approximately
-		 * STRIP_SIZE_DEFAULT bytes long.
+		 * _TIFFChunkSize() bytes long.
 		 */
 		uint64 scanlinesize;
 		uint64 rows;
 		scanlinesize=TIFFScanlineSize64(tif);
 		if (scanlinesize==0)
 			scanlinesize=1;
-		rows=(uint64)STRIP_SIZE_DEFAULT/scanlinesize;
+		rows=_TIFFChunkSize(tif)/scanlinesize;
 		if (rows==0)
 			rows=1;
+		else if (tif->tif_chunksize!=0 &&
+		    tif->tif_dir.td_imagelength!=0 &&
+		    rows>tif->tif_dir.td_imagelength)
+			rows=tif->tif_dir.td_imagelength;
 		else if (rows>0xFFFFFFFF)
 			rows=0xFFFFFFFF;
 		s=(uint32)rows;
@@ -287,7 +315,7 @@ TIFFScanlineSize64(TIFF* tif)
 			uint64 samplingrow_size;
 			if(td->td_samplesperpixel!=3)
 			{
-                            TIFFErrorExt(tif->tif_clientdata,module,
+                            TIFFErrorExtR(tif,module,
                                          "Invalid td_samplesperpixel value");
                             return 0;
 			}
@@ -297,7 +325,7 @@ TIFFScanlineSize64(TIFF* tif)
 			if (((ycbcrsubsampling[0]!=1)&&(ycbcrsubsampling[0]!=2)&&(ycbcrsubsampling[0]!=4)) ||
 			    ((ycbcrsubsampling[1]!=1)&&(ycbcrsubsampling[1]!=2)&&(ycbcrsubsampling[1]!=4)))
 			{
-                            TIFFErrorExt(tif->tif_clientdata,module,
+                            TIFFErrorExtR(tif,module,
                                          "Invalid YCbCr subsampling");
                             return 0;
 			}
@@ -320,7 +348,7 @@ TIFFScanlineSize64(TIFF* tif)
         }
         if (scanline_size == 0)
         {
-                TIFFErrorExt(tif->tif_clientdata,module,"Computed scanline size is zero");
+                TIFFErrorExtR(tif,module,"Computed scanline size is zero");
                 return 0;
         }
 	return(scanline_size);
@@ -334,7 +362,7 @@ TIFFScanlineSize(TIFF* tif)
 	m=TIFFScanlineSize64(tif);
 	n=(tmsize_t)m;
 	if ((uint64)n!=m) {
-		TIFFErrorExt(tif->tif_clientdata,module,"Integer arithmetic overflow");
+		TIFFErrorExtR(tif,module,"Integer arithmetic overflow");
 		n=0;
 	}
 	return(n);
@@ -371,7 +399,7 @@ TIFFRasterScanlineSize(TIFF* tif)
 	n=(tmsize_t)m;
 	if ((uint64)n!=m)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Integer arithmetic overflow");
+		TIFFErrorExtR(tif,module,"Integer arithmetic overflow");
 		n=0;
 	}
 	return(n);
@@ -28,6 +28,166 @@
  * XXX We assume short = 16-bits and long = 32-bits XXX
  */
 #include "tiffiop.h"
+#include <string.h>
+
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#elif defined(TIFF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * SIMD byte swapping of arrays, 16 bytes at a time.  The swab kernel
+ * swaps a prefix of the n elements of the given size (2, 4 or 8
+ * bytes, or 3 for triples) and returns the number of elements it
+ * handled; the caller finishes the array with scalar code.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSE2
+static tmsize_t
+swab16SSE2(uint8* cp, tmsize_t n)
+{
+	tmsize_t i;
+	__m128i x;
+
+	for (i = 0; i + 8 <= n; i += 8, cp += 16) {
+		x = _mm_loadu_si128((const __m128i*) cp);
+		x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+		_mm_storeu_si128((__m128i*) cp, x);
+	}
+	return (i);
+}
+
+/*
+ * 16 triples fill 3 vectors; a 0x80 (-128) index makes pshufb yield 0,
+ * so each output vector is the OR of the shuffles of the inputs it
+ * takes bytes from.
+ */
+TIFF_TARGET_SSSE3
+static tmsize_t
+swab24SSSE3(uint8* cp, tmsize_t n)
+{
+	const __m128i m00 = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7,
+	    6, 11, 10, 9, 14, 13, 12, -128);
+	const __m128i m01 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128,
+	    -128, -128, -128, -128, -128, -128, -128, -128, -128, 1);
+	const __m128i m10 = _mm_setr_epi8(-128, 15, -128, -128, -128, -128,
+	    -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+	const __m128i m11 = _mm_setr_epi8(0, -128, 4, 3, 2, 7, 6, 5,
+	    10, 9, 8, 13, 12, 11, -128, 15);
+	const __m128i m12 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128,
+	    -128, -128, -128, -128, -128, -128, -128, -128, 0, -128);
+	const __m128i m21 = _mm_setr_epi8(14, -128, -128, -128, -128, -128,
+	    -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+	const __m128i m22 = _mm_setr_epi8(-128, 3, 2, 1, 6, 5, 4, 9,
+	    8, 7, 12, 11, 10, 15, 14, 13);
+	tmsize_t i;
+	__m128i a, b, c;
+
+	for (i = 0; i + 16 <= n; i += 16, cp += 48) {
+		a = _mm_loadu_si128((const __m128i*) cp);
+		b = _mm_loadu_si128((const __m128i*) (cp + 16));
+		c = _mm_loadu_si128((const __m128i*) (cp + 32));
+		_mm_storeu_si128((__m128i*) cp, _mm_or_si128(
+		    _mm_shuffle_epi8(a, m00), _mm_shuffle_epi8(b, m01)));
+		_mm_storeu_si128((__m128i*) (cp + 16), _mm_or_si128(
+		    _mm_or_si128(_mm_shuffle_epi8(a, m10),
+		    _mm_shuffle_epi8(b, m11)), _mm_shuffle_epi8(c, m12)));
+		_mm_storeu_si128((__m128i*) (cp + 32), _mm_or_si128(
+		    _mm_shuffle_epi8(b, m21), _mm_shuffle_epi8(c, m22)));
+	}
+	return (i);
+}
+
+static tmsize_t
+swabSSE2(void* p, tmsize_t n, int size)
+{
+	return (size == 2 ? swab16SSE2((uint8*) p, n) : 0);
+}
+
+TIFF_TARGET_SSSE3
+static tmsize_t
+swabSSSE3(void* p, tmsize_t n, int size)
+{
+	uint8* cp = (uint8*) p;
+	tmsize_t nb = n * size, i;
+	__m128i m, x, y;
+
+	switch (size) {
+	case 2:
+		m = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+		    9, 8, 11, 10, 13, 12, 15, 14);
+		break;
+	case 3:
+		return swab24SSSE3(cp, n);
+	case 4:
+		m = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+		    11, 10, 9, 8, 15, 14, 13, 12);
+		break;
+	default:
+		m = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+		    15, 14, 13, 12, 11, 10, 9, 8);
+		break;
+	}
+	for (i = 0; i + 32 <= nb; i += 32, cp += 32) {
+		x = _mm_loadu_si128((const __m128i*) cp);
+		y = _mm_loadu_si128((const __m128i*) (cp + 16));
+		_mm_storeu_si128((__m128i*) cp, _mm_shuffle_epi8(x, m));
+		_mm_storeu_si128((__m128i*) (cp + 16), _mm_shuffle_epi8(y, m));
+	}
+	if (i + 16 <= nb) {
+		x = _mm_loadu_si128((const __m128i*) cp);
+		_mm_storeu_si128((__m128i*) cp, _mm_shuffle_epi8(x, m));
+		i += 16;
+	}
+	return (i / size);
+}
+#elif defined(TIFF_SIMD_NEON)
+static tmsize_t
+swabNEON(void* p, tmsize_t n, int size)
+{
+	uint8* cp = (uint8*) p;
+	tmsize_t nb = n * size, i;
+
+	if (size == 3) {
+		uint8x16x3_t t;
+		uint8x16_t x;
+
+		for (i = 0; i + 48 <= nb; i += 48, cp += 48) {
+			t = vld3q_u8(cp);
+			x = t.val[0]; t.val[0] = t.val[2]; t.val[2] = x;
+			vst3q_u8(cp, t);
+		}
+		return (i / 3);
+	}
+	for (i = 0; i + 16 <= nb; i += 16, cp += 16) {
+		uint8x16_t x = vld1q_u8(cp);
+
+		switch (size) {
+		case 2:
+			x = vrev16q_u8(x);
+			break;
+		case 4:
+			x = vrev32q_u8(x);
+			break;
+		default:
+			x = vrev64q_u8(x);
+			break;
+		}
+		vst1q_u8(cp, x);
+	}
+	return (i / size);
+}
+#endif
+
+static tmsize_t
+swabSIMD(void* p, tmsize_t n, int size)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return (k->swab != NULL ? (*k->swab)(p, n, size) : 0);
+}
 
 #if defined(DISABLE_CHECK_TIFFSWABMACROS) || !defined(TIFFSwabShort)
 void
@@ -72,8 +232,11 @@ TIFFSwabArrayOfShort(register uint16* wp, tmsize_t n)
 {
 	register unsigned char* cp;
 	register unsigned char t;
+	tmsize_t done;
 	assert(sizeof(uint16)==2);
-	/* XXX unroll loop some */
+	done = swabSIMD(wp, n, 2);
+	wp += done;
+	n -= done;
 	while (n-- > 0) {
 		cp = (unsigned char*) wp;
 		t = cp[1]; cp[1] = cp[0]; cp[0] = t;
@@ -88,8 +251,11 @@ TIFFSwabArrayOfTriples(register uint8* tp, tmsize_t n)
 {
 	unsigned char* cp;
 	unsigned char t;
+	tmsize_t done;
 
-	/* XXX unroll loop some */
+	done = swabSIMD(tp, n, 3);
+	tp += 3 * done;
+	n -= done;
 	while (n-- > 0) {
 		cp = (unsigned char*) tp;
 		t = cp[2]; cp[2] = cp[0]; cp[0] = t;
@@ -104,8 +270,11 @@ TIFFSwabArrayOfLong(register uint32* lp, tmsize_t n)
 {
 	register unsigned char *cp;
 	register unsigned char t;
+	tmsize_t done;
 	assert(sizeof(uint32)==4);
-	/* XXX unroll loop some */
+	done = swabSIMD(lp, n, 4);
+	lp += done;
+	n -= done;
 	while (n-- > 0) {
 		cp = (unsigned char *)lp;
 		t = cp[3]; cp[3] = cp[0]; cp[0] = t;
@@ -121,8 +290,11 @@ TIFFSwabArrayOfLong8(register uint64* lp, tmsize_t n)
 {
 	register unsigned char *cp;
 	register unsigned char t;
+	tmsize_t done;
 	assert(sizeof(uint64)==8);
-	/* XXX unroll loop some */
+	done = swabSIMD(lp, n, 8);
+	lp += done;
+	n -= done;
 	while (n-- > 0) {
 		cp = (unsigned char *)lp;
 		t = cp[7]; cp[7] = cp[0]; cp[0] = t;
@@ -152,8 +324,11 @@ TIFFSwabArrayOfFloat(register float* fp, tmsize_t n)
 {
 	register unsigned char *cp;
 	register unsigned char t;
+	tmsize_t done;
 	assert(sizeof(float)==4);
-	/* XXX unroll loop some */
+	done = swabSIMD(fp, n, 4);
+	fp += done;
+	n -= done;
 	while (n-- > 0) {
 		cp = (unsigned char *)fp;
 		t = cp[3]; cp[3] = cp[0]; cp[0] = t;
@@ -183,8 +358,11 @@ TIFFSwabArrayOfDouble(double* dp, tmsize_t n)
 {
 	register unsigned char *cp;
 	register unsigned char t;
+	tmsize_t done;
 	assert(sizeof(double)==8);
-	/* XXX unroll loop some */
+	done = swabSIMD(dp, n, 8);
+	dp += done;
+	n -= done;
 	while (n-- > 0) {
 		cp = (unsigned char *)dp;
 		t = cp[7]; cp[7] = cp[0]; cp[0] = t;
@@ -280,19 +458,107 @@ TIFFGetBitRevTable(int reversed)
 	return (reversed ? TIFFBitRevTable : TIFFNoBitRevTable);
 }
 
+/*
+ * SIMD bit reversal: each byte is split into nibbles that are
+ * reversed through a 16-entry table shuffle.  The kernel returns the
+ * number of bytes handled.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSSE3
+static tmsize_t
+reverseBitsSSSE3(uint8* cp, tmsize_t n)
+{
+	const __m128i lo = _mm_setr_epi8(0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a,
+	    0x06, 0x0e, 0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f);
+	const __m128i hi = _mm_slli_epi16(lo, 4);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	tmsize_t i;
+	__m128i x;
+
+	for (i = 0; i + 16 <= n; i += 16, cp += 16) {
+		x = _mm_loadu_si128((const __m128i*) cp);
+		x = _mm_or_si128(
+		    _mm_shuffle_epi8(hi, _mm_and_si128(x, mask)),
+		    _mm_shuffle_epi8(lo,
+		    _mm_and_si128(_mm_srli_epi16(x, 4), mask)));
+		_mm_storeu_si128((__m128i*) cp, x);
+	}
+	return (i);
+}
+#elif defined(TIFF_SIMD_NEON)
+static tmsize_t
+reverseBitsNEON(uint8* cp, tmsize_t n)
+{
+	tmsize_t i;
+#if defined(__aarch64__) || defined(_M_ARM64)
+	for (i = 0; i + 16 <= n; i += 16, cp += 16)
+		vst1q_u8(cp, vrbitq_u8(vld1q_u8(cp)));
+#else
+	static const uint8 rev4[8] = { 0x00, 0x08, 0x04, 0x0c,
+				       0x02, 0x0a, 0x06, 0x0e };
+	const uint8x8_t mask = vdup_n_u8(0x0f);
+	uint8x8x2_t lo;
+	uint8x8_t x;
+
+	lo.val[0] = vld1_u8(rev4);
+	lo.val[1] = vorr_u8(lo.val[0], vdup_n_u8(0x01));
+	for (i = 0; i + 8 <= n; i += 8, cp += 8) {
+		x = vld1_u8(cp);
+		x = vorr_u8(vshl_n_u8(vtbl2_u8(lo, vand_u8(x, mask)), 4),
+		    vtbl2_u8(lo, vshr_n_u8(x, 4)));
+		vst1_u8(cp, x);
+	}
+#endif
+	return (i);
+}
+#endif
+
+void
+_TIFFSwabKernels(TIFFKernels* k, int features)
+{
+#if defined(TIFF_SIMD_X86)
+	if (features & TIFF_CPU_SSE2)
+		k->swab = swabSSE2;
+	if ((features & (TIFF_CPU_SSE2|TIFF_CPU_SSSE3)) ==
+	    (TIFF_CPU_SSE2|TIFF_CPU_SSSE3)) {
+		k->swab = swabSSSE3;
+		k->reverseBits = reverseBitsSSSE3;
+	}
+#elif defined(TIFF_SIMD_NEON)
+	if (features & TIFF_CPU_NEON) {
+		k->swab = swabNEON;
+		k->reverseBits = reverseBitsNEON;
+	}
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+static tmsize_t
+reverseBitsSIMD(uint8* cp, tmsize_t n)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+
+	return (k->reverseBits != NULL ? (*k->reverseBits)(cp, n) : 0);
+}
+
 void
 TIFFReverseBits(uint8* cp, tmsize_t n)  
 {
-	for (; n > 8; n -= 8) {
-		cp[0] = TIFFBitRevTable[cp[0]];
-		cp[1] = TIFFBitRevTable[cp[1]];
-		cp[2] = TIFFBitRevTable[cp[2]];
-		cp[3] = TIFFBitRevTable[cp[3]];
-		cp[4] = TIFFBitRevTable[cp[4]];
-		cp[5] = TIFFBitRevTable[cp[5]];
-		cp[6] = TIFFBitRevTable[cp[6]];
-		cp[7] = TIFFBitRevTable[cp[7]];
-		cp += 8;
+	const uint64 ones = ~(uint64) 0 / 0xff;		/* 0x0101...01 */
+	tmsize_t done = reverseBitsSIMD(cp, n);
+	uint64 w;
+
+	cp += done;
+	n -= done;
+	/* swap adjacent bits, then bit pairs, then nibbles of each byte */
+	for (; n >= 8; n -= 8, cp += 8) {
+		memcpy(&w, cp, sizeof (w));
+		w = ((w >> 1) & (ones * 0x55)) | ((w & (ones * 0x55)) << 1);
+		w = ((w >> 2) & (ones * 0x33)) | ((w & (ones * 0x33)) << 2);
+		w = ((w >> 4) & (ones * 0x0f)) | ((w & (ones * 0x0f)) << 4);
+		memcpy(cp, &w, sizeof (w));
 	}
 	while (n-- > 0) {
 		*cp = TIFFBitRevTable[*cp];
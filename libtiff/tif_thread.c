@@ -0,0 +1,612 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Minimal portable threading primitives used internally by the
+ * parallel decoding routines.  POSIX threads are used when available,
+ * native threads on Windows; otherwise work is run serially on the
+ * calling thread.  Parallel tasks can also be run on a thread pool of
+ * the application instead.
+ */
+#include "tiffiop.h"
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifdef _WIN32
+# include <windows.h>
+#endif
+
+#if defined(THREADS_SUPPORT) && defined(HAVE_PTHREAD)
+# include <pthread.h>
+# define TIFF_THREADS_PTHREAD
+#elif defined(THREADS_SUPPORT) && defined(_WIN32)
+# define TIFF_THREADS_WIN32
+#endif
+
+struct _TIFFMutex {
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_mutex_t      mutex;
+#elif defined(TIFF_THREADS_WIN32)
+	CRITICAL_SECTION     cs;
+#else
+	int                  dummy;
+#endif
+};
+
+TIFFMutex*
+_TIFFMutexCreate(void)
+{
+	TIFFMutex* m = (TIFFMutex*) _TIFFmalloc(sizeof(TIFFMutex));
+
+	if (m == NULL)
+		return (NULL);
+#if defined(TIFF_THREADS_PTHREAD)
+	if (pthread_mutex_init(&m->mutex, NULL) != 0) {
+		_TIFFfree(m);
+		return (NULL);
+	}
+#elif defined(TIFF_THREADS_WIN32)
+	InitializeCriticalSection(&m->cs);
+#else
+	m->dummy = 0;
+#endif
+	return (m);
+}
+
+void
+_TIFFMutexDestroy(TIFFMutex* m)
+{
+	if (m == NULL)
+		return;
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_mutex_destroy(&m->mutex);
+#elif defined(TIFF_THREADS_WIN32)
+	DeleteCriticalSection(&m->cs);
+#endif
+	_TIFFfree(m);
+}
+
+void
+_TIFFMutexLock(TIFFMutex* m)
+{
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_mutex_lock(&m->mutex);
+#elif defined(TIFF_THREADS_WIN32)
+	EnterCriticalSection(&m->cs);
+#else
+	(void) m;
+#endif
+}
+
+void
+_TIFFMutexUnlock(TIFFMutex* m)
+{
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_mutex_unlock(&m->mutex);
+#elif defined(TIFF_THREADS_WIN32)
+	LeaveCriticalSection(&m->cs);
+#else
+	(void) m;
+#endif
+}
+
+struct _TIFFCond {
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_cond_t       cond;
+#elif defined(TIFF_THREADS_WIN32)
+	CONDITION_VARIABLE   cv;
+#else
+	int                  dummy;
+#endif
+};
+
+/*
+ * Condition variables, to wait with a TIFFMutex held until another
+ * thread has changed the state it protects.  Without thread support
+ * _TIFFCondWait() returns at once: the state can only have been
+ * changed by the caller itself.
+ */
+TIFFCond*
+_TIFFCondCreate(void)
+{
+	TIFFCond* c = (TIFFCond*) _TIFFmalloc(sizeof(TIFFCond));
+
+	if (c == NULL)
+		return (NULL);
+#if defined(TIFF_THREADS_PTHREAD)
+	if (pthread_cond_init(&c->cond, NULL) != 0) {
+		_TIFFfree(c);
+		return (NULL);
+	}
+#elif defined(TIFF_THREADS_WIN32)
+	InitializeConditionVariable(&c->cv);
+#else
+	c->dummy = 0;
+#endif
+	return (c);
+}
+
+void
+_TIFFCondDestroy(TIFFCond* c)
+{
+	if (c == NULL)
+		return;
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_cond_destroy(&c->cond);
+#endif
+	_TIFFfree(c);
+}
+
+/*
+ * Release m, which the caller holds, wait for c to be signalled and
+ * take m again.  Waits may also end spuriously, so the state has to
+ * be checked again on return.
+ */
+void
+_TIFFCondWait(TIFFCond* c, TIFFMutex* m)
+{
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_cond_wait(&c->cond, &m->mutex);
+#elif defined(TIFF_THREADS_WIN32)
+	SleepConditionVariableCS(&c->cv, &m->cs, INFINITE);
+#else
+	(void) c;
+	(void) m;
+#endif
+}
+
+/*
+ * Wake all the threads waiting on c.
+ */
+void
+_TIFFCondBroadcast(TIFFCond* c)
+{
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_cond_broadcast(&c->cond);
+#elif defined(TIFF_THREADS_WIN32)
+	WakeAllConditionVariable(&c->cv);
+#else
+	(void) c;
+#endif
+}
+
+/*
+ * A single library-wide lock, usable without prior setup, for the
+ * one-time construction of tables shared by all handles.
+ */
+#if defined(TIFF_THREADS_PTHREAD)
+static pthread_mutex_t globalmutex = PTHREAD_MUTEX_INITIALIZER;
+#elif defined(TIFF_THREADS_WIN32)
+static volatile LONG globallock = 0;
+#endif
+
+void
+_TIFFGlobalLock(void)
+{
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_mutex_lock(&globalmutex);
+#elif defined(TIFF_THREADS_WIN32)
+	while (InterlockedCompareExchange(&globallock, 1, 0) != 0)
+		Sleep(0);
+#endif
+}
+
+void
+_TIFFGlobalUnlock(void)
+{
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_mutex_unlock(&globalmutex);
+#elif defined(TIFF_THREADS_WIN32)
+	InterlockedExchange(&globallock, 0);
+#endif
+}
+
+/*
+ * Return non-zero if the library was built with thread support.
+ */
+int
+_TIFFHaveThreads(void)
+{
+#if defined(TIFF_THREADS_PTHREAD) || defined(TIFF_THREADS_WIN32)
+	return (1);
+#else
+	return (0);
+#endif
+}
+
+/*
+ * Return the number of online processors, or 1 if unknown.
+ */
+int
+_TIFFGetNumCPUs(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0 ? (int) info.dwNumberOfProcessors : 1);
+#elif defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0 ? (int) n : 1);
+#else
+	return (1);
+#endif
+}
+
+typedef struct {
+	void (*func)(void*);
+	void* arg;
+} TIFFThreadStart;
+
+struct _TIFFThread {
+	TIFFThreadStart      start;
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_t            thread;
+#elif defined(TIFF_THREADS_WIN32)
+	HANDLE               thread;
+#endif
+};
+
+#if defined(TIFF_THREADS_PTHREAD)
+static void*
+_TIFFThreadMain(void* p)
+{
+	TIFFThreadStart* start = (TIFFThreadStart*) p;
+
+	(*start->func)(start->arg);
+	return (NULL);
+}
+#elif defined(TIFF_THREADS_WIN32)
+static DWORD WINAPI
+_TIFFThreadMain(LPVOID p)
+{
+	TIFFThreadStart* start = (TIFFThreadStart*) p;
+
+	(*start->func)(start->arg);
+	return (0);
+}
+#endif
+
+/*
+ * Start func(arg) on a new thread.  Returns NULL if threads are not
+ * supported or the thread could not be created, in which case func
+ * has not been called.
+ */
+TIFFThread*
+_TIFFThreadCreate(void (*func)(void*), void* arg)
+{
+#if defined(TIFF_THREADS_PTHREAD) || defined(TIFF_THREADS_WIN32)
+	TIFFThread* t = (TIFFThread*) _TIFFmalloc(sizeof(TIFFThread));
+
+	if (t == NULL)
+		return (NULL);
+	t->start.func = func;
+	t->start.arg = arg;
+# if defined(TIFF_THREADS_PTHREAD)
+	if (pthread_create(&t->thread, NULL, _TIFFThreadMain, &t->start) != 0) {
+		_TIFFfree(t);
+		return (NULL);
+	}
+# else
+	t->thread = CreateThread(NULL, 0, _TIFFThreadMain, &t->start, 0, NULL);
+	if (t->thread == NULL) {
+		_TIFFfree(t);
+		return (NULL);
+	}
+# endif
+	return (t);
+#else
+	(void) func;
+	(void) arg;
+	return (NULL);
+#endif
+}
+
+/*
+ * Wait for a thread started by _TIFFThreadCreate() and release it.
+ */
+void
+_TIFFThreadJoin(TIFFThread* t)
+{
+	if (t == NULL)
+		return;
+#if defined(TIFF_THREADS_PTHREAD)
+	pthread_join(t->thread, NULL);
+#elif defined(TIFF_THREADS_WIN32)
+	WaitForSingleObject(t->thread, INFINITE);
+	CloseHandle(t->thread);
+#endif
+	_TIFFfree(t);
+}
+
+/*
+ * Run the invocations on threads started for them, the default when no
+ * thread pool is set.
+ */
+static int
+_TIFFRunOwnThreads(int nthreads, void (*func)(void*), void** args)
+{
+#if defined(TIFF_THREADS_PTHREAD) || defined(TIFF_THREADS_WIN32)
+	TIFFThreadStart* starts;
+# if defined(TIFF_THREADS_PTHREAD)
+	pthread_t* threads;
+# else
+	HANDLE* threads;
+# endif
+	char* started;
+	int i, nstarted = 1;
+
+	if (nthreads <= 1)
+		goto serial;
+	starts = (TIFFThreadStart*) _TIFFmalloc(nthreads * sizeof(TIFFThreadStart));
+	threads = _TIFFmalloc(nthreads * sizeof(*threads));
+	started = (char*) _TIFFmalloc(nthreads);
+	if (starts == NULL || threads == NULL || started == NULL) {
+		_TIFFfree(starts);
+		_TIFFfree(threads);
+		_TIFFfree(started);
+		goto serial;
+	}
+	for (i = 1; i < nthreads; i++) {
+		starts[i].func = func;
+		starts[i].arg = args[i];
+# if defined(TIFF_THREADS_PTHREAD)
+		started[i] = pthread_create(&threads[i], NULL,
+		    _TIFFThreadMain, &starts[i]) == 0;
+# else
+		threads[i] = CreateThread(NULL, 0, _TIFFThreadMain,
+		    &starts[i], 0, NULL);
+		started[i] = threads[i] != NULL;
+# endif
+		nstarted += started[i];
+	}
+	(*func)(args[0]);
+	for (i = 1; i < nthreads; i++) {
+		if (!started[i]) {
+			(*func)(args[i]);
+			continue;
+		}
+# if defined(TIFF_THREADS_PTHREAD)
+		pthread_join(threads[i], NULL);
+# else
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+# endif
+	}
+	_TIFFfree(starts);
+	_TIFFfree(threads);
+	_TIFFfree(started);
+	return (nstarted);
+serial:
+#endif
+	{
+		int j;
+
+		for (j = 0; j < nthreads; j++)
+			(*func)(args[j]);
+	}
+	return (1);
+}
+
+/*
+ * The pool used by handles opened without one, or a NULL submit method
+ * for threads started by the library itself.
+ */
+static TIFFThreadPool defaultpool;
+
+void
+TIFFSetDefaultThreadPool(const TIFFThreadPool* pool)
+{
+	_TIFFGlobalLock();
+	if (pool != NULL && pool->submit != NULL)
+		defaultpool = *pool;
+	else
+		_TIFFmemset(&defaultpool, 0, sizeof(TIFFThreadPool));
+	_TIFFGlobalUnlock();
+}
+
+/*
+ * Get the pool tasks of tif, or of no handle if tif is NULL, run on.
+ * Returns 0 for threads of the library's own.
+ */
+static int
+_TIFFGetThreadPool(TIFF* tif, TIFFThreadPool* pool)
+{
+	if (!_TIFFHaveThreads())
+		return (0);
+	if (tif != NULL && tif->tif_threadpool.submit != NULL) {
+		*pool = tif->tif_threadpool;
+		return (1);
+	}
+	_TIFFGlobalLock();
+	*pool = defaultpool;
+	_TIFFGlobalUnlock();
+	return (pool->submit != NULL);
+}
+
+/*
+ * Number of tasks worth running at once for tif when the caller did not
+ * say: the concurrency of its pool, else one per processor.
+ */
+int
+_TIFFThreadConcurrency(TIFF* tif)
+{
+	TIFFThreadPool pool;
+
+	if (_TIFFGetThreadPool(tif, &pool) && pool.concurrency > 0)
+		return (pool.concurrency);
+	return (_TIFFGetNumCPUs());
+}
+
+/*
+ * Tasks submitted to a pool without group methods are counted down as
+ * they end, for the caller to wait on.
+ */
+typedef struct {
+	TIFFMutex*           mutex;
+	TIFFCond*            cond;
+	int                  pending;
+} TIFFTaskGroup;
+
+typedef struct {
+	TIFFTaskGroup*       group;
+	void               (*func)(void*);
+	void*                arg;
+} TIFFTask;
+
+static void
+_TIFFTaskMain(void* p)
+{
+	TIFFTask* task = (TIFFTask*) p;
+	TIFFTaskGroup* group = task->group;
+
+	(*task->func)(task->arg);
+	_TIFFMutexLock(group->mutex);
+	if (--group->pending == 0)
+		_TIFFCondBroadcast(group->cond);
+	_TIFFMutexUnlock(group->mutex);
+}
+
+static int
+_TIFFRunPoolTasks(TIFFThreadPool* pool, int ntasks, void (*func)(void*),
+    void** args)
+{
+	TIFFTaskGroup own;
+	TIFFTask* tasks = NULL;
+	char* queued;
+	void* group = NULL;
+	int i, nqueued = 0;
+
+	queued = (char*) _TIFFmalloc(ntasks);
+	if (queued == NULL)
+		return (0);
+	own.mutex = NULL;
+	own.cond = NULL;
+	own.pending = 0;
+	if (pool->group_create != NULL && pool->group_wait != NULL) {
+		group = (*pool->group_create)(pool->user_data);
+		if (group == NULL) {
+			_TIFFfree(queued);
+			return (0);
+		}
+	} else {
+		tasks = (TIFFTask*) _TIFFmalloc(ntasks * sizeof(TIFFTask));
+		own.mutex = _TIFFMutexCreate();
+		own.cond = _TIFFCondCreate();
+		if (tasks == NULL || own.mutex == NULL || own.cond == NULL) {
+			_TIFFfree(tasks);
+			_TIFFMutexDestroy(own.mutex);
+			_TIFFCondDestroy(own.cond);
+			_TIFFfree(queued);
+			return (0);
+		}
+	}
+	for (i = 1; i < ntasks; i++) {
+		if (group != NULL) {
+			queued[i] = (*pool->submit)(pool->user_data, group,
+			    func, args[i]) != 0;
+		} else {
+			tasks[i].group = &own;
+			tasks[i].func = func;
+			tasks[i].arg = args[i];
+			_TIFFMutexLock(own.mutex);
+			own.pending++;
+			_TIFFMutexUnlock(own.mutex);
+			queued[i] = (*pool->submit)(pool->user_data, NULL,
+			    _TIFFTaskMain, &tasks[i]) != 0;
+			if (!queued[i]) {
+				_TIFFMutexLock(own.mutex);
+				own.pending--;
+				_TIFFMutexUnlock(own.mutex);
+			}
+		}
+		nqueued += queued[i];
+	}
+	(*func)(args[0]);
+	for (i = 1; i < ntasks; i++)
+		if (!queued[i])
+			(*func)(args[i]);
+	if (group != NULL)
+		(*pool->group_wait)(pool->user_data, group);
+	else {
+		_TIFFMutexLock(own.mutex);
+		while (own.pending > 0)
+			_TIFFCondWait(own.cond, own.mutex);
+		_TIFFMutexUnlock(own.mutex);
+		_TIFFMutexDestroy(own.mutex);
+		_TIFFCondDestroy(own.cond);
+		_TIFFfree(tasks);
+	}
+	_TIFFfree(queued);
+	return (nqueued + 1);
+}
+
+/*
+ * Run func(args[i]) for i in [0, ntasks) concurrently and wait for all
+ * of them to complete, on the thread pool of tif, else on the default
+ * pool, else on threads started for them.  The first invocation runs
+ * on the calling thread.  An invocation that cannot be handed over is
+ * run on the calling thread once the others have been, so every
+ * invocation happens exactly once.  Returns the number of invocations
+ * handed over plus one.
+ */
+int
+_TIFFRunTasks(TIFF* tif, int ntasks, void (*func)(void*), void** args)
+{
+	TIFFThreadPool pool;
+	int n;
+
+	if (ntasks > 1 && _TIFFGetThreadPool(tif, &pool)) {
+		n = _TIFFRunPoolTasks(&pool, ntasks, func, args);
+		if (n > 0)
+			return (n);
+		/* out of memory: nothing was handed over */
+		for (n = 0; n < ntasks; n++)
+			(*func)(args[n]);
+		return (1);
+	}
+	return (_TIFFRunOwnThreads(ntasks, func, args));
+}
+
+/*
+ * _TIFFRunTasks() for work not done on behalf of a handle.
+ */
+int
+_TIFFRunThreads(int nthreads, void (*func)(void*), void** args)
+{
+	return (_TIFFRunTasks(NULL, nthreads, func, args));
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
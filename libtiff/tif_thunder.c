@@ -72,7 +72,7 @@ ThunderSetupDecode(TIFF* tif)
 
         if( tif->tif_dir.td_bitspersample != 4 )
         {
-                TIFFErrorExt(tif->tif_clientdata, module,
+                TIFFErrorExtR(tif, module,
                              "Wrong bitspersample value (%d), Thunder decoder only supports 4bits per sample.",
                              (int) tif->tif_dir.td_bitspersample );
                 return 0;
@@ -143,14 +143,14 @@ ThunderDecode(TIFF* tif, uint8* op, tmsize_t maxpixels)
 	tif->tif_rawcc = cc;
 	if (npixels != maxpixels) {
 #if defined(__WIN32__) && (defined(_MSC_VER) || defined(__MINGW32__))
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "%s data at scanline %lu (%I64u != %I64u)",
 			     npixels < maxpixels ? "Not enough" : "Too much",
 			     (unsigned long) tif->tif_row,
 			     (unsigned __int64) npixels,
 			     (unsigned __int64) maxpixels);
 #else
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "%s data at scanline %lu (%llu != %llu)",
 			     npixels < maxpixels ? "Not enough" : "Too much",
 			     (unsigned long) tif->tif_row,
@@ -172,7 +172,7 @@ ThunderDecodeRow(TIFF* tif, uint8* buf, tmsize_t occ, uint16 s)
 	(void) s;
 	if (occ % tif->tif_scanlinesize)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "Fractional scanlines cannot be read");
+		TIFFErrorExtR(tif, module, "Fractional scanlines cannot be read");
 		return (0);
 	}
 	while (occ > 0) {
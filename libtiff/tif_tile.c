@@ -75,21 +75,21 @@ TIFFCheckTile(TIFF* tif, uint32 x, uint32 y, uint32 z, uint16 s)
 	TIFFDirectory *td = &tif->tif_dir;
 
 	if (x >= td->td_imagewidth) {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			     "%lu: Col out of range, max %lu",
 			     (unsigned long) x,
 			     (unsigned long) (td->td_imagewidth - 1));
 		return (0);
 	}
 	if (y >= td->td_imagelength) {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			     "%lu: Row out of range, max %lu",
 			     (unsigned long) y,
 			     (unsigned long) (td->td_imagelength - 1));
 		return (0);
 	}
 	if (z >= td->td_imagedepth) {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			     "%lu: Depth out of range, max %lu",
 			     (unsigned long) z,
 			     (unsigned long) (td->td_imagedepth - 1));
@@ -97,7 +97,7 @@ TIFFCheckTile(TIFF* tif, uint32 x, uint32 y, uint32 z, uint16 s)
 	}
 	if (td->td_planarconfig == PLANARCONFIG_SEPARATE &&
 	    s >= td->td_samplesperpixel) {
-		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
+		TIFFErrorExtR(tif, tif->tif_name,
 			     "%lu: Sample out of range, max %lu",
 			     (unsigned long) s,
 			     (unsigned long) (td->td_samplesperpixel - 1));
@@ -148,12 +148,12 @@ TIFFTileRowSize64(TIFF* tif)
 
 	if (td->td_tilelength == 0)
         {
-                TIFFErrorExt(tif->tif_clientdata,module,"Tile length is zero");
+                TIFFErrorExtR(tif,module,"Tile length is zero");
                 return 0;
         }
         if (td->td_tilewidth == 0)
         {
-                TIFFErrorExt(tif->tif_clientdata,module,"Tile width is zero");
+                TIFFErrorExtR(tif,module,"Tile width is zero");
 		return (0);
         }
 	rowsize = _TIFFMultiply64(tif, td->td_bitspersample, td->td_tilewidth,
@@ -162,7 +162,7 @@ TIFFTileRowSize64(TIFF* tif)
         {
                 if (td->td_samplesperpixel == 0)
                 {
-                        TIFFErrorExt(tif->tif_clientdata,module,"Samples per pixel is zero");
+                        TIFFErrorExtR(tif,module,"Samples per pixel is zero");
                         return 0;
                 }
 		rowsize = _TIFFMultiply64(tif, rowsize, td->td_samplesperpixel,
@@ -171,7 +171,7 @@ TIFFTileRowSize64(TIFF* tif)
         tilerowsize=TIFFhowmany8_64(rowsize);
         if (tilerowsize == 0)
         {
-                TIFFErrorExt(tif->tif_clientdata,module,"Computed tile row size is zero");
+                TIFFErrorExtR(tif,module,"Computed tile row size is zero");
                 return 0;
         }
 	return (tilerowsize);
@@ -186,7 +186,7 @@ TIFFTileRowSize(TIFF* tif)
 	n=(tmsize_t)m;
 	if ((uint64)n!=m)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Integer overflow");
+		TIFFErrorExtR(tif,module,"Integer overflow");
 		n=0;
 	}
 	return(n);
@@ -227,7 +227,7 @@ TIFFVTileSize64(TIFF* tif, uint32 nrows)
 		if ((ycbcrsubsampling[0] != 1 && ycbcrsubsampling[0] != 2 && ycbcrsubsampling[0] != 4)
 		    ||(ycbcrsubsampling[1] != 1 && ycbcrsubsampling[1] != 2 && ycbcrsubsampling[1] != 4))
 		{
-			TIFFErrorExt(tif->tif_clientdata,module,
+			TIFFErrorExtR(tif,module,
 				     "Invalid YCbCr subsampling (%dx%d)", 
 				     ycbcrsubsampling[0], 
 				     ycbcrsubsampling[1] );
@@ -253,7 +253,7 @@ TIFFVTileSize(TIFF* tif, uint32 nrows)
 	n=(tmsize_t)m;
 	if ((uint64)n!=m)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Integer overflow");
+		TIFFErrorExtR(tif,module,"Integer overflow");
 		n=0;
 	}
 	return(n);
@@ -277,7 +277,7 @@ TIFFTileSize(TIFF* tif)
 	n=(tmsize_t)m;
 	if ((uint64)n!=m)
 	{
-		TIFFErrorExt(tif->tif_clientdata,module,"Integer overflow");
+		TIFFErrorExtR(tif,module,"Integer overflow");
 		n=0;
 	}
 	return(n);
@@ -298,11 +298,33 @@ TIFFDefaultTileSize(TIFF* tif, uint32* tw, uint32* th)
 void
 _TIFFDefaultTileSize(TIFF* tif, uint32* tw, uint32* th)
 {
-	(void) tif;
+	TIFFDirectory *td = &tif->tif_dir;
+	uint32 side = 256;
+
+	if (tif->tif_chunksize != 0) {
+		/*
+		 * The largest square power of two tile of at most
+		 * _TIFFChunkSize() bytes, and no larger than the image needs.
+		 */
+		uint64 bits = _TIFFChunkSize(tif) * 8;
+		uint64 pixelbits = td->td_bitspersample;
+		uint32 extent = td->td_imagewidth > td->td_imagelength ?
+		    td->td_imagewidth : td->td_imagelength;
+
+		if (td->td_planarconfig == PLANARCONFIG_CONTIG)
+			pixelbits *= td->td_samplesperpixel;
+		if (pixelbits == 0)
+			pixelbits = 1;
+		side = 16;
+		while (side < 0x8000 &&
+		    (uint64) side * 2 * side * 2 * pixelbits <= bits &&
+		    (extent == 0 || side < extent))
+			side *= 2;
+	}
 	if (*(int32*) tw < 1)
-		*tw = 256;
+		*tw = side;
 	if (*(int32*) th < 1)
-		*th = 256;
+		*th = side;
 	/* roundup to a multiple of 16 per the spec */
 	if (*tw & 0xf)
 		*tw = TIFFroundup_32(*tw, 16);
@@ -29,6 +29,11 @@
 
 #include "tif_config.h"
 
+#if (defined(HAVE_FALLOCATE) || defined(HAVE_MEMFD_CREATE) || \
+    defined(__linux__)) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE	/* for fallocate(), memfd_create() and O_DIRECT */
+#endif
+
 #ifdef HAVE_SYS_TYPES_H
 # include <sys/types.h>
 #endif
@@ -157,11 +162,20 @@ _tiffSizeProc(thandle_t fd)
 #ifdef HAVE_MMAP
 #include <sys/mman.h>
 
+/*
+ * Files larger than this are not mapped on systems with 32-bit
+ * pointers, where a mapping of a large part of the address space is
+ * likely to make later allocations fail; they are read instead.
+ */
+#define TIFF_MAP_MAX_32 ((uint64) 1 << 30)
+
 static int
 _tiffMapProc(thandle_t fd, void** pbase, toff_t* psize)
 {
 	uint64 size64 = _tiffSizeProc(fd);
 	tmsize_t sizem = (tmsize_t)size64;
+	if (sizeof (void*) < 8 && size64 > TIFF_MAP_MAX_32)
+		return (0);
 	if ((uint64)sizem==size64) {
 		fd_as_handle_union_t fdh;
 		fdh.h = fd;
@@ -181,6 +195,48 @@ _tiffUnmapProc(thandle_t fd, void* base, toff_t size)
 	(void) fd;
 	(void) munmap(base, (off_t) size);
 }
+
+#ifdef HAVE_MADVISE
+/*
+ * Pass an access pattern hint for part of a mapping to the kernel.
+ * Sequential reads also ask for huge pages where the kernel can back
+ * the page cache with them, so that a scan takes fewer faults; other
+ * patterns turn that off again, since it would read 2MB per fault.
+ */
+static void
+_tiffMapAdviceProc(thandle_t fd, void* addr, tmsize_t len, int advice)
+{
+	static size_t pagesize = 0;
+	size_t skip;
+
+	(void) fd;
+	if (pagesize == 0) {
+		long ps = sysconf(_SC_PAGESIZE);
+		pagesize = ps > 0 ? (size_t) ps : 4096;
+	}
+	/* madvise() wants a page aligned address */
+	skip = (size_t) addr % pagesize;
+	addr = (char*) addr - skip;
+	len += (tmsize_t) skip;
+	switch (advice) {
+	case TIFF_MAP_SEQUENTIAL:
+		(void) madvise(addr, (size_t) len, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+		(void) madvise(addr, (size_t) len, MADV_HUGEPAGE);
+#endif
+		break;
+	case TIFF_MAP_WILLNEED:
+		(void) madvise(addr, (size_t) len, MADV_WILLNEED);
+		break;
+	default:
+		(void) madvise(addr, (size_t) len, MADV_NORMAL);
+#ifdef MADV_NOHUGEPAGE
+		(void) madvise(addr, (size_t) len, MADV_NOHUGEPAGE);
+#endif
+		break;
+	}
+}
+#endif
 #else /* !HAVE_MMAP */
 static int
 _tiffMapProc(thandle_t fd, void** pbase, toff_t* psize)
@@ -196,23 +252,875 @@ _tiffUnmapProc(thandle_t fd, void* base, toff_t size)
 }
 #endif /* !HAVE_MMAP */
 
+#ifdef HAVE_POSIX_FADVISE
+/*
+ * Tell the kernel that a byte range is about to be read.
+ */
+static void
+_tiffReadAheadProc(thandle_t fd, uint64 off, uint64 len)
+{
+	fd_as_handle_union_t fdh;
+	const off_t off_io = (off_t) off;
+	const off_t len_io = (off_t) len;
+
+	if ((uint64) off_io != off || (uint64) len_io != len)
+		return;
+	fdh.h = fd;
+	(void) posix_fadvise(fdh.fd, off_io, len_io, POSIX_FADV_WILLNEED);
+}
+#endif
+
+#ifdef HAVE_FALLOCATE
+/*
+ * Reserve disk space for a byte range without changing the file size,
+ * which libtiff uses to append.
+ */
+static int
+_tiffPreallocateProc(thandle_t fd, toff_t off, toff_t len)
+{
+	fd_as_handle_union_t fdh;
+	const off_t off_io = (off_t) off;
+	const off_t len_io = (off_t) len;
+
+	if ((uint64) off_io != off || (uint64) len_io != len || off_io < 0)
+		return (0);
+	fdh.h = fd;
+	return (fallocate(fdh.fd, FALLOC_FL_KEEP_SIZE, off_io, len_io) == 0);
+}
+#endif
+
+#ifdef HAVE_PREAD
+/*
+ * Read at an offset, without moving the file position.
+ */
+static tmsize_t
+_tiffReadAtProc(thandle_t fd, void* buf, tmsize_t size, uint64 off)
+{
+	fd_as_handle_union_t fdh;
+	const size_t bytes_total = (size_t) size;
+	size_t bytes_read;
+	tmsize_t count = -1;
+
+	if ((tmsize_t) bytes_total != size ||
+	    (uint64) (_TIFF_off_t) off != off)
+	{
+		errno=EINVAL;
+		return (tmsize_t) -1;
+	}
+	fdh.h = fd;
+	for (bytes_read=0; bytes_read < bytes_total; bytes_read+=count)
+	{
+		char *buf_offset = (char *) buf+bytes_read;
+		size_t io_size = bytes_total-bytes_read;
+		if (io_size > TIFF_IO_MAX)
+			io_size = TIFF_IO_MAX;
+		count=pread(fdh.fd, buf_offset, (TIFFIOSize_t) io_size,
+		    (_TIFF_off_t) (off + bytes_read));
+		if (count <= 0)
+			break;
+	}
+	if (count < 0)
+		return (tmsize_t)-1;
+	return (tmsize_t) bytes_read;
+}
+
+static tmsize_t
+_tiffWriteAtProc(thandle_t fd, void* buf, tmsize_t size, uint64 off)
+{
+	fd_as_handle_union_t fdh;
+	const size_t bytes_total = (size_t) size;
+	size_t bytes_written;
+	tmsize_t count = -1;
+
+	if ((tmsize_t) bytes_total != size ||
+	    (uint64) (_TIFF_off_t) off != off)
+	{
+		errno=EINVAL;
+		return (tmsize_t) -1;
+	}
+	fdh.h = fd;
+	for (bytes_written=0; bytes_written < bytes_total; bytes_written+=count)
+	{
+		const char *buf_offset = (char *) buf+bytes_written;
+		size_t io_size = bytes_total-bytes_written;
+		if (io_size > TIFF_IO_MAX)
+			io_size = TIFF_IO_MAX;
+		count=pwrite(fdh.fd, buf_offset, (TIFFIOSize_t) io_size,
+		    (_TIFF_off_t) (off + bytes_written));
+		if (count <= 0)
+			break;
+	}
+	if (count < 0)
+		return (tmsize_t)-1;
+	return (tmsize_t) bytes_written;
+}
+
+#ifdef IO_URING_SUPPORT
+/*
+ * Batched reads through io_uring: the requests of a batch are queued
+ * on a ring of their own, so that the device sees them all at once,
+ * and are completed in whatever order it finishes them.  The ring is
+ * driven with the bare system calls, so that no liburing is needed.
+ */
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#define URING_ENTRIES 64
+
+typedef struct {
+	int                  fd;
+	void*                sqmap;
+	size_t               sqmapsize;
+	void*                cqmap;
+	size_t               cqmapsize;
+	struct io_uring_sqe* sqes;
+	size_t               sqessize;
+	unsigned*            sqtail;
+	unsigned             sqmask;
+	unsigned*            sqarray;
+	unsigned*            cqhead;
+	unsigned*            cqtail;
+	unsigned             cqmask;
+	struct io_uring_cqe* cqes;
+	unsigned             entries;
+} uring_t;
+
+static void
+_tiffUringClose(uring_t* r)
+{
+	if (r->sqes != NULL)
+		munmap(r->sqes, r->sqessize);
+	if (r->cqmap != NULL)
+		munmap(r->cqmap, r->cqmapsize);
+	if (r->sqmap != NULL)
+		munmap(r->sqmap, r->sqmapsize);
+	close(r->fd);
+}
+
+static int
+_tiffUringSetup(uring_t* r, unsigned entries)
+{
+	struct io_uring_params p;
+	void* m;
+
+	memset(r, 0, sizeof (uring_t));
+	memset(&p, 0, sizeof (p));
+	r->fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+	if (r->fd < 0)
+		return (0);
+	r->sqmapsize = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+	r->cqmapsize = p.cq_off.cqes +
+	    p.cq_entries * sizeof (struct io_uring_cqe);
+	r->sqessize = p.sq_entries * sizeof (struct io_uring_sqe);
+	m = mmap(NULL, r->sqmapsize, PROT_READ|PROT_WRITE,
+	    MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (m == MAP_FAILED)
+		goto bad;
+	r->sqmap = m;
+	m = mmap(NULL, r->cqmapsize, PROT_READ|PROT_WRITE,
+	    MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+	if (m == MAP_FAILED)
+		goto bad;
+	r->cqmap = m;
+	m = mmap(NULL, r->sqessize, PROT_READ|PROT_WRITE,
+	    MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (m == MAP_FAILED)
+		goto bad;
+	r->sqes = (struct io_uring_sqe*) m;
+	r->sqtail = (unsigned*) ((char*) r->sqmap + p.sq_off.tail);
+	r->sqmask = *(unsigned*) ((char*) r->sqmap + p.sq_off.ring_mask);
+	r->sqarray = (unsigned*) ((char*) r->sqmap + p.sq_off.array);
+	r->cqhead = (unsigned*) ((char*) r->cqmap + p.cq_off.head);
+	r->cqtail = (unsigned*) ((char*) r->cqmap + p.cq_off.tail);
+	r->cqmask = *(unsigned*) ((char*) r->cqmap + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe*) ((char*) r->cqmap + p.cq_off.cqes);
+	r->entries = p.sq_entries;
+	return (1);
+bad:
+	_tiffUringClose(r);
+	return (0);
+}
+
+/*
+ * Queue a read of what is left of request i; the caller makes sure
+ * that the submission queue has room for it.
+ */
+static void
+_tiffUringQueue(uring_t* r, int fd, TIFFIORequest* reqs, struct iovec* iov,
+    uint32 i)
+{
+	unsigned tail = *r->sqtail;
+	unsigned slot = tail & r->sqmask;
+	struct io_uring_sqe* sqe = &r->sqes[slot];
+	size_t left = (size_t) (reqs[i].size - reqs[i].result);
+
+	iov[i].iov_base = (char*) reqs[i].buf + reqs[i].result;
+	iov[i].iov_len = left > TIFF_IO_MAX ? TIFF_IO_MAX : left;
+	memset(sqe, 0, sizeof (*sqe));
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = fd;
+	sqe->off = reqs[i].offset + (uint64) reqs[i].result;
+	sqe->addr = (uint64) (size_t) &iov[i];
+	sqe->len = 1;
+	sqe->user_data = i;
+	r->sqarray[slot] = slot;
+	__atomic_store_n(r->sqtail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static int
+_tiffReadBatchProc(thandle_t fd, TIFFIORequest* reqs, uint32 n)
+{
+	fd_as_handle_union_t fdh;
+	struct iovec* iov;
+	uring_t ring;
+	uint32 i, next = 0, left = n;
+	unsigned inflight = 0, tosubmit = 0;
+	int ret = 1;
+
+	fdh.h = fd;
+	for (i = 0; i < n; i++) {
+		reqs[i].result = 0;
+		if (reqs[i].size <= 0 ||
+		    (uint64) (_TIFF_off_t) reqs[i].offset != reqs[i].offset) {
+			reqs[i].result = reqs[i].size == 0 ? 0 : -1;
+			left--;
+		}
+	}
+	iov = (struct iovec*) _TIFFmalloc(n * sizeof (struct iovec));
+	if (iov == NULL || !_tiffUringSetup(&ring, URING_ENTRIES)) {
+		/* No ring, e.g. in a sandbox: read one request after another */
+		_TIFFfree(iov);
+		for (i = 0; i < n; i++)
+			if (reqs[i].size > 0 && reqs[i].result == 0)
+				reqs[i].result = _tiffReadAtProc(fd,
+				    reqs[i].buf, reqs[i].size, reqs[i].offset);
+		return (1);
+	}
+
+	while (left > 0) {
+		unsigned head, tail;
+		int cc;
+
+		while (next < n && inflight < ring.entries) {
+			if (reqs[next].size > 0 && reqs[next].result == 0) {
+				_tiffUringQueue(&ring, fdh.fd, reqs, iov, next);
+				inflight++;
+				tosubmit++;
+			}
+			next++;
+		}
+		cc = (int) syscall(__NR_io_uring_enter, ring.fd, tosubmit, 1,
+		    IORING_ENTER_GETEVENTS, NULL, 0);
+		if (cc < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			ret = 0;
+			break;
+		}
+		tosubmit -= (unsigned) cc < tosubmit ? (unsigned) cc : tosubmit;
+
+		head = *ring.cqhead;
+		tail = __atomic_load_n(ring.cqtail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++) {
+			struct io_uring_cqe* cqe = &ring.cqes[head & ring.cqmask];
+
+			i = (uint32) cqe->user_data;
+			inflight--;
+			if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+				/* retry as it was */
+			} else if (cqe->res < 0) {
+				reqs[i].result = -1;
+				left--;
+				continue;
+			} else if (cqe->res == 0) {
+				/* end of file: the request stays short */
+				left--;
+				continue;
+			} else {
+				reqs[i].result += cqe->res;
+				if (reqs[i].result >= reqs[i].size) {
+					left--;
+					continue;
+				}
+			}
+			/* the completion freed the entry the rest goes into */
+			_tiffUringQueue(&ring, fdh.fd, reqs, iov, i);
+			inflight++;
+			tosubmit++;
+		}
+		__atomic_store_n(ring.cqhead, head, __ATOMIC_RELEASE);
+	}
+	_tiffUringClose(&ring);
+	_TIFFfree(iov);
+	return (ret);
+}
+#endif /* IO_URING_SUPPORT */
+
+/*
+ * Positional I/O: the handle keeps its own file position and every
+ * read and write is a pread() or pwrite() at that position, so that
+ * handles sharing a descriptor do not disturb each other.
+ */
+typedef struct {
+	fd_as_handle_union_t fdh;
+	uint64               off;      /* file position of the handle */
+} posfd_t;
+
+static tmsize_t
+_tiffPosReadProc(thandle_t h, void* buf, tmsize_t size)
+{
+	posfd_t* p = (posfd_t*) h;
+	tmsize_t n = _tiffReadAtProc(p->fdh.h, buf, size, p->off);
+
+	if (n > 0)
+		p->off += n;
+	return (n);
+}
+
+static tmsize_t
+_tiffPosWriteProc(thandle_t h, void* buf, tmsize_t size)
+{
+	posfd_t* p = (posfd_t*) h;
+	tmsize_t n = _tiffWriteAtProc(p->fdh.h, buf, size, p->off);
+
+	if (n > 0)
+		p->off += n;
+	return (n);
+}
+
+static uint64
+_tiffPosSeekProc(thandle_t h, uint64 off, int whence)
+{
+	posfd_t* p = (posfd_t*) h;
+	uint64 base;
+
+	switch (whence) {
+	case SEEK_SET:
+		base = 0;
+		break;
+	case SEEK_CUR:
+		base = p->off;
+		break;
+	case SEEK_END:
+		base = _tiffSizeProc(p->fdh.h);
+		break;
+	default:
+		errno=EINVAL;
+		return (uint64) -1;
+	}
+	/* offsets are signed for SEEK_CUR and SEEK_END */
+	if ((int64) off < 0 && (uint64) -(int64) off > base) {
+		errno=EINVAL;
+		return (uint64) -1;
+	}
+	p->off = base + off;
+	return (p->off);
+}
+
+static int
+_tiffPosCloseProc(thandle_t h)
+{
+	posfd_t* p = (posfd_t*) h;
+	int fd = p->fdh.fd;
+
+	_TIFFfree(p);
+	return (close(fd));
+}
+
+static tmsize_t
+_tiffPosReadAtProc(thandle_t h, void* buf, tmsize_t size, uint64 off)
+{
+	return (_tiffReadAtProc(((posfd_t*) h)->fdh.h, buf, size, off));
+}
+
+static uint64
+_tiffPosSizeProc(thandle_t h)
+{
+	return (_tiffSizeProc(((posfd_t*) h)->fdh.h));
+}
+
+static int
+_tiffPosMapProc(thandle_t h, void** pbase, toff_t* psize)
+{
+	return (_tiffMapProc(((posfd_t*) h)->fdh.h, pbase, psize));
+}
+
+static void
+_tiffPosUnmapProc(thandle_t h, void* base, toff_t size)
+{
+	_tiffUnmapProc(((posfd_t*) h)->fdh.h, base, size);
+}
+
+#ifdef HAVE_POSIX_FADVISE
+static void
+_tiffPosReadAheadProc(thandle_t h, uint64 off, uint64 len)
+{
+	_tiffReadAheadProc(((posfd_t*) h)->fdh.h, off, len);
+}
+#endif
+
+#ifdef HAVE_FALLOCATE
+static int
+_tiffPosPreallocateProc(thandle_t h, toff_t off, toff_t len)
+{
+	return (_tiffPreallocateProc(((posfd_t*) h)->fdh.h, off, len));
+}
+#endif
+
+#ifdef IO_URING_SUPPORT
+static int
+_tiffPosReadBatchProc(thandle_t h, TIFFIORequest* reqs, uint32 n)
+{
+	return (_tiffReadBatchProc(((posfd_t*) h)->fdh.h, reqs, n));
+}
+#endif
+
+static TIFF*
+_tiffPosFdOpen(int fd, const char* name, const char* mode,
+    TIFFOpenOptions* opts)
+{
+	posfd_t* p = (posfd_t*) _TIFFmalloc(sizeof (posfd_t));
+	_TIFF_off_t cur;
+	TIFF* tif;
+
+	if (p == NULL) {
+		TIFFErrorExt(0, "TIFFFdOpen", "%s: Out of memory", name);
+		return (NULL);
+	}
+	p->fdh.fd = fd;
+	/* start where a handle using the descriptor's position would */
+	cur = _TIFF_lseek_f(fd, 0, SEEK_CUR);
+	p->off = cur < 0 ? 0 : (uint64) cur;
+	tif = TIFFClientOpenExt(name, mode, (thandle_t) p,
+	    _tiffPosReadProc, _tiffPosWriteProc,
+	    _tiffPosSeekProc, _tiffPosCloseProc, _tiffPosSizeProc,
+	    _tiffPosMapProc, _tiffPosUnmapProc, opts);
+	if (tif == NULL) {
+		_TIFFfree(p);
+		return (NULL);
+	}
+	tif->tif_fd = fd;
+#ifdef HAVE_POSIX_FADVISE
+	tif->tif_readaheadproc = _tiffPosReadAheadProc;
+#endif
+#ifdef HAVE_MADVISE
+	tif->tif_mapadviceproc = _tiffMapAdviceProc;
+#endif
+	tif->tif_readatproc = _tiffPosReadAtProc;
+#ifdef HAVE_FALLOCATE
+	if (tif->tif_preallocateproc == NULL)
+		tif->tif_preallocateproc = _tiffPosPreallocateProc;
+#endif
+#ifdef IO_URING_SUPPORT
+	tif->tif_readbatchproc = _tiffPosReadBatchProc;
+#endif
+	return (tif);
+}
+
+#ifdef O_DIRECT
+/*
+ * Direct I/O: writes of whole aligned blocks go through a second
+ * descriptor opened with O_DIRECT, bypassing the page cache, so that
+ * writing huge files does not evict the data other processes read.
+ * Sequential writes are collected in an aligned staging buffer, and
+ * written once it is full.  Writes before the first block boundary,
+ * the tail of the staged data when it has to be written early (before
+ * a read, a seek back or closing) and writes elsewhere in the file,
+ * such as directories and their links, use the buffered descriptor.
+ * Both descriptors are used positionally, as with positional I/O.
+ */
+#define TIFF_DIRECT_ALIGN	4096
+#define TIFF_DIRECT_STAGE	((tmsize_t) 1 << 20)
+
+typedef struct {
+	posfd_t              pos;      /* buffered descriptor and position */
+	int                  directfd; /* O_DIRECT descriptor, -1 once unusable */
+	void*                alloc;    /* stage, before alignment */
+	uint8*               stage;    /* aligned staging buffer */
+	uint64               stageoff; /* file offset of stage[0], aligned */
+	tmsize_t             stagelen; /* bytes held */
+} directfd_t;
+
+/*
+ * Write len bytes of the stage at its offset, the whole blocks directly
+ * and the rest through the page cache.
+ */
+static int
+_tiffDirectPut(directfd_t* d, tmsize_t len)
+{
+	tmsize_t whole = len & ~((tmsize_t) TIFF_DIRECT_ALIGN - 1);
+	ssize_t n = -1;
+
+	if (whole > 0 && d->directfd >= 0) {
+		n = pwrite(d->directfd, d->stage, (size_t) whole,
+		    (_TIFF_off_t) d->stageoff);
+		if (n < 0 && errno == EINVAL) {
+			/* not supported for this file after all */
+			close(d->directfd);
+			d->directfd = -1;
+		}
+	}
+	if (n != (ssize_t) whole)
+		whole = 0;
+	if (len > whole &&
+	    _tiffWriteAtProc(d->pos.fdh.h, d->stage + whole, len - whole,
+	    d->stageoff + (uint64) whole) != len - whole)
+		return (0);
+	return (1);
+}
+
+/*
+ * Write out the bytes staged.
+ */
+static int
+_tiffDirectFlush(directfd_t* d)
+{
+	tmsize_t len = d->stagelen;
+
+	if (len == 0)
+		return (1);
+	d->stagelen = 0;
+	return (_tiffDirectPut(d, len));
+}
+
+static tmsize_t
+_tiffDirectReadProc(thandle_t h, void* buf, tmsize_t size)
+{
+	directfd_t* d = (directfd_t*) h;
+
+	if (!_tiffDirectFlush(d))
+		return ((tmsize_t) -1);
+	return (_tiffPosReadProc((thandle_t) &d->pos, buf, size));
+}
+
+static tmsize_t
+_tiffDirectWriteProc(thandle_t h, void* buf, tmsize_t size)
+{
+	directfd_t* d = (directfd_t*) h;
+	const uint8* p = (const uint8*) buf;
+	tmsize_t left = size, n;
+
+	if (d->stagelen > 0 &&
+	    d->pos.off != d->stageoff + (uint64) d->stagelen &&
+	    !_tiffDirectFlush(d))
+		return ((tmsize_t) -1);
+	while (left > 0) {
+		if (d->stagelen == 0) {
+			uint64 skip = (uint64) (-(int64) d->pos.off) &
+			    (TIFF_DIRECT_ALIGN - 1);
+
+			if (d->directfd < 0 || skip >= (uint64) left) {
+				/* nothing to stage, or not up to a block */
+				n = _tiffPosWriteProc((thandle_t) &d->pos,
+				    (void*) p, left);
+				if (n < 0)
+					return ((tmsize_t) -1);
+				return (size - left + n);
+			}
+			if (skip > 0) {
+				n = _tiffPosWriteProc((thandle_t) &d->pos,
+				    (void*) p, (tmsize_t) skip);
+				if (n != (tmsize_t) skip)
+					return ((tmsize_t) -1);
+				p += n;
+				left -= n;
+			}
+			d->stageoff = d->pos.off;
+		}
+		n = TIFF_DIRECT_STAGE - d->stagelen;
+		if (n > left)
+			n = left;
+		_TIFFmemcpy(d->stage + d->stagelen, p, n);
+		d->stagelen += n;
+		d->pos.off += (uint64) n;
+		p += n;
+		left -= n;
+		if (d->stagelen == TIFF_DIRECT_STAGE && !_tiffDirectFlush(d))
+			return ((tmsize_t) -1);
+	}
+	return (size);
+}
+
+static uint64
+_tiffDirectSizeProc(thandle_t h)
+{
+	directfd_t* d = (directfd_t*) h;
+	uint64 size = _tiffSizeProc(d->pos.fdh.h);
+
+	if (d->stagelen > 0 && d->stageoff + (uint64) d->stagelen > size)
+		size = d->stageoff + (uint64) d->stagelen;
+	return (size);
+}
+
+static uint64
+_tiffDirectSeekProc(thandle_t h, uint64 off, int whence)
+{
+	directfd_t* d = (directfd_t*) h;
+
+	if (whence == SEEK_END) {
+		uint64 size = _tiffDirectSizeProc(h);
+
+		if ((int64) off < 0 && (uint64) -(int64) off > size) {
+			errno=EINVAL;
+			return (uint64) -1;
+		}
+		d->pos.off = size + off;
+		return (d->pos.off);
+	}
+	return (_tiffPosSeekProc((thandle_t) &d->pos, off, whence));
+}
+
+static int
+_tiffDirectCloseProc(thandle_t h)
+{
+	directfd_t* d = (directfd_t*) h;
+	int fd = d->pos.fdh.fd;
+	int ok = _tiffDirectFlush(d);
+
+	if (d->directfd >= 0)
+		close(d->directfd);
+	_TIFFfree(d->alloc);
+	_TIFFfree(d);
+	return (close(fd) == 0 && ok ? 0 : -1);
+}
+
+static int
+_tiffDirectMapProc(thandle_t h, void** pbase, toff_t* psize)
+{
+	(void) h; (void) pbase; (void) psize;
+	return (0);
+}
+
+static void
+_tiffDirectUnmapProc(thandle_t h, void* base, toff_t size)
+{
+	(void) h; (void) base; (void) size;
+}
+
+/*
+ * Open name, already open as fd, for direct writes as well.  If the
+ * file system does not support O_DIRECT, the handle writes through the
+ * page cache only.
+ */
+static TIFF*
+_tiffDirectOpen(int fd, const char* name, const char* mode,
+    TIFFOpenOptions* opts)
+{
+	directfd_t* d = (directfd_t*) _TIFFmalloc(sizeof (directfd_t));
+	TIFF* tif;
+
+	if (d == NULL) {
+		TIFFErrorExt(0, "TIFFOpen", "%s: Out of memory", name);
+		return (NULL);
+	}
+	_TIFFmemset(d, 0, sizeof (directfd_t));
+	d->alloc = _TIFFmalloc(TIFF_DIRECT_STAGE + TIFF_DIRECT_ALIGN);
+	if (d->alloc == NULL) {
+		TIFFErrorExt(0, "TIFFOpen", "%s: Out of memory", name);
+		_TIFFfree(d);
+		return (NULL);
+	}
+	d->stage = (uint8*) d->alloc + ((TIFF_DIRECT_ALIGN -
+	    ((size_t) d->alloc & (TIFF_DIRECT_ALIGN - 1))) &
+	    (TIFF_DIRECT_ALIGN - 1));
+	d->pos.fdh.fd = fd;
+	d->pos.off = 0;
+	d->directfd = open(name, O_WRONLY | O_DIRECT);
+	tif = TIFFClientOpenExt(name, mode, (thandle_t) d,
+	    _tiffDirectReadProc, _tiffDirectWriteProc,
+	    _tiffDirectSeekProc, _tiffDirectCloseProc, _tiffDirectSizeProc,
+	    _tiffDirectMapProc, _tiffDirectUnmapProc, opts);
+	if (tif == NULL) {
+		if (d->directfd >= 0)
+			close(d->directfd);
+		_TIFFfree(d->alloc);
+		_TIFFfree(d);
+		return (NULL);
+	}
+	tif->tif_fd = fd;
+#ifdef HAVE_FALLOCATE
+	if (tif->tif_preallocateproc == NULL)
+		tif->tif_preallocateproc = _tiffPosPreallocateProc;
+#endif
+	return (tif);
+}
+#endif /* O_DIRECT */
+#endif
+
 /*
  * Open a TIFF file descriptor for read/writing.
  */
 TIFF*
 TIFFFdOpen(int fd, const char* name, const char* mode)
+{
+	return (TIFFFdOpenExt(fd, name, mode, NULL));
+}
+
+TIFF*
+TIFFFdOpenExt(int fd, const char* name, const char* mode, TIFFOpenOptions* opts)
 {
 	TIFF* tif;
 
 	fd_as_handle_union_t fdh;
+#ifdef HAVE_POSIX_FADVISE
+	if (opts != NULL && opts->accesspattern != TIFF_ACCESS_NORMAL)
+		(void) posix_fadvise(fd, 0, 0,
+		    opts->accesspattern == TIFF_ACCESS_SEQUENTIAL ?
+		    POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+#endif
+#ifdef HAVE_PREAD
+	if (opts != NULL && opts->positionalio)
+		return (_tiffPosFdOpen(fd, name, mode, opts));
+#endif
 	fdh.fd = fd;
-	tif = TIFFClientOpen(name, mode,
+	/* A pipe or socket is written through TIFFOpenSequential() */
+	if (mode[0] == 'w' && lseek(fd, 0, SEEK_CUR) == (off_t) -1 &&
+	    errno == ESPIPE) {
+		tif = TIFFOpenSequential(name, mode, fdh.h, _tiffWriteProc,
+		    _tiffCloseProc, opts);
+		if (tif)
+			tif->tif_fd = fd;
+		return (tif);
+	}
+	tif = TIFFClientOpenExt(name, mode,
 	    fdh.h,
 	    _tiffReadProc, _tiffWriteProc,
 	    _tiffSeekProc, _tiffCloseProc, _tiffSizeProc,
-	    _tiffMapProc, _tiffUnmapProc);
+	    _tiffMapProc, _tiffUnmapProc, opts);
 	if (tif)
+	{
 		tif->tif_fd = fd;
+#ifdef HAVE_POSIX_FADVISE
+		tif->tif_readaheadproc = _tiffReadAheadProc;
+#endif
+#ifdef HAVE_MADVISE
+		tif->tif_mapadviceproc = _tiffMapAdviceProc;
+#endif
+#ifdef HAVE_PREAD
+		tif->tif_readatproc = _tiffReadAtProc;
+#endif
+#ifdef HAVE_FALLOCATE
+		if (tif->tif_preallocateproc == NULL)
+			tif->tif_preallocateproc = _tiffPreallocateProc;
+#endif
+#ifdef IO_URING_SUPPORT
+		tif->tif_readbatchproc = _tiffReadBatchProc;
+#endif
+	}
+	return (tif);
+}
+
+/*
+ * Shared memory files, to hand a TIFF to another process without a
+ * round trip through the file system: the writer builds the file in an
+ * anonymous segment and passes the descriptor on (over fork(), or as
+ * SCM_RIGHTS data on a socket), and the reader maps the same pages.
+ */
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
+
+int
+TIFFCreateSharedMemory(const char* name)
+{
+	static const char module[] = "TIFFCreateSharedMemory";
+	int fd = -1;
+
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+		TIFFErrorExt(0, module, "%s: %s", name, strerror(errno));
+#else
+	TIFFErrorExt(0, module,
+	    "%s: Shared memory files are not supported", name);
+#endif
+	return (fd);
+}
+
+#if defined(HAVE_PREAD) && defined(F_ADD_SEALS)
+/*
+ * The file is complete: seal the segment, so that its readers can map
+ * it without fearing that it changes or shrinks under them.
+ */
+static int
+_tiffShmCloseProc(thandle_t h)
+{
+	(void) fcntl(((posfd_t*) h)->fdh.fd, F_ADD_SEALS,
+	    F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE);
+	return (_tiffPosCloseProc(h));
+}
+#endif
+
+TIFF*
+TIFFOpenSharedMemory(int fd, const char* name, const char* mode)
+{
+	return (TIFFOpenSharedMemoryExt(fd, name, mode, NULL));
+}
+
+TIFF*
+TIFFOpenSharedMemoryExt(int fd, const char* name, const char* mode,
+    TIFFOpenOptions* opts)
+{
+	static const char module[] = "TIFFOpenSharedMemory";
+	char* unmapped = NULL;
+	int m, sfd;
+	TIFF* tif;
+
+	m = _TIFFgetMode(mode, module);
+	if (m == -1)
+		return ((TIFF*)0);
+	/* the handle closes a descriptor of its own */
+#ifdef F_DUPFD_CLOEXEC
+	sfd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+#else
+	sfd = dup(fd);
+#endif
+	if (sfd < 0 || ((m & O_TRUNC) && ftruncate(sfd, 0) != 0)) {
+		TIFFErrorExt(0, module, "%s: %s", name, strerror(errno));
+		if (sfd >= 0)
+			close(sfd);
+		return ((TIFF*)0);
+	}
+#ifdef F_ADD_SEALS
+	if ((m & O_ACCMODE) == O_RDONLY) {
+		int seals;
+
+		/*
+		 * If the writer could still truncate the segment, touching
+		 * a mapping of it would fault; forbid that, or failing that
+		 * read the file instead of mapping it.
+		 */
+		(void) fcntl(sfd, F_ADD_SEALS, F_SEAL_SHRINK);
+		seals = fcntl(sfd, F_GET_SEALS);
+		if (seals >= 0 && !(seals & F_SEAL_SHRINK)) {
+			unmapped = (char*) _TIFFmalloc((tmsize_t) strlen(mode) + 2);
+			if (unmapped == NULL) {
+				TIFFErrorExt(0, module, "%s: Out of memory", name);
+				close(sfd);
+				return ((TIFF*)0);
+			}
+			strcpy(unmapped, mode);
+			strcat(unmapped, "m");
+			mode = unmapped;
+		}
+	}
+#endif
+	/* the descriptor may have been left anywhere by the writer */
+	(void) lseek(sfd, 0, SEEK_SET);
+#ifdef HAVE_PREAD
+	tif = _tiffPosFdOpen(sfd, name, mode, opts);
+#ifdef F_ADD_SEALS
+	if (tif != NULL && (m & O_ACCMODE) != O_RDONLY)
+		tif->tif_closeproc = _tiffShmCloseProc;
+#endif
+#else
+	tif = TIFFFdOpenExt(sfd, name, mode, opts);
+#endif
+	_TIFFfree(unmapped);
+	if (tif == NULL)
+		close(sfd);
 	return (tif);
 }
 
@@ -221,6 +1129,12 @@ TIFFFdOpen(int fd, const char* name, const char* mode)
  */
 TIFF*
 TIFFOpen(const char* name, const char* mode)
+{
+	return (TIFFOpenExt(name, mode, NULL));
+}
+
+TIFF*
+TIFFOpenExt(const char* name, const char* mode, TIFFOpenOptions* opts)
 {
 	static const char module[] = "TIFFOpen";
 	int m, fd;
@@ -244,8 +1158,41 @@ TIFFOpen(const char* name, const char* mode)
 		}
 		return ((TIFF *)0);
 	}
+#ifdef S_ISFIFO
+	/*
+	 * Through a descriptor that can also read a pipe, the writer is a
+	 * reader of its own output: it would block once the others stop
+	 * reading instead of getting EPIPE.  Write pipes and sockets named
+	 * like /dev/stdout through a write-only descriptor.
+	 */
+	if (mode[0] == 'w') {
+		struct stat sb;
+
+		if (fstat(fd, &sb) == 0 && (S_ISFIFO(sb.st_mode)
+#ifdef S_ISSOCK
+		    || S_ISSOCK(sb.st_mode)
+#endif
+		    )) {
+			int wfd = open(name, (m & ~(O_ACCMODE | O_CREAT |
+			    O_TRUNC)) | O_WRONLY);
+
+			close(fd);
+			if (wfd < 0) {
+				TIFFErrorExt(0, module, "%s: %s", name,
+				    strerror(errno));
+				return ((TIFF *)0);
+			}
+			fd = wfd;
+		}
+	}
+#endif
 
-	tif = TIFFFdOpen((int)fd, name, mode);
+#if defined(HAVE_PREAD) && defined(O_DIRECT)
+	if (opts != NULL && opts->directio && (m & O_ACCMODE) != O_RDONLY)
+		tif = _tiffDirectOpen(fd, name, mode, opts);
+	else
+#endif
+	tif = TIFFFdOpenExt((int)fd, name, mode, opts);
 	if(!tif)
 		close(fd);
 	return tif;
@@ -258,6 +1205,12 @@ TIFFOpen(const char* name, const char* mode)
  */
 TIFF*
 TIFFOpenW(const wchar_t* name, const char* mode)
+{
+	return (TIFFOpenWExt(name, mode, NULL));
+}
+
+TIFF*
+TIFFOpenWExt(const wchar_t* name, const char* mode, TIFFOpenOptions* opts)
 {
 	static const char module[] = "TIFFOpenW";
 	int m, fd;
@@ -294,8 +1247,8 @@ TIFFOpenW(const wchar_t* name, const char* mode)
 				    NULL, NULL);
 	}
 
-	tif = TIFFFdOpen((int)fd, (mbname != NULL) ? mbname : "<unknown>",
-			 mode);
+	tif = TIFFFdOpenExt((int)fd, (mbname != NULL) ? mbname : "<unknown>",
+			    mode, opts);
 	
 	_TIFFfree(mbname);
 	
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library.
+ *
+ * Expansion of packed 1, 2, 4 and 12-bit samples to byte and
+ * 16-bit arrays.
+ *
+ * Samples of 8 bits or less go through a table of their 2^bps output
+ * values, built from the caller's map or from the scaling and
+ * inversion flags, so all the options cost the same.
+ */
+#include "tiffiop.h"
+#include <string.h>
+
+#if defined(TIFF_SIMD_X86)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+/*
+ * SIMD kernels.  Each expands a multiple of 16 (8 for 12-bit) of the
+ * n samples, so the caller resumes on a byte boundary, and returns
+ * how many it did.  The sub-byte kernels look the samples up in a
+ * table of 16 byte values.
+ */
+#if defined(TIFF_SIMD_X86)
+TIFF_TARGET_SSE2
+static tmsize_t
+unpack1SSE2(uint8* dst, const uint8* src, tmsize_t n, const uint8* values)
+{
+	const __m128i bits = _mm_setr_epi8(-128, 0x40, 0x20, 0x10, 0x08,
+	    0x04, 0x02, 0x01, -128, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	const __m128i v0 = _mm_set1_epi8((char) values[0]);
+	const __m128i dv = _mm_xor_si128(v0, _mm_set1_epi8((char) values[1]));
+	tmsize_t i;
+	__m128i x;
+
+	for (i = 0; i + 16 <= n; i += 16, src += 2) {
+		/* each byte spread over 8 lanes, one bit tested per lane */
+		x = _mm_cvtsi32_si128(src[0] | (src[1] << 8));
+		x = _mm_unpacklo_epi8(x, x);
+		x = _mm_unpacklo_epi16(x, x);
+		x = _mm_unpacklo_epi32(x, x);
+		x = _mm_cmpeq_epi8(_mm_and_si128(x, bits), bits);
+		_mm_storeu_si128((__m128i*) (dst + i),
+		    _mm_xor_si128(v0, _mm_and_si128(x, dv)));
+	}
+	return (i);
+}
+
+TIFF_TARGET_SSSE3
+static tmsize_t
+unpack2SSSE3(uint8* dst, const uint8* src, tmsize_t n, const uint8* values)
+{
+	const __m128i table = _mm_loadu_si128((const __m128i*) values);
+	const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1,
+	    2, 2, 2, 2, 3, 3, 3, 3);
+	const __m128i hibit = _mm_setr_epi8(-128, 0x20, 0x08, 0x02,
+	    -128, 0x20, 0x08, 0x02, -128, 0x20, 0x08, 0x02,
+	    -128, 0x20, 0x08, 0x02);
+	const __m128i lobit = _mm_srli_epi16(hibit, 1);
+	const __m128i two = _mm_set1_epi8(2);
+	const __m128i one = _mm_set1_epi8(1);
+	tmsize_t i;
+	uint32 w;
+	__m128i x, idx;
+
+	for (i = 0; i + 16 <= n; i += 16, src += 4) {
+		memcpy(&w, src, sizeof (w));
+		x = _mm_shuffle_epi8(_mm_cvtsi32_si128((int) w), spread);
+		idx = _mm_or_si128(
+		    _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(x, hibit),
+		    hibit), two),
+		    _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(x, lobit),
+		    lobit), one));
+		_mm_storeu_si128((__m128i*) (dst + i),
+		    _mm_shuffle_epi8(table, idx));
+	}
+	return (i);
+}
+
+TIFF_TARGET_SSSE3
+static tmsize_t
+unpack4SSSE3(uint8* dst, const uint8* src, tmsize_t n, const uint8* values)
+{
+	const __m128i table = _mm_loadu_si128((const __m128i*) values);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	tmsize_t i;
+	__m128i x, idx;
+
+	for (i = 0; i + 16 <= n; i += 16, src += 8) {
+		x = _mm_loadl_epi64((const __m128i*) src);
+		idx = _mm_unpacklo_epi8(
+		    _mm_and_si128(_mm_srli_epi16(x, 4), mask),
+		    _mm_and_si128(x, mask));
+		_mm_storeu_si128((__m128i*) (dst + i),
+		    _mm_shuffle_epi8(table, idx));
+	}
+	return (i);
+}
+
+/*
+ * 12-bit: every 3 bytes hold 2 samples.  Each pair of source bytes is
+ * moved into a 16-bit lane in big-endian order; even samples are then
+ * the top 12 bits of their lane and odd samples the bottom 12.
+ */
+TIFF_TARGET_SSSE3
+static tmsize_t
+unpack12SSSE3(uint16* dst, const uint8* src, tmsize_t n)
+{
+	const __m128i gather = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+	    7, 6, 8, 7, 10, 9, 11, 10);
+	const __m128i even = _mm_set1_epi32(0x0000ffff);
+	const __m128i low12 = _mm_set1_epi16(0x0fff);
+	tmsize_t i;
+	__m128i x;
+
+	/* 16-byte loads, so stop while they stay inside the source */
+	for (i = 0; i + 8 <= n && (i / 2) * 3 + 16 <= (n * 3 + 1) / 2;
+	    i += 8, src += 12) {
+		x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) src),
+		    gather);
+		x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 4), even),
+		    _mm_andnot_si128(even, _mm_and_si128(x, low12)));
+		_mm_storeu_si128((__m128i*) (dst + i), x);
+	}
+	return (i);
+}
+#endif
+
+void
+_TIFFUnpackKernels(TIFFKernels* k, int features)
+{
+#if defined(TIFF_SIMD_X86)
+	if (features & TIFF_CPU_SSE2)
+		k->unpack1 = unpack1SSE2;
+	if ((features & (TIFF_CPU_SSE2|TIFF_CPU_SSSE3)) ==
+	    (TIFF_CPU_SSE2|TIFF_CPU_SSSE3)) {
+		k->unpack2 = unpack2SSSE3;
+		k->unpack4 = unpack4SSSE3;
+		k->unpack12 = unpack12SSSE3;
+	}
+#else
+	(void) k;
+	(void) features;
+#endif
+}
+
+/*
+ * Expand n samples of 1, 2 or 4 bits through a table of (at least 16)
+ * byte values.
+ */
+static void
+unpackBits(uint8* dst, const uint8* src, tmsize_t n, uint16 bps,
+    const uint8* values)
+{
+	const TIFFKernels* k = _TIFFGetKernels();
+	tmsize_t (*kernel)(uint8*, const uint8*, tmsize_t, const uint8*);
+	int ppb = 8 / bps, mask = (1 << bps) - 1;
+	tmsize_t done;
+	int s;
+	uint8 b;
+
+	kernel = bps == 1 ? k->unpack1 : bps == 2 ? k->unpack2 : k->unpack4;
+	done = kernel != NULL ? (*kernel)(dst, src, n, values) : 0;
+	dst += done;
+	src += done / ppb;
+	n -= done;
+	for (; n >= ppb; n -= ppb) {
+		b = *src++;
+		for (s = 8 - bps; s >= 0; s -= bps)
+			*dst++ = values[(b >> s) & mask];
+	}
+	if (n > 0) {
+		b = *src;
+		for (s = 8 - bps; n > 0; n--, s -= bps)
+			*dst++ = values[(b >> s) & mask];
+	}
+}
+
+/*
+ * Output value of sample v of a bps-bit image for the flags, in an
+ * output range of outbits bits.
+ */
+static uint32
+unpackValue(uint32 v, uint16 bps, int flags, int outbits)
+{
+	uint32 max = ((uint32) 1 << bps) - 1;
+
+	if (flags & TIFF_UNPACK_SCALE) {
+		/* replicate the bits of v: exact for bps dividing outbits */
+		uint32 s = 0;
+		int shift;
+
+		for (shift = outbits - bps; shift > -(int) bps; shift -= bps)
+			s |= shift >= 0 ? v << shift : v >> -shift;
+		v = s;
+		max = ((uint32) 1 << outbits) - 1;
+	}
+	if (flags & TIFF_UNPACK_INVERT)
+		v = max - v;
+	return (v);
+}
+
+static int
+unpackCheck(const char* module, uint16 bps, int outbits)
+{
+	if (bps == 1 || bps == 2 || bps == 4 || bps == 8 ||
+	    (outbits == 16 && (bps == 12 || bps == 16)))
+		return (1);
+	TIFFErrorExt(0, module,
+	    "Cannot unpack %d-bit samples to %d bits", bps, outbits);
+	return (0);
+}
+
+/*
+ * Expand nsamples packed samples of bitspersample (1, 2, 4 or 8) bits,
+ * as found in decoded strips and tiles, to one byte each.  A sample is
+ * replaced by map[sample] if map is not NULL, and otherwise is kept
+ * as it is, scaled to the range 0-255 by TIFF_UNPACK_SCALE and
+ * complemented (min-is-white) by TIFF_UNPACK_INVERT.
+ */
+int
+TIFFUnpackSamples8(uint8* dst, const uint8* src, tmsize_t nsamples,
+    uint16 bitspersample, int flags, const uint8* map)
+{
+	static const char module[] = "TIFFUnpackSamples8";
+	uint8 values[256];
+	uint32 v, nvalues;
+	tmsize_t i;
+
+	if (!unpackCheck(module, bitspersample, 8))
+		return (0);
+	nvalues = (uint32) 1 << bitspersample;
+	if (bitspersample == 8 && map == NULL && flags == 0) {
+		_TIFFmemcpy(dst, src, nsamples);
+		return (1);
+	}
+	_TIFFmemset(values, 0, sizeof (values));
+	for (v = 0; v < nvalues; v++)
+		values[v] = map != NULL ? map[v] :
+		    (uint8) unpackValue(v, bitspersample, flags, 8);
+	if (bitspersample == 8) {
+		for (i = 0; i < nsamples; i++)
+			dst[i] = values[src[i]];
+	} else
+		unpackBits(dst, src, nsamples, bitspersample, values);
+	return (1);
+}
+
+/*
+ * Expand nsamples packed samples of bitspersample (1, 2, 4, 8, 12 or
+ * 16) bits to 16 bits each, as TIFFUnpackSamples8() does.  16-bit
+ * samples are in the native byte order, as decoded by the library;
+ * the map of 12 and 16-bit samples has 4096 and 65536 entries.
+ */
+int
+TIFFUnpackSamples16(uint16* dst, const uint8* src, tmsize_t nsamples,
+    uint16 bitspersample, int flags, const uint16* map)
+{
+	static const char module[] = "TIFFUnpackSamples16";
+	uint8 identity[16], idx[256];
+	uint16 values[256];
+	uint32 v, nvalues;
+	tmsize_t i, done, n;
+
+	if (!unpackCheck(module, bitspersample, 16))
+		return (0);
+	if (bitspersample == 12) {
+		const TIFFKernels* k = _TIFFGetKernels();
+
+		done = k->unpack12 != NULL ?
+		    (*k->unpack12)(dst, src, nsamples) : 0;
+		for (i = done, src += done / 2 * 3; i + 2 <= nsamples;
+		    i += 2, src += 3) {
+			dst[i] = (uint16) ((src[0] << 4) | (src[1] >> 4));
+			dst[i + 1] = (uint16) (((src[1] & 0x0f) << 8) | src[2]);
+		}
+		if (i < nsamples)
+			dst[i] = (uint16) ((src[0] << 4) | (src[1] >> 4));
+	} else if (bitspersample == 16)
+		memmove(dst, src, nsamples * sizeof (uint16));
+	if (bitspersample >= 12) {
+		if (map != NULL) {
+			for (i = 0; i < nsamples; i++)
+				dst[i] = map[dst[i]];
+		} else if (flags != 0) {
+			for (i = 0; i < nsamples; i++)
+				dst[i] = (uint16) unpackValue(dst[i],
+				    bitspersample, flags, 16);
+		}
+		return (1);
+	}
+	nvalues = (uint32) 1 << bitspersample;
+	for (v = 0; v < nvalues; v++)
+		values[v] = map != NULL ? map[v] :
+		    (uint16) unpackValue(v, bitspersample, flags, 16);
+	if (bitspersample == 8) {
+		for (i = 0; i < nsamples; i++)
+			dst[i] = values[src[i]];
+		return (1);
+	}
+	/* sample numbers first, a byte-aligned chunk at a time */
+	for (v = 0; v < 16; v++)
+		identity[v] = (uint8) v;
+	for (i = 0; i < nsamples; i += n) {
+		n = nsamples - i;
+		if (n > (tmsize_t) sizeof (idx))
+			n = sizeof (idx);
+		unpackBits(idx, src + i * bitspersample / 8, n,
+		    bitspersample, identity);
+		for (done = 0; done < n; done++)
+			dst[i + done] = values[idx[done]];
+	}
+	return (1);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
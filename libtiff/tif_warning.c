@@ -77,6 +77,38 @@ TIFFWarningExt(thandle_t fd, const char* module, const char* fmt, ...)
 	}
 }
 
+/*
+ * Report a warning of a handle as TIFFErrorExtR() does errors.  Handles
+ * opened with warnings disabled drop them before anything is formatted.
+ */
+void
+TIFFWarningExtR(TIFF* tif, const char* module, const char* fmt, ...)
+{
+	va_list ap;
+	if (tif != NULL && (tif->tif_flags & TIFF_NOWARNINGS))
+		return;
+	if (tif != NULL && tif->tif_warnhandler) {
+		int stop;
+
+		va_start(ap, fmt);
+		stop = (*tif->tif_warnhandler)(tif,
+		    tif->tif_warnhandler_user_data, module, fmt, ap);
+		va_end(ap);
+		if (stop)
+			return;
+	}
+	if (_TIFFwarningHandler) {
+		va_start(ap, fmt);
+		(*_TIFFwarningHandler)(module, fmt, ap);
+		va_end(ap);
+	}
+	if (_TIFFwarningHandlerExt) {
+		va_start(ap, fmt);
+		(*_TIFFwarningHandlerExt)(tif ? tif->tif_clientdata : 0,
+		    module, fmt, ap);
+		va_end(ap);
+	}
+}
 
 /*
  * Local Variables:
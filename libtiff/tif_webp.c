@@ -0,0 +1,580 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include "tiffiop.h"
+#ifdef WEBP_SUPPORT
+/*
+ * TIFF Library.
+ *
+ * WebP Compression Support
+ *
+ * Each strip or tile of 8 bit RGB or RGBA contiguous data is stored as
+ * one WebP image, lossy at TIFFTAG_WEBP_LEVEL quality or lossless when
+ * TIFFTAG_WEBP_LOSSLESS is set.  Lossless images keep the colour of
+ * fully transparent pixels.  Whole tiles and strips are encoded straight
+ * from the caller's buffer into the raw data buffer and decoded straight
+ * into the caller's buffer.  A WebP image can only be decoded whole, so
+ * a strip read a scanline at a time is decoded once into a buffer the
+ * rows are then copied from, and data written a scanline at a time is
+ * gathered until the end of the strip.  Images are at most 16383 pixels
+ * wide and high.
+ */
+
+#include "webp/decode.h"
+#include "webp/encode.h"
+
+#include <stdio.h>
+
+/*
+ * State block for each open TIFF file using WebP compression/decompression.
+ */
+typedef struct {
+        int             quality_level;          /* 1 to 100 */
+        int             lossless;               /* lossless encoding */
+        int             nsamples;               /* 3 or 4 */
+        uint32          width;                  /* pixels per row */
+        tmsize_t        rowbytes;               /* bytes per row */
+        uint8*          buffer;                 /* gathered or decoded data */
+        tmsize_t        buffer_size;
+        tmsize_t        buffer_used;            /* bytes gathered or decoded */
+        tmsize_t        buffer_pos;             /* bytes given back */
+        int             chunk_done;             /* chunk fully processed */
+        int             state;                  /* state flags */
+#define LSTATE_INIT_DECODE 0x01
+#define LSTATE_INIT_ENCODE 0x02
+
+        TIFFVGetMethod  vgetparent;            /* super-class method */
+        TIFFVSetMethod  vsetparent;            /* super-class method */
+} WebPState;
+
+#define LState(tif)             ((WebPState*) (tif)->tif_data)
+#define DecoderState(tif)       LState(tif)
+#define EncoderState(tif)       LState(tif)
+
+static int TWebPEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s);
+static int TWebPDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s);
+
+static int
+TWebPFixupTags(TIFF* tif)
+{
+        (void) tif;
+        return 1;
+}
+
+/*
+ * Check the image layout is one WebP can store.
+ */
+static int
+TWebPSetupLayout(TIFF* tif, const char* module)
+{
+        WebPState* sp = LState(tif);
+        TIFFDirectory* td = &tif->tif_dir;
+
+        if( td->td_bitspersample != 8 ||
+            (td->td_sampleformat != SAMPLEFORMAT_UINT &&
+             td->td_sampleformat != SAMPLEFORMAT_VOID) ) {
+                TIFFErrorExtR(tif, module,
+                             "WebP requires 8 bit unsigned samples");
+                return 0;
+        }
+        if( (td->td_samplesperpixel != 3 && td->td_samplesperpixel != 4) ||
+            td->td_planarconfig != PLANARCONFIG_CONTIG ) {
+                TIFFErrorExtR(tif, module,
+                    "WebP requires 3 or 4 contiguous samples per pixel");
+                return 0;
+        }
+        sp->nsamples = td->td_samplesperpixel;
+        sp->width = isTiled(tif) ? td->td_tilewidth : td->td_imagewidth;
+        if( sp->width == 0 || sp->width > WEBP_MAX_DIMENSION ) {
+                TIFFErrorExtR(tif, module,
+                             "WebP images are at most %d pixels wide",
+                             WEBP_MAX_DIMENSION);
+                return 0;
+        }
+        sp->rowbytes = (tmsize_t) sp->width * sp->nsamples;
+        return 1;
+}
+
+/*
+ * Largest number of rows in a strip or tile.
+ */
+static uint32
+TWebPMaxRows(TIFF* tif)
+{
+        TIFFDirectory* td = &tif->tif_dir;
+
+        if( isTiled(tif) )
+                return td->td_tilelength;
+        return td->td_rowsperstrip < td->td_imagelength ?
+            td->td_rowsperstrip : td->td_imagelength;
+}
+
+static int
+TWebPSetupDecode(TIFF* tif)
+{
+        static const char module[] = "TWebPSetupDecode";
+        WebPState* sp = DecoderState(tif);
+
+        assert(sp != NULL);
+
+        if( !TWebPSetupLayout(tif, module) )
+                return 0;
+
+        sp->state = LSTATE_INIT_DECODE;
+        return 1;
+}
+
+/*
+ * Setup state for decoding a strip.
+ */
+static int
+TWebPPreDecode(TIFF* tif, uint16 s)
+{
+        WebPState* sp = DecoderState(tif);
+
+        (void) s;
+        assert(sp != NULL);
+
+        if( (sp->state & LSTATE_INIT_DECODE) == 0 &&
+            !tif->tif_setupdecode(tif) )
+                return 0;
+
+        sp->buffer_used = 0;
+        sp->buffer_pos = 0;
+        sp->chunk_done = 0;
+        return 1;
+}
+
+static int
+TWebPDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
+{
+        static const char module[] = "TWebPDecode";
+        WebPState* sp = DecoderState(tif);
+        int width, height;
+        tmsize_t size;
+        uint8* dst;
+        uint8* ret;
+
+        (void) s;
+        assert(sp != NULL);
+        assert(sp->state == LSTATE_INIT_DECODE);
+
+        if( sp->chunk_done )
+                goto copy;
+
+        /* Check the image matches the strip or tile before decoding it */
+        if( !WebPGetInfo(tif->tif_rawcp, (size_t) tif->tif_rawcc,
+                         &width, &height) ) {
+                TIFFErrorExtR(tif, module,
+                             "Invalid WebP data at scanline %lu",
+                             (unsigned long) tif->tif_row);
+                return 0;
+        }
+        if( (uint32) width != sp->width || height <= 0 ||
+            (uint32) height > TWebPMaxRows(tif) ) {
+                TIFFErrorExtR(tif, module,
+                    "WebP image of %d x %d pixels does not match the "
+                    "image layout", width, height);
+                return 0;
+        }
+        size = sp->rowbytes * height;
+
+        /*
+         * Decode a whole strip or tile straight into the caller's buffer,
+         * anything else once into a buffer it is handed out from.
+         */
+        if( size == occ && _TIFFIsWholeChunk(tif, occ) )
+                dst = op;
+        else {
+                if( sp->buffer_size < size ) {
+                        uint8* buffer = (uint8*) _TIFFreallocExt(tif,
+                            sp->buffer, size);
+                        if( buffer == NULL ) {
+                                TIFFErrorExtR(tif, module,
+                                             "No space for WebP strip buffer");
+                                return 0;
+                        }
+                        sp->buffer = buffer;
+                        sp->buffer_size = size;
+                }
+                dst = sp->buffer;
+        }
+        if( sp->nsamples == 4 )
+                ret = WebPDecodeRGBAInto(tif->tif_rawcp,
+                                         (size_t) tif->tif_rawcc, dst,
+                                         (size_t) size, (int) sp->rowbytes);
+        else
+                ret = WebPDecodeRGBInto(tif->tif_rawcp,
+                                        (size_t) tif->tif_rawcc, dst,
+                                        (size_t) size, (int) sp->rowbytes);
+        if( ret == NULL ) {
+                TIFFErrorExtR(tif, module,
+                             "Decoding error at scanline %lu",
+                             (unsigned long) tif->tif_row);
+                return 0;
+        }
+        tif->tif_rawcp += tif->tif_rawcc;
+        tif->tif_rawcc = 0;
+        sp->chunk_done = 1;
+        if( dst == op )
+                return 1;
+        sp->buffer_used = size;
+        sp->buffer_pos = 0;
+
+copy:
+        if( sp->buffer_used - sp->buffer_pos < occ ) {
+                TIFFErrorExtR(tif, module,
+                    "Not enough data at scanline %lu (short %lu bytes)",
+                    (unsigned long) tif->tif_row,
+                    (unsigned long) (occ - (sp->buffer_used - sp->buffer_pos)));
+                return 0;
+        }
+        _TIFFmemcpy(op, sp->buffer + sp->buffer_pos, occ);
+        sp->buffer_pos += occ;
+        return 1;
+}
+
+static int
+TWebPSetupEncode(TIFF* tif)
+{
+        static const char module[] = "TWebPSetupEncode";
+        WebPState* sp = EncoderState(tif);
+
+        assert(sp != NULL);
+
+        if( !TWebPSetupLayout(tif, module) )
+                return 0;
+
+        sp->state = LSTATE_INIT_ENCODE;
+        return 1;
+}
+
+/*
+ * Reset encoding state at the start of a strip.
+ */
+static int
+TWebPPreEncode(TIFF* tif, uint16 s)
+{
+        WebPState *sp = EncoderState(tif);
+
+        (void) s;
+        assert(sp != NULL);
+        if( sp->state != LSTATE_INIT_ENCODE &&
+            !tif->tif_setupencode(tif) )
+                return 0;
+
+        sp->buffer_used = 0;
+        sp->chunk_done = 0;
+        return 1;
+}
+
+/*
+ * WebP output callback: append to the raw data buffer, flushing it as it
+ * fills up.
+ */
+static int
+TWebPWriter(const uint8_t* data, size_t data_size, const WebPPicture* picture)
+{
+        TIFF* tif = (TIFF*) picture->custom_ptr;
+        tmsize_t n = (tmsize_t) data_size;
+
+        while( n > 0 ) {
+                tmsize_t chunk = tif->tif_rawdatasize - tif->tif_rawcc;
+
+                if( chunk == 0 ) {
+                        if( !TIFFFlushData1(tif) )
+                                return 0;
+                        continue;
+                }
+                if( chunk > n )
+                        chunk = n;
+                _TIFFmemcpy(tif->tif_rawcp, data, chunk);
+                tif->tif_rawcp += chunk;
+                tif->tif_rawcc += chunk;
+                data += chunk;
+                n -= chunk;
+        }
+        return 1;
+}
+
+/*
+ * Encode cc bytes of whole rows as one WebP image.
+ */
+static int
+TWebPCompressChunk(TIFF* tif, const uint8* data, tmsize_t cc)
+{
+        static const char module[] = "TWebPEncode";
+        WebPState *sp = EncoderState(tif);
+        tmsize_t rows = cc / sp->rowbytes;
+        WebPConfig config;
+        WebPPicture picture;
+        int ok;
+
+        if( cc % sp->rowbytes != 0 || rows > WEBP_MAX_DIMENSION ) {
+                TIFFErrorExtR(tif, module,
+                    "WebP can only encode whole rows, at most %d of them",
+                    WEBP_MAX_DIMENSION);
+                return 0;
+        }
+        if( !WebPConfigPreset(&config, WEBP_PRESET_DEFAULT,
+                              (float) sp->quality_level) ||
+            !WebPPictureInit(&picture) ) {
+                TIFFErrorExtR(tif, module,
+                             "Incompatible libwebp version");
+                return 0;
+        }
+        if( sp->lossless ) {
+                config.lossless = 1;
+                config.exact = 1;	/* keep transparent pixels */
+                picture.use_argb = 1;
+        }
+        if( !WebPValidateConfig(&config) ) {
+                TIFFErrorExtR(tif, module,
+                             "Invalid WebP configuration");
+                return 0;
+        }
+
+        picture.width = (int) sp->width;
+        picture.height = (int) rows;
+        picture.writer = TWebPWriter;
+        picture.custom_ptr = tif;
+        if( sp->nsamples == 4 )
+                ok = WebPPictureImportRGBA(&picture, data,
+                                           (int) sp->rowbytes);
+        else
+                ok = WebPPictureImportRGB(&picture, data, (int) sp->rowbytes);
+        if( !ok ) {
+                TIFFErrorExtR(tif, module,
+                             "No space for WebP picture");
+                return 0;
+        }
+        ok = WebPEncode(&config, &picture);
+        if( !ok )
+                TIFFErrorExtR(tif, module,
+                             "WebP encoding failed at scanline %lu "
+                             "(error %d)",
+                             (unsigned long) tif->tif_row,
+                             (int) picture.error_code);
+        WebPPictureFree(&picture);
+        sp->chunk_done = 1;
+        return ok;
+}
+
+/*
+ * Encode a chunk of pixels.
+ */
+static int
+TWebPEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
+{
+        static const char module[] = "TWebPEncode";
+        WebPState *sp = EncoderState(tif);
+        tmsize_t size;
+
+        assert(sp != NULL);
+        assert(sp->state == LSTATE_INIT_ENCODE);
+
+        (void) s;
+
+        if( sp->chunk_done ) {
+                TIFFErrorExtR(tif, module,
+                             "Strip or tile already compressed");
+                return 0;
+        }
+
+        /* A whole strip or tile is compressed on the spot */
+        if( sp->buffer_used == 0 && _TIFFIsWholeChunk(tif, cc) )
+                return TWebPCompressChunk(tif, bp, cc);
+
+        size = sp->rowbytes * (tmsize_t) TWebPMaxRows(tif);
+        if( sp->buffer_size < size ) {
+                uint8* buffer = (uint8*) _TIFFreallocExt(tif, sp->buffer,
+                                                         size);
+                if( buffer == NULL ) {
+                        TIFFErrorExtR(tif, module,
+                                     "No space for WebP strip buffer");
+                        return 0;
+                }
+                sp->buffer = buffer;
+                sp->buffer_size = size;
+        }
+        if( cc > size - sp->buffer_used ) {
+                TIFFErrorExtR(tif, module,
+                             "More data than fits in a strip or tile");
+                return 0;
+        }
+        _TIFFmemcpy(sp->buffer + sp->buffer_used, bp, cc);
+        sp->buffer_used += cc;
+        return 1;
+}
+
+/*
+ * Finish off an encoded strip by compressing the data gathered.
+ */
+static int
+TWebPPostEncode(TIFF* tif)
+{
+        WebPState *sp = EncoderState(tif);
+
+        if( sp->chunk_done || sp->buffer_used == 0 )
+                return 1;
+        if( !TWebPCompressChunk(tif, sp->buffer, sp->buffer_used) )
+                return 0;
+        sp->buffer_used = 0;
+        return 1;
+}
+
+static void
+TWebPCleanup(TIFF* tif)
+{
+        WebPState* sp = LState(tif);
+
+        assert(sp != 0);
+
+        tif->tif_tagmethods.vgetfield = sp->vgetparent;
+        tif->tif_tagmethods.vsetfield = sp->vsetparent;
+
+        if (sp->buffer)
+            _TIFFfreeExt(tif, sp->buffer);
+        _TIFFfreeExt(tif, sp);
+        tif->tif_data = NULL;
+
+        _TIFFSetDefaultCompressionState(tif);
+}
+
+static int
+TWebPVSetField(TIFF* tif, uint32 tag, va_list ap)
+{
+	static const char module[] = "TWebPVSetField";
+        WebPState* sp = LState(tif);
+        int v;
+
+        switch (tag) {
+        case TIFFTAG_WEBP_LEVEL:
+                v = (int) va_arg(ap, int);
+                if( v < 1 || v > 100 ) {
+                    TIFFErrorExtR(tif, module,
+                                 "WEBP_LEVEL should be between 1 and 100");
+                    return 0;
+                }
+                sp->quality_level = v;
+                return 1;
+        case TIFFTAG_WEBP_LOSSLESS:
+                sp->lossless = (int) va_arg(ap, int) != 0;
+                return 1;
+        default:
+                return (*sp->vsetparent)(tif, tag, ap);
+        }
+        /*NOTREACHED*/
+}
+
+static int
+TWebPVGetField(TIFF* tif, uint32 tag, va_list ap)
+{
+        WebPState* sp = LState(tif);
+
+        switch (tag) {
+        case TIFFTAG_WEBP_LEVEL:
+                *va_arg(ap, int*) = sp->quality_level;
+                break;
+        case TIFFTAG_WEBP_LOSSLESS:
+                *va_arg(ap, int*) = sp->lossless;
+                break;
+        default:
+                return (*sp->vgetparent)(tif, tag, ap);
+        }
+        return 1;
+}
+
+static const TIFFField TWebPFields[] = {
+        { TIFFTAG_WEBP_LEVEL, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, FALSE, "WEBP quality", NULL },
+        { TIFFTAG_WEBP_LOSSLESS, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, FALSE, "WEBP lossless/lossy", NULL },
+};
+
+int
+TIFFInitWebP(TIFF* tif, int scheme)
+{
+        static const char module[] = "TIFFInitWebP";
+        WebPState* sp;
+
+        assert( scheme == COMPRESSION_WEBP );
+
+        /*
+        * Merge codec-specific tag information.
+        */
+        if (!_TIFFMergeFields(tif, TWebPFields, TIFFArrayCount(TWebPFields))) {
+                TIFFErrorExtR(tif, module,
+                            "Merging WebP codec-specific tags failed");
+                return 0;
+        }
+
+        /*
+        * Allocate state block so tag methods have storage to record values.
+        */
+        tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof(WebPState));
+        if (tif->tif_data == NULL)
+                goto bad;
+        sp = LState(tif);
+        _TIFFmemset(sp, 0, sizeof(WebPState));
+
+        /*
+        * Override parent get/set field methods.
+        */
+        sp->vgetparent = tif->tif_tagmethods.vgetfield;
+        tif->tif_tagmethods.vgetfield = TWebPVGetField;	/* hook for codec tags */
+        sp->vsetparent = tif->tif_tagmethods.vsetfield;
+        tif->tif_tagmethods.vsetfield = TWebPVSetField;	/* hook for codec tags */
+
+        /* Default values for codec-specific fields */
+        sp->quality_level = 75;			/* default comp. level */
+        sp->lossless = 0;			/* lossy */
+        sp->state = 0;
+
+        /*
+        * Install codec methods.
+        */
+        tif->tif_fixuptags = TWebPFixupTags;
+        tif->tif_setupdecode = TWebPSetupDecode;
+        tif->tif_predecode = TWebPPreDecode;
+        tif->tif_decoderow = TWebPDecode;
+        tif->tif_decodestrip = TWebPDecode;
+        tif->tif_decodetile = TWebPDecode;
+        tif->tif_setupencode = TWebPSetupEncode;
+        tif->tif_preencode = TWebPPreEncode;
+        tif->tif_postencode = TWebPPostEncode;
+        tif->tif_encoderow = TWebPEncode;
+        tif->tif_encodestrip = TWebPEncode;
+        tif->tif_encodetile = TWebPEncode;
+        tif->tif_cleanup = TWebPCleanup;
+        return 1;
+bad:
+        TIFFErrorExtR(tif, module,
+                    "No space for WebP state block");
+        return 0;
+}
+#endif /* WEBP_SUPPORT */
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
@@ -156,6 +156,177 @@ _tiffSizeProc(thandle_t fd)
 	return(m.QuadPart);
 }
 
+/*
+ * Functions of newer versions of Windows, looked up at run time so that
+ * the library still loads on older ones.
+ */
+typedef HANDLE (WINAPI *ReOpenFileFunc)(HANDLE, DWORD, DWORD, DWORD);
+typedef struct {
+	PVOID  VirtualAddress;
+	SIZE_T NumberOfBytes;
+} TIFFMemoryRange;			/* WIN32_MEMORY_RANGE_ENTRY */
+typedef BOOL (WINAPI *PrefetchVirtualMemoryFunc)(HANDLE, ULONG_PTR,
+    TIFFMemoryRange*, ULONG);
+
+static FARPROC
+_tiffKernel32Proc(const char* name)
+{
+	HMODULE kernel32 = GetModuleHandleA("kernel32.dll");
+
+	return (kernel32 != NULL ? GetProcAddress(kernel32, name) : NULL);
+}
+
+/*
+ * Number of reads kept in flight by _tiffReadBatchProc().
+ */
+#define TIFF_OVERLAPPED_MAX 32
+
+/*
+ * Read at an offset through a handle opened for overlapped I/O, waiting
+ * for each piece; used for what is left of a request after its first
+ * overlapped read came back short.
+ */
+static tmsize_t
+_tiffReadOverlapped(HANDLE h, HANDLE event, uint8* buf, uint64 size,
+    uint64 off)
+{
+	OVERLAPPED ov;
+	uint64 done = 0;
+	DWORD n, got;
+
+	while (done < size) {
+		n = 0x80000000UL;
+		if ((uint64)n > size - done)
+			n = (DWORD)(size - done);
+		_TIFFmemset(&ov, 0, sizeof(ov));
+		ov.Offset = (DWORD)(off + done);
+		ov.OffsetHigh = (DWORD)((off + done) >> 32);
+		ov.hEvent = event;
+		if (!ReadFile(h, buf + done, n, NULL, &ov) &&
+		    GetLastError() != ERROR_IO_PENDING) {
+			if (GetLastError() == ERROR_HANDLE_EOF)
+				break;
+			return (-1);
+		}
+		if (!GetOverlappedResult(h, &ov, &got, TRUE)) {
+			if (GetLastError() == ERROR_HANDLE_EOF)
+				break;
+			return (-1);
+		}
+		done += got;
+		if (got != n)
+			break;
+	}
+	return ((tmsize_t)done);
+}
+
+/*
+ * Batched reads for TIFFReadRawChunks().  The file is reopened for
+ * overlapped I/O for the duration of the batch, which leaves the file
+ * pointer of the handle alone, and up to TIFF_OVERLAPPED_MAX reads are
+ * queued before the first one is waited for.
+ */
+static int
+_tiffReadBatchProc(thandle_t fd, TIFFIORequest* reqs, uint32 n)
+{
+	static ReOpenFileFunc reopen = NULL;
+	static int looked = 0;
+	OVERLAPPED ov[TIFF_OVERLAPPED_MAX];
+	HANDLE events[TIFF_OVERLAPPED_MAX];
+	DWORD want[TIFF_OVERLAPPED_MAX];
+	HANDLE h = INVALID_HANDLE_VALUE;
+	uint32 i, k, nevents = 0;
+	int ret = 0;
+
+	if (!looked) {
+		reopen = (ReOpenFileFunc) _tiffKernel32Proc("ReOpenFile");
+		looked = 1;
+	}
+	if (reopen != NULL)
+		h = (*reopen)((HANDLE) fd, GENERIC_READ,
+		    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		    FILE_FLAG_OVERLAPPED);
+	if (h == INVALID_HANDLE_VALUE) {
+		/* e.g. a pipe, or Windows XP: one request after another */
+		for (i = 0; i < n; i++) {
+			reqs[i].result = 0;
+			if (reqs[i].size <= 0) {
+				reqs[i].result = reqs[i].size == 0 ? 0 : -1;
+				continue;
+			}
+			if (_tiffSeekProc(fd, reqs[i].offset, SEEK_SET) !=
+			    reqs[i].offset)
+				reqs[i].result = -1;
+			else
+				reqs[i].result = _tiffReadProc(fd,
+				    reqs[i].buf, reqs[i].size);
+		}
+		return (1);
+	}
+	for (nevents = 0; nevents < TIFF_OVERLAPPED_MAX && nevents < n;
+	    nevents++) {
+		events[nevents] = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (events[nevents] == NULL)
+			goto done;
+	}
+
+	for (i = 0; i < n; i += nevents) {
+		uint32 m = n - i < nevents ? n - i : nevents;
+
+		for (k = 0; k < m; k++) {
+			TIFFIORequest* req = &reqs[i + k];
+
+			req->result = 0;
+			want[k] = 0;
+			if (req->size <= 0) {
+				req->result = req->size == 0 ? 0 : -1;
+				continue;
+			}
+			want[k] = 0x80000000UL;
+			if ((uint64)want[k] > (uint64)req->size)
+				want[k] = (DWORD)req->size;
+			_TIFFmemset(&ov[k], 0, sizeof(OVERLAPPED));
+			ov[k].Offset = (DWORD)req->offset;
+			ov[k].OffsetHigh = (DWORD)(req->offset >> 32);
+			ov[k].hEvent = events[k];
+			if (!ReadFile(h, req->buf, want[k], NULL, &ov[k]) &&
+			    GetLastError() != ERROR_IO_PENDING) {
+				req->result = GetLastError() ==
+				    ERROR_HANDLE_EOF ? 0 : -1;
+				want[k] = 0;
+			}
+		}
+		for (k = 0; k < m; k++) {
+			TIFFIORequest* req = &reqs[i + k];
+			DWORD got;
+			tmsize_t rest;
+
+			if (want[k] == 0)
+				continue;
+			if (!GetOverlappedResult(h, &ov[k], &got, TRUE)) {
+				if (GetLastError() != ERROR_HANDLE_EOF)
+					req->result = -1;
+				continue;
+			}
+			req->result = (tmsize_t)got;
+			if (got != want[k] || req->result == req->size)
+				continue;
+			rest = _tiffReadOverlapped(h, events[k],
+			    (uint8*)req->buf + got,
+			    (uint64)(req->size - req->result),
+			    req->offset + got);
+			req->result = rest < 0 ? -1 : req->result + rest;
+		}
+	}
+	ret = 1;
+done:
+	for (k = 0; k < nevents; k++)
+		if (events[k] != NULL)
+			CloseHandle(events[k]);
+	CloseHandle(h);
+	return (ret);
+}
+
 static int
 _tiffDummyMapProc(thandle_t fd, void** pbase, toff_t* psize)
 {
@@ -176,6 +347,13 @@ _tiffDummyMapProc(thandle_t fd, void** pbase, toff_t* psize)
  * This removes a nasty OS dependency and cures a problem
  * with Visual C++ 5.0
  */
+/*
+ * Files larger than this are not mapped in 32-bit processes, where a
+ * view of a large part of the address space is likely to make later
+ * allocations fail; they are read instead.
+ */
+#define TIFF_MAP_MAX_32 ((uint64) 1 << 30)
+
 static int
 _tiffMapProc(thandle_t fd, void** pbase, toff_t* psize)
 {
@@ -187,6 +365,8 @@ _tiffMapProc(thandle_t fd, void** pbase, toff_t* psize)
 	sizem = (tmsize_t)size;
 	if ((uint64)sizem!=size)
 		return (0);
+	if (sizeof (void*) < 8 && size > TIFF_MAP_MAX_32)
+		return (0);
 
 	/* By passing in 0 for the maximum file size, it specifies that we
 	   create a file mapping object for the full file size. */
@@ -217,6 +397,33 @@ _tiffUnmapProc(thandle_t fd, void* base, toff_t size)
 	UnmapViewOfFile(base);
 }
 
+/*
+ * Windows has no counterpart of madvise() for access patterns, but from
+ * Windows 8 on a range of a view that is about to be read can be faulted
+ * in with one request to the memory manager.
+ */
+static void
+_tiffMapAdviceProc(thandle_t fd, void* addr, tmsize_t len, int advice)
+{
+	static PrefetchVirtualMemoryFunc prefetch = NULL;
+	static int looked = 0;
+	TIFFMemoryRange range;
+
+	(void) fd;
+	if (advice != TIFF_MAP_WILLNEED || len <= 0)
+		return;
+	if (!looked) {
+		prefetch = (PrefetchVirtualMemoryFunc)
+		    _tiffKernel32Proc("PrefetchVirtualMemory");
+		looked = 1;
+	}
+	if (prefetch == NULL)
+		return;
+	range.VirtualAddress = addr;
+	range.NumberOfBytes = (SIZE_T) len;
+	(void) (*prefetch)(GetCurrentProcess(), 1, &range, 0);
+}
+
 /*
  * Open a TIFF file descriptor for read/writing.
  * Note that TIFFFdOpen and TIFFOpen recognise the character 'u' in the mode
@@ -224,10 +431,25 @@ _tiffUnmapProc(thandle_t fd, void* base, toff_t size)
  */
 TIFF*
 TIFFFdOpen(int ifd, const char* name, const char* mode)
+{
+	return (TIFFFdOpenExt(ifd, name, mode, NULL));
+}
+
+TIFF*
+TIFFFdOpenExt(int ifd, const char* name, const char* mode, TIFFOpenOptions* opts)
 {
 	TIFF* tif;
 	int fSuppressMap;
 	int m;
+	/* A pipe or console is written through TIFFOpenSequential() */
+	if (mode[0]=='w' && (GetFileType((HANDLE)ifd) == FILE_TYPE_PIPE ||
+	    GetFileType((HANDLE)ifd) == FILE_TYPE_CHAR)) {
+		tif = TIFFOpenSequential(name, mode, (thandle_t)ifd,
+		    _tiffWriteProc, _tiffCloseProc, opts);
+		if (tif)
+			tif->tif_fd = ifd;
+		return (tif);
+	}
 	fSuppressMap=0;
 	for (m=0; mode[m]!=0; m++)
 	{
@@ -237,16 +459,66 @@ TIFFFdOpen(int ifd, const char* name, const char* mode)
 			break;
 		}
 	}
-	tif = TIFFClientOpen(name, mode, (thandle_t)ifd, /* FIXME: WIN64 cast to pointer warning */
+	tif = TIFFClientOpenExt(name, mode, (thandle_t)ifd, /* FIXME: WIN64 cast to pointer warning */
 			_tiffReadProc, _tiffWriteProc,
 			_tiffSeekProc, _tiffCloseProc, _tiffSizeProc,
 			fSuppressMap ? _tiffDummyMapProc : _tiffMapProc,
-			fSuppressMap ? _tiffDummyUnmapProc : _tiffUnmapProc);
-	if (tif)
+			fSuppressMap ? _tiffDummyUnmapProc : _tiffUnmapProc,
+			opts);
+	if (tif) {
 		tif->tif_fd = ifd;
+		if (!fSuppressMap)
+			tif->tif_mapadviceproc = _tiffMapAdviceProc;
+		if (tif->tif_readbatchproc == NULL)
+			tif->tif_readbatchproc = _tiffReadBatchProc;
+	}
 	return (tif);
 }
 
+/*
+ * Shared memory files are built on memfd_create(), for which there is
+ * no counterpart here.
+ */
+int
+TIFFCreateSharedMemory(const char* name)
+{
+	TIFFErrorExt(0, "TIFFCreateSharedMemory",
+	    "%s: Shared memory files are not supported", name);
+	return (-1);
+}
+
+TIFF*
+TIFFOpenSharedMemory(int ifd, const char* name, const char* mode)
+{
+	return (TIFFOpenSharedMemoryExt(ifd, name, mode, NULL));
+}
+
+TIFF*
+TIFFOpenSharedMemoryExt(int ifd, const char* name, const char* mode,
+    TIFFOpenOptions* opts)
+{
+	(void) ifd; (void) mode; (void) opts;
+	TIFFErrorExt(0, "TIFFOpenSharedMemory",
+	    "%s: Shared memory files are not supported", name);
+	return ((TIFF*)0);
+}
+
+/*
+ * Flags and attributes for CreateFile() for a file opened with mode m.
+ */
+static DWORD
+_tiffCreateFlags(int m, TIFFOpenOptions* opts)
+{
+	DWORD flags = (m == O_RDONLY) ?
+	    FILE_ATTRIBUTE_READONLY : FILE_ATTRIBUTE_NORMAL;
+
+	if (opts != NULL && opts->accesspattern == TIFF_ACCESS_SEQUENTIAL)
+		flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+	else if (opts != NULL && opts->accesspattern == TIFF_ACCESS_RANDOM)
+		flags |= FILE_FLAG_RANDOM_ACCESS;
+	return (flags);
+}
+
 #ifndef _WIN32_WCE
 
 /*
@@ -254,6 +526,12 @@ TIFFFdOpen(int ifd, const char* name, const char* mode)
  */
 TIFF*
 TIFFOpen(const char* name, const char* mode)
+{
+	return (TIFFOpenExt(name, mode, NULL));
+}
+
+TIFF*
+TIFFOpenExt(const char* name, const char* mode, TIFFOpenOptions* opts)
 {
 	static const char module[] = "TIFFOpen";
 	thandle_t fd;
@@ -275,14 +553,14 @@ TIFFOpen(const char* name, const char* mode)
 	fd = (thandle_t)CreateFileA(name,
 		(m == O_RDONLY)?GENERIC_READ:(GENERIC_READ | GENERIC_WRITE),
 		FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, dwMode,
-		(m == O_RDONLY)?FILE_ATTRIBUTE_READONLY:FILE_ATTRIBUTE_NORMAL,
+		_tiffCreateFlags(m, opts),
 		NULL);
 	if (fd == INVALID_HANDLE_VALUE) {
 		TIFFErrorExt(0, module, "%s: Cannot open", name);
 		return ((TIFF *)0);
 	}
 
-	tif = TIFFFdOpen((int)fd, name, mode);   /* FIXME: WIN64 cast from pointer to int warning */
+	tif = TIFFFdOpenExt((int)fd, name, mode, opts);   /* FIXME: WIN64 cast from pointer to int warning */
 	if(!tif)
 		CloseHandle(fd);
 	return tif;
@@ -293,6 +571,12 @@ TIFFOpen(const char* name, const char* mode)
  */
 TIFF*
 TIFFOpenW(const wchar_t* name, const char* mode)
+{
+	return (TIFFOpenWExt(name, mode, NULL));
+}
+
+TIFF*
+TIFFOpenWExt(const wchar_t* name, const char* mode, TIFFOpenOptions* opts)
 {
 	static const char module[] = "TIFFOpenW";
 	thandle_t fd;
@@ -316,7 +600,7 @@ TIFFOpenW(const wchar_t* name, const char* mode)
 	fd = (thandle_t)CreateFileW(name,
 		(m == O_RDONLY)?GENERIC_READ:(GENERIC_READ|GENERIC_WRITE),
 		FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, dwMode,
-		(m == O_RDONLY)?FILE_ATTRIBUTE_READONLY:FILE_ATTRIBUTE_NORMAL,
+		_tiffCreateFlags(m, opts),
 		NULL);
 	if (fd == INVALID_HANDLE_VALUE) {
 		TIFFErrorExt(0, module, "%S: Cannot open", name);
@@ -337,8 +621,8 @@ TIFFOpenW(const wchar_t* name, const char* mode)
 				    NULL, NULL);
 	}
 
-	tif = TIFFFdOpen((int)fd,    /* FIXME: WIN64 cast from pointer to int warning */
-			 (mbname != NULL) ? mbname : "<unknown>", mode);
+	tif = TIFFFdOpenExt((int)fd,    /* FIXME: WIN64 cast from pointer to int warning */
+			 (mbname != NULL) ? mbname : "<unknown>", mode, opts);
 	if(!tif)
 		CloseHandle(fd);
 
@@ -42,6 +42,11 @@
 
 static int TIFFGrowStrips(TIFF* tif, uint32 delta, const char* module);
 static int TIFFAppendToStrip(TIFF* tif, uint32 strip, uint8* data, tmsize_t cc);
+static int TIFFIsZeroData(const uint8* data, tmsize_t cc);
+static void TIFFDetachChunk(TIFF* tif, uint32 strile);
+static int TIFFAppendChunk(TIFF* tif, uint32 strile, uint8* data, tmsize_t cc);
+static int TIFFWriteTileRowScanline(TIFF* tif, void* buf, uint32 row,
+    uint16 sample, const char* module);
 
 int
 TIFFWriteScanline(TIFF* tif, void* buf, uint32 row, uint16 sample)
@@ -51,6 +56,10 @@ TIFFWriteScanline(TIFF* tif, void* buf, uint32 row, uint16 sample)
 	int status, imagegrew = 0;
 	uint32 strip;
 
+	if (_TIFFCheckCancel(tif, module))
+		return (-1);
+	if (isTiled(tif) && tif->tif_mode != O_RDONLY)
+		return (TIFFWriteTileRowScanline(tif, buf, row, sample, module));
 	if (!WRITECHECKSTRIPS(tif, module))
 		return (-1);
 	/*
@@ -69,7 +78,7 @@ TIFFWriteScanline(TIFF* tif, void* buf, uint32 row, uint16 sample)
 	 */
 	if (row >= td->td_imagelength) {	/* extend image */
 		if (td->td_planarconfig == PLANARCONFIG_SEPARATE) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Can not change \"ImageLength\" when using separate planes");
 			return (-1);
 		}
@@ -81,7 +90,7 @@ TIFFWriteScanline(TIFF* tif, void* buf, uint32 row, uint16 sample)
 	 */
 	if (td->td_planarconfig == PLANARCONFIG_SEPARATE) {
 		if (sample >= td->td_samplesperpixel) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "%lu: Sample out of range, max %lu",
 			    (unsigned long) sample, (unsigned long) td->td_samplesperpixel);
 			return (-1);
@@ -114,7 +123,7 @@ TIFFWriteScanline(TIFF* tif, void* buf, uint32 row, uint16 sample)
 			td->td_stripsperimage =
 			    TIFFhowmany_32(td->td_imagelength,td->td_rowsperstrip);
                 if (td->td_stripsperimage == 0) {
-                        TIFFErrorExt(tif->tif_clientdata, module, "Zero strips per image");
+                        TIFFErrorExtR(tif, module, "Zero strips per image");
                         return (-1);
                 }
 		tif->tif_row =
@@ -128,10 +137,12 @@ TIFFWriteScanline(TIFF* tif, void* buf, uint32 row, uint16 sample)
 		tif->tif_rawcc = 0;
 		tif->tif_rawcp = tif->tif_rawdata;
 
-		if( td->td_stripbytecount[strip] > 0 )
+		if (!_TIFFHoldStrile(tif, strip, 1))
+			return (-1);
+		if( td->td_stripbytecount[TIFFStrileIndex(tif, strip)] > 0 )
 		{
 			/* if we are writing over existing tiles, zero length */
-			td->td_stripbytecount[strip] = 0;
+			td->td_stripbytecount[TIFFStrileIndex(tif, strip)] = 0;
 
 			/* this forces TIFFAppendToStrip() to do a seek */
 			tif->tif_curoff = 0;
@@ -139,6 +150,7 @@ TIFFWriteScanline(TIFF* tif, void* buf, uint32 row, uint16 sample)
 
 		if (!(*tif->tif_preencode)(tif, sample))
 			return (-1);
+		TIFFStatsAdd(tif, stripsencoded, 1);
 		tif->tif_flags |= TIFF_POSTENCODE;
 	}
 	/*
@@ -165,10 +177,15 @@ TIFFWriteScanline(TIFF* tif, void* buf, uint32 row, uint16 sample)
 		tif->tif_row = row;
 	}
 
+	if (tif->tif_flags & TIFF_CHUNKSTATS)
+		_TIFFChunkStatsTally(tif, strip, buf, tif->tif_scanlinesize,
+		    row % td->td_rowsperstrip, row % td->td_rowsperstrip == 0,
+		    NULL);
+
 	/* swab if needed - note that source buffer will be altered */
 	tif->tif_postdecode( tif, (uint8*) buf, tif->tif_scanlinesize );
 
-	status = (*tif->tif_encoderow)(tif, (uint8*) buf,
+	status = _TIFFCallEncode(tif, tif_encoderow, (uint8*) buf,
 	    tif->tif_scanlinesize, sample);
 
         /* we are now poised at the beginning of the next row */
@@ -189,7 +206,7 @@ TIFFWriteEncodedStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc)
 	TIFFDirectory *td = &tif->tif_dir;
 	uint16 sample;
 
-	if (!WRITECHECKSTRIPS(tif, module))
+	if (!WRITECHECKSTRIPS(tif, module) || _TIFFCheckCancel(tif, module))
 		return ((tmsize_t) -1);
 	/*
 	 * Check strip array to make sure there's space.
@@ -202,7 +219,7 @@ TIFFWriteEncodedStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc)
 	 */
 	if (strip >= td->td_nstrips) {
 		if (td->td_planarconfig == PLANARCONFIG_SEPARATE) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Can not grow image by strips when using separate planes");
 			return ((tmsize_t) -1);
 		}
@@ -211,6 +228,13 @@ TIFFWriteEncodedStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc)
 		td->td_stripsperimage =
 		    TIFFhowmany_32(td->td_imagelength, td->td_rowsperstrip);  
 	}
+	if (tif->tif_flags & TIFF_CHUNKSTATS)
+		_TIFFChunkStatsTally(tif, strip, data, cc, 0, 1, NULL);
+	if ((tif->tif_flags & TIFF_SPARSEWRITE) &&
+	    TIFFIsZeroData((uint8*) data, cc)) {
+		_TIFFWriteSparseStrile(tif, strip);
+		return (cc);
+	}
 	/*
 	 * Handle delayed allocation of data buffer.  This
 	 * permits it to be sized according to the directory
@@ -223,7 +247,7 @@ TIFFWriteEncodedStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc)
 	tif->tif_curstrip = strip;
 
         if (td->td_stripsperimage == 0) {
-                TIFFErrorExt(tif->tif_clientdata, module, "Zero strips per image");
+                TIFFErrorExtR(tif, module, "Zero strips per image");
                 return ((tmsize_t) -1);
         }
 
@@ -234,16 +258,20 @@ TIFFWriteEncodedStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc)
 		tif->tif_flags |= TIFF_CODERSETUP;
 	}
 
-	if( td->td_stripbytecount[strip] > 0 )
+	if (tif->tif_flags & TIFF_DEDUPWRITE)
+		TIFFDetachChunk(tif, strip);
+	if (!_TIFFHoldStrile(tif, strip, 0))
+		return ((tmsize_t)(-1));
+	if( td->td_stripbytecount[TIFFStrileIndex(tif, strip)] > 0 )
         {
             /* Make sure that at the first attempt of rewriting the tile, we will have */
             /* more bytes available in the output buffer than the previous byte count, */
             /* so that TIFFAppendToStrip() will detect the overflow when it is called the first */
             /* time if the new compressed tile is bigger than the older one. (GDAL #4771) */
-            if( tif->tif_rawdatasize <= (tmsize_t)td->td_stripbytecount[strip] )
+            if( tif->tif_rawdatasize <= (tmsize_t)td->td_stripbytecount[TIFFStrileIndex(tif, strip)] )
             {
                 if( !(TIFFWriteBufferSetup(tif, NULL,
-                    (tmsize_t)TIFFroundup_64((uint64)(td->td_stripbytecount[strip] + 1), 1024))) )
+                    (tmsize_t)TIFFroundup_64((uint64)(td->td_stripbytecount[TIFFStrileIndex(tif, strip)] + 1), 1024))) )
                     return ((tmsize_t)(-1));
             }
 
@@ -268,19 +296,21 @@ TIFFWriteEncodedStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc)
             TIFFReverseBits((uint8*) data, cc);
 
         if (cc > 0 &&
-            !TIFFAppendToStrip(tif, strip, (uint8*) data, cc))
+            !TIFFAppendChunk(tif, strip, (uint8*) data, cc))
             return ((tmsize_t) -1);
+        TIFFStatsAdd(tif, stripsencoded, 1);
         return (cc);
     }
 
 	sample = (uint16)(strip / td->td_stripsperimage);
 	if (!(*tif->tif_preencode)(tif, sample))
 		return ((tmsize_t) -1);
+	TIFFStatsAdd(tif, stripsencoded, 1);
 
         /* swab if needed - note that source buffer will be altered */
 	tif->tif_postdecode( tif, (uint8*) data, cc );
 
-	if (!(*tif->tif_encodestrip)(tif, (uint8*) data, cc, sample))
+	if (!_TIFFCallEncode(tif, tif_encodestrip, (uint8*) data, cc, sample))
 		return ((tmsize_t) -1);
 	if (!(*tif->tif_postencode)(tif))
 		return ((tmsize_t) -1);
@@ -288,7 +318,7 @@ TIFFWriteEncodedStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc)
 	    (tif->tif_flags & TIFF_NOBITREV) == 0)
 		TIFFReverseBits(tif->tif_rawdata, tif->tif_rawcc);
 	if (tif->tif_rawcc > 0 &&
-	    !TIFFAppendToStrip(tif, strip, tif->tif_rawdata, tif->tif_rawcc))
+	    !TIFFAppendChunk(tif, strip, tif->tif_rawdata, tif->tif_rawcc))
 		return ((tmsize_t) -1);
 	tif->tif_rawcc = 0;
 	tif->tif_rawcp = tif->tif_rawdata;
@@ -319,7 +349,7 @@ TIFFWriteRawStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc)
 	 */
 	if (strip >= td->td_nstrips) {
 		if (td->td_planarconfig == PLANARCONFIG_SEPARATE) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Can not grow image by strips when using separate planes");
 			return ((tmsize_t) -1);
 		}
@@ -336,10 +366,15 @@ TIFFWriteRawStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc)
 	}
 	tif->tif_curstrip = strip;
         if (td->td_stripsperimage == 0) {
-                TIFFErrorExt(tif->tif_clientdata, module,"Zero strips per image");
+                TIFFErrorExtR(tif, module,"Zero strips per image");
                 return ((tmsize_t) -1);
         }
 	tif->tif_row = (strip % td->td_stripsperimage) * td->td_rowsperstrip;
+	if (tif->tif_flags & TIFF_DEDUPWRITE) {
+		TIFFDetachChunk(tif, strip);
+		return (TIFFAppendChunk(tif, strip, (uint8*) data, cc) ?
+		    cc : (tmsize_t) -1);
+	}
 	return (TIFFAppendToStrip(tif, strip, (uint8*) data, cc) ?
 	    cc : (tmsize_t) -1);
 }
@@ -383,14 +418,27 @@ TIFFWriteEncodedTile(TIFF* tif, uint32 tile, void* data, tmsize_t cc)
 	uint16 sample;
         uint32 howmany32;
 
-	if (!WRITECHECKTILES(tif, module))
+	if (!WRITECHECKTILES(tif, module) || _TIFFCheckCancel(tif, module))
 		return ((tmsize_t)(-1));
 	td = &tif->tif_dir;
 	if (tile >= td->td_nstrips) {
-		TIFFErrorExt(tif->tif_clientdata, module, "Tile %lu out of range, max %lu",
+		TIFFErrorExtR(tif, module, "Tile %lu out of range, max %lu",
 		    (unsigned long) tile, (unsigned long) td->td_nstrips);
 		return ((tmsize_t)(-1));
 	}
+	if (tif->tif_flags & TIFF_CHUNKSTATS)
+		_TIFFChunkStatsTally(tif, tile, data,
+		    (cc < 1 || cc > tif->tif_tilesize) ? tif->tif_tilesize : cc,
+		    0, 1, NULL);
+	if (tif->tif_flags & TIFF_SPARSEWRITE) {
+		tmsize_t n = (cc < 1 || cc > tif->tif_tilesize) ?
+		    tif->tif_tilesize : cc;
+
+		if (TIFFIsZeroData((uint8*) data, n)) {
+			_TIFFWriteSparseStrile(tif, tile);
+			return (n);
+		}
+	}
 	/*
 	 * Handle delayed allocation of data buffer.  This
 	 * permits it to be sized more intelligently (using
@@ -402,16 +450,20 @@ TIFFWriteEncodedTile(TIFF* tif, uint32 tile, void* data, tmsize_t cc)
         tif->tif_flags |= TIFF_BUF4WRITE;
 	tif->tif_curtile = tile;
 
-	if( td->td_stripbytecount[tile] > 0 )
+	if (tif->tif_flags & TIFF_DEDUPWRITE)
+		TIFFDetachChunk(tif, tile);
+	if (!_TIFFHoldStrile(tif, tile, 0))
+		return ((tmsize_t)(-1));
+	if( td->td_stripbytecount[TIFFStrileIndex(tif, tile)] > 0 )
         {
             /* Make sure that at the first attempt of rewriting the tile, we will have */
             /* more bytes available in the output buffer than the previous byte count, */
             /* so that TIFFAppendToStrip() will detect the overflow when it is called the first */
             /* time if the new compressed tile is bigger than the older one. (GDAL #4771) */
-            if( tif->tif_rawdatasize <= (tmsize_t) td->td_stripbytecount[tile] )
+            if( tif->tif_rawdatasize <= (tmsize_t) td->td_stripbytecount[TIFFStrileIndex(tif, tile)] )
             {
                 if( !(TIFFWriteBufferSetup(tif, NULL,
-                    (tmsize_t)TIFFroundup_64((uint64)(td->td_stripbytecount[tile] + 1), 1024))) )
+                    (tmsize_t)TIFFroundup_64((uint64)(td->td_stripbytecount[TIFFStrileIndex(tif, tile)] + 1), 1024))) )
                     return ((tmsize_t)(-1));
             }
 
@@ -429,13 +481,13 @@ TIFFWriteEncodedTile(TIFF* tif, uint32 tile, void* data, tmsize_t cc)
 	 */
         howmany32=TIFFhowmany_32(td->td_imagelength, td->td_tilelength);
         if (howmany32 == 0) {
-                 TIFFErrorExt(tif->tif_clientdata,module,"Zero tiles");
+                 TIFFErrorExtR(tif,module,"Zero tiles");
                 return ((tmsize_t)(-1));
         }
 	tif->tif_row = (tile % howmany32) * td->td_tilelength;
         howmany32=TIFFhowmany_32(td->td_imagewidth, td->td_tilewidth);
         if (howmany32 == 0) {
-                 TIFFErrorExt(tif->tif_clientdata,module,"Zero tiles");
+                 TIFFErrorExtR(tif,module,"Zero tiles");
                 return ((tmsize_t)(-1));
         }
 	tif->tif_col = (tile % howmany32) * td->td_tilewidth;
@@ -466,25 +518,27 @@ TIFFWriteEncodedTile(TIFF* tif, uint32 tile, void* data, tmsize_t cc)
             TIFFReverseBits((uint8*) data, cc);
 
         if (cc > 0 &&
-            !TIFFAppendToStrip(tif, tile, (uint8*) data, cc))
+            !TIFFAppendChunk(tif, tile, (uint8*) data, cc))
             return ((tmsize_t) -1);
+        TIFFStatsAdd(tif, tilesencoded, 1);
         return (cc);
     }
 
     sample = (uint16)(tile/td->td_stripsperimage);
     if (!(*tif->tif_preencode)(tif, sample))
         return ((tmsize_t)(-1));
+    TIFFStatsAdd(tif, tilesencoded, 1);
     /* swab if needed - note that source buffer will be altered */
     tif->tif_postdecode( tif, (uint8*) data, cc );
 
-    if (!(*tif->tif_encodetile)(tif, (uint8*) data, cc, sample))
+    if (!_TIFFCallEncode(tif, tif_encodetile, (uint8*) data, cc, sample))
             return ((tmsize_t) -1);
     if (!(*tif->tif_postencode)(tif))
             return ((tmsize_t)(-1));
     if (!isFillOrder(tif, td->td_fillorder) &&
         (tif->tif_flags & TIFF_NOBITREV) == 0)
             TIFFReverseBits((uint8*)tif->tif_rawdata, tif->tif_rawcc);
-    if (tif->tif_rawcc > 0 && !TIFFAppendToStrip(tif, tile,
+    if (tif->tif_rawcc > 0 && !TIFFAppendChunk(tif, tile,
         tif->tif_rawdata, tif->tif_rawcc))
             return ((tmsize_t)(-1));
     tif->tif_rawcc = 0;
@@ -509,11 +563,16 @@ TIFFWriteRawTile(TIFF* tif, uint32 tile, void* data, tmsize_t cc)
 	if (!WRITECHECKTILES(tif, module))
 		return ((tmsize_t)(-1));
 	if (tile >= tif->tif_dir.td_nstrips) {
-		TIFFErrorExt(tif->tif_clientdata, module, "Tile %lu out of range, max %lu",
+		TIFFErrorExtR(tif, module, "Tile %lu out of range, max %lu",
 		    (unsigned long) tile,
 		    (unsigned long) tif->tif_dir.td_nstrips);
 		return ((tmsize_t)(-1));
 	}
+	if (tif->tif_flags & TIFF_DEDUPWRITE) {
+		TIFFDetachChunk(tif, tile);
+		return (TIFFAppendChunk(tif, tile, (uint8*) data, cc) ?
+		    cc : (tmsize_t)(-1));
+	}
 	return (TIFFAppendToStrip(tif, tile, (uint8*) data, cc) ?
 	    cc : (tmsize_t)(-1));
 }
@@ -537,18 +596,25 @@ TIFFSetupStrips(TIFF* tif)
 	td->td_nstrips = td->td_stripsperimage;
 	if (td->td_planarconfig == PLANARCONFIG_SEPARATE)
 		td->td_stripsperimage /= td->td_samplesperpixel;
-	td->td_stripoffset = (uint64 *)
-	    _TIFFmalloc(td->td_nstrips * sizeof (uint64));
-	td->td_stripbytecount = (uint64 *)
-	    _TIFFmalloc(td->td_nstrips * sizeof (uint64));
-	if (td->td_stripoffset == NULL || td->td_stripbytecount == NULL)
-		return (0);
-	/*
-	 * Place data at the end-of-file
-	 * (by setting offsets to zero).
-	 */
-	_TIFFmemset(td->td_stripoffset, 0, td->td_nstrips*sizeof (uint64));
-	_TIFFmemset(td->td_stripbytecount, 0, td->td_nstrips*sizeof (uint64));
+	if (tif->tif_strilewindow != 0 &&
+	    td->td_nstrips > tif->tif_strilewindow) {
+		/* Only a window of the arrays is kept, see tif_strilewindow.c */
+		if (!_TIFFSetupStrileWindow(tif))
+			return (0);
+	} else {
+		td->td_stripoffset = (uint64 *)
+		    _TIFFmallocExt(tif, td->td_nstrips * sizeof (uint64));
+		td->td_stripbytecount = (uint64 *)
+		    _TIFFmallocExt(tif, td->td_nstrips * sizeof (uint64));
+		if (td->td_stripoffset == NULL || td->td_stripbytecount == NULL)
+			return (0);
+		/*
+		 * Place data at the end-of-file
+		 * (by setting offsets to zero).
+		 */
+		_TIFFmemset(td->td_stripoffset, 0, td->td_nstrips*sizeof (uint64));
+		_TIFFmemset(td->td_stripbytecount, 0, td->td_nstrips*sizeof (uint64));
+	}
 	TIFFSetFieldBit(tif, FIELD_STRIPOFFSETS);
 	TIFFSetFieldBit(tif, FIELD_STRIPBYTECOUNTS);
 	return (1);
@@ -565,11 +631,11 @@ int
 TIFFWriteCheck(TIFF* tif, int tiles, const char* module)
 {
 	if (tif->tif_mode == O_RDONLY) {
-		TIFFErrorExt(tif->tif_clientdata, module, "File not open for writing");
+		TIFFErrorExtR(tif, module, "File not open for writing");
 		return (0);
 	}
 	if (tiles ^ isTiled(tif)) {
-		TIFFErrorExt(tif->tif_clientdata, module, tiles ?
+		TIFFErrorExtR(tif, module, tiles ?
 		    "Can not write tiles to a stripped image" :
 		    "Can not write scanlines to a tiled image");
 		return (0);
@@ -588,7 +654,7 @@ TIFFWriteCheck(TIFF* tif, int tiles, const char* module)
 	 * the image's length to be changed).
 	 */
 	if (!TIFFFieldSet(tif, FIELD_IMAGEDIMENSIONS)) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Must set \"ImageWidth\" before writing data");
 		return (0);
 	}
@@ -603,14 +669,14 @@ TIFFWriteCheck(TIFF* tif, int tiles, const char* module)
                     tif->tif_dir.td_planarconfig = PLANARCONFIG_CONTIG;
 	} else {
 		if (!TIFFFieldSet(tif, FIELD_PLANARCONFIG)) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Must set \"PlanarConfiguration\" before writing data");
 			return (0);
 		}
 	}
 	if (tif->tif_dir.td_stripoffset == NULL && !TIFFSetupStrips(tif)) {
 		tif->tif_dir.td_nstrips = 0;
-		TIFFErrorExt(tif->tif_clientdata, module, "No space for %s arrays",
+		TIFFErrorExtR(tif, module, "No space for %s arrays",
 		    isTiled(tif) ? "tile" : "strip");
 		return (0);
 	}
@@ -629,6 +695,210 @@ TIFFWriteCheck(TIFF* tif, int tiles, const char* module)
 	return (1);
 }
 
+/*
+ * Scanlines of a tiled image are gathered until they complete a row of
+ * tiles, which is then cut into tiles and encoded with
+ * TIFFWriteEncodedTilesParallel().  Each plane of a separate image has
+ * its own band of rows, so the planes may be written one after the
+ * other or row by row.
+ */
+struct _TIFFTileRows {
+	tmsize_t  scanline;     /* bytes in a row of one plane */
+	tmsize_t  tilerow;      /* bytes in a row of a tile */
+	tmsize_t  tilesize;
+	uint32    tilesacross;
+	uint16    nplanes;
+	uint8*    rows;         /* TileLength rows of each plane */
+	uint32*   nextrow;      /* row expected next in each plane */
+	uint8*    dirty;        /* the plane has rows not yet encoded */
+	uint8*    tiles;        /* a row of tiles of one plane */
+	void**    bufs;
+	tmsize_t* sizes;
+	uint32*   tilenos;
+};
+
+void
+_TIFFFreeTileRows(TIFF* tif)
+{
+	TIFFTileRows* t = tif->tif_tilerows;
+
+	if (t == NULL)
+		return;
+	_TIFFfreeExt(tif, t->rows);
+	_TIFFfreeExt(tif, t->nextrow);
+	_TIFFfreeExt(tif, t->dirty);
+	_TIFFfreeExt(tif, t->tiles);
+	_TIFFfreeExt(tif, t->bufs);
+	_TIFFfreeExt(tif, t->sizes);
+	_TIFFfreeExt(tif, t->tilenos);
+	_TIFFfreeExt(tif, t);
+	tif->tif_tilerows = NULL;
+}
+
+static TIFFTileRows*
+TIFFSetupTileRows(TIFF* tif, const char* module)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFTileRows* t;
+	uint64 rows, tiles;
+
+	if (!TIFFWriteCheck(tif, 1, module))
+		return (NULL);
+	if (td->td_imagelength == 0 || td->td_imagedepth > 1) {
+		TIFFErrorExtR(tif, module,
+		    "Can not write scanlines to a tiled image without \"ImageLength\" or with \"ImageDepth\"");
+		return (NULL);
+	}
+	if (td->td_photometric == PHOTOMETRIC_YCBCR && !isUpSampled(tif) &&
+	    (td->td_ycbcrsubsampling[0] != 1 ||
+	    td->td_ycbcrsubsampling[1] != 1)) {
+		TIFFErrorExtR(tif, module,
+		    "Can not write scanlines to subsampled YCbCr tiles");
+		return (NULL);
+	}
+	t = (TIFFTileRows*) _TIFFcallocExt(tif, 1, sizeof (TIFFTileRows));
+	if (t == NULL)
+		goto nomem;
+	tif->tif_tilerows = t;
+	t->nplanes = td->td_planarconfig == PLANARCONFIG_SEPARATE ?
+	    td->td_samplesperpixel : 1;
+	t->scanline = TIFFScanlineSize(tif);
+	t->tilerow = TIFFTileRowSize(tif);
+	t->tilesize = TIFFTileSize(tif);
+	t->tilesacross = TIFFhowmany_32(td->td_imagewidth, td->td_tilewidth);
+	if (t->scanline == 0 || t->tilerow == 0 || t->tilesize == 0)
+		goto bad;
+	rows = _TIFFMultiply64(tif, _TIFFMultiply64(tif, t->nplanes,
+	    td->td_tilelength, module), (uint64) t->scanline, module);
+	tiles = _TIFFMultiply64(tif, t->tilesacross, (uint64) t->tilesize,
+	    module);
+	if (rows == 0 || tiles == 0 || (uint64)(tmsize_t) rows != rows ||
+	    (uint64)(tmsize_t) tiles != tiles)
+		goto bad;
+	t->rows = (uint8*) _TIFFmallocExt(tif, (tmsize_t) rows);
+	t->tiles = (uint8*) _TIFFmallocExt(tif, (tmsize_t) tiles);
+	t->nextrow = (uint32*) _TIFFcallocExt(tif, t->nplanes, sizeof (uint32));
+	t->dirty = (uint8*) _TIFFcallocExt(tif, t->nplanes, 1);
+	t->bufs = (void**) _TIFFmallocExt(tif,
+	    (tmsize_t) t->tilesacross * sizeof (void*));
+	t->sizes = (tmsize_t*) _TIFFmallocExt(tif,
+	    (tmsize_t) t->tilesacross * sizeof (tmsize_t));
+	t->tilenos = (uint32*) _TIFFmallocExt(tif,
+	    (tmsize_t) t->tilesacross * sizeof (uint32));
+	if (t->rows == NULL || t->tiles == NULL || t->nextrow == NULL ||
+	    t->dirty == NULL || t->bufs == NULL || t->sizes == NULL ||
+	    t->tilenos == NULL)
+		goto nomem;
+	return (t);
+nomem:
+	TIFFErrorExtR(tif, module, "No space for a row of tiles");
+bad:
+	_TIFFFreeTileRows(tif);
+	return (NULL);
+}
+
+/*
+ * Encode the band of rows held for a plane; rows that have not been
+ * written yet, and the parts of tiles beyond the image, are zero.
+ */
+static int
+TIFFEncodeTileRow(TIFF* tif, TIFFTileRows* t, uint16 plane)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	uint32 band = (t->nextrow[plane] - 1) / td->td_tilelength;
+	uint32 held = t->nextrow[plane] - band * td->td_tilelength;
+	const uint8* rows = t->rows +
+	    (tmsize_t) plane * td->td_tilelength * t->scanline;
+	uint32 c, j;
+
+	for (c = 0; c < t->tilesacross; c++) {
+		uint8* tile = t->tiles + (tmsize_t) c * t->tilesize;
+		tmsize_t off = (tmsize_t) c * t->tilerow;
+		tmsize_t n = t->scanline - off < t->tilerow ?
+		    t->scanline - off : t->tilerow;
+
+		for (j = 0; j < td->td_tilelength; j++) {
+			uint8* dst = tile + (tmsize_t) j * t->tilerow;
+
+			if (j < held) {
+				_TIFFmemcpy(dst, rows +
+				    (tmsize_t) j * t->scanline + off, n);
+				if (n < t->tilerow)
+					_TIFFmemset(dst + n, 0, t->tilerow - n);
+			} else
+				_TIFFmemset(dst, 0, t->tilerow);
+		}
+		t->bufs[c] = tile;
+		t->sizes[c] = t->tilesize;
+		t->tilenos[c] = TIFFComputeTile(tif, c * td->td_tilewidth,
+		    band * td->td_tilelength, 0, plane);
+	}
+	t->dirty[plane] = 0;
+	return (TIFFWriteEncodedTilesParallel(tif, t->tilenos, t->tilesacross,
+	    t->bufs, t->sizes, 0));
+}
+
+/*
+ * Encode the rows held for a tile row that is not complete yet, so that
+ * the file can be read or closed.  The rows are kept, and the tiles are
+ * written again when the rest of their rows arrive.
+ */
+int
+_TIFFFlushTileRows(TIFF* tif)
+{
+	TIFFTileRows* t = tif->tif_tilerows;
+	uint16 plane;
+
+	if (t == NULL)
+		return (1);
+	for (plane = 0; plane < t->nplanes; plane++)
+		if (t->dirty[plane] && !TIFFEncodeTileRow(tif, t, plane))
+			return (0);
+	return (1);
+}
+
+static int
+TIFFWriteTileRowScanline(TIFF* tif, void* buf, uint32 row, uint16 sample,
+    const char* module)
+{
+	TIFFDirectory* td = &tif->tif_dir;
+	TIFFTileRows* t = tif->tif_tilerows;
+	uint16 plane = 0;
+
+	if (t == NULL && (t = TIFFSetupTileRows(tif, module)) == NULL)
+		return (-1);
+	if (td->td_planarconfig == PLANARCONFIG_SEPARATE) {
+		if (sample >= td->td_samplesperpixel) {
+			TIFFErrorExtR(tif, module,
+			    "%lu: Sample out of range, max %lu",
+			    (unsigned long) sample,
+			    (unsigned long) td->td_samplesperpixel);
+			return (-1);
+		}
+		plane = sample;
+	}
+	if (row >= td->td_imagelength) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: Row out of range, max %lu", (unsigned long) row,
+		    (unsigned long) td->td_imagelength);
+		return (-1);
+	}
+	if (row != t->nextrow[plane]) {
+		TIFFErrorExtR(tif, module,
+		    "%lu: Scanlines of a tiled image must be written in order, "
+		    "row %lu is next", (unsigned long) row,
+		    (unsigned long) t->nextrow[plane]);
+		return (-1);
+	}
+	_TIFFmemcpy(t->rows + ((tmsize_t) plane * td->td_tilelength +
+	    row % td->td_tilelength) * t->scanline, buf, t->scanline);
+	t->nextrow[plane]++;
+	t->dirty[plane] = 1;
+	if ((row + 1) % td->td_tilelength == 0 || row + 1 == td->td_imagelength)
+		return (TIFFEncodeTileRow(tif, t, plane) ? 1 : -1);
+	return (1);
+}
+
 /*
  * Setup the raw data buffer used for encoding.
  */
@@ -639,7 +909,7 @@ TIFFWriteBufferSetup(TIFF* tif, void* bp, tmsize_t size)
 
 	if (tif->tif_rawdata) {
 		if (tif->tif_flags & TIFF_MYBUFFER) {
-			_TIFFfree(tif->tif_rawdata);
+			_TIFFfreeExt(tif, tif->tif_rawdata);
 			tif->tif_flags &= ~TIFF_MYBUFFER;
 		}
 		tif->tif_rawdata = NULL;
@@ -655,9 +925,9 @@ TIFFWriteBufferSetup(TIFF* tif, void* bp, tmsize_t size)
 		bp = NULL;			/* NB: force malloc */
 	}
 	if (bp == NULL) {
-		bp = _TIFFmalloc(size);
+		bp = _TIFFmallocExt(tif, size);
 		if (bp == NULL) {
-			TIFFErrorExt(tif->tif_clientdata, module, "No space for output buffer");
+			TIFFErrorExtR(tif, module, "No space for output buffer");
 			return (0);
 		}
 		tif->tif_flags |= TIFF_MYBUFFER;
@@ -682,17 +952,22 @@ TIFFGrowStrips(TIFF* tif, uint32 delta, const char* module)
 	uint64* new_stripbytecount;
 
 	assert(td->td_planarconfig == PLANARCONFIG_CONTIG);
-	new_stripoffset = (uint64*)_TIFFrealloc(td->td_stripoffset,
+	if (td->td_strilewindow != NULL) {
+		TIFFErrorExtR(tif, module,
+		    "Cannot grow strip arrays set aside in the file");
+		return (0);
+	}
+	new_stripoffset = (uint64*)_TIFFreallocExt(tif, td->td_stripoffset,
 		(td->td_nstrips + delta) * sizeof (uint64));
-	new_stripbytecount = (uint64*)_TIFFrealloc(td->td_stripbytecount,
+	new_stripbytecount = (uint64*)_TIFFreallocExt(tif, td->td_stripbytecount,
 		(td->td_nstrips + delta) * sizeof (uint64));
 	if (new_stripoffset == NULL || new_stripbytecount == NULL) {
 		if (new_stripoffset)
-			_TIFFfree(new_stripoffset);
+			_TIFFfreeExt(tif, new_stripoffset);
 		if (new_stripbytecount)
-			_TIFFfree(new_stripbytecount);
+			_TIFFfreeExt(tif, new_stripbytecount);
 		td->td_nstrips = 0;
-		TIFFErrorExt(tif->tif_clientdata, module, "No space to expand strip arrays");
+		TIFFErrorExtR(tif, module, "No space to expand strip arrays");
 		return (0);
 	}
 	td->td_stripoffset = new_stripoffset;
@@ -707,6 +982,186 @@ TIFFGrowStrips(TIFF* tif, uint32 delta, const char* module)
 	return (1);
 }
 
+/*
+ * Return 1 if the cc bytes of data are all zero.
+ */
+static int
+TIFFIsZeroData(const uint8* data, tmsize_t cc)
+{
+	if (cc <= 0 || data[0] != 0)
+		return (0);
+	/* every byte equals the next one */
+	return (_TIFFmemcmp(data, data + 1, cc - 1) == 0);
+}
+
+/*
+ * Leave a strip or tile out of the file, as sparse files do with the
+ * ones that only hold zeros: it gets neither an offset nor a byte count.
+ * The data it may have had before is not reclaimed.
+ */
+void
+_TIFFWriteSparseStrile(TIFF* tif, uint32 strile)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	uint32 i;
+
+	if (!_TIFFHoldStrile(tif, strile, 1))
+		return;
+	i = TIFFStrileIndex(tif, strile);
+	if (td->td_stripoffset[i] != 0 || td->td_stripbytecount[i] != 0) {
+		td->td_stripoffset[i] = 0;
+		td->td_stripbytecount[i] = 0;
+		tif->tif_flags |= TIFF_DIRTYSTRIP;
+	}
+}
+
+/*
+ * Strips and tiles written in deduplicating mode, in an open addressing
+ * table keyed by the hash of their data.
+ */
+struct _TIFFDedupEntry {
+	uint64	hash;
+	uint64	offset;
+	uint64	bytecount;		/* 0 for a free slot */
+};
+
+#define	DEDUP_MIN_SLOTS	256
+
+/*
+ * Make a strip or tile that is about to be rewritten in deduplicating
+ * mode start afresh at the end of the file, as its old data may be
+ * shared with other strips or tiles and must not be written over.
+ */
+static void
+TIFFDetachChunk(TIFF* tif, uint32 strile)
+{
+	_TIFFWriteSparseStrile(tif, strile);
+	tif->tif_curoff = 0;
+}
+
+/*
+ * Return 1 if the cc bytes at offset in the file are data.
+ */
+static int
+TIFFDedupCompare(TIFF* tif, uint64 offset, const uint8* data, tmsize_t cc)
+{
+	uint8* buf = (uint8*) _TIFFGetScratch(tif, TIFF_SCRATCH_DEDUP, cc);
+
+	/* the next append seeks to where it writes */
+	tif->tif_curoff = 0;
+	if (buf == NULL || !SeekOK(tif, offset) || !ReadOK(tif, buf, cc))
+		return (0);
+	return (_TIFFmemcmp(buf, data, cc) == 0);
+}
+
+/*
+ * Look the data up among the strips and tiles written so far; on a
+ * match, store the offset of their copy in *offset and return 1.
+ */
+static int
+TIFFDedupFind(TIFF* tif, uint64 hash, const uint8* data, tmsize_t cc,
+    uint64* offset)
+{
+	TIFFDedupEntry* e;
+	uint32 i;
+
+	if (tif->tif_dedup == NULL)
+		return (0);
+	for (i = (uint32) hash & tif->tif_dedupmask;
+	    tif->tif_dedup[i].bytecount != 0;
+	    i = (i + 1) & tif->tif_dedupmask) {
+		e = &tif->tif_dedup[i];
+		if (e->hash == hash && e->bytecount == (uint64) cc &&
+		    TIFFDedupCompare(tif, e->offset, data, cc)) {
+			*offset = e->offset;
+			return (1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Enter the data just written at offset, growing the table to keep it at
+ * most half full.  Deduplication is only an optimization: when memory runs
+ * out, the data is just not entered.
+ */
+static void
+TIFFDedupAdd(TIFF* tif, uint64 hash, uint64 offset, tmsize_t cc)
+{
+	TIFFDedupEntry* e;
+	uint32 i;
+
+	if (tif->tif_dedup == NULL ||
+	    tif->tif_dedupcount >= tif->tif_dedupmask / 2) {
+		uint32 nslots = tif->tif_dedup ?
+		    (tif->tif_dedupmask + 1) * 2 : DEDUP_MIN_SLOTS;
+		TIFFDedupEntry* table;
+		uint32 j;
+
+		if (nslots == 0)
+			return;
+		table = (TIFFDedupEntry*) _TIFFcallocExt(tif, nslots,
+		    sizeof(TIFFDedupEntry));
+		if (table == NULL)
+			return;
+		for (j = 0; tif->tif_dedup && j <= tif->tif_dedupmask; j++) {
+			e = &tif->tif_dedup[j];
+			if (e->bytecount == 0)
+				continue;
+			for (i = (uint32) e->hash & (nslots - 1);
+			    table[i].bytecount != 0; i = (i + 1) & (nslots - 1))
+				;
+			table[i] = *e;
+		}
+		if (tif->tif_dedup)
+			_TIFFfreeExt(tif, tif->tif_dedup);
+		tif->tif_dedup = table;
+		tif->tif_dedupmask = nslots - 1;
+	}
+	for (i = (uint32) hash & tif->tif_dedupmask;
+	    tif->tif_dedup[i].bytecount != 0;
+	    i = (i + 1) & tif->tif_dedupmask)
+		;
+	e = &tif->tif_dedup[i];
+	e->hash = hash;
+	e->offset = offset;
+	e->bytecount = (uint64) cc;
+	tif->tif_dedupcount++;
+}
+
+/*
+ * Write all the cc bytes of encoded data of a strip or tile.  In
+ * deduplicating mode, point it at an identical copy already in the file
+ * if there is one; a strip or tile whose first part was already flushed
+ * by the codec is appended as usual.
+ */
+static int
+TIFFAppendChunk(TIFF* tif, uint32 strile, uint8* data, tmsize_t cc)
+{
+	TIFFDirectory *td = &tif->tif_dir;
+	uint64 hash, offset;
+
+	if (!_TIFFHoldStrile(tif, strile, 1))
+		return (0);
+	if (!(tif->tif_flags & TIFF_DEDUPWRITE) ||
+	    td->td_stripbytecount[TIFFStrileIndex(tif, strile)] != 0)
+		return (TIFFAppendToStrip(tif, strile, data, cc));
+	hash = _TIFFHash64(data, cc);
+	if (TIFFDedupFind(tif, hash, data, cc, &offset)) {
+		td->td_stripoffset[TIFFStrileIndex(tif, strile)] = offset;
+		td->td_stripbytecount[TIFFStrileIndex(tif, strile)] = (uint64) cc;
+		tif->tif_flags |= TIFF_DIRTYSTRIP;
+		if (tif->tif_chunkchecksums)
+			_TIFFChunkCRCUpdate(tif, strile, data, cc, 1);
+		return (1);
+	}
+	if (!TIFFAppendToStrip(tif, strile, data, cc))
+		return (0);
+	TIFFDedupAdd(tif, hash, td->td_stripoffset[TIFFStrileIndex(tif, strile)],
+	    cc);
+	return (1);
+}
+
 /*
  * Append the data to the specified strip.
  */
@@ -717,13 +1172,17 @@ TIFFAppendToStrip(TIFF* tif, uint32 strip, uint8* data, tmsize_t cc)
 	TIFFDirectory *td = &tif->tif_dir;
 	uint64 m;
         int64 old_byte_count = -1;
+	uint32 i;
 
-	if (td->td_stripoffset[strip] == 0 || tif->tif_curoff == 0) {
+	if (!_TIFFHoldStrile(tif, strip, 1))
+		return (0);
+	i = TIFFStrileIndex(tif, strip);
+	if (td->td_stripoffset[i] == 0 || tif->tif_curoff == 0) {
             assert(td->td_nstrips > 0);
 
-            if( td->td_stripbytecount[strip] != 0 
-                && td->td_stripoffset[strip] != 0 
-                && td->td_stripbytecount[strip] >= (uint64) cc )
+            if( td->td_stripbytecount[i] != 0 
+                && td->td_stripoffset[i] != 0 
+                && td->td_stripbytecount[i] >= (uint64) cc )
             {
                 /* 
                  * There is already tile data on disk, and the new tile
@@ -732,8 +1191,8 @@ TIFFAppendToStrip(TIFF* tif, uint32 strip, uint8* data, tmsize_t cc)
                  * more data to append to this strip before we are done
                  * depending on how we are getting called.
                  */
-                if (!SeekOK(tif, td->td_stripoffset[strip])) {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                if (!SeekOK(tif, td->td_stripoffset[i])) {
+                    TIFFErrorExtR(tif, module,
                                  "Seek error at scanline %lu",
                                  (unsigned long)tif->tif_row);
                     return (0);
@@ -745,36 +1204,41 @@ TIFFAppendToStrip(TIFF* tif, uint32 strip, uint8* data, tmsize_t cc)
                  * Seek to end of file, and set that as our location to 
                  * write this strip.
                  */
-                td->td_stripoffset[strip] = TIFFSeekFile(tif, 0, SEEK_END);
+                td->td_stripoffset[i] = TIFFSeekFile(tif, 0, SEEK_END);
                 tif->tif_flags |= TIFF_DIRTYSTRIP;
             }
 
-            tif->tif_curoff = td->td_stripoffset[strip];
+            tif->tif_curoff = td->td_stripoffset[i];
 
             /*
              * We are starting a fresh strip/tile, so set the size to zero.
              */
-            old_byte_count = td->td_stripbytecount[strip];
-            td->td_stripbytecount[strip] = 0;
+            old_byte_count = td->td_stripbytecount[i];
+            td->td_stripbytecount[i] = 0;
 	}
 
+	if (!_TIFFPromoteIfNeeded(tif, tif->tif_curoff+(uint64)cc, module))
+		return (0);
 	m = tif->tif_curoff+cc;
 	if (!(tif->tif_flags&TIFF_BIGTIFF))
 		m = (uint32)m;
 	if ((m<tif->tif_curoff)||(m<(uint64)cc))
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "Maximum TIFF file size exceeded");
+		TIFFErrorExtR(tif, module, "Maximum TIFF file size exceeded");
 		return (0);
 	}
 	if (!WriteOK(tif, data, cc)) {
-		TIFFErrorExt(tif->tif_clientdata, module, "Write error at scanline %lu",
+		TIFFErrorExtR(tif, module, "Write error at scanline %lu",
 		    (unsigned long) tif->tif_row);
 		    return (0);
 	}
 	tif->tif_curoff = m;
-	td->td_stripbytecount[strip] += cc;
+	if (tif->tif_chunkchecksums)
+		_TIFFChunkCRCUpdate(tif, strip, data, cc,
+		    td->td_stripbytecount[i] == 0);
+	td->td_stripbytecount[i] += cc;
 
-        if( (int64) td->td_stripbytecount[strip] != old_byte_count )
+        if( (int64) td->td_stripbytecount[i] != old_byte_count )
             tif->tif_flags |= TIFF_DIRTYSTRIP;
             
 	return (1);
@@ -822,6 +1286,55 @@ TIFFSetWriteOffset(TIFF* tif, toff_t off)
 	tif->tif_curoff = off;
 }
 
+/*
+ * Ask the file system to reserve size bytes past the current end of
+ * the file for data about to be written, so that a large image is laid
+ * out in few extents and the file need not be extended at every write.
+ * The size of the file is unchanged.  A size of 0 stands for the image
+ * of the current directory uncompressed, with room for its strip or
+ * tile arrays and directory.  Returns 1 if the space was reserved and
+ * 0 if it was not, such as when the handle has no method for it.
+ */
+int
+TIFFPreallocate(TIFF* tif, uint64 size)
+{
+	static const char module[] = "TIFFPreallocate";
+
+	if (tif->tif_mode == O_RDONLY) {
+		TIFFErrorExtR(tif, module,
+		    "File not open for writing");
+		return (0);
+	}
+	if (size == 0) {
+		uint64 chunk, nchunks;
+
+		if (!TIFFFieldSet(tif, FIELD_IMAGEDIMENSIONS)) {
+			TIFFErrorExtR(tif, module,
+			    "Must set \"ImageWidth\" before preallocating");
+			return (0);
+		}
+		if (isTiled(tif)) {
+			chunk = TIFFTileSize64(tif);
+			nchunks = TIFFNumberOfTiles(tif);
+		} else {
+			chunk = TIFFStripSize64(tif);
+			nchunks = TIFFNumberOfStrips(tif);
+		}
+		if (chunk == 0 || nchunks == 0 ||
+		    nchunks > ((uint64) -1 - 4096) / (chunk + 16)) {
+			TIFFErrorExtR(tif, module,
+			    "Can not estimate the image size");
+			return (0);
+		}
+		/* two 8 byte array entries per chunk, and the directory */
+		size = nchunks * (chunk + 16) + 4096;
+	}
+	if (tif->tif_preallocateproc == NULL)
+		return (0);
+	return ((*tif->tif_preallocateproc)(tif->tif_clientdata,
+	    TIFFSeekFile(tif, 0, SEEK_END), size));
+}
+
 /* vim: set ts=8 sts=8 sw=8 noet: */
 /*
  * Local Variables:
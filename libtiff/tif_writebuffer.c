@@ -0,0 +1,439 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+
+/*
+ * TIFF Library.
+ *
+ * Write-behind buffer for files written through client procedures.
+ *
+ * When enabled with TIFFOpenOptionsSetWriteBuffer(), TIFFWriteFile()
+ * and TIFFSeekFile() on a handle open for writing go through a buffer
+ * that collects writes following each other in the file, so that the
+ * strips of images with few rows per strip and the out-of-line data of
+ * directories reach the write method in large sequential writes.  The
+ * buffer is written out when a write is not contiguous with it or does
+ * not fit, before every read, and once a directory is written or the
+ * file is flushed or closed.  Seeking only moves a position kept here,
+ * and the file size is tracked so that seeking to the end of the file
+ * does not need a flush.
+ *
+ * With TIFFOpenOptionsSetWriteBehind(), full buffers are handed to a
+ * thread that writes them in the background, in order, while the
+ * caller fills another one, so that encoding the next strip or tile
+ * overlaps writing the previous ones.  The number of buffers bounds the
+ * data waiting to be written; the caller only blocks when they are all
+ * full.  The thread is the only user of the client procedures while
+ * blocks are queued: everything else that reaches them waits for the
+ * queue to drain first.  Write errors of the thread are reported by the
+ * next flush.
+ */
+#include "tiffiop.h"
+
+typedef struct {
+	uint8*		data;
+	tmsize_t	len;
+	uint64		off;
+} TIFFWriteBlock;
+
+struct _TIFFWriteBuffer {
+	uint8*		data;
+	tmsize_t	size;		/* capacity */
+	tmsize_t	len;		/* bytes held */
+	uint64		off;		/* file offset of data[0] */
+	uint64		pos;		/* file position seen by libtiff */
+	uint64		end;		/* file size including held bytes */
+	int		endvalid;
+	/* write-behind thread, NULL if buffers are written by the caller */
+	TIFFThread*	thread;
+	TIFFMutex*	mutex;		/* protects the fields below */
+	TIFFCond*	cond;		/* signalled when they change */
+	TIFFWriteBlock*	queue;		/* ring of blocks to write */
+	int		nbuffers;	/* # buffers, and ring size */
+	int		head;		/* oldest entry of queue */
+	int		count;		/* # entries in queue */
+	uint8**		spare;		/* buffers not in use */
+	int		nspare;
+	int		stop;		/* thread to end once queue is empty */
+	int		failed;		/* a block could not be written */
+	uint64		failoff;	/* file offset of the first such block */
+};
+
+/*
+ * Write size bytes at off with the client procedures.
+ */
+static tmsize_t
+_TIFFWriteBlockAt(TIFF* tif, uint64 off, const void* buf, tmsize_t size)
+{
+	if (_TIFFCallSeekProc(tif, off, SEEK_SET) != off)
+		return ((tmsize_t) -1);
+	return (_TIFFCallWriteProc(tif, (void*) buf, size));
+}
+
+static tmsize_t
+_TIFFWriteBufferPut(TIFF* tif, uint64 off, const void* buf, tmsize_t size)
+{
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+	tmsize_t n;
+
+	n = _TIFFWriteBlockAt(tif, off, buf, size);
+	if (n > 0 && wb->endvalid && off + (uint64) n > wb->end)
+		wb->end = off + (uint64) n;
+	return (n);
+}
+
+static void
+_TIFFWriteBehindThread(void* arg)
+{
+	TIFF* tif = (TIFF*) arg;
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+	TIFFWriteBlock block;
+	int failed;
+
+	_TIFFMutexLock(wb->mutex);
+	for (;;) {
+		while (wb->count == 0 && !wb->stop)
+			_TIFFCondWait(wb->cond, wb->mutex);
+		if (wb->count == 0)
+			break;
+		/* the block stays queued until written, for the drain */
+		block = wb->queue[wb->head];
+		failed = wb->failed;
+		_TIFFMutexUnlock(wb->mutex);
+		/* later blocks are dropped once one failed */
+		if (!failed &&
+		    _TIFFWriteBlockAt(tif, block.off, block.data, block.len) !=
+		    block.len)
+			failed = -1;
+		_TIFFMutexLock(wb->mutex);
+		if (failed < 0) {
+			wb->failed = 1;
+			wb->failoff = block.off;
+		}
+		wb->spare[wb->nspare++] = block.data;
+		wb->head = (wb->head + 1) % wb->nbuffers;
+		wb->count--;
+		_TIFFCondBroadcast(wb->cond);
+	}
+	_TIFFMutexUnlock(wb->mutex);
+}
+
+/*
+ * Hand the bytes held to the thread and take a free buffer, waiting
+ * for one if need be.  Returns 0 if an earlier block failed.
+ */
+static int
+_TIFFWriteBufferQueue(TIFF* tif)
+{
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+	TIFFWriteBlock* block;
+	int ok;
+
+	_TIFFMutexLock(wb->mutex);
+	while (wb->nspare == 0)
+		_TIFFCondWait(wb->cond, wb->mutex);
+	block = &wb->queue[(wb->head + wb->count) % wb->nbuffers];
+	block->data = wb->data;
+	block->len = wb->len;
+	block->off = wb->off;
+	wb->count++;
+	wb->data = wb->spare[--wb->nspare];
+	ok = !wb->failed;
+	_TIFFCondBroadcast(wb->cond);
+	_TIFFMutexUnlock(wb->mutex);
+	wb->len = 0;
+	return (ok);
+}
+
+/*
+ * Write out the bytes held.  Returns 0 on error; they are dropped then.
+ * With a write-behind thread, this waits for it to write all the
+ * blocks queued, and reports the first one it could not write.
+ */
+int
+_TIFFWriteBufferFlush(TIFF* tif)
+{
+	static const char module[] = "_TIFFWriteBufferFlush";
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+	tmsize_t len;
+	uint64 failoff;
+	int failed;
+
+	if (wb == NULL)
+		return (1);
+	if (wb->thread != NULL) {
+		if (wb->len > 0)
+			(void) _TIFFWriteBufferQueue(tif);
+		_TIFFMutexLock(wb->mutex);
+		while (wb->count > 0)
+			_TIFFCondWait(wb->cond, wb->mutex);
+		failed = wb->failed;
+		failoff = wb->failoff;
+		wb->failed = 0;
+		_TIFFMutexUnlock(wb->mutex);
+		if (failed) {
+			TIFFErrorExtR(tif, module,
+			    "IO error writing buffered data at offset "
+			    TIFF_UINT64_FORMAT, (TIFF_UINT64_T) failoff);
+			return (0);
+		}
+		return (1);
+	}
+	if (wb->len == 0)
+		return (1);
+	len = wb->len;
+	wb->len = 0;
+	if (_TIFFWriteBufferPut(tif, wb->off, wb->data, len) != len) {
+		TIFFErrorExtR(tif, module,
+		    "IO error writing buffered data at offset "
+		    TIFF_UINT64_FORMAT, (TIFF_UINT64_T) wb->off);
+		return (0);
+	}
+	return (1);
+}
+
+/*
+ * Copy writes of any size through the buffers of the write-behind
+ * thread, so that large strips and tiles are written behind too.
+ */
+static tmsize_t
+_TIFFWriteBehind(TIFF* tif, const void* buf, tmsize_t size)
+{
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+	const uint8* p = (const uint8*) buf;
+	tmsize_t left = size, n;
+
+	if (wb->len > 0 && wb->pos != wb->off + (uint64) wb->len &&
+	    !_TIFFWriteBufferQueue(tif))
+		return ((tmsize_t) -1);
+	while (left > 0) {
+		if (wb->len == 0)
+			wb->off = wb->pos;
+		n = wb->size - wb->len;
+		if (n > left)
+			n = left;
+		_TIFFmemcpy(wb->data + wb->len, p, n);
+		wb->len += n;
+		wb->pos += (uint64) n;
+		p += n;
+		left -= n;
+		if (wb->len == wb->size && !_TIFFWriteBufferQueue(tif))
+			return ((tmsize_t) -1);
+	}
+	if (wb->endvalid && wb->pos > wb->end)
+		wb->end = wb->pos;
+	return (size);
+}
+
+tmsize_t
+_TIFFWriteBufferWrite(TIFF* tif, const void* buf, tmsize_t size)
+{
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+	tmsize_t n;
+
+	if (size <= 0)
+		return (0);
+	if (wb->thread != NULL)
+		return (_TIFFWriteBehind(tif, buf, size));
+	if (wb->len > 0 && (wb->pos != wb->off + (uint64) wb->len ||
+	    size > wb->size - wb->len)) {
+		if (!_TIFFWriteBufferFlush(tif))
+			return ((tmsize_t) -1);
+	}
+	if (size >= wb->size) {
+		/* too large to be worth copying */
+		n = _TIFFWriteBufferPut(tif, wb->pos, buf, size);
+		if (n > 0)
+			wb->pos += (uint64) n;
+		return (n);
+	}
+	if (wb->len == 0)
+		wb->off = wb->pos;
+	_TIFFmemcpy(wb->data + wb->len, buf, size);
+	wb->len += size;
+	wb->pos += (uint64) size;
+	if (wb->endvalid && wb->pos > wb->end)
+		wb->end = wb->pos;
+	return (size);
+}
+
+tmsize_t
+_TIFFWriteBufferRead(TIFF* tif, void* buf, tmsize_t size)
+{
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+	tmsize_t n;
+
+	if (!_TIFFWriteBufferFlush(tif))
+		return ((tmsize_t) -1);
+	if (_TIFFCallSeekProc(tif, wb->pos, SEEK_SET) != wb->pos)
+		return ((tmsize_t) -1);
+	n = _TIFFCallReadProc(tif, buf, size);
+	if (n > 0)
+		wb->pos += (uint64) n;
+	return (n);
+}
+
+uint64
+_TIFFWriteBufferSeek(TIFF* tif, uint64 off, int whence)
+{
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+
+	switch (whence) {
+	case SEEK_SET:
+		wb->pos = off;
+		break;
+	case SEEK_CUR:
+		wb->pos += off;
+		break;
+	case SEEK_END:
+		if (!wb->endvalid) {
+			uint64 end;
+
+			/* the thread may be using the file */
+			if (wb->thread != NULL && !_TIFFWriteBufferFlush(tif))
+				return ((uint64) -1);
+			end = _TIFFCallSeekProc(tif, 0, SEEK_END);
+			if (end == (uint64) -1)
+				return (end);
+			if (wb->len > 0 && wb->off + (uint64) wb->len > end)
+				end = wb->off + (uint64) wb->len;
+			wb->end = end;
+			wb->endvalid = 1;
+		}
+		wb->pos = wb->end + off;
+		break;
+	default:
+		return ((uint64) -1);
+	}
+	return (wb->pos);
+}
+
+/*
+ * Set up a buffer of size bytes, and with nbuffers > 1 a write-behind
+ * thread using as many buffers.  The thread is left out if threads are
+ * not supported.  The position starts where the file is at the time,
+ * at its beginning when it has just been opened.
+ */
+static int
+_TIFFWriteBehindInit(TIFF* tif, int nbuffers)
+{
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+	int i;
+
+	wb->queue = (TIFFWriteBlock*) _TIFFmallocExt(tif,
+	    nbuffers * sizeof(TIFFWriteBlock));
+	wb->spare = (uint8**) _TIFFmallocExt(tif, nbuffers * sizeof(uint8*));
+	if (wb->queue == NULL || wb->spare == NULL)
+		return (0);
+	wb->nbuffers = nbuffers;
+	for (i = 1; i < nbuffers; i++) {
+		wb->spare[wb->nspare] = (uint8*) _TIFFmallocExt(tif, wb->size);
+		if (wb->spare[wb->nspare] == NULL)
+			return (0);
+		wb->nspare++;
+	}
+	wb->mutex = _TIFFMutexCreate();
+	wb->cond = _TIFFCondCreate();
+	if (wb->mutex == NULL || wb->cond == NULL)
+		return (0);
+	wb->thread = _TIFFThreadCreate(_TIFFWriteBehindThread, tif);
+	return (wb->thread != NULL);
+}
+
+int
+_TIFFWriteBufferInit(TIFF* tif, tmsize_t size, int nbuffers)
+{
+	static const char module[] = "_TIFFWriteBufferInit";
+	TIFFWriteBuffer* wb;
+
+	wb = (TIFFWriteBuffer*) _TIFFmallocExt(tif, sizeof(TIFFWriteBuffer));
+	if (wb == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for write buffer");
+		return (0);
+	}
+	_TIFFmemset(wb, 0, sizeof(TIFFWriteBuffer));
+	wb->data = (uint8*) _TIFFmallocExt(tif, size);
+	if (wb->data == NULL) {
+		TIFFErrorExtR(tif, module,
+		    "No space for write buffer");
+		_TIFFfreeExt(tif, wb);
+		return (0);
+	}
+	wb->size = size;
+	wb->pos = _TIFFCallSeekProc(tif, 0, SEEK_CUR);
+	if (wb->pos == (uint64) -1)
+		wb->pos = 0;
+	tif->tif_writebuffer = wb;
+	if (nbuffers > 1 && _TIFFHaveThreads() &&
+	    !_TIFFWriteBehindInit(tif, nbuffers)) {
+		TIFFErrorExtR(tif, module,
+		    "Cannot start the write-behind thread");
+		_TIFFFreeWriteBuffer(tif);
+		return (0);
+	}
+	return (1);
+}
+
+/*
+ * Write out and release the buffer.  Returns 0 if the held bytes could
+ * not be written.
+ */
+int
+_TIFFFreeWriteBuffer(TIFF* tif)
+{
+	TIFFWriteBuffer* wb = tif->tif_writebuffer;
+	int ok, i;
+
+	if (wb == NULL)
+		return (1);
+	ok = _TIFFWriteBufferFlush(tif);
+	if (wb->thread != NULL) {
+		_TIFFMutexLock(wb->mutex);
+		wb->stop = 1;
+		_TIFFCondBroadcast(wb->cond);
+		_TIFFMutexUnlock(wb->mutex);
+		_TIFFThreadJoin(wb->thread);
+	}
+	_TIFFMutexDestroy(wb->mutex);
+	_TIFFCondDestroy(wb->cond);
+	for (i = 0; i < wb->nspare; i++)
+		_TIFFfreeExt(tif, wb->spare[i]);
+	if (wb->spare)
+		_TIFFfreeExt(tif, wb->spare);
+	if (wb->queue)
+		_TIFFfreeExt(tif, wb->queue);
+	_TIFFfreeExt(tif, wb->data);
+	_TIFFfreeExt(tif, wb);
+	tif->tif_writebuffer = NULL;
+	return (ok);
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -43,9 +43,23 @@
  * zlib-3.1.doc, deflate-1.1.doc and gzip-4.1.doc, available in the
  * directory ftp://ftp.uu.net/pub/archiving/zip/doc.  The library was
  * last found at ftp://ftp.uu.net/pub/archiving/zip/zlib/zlib-0.99.tar.gz.
+ *
+ * When built with LIBDEFLATE_SUPPORT, whole strips and tiles are
+ * handed to libdeflate, which is noticeably faster than zlib for
+ * one-shot buffers.  Partial reads (scanline access) and writes that
+ * are not a whole chunk still go through the zlib streaming interface.
+ *
+ * With TIFFTAG_ZIP_THREADS a whole strip or tile of at least two blocks
+ * is compressed as pigz does: each thread deflates one block as a raw
+ * stream primed with the 32 KiB of data before it and ending on a full
+ * flush, and the blocks are joined under one zlib header and the Adler-32
+ * combined from theirs.  The result is a single ordinary zlib stream.
  */
 #include "tif_predict.h"
 #include "zlib.h"
+#if LIBDEFLATE_SUPPORT
+#include "libdeflate.h"
+#endif
 
 #include <stdio.h>
 
@@ -61,6 +75,17 @@
 
 #define SAFE_MSG(sp)   ((sp)->stream.msg == NULL ? "" : (sp)->stream.msg)
 
+#if LIBDEFLATE_SUPPORT
+#define LIBDEFLATE_MAX_COMPRESSION_LEVEL 12
+#endif
+
+/* Smallest block handed to a thread, and the window primed from before it */
+#define ZIP_MIN_BLOCK_SIZE ((tmsize_t) 128 * 1024)
+#define ZIP_WINDOW_SIZE ((tmsize_t) 32 * 1024)
+
+/* Output asked of inflate() at a time, see ZIPDecode() */
+#define ZIP_DECODE_BLOCK_SIZE ((tmsize_t) 1024 * 1024)
+
 /*
  * State block for each open TIFF
  * file using ZIP compression/decompression.
@@ -69,9 +94,16 @@ typedef struct {
 	TIFFPredictorState predict;
         z_stream        stream;
 	int             zipquality;            /* compression level */
+	int             threads;               /* encoder threads */
+	int             blocksdone;            /* chunk encoded in blocks */
 	int             state;                 /* state flags */
 #define ZSTATE_INIT_DECODE 0x01
 #define ZSTATE_INIT_ENCODE 0x02
+#if LIBDEFLATE_SUPPORT
+	int             libdeflate_state;      /* -1 = undecided, 0 = zlib, 1 = done */
+	struct libdeflate_decompressor* libdeflate_dec;
+	struct libdeflate_compressor*   libdeflate_enc;
+#endif
 
 	TIFFVGetMethod  vgetparent;            /* super-class method */
 	TIFFVSetMethod  vsetparent;            /* super-class method */
@@ -84,6 +116,32 @@ typedef struct {
 static int ZIPEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s);
 static int ZIPDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s);
 
+/*
+ * zlib allocator hooks, used when the handle has its own allocator
+ * or keeps track of its memory.
+ */
+static voidpf
+ZIPAlloc(voidpf opaque, uInt items, uInt size)
+{
+	return (_TIFFcallocExt((TIFF*) opaque, (tmsize_t) items, (tmsize_t) size));
+}
+
+static void
+ZIPFree(voidpf opaque, voidpf ptr)
+{
+	_TIFFfreeExt((TIFF*) opaque, ptr);
+}
+
+/*
+ * zlib only knows levels up to 9; higher libdeflate levels map to
+ * its best compression.
+ */
+static int
+ZIPZlibLevel(int zipquality)
+{
+	return (zipquality > Z_BEST_COMPRESSION ? Z_BEST_COMPRESSION : zipquality);
+}
+
 static int
 ZIPFixupTags(TIFF* tif)
 {
@@ -110,7 +168,7 @@ ZIPSetupDecode(TIFF* tif)
 	/* PredictorSetup() fails */
 	if ((sp->state & ZSTATE_INIT_DECODE) == 0 &&
 	    inflateInit(&sp->stream) != Z_OK) {
-		TIFFErrorExt(tif->tif_clientdata, module, "%s", SAFE_MSG(sp));
+		TIFFErrorExtR(tif, module, "%s", SAFE_MSG(sp));
 		return (0);
 	} else {
 		sp->state |= ZSTATE_INIT_DECODE;
@@ -141,9 +199,12 @@ ZIPPreDecode(TIFF* tif, uint16 s)
 	sp->stream.avail_in = (uInt) tif->tif_rawcc;
 	if ((tmsize_t)sp->stream.avail_in != tif->tif_rawcc)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "ZLib cannot deal with buffers this size");
+		TIFFErrorExtR(tif, module, "ZLib cannot deal with buffers this size");
 		return (0);
 	}
+#if LIBDEFLATE_SUPPORT
+	sp->libdeflate_state = -1;
+#endif
 	return (inflateReset(&sp->stream) == Z_OK);
 }
 
@@ -152,31 +213,59 @@ ZIPDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 {
 	static const char module[] = "ZIPDecode";
 	ZIPState* sp = DecoderState(tif);
+	tmsize_t left;
 
 	(void) s;
 	assert(sp != NULL);
 	assert(sp->state == ZSTATE_INIT_DECODE);
 
+#if LIBDEFLATE_SUPPORT
+	if (sp->libdeflate_state == 1)
+		return (0);
+
+	/*
+	 * Decode a whole strip or tile in one go with libdeflate.  Only a
+	 * fully successful decode is kept; on any other outcome the zlib
+	 * stream, which has not been touched yet, decodes the data instead
+	 * so that errors and partial output are reported as before.
+	 */
+	if (sp->libdeflate_state == -1 && _TIFFIsWholeChunk(tif, occ) &&
+	    (uint64)(size_t) tif->tif_rawcc == (uint64) tif->tif_rawcc &&
+	    (uint64)(size_t) occ == (uint64) occ) {
+		if (sp->libdeflate_dec == NULL)
+			sp->libdeflate_dec = libdeflate_alloc_decompressor();
+		if (sp->libdeflate_dec != NULL &&
+		    libdeflate_zlib_decompress(sp->libdeflate_dec,
+			tif->tif_rawcp, (size_t) tif->tif_rawcc,
+			op, (size_t) occ, NULL) == LIBDEFLATE_SUCCESS) {
+			sp->libdeflate_state = 1;
+			tif->tif_rawcp += tif->tif_rawcc;
+			tif->tif_rawcc = 0;
+			return (1);
+		}
+	}
+	sp->libdeflate_state = 0;
+#endif
+
         sp->stream.next_in = tif->tif_rawcp;
 	sp->stream.avail_in = (uInt) tif->tif_rawcc;
         
 	sp->stream.next_out = op;
-	assert(sizeof(sp->stream.avail_out)==4);  /* if this assert gets raised,
-	    we need to simplify this code to reflect a ZLib that is likely updated
-	    to deal with 8byte memory sizes, though this code will respond
-	    appropriately even before we simplify it */
-	sp->stream.avail_out = (uInt) occ;
-	if ((tmsize_t)sp->stream.avail_out != occ)
-	{
-		TIFFErrorExt(tif->tif_clientdata, module, "ZLib cannot deal with buffers this size");
-		return (0);
-	}
+	/*
+	 * Hand out the output a block at a time, so that cancellation is
+	 * noticed in large strips and tiles and so that zlib never sees
+	 * a size beyond its 32-bit counters.
+	 */
+	left = occ;
+	sp->stream.avail_out = (uInt) (left < ZIP_DECODE_BLOCK_SIZE ?
+	    left : ZIP_DECODE_BLOCK_SIZE);
+	left -= sp->stream.avail_out;
 	do {
 		int state = inflate(&sp->stream, Z_PARTIAL_FLUSH);
 		if (state == Z_STREAM_END)
 			break;
 		if (state == Z_DATA_ERROR) {
-			TIFFErrorExt(tif->tif_clientdata, module,
+			TIFFErrorExtR(tif, module,
 			    "Decoding error at scanline %lu, %s",
 			     (unsigned long) tif->tif_row, SAFE_MSG(sp));
 			if (inflateSync(&sp->stream) != Z_OK)
@@ -184,15 +273,23 @@ ZIPDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 			continue;
 		}
 		if (state != Z_OK) {
-			TIFFErrorExt(tif->tif_clientdata, module, 
+			TIFFErrorExtR(tif, module, 
 				     "ZLib error: %s", SAFE_MSG(sp));
 			return (0);
 		}
+		if (sp->stream.avail_out == 0 && left > 0) {
+			if (_TIFFCheckCancel(tif, module))
+				return (0);
+			sp->stream.avail_out = (uInt) (left <
+			    ZIP_DECODE_BLOCK_SIZE ? left : ZIP_DECODE_BLOCK_SIZE);
+			left -= sp->stream.avail_out;
+		}
 	} while (sp->stream.avail_out > 0);
 	if (sp->stream.avail_out != 0) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 		    "Not enough data at scanline %lu (short " TIFF_UINT64_FORMAT " bytes)",
-		    (unsigned long) tif->tif_row, (TIFF_UINT64_T) sp->stream.avail_out);
+		    (unsigned long) tif->tif_row,
+		    (TIFF_UINT64_T) (sp->stream.avail_out + left));
 		return (0);
 	}
 
@@ -202,6 +299,56 @@ ZIPDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
 	return (1);
 }
 
+/*
+ * Decoder checkpoints: a copy of the inflate stream, window included.
+ * The input pointers are set again by ZIPDecode().
+ */
+static void*
+ZIPSaveState(TIFF* tif)
+{
+	ZIPState* sp = DecoderState(tif);
+	z_stream* copy;
+
+	if (sp->state != ZSTATE_INIT_DECODE)
+		return (NULL);
+	copy = (z_stream*) _TIFFmallocExt(tif, sizeof(z_stream));
+	if (copy == NULL)
+		return (NULL);
+	if (inflateCopy(copy, &sp->stream) != Z_OK) {
+		_TIFFfreeExt(tif, copy);
+		return (NULL);
+	}
+	return (copy);
+}
+
+static int
+ZIPRestoreState(TIFF* tif, void* state)
+{
+	ZIPState* sp = DecoderState(tif);
+
+	if (sp->state != ZSTATE_INIT_DECODE)
+		return (0);
+	/* zlib streams refer to themselves, so copy in place */
+	inflateEnd(&sp->stream);
+	if (inflateCopy(&sp->stream, (z_stream*) state) != Z_OK) {
+		/* Leave a stream the next strip can start with */
+		if (inflateInit(&sp->stream) != Z_OK)
+			sp->state = 0;
+		return (0);
+	}
+#if LIBDEFLATE_SUPPORT
+	sp->libdeflate_state = 0;
+#endif
+	return (1);
+}
+
+static void
+ZIPFreeState(TIFF* tif, void* state)
+{
+	inflateEnd((z_stream*) state);
+	_TIFFfreeExt(tif, state);
+}
+
 static int
 ZIPSetupEncode(TIFF* tif)
 {
@@ -214,8 +361,8 @@ ZIPSetupEncode(TIFF* tif)
 		sp->state = 0;
 	}
 
-	if (deflateInit(&sp->stream, sp->zipquality) != Z_OK) {
-		TIFFErrorExt(tif->tif_clientdata, module, "%s", SAFE_MSG(sp));
+	if (deflateInit(&sp->stream, ZIPZlibLevel(sp->zipquality)) != Z_OK) {
+		TIFFErrorExtR(tif, module, "%s", SAFE_MSG(sp));
 		return (0);
 	} else {
 		sp->state |= ZSTATE_INIT_ENCODE;
@@ -245,12 +392,173 @@ ZIPPreEncode(TIFF* tif, uint16 s)
 	sp->stream.avail_out = (uInt)tif->tif_rawdatasize;
 	if ((tmsize_t)sp->stream.avail_out != tif->tif_rawdatasize)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "ZLib cannot deal with buffers this size");
+		TIFFErrorExtR(tif, module, "ZLib cannot deal with buffers this size");
 		return (0);
 	}
+#if LIBDEFLATE_SUPPORT
+	sp->libdeflate_state = -1;
+#endif
+	sp->blocksdone = 0;
 	return (deflateReset(&sp->stream) == Z_OK);
 }
 
+/*
+ * A block of a strip or tile compressed by one thread.
+ */
+typedef struct {
+	const uint8*	in;
+	tmsize_t	inlen;
+	uInt		dictlen;	/* bytes before in to prime with */
+	int		level;
+	int		last;		/* finish the deflate stream */
+	uint8*		out;
+	tmsize_t	outlen;		/* room at out, then bytes stored */
+	uLong		adler;		/* Adler-32 of the block */
+	int		ok;
+} ZIPBlock;
+
+static void
+ZIPBlockEncode(void* arg)
+{
+	ZIPBlock* b = (ZIPBlock*) arg;
+	z_stream stream;
+	int ret;
+
+	b->ok = 0;
+	b->adler = adler32(adler32(0L, Z_NULL, 0), b->in, (uInt) b->inlen);
+	/* zlib's allocator: the handle's may not be called from threads */
+	_TIFFmemset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, b->level, Z_DEFLATED, -MAX_WBITS, 8,
+	    Z_DEFAULT_STRATEGY) != Z_OK)
+		return;
+	if (b->dictlen > 0 &&
+	    deflateSetDictionary(&stream, b->in - b->dictlen, b->dictlen) != Z_OK)
+		goto done;
+	stream.next_in = (Bytef*) b->in;
+	stream.avail_in = (uInt) b->inlen;
+	stream.next_out = b->out;
+	stream.avail_out = (uInt) b->outlen;
+	ret = deflate(&stream, b->last ? Z_FINISH : Z_FULL_FLUSH);
+	if (ret == (b->last ? Z_STREAM_END : Z_OK) && stream.avail_in == 0 &&
+	    stream.avail_out > 0) {
+		b->outlen -= stream.avail_out;
+		b->ok = 1;
+	}
+done:
+	deflateEnd(&stream);
+}
+
+/*
+ * Append n bytes to the raw data buffer, flushing it as it fills.
+ */
+static int
+ZIPPutBytes(TIFF* tif, const uint8* p, tmsize_t n)
+{
+	while (n > 0) {
+		tmsize_t m = tif->tif_rawdatasize - tif->tif_rawcc;
+
+		if (m == 0) {
+			if (!TIFFFlushData1(tif))
+				return (0);
+			continue;
+		}
+		if (m > n)
+			m = n;
+		_TIFFmemcpy(tif->tif_rawdata + tif->tif_rawcc, p, m);
+		tif->tif_rawcc += m;
+		p += m;
+		n -= m;
+	}
+	return (1);
+}
+
+/*
+ * Compress the whole strip or tile at bp in blocks on several threads.
+ * Returns 1 on success, 0 on error, and -1 if nothing was done and the
+ * chunk should be compressed on this thread instead.
+ */
+static int
+ZIPEncodeBlocks(TIFF* tif, uint8* bp, tmsize_t cc)
+{
+	static const char module[] = "ZIPEncodeBlocks";
+	ZIPState* sp = EncoderState(tif);
+	ZIPBlock* blocks;
+	void** args;
+	uint8 header[2], trailer[4];
+	tmsize_t blocksize, off;
+	uLong adler;
+	int level = ZIPZlibLevel(sp->zipquality), nblocks, i, ret = -1;
+
+	nblocks = sp->threads;
+	if ((tmsize_t) nblocks > cc / ZIP_MIN_BLOCK_SIZE)
+		nblocks = (int) (cc / ZIP_MIN_BLOCK_SIZE);
+	blocksize = (cc + nblocks - 1) / nblocks;
+	if ((tmsize_t)(uInt) blocksize != blocksize)
+		return (-1);
+	blocks = (ZIPBlock*) _TIFFcallocExt(tif, nblocks, sizeof(ZIPBlock));
+	args = (void**) _TIFFcallocExt(tif, nblocks, sizeof(void*));
+	if (blocks == NULL || args == NULL)
+		goto done;
+	for (i = 0, off = 0; i < nblocks; i++, off += blocksize) {
+		ZIPBlock* b = &blocks[i];
+
+		b->in = bp + off;
+		b->inlen = off + blocksize < cc ? blocksize : cc - off;
+		b->dictlen = (uInt) (off < ZIP_WINDOW_SIZE ? off : ZIP_WINDOW_SIZE);
+		b->level = level;
+		b->last = (i == nblocks - 1);
+		/* stored blocks and the flush marker at worst */
+		b->outlen = (tmsize_t) compressBound((uLong) b->inlen) + 16;
+		b->out = (uint8*) _TIFFmallocExt(tif, b->outlen);
+		if (b->out == NULL)
+			goto done;
+		args[i] = b;
+	}
+	_TIFFRunTasks(tif, nblocks, ZIPBlockEncode, args);
+
+	ret = 0;
+	for (i = 0; i < nblocks; i++)
+		if (!blocks[i].ok) {
+			TIFFErrorExtR(tif, module,
+			    "Encoder error in block %d of strip/tile", i);
+			goto done;
+		}
+	/* deflate, 32 KiB window, and the level class zlib would note */
+	header[0] = 0x78;
+	header[1] = (uint8) ((level < 0 || level == 6 ? 2 :
+	    level < 2 ? 0 : level < 6 ? 1 : 3) << 6);
+	header[1] += (uint8) (31 - (header[0] * 256 + header[1]) % 31);
+	adler = blocks[0].adler;
+	for (i = 1; i < nblocks; i++)
+		adler = adler32_combine(adler, blocks[i].adler,
+		    (z_off_t) blocks[i].inlen);
+	trailer[0] = (uint8) (adler >> 24);
+	trailer[1] = (uint8) (adler >> 16);
+	trailer[2] = (uint8) (adler >> 8);
+	trailer[3] = (uint8) adler;
+	if (!ZIPPutBytes(tif, header, 2))
+		goto done;
+	for (i = 0; i < nblocks; i++)
+		if (!ZIPPutBytes(tif, blocks[i].out, blocks[i].outlen))
+			goto done;
+	if (!ZIPPutBytes(tif, trailer, 4) || !TIFFFlushData1(tif))
+		goto done;
+	ret = 1;
+done:
+	if (ret < 0)
+		TIFFWarningExtR(tif, module,
+		    "Out of memory, compressing on a single thread");
+	if (blocks != NULL) {
+		for (i = 0; i < nblocks; i++)
+			if (blocks[i].out)
+				_TIFFfreeExt(tif, blocks[i].out);
+		_TIFFfreeExt(tif, blocks);
+	}
+	if (args != NULL)
+		_TIFFfreeExt(tif, args);
+	return (ret);
+}
+
 /*
  * Encode a chunk of pixels.
  */
@@ -264,6 +572,62 @@ ZIPEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	assert(sp->state == ZSTATE_INIT_ENCODE);
 
 	(void) s;
+
+	if (sp->blocksdone)
+		return (0);
+	if (sp->threads > 1 && cc >= 2 * ZIP_MIN_BLOCK_SIZE &&
+	    _TIFFIsWholeChunk(tif, cc)) {
+		int ret = ZIPEncodeBlocks(tif, bp, cc);
+
+		if (ret >= 0) {
+			sp->blocksdone = ret;
+			return (ret);
+		}
+	}
+
+#if LIBDEFLATE_SUPPORT
+	if (sp->libdeflate_state == 1)
+		return (0);
+
+	/*
+	 * Compress a whole strip or tile in one go with libdeflate when
+	 * the result is guaranteed to fit in the raw data buffer.
+	 * libdeflate has no stored-only level, so level 0 stays on zlib.
+	 */
+	if (sp->libdeflate_state == -1 && sp->zipquality != Z_NO_COMPRESSION &&
+	    _TIFFIsWholeChunk(tif, cc) && (uint64)(size_t) cc == (uint64) cc) {
+		if (sp->libdeflate_enc == NULL) {
+			int level = sp->zipquality;
+
+			/* Match zlib's default, and its 6..9 levels */
+			/* roughly correspond to libdeflate's 7..10. */
+			if (level == Z_DEFAULT_COMPRESSION)
+				level = 7;
+			else if (level >= 6 && level <= 9)
+				level++;
+			sp->libdeflate_enc = libdeflate_alloc_compressor(level);
+		}
+		if (sp->libdeflate_enc != NULL &&
+		    libdeflate_zlib_compress_bound(sp->libdeflate_enc,
+			(size_t) cc) <= (size_t) tif->tif_rawdatasize) {
+			size_t nbytes = libdeflate_zlib_compress(
+				sp->libdeflate_enc, bp, (size_t) cc,
+				tif->tif_rawdata, (size_t) tif->tif_rawdatasize);
+
+			if (nbytes == 0) {
+				TIFFErrorExtR(tif, module,
+					     "Encoder error at scanline %lu",
+					     (unsigned long) tif->tif_row);
+				return (0);
+			}
+			sp->libdeflate_state = 1;
+			tif->tif_rawcc = (tmsize_t) nbytes;
+			return (TIFFFlushData1(tif));
+		}
+	}
+	sp->libdeflate_state = 0;
+#endif
+
 	sp->stream.next_in = bp;
 	assert(sizeof(sp->stream.avail_in)==4);  /* if this assert gets raised,
 	    we need to simplify this code to reflect a ZLib that is likely updated
@@ -272,12 +636,12 @@ ZIPEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
 	sp->stream.avail_in = (uInt) cc;
 	if ((tmsize_t)sp->stream.avail_in != cc)
 	{
-		TIFFErrorExt(tif->tif_clientdata, module, "ZLib cannot deal with buffers this size");
+		TIFFErrorExtR(tif, module, "ZLib cannot deal with buffers this size");
 		return (0);
 	}
 	do {
 		if (deflate(&sp->stream, Z_NO_FLUSH) != Z_OK) {
-			TIFFErrorExt(tif->tif_clientdata, module, 
+			TIFFErrorExtR(tif, module, 
 				     "Encoder error: %s",
 				     SAFE_MSG(sp));
 			return (0);
@@ -303,6 +667,13 @@ ZIPPostEncode(TIFF* tif)
 	ZIPState *sp = EncoderState(tif);
 	int state;
 
+	if (sp->blocksdone)
+		return (1);
+#if LIBDEFLATE_SUPPORT
+	if (sp->libdeflate_state == 1)
+		return (1);
+#endif
+
 	sp->stream.avail_in = 0;
 	do {
 		state = deflate(&sp->stream, Z_FINISH);
@@ -318,7 +689,7 @@ ZIPPostEncode(TIFF* tif)
 			}
 			break;
 		default:
-			TIFFErrorExt(tif->tif_clientdata, module, 
+			TIFFErrorExtR(tif, module, 
 				     "ZLib error: %s", SAFE_MSG(sp));
 			return (0);
 		}
@@ -345,7 +716,13 @@ ZIPCleanup(TIFF* tif)
 		inflateEnd(&sp->stream);
 		sp->state = 0;
 	}
-	_TIFFfree(sp);
+#if LIBDEFLATE_SUPPORT
+	if (sp->libdeflate_dec)
+		libdeflate_free_decompressor(sp->libdeflate_dec);
+	if (sp->libdeflate_enc)
+		libdeflate_free_compressor(sp->libdeflate_enc);
+#endif
+	_TIFFfreeExt(tif, sp);
 	tif->tif_data = NULL;
 
 	_TIFFSetDefaultCompressionState(tif);
@@ -360,15 +737,45 @@ ZIPVSetField(TIFF* tif, uint32 tag, va_list ap)
 	switch (tag) {
 	case TIFFTAG_ZIPQUALITY:
 		sp->zipquality = (int) va_arg(ap, int);
+#if LIBDEFLATE_SUPPORT
+		if (sp->zipquality < Z_DEFAULT_COMPRESSION ||
+		    sp->zipquality > LIBDEFLATE_MAX_COMPRESSION_LEVEL) {
+			TIFFErrorExtR(tif, module,
+			    "Invalid ZipQuality value. Should be in [-1,%d] range",
+			    LIBDEFLATE_MAX_COMPRESSION_LEVEL);
+			return (0);
+		}
+		if (sp->libdeflate_enc) {
+			libdeflate_free_compressor(sp->libdeflate_enc);
+			sp->libdeflate_enc = NULL;
+		}
+#else
+		if (sp->zipquality < Z_DEFAULT_COMPRESSION ||
+		    sp->zipquality > Z_BEST_COMPRESSION) {
+			TIFFErrorExtR(tif, module,
+			    "Invalid ZipQuality value. Should be in [-1,%d] range",
+			    Z_BEST_COMPRESSION);
+			return (0);
+		}
+#endif
 		if ( sp->state&ZSTATE_INIT_ENCODE ) {
 			if (deflateParams(&sp->stream,
-			    sp->zipquality, Z_DEFAULT_STRATEGY) != Z_OK) {
-				TIFFErrorExt(tif->tif_clientdata, module, "ZLib error: %s",
+			    ZIPZlibLevel(sp->zipquality), Z_DEFAULT_STRATEGY) != Z_OK) {
+				TIFFErrorExtR(tif, module, "ZLib error: %s",
 					     SAFE_MSG(sp));
 				return (0);
 			}
 		}
 		return (1);
+	case TIFFTAG_ZIP_THREADS:
+		sp->threads = (int) va_arg(ap, int);
+		if (sp->threads < 0) {
+			TIFFErrorExtR(tif, module,
+			    "ZIP_THREADS should not be negative");
+			sp->threads = 0;
+			return (0);
+		}
+		return (1);
 	default:
 		return (*sp->vsetparent)(tif, tag, ap);
 	}
@@ -384,6 +791,9 @@ ZIPVGetField(TIFF* tif, uint32 tag, va_list ap)
 	case TIFFTAG_ZIPQUALITY:
 		*va_arg(ap, int*) = sp->zipquality;
 		break;
+	case TIFFTAG_ZIP_THREADS:
+		*va_arg(ap, int*) = sp->threads;
+		break;
 	default:
 		return (*sp->vgetparent)(tif, tag, ap);
 	}
@@ -392,6 +802,7 @@ ZIPVGetField(TIFF* tif, uint32 tag, va_list ap)
 
 static const TIFFField zipFields[] = {
     { TIFFTAG_ZIPQUALITY, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, TRUE, FALSE, "", NULL },
+    { TIFFTAG_ZIP_THREADS, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT, TIFF_SETGET_UNDEFINED, FIELD_PSEUDO, TRUE, FALSE, "Deflate Encoder Threads", NULL },
 };
 
 int
@@ -407,7 +818,7 @@ TIFFInitZIP(TIFF* tif, int scheme)
 	 * Merge codec-specific tag information.
 	 */
 	if (!_TIFFMergeFields(tif, zipFields, TIFFArrayCount(zipFields))) {
-		TIFFErrorExt(tif->tif_clientdata, module,
+		TIFFErrorExtR(tif, module,
 			     "Merging Deflate codec-specific tags failed");
 		return 0;
 	}
@@ -415,13 +826,19 @@ TIFFInitZIP(TIFF* tif, int scheme)
 	/*
 	 * Allocate state block so tag methods have storage to record values.
 	 */
-	tif->tif_data = (uint8*) _TIFFmalloc(sizeof (ZIPState));
+	tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof (ZIPState));
 	if (tif->tif_data == NULL)
 		goto bad;
 	sp = ZState(tif);
-	sp->stream.zalloc = NULL;
-	sp->stream.zfree = NULL;
-	sp->stream.opaque = NULL;
+	if (tif->tif_mallocproc != NULL || tif->tif_memaccount != NULL) {
+		sp->stream.zalloc = ZIPAlloc;
+		sp->stream.zfree = ZIPFree;
+		sp->stream.opaque = (voidpf) tif;
+	} else {
+		sp->stream.zalloc = NULL;
+		sp->stream.zfree = NULL;
+		sp->stream.opaque = NULL;
+	}
 	sp->stream.data_type = Z_BINARY;
 
 	/*
@@ -434,7 +851,14 @@ TIFFInitZIP(TIFF* tif, int scheme)
 
 	/* Default values for codec-specific fields */
 	sp->zipquality = Z_DEFAULT_COMPRESSION;	/* default comp. level */
+	sp->threads = 0;
+	sp->blocksdone = 0;
 	sp->state = 0;
+#if LIBDEFLATE_SUPPORT
+	sp->libdeflate_state = -1;
+	sp->libdeflate_dec = NULL;
+	sp->libdeflate_enc = NULL;
+#endif
 
 	/*
 	 * Install codec methods.
@@ -445,6 +869,9 @@ TIFFInitZIP(TIFF* tif, int scheme)
 	tif->tif_decoderow = ZIPDecode;
 	tif->tif_decodestrip = ZIPDecode;
 	tif->tif_decodetile = ZIPDecode;  
+	tif->tif_savestate = ZIPSaveState;
+	tif->tif_restorestate = ZIPRestoreState;
+	tif->tif_freestate = ZIPFreeState;
 	tif->tif_setupencode = ZIPSetupEncode;
 	tif->tif_preencode = ZIPPreEncode;
 	tif->tif_postencode = ZIPPostEncode;
@@ -456,9 +883,13 @@ TIFFInitZIP(TIFF* tif, int scheme)
 	 * Setup predictor setup.
 	 */
 	(void) TIFFPredictorInit(tif);
+#if !LIBDEFLATE_SUPPORT
+	/* libdeflate only decodes whole chunks, so leave those alone */
+	sp->predict.batchdecode = 1;
+#endif
 	return (1);
 bad:
-	TIFFErrorExt(tif->tif_clientdata, module,
+	TIFFErrorExtR(tif, module,
 		     "No space for ZIP state block");
 	return (0);
 }
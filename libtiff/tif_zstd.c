@@ -29,6 +29,12 @@
 *
 * ZSTD Compression Support
 *
+* Compression and decompression contexts are kept for the life of the
+* handle and reset for each strip or tile.  With libzstd 1.4.0 or later
+* the advanced parameters (window size, long distance matching, worker
+* threads and a shared dictionary) are available as pseudo-tags, and
+* whole strips and tiles are decoded with a single ZSTD_decompressDCtx()
+* call.
 */
 
 #include "tif_predict.h"
@@ -36,6 +42,15 @@
 
 #include <stdio.h>
 
+#if defined(ZSTD_VERSION_NUMBER) && ZSTD_VERSION_NUMBER >= 10400
+#define ZSTD_ADVANCED_API 1
+#else
+#define ZSTD_ADVANCED_API 0
+#endif
+
+/* Largest window accepted by default by the decoder, as per zstd.h */
+#define ZSTD_DEFAULT_WINDOWLOG_LIMIT 27
+
 /*
 * State block for each open TIFF file using ZSTD compression/decompression.
 */
@@ -44,6 +59,17 @@ typedef struct {
         ZSTD_DStream*   dstream;
         ZSTD_CStream*   cstream;
         int             compression_level;      /* compression level */
+        int             window_log;             /* 0 = library default */
+        int             long_distance;          /* long distance matching */
+        int             nb_workers;             /* compression threads */
+        uint8*          dictionary;             /* shared dictionary */
+        uint32          dictionary_size;
+#if ZSTD_ADVANCED_API
+        ZSTD_CDict*     cdict;                  /* digested dictionary */
+        int             cdict_level;            /* ... for this level */
+        ZSTD_DDict*     ddict;
+        int             decode_started;         /* chunk partly decoded */
+#endif
         ZSTD_outBuffer  out_buffer;
         int             state;                  /* state flags */
 #define LSTATE_INIT_DECODE 0x01
@@ -101,25 +127,50 @@ ZSTDPreDecode(TIFF* tif, uint16 s)
         if( (sp->state & LSTATE_INIT_DECODE) == 0 )
             tif->tif_setupdecode(tif);
 
-        if( sp->dstream )
-        {
-            ZSTD_freeDStream(sp->dstream);
-            sp->dstream = NULL;
-        }
-
-        sp->dstream = ZSTD_createDStream();
         if( sp->dstream == NULL ) {
-            TIFFErrorExt(tif->tif_clientdata, module,
-                         "Cannot allocate decompression stream");
+            sp->dstream = ZSTD_createDStream();
+            if( sp->dstream == NULL ) {
+                TIFFErrorExtR(tif, module,
+                             "Cannot allocate decompression stream");
+                return 0;
+            }
+        }
+#if ZSTD_ADVANCED_API
+        zstd_ret = ZSTD_DCtx_reset(sp->dstream,
+                                   ZSTD_reset_session_and_parameters);
+        if( !ZSTD_isError(zstd_ret) &&
+            sp->window_log > ZSTD_DEFAULT_WINDOWLOG_LIMIT )
+            zstd_ret = ZSTD_DCtx_setParameter(sp->dstream,
+                                              ZSTD_d_windowLogMax,
+                                              sp->window_log);
+        if( !ZSTD_isError(zstd_ret) && sp->dictionary_size > 0 ) {
+            if( sp->ddict == NULL ) {
+                sp->ddict = ZSTD_createDDict(sp->dictionary,
+                                             sp->dictionary_size);
+                if( sp->ddict == NULL ) {
+                    TIFFErrorExtR(tif, module,
+                                 "Cannot load decompression dictionary");
+                    return 0;
+                }
+            }
+            zstd_ret = ZSTD_DCtx_refDDict(sp->dstream, sp->ddict);
+        }
+        if( ZSTD_isError(zstd_ret) ) {
+            TIFFErrorExtR(tif, module,
+                         "Cannot set decompression parameters: %s",
+                         ZSTD_getErrorName(zstd_ret));
             return 0;
         }
+        sp->decode_started = 0;
+#else
         zstd_ret = ZSTD_initDStream(sp->dstream);
         if( ZSTD_isError(zstd_ret) ) {
-            TIFFErrorExt(tif->tif_clientdata, module,
+            TIFFErrorExtR(tif, module,
                          "Error in ZSTD_initDStream(): %s",
                          ZSTD_getErrorName(zstd_ret));
             return 0;
         }
+#endif
 
         return 1;
 }
@@ -137,6 +188,27 @@ ZSTDDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
         assert(sp != NULL);
         assert(sp->state == LSTATE_INIT_DECODE);
 
+#if ZSTD_ADVANCED_API
+        /*
+         * Decode a whole strip or tile in one call.  If that does not
+         * produce exactly the expected amount of data, start over with
+         * the streaming decoder, which reports errors and tolerates
+         * over-long chunks as it always has.
+         */
+        if( !sp->decode_started && _TIFFIsWholeChunk(tif, occ) ) {
+                zstd_ret = ZSTD_decompressDCtx(sp->dstream, op, (size_t) occ,
+                                               tif->tif_rawcp,
+                                               (size_t) tif->tif_rawcc);
+                if( !ZSTD_isError(zstd_ret) && zstd_ret == (size_t) occ ) {
+                        tif->tif_rawcp += tif->tif_rawcc;
+                        tif->tif_rawcc = 0;
+                        return 1;
+                }
+                ZSTD_DCtx_reset(sp->dstream, ZSTD_reset_session_only);
+        }
+        sp->decode_started = 1;
+#endif
+
         in_buffer.src = tif->tif_rawcp;
         in_buffer.size = (size_t) tif->tif_rawcc;
         in_buffer.pos = 0;
@@ -149,7 +221,7 @@ ZSTDDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
                 zstd_ret = ZSTD_decompressStream(sp->dstream, &out_buffer,
                                                  &in_buffer);
                 if( ZSTD_isError(zstd_ret) ) {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                                 "Error in ZSTD_decompressStream(): %s",
                                 ZSTD_getErrorName(zstd_ret));
                     return 0;
@@ -159,7 +231,7 @@ ZSTDDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
                  out_buffer.pos < out_buffer.size );
 
         if (out_buffer.pos < (size_t)occ) {
-                TIFFErrorExt(tif->tif_clientdata, module,
+                TIFFErrorExtR(tif, module,
                     "Not enough data at scanline %lu (short %lu bytes)",
                     (unsigned long) tif->tif_row,
                     (unsigned long) (size_t)occ - out_buffer.pos);
@@ -172,6 +244,70 @@ ZSTDDecode(TIFF* tif, uint8* op, tmsize_t occ, uint16 s)
         return 1;
 }
 
+#if ZSTD_ADVANCED_API
+/*
+* Reset the compression context and apply the codec parameters to it.
+*/
+static int
+ZSTDSetCompressionParameters(TIFF* tif)
+{
+        static const char module[] = "ZSTDPreEncode";
+        ZSTDState *sp = EncoderState(tif);
+        ZSTD_CCtx* cctx = sp->cstream;
+        size_t zstd_ret;
+
+        zstd_ret = ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+        if( !ZSTD_isError(zstd_ret) )
+            zstd_ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+                                              sp->compression_level);
+        if( !ZSTD_isError(zstd_ret) && sp->window_log != 0 )
+            zstd_ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog,
+                                              sp->window_log);
+        if( !ZSTD_isError(zstd_ret) && sp->long_distance )
+            zstd_ret = ZSTD_CCtx_setParameter(cctx,
+                                              ZSTD_c_enableLongDistanceMatching,
+                                              1);
+        if( !ZSTD_isError(zstd_ret) && sp->dictionary_size > 0 ) {
+            if( sp->cdict != NULL && sp->cdict_level != sp->compression_level ) {
+                ZSTD_freeCDict(sp->cdict);
+                sp->cdict = NULL;
+            }
+            if( sp->cdict == NULL ) {
+                sp->cdict = ZSTD_createCDict(sp->dictionary,
+                                             sp->dictionary_size,
+                                             sp->compression_level);
+                if( sp->cdict == NULL ) {
+                    TIFFErrorExtR(tif, module,
+                                 "Cannot load compression dictionary");
+                    return 0;
+                }
+                sp->cdict_level = sp->compression_level;
+            }
+            zstd_ret = ZSTD_CCtx_refCDict(cctx, sp->cdict);
+        }
+        if( ZSTD_isError(zstd_ret) ) {
+            TIFFErrorExtR(tif, module,
+                         "Cannot set compression parameters: %s",
+                         ZSTD_getErrorName(zstd_ret));
+            return 0;
+        }
+
+        /* libzstd may be built without multithreading support */
+        if( sp->nb_workers > 0 ) {
+            zstd_ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers,
+                                              sp->nb_workers);
+            if( ZSTD_isError(zstd_ret) ) {
+                TIFFWarningExtR(tif, module,
+                               "Cannot use %d worker threads, compressing "
+                               "on the calling thread: %s", sp->nb_workers,
+                               ZSTD_getErrorName(zstd_ret));
+                sp->nb_workers = 0;
+            }
+        }
+        return 1;
+}
+#endif
+
 static int
 ZSTDSetupEncode(TIFF* tif)
 {
@@ -196,31 +332,36 @@ ZSTDPreEncode(TIFF* tif, uint16 s)
 {
         static const char module[] = "ZSTDPreEncode";
         ZSTDState *sp = EncoderState(tif);
+#if !ZSTD_ADVANCED_API
         size_t zstd_ret;
+#endif
 
         (void) s;
         assert(sp != NULL);
         if( sp->state != LSTATE_INIT_ENCODE )
             tif->tif_setupencode(tif);
 
-        if (sp->cstream) {
-            ZSTD_freeCStream(sp->cstream);
-            sp->cstream = NULL;
-        }
-        sp->cstream = ZSTD_createCStream();
         if( sp->cstream == NULL ) {
-            TIFFErrorExt(tif->tif_clientdata, module,
-                         "Cannot allocate compression stream");
-            return 0;
+            sp->cstream = ZSTD_createCStream();
+            if( sp->cstream == NULL ) {
+                TIFFErrorExtR(tif, module,
+                             "Cannot allocate compression stream");
+                return 0;
+            }
         }
 
+#if ZSTD_ADVANCED_API
+        if( !ZSTDSetCompressionParameters(tif) )
+            return 0;
+#else
         zstd_ret = ZSTD_initCStream(sp->cstream, sp->compression_level);
         if( ZSTD_isError(zstd_ret) ) {
-            TIFFErrorExt(tif->tif_clientdata, module,
+            TIFFErrorExtR(tif, module,
                          "Error in ZSTD_initCStream(): %s",
                          ZSTD_getErrorName(zstd_ret));
             return 0;
         }
+#endif
 
         sp->out_buffer.dst = tif->tif_rawdata;
         sp->out_buffer.size = (size_t)tif->tif_rawdatasize;
@@ -253,16 +394,17 @@ ZSTDEncode(TIFF* tif, uint8* bp, tmsize_t cc, uint16 s)
                 zstd_ret = ZSTD_compressStream(sp->cstream, &sp->out_buffer,
                                                &in_buffer);
                 if( ZSTD_isError(zstd_ret) ) {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                                 "Error in ZSTD_compressStream(): %s",
                                 ZSTD_getErrorName(zstd_ret));
                     return 0;
                 }
                 if( sp->out_buffer.pos == sp->out_buffer.size ) {
                         tif->tif_rawcc = tif->tif_rawdatasize;
-                        TIFFFlushData1(tif);
+                        if( !TIFFFlushData1(tif) )
+                            return 0;
                         sp->out_buffer.dst = tif->tif_rawcp;
-                        sp->out_buffer.size = (size_t) tif->tif_rawcc;
+                        sp->out_buffer.size = (size_t) tif->tif_rawdatasize;
                         sp->out_buffer.pos = 0;
                 }
         } while( in_buffer.pos < in_buffer.size );
@@ -283,22 +425,45 @@ ZSTDPostEncode(TIFF* tif)
         do {
                 zstd_ret = ZSTD_endStream(sp->cstream, &sp->out_buffer);
                 if( ZSTD_isError(zstd_ret) ) {
-                    TIFFErrorExt(tif->tif_clientdata, module,
+                    TIFFErrorExtR(tif, module,
                                 "Error in ZSTD_endStream(): %s",
                                 ZSTD_getErrorName(zstd_ret));
                     return 0;
                 }
                 if( sp->out_buffer.pos > 0 ) {
                         tif->tif_rawcc = sp->out_buffer.pos;
-                        TIFFFlushData1(tif);
+                        if( !TIFFFlushData1(tif) )
+                            return 0;
                         sp->out_buffer.dst = tif->tif_rawcp;
-                        sp->out_buffer.size = (size_t) tif->tif_rawcc;
+                        sp->out_buffer.size = (size_t) tif->tif_rawdatasize;
                         sp->out_buffer.pos = 0;
                 }
         } while (zstd_ret != 0);
         return 1;
 }
 
+static void
+ZSTDFreeDictionary(TIFF* tif)
+{
+        ZSTDState* sp = LState(tif);
+
+#if ZSTD_ADVANCED_API
+        if (sp->cdict) {
+            ZSTD_freeCDict(sp->cdict);
+            sp->cdict = NULL;
+        }
+        if (sp->ddict) {
+            ZSTD_freeDDict(sp->ddict);
+            sp->ddict = NULL;
+        }
+#endif
+        if (sp->dictionary) {
+            _TIFFfreeExt(tif, sp->dictionary);
+            sp->dictionary = NULL;
+        }
+        sp->dictionary_size = 0;
+}
+
 static void
 ZSTDCleanup(TIFF* tif)
 {
@@ -319,7 +484,8 @@ ZSTDCleanup(TIFF* tif)
             ZSTD_freeCStream(sp->cstream);
             sp->cstream = NULL;
         }
-        _TIFFfree(sp);
+        ZSTDFreeDictionary(tif);
+        _TIFFfreeExt(tif, sp);
         tif->tif_data = NULL;
 
         _TIFFSetDefaultCompressionState(tif);
@@ -330,6 +496,8 @@ ZSTDVSetField(TIFF* tif, uint32 tag, va_list ap)
 {
 	static const char module[] = "ZSTDVSetField";
         ZSTDState* sp = LState(tif);
+        uint32 v32;
+        int v;
 
         switch (tag) {
         case TIFFTAG_ZSTD_LEVEL:
@@ -337,15 +505,54 @@ ZSTDVSetField(TIFF* tif, uint32 tag, va_list ap)
                 if( sp->compression_level <= 0 ||
                     sp->compression_level > ZSTD_maxCLevel() )
                 {
-                    TIFFWarningExt(tif->tif_clientdata, module,
+                    TIFFWarningExtR(tif, module,
                                    "ZSTD_LEVEL should be between 1 and %d",
                                    ZSTD_maxCLevel());
                 }
                 return 1;
+        case TIFFTAG_ZSTD_WINDOWLOG:
+                v = (int) va_arg(ap, int);
+                if( v != 0 && (v < 10 || v > 31) ) {
+                    TIFFErrorExtR(tif, module,
+                                 "ZSTD_WINDOWLOG should be 0 or between "
+                                 "10 and 31");
+                    return 0;
+                }
+                sp->window_log = v;
+                break;
+        case TIFFTAG_ZSTD_LONGDISTANCE:
+                sp->long_distance = (int) va_arg(ap, int) != 0;
+                break;
+        case TIFFTAG_ZSTD_NBWORKERS:
+                v = (int) va_arg(ap, int);
+                if( v < 0 ) {
+                    TIFFErrorExtR(tif, module,
+                                 "ZSTD_NBWORKERS should not be negative");
+                    return 0;
+                }
+                sp->nb_workers = v;
+                break;
+        case TIFFTAG_ZSTD_DICTIONARY:
+                v32 = (uint32) va_arg(ap, uint32);
+                ZSTDFreeDictionary(tif);
+                if( v32 > 0 ) {
+                    _TIFFsetByteArrayExt(tif, (void**) &sp->dictionary,
+                                         va_arg(ap, void*), v32);
+                    if( sp->dictionary == NULL )
+                        return 0;
+                    sp->dictionary_size = v32;
+                }
+                break;
         default:
                 return (*sp->vsetparent)(tif, tag, ap);
         }
-        /*NOTREACHED*/
+#if !ZSTD_ADVANCED_API
+        TIFFErrorExtR(tif, module,
+                     "This tag requires libzstd 1.4.0 or later");
+        return 0;
+#else
+        return 1;
+#endif
 }
 
 static int
@@ -357,6 +564,19 @@ ZSTDVGetField(TIFF* tif, uint32 tag, va_list ap)
         case TIFFTAG_ZSTD_LEVEL:
                 *va_arg(ap, int*) = sp->compression_level;
                 break;
+        case TIFFTAG_ZSTD_WINDOWLOG:
+                *va_arg(ap, int*) = sp->window_log;
+                break;
+        case TIFFTAG_ZSTD_LONGDISTANCE:
+                *va_arg(ap, int*) = sp->long_distance;
+                break;
+        case TIFFTAG_ZSTD_NBWORKERS:
+                *va_arg(ap, int*) = sp->nb_workers;
+                break;
+        case TIFFTAG_ZSTD_DICTIONARY:
+                *va_arg(ap, uint32*) = sp->dictionary_size;
+                *va_arg(ap, void**) = sp->dictionary;
+                break;
         default:
                 return (*sp->vgetparent)(tif, tag, ap);
         }
@@ -367,6 +587,18 @@ static const TIFFField ZSTDFields[] = {
         { TIFFTAG_ZSTD_LEVEL, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
           TIFF_SETGET_UNDEFINED,
           FIELD_PSEUDO, TRUE, FALSE, "ZSTD compression_level", NULL },
+        { TIFFTAG_ZSTD_WINDOWLOG, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, FALSE, "ZSTD window_log", NULL },
+        { TIFFTAG_ZSTD_LONGDISTANCE, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, FALSE, "ZSTD long_distance", NULL },
+        { TIFFTAG_ZSTD_NBWORKERS, 0, 0, TIFF_ANY, 0, TIFF_SETGET_INT,
+          TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, FALSE, "ZSTD nb_workers", NULL },
+        { TIFFTAG_ZSTD_DICTIONARY, -3, -3, TIFF_UNDEFINED, 0,
+          TIFF_SETGET_C32_UINT8, TIFF_SETGET_UNDEFINED,
+          FIELD_PSEUDO, TRUE, TRUE, "ZSTD dictionary", NULL },
 };
 
 int
@@ -381,7 +613,7 @@ TIFFInitZSTD(TIFF* tif, int scheme)
         * Merge codec-specific tag information.
         */
         if (!_TIFFMergeFields(tif, ZSTDFields, TIFFArrayCount(ZSTDFields))) {
-                TIFFErrorExt(tif->tif_clientdata, module,
+                TIFFErrorExtR(tif, module,
                             "Merging ZSTD codec-specific tags failed");
                 return 0;
         }
@@ -389,7 +621,7 @@ TIFFInitZSTD(TIFF* tif, int scheme)
         /*
         * Allocate state block so tag methods have storage to record values.
         */
-        tif->tif_data = (uint8*) _TIFFmalloc(sizeof(ZSTDState));
+        tif->tif_data = (uint8*) _TIFFmallocExt(tif, sizeof(ZSTDState));
         if (tif->tif_data == NULL)
                 goto bad;
         sp = LState(tif);
@@ -407,6 +639,17 @@ TIFFInitZSTD(TIFF* tif, int scheme)
         sp->state = 0;
         sp->dstream = 0;
         sp->cstream = 0;
+        sp->window_log = 0;
+        sp->long_distance = 0;
+        sp->nb_workers = 0;
+        sp->dictionary = NULL;
+        sp->dictionary_size = 0;
+#if ZSTD_ADVANCED_API
+        sp->cdict = NULL;
+        sp->cdict_level = 0;
+        sp->ddict = NULL;
+        sp->decode_started = 0;
+#endif
         sp->out_buffer.dst = NULL;
         sp->out_buffer.size = 0;
         sp->out_buffer.pos = 0;
@@ -431,9 +674,10 @@ TIFFInitZSTD(TIFF* tif, int scheme)
         * Setup predictor setup.
         */
         (void) TIFFPredictorInit(tif);
+        sp->predict.batchdecode = 1;
         return 1;
 bad:
-        TIFFErrorExt(tif->tif_clientdata, module,
+        TIFFErrorExtR(tif, module,
                     "No space for ZSTD state block");
         return 0;
 }
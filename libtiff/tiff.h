@@ -187,8 +187,11 @@ typedef enum {
 #define     COMPRESSION_SGILOG		34676	/* SGI Log Luminance RLE */
 #define     COMPRESSION_SGILOG24	34677	/* SGI Log 24-bit packed */
 #define     COMPRESSION_JP2000          34712   /* Leadtools JPEG2000 */
+#define	    COMPRESSION_LERC		34887	/* ESRI Lerc codec: https://github.com/Esri/lerc */
 #define	    COMPRESSION_LZMA		34925	/* LZMA2 */
 #define	    COMPRESSION_ZSTD		34926	/* ZSTD: WARNING not registered in Adobe-maintained registry */
+#define	    COMPRESSION_LZ4		34928	/* LZ4: WARNING not registered in Adobe-maintained registry */
+#define	    COMPRESSION_WEBP		50001	/* WEBP: WARNING not registered in Adobe-maintained registry */
 #define	TIFFTAG_PHOTOMETRIC		262	/* photometric interpretation */
 #define	    PHOTOMETRIC_MINISWHITE	0	/* min value is white */
 #define	    PHOTOMETRIC_MINISBLACK	1	/* min value is black */
@@ -276,6 +279,7 @@ typedef enum {
 #define     PREDICTOR_NONE		1	/* no prediction scheme used */
 #define     PREDICTOR_HORIZONTAL	2	/* horizontal differencing */
 #define     PREDICTOR_FLOATINGPOINT	3	/* floating point predictor */
+#define     PREDICTOR_SHUFFLE		34897	/* byte shuffle: WARNING not registered in Adobe-maintained registry */
 #define	TIFFTAG_WHITEPOINT		318	/* image white point */
 #define	TIFFTAG_PRIMARYCHROMATICITIES	319	/* !primary chromaticities */
 #define	TIFFTAG_COLORMAP		320	/* RGB map for palette image */
@@ -449,6 +453,9 @@ typedef enum {
 /* tag 34929 is a private tag registered to FedEx */
 #define	TIFFTAG_FEDEX_EDR		34929	/* unknown use */
 #define TIFFTAG_INTEROPERABILITYIFD	40965	/* Pointer to Interoperability private directory */
+/* tag 50674 is registered to Esri */
+#define TIFFTAG_LERC_PARAMETERS		50674	/* LERC version and additional
+						   compression */
 /* Adobe Digital Negative (DNG) format tags */
 #define TIFFTAG_DNGVERSION		50706	/* &DNG version number */
 #define TIFFTAG_DNGBACKWARDVERSION	50707	/* &DNG compatibility version */
@@ -530,6 +537,9 @@ typedef enum {
 						   into ICC profile space */
 #define TIFFTAG_CURRENTICCPROFILE	50833	/* & */
 #define TIFFTAG_CURRENTPREPROFILEMATRIX	50834	/* & */
+/* tags 65400-65401 are private to libtiff */
+#define TIFFTAG_CHUNKSTATISTICS		65400	/* sample min/max of strips/tiles */
+#define TIFFTAG_CHUNKCRC32C		65401	/* CRC-32C of strips/tiles */
 /* tag 65535 is an undefined tag used by Eastman Kodak */
 #define TIFFTAG_DCSHUESHIFTVALUES       65535   /* hue shift correction data */
 
@@ -556,6 +566,7 @@ typedef enum {
 #define	TIFFTAG_JPEGCOLORMODE		65538	/* Auto RGB<=>YCbCr convert? */
 #define	    JPEGCOLORMODE_RAW	0x0000		/* no conversion (default) */
 #define	    JPEGCOLORMODE_RGB	0x0001		/* do auto conversion */
+#define	    JPEGCOLORMODE_PLANES 0x0002		/* separate Y, Cb, Cr planes */
 #define	TIFFTAG_JPEGTABLESMODE		65539	/* What to put in JPEGTables */
 #define	    JPEGTABLESMODE_QUANT 0x0001		/* include quantization tbls */
 #define	    JPEGTABLESMODE_HUFF	0x0002		/* include Huffman tbls */
@@ -602,7 +613,28 @@ typedef enum {
 #define TIFFTAG_PERSAMPLE       65563	/* interface for per sample tags */
 #define     PERSAMPLE_MERGED        0	/* present as a single value */
 #define     PERSAMPLE_MULTI         1	/* present as multiple values */
+#define TIFFTAG_LZWENCODEMODE		65564	/* LZW encoder hash table */
+#define     LZWENCODEMODE_COMPAT	0	/* compress(1) double hashing */
+#define     LZWENCODEMODE_FAST		1	/* packed linear probing */
 #define TIFFTAG_ZSTD_LEVEL      65534    /* ZSTD compression level */
+#define TIFFTAG_ZSTD_WINDOWLOG		65565	/* ZSTD log2 of window size */
+#define TIFFTAG_ZSTD_LONGDISTANCE	65566	/* ZSTD long distance matching */
+#define TIFFTAG_ZSTD_NBWORKERS		65567	/* ZSTD compression threads */
+#define TIFFTAG_ZSTD_DICTIONARY		65568	/* ZSTD shared dictionary */
+#define TIFFTAG_LZMA_THREADS		65569	/* LZMA2 encoder threads */
+#define TIFFTAG_JPEGSCALEDENOM		65570	/* JPEG reduced size decoding */
+#define TIFFTAG_FAXRUNSFUNC		65571	/* G3/G4 run-length callback */
+#define TIFFTAG_LZ4_LEVEL		65572	/* LZ4 compression level */
+#define TIFFTAG_LERC_VERSION		65573	/* LERC version */
+#define     LERC_VERSION_2_4		4
+#define TIFFTAG_LERC_ADD_COMPRESSION	65574	/* LERC additional compression */
+#define     LERC_ADD_COMPRESSION_NONE	0
+#define     LERC_ADD_COMPRESSION_DEFLATE 1
+#define     LERC_ADD_COMPRESSION_ZSTD	2
+#define TIFFTAG_LERC_MAXZERROR		65575	/* LERC maximum error */
+#define TIFFTAG_WEBP_LEVEL		65576	/* WebP compression level */
+#define TIFFTAG_WEBP_LOSSLESS		65577	/* WebP lossless/lossy */
+#define TIFFTAG_ZIP_THREADS		65578	/* Deflate encoder threads */
 
 /*
  * EXIF tags
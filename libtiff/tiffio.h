@@ -230,6 +230,11 @@ struct _TIFFRGBAImage {
 	int col_offset;
 };
 
+/*
+ * Opaque state for reading an image in bands of RGBA rows.
+ */
+typedef struct _TIFFRGBAIterator TIFFRGBAIterator;
+
 /*
  * Macros for extracting components from the
  * packed ABGR form returned by TIFFReadRGBAImage.
@@ -239,6 +244,15 @@ struct _TIFFRGBAImage {
 #define TIFFGetB(abgr) (((abgr) >> 16) & 0xff)
 #define TIFFGetA(abgr) (((abgr) >> 24) & 0xff)
 
+/*
+ * Macros for extracting components from the 16 bits
+ * per channel form returned by TIFFReadRGBA64Image.
+ */
+#define TIFFGetR64(abgr) ((uint16)((abgr) & 0xffff))
+#define TIFFGetG64(abgr) ((uint16)(((abgr) >> 16) & 0xffff))
+#define TIFFGetB64(abgr) ((uint16)(((abgr) >> 32) & 0xffff))
+#define TIFFGetA64(abgr) ((uint16)(((abgr) >> 48) & 0xffff))
+
 /*
  * A CODEC is a software package that implements decoding,
  * encoding, or decoding+encoding of a compression algorithm.
@@ -270,13 +284,160 @@ extern "C" {
 #endif
 typedef void (*TIFFErrorHandler)(const char*, const char*, va_list);
 typedef void (*TIFFErrorHandlerExt)(thandle_t, const char*, const char*, va_list);
+typedef int (*TIFFErrorHandlerExtR)(TIFF*, void*, const char*, const char*, va_list);
 typedef tmsize_t (*TIFFReadWriteProc)(thandle_t, void*, tmsize_t);
 typedef toff_t (*TIFFSeekProc)(thandle_t, toff_t, int);
+typedef tmsize_t (*TIFFReadAtProc)(thandle_t, void*, tmsize_t, toff_t);
+typedef struct {
+	toff_t   offset;              /* file offset to read from */
+	void*    buf;                 /* destination buffer */
+	tmsize_t size;                /* number of bytes wanted */
+	tmsize_t result;              /* bytes read, or -1 on error */
+} TIFFIORequest;
+typedef int (*TIFFReadBatchProc)(thandle_t, TIFFIORequest*, uint32);
+typedef int (*TIFFPreallocateProc)(thandle_t, toff_t, toff_t);
 typedef int (*TIFFCloseProc)(thandle_t);
 typedef toff_t (*TIFFSizeProc)(thandle_t);
 typedef int (*TIFFMapFileProc)(thandle_t, void** base, toff_t* size);
 typedef void (*TIFFUnmapFileProc)(thandle_t, void* base, toff_t size);
 typedef void (*TIFFExtendProc)(TIFF*);
+typedef void* (*TIFFMallocProc)(void* ctx, tmsize_t size);
+typedef void* (*TIFFReallocProc)(void* ctx, void* ptr, tmsize_t size);
+typedef void (*TIFFFreeProc)(void* ctx, void* ptr);
+typedef struct _TIFFOpenOptions TIFFOpenOptions;
+#define TIFF_CHUNKSIZE_AUTO ((tmsize_t) -1) /* see TIFFOpenOptionsSetChunkSize() */
+#define TIFF_WRITEBEHIND_BUFFER_SIZE ((tmsize_t) 1 << 20) /* see TIFFOpenOptionsSetWriteBehind() */
+#define TIFF_MAX_BUFFER_ALIGNMENT 65536 /* see TIFFOpenOptionsSetBufferAlignment() */
+/* access patterns for TIFFOpenOptionsSetAccessPattern() */
+#define TIFF_ACCESS_NORMAL     0  /* no hint */
+#define TIFF_ACCESS_SEQUENTIAL 1  /* the file is read from start to end */
+#define TIFF_ACCESS_RANDOM     2  /* e.g. tiles picked out of a large image */
+typedef struct _TIFFChunkCache TIFFChunkCache;
+
+/*
+ * Executor the parallel routines run their tasks on instead of threads
+ * of their own; see TIFFOpenOptionsSetThreadPool().  The group methods
+ * are optional, but must be given together.
+ */
+typedef struct {
+	void*  user_data;
+	int    concurrency;               /* # tasks run at once, 0 if unknown */
+	int  (*submit)(void* user_data, void* group, void (*func)(void*), void* arg);
+	void* (*group_create)(void* user_data);
+	void (*group_wait)(void* user_data, void* group); /* and release it */
+} TIFFThreadPool;
+
+/*
+ * Directory entry, as reported by TIFFScanDirectories().
+ */
+typedef struct {
+	uint16 tag;
+	uint16 type;                      /* a TIFFDataType */
+	uint64 count;
+	int    isinline;                  /* value held in the entry itself */
+	uint64 offset;                    /* file offset of the value */
+	uint8  value[8];                  /* raw value field, file byte order */
+} TIFFScanEntry;
+typedef int (*TIFFScanDirectoryProc)(TIFF*, void* clientdata, uint16 dirnum,
+    uint64 diroff, uint16 nentries, const TIFFScanEntry* entries,
+    uint64 nextdiroff);
+typedef int (*TIFFFaxRunsFunc)(void* clientdata, uint32 row,
+    const uint32* runs, uint32 nruns, uint32 width);
+
+/*
+ * Counters kept for a handle opened with TIFFOpenOptionsSetStatistics(),
+ * as returned by TIFFGetStatistics().  Times are in nanoseconds.
+ */
+typedef struct {
+	uint64 readcalls;                 /* calls to the read method */
+	uint64 readbytes;                 /* bytes it returned */
+	uint64 writecalls;                /* calls to the write method */
+	uint64 writebytes;                /* bytes it accepted */
+	uint64 seekcalls;                 /* calls to the seek method */
+	uint64 stripsdecoded;
+	uint64 tilesdecoded;
+	uint64 stripsencoded;
+	uint64 tilesencoded;
+	uint64 decodetime;                /* in the codec decode methods */
+	uint64 predictortime;             /* of which undoing prediction */
+	uint64 postdecodetime;            /* byte swapping after decoding */
+	uint64 encodetime;                /* in the codec encode methods */
+	uint64 rawbufferallocs;           /* raw buffer (re)allocations */
+	uint64 directoriesread;
+	uint64 directorytime;             /* in reading directories */
+	uint64 directoriescached;         /* of those read, found in the cache */
+} TIFFStatistics;
+
+/*
+ * Where the raw data of a strip or tile is, as returned by
+ * TIFFGetStripInfo() and TIFFGetTileInfo().
+ */
+typedef struct {
+	uint64 offset;                    /* file offset of the raw bytes */
+	uint64 bytecount;                 /* their number, 0 if not written */
+	uint16 compression;               /* codec they are compressed with */
+	tmsize_t size;                    /* # bytes the chunk decodes to */
+} TIFFChunkInfo;
+
+/*
+ * A decoded strip or tile with its place in the image, as returned by
+ * TIFFChunkIteratorNext().
+ */
+typedef struct _TIFFChunkIterator TIFFChunkIterator;
+typedef struct {
+	uint32 chunk;                     /* strip or tile number */
+	uint16 sample;                    /* its plane if separate, else 0 */
+	uint32 x, y;                      /* column and row of its first pixel */
+	uint32 width, length;             /* columns and rows of image in it */
+	tmsize_t stride;                  /* bytes from one row to the next */
+	tmsize_t size;                    /* bytes of decoded data */
+	void* buf;                        /* the data, owned by the iterator */
+} TIFFChunk;
+
+#define	TIFFITER_CHUNKORDER	0         /* by strip or tile number */
+#define	TIFFITER_FILEORDER	1         /* by file offset of the data */
+
+/*
+ * The core fields of the current directory, as returned in one call by
+ * TIFFGetImageInfo() without going through TIFFGetField().
+ */
+typedef struct {
+	uint32 imagewidth;
+	uint32 imagelength;
+	uint32 imagedepth;
+	uint32 tilewidth;                 /* 0 for a striped image */
+	uint32 tilelength;                /* 0 for a striped image */
+	uint32 tiledepth;
+	uint32 rowsperstrip;
+	uint32 nstrips;                   /* strips or tiles, all planes */
+	uint32 stripsperimage;            /* strips or tiles in a plane */
+	uint32 subfiletype;
+	uint16 bitspersample;
+	uint16 samplesperpixel;
+	uint16 extrasamples;              /* # of extra samples */
+	uint16 sampleformat;
+	uint16 planarconfig;
+	uint16 photometric;
+	uint16 compression;
+	uint16 fillorder;
+	uint16 orientation;
+	uint16 tiled;                     /* 1 if tiled, 0 if striped */
+} TIFFImageInfo;
+
+/*
+ * Stages and phases reported to the callback set with
+ * TIFFSetTraceCallback().
+ */
+#define	TIFF_TRACE_FILL		1	/* read a strip or tile */
+#define	TIFF_TRACE_DECODE	2	/* codec decode method */
+#define	TIFF_TRACE_ENCODE	3	/* codec encode method */
+#define	TIFF_TRACE_READDIR	4	/* TIFFReadDirectory() */
+#define	TIFF_TRACE_WRITEDIR	5	/* writing a directory */
+#define	TIFF_TRACE_BEGIN	0
+#define	TIFF_TRACE_END		1	/* stage succeeded */
+#define	TIFF_TRACE_FAIL		2	/* stage failed */
+typedef void (*TIFFTraceProc)(TIFF*, void* clientdata, int stage, int phase,
+    uint32 strile, uint64 bytes);
 
 extern const char* TIFFGetVersion(void);
 
@@ -386,13 +547,45 @@ extern TIFFCloseProc TIFFGetCloseProc(TIFF*);
 extern TIFFSizeProc TIFFGetSizeProc(TIFF*);
 extern TIFFMapFileProc TIFFGetMapFileProc(TIFF*);
 extern TIFFUnmapFileProc TIFFGetUnmapFileProc(TIFF*);
+extern void TIFFGetMemoryUsage(TIFF*, tmsize_t*, tmsize_t*);
+extern int TIFFGetStatistics(TIFF*, TIFFStatistics*);
+extern void TIFFGetImageInfo(TIFF*, TIFFImageInfo*);
+extern int TIFFGetChunkStatistics(TIFF*, uint32, uint16, double*, double*);
+extern int TIFFGetImageStatistics(TIFF*, uint16, double*, double*, double*, uint64*);
+#define	TIFF_SELECT_INSIDE	0	/* some value within lo..hi */
+#define	TIFF_SELECT_OUTSIDE	1	/* some value outside lo..hi */
+extern uint32 TIFFSelectChunks(TIFF*, uint16, double, double, int, uint32*, uint32);
+extern int64 TIFFVerifyChunks(TIFF*, uint32*, uint32);
+extern void TIFFSetTraceCallback(TIFF*, TIFFTraceProc, void*);
+#define	TIFF_CANCEL_NONE	0	/* operations run to completion */
+#define	TIFF_CANCEL_REQUESTED	1	/* TIFFCancel() was called */
+#define	TIFF_CANCEL_DEADLINE	2	/* the deadline has passed */
+extern void TIFFCancel(TIFF*);
+extern void TIFFSetDeadline(TIFF*, double);
+extern void TIFFResetCancel(TIFF*);
+extern int TIFFGetCancelState(TIFF*);
 extern uint32 TIFFCurrentRow(TIFF*);
 extern uint16 TIFFCurrentDirectory(TIFF*);
 extern uint16 TIFFNumberOfDirectories(TIFF*);
+extern int TIFFBuildDirectoryIndex(TIFF*);
+extern uint16 TIFFGetDirectoryIndex(TIFF*, uint64*, uint16);
+extern int TIFFSetDirectoryIndex(TIFF*, const uint64*, uint16);
 extern uint64 TIFFCurrentDirOffset(TIFF*);
+extern int TIFFGetOverviewCount(TIFF*);
+extern int TIFFGetOverviewInfo(TIFF*, int, uint32*, uint32*, uint64*);
+extern int TIFFGetOverviewForScale(TIFF*, double);
+extern int TIFFOpenOverview(TIFF*, int);
+extern int TIFFScanDirectories(TIFF*, TIFFScanDirectoryProc, void*);
 extern uint32 TIFFCurrentStrip(TIFF*);
 extern uint32 TIFFCurrentTile(TIFF* tif);
+extern uint64 TIFFGetStrileOffset(TIFF* tif, uint32 strile);
+extern uint64 TIFFGetStrileByteCount(TIFF* tif, uint32 strile);
+extern uint64 TIFFGetStrileOffsetWithErr(TIFF* tif, uint32 strile, int* pbErr);
+extern uint64 TIFFGetStrileByteCountWithErr(TIFF* tif, uint32 strile, int* pbErr);
 extern int TIFFReadBufferSetup(TIFF* tif, void* bp, tmsize_t size);
+extern int TIFFSetPrefetch(TIFF* tif, uint32 nchunks);
+extern int TIFFSetScanlineCheckpoints(TIFF* tif, uint32 interval);
+extern int TIFFSetDirectoryCache(TIFF* tif, uint32 ndirs);
 extern int TIFFWriteBufferSetup(TIFF* tif, void* bp, tmsize_t size);  
 extern int TIFFSetupStrips(TIFF *);
 extern int TIFFWriteCheck(TIFF*, int, const char *);
@@ -411,6 +604,10 @@ extern int TIFFWriteDirectory(TIFF *);
 extern int TIFFWriteCustomDirectory(TIFF *, uint64 *);
 extern int TIFFCheckpointDirectory(TIFF *);
 extern int TIFFRewriteDirectory(TIFF *);
+extern int TIFFReserveDirectory(TIFF *);
+extern int TIFFReserveDirectorySpace(TIFF *, tmsize_t);
+extern int TIFFReorientDirectory(TIFF* in, TIFF* out, int orientation);
+extern int TIFFDigestDirectory(TIFF* tif, uint64* digest, int nthreads);
 
 #if defined(c_plusplus) || defined(__cplusplus)
 extern void TIFFPrintDirectory(TIFF*, FILE*, long = 0);
@@ -431,10 +628,18 @@ extern int TIFFReadRGBAStrip(TIFF*, uint32, uint32 * );
 extern int TIFFReadRGBATile(TIFF*, uint32, uint32, uint32 * );
 extern int TIFFReadRGBAStripExt(TIFF*, uint32, uint32 *, int stop_on_error );
 extern int TIFFReadRGBATileExt(TIFF*, uint32, uint32, uint32 *, int stop_on_error );
+extern int TIFFReadRGBAImageScaled(TIFF*, uint32, uint32, uint32*, int);
+extern int TIFFReadRGBA64Image(TIFF*, uint32, uint32, uint64*, int);
+extern int TIFFReadRGBA64ImageOriented(TIFF*, uint32, uint32, uint64*, int, int);
 extern int TIFFRGBAImageOK(TIFF*, char [1024]);
 extern int TIFFRGBAImageBegin(TIFFRGBAImage*, TIFF*, int, char [1024]);
 extern int TIFFRGBAImageGet(TIFFRGBAImage*, uint32*, uint32, uint32);
+extern int TIFFRGBAImageGetParallel(TIFFRGBAImage*, uint32*, uint32, uint32, int);
+extern int TIFFRGBAImageGet64(TIFFRGBAImage*, uint64*, uint32, uint32);
 extern void TIFFRGBAImageEnd(TIFFRGBAImage*);
+extern TIFFRGBAIterator* TIFFRGBAIteratorBegin(TIFF*, int, int, char [1024]);
+extern int TIFFRGBAIteratorNext(TIFFRGBAIterator*, uint32**, uint32*, uint32*);
+extern void TIFFRGBAIteratorEnd(TIFFRGBAIterator*);
 extern TIFF* TIFFOpen(const char*, const char*);
 # ifdef __WIN32__
 extern TIFF* TIFFOpenW(const wchar_t*, const char*);
@@ -446,12 +651,61 @@ extern TIFF* TIFFClientOpen(const char*, const char*,
 	    TIFFSeekProc, TIFFCloseProc,
 	    TIFFSizeProc,
 	    TIFFMapFileProc, TIFFUnmapFileProc);
+extern TIFFOpenOptions* TIFFOpenOptionsAlloc(void);
+extern void TIFFOpenOptionsFree(TIFFOpenOptions*);
+extern void TIFFOpenOptionsSetAllocator(TIFFOpenOptions*, TIFFMallocProc,
+	    TIFFReallocProc, TIFFFreeProc, void*);
+extern void TIFFOpenOptionsSetMaxCumulatedMemAlloc(TIFFOpenOptions*, tmsize_t);
+extern void TIFFOpenOptionsSetBufferAlignment(TIFFOpenOptions*, tmsize_t);
+extern void TIFFOpenOptionsSetReadAtProc(TIFFOpenOptions*, TIFFReadAtProc);
+extern void TIFFOpenOptionsSetPositionalIO(TIFFOpenOptions*, int);
+extern void TIFFOpenOptionsSetDirectIO(TIFFOpenOptions*, int);
+extern void TIFFOpenOptionsSetAccessPattern(TIFFOpenOptions*, int);
+extern void TIFFOpenOptionsSetSpillLimit(TIFFOpenOptions*, tmsize_t);
+extern void TIFFOpenOptionsSetChunkChecksums(TIFFOpenOptions*, int);
+extern void TIFFOpenOptionsSetPreallocateProc(TIFFOpenOptions*, TIFFPreallocateProc);
+extern void TIFFOpenOptionsSetReadBatchProc(TIFFOpenOptions*, TIFFReadBatchProc);
+extern void TIFFOpenOptionsSetBlockCache(TIFFOpenOptions*, tmsize_t, uint32);
+extern void TIFFOpenOptionsSetHeaderPrefetch(TIFFOpenOptions*, tmsize_t);
+extern void TIFFOpenOptionsSetWriteBuffer(TIFFOpenOptions*, tmsize_t);
+extern void TIFFOpenOptionsSetWriteBehind(TIFFOpenOptions*, int);
+extern void TIFFOpenOptionsSetChunkSize(TIFFOpenOptions*, tmsize_t);
+extern void TIFFOpenOptionsSetStrileWindow(TIFFOpenOptions*, uint32);
+extern void TIFFOpenOptionsSetThreadPool(TIFFOpenOptions*, const TIFFThreadPool*);
+extern void TIFFSetDefaultThreadPool(const TIFFThreadPool*);
+extern void TIFFOpenOptionsSetStatistics(TIFFOpenOptions*, int);
+extern void TIFFOpenOptionsSetErrorHandlerExtR(TIFFOpenOptions*, TIFFErrorHandlerExtR, void*);
+extern void TIFFOpenOptionsSetWarningHandlerExtR(TIFFOpenOptions*, TIFFErrorHandlerExtR, void*);
+extern void TIFFOpenOptionsSetWarnings(TIFFOpenOptions*, int);
+extern TIFF* TIFFOpenExt(const char*, const char*, TIFFOpenOptions*);
+# ifdef __WIN32__
+extern TIFF* TIFFOpenWExt(const wchar_t*, const char*, TIFFOpenOptions*);
+# endif /* __WIN32__ */
+extern TIFF* TIFFFdOpenExt(int, const char*, const char*, TIFFOpenOptions*);
+extern TIFF* TIFFClientOpenExt(const char*, const char*,
+	    thandle_t,
+	    TIFFReadWriteProc, TIFFReadWriteProc,
+	    TIFFSeekProc, TIFFCloseProc,
+	    TIFFSizeProc,
+	    TIFFMapFileProc, TIFFUnmapFileProc,
+	    TIFFOpenOptions*);
+extern TIFF* TIFFOpenMemory(void*, tmsize_t, const char*);
+extern TIFF* TIFFOpenMemoryExt(void*, tmsize_t, const char*, TIFFOpenOptions*);
+extern int TIFFCloseMemory(TIFF*, void**, tmsize_t*);
+extern int TIFFCreateSharedMemory(const char*);
+extern TIFF* TIFFOpenSharedMemory(int, const char*, const char*);
+extern TIFF* TIFFOpenSharedMemoryExt(int, const char*, const char*, TIFFOpenOptions*);
+extern TIFF* TIFFOpenSequential(const char*, const char*, thandle_t,
+	    TIFFReadWriteProc, TIFFCloseProc, TIFFOpenOptions*);
+extern TIFF* TIFFCloneForThread(TIFF*);
 extern const char* TIFFFileName(TIFF*);
 extern const char* TIFFSetFileName(TIFF*, const char *);
 extern void TIFFError(const char*, const char*, ...) __attribute__((__format__ (__printf__,2,3)));
 extern void TIFFErrorExt(thandle_t, const char*, const char*, ...) __attribute__((__format__ (__printf__,3,4)));
 extern void TIFFWarning(const char*, const char*, ...) __attribute__((__format__ (__printf__,2,3)));
 extern void TIFFWarningExt(thandle_t, const char*, const char*, ...) __attribute__((__format__ (__printf__,3,4)));
+extern void TIFFErrorExtR(TIFF*, const char*, const char*, ...) __attribute__((__format__ (__printf__,3,4)));
+extern void TIFFWarningExtR(TIFF*, const char*, const char*, ...) __attribute__((__format__ (__printf__,3,4)));
 extern TIFFErrorHandler TIFFSetErrorHandler(TIFFErrorHandler);
 extern TIFFErrorHandlerExt TIFFSetErrorHandlerExt(TIFFErrorHandlerExt);
 extern TIFFErrorHandler TIFFSetWarningHandler(TIFFErrorHandler);
@@ -468,12 +722,43 @@ extern tmsize_t TIFFReadEncodedStrip(TIFF* tif, uint32 strip, void* buf, tmsize_
 extern tmsize_t TIFFReadRawStrip(TIFF* tif, uint32 strip, void* buf, tmsize_t size);  
 extern tmsize_t TIFFReadEncodedTile(TIFF* tif, uint32 tile, void* buf, tmsize_t size);  
 extern tmsize_t TIFFReadRawTile(TIFF* tif, uint32 tile, void* buf, tmsize_t size);  
+extern int TIFFGetMappedRawStrip(TIFF* tif, uint32 strip, const void** ptr, tmsize_t* size);
+extern int TIFFGetMappedRawTile(TIFF* tif, uint32 tile, const void** ptr, tmsize_t* size);
+extern int TIFFGetStripInfo(TIFF* tif, uint32 strip, TIFFChunkInfo* info);
+extern int TIFFGetTileInfo(TIFF* tif, uint32 tile, TIFFChunkInfo* info);
+extern tmsize_t TIFFReadEncodedStripFromBuffer(TIFF* tif, uint32 strip, void* raw, tmsize_t rawsize, void* buf, tmsize_t size);
+extern tmsize_t TIFFReadEncodedTileFromBuffer(TIFF* tif, uint32 tile, void* raw, tmsize_t rawsize, void* buf, tmsize_t size);
+extern tmsize_t TIFFReadEncodedStripAs(TIFF* tif, uint32 strip, void* buf, tmsize_t size, TIFFDataType type, double scale, double offset);
+extern tmsize_t TIFFReadEncodedTileAs(TIFF* tif, uint32 tile, void* buf, tmsize_t size, TIFFDataType type, double scale, double offset);
+extern tmsize_t TIFFReadEncodedStripInterleaved(TIFF* tif, uint32 strip, void* buf, tmsize_t size);
+extern tmsize_t TIFFReadEncodedTileInterleaved(TIFF* tif, uint32 tile, void* buf, tmsize_t size);
+extern tmsize_t TIFFDecodeChunk(TIFF* tif, uint32 chunk, const void* raw, tmsize_t rawsize, void* buf, tmsize_t size);
+extern TIFFChunkCache* TIFFChunkCacheCreate(tmsize_t maxbytes);
+extern void TIFFChunkCacheFree(TIFFChunkCache* cache);
+extern void TIFFChunkCacheGetStats(TIFFChunkCache* cache, uint64* hits, uint64* misses, tmsize_t* bytes);
+extern int TIFFSetChunkCache(TIFF* tif, TIFFChunkCache* cache);
+extern int TIFFReadRawChunks(TIFF* tif, const uint32* chunks, uint32 nchunks, void** bufs, tmsize_t* sizes, tmsize_t maxgap);
+extern int TIFFReadEncodedStripsParallel(TIFF* tif, const uint32* strips, uint32 nstrips, void** bufs, tmsize_t bufsize, int nthreads);
+extern int TIFFReadEncodedTilesParallel(TIFF* tif, const uint32* tiles, uint32 ntiles, void** bufs, tmsize_t bufsize, int nthreads);
+extern int TIFFReadRegion(TIFF* tif, uint32 x, uint32 y, uint32 w, uint32 h, uint16 sample, void* buf, tmsize_t stride);
+extern TIFFChunkIterator* TIFFChunkIteratorBegin(TIFF* tif, int order, int nthreads);
+extern int TIFFChunkIteratorNext(TIFFChunkIterator* it, TIFFChunk* chunk);
+extern void TIFFChunkIteratorRelease(TIFFChunkIterator* it, TIFFChunk* chunk);
+extern void TIFFChunkIteratorEnd(TIFFChunkIterator* it);
 extern tmsize_t TIFFWriteEncodedStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc);
 extern tmsize_t TIFFWriteRawStrip(TIFF* tif, uint32 strip, void* data, tmsize_t cc);  
 extern tmsize_t TIFFWriteEncodedTile(TIFF* tif, uint32 tile, void* data, tmsize_t cc);  
+extern tmsize_t TIFFWriteEncodedStripInterleaved(TIFF* tif, uint32 strip, void* data, tmsize_t cc);
+extern tmsize_t TIFFWriteEncodedTileInterleaved(TIFF* tif, uint32 tile, void* data, tmsize_t cc);
 extern tmsize_t TIFFWriteRawTile(TIFF* tif, uint32 tile, void* data, tmsize_t cc);  
+extern tmsize_t TIFFEncodeChunk(TIFF* tif, uint32 chunk, void* buf, tmsize_t size, void* out, tmsize_t outsize);
+extern int TIFFChooseCompression(TIFF* tif, const uint32* chunks, uint32 nchunks, void** bufs, const tmsize_t* sizes, double bytespersecond);
+extern int TIFFWriteEncodedStripsParallel(TIFF* tif, const uint32* strips, uint32 nstrips, void** bufs, const tmsize_t* sizes, int nthreads);
+extern int TIFFWriteEncodedTilesParallel(TIFF* tif, const uint32* tiles, uint32 ntiles, void** bufs, const tmsize_t* sizes, int nthreads);
+extern int TIFFWriteFaxRuns(TIFF* tif, uint32 row, const uint32* runs, uint32 nruns);
 extern int TIFFDataWidth(TIFFDataType);    /* table of tag datatype widths */
 extern void TIFFSetWriteOffset(TIFF* tif, toff_t off);
+extern int TIFFPreallocate(TIFF* tif, uint64 size);
 extern void TIFFSwabShort(uint16*);
 extern void TIFFSwabLong(uint32*);
 extern void TIFFSwabLong8(uint64*);
@@ -488,6 +773,28 @@ extern void TIFFSwabArrayOfDouble(double* dp, tmsize_t n);
 extern void TIFFReverseBits(uint8* cp, tmsize_t n);
 extern const unsigned char* TIFFGetBitRevTable(int);
 
+/*
+ * Options of TIFFUnpackSamples8() and TIFFUnpackSamples16().
+ */
+#define	TIFF_UNPACK_SCALE	0x1	/* scale to the full output range */
+#define	TIFF_UNPACK_INVERT	0x2	/* complement (min-is-white) */
+extern int TIFFUnpackSamples8(uint8* dst, const uint8* src, tmsize_t nsamples, uint16 bitspersample, int flags, const uint8* map);
+extern int TIFFUnpackSamples16(uint16* dst, const uint8* src, tmsize_t nsamples, uint16 bitspersample, int flags, const uint16* map);
+
+/*
+ * Instruction sets used by the optimized code paths of the library,
+ * as returned by TIFFGetCPUFeatures().
+ */
+#define	TIFF_CPU_SSE2	0x1		/* x86 SSE2 */
+#define	TIFF_CPU_SSSE3	0x2		/* x86 SSSE3 */
+#define	TIFF_CPU_NEON	0x4		/* ARM Advanced SIMD */
+#define	TIFF_CPU_AVX2	0x8		/* x86 AVX2 */
+#define	TIFF_CPU_SSE42	0x10		/* x86 SSE4.2 (crc32) */
+#define	TIFF_CPU_CRC32	0x20		/* ARMv8 CRC32 */
+#define	TIFF_CPU_ALL	(-1)		/* everything the CPU supports */
+extern int TIFFGetCPUFeatures(void);
+extern int TIFFSetCPUFeatures(int);
+
 #ifdef LOGLUV_PUBLIC
 #define U_NEU		0.210526316
 #define V_NEU		0.473684211
@@ -522,6 +829,13 @@ extern void TIFFXYZToRGB(TIFFCIELabToRGB *, float, float, float,
 extern int TIFFYCbCrToRGBInit(TIFFYCbCrToRGB*, float*, float*);
 extern void TIFFYCbCrtoRGB(TIFFYCbCrToRGB *, uint32, int32, int32,
     uint32 *, uint32 *, uint32 *);
+extern void TIFFRGBToGrey8(uint8*, const uint8*, const uint8*, const uint8*,
+    uint32, int, const int32[3]);
+extern void TIFFRGBAToYCbCr8(uint8*, const uint32*, tmsize_t, uint32, uint32,
+    int, int, const float[3], const float[6]);
+extern void TIFFPaletteToRGB8(uint8*, const uint8*, tmsize_t, const uint32[256]);
+extern void TIFFOrientPixels(uint8*, tmsize_t, const uint8*, tmsize_t,
+    uint32, uint32, uint32, int);
 
 /****************************************************************************
  *               O B S O L E T E D    I N T E R F A C E S
@@ -35,6 +35,326 @@
 extern TIFF* TIFFStreamOpen(const char*, std::ostream *);
 extern TIFF* TIFFStreamOpen(const char*, std::istream *);
 
+#if __cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+
+#include <iterator>
+#include "tiffio.h"
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define TIFFXX_COROUTINES 1
+#include <coroutine>
+#include <exception>
+#include <utility>
+#endif
+#endif
+
+/*
+ * libtiff::File owns a TIFF handle and closes it when destroyed.  It can be
+ * moved but not copied.  The chunk methods are the TIFFReadEncoded*()
+ * and TIFFWriteEncoded*() calls on buffers the caller provides, either
+ * as a pointer and a size or as any contiguous container with data() and
+ * size() members (std::vector, std::array, std::span, ...), whose size
+ * in bytes is used.  Nothing is allocated or copied on the way, and as
+ * with the C calls, writing may byte swap or difference the data in
+ * place.  Errors are reported through TIFFError() and by the return
+ * values.
+ */
+namespace libtiff {
+
+#ifdef TIFFXX_COROUTINES
+/*
+ * A lazily started coroutine producing a T, returned by the asynchronous
+ * read methods of File.  Either co_await it from another coroutine, or
+ * start() it once and take its result() when done().
+ */
+template<class T>
+class Task {
+public:
+	class promise_type {
+	public:
+		Task get_return_object() noexcept
+		{
+			return Task(std::coroutine_handle<promise_type>::
+			    from_promise(*this));
+		}
+		std::suspend_always initial_suspend() const noexcept
+		{
+			return {};
+		}
+		struct FinalAwaiter {
+			bool await_ready() const noexcept { return false; }
+			std::coroutine_handle<> await_suspend(
+			    std::coroutine_handle<promise_type> h) const noexcept
+			{
+				std::coroutine_handle<> next =
+				    h.promise().continuation_;
+				return next ? next : std::noop_coroutine();
+			}
+			void await_resume() const noexcept {}
+		};
+		FinalAwaiter final_suspend() const noexcept { return {}; }
+		void return_value(T value) { value_ = std::move(value); }
+		void unhandled_exception() noexcept
+		{
+			exception_ = std::current_exception();
+		}
+		T result()
+		{
+			if (exception_)
+				std::rethrow_exception(exception_);
+			return std::move(value_);
+		}
+
+		std::coroutine_handle<> continuation_;
+
+	private:
+		T value_{};
+		std::exception_ptr exception_;
+	};
+
+	Task(Task&& other) noexcept : h_(std::exchange(other.h_, nullptr)) {}
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other) {
+			if (h_)
+				h_.destroy();
+			h_ = std::exchange(other.h_, nullptr);
+		}
+		return *this;
+	}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task()
+	{
+		if (h_)
+			h_.destroy();
+	}
+
+	bool await_ready() const noexcept { return h_.done(); }
+	std::coroutine_handle<> await_suspend(
+	    std::coroutine_handle<> awaiting) noexcept
+	{
+		h_.promise().continuation_ = awaiting;
+		return h_;
+	}
+	T await_resume() { return h_.promise().result(); }
+
+	void start() { h_.resume(); }
+	bool done() const noexcept { return h_.done(); }
+	T result() { return h_.promise().result(); }
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> h) noexcept : h_(h) {}
+
+	std::coroutine_handle<promise_type> h_;
+};
+#endif /* TIFFXX_COROUTINES */
+
+class File {
+public:
+	File() noexcept : tif_(nullptr) {}
+	explicit File(TIFF* tif) noexcept : tif_(tif) {}
+	File(const char* name, const char* mode) : tif_(TIFFOpen(name, mode)) {}
+	File(const char* name, std::istream* is) : tif_(TIFFStreamOpen(name, is)) {}
+	File(const char* name, std::ostream* os) : tif_(TIFFStreamOpen(name, os)) {}
+	~File() { close(); }
+
+	File(File&& other) noexcept : tif_(other.release()) {}
+	File& operator=(File&& other) noexcept
+	{
+		if (this != &other) {
+			close();
+			tif_ = other.release();
+		}
+		return *this;
+	}
+	File(const File&) = delete;
+	File& operator=(const File&) = delete;
+
+	explicit operator bool() const noexcept { return tif_ != nullptr; }
+	TIFF* get() const noexcept { return tif_; }
+	TIFF* release() noexcept
+	{
+		TIFF* tif = tif_;
+		tif_ = nullptr;
+		return tif;
+	}
+	void close() noexcept
+	{
+		if (tif_)
+			TIFFClose(release());
+	}
+
+	/* Chunks, returning the number of bytes done or -1 */
+	tmsize_t readTile(uint32 tile, void* buf, tmsize_t size) const
+	{
+		return TIFFReadEncodedTile(tif_, tile, buf, size);
+	}
+	tmsize_t readStrip(uint32 strip, void* buf, tmsize_t size) const
+	{
+		return TIFFReadEncodedStrip(tif_, strip, buf, size);
+	}
+	tmsize_t writeTile(uint32 tile, void* buf, tmsize_t size) const
+	{
+		return TIFFWriteEncodedTile(tif_, tile, buf, size);
+	}
+	tmsize_t writeStrip(uint32 strip, void* buf, tmsize_t size) const
+	{
+		return TIFFWriteEncodedStrip(tif_, strip, buf, size);
+	}
+
+	template<class Buffer>
+	tmsize_t readTile(uint32 tile, Buffer&& buf) const
+	{
+		return readTile(tile, buf.data(), bytes(buf));
+	}
+	template<class Buffer>
+	tmsize_t readStrip(uint32 strip, Buffer&& buf) const
+	{
+		return readStrip(strip, buf.data(), bytes(buf));
+	}
+	template<class Buffer>
+	tmsize_t writeTile(uint32 tile, Buffer&& buf) const
+	{
+		return writeTile(tile, buf.data(), bytes(buf));
+	}
+	template<class Buffer>
+	tmsize_t writeStrip(uint32 strip, Buffer&& buf) const
+	{
+		return writeStrip(strip, buf.data(), bytes(buf));
+	}
+
+#ifdef TIFFXX_COROUTINES
+	/*
+	 * Split-phase chunk reads for event loops: fetch(offset, bytecount)
+	 * is awaited for the raw bytes of the chunk and must yield a
+	 * contiguous byte container, whose contents may be bit reversed in
+	 * place.  Decoding runs wherever the fetch resumes the coroutine,
+	 * for instance on a thread pool.  The File must outlive the task,
+	 * and one handle decodes one chunk at a time; use handles from
+	 * TIFFCloneForThread() to decode on several threads.
+	 */
+	template<class Fetch>
+	Task<tmsize_t> readTileAsync(uint32 tile, void* buf, tmsize_t size,
+	    Fetch fetch) const
+	{
+		TIFFChunkInfo info;
+
+		if (!TIFFGetTileInfo(tif_, tile, &info))
+			co_return static_cast<tmsize_t>(-1);
+		auto raw = co_await fetch(info.offset, info.bytecount);
+		co_return TIFFReadEncodedTileFromBuffer(tif_, tile, raw.data(),
+		    bytes(raw), buf, size);
+	}
+	template<class Fetch>
+	Task<tmsize_t> readStripAsync(uint32 strip, void* buf, tmsize_t size,
+	    Fetch fetch) const
+	{
+		TIFFChunkInfo info;
+
+		if (!TIFFGetStripInfo(tif_, strip, &info))
+			co_return static_cast<tmsize_t>(-1);
+		auto raw = co_await fetch(info.offset, info.bytecount);
+		co_return TIFFReadEncodedStripFromBuffer(tif_, strip, raw.data(),
+		    bytes(raw), buf, size);
+	}
+
+	template<class Buffer, class Fetch>
+	Task<tmsize_t> readTileAsync(uint32 tile, Buffer& buf, Fetch fetch) const
+	{
+		return readTileAsync(tile, buf.data(), bytes(buf),
+		    std::move(fetch));
+	}
+	template<class Buffer, class Fetch>
+	Task<tmsize_t> readStripAsync(uint32 strip, Buffer& buf,
+	    Fetch fetch) const
+	{
+		return readStripAsync(strip, buf.data(), bytes(buf),
+		    std::move(fetch));
+	}
+#endif /* TIFFXX_COROUTINES */
+
+	/*
+	 * Iterating over directories() makes each directory of the main
+	 * chain current in turn, starting with the first, and yields its
+	 * number.  Only one iteration may be in progress at a time.
+	 */
+	class DirectoryIterator {
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef tdir_t value_type;
+		typedef int difference_type;
+		typedef const tdir_t* pointer;
+		typedef tdir_t reference;
+
+		DirectoryIterator() noexcept : tif_(nullptr), dirn_(0) {}
+		explicit DirectoryIterator(TIFF* tif) : tif_(tif), dirn_(0)
+		{
+			if (!tif_ || !TIFFSetDirectory(tif_, 0))
+				tif_ = nullptr;
+		}
+
+		tdir_t operator*() const noexcept { return dirn_; }
+		DirectoryIterator& operator++()
+		{
+			if (TIFFReadDirectory(tif_))
+				dirn_ = TIFFCurrentDirectory(tif_);
+			else
+				tif_ = nullptr;
+			return *this;
+		}
+		DirectoryIterator operator++(int)
+		{
+			DirectoryIterator it(*this);
+			++*this;
+			return it;
+		}
+		/* Only the end compares equal to the end */
+		bool operator==(const DirectoryIterator& other) const noexcept
+		{
+			return tif_ == other.tif_ &&
+			    (tif_ == nullptr || dirn_ == other.dirn_);
+		}
+		bool operator!=(const DirectoryIterator& other) const noexcept
+		{
+			return !(*this == other);
+		}
+
+	private:
+		TIFF* tif_;
+		tdir_t dirn_;
+	};
+
+	class DirectoryRange {
+	public:
+		explicit DirectoryRange(TIFF* tif) noexcept : tif_(tif) {}
+		DirectoryIterator begin() const { return DirectoryIterator(tif_); }
+		DirectoryIterator end() const noexcept { return DirectoryIterator(); }
+
+	private:
+		TIFF* tif_;
+	};
+
+	DirectoryRange directories() const noexcept
+	{
+		return DirectoryRange(tif_);
+	}
+
+private:
+	template<class Buffer>
+	static tmsize_t bytes(const Buffer& buf)
+	{
+		return static_cast<tmsize_t>(buf.size() * sizeof(*buf.data()));
+	}
+
+	TIFF* tif_;
+};
+
+} /* namespace libtiff */
+
+#endif /* C++11 */
+
 #endif /* _TIFFIO_HXX_ */
 
 /* vim: set ts=8 sts=8 sw=8 noet: */
@@ -69,6 +69,11 @@ extern int snprintf(char* str, size_t size, const char* format, ...);
 # define STRIP_SIZE_DEFAULT 8192
 #endif
 
+/* smallest compressed single strip read piecewise, see TIFF_CHUNKYSTRIP */
+#ifndef CHUNKY_STRIP_MIN_BYTES
+# define CHUNKY_STRIP_MIN_BYTES (1024*1024)
+#endif
+
 #define    streq(a,b)      (strcmp(a,b) == 0)
 
 #ifndef TRUE
@@ -97,6 +102,63 @@ typedef int (*TIFFSeekMethod)(TIFF*, uint32);
 typedef void (*TIFFPostMethod)(TIFF* tif, uint8* buf, tmsize_t size);
 typedef uint32 (*TIFFStripMethod)(TIFF*, uint32);
 typedef void (*TIFFTileMethod)(TIFF*, uint32*, uint32*);
+typedef void* (*TIFFSaveStateMethod)(TIFF*);
+typedef int (*TIFFRestoreStateMethod)(TIFF*, void*);
+typedef void (*TIFFFreeStateMethod)(TIFF*, void*);
+
+typedef struct _TIFFMutex TIFFMutex;  /* opaque, see tif_thread.c */
+typedef struct _TIFFCond TIFFCond;  /* opaque, see tif_thread.c */
+typedef struct _TIFFAllocProfile TIFFAllocProfile; /* see tif_stats.c */
+typedef struct _TIFFDirDataSpan TIFFDirDataSpan; /* see tif_dirread.c */
+
+/*
+ * Users of the scratch buffers of a handle; buffers in use at the same
+ * time need different slots.
+ */
+#define TIFF_SCRATCH_PREDICTOR	0	/* floating point predictor rows */
+#define TIFF_SCRATCH_ENCODE	1	/* copy of a chunk being encoded */
+#define TIFF_SCRATCH_CODEC	2	/* codec row buffers */
+#define TIFF_SCRATCH_DIRECTORY	3	/* directory block being written */
+#define TIFF_SCRATCH_DEDUP	4	/* strip/tile read back for comparison */
+#define TIFF_SCRATCH_SEEK	5	/* rows decoded only to skip them */
+#define TIFF_SCRATCH_CONVERT	6	/* chunk decoded for conversion */
+#define TIFF_SCRATCH_PLANES	7	/* planes of an interleaved chunk */
+#define TIFF_SCRATCH_SLOTS	8
+
+/*
+ * Amount of data taken through a chain of in-place passes over a chunk
+ * (bit reversal, decoding, prediction, byte swapping) at a time, so that
+ * it is still in a typical L2 cache for the later passes.  A multiple of
+ * every sample size.
+ */
+#define TIFF_BATCH_SIZE		((tmsize_t) 24 * 10 * 1024)
+typedef struct _TIFFThread TIFFThread;  /* opaque, see tif_thread.c */
+typedef struct _TIFFPrefetch TIFFPrefetch;  /* opaque, see tif_prefetch.c */
+typedef struct _TIFFCheckpoints TIFFCheckpoints;  /* see tif_checkpoint.c */
+typedef struct _TIFFDirCache TIFFDirCache;  /* see tif_dircache.c */
+typedef struct {
+	uint64 diroff;
+	uint32 gen;                       /* tif_dirsetgen when added */
+} TIFFDirSetEntry;
+typedef struct _TIFFChunkEncoder TIFFChunkEncoder;  /* see tif_parallel.c */
+typedef struct _TIFFBlockCache TIFFBlockCache;  /* see tif_blockcache.c */
+typedef struct _TIFFWriteBuffer TIFFWriteBuffer;  /* see tif_writebuffer.c */
+typedef struct _TIFFTileRows TIFFTileRows;        /* see tif_write.c */
+typedef struct _TIFFChunkStats TIFFChunkStats;    /* see tif_chunkstats.c */
+typedef struct _TIFFDedupEntry TIFFDedupEntry;  /* see tif_write.c */
+typedef struct {
+	uint64 diroff;                         /* directory of the level */
+	uint32 width;
+	uint32 length;
+	uint16 dirn;                           /* directory number reported */
+} TIFFOverviewEntry;
+typedef void (*TIFFReadAheadProc)(thandle_t, uint64 off, uint64 len);
+typedef void (*TIFFMapAdviceProc)(thandle_t, void* addr, tmsize_t len, int advice);
+
+/* access patterns passed to a TIFFMapAdviceProc */
+#define TIFF_MAP_NORMAL      0  /* no particular order, e.g. tiles */
+#define TIFF_MAP_SEQUENTIAL  1  /* read in order, e.g. strips */
+#define TIFF_MAP_WILLNEED    2  /* this range is about to be read */
 
 struct tiff {
 	char*                tif_name;         /* name of open file */
@@ -126,11 +188,32 @@ struct tiff {
         #define TIFF_DIRTYSTRIP 0x200000U /* stripoffsets/stripbytecount dirty*/
         #define TIFF_PERSAMPLE  0x400000U /* get/set per sample tags as arrays */
         #define TIFF_BUFFERMMAP 0x800000U /* read buffer (tif_rawdata) points into mmap() memory */
+        #define TIFF_LAZYSTRILELOAD 0x1000000U /* load strile arrays piecewise on demand */
+        #define TIFF_DEFERTAGS 0x2000000U /* read custom tags on first access */
+        #define TIFF_INPLACEUPDATE 0x4000000U /* rewrite directories where they are */
+        #define TIFF_SPARSEWRITE 0x8000000U /* leave all-zero strips/tiles out of the file */
+        #define TIFF_DEDUPWRITE 0x10000000U /* share the data of identical strips/tiles */
+        #define TIFF_CHUNKYSTRIP 0x20000000U /* read the single strip piecewise for scanlines */
+        #define TIFF_NOWARNINGS 0x40000000U /* drop warnings without formatting them */
+        #define TIFF_CHUNKSTATS 0x80000000U /* tally the samples written */
 	uint64               tif_diroff;       /* file offset of current directory */
 	uint64               tif_nextdiroff;   /* file offset of following directory */
 	uint64*              tif_dirlist;      /* list of offsets to already seen directories to prevent IFD looping */
-	uint16               tif_dirlistsize;  /* number of entries in offset list */
-	uint16               tif_dirnumber;    /* number of already seen directories */
+	uint32               tif_dirlistsize;  /* number of entries in offset list */
+	uint32               tif_dirnumber;    /* number of already seen directories */
+	TIFFDirSetEntry*     tif_dirset;       /* the same offsets, hashed */
+	uint32               tif_dirsetmask;   /* # slots in tif_dirset - 1 */
+	uint32               tif_dirsetgen;    /* entries of other generations are free */
+	uint64*              tif_dirindex;     /* offsets of the main chain directories */
+	uint32               tif_ndirindex;    /* # known entries in tif_dirindex */
+	TIFFDirDataSpan*     tif_dirspans;     /* tag data read ahead, by offset */
+	uint32               tif_ndirspans;    /* # spans in tif_dirspans */
+	uint8*               tif_dirspandata;  /* their contents */
+	uint32               tif_dirindexsize; /* # allocated entries */
+	int                  tif_dirindexdone; /* last known directory is the last one */
+	TIFFOverviewEntry*   tif_ovrindex;     /* levels of an image, see tif_dir.c */
+	uint32               tif_novrindex;    /* # levels, the image included */
+	uint64               tif_ovrbase;      /* image indexed, 0 if none */
 	TIFFDirectory        tif_dir;          /* internal rep of current directory */
 	TIFFDirectory        tif_customdir;    /* custom IFDs are separated from the main ones */
 	union {
@@ -144,6 +227,10 @@ struct tiff {
 	uint32               tif_curstrip;     /* current strip for read/write */
 	uint64               tif_curoff;       /* current offset for read/write */
 	uint64               tif_dataoff;      /* current offset for writing dir */
+	uint64               tif_dataend;      /* end of the tag data written */
+	uint64               tif_dirreserveoff; /* space set aside for the directory */
+	uint64               tif_dirreservesize; /* and its size, 0 if none */
+	uint64               tif_lastdiroff;   /* last directory linked, or 0 */
 	/* SubIFD support */
 	uint16               tif_nsubifd;      /* remaining subifds to write */
 	uint64               tif_subifdoff;    /* offset for patching SubIFD link */
@@ -168,6 +255,9 @@ struct tiff {
 	TIFFCodeMethod       tif_encodetile;   /* tile encoding routine */
 	TIFFVoidMethod       tif_close;        /* cleanup-on-close routine */
 	TIFFSeekMethod       tif_seek;         /* position within a strip routine */
+	TIFFSaveStateMethod  tif_savestate;    /* snapshot decoder, or NULL */
+	TIFFRestoreStateMethod tif_restorestate;/* return to a snapshot */
+	TIFFFreeStateMethod  tif_freestate;    /* discard a snapshot */
 	TIFFVoidMethod       tif_cleanup;      /* cleanup state routine */
 	TIFFStripMethod      tif_defstripsize; /* calculate/constrain strip size */
 	TIFFTileMethod       tif_deftilesize;  /* calculate/constrain tile size */
@@ -199,30 +289,190 @@ struct tiff {
 	TIFFField**          tif_fields;       /* sorted table of registered tags */
 	size_t               tif_nfields;      /* # entries in registered tag table */
 	const TIFFField*     tif_foundfield;   /* cached pointer to already found tag */
+	uint32*              tif_fieldshash;   /* tag -> 1 + first index in tif_fields */
+	uint32               tif_fieldshashmask;/* # hash slots - 1 */
 	TIFFTagMethods       tif_tagmethods;   /* tag get/set/print routines */
 	TIFFClientInfoLink*  tif_clientinfo;   /* extra client information. */
 	/* Backward compatibility stuff. We need these two fields for
 	 * setting up an old tag extension scheme. */
 	TIFFFieldArray*      tif_fieldscompat;
 	size_t               tif_nfieldscompat;
+	/* parallel decoding support */
+	TIFF**               tif_workers;      /* cached decoding handles */
+	int                  tif_nworkers;     /* # entries in tif_workers */
+	uint64               tif_workersdiroff;/* directory the workers read */
+	TIFFMutex*           tif_iomutex;      /* serializes seek+read raw reads */
+	TIFF*                tif_master;       /* handle a worker reads through */
+	/* handles cloned for other threads */
+	TIFF*                tif_template;     /* handle this one was cloned from */
+	int                  tif_shareddir;    /* tif_dir belongs to tif_template */
+	int                  tif_nclones;      /* # live clones of this handle */
+	int                  tif_closepending; /* 1 cleanup, 2 close after clones */
+	TIFFMutex*           tif_decodemutex;  /* protects tif_decoders */
+	TIFF**               tif_decoders;     /* idle TIFFDecodeChunk() clones */
+	int                  tif_ndecoders;    /* # entries in tif_decoders */
+	int                  tif_decodersalloc;/* # entries allocated */
+	TIFFMutex*           tif_encodemutex;  /* protects tif_encoders */
+	TIFFChunkEncoder**   tif_encoders;     /* idle TIFFEncodeChunk() workers */
+	int                  tif_nencoders;    /* # entries in tif_encoders */
+	int                  tif_encodersalloc;/* # entries allocated */
+	uint32               tif_encodergen;   /* bumped when a tag is set */
+	uint32               tif_encodersetup; /* tif_encodergen+1 once set up */
+	uint8*               tif_sharedraw;    /* raw data buffer of a worker */
+	tmsize_t             tif_sharedrawsize;
+	/* read-ahead support */
+	TIFFPrefetch*        tif_prefetch;     /* background read-ahead state */
+	TIFFCheckpoints*     tif_checkpoints;  /* decoder snapshots, or NULL */
+	TIFFDirCache*        tif_dircache;     /* directories put aside, or NULL */
+	TIFFReadAheadProc    tif_readaheadproc;/* OS read-ahead hint method */
+	TIFFReadAtProc       tif_readatproc;   /* positional read, or NULL */
+	TIFFReadBatchProc    tif_readbatchproc;/* batched positional reads */
+	TIFFPreallocateProc  tif_preallocateproc;/* file space reservation */
+	TIFFMapAdviceProc    tif_mapadviceproc;/* mapped access hint method */
+	int                  tif_mapadvice;    /* pattern last given for map */
+	TIFFBlockCache*      tif_blockcache;   /* cache of file blocks, or NULL */
+	TIFFChunkCache*      tif_chunkcache;   /* cache of decoded chunks, or NULL */
+	uint64               tif_cacheid;      /* key of entries in tif_chunkcache */
+	TIFFWriteBuffer*     tif_writebuffer;  /* write-behind buffer, or NULL */
+	TIFFTileRows*        tif_tilerows;     /* scanlines of a tiled image */
+	TIFFChunkStats*      tif_chunkstats;   /* sample tallies, or NULL */
+	int                  tif_chunkchecksums;/* keep CRC-32C of strips/tiles */
+	uint32*              tif_chunkcrc;     /* their checksums, or NULL */
+	uint32               tif_nchunkcrc;    /* # entries in tif_chunkcrc */
+	tmsize_t             tif_chunksize;    /* default strip/tile size, 0 if not set */
+	uint32               tif_strilewindow; /* strip/tile entries kept when streamed, 0 for all */
+	int                  tif_promote;      /* TIFF_PROMOTE_*, see tif_promote.c */
+	TIFFThreadPool       tif_threadpool;   /* executor of parallel tasks, submit NULL for the default */
+	TIFFDedupEntry*      tif_dedup;        /* strips/tiles written, by hash */
+	uint32               tif_dedupcount;   /* # entries in tif_dedup */
+	uint32               tif_dedupmask;    /* # slots in tif_dedup - 1 */
+	TIFFStatistics*      tif_stats;        /* counters, or NULL if not kept */
+	TIFFTraceProc        tif_traceproc;    /* stage callback, or NULL */
+	void*                tif_tracedata;    /* its client data */
+	TIFF*                tif_traceowner;   /* handle reported, NULL for self */
+	/* cancellation, see tif_cancel.c */
+	volatile int         tif_cancel;       /* TIFF_CANCEL_* */
+	uint64               tif_deadline;     /* _TIFFStatsClock() time, 0 for none */
+	TIFF*                tif_cancelowner;  /* handle obeyed, NULL for self */
+	/* memory allocation, NULL for the _TIFFmalloc() family */
+	TIFFMallocProc       tif_mallocproc;   /* allocate method */
+	TIFFReallocProc      tif_reallocproc;  /* reallocate method */
+	TIFFFreeProc         tif_freeproc;     /* free method */
+	void*                tif_allocctx;     /* allocator callback parameter */
+	/* memory accounting, NULL account if not tracked */
+	TIFF*                tif_memaccount;   /* handle charged, self or master */
+	TIFFMutex*           tif_memmutex;     /* protects the counters below */
+	tmsize_t             tif_maxmemalloc;  /* limit, 0 for none */
+	tmsize_t             tif_memalign;     /* block alignment, 0 for default */
+	tmsize_t             tif_curmemalloc;  /* bytes currently allocated */
+	tmsize_t             tif_peakmemalloc; /* largest tif_curmemalloc */
+	/* allocations by call site, with ALLOC_PROFILE */
+	TIFFAllocProfile*    tif_allocprofile; /* sites, or NULL */
+	TIFF*                tif_allocowner;   /* handle recorded, NULL for self */
+	/* work buffers kept from chunk to chunk, see _TIFFGetScratch() */
+	void*                tif_scratch[TIFF_SCRATCH_SLOTS];
+	tmsize_t             tif_scratchsize[TIFF_SCRATCH_SLOTS];
+	/* JPEG decompressors kept from directory to directory, see tif_jpeg.c */
+	void*                tif_jpegdecoders[2]; /* 8 and 12 bit, or NULL */
+	/* handlers of this handle, called before the global ones */
+	TIFFErrorHandlerExtR tif_errorhandler;
+	void*                tif_errorhandler_user_data;
+	TIFFErrorHandlerExtR tif_warnhandler;
+	void*                tif_warnhandler_user_data;
+};
+
+struct _TIFFOpenOptions {
+	TIFFMallocProc       mallocproc;
+	TIFFReallocProc      reallocproc;
+	TIFFFreeProc         freeproc;
+	void*                allocctx;
+	tmsize_t             maxmemalloc;
+	tmsize_t             memalign;         /* 0 for the allocator's */
+	TIFFReadAtProc       readatproc;
+	TIFFReadBatchProc    readbatchproc;
+	int                  positionalio;     /* TIFFFdOpenExt() and friends */
+	int                  directio;         /* TIFFOpenExt() with O_DIRECT */
+	int                  accesspattern;    /* TIFF_ACCESS_* hint for the OS */
+	tmsize_t             spilllimit;       /* TIFFOpenSequential(), 0 for default */
+	int                  chunkchecksums;   /* write CRC-32C of strips/tiles */
+	TIFFPreallocateProc  preallocateproc;
+	tmsize_t             cacheblocksize;
+	uint32               cacheblocks;      /* 0 for no block cache */
+	tmsize_t             headerprefetch;
+	tmsize_t             writebuffersize;  /* 0 for no write buffer */
+	int                  writebehind;      /* # buffers, 0 for no thread */
+	tmsize_t             chunksize;        /* strip/tile size aimed at */
+	uint32               strilewindow;     /* 0 for whole strip/tile arrays */
+	TIFFThreadPool       threadpool;       /* submit NULL for the default */
+	int                  statistics;       /* keep a TIFFStatistics */
+	TIFFErrorHandlerExtR errorhandler;
+	void*                errorhandler_user_data;
+	TIFFErrorHandlerExtR warnhandler;
+	void*                warnhandler_user_data;
+	int                  nowarnings;
+	TIFF*                memaccount;       /* for helper handles only */
 };
 
 #define isPseudoTag(t) (t > 0xffff)            /* is tag value normal or pseudo */
 
 #define isTiled(tif) (((tif)->tif_flags & TIFF_ISTILED) != 0)
 #define isMapped(tif) (((tif)->tif_flags & TIFF_MAPPED) != 0)
+#define isDirReserved(tif) ((tif)->tif_dirreservesize != 0 && \
+    (tif)->tif_diroff == (tif)->tif_dirreserveoff)
 #define isFillOrder(tif, o) (((tif)->tif_flags & (o)) != 0)
 #define isUpSampled(tif) (((tif)->tif_flags & TIFF_UPSAMPLED) != 0)
+/*
+ * Calls to the I/O methods of the handle, counted when the handle keeps
+ * statistics.
+ */
+#define _TIFFCallReadProc(tif, buf, size) \
+	((tif)->tif_stats ? _TIFFStatsRead((tif),(buf),(size)) : \
+	 (*(tif)->tif_readproc)((tif)->tif_clientdata,(buf),(size)))
+#define _TIFFCallWriteProc(tif, buf, size) \
+	((tif)->tif_stats ? _TIFFStatsWrite((tif),(buf),(size)) : \
+	 (*(tif)->tif_writeproc)((tif)->tif_clientdata,(buf),(size)))
+#define _TIFFCallSeekProc(tif, off, whence) \
+	((tif)->tif_stats ? _TIFFStatsSeek((tif),(off),(whence)) : \
+	 (*(tif)->tif_seekproc)((tif)->tif_clientdata,(off),(whence)))
+#define TIFFStatsAdd(tif, field, n) \
+	((tif)->tif_stats ? (void) ((tif)->tif_stats->field += (n)) : (void) 0)
+#define _TIFFTrace(tif, stage, phase, strile, bytes) \
+	((tif)->tif_traceproc ? \
+	 _TIFFTraceEvent((tif),(stage),(phase),(strile),(uint64)(bytes)) : \
+	 (void) 0)
+/*
+ * Calls to the codec methods, timed when the handle keeps statistics
+ * and reported when it has a trace callback.
+ */
+#define _TIFFCallDecode(tif, method, buf, cc, s) \
+	((tif)->tif_stats || (tif)->tif_traceproc ? \
+	 _TIFFStatsCode((tif),(tif)->method,(buf),(cc),(s),TIFF_TRACE_DECODE) : \
+	 (*(tif)->method)((tif),(buf),(cc),(s)))
+#define _TIFFCallEncode(tif, method, buf, cc, s) \
+	((tif)->tif_stats || (tif)->tif_traceproc ? \
+	 _TIFFStatsCode((tif),(tif)->method,(buf),(cc),(s),TIFF_TRACE_ENCODE) : \
+	 (*(tif)->method)((tif),(buf),(cc),(s)))
+#define _TIFFCallPostDecode(tif, buf, cc) \
+	((tif)->tif_stats ? _TIFFStatsPostDecode((tif),(buf),(cc)) : \
+	 (*(tif)->tif_postdecode)((tif),(buf),(cc)))
+
 #define TIFFReadFile(tif, buf, size) \
-	((*(tif)->tif_readproc)((tif)->tif_clientdata,(buf),(size)))
+	((tif)->tif_blockcache ? _TIFFBlockCacheRead((tif),(buf),(size)) : \
+	 (tif)->tif_writebuffer ? _TIFFWriteBufferRead((tif),(buf),(size)) : \
+	 _TIFFCallReadProc((tif),(buf),(size)))
 #define TIFFWriteFile(tif, buf, size) \
-	((*(tif)->tif_writeproc)((tif)->tif_clientdata,(buf),(size)))
+	((tif)->tif_writebuffer ? _TIFFWriteBufferWrite((tif),(buf),(size)) : \
+	 _TIFFCallWriteProc((tif),(buf),(size)))
 #define TIFFSeekFile(tif, off, whence) \
-	((*(tif)->tif_seekproc)((tif)->tif_clientdata,(off),(whence)))
+	((tif)->tif_prefetch ? _TIFFPrefetchWait(tif) : (void) 0, \
+	 (tif)->tif_blockcache ? _TIFFBlockCacheSeek((tif),(off),(whence)) : \
+	 (tif)->tif_writebuffer ? _TIFFWriteBufferSeek((tif),(off),(whence)) : \
+	 _TIFFCallSeekProc((tif),(off),(whence)))
 #define TIFFCloseFile(tif) \
 	((*(tif)->tif_closeproc)((tif)->tif_clientdata))
 #define TIFFGetFileSize(tif) \
-	((*(tif)->tif_sizeproc)((tif)->tif_clientdata))
+	((void) _TIFFWriteBufferFlush(tif), \
+	 (*(tif)->tif_sizeproc)((tif)->tif_clientdata))
 #define TIFFMapFileContents(tif, paddr, psize) \
 	((*(tif)->tif_mapproc)((tif)->tif_clientdata,(paddr),(psize)))
 #define TIFFUnmapFileContents(tif, addr, size) \
@@ -265,6 +515,9 @@ struct tiff {
 
 #define TIFFArrayCount(a) (sizeof (a) / sizeof ((a)[0]))
 
+/* upper bound on the threads used by the parallel read/write routines */
+#define TIFF_MAX_WORKER_THREADS 64
+
 /*
   Support for large files.
 
@@ -322,6 +575,115 @@ typedef size_t TIFFIOSize_t;
 #define TIFF_NOSANITIZE_UNSIGNED_INT_OVERFLOW
 #endif
 
+/*
+ * SIMD code paths, selected at run time from _TIFFCPUFeatures().
+ * TIFF_TARGET_xxx allow a function to use an instruction set the rest
+ * of the library is not compiled for.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define TIFF_SIMD_X86
+#define TIFF_TARGET_SSE2 __attribute__((target("sse2")))
+#define TIFF_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TIFF_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TIFF_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define TIFF_SIMD_X86
+#define TIFF_TARGET_SSE2
+#define TIFF_TARGET_SSSE3
+#define TIFF_TARGET_SSE42
+#define TIFF_TARGET_AVX2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TIFF_SIMD_NEON
+#endif
+
+/*
+ * Optimized kernels for the CPU the library runs on, chosen once from
+ * the available instruction sets (TIFF_CPU_xxx in tiffio.h) by
+ * _TIFFGetKernels().  Each module fills in its own entries in its
+ * _TIFFxxxKernels() routine; a NULL entry means the portable code is
+ * used.  Kernels return how many of the n elements they processed
+ * (the caller does the rest) or, for the predictor, 1 if they did
+ * the whole row and 0 if they could not handle it; the transposes
+ * always do a whole 16x16 byte or 8x8 16-bit block.
+ */
+typedef struct {
+	/* tif_swab.c */
+	tmsize_t (*swab)(void* p, tmsize_t n, int size);
+	tmsize_t (*reverseBits)(uint8* cp, tmsize_t n);
+	/* tif_predict.c */
+	int (*horAcc8)(uint8* cp, tmsize_t cc, tmsize_t stride);
+	int (*horAcc16)(uint16* wp, tmsize_t wc, tmsize_t stride);
+	int (*horDiff8)(uint8* cp, tmsize_t cc, tmsize_t stride);
+	int (*horDiff16)(uint16* wp, tmsize_t wc, tmsize_t stride);
+	tmsize_t (*fpMergeBytes)(uint8* cp, const uint8* const* planes,
+	    tmsize_t wc, uint32 bps);
+	tmsize_t (*fpSplitBytes)(uint8* const* planes, const uint8* cp,
+	    tmsize_t wc, uint32 bps);
+	/* tif_getimage.c */
+	uint32 (*packRGB8)(uint32* cp, const uint8* pp, uint32 w,
+	    int samplesperpixel);
+	uint32 (*packRGBUA8)(uint32* cp, const uint8* pp, uint32 w,
+	    int samplesperpixel);
+	uint32 (*packGrey8)(uint32* cp, const uint8* pp, uint32 w,
+	    int samplesperpixel, int invert);
+	uint32 (*ycbcr8)(uint32* cp, uint32* cp2, const uint8* pp,
+	    uint32 w, int hs, int vs, const int32* D);
+	uint32 (*cielab8)(uint32* cp, const uint8* pp, uint32 w,
+	    const int16* cube, const uint8* tab);
+	/* tif_dirread.c */
+	tmsize_t (*shortToLong8)(uint64* dst, const uint16* src, tmsize_t n);
+	tmsize_t (*longToLong8)(uint64* dst, const uint32* src, tmsize_t n);
+	tmsize_t (*floatToDouble)(double* dst, const float* src, tmsize_t n);
+	/* tif_orient.c */
+	void (*transpose8)(const uint8* src, tmsize_t srcstep, uint8* dst,
+	    tmsize_t dststep);
+	void (*transpose16)(const uint8* src, tmsize_t srcstep, uint8* dst,
+	    tmsize_t dststep);
+	/* tif_color.c */
+	uint32 (*rgbGrey8)(uint8* out, const uint8* r, const uint8* g,
+	    const uint8* b, uint32 n, int step, const int32* weights);
+	uint32 (*rgbYCbCr8)(uint8* y, int32* cb, int32* cr, const uint32* rgba,
+	    uint32 n, const int32* coeffs);
+	tmsize_t (*palette8)(uint8* dst, const uint8* src, tmsize_t n,
+	    const uint32* map);
+	/* tif_unpack.c */
+	tmsize_t (*unpack1)(uint8* dst, const uint8* src, tmsize_t n,
+	    const uint8* values);
+	tmsize_t (*unpack2)(uint8* dst, const uint8* src, tmsize_t n,
+	    const uint8* values);
+	tmsize_t (*unpack4)(uint8* dst, const uint8* src, tmsize_t n,
+	    const uint8* values);
+	tmsize_t (*unpack12)(uint16* dst, const uint8* src, tmsize_t n);
+	/* tif_convert.c */
+	tmsize_t (*uint8ToFloat)(float* dst, const uint8* src, tmsize_t n,
+	    float scale, float offset);
+	tmsize_t (*uint16ToFloat)(float* dst, const uint16* src, tmsize_t n,
+	    float scale, float offset);
+	tmsize_t (*int16ToFloat)(float* dst, const int16* src, tmsize_t n,
+	    float scale, float offset);
+	/* tif_interleave.c */
+	tmsize_t (*interleave)(uint8* dst, uint8* const* planes, tmsize_t n,
+	    int nplanes, int size);
+	tmsize_t (*deinterleave)(uint8* const* planes, const uint8* src,
+	    tmsize_t n, int nplanes, int size);
+	/* tif_checksum.c */
+	tmsize_t (*crc32c)(uint32* state, const uint8* p, tmsize_t n);
+} TIFFKernels;
+
+/*
+ * Interpolation cube of _TIFFCIELabToRGBCube(): CIELABCUBE_NODES^3 nodes
+ * of 4 values (R, G, B, unused), and display value tables of
+ * CIELABCUBE_TABSIZE bytes.
+ */
+#define CIELABCUBE_STEP		8
+#define CIELABCUBE_NODES	(256 / CIELABCUBE_STEP + 1)
+#define CIELABCUBE_BIAS		8192
+#define CIELABCUBE_SIZE \
+	(CIELABCUBE_NODES * CIELABCUBE_NODES * CIELABCUBE_NODES * 4 * sizeof (int16))
+#define CIELABCUBE_TABSIZE	(3 * (CIELABTORGB_TABLE_RANGE + 1))
+
 
 #if defined(__cplusplus)
 extern "C" {
@@ -335,20 +697,26 @@ extern int _TIFFNoStripDecode(TIFF* tif, uint8* pp, tmsize_t cc, uint16 s);
 extern int _TIFFNoTileDecode(TIFF*, uint8* pp, tmsize_t cc, uint16 s);
 extern void _TIFFNoPostDecode(TIFF* tif, uint8* buf, tmsize_t cc);
 extern int _TIFFNoPreCode(TIFF* tif, uint16 s);
+extern int _TIFFIsWholeChunk(TIFF* tif, tmsize_t cc);
 extern int _TIFFNoSeek(TIFF* tif, uint32 off);
 extern void _TIFFSwab16BitData(TIFF* tif, uint8* buf, tmsize_t cc);
 extern void _TIFFSwab24BitData(TIFF* tif, uint8* buf, tmsize_t cc);
 extern void _TIFFSwab32BitData(TIFF* tif, uint8* buf, tmsize_t cc);
 extern void _TIFFSwab64BitData(TIFF* tif, uint8* buf, tmsize_t cc);
 extern int TIFFFlushData1(TIFF* tif);
+extern int _TIFFFlushTileRows(TIFF* tif);
+extern void _TIFFFreeTileRows(TIFF* tif);
 extern int TIFFDefaultDirectory(TIFF* tif);
 extern void _TIFFSetDefaultCompressionState(TIFF* tif);
 extern int _TIFFRewriteField(TIFF *, uint16, TIFFDataType, tmsize_t, void *);
 extern int TIFFSetCompressionScheme(TIFF* tif, int scheme);
 extern int TIFFSetDefaultCompressionState(TIFF* tif);
 extern uint32 _TIFFDefaultStripSize(TIFF* tif, uint32 s);
+extern uint64 _TIFFChunkSize(TIFF* tif);
 extern void _TIFFDefaultTileSize(TIFF* tif, uint32* tw, uint32* th);
 extern int _TIFFDataSize(TIFFDataType type);
+extern int _TIFFYCbCrFixedPoint(const TIFFYCbCrToRGB*, const float*, int32[4]);
+extern void _TIFFCIELabToRGBCube(TIFFCIELabToRGB*, int16*, uint8*);
 
 extern void _TIFFsetByteArray(void**, void*, uint32);
 extern void _TIFFsetString(char**, char*);
@@ -356,6 +724,10 @@ extern void _TIFFsetShortArray(uint16**, uint16*, uint32);
 extern void _TIFFsetLongArray(uint32**, uint32*, uint32);
 extern void _TIFFsetFloatArray(float**, float*, uint32);
 extern void _TIFFsetDoubleArray(double**, double*, uint32);
+extern void _TIFFsetByteArrayExt(TIFF*, void**, void*, uint32);
+extern void _TIFFsetShortArrayExt(TIFF*, uint16**, uint16*, uint32);
+extern void _TIFFsetFloatArrayExt(TIFF*, float**, float*, uint32);
+extern void _TIFFsetDoubleArrayExt(TIFF*, double**, double*, uint32);
 
 extern void _TIFFprintAscii(FILE*, const char*);
 extern void _TIFFprintAsciiTag(FILE*, const char*, const char*);
@@ -367,8 +739,49 @@ extern TIFFErrorHandlerExt _TIFFerrorHandlerExt;
 
 extern uint32 _TIFFMultiply32(TIFF*, uint32, uint32, const char*);
 extern uint64 _TIFFMultiply64(TIFF*, uint64, uint64, const char*);
+extern void* _TIFFmallocExt(TIFF* tif, tmsize_t s);
+extern void* _TIFFcallocExt(TIFF* tif, tmsize_t nmemb, tmsize_t siz);
+extern void* _TIFFreallocExt(TIFF* tif, void* p, tmsize_t s);
+extern void _TIFFfreeExt(TIFF* tif, void* p);
+extern void _TIFFFreeHandle(TIFF* tif);
+extern void* _TIFFGetScratch(TIFF* tif, int slot, tmsize_t size);
+extern void* _TIFFGrowScratch(TIFF* tif, int slot, tmsize_t size);
+extern void _TIFFFreeScratch(TIFF* tif);
+extern void _TIFFResetDirIndex(TIFF* tif);
+extern void _TIFFResetOverviewIndex(TIFF* tif);
+extern void _TIFFLinkDirIndex(TIFF* tif, uint16 dirn, uint64 diroff,
+    uint64 nextdiroff);
+extern void _TIFFAppendDirIndexLink(TIFF* tif, uint64 prevdiroff,
+    uint64 diroff);
 extern void* _TIFFCheckMalloc(TIFF*, tmsize_t, tmsize_t, const char*);
 extern void* _TIFFCheckRealloc(TIFF*, void*, tmsize_t, tmsize_t, const char*);
+extern void* _TIFFmallocSite(TIFF*, tmsize_t, const char*, int);
+extern void* _TIFFcallocSite(TIFF*, tmsize_t, tmsize_t, const char*, int);
+extern void* _TIFFreallocSite(TIFF*, void*, tmsize_t, const char*, int);
+extern void* _TIFFCheckReallocSite(TIFF*, void*, tmsize_t, tmsize_t,
+    const char*, const char*, int);
+extern void _TIFFAllocProfileHelper(TIFF* tif, TIFF* helper);
+extern void _TIFFFreeAllocProfile(TIFF* tif);
+
+/*
+ * Builds configured with ALLOC_PROFILE record the allocations made for
+ * a handle by call site, and report them when it is closed.  The
+ * definitions of the functions use parenthesized names to escape these.
+ */
+#ifdef ALLOC_PROFILE
+#define _TIFFmallocExt(tif, s) \
+	_TIFFmallocSite((tif), (s), __FILE__, __LINE__)
+#define _TIFFcallocExt(tif, nmemb, siz) \
+	_TIFFcallocSite((tif), (nmemb), (siz), __FILE__, __LINE__)
+#define _TIFFreallocExt(tif, p, s) \
+	_TIFFreallocSite((tif), (p), (s), __FILE__, __LINE__)
+#define _TIFFCheckMalloc(tif, nmemb, elem_size, what) \
+	_TIFFCheckReallocSite((tif), NULL, (nmemb), (elem_size), (what), \
+	    __FILE__, __LINE__)
+#define _TIFFCheckRealloc(tif, buffer, nmemb, elem_size, what) \
+	_TIFFCheckReallocSite((tif), (buffer), (nmemb), (elem_size), (what), \
+	    __FILE__, __LINE__)
+#endif
 
 extern double _TIFFUInt64ToDouble(uint64);
 extern float _TIFFUInt64ToFloat(uint64);
@@ -385,7 +798,137 @@ extern tmsize_t
 _TIFFReadTileAndAllocBuffer(TIFF* tif,
                             void **buf, tmsize_t bufsizetoalloc,
                             uint32 x, uint32 y, uint32 z, uint16 s);
+extern tmsize_t
+_TIFFReadEncodedChunkFromBuffer(TIFF* tif, uint32 strile,
+                                void* inbuf, tmsize_t insize,
+                                void* outbuf, tmsize_t outsize);
 extern int _TIFFSeekOK(TIFF* tif, toff_t off);
+extern int _TIFFIsSparseStrile(TIFF* tif, uint32 strile);
+extern void _TIFFWriteSparseStrile(TIFF* tif, uint32 strile);
+extern uint64 _TIFFHash64(const void* buf, tmsize_t size);
+
+extern TIFFMutex* _TIFFMutexCreate(void);
+extern void _TIFFMutexDestroy(TIFFMutex*);
+extern void _TIFFMutexLock(TIFFMutex*);
+extern void _TIFFMutexUnlock(TIFFMutex*);
+extern TIFFCond* _TIFFCondCreate(void);
+extern void _TIFFCondDestroy(TIFFCond*);
+extern void _TIFFCondWait(TIFFCond*, TIFFMutex*);
+extern void _TIFFCondBroadcast(TIFFCond*);
+extern void _TIFFGlobalLock(void);
+extern void _TIFFGlobalUnlock(void);
+extern int _TIFFHaveThreads(void);
+extern int _TIFFGetNumCPUs(void);
+extern int _TIFFCPUFeatures(void);
+extern const TIFFKernels* _TIFFGetKernels(void);
+extern void _TIFFSwabKernels(TIFFKernels*, int features);
+extern void _TIFFPredictorKernels(TIFFKernels*, int features);
+extern void _TIFFRGBAImageKernels(TIFFKernels*, int features);
+extern void _TIFFDirReadKernels(TIFFKernels*, int features);
+extern void _TIFFOrientKernels(TIFFKernels*, int features);
+extern void _TIFFColorKernels(TIFFKernels*, int features);
+extern void _TIFFUnpackKernels(TIFFKernels*, int features);
+extern void _TIFFConvertKernels(TIFFKernels*, int features);
+extern void _TIFFInterleaveKernels(TIFFKernels*, int features);
+extern void _TIFFChecksumKernels(TIFFKernels*, int features);
+extern int _TIFFRunThreads(int nthreads, void (*func)(void*), void** args);
+extern int _TIFFRunTasks(TIFF* tif, int ntasks, void (*func)(void*), void** args);
+extern int _TIFFThreadConcurrency(TIFF* tif);
+extern TIFFThread* _TIFFThreadCreate(void (*func)(void*), void* arg);
+extern void _TIFFThreadJoin(TIFFThread*);
+extern void _TIFFFreeDecodeWorkers(TIFF* tif);
+extern int _TIFFGetDecodeWorkers(TIFF* tif, int n);
+extern int _TIFFCanDecodeInParallel(TIFF* tif);
+extern void _TIFFFreeChunkDecoders(TIFF* tif);
+extern void _TIFFFreeChunkEncoders(TIFF* tif);
+extern int _TIFFKeepTemplate(TIFF* tif, int close);
+extern void _TIFFReleaseTemplate(TIFF* tif, thandle_t io);
+extern int _TIFFCheckUnshared(TIFF* tif, int modify, const char* module);
+extern tmsize_t _TIFFReadEncodedShared(TIFF* worker, uint32 strile, void* buf,
+    tmsize_t bufsize);
+extern int _TIFFReadEncodedParallel(TIFF* tif, int tiles, const uint32* striles,
+    uint32 nstriles, void** bufs, tmsize_t bufsize, int nthreads,
+    const char* module);
+extern void _TIFFPrefetchWait(TIFF* tif);
+extern int _TIFFPrefetchTake(TIFF* tif, uint32 strile, tmsize_t size);
+extern void _TIFFPrefetchSchedule(TIFF* tif, uint32 strile);
+extern void _TIFFFreePrefetch(TIFF* tif);
+extern int _TIFFCheckpointFind(TIFF* tif, uint32 strip, uint32 row,
+    uint32* ckrow, uint64* rawoff);
+extern int _TIFFCheckpointRestore(TIFF* tif, int which);
+extern void _TIFFCheckpointSave(TIFF* tif);
+extern void _TIFFFreeCheckpoints(TIFF* tif);
+extern int _TIFFDirCacheSwitch(TIFF* tif);
+extern void _TIFFDirCacheRead(TIFF* tif, int ok);
+extern void _TIFFFreeDirCache(TIFF* tif);
+extern int _TIFFBlockCacheInit(TIFF* tif, tmsize_t blocksize, uint32 nblocks,
+    tmsize_t header);
+extern tmsize_t _TIFFBlockCacheRead(TIFF* tif, void* buf, tmsize_t size);
+extern uint64 _TIFFBlockCacheSeek(TIFF* tif, uint64 off, int whence);
+extern void _TIFFBlockCacheOptions(TIFF* tif, TIFFOpenOptions* opts);
+extern void _TIFFFreeBlockCache(TIFF* tif);
+extern tmsize_t _TIFFChunkCacheGet(TIFF* tif, uint32 chunk, void* buf,
+    tmsize_t size);
+extern void _TIFFChunkCachePut(TIFF* tif, uint32 chunk, const void* buf,
+    tmsize_t size);
+extern void _TIFFChunkCacheShare(TIFF* tif, TIFF* w);
+extern void _TIFFFreeChunkCache(TIFF* tif);
+extern uint32 _TIFFDecodeVariant(TIFF* tif);
+extern int _TIFFWriteBufferInit(TIFF* tif, tmsize_t size, int nbuffers);
+extern tmsize_t _TIFFWriteBufferWrite(TIFF* tif, const void* buf,
+    tmsize_t size);
+extern tmsize_t _TIFFWriteBufferRead(TIFF* tif, void* buf, tmsize_t size);
+extern uint64 _TIFFWriteBufferSeek(TIFF* tif, uint64 off, int whence);
+extern int _TIFFWriteBufferFlush(TIFF* tif);
+
+/* tif_strilewindow.c */
+#define TIFFStrileIndex(tif, s) ((s) - (tif)->tif_dir.td_strilefirst)
+extern int _TIFFSetupStrileWindow(TIFF* tif);
+extern int _TIFFHoldStrile(TIFF* tif, uint32 strile, int modify);
+extern int _TIFFFlushStrileWindow(TIFF* tif);
+extern uint64 _TIFFStrileArrayOffset(TIFF* tif, int bytecounts);
+extern void _TIFFFreeStrileWindow(TIFF* tif);
+
+/* tif_promote.c */
+#define TIFF_PROMOTE_NONE     0  /* file stays in its format */
+#define TIFF_PROMOTE_AUTO     1  /* ClassicTIFF, BigTIFF when needed */
+#define TIFF_PROMOTE_PENDING  2  /* BigTIFF, older directories still classic */
+extern int _TIFFPromoteIfNeeded(TIFF* tif, uint64 end, const char* module);
+extern int _TIFFPromoteDirectories(TIFF* tif, const char* module);
+
+/* tif_sequential.c */
+extern int _TIFFSequentialCommit(TIFF* tif, uint64 off);
+extern void _TIFFSequentialHold(TIFF* tif);
+
+/* tif_chunkstats.c */
+extern TIFFChunkStats* _TIFFChunkStatsSetup(TIFF* tif);
+extern void _TIFFChunkStatsTally(TIFF* tif, uint32 strile, const void* buf,
+    tmsize_t cc, uint32 row, int reset, TIFFMutex* lock);
+extern int _TIFFChunkStatsFlush(TIFF* tif);
+extern void _TIFFFreeChunkStats(TIFF* tif);
+
+/* tif_checksum.c */
+extern uint32 _TIFFCRC32C(uint32 crc, const void* buf, tmsize_t n);
+extern void _TIFFChunkCRCUpdate(TIFF* tif, uint32 strile, const void* data,
+    tmsize_t cc, int fresh);
+extern int _TIFFChunkCRCFlush(TIFF* tif);
+extern void _TIFFFreeChunkCRC(TIFF* tif);
+extern int _TIFFFreeWriteBuffer(TIFF* tif);
+extern uint64 _TIFFStatsClock(void);
+extern int _TIFFStatsInit(TIFF* tif);
+extern tmsize_t _TIFFStatsRead(TIFF* tif, void* buf, tmsize_t size);
+extern tmsize_t _TIFFStatsWrite(TIFF* tif, void* buf, tmsize_t size);
+extern uint64 _TIFFStatsSeek(TIFF* tif, uint64 off, int whence);
+extern int _TIFFStatsCode(TIFF* tif, TIFFCodeMethod method, uint8* buf,
+    tmsize_t cc, uint16 s, int stage);
+extern void _TIFFStatsPostDecode(TIFF* tif, uint8* buf, tmsize_t cc);
+extern void _TIFFStatsMerge(TIFF* tif, TIFF* helper, int io);
+extern void _TIFFFreeStats(TIFF* tif);
+extern void _TIFFTraceEvent(TIFF* tif, int stage, int phase, uint32 strile,
+    uint64 bytes);
+extern void _TIFFTraceHelper(TIFF* tif, TIFF* helper);
+extern int _TIFFCheckCancel(TIFF* tif, const char* module);
+extern void _TIFFCancelHelper(TIFF* tif, TIFF* helper);
 
 extern int TIFFInitDumpMode(TIFF*, int);
 #ifdef PACKBITS_SUPPORT
@@ -409,6 +952,7 @@ extern int TIFFInitOJPEG(TIFF*, int);
 #endif
 #ifdef JPEG_SUPPORT
 extern int TIFFInitJPEG(TIFF*, int);
+extern void _TIFFFreeJPEGDecoders(TIFF*);
 extern int TIFFJPEGIsFullStripRequired(TIFF*);
 #endif
 #ifdef JBIG_SUPPORT
@@ -429,6 +973,15 @@ extern int TIFFInitLZMA(TIFF*, int);
 #ifdef ZSTD_SUPPORT
 extern int TIFFInitZSTD(TIFF*, int);
 #endif
+#ifdef LZ4_SUPPORT
+extern int TIFFInitLZ4(TIFF*, int);
+#endif
+#ifdef LERC_SUPPORT
+extern int TIFFInitLERC(TIFF*, int);
+#endif
+#ifdef WEBP_SUPPORT
+extern int TIFFInitWebP(TIFF*, int);
+#endif
 #ifdef VMS
 extern const TIFFCodec _TIFFBuiltinCODECS[];
 #else
@@ -28,6 +28,23 @@ string(REPLACE "^" ";" TESTFILES "${TESTFILES}")
 
 test_convert_multi("${TIFFCP}" "${TESTFILES}" "${CONJOINED}")
 test_convert("${TIFFSPLIT}" "${CONJOINED}" "${SPLITFILE}")
+if (SPLITPAGES)
+  # Pages split out on their own must match those of the full split
+  test_convert("${TIFFSPLIT};-N;${SPLITPAGES}" "${CONJOINED}" "${PAGEFILE}")
+  file(GLOB PAGEFILES "${PAGEFILE}*")
+  if (NOT PAGEFILES)
+    message(FATAL_ERROR "No pages were split out!")
+  endif()
+  foreach(pagefile ${PAGEFILES})
+    string(REPLACE "${PAGEFILE}" "${SPLITFILE}" splitfile "${pagefile}")
+    execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files
+                    "${pagefile}" "${splitfile}"
+                    RESULT_VARIABLE TEST_STATUS)
+    if(TEST_STATUS)
+      message(FATAL_ERROR "\"${pagefile}\" differs from \"${splitfile}\"!")
+    endif()
+  endforeach()
+endif()
 if (RECONJOINED)
   file(GLOB SPLITFILES "${SPLITFILE}*")
   test_convert_multi("${TIFFCP}" "${SPLITFILES}" "${RECONJOINED}")
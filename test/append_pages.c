@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that writing many pages, in a new file and in append mode,
+ * does not walk the whole directory chain for every page.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "append_pages.tif";
+
+#define	NPAGES		300
+#define	NAPPENDED	50
+
+/* Reading the end of the last directory takes two reads per page */
+#define	MAXREADS(n)	(4 * (n) + 16)
+
+static int
+write_page(TIFF* tif, uint16 page)
+{
+	unsigned char row[8];
+
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, sizeof(row));
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, 1);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+	TIFFSetField(tif, TIFFTAG_PAGENUMBER, page, 0);
+	memset(row, page & 0xff, sizeof(row));
+	if (TIFFWriteScanline(tif, row, 0, 0) == -1 ||
+	    !TIFFWriteDirectory(tif)) {
+		fprintf (stderr, "Can't write page %u.\n", page);
+		return 0;
+	}
+	return 1;
+}
+
+static int
+write_pages(const char* mode, uint16 first, uint16 n)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFFStatistics stats;
+	TIFF* tif;
+	uint16 i;
+	int ret = 0;
+
+	if (!opts)
+		return 0;
+	TIFFOpenOptionsSetStatistics(opts, 1);
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s (mode %s).\n", filename, mode);
+		return 0;
+	}
+	for (i = 0; i < n; i++)
+		if (!write_page(tif, (uint16) (first + i)))
+			goto failure;
+	if (!TIFFGetStatistics(tif, &stats))
+		goto failure;
+	/* append mode has to find the end of the chain once */
+	if (stats.readcalls > (uint64) MAXREADS(n) + 2 * first) {
+		fprintf (stderr, "Mode %s: %lu reads for %u pages.\n", mode,
+			 (unsigned long) stats.readcalls, n);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+/*
+ * Rewriting the last directory moves it to the end of the file, after
+ * which pages are appended behind it.
+ */
+static int
+rewrite_page(uint16 dirn, uint16 page)
+{
+	TIFF* tif;
+	int ret;
+
+	tif = TIFFOpen(filename, "r+");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s for update.\n", filename);
+		return 0;
+	}
+	ret = TIFFSetDirectory(tif, dirn) &&
+	    TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, "rewritten") &&
+	    TIFFRewriteDirectory(tif);
+	if (ret) {
+		TIFFCreateDirectory(tif);
+		ret = write_page(tif, page);
+	}
+	TIFFClose(tif);
+	if (!ret)
+		fprintf (stderr, "Can't rewrite directory %u.\n", dirn);
+	return ret;
+}
+
+static int
+check_pages(const uint16* pages, uint16 n)
+{
+	TIFF* tif;
+	uint16 i, page, total;
+	int ret = 0;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		if ((i > 0 && !TIFFReadDirectory(tif)) ||
+		    !TIFFGetField(tif, TIFFTAG_PAGENUMBER, &page, &total) ||
+		    page != pages[i]) {
+			fprintf (stderr, "Directory %u is not page %u.\n",
+				 i, pages[i]);
+			goto failure;
+		}
+	}
+	if (TIFFReadDirectory(tif)) {
+		fprintf (stderr, "Too many directories.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+static int
+check_mode(const char* mode, const char* appendmode)
+{
+	uint16 pages[NPAGES + NAPPENDED + 1];
+	uint16 i;
+
+	if (!write_pages(mode, 0, NPAGES) ||
+	    !write_pages(appendmode, NPAGES, NAPPENDED))
+		return 0;
+	for (i = 0; i <= NPAGES + NAPPENDED; i++)
+		pages[i] = i;
+	return rewrite_page(NPAGES + NAPPENDED - 1, NPAGES + NAPPENDED) &&
+	    check_pages(pages, NPAGES + NAPPENDED + 1);
+}
+
+int
+main()
+{
+	if (!check_mode("w", "a") || !check_mode("w8", "a"))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that handles opened with a block cache read the same data
+ * with fewer calls to the read method.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiffio.h"
+
+#define	WIDTH		64
+#define	LENGTH		64
+#define	TILESIZE	16
+
+typedef struct {
+	const unsigned char* data;
+	uint64 size;
+	uint64 pos;
+	int reads;
+} client_t;
+
+static tmsize_t
+client_read(thandle_t fd, void* buf, tmsize_t size)
+{
+	client_t* c = (client_t*) fd;
+	tmsize_t n = 0;
+
+	c->reads++;
+	if (c->pos < c->size) {
+		n = c->size - c->pos < (uint64) size ?
+		    (tmsize_t)(c->size - c->pos) : size;
+		memcpy(buf, c->data + c->pos, n);
+		c->pos += n;
+	}
+	return n;
+}
+
+static tmsize_t
+client_write(thandle_t fd, void* buf, tmsize_t size)
+{
+	(void) fd; (void) buf; (void) size;
+	return -1;
+}
+
+static uint64
+client_seek(thandle_t fd, uint64 off, int whence)
+{
+	client_t* c = (client_t*) fd;
+
+	if (whence == SEEK_CUR)
+		off += c->pos;
+	else if (whence == SEEK_END)
+		off += c->size;
+	c->pos = off;
+	return off;
+}
+
+static int
+client_close(thandle_t fd)
+{
+	(void) fd;
+	return 0;
+}
+
+static uint64
+client_size(thandle_t fd)
+{
+	return ((client_t*) fd)->size;
+}
+
+static void
+fill_tile(unsigned char* buf, tmsize_t size, uint32 tile)
+{
+	tmsize_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)((i / 5 + tile * 29) & 0xff);
+}
+
+static int
+write_file(void** buf, tmsize_t* size)
+{
+	unsigned char tile[TILESIZE * TILESIZE];
+	TIFF* tif;
+	uint32 t, n;
+
+	tif = TIFFOpenMemory(NULL, 0, "w");
+	if (!tif)
+		return 0;
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, "block cache test");
+	n = TIFFNumberOfTiles(tif);
+	for (t = 0; t < n; t++) {
+		fill_tile(tile, sizeof(tile), t);
+		if (TIFFWriteEncodedTile(tif, t, tile, sizeof(tile)) == -1) {
+			fprintf (stderr, "Can't write tile %lu.\n",
+				 (unsigned long) t);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	if (!TIFFWriteDirectory(tif))
+		return 0;
+	return TIFFCloseMemory(tif, buf, size);
+}
+
+/*
+ * Read all tiles, backwards, through a handle with the given cache
+ * geometry and return the number of calls to the read method, or -1.
+ */
+static int
+read_file(const void* buf, tmsize_t size, tmsize_t blocksize,
+	  uint32 nblocks, tmsize_t header)
+{
+	unsigned char tile[TILESIZE * TILESIZE], ref[TILESIZE * TILESIZE];
+	TIFFOpenOptions* opts;
+	client_t c;
+	TIFF* tif;
+	uint32 t, n;
+	char* desc;
+	int ret = -1;
+
+	c.data = (const unsigned char*) buf;
+	c.size = (uint64) size;
+	c.pos = 0;
+	c.reads = 0;
+	opts = TIFFOpenOptionsAlloc();
+	if (!opts)
+		return -1;
+	TIFFOpenOptionsSetBlockCache(opts, blocksize, nblocks);
+	TIFFOpenOptionsSetHeaderPrefetch(opts, header);
+	tif = TIFFClientOpenExt("block_cache", "r", (thandle_t) &c,
+	    client_read, client_write, client_seek, client_close,
+	    client_size, NULL, NULL, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open the file with %ld blocks of "
+			 "%ld bytes.\n", (long) nblocks, (long) blocksize);
+		return -1;
+	}
+	if (!TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &desc) ||
+	    strcmp(desc, "block cache test") != 0) {
+		fprintf (stderr, "Wrong image description.\n");
+		goto failure;
+	}
+	n = TIFFNumberOfTiles(tif);
+	for (t = n; t-- > 0; ) {
+		fill_tile(ref, sizeof(ref), t);
+		if (TIFFReadEncodedTile(tif, t, tile, sizeof(tile)) !=
+		    (tmsize_t) sizeof(tile) ||
+		    memcmp(tile, ref, sizeof(tile)) != 0) {
+			fprintf (stderr, "Tile %lu differs with %ld blocks of "
+				 "%ld bytes.\n", (unsigned long) t,
+				 (long) nblocks, (long) blocksize);
+			goto failure;
+		}
+	}
+	ret = c.reads;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	void* buf;
+	tmsize_t size;
+	int plain, cached;
+
+	if (!write_file(&buf, &size)) {
+		fprintf (stderr, "Can't write the test file.\n");
+		return 1;
+	}
+	plain = read_file(buf, size, 0, 0, 0);
+	if (plain < 0)
+		return 1;
+
+	/* blocks smaller than the tiles, which are read past the cache */
+	if (read_file(buf, size, 100, 3, 0) < 0)
+		return 1;
+	/* tiles read from a cache too small for the file */
+	if (read_file(buf, size, 1024, 2, 0) < 0)
+		return 1;
+	if (read_file(buf, size, 0, 1, 0) < 0)
+		return 1;
+
+	/* the whole file arrives with the header */
+	cached = read_file(buf, size, 4096, 8, 65536);
+	if (cached != 1) {
+		fprintf (stderr, "%d reads with a header prefetch, %d "
+			 "without cache.\n", cached, plain);
+		return 1;
+	}
+	_TIFFfree(buf);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
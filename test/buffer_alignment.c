@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that handles opened with TIFFOpenOptionsSetBufferAlignment()
+ * return aligned blocks, also on top of an allocator that only gives
+ * 8-byte alignment, and that reallocated blocks keep their contents.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "tiffiop.h"
+#include "test_image.h"
+
+static const char filename[] = "buffer_alignment.tif";
+
+#define	WIDTH		256
+#define	LENGTH		192
+#define	TILESIZE	64
+
+static long live;
+
+/* Hand out pointers that are 8 but never 16-byte aligned */
+static void*
+odd_malloc(void* ctx, tmsize_t size)
+{
+	char* p = (char*) malloc(size + 16);
+
+	(void) ctx;
+	if (!p)
+		return NULL;
+	live++;
+	return p + 8;
+}
+
+static void*
+odd_realloc(void* ctx, void* p, tmsize_t size)
+{
+	char* q;
+
+	if (p == NULL)
+		return odd_malloc(ctx, size);
+	q = (char*) realloc((char*) p - 8, size + 16);
+	return q ? q + 8 : NULL;
+}
+
+static void
+odd_free(void* ctx, void* p)
+{
+	(void) ctx;
+	if (p) {
+		live--;
+		free((char*) p - 8);
+	}
+}
+
+static int
+is_aligned(const void* p, tmsize_t alignment)
+{
+	return ((size_t) p & (size_t) (alignment - 1)) == 0;
+}
+
+static unsigned char
+pixel(uint32 x, uint32 y)
+{
+	return (unsigned char) ((x * 5 + y * 11 + (x ^ y)) & 0xff);
+}
+
+static void
+fill_tile(TestChunk* c, void* arg)
+{
+	uint32 i, j;
+
+	(void) arg;
+	for (j = 0; j < c->length; j++)
+		for (i = 0; i < c->width; i++)
+			c->buf[j * c->width + i] = pixel(c->x + i, c->y + j);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, 0, TILESIZE, TILESIZE };
+
+	return write_test_image(filename, &im, fill_tile, NULL);
+}
+
+/*
+ * Read every tile into a buffer allocated by the library and check the
+ * alignment of that buffer and of the raw data buffer.
+ */
+static int
+check_read(tmsize_t alignment)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFF* tif;
+	uint32 x, y, i, j;
+	int ret = 0;
+
+	if (!opts)
+		return 0;
+	TIFFOpenOptionsSetAllocator(opts, odd_malloc, odd_realloc, odd_free,
+				    NULL);
+	TIFFOpenOptionsSetBufferAlignment(opts, alignment);
+	/* Not mapped, so that the raw data is read into a buffer */
+	tif = TIFFOpenExt(filename, "rm", opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	for (y = 0; y < LENGTH; y += TILESIZE)
+		for (x = 0; x < WIDTH; x += TILESIZE) {
+			void* buf = NULL;
+			unsigned char* p;
+
+			if (_TIFFReadTileAndAllocBuffer(tif, &buf,
+			    TIFFTileSize(tif), x, y, 0, 0) !=
+			    TIFFTileSize(tif)) {
+				fprintf (stderr, "Can't read tile at %lu,%lu.\n",
+					 (unsigned long) x, (unsigned long) y);
+				_TIFFfreeExt(tif, buf);
+				goto failure;
+			}
+			if (!is_aligned(buf, alignment) ||
+			    !is_aligned(tif->tif_rawdata, alignment)) {
+				fprintf (stderr, "Buffers not aligned on %ld "
+					 "bytes.\n", (long) alignment);
+				_TIFFfreeExt(tif, buf);
+				goto failure;
+			}
+			p = (unsigned char*) buf;
+			for (j = 0; j < TILESIZE; j++)
+				for (i = 0; i < TILESIZE; i++)
+					if (p[j * TILESIZE + i] !=
+					    pixel(x + i, y + j)) {
+						fprintf (stderr, "Tile at "
+							 "%lu,%lu differs.\n",
+							 (unsigned long) x,
+							 (unsigned long) y);
+						_TIFFfreeExt(tif, buf);
+						goto failure;
+					}
+			_TIFFfreeExt(tif, buf);
+		}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+/*
+ * Grow and shrink a block, which the allocator is free to move, and
+ * check that it stays aligned and keeps its contents.
+ */
+static int
+check_realloc(tmsize_t alignment)
+{
+	static const tmsize_t sizes[] = { 10, 1000, 100000, 37, 65536, 1 };
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFF* tif;
+	unsigned char* p;
+	tmsize_t cur, n, i;
+	size_t k;
+	int ret = 0;
+
+	if (!opts)
+		return 0;
+	TIFFOpenOptionsSetAllocator(opts, odd_malloc, odd_realloc, odd_free,
+				    NULL);
+	TIFFOpenOptionsSetBufferAlignment(opts, alignment);
+	tif = TIFFOpenExt(filename, "r", opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	cur = sizes[0];
+	p = (unsigned char*) _TIFFmallocExt(tif, cur);
+	if (!p)
+		goto failure;
+	for (i = 0; i < cur; i++)
+		p[i] = (unsigned char) (i * 7);
+	for (k = 1; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+		unsigned char* q = (unsigned char*) _TIFFreallocExt(tif, p,
+		    sizes[k]);
+
+		if (!q) {
+			fprintf (stderr, "Can't reallocate to %ld bytes.\n",
+				 (long) sizes[k]);
+			goto failure;
+		}
+		p = q;
+		n = cur < sizes[k] ? cur : sizes[k];
+		if (!is_aligned(p, alignment)) {
+			fprintf (stderr, "Block of %ld bytes not aligned on "
+				 "%ld bytes.\n", (long) sizes[k],
+				 (long) alignment);
+			goto failure;
+		}
+		for (i = 0; i < n; i++)
+			if (p[i] != (unsigned char) (i * 7)) {
+				fprintf (stderr, "Block contents lost when "
+					 "reallocating to %ld bytes.\n",
+					 (long) sizes[k]);
+				goto failure;
+			}
+		for (i = n; i < sizes[k]; i++)
+			p[i] = (unsigned char) (i * 7);
+		cur = sizes[k];
+	}
+	ret = 1;
+
+failure:
+	_TIFFfreeExt(tif, p);
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	static const tmsize_t alignments[] = { 16, 64, 4096 };
+	size_t a;
+
+	if (!write_image())
+		return 1;
+	for (a = 0; a < sizeof(alignments) / sizeof(alignments[0]); a++)
+		if (!check_read(alignments[a]) ||
+		    !check_realloc(alignments[a])) {
+			fprintf (stderr, "Failed for %ld byte alignment.\n",
+				 (long) alignments[a]);
+			return 1;
+		}
+	if (live != 0) {
+		fprintf (stderr, "%ld blocks leaked.\n", live);
+		return 1;
+	}
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
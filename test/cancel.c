@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFCancel() and TIFFSetDeadline() stop reading and
+ * writing with an error, also in the middle of a large Deflate strip,
+ * in TIFFReadRGBAImage() and in the parallel routines, and that
+ * TIFFResetCancel() lets the handle be used again.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "cancel.tif";
+
+#define	WIDTH		2048
+#define	LENGTH		2048
+#define	ROWSPERSTRIP	1024	/* 2 MiB strips */
+
+static char last[256];
+static int errors;
+
+static int
+count_error(TIFF* tif, void* user_data, const char* module, const char* fmt,
+    va_list ap)
+{
+	(void) tif;
+	(void) user_data;
+	(void) module;
+	errors++;
+	vsnprintf(last, sizeof(last), fmt, ap);
+	return (1);
+}
+
+/* Cancel from the trace callback once the first decode has begun */
+static void
+cancel_on_decode(TIFF* tif, void* clientdata, int stage, int phase,
+    uint32 strile, uint64 bytes)
+{
+	(void) clientdata;
+	(void) strile;
+	(void) bytes;
+	if (stage == TIFF_TRACE_DECODE && phase == TIFF_TRACE_BEGIN)
+		TIFFCancel(tif);
+}
+
+static TIFF*
+open_file(const char* mode)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFF* tif;
+
+	if (!opts)
+		return NULL;
+	TIFFOpenOptionsSetErrorHandlerExtR(opts, count_error, NULL);
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif)
+		fprintf (stderr, "Can't open %s.\n", filename);
+	return tif;
+}
+
+static int
+expect_cancel(TIFF* tif, int ok, int state, const char* what)
+{
+	if (ok || TIFFGetCancelState(tif) != state ||
+	    strcmp(last, state == TIFF_CANCEL_DEADLINE ?
+		   "Deadline exceeded" : "Operation cancelled") != 0) {
+		fprintf (stderr, "%s was not cancelled (state %d, \"%s\").\n",
+			 what, TIFFGetCancelState(tif), last);
+		return 0;
+	}
+	last[0] = '\0';
+	TIFFResetCancel(tif);
+	return 1;
+}
+
+static int
+write_image(unsigned char* buf)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_ADOBE_DEFLATE, ROWSPERSTRIP,
+	    0, 0 };
+	TIFF* tif = open_file("w");
+	tmsize_t size = (tmsize_t) WIDTH * ROWSPERSTRIP;
+	int ok;
+
+	if (!tif)
+		return 0;
+	set_image_fields(tif, &im);
+
+	/* A cancelled handle writes nothing */
+	TIFFCancel(tif);
+	ok = TIFFWriteEncodedStrip(tif, 0, buf, size) != -1;
+	if (!expect_cancel(tif, ok, TIFF_CANCEL_REQUESTED,
+			   "TIFFWriteEncodedStrip()")) {
+		TIFFClose(tif);
+		return 0;
+	}
+	ok = TIFFWriteEncodedStrip(tif, 0, buf, size) == size &&
+	    TIFFWriteEncodedStrip(tif, 1, buf + size, size) == size;
+	TIFFClose(tif);
+	if (!ok)
+		fprintf (stderr, "Can't write %s.\n", filename);
+	return ok;
+}
+
+static int
+check_read(const unsigned char* image)
+{
+	TIFF* tif = open_file("r");
+	tmsize_t size = (tmsize_t) WIDTH * ROWSPERSTRIP;
+	unsigned char* buf = (unsigned char*) malloc(2 * size);
+	uint32* raster = (uint32*) malloc((tmsize_t) WIDTH * LENGTH * 4);
+	void* bufs[2];
+	uint32 strips[2] = { 0, 1 };
+	int ok, ret = 0;
+
+	if (!tif || !buf || !raster)
+		goto failure;
+
+	/* Cancelled before, and while, decoding a strip */
+	TIFFCancel(tif);
+	ok = TIFFReadEncodedStrip(tif, 0, buf, size) != -1;
+	if (!expect_cancel(tif, ok, TIFF_CANCEL_REQUESTED,
+			   "TIFFReadEncodedStrip()"))
+		goto failure;
+	TIFFSetTraceCallback(tif, cancel_on_decode, NULL);
+	ok = TIFFReadEncodedStrip(tif, 1, buf, size) != -1;
+	TIFFSetTraceCallback(tif, NULL, NULL);
+	if (!expect_cancel(tif, ok, TIFF_CANCEL_REQUESTED,
+			   "Decoding of a strip"))
+		goto failure;
+
+	/* A deadline that has passed */
+	TIFFSetDeadline(tif, 1e-9);
+	ok = TIFFReadScanline(tif, buf, 0, 0) != -1;
+	if (!expect_cancel(tif, ok, TIFF_CANCEL_DEADLINE,
+			   "TIFFReadScanline()"))
+		goto failure;
+
+	TIFFCancel(tif);
+	ok = TIFFReadRGBAImage(tif, WIDTH, LENGTH, raster, 0);
+	if (!expect_cancel(tif, ok, TIFF_CANCEL_REQUESTED,
+			   "TIFFReadRGBAImage()"))
+		goto failure;
+
+	TIFFCancel(tif);
+	bufs[0] = buf;
+	bufs[1] = buf + size;
+	ok = TIFFReadEncodedStripsParallel(tif, strips, 2, bufs, size, 2);
+	if (!expect_cancel(tif, ok, TIFF_CANCEL_REQUESTED,
+			   "TIFFReadEncodedStripsParallel()"))
+		goto failure;
+
+	/* A deadline far away changes nothing, nor does a reset one */
+	TIFFSetDeadline(tif, 3600);
+	if (TIFFReadEncodedStripsParallel(tif, strips, 2, bufs, size, 2) != 1 ||
+	    memcmp(buf, image, 2 * size) != 0) {
+		fprintf (stderr, "Reading after a reset failed.\n");
+		goto failure;
+	}
+	TIFFSetDeadline(tif, 1e-9);
+	TIFFSetDeadline(tif, 0);
+	if (TIFFReadEncodedStrip(tif, 1, buf, size) != size ||
+	    memcmp(buf, image + size, size) != 0 ||
+	    TIFFGetCancelState(tif) != TIFF_CANCEL_NONE) {
+		fprintf (stderr, "Reading without a deadline failed.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	if (tif)
+		TIFFClose(tif);
+	free(buf);
+	free(raster);
+	return ret;
+}
+
+int
+main()
+{
+	tmsize_t size = (tmsize_t) WIDTH * LENGTH, i;
+	unsigned char* image = (unsigned char*) malloc(size);
+	unsigned char* copy = (unsigned char*) malloc(size);
+	uint32 seed = 1;
+	int ret = 1;
+
+	if (!image || !copy) {
+		fprintf (stderr, "Out of memory.\n");
+		goto failure;
+	}
+	for (i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		image[i] = (unsigned char) ((i % WIDTH) + (seed >> 29));
+	}
+	/* writing may swab or predict the buffer in place */
+	memcpy(copy, image, size);
+	if (!write_image(copy) || !check_read(image))
+		goto failure;
+	unlink(filename);
+	ret = 0;
+
+failure:
+	free(image);
+	free(copy);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFChooseCompression() sets a configured codec with a
+ * predictor for smooth 16-bit data, leaves the sample tiles as they were,
+ * and is refused once image data is written; and that the image written
+ * with the choice reads back.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "choose_compression.tif";
+
+#define	WIDTH		128
+#define	LENGTH		96
+#define	TILESIZE	32
+#define	NTILES		((WIDTH / TILESIZE) * (LENGTH / TILESIZE))
+#define	TILEBYTES	(TILESIZE * TILESIZE * 2)
+
+static void
+make_tile(uint16* buf, uint32 t)
+{
+	uint32 x0 = (t % (WIDTH / TILESIZE)) * TILESIZE;
+	uint32 y0 = (t / (WIDTH / TILESIZE)) * TILESIZE;
+	uint32 x, y;
+
+	for (y = 0; y < TILESIZE; y++)
+		for (x = 0; x < TILESIZE; x++)
+			buf[y * TILESIZE + x] =
+			    (uint16)((x0 + x) * 37 + (y0 + y) * 101);
+}
+
+static int
+is_candidate(uint16 compression)
+{
+	return compression == COMPRESSION_ADOBE_DEFLATE ||
+	    compression == COMPRESSION_ZSTD ||
+	    compression == COMPRESSION_LZMA ||
+	    compression == COMPRESSION_LZ4;
+}
+
+static int
+test_choose(double bytespersecond)
+{
+	uint16 tiles[NTILES][TILESIZE * TILESIZE], check[TILESIZE * TILESIZE];
+	void* bufs[2];
+	tmsize_t sizes[2];
+	uint32 chunks[2] = { 0, 1 };
+	uint16 compression, predictor;
+	uint32 t;
+	TIFF* tif;
+
+	for (t = 0; t < NTILES; t++)
+		make_tile(tiles[t], t);
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	for (t = 0; t < 2; t++) {
+		bufs[t] = tiles[t];
+		sizes[t] = TILEBYTES;
+	}
+	if (!TIFFChooseCompression(tif, chunks, 2, bufs, sizes,
+				   bytespersecond)) {
+		fprintf (stderr, "No compression chosen.\n");
+		goto failure;
+	}
+	TIFFGetField(tif, TIFFTAG_COMPRESSION, &compression);
+	if (!TIFFGetField(tif, TIFFTAG_PREDICTOR, &predictor))
+		predictor = PREDICTOR_NONE;
+	if (!is_candidate(compression) ||
+	    (bytespersecond == 0 && predictor == PREDICTOR_NONE)) {
+		fprintf (stderr, "Chose compression %u predictor %u.\n",
+			 compression, predictor);
+		goto failure;
+	}
+	for (t = 0; t < 2; t++) {
+		make_tile(check, t);
+		if (memcmp(check, tiles[t], TILEBYTES)) {
+			fprintf (stderr, "Sample tile %lu changed.\n",
+				 (unsigned long) t);
+			goto failure;
+		}
+	}
+	for (t = 0; t < NTILES; t++)
+		if (TIFFWriteEncodedTile(tif, t, tiles[t], TILEBYTES) < 0) {
+			fprintf (stderr, "Can't write tile %lu.\n",
+				 (unsigned long) t);
+			goto failure;
+		}
+	if (TIFFChooseCompression(tif, chunks, 2, bufs, sizes, 0)) {
+		fprintf (stderr, "Compression changed after writing.\n");
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	for (t = 0; t < NTILES; t++) {
+		make_tile(check, t);
+		if (TIFFReadEncodedTile(tif, t, tiles[0], TILEBYTES) !=
+		    TILEBYTES || memcmp(check, tiles[0], TILEBYTES)) {
+			fprintf (stderr, "Tile %lu read back wrong.\n",
+				 (unsigned long) t);
+			goto failure;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+int
+main(void)
+{
+	if (!TIFFIsCODECConfigured(COMPRESSION_ADOBE_DEFLATE))
+		return 0;
+	if (!test_choose(0) || !test_choose(1e12)) {
+		unlink(filename);
+		return 1;
+	}
+	unlink(filename);
+	return 0;
+}
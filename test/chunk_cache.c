@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that a cache attached with TIFFSetChunkCache() returns the
+ * decoded data of strips and tiles read again, stays within its
+ * budget, and is shared with clones but not between files.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "chunk_cache.tif";
+
+#define	WIDTH		100
+#define	LENGTH		70
+#define	TILESIZE	32
+#define	ROWSPERSTRIP	16
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	tmsize_t i;
+
+	(void) arg;
+	for (i = 0; i < c->size; i++)
+		c->buf[i] = (unsigned char)((i / 5 + c->index * 41 + (i % 3) * 80) & 0xff);
+}
+
+static int
+write_directory(TIFF* tif, int tiled)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 3, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_RGB, COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+
+	if (tiled)
+		im.tilewidth = im.tilelength = TILESIZE;
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	return write_image_data(tif, fill_chunk, NULL) && TIFFWriteDirectory(tif);
+}
+
+static int
+write_image(void)
+{
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	ok = write_directory(tif, 1) && write_directory(tif, 0);
+	if (ok && TIFFSetChunkCache(tif, NULL) == 1) {
+		TIFFChunkCache* cc = TIFFChunkCacheCreate(1024);
+
+		/* only read-only handles take a cache */
+		ok = cc != NULL && !TIFFSetChunkCache(tif, cc);
+		TIFFChunkCacheFree(cc);
+	}
+	TIFFClose(tif);
+	if (!ok)
+		fprintf (stderr, "Can't write %s.\n", filename);
+	return ok;
+}
+
+/*
+ * Read chunk n of the current directory with and without the cache,
+ * and compare.
+ */
+static int
+compare_chunk(TIFF* tif, TIFF* ref, uint32 n, tmsize_t size)
+{
+	unsigned char* a = (unsigned char*) malloc(size);
+	unsigned char* b = (unsigned char*) malloc(size);
+	tmsize_t got, want;
+	int ret = 0;
+
+	if (!a || !b)
+		goto failure;
+	memset(a, 0, size);
+	if (TIFFIsTiled(ref)) {
+		want = TIFFReadEncodedTile(ref, n, b, size);
+		got = TIFFReadEncodedTile(tif, n, a, size);
+	} else {
+		want = TIFFReadEncodedStrip(ref, n, b, size);
+		got = TIFFReadEncodedStrip(tif, n, a, size);
+	}
+	if (want == -1 || got != want || memcmp(a, b, got) != 0) {
+		fprintf (stderr, "Chunk %lu differs.\n", (unsigned long) n);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	free(a);
+	free(b);
+	return ret;
+}
+
+static int
+check_stats(TIFFChunkCache* cc, uint64 hits, uint64 misses, const char* what)
+{
+	uint64 h, m;
+
+	TIFFChunkCacheGetStats(cc, &h, &m, NULL);
+	if (h != hits || m != misses) {
+		fprintf (stderr, "%s: %lu hits and %lu misses, expected %lu and %lu.\n",
+			 what, (unsigned long) h, (unsigned long) m,
+			 (unsigned long) hits, (unsigned long) misses);
+		return 0;
+	}
+	return 1;
+}
+
+int
+main()
+{
+	TIFF* tif = NULL;
+	TIFF* ref = NULL;
+	TIFF* other = NULL;
+	TIFF* clone = NULL;
+	TIFFChunkCache* cc = NULL;
+	unsigned char* region = NULL;
+	unsigned char* expect = NULL;
+	tmsize_t tilesize, stripsize, bytes;
+	int ret = 1;
+
+	if (!write_image())
+		return 1;
+	tif = TIFFOpen(filename, "r");
+	ref = TIFFOpen(filename, "r");
+	other = TIFFOpen(filename, "r");
+	if (!tif || !ref || !other) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	tilesize = TIFFTileSize(tif);
+	/* room for two tiles */
+	cc = TIFFChunkCacheCreate(2 * tilesize + tilesize / 2);
+	if (!cc || !TIFFSetChunkCache(tif, cc) || !TIFFSetChunkCache(other, cc))
+		goto failure;
+
+	/* read again: the second read is a hit, a partial read too */
+	if (!compare_chunk(tif, ref, 0, tilesize) ||
+	    !compare_chunk(tif, ref, 0, tilesize) ||
+	    !compare_chunk(tif, ref, 0, tilesize / 4) ||
+	    !check_stats(cc, 2, 1, "Tile reread"))
+		goto failure;
+	/* another file does not see the entries */
+	if (!compare_chunk(other, ref, 0, tilesize) ||
+	    !check_stats(cc, 2, 2, "Other handle"))
+		goto failure;
+	/* the budget holds two tiles: tile 0 of tif was dropped */
+	if (!compare_chunk(tif, ref, 1, tilesize) ||
+	    !compare_chunk(tif, ref, 0, tilesize) ||
+	    !check_stats(cc, 2, 4, "Eviction"))
+		goto failure;
+	TIFFChunkCacheGetStats(cc, NULL, NULL, &bytes);
+	if (bytes > 2 * tilesize) {
+		fprintf (stderr, "Cache holds %ld bytes.\n", (long) bytes);
+		goto failure;
+	}
+
+	/* a clone uses the entries of its template */
+	clone = TIFFCloneForThread(tif);
+	if (!clone || !compare_chunk(clone, ref, 0, tilesize) ||
+	    !check_stats(cc, 3, 4, "Clone"))
+		goto failure;
+	TIFFClose(clone);
+	clone = NULL;
+
+	/* region reads go through the cache, here all in tile 2 */
+	region = (unsigned char*) malloc(20 * 20 * 3);
+	expect = (unsigned char*) malloc(20 * 20 * 3);
+	if (!region || !expect ||
+	    !TIFFReadRegion(ref, 66, 5, 20, 20, 0, expect, 20 * 3) ||
+	    !TIFFReadRegion(tif, 66, 5, 20, 20, 0, region, 20 * 3) ||
+	    !TIFFReadRegion(tif, 66, 5, 20, 20, 0, region, 20 * 3) ||
+	    memcmp(region, expect, 20 * 20 * 3) != 0 ||
+	    !check_stats(cc, 4, 5, "Region"))
+		goto failure;
+
+	/* strips of another directory are cached apart */
+	if (!TIFFSetDirectory(tif, 1) || !TIFFSetDirectory(ref, 1))
+		goto failure;
+	stripsize = TIFFStripSize(tif);
+	if (!compare_chunk(tif, ref, 4, stripsize) ||
+	    !compare_chunk(tif, ref, 4, stripsize) ||
+	    !check_stats(cc, 5, 6, "Strip reread"))
+		goto failure;
+
+	/* closing the handles drops their entries */
+	TIFFClose(other);
+	other = NULL;
+	TIFFClose(tif);
+	tif = NULL;
+	TIFFChunkCacheGetStats(cc, NULL, NULL, &bytes);
+	if (bytes != 0) {
+		fprintf (stderr, "%ld bytes left in the cache.\n", (long) bytes);
+		goto failure;
+	}
+	ret = 0;
+
+failure:
+	free(region);
+	free(expect);
+	if (clone)
+		TIFFClose(clone);
+	if (other)
+		TIFFClose(other);
+	if (tif)
+		TIFFClose(tif);
+	if (ref)
+		TIFFClose(ref);
+	TIFFChunkCacheFree(cc);
+	if (ret == 0)
+		unlink(filename);
+	return ret;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
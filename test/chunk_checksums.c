@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check the CRC-32C of strips and tiles recorded by handles opened with
+ * TIFFOpenOptionsSetChunkChecksums(): the value of a known string, the
+ * same values with and without the crc32 instructions, strips flushed in
+ * several pieces, and TIFFVerifyChunks() on intact and damaged files,
+ * memory-mapped or not.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "chunk_checksums.tif";
+
+#define	NSTRIPS		40
+
+static TIFF*
+create(uint32 width, uint32 length, uint32 rowsperstrip, uint16 compression)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TestImage im = { 0, 0, 8, 1, 0, PHOTOMETRIC_MINISBLACK, 0, 0, 0, 0 };
+	TIFF* tif;
+
+	TIFFOpenOptionsSetChunkChecksums(opts, 1);
+	tif = TIFFOpenExt(filename, "w", opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return NULL;
+	}
+	im.width = width;
+	im.length = length;
+	im.compression = compression;
+	im.rowsperstrip = rowsperstrip;
+	set_image_fields(tif, &im);
+	return tif;
+}
+
+/*
+ * Write raw strips of 0 to NSTRIPS-1 bytes and return their checksums.
+ */
+static int
+raw_checksums(uint32* crcs)
+{
+	unsigned char data[NSTRIPS];
+	uint32 count, i;
+	uint32* values;
+	TIFF* tif = create(NSTRIPS, NSTRIPS, 1, COMPRESSION_NONE);
+
+	if (!tif)
+		return 0;
+	for (i = 0; i < NSTRIPS; i++)
+		data[i] = (unsigned char)(i * 37 + 11);
+	/* strip 0 is left without data */
+	for (i = 1; i < NSTRIPS; i++)
+		if (TIFFWriteRawStrip(tif, i, data, i) != (tmsize_t) i) {
+			fprintf (stderr, "Can't write strip %lu.\n",
+				 (unsigned long) i);
+			TIFFClose(tif);
+			return 0;
+		}
+	if (!TIFFWriteDirectory(tif) || !TIFFSetDirectory(tif, 0) ||
+	    !TIFFGetField(tif, TIFFTAG_CHUNKCRC32C, &count, &values) ||
+	    count != NSTRIPS) {
+		fprintf (stderr, "No ChunkCRC32C tag written.\n");
+		TIFFClose(tif);
+		return 0;
+	}
+	memcpy(crcs, values, NSTRIPS * sizeof(uint32));
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+test_values(void)
+{
+	uint32 hw[NSTRIPS], sw[NSTRIPS];
+	TIFF* tif = create(9, 1, 1, COMPRESSION_NONE);
+	uint32 count;
+	uint32* values;
+	int ok;
+
+	if (!tif)
+		return 0;
+	/* the check value of CRC-32C */
+	ok = TIFFWriteRawStrip(tif, 0, "123456789", 9) == 9;
+	TIFFClose(tif);
+	tif = TIFFOpen(filename, "r");
+	if (!ok || !tif ||
+	    !TIFFGetField(tif, TIFFTAG_CHUNKCRC32C, &count, &values) ||
+	    count != 1 || values[0] != 0xE3069283) {
+		fprintf (stderr, "Wrong CRC-32C of \"123456789\".\n");
+		if (tif)
+			TIFFClose(tif);
+		return 0;
+	}
+	TIFFClose(tif);
+
+	if (!raw_checksums(hw))
+		return 0;
+	TIFFSetCPUFeatures(0);
+	ok = raw_checksums(sw);
+	TIFFSetCPUFeatures(TIFF_CPU_ALL);
+	if (!ok)
+		return 0;
+	if (memcmp(hw, sw, sizeof(hw)) != 0) {
+		fprintf (stderr, "Checksums differ without crc32 instructions.\n");
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Write an LZW image by scanline with a small raw buffer, so that strips
+ * go to the file in several pieces.
+ */
+static int
+write_image(void)
+{
+	unsigned char row[500];
+	uint32 x, y;
+	TIFF* tif = create(sizeof(row), 200, 50, COMPRESSION_LZW);
+
+	if (!tif)
+		return 0;
+	TIFFWriteBufferSetup(tif, NULL, 1024);
+	for (y = 0; y < 200; y++) {
+		for (x = 0; x < sizeof(row); x++)
+			row[x] = (unsigned char)((x * y + (x ^ y) * 13) & 0xff);
+		if (TIFFWriteScanline(tif, row, y, 0) != 1) {
+			fprintf (stderr, "Can't write row %lu.\n",
+				 (unsigned long) y);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+verify(const char* mode, int64 expected, uint32 badstrip)
+{
+	uint32 bad[4];
+	int64 n;
+	TIFF* tif = TIFFOpen(filename, mode);
+
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	n = TIFFVerifyChunks(tif, bad, 4);
+	TIFFClose(tif);
+	if (n != expected || (n == 1 && bad[0] != badstrip)) {
+		fprintf (stderr, "TIFFVerifyChunks(\"%s\") returned %ld, "
+			 "expected %ld.\n", mode, (long) n, (long) expected);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Flip a byte in the middle of strip 2.
+ */
+static int
+damage(uint32* strip)
+{
+	uint64* offsets;
+	uint64* counts;
+	uint64 off;
+	FILE* fp;
+	int c;
+	TIFF* tif = TIFFOpen(filename, "r");
+
+	if (!tif)
+		return 0;
+	TIFFGetField(tif, TIFFTAG_STRIPOFFSETS, &offsets);
+	TIFFGetField(tif, TIFFTAG_STRIPBYTECOUNTS, &counts);
+	off = offsets[2] + counts[2] / 2;
+	TIFFClose(tif);
+	*strip = 2;
+	fp = fopen(filename, "r+b");
+	if (!fp)
+		return 0;
+	fseek(fp, (long) off, SEEK_SET);
+	c = fgetc(fp);
+	fseek(fp, (long) off, SEEK_SET);
+	fputc(c ^ 0x40, fp);
+	fclose(fp);
+	return 1;
+}
+
+int
+main(void)
+{
+	uint32 strip = 0;
+	TIFF* tif;
+
+	if (!test_values())
+		goto failure;
+	if (!write_image() || !verify("r", 0, 0) || !verify("rm", 0, 0))
+		goto failure;
+	if (!damage(&strip) || !verify("r", 1, strip) ||
+	    !verify("rm", 1, strip))
+		goto failure;
+
+	/* no checksums */
+	tif = TIFFOpen(filename, "w");
+	if (!tif)
+		goto failure;
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, 1);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, 1);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFWriteRawStrip(tif, 0, "x", 1);
+	TIFFClose(tif);
+	if (!verify("r", -1, 0))
+		goto failure;
+
+	unlink(filename);
+	return 0;
+
+failure:
+	unlink(filename);
+	return 1;
+}
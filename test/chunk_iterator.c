@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that the chunk iterator returns every strip or tile once, with
+ * the data TIFFReadEncodedStrip()/TIFFReadEncodedTile() return and the
+ * right place in the image, in both orders and with several threads
+ * pulling from it.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#if defined(THREADS_SUPPORT) && defined(HAVE_PTHREAD)
+# include <pthread.h>
+# define HAVE_PULLER_THREADS
+#endif
+
+#include "tiffio.h"
+#include "tiffiop.h"
+#include "test_image.h"
+
+static const char tiledfile[] = "chunk_iterator_tiled.tif";
+static const char stripfile[] = "chunk_iterator_strip.tif";
+static const char planefile[] = "chunk_iterator_planes.tif";
+
+#define	WIDTH		100
+#define	LENGTH		70
+#define	TILESIZE	32
+#define	ROWSPERSTRIP	16
+#define	NTHREADS	4
+
+static void
+fill_chunk(unsigned char* buf, tmsize_t size, uint32 chunk)
+{
+	tmsize_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)((i / 5 + chunk * 29 + (i % 3) * 37) & 0xff);
+}
+
+/*
+ * Write the chunks in reverse order, so that file order and chunk
+ * order differ.
+ */
+static int
+write_image(const char* filename, int tiled, uint16 planar)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 3, 0, PHOTOMETRIC_RGB,
+	    COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif;
+	unsigned char* buf;
+	tmsize_t size;
+	uint32 n, i;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.planarconfig = planar;
+	if (tiled)
+		im.tilewidth = im.tilelength = TILESIZE;
+	set_image_fields(tif, &im);
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	buf = (unsigned char*) malloc(size);
+	if (!buf) {
+		fprintf (stderr, "Out of memory.\n");
+		TIFFClose(tif);
+		return 0;
+	}
+	for (i = n; i-- > 0; ) {
+		fill_chunk(buf, size, i);
+		if ((tiled ? TIFFWriteEncodedTile(tif, i, buf, size) :
+		     TIFFWriteEncodedStrip(tif, i, buf, size)) == -1) {
+			fprintf (stderr, "Can't write chunk %lu.\n",
+				 (unsigned long) i);
+			free(buf);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	free(buf);
+	TIFFClose(tif);
+	return 1;
+}
+
+typedef struct {
+	TIFFChunkIterator*	it;
+	TIFF*			tif;
+	unsigned char*		seen;
+	uint64*			offsets;	/* in order of return */
+	uint32			nreturned;
+#ifdef HAVE_PULLER_THREADS
+	pthread_mutex_t		mutex;
+#endif
+	int			ok;
+	unsigned char**		ref;	/* data of each chunk */
+	tmsize_t*		refsize;
+} IterState;
+
+#ifdef HAVE_PULLER_THREADS
+# define LOCK(st)	pthread_mutex_lock(&(st)->mutex)
+# define UNLOCK(st)	pthread_mutex_unlock(&(st)->mutex)
+#else
+# define LOCK(st)	((void) 0)
+# define UNLOCK(st)	((void) 0)
+#endif
+
+static int
+check_chunk(IterState* st, TIFFChunk* chunk)
+{
+	TIFFDirectory* td = &st->tif->tif_dir;
+	uint32 perplane = td->td_stripsperimage;
+	uint32 k = chunk->chunk % perplane;
+	uint32 x, y, w, l;
+
+	if (td->td_planarconfig == PLANARCONFIG_SEPARATE) {
+		if (chunk->sample != chunk->chunk / perplane)
+			return 0;
+	} else if (chunk->sample != 0)
+		return 0;
+	if (isTiled(st->tif)) {
+		uint32 across = (WIDTH + TILESIZE - 1) / TILESIZE;
+
+		x = (k % across) * TILESIZE;
+		y = (k / across) * TILESIZE;
+		w = WIDTH - x < TILESIZE ? WIDTH - x : TILESIZE;
+		l = LENGTH - y < TILESIZE ? LENGTH - y : TILESIZE;
+	} else {
+		x = 0;
+		y = k * ROWSPERSTRIP;
+		w = WIDTH;
+		l = LENGTH - y < ROWSPERSTRIP ? LENGTH - y : ROWSPERSTRIP;
+	}
+	if (chunk->x != x || chunk->y != y || chunk->width != w ||
+	    chunk->length != l) {
+		fprintf (stderr, "Chunk %lu at %lu,%lu %lux%lu, "
+			 "expected %lu,%lu %lux%lu.\n",
+			 (unsigned long) chunk->chunk,
+			 (unsigned long) chunk->x, (unsigned long) chunk->y,
+			 (unsigned long) chunk->width,
+			 (unsigned long) chunk->length,
+			 (unsigned long) x, (unsigned long) y,
+			 (unsigned long) w, (unsigned long) l);
+		return 0;
+	}
+	if (chunk->size != st->refsize[chunk->chunk] ||
+	    memcmp(chunk->buf, st->ref[chunk->chunk], chunk->size) != 0) {
+		fprintf (stderr, "Chunk %lu differs.\n",
+			 (unsigned long) chunk->chunk);
+		return 0;
+	}
+	return 1;
+}
+
+static void*
+pull_chunks(void* arg)
+{
+	IterState* st = (IterState*) arg;
+	TIFFChunk chunk;
+	int r;
+
+	while ((r = TIFFChunkIteratorNext(st->it, &chunk)) == 1) {
+		int ok = check_chunk(st, &chunk);
+
+		LOCK(st);
+		if (!ok || st->seen[chunk.chunk]++)
+			st->ok = 0;
+		st->offsets[st->nreturned++] =
+		    TIFFGetStrileOffset(st->tif, chunk.chunk);
+		UNLOCK(st);
+		TIFFChunkIteratorRelease(st->it, &chunk);
+	}
+	if (r != 0) {
+		fprintf (stderr, "TIFFChunkIteratorNext() failed.\n");
+		LOCK(st);
+		st->ok = 0;
+		UNLOCK(st);
+	}
+	return NULL;
+}
+
+/*
+ * Pull the chunks of st->it on npullers threads at once.
+ */
+static int
+run_pullers(IterState* st, int npullers)
+{
+#ifdef HAVE_PULLER_THREADS
+	pthread_t threads[NTHREADS];
+	int i, n;
+
+	for (n = 1; n < npullers; n++)
+		if (pthread_create(&threads[n], NULL, pull_chunks, st) != 0)
+			break;
+	pull_chunks(st);
+	for (i = 1; i < n; i++)
+		pthread_join(threads[i], NULL);
+	return n == npullers;
+#else
+	(void) npullers;
+	pull_chunks(st);
+	return 1;
+#endif
+}
+
+static int
+check_image(const char* filename, int order, int nthreads, int npullers)
+{
+	TIFF* tif;
+	IterState st;
+	uint32 n, i;
+	int ret = 0;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	memset(&st, 0, sizeof (st));
+	st.tif = tif;
+	st.ok = 1;
+	n = TIFFIsTiled(tif) ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	st.seen = (unsigned char*) calloc(n, 1);
+	st.offsets = (uint64*) calloc(n, sizeof (uint64));
+	st.ref = (unsigned char**) calloc(n, sizeof (unsigned char*));
+	st.refsize = (tmsize_t*) calloc(n, sizeof (tmsize_t));
+#ifdef HAVE_PULLER_THREADS
+	pthread_mutex_init(&st.mutex, NULL);
+#endif
+	if (!st.seen || !st.offsets || !st.ref || !st.refsize)
+		goto failure;
+	for (i = 0; i < n; i++) {
+		tmsize_t size = TIFFIsTiled(tif) ? TIFFTileSize(tif) :
+		    TIFFStripSize(tif);
+
+		st.ref[i] = (unsigned char*) malloc(size);
+		if (!st.ref[i])
+			goto failure;
+		st.refsize[i] = TIFFIsTiled(tif) ?
+		    TIFFReadEncodedTile(tif, i, st.ref[i], size) :
+		    TIFFReadEncodedStrip(tif, i, st.ref[i], size);
+		if (st.refsize[i] == -1) {
+			fprintf (stderr, "Can't read chunk %lu.\n",
+				 (unsigned long) i);
+			goto failure;
+		}
+	}
+
+	st.it = TIFFChunkIteratorBegin(tif, order, nthreads);
+	if (!st.it) {
+		fprintf (stderr, "TIFFChunkIteratorBegin() failed.\n");
+		goto failure;
+	}
+	if (!run_pullers(&st, npullers)) {
+		fprintf (stderr, "Can't start the puller threads.\n");
+		st.ok = 0;
+	}
+	TIFFChunkIteratorEnd(st.it);
+
+	if (!st.ok)
+		goto failure;
+	if (st.nreturned != n) {
+		fprintf (stderr, "%lu chunks returned out of %lu.\n",
+			 (unsigned long) st.nreturned, (unsigned long) n);
+		goto failure;
+	}
+	/* A single puller sees the chunks in the order asked for */
+	if (npullers == 1) {
+		for (i = 1; i < n; i++) {
+			if (order == TIFFITER_FILEORDER &&
+			    st.offsets[i] < st.offsets[i - 1]) {
+				fprintf (stderr, "%s: chunks not in file order.\n",
+					 filename);
+				goto failure;
+			}
+			if (order == TIFFITER_CHUNKORDER &&
+			    st.offsets[i] > st.offsets[i - 1]) {
+				/* written in reverse, so offsets decrease */
+				fprintf (stderr, "%s: chunks not in chunk order.\n",
+					 filename);
+				goto failure;
+			}
+		}
+	}
+	ret = 1;
+
+failure:
+	if (!ret)
+		fprintf (stderr, "%s: order %d, %d threads, %d pullers failed.\n",
+			 filename, order, nthreads, npullers);
+	if (st.ref) {
+		for (i = 0; i < n; i++)
+			free(st.ref[i]);
+		free(st.ref);
+	}
+	free(st.refsize);
+	free(st.seen);
+	free(st.offsets);
+#ifdef HAVE_PULLER_THREADS
+	pthread_mutex_destroy(&st.mutex);
+#endif
+	TIFFClose(tif);
+	return ret;
+}
+
+static int
+check_all(const char* filename)
+{
+	static const int orders[] = { TIFFITER_CHUNKORDER, TIFFITER_FILEORDER };
+	size_t i;
+
+	for (i = 0; i < sizeof (orders) / sizeof (orders[0]); i++) {
+		if (!check_image(filename, orders[i], 1, 1)
+		    || !check_image(filename, orders[i], NTHREADS, 1)
+		    || !check_image(filename, orders[i], 2, NTHREADS)
+		    || !check_image(filename, orders[i], 0, NTHREADS))
+			return 0;
+	}
+	return 1;
+}
+
+int
+main(void)
+{
+	TIFF* tif;
+
+	if (!write_image(tiledfile, 1, PLANARCONFIG_CONTIG)
+	    || !write_image(stripfile, 0, PLANARCONFIG_CONTIG)
+	    || !write_image(planefile, 1, PLANARCONFIG_SEPARATE))
+		return 1;
+	if (!check_all(tiledfile) || !check_all(stripfile)
+	    || !check_all(planefile))
+		return 1;
+
+	/* Unknown orders are refused */
+	tif = TIFFOpen(stripfile, "r");
+	if (!tif || TIFFChunkIteratorBegin(tif, 7, 1) != NULL) {
+		fprintf (stderr, "Invalid iteration order was accepted.\n");
+		return 1;
+	}
+	TIFFClose(tif);
+
+	unlink(tiledfile);
+	unlink(stripfile);
+	unlink(planefile);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
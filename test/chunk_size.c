@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check the strip and tile sizes picked by TIFFDefaultStripSize() and
+ * TIFFDefaultTileSize() with the size set by
+ * TIFFOpenOptionsSetChunkSize(), and that an image written with them
+ * reads back.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "chunk_size.tif";
+
+#define	WIDTH		1000
+#define	LENGTH		3000
+
+static TIFF*
+open_with_chunk_size(tmsize_t size)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFF* tif;
+
+	if (!opts)
+		return NULL;
+	TIFFOpenOptionsSetChunkSize(opts, size);
+	tif = TIFFOpenExt(filename, "w", opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif)
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+	return tif;
+}
+
+static void
+set_image(TIFF* tif, uint32 width, uint16 spp, uint16 compression)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, spp);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC,
+		     spp == 3 ? PHOTOMETRIC_RGB : PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, compression);
+}
+
+static int
+check_strips(tmsize_t size, uint32 width, uint16 spp, uint16 compression,
+	     uint32 expected)
+{
+	TIFF* tif = open_with_chunk_size(size);
+	uint32 rows;
+
+	if (!tif)
+		return 0;
+	set_image(tif, width, spp, compression);
+	rows = TIFFDefaultStripSize(tif, 0);
+	TIFFClose(tif);
+	if (rows != expected) {
+		fprintf (stderr, "Chunk size %ld, compression %u: %lu rows "
+			 "per strip, expected %lu.\n", (long) size,
+			 (unsigned) compression, (unsigned long) rows,
+			 (unsigned long) expected);
+		return 0;
+	}
+	return 1;
+}
+
+static int
+check_tiles(tmsize_t size, uint32 width, uint16 spp, uint16 compression,
+	    uint32 expected)
+{
+	TIFF* tif = open_with_chunk_size(size);
+	uint32 tw = 0, th = 0;
+
+	if (!tif)
+		return 0;
+	set_image(tif, width, spp, compression);
+	TIFFDefaultTileSize(tif, &tw, &th);
+	TIFFClose(tif);
+	if (tw != expected || th != expected) {
+		fprintf (stderr, "Chunk size %ld, compression %u: %lux%lu "
+			 "tiles, expected %lux%lu.\n", (long) size,
+			 (unsigned) compression, (unsigned long) tw,
+			 (unsigned long) th, (unsigned long) expected,
+			 (unsigned long) expected);
+		return 0;
+	}
+	return 1;
+}
+
+/* Write a Deflate image with the automatic size and read it back */
+static int
+write_and_read(void)
+{
+	static unsigned char buf[WIDTH * 3];
+	TIFF* tif = open_with_chunk_size(TIFF_CHUNKSIZE_AUTO);
+	uint32 rows, x, y;
+
+	if (!tif)
+		return 0;
+	set_image(tif, WIDTH, 3, COMPRESSION_ADOBE_DEFLATE);
+	rows = TIFFDefaultStripSize(tif, 0);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rows);
+	for (y = 0; y < LENGTH; y++) {
+		for (x = 0; x < WIDTH * 3; x++)
+			buf[x] = (unsigned char)(x + y);
+		if (TIFFWriteScanline(tif, buf, y, 0) == -1) {
+			fprintf (stderr, "Can't write row %lu.\n",
+				 (unsigned long) y);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (TIFFNumberOfStrips(tif) != (LENGTH + rows - 1) / rows) {
+		fprintf (stderr, "Wrote %lu strips.\n",
+			 (unsigned long) TIFFNumberOfStrips(tif));
+		TIFFClose(tif);
+		return 0;
+	}
+	for (y = 0; y < LENGTH; y++) {
+		if (TIFFReadScanline(tif, buf, y, 0) == -1) {
+			fprintf (stderr, "Can't read row %lu.\n",
+				 (unsigned long) y);
+			TIFFClose(tif);
+			return 0;
+		}
+		for (x = 0; x < WIDTH * 3; x++) {
+			if (buf[x] != (unsigned char)(x + y)) {
+				fprintf (stderr, "Wrong sample %lu of row %lu.\n",
+					 (unsigned long) x, (unsigned long) y);
+				TIFFClose(tif);
+				return 0;
+			}
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+int
+main()
+{
+	int ret = 1;
+
+	/* Without a size, strips of about 8 kilobytes and 256x256 tiles */
+	if (!check_strips(0, WIDTH, 1, COMPRESSION_NONE, 8192 / WIDTH) ||
+	    !check_tiles(0, WIDTH, 1, COMPRESSION_NONE, 256))
+		goto done;
+	/* An explicit size, whatever the codec */
+	if (!check_strips(65536, WIDTH, 3, COMPRESSION_PACKBITS,
+			  65536 / (WIDTH * 3)) ||
+	    !check_tiles(65536, WIDTH, 1, COMPRESSION_PACKBITS, 256) ||
+	    !check_tiles(65536, WIDTH, 3, COMPRESSION_PACKBITS, 128))
+		goto done;
+	/* Strips no longer and tiles no larger than the image */
+	if (!check_strips(64 * 1024 * 1024, WIDTH, 1, COMPRESSION_NONE,
+			  LENGTH) ||
+	    !check_tiles(64 * 1024 * 1024, 40, 1, COMPRESSION_NONE, 4096))
+		goto done;
+	/* The automatic size depends on the codec */
+	if (!check_strips(TIFF_CHUNKSIZE_AUTO, WIDTH, 1, COMPRESSION_NONE,
+			  256 * 1024 / WIDTH) ||
+	    !check_tiles(TIFF_CHUNKSIZE_AUTO, WIDTH, 1, COMPRESSION_NONE,
+			 512))
+		goto done;
+	if (TIFFIsCODECConfigured(COMPRESSION_ADOBE_DEFLATE) &&
+	    (!check_strips(TIFF_CHUNKSIZE_AUTO, WIDTH, 3,
+			   COMPRESSION_ADOBE_DEFLATE, 1024 * 1024 / (WIDTH * 3)) ||
+	     !check_tiles(TIFF_CHUNKSIZE_AUTO, WIDTH, 3,
+			  COMPRESSION_ADOBE_DEFLATE, 512) ||
+	     !write_and_read()))
+		goto done;
+	/* JPEG strips stay a multiple of the MCU height, 16 rows here */
+	if (TIFFIsCODECConfigured(COMPRESSION_JPEG) &&
+	    !check_strips(TIFF_CHUNKSIZE_AUTO, WIDTH, 3, COMPRESSION_JPEG,
+			  (256 * 1024 / (WIDTH * 3) + 15) / 16 * 16))
+		goto done;
+	ret = 0;
+done:
+	unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check the sample statistics tallied by handles opened with 'T': per
+ * tile and per image, with the parts of edge tiles outside the image left
+ * out, for tiles written one by one and in parallel, strips written by
+ * scanline, and floating point strips holding NaN; that the minima
+ * and maxima read back from the ChunkStatistics tag; and the strips
+ * TIFFSelectChunks() picks from them.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "chunk_statistics.tif";
+
+#define	WIDTH		100
+#define	LENGTH		70
+#define	TILESIZE	32
+#define	ACROSS		((WIDTH + TILESIZE - 1) / TILESIZE)
+#define	DOWN		((LENGTH + TILESIZE - 1) / TILESIZE)
+#define	NTILES		(ACROSS * DOWN)
+
+static unsigned char
+pixel(uint32 x, uint32 y, uint16 s)
+{
+	return (unsigned char)((x * 7 + y * 3 + s * 50) % 200 + 10);
+}
+
+/*
+ * Fill tile t of an RGB image; the part outside the image gets 255 and
+ * 0, which must not be tallied.
+ */
+static void
+make_tile(unsigned char* buf, uint32 t)
+{
+	uint32 x0 = (t % ACROSS) * TILESIZE, y0 = (t / ACROSS) * TILESIZE;
+	uint32 x, y;
+	uint16 s;
+
+	for (y = 0; y < TILESIZE; y++)
+		for (x = 0; x < TILESIZE; x++)
+			for (s = 0; s < 3; s++)
+				buf[(y * TILESIZE + x) * 3 + s] =
+				    (x0 + x < WIDTH && y0 + y < LENGTH) ?
+				    pixel(x0 + x, y0 + y, s) : (s ? 0 : 255);
+}
+
+/*
+ * The statistics expected for sample s of tile t, or of the image if t
+ * is NTILES.
+ */
+static void
+expected(uint32 t, uint16 s, double* min, double* max, double* mean,
+	 uint64* hist)
+{
+	uint32 x, y;
+	double sum = 0, n = 0;
+
+	*min = 255;
+	*max = 0;
+	if (hist)
+		memset(hist, 0, 256 * sizeof(uint64));
+	for (y = 0; y < LENGTH; y++)
+		for (x = 0; x < WIDTH; x++) {
+			unsigned char v = pixel(x, y, s);
+
+			if (t < NTILES && (x / TILESIZE != t % ACROSS ||
+			    y / TILESIZE != t / ACROSS))
+				continue;
+			if (v < *min)
+				*min = v;
+			if (v > *max)
+				*max = v;
+			sum += v;
+			n++;
+			if (hist)
+				hist[v]++;
+		}
+	*mean = sum / n;
+}
+
+static int
+check_stats(TIFF* tif, const char* what, int withimage)
+{
+	uint64 hist[256], want[256];
+	double min, max, mean, emin, emax, emean;
+	uint32 t;
+	uint16 s;
+
+	for (t = 0; t < NTILES; t++)
+		for (s = 0; s < 3; s++) {
+			expected(t, s, &emin, &emax, &emean, NULL);
+			if (!TIFFGetChunkStatistics(tif, t, s, &min, &max) ||
+			    min != emin || max != emax) {
+				fprintf (stderr, "%s: tile %lu sample %u: "
+					 "got %g..%g, expected %g..%g.\n",
+					 what, (unsigned long) t, s, min, max,
+					 emin, emax);
+				return 0;
+			}
+		}
+	if (TIFFGetChunkStatistics(tif, 0, 3, &min, &max)) {
+		fprintf (stderr, "%s: sample 3 accepted.\n", what);
+		return 0;
+	}
+	if (!withimage)
+		return 1;
+	for (s = 0; s < 3; s++) {
+		expected(NTILES, s, &emin, &emax, &emean, want);
+		if (!TIFFGetImageStatistics(tif, s, &min, &max, &mean, hist) ||
+		    min != emin || max != emax || mean < emean - 1e-9 ||
+		    mean > emean + 1e-9 || memcmp(hist, want, sizeof(hist))) {
+			fprintf (stderr, "%s: image sample %u: got %g..%g "
+				 "mean %g, expected %g..%g mean %g.\n",
+				 what, s, min, max, mean, emin, emax, emean);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static TIFF*
+create_tiled(void)
+{
+	TIFF* tif = TIFFOpen(filename, "wT");
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return NULL;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	return tif;
+}
+
+/*
+ * Write the RGB tiles one by one, or all at once on nthreads threads.
+ */
+static int
+test_tiles(int nthreads)
+{
+	unsigned char* bufs[NTILES];
+	void* ptrs[NTILES];
+	tmsize_t sizes[NTILES];
+	uint32 tiles[NTILES];
+	const char* what = nthreads ? "parallel tiles" : "tiles";
+	TIFF* tif;
+	uint32 t;
+	int ret = 0;
+
+	memset(bufs, 0, sizeof(bufs));
+	tif = create_tiled();
+	if (!tif)
+		return 0;
+	for (t = 0; t < NTILES; t++) {
+		bufs[t] = (unsigned char*) malloc(TILESIZE * TILESIZE * 3);
+		if (!bufs[t])
+			goto failure;
+		make_tile(bufs[t], t);
+		ptrs[t] = bufs[t];
+		sizes[t] = TILESIZE * TILESIZE * 3;
+		tiles[t] = t;
+	}
+	if (nthreads) {
+		if (!TIFFWriteEncodedTilesParallel(tif, tiles, NTILES, ptrs,
+						   sizes, nthreads)) {
+			fprintf (stderr, "%s: can't write tiles.\n", what);
+			goto failure;
+		}
+	} else {
+		for (t = 0; t < NTILES; t++)
+			if (TIFFWriteEncodedTile(tif, t, bufs[t], sizes[t]) < 0) {
+				fprintf (stderr, "%s: can't write tile %lu.\n",
+					 what, (unsigned long) t);
+				goto failure;
+			}
+	}
+	if (!check_stats(tif, what, 1))
+		goto failure;
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	if (!check_stats(tif, "tag read back", 0))
+		goto failure;
+	ret = 1;
+
+failure:
+	if (tif)
+		TIFFClose(tif);
+	for (t = 0; t < NTILES; t++)
+		free(bufs[t]);
+	return ret;
+}
+
+/*
+ * A 16-bit image of two separate planes written by scanline, in strips
+ * of 16 rows, the last one short.
+ */
+static int
+test_scanlines(void)
+{
+	uint16 row[WIDTH];
+	uint64 hist[256];
+	uint32 strips[5];
+	double min, max, mean;
+	uint32 x, y, nstrips;
+	uint16 plane;
+	TIFF* tif = TIFFOpen(filename, "wT");
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 2);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_SEPARATE);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 16);
+	for (plane = 0; plane < 2; plane++)
+		for (y = 0; y < LENGTH; y++) {
+			for (x = 0; x < WIDTH; x++)
+				row[x] = (uint16)(plane * 1000 + y * 256 + x);
+			if (TIFFWriteScanline(tif, row, y, plane) != 1) {
+				fprintf (stderr, "scanlines: can't write row "
+					 "%lu.\n", (unsigned long) y);
+				goto failure;
+			}
+		}
+	nstrips = TIFFNumberOfStrips(tif) / 2;
+	/* strip 4 of plane 1 has rows 64..69 */
+	if (!TIFFGetChunkStatistics(tif, nstrips + 4, 0, &min, &max) ||
+	    min != 1000 + 64 * 256 || max != 1000 + 69 * 256 + WIDTH - 1) {
+		fprintf (stderr, "scanlines: last strip %g..%g.\n", min, max);
+		goto failure;
+	}
+	if (!TIFFGetImageStatistics(tif, 1, &min, &max, &mean, hist) ||
+	    min != 1000 || max != 1000 + 69 * 256 + WIDTH - 1 ||
+	    mean != 1000 + 34.5 * 256 + (WIDTH - 1) / 2.0 ||
+	    hist[(1000 >> 8)] != 24 || hist[(1000 + 69 * 256 + 99) >> 8] == 0) {
+		fprintf (stderr, "scanlines: image %g..%g mean %g.\n",
+			 min, max, mean);
+		goto failure;
+	}
+	/* rows 32..47 of plane 1 only, and all strips of plane 0 */
+	if (TIFFSelectChunks(tif, 1, 1000 + 40 * 256, 1000 + 40 * 256 + 2,
+			     TIFF_SELECT_INSIDE, strips, 5) != 1 ||
+	    strips[0] != nstrips + 2 ||
+	    TIFFSelectChunks(tif, 0, 1000 + 40 * 256, 1000 + 40 * 256,
+			     TIFF_SELECT_OUTSIDE, strips, 0) != nstrips ||
+	    TIFFSelectChunks(tif, 2, 0, 0, TIFF_SELECT_INSIDE, strips, 5)) {
+		fprintf (stderr, "scanlines: wrong strips selected.\n");
+		goto failure;
+	}
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+/*
+ * Floating point strips: NaN is left out, a strip of NaN only has an
+ * empty range, and a strip not written has no statistics.
+ */
+static int
+test_float(void)
+{
+	float row[WIDTH * 10];
+	double min, max, mean, zero = 0;
+	uint32 i, strips[3];
+	TIFF* tif = TIFFOpen(filename, "wT");
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, 30);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 32);
+	TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 10);
+	for (i = 0; i < WIDTH * 10; i++)
+		row[i] = (i % 3) ? (float)(i * 0.5 - 100) : (float)(zero / zero);
+	if (TIFFWriteEncodedStrip(tif, 0, row, sizeof(row)) < 0)
+		goto failure;
+	for (i = 0; i < WIDTH * 10; i++)
+		row[i] = (float)(zero / zero);
+	if (TIFFWriteEncodedStrip(tif, 1, row, sizeof(row)) < 0)
+		goto failure;
+	if (!TIFFGetChunkStatistics(tif, 0, 0, &min, &max) ||
+	    min != -99.5 || max != 399) {
+		fprintf (stderr, "float: strip 0 %g..%g.\n", min, max);
+		goto failure;
+	}
+	if (!TIFFGetChunkStatistics(tif, 1, 0, &min, &max) || min <= max) {
+		fprintf (stderr, "float: NaN strip %g..%g.\n", min, max);
+		goto failure;
+	}
+	if (TIFFGetChunkStatistics(tif, 2, 0, &min, &max)) {
+		fprintf (stderr, "float: strip 2 has statistics.\n");
+		goto failure;
+	}
+	if (!TIFFGetImageStatistics(tif, 0, &min, &max, &mean, NULL) ||
+	    min != -99.5 || max != 399) {
+		fprintf (stderr, "float: image %g..%g.\n", min, max);
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif)
+		return 0;
+	if (!TIFFGetChunkStatistics(tif, 1, 0, &min, &max) || min <= max ||
+	    TIFFGetChunkStatistics(tif, 2, 0, &min, &max) ||
+	    TIFFGetImageStatistics(tif, 0, &min, &max, &mean, NULL)) {
+		fprintf (stderr, "float: wrong statistics read back.\n");
+		goto failure;
+	}
+	/* strip 2 has no statistics and strip 1 only NaN */
+	if (TIFFSelectChunks(tif, 0, 500, 600, TIFF_SELECT_INSIDE,
+			     strips, 3) != 1 || strips[0] != 2 ||
+	    TIFFSelectChunks(tif, 0, 0, 1, TIFF_SELECT_INSIDE,
+			     strips, 3) != 2 || strips[0] != 0 || strips[1] != 2 ||
+	    TIFFSelectChunks(tif, 0, -100, 400, TIFF_SELECT_OUTSIDE,
+			     strips, 3) != 1 || strips[0] != 2 ||
+	    TIFFSelectChunks(tif, 0, 0, 400, TIFF_SELECT_OUTSIDE,
+			     strips, 3) != 2 || strips[0] != 0) {
+		fprintf (stderr, "float: wrong strips selected.\n");
+		goto failure;
+	}
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+int
+main(void)
+{
+	if (!test_tiles(0) || !test_tiles(4) || !test_scanlines() ||
+	    !test_float()) {
+		unlink(filename);
+		return 1;
+	}
+	unlink(filename);
+	return 0;
+}
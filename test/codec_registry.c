@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFFindCODEC() finds the builtin codecs and those
+ * registered with TIFFRegisterCODEC(), which override the builtin ones
+ * until they are unregistered.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiffio.h"
+
+#define	SCHEME		60001		/* no builtin codec */
+
+static int
+initDummy(TIFF* tif, int scheme)
+{
+	(void) tif;
+	(void) scheme;
+	return (1);
+}
+
+static int
+check_find(uint16 scheme, const TIFFCodec* want, const char* what)
+{
+	const TIFFCodec* c = TIFFFindCODEC(scheme);
+
+	if (c != want) {
+		fprintf (stderr, "Scheme %u %s: found %s instead of %s.\n",
+		    scheme, what, c ? c->name : "nothing",
+		    want ? want->name : "nothing");
+		return 0;
+	}
+	return 1;
+}
+
+static int
+configured(const char* name)
+{
+	TIFFCodec* codecs = TIFFGetConfiguredCODECs();
+	TIFFCodec* c;
+	int found = 0;
+
+	if (codecs == NULL)
+		return -1;
+	for (c = codecs; c->name; c++)
+		if (strcmp(c->name, name) == 0)
+			found = 1;
+	_TIFFfree(codecs);
+	return found;
+}
+
+int
+main()
+{
+	const TIFFCodec* lzw = TIFFFindCODEC(COMPRESSION_LZW);
+	const TIFFCodec* none = TIFFFindCODEC(COMPRESSION_NONE);
+	TIFFCodec *mine, *over;
+
+	if (lzw == NULL || lzw->scheme != COMPRESSION_LZW ||
+	    none == NULL || none->scheme != COMPRESSION_NONE) {
+		fprintf (stderr, "Builtin codecs not found.\n");
+		return 1;
+	}
+	if (!check_find(SCHEME, NULL, "before registration") ||
+	    !check_find(12345, NULL, "never registered"))
+		return 1;
+
+	mine = TIFFRegisterCODEC(SCHEME, "Mine", initDummy);
+	over = TIFFRegisterCODEC(COMPRESSION_LZW, "MyLZW", initDummy);
+	if (mine == NULL || over == NULL) {
+		fprintf (stderr, "Can't register codecs.\n");
+		return 1;
+	}
+	if (!check_find(SCHEME, mine, "registered") ||
+	    !check_find(COMPRESSION_LZW, over, "overridden") ||
+	    !check_find(COMPRESSION_NONE, none, "untouched") ||
+	    !check_find(SCHEME + 1, NULL, "next to a registered one"))
+		return 1;
+	if (configured("Mine") != 1 || configured("MyLZW") != 1) {
+		fprintf (stderr, "Registered codecs not listed as configured.\n");
+		return 1;
+	}
+
+	TIFFUnRegisterCODEC(over);
+	if (!check_find(COMPRESSION_LZW, lzw, "unregistered override"))
+		return 1;
+	TIFFUnRegisterCODEC(mine);
+	if (!check_find(SCHEME, NULL, "unregistered"))
+		return 1;
+	if (configured("Mine") != 0) {
+		fprintf (stderr, "Unregistered codec still listed.\n");
+		return 1;
+	}
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
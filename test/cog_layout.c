@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that directories written with TIFFReserveDirectory() come
+ * before all image data, which is then laid out in the order it is
+ * written, smallest overview first.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "cog_layout.tif";
+
+#define	WIDTH		128
+#define	TILESIZE	16
+#define	NLEVELS		3
+
+static void
+fill_tile(unsigned char* buf, tmsize_t size, uint32 tile, int level)
+{
+	tmsize_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)((i / 9 + tile * 17 + level * 61) & 0xff);
+}
+
+static void
+setup_level(TIFF* tif, int level, uint16 compression)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH >> level);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, WIDTH >> level);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, compression);
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	if (level > 0)
+		TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE);
+	else
+		TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, "cog layout test");
+}
+
+static int
+write_file(const char* mode, uint16 compression)
+{
+	unsigned char buf[TILESIZE * TILESIZE];
+	TIFF* tif;
+	uint32 t, n;
+	int level;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (level = 0; level < NLEVELS; level++) {
+		setup_level(tif, level, compression);
+		if (!TIFFReserveDirectory(tif)) {
+			fprintf (stderr, "Can't reserve directory %d.\n", level);
+			goto failure;
+		}
+	}
+	for (level = NLEVELS - 1; level >= 0; level--) {
+		if (!TIFFSetDirectory(tif, (uint16) level))
+			goto failure;
+		if (level == 0 && TIFFReserveDirectory(tif)) {
+			fprintf (stderr, "A written directory was reserved.\n");
+			goto failure;
+		}
+		n = TIFFNumberOfTiles(tif);
+		for (t = 0; t < n; t++) {
+			fill_tile(buf, sizeof(buf), t, level);
+			if (TIFFWriteEncodedTile(tif, t, buf, sizeof(buf)) == -1) {
+				fprintf (stderr, "Can't write tile %lu of "
+					 "level %d.\n", (unsigned long) t, level);
+				goto failure;
+			}
+		}
+		if (!TIFFFlush(tif))
+			goto failure;
+	}
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+static int
+check_file(const char* mode, uint16 compression)
+{
+	unsigned char buf[TILESIZE * TILESIZE], ref[TILESIZE * TILESIZE];
+	uint64 lastdir = 0, datastart = (uint64) -1, levelstart = (uint64) -1;
+	TIFF* tif;
+	uint32 t, n;
+	int level;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	for (level = 0; level < NLEVELS; level++) {
+		uint64 first = (uint64) -1, end = 0;
+
+		if (level > 0 && !TIFFReadDirectory(tif)) {
+			fprintf (stderr, "%s: directory %d is missing.\n",
+				 mode, level);
+			goto failure;
+		}
+		if (TIFFCurrentDirOffset(tif) <= lastdir) {
+			fprintf (stderr, "%s: directories are out of order.\n",
+				 mode);
+			goto failure;
+		}
+		lastdir = TIFFCurrentDirOffset(tif);
+		n = TIFFNumberOfTiles(tif);
+		for (t = 0; t < n; t++) {
+			uint64 off = TIFFGetStrileOffset(tif, t);
+			uint64 size = TIFFGetStrileByteCount(tif, t);
+
+			if (off < first)
+				first = off;
+			if (off + size > end)
+				end = off + size;
+			if (TIFFReadEncodedTile(tif, t, buf, sizeof(buf)) !=
+			    (tmsize_t) sizeof(buf)) {
+				fprintf (stderr, "%s: can't read tile %lu of "
+					 "level %d.\n", mode,
+					 (unsigned long) t, level);
+				goto failure;
+			}
+			fill_tile(ref, sizeof(ref), t, level);
+			if (compression != COMPRESSION_JPEG &&
+			    memcmp(buf, ref, sizeof(buf)) != 0) {
+				fprintf (stderr, "%s: tile %lu of level %d "
+					 "differs.\n", mode, (unsigned long) t,
+					 level);
+				goto failure;
+			}
+		}
+		/* each level follows the smaller ones */
+		if (level > 0 && end > levelstart) {
+			fprintf (stderr, "%s: level %d is not stored before "
+				 "level %d.\n", mode, level, level - 1);
+			goto failure;
+		}
+		levelstart = first;
+		if (first < datastart)
+			datastart = first;
+	}
+	if (lastdir >= datastart) {
+		fprintf (stderr, "%s: directories are not ahead of the data.\n",
+			 mode);
+		goto failure;
+	}
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+static int
+check_layout(const char* mode, uint16 compression)
+{
+	return write_file(mode, compression) && check_file(mode, compression);
+}
+
+int
+main()
+{
+	if (!check_layout("w", COMPRESSION_LZW) ||
+	    !check_layout("w8", COMPRESSION_LZW) ||
+	    !check_layout("w", COMPRESSION_NONE))
+		return 1;
+#ifdef JPEG_SUPPORT
+	/* JPEGTables must be written with the directory */
+	if (!check_layout("w", COMPRESSION_JPEG))
+		return 1;
+#endif
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
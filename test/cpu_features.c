@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check TIFFGetCPUFeatures() and TIFFSetCPUFeatures(), and that the
+ * portable code and the optimized kernels produce the same data: an
+ * image written with each set of kernels must read back identically
+ * with the other, and TIFFReadRGBAImage() must return the same pixels
+ * (including for YCbCr and CIE L*a*b* images).  The interpolated
+ * L*a*b* conversion is also checked against the exact one, and so are
+ * the RGB to YCbCr and palette conversions of the tools.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "tiffiop.h"
+#include "test_image.h"
+
+static const char filename[] = "cpu_features.tif";
+
+#define	WIDTH		157
+#define	LENGTH		40
+
+static void
+copy_strip(TestChunk* c, void* arg)
+{
+	memcpy(c->buf, arg, c->size);
+}
+
+static int
+write_image(uint16 bps, uint16 spp, uint16 photometric, uint16 extra,
+	    const uint16* subsampling, uint16 predictor, const void* buf)
+{
+	TestImage im = { WIDTH, LENGTH, 0, 0, PLANARCONFIG_CONTIG, 0,
+	    COMPRESSION_LZW, LENGTH, 0, 0 };
+	TIFF* tif = TIFFOpen(filename, "w");
+	int ok;
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.bitspersample = bps;
+	im.samplesperpixel = spp;
+	im.photometric = photometric;
+	set_image_fields(tif, &im);
+	if (extra != EXTRASAMPLE_UNSPECIFIED)
+		TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, 1, &extra);
+	if (subsampling)
+		TIFFSetField(tif, TIFFTAG_YCBCRSUBSAMPLING, subsampling[0],
+			     subsampling[1]);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor);
+	if (predictor == PREDICTOR_FLOATINGPOINT)
+		TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
+	ok = write_image_data(tif, copy_strip, (void*) buf);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+read_image(void* buf, tmsize_t size)
+{
+	TIFF* tif = TIFFOpen(filename, "r");
+	tmsize_t got;
+
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	got = TIFFReadEncodedStrip(tif, 0, buf, size);
+	TIFFClose(tif);
+	if (got != size) {
+		fprintf (stderr, "Can't read %s.\n", filename);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Write with one set of features and read back with the other.
+ */
+static int
+check_roundtrip(uint16 bps, uint16 spp, uint16 predictor,
+		int wfeatures, int rfeatures)
+{
+	tmsize_t size = (tmsize_t) WIDTH * LENGTH * spp * (bps / 8), i;
+	unsigned char* ref = (unsigned char*) malloc(size);
+	unsigned char* got = (unsigned char*) malloc(size);
+	int ret = 0;
+
+	if (!ref || !got) {
+		fprintf (stderr, "Out of memory.\n");
+		goto done;
+	}
+	for (i = 0; i < size; i++)
+		ref[i] = (unsigned char)((i * 7 + i / 13) & 0xff);
+	TIFFSetCPUFeatures(wfeatures);
+	if (!write_image(bps, spp, PHOTOMETRIC_MINISBLACK,
+			 EXTRASAMPLE_UNSPECIFIED, NULL, predictor, ref))
+		goto done;
+	TIFFSetCPUFeatures(rfeatures);
+	if (!read_image(got, size))
+		goto done;
+	if (memcmp(ref, got, size) != 0) {
+		fprintf (stderr, "bps %d spp %d predictor %d: data differs "
+			 "(features %#x then %#x).\n", bps, spp, predictor,
+			 wfeatures, rfeatures);
+		goto done;
+	}
+	ret = 1;
+done:
+	free(ref);
+	free(got);
+	return ret;
+}
+
+/*
+ * Read an 8-bit image with TIFFReadRGBAImage() with and without the
+ * optimized pixel packing.
+ */
+static int
+check_rgba(uint16 spp, uint16 photometric, uint16 extra,
+	   const uint16* subsampling)
+{
+	tmsize_t size = (tmsize_t) WIDTH * LENGTH * spp, i;
+	unsigned char* buf = (unsigned char*) malloc(size);
+	uint32* ref = (uint32*) malloc(WIDTH * LENGTH * sizeof (uint32));
+	uint32* got = (uint32*) malloc(WIDTH * LENGTH * sizeof (uint32));
+	TIFF* tif = NULL;
+	int ret = 0;
+
+	if (!buf || !ref || !got) {
+		fprintf (stderr, "Out of memory.\n");
+		goto done;
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)((i * 7 + i / 13) & 0xff);
+	if (!write_image(8, spp, photometric, extra, subsampling,
+			 PREDICTOR_NONE, buf))
+		goto done;
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto done;
+	}
+	TIFFSetCPUFeatures(0);
+	if (!TIFFReadRGBAImage(tif, WIDTH, LENGTH, ref, 0))
+		goto done;
+	TIFFSetCPUFeatures(TIFF_CPU_ALL);
+	if (!TIFFReadRGBAImage(tif, WIDTH, LENGTH, got, 0))
+		goto done;
+	if (memcmp(ref, got, WIDTH * LENGTH * sizeof (uint32)) != 0) {
+		fprintf (stderr, "spp %d photometric %d extra %d: RGBA "
+			 "images differ.\n", spp, photometric, extra);
+		goto done;
+	}
+	ret = 1;
+done:
+	if (tif)
+		TIFFClose(tif);
+	free(buf);
+	free(ref);
+	free(got);
+	return ret;
+}
+
+/*
+ * Compare the interpolated L*a*b* to RGB conversion done by
+ * TIFFReadRGBAImage() with TIFFCIELabToXYZ() and TIFFXYZToRGB().
+ */
+static int
+check_cielab(void)
+{
+	static const TIFFDisplay display_sRGB = {
+		{
+			{  3.2410F, -1.5374F, -0.4986F },
+			{  -0.9692F, 1.8760F, 0.0416F },
+			{  0.0556F, -0.2040F, 1.0570F }
+		},
+		100.0F, 100.0F, 100.0F,
+		255, 255, 255,
+		1.0F, 1.0F, 1.0F,
+		2.4F, 2.4F, 2.4F,
+	};
+	tmsize_t size = (tmsize_t) WIDTH * LENGTH * 3, i;
+	unsigned char* buf = (unsigned char*) malloc(size);
+	uint32* got = (uint32*) malloc(WIDTH * LENGTH * sizeof (uint32));
+	TIFFCIELabToRGB* cielab = (TIFFCIELabToRGB*)
+	    malloc(sizeof (TIFFCIELabToRGB));
+	float refWhite[3];
+	double sum = 0;
+	int maxerr = 0, ret = 0;
+	TIFF* tif = NULL;
+
+	if (!buf || !got || !cielab) {
+		fprintf (stderr, "Out of memory.\n");
+		goto done;
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)(((i * 2654435761U) >> 13) & 0xff);
+	if (!write_image(8, 3, PHOTOMETRIC_CIELAB, EXTRASAMPLE_UNSPECIFIED,
+			 NULL, PREDICTOR_NONE, buf))
+		goto done;
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto done;
+	}
+	if (!TIFFReadRGBAImageOriented(tif, WIDTH, LENGTH, got,
+				       ORIENTATION_TOPLEFT, 0))
+		goto done;
+	refWhite[1] = 100.0F;
+	refWhite[0] = D50_X0 / D50_Y0 * refWhite[1];
+	refWhite[2] = D50_Z0 / D50_Y0 * refWhite[1];
+	if (TIFFCIELabToRGBInit(cielab, &display_sRGB, refWhite) < 0)
+		goto done;
+	for (i = 0; i < WIDTH * LENGTH; i++) {
+		float X, Y, Z;
+		uint32 rgb[3];
+		int c;
+
+		TIFFCIELabToXYZ(cielab, buf[3 * i], (signed char) buf[3 * i + 1],
+				(signed char) buf[3 * i + 2], &X, &Y, &Z);
+		TIFFXYZToRGB(cielab, X, Y, Z, &rgb[0], &rgb[1], &rgb[2]);
+		for (c = 0; c < 3; c++) {
+			int err = abs((int) ((got[i] >> (8 * c)) & 0xff) -
+				      (int) rgb[c]);
+
+			sum += err;
+			if (err > maxerr)
+				maxerr = err;
+		}
+	}
+	/* Interpolation errors are largest close to black */
+	if (sum / (3.0 * WIDTH * LENGTH) > 0.25 || maxerr > 24) {
+		fprintf (stderr, "CIE L*a*b* conversion is inaccurate "
+			 "(mean error %g, max %d).\n",
+			 sum / (3.0 * WIDTH * LENGTH), maxerr);
+		goto done;
+	}
+	ret = 1;
+done:
+	if (tif)
+		TIFFClose(tif);
+	free(buf);
+	free(got);
+	free(cielab);
+	return ret;
+}
+
+/*
+ * Compare the conversions of RGBA rasters to subsampled YCbCr, read
+ * top-down and bottom-up, and of palette indices to RGB done by the
+ * portable code and the optimized kernels.
+ */
+static int
+check_color(void)
+{
+	static const float luma[3] = { .299F, .587F, .114F };
+	static const float refbw[2][6] = {
+		{ 0.F, 255.F, 128.F, 255.F, 128.F, 255.F },
+		{ 16.F, 235.F, 128.F, 240.F, 128.F, 240.F }
+	};
+	static const int subsamplings[][2] = {
+		{ 1, 1 }, { 2, 1 }, { 2, 2 }, { 4, 2 }, { 4, 4 }
+	};
+	static uint32 raster[WIDTH * LENGTH], map[256];
+	static unsigned char pix[WIDTH * LENGTH];
+	static unsigned char ref[3 * WIDTH * LENGTH], got[3 * WIDTH * LENGTH];
+	const uint32* top;
+	tmsize_t stride;
+	int i, r, s;
+
+	for (i = 0; i < WIDTH * LENGTH; i++) {
+		raster[i] = (uint32) i * 2654435761U;
+		pix[i] = (unsigned char) (i * 7 + i / 13);
+	}
+	for (i = 0; i < 256; i++)
+		map[i] = (uint32) i * 40503U * 40503U;
+	for (r = 0; r < 2; r++) {
+		for (s = 0; s < 5; s++) {
+			for (i = 0; i < 2; i++) {
+				top = i ? raster + (LENGTH - 1) * WIDTH : raster;
+				stride = i ? -WIDTH : WIDTH;
+				memset(ref, 0, sizeof (ref));
+				memset(got, 0, sizeof (got));
+				TIFFSetCPUFeatures(0);
+				TIFFRGBAToYCbCr8(ref, top, stride, WIDTH, LENGTH,
+				    subsamplings[s][0], subsamplings[s][1], luma,
+				    refbw[r]);
+				TIFFSetCPUFeatures(TIFF_CPU_ALL);
+				TIFFRGBAToYCbCr8(got, top, stride, WIDTH, LENGTH,
+				    subsamplings[s][0], subsamplings[s][1], luma,
+				    refbw[r]);
+				if (memcmp(ref, got, sizeof (ref)) != 0) {
+					fprintf (stderr, "YCbCr %dx%d conversions "
+					    "differ.\n", subsamplings[s][0],
+					    subsamplings[s][1]);
+					return 0;
+				}
+			}
+		}
+	}
+	/* Without subsampling each luminance code starts a clump */
+	TIFFRGBAToYCbCr8(ref, raster, WIDTH, WIDTH, LENGTH, 1, 1, luma,
+	    refbw[1]);
+	for (i = 0; i < WIDTH * LENGTH; i++) {
+		uint32 v = raster[i];
+		double y = .299 * TIFFGetR(v) + .587 * TIFFGetG(v) +
+		    .114 * TIFFGetB(v);
+
+		if (abs((int) (y * 219 / 255 + 16.5) - ref[3 * i]) > 1) {
+			fprintf (stderr, "Wrong luminance code %d for %lx.\n",
+			    ref[3 * i], (unsigned long) v);
+			return 0;
+		}
+	}
+	TIFFSetCPUFeatures(0);
+	TIFFPaletteToRGB8(ref, pix, WIDTH * LENGTH, map);
+	TIFFSetCPUFeatures(TIFF_CPU_ALL);
+	TIFFPaletteToRGB8(got, pix, WIDTH * LENGTH, map);
+	for (i = 0; i < WIDTH * LENGTH; i++)
+		if (ref[3 * i] != TIFFGetR(map[pix[i]]) ||
+		    ref[3 * i + 1] != TIFFGetG(map[pix[i]]) ||
+		    ref[3 * i + 2] != TIFFGetB(map[pix[i]]))
+			break;
+	if (i < WIDTH * LENGTH || memcmp(ref, got, sizeof (ref)) != 0) {
+		fprintf (stderr, "Palette conversions differ.\n");
+		return 0;
+	}
+	return 1;
+}
+
+int
+main()
+{
+	static const uint16 spps[] = { 1, 2, 3, 4, 5 };
+	static const uint16 subsamplings[][2] = { { 1, 1 }, { 2, 1 }, { 2, 2 } };
+	unsigned char a[1000], b[1000];
+	int all, i, s;
+
+	all = TIFFGetCPUFeatures();
+	if (TIFFSetCPUFeatures(0) != 0 || TIFFGetCPUFeatures() != 0) {
+		fprintf (stderr, "Can't disable the optimized code paths.\n");
+		return 1;
+	}
+	if (TIFFSetCPUFeatures(TIFF_CPU_ALL) != all ||
+	    TIFFGetCPUFeatures() != all) {
+		fprintf (stderr, "Can't restore the CPU features.\n");
+		return 1;
+	}
+	/* Only features the CPU has can be enabled */
+	if ((TIFFSetCPUFeatures(all | TIFF_CPU_NEON | TIFF_CPU_SSE2) & ~all)
+	    != 0) {
+		fprintf (stderr, "Unsupported CPU features were enabled.\n");
+		return 1;
+	}
+
+	for (i = 0; i < 1000; i++)
+		a[i] = b[i] = (unsigned char)(i * 31);
+	TIFFSetCPUFeatures(0);
+	TIFFSwabArrayOfLong((uint32*) a, 250);
+	TIFFReverseBits(a, 1000);
+	TIFFSetCPUFeatures(TIFF_CPU_ALL);
+	TIFFSwabArrayOfLong((uint32*) b, 250);
+	TIFFReverseBits(b, 1000);
+	if (memcmp(a, b, 1000) != 0) {
+		fprintf (stderr, "Byte swapping results differ.\n");
+		return 1;
+	}
+
+	for (s = 0; s < 5; s++) {
+		if (!check_roundtrip(8, spps[s], PREDICTOR_HORIZONTAL, 0, all) ||
+		    !check_roundtrip(8, spps[s], PREDICTOR_HORIZONTAL, all, 0) ||
+		    !check_roundtrip(16, spps[s], PREDICTOR_HORIZONTAL, 0, all) ||
+		    !check_roundtrip(16, spps[s], PREDICTOR_HORIZONTAL, all, 0) ||
+		    !check_roundtrip(32, spps[s], PREDICTOR_FLOATINGPOINT, 0, all) ||
+		    !check_roundtrip(32, spps[s], PREDICTOR_FLOATINGPOINT, all, 0) ||
+		    !check_roundtrip(64, spps[s], PREDICTOR_FLOATINGPOINT, 0, all) ||
+		    !check_roundtrip(64, spps[s], PREDICTOR_FLOATINGPOINT, all, 0) ||
+		    !check_roundtrip(16, spps[s], PREDICTOR_SHUFFLE, 0, all) ||
+		    !check_roundtrip(16, spps[s], PREDICTOR_SHUFFLE, all, 0) ||
+		    !check_roundtrip(32, spps[s], PREDICTOR_SHUFFLE, 0, all) ||
+		    !check_roundtrip(64, spps[s], PREDICTOR_SHUFFLE, all, 0))
+			return 1;
+	}
+	if (!check_rgba(3, PHOTOMETRIC_RGB, EXTRASAMPLE_UNSPECIFIED, NULL) ||
+	    !check_rgba(4, PHOTOMETRIC_RGB, EXTRASAMPLE_UNSPECIFIED, NULL) ||
+	    !check_rgba(4, PHOTOMETRIC_RGB, EXTRASAMPLE_ASSOCALPHA, NULL) ||
+	    !check_rgba(4, PHOTOMETRIC_RGB, EXTRASAMPLE_UNASSALPHA, NULL) ||
+	    !check_rgba(1, PHOTOMETRIC_MINISBLACK, EXTRASAMPLE_UNSPECIFIED, NULL) ||
+	    !check_rgba(1, PHOTOMETRIC_MINISWHITE, EXTRASAMPLE_UNSPECIFIED, NULL) ||
+	    !check_rgba(2, PHOTOMETRIC_MINISBLACK, EXTRASAMPLE_UNSPECIFIED, NULL) ||
+	    !check_rgba(3, PHOTOMETRIC_CIELAB, EXTRASAMPLE_UNSPECIFIED, NULL))
+		return 1;
+	for (s = 0; s < 3; s++)
+		if (!check_rgba(3, PHOTOMETRIC_YCBCR, EXTRASAMPLE_UNSPECIFIED,
+				subsamplings[s]))
+			return 1;
+	TIFFSetCPUFeatures(TIFF_CPU_ALL);
+	if (!check_cielab() || !check_color())
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check split-phase reading: TIFFGetTileInfo(), TIFFGetStripInfo() and
+ * the *FromBuffer() decoders, driven by the coroutine helpers of
+ * tiffio.hxx from a toy event loop that serves the raw reads in an
+ * order of its own.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <fstream>
+#include <vector>
+
+#include "tiffio.h"
+#include "tiffio.hxx"
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifdef TIFFXX_COROUTINES
+
+static const char tiledfile[] = "cxx_async_tiled.tif";
+static const char stripfile[] = "cxx_async_strip.tif";
+
+#define	WIDTH		100
+#define	LENGTH		70
+#define	TILESIZE	32
+#define	ROWSPERSTRIP	16
+
+static int
+write_file(const char* filename, bool tiled)
+{
+	libtiff::File file(filename, "w");
+	tmsize_t size;
+	uint32 n, i;
+	tmsize_t j;
+
+	if (!file) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFF* tif = file.get();
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	if (tiled) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+		size = TIFFTileSize(tif);
+		n = TIFFNumberOfTiles(tif);
+	} else {
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+		size = TIFFStripSize(tif);
+		n = TIFFNumberOfStrips(tif);
+	}
+	std::vector<unsigned char> buf(size);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < size; j++)
+			buf[j] = (unsigned char) (j * 7 + i * 31 + j / 50);
+		if ((tiled ? file.writeTile(i, buf) : file.writeStrip(i, buf))
+		    != size)
+			return 0;
+	}
+	return 1;
+}
+
+/* Raw reads queued by the tasks, served later by run() */
+class Loop {
+public:
+	explicit Loop(const char* filename) : in(filename, std::ios::binary) {}
+
+	struct Read {
+		Loop* loop;
+		uint64 offset;
+		uint64 bytecount;
+		std::vector<unsigned char> data;
+		std::coroutine_handle<> waiting;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			waiting = h;
+			loop->pending.push_back(this);
+		}
+		std::vector<unsigned char> await_resume()
+		{
+			return std::move(data);
+		}
+	};
+
+	Read fetch(uint64 offset, uint64 bytecount)
+	{
+		return Read{this, offset, bytecount, {}, nullptr};
+	}
+
+	/* Newest request first, to mix the decoding order up */
+	void run()
+	{
+		while (!pending.empty()) {
+			Read* r = pending.back();
+			pending.pop_back();
+			r->data.resize((size_t) r->bytecount);
+			in.seekg((std::streamoff) r->offset);
+			in.read((char*) r->data.data(), (std::streamsize) r->bytecount);
+			reads++;
+			r->waiting.resume();
+		}
+	}
+
+	std::ifstream in;
+	std::deque<Read*> pending;
+	int reads = 0;
+};
+
+static int
+check_file(const char* filename, bool tiled)
+{
+	libtiff::File file(filename, "r");
+	Loop loop(filename);
+	TIFFChunkInfo info;
+
+	if (!file || !loop.in) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	TIFF* tif = file.get();
+	uint32 n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	tmsize_t size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+
+	/* Phase one: the raw byte ranges, without reading anything */
+	if (!(tiled ? TIFFGetTileInfo(tif, n - 1, &info) :
+	      TIFFGetStripInfo(tif, n - 1, &info)) ||
+	    info.compression != COMPRESSION_ADOBE_DEFLATE ||
+	    info.offset != TIFFGetStrileOffset(tif, n - 1) ||
+	    info.bytecount != TIFFGetStrileByteCount(tif, n - 1) ||
+	    info.size != (tiled ? size :
+			  TIFFVStripSize(tif, LENGTH % ROWSPERSTRIP))) {
+		fprintf (stderr, "%s: wrong chunk information.\n", filename);
+		return 0;
+	}
+	if (tiled ? TIFFGetStripInfo(tif, 0, &info) :
+	    TIFFGetTileInfo(tif, 0, &info)) {
+		fprintf (stderr, "%s: mismatched chunk type accepted.\n",
+			 filename);
+		return 0;
+	}
+
+	/* Phase two, all chunks in flight at once */
+	std::vector<std::vector<unsigned char> > bufs(n);
+	std::vector<libtiff::Task<tmsize_t> > tasks;
+	auto fetch = [&loop](uint64 offset, uint64 bytecount) {
+		return loop.fetch(offset, bytecount);
+	};
+	for (uint32 i = 0; i < n; i++) {
+		bufs[i].resize(size);
+		tasks.push_back(tiled ?
+		    file.readTileAsync(i, bufs[i], fetch) :
+		    file.readStripAsync(i, bufs[i], fetch));
+		tasks.back().start();
+	}
+	if ((uint32) loop.pending.size() != n) {
+		fprintf (stderr, "%s: the tasks did not wait for their reads.\n",
+			 filename);
+		return 0;
+	}
+	loop.run();
+
+	std::vector<unsigned char> ref(size);
+	for (uint32 i = 0; i < n; i++) {
+		tmsize_t got = tiled ? file.readTile(i, ref) : file.readStrip(i, ref);
+
+		if (!tasks[i].done() || tasks[i].result() != got || got <= 0 ||
+		    memcmp(ref.data(), bufs[i].data(), (size_t) got) != 0) {
+			fprintf (stderr, "%s: chunk %lu differs.\n", filename,
+				 (unsigned long) i);
+			return 0;
+		}
+	}
+	return loop.reads == (int) n;
+}
+
+int
+main()
+{
+	if (!write_file(tiledfile, true) || !write_file(stripfile, false))
+		return 1;
+	if (!check_file(tiledfile, true) || !check_file(stripfile, false))
+		return 1;
+	unlink(tiledfile);
+	unlink(stripfile);
+	return 0;
+}
+
+#else
+
+int
+main()
+{
+	fprintf (stderr, "No C++20 coroutine support, nothing checked.\n");
+	return 0;
+}
+
+#endif
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check the libtiff::File wrapper of tiffio.hxx: ownership through moves,
+ * chunk i/o on caller containers and iteration over directories.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <string.h>
+#include <array>
+#include <utility>
+#include <vector>
+
+#include "tiffio.h"
+#include "tiffio.hxx"
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+static const char filename[] = "cxx_file.tif";
+
+#define	WIDTH		64
+#define	LENGTH		32
+#define	ROWSPERSTRIP	8
+#define	NDIRS		3
+
+static void
+set_fields(TIFF* tif)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+}
+
+static unsigned char
+sample(tdir_t dir, uint32 strip, size_t i)
+{
+	return (unsigned char) (i * 3 + strip * 17 + dir * 101);
+}
+
+static int
+write_file()
+{
+	libtiff::File file;
+	tdir_t dir;
+	uint32 strip;
+	size_t i;
+
+	if (file || (file = libtiff::File(filename, "w")).get() == NULL) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (dir = 0; dir < NDIRS; dir++) {
+		set_fields(file.get());
+		for (strip = 0; strip < LENGTH / ROWSPERSTRIP; strip++) {
+			tmsize_t got;
+
+			/* Both a vector and an array of 16 bit words */
+			if (strip % 2 == 0) {
+				std::vector<unsigned char> buf(WIDTH * ROWSPERSTRIP);
+
+				for (i = 0; i < buf.size(); i++)
+					buf[i] = sample(dir, strip, i);
+				got = file.writeStrip(strip, buf);
+			} else {
+				std::array<uint16, WIDTH * ROWSPERSTRIP / 2> buf;
+				unsigned char* p = (unsigned char*) buf.data();
+
+				for (i = 0; i < WIDTH * ROWSPERSTRIP; i++)
+					p[i] = sample(dir, strip, i);
+				got = file.writeStrip(strip, buf);
+			}
+			if (got != WIDTH * ROWSPERSTRIP) {
+				fprintf (stderr, "Can't write strip %lu.\n",
+					 (unsigned long) strip);
+				return 0;
+			}
+		}
+		if (!TIFFWriteDirectory(file.get()))
+			return 0;
+	}
+	/* Closed by the destructor */
+	return 1;
+}
+
+static int
+check_file()
+{
+	libtiff::File opened(filename, "r");
+	libtiff::File file(std::move(opened));
+	std::vector<unsigned char> buf(WIDTH * ROWSPERSTRIP);
+	tdir_t expected = 0;
+	TIFF* tif;
+	size_t i;
+
+	if (opened || !file) {
+		fprintf (stderr, "The handle was not moved.\n");
+		return 0;
+	}
+	for (tdir_t dir : file.directories()) {
+		uint32 strip;
+
+		if (dir != expected || TIFFCurrentDirectory(file.get()) != dir) {
+			fprintf (stderr, "Directory %d found for %d.\n",
+				 (int) dir, (int) expected);
+			return 0;
+		}
+		for (strip = 0; strip < LENGTH / ROWSPERSTRIP; strip++) {
+			if (file.readStrip(strip, buf) != WIDTH * ROWSPERSTRIP)
+				return 0;
+			for (i = 0; i < buf.size(); i++)
+				if (buf[i] != sample(dir, strip, i)) {
+					fprintf (stderr, "Directory %d, strip %lu "
+						 "differs.\n", (int) dir,
+						 (unsigned long) strip);
+					return 0;
+				}
+		}
+		expected++;
+	}
+	if (expected != NDIRS) {
+		fprintf (stderr, "%d directories found.\n", (int) expected);
+		return 0;
+	}
+
+	/* A short buffer gets only its size */
+	std::array<unsigned char, 10> small;
+	if (file.readStrip(0, small) != 10 || file.readStrip(0, small.data(), 0) != 0)
+		return 0;
+
+	/* release() hands the handle over to the caller */
+	tif = file.release();
+	if (file || tif == NULL)
+		return 0;
+	TIFFClose(tif);
+	return 1;
+}
+
+int
+main()
+{
+	if (!write_file() || !check_file())
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
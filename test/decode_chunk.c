@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFDecodeChunk() decodes raw data fetched by the caller
+ * like TIFFReadEncodedTile(), leaves that data alone, and does not get
+ * in the way of moving to another directory.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "decode_chunk.tif";
+
+#define	WIDTH		100
+#define	LENGTH		70
+#define	TILESIZE	32
+
+static void
+fill_tile(TestChunk* c, void* arg)
+{
+	tmsize_t i;
+
+	(void) arg;
+	for (i = 0; i < c->size; i++)
+		c->buf[i] = (unsigned char)((i / 7 + c->index * 31 + (i % 3) * 60) & 0xff);
+}
+
+static int
+write_directory(TIFF* tif, uint16 compression, uint16 fillorder)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 3, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_RGB, 0, 0, TILESIZE, TILESIZE };
+
+	im.compression = compression;
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_FILLORDER, fillorder);
+	if (compression == COMPRESSION_LZW)
+		TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	return write_image_data(tif, fill_tile, NULL) && TIFFWriteDirectory(tif);
+}
+
+static int
+write_image(void)
+{
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	ok = write_directory(tif, COMPRESSION_LZW, FILLORDER_MSB2LSB) &&
+	    write_directory(tif, COMPRESSION_PACKBITS, FILLORDER_LSB2MSB);
+	TIFFClose(tif);
+	if (!ok)
+		fprintf (stderr, "Can't write %s.\n", filename);
+	return ok;
+}
+
+/*
+ * Fetch the raw data of every tile of the current directory of tif
+ * through ref, decode it with TIFFDecodeChunk() and compare with the
+ * tiles decoded by ref.
+ */
+static int
+compare_tiles(TIFF* tif, TIFF* ref)
+{
+	tmsize_t size = TIFFTileSize(ref);
+	uint32 n = TIFFNumberOfTiles(ref);
+	unsigned char* a = (unsigned char*) malloc(size);
+	unsigned char* b = (unsigned char*) malloc(size);
+	unsigned char* raw = NULL;
+	unsigned char* copy = NULL;
+	uint32 t;
+	int ret = 0;
+
+	if (!a || !b)
+		goto failure;
+	for (t = 0; t < n; t++) {
+		TIFFChunkInfo info;
+		tmsize_t got = TIFFReadEncodedTile(ref, t, a, size);
+
+		if (got == -1 || !TIFFGetTileInfo(ref, t, &info)) {
+			fprintf (stderr, "Can't read tile %lu.\n",
+				 (unsigned long) t);
+			goto failure;
+		}
+		free(raw);
+		free(copy);
+		raw = (unsigned char*) malloc((size_t) info.bytecount);
+		copy = (unsigned char*) malloc((size_t) info.bytecount);
+		if (!raw || !copy ||
+		    TIFFReadRawTile(ref, t, raw, (tmsize_t) info.bytecount) !=
+		    (tmsize_t) info.bytecount)
+			goto failure;
+		memcpy(copy, raw, (size_t) info.bytecount);
+		if (TIFFDecodeChunk(tif, t, raw, (tmsize_t) info.bytecount,
+		    b, size) != got) {
+			fprintf (stderr, "Can't decode tile %lu.\n",
+				 (unsigned long) t);
+			goto failure;
+		}
+		if (memcmp(a, b, got) != 0) {
+			fprintf (stderr, "Tile %lu differs.\n", (unsigned long) t);
+			goto failure;
+		}
+		if (memcmp(raw, copy, (size_t) info.bytecount) != 0) {
+			fprintf (stderr, "Raw data of tile %lu was modified.\n",
+				 (unsigned long) t);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	free(a);
+	free(b);
+	free(raw);
+	free(copy);
+	return ret;
+}
+
+static int
+check_decode(const char* mode)
+{
+	TIFF* tif = TIFFOpen(filename, mode);
+	TIFF* ref = TIFFOpen(filename, "rm");
+	uint16 dir;
+	int ret = 0;
+
+	if (!tif || !ref) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	for (dir = 0; dir < 2; dir++) {
+		/* directories can still be changed after decoding */
+		if (!TIFFSetDirectory(tif, dir) || !TIFFSetDirectory(ref, dir)) {
+			fprintf (stderr, "Can't read directory %u (mode %s).\n",
+				 dir, mode);
+			goto failure;
+		}
+		if (!compare_tiles(tif, ref) || !compare_tiles(tif, ref)) {
+			fprintf (stderr, "Directory %u (mode %s) failed.\n",
+				 dir, mode);
+			goto failure;
+		}
+	}
+	if (TIFFDecodeChunk(tif, 0, NULL, 0, NULL, -1) != -1 ||
+	    TIFFDecodeChunk(tif, TIFFNumberOfTiles(tif), "x", 1, NULL, -1) != -1) {
+		fprintf (stderr, "Invalid arguments not rejected.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	if (ref)
+		TIFFClose(ref);
+	if (tif)
+		TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image())
+		return 1;
+	if (!check_decode("r") || !check_decode("rm") ||
+	    !check_decode("rO") || !check_decode("r+"))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
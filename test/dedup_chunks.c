@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that strips and tiles written in deduplicating mode ("D") with
+ * the same data share one copy in the file, and that rewriting one of
+ * them leaves the others alone.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "dedup_chunks.tif";
+
+#define	WIDTH		160
+#define	LENGTH		96
+#define	TILESIZE	32
+#define	ROWSPERSTRIP	8
+
+/* chunks come in four kinds, kind 0 being unique to each chunk */
+#define	KIND(t)		((t) % 5 < 2 ? 0 : (t) % 4)
+
+static void
+fill(unsigned char* buf, tmsize_t size, uint32 t)
+{
+	uint32 seed = KIND(t) ? KIND(t) * 1000 : t;
+	tmsize_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)((i / 3 + seed * 7 + (seed >> 3)) & 0xff);
+}
+
+static int
+write_file(const char* mode, int tiled, int how)
+{
+	TIFF* tif;
+	unsigned char** bufs;
+	tmsize_t* sizes;
+	uint32* list;
+	tmsize_t size;
+	uint32 n, t;
+	int ok = 1;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf(stderr, "Can't create %s\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION,
+	    how == 1 ? COMPRESSION_NONE : COMPRESSION_LZW);
+	if (tiled) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	} else
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	bufs = (unsigned char**) calloc(n, sizeof(unsigned char*));
+	sizes = (tmsize_t*) calloc(n, sizeof(tmsize_t));
+	list = (uint32*) calloc(n, sizeof(uint32));
+	if (!bufs || !sizes || !list)
+		ok = 0;
+	for (t = 0; ok && t < n; t++) {
+		bufs[t] = (unsigned char*) malloc(size);
+		if (!bufs[t]) {
+			ok = 0;
+			break;
+		}
+		fill(bufs[t], size, t);
+		sizes[t] = size;
+		list[t] = t;
+	}
+	/* 0: one by one, 1: uncompressed, 2: in parallel */
+	if (ok && how == 2)
+		ok = tiled ? TIFFWriteEncodedTilesParallel(tif, list, n,
+		    (void**) bufs, sizes, 3) :
+		    TIFFWriteEncodedStripsParallel(tif, list, n,
+		    (void**) bufs, sizes, 3);
+	for (t = 0; ok && how != 2 && t < n; t++)
+		if ((tiled ? TIFFWriteEncodedTile(tif, t, bufs[t], size) :
+		    TIFFWriteEncodedStrip(tif, t, bufs[t], size)) != size)
+			ok = 0;
+	if (!ok)
+		fprintf(stderr, "Can't write %s\n", filename);
+	for (t = 0; bufs && t < n; t++)
+		free(bufs[t]);
+	free(bufs);
+	free(sizes);
+	free(list);
+	TIFFClose(tif);
+	return ok;
+}
+
+/*
+ * Check the data, and that chunks share their offsets exactly when they
+ * have the same kind; return the file size in *fsize.
+ */
+static int
+check_file(const char* label, int tiled, int dedup, uint32 changed,
+    uint64* fsize)
+{
+	TIFF* tif;
+	unsigned char* buf;
+	unsigned char* ref;
+	tmsize_t size;
+	uint32 n, t, u;
+	int ok = 1;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf(stderr, "%s: Can't open %s\n", label, filename);
+		return 0;
+	}
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	buf = (unsigned char*) malloc(size);
+	ref = (unsigned char*) malloc(size);
+	if (!buf || !ref) {
+		fprintf(stderr, "%s: Out of memory\n", label);
+		ok = 0;
+		goto done;
+	}
+	for (t = 0; t < n; t++) {
+		if (t == changed)
+			memset(ref, 0x5A, size);
+		else
+			fill(ref, size, t);
+		if ((tiled ? TIFFReadEncodedTile(tif, t, buf, size) :
+		    TIFFReadEncodedStrip(tif, t, buf, size)) != size ||
+		    memcmp(buf, ref, size) != 0) {
+			fprintf(stderr, "%s: Chunk %lu reads back wrong\n",
+			    label, (unsigned long) t);
+			ok = 0;
+		}
+		for (u = 0; u < t; u++) {
+			int same = KIND(t) != 0 && KIND(t) == KIND(u) &&
+			    t != changed && u != changed;
+			int shared = TIFFGetStrileOffset(tif, t) ==
+			    TIFFGetStrileOffset(tif, u);
+
+			if (shared != (same && dedup)) {
+				fprintf(stderr,
+				    "%s: Chunks %lu and %lu %s their data\n",
+				    label, (unsigned long) u, (unsigned long) t,
+				    shared ? "share" : "do not share");
+				ok = 0;
+			}
+		}
+	}
+done:
+	free(buf);
+	free(ref);
+	TIFFClose(tif);
+	if (ok) {
+		FILE* fp = fopen(filename, "rb");
+
+		if (!fp || fseek(fp, 0, SEEK_END) != 0)
+			ok = 0;
+		else
+			*fsize = (uint64) ftell(fp);
+		if (fp)
+			fclose(fp);
+	}
+	return ok;
+}
+
+/*
+ * Rewrite a chunk that shares its data in update mode.
+ */
+static int
+rewrite_chunk(int tiled, uint32 t)
+{
+	TIFF* tif;
+	unsigned char* buf;
+	tmsize_t size;
+	int ok;
+
+	tif = TIFFOpen(filename, "r+D");
+	if (!tif)
+		return 0;
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	buf = (unsigned char*) malloc(size);
+	if (!buf) {
+		TIFFClose(tif);
+		return 0;
+	}
+	memset(buf, 0x5A, size);
+	ok = (tiled ? TIFFWriteEncodedTile(tif, t, buf, size) :
+	    TIFFWriteEncodedStrip(tif, t, buf, size)) == size;
+	free(buf);
+	TIFFClose(tif);
+	return ok;
+}
+
+int
+main()
+{
+	static const char* hows[] = { "lzw", "none", "parallel" };
+	int ret = 0, tiled, how;
+
+	for (tiled = 0; tiled <= 1; tiled++)
+		for (how = 0; how < 3; how++) {
+			char label[64];
+			uint64 full, deduped;
+
+			sprintf(label, "%s/%s", tiled ? "tiles" : "strips",
+			    hows[how]);
+			if (!write_file("w", tiled, how) ||
+			    !check_file(label, tiled, 0, (uint32) -1, &full) ||
+			    !write_file("wD", tiled, how) ||
+			    !check_file(label, tiled, 1, (uint32) -1, &deduped)) {
+				ret = 1;
+				continue;
+			}
+			if (deduped >= full) {
+				fprintf(stderr, "%s: File did not shrink\n",
+				    label);
+				ret = 1;
+			}
+			/* chunk 3 has the data of chunk 7 */
+			if (!rewrite_chunk(tiled, 3) ||
+			    !check_file(label, tiled, 1, 3, &deduped))
+				ret = 1;
+		}
+
+	if (ret == 0)
+		unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that tags deferred by the TIFFOpen() 'F' flag read back the
+ * same as with a normal open.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "deferred_tags.tif";
+static const char description[] = "deferred tags test";
+static const char artist[] = "libtiff";
+
+#define	WIDTH		64
+#define	LENGTH		32
+#define	ICCSIZE		5000
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	uint32 row;
+
+	(void) arg;
+	for (row = 0; row < c->length; row++)
+		memset(c->buf + row * c->rowsize, (int) (c->y + row),
+		       c->rowsize);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, 8, 0, 0 };
+	TIFF* tif;
+	unsigned char icc[ICCSIZE];
+	uint32 i;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (i = 0; i < ICCSIZE; i++)
+		icc[i] = (unsigned char)(i * 7);
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, description);
+	TIFFSetField(tif, TIFFTAG_ARTIST, artist);
+	TIFFSetField(tif, TIFFTAG_ICCPROFILE, (uint32) ICCSIZE, icc);
+	ok = write_image_data(tif, fill_strip, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+check_image(void)
+{
+	TIFF* ref;
+	TIFF* tif;
+	unsigned char a[WIDTH], b[WIDTH];
+	uint32 width = 0, count = 0, refcount = 0;
+	void *icc = NULL, *reficc = NULL;
+	char* value = NULL;
+	int ret = 0;
+
+	ref = TIFFOpen(filename, "r");
+	tif = TIFFOpen(filename, "rF");
+	if (!ref || !tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	if (!TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width) || width != WIDTH) {
+		fprintf (stderr, "Wrong ImageWidth.\n");
+		goto failure;
+	}
+	if (TIFFReadScanline(tif, a, 5, 0) == -1 ||
+	    TIFFReadScanline(ref, b, 5, 0) == -1 ||
+	    memcmp(a, b, sizeof(a)) != 0) {
+		fprintf (stderr, "Image data differs.\n");
+		goto failure;
+	}
+	if (!TIFFGetField(tif, TIFFTAG_ICCPROFILE, &count, &icc) ||
+	    !TIFFGetField(ref, TIFFTAG_ICCPROFILE, &refcount, &reficc) ||
+	    count != refcount || memcmp(icc, reficc, count) != 0) {
+		fprintf (stderr, "ICC profile differs.\n");
+		goto failure;
+	}
+	/* A value set by the application replaces the one in the file */
+	if (!TIFFSetField(tif, TIFFTAG_ARTIST, "someone else") ||
+	    !TIFFGetField(tif, TIFFTAG_ARTIST, &value) ||
+	    strcmp(value, "someone else") != 0) {
+		fprintf (stderr, "Artist was not replaced.\n");
+		goto failure;
+	}
+	if (TIFFGetTagListCount(tif) != TIFFGetTagListCount(ref)) {
+		fprintf (stderr, "Tag list count differs: %d instead of %d.\n",
+			 TIFFGetTagListCount(tif), TIFFGetTagListCount(ref));
+		goto failure;
+	}
+	if (!TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &value) ||
+	    strcmp(value, description) != 0) {
+		fprintf (stderr, "ImageDescription differs.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	if (ref)
+		TIFFClose(ref);
+	if (tif)
+		TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image() || !check_image())
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that Deflate compressed strips and tiles round trip both when
+ * written and read whole and when accessed a scanline at a time, that
+ * TIFFTAG_ZIPQUALITY range checking matches the build, and that a big
+ * strip compressed in blocks on several threads with TIFFTAG_ZIP_THREADS
+ * reads back and stays about as small.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "deflate.tif";
+
+#define	WIDTH		300
+#define	LENGTH		250
+#define	ROWSPERSTRIP	16
+#define	TILESIZE	64
+
+static void
+fill_image(unsigned char* buf, tmsize_t size)
+{
+	uint32 seed = 1234;
+	tmsize_t i;
+
+	for (i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		if ((i / 4000) % 3 == 0)
+			buf[i] = (unsigned char) (seed >> 16);
+		else
+			buf[i] = (unsigned char) (i % WIDTH / 3);
+	}
+}
+
+static TIFF*
+create_image(int quality, int tiled)
+{
+	TIFF* tif = TIFFOpen(filename, "w");
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return NULL;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+	if (!TIFFSetField(tif, TIFFTAG_ZIPQUALITY, quality)) {
+		fprintf (stderr, "ZipQuality %d refused.\n", quality);
+		TIFFClose(tif);
+		return NULL;
+	}
+	if (tiled) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	} else
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	return tif;
+}
+
+/*
+ * Write the image with whole chunk or scanline calls, read it back
+ * both ways and compare.
+ */
+static int
+round_trip(const unsigned char* image, int quality, int tiled,
+	   int scanlines)
+{
+	TIFF* tif;
+	unsigned char* buf;
+	tmsize_t size;
+	uint32 row, x, y, n;
+	int ret = 0;
+
+	tif = create_image(quality, tiled);
+	if (!tif)
+		return 0;
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	buf = (unsigned char*) malloc(size);
+	if (!buf)
+		goto failure;
+	if (tiled) {
+		for (y = 0; y < LENGTH; y += TILESIZE)
+			for (x = 0; x < WIDTH; x += TILESIZE) {
+				for (row = 0; row < TILESIZE; row++) {
+					uint32 w = TILESIZE;
+
+					memset(buf + row * TILESIZE, 0, TILESIZE);
+					if (y + row >= LENGTH)
+						continue;
+					if (x + w > WIDTH)
+						w = WIDTH - x;
+					memcpy(buf + row * TILESIZE,
+					       image + (y + row) * WIDTH + x, w);
+				}
+				if (TIFFWriteTile(tif, buf, x, y, 0, 0) == -1) {
+					fprintf (stderr, "Can't write tile.\n");
+					goto failure;
+				}
+			}
+	} else if (scanlines) {
+		for (row = 0; row < LENGTH; row++)
+			if (TIFFWriteScanline(tif, (void*) (image + row * WIDTH),
+					      row, 0) == -1) {
+				fprintf (stderr, "Can't write row %lu.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+	} else {
+		n = TIFFNumberOfStrips(tif);
+		for (row = 0; row < n; row++) {
+			tmsize_t cc = size;
+
+			if ((row + 1) * ROWSPERSTRIP > LENGTH)
+				cc = (LENGTH - row * ROWSPERSTRIP) * WIDTH;
+			if (TIFFWriteEncodedStrip(tif, row,
+			    (void*) (image + row * ROWSPERSTRIP * WIDTH),
+			    cc) == -1) {
+				fprintf (stderr, "Can't write strip %lu.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+		}
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	if (tiled) {
+		for (y = 0; y < LENGTH; y += TILESIZE)
+			for (x = 0; x < WIDTH; x += TILESIZE) {
+				if (TIFFReadTile(tif, buf, x, y, 0, 0) == -1) {
+					fprintf (stderr, "Can't read tile.\n");
+					goto failure;
+				}
+				for (row = 0; row < TILESIZE && y + row < LENGTH; row++) {
+					uint32 w = TILESIZE;
+
+					if (x + w > WIDTH)
+						w = WIDTH - x;
+					if (memcmp(buf + row * TILESIZE,
+					    image + (y + row) * WIDTH + x, w) != 0) {
+						fprintf (stderr, "Tile at %lu,%lu differs.\n",
+							 (unsigned long) x,
+							 (unsigned long) y);
+						goto failure;
+					}
+				}
+			}
+	} else {
+		n = TIFFNumberOfStrips(tif);
+		for (row = 0; row < n; row++) {
+			tmsize_t got = TIFFReadEncodedStrip(tif, row, buf, -1);
+
+			if (got == -1 ||
+			    memcmp(buf, image + row * ROWSPERSTRIP * WIDTH,
+				   got) != 0) {
+				fprintf (stderr, "Strip %lu differs.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+		}
+		for (row = 0; row < LENGTH; row++)
+			if (TIFFReadScanline(tif, buf, row, 0) == -1 ||
+			    memcmp(buf, image + row * WIDTH, WIDTH) != 0) {
+				fprintf (stderr, "Row %lu differs.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+	}
+	ret = 1;
+
+failure:
+	free(buf);
+	if (tif)
+		TIFFClose(tif);
+	return ret;
+}
+
+#define	BIGWIDTH	1024
+#define	BIGLENGTH	1100
+
+/*
+ * Write image, BIGWIDTH by BIGLENGTH, as a single strip with threads
+ * encoder threads and read it back; return the size of the strip, or 0.
+ */
+static uint64
+one_strip(const unsigned char* image, int quality, int threads)
+{
+	TIFF* tif = TIFFOpen(filename, "w");
+	unsigned char* buf = NULL;
+	tmsize_t size = (tmsize_t) BIGWIDTH * BIGLENGTH;
+	uint64 ret = 0;
+	uint32 row;
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, BIGWIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, BIGLENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, BIGLENGTH);
+	TIFFSetField(tif, TIFFTAG_ZIPQUALITY, quality);
+	if (!TIFFSetField(tif, TIFFTAG_ZIP_THREADS, threads) ||
+	    TIFFWriteEncodedStrip(tif, 0, (void*) image, size) != size) {
+		fprintf (stderr, "Can't write the strip on %d threads.\n",
+			 threads);
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	buf = (unsigned char*) malloc(size);
+	if (!tif || !buf)
+		goto failure;
+	/* through the zlib streaming interface, and in one go */
+	for (row = 0; row < BIGLENGTH; row++)
+		if (TIFFReadScanline(tif, buf, row, 0) == -1 ||
+		    memcmp(buf, image + row * BIGWIDTH, BIGWIDTH) != 0) {
+			fprintf (stderr, "Row %lu written on %d threads "
+				 "differs.\n", (unsigned long) row, threads);
+			goto failure;
+		}
+	if (TIFFReadEncodedStrip(tif, 0, buf, size) != size ||
+	    memcmp(buf, image, size) != 0) {
+		fprintf (stderr, "Strip written on %d threads differs.\n",
+			 threads);
+		goto failure;
+	}
+	ret = TIFFGetStrileByteCount(tif, 0);
+
+failure:
+	free(buf);
+	if (tif)
+		TIFFClose(tif);
+	return ret;
+}
+
+static int
+test_threads(void)
+{
+	static const int qualities[] = { -1, 0, 1, 9 };
+	unsigned char* image;
+	uint64 single, blocks;
+	size_t i;
+	int ret = 0;
+
+	image = (unsigned char*) malloc((size_t) BIGWIDTH * BIGLENGTH);
+	if (!image)
+		return 0;
+	fill_image(image, (tmsize_t) BIGWIDTH * BIGLENGTH);
+	for (i = 0; i < sizeof(qualities) / sizeof(qualities[0]); i++) {
+		single = one_strip(image, qualities[i], 0);
+		blocks = one_strip(image, qualities[i], 4);
+		if (!single || !blocks || blocks > single + single / 50) {
+			fprintf (stderr, "Level %d: %lu bytes on 4 threads, "
+				 "%lu on one.\n", qualities[i],
+				 (unsigned long) blocks,
+				 (unsigned long) single);
+			goto failure;
+		}
+	}
+	/* more threads than 128 KiB blocks */
+	if (!one_strip(image, -1, 64))
+		goto failure;
+	ret = 1;
+
+failure:
+	free(image);
+	return ret;
+}
+
+int
+main()
+{
+	static const int qualities[] = { -1, 0, 1, 6, 9 };
+	unsigned char* image;
+	TIFF* tif;
+	size_t i;
+	int tiled;
+
+	image = (unsigned char*) malloc((size_t) WIDTH * LENGTH);
+	if (!image)
+		return 1;
+	fill_image(image, (tmsize_t) WIDTH * LENGTH);
+	for (i = 0; i < sizeof(qualities) / sizeof(qualities[0]); i++)
+		for (tiled = 0; tiled < 2; tiled++)
+			if (!round_trip(image, qualities[i], tiled, 0))
+				goto failure;
+	if (!round_trip(image, -1, 0, 1))
+		goto failure;
+#if LIBDEFLATE_SUPPORT
+	if (!round_trip(image, 12, 0, 0) || !round_trip(image, 12, 0, 1) ||
+	    !round_trip(image, 12, 1, 0))
+		goto failure;
+#else
+	tif = create_image(12, 0);
+	if (tif) {
+		fprintf (stderr, "ZipQuality 12 accepted without libdeflate.\n");
+		TIFFClose(tif);
+		goto failure;
+	}
+#endif
+	tif = create_image(13, 0);
+	if (tif) {
+		fprintf (stderr, "ZipQuality 13 accepted.\n");
+		TIFFClose(tif);
+		goto failure;
+	}
+	if (!test_threads())
+		goto failure;
+	free(image);
+	unlink(filename);
+	return 0;
+
+failure:
+	free(image);
+	return 1;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFDigestDirectory() gives the xxHash of the packed
+ * image data, whatever the compression, layout and padding bits.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "digest.tif";
+
+#define	WIDTH		157
+#define	LENGTH		61
+
+/* Known value of the 64-bit xxHash with seed 0 */
+static const char phrase[] = "Nobody inspects the spammish repetition";
+#define	PHRASE_DIGEST_HI	0xfbcea83cUL
+#define	PHRASE_DIGEST_LO	0x8a378bf1UL
+
+static unsigned char
+pixel(uint32 col, uint32 row, uint16 s)
+{
+	return (unsigned char)((col * 5 + row * 11 + s * 83) & 0xff);
+}
+
+typedef struct {
+	uint16	bps;
+	uint32	changed;
+	int	fill;
+} DigestFill;
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	const DigestFill* f = (const DigestFill*) arg;
+	uint32 x, y, v;
+	int i;
+
+	memset(c->buf, f->fill, c->size);
+	for (y = 0; y < c->length && c->y + y < LENGTH; y++) {
+		unsigned char* row = c->buf + y * c->rowsize;
+
+		for (x = 0; x < c->width && c->x + x < WIDTH; x++)
+			for (i = 0; i < c->samples; i++) {
+				v = pixel(c->x + x, c->y + y,
+				    (uint16)(c->plane + i));
+				if (c->x + x == f->changed && c->y + y == 1)
+					v ^= 0x80;
+				if (f->bps == 8)
+					row[x * c->samples + i] =
+					    (unsigned char) v;
+				else if (v & 0x80)
+					row[x / 8] |= (unsigned char)
+					    (0x80 >> (x % 8));
+				else
+					row[x / 8] &= (unsigned char)
+					    ~(0x80 >> (x % 8));
+			}
+	}
+}
+
+/*
+ * Write an image of bps bits (8 or 1) with spp samples, in strips of
+ * rowsperstrip rows or tiles of tilesize pixels, filling any padding
+ * bits with fill.  The pixel at changed (if below WIDTH) gets another
+ * value.
+ */
+static int
+write_image(uint16 bps, uint16 spp, uint16 planar, uint16 compression,
+	    uint32 rowsperstrip, uint32 tilesize, uint32 changed, int fill)
+{
+	TestImage im = { WIDTH, LENGTH, 0, 0, 0, PHOTOMETRIC_MINISBLACK,
+	    0, 0, 0, 0 };
+	DigestFill f;
+
+	im.bitspersample = f.bps = bps;
+	im.samplesperpixel = spp;
+	im.planarconfig = planar;
+	if (spp == 3)
+		im.photometric = PHOTOMETRIC_RGB;
+	im.compression = compression;
+	im.rowsperstrip = rowsperstrip;
+	im.tilewidth = im.tilelength = tilesize;
+	f.changed = changed;
+	f.fill = fill;
+	return write_test_image(filename, &im, fill_chunk, &f);
+}
+
+static int
+image_digest(uint64* digest, int nthreads)
+{
+	TIFF* tif;
+	int ret;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	ret = TIFFDigestDirectory(tif, digest, nthreads);
+	if (!ret)
+		fprintf (stderr, "Can't digest %s.\n", filename);
+	TIFFClose(tif);
+	return ret;
+}
+
+static int
+check_layouts(uint16 bps, uint16 spp, uint16 planar)
+{
+	static const struct {
+		uint16	compression;
+		uint32	rowsperstrip;
+		uint32	tilesize;
+	} layouts[] = {
+		{ COMPRESSION_NONE, LENGTH, 0 },
+		{ COMPRESSION_LZW, 5, 0 },
+		{ COMPRESSION_PACKBITS, 1, 0 },
+		{ COMPRESSION_NONE, 0, 16 },
+		{ COMPRESSION_LZW, 0, 48 },
+	};
+	uint64 ref = 0, digest;
+	size_t i;
+
+	for (i = 0; i < sizeof (layouts) / sizeof (layouts[0]); i++) {
+		if (!write_image(bps, spp, planar, layouts[i].compression,
+		    layouts[i].rowsperstrip, layouts[i].tilesize, WIDTH,
+		    i % 2 ? 0xff : 0) ||
+		    !image_digest(&digest, (int) i))
+			return 0;
+		if (i == 0)
+			ref = digest;
+		else if (digest != ref) {
+			fprintf (stderr, "%d-bit image, layout %d: digests "
+				 "differ.\n", (int) bps, (int) i);
+			return 0;
+		}
+	}
+
+	/* Any changed pixel shows */
+	if (!write_image(bps, spp, planar, COMPRESSION_LZW, 5, 0, WIDTH - 1,
+	    0) ||
+	    !image_digest(&digest, 0))
+		return 0;
+	if (digest == ref) {
+		fprintf (stderr, "%d-bit image: change is not seen.\n",
+			 (int) bps);
+		return 0;
+	}
+	return 1;
+}
+
+static int
+check_phrase(void)
+{
+	TIFF* tif;
+	uint64 digest;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, (uint32) strlen(phrase));
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, 1);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1);
+	if (TIFFWriteEncodedStrip(tif, 0, (void*) phrase,
+	    (tmsize_t) strlen(phrase)) == -1) {
+		TIFFClose(tif);
+		return 0;
+	}
+	TIFFClose(tif);
+	if (!image_digest(&digest, 1))
+		return 0;
+	if ((uint32) (digest >> 32) != PHRASE_DIGEST_HI ||
+	    (uint32) digest != PHRASE_DIGEST_LO) {
+		fprintf (stderr, "Wrong digest %08lx%08lx.\n",
+			 (unsigned long) (digest >> 32),
+			 (unsigned long) (uint32) digest);
+		return 0;
+	}
+	return 1;
+}
+
+int
+main()
+{
+	if (!check_phrase())
+		return 1;
+	if (!check_layouts(8, 3, PLANARCONFIG_CONTIG) ||
+	    !check_layouts(8, 3, PLANARCONFIG_SEPARATE) ||
+	    !check_layouts(1, 1, PLANARCONFIG_CONTIG))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
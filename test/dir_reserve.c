@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that directories with space set aside by
+ * TIFFReserveDirectorySpace() are checkpointed in place while an image
+ * grows, and moved to the end of the file once they no longer fit.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "dir_reserve.tif";
+
+#define	WIDTH		64
+#define	BATCH		16
+#define	NBATCHES	10
+#define	RESERVE		4096
+
+static unsigned char
+pixel(uint16 dirn, uint32 row, uint32 col)
+{
+	return (unsigned char)((row * 3 + col * 5 + dirn * 17) & 0xff);
+}
+
+static void
+silent_handler(const char* module, const char* fmt, va_list ap)
+{
+	(void) module;
+	(void) fmt;
+	(void) ap;
+}
+
+/*
+ * Write ndirs images of growing length, checkpointing each after every
+ * batch of rows.  Returns the offset of the first directory.
+ */
+static uint64
+write_file(tmsize_t reserve, uint16 ndirs)
+{
+	TIFF* tif;
+	unsigned char buf[WIDTH];
+	uint64 first = 0, diroff = 0;
+	uint32 row, col, batch;
+	uint16 dirn;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (dirn = 0; dirn < ndirs; dirn++) {
+		TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+		TIFFSetField(tif, TIFFTAG_IMAGELENGTH, 1);
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+		TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1);
+		if (!TIFFReserveDirectorySpace(tif, reserve)) {
+			fprintf (stderr, "Can't reserve directory space.\n");
+			goto failure;
+		}
+		for (row = 0, batch = 0; batch < NBATCHES; batch++) {
+			for (; row < (batch + 1) * BATCH; row++) {
+				for (col = 0; col < WIDTH; col++)
+					buf[col] = pixel(dirn, row, col);
+				if (TIFFWriteScanline(tif, buf, row, 0) == -1) {
+					fprintf (stderr, "Can't write row %lu.\n",
+						 (unsigned long) row);
+					goto failure;
+				}
+			}
+			if (!TIFFCheckpointDirectory(tif)) {
+				fprintf (stderr, "Can't checkpoint directory.\n");
+				goto failure;
+			}
+			if (batch == 0)
+				diroff = TIFFCurrentDirOffset(tif);
+			else if (TIFFCurrentDirOffset(tif) != diroff &&
+				 reserve >= RESERVE) {
+				fprintf (stderr, "Directory %d moved from "
+					 "%lu to %lu.\n", dirn,
+					 (unsigned long) diroff,
+					 (unsigned long) TIFFCurrentDirOffset(tif));
+				goto failure;
+			}
+		}
+		if (dirn == 0)
+			first = TIFFCurrentDirOffset(tif);
+		if (!TIFFWriteDirectory(tif)) {
+			fprintf (stderr, "Can't write directory.\n");
+			goto failure;
+		}
+	}
+	TIFFClose(tif);
+	return first;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+static int
+check_file(uint16 ndirs, uint64 first)
+{
+	TIFF* tif;
+	unsigned char buf[WIDTH];
+	uint32 length, row, col;
+	uint16 dirn;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (TIFFCurrentDirOffset(tif) != first) {
+		fprintf (stderr, "First directory at %lu, expected %lu.\n",
+			 (unsigned long) TIFFCurrentDirOffset(tif),
+			 (unsigned long) first);
+		goto failure;
+	}
+	for (dirn = 0; dirn < ndirs; dirn++) {
+		if (dirn > 0 && !TIFFReadDirectory(tif)) {
+			fprintf (stderr, "Can't read directory %d.\n", dirn);
+			goto failure;
+		}
+		if (!TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &length) ||
+		    length != BATCH * NBATCHES) {
+			fprintf (stderr, "Directory %d has wrong length.\n",
+				 dirn);
+			goto failure;
+		}
+		for (row = 0; row < length; row++) {
+			if (TIFFReadScanline(tif, buf, row, 0) == -1) {
+				fprintf (stderr, "Can't read row %lu.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+			for (col = 0; col < WIDTH; col++)
+				if (buf[col] != pixel(dirn, row, col)) {
+					fprintf (stderr, "Directory %d, row "
+						 "%lu differs.\n", dirn,
+						 (unsigned long) row);
+					goto failure;
+				}
+		}
+	}
+	if (TIFFReadDirectory(tif)) {
+		fprintf (stderr, "Unexpected extra directory.\n");
+		goto failure;
+	}
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+static long
+file_size(void)
+{
+	FILE* fd;
+	long size;
+
+	fd = fopen(filename, "rb");
+	if (!fd)
+		return -1;
+	fseek(fd, 0, SEEK_END);
+	size = ftell(fd);
+	fclose(fd);
+	return size;
+}
+
+int
+main()
+{
+	uint64 first;
+	long expected;
+
+	/* Every checkpoint fits: nothing beyond the reserves and data */
+	first = write_file(RESERVE, 2);
+	if (!first || !check_file(2, first))
+		return 1;
+	if (first != 8) {
+		fprintf (stderr, "First directory not at its reserve.\n");
+		return 1;
+	}
+	expected = 8 + 2 * ((long) RESERVE + BATCH * NBATCHES * WIDTH);
+	if (file_size() != expected) {
+		fprintf (stderr, "File is %ld bytes, expected %ld.\n",
+			 file_size(), expected);
+		return 1;
+	}
+
+	/* The strip arrays outgrow a small reserve */
+	TIFFSetWarningHandler(silent_handler);
+	first = write_file(256, 2);
+	if (!first || !check_file(2, first))
+		return 1;
+	if (first == 8) {
+		fprintf (stderr, "Directory did not leave its reserve.\n");
+		return 1;
+	}
+
+	/* Too small for even an empty directory */
+	TIFFSetErrorHandler(silent_handler);
+	{
+		TIFF* tif = TIFFOpen(filename, "w");
+		if (!tif)
+			return 1;
+		if (TIFFReserveDirectorySpace(tif, 2)) {
+			fprintf (stderr, "Tiny reserve was accepted.\n");
+			TIFFClose(tif);
+			return 1;
+		}
+		TIFFClose(tif);
+	}
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that the out-of-line tag data of a directory read from a
+ * file that is not memory mapped is fetched in few read calls, and
+ * that the values are unaffected by it.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "dirdata_batch.tif";
+
+#define	WIDTH		16
+#define	LENGTH		16
+#define	MAXREADCALLS	6	/* header, directory and its data */
+
+static const struct {
+	ttag_t		tag;
+	const char*	value;
+} asciitags[] = {
+	{ TIFFTAG_DOCUMENTNAME, "dirdata_batch document" },
+	{ TIFFTAG_IMAGEDESCRIPTION, "Image with many out-of-line tags" },
+	{ TIFFTAG_MAKE, "libtiff test suite" },
+	{ TIFFTAG_MODEL, "dirdata_batch model" },
+	{ TIFFTAG_PAGENAME, "first and only page" },
+	{ TIFFTAG_SOFTWARE, "dirdata_batch.c" },
+	{ TIFFTAG_DATETIME, "2026:10:14 12:00:00" },
+	{ TIFFTAG_ARTIST, "Sam Leffler" },
+	{ TIFFTAG_HOSTCOMPUTER, "localhost.localdomain" },
+	{ TIFFTAG_COPYRIGHT, "Copyright (c) 1988-1997 Sam Leffler" }
+};
+#define	NASCIITAGS	(sizeof(asciitags) / sizeof(asciitags[0]))
+
+static const struct {
+	ttag_t		tag;
+	float		value;
+} floattags[] = {
+	{ TIFFTAG_XRESOLUTION, 300.0f },
+	{ TIFFTAG_YRESOLUTION, 150.0f },
+	{ TIFFTAG_XPOSITION, 1.5f },
+	{ TIFFTAG_YPOSITION, 2.25f }
+};
+#define	NFLOATTAGS	(sizeof(floattags) / sizeof(floattags[0]))
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	(void) arg;
+	memset(c->buf, 0x55, c->size);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, LENGTH, 0, 0 };
+	TIFF* tif = TIFFOpen(filename, "w");
+	size_t i;
+	int ok;
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	set_image_fields(tif, &im);
+	for (i = 0; i < NASCIITAGS; i++)
+		TIFFSetField(tif, asciitags[i].tag, asciitags[i].value);
+	for (i = 0; i < NFLOATTAGS; i++)
+		TIFFSetField(tif, floattags[i].tag, floattags[i].value);
+	ok = write_image_data(tif, fill_strip, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+check_image(const char* mode)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFFStatistics stats;
+	TIFF* tif;
+	size_t i;
+	int ret = 0;
+
+	if (!opts)
+		return 0;
+	TIFFOpenOptionsSetStatistics(opts, 1);
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	(void) TIFFGetStatistics(tif, &stats);
+	for (i = 0; i < NASCIITAGS; i++) {
+		char* value;
+
+		if (!TIFFGetField(tif, asciitags[i].tag, &value) ||
+		    strcmp(value, asciitags[i].value) != 0) {
+			fprintf (stderr, "Mode %s: wrong value for tag %lu.\n",
+				 mode, (unsigned long) asciitags[i].tag);
+			goto failure;
+		}
+	}
+	for (i = 0; i < NFLOATTAGS; i++) {
+		float value;
+
+		if (!TIFFGetField(tif, floattags[i].tag, &value) ||
+		    value != floattags[i].value) {
+			fprintf (stderr, "Mode %s: wrong value for tag %lu.\n",
+				 mode, (unsigned long) floattags[i].tag);
+			goto failure;
+		}
+	}
+	if (strchr(mode, 'm') && stats.readcalls > MAXREADCALLS) {
+		fprintf (stderr,
+			 "Reading the directory made %lu read calls, "
+			 "expected at most %d.\n",
+			 (unsigned long) stats.readcalls, MAXREADCALLS);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image())
+		return 1;
+	if (!check_image("rm") || !check_image("r"))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that files written with TIFFOpenOptionsSetDirectIO() are the
+ * same as files written through the page cache, when writing images
+ * larger than the staging buffer, directories and updates.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char plainname[] = "direct_io_plain.tif";
+static const char directname[] = "direct_io.tif";
+
+#define	WIDTH		1000
+#define	LENGTH		1200
+#define	ROWSPERSTRIP	300
+#define	SMALLROWS	7
+
+static unsigned char
+pixel(uint16 dirn, uint32 row, uint32 col, int updated)
+{
+	return (unsigned char)((row * 5 + col * 3 + dirn * 71 + updated * 13) & 0xff);
+}
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	uint32 row, col;
+
+	for (row = 0; row < c->length; row++)
+		for (col = 0; col < c->width; col++)
+			c->buf[row * c->width + col] =
+			    pixel(*(uint16*) arg, c->y + row, col, 0);
+}
+
+static int
+write_image(TIFF* tif, uint16 dirn, uint32 rowsperstrip, uint16 compression)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, 0, PHOTOMETRIC_MINISBLACK,
+	    0, 0, 0, 0 };
+
+	im.compression = compression;
+	im.rowsperstrip = rowsperstrip;
+	set_image_fields(tif, &im);
+	return write_image_data(tif, fill_strip, &dirn) && TIFFWriteDirectory(tif);
+}
+
+/*
+ * Write an uncompressed image with strips larger than the staging
+ * buffer and a compressed one with small strips, then rewrite the
+ * strips of the first in place.
+ */
+static int
+write_file(const char* name, int direct)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	unsigned char* buf = (unsigned char*) malloc(WIDTH * ROWSPERSTRIP);
+	TIFF* tif = NULL;
+	uint32 row, col, strip;
+	int ret = 0;
+
+	if (!opts || !buf) {
+		fprintf (stderr, "Out of memory.\n");
+		goto done;
+	}
+	TIFFOpenOptionsSetDirectIO(opts, direct);
+	tif = TIFFOpenExt(name, "w", opts);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", name);
+		goto done;
+	}
+	if (!write_image(tif, 0, ROWSPERSTRIP, COMPRESSION_NONE) ||
+	    !write_image(tif, 1, SMALLROWS, COMPRESSION_LZW)) {
+		fprintf (stderr, "Can't write %s.\n", name);
+		goto done;
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpenExt(name, "r+", opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s for update.\n", name);
+		goto done;
+	}
+	for (strip = 0; strip < LENGTH / ROWSPERSTRIP; strip++) {
+		for (row = 0; row < ROWSPERSTRIP; row++)
+			for (col = 0; col < WIDTH; col++)
+				buf[row * WIDTH + col] = pixel(0,
+				    strip * ROWSPERSTRIP + row, col, 1);
+		if (TIFFWriteEncodedStrip(tif, strip, buf,
+		    WIDTH * ROWSPERSTRIP) == -1) {
+			fprintf (stderr, "Can't rewrite strip %lu of %s.\n",
+				 (unsigned long) strip, name);
+			goto done;
+		}
+	}
+	ret = 1;
+done:
+	if (tif)
+		TIFFClose(tif);
+	if (opts)
+		TIFFOpenOptionsFree(opts);
+	free(buf);
+	return ret;
+}
+
+static unsigned char*
+read_all(const char* name, long* size)
+{
+	FILE* f = fopen(name, "rb");
+	unsigned char* data = NULL;
+
+	if (!f)
+		return NULL;
+	if (fseek(f, 0, SEEK_END) == 0 && (*size = ftell(f)) > 0 &&
+	    fseek(f, 0, SEEK_SET) == 0 &&
+	    (data = (unsigned char*) malloc(*size)) != NULL &&
+	    fread(data, 1, *size, f) != (size_t) *size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+int
+main()
+{
+	unsigned char* plain = NULL;
+	unsigned char* direct = NULL;
+	long plainsize = 0, directsize = 0;
+	int ret = 1;
+
+	if (!write_file(plainname, 0) || !write_file(directname, 1))
+		goto done;
+	plain = read_all(plainname, &plainsize);
+	direct = read_all(directname, &directsize);
+	if (!plain || !direct) {
+		fprintf (stderr, "Can't read back the files.\n");
+		goto done;
+	}
+	if (plainsize != directsize ||
+	    memcmp(plain, direct, (size_t) plainsize) != 0) {
+		fprintf (stderr, "File written with direct I/O differs.\n");
+		goto done;
+	}
+	ret = 0;
+done:
+	free(plain);
+	free(direct);
+	unlink(plainname);
+	unlink(directname);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that directories kept by TIFFSetDirectoryCache() read the same
+ * pixels and tags as directories read from the file, for strips and
+ * tiles and several codecs, and that a directory changed after it was
+ * read is read again.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "directory_cache.tif";
+
+#define	NDIRS		4
+#define	MAXSIZE		(160 * 120)
+
+static const struct {
+	uint32 width, length;
+	uint16 compression;
+	uint16 predictor;
+	int tiled;
+} dirs[NDIRS] = {
+	{ 160, 120, COMPRESSION_LZW, PREDICTOR_HORIZONTAL, 0 },
+	{ 80, 64, COMPRESSION_ADOBE_DEFLATE, PREDICTOR_NONE, 1 },
+	{ 40, 30, COMPRESSION_PACKBITS, PREDICTOR_NONE, 0 },
+	{ 32, 16, COMPRESSION_NONE, PREDICTOR_NONE, 1 }
+};
+
+static unsigned char
+pixel(int d, uint32 x, uint32 y)
+{
+	return (unsigned char)((x * (d + 3) + y * 7 + (x * y) / 5) & 0xff);
+}
+
+static uint16
+compression(int d)
+{
+	return TIFFIsCODECConfigured(dirs[d].compression) ?
+	    dirs[d].compression : COMPRESSION_NONE;
+}
+
+static int
+write_file(void)
+{
+	static unsigned char buf[MAXSIZE];
+	TIFF* tif;
+	uint32 x, y;
+	int d;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (d = 0; d < NDIRS; d++) {
+		uint32 w = dirs[d].width, l = dirs[d].length;
+
+		TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, w);
+		TIFFSetField(tif, TIFFTAG_IMAGELENGTH, l);
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+		TIFFSetField(tif, TIFFTAG_COMPRESSION, compression(d));
+		if (compression(d) == dirs[d].compression &&
+		    dirs[d].predictor != PREDICTOR_NONE)
+			TIFFSetField(tif, TIFFTAG_PREDICTOR, dirs[d].predictor);
+		if (d > 0)
+			TIFFSetField(tif, TIFFTAG_SUBFILETYPE,
+				     FILETYPE_REDUCEDIMAGE);
+		if (dirs[d].tiled) {
+			TIFFSetField(tif, TIFFTAG_TILEWIDTH, w);
+			TIFFSetField(tif, TIFFTAG_TILELENGTH, l);
+		} else
+			TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 16);
+		for (y = 0; y < l; y++)
+			for (x = 0; x < w; x++)
+				buf[y * w + x] = pixel(d, x, y);
+		if (dirs[d].tiled) {
+			if (TIFFWriteEncodedTile(tif, 0, buf, w * l) == -1) {
+				fprintf (stderr, "Can't write directory %d.\n", d);
+				TIFFClose(tif);
+				return 0;
+			}
+		} else {
+			for (y = 0; y < l; y++) {
+				if (TIFFWriteScanline(tif, buf + y * w, y, 0) == -1) {
+					fprintf (stderr,
+						 "Can't write directory %d.\n", d);
+					TIFFClose(tif);
+					return 0;
+				}
+			}
+		}
+		if (!TIFFWriteDirectory(tif)) {
+			fprintf (stderr, "Can't write directory %d.\n", d);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+/* Switch to directory d and check its tags and pixels */
+static int
+check_dir(TIFF* tif, int d)
+{
+	static unsigned char buf[MAXSIZE];
+	uint32 w, l, x, y;
+	uint16 c;
+
+	if (!TIFFSetDirectory(tif, (uint16) d)) {
+		fprintf (stderr, "Can't set directory %d.\n", d);
+		return 0;
+	}
+	if (TIFFCurrentDirectory(tif) != d ||
+	    !TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &w) ||
+	    !TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &l) ||
+	    !TIFFGetField(tif, TIFFTAG_COMPRESSION, &c) ||
+	    w != dirs[d].width || l != dirs[d].length || c != compression(d) ||
+	    TIFFIsTiled(tif) != dirs[d].tiled ||
+	    TIFFLastDirectory(tif) != (d == NDIRS - 1)) {
+		fprintf (stderr, "Wrong tags in directory %d.\n", d);
+		return 0;
+	}
+	if (dirs[d].tiled) {
+		if (TIFFReadEncodedTile(tif, 0, buf, w * l) != (tmsize_t)(w * l)) {
+			fprintf (stderr, "Can't read directory %d.\n", d);
+			return 0;
+		}
+	} else {
+		/* scanlines, so that the decoder state is carried along */
+		for (y = 0; y < l; y++) {
+			if (TIFFReadScanline(tif, buf + y * w, y, 0) == -1) {
+				fprintf (stderr, "Can't read directory %d.\n", d);
+				return 0;
+			}
+		}
+	}
+	for (y = 0; y < l; y++) {
+		for (x = 0; x < w; x++) {
+			if (buf[y * w + x] != pixel(d, x, y)) {
+				fprintf (stderr,
+					 "Wrong pixel at %lu,%lu of directory %d.\n",
+					 (unsigned long) x, (unsigned long) y, d);
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static int
+check_file(const char* mode)
+{
+	static const int order[] = { 0, 1, 0, 1, 2, 3, 0, 3, 3, 1, 2, 0 };
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFFStatistics stats;
+	TIFF* tif;
+	char* desc;
+	size_t i;
+	int ok = 0;
+
+	if (!opts)
+		return 0;
+	TIFFOpenOptionsSetStatistics(opts, 1);
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (!TIFFSetDirectoryCache(tif, 2)) {
+		fprintf (stderr, "TIFFSetDirectoryCache() failed.\n");
+		goto done;
+	}
+	for (i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+		if (!check_dir(tif, order[i]))
+			goto done;
+	(void) TIFFGetStatistics(tif, &stats);
+	/*
+	 * With room for two directories besides the current one, going
+	 * back to 0, 1, 3 and then 3 again finds them kept; the others
+	 * were pushed out, or are read the first time.
+	 */
+	if (stats.directoriesread != 13 || stats.directoriescached != 4) {
+		fprintf (stderr, "Read %lu directories, %lu from the cache.\n",
+			 (unsigned long) stats.directoriesread,
+			 (unsigned long) stats.directoriescached);
+		goto done;
+	}
+	/* A tag set after reading the directory is not kept */
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, "changed");
+	if (!check_dir(tif, 1) || !check_dir(tif, 0))
+		goto done;
+	if (TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &desc)) {
+		fprintf (stderr, "A changed directory was kept.\n");
+		goto done;
+	}
+	/* Nor is the cache kept when it is disabled */
+	if (!TIFFSetDirectoryCache(tif, 0) || !check_dir(tif, 2) ||
+	    !check_dir(tif, 0))
+		goto done;
+	ok = 1;
+done:
+	TIFFClose(tif);
+	return ok;
+}
+
+int
+main()
+{
+	TIFF* tif;
+	int ret = 1;
+
+	if (!write_file() || !check_file("r") || !check_file("rm"))
+		goto done;
+
+	/* Only read-only handles keep directories */
+	tif = TIFFOpen(filename, "r+");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s for update.\n", filename);
+		goto done;
+	}
+	if (TIFFSetDirectoryCache(tif, 2)) {
+		fprintf (stderr, "TIFFSetDirectoryCache() accepted a "
+			 "handle open for update.\n");
+		TIFFClose(tif);
+		goto done;
+	}
+	TIFFClose(tif);
+	ret = 0;
+done:
+	unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
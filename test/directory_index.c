@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check random access to the directories of a multi-page file through
+ * the directory offset index, and its export and import.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "directory_index.tif";
+
+#define	NPAGES		40
+#define	LENGTH		4
+
+static int
+write_page(TIFF* tif, uint32 page)
+{
+	unsigned char buf[NPAGES + 16];
+	uint32 width = page + 1, y;
+
+	memset(buf, (int) page, sizeof(buf));
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, LENGTH);
+	for (y = 0; y < LENGTH; y++)
+		if (TIFFWriteScanline(tif, buf, y, 0) == -1)
+			return 0;
+	return TIFFWriteDirectory(tif);
+}
+
+/*
+ * Pages are identified by their width.
+ */
+static int
+check_page(TIFF* tif, uint16 dirn)
+{
+	uint32 width;
+
+	if (!TIFFSetDirectory(tif, dirn)) {
+		fprintf (stderr, "Can't set directory %d.\n", (int) dirn);
+		return 0;
+	}
+	if (TIFFCurrentDirectory(tif) != dirn ||
+	    !TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width) ||
+	    width != (uint32) dirn + 1) {
+		fprintf (stderr, "Wrong page for directory %d.\n", (int) dirn);
+		return 0;
+	}
+	return 1;
+}
+
+static int
+check_random_access(TIFF* tif, uint16 npages)
+{
+	uint16 i;
+
+	/* Seek forward in large steps, then back and forth */
+	for (i = 0; i < npages; i += 7)
+		if (!check_page(tif, i))
+			return 0;
+	for (i = 0; i < npages; i++)
+		if (!check_page(tif, (uint16) ((i * 17) % npages)))
+			return 0;
+	if (TIFFSetDirectory(tif, npages)) {
+		fprintf (stderr, "Directory beyond the last one was set.\n");
+		return 0;
+	}
+	return check_page(tif, 0);
+}
+
+int
+main()
+{
+	uint64 offsets[NPAGES + 1];
+	uint64 bad[2];
+	TIFF* tif;
+	uint32 i;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 1;
+	}
+	for (i = 0; i < NPAGES; i++)
+		if (!write_page(tif, i)) {
+			fprintf (stderr, "Can't write page %lu.\n",
+				 (unsigned long) i);
+			TIFFClose(tif);
+			return 1;
+		}
+	/* The pages written are indexed as they are linked */
+	if (TIFFGetDirectoryIndex(tif, offsets, NPAGES + 1) != NPAGES ||
+	    TIFFNumberOfDirectories(tif) != NPAGES) {
+		fprintf (stderr, "Wrong directory index after writing.\n");
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	/* Index built on demand */
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 1;
+	}
+	if (!check_random_access(tif, NPAGES))
+		goto failure;
+	if (TIFFNumberOfDirectories(tif) != NPAGES) {
+		fprintf (stderr, "Wrong number of directories.\n");
+		goto failure;
+	}
+	if (TIFFGetDirectoryIndex(tif, offsets, NPAGES + 1) != NPAGES ||
+	    offsets[0] == 0) {
+		fprintf (stderr, "Wrong directory index.\n");
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	/* Index imported, and a mismatching one refused */
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 1;
+	}
+	bad[0] = offsets[0] + 1;
+	bad[1] = offsets[1];
+	if (TIFFSetDirectoryIndex(tif, bad, 2)) {
+		fprintf (stderr, "Mismatching directory index was accepted.\n");
+		goto failure;
+	}
+	if (!TIFFSetDirectoryIndex(tif, offsets, NPAGES) ||
+	    !check_page(tif, NPAGES - 1) || !check_random_access(tif, NPAGES))
+		goto failure;
+	TIFFClose(tif);
+
+	/* Appending a page extends the index */
+	tif = TIFFOpen(filename, "a");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s for appending.\n", filename);
+		return 1;
+	}
+	if (!TIFFBuildDirectoryIndex(tif) ||
+	    TIFFNumberOfDirectories(tif) != NPAGES) {
+		fprintf (stderr, "Wrong number of directories before appending.\n");
+		goto failure;
+	}
+	if (!write_page(tif, NPAGES)) {
+		fprintf (stderr, "Can't append a page.\n");
+		goto failure;
+	}
+	if (TIFFGetDirectoryIndex(tif, offsets, NPAGES + 1) != NPAGES + 1) {
+		fprintf (stderr, "Directory index not extended.\n");
+		goto failure;
+	}
+	if (TIFFNumberOfDirectories(tif) != NPAGES + 1) {
+		fprintf (stderr, "Wrong number of directories after appending.\n");
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 1;
+	}
+	/* Sequential reading records the offsets as well */
+	while (TIFFReadDirectory(tif))
+		;
+	if (TIFFGetDirectoryIndex(tif, offsets, NPAGES + 1) != NPAGES + 1 ||
+	    !check_random_access(tif, NPAGES + 1))
+		goto failure;
+	TIFFClose(tif);
+	unlink(filename);
+	return 0;
+
+failure:
+	TIFFClose(tif);
+	return 1;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
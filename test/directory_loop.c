@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that reading directories in sequence stops at a link back to a
+ * directory already read, each time the chain is walked again, and that
+ * chains longer than 65535 directories can be read through.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "directory_loop.tif";
+
+#define	NLOOP		5
+#define	NMANY		70000
+
+static int
+write_file(uint32 ndirs)
+{
+	TIFF* tif;
+	unsigned char pixel = 0;
+	uint32 d;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (d = 0; d < ndirs; d++) {
+		TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, 1);
+		TIFFSetField(tif, TIFFTAG_IMAGELENGTH, 1);
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1);
+		if (TIFFWriteScanline(tif, &pixel, 0, 0) == -1 ||
+		    !TIFFWriteDirectory(tif)) {
+			fprintf (stderr, "Can't write directory %lu.\n",
+				 (unsigned long) d);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+/* Count the directories read from the current one on */
+static uint32
+count_directories(TIFF* tif)
+{
+	uint32 n = 1;
+
+	while (TIFFReadDirectory(tif))
+		n++;
+	return n;
+}
+
+/* Make the last directory link back to directory target */
+static int
+make_loop(uint32 target)
+{
+	TIFF* tif;
+	uint64 targetoff = 0, lastoff = 0;
+	uint16 nentries;
+	uint32 link, d = 0;
+	FILE* fp;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	do {
+		if (d++ == target)
+			targetoff = TIFFCurrentDirOffset(tif);
+		lastoff = TIFFCurrentDirOffset(tif);
+	} while (TIFFReadDirectory(tif));
+	TIFFClose(tif);
+
+	/* Patch the link in the byte order of the file */
+	fp = fopen(filename, "r+b");
+	if (!fp) {
+		fprintf (stderr, "Can't open %s for patching.\n", filename);
+		return 0;
+	}
+	if (fseek(fp, (long) lastoff, SEEK_SET) != 0 ||
+	    fread(&nentries, 2, 1, fp) != 1) {
+		fclose(fp);
+		return 0;
+	}
+	link = (uint32) targetoff;
+	if (fseek(fp, (long) (lastoff + 2 + 12 * nentries), SEEK_SET) != 0 ||
+	    fwrite(&link, 4, 1, fp) != 1) {
+		fclose(fp);
+		return 0;
+	}
+	fclose(fp);
+	return 1;
+}
+
+int
+main()
+{
+	TIFF* tif = NULL;
+	uint32 n;
+	int ret = 1;
+
+	/* A loop from the last of NLOOP directories back to the second */
+	if (!write_file(NLOOP) || !make_loop(1))
+		goto done;
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto done;
+	}
+	if ((n = count_directories(tif)) != NLOOP) {
+		fprintf (stderr, "Read %lu directories of a loop of %d.\n",
+			 (unsigned long) n, NLOOP);
+		goto done;
+	}
+	/* Every walk from a directory set starts a new list */
+	if (!TIFFSetDirectory(tif, 2) ||
+	    (n = count_directories(tif)) != NLOOP - 1) {
+		fprintf (stderr, "Read %lu directories from the third.\n",
+			 (unsigned long) n);
+		goto done;
+	}
+	if (!TIFFSetDirectory(tif, 0) ||
+	    (n = count_directories(tif)) != NLOOP) {
+		fprintf (stderr, "Read %lu directories from the first.\n",
+			 (unsigned long) n);
+		goto done;
+	}
+	TIFFClose(tif);
+	tif = NULL;
+
+	/* More directories than a 16 bit count holds */
+	if (!write_file(NMANY))
+		goto done;
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto done;
+	}
+	if ((n = count_directories(tif)) != NMANY) {
+		fprintf (stderr, "Read %lu of %d directories.\n",
+			 (unsigned long) n, NMANY);
+		goto done;
+	}
+	ret = 0;
+done:
+	if (tif)
+		TIFFClose(tif);
+	unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
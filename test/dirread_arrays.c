@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the conversions of directory entry arrays to the types the
+ * tags are stored as: SHORT, SSHORT, LONG and SLONG strip offsets and
+ * byte counts widened to uint64, FLOAT arrays widened to double and
+ * negative values refused for an unsigned tag, in both byte orders
+ * and with and without the optimized kernels.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "dirread_arrays.tif";
+
+#define	WIDTH		8
+#define	NSTRIPS		37	/* not a multiple of the SIMD widths */
+#define	NENTRIES	10
+#define	IFDOFFSET	8
+
+#define	TAG_FLOATS	65000	/* FLOAT in the file, double in memory */
+#define	TAG_LONG8S	65001	/* SSHORT in the file, uint64 in memory */
+
+static const TIFFFieldInfo testfields[] = {
+	{ TAG_FLOATS, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, 1, 1, "TestFloats" },
+	{ TAG_LONG8S, -1, -1, TIFF_LONG8, FIELD_CUSTOM, 1, 1, "TestLong8s" }
+};
+
+static TIFFExtendProc parent_extender;
+
+static void
+test_extender(TIFF* tif)
+{
+	TIFFMergeFieldInfo(tif, testfields,
+	    sizeof(testfields) / sizeof(testfields[0]));
+	if (parent_extender)
+		(*parent_extender)(tif);
+}
+
+static unsigned char file[IFDOFFSET + 2 + NENTRIES * 12 + 4 +
+    4 * (4 * NSTRIPS) + WIDTH * NSTRIPS];
+static size_t filesize;
+static uint32 stripdata;
+static int bigendian;
+
+static void
+put16(size_t off, uint16 v)
+{
+	file[off + (bigendian ? 0 : 1)] = (unsigned char) (v >> 8);
+	file[off + (bigendian ? 1 : 0)] = (unsigned char) v;
+}
+
+static void
+put32(size_t off, uint32 v)
+{
+	put16(off + (bigendian ? 0 : 2), (uint16) (v >> 16));
+	put16(off + (bigendian ? 2 : 0), (uint16) v);
+}
+
+static int
+type_width(uint16 type)
+{
+	return (type == TIFF_SHORT || type == TIFF_SSHORT ? 2 : 4);
+}
+
+/*
+ * Append the values of an array entry to the file, and return the
+ * offset they were written at.
+ */
+static uint32
+put_array(uint16 type, const uint32* values, uint32 count)
+{
+	uint32 off = (uint32) filesize;
+	uint32 i;
+
+	for (i = 0; i < count; i++) {
+		if (type_width(type) == 2)
+			put16(filesize, (uint16) values[i]);
+		else
+			put32(filesize, values[i]);
+		filesize += type_width(type);
+	}
+	return (off);
+}
+
+static void
+put_entry(int n, uint16 tag, uint16 type, uint32 count, uint32 value)
+{
+	size_t off = IFDOFFSET + 2 + n * 12;
+
+	put16(off, tag);
+	put16(off + 2, type);
+	put32(off + 4, count);
+	if (count == 1 && type == TIFF_SHORT)
+		put16(off + 8, (uint16) value);
+	else
+		put32(off + 8, value);
+}
+
+static float
+float_value(uint32 i)
+{
+	return (float) i * 0.5f - 3.0f;
+}
+
+/*
+ * Write a file whose strip arrays are of the given type, with one
+ * negative value in the SSHORT array of TAG_LONG8S if asked to.
+ */
+static int
+write_file(uint16 type, int negative)
+{
+	uint32 offsets[NSTRIPS], counts[NSTRIPS], floats[NSTRIPS];
+	uint32 shorts[NSTRIPS];
+	uint32 offoff, cntoff, floatoff, shortoff, dataoff, i;
+	FILE* fd;
+
+	memset(file, 0, sizeof(file));
+	file[0] = file[1] = bigendian ? 'M' : 'I';
+	put16(2, 42);
+	put32(4, IFDOFFSET);
+	filesize = IFDOFFSET + 2 + NENTRIES * 12 + 4;
+	dataoff = stripdata = (uint32) (filesize + 4 * (4 * NSTRIPS));
+	for (i = 0; i < NSTRIPS; i++) {
+		union { float f; uint32 l; } u;
+
+		offsets[i] = dataoff + i * WIDTH;
+		counts[i] = WIDTH;
+		u.f = float_value(i);
+		floats[i] = u.l;
+		shorts[i] = i * 100;
+	}
+	if (negative)
+		shorts[NSTRIPS - 2] = 0x8000;
+	offoff = put_array(type, offsets, NSTRIPS);
+	cntoff = put_array(type, counts, NSTRIPS);
+	floatoff = put_array(TIFF_FLOAT, floats, NSTRIPS);
+	shortoff = put_array(TIFF_SSHORT, shorts, NSTRIPS);
+	filesize = dataoff;
+	for (i = 0; i < NSTRIPS; i++) {
+		memset(file + filesize, (int) i, WIDTH);
+		filesize += WIDTH;
+	}
+
+	put16(IFDOFFSET, NENTRIES);
+	put_entry(0, TIFFTAG_IMAGEWIDTH, TIFF_SHORT, 1, WIDTH);
+	put_entry(1, TIFFTAG_IMAGELENGTH, TIFF_SHORT, 1, NSTRIPS);
+	put_entry(2, TIFFTAG_BITSPERSAMPLE, TIFF_SHORT, 1, 8);
+	put_entry(3, TIFFTAG_COMPRESSION, TIFF_SHORT, 1, COMPRESSION_NONE);
+	put_entry(4, TIFFTAG_PHOTOMETRIC, TIFF_SHORT, 1,
+	    PHOTOMETRIC_MINISBLACK);
+	put_entry(5, TIFFTAG_STRIPOFFSETS, type, NSTRIPS, offoff);
+	put_entry(6, TIFFTAG_ROWSPERSTRIP, TIFF_SHORT, 1, 1);
+	put_entry(7, TIFFTAG_STRIPBYTECOUNTS, type, NSTRIPS, cntoff);
+	put_entry(8, TAG_FLOATS, TIFF_FLOAT, NSTRIPS, floatoff);
+	put_entry(9, TAG_LONG8S, TIFF_SSHORT, NSTRIPS, shortoff);
+
+	fd = fopen(filename, "wb");
+	if (!fd) {
+		fprintf (stderr, "Can't create %s.\n", filename);
+		return 0;
+	}
+	if (fwrite(file, 1, filesize, fd) != filesize) {
+		fprintf (stderr, "Can't write %s.\n", filename);
+		fclose(fd);
+		return 0;
+	}
+	fclose(fd);
+	return 1;
+}
+
+static int
+check_file(uint16 type, int negative, const char* mode)
+{
+	TIFF* tif = TIFFOpen(filename, mode);
+	uint64* offsets;
+	uint64* counts;
+	uint64* long8s;
+	double* doubles;
+	uint16 count;
+	unsigned char buf[WIDTH];
+	uint32 i;
+	int ret = 0;
+
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (!TIFFGetField(tif, TIFFTAG_STRIPOFFSETS, &offsets) ||
+	    !TIFFGetField(tif, TIFFTAG_STRIPBYTECOUNTS, &counts)) {
+		fprintf (stderr, "Type %d: no strip arrays.\n", type);
+		goto failure;
+	}
+	for (i = 0; i < NSTRIPS; i++) {
+		if (offsets[i] != (uint64) stripdata + i * WIDTH ||
+		    counts[i] != WIDTH) {
+			fprintf (stderr, "Type %d: wrong strip %lu entry.\n",
+				 type, (unsigned long) i);
+			goto failure;
+		}
+		if (TIFFReadEncodedStrip(tif, i, buf, WIDTH) != WIDTH ||
+		    buf[0] != i || buf[WIDTH - 1] != i) {
+			fprintf (stderr, "Type %d: wrong strip %lu data.\n",
+				 type, (unsigned long) i);
+			goto failure;
+		}
+	}
+	if (!TIFFGetField(tif, TAG_FLOATS, &count, &doubles) ||
+	    count != NSTRIPS) {
+		fprintf (stderr, "No FLOAT array.\n");
+		goto failure;
+	}
+	for (i = 0; i < NSTRIPS; i++) {
+		if (doubles[i] != (double) float_value(i)) {
+			fprintf (stderr, "Wrong FLOAT array value %lu.\n",
+				 (unsigned long) i);
+			goto failure;
+		}
+	}
+	if (negative) {
+		if (TIFFGetField(tif, TAG_LONG8S, &count, &long8s)) {
+			fprintf (stderr, "Negative SSHORT value accepted.\n");
+			goto failure;
+		}
+	} else {
+		if (!TIFFGetField(tif, TAG_LONG8S, &count, &long8s) ||
+		    count != NSTRIPS) {
+			fprintf (stderr, "No SSHORT array.\n");
+			goto failure;
+		}
+		for (i = 0; i < NSTRIPS; i++) {
+			if (long8s[i] != (uint64) i * 100) {
+				fprintf (stderr,
+					 "Wrong SSHORT array value %lu.\n",
+					 (unsigned long) i);
+				goto failure;
+			}
+		}
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	static const uint16 types[] = {
+		TIFF_SHORT, TIFF_SSHORT, TIFF_LONG, TIFF_SLONG
+	};
+	static const int features[] = { 0, TIFF_CPU_ALL };
+	size_t t, f;
+	int negative;
+
+	parent_extender = TIFFSetTagExtender(test_extender);
+	/* the negative value makes the reading of TAG_LONG8S warn */
+	TIFFSetWarningHandler(NULL);
+	for (f = 0; f < sizeof(features) / sizeof(features[0]); f++) {
+		TIFFSetCPUFeatures(features[f]);
+		for (bigendian = 0; bigendian < 2; bigendian++) {
+			for (t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+				for (negative = 0; negative < 2; negative++) {
+					if (!write_file(types[t], negative) ||
+					    !check_file(types[t], negative, "r") ||
+					    !check_file(types[t], negative, "rm")) {
+						fprintf (stderr,
+							 "Failed with CPU features %#x, "
+							 "%s-endian file.\n",
+							 features[f],
+							 bigendian ? "big" : "little");
+						return 1;
+					}
+				}
+			}
+		}
+	}
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that a directory and its out-of-line tag data are written to
+ * the file in one call, and read back correctly.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "dirwrite_block.tif";
+
+#define	WIDTH		64
+#define	LENGTH		3001
+#define	NPAGES		3
+
+/*
+ * The directory write should take the directory block plus the update
+ * of the link to it.
+ */
+#define	MAXDIRWRITES	2
+
+static const char software[] = "dirwrite_block";	/* odd length */
+
+static int
+write_file(const char* mode)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFFStatistics before, after;
+	unsigned char row[WIDTH * 3];
+	TIFF* tif;
+	uint32 r;
+	int page;
+
+	if (!opts)
+		return 0;
+	TIFFOpenOptionsSetStatistics(opts, 1);
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (page = 0; page < NPAGES; page++) {
+		TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+		TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+		TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1);
+		TIFFSetField(tif, TIFFTAG_XRESOLUTION, 72.0 + page);
+		TIFFSetField(tif, TIFFTAG_YRESOLUTION, 300.0);
+		TIFFSetField(tif, TIFFTAG_SOFTWARE, software);
+		TIFFSetField(tif, TIFFTAG_PAGENUMBER, page, NPAGES);
+		for (r = 0; r < LENGTH; r++) {
+			memset(row, (int)((r + page) & 0xff), sizeof(row));
+			if (TIFFWriteScanline(tif, row, r, 0) == -1) {
+				fprintf (stderr, "Can't write row %lu.\n",
+					 (unsigned long) r);
+				TIFFClose(tif);
+				return 0;
+			}
+		}
+		if (!TIFFFlushData(tif) || !TIFFGetStatistics(tif, &before) ||
+		    !TIFFWriteDirectory(tif) || !TIFFGetStatistics(tif, &after)) {
+			fprintf (stderr, "Can't write directory %d.\n", page);
+			TIFFClose(tif);
+			return 0;
+		}
+		if (after.writecalls - before.writecalls > MAXDIRWRITES) {
+			fprintf (stderr, "%s: directory %d took %lu writes.\n",
+				 mode, page, (unsigned long)
+				 (after.writecalls - before.writecalls));
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+check_file(const char* mode)
+{
+	unsigned char row[WIDTH * 3];
+	uint16 bps, pg, npg;
+	uint32 r;
+	float xres, yres;
+	char* sw;
+	TIFF* tif;
+	int page, ret = 0;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	for (page = 0; page < NPAGES; page++) {
+		if (page > 0 && !TIFFReadDirectory(tif))
+			goto failure;
+		if (!TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bps) || bps != 8 ||
+		    !TIFFGetField(tif, TIFFTAG_XRESOLUTION, &xres) ||
+		    xres != 72.0 + page ||
+		    !TIFFGetField(tif, TIFFTAG_YRESOLUTION, &yres) ||
+		    yres != 300.0 ||
+		    !TIFFGetField(tif, TIFFTAG_SOFTWARE, &sw) ||
+		    strcmp(sw, software) != 0 ||
+		    !TIFFGetField(tif, TIFFTAG_PAGENUMBER, &pg, &npg) ||
+		    pg != page || npg != NPAGES ||
+		    TIFFNumberOfStrips(tif) != LENGTH) {
+			fprintf (stderr, "%s: wrong tags in directory %d.\n",
+				 mode, page);
+			goto failure;
+		}
+		for (r = 0; r < LENGTH; r += 97) {
+			if (TIFFReadScanline(tif, row, r, 0) == -1 ||
+			    row[0] != ((r + page) & 0xff) ||
+			    row[sizeof(row) - 1] != ((r + page) & 0xff)) {
+				fprintf (stderr, "%s: wrong row %lu in directory "
+					 "%d.\n", mode, (unsigned long) r, page);
+				goto failure;
+			}
+		}
+	}
+	if (TIFFReadDirectory(tif)) {
+		fprintf (stderr, "%s: too many directories.\n", mode);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	static const char* modes[] = { "wl", "wb", "w8", "wb8" };
+	size_t i;
+
+	for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+		if (!write_file(modes[i]) || !check_file(modes[i]))
+			return 1;
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that strips and tiles compressed with TIFFEncodeChunk() and
+ * written out of order with TIFFWriteRawStrip() or TIFFWriteRawTile()
+ * read back as the data they were made from.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "encode_chunk.tif";
+
+#define	WIDTH		100
+#define	LENGTH		70
+#define	TILESIZE	32
+#define	ROWSPERSTRIP	16
+
+static void
+fill_chunk(unsigned char* buf, tmsize_t size, uint32 n)
+{
+	tmsize_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)((i / 9 + n * 37 + (i % 3) * 50) & 0xff);
+}
+
+static void
+set_fields(TIFF* tif, int tiled, uint16 compression)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, compression);
+	if (compression == COMPRESSION_LZW)
+		TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	if (tiled) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	} else
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+}
+
+/*
+ * Encode every chunk of the current directory, then write them in
+ * reverse order.
+ */
+static int
+write_directory(TIFF* tif, int tiled, uint16 compression)
+{
+	tmsize_t size, outsize;
+	unsigned char* buf;
+	unsigned char** chunks;
+	tmsize_t* sizes;
+	uint32 n, i;
+	int ret = 0;
+
+	set_fields(tif, tiled, compression);
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	/* enough for data that does not compress at all */
+	outsize = 2 * size + 1024;
+	buf = (unsigned char*) malloc(size);
+	chunks = (unsigned char**) calloc(n, sizeof(unsigned char*));
+	sizes = (tmsize_t*) calloc(n, sizeof(tmsize_t));
+	if (!buf || !chunks || !sizes)
+		goto failure;
+	for (i = 0; i < n; i++) {
+		fill_chunk(buf, size, i);
+		chunks[i] = (unsigned char*) malloc(outsize);
+		if (!chunks[i])
+			goto failure;
+		sizes[i] = TIFFEncodeChunk(tif, i, buf, size, chunks[i], outsize);
+		if (sizes[i] <= 0) {
+			fprintf (stderr, "Can't encode chunk %lu.\n",
+				 (unsigned long) i);
+			goto failure;
+		}
+	}
+	fill_chunk(buf, size, 0);
+	if (TIFFEncodeChunk(tif, 0, buf, size, chunks[0], 1) != -1 ||
+	    TIFFEncodeChunk(tif, n, buf, size, chunks[0], outsize) != -1) {
+		fprintf (stderr, "Invalid arguments not rejected.\n");
+		goto failure;
+	}
+	for (i = n; i-- > 0; ) {
+		tmsize_t got = tiled ?
+		    TIFFWriteRawTile(tif, i, chunks[i], sizes[i]) :
+		    TIFFWriteRawStrip(tif, i, chunks[i], sizes[i]);
+		if (got != sizes[i]) {
+			fprintf (stderr, "Can't write chunk %lu.\n",
+				 (unsigned long) i);
+			goto failure;
+		}
+	}
+	ret = TIFFWriteDirectory(tif);
+
+failure:
+	if (chunks)
+		for (i = 0; i < n; i++)
+			free(chunks[i]);
+	free(chunks);
+	free(sizes);
+	free(buf);
+	return ret;
+}
+
+static int
+check_directory(TIFF* tif, int tiled)
+{
+	tmsize_t size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	uint32 n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	unsigned char* a = (unsigned char*) malloc(size);
+	unsigned char* b = (unsigned char*) malloc(size);
+	uint32 i;
+	int ret = 0;
+
+	if (!a || !b)
+		goto failure;
+	for (i = 0; i < n; i++) {
+		tmsize_t got = tiled ? TIFFReadEncodedTile(tif, i, a, size) :
+		    TIFFReadEncodedStrip(tif, i, a, size);
+
+		fill_chunk(b, size, i);
+		if (got == -1 || memcmp(a, b, got) != 0) {
+			fprintf (stderr, "Chunk %lu differs.\n",
+				 (unsigned long) i);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	free(a);
+	free(b);
+	return ret;
+}
+
+int
+main()
+{
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 1;
+	}
+	ok = write_directory(tif, 1, COMPRESSION_LZW) &&
+	    write_directory(tif, 0, COMPRESSION_PACKBITS) &&
+	    write_directory(tif, 1, COMPRESSION_NONE);
+	TIFFClose(tif);
+	if (!ok) {
+		fprintf (stderr, "Can't write %s.\n", filename);
+		return 1;
+	}
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 1;
+	}
+	ok = check_directory(tif, 1) &&
+	    TIFFReadDirectory(tif) && check_directory(tif, 0) &&
+	    TIFFReadDirectory(tif) && check_directory(tif, 1);
+	TIFFClose(tif);
+	if (!ok) {
+		fprintf (stderr, "Can't read back %s.\n", filename);
+		return 1;
+	}
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
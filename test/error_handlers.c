@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that the handlers given with TIFFOpenOptionsSetErrorHandlerExtR()
+ * and TIFFOpenOptionsSetWarningHandlerExtR() get the messages of their
+ * handle before the global handlers, and that
+ * TIFFOpenOptionsSetWarnings() drops warnings.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "error_handlers.tif";
+
+#define	WIDTH		16
+#define	LENGTH		8
+
+typedef struct {
+	TIFF*	tif;		/* handle the messages should come from */
+	int	stop;		/* value the handler returns */
+	int	errors;
+	int	warnings;
+	char	last[256];	/* last message formatted */
+} Messages;
+
+static int global_errors, global_warnings;
+
+static void
+global_error(const char* module, const char* fmt, va_list ap)
+{
+	(void) module;
+	(void) fmt;
+	(void) ap;
+	global_errors++;
+}
+
+static void
+global_warning(const char* module, const char* fmt, va_list ap)
+{
+	(void) module;
+	(void) fmt;
+	(void) ap;
+	global_warnings++;
+}
+
+static int
+handle_error(TIFF* tif, void* user_data, const char* module, const char* fmt,
+    va_list ap)
+{
+	Messages* m = (Messages*) user_data;
+
+	(void) module;
+	if (tif != m->tif)
+		return (0);
+	m->errors++;
+	vsnprintf(m->last, sizeof(m->last), fmt, ap);
+	return (m->stop);
+}
+
+static int
+handle_warning(TIFF* tif, void* user_data, const char* module,
+    const char* fmt, va_list ap)
+{
+	Messages* m = (Messages*) user_data;
+
+	(void) module;
+	if (tif != m->tif)
+		return (0);
+	m->warnings++;
+	vsnprintf(m->last, sizeof(m->last), fmt, ap);
+	return (m->stop);
+}
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	(void) arg;
+	memset(c->buf, 0, c->size);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, LENGTH, 0, 0 };
+
+	return write_test_image(filename, &im, fill_strip, NULL);
+}
+
+/*
+ * Open the file with the handlers of m, cause an error and a warning,
+ * and check who got them.
+ */
+static int
+check(Messages* m, int warnings, int want_errors, int want_warnings,
+    int want_global_errors, int want_global_warnings)
+{
+	TIFFOpenOptions* opts;
+	unsigned char buf[WIDTH * LENGTH];
+	TIFF* tif;
+	int ok = 1;
+
+	opts = TIFFOpenOptionsAlloc();
+	if (opts == NULL) {
+		fprintf (stderr, "Can't allocate options.\n");
+		return 0;
+	}
+	TIFFOpenOptionsSetErrorHandlerExtR(opts, handle_error, m);
+	TIFFOpenOptionsSetWarningHandlerExtR(opts, handle_warning, m);
+	TIFFOpenOptionsSetWarnings(opts, warnings);
+	tif = TIFFOpenExt(filename, "r", opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open test TIFF file %s.\n", filename);
+		return 0;
+	}
+	m->tif = tif;
+	m->errors = m->warnings = 0;
+	m->last[0] = '\0';
+	global_errors = global_warnings = 0;
+
+	/* strip 5 does not exist */
+	if (TIFFReadEncodedStrip(tif, 5, buf, sizeof(buf)) != -1) {
+		fprintf (stderr, "Read a strip out of range.\n");
+		ok = 0;
+	}
+	if (m->errors == 1 && strstr(m->last, "out of range") == NULL) {
+		fprintf (stderr, "Unexpected error message \"%s\".\n", m->last);
+		ok = 0;
+	}
+	TIFFWarningExtR(tif, "error_handlers", "warning %d", 42);
+	if (m->warnings == 1 && strcmp(m->last, "warning 42") != 0) {
+		fprintf (stderr, "Unexpected warning message \"%s\".\n",
+		    m->last);
+		ok = 0;
+	}
+	if (m->errors != want_errors || m->warnings != want_warnings ||
+	    global_errors != want_global_errors ||
+	    global_warnings != want_global_warnings) {
+		fprintf (stderr, "Handle got %d errors and %d warnings, global "
+		    "handlers %d and %d, instead of %d, %d, %d and %d.\n",
+		    m->errors, m->warnings, global_errors, global_warnings,
+		    want_errors, want_warnings, want_global_errors,
+		    want_global_warnings);
+		ok = 0;
+	}
+	TIFFClose(tif);
+	return ok;
+}
+
+int
+main()
+{
+	Messages m;
+
+	TIFFSetErrorHandler(global_error);
+	TIFFSetWarningHandler(global_warning);
+	if (!write_image())
+		goto failure;
+	memset(&m, 0, sizeof(m));
+
+	/* the handle's handlers and then the global ones */
+	m.stop = 0;
+	if (!check(&m, 1, 1, 1, 1, 1))
+		goto failure;
+	/* only the handle's handlers */
+	m.stop = 1;
+	if (!check(&m, 1, 1, 1, 0, 0))
+		goto failure;
+	/* no warnings at all */
+	m.stop = 0;
+	if (!check(&m, 0, 1, 0, 1, 0))
+		goto failure;
+	unlink(filename);
+	return 0;
+
+failure:
+	unlink(filename);
+	return 1;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
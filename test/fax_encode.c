@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Round trip bilevel images through the G3 1D, G3 2D and G4 encoders
+ * and check that decoding gives back the original pixels.  Rows mix
+ * long and short spans and carry garbage in their pad bits.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "fax_encode.tif";
+
+#define	LENGTH		48
+#define	ROWSPERSTRIP	20
+
+static unsigned long seed = 1;
+
+static unsigned int
+next_random(void)
+{
+	seed = seed * 1103515245UL + 12345UL;
+	return (unsigned int) ((seed >> 16) & 0x7fff);
+}
+
+static void
+make_image(unsigned char* buf, uint32 width, tmsize_t rowbytes)
+{
+	uint32 row, x;
+
+	for (row = 0; row < LENGTH; row++) {
+		unsigned char* cp = buf + row * rowbytes;
+		int black = (row % 7) == 3;	/* some rows start black */
+		uint32 span = 0;
+
+		memset(cp, 0, rowbytes);
+		for (x = 0; x < width; x++) {
+			if (span == 0) {
+				black = !black;
+				span = (row % 3) == 0 ? 1 + next_random() % 4 :
+				    1 + next_random() % 150;
+			}
+			span--;
+			if (black)
+				cp[x >> 3] |= 0x80 >> (x & 7);
+		}
+		if (width & 7)			/* garbage in the pad bits */
+			cp[width >> 3] |= (unsigned char)
+			    (next_random() & (0xff >> (width & 7)));
+	}
+}
+
+static int
+check_roundtrip(uint16 compression, uint32 options, uint32 width)
+{
+	tmsize_t rowbytes = (width + 7) / 8;
+	unsigned char* image = (unsigned char*) malloc(rowbytes * LENGTH);
+	unsigned char* row = (unsigned char*) malloc(rowbytes);
+	TIFF* tif;
+	uint32 y, x;
+	int ret = 0;
+
+	if (!image || !row) {
+		fprintf (stderr, "Out of memory.\n");
+		goto done;
+	}
+	make_image(image, width, rowbytes);
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		goto done;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 1);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISWHITE);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, compression);
+	if (compression == COMPRESSION_CCITTFAX3)
+		TIFFSetField(tif, TIFFTAG_GROUP3OPTIONS, options);
+	for (y = 0; y < LENGTH; y++) {
+		/* The encoder may not rely on the caller's buffer afterwards */
+		memcpy(row, image + y * rowbytes, rowbytes);
+		if (TIFFWriteScanline(tif, row, y, 0) == -1) {
+			fprintf (stderr, "Can't write row %lu.\n",
+				 (unsigned long) y);
+			TIFFClose(tif);
+			goto done;
+		}
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto done;
+	}
+	for (y = 0; y < LENGTH; y++) {
+		const unsigned char* ref = image + y * rowbytes;
+
+		if (TIFFReadScanline(tif, row, y, 0) == -1) {
+			fprintf (stderr, "Can't read row %lu.\n",
+				 (unsigned long) y);
+			TIFFClose(tif);
+			goto done;
+		}
+		for (x = 0; x < width; x++) {
+			if (((row[x >> 3] ^ ref[x >> 3]) & (0x80 >> (x & 7))) != 0) {
+				fprintf (stderr,
+				    "Compression %d, options %lu, width %lu: "
+				    "pixel %lu of row %lu differs.\n",
+				    compression, (unsigned long) options,
+				    (unsigned long) width, (unsigned long) x,
+				    (unsigned long) y);
+				TIFFClose(tif);
+				goto done;
+			}
+		}
+	}
+	TIFFClose(tif);
+	ret = 1;
+
+done:
+	free(image);
+	free(row);
+	return ret;
+}
+
+int
+main()
+{
+	static const uint32 widths[] = { 1, 7, 63, 64, 65, 203, 1728, 2483 };
+	unsigned int i;
+
+	for (i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+		if (!check_roundtrip(COMPRESSION_CCITTFAX3, 0, widths[i]) ||
+		    !check_roundtrip(COMPRESSION_CCITTFAX3,
+				     GROUP3OPT_2DENCODING, widths[i]) ||
+		    !check_roundtrip(COMPRESSION_CCITTFAX3,
+				     GROUP3OPT_2DENCODING|GROUP3OPT_FILLBITS,
+				     widths[i]) ||
+		    !check_roundtrip(COMPRESSION_CCITTFAX4, 0, widths[i]))
+			return 1;
+	}
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that rows written with TIFFWriteFaxRuns() are encoded
+ * exactly as the same rows written with TIFFWriteScanline().
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char pixelfile[] = "fax_encode_runs_pixels.tif";
+static const char runsfile[] = "fax_encode_runs_runs.tif";
+
+#define	WIDTH		203
+#define	LENGTH		61
+#define	ROWSPERSTRIP	16
+#define	MAXRUNS		(2*WIDTH+8)
+
+static unsigned char image[LENGTH][(WIDTH+7)/8];
+
+static void
+make_image(void)
+{
+	uint32 x, y;
+
+	for (y = 0; y < LENGTH; y++) {
+		memset(image[y], 0, sizeof (image[y]));
+		for (x = 0; x < WIDTH; x++) {
+			int black;
+			if (y % 10 == 0)
+				black = 0;			/* all white */
+			else if (y % 10 == 1)
+				black = 1;			/* all black */
+			else if (y % 10 < 6)
+				black = ((x * 7 + y * 3) / (y % 5 + 2)) & 1;
+			else
+				black = ((x / 11 + (x * y) / 37) & 3) == 0;
+			if (black)
+				image[y][x >> 3] |= 0x80 >> (x & 7);
+		}
+	}
+}
+
+/*
+ * Turn a row into runs, occasionally splitting a run with an empty
+ * one and adding runs past the end of the row, which must not
+ * change the result.
+ */
+static uint32
+make_runs(uint32 y, uint32* runs)
+{
+	uint32 n = 0, x = 0, run;
+	int color = 0;
+
+	while (x < WIDTH) {
+		for (run = 0; x + run < WIDTH; run++) {
+			uint32 p = x + run;
+			if (((image[y][p >> 3] >> (7 - (p & 7))) & 1) != color)
+				break;
+		}
+		if (run > 2 && (y & 1)) {
+			runs[n++] = run / 2;
+			runs[n++] = 0;
+			runs[n++] = run - run / 2;
+		} else
+			runs[n++] = run;
+		x += run;
+		color ^= 1;
+	}
+	if (y % 3 == 0) {
+		runs[n++] = 5;
+		runs[n++] = 9;
+	}
+	return (n);
+}
+
+static int
+write_image(const char* filename, uint16 compression, uint32 options,
+	    uint32 mode, float yres, int userows)
+{
+	TestImage im = { WIDTH, LENGTH, 1, 1, 0, PHOTOMETRIC_MINISWHITE,
+	    0, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif;
+	uint32 runs[MAXRUNS];
+	uint32 y;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.compression = compression;
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_XRESOLUTION, 204.0);
+	TIFFSetField(tif, TIFFTAG_YRESOLUTION, yres);
+	TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
+	if (compression == COMPRESSION_CCITTFAX3)
+		TIFFSetField(tif, TIFFTAG_GROUP3OPTIONS, options);
+	TIFFSetField(tif, TIFFTAG_FAXMODE, mode);
+	for (y = 0; y < LENGTH; y++) {
+		/* userows: 1 -> runs only, 2 -> every third row as pixels */
+		int ok;
+		if (userows && !(userows == 2 && y % 3 == 1))
+			ok = TIFFWriteFaxRuns(tif, y, runs,
+					      make_runs(y, runs)) == 1;
+		else
+			ok = TIFFWriteScanline(tif, image[y], y, 0) == 1;
+		if (!ok) {
+			fprintf (stderr, "Can't write row %lu.\n",
+				 (unsigned long) y);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+compare_files(const char* what)
+{
+	TIFF* a = TIFFOpen(pixelfile, "r");
+	TIFF* b = TIFFOpen(runsfile, "r");
+	unsigned char *ba = NULL, *bb = NULL;
+	uint32 s, n;
+	int ret = 0;
+
+	if (!a || !b) {
+		fprintf (stderr, "%s: can't reopen test files.\n", what);
+		goto failure;
+	}
+	n = TIFFNumberOfStrips(a);
+	if (n != TIFFNumberOfStrips(b))
+		goto differ;
+	for (s = 0; s < n; s++) {
+		uint64 *ca, *cb;
+		tmsize_t size;
+		TIFFGetField(a, TIFFTAG_STRIPBYTECOUNTS, &ca);
+		TIFFGetField(b, TIFFTAG_STRIPBYTECOUNTS, &cb);
+		if (ca[s] != cb[s])
+			goto differ;
+		size = (tmsize_t) ca[s];
+		ba = (unsigned char*) realloc(ba, size);
+		bb = (unsigned char*) realloc(bb, size);
+		if (!ba || !bb)
+			goto failure;
+		if (TIFFReadRawStrip(a, s, ba, size) != size ||
+		    TIFFReadRawStrip(b, s, bb, size) != size ||
+		    memcmp(ba, bb, size) != 0)
+			goto differ;
+	}
+	ret = 1;
+	goto failure;
+differ:
+	fprintf (stderr, "%s: encoded data differs.\n", what);
+failure:
+	free(ba);
+	free(bb);
+	if (a)
+		TIFFClose(a);
+	if (b)
+		TIFFClose(b);
+	return ret;
+}
+
+static int
+check(const char* what, uint16 compression, uint32 options, uint32 mode,
+      float yres)
+{
+	int userows;
+
+	if (!write_image(pixelfile, compression, options, mode, yres, 0))
+		return 0;
+	for (userows = 1; userows <= 2; userows++) {
+		if (!write_image(runsfile, compression, options, mode, yres,
+				 userows) ||
+		    !compare_files(what))
+			return 0;
+	}
+	return 1;
+}
+
+int
+main()
+{
+	TIFF* tif;
+	uint32 runs[2] = { 10, 20 };
+
+	make_image();
+	if (!check("G3 1D", COMPRESSION_CCITTFAX3, 0, FAXMODE_CLASSF, 98.0f) ||
+	    !check("G3 1D aligned", COMPRESSION_CCITTFAX3, GROUP3OPT_FILLBITS,
+		   FAXMODE_BYTEALIGN, 98.0f) ||
+	    !check("G3 2D K=2", COMPRESSION_CCITTFAX3, GROUP3OPT_2DENCODING,
+		   FAXMODE_CLASSF, 98.0f) ||
+	    !check("G3 2D K=4", COMPRESSION_CCITTFAX3, GROUP3OPT_2DENCODING,
+		   FAXMODE_CLASSF, 392.0f) ||
+	    !check("G3 2D word aligned", COMPRESSION_CCITTFAX3,
+		   GROUP3OPT_2DENCODING, FAXMODE_WORDALIGN, 196.0f) ||
+	    !check("G4", COMPRESSION_CCITTFAX4, 0, FAXMODE_CLASSF, 196.0f))
+		return 1;
+
+	/* Other codecs must refuse runs */
+	tif = TIFFOpen(runsfile, "w");
+	if (!tif)
+		return 1;
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 1);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	if (TIFFWriteFaxRuns(tif, 0, runs, 2) != -1) {
+		fprintf (stderr, "Runs were accepted for LZW.\n");
+		TIFFClose(tif);
+		return 1;
+	}
+	TIFFClose(tif);
+
+	unlink(pixelfile);
+	unlink(runsfile);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
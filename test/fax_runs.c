@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that the runs reported through TIFFTAG_FAXRUNSFUNC describe the
+ * same rows as the bitmap produced by normal G3/G4 decoding.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "fax_runs.tif";
+
+#define	WIDTH		203
+#define	LENGTH		40
+#define	ROWSPERSTRIP	16
+#define	ROWBYTES	((WIDTH + 7) / 8)
+
+typedef struct {
+	unsigned char* buf;		/* rows rebuilt from the runs */
+	uint32 nrows;			/* rows reported so far */
+	uint32 stoprow;			/* fail on this row, if non-zero */
+	int bad;			/* set on inconsistent callback data */
+} RunsContext;
+
+static int
+put_runs(void* clientdata, uint32 row, const uint32* runs, uint32 nruns,
+	 uint32 width)
+{
+	RunsContext* ctx = (RunsContext*) clientdata;
+	unsigned char* cp;
+	uint32 i, x = 0, end;
+
+	if (ctx->stoprow && row == ctx->stoprow)
+		return 0;
+	if (row != ctx->nrows || width != WIDTH || (nruns & 1) != 0) {
+		ctx->bad = 1;
+		return 0;
+	}
+	cp = ctx->buf + row * ROWBYTES;
+	memset(cp, 0, ROWBYTES);
+	for (i = 0; i < nruns; i++) {
+		end = x + runs[i];
+		if (i & 1)
+			for (; x < end; x++)
+				cp[x >> 3] |= 0x80 >> (x & 7);
+		x = end;
+	}
+	if (x != WIDTH)
+		ctx->bad = 1;
+	ctx->nrows++;
+	return 1;
+}
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	uint32 row, x;
+
+	(void) arg;
+	memset(c->buf, 0, c->size);
+	for (row = 0; row < c->length; row++) {
+		uint32 y = c->y + row;
+
+		for (x = 0; x < WIDTH; x++) {
+			if ((x / (3 + y % 5)) % 2 == 0 && (x + 2 * y) % 37 > 6)
+				c->buf[row * ROWBYTES + (x >> 3)] |= 0x80 >> (x & 7);
+		}
+	}
+}
+
+static int
+write_image(uint16 compression, uint32 group3options)
+{
+	TestImage im = { WIDTH, LENGTH, 1, 1, 0, PHOTOMETRIC_MINISWHITE,
+	    0, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.compression = compression;
+	set_image_fields(tif, &im);
+	if (compression == COMPRESSION_CCITTFAX3)
+		TIFFSetField(tif, TIFFTAG_GROUP3OPTIONS, group3options);
+	ok = write_image_data(tif, fill_strip, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+check_image(const char* name)
+{
+	unsigned char ref[ROWBYTES * ROWSPERSTRIP];
+	unsigned char runsbuf[ROWBYTES * ROWSPERSTRIP];
+	unsigned char out[ROWBYTES * ROWSPERSTRIP];
+	RunsContext ctx;
+	TIFFFaxRunsFunc func;
+	void* data;
+	TIFF* tif;
+	uint32 i;
+	tmsize_t got;
+	int ret = 0;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	for (i = 0; i < TIFFNumberOfStrips(tif); i++) {
+		/* Decoding leaves the pad bits at the end of each row alone */
+		memset(ref, 0, sizeof(ref));
+		got = TIFFReadEncodedStrip(tif, i, ref, sizeof(ref));
+		if (got == -1) {
+			fprintf (stderr, "%s: can't decode strip %lu.\n",
+				 name, (unsigned long) i);
+			goto failure;
+		}
+
+		memset(&ctx, 0, sizeof(ctx));
+		ctx.buf = runsbuf;
+		TIFFSetField(tif, TIFFTAG_FAXRUNSFUNC, put_runs, &ctx);
+		memset(out, 0x5a, sizeof(out));
+		if (TIFFReadEncodedStrip(tif, i, out, sizeof(out)) != got) {
+			fprintf (stderr, "%s: run decoding of strip %lu failed.\n",
+				 name, (unsigned long) i);
+			goto failure;
+		}
+		TIFFSetField(tif, TIFFTAG_FAXRUNSFUNC, NULL, NULL);
+		if (ctx.bad || ctx.nrows != (uint32) (got / ROWBYTES) ||
+		    memcmp(runsbuf, ref, got) != 0) {
+			fprintf (stderr, "%s: runs of strip %lu differ.\n",
+				 name, (unsigned long) i);
+			goto failure;
+		}
+		/* The caller's buffer is not touched in run mode */
+		for (got = 0; got < (tmsize_t) sizeof(out); got++) {
+			if (out[got] != 0x5a) {
+				fprintf (stderr, "%s: buffer was written.\n",
+					 name);
+				goto failure;
+			}
+		}
+	}
+
+	/* A failing callback aborts decoding */
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.buf = runsbuf;
+	ctx.stoprow = 5;
+	TIFFSetField(tif, TIFFTAG_FAXRUNSFUNC, put_runs, &ctx);
+	if (!TIFFGetField(tif, TIFFTAG_FAXRUNSFUNC, &func, &data) ||
+	    func != put_runs || data != &ctx) {
+		fprintf (stderr, "%s: can't get TIFFTAG_FAXRUNSFUNC.\n", name);
+		goto failure;
+	}
+	if (TIFFReadEncodedStrip(tif, 0, out, sizeof(out)) != -1 ||
+	    ctx.nrows != ctx.stoprow) {
+		fprintf (stderr, "%s: callback failure was ignored.\n", name);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image(COMPRESSION_CCITTFAX3, 0) || !check_image("G3 1D"))
+		return 1;
+	if (!write_image(COMPRESSION_CCITTFAX3, GROUP3OPT_2DENCODING) ||
+	    !check_image("G3 2D"))
+		return 1;
+	if (!write_image(COMPRESSION_CCITTFAX4, 0) || !check_image("G4"))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the floating point and byte shuffle predictors for half, single
+ * and double precision samples.  The byte planes produced by the encoder
+ * are compared with a straightforward computation, and decoding must
+ * give back the image.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "fp_predictor.tif";
+static const char rawfilename[] = "fp_predictor_raw.tif";
+
+#define	LENGTH		3
+
+static void
+set_fields(TIFF* tif, uint32 width, uint16 bps, uint16 spp)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, bps);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, spp);
+	TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, LENGTH);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+}
+
+/*
+ * Compute the predictor output for one row: the bytes of each sample
+ * go to separate planes, most significant first, and for the floating
+ * point predictor the planes are then differenced bytewise with a
+ * stride of spp.
+ */
+static void
+encode_row(uint8* out, const uint8* in, tmsize_t wc, int nbytes, int spp,
+	   uint16 predictor)
+{
+	static const uint16 one = 1;
+	int littleendian = *(const uint8*) &one == 1;
+	tmsize_t count, cc = wc * nbytes;
+	int byte;
+
+	for (count = 0; count < wc; count++)
+		for (byte = 0; byte < nbytes; byte++)
+			out[(littleendian ? nbytes - byte - 1 : byte) * wc + count] =
+			    in[nbytes * count + byte];
+	if (predictor != PREDICTOR_FLOATINGPOINT)
+		return;
+	for (count = cc - 1; count >= spp; count--)
+		out[count] = (uint8) (out[count] - out[count - spp]);
+}
+
+static int
+check(uint32 width, uint16 bps, uint16 spp, uint16 predictor)
+{
+	TIFF* tif;
+	int nbytes = bps / 8;
+	tmsize_t nsamples = (tmsize_t) width * spp * LENGTH;
+	tmsize_t rowsize = (tmsize_t) width * spp * nbytes, i;
+	tmsize_t size = nsamples * nbytes, rawsize;
+	uint8 *image, *buf, *raw, *expected;
+	uint32 seed = width * 31 + bps * 7 + spp;
+	int ret = 0;
+
+	image = (uint8*) malloc(size);
+	buf = (uint8*) malloc(size);
+	expected = (uint8*) malloc(size);
+	raw = (uint8*) malloc(2 * size + 1024);
+	if (!image || !buf || !expected || !raw) {
+		fprintf (stderr, "Out of memory.\n");
+		goto failure;
+	}
+	for (i = 0; i < nsamples; i++) {
+		seed = seed * 1103515245 + 12345;
+		if (bps == 16)
+			((uint16*) image)[i] = (uint16) (seed >> 12);
+		else if (bps == 32)
+			((float*) image)[i] = (float) (seed >> 8) / 1024.0f - 4096.0f;
+		else
+			((double*) image)[i] = (double) seed / 3.0 - 1e9;
+	}
+	for (i = 0; i < LENGTH; i++)
+		encode_row(expected + i * rowsize, image + i * rowsize,
+		    (tmsize_t) width * spp, nbytes, spp, predictor);
+
+	/* Encode with the predictor */
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", filename);
+		goto failure;
+	}
+	set_fields(tif, width, bps, spp);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor);
+	memcpy(buf, image, size);
+	if (TIFFWriteEncodedStrip(tif, 0, buf, size) != size) {
+		fprintf (stderr, "Can't write %s.\n", filename);
+		TIFFClose(tif);
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	/* Decoding must give back the image */
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	if (TIFFReadEncodedStrip(tif, 0, buf, size) != size ||
+	    memcmp(buf, image, size) != 0) {
+		fprintf (stderr, "Decoding differs.\n");
+		TIFFClose(tif);
+		goto failure;
+	}
+	rawsize = TIFFReadRawStrip(tif, 0, raw, 2 * size + 1024);
+	TIFFClose(tif);
+	if (rawsize <= 0) {
+		fprintf (stderr, "Can't read raw strip.\n");
+		goto failure;
+	}
+
+	/* Decode the same codes without the predictor to see its output */
+	tif = TIFFOpen(rawfilename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", rawfilename);
+		goto failure;
+	}
+	set_fields(tif, width, bps, spp);
+	if (TIFFWriteRawStrip(tif, 0, raw, rawsize) != rawsize) {
+		fprintf (stderr, "Can't write %s.\n", rawfilename);
+		TIFFClose(tif);
+		goto failure;
+	}
+	TIFFClose(tif);
+	tif = TIFFOpen(rawfilename, "r");
+	if (!tif || TIFFReadEncodedStrip(tif, 0, buf, size) != size) {
+		fprintf (stderr, "Can't read %s.\n", rawfilename);
+		if (tif)
+			TIFFClose(tif);
+		goto failure;
+	}
+	TIFFClose(tif);
+	for (i = 0; i < size; i++) {
+		if (buf[i] != expected[i]) {
+			fprintf (stderr, "Predictor error at byte %ld.\n",
+				 (long) i);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	if (!ret)
+		fprintf (stderr, "Failed for width %lu, %d bits, %d samples, "
+			 "predictor %d.\n", (unsigned long) width, bps, spp,
+			 predictor);
+	free(image);
+	free(buf);
+	free(expected);
+	free(raw);
+	return ret;
+}
+
+int
+main()
+{
+	static const uint32 widths[] = { 1, 2, 5, 15, 16, 17, 33, 100, 257 };
+	static const uint16 predictors[] = {
+		PREDICTOR_FLOATINGPOINT, PREDICTOR_SHUFFLE
+	};
+	uint16 bps, spp;
+	size_t p, w;
+
+	for (p = 0; p < sizeof(predictors) / sizeof(predictors[0]); p++)
+		for (bps = 16; bps <= 64; bps *= 2)
+			for (spp = 1; spp <= 4; spp++)
+				for (w = 0; w < sizeof(widths) /
+				     sizeof(widths[0]); w++)
+					if (!check(widths[w], bps, spp,
+						   predictors[p]))
+						return 1;
+	unlink(filename);
+	unlink(rawfilename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFGetImageInfo() agrees with TIFFGetField() for striped and
+ * tiled images.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "image_info.tif";
+
+#define	WIDTH		37
+#define	LENGTH		29
+#define	TILESIZE	16
+#define	ROWSPERSTRIP	5
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	(void) arg;
+	memset(c->buf, 0, c->size);
+}
+
+static int
+write_image(int tiled)
+{
+	TestImage im = { WIDTH, LENGTH, 16, 2, PLANARCONFIG_SEPARATE,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+	uint16 extra = EXTRASAMPLE_UNASSALPHA;
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	if (tiled)
+		im.tilewidth = im.tilelength = TILESIZE;
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, 1, &extra);
+	TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_INT);
+	TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_BOTLEFT);
+	ok = write_image_data(tif, fill_chunk, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+#define	CHECK(field, want) \
+	if ((uint32) (field) != (uint32) (want)) { \
+		fprintf (stderr, "%s is %lu instead of %lu.\n", #field, \
+		    (unsigned long) (field), (unsigned long) (want)); \
+		ok = 0; \
+	}
+
+static int
+check_image(int tiled)
+{
+	TIFFImageInfo info;
+	TIFF* tif;
+	uint32 v32;
+	uint16 v16, *extras;
+	int ok = 1;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open test TIFF file %s.\n", filename);
+		return 0;
+	}
+	memset(&info, 0xff, sizeof(info));
+	TIFFGetImageInfo(tif, &info);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_IMAGEWIDTH, &v32);
+	CHECK(info.imagewidth, v32);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_IMAGELENGTH, &v32);
+	CHECK(info.imagelength, v32);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_IMAGEDEPTH, &v32);
+	CHECK(info.imagedepth, v32);
+	if (tiled) {
+		TIFFGetField(tif, TIFFTAG_TILEWIDTH, &v32);
+		CHECK(info.tilewidth, v32);
+		TIFFGetField(tif, TIFFTAG_TILELENGTH, &v32);
+		CHECK(info.tilelength, v32);
+		CHECK(info.nstrips, TIFFNumberOfTiles(tif));
+		CHECK(info.stripsperimage, TIFFNumberOfTiles(tif) / 2);
+	} else {
+		CHECK(info.tilewidth, 0);
+		CHECK(info.tilelength, 0);
+		TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &v32);
+		CHECK(info.rowsperstrip, v32);
+		CHECK(info.nstrips, TIFFNumberOfStrips(tif));
+		CHECK(info.stripsperimage, TIFFNumberOfStrips(tif) / 2);
+	}
+	CHECK(info.tiled, tiled);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SUBFILETYPE, &v32);
+	CHECK(info.subfiletype, v32);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &v16);
+	CHECK(info.bitspersample, v16);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &v16);
+	CHECK(info.samplesperpixel, v16);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_EXTRASAMPLES, &v16, &extras);
+	CHECK(info.extrasamples, v16);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLEFORMAT, &v16);
+	CHECK(info.sampleformat, v16);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &v16);
+	CHECK(info.planarconfig, v16);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_PHOTOMETRIC, &v16);
+	CHECK(info.photometric, v16);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_COMPRESSION, &v16);
+	CHECK(info.compression, v16);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_FILLORDER, &v16);
+	CHECK(info.fillorder, v16);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_ORIENTATION, &v16);
+	CHECK(info.orientation, v16);
+	TIFFClose(tif);
+	return ok;
+}
+
+int
+main()
+{
+	int tiled;
+
+	for (tiled = 0; tiled < 2; tiled++)
+		if (!write_image(tiled) || !check_image(tiled))
+			goto failure;
+	unlink(filename);
+	return 0;
+
+failure:
+	unlink(filename);
+	return 1;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFRewriteDirectory() on a file opened with the 'I' flag
+ * updates the directory where it is when the new values fit, and still
+ * moves it to the end of the file when they do not.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "inplace_update.tif";
+
+#define	WIDTH		16
+#define	LENGTH		16
+#define	ROWSPERSTRIP	4
+#define	NDIRS		2
+
+static const char description[] = "a description of the image";
+static const char shorter[] = "shorter description";
+static const char longer[] =
+    "a description that is much longer than the one it replaces";
+
+static int
+write_file(const char* mode, int ndirs)
+{
+	TIFF* tif;
+	unsigned char buf[WIDTH * ROWSPERSTRIP];
+	int d;
+	uint32 s;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (d = 0; d < ndirs; d++) {
+		TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+		TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+		TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+		TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, description);
+		TIFFSetField(tif, TIFFTAG_ARTIST, "ab");
+		TIFFSetField(tif, TIFFTAG_XRESOLUTION, 72.0);
+		TIFFSetField(tif, TIFFTAG_YRESOLUTION, 72.0);
+		for (s = 0; s < TIFFNumberOfStrips(tif); s++) {
+			memset(buf, (int)(d * 16 + s), sizeof(buf));
+			if (TIFFWriteEncodedStrip(tif, s, buf, sizeof(buf)) == -1) {
+				fprintf (stderr, "Can't write strip %lu.\n",
+					 (unsigned long) s);
+				TIFFClose(tif);
+				return 0;
+			}
+		}
+		if (!TIFFWriteDirectory(tif)) {
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static uint64
+file_size(void)
+{
+	FILE* fp = fopen(filename, "rb");
+	long size;
+
+	if (!fp)
+		return 0;
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fclose(fp);
+	return (uint64) size;
+}
+
+/*
+ * Set new values in directory dirn and rewrite it, returning the
+ * offset the directory ends up at.
+ */
+static uint64
+update(const char* mode, tdir_t dirn, const char* desc, const char* artist,
+       float xres)
+{
+	TIFF* tif;
+	uint64 off = 0;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (!TIFFSetDirectory(tif, dirn) ||
+	    !TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, desc) ||
+	    !TIFFSetField(tif, TIFFTAG_ARTIST, artist) ||
+	    !TIFFSetField(tif, TIFFTAG_XRESOLUTION, xres) ||
+	    !TIFFRewriteDirectory(tif)) {
+		fprintf (stderr, "Can't update directory %d.\n", (int) dirn);
+		TIFFClose(tif);
+		return 0;
+	}
+	if (TIFFSetDirectory(tif, dirn))
+		off = TIFFCurrentDirOffset(tif);
+	TIFFClose(tif);
+	return off;
+}
+
+static int
+check_file(int ndirs, tdir_t dirn, const char* desc, const char* artist,
+	   float xres)
+{
+	TIFF* tif;
+	unsigned char buf[WIDTH * ROWSPERSTRIP];
+	char* str;
+	float res;
+	int d;
+	uint32 s;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (TIFFNumberOfDirectories(tif) != ndirs) {
+		fprintf (stderr, "Got %d directories instead of %d.\n",
+			 (int) TIFFNumberOfDirectories(tif), ndirs);
+		goto failure;
+	}
+	for (d = 0; d < ndirs; d++) {
+		int changed = (d == (int) dirn);
+
+		if (!TIFFSetDirectory(tif, (tdir_t) d))
+			goto failure;
+		if (!TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &str) ||
+		    strcmp(str, changed ? desc : description) != 0) {
+			fprintf (stderr, "Directory %d: wrong description.\n", d);
+			goto failure;
+		}
+		if (!TIFFGetField(tif, TIFFTAG_ARTIST, &str) ||
+		    strcmp(str, changed ? artist : "ab") != 0) {
+			fprintf (stderr, "Directory %d: wrong artist.\n", d);
+			goto failure;
+		}
+		if (!TIFFGetField(tif, TIFFTAG_XRESOLUTION, &res) ||
+		    res != (changed ? xres : 72.0f)) {
+			fprintf (stderr, "Directory %d: wrong resolution.\n", d);
+			goto failure;
+		}
+		for (s = 0; s < TIFFNumberOfStrips(tif); s++) {
+			if (TIFFReadEncodedStrip(tif, s, buf, sizeof(buf)) !=
+			    (tmsize_t) sizeof(buf) ||
+			    buf[0] != (unsigned char)(d * 16 + s) ||
+			    buf[sizeof(buf) - 1] != (unsigned char)(d * 16 + s)) {
+				fprintf (stderr, "Directory %d: wrong strip %lu.\n",
+					 d, (unsigned long) s);
+				goto failure;
+			}
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+static uint64
+dir_offset(tdir_t dirn)
+{
+	TIFF* tif = TIFFOpen(filename, "r");
+	uint64 off = 0;
+
+	if (!tif)
+		return 0;
+	if (TIFFSetDirectory(tif, dirn))
+		off = TIFFCurrentDirOffset(tif);
+	TIFFClose(tif);
+	return off;
+}
+
+static int
+test_mode(const char* mode)
+{
+	uint64 size, off;
+	tdir_t d;
+
+	/* Values that fit are updated without growing the file */
+	if (!write_file(mode, NDIRS))
+		return 0;
+	for (d = 0; d < NDIRS; d++) {
+		size = file_size();
+		off = dir_offset(d);
+		if (update("r+I", d, shorter, "cd", 300.0f) != off ||
+		    file_size() != size) {
+			fprintf (stderr, "%s: directory %d was moved.\n",
+				 mode, (int) d);
+			return 0;
+		}
+		if (!check_file(NDIRS, d, shorter, "cd", 300.0f))
+			return 0;
+		/* Same values again: nothing is written */
+		if (update("r+I", d, shorter, "cd", 300.0f) != off ||
+		    file_size() != size)
+			return 0;
+		if (!write_file(mode, NDIRS))
+			return 0;
+	}
+
+	/* Without the flag the directory is still relocated */
+	if (!write_file(mode, 1))
+		return 0;
+	size = file_size();
+	off = update("r+", 0, shorter, "cd", 300.0f);
+	if (off == 0 || file_size() == size) {
+		fprintf (stderr, "%s: directory was not relocated.\n", mode);
+		return 0;
+	}
+	if (!check_file(1, 0, shorter, "cd", 300.0f))
+		return 0;
+
+	/* A value that does not fit moves the directory */
+	if (!write_file(mode, 1))
+		return 0;
+	size = file_size();
+	off = dir_offset(0);
+	if (update("r+I", 0, longer, "a longer artist", 150.0f) == off ||
+	    file_size() <= size) {
+		fprintf (stderr, "%s: directory was not relocated.\n", mode);
+		return 0;
+	}
+	if (!check_file(1, 0, longer, "a longer artist", 150.0f))
+		return 0;
+	return 1;
+}
+
+int
+main()
+{
+	if (!test_mode("w") || !test_mode("wb") || !test_mode("w8") ||
+	    !test_mode("wb8"))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Write PLANARCONFIG_SEPARATE images with TIFFWriteEncodedStripInterleaved()
+ * and TIFFWriteEncodedTileInterleaved(), check the planes written, and
+ * read the pixels back interleaved, with the optimized code and the
+ * portable code.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "interleave.tif";
+
+#define	WIDTH		37
+#define	LENGTH		29
+#define	TILESIZE	16
+#define	ROWSPERSTRIP	5
+#define	MAXSPP		5
+#define	MAXCHUNK	(TILESIZE * TILESIZE * MAXSPP * 8)
+
+/* byte b of sample s of pixel i of chunk c */
+static unsigned char
+value(uint32 c, uint32 i, int s, int b)
+{
+	return (unsigned char) (c * 101 + i * 7 + s * 31 + b * 3);
+}
+
+static int
+write_image(int size, int spp, int tiled, uint32* npixels)
+{
+	unsigned char buf[MAXCHUNK];
+	TestImage im = { WIDTH, LENGTH, 0, 0, PLANARCONFIG_SEPARATE,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif;
+	uint32 c, i, nchunks, n;
+	int s, b;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.bitspersample = (uint16) (size * 8);
+	im.samplesperpixel = (uint16) spp;
+	if (tiled)
+		im.tilewidth = im.tilelength = TILESIZE;
+	set_image_fields(tif, &im);
+	if (tiled) {
+		nchunks = TIFFNumberOfTiles(tif) / spp;
+		n = TILESIZE * TILESIZE;
+	} else {
+		nchunks = TIFFNumberOfStrips(tif) / spp;
+		n = WIDTH * ROWSPERSTRIP;
+	}
+	for (c = 0; c < nchunks; c++) {
+		for (i = 0; i < n; i++)
+			for (s = 0; s < spp; s++)
+				for (b = 0; b < size; b++)
+					buf[(i * spp + s) * size + b] =
+					    value(c, i, s, b);
+		if ((tiled ?
+		    TIFFWriteEncodedTileInterleaved(tif, c, buf, n * spp * size) :
+		    TIFFWriteEncodedStripInterleaved(tif, c, buf,
+		    n * spp * size)) != (tmsize_t) (n * spp * size)) {
+			fprintf (stderr, "Can't write chunk %lu.\n",
+			    (unsigned long) c);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	*npixels = n;
+	return 1;
+}
+
+static int
+check_image(int size, int spp, int tiled, uint32 n)
+{
+	unsigned char buf[MAXCHUNK + 1];
+	TIFF* tif;
+	uint32 c, i, nchunks;
+	int s, b;
+	tmsize_t got;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open test TIFF file %s.\n", filename);
+		return 0;
+	}
+	nchunks = (tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif)) /
+	    spp;
+	/* each plane as written */
+	for (c = 0; c < nchunks; c++)
+		for (s = 0; s < spp; s++) {
+			got = tiled ?
+			    TIFFReadEncodedTile(tif, c + s * nchunks, buf, -1) :
+			    TIFFReadEncodedStrip(tif, c + s * nchunks, buf, -1);
+			if (got < (tmsize_t) size) {
+				fprintf (stderr, "Can't read chunk %lu.\n",
+				    (unsigned long) (c + s * nchunks));
+				TIFFClose(tif);
+				return 0;
+			}
+			for (i = 0; i < (uint32) got / size; i++)
+				for (b = 0; b < size; b++)
+					if (buf[i * size + b] != value(c, i, s, b)) {
+						fprintf (stderr, "%d-byte %d-sample "
+						    "chunk %lu sample %d: pixel "
+						    "%lu differs.\n", size, spp,
+						    (unsigned long) c, s,
+						    (unsigned long) i);
+						TIFFClose(tif);
+						return 0;
+					}
+		}
+	/* all the planes interleaved, chunk 1 into a short buffer */
+	for (c = 0; c < nchunks; c++) {
+		uint32 count = n;
+		tmsize_t limit = (tmsize_t) -1;
+
+		if (!tiled && c == nchunks - 1)
+			count = WIDTH * (LENGTH - c * ROWSPERSTRIP);
+		if (c == 1) {
+			count = 21;
+			limit = count * spp * size + size;
+		}
+		buf[count * spp * size] = 0xa5;
+		got = tiled ? TIFFReadEncodedTileInterleaved(tif, c, buf, limit) :
+		    TIFFReadEncodedStripInterleaved(tif, c, buf, limit);
+		if (got != (tmsize_t) (count * spp * size)) {
+			fprintf (stderr, "%d-byte %d-sample chunk %lu: read %ld "
+			    "bytes instead of %ld.\n", size, spp,
+			    (unsigned long) c, (long) got,
+			    (long) (count * spp * size));
+			TIFFClose(tif);
+			return 0;
+		}
+		if (buf[count * spp * size] != 0xa5) {
+			fprintf (stderr, "%d-byte %d-sample chunk %lu: read past "
+			    "the buffer.\n", size, spp, (unsigned long) c);
+			TIFFClose(tif);
+			return 0;
+		}
+		for (i = 0; i < count; i++)
+			for (s = 0; s < spp; s++)
+				for (b = 0; b < size; b++)
+					if (buf[(i * spp + s) * size + b] !=
+					    value(c, i, s, b)) {
+						fprintf (stderr, "%d-byte %d-sample "
+						    "chunk %lu: pixel %lu sample "
+						    "%d differs.\n", size, spp,
+						    (unsigned long) c,
+						    (unsigned long) i, s);
+						TIFFClose(tif);
+						return 0;
+					}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+int
+main()
+{
+	int pass, size, spp, tiled;
+	uint32 n;
+
+	for (pass = 0; pass < 2; pass++) {
+		if (pass == 1)
+			TIFFSetCPUFeatures(0);
+		for (size = 1; size <= 8; size *= 2)
+			for (spp = 2; spp <= MAXSPP; spp++)
+				for (tiled = 0; tiled < 2; tiled++) {
+					if (!write_image(size, spp, tiled, &n) ||
+					    !check_image(size, spp, tiled, n))
+						goto failure;
+				}
+	}
+	TIFFSetCPUFeatures(TIFF_CPU_ALL);
+	unlink(filename);
+	return 0;
+
+failure:
+	unlink(filename);
+	return 1;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,536 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * I/O benchmark: time the opening of files, the reading of their
+ * directories and random access to their pages and tiles, for the
+ * file sizes the library is expected to handle, and report the
+ * latencies as JSON.
+ *
+ *   iobench [-q] [-k] [-p pages] [-n tiles] [-r repeats] [-o file]
+ *
+ * Three files are written to the current directory: one image with
+ * GeoTIFF tags and an EXIF directory, a file of -p pages (default
+ * 10000) and a BigTIFF of -n tiles (default 1048576).  Each is then
+ * read with the open modes that change how it is read: through the
+ * memory mapping ('r') or read() calls ('rm'), with tags ('F') or
+ * strip and tile arrays ('O') loaded on demand.  -r gives the number
+ * of timed operations of each kind (default 1000), -k keeps the files
+ * and -q is a quick run on small files, used as a smoke test.  Times
+ * are wall-clock microseconds, with the files in the page cache as
+ * they were just written.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char tagsfile[] = "iobench_tags.tif";
+static const char pagesfile[] = "iobench_pages.tif";
+static const char tilesfile[] = "iobench_tiles.tif";
+
+#define	TILESIZE	16
+
+#define	GEOTAG_PIXELSCALE	33550
+#define	GEOTAG_TIEPOINTS	33922
+#define	GEOTAG_KEYDIRECTORY	34735
+#define	GEOTAG_DOUBLEPARAMS	34736
+#define	GEOTAG_ASCIIPARAMS	34737
+
+#define	NTIEPOINTS	1024
+#define	NGEOKEYS	32
+
+static const TIFFFieldInfo geofields[] = {
+	{ GEOTAG_PIXELSCALE, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, 1, 1,
+	  "GeoPixelScale" },
+	{ GEOTAG_TIEPOINTS, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, 1, 1,
+	  "GeoTiePoints" },
+	{ GEOTAG_KEYDIRECTORY, -1, -1, TIFF_SHORT, FIELD_CUSTOM, 1, 1,
+	  "GeoKeyDirectory" },
+	{ GEOTAG_DOUBLEPARAMS, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, 1, 1,
+	  "GeoDoubleParams" },
+	{ GEOTAG_ASCIIPARAMS, -1, -1, TIFF_ASCII, FIELD_CUSTOM, 1, 0,
+	  "GeoASCIIParams" },
+};
+
+static uint32 npages = 10000;
+static uint32 ntiles = 1048576;
+static uint32 repeats = 1000;
+
+static TIFFExtendProc parent_extender;
+
+#define	NITEMS(a)	(sizeof(a) / sizeof((a)[0]))
+
+/*
+ * Register the GeoTIFF tags with every handle, as libgeotiff does.
+ */
+static void
+geotiff_extender(TIFF* tif)
+{
+	TIFFMergeFieldInfo(tif, geofields, NITEMS(geofields));
+	if (parent_extender)
+		(*parent_extender)(tif);
+}
+
+/*
+ * Return a monotonic time in microseconds.
+ */
+static double
+now(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER freq, t;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t);
+	return (double) t.QuadPart * 1e6 / (double) freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec * 1e6 + (double) ts.tv_nsec / 1e3;
+#else
+	return (double) clock() * 1e6 / CLOCKS_PER_SEC;
+#endif
+}
+
+static uint32
+noise(uint32* state)
+{
+	*state = *state * 1103515245U + 12345U;
+	return *state >> 8;
+}
+
+/*
+ * Write a small image whose main directory carries the tags of a
+ * georeferenced scan, with a grid of tie points, and an EXIF directory
+ * with a maker note.
+ */
+static int
+write_tags_file(uint64* exifoff)
+{
+	TestImage im = { 64, 1, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, 1, 0, 0 };
+	TIFF* tif;
+	unsigned char row[64];
+	double scale[3] = { 0.5, 0.5, 0 };
+	double* ties;
+	uint16 keys[4 * (NGEOKEYS + 1)];
+	double params[NGEOKEYS];
+	char xmp[4096];
+	unsigned char makernote[8192];
+	uint16 iso = 200;
+	int i;
+
+	ties = (double*) malloc(6 * NTIEPOINTS * sizeof(double));
+	if (!ties) {
+		fprintf (stderr, "Out of memory.\n");
+		return 0;
+	}
+	for (i = 0; i < 6 * NTIEPOINTS; i++)
+		ties[i] = (double) (i * 37 % 1000) / 3.0;
+	keys[0] = 1;
+	keys[1] = 1;
+	keys[2] = 0;
+	keys[3] = NGEOKEYS;
+	for (i = 0; i < NGEOKEYS; i++) {
+		keys[4 * (i + 1)] = (uint16) (1024 + i);
+		keys[4 * (i + 1) + 1] = GEOTAG_DOUBLEPARAMS;
+		keys[4 * (i + 1) + 2] = 1;
+		keys[4 * (i + 1) + 3] = (uint16) i;
+		params[i] = 6378137.0 / (i + 1);
+	}
+	memset(xmp, ' ', sizeof(xmp) - 1);
+	memcpy(xmp, "<x:xmpmeta xmlns:x='adobe:ns:meta/'>", 36);
+	xmp[sizeof(xmp) - 1] = '\0';
+	for (i = 0; i < (int) sizeof(makernote); i++)
+		makernote[i] = (unsigned char) (i * 7);
+	memset(row, 0x80, sizeof(row));
+
+	tif = TIFFOpen(tagsfile, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", tagsfile);
+		free(ties);
+		return 0;
+	}
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, "iobench tagged image");
+	TIFFSetField(tif, TIFFTAG_SOFTWARE, "iobench");
+	TIFFSetField(tif, TIFFTAG_DATETIME, "2026:10:14 12:00:00");
+	TIFFSetField(tif, TIFFTAG_XMLPACKET, (uint32) sizeof(xmp), xmp);
+	TIFFSetField(tif, GEOTAG_PIXELSCALE, 3, scale);
+	TIFFSetField(tif, GEOTAG_TIEPOINTS, 6 * NTIEPOINTS, ties);
+	TIFFSetField(tif, GEOTAG_KEYDIRECTORY, 4 * (NGEOKEYS + 1), keys);
+	TIFFSetField(tif, GEOTAG_DOUBLEPARAMS, NGEOKEYS, params);
+	TIFFSetField(tif, GEOTAG_ASCIIPARAMS, "WGS 84 / UTM zone 31N|WGS 84|");
+	free(ties);
+	if (TIFFWriteScanline(tif, row, 0, 0) == -1 ||
+	    !TIFFWriteDirectory(tif)) {
+		fprintf (stderr, "Can't write %s.\n", tagsfile);
+		TIFFClose(tif);
+		return 0;
+	}
+
+	if (TIFFCreateEXIFDirectory(tif) != 0) {
+		fprintf (stderr, "TIFFCreateEXIFDirectory() failed.\n");
+		TIFFClose(tif);
+		return 0;
+	}
+	TIFFSetField(tif, EXIFTAG_EXPOSURETIME, 1.0 / 250);
+	TIFFSetField(tif, EXIFTAG_FNUMBER, 5.6);
+	TIFFSetField(tif, EXIFTAG_ISOSPEEDRATINGS, 1, &iso);
+	TIFFSetField(tif, EXIFTAG_DATETIMEORIGINAL, "2026:10:14 12:00:00");
+	TIFFSetField(tif, EXIFTAG_FOCALLENGTH, 35.0);
+	TIFFSetField(tif, EXIFTAG_MAKERNOTE, (uint16) sizeof(makernote),
+	    makernote);
+	TIFFSetField(tif, EXIFTAG_USERCOMMENT, 8, "ASCII\0\0\0");
+	if (!TIFFWriteCustomDirectory(tif, exifoff)) {
+		fprintf (stderr, "Can't write the EXIF directory.\n");
+		TIFFClose(tif);
+		return 0;
+	}
+	TIFFSetDirectory(tif, 0);
+	TIFFSetField(tif, TIFFTAG_EXIFIFD, *exifoff);
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+write_pages_file(void)
+{
+	TestImage im = { 16, 1, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, 1, 0, 0 };
+	TIFF* tif;
+	unsigned char row[16];
+	uint32 i;
+
+	tif = TIFFOpen(pagesfile, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", pagesfile);
+		return 0;
+	}
+	for (i = 0; i < npages; i++) {
+		memset(row, (int) (i & 0xff), sizeof(row));
+		set_image_fields(tif, &im);
+		TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+		TIFFSetField(tif, TIFFTAG_PAGENUMBER, (uint16) i,
+		    (uint16) npages);
+		if (TIFFWriteScanline(tif, row, 0, 0) == -1 ||
+		    !TIFFWriteDirectory(tif)) {
+			fprintf (stderr, "Can't write page %lu.\n",
+				 (unsigned long) i);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+/*
+ * Write a BigTIFF of at least ntiles PackBits compressed tiles, in a
+ * square grid.  Each tile holds its number, so that reads from the
+ * wrong place are noticed.
+ */
+static int
+write_tiles_file(uint32* across)
+{
+	TestImage im = { 0, 0, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_PACKBITS, 0,
+	    TILESIZE, TILESIZE };
+	TIFF* tif;
+	unsigned char tile[TILESIZE * TILESIZE];
+	uint32 n = 1, i;
+
+	while (n * n < ntiles)
+		n++;
+	*across = n;
+	tif = TIFFOpen(tilesfile, "w8");
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", tilesfile);
+		return 0;
+	}
+	im.width = im.length = n * TILESIZE;
+	set_image_fields(tif, &im);
+	for (i = 0; i < n * n; i++) {
+		memset(tile, (int) (i & 0xff), sizeof(tile));
+		if (TIFFWriteEncodedTile(tif, i, tile, sizeof(tile)) == -1) {
+			fprintf (stderr, "Can't write tile %lu.\n",
+				 (unsigned long) i);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	if (!TIFFWriteDirectory(tif)) {
+		TIFFClose(tif);
+		return 0;
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static void
+report(FILE* out, int* first, const char* file, const char* mode,
+       const char* measure, double total, uint32 count)
+{
+	fprintf(out, "%s    {\"file\": \"%s\", \"mode\": \"%s\", "
+	    "\"measure\": \"%s\", \"count\": %lu, \"microseconds\": %.3f}",
+	    *first ? "" : ",\n", file, mode, measure, (unsigned long) count,
+	    count ? total / count : 0);
+	*first = 0;
+}
+
+static int
+bench_open(FILE* out, int* first, const char* filename, const char* mode)
+{
+	double start = now();
+	uint32 i;
+
+	for (i = 0; i < repeats; i++) {
+		TIFF* tif = TIFFOpen(filename, mode);
+
+		if (!tif)
+			return 0;
+		TIFFClose(tif);
+	}
+	report(out, first, filename, mode, "open", now() - start, repeats);
+	return 1;
+}
+
+static int
+bench_tags(FILE* out, int* first, const char* mode, uint64 exifoff)
+{
+	TIFF* tif;
+	double start;
+	uint32 i;
+	uint16 count;
+	double* ties;
+
+	if (!bench_open(out, first, tagsfile, mode))
+		return 0;
+	tif = TIFFOpen(tagsfile, mode);
+	if (!tif)
+		return 0;
+	start = now();
+	for (i = 0; i < repeats; i++) {
+		/* setting the current directory again reads it again */
+		if (!TIFFSetDirectory(tif, 0) ||
+		    !TIFFGetField(tif, GEOTAG_TIEPOINTS, &count, &ties) ||
+		    count != 6 * NTIEPOINTS) {
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	report(out, first, tagsfile, mode, "readdirectory", now() - start,
+	    repeats);
+	start = now();
+	for (i = 0; i < repeats; i++) {
+		if (!TIFFReadEXIFDirectory(tif, exifoff)) {
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	report(out, first, tagsfile, mode, "readexifdirectory",
+	    now() - start, repeats);
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+bench_pages(FILE* out, int* first, const char* mode)
+{
+	TIFF* tif;
+	double start;
+	uint32 state = 1, i;
+
+	tif = TIFFOpen(pagesfile, mode);
+	if (!tif)
+		return 0;
+	start = now();
+	if (!TIFFSetDirectory(tif, (tdir_t) (npages - 1))) {
+		TIFFClose(tif);
+		return 0;
+	}
+	report(out, first, pagesfile, mode, "setdirectory_last_first",
+	    now() - start, 1);
+	start = now();
+	for (i = 0; i < repeats; i++) {
+		if (!TIFFSetDirectory(tif, (tdir_t) (noise(&state) % npages))) {
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	report(out, first, pagesfile, mode, "setdirectory_random",
+	    now() - start, repeats);
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+bench_tiles(FILE* out, int* first, const char* mode, uint32 across)
+{
+	unsigned char tile[TILESIZE * TILESIZE];
+	TIFF* tif;
+	double start;
+	uint32 state = 1, i;
+
+	start = now();
+	tif = TIFFOpen(tilesfile, mode);
+	if (!tif)
+		return 0;
+	report(out, first, tilesfile, mode, "open_first", now() - start, 1);
+	start = now();
+	if (TIFFReadEncodedTile(tif, across * across - 1, tile,
+	    sizeof(tile)) != sizeof(tile)) {
+		TIFFClose(tif);
+		return 0;
+	}
+	report(out, first, tilesfile, mode, "readtile_first", now() - start, 1);
+	start = now();
+	for (i = 0; i < repeats; i++) {
+		uint32 t = noise(&state) % (across * across);
+
+		if (TIFFReadEncodedTile(tif, t, tile, sizeof(tile)) !=
+		    sizeof(tile) || tile[0] != (t & 0xff) ||
+		    tile[sizeof(tile) - 1] != (t & 0xff)) {
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	report(out, first, tilesfile, mode, "readtile_random",
+	    now() - start, repeats);
+	TIFFClose(tif);
+	return 1;
+}
+
+static void
+usage(void)
+{
+	fprintf (stderr,
+		 "usage: iobench [-q] [-k] [-p pages] [-n tiles] [-r repeats] "
+		 "[-o file]\n");
+	exit(1);
+}
+
+int
+main(int argc, char* argv[])
+{
+	static const char* tagsmodes[] = { "r", "rm", "rF", "rmF" };
+	static const char* pagesmodes[] = { "r", "rm" };
+	static const char* tilesmodes[] = { "r", "rm", "rO", "rmO" };
+	const char* outname = NULL;
+	FILE* out = stdout;
+	int first = 1, keep = 0, i;
+	uint64 exifoff = 0;
+	uint32 across = 0;
+	size_t m;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-q") == 0) {
+			npages = 100;
+			ntiles = 4096;
+			repeats = 20;
+		} else if (strcmp(argv[i], "-k") == 0)
+			keep = 1;
+		else if (i + 1 < argc && strcmp(argv[i], "-p") == 0)
+			npages = (uint32) atol(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-n") == 0)
+			ntiles = (uint32) atol(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-r") == 0)
+			repeats = (uint32) atol(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-o") == 0)
+			outname = argv[++i];
+		else
+			usage();
+	}
+	if (npages == 0 || npages > 65535 || ntiles == 0 || repeats == 0)
+		usage();
+
+	parent_extender = TIFFSetTagExtender(geotiff_extender);
+	if (!write_tags_file(&exifoff) || !write_pages_file() ||
+	    !write_tiles_file(&across))
+		return 1;
+	if (outname && (out = fopen(outname, "w")) == NULL) {
+		fprintf (stderr, "Can't create %s.\n", outname);
+		return 1;
+	}
+
+	fprintf(out, "{\n  \"pages\": %lu, \"tiles\": %lu, \"repeats\": %lu,\n"
+	    "  \"results\": [\n", (unsigned long) npages,
+	    (unsigned long) (across * across), (unsigned long) repeats);
+	for (m = 0; m < NITEMS(tagsmodes); m++) {
+		if (!bench_tags(out, &first, tagsmodes[m], exifoff)) {
+			fprintf (stderr, "%s (mode %s) failed.\n", tagsfile,
+				 tagsmodes[m]);
+			return 1;
+		}
+	}
+	for (m = 0; m < NITEMS(pagesmodes); m++) {
+		if (!bench_open(out, &first, pagesfile, pagesmodes[m]) ||
+		    !bench_pages(out, &first, pagesmodes[m])) {
+			fprintf (stderr, "%s (mode %s) failed.\n", pagesfile,
+				 pagesmodes[m]);
+			return 1;
+		}
+	}
+	for (m = 0; m < NITEMS(tilesmodes); m++) {
+		if (!bench_tiles(out, &first, tilesmodes[m], across)) {
+			fprintf (stderr, "%s (mode %s) failed.\n", tilesfile,
+				 tilesmodes[m]);
+			return 1;
+		}
+	}
+	fputs("\n  ]\n}\n", out);
+	if (outname)
+		fclose(out);
+	if (!keep) {
+		unlink(tagsfile);
+		unlink(pagesfile);
+		unlink(tilesfile);
+	}
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check the JBIG codec: a bilevel page written in either fill order must
+ * read back unchanged a scanline at a time (also after seeking back to
+ * the start of the strip), as a whole strip and into a buffer shorter
+ * than the strip.  Does nothing if the library is built without JBIG support.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "jbig.tif";
+
+#define	WIDTH		300	/* rows do not end on a byte boundary */
+#define	LENGTH		200
+#define	ROWBYTES	((WIDTH + 7) / 8)
+
+static unsigned char image[ROWBYTES * LENGTH];
+
+/* Black discs and bars on white, with the row padding bits cleared */
+static void
+fill_image(void)
+{
+	uint32 x, y;
+
+	memset(image, 0, sizeof(image));
+	for (y = 0; y < LENGTH; y++)
+		for (x = 0; x < WIDTH; x++) {
+			int dx = (int) (x % 50) - 25, dy = (int) (y % 50) - 25;
+
+			if (dx * dx + dy * dy < 300 || (x / 7 + y) % 31 == 0)
+				image[y * ROWBYTES + x / 8] |= 0x80 >> (x % 8);
+		}
+}
+
+static int
+write_page(uint16 fillorder)
+{
+	TIFF* tif = TIFFOpen(filename, "w");
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 1);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISWHITE);
+	TIFFSetField(tif, TIFFTAG_FILLORDER, fillorder);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, LENGTH);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_JBIG);
+	if (TIFFWriteEncodedStrip(tif, 0, image, sizeof(image)) == -1) {
+		fprintf (stderr, "Can't write JBIG strip.\n");
+		TIFFClose(tif);
+		return 0;
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+read_page(void)
+{
+	static unsigned char out[ROWBYTES * LENGTH];
+	TIFF* tif;
+	uint32 row;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+
+	/* Half the rows, then all of them again from the top */
+	memset(out, 0, sizeof(out));
+	for (row = 0; row < LENGTH / 2; row++)
+		if (TIFFReadScanline(tif, out + row * ROWBYTES, row, 0) == -1)
+			goto failure;
+	for (row = 0; row < LENGTH; row++)
+		if (TIFFReadScanline(tif, out + row * ROWBYTES, row, 0) == -1)
+			goto failure;
+	if (memcmp(out, image, sizeof(out)) != 0) {
+		fprintf (stderr, "JBIG scanlines do not read back.\n");
+		goto failure;
+	}
+
+	memset(out, 0, sizeof(out));
+	if (TIFFReadEncodedStrip(tif, 0, out, (tmsize_t) -1) !=
+	    (tmsize_t) sizeof(out) || memcmp(out, image, sizeof(out)) != 0) {
+		fprintf (stderr, "JBIG strip does not read back.\n");
+		goto failure;
+	}
+
+	/* Only the requested bytes are written */
+	memset(out, 0xAA, sizeof(out));
+	if (TIFFReadEncodedStrip(tif, 0, out, 10 * ROWBYTES) !=
+	    10 * ROWBYTES || memcmp(out, image, 10 * ROWBYTES) != 0 ||
+	    out[10 * ROWBYTES] != 0xAA) {
+		fprintf (stderr, "Short JBIG strip read is wrong.\n");
+		goto failure;
+	}
+
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+int
+main()
+{
+	if (!TIFFIsCODECConfigured(COMPRESSION_JBIG))
+		return 0;
+	fill_image();
+
+	if (!write_page(FILLORDER_MSB2LSB) || !read_page())
+		return 1;
+	if (!write_page(FILLORDER_LSB2MSB) || !read_page())
+		return 1;
+
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
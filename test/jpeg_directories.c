@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that the JPEG decompressor kept from directory to directory
+ * decodes every directory of a series as a handle opened on it alone
+ * does, whatever the order the directories are read in, and with
+ * directories of another codec or JPEG layout in between.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "jpeg_directories.tif";
+
+#define	WIDTH		72
+#define	LENGTH		64
+#define	ROWSPERSTRIP	16
+#define	NDIRS		5
+#define	STRIPSIZE	(WIDTH * ROWSPERSTRIP * 3)
+
+/* Compression, samples per pixel and photometric of each directory */
+static const uint16 layout[NDIRS][3] = {
+	{ COMPRESSION_JPEG, 1, PHOTOMETRIC_MINISBLACK },
+	{ COMPRESSION_JPEG, 3, PHOTOMETRIC_YCBCR },
+	{ COMPRESSION_ADOBE_DEFLATE, 1, PHOTOMETRIC_MINISBLACK },
+	{ COMPRESSION_JPEG, 3, PHOTOMETRIC_RGB },
+	{ COMPRESSION_JPEG, 1, PHOTOMETRIC_MINISBLACK },
+};
+
+static unsigned char ref[NDIRS][LENGTH / ROWSPERSTRIP][STRIPSIZE];
+static tmsize_t refsize[NDIRS][LENGTH / ROWSPERSTRIP];
+
+static int
+write_file(void)
+{
+	unsigned char row[WIDTH * 3];
+	TIFF* tif;
+	uint32 x, y;
+	int d;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (d = 0; d < NDIRS; d++) {
+		TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+		TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, layout[d][1]);
+		TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, layout[d][2]);
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+		TIFFSetField(tif, TIFFTAG_COMPRESSION, layout[d][0]);
+		if (layout[d][2] == PHOTOMETRIC_YCBCR)
+			TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE,
+				     JPEGCOLORMODE_RGB);
+		if (layout[d][0] == COMPRESSION_JPEG)
+			TIFFSetField(tif, TIFFTAG_JPEGQUALITY, 60 + d * 8);
+		for (y = 0; y < LENGTH; y++) {
+			for (x = 0; x < WIDTH * layout[d][1]; x++)
+				row[x] = (unsigned char) (x * (d + 1) + y * 5);
+			if (TIFFWriteScanline(tif, row, y, 0) == -1) {
+				TIFFClose(tif);
+				return 0;
+			}
+		}
+		if (!TIFFWriteDirectory(tif)) {
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+/* Read directory d of tif and compare it to ref, or fill ref */
+static int
+read_directory(TIFF* tif, int d, int fill)
+{
+	unsigned char buf[STRIPSIZE];
+	uint32 s;
+
+	if (!TIFFSetDirectory(tif, (uint16) d))
+		return 0;
+	for (s = 0; s < TIFFNumberOfStrips(tif); s++) {
+		tmsize_t n = TIFFReadEncodedStrip(tif, s, buf, sizeof(buf));
+
+		if (n <= 0)
+			return 0;
+		if (fill) {
+			memcpy(ref[d][s], buf, n);
+			refsize[d][s] = n;
+		} else if (n != refsize[d][s] ||
+			   memcmp(buf, ref[d][s], n) != 0) {
+			fprintf (stderr, "Directory %d strip %u differs.\n",
+				 d, s);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int
+main()
+{
+	static const int order[] = { 0, 1, 2, 3, 4, 3, 0, 4, 1, 1, 2, 0 };
+	TIFF* tif;
+	int i, d;
+
+	if (!TIFFIsCODECConfigured(COMPRESSION_JPEG) ||
+	    !TIFFIsCODECConfigured(COMPRESSION_ADOBE_DEFLATE))
+		return 0;
+	if (!write_file())
+		return 1;
+
+	/* Each directory through a handle of its own */
+	for (d = 0; d < NDIRS; d++) {
+		tif = TIFFOpen(filename, "r");
+		if (!tif || !read_directory(tif, d, 1)) {
+			fprintf (stderr, "Can't read directory %d.\n", d);
+			if (tif)
+				TIFFClose(tif);
+			return 1;
+		}
+		TIFFClose(tif);
+	}
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif)
+		return 1;
+	for (i = 0; i < (int) (sizeof(order) / sizeof(order[0])); i++)
+		if (!read_directory(tif, order[i], 0)) {
+			fprintf (stderr, "Directory %d differs in a series.\n",
+				 order[i]);
+			TIFFClose(tif);
+			return 1;
+		}
+	TIFFClose(tif);
+
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
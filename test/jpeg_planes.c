@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that JPEGCOLORMODE_PLANES returns the same samples as the
+ * packed YCbCr layout, as separate Y, Cb and Cr planes.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "jpeg_planes.tif";
+
+#define	WIDTH		80
+#define	LENGTH		72
+#define	TILESIZE	32
+#define	ROWSPERSTRIP	16
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	tmsize_t i;
+
+	(void) arg;
+	for (i = 0; i < c->size; i++)
+		c->buf[i] = (unsigned char)((i * 7 + c->index * 29 + (i / 97) * 3) & 0xff);
+}
+
+static int
+write_image(int tiled, uint16 hs, uint16 vs)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 3, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_YCBCR, COMPRESSION_JPEG, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	if (tiled)
+		im.tilewidth = im.tilelength = TILESIZE;
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_YCBCRSUBSAMPLING, hs, vs);
+	ok = write_image_data(tif, fill_chunk, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+/*
+ * Read every chunk packed and as planes, and check that each plane
+ * sample matches the corresponding sample of the packed clumps.
+ */
+static int
+check_image(int tiled, uint16 hs, uint16 vs)
+{
+	TIFF* tif;
+	unsigned char *packed = NULL, *planes = NULL;
+	tmsize_t size;
+	uint32 n, c, w, h, x, y, cpl, cw, ch;
+	int ret = 0;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	packed = (unsigned char*) malloc(size);
+	planes = (unsigned char*) malloc(size);
+	if (!packed || !planes)
+		goto failure;
+	for (c = 0; c < n; c++) {
+		const unsigned char *py, *pcb, *pcr;
+
+		TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RAW);
+		if ((tiled ? TIFFReadEncodedTile(tif, c, packed, size) :
+		     TIFFReadEncodedStrip(tif, c, packed, size)) == -1)
+			goto failure;
+		TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_PLANES);
+		if ((tiled ? TIFFReadEncodedTile(tif, c, planes, size) :
+		     TIFFReadEncodedStrip(tif, c, planes, size)) == -1) {
+			fprintf (stderr, "Planar read of chunk %lu failed.\n",
+				 (unsigned long) c);
+			goto failure;
+		}
+		if (tiled) {
+			w = TILESIZE;
+			h = TILESIZE;
+		} else {
+			w = WIDTH;
+			h = LENGTH - c * ROWSPERSTRIP;
+			if (h > ROWSPERSTRIP)
+				h = ROWSPERSTRIP;
+		}
+		cpl = (w + hs - 1) / hs;
+		cw = cpl;
+		ch = (h + vs - 1) / vs;
+		py = planes;
+		pcb = py + w * h;
+		pcr = pcb + cw * ch;
+		for (y = 0; y < h; y++) {
+			for (x = 0; x < w; x++) {
+				const unsigned char* clump = packed +
+				    ((y / vs) * cpl + x / hs) * (hs * vs + 2);
+				int ok = py[y * w + x] == clump[(y % vs) * hs + x % hs];
+
+				if (x % hs == 0 && y % vs == 0)
+					ok = ok &&
+					    pcb[(y / vs) * cw + x / hs] == clump[hs * vs] &&
+					    pcr[(y / vs) * cw + x / hs] == clump[hs * vs + 1];
+				if (!ok) {
+					fprintf (stderr, "Chunk %lu differs at %lu,%lu.\n",
+						 (unsigned long) c,
+						 (unsigned long) x, (unsigned long) y);
+					goto failure;
+				}
+			}
+		}
+	}
+
+	/* Scanline access is refused */
+	if (!tiled && TIFFReadScanline(tif, planes, 0, 0) != -1) {
+		fprintf (stderr, "Scanline read was accepted.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	free(packed);
+	free(planes);
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	static const uint16 sampling[][2] = { { 2, 2 }, { 2, 1 }, { 1, 1 } };
+	int i, tiled;
+
+	if (!TIFFIsCODECConfigured(COMPRESSION_JPEG))
+		return 0;
+	for (i = 0; i < 3; i++) {
+		for (tiled = 0; tiled < 2; tiled++) {
+			if (!write_image(tiled, sampling[i][0], sampling[i][1]) ||
+			    !check_image(tiled, sampling[i][0], sampling[i][1])) {
+				fprintf (stderr, "Failed for %dx%d %s.\n",
+					 sampling[i][0], sampling[i][1],
+					 tiled ? "tiles" : "strips");
+				return 1;
+			}
+		}
+	}
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check reduced size decoding of JPEG compressed tiles through
+ * TIFFTAG_JPEGSCALEDENOM: the tiles must come out at 1/N of their size
+ * and close to a box filtered full size decode, serially and with
+ * TIFFReadEncodedTilesParallel().  Does nothing if the library is built
+ * without JPEG support.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "jpeg_scaled.tif";
+
+#define	WIDTH		256
+#define	LENGTH		256
+#define	TILESIZE	128
+#define	NTILES		((WIDTH / TILESIZE) * (LENGTH / TILESIZE))
+
+static void
+fill_tile(TestChunk* c, void* arg)
+{
+	uint32 spp = c->samples, i;
+
+	(void) arg;
+	/* Smooth gradients, which survive scaling well */
+	for (i = 0; i < (uint32) c->size; i++) {
+		uint32 x = (i / spp) % TILESIZE, y = (i / spp) / TILESIZE;
+
+		c->buf[i] = (unsigned char) ((x + y + c->index * 40 +
+		    (i % spp) * 60) & 0xff);
+		if (x + y + c->index * 40 + (i % spp) * 60 >= 256)
+			c->buf[i] = (unsigned char) (255 - c->buf[i]);
+	}
+}
+
+static int
+write_image(int ycbcr)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_JPEG, 0, TILESIZE, TILESIZE };
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	if (ycbcr) {
+		im.samplesperpixel = 3;
+		im.photometric = PHOTOMETRIC_YCBCR;
+	}
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_JPEGQUALITY, 90);
+	if (ycbcr)
+		TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+	ok = write_image_data(tif, fill_tile, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+/*
+ * Compare a tile decoded at 1/denom size with the box filtered full
+ * size one.
+ */
+static int
+compare_scaled(const unsigned char* full, const unsigned char* scaled,
+	       int denom, int spp)
+{
+	uint32 size = TILESIZE / denom;
+	uint32 x, y, c, i, j;
+	double total = 0.0;
+
+	for (y = 0; y < size; y++)
+		for (x = 0; x < size; x++)
+			for (c = 0; c < (uint32) spp; c++) {
+				double sum = 0.0;
+
+				for (j = 0; j < (uint32) denom; j++)
+					for (i = 0; i < (uint32) denom; i++)
+						sum += full[((y * denom + j) * TILESIZE +
+						    x * denom + i) * spp + c];
+				sum /= denom * denom;
+				sum -= scaled[(y * size + x) * spp + c];
+				total += sum < 0 ? -sum : sum;
+			}
+	total /= size * size * spp;
+	if (total > 4.0) {
+		fprintf (stderr, "1/%d decode differs by %.2f on average.\n",
+			 denom, total);
+		return 0;
+	}
+	return 1;
+}
+
+static int
+check_image(int ycbcr)
+{
+	int spp = ycbcr ? 3 : 1;
+	tmsize_t fullsize = TILESIZE * TILESIZE * spp;
+	unsigned char* full = NULL;
+	unsigned char* scaled = NULL;
+	unsigned char* bufs[NTILES];
+	uint32 list[NTILES];
+	TIFF* tif;
+	uint32 tile;
+	int denom, ret = 0;
+
+	memset(bufs, 0, sizeof(bufs));
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (ycbcr)
+		TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+	full = (unsigned char*) malloc(fullsize);
+	scaled = (unsigned char*) malloc(fullsize);
+	for (tile = 0; tile < NTILES; tile++) {
+		list[tile] = tile;
+		bufs[tile] = (unsigned char*) malloc(fullsize);
+		if (!bufs[tile])
+			goto failure;
+	}
+	if (!full || !scaled)
+		goto failure;
+
+	for (denom = 2; denom <= 8; denom *= 2) {
+		tmsize_t size = fullsize / (denom * denom);
+
+		for (tile = 0; tile < NTILES; tile++) {
+			if (!TIFFSetField(tif, TIFFTAG_JPEGSCALEDENOM, 1) ||
+			    TIFFReadEncodedTile(tif, tile, full, fullsize) == -1)
+				goto failure;
+			if (!TIFFSetField(tif, TIFFTAG_JPEGSCALEDENOM, denom) ||
+			    TIFFReadEncodedTile(tif, tile, scaled, size) == -1) {
+				fprintf (stderr, "1/%d decode failed.\n", denom);
+				goto failure;
+			}
+			if (!compare_scaled(full, scaled, denom, spp))
+				goto failure;
+		}
+		if (!TIFFReadEncodedTilesParallel(tif, list, NTILES,
+						  (void**) bufs, size, 2)) {
+			fprintf (stderr, "1/%d parallel decode failed.\n", denom);
+			goto failure;
+		}
+		for (tile = 0; tile < NTILES; tile++)
+			if (TIFFReadEncodedTile(tif, tile, scaled, size) == -1 ||
+			    memcmp(scaled, bufs[tile], size) != 0) {
+				fprintf (stderr, "1/%d parallel decode differs.\n",
+					 denom);
+				goto failure;
+			}
+	}
+	if (TIFFSetField(tif, TIFFTAG_JPEGSCALEDENOM, 3)) {
+		fprintf (stderr, "JPEGSCALEDENOM 3 accepted.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	for (tile = 0; tile < NTILES; tile++)
+		free(bufs[tile]);
+	free(full);
+	free(scaled);
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!TIFFIsCODECConfigured(COMPRESSION_JPEG))
+		return 0;
+	if (!write_image(0) || !check_image(0))
+		return 1;
+	if (!write_image(1) || !check_image(1))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that strip/tile offsets and byte counts loaded on demand
+ * (TIFFOpen() 'O' flag) match those read with the directory.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "lazy_striles.tif";
+
+#define	WIDTH		1024
+#define	LENGTH		512
+#define	TILESIZE	16
+
+static void
+fill_tile(TestChunk* c, void* arg)
+{
+	(void) arg;
+	/* Vary the compressed size from tile to tile */
+	memset(c->buf, (int)(c->index & 0xff), c->size);
+	c->buf[c->index % c->size] ^= 0x55;
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_PACKBITS, 0,
+	    TILESIZE, TILESIZE };
+
+	return write_test_image(filename, &im, fill_tile, NULL);
+}
+
+static int
+check_image(const char* mode)
+{
+	TIFF* ref;
+	TIFF* tif;
+	unsigned char a[TILESIZE * TILESIZE], b[TILESIZE * TILESIZE];
+	static const uint32 tiles[] = { 1500, 0, 2047, 1023, 1024 };
+	uint64* offsets;
+	uint32 i, n;
+	int err, ret = 0;
+
+	ref = TIFFOpen(filename, "r");
+	tif = TIFFOpen(filename, mode);
+	if (!ref || !tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	n = TIFFNumberOfTiles(tif);
+	for (i = 0; i < sizeof(tiles) / sizeof(tiles[0]); i++) {
+		uint32 t = tiles[i];
+
+		if (TIFFGetStrileOffset(tif, t) != TIFFGetStrileOffset(ref, t) ||
+		    TIFFGetStrileByteCount(tif, t) !=
+		    TIFFGetStrileByteCount(ref, t)) {
+			fprintf (stderr, "Mode %s: location of tile %lu differs.\n",
+				 mode, (unsigned long) t);
+			goto failure;
+		}
+		if (TIFFReadEncodedTile(tif, t, a, sizeof(a)) != sizeof(a) ||
+		    TIFFReadEncodedTile(ref, t, b, sizeof(b)) != sizeof(b) ||
+		    memcmp(a, b, sizeof(a)) != 0) {
+			fprintf (stderr, "Mode %s: tile %lu differs.\n",
+				 mode, (unsigned long) t);
+			goto failure;
+		}
+	}
+	if (TIFFGetStrileOffsetWithErr(tif, n, &err) != 0 || !err) {
+		fprintf (stderr, "Mode %s: out of range tile was accepted.\n",
+			 mode);
+		goto failure;
+	}
+	/* Asking for the whole array loads it */
+	if (!TIFFGetField(tif, TIFFTAG_TILEOFFSETS, &offsets)) {
+		fprintf (stderr, "Mode %s: no TileOffsets.\n", mode);
+		goto failure;
+	}
+	for (i = 0; i < n; i++) {
+		if (offsets[i] != TIFFGetStrileOffset(ref, i)) {
+			fprintf (stderr, "Mode %s: TileOffsets[%lu] differs.\n",
+				 mode, (unsigned long) i);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	if (ref)
+		TIFFClose(ref);
+	if (tif)
+		TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image())
+		return 1;
+	if (!check_image("rO") || !check_image("rmO"))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
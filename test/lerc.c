@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check the LERC codec: floating point strips written whole or a
+ * scanline at a time must read back within the maximum error, exactly
+ * when it is 0, with NaN pixels kept, and tiles of 16 bit RGB data must
+ * read back unchanged with the LERC data compressed further by Deflate.
+ * Does nothing if the library is built without LERC support.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "lerc.tif";
+
+#define	WIDTH		200
+#define	LENGTH		100	/* last strip is short */
+#define	ROWSPERSTRIP	32
+#define	TILESIZE	64
+
+static float image[WIDTH * LENGTH];
+static uint16 rgb[WIDTH * LENGTH * 3];
+
+/* An elevation model: smooth hills with some noise */
+static void
+fill_images(void)
+{
+	uint32 seed = 7;
+	uint32 x, y, i;
+
+	for (y = 0; y < LENGTH; y++)
+		for (x = 0; x < WIDTH; x++) {
+			seed = seed * 1103515245 + 12345;
+			image[y * WIDTH + x] = 1000.0f + (float) (x * y) / 20 +
+			    (float) ((seed >> 16) & 255) / 64;
+			for (i = 0; i < 3; i++)
+				rgb[(y * WIDTH + x) * 3 + i] = (uint16)
+				    (x * 300 + y * 100 * i + ((seed >> 20) & 15));
+		}
+}
+
+static int
+is_nan_pixel(uint32 x, uint32 y)
+{
+	return (x + y) % 37 == 0;
+}
+
+/*
+ * Write the elevation model with the given maximum error, optionally
+ * with NaN pixels, read it back and return the file size, or 0 on
+ * failure.
+ */
+static long
+round_trip(double maxzerror, int scanlines, int nans)
+{
+	TIFF* tif;
+	float strip[WIDTH * ROWSPERSTRIP];
+	float* src = nans ? malloc(sizeof(image)) : image;
+	double d;
+	uint32 row, rows, x, y, n;
+	long size = 0;
+	FILE* fd;
+
+	if (!src)
+		return 0;
+	if (nans) {
+		memcpy(src, image, sizeof(image));
+		for (y = 0; y < LENGTH; y++)
+			for (x = 0; x < WIDTH; x++)
+				if (is_nan_pixel(x, y))
+					src[y * WIDTH + x] =
+					    (float) strtod("nan", NULL);
+	}
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		goto done;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 32);
+	TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LERC);
+	if (!TIFFSetField(tif, TIFFTAG_LERC_MAXZERROR, maxzerror) ||
+	    !TIFFGetField(tif, TIFFTAG_LERC_MAXZERROR, &d) ||
+	    d != maxzerror) {
+		fprintf (stderr, "Can't set LERC maximum error %g.\n",
+			 maxzerror);
+		goto failure;
+	}
+	for (row = 0; row < LENGTH; row += ROWSPERSTRIP) {
+		rows = LENGTH - row < ROWSPERSTRIP ?
+		    LENGTH - row : ROWSPERSTRIP;
+		if (scanlines) {
+			for (y = row; y < row + rows; y++)
+				if (TIFFWriteScanline(tif, src + y * WIDTH,
+				    y, 0) == -1)
+					goto failure;
+		} else if (TIFFWriteEncodedStrip(tif, row / ROWSPERSTRIP,
+		    src + row * WIDTH, rows * WIDTH * sizeof(float)) == -1)
+			goto failure;
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto done;
+	}
+	n = TIFFNumberOfStrips(tif);
+	for (row = 0; row < n + LENGTH; row++) {
+		/* All strips whole, then all rows one by one */
+		if (row < n) {
+			rows = LENGTH - row * ROWSPERSTRIP < ROWSPERSTRIP ?
+			    LENGTH - row * ROWSPERSTRIP : ROWSPERSTRIP;
+			y = row * ROWSPERSTRIP;
+			if (TIFFReadEncodedStrip(tif, row, strip, -1) !=
+			    (tmsize_t) (rows * WIDTH * sizeof(float))) {
+				fprintf (stderr, "Can't read strip %lu.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+		} else {
+			rows = 1;
+			y = row - n;
+			if (TIFFReadScanline(tif, strip, y, 0) == -1) {
+				fprintf (stderr, "Can't read row %lu.\n",
+					 (unsigned long) y);
+				goto failure;
+			}
+		}
+		for (x = 0; x < rows * WIDTH; x++) {
+			float v = src[y * WIDTH + x];
+			float r = strip[x];
+
+			if (v != v ? r == r :
+			    (r != r || r - v > maxzerror || v - r > maxzerror)) {
+				fprintf (stderr,
+					 "Pixel %lu,%lu reads %g instead of %g "
+					 "with maximum error %g.\n",
+					 (unsigned long) (x % WIDTH),
+					 (unsigned long) (y + x / WIDTH),
+					 r, v, maxzerror);
+				goto failure;
+			}
+		}
+	}
+	TIFFClose(tif);
+
+	fd = fopen(filename, "rb");
+	if (fd) {
+		fseek(fd, 0, SEEK_END);
+		size = ftell(fd);
+		fclose(fd);
+	}
+	goto done;
+
+failure:
+	TIFFClose(tif);
+done:
+	if (src != image)
+		free(src);
+	return size;
+}
+
+/*
+ * Write 16 bit RGB tiles, LERC compressed and then Deflate compressed,
+ * and check they read back unchanged along with the LercParameters tag.
+ */
+static int
+check_tiles(void)
+{
+	TIFF* tif;
+	uint16 buf[TILESIZE * TILESIZE * 3];
+	uint32 row, x, y;
+	uint32 count;
+	uint32* params;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LERC);
+	if (!TIFFSetField(tif, TIFFTAG_LERC_ADD_COMPRESSION,
+			  LERC_ADD_COMPRESSION_DEFLATE)) {
+		fprintf (stderr, "Can't set LERC additional compression.\n");
+		goto failure;
+	}
+	TIFFSetField(tif, TIFFTAG_ZIPQUALITY, 9);
+	for (y = 0; y < LENGTH; y += TILESIZE)
+		for (x = 0; x < WIDTH; x += TILESIZE) {
+			memset(buf, 0, sizeof(buf));
+			for (row = 0; row < TILESIZE && y + row < LENGTH; row++)
+				memcpy(buf + row * TILESIZE * 3,
+				       rgb + ((y + row) * WIDTH + x) * 3,
+				       (x + TILESIZE <= WIDTH ?
+					TILESIZE : WIDTH - x) *
+				       3 * sizeof(uint16));
+			if (TIFFWriteTile(tif, buf, x, y, 0, 0) == -1)
+				goto failure;
+		}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (!TIFFGetField(tif, TIFFTAG_LERC_PARAMETERS, &count, &params) ||
+	    count != 2 || params[0] != LERC_VERSION_2_4 ||
+	    params[1] != LERC_ADD_COMPRESSION_DEFLATE) {
+		fprintf (stderr, "Wrong LercParameters tag.\n");
+		goto failure;
+	}
+	for (y = 0; y < LENGTH; y += TILESIZE)
+		for (x = 0; x < WIDTH; x += TILESIZE) {
+			if (TIFFReadTile(tif, buf, x, y, 0, 0) == -1)
+				goto failure;
+			for (row = 0; row < TILESIZE && y + row < LENGTH; row++)
+				if (memcmp(buf + row * TILESIZE * 3,
+				    rgb + ((y + row) * WIDTH + x) * 3,
+				    (x + TILESIZE <= WIDTH ?
+				     TILESIZE : WIDTH - x) *
+				    3 * sizeof(uint16)) != 0) {
+					fprintf (stderr, "Tile differs.\n");
+					goto failure;
+				}
+		}
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+int
+main()
+{
+	TIFF* tif;
+	long lossless, lossy;
+
+	if (!TIFFIsCODECConfigured(COMPRESSION_LERC))
+		return 0;
+	fill_images();
+
+	lossless = round_trip(0.0, 0, 0);
+	if (!lossless || !round_trip(0.0, 1, 0))
+		return 1;
+	lossy = round_trip(0.5, 0, 0);
+	if (!lossy || !round_trip(0.5, 1, 0))
+		return 1;
+	if (lossy >= lossless) {
+		fprintf (stderr, "Lossy file (%ld bytes) is not smaller than "
+			 "lossless file (%ld bytes).\n", lossy, lossless);
+		return 1;
+	}
+	if (!round_trip(0.0, 0, 1) || !round_trip(0.1, 1, 1))
+		return 1;
+	if (TIFFIsCODECConfigured(COMPRESSION_ADOBE_DEFLATE) &&
+	    !check_tiles())
+		return 1;
+
+	/* Invalid values are rejected */
+	tif = TIFFOpen(filename, "w");
+	if (!tif)
+		return 1;
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LERC);
+	if (TIFFSetField(tif, TIFFTAG_LERC_MAXZERROR, -1.0) ||
+	    TIFFSetField(tif, TIFFTAG_LERC_ADD_COMPRESSION, 3)) {
+		fprintf (stderr, "Invalid LERC settings accepted.\n");
+		TIFFClose(tif);
+		return 1;
+	}
+	TIFFClose(tif);
+
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check the LZ4 codec: strips and tiles written whole or a scanline at
+ * a time, with the fast and LZ4HC encoders and with horizontal
+ * differencing, must read back unchanged, whole or a scanline at a
+ * time.  Does nothing if the library is built without LZ4 support.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "lz4.tif";
+
+#define	WIDTH		256
+#define	LENGTH		200	/* last strip is short */
+#define	ROWSPERSTRIP	32
+#define	TILESIZE	64
+
+static uint16 image[WIDTH * LENGTH];
+
+/* A smooth ramp with some noise, which differencing helps */
+static void
+fill_image(void)
+{
+	uint32 seed = 7;
+	uint32 x, y;
+
+	for (y = 0; y < LENGTH; y++)
+		for (x = 0; x < WIDTH; x++) {
+			seed = seed * 1103515245 + 12345;
+			image[y * WIDTH + x] = (uint16)
+			    (x * 64 + y * 16 + ((seed >> 16) & 3));
+		}
+}
+
+typedef struct {
+	int tiled;
+	int scanlines;
+	int level;
+	int predictor;
+} options_t;
+
+/*
+ * Write the image, read it back and return the file size, or 0 on
+ * failure.
+ */
+static long
+round_trip(const options_t* opt)
+{
+	TIFF* tif;
+	uint16 buf[TILESIZE * TILESIZE];
+	uint32 row, x, y, rows;
+	uint32 n;
+	int level;
+	long size = 0;
+	FILE* fd;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZ4);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, opt->predictor);
+	if (!TIFFSetField(tif, TIFFTAG_LZ4_LEVEL, opt->level) ||
+	    !TIFFGetField(tif, TIFFTAG_LZ4_LEVEL, &level) ||
+	    level != opt->level) {
+		fprintf (stderr, "Can't set LZ4 level %d.\n", opt->level);
+		goto failure;
+	}
+	if (opt->tiled) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+		for (y = 0; y < LENGTH; y += TILESIZE)
+			for (x = 0; x < WIDTH; x += TILESIZE) {
+				memset(buf, 0, sizeof(buf));
+				for (row = 0; row < TILESIZE &&
+				     y + row < LENGTH; row++)
+					memcpy(buf + row * TILESIZE,
+					       image + (y + row) * WIDTH + x,
+					       TILESIZE * sizeof(uint16));
+				if (TIFFWriteTile(tif, buf, x, y, 0, 0) == -1)
+					goto failure;
+			}
+	} else {
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+		for (row = 0; row < LENGTH; row += ROWSPERSTRIP) {
+			rows = LENGTH - row < ROWSPERSTRIP ?
+			    LENGTH - row : ROWSPERSTRIP;
+			if (opt->scanlines) {
+				/* differencing is done in place */
+				for (y = row; y < row + rows; y++) {
+					memcpy(buf, image + y * WIDTH,
+					       WIDTH * sizeof(uint16));
+					if (TIFFWriteScanline(tif, buf,
+					    y, 0) == -1)
+						goto failure;
+				}
+			} else if (TIFFWriteEncodedStrip(tif,
+			    row / ROWSPERSTRIP, image + row * WIDTH,
+			    rows * WIDTH * sizeof(uint16)) == -1)
+				goto failure;
+		}
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (opt->tiled) {
+		for (y = 0; y < LENGTH; y += TILESIZE)
+			for (x = 0; x < WIDTH; x += TILESIZE) {
+				if (TIFFReadTile(tif, buf, x, y, 0, 0) == -1)
+					goto failure;
+				for (row = 0; row < TILESIZE &&
+				     y + row < LENGTH; row++)
+					if (memcmp(buf + row * TILESIZE,
+					    image + (y + row) * WIDTH + x,
+					    TILESIZE * sizeof(uint16)) != 0) {
+						fprintf (stderr, "Tile differs.\n");
+						goto failure;
+					}
+			}
+	} else {
+		uint16 strip[WIDTH * ROWSPERSTRIP];
+
+		n = TIFFNumberOfStrips(tif);
+		for (row = 0; row < n; row++) {
+			rows = LENGTH - row * ROWSPERSTRIP < ROWSPERSTRIP ?
+			    LENGTH - row * ROWSPERSTRIP : ROWSPERSTRIP;
+			if (TIFFReadEncodedStrip(tif, row, strip, -1) !=
+			    (tmsize_t) (rows * WIDTH * sizeof(uint16)) ||
+			    memcmp(strip, image + row * ROWSPERSTRIP * WIDTH,
+				   rows * WIDTH * sizeof(uint16)) != 0) {
+				fprintf (stderr, "Strip %lu differs.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+		}
+		for (row = 0; row < LENGTH; row++)
+			if (TIFFReadScanline(tif, strip, row, 0) == -1 ||
+			    memcmp(strip, image + row * WIDTH,
+				   WIDTH * sizeof(uint16)) != 0) {
+				fprintf (stderr, "Row %lu differs.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+	}
+	TIFFClose(tif);
+
+	fd = fopen(filename, "rb");
+	if (fd) {
+		fseek(fd, 0, SEEK_END);
+		size = ftell(fd);
+		fclose(fd);
+	}
+	return size;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+int
+main()
+{
+	options_t opt;
+	long plain, differenced, hc;
+	TIFF* tif;
+
+	if (!TIFFIsCODECConfigured(COMPRESSION_LZ4))
+		return 0;
+	fill_image();
+
+	memset(&opt, 0, sizeof(opt));
+	opt.predictor = PREDICTOR_NONE;
+	plain = round_trip(&opt);
+	opt.scanlines = 1;
+	if (!plain || !round_trip(&opt))
+		return 1;
+	opt.level = -8;
+	if (!round_trip(&opt))
+		return 1;
+
+	opt.level = 0;
+	opt.predictor = PREDICTOR_HORIZONTAL;
+	if (!round_trip(&opt))
+		return 1;
+	opt.scanlines = 0;
+	differenced = round_trip(&opt);
+	opt.level = 9;
+	hc = round_trip(&opt);
+	if (!differenced || !hc)
+		return 1;
+	if (differenced >= plain || hc > differenced) {
+		fprintf (stderr, "Unexpected sizes: %ld, %ld, %ld bytes.\n",
+			 plain, differenced, hc);
+		return 1;
+	}
+
+	opt.tiled = 1;
+	if (!round_trip(&opt))
+		return 1;
+	opt.level = 0;
+	opt.predictor = PREDICTOR_NONE;
+	if (!round_trip(&opt))
+		return 1;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif)
+		return 1;
+	if (TIFFSetField(tif, TIFFTAG_LZ4_LEVEL, 13)) {
+		fprintf (stderr, "Invalid level accepted.\n");
+		TIFFClose(tif);
+		return 1;
+	}
+	TIFFClose(tif);
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that strips compressed by the multithreaded LZMA2 encoder
+ * (TIFFTAG_LZMA_THREADS) read back unchanged.  Does nothing if the
+ * library is built without LZMA2 support.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "lzma_threads.tif";
+
+/* Large enough for the strip to be split in several blocks */
+#define	WIDTH		1024
+#define	LENGTH		3072
+#define	ROWSPERSTRIP	2048
+#define	NTHREADS	3
+
+static void
+fill_image(unsigned char* buf, tmsize_t size)
+{
+	uint32 seed = 777;
+	tmsize_t i;
+
+	for (i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (unsigned char) ((i % WIDTH) / 2 + ((seed >> 16) & 7));
+	}
+}
+
+static int
+round_trip(const unsigned char* image, int threads)
+{
+	TIFF* tif;
+	unsigned char* buf;
+	tmsize_t size = (tmsize_t) WIDTH * ROWSPERSTRIP, got;
+	uint32 strip;
+	int value = -1;
+	int ret = 0;
+
+	buf = (unsigned char*) malloc(size);
+	if (!buf)
+		return 0;
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		free(buf);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZMA);
+	TIFFSetField(tif, TIFFTAG_LZMAPRESET, 1);
+	if (!TIFFSetField(tif, TIFFTAG_LZMA_THREADS, threads) ||
+	    !TIFFGetField(tif, TIFFTAG_LZMA_THREADS, &value) ||
+	    value != threads) {
+		fprintf (stderr, "Can't set LZMA_THREADS to %d.\n", threads);
+		goto failure;
+	}
+	if (TIFFSetField(tif, TIFFTAG_LZMA_THREADS, -1)) {
+		fprintf (stderr, "Negative LZMA_THREADS accepted.\n");
+		goto failure;
+	}
+	TIFFSetField(tif, TIFFTAG_LZMA_THREADS, threads);
+	for (strip = 0; strip < TIFFNumberOfStrips(tif); strip++) {
+		tmsize_t cc = size;
+
+		if ((strip + 1) * ROWSPERSTRIP > LENGTH)
+			cc = (tmsize_t) (LENGTH - strip * ROWSPERSTRIP) * WIDTH;
+		if (TIFFWriteEncodedStrip(tif, strip,
+		    (void*) (image + (tmsize_t) strip * size), cc) == -1) {
+			fprintf (stderr, "Can't write strip %lu.\n",
+				 (unsigned long) strip);
+			goto failure;
+		}
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		free(buf);
+		return 0;
+	}
+	for (strip = 0; strip < TIFFNumberOfStrips(tif); strip++) {
+		got = TIFFReadEncodedStrip(tif, strip, buf, -1);
+		if (got == -1 ||
+		    memcmp(buf, image + (tmsize_t) strip * size, got) != 0) {
+			fprintf (stderr, "%d threads: strip %lu differs.\n",
+				 threads, (unsigned long) strip);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	free(buf);
+	return ret;
+}
+
+int
+main()
+{
+	unsigned char* image;
+	int ret = 1;
+
+	if (!TIFFIsCODECConfigured(COMPRESSION_LZMA))
+		return 0;
+	image = (unsigned char*) malloc((size_t) WIDTH * LENGTH);
+	if (!image)
+		return 1;
+	fill_image(image, (tmsize_t) WIDTH * LENGTH);
+	if (round_trip(image, 0) && round_trip(image, NTHREADS)) {
+		unlink(filename);
+		ret = 0;
+	}
+	free(image);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
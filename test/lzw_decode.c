@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the LZW decoder on data with both short and long strings,
+ * decoding whole strips, prefixes of strips and single scanlines.
+ * When run as "lzw_decode -b [count]" also report decoding speed.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "lzw_decode.tif";
+
+#define	WIDTH		1000
+#define	LENGTH		600
+#define	ROWSPERSTRIP	200
+
+static void
+fill_image(unsigned char* buf, tmsize_t size)
+{
+	uint32 seed = 12345;
+	tmsize_t i;
+
+	for (i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		if ((i / 3000) % 8 == 0)	/* noise */
+			buf[i] = (unsigned char) (seed >> 16);
+		else if ((i / 3000) % 2 == 1)	/* runs */
+			buf[i] = (unsigned char) ((i / 500) * 37);
+		else				/* gradients with some noise */
+			buf[i] = (unsigned char) (i % WIDTH / 4 +
+			    ((seed >> 16) & 3));
+	}
+}
+
+static void
+copy_strip(TestChunk* c, void* arg)
+{
+	memcpy(c->buf, (const unsigned char*) arg + c->y * c->rowsize, c->size);
+}
+
+static int
+write_image(const unsigned char* image, uint16 spp)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 0, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+
+	im.samplesperpixel = spp;
+	if (spp == 3)
+		im.photometric = PHOTOMETRIC_RGB;
+	return write_test_image(filename, &im, copy_strip, (void*) image);
+}
+
+static int
+check_image(const unsigned char* image, uint16 spp)
+{
+	TIFF* tif;
+	tmsize_t scanline = (tmsize_t) WIDTH * spp;
+	tmsize_t stripsize = scanline * ROWSPERSTRIP;
+	unsigned char* buf;
+	uint32 s, row;
+	int ret = 0;
+
+	buf = (unsigned char*) malloc(stripsize);
+	tif = TIFFOpen(filename, "r");
+	if (!buf || !tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	for (s = 0; s < LENGTH / ROWSPERSTRIP; s++) {
+		if (TIFFReadEncodedStrip(tif, s, buf, stripsize) != stripsize ||
+		    memcmp(buf, image + s * stripsize, stripsize) != 0) {
+			fprintf (stderr, "Strip %lu differs.\n",
+				 (unsigned long) s);
+			goto failure;
+		}
+		/* A prefix ends in the middle of a string */
+		if (TIFFReadEncodedStrip(tif, s, buf, 4099) != 4099 ||
+		    memcmp(buf, image + s * stripsize, 4099) != 0) {
+			fprintf (stderr, "Prefix of strip %lu differs.\n",
+				 (unsigned long) s);
+			goto failure;
+		}
+	}
+	/* Scanlines restart strings across calls to the decoder */
+	for (row = 0; row < LENGTH; row++) {
+		if (TIFFReadScanline(tif, buf, row, 0) != 1 ||
+		    memcmp(buf, image + row * scanline, scanline) != 0) {
+			fprintf (stderr, "Scanline %lu differs.\n",
+				 (unsigned long) row);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	if (tif)
+		TIFFClose(tif);
+	free(buf);
+	return ret;
+}
+
+static void
+benchmark(int count)
+{
+	TIFF* tif = TIFFOpen(filename, "r");
+	tmsize_t stripsize = TIFFStripSize(tif);
+	unsigned char* buf = (unsigned char*) malloc(stripsize);
+	double total = 0;
+	clock_t start = clock();
+	double secs;
+	uint32 s;
+	int i;
+
+	for (i = 0; i < count; i++)
+		for (s = 0; s < TIFFNumberOfStrips(tif); s++)
+			total += (double) TIFFReadEncodedStrip(tif, s, buf,
+			    stripsize);
+	secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+	printf("Decoded %.0f MB in %.3f s: %.1f MB/s\n", total / 1e6, secs,
+	    secs > 0 ? total / 1e6 / secs : 0.0);
+	free(buf);
+	TIFFClose(tif);
+}
+
+int
+main(int argc, char* argv[])
+{
+	unsigned char* image;
+	uint16 spp;
+
+	image = (unsigned char*) malloc((tmsize_t) WIDTH * LENGTH * 3);
+	if (!image) {
+		fprintf (stderr, "Out of memory.\n");
+		return 1;
+	}
+	fill_image(image, (tmsize_t) WIDTH * LENGTH * 3);
+	for (spp = 1; spp <= 3; spp += 2) {
+		if (!write_image(image, spp) || !check_image(image, spp)) {
+			fprintf (stderr, "Failed for %d samples.\n", spp);
+			free(image);
+			return 1;
+		}
+	}
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+		benchmark(argc > 2 ? atoi(argv[2]) : 100);
+	free(image);
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
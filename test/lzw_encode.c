@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFTAG_LZWENCODEMODE selects the encoder hash table
+ * without changing the codes written, and that the result decodes.
+ * When run as "lzw_encode -b [count]" also report encoding speed of
+ * both modes.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "lzw_encode.tif";
+
+#define	WIDTH		1000
+#define	LENGTH		600
+#define	ROWSPERSTRIP	100
+#define	NSTRIPS		(LENGTH / ROWSPERSTRIP)
+#define	STRIPSIZE	((tmsize_t) WIDTH * ROWSPERSTRIP)
+
+static void
+fill_image(unsigned char* buf, tmsize_t size)
+{
+	uint32 seed = 4321;
+	tmsize_t i;
+
+	for (i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		if ((i / 5000) % 8 == 0)	/* noise, forces table resets */
+			buf[i] = (unsigned char) (seed >> 16);
+		else if ((i / 5000) % 2 == 1)	/* runs */
+			buf[i] = (unsigned char) ((i / 700) * 29);
+		else				/* gradients with some noise */
+			buf[i] = (unsigned char) (i % WIDTH / 4 +
+			    ((seed >> 16) & 3));
+	}
+}
+
+static void
+copy_strip(TestChunk* c, void* arg)
+{
+	memcpy(c->buf, (const unsigned char*) arg + c->y * c->rowsize, c->size);
+}
+
+/*
+ * Write the image with the given mode and return the raw strips,
+ * concatenated, in raw.  Returns the total size or -1.
+ */
+static tmsize_t
+write_image(const unsigned char* image, int mode, unsigned char* raw)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif;
+	tmsize_t total = 0;
+	uint32 s;
+	int got;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", filename);
+		return -1;
+	}
+	set_image_fields(tif, &im);
+	if (!TIFFSetField(tif, TIFFTAG_LZWENCODEMODE, mode) ||
+	    !TIFFGetField(tif, TIFFTAG_LZWENCODEMODE, &got) || got != mode) {
+		fprintf (stderr, "Can't set LZW encoding mode %d.\n", mode);
+		TIFFClose(tif);
+		return -1;
+	}
+	if (!write_image_data(tif, copy_strip, (void*) image)) {
+		TIFFClose(tif);
+		return -1;
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return -1;
+	}
+	for (s = 0; s < NSTRIPS; s++) {
+		tmsize_t n = TIFFReadRawStrip(tif, s, raw + total, 2 * STRIPSIZE);
+
+		if (n <= 0) {
+			fprintf (stderr, "Can't read raw strip %lu.\n",
+				 (unsigned long) s);
+			TIFFClose(tif);
+			return -1;
+		}
+		total += n;
+	}
+	TIFFClose(tif);
+	return total;
+}
+
+static int
+check_decode(const unsigned char* image)
+{
+	TIFF* tif = TIFFOpen(filename, "r");
+	unsigned char* buf = (unsigned char*) malloc(STRIPSIZE);
+	uint32 s;
+	int ret = 0;
+
+	if (!tif || !buf) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	for (s = 0; s < NSTRIPS; s++) {
+		if (TIFFReadEncodedStrip(tif, s, buf, STRIPSIZE) != STRIPSIZE ||
+		    memcmp(buf, image + s * STRIPSIZE, STRIPSIZE) != 0) {
+			fprintf (stderr, "Strip %lu differs.\n",
+				 (unsigned long) s);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	if (tif)
+		TIFFClose(tif);
+	free(buf);
+	return ret;
+}
+
+static void
+benchmark(const unsigned char* image, unsigned char* raw, int count)
+{
+	int mode, i;
+
+	for (mode = LZWENCODEMODE_COMPAT; mode <= LZWENCODEMODE_FAST; mode++) {
+		clock_t start = clock();
+		double secs;
+
+		for (i = 0; i < count; i++)
+			write_image(image, mode, raw);
+		secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+		printf("Mode %d: %.3f s, %.1f MB/s\n", mode, secs,
+		    secs > 0 ? (double) count * NSTRIPS * STRIPSIZE / 1e6 / secs :
+		    0.0);
+	}
+}
+
+int
+main(int argc, char* argv[])
+{
+	unsigned char *image, *raw1, *raw2;
+	tmsize_t n1, n2;
+	TIFF* tif;
+	int ret = 1;
+
+	image = (unsigned char*) malloc(NSTRIPS * STRIPSIZE);
+	raw1 = (unsigned char*) malloc(2 * NSTRIPS * STRIPSIZE);
+	raw2 = (unsigned char*) malloc(2 * NSTRIPS * STRIPSIZE);
+	if (!image || !raw1 || !raw2) {
+		fprintf (stderr, "Out of memory.\n");
+		goto failure;
+	}
+	fill_image(image, NSTRIPS * STRIPSIZE);
+
+	n1 = write_image(image, LZWENCODEMODE_COMPAT, raw1);
+	if (n1 < 0 || !check_decode(image))
+		goto failure;
+	n2 = write_image(image, LZWENCODEMODE_FAST, raw2);
+	if (n2 < 0 || !check_decode(image))
+		goto failure;
+	if (n1 != n2 || memcmp(raw1, raw2, n1) != 0) {
+		fprintf (stderr, "Encoding modes give different codes.\n");
+		goto failure;
+	}
+
+	/* Unknown modes are refused */
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", filename);
+		goto failure;
+	}
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	if (TIFFSetField(tif, TIFFTAG_LZWENCODEMODE, 2)) {
+		fprintf (stderr, "Unknown encoding mode was accepted.\n");
+		TIFFClose(tif);
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+		benchmark(image, raw1, argc > 2 ? atoi(argv[2]) : 20);
+	unlink(filename);
+	ret = 0;
+
+failure:
+	free(image);
+	free(raw1);
+	free(raw2);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
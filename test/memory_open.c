@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check writing, appending to and reading files in memory with
+ * TIFFOpenMemory() and TIFFCloseMemory().
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiffio.h"
+
+#define	WIDTH		100
+#define	LENGTH		60
+#define	ROWSPERSTRIP	8
+
+static void
+fill_strip(unsigned char* buf, tmsize_t size, uint32 strip, int dir)
+{
+	tmsize_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)((i / 3 + strip * 31 + dir * 7) & 0xff);
+}
+
+static int
+write_directory(TIFF* tif, int dir)
+{
+	unsigned char buf[WIDTH * ROWSPERSTRIP];
+	tmsize_t size;
+	uint32 s, n;
+
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	n = TIFFNumberOfStrips(tif);
+	for (s = 0; s < n; s++) {
+		size = TIFFVStripSize(tif, s == n - 1 ?
+		    LENGTH - s * ROWSPERSTRIP : ROWSPERSTRIP);
+		fill_strip(buf, size, s, dir);
+		if (TIFFWriteEncodedStrip(tif, s, buf, size) != size) {
+			fprintf (stderr, "Can't write strip %lu.\n",
+				 (unsigned long) s);
+			return 0;
+		}
+	}
+	return TIFFWriteDirectory(tif);
+}
+
+static int
+check_directory(TIFF* tif, int dir, const unsigned char* file,
+		tmsize_t filesize)
+{
+	unsigned char buf[WIDTH * ROWSPERSTRIP], ref[WIDTH * ROWSPERSTRIP];
+	uint32 s, n = TIFFNumberOfStrips(tif);
+
+	for (s = 0; s < n; s++) {
+		tmsize_t size = TIFFReadEncodedStrip(tif, s, buf, sizeof (buf));
+		const void* raw;
+		tmsize_t rawsize;
+
+		fill_strip(ref, size, s, dir);
+		if (size <= 0 || memcmp(buf, ref, size) != 0) {
+			fprintf (stderr, "Directory %d, strip %lu differs.\n",
+				 dir, (unsigned long) s);
+			return 0;
+		}
+		/* the raw data must come straight from the caller's buffer */
+		if (file != NULL &&
+		    (!TIFFGetMappedRawStrip(tif, s, &raw, &rawsize) ||
+		     (const unsigned char*) raw < file ||
+		     (const unsigned char*) raw + rawsize > file + filesize)) {
+			fprintf (stderr, "Strip %lu is not read in place.\n",
+				 (unsigned long) s);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int
+main()
+{
+	TIFF* tif;
+	void* buf = NULL;
+	void* buf2 = NULL;
+	tmsize_t size = 0, size2 = 0;
+	uint32 strips[LENGTH / ROWSPERSTRIP + 1];
+	void* bufs[LENGTH / ROWSPERSTRIP + 1];
+	uint32 s, n;
+
+	/* write a new file */
+	tif = TIFFOpenMemory(NULL, 0, "w");
+	if (!tif || !write_directory(tif, 0))
+		return 1;
+	if (!TIFFCloseMemory(tif, &buf, &size) || buf == NULL || size <= 0) {
+		fprintf (stderr, "No file contents returned.\n");
+		return 1;
+	}
+
+	/* append a directory to a copy */
+	tif = TIFFOpenMemory(buf, size, "a");
+	if (!tif || !write_directory(tif, 1))
+		return 1;
+	if (!TIFFCloseMemory(tif, &buf2, &size2) || size2 <= size) {
+		fprintf (stderr, "Append did not grow the file.\n");
+		return 1;
+	}
+
+	/* the original must be untouched and readable in place */
+	tif = TIFFOpenMemory(buf, size, "r");
+	if (!tif || !check_directory(tif, 0, (unsigned char*) buf, size) ||
+	    TIFFReadDirectory(tif)) {
+		fprintf (stderr, "Can't read the written file.\n");
+		return 1;
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpenMemory(buf2, size2, "r");
+	if (!tif || !check_directory(tif, 0, (unsigned char*) buf2, size2) ||
+	    !TIFFReadDirectory(tif) ||
+	    !check_directory(tif, 1, (unsigned char*) buf2, size2)) {
+		fprintf (stderr, "Can't read the appended file.\n");
+		return 1;
+	}
+	TIFFClose(tif);
+
+	/* parallel decoding, with the raw data read rather than mapped */
+	tif = TIFFOpenMemory(buf2, size2, "rm");
+	if (!tif)
+		return 1;
+	n = TIFFNumberOfStrips(tif);
+	for (s = 0; s < n; s++) {
+		strips[s] = n - 1 - s;
+		bufs[s] = malloc(WIDTH * ROWSPERSTRIP);
+		if (!bufs[s])
+			return 1;
+	}
+	if (!TIFFReadEncodedStripsParallel(tif, strips, n, bufs,
+					   WIDTH * ROWSPERSTRIP, 4)) {
+		fprintf (stderr, "Parallel decoding failed.\n");
+		return 1;
+	}
+	for (s = 0; s < n; s++) {
+		unsigned char ref[WIDTH * ROWSPERSTRIP];
+
+		fill_strip(ref, TIFFVStripSize(tif, strips[s] == n - 1 ?
+		    LENGTH - strips[s] * ROWSPERSTRIP : ROWSPERSTRIP),
+		    strips[s], 0);
+		if (memcmp(bufs[s], ref, TIFFVStripSize(tif,
+		    strips[s] == n - 1 ? LENGTH - strips[s] * ROWSPERSTRIP :
+		    ROWSPERSTRIP)) != 0) {
+			fprintf (stderr, "Parallel strip %lu differs.\n",
+				 (unsigned long) strips[s]);
+			return 1;
+		}
+		free(bufs[s]);
+	}
+	/* a read-only handle hands back the caller's buffer */
+	buf2 = NULL;
+	if (!TIFFCloseMemory(tif, &buf2, &size2) || buf2 == NULL) {
+		fprintf (stderr, "Read-only close lost the buffer.\n");
+		return 1;
+	}
+
+	if (TIFFOpenMemory(NULL, 0, "r") != NULL) {
+		fprintf (stderr, "Empty buffer was accepted.\n");
+		return 1;
+	}
+	_TIFFfree(buf);
+	_TIFFfree(buf2);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
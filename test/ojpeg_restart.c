@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that old-style JPEG strips read in any order match the strips
+ * read in sequence.  The old-style file is made from the strips of a
+ * new-style JPEG file: the first strip keeps the JPEG header, the
+ * others only their entropy coded data, so every strip is a restart
+ * interval of its own.  Does nothing if the library is built without
+ * JPEG or old-style JPEG support.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char jpegfile[] = "ojpeg_restart_jpeg.tif";
+static const char filename[] = "ojpeg_restart.tif";
+
+#define	WIDTH		80	/* not a whole number of MCUs */
+#define	LENGTH		88	/* the last strip is partial */
+#define	ROWSPERSTRIP	16
+#define	NSTRIPS		((LENGTH + ROWSPERSTRIP - 1) / ROWSPERSTRIP)
+
+static int
+fail(const char* msg)
+{
+	fprintf (stderr, "%s\n", msg);
+	return 0;
+}
+
+/* Offset of the data following the SOS segment, 0 if there is none */
+static tmsize_t
+find_scan(const unsigned char* p, tmsize_t size, tmsize_t* sof)
+{
+	tmsize_t i = 2;
+
+	while (i + 4 <= size && p[i] == 0xFF) {
+		tmsize_t len = (p[i + 2] << 8) | p[i + 3];
+
+		if (p[i + 1] == 0xC0)
+			*sof = i;
+		if (p[i + 1] == 0xDA)
+			return i + 2 + len;
+		i += 2 + len;
+	}
+	return 0;
+}
+
+/*
+ * Write a new-style JPEG file and turn its strips into an old-style one,
+ * written uncompressed then relabelled.
+ */
+static int
+make_ojpeg(int nsamples)
+{
+	static unsigned char raw[NSTRIPS][65536];
+	tmsize_t size[NSTRIPS];
+	unsigned char row[WIDTH * 3];
+	TIFF* tif;
+	uint32 x, y, s;
+	uint16 photometric = nsamples == 3 ? PHOTOMETRIC_YCBCR :
+	    PHOTOMETRIC_MINISBLACK;
+	unsigned char ifd[12];
+	uint32 diroff;
+	uint16 n, i;
+	FILE* fd;
+
+	tif = TIFFOpen(jpegfile, "wl");
+	if (!tif)
+		return fail("Can't create test TIFF file.");
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, nsamples);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, photometric);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_JPEG);
+	TIFFSetField(tif, TIFFTAG_JPEGTABLESMODE, 0);
+	if (nsamples == 3)
+		TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+	for (y = 0; y < LENGTH; y++) {
+		for (x = 0; x < WIDTH * (uint32) nsamples; x++)
+			row[x] = (unsigned char) ((x * 7 + y * 3 + (x ^ y)) & 255);
+		if (TIFFWriteScanline(tif, row, y, 0) == -1) {
+			TIFFClose(tif);
+			return fail("Can't write JPEG scanline.");
+		}
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(jpegfile, "r");
+	if (!tif)
+		return fail("Can't open JPEG file.");
+	for (s = 0; s < NSTRIPS; s++) {
+		tmsize_t sof = 0, scan;
+
+		size[s] = TIFFReadRawStrip(tif, s, raw[s], sizeof(raw[s]));
+		scan = size[s] > 0 ? find_scan(raw[s], size[s], &sof) : 0;
+		if (scan == 0 || sof == 0 || raw[s][size[s] - 1] != 0xD9) {
+			TIFFClose(tif);
+			return fail("Unexpected JPEG strip layout.");
+		}
+		size[s] -= 2;		/* no EOI */
+		if (s == 0) {
+			/* the frame covers the whole image */
+			raw[0][sof + 5] = (unsigned char) (LENGTH >> 8);
+			raw[0][sof + 6] = (unsigned char) (LENGTH & 255);
+		} else {
+			size[s] -= scan;
+			memmove(raw[s], raw[s] + scan, size[s]);
+		}
+	}
+	TIFFClose(tif);
+	unlink(jpegfile);
+
+	tif = TIFFOpen(filename, "wl");
+	if (!tif)
+		return fail("Can't create test TIFF file.");
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, nsamples);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, photometric);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	for (s = 0; s < NSTRIPS; s++)
+		if (TIFFWriteRawStrip(tif, s, raw[s], size[s]) == -1) {
+			TIFFClose(tif);
+			return fail("Can't write raw strip.");
+		}
+	TIFFClose(tif);
+
+	/* Relabel the Compression tag of the little-endian classic file */
+	fd = fopen(filename, "r+b");
+	if (!fd)
+		return fail("Can't reopen test file.");
+	if (fseek(fd, 4, SEEK_SET) != 0 || fread(ifd, 1, 4, fd) != 4)
+		goto failure;
+	diroff = ifd[0] | (ifd[1] << 8) | ((uint32) ifd[2] << 16) |
+	    ((uint32) ifd[3] << 24);
+	if (fseek(fd, diroff, SEEK_SET) != 0 || fread(ifd, 1, 2, fd) != 2)
+		goto failure;
+	n = (uint16) (ifd[0] | (ifd[1] << 8));
+	for (i = 0; i < n; i++) {
+		if (fread(ifd, 1, 12, fd) != 12)
+			goto failure;
+		if ((ifd[0] | (ifd[1] << 8)) == TIFFTAG_COMPRESSION) {
+			ifd[8] = COMPRESSION_OJPEG;
+			if (fseek(fd, -4, SEEK_CUR) != 0 ||
+			    fwrite(ifd + 8, 1, 2, fd) != 2)
+				goto failure;
+			fclose(fd);
+			return 1;
+		}
+	}
+failure:
+	fclose(fd);
+	return fail("Can't relabel the test file.");
+}
+
+static int
+check_order(int nsamples)
+{
+	static const uint32 order[] = { 4, 1, 5, 5, 0, 3, 2, 1 };
+	static unsigned char ref[NSTRIPS][ROWSPERSTRIP * WIDTH * 3];
+	static unsigned char buf[ROWSPERSTRIP * WIDTH * 3];
+	tmsize_t size[NSTRIPS];
+	TIFF* tif;
+	uint32 s, i;
+
+	if (!make_ojpeg(nsamples))
+		return 0;
+	tif = TIFFOpen(filename, "r");
+	if (!tif)
+		return fail("Can't open old-style JPEG file.");
+	for (s = 0; s < NSTRIPS; s++) {
+		size[s] = TIFFReadEncodedStrip(tif, s, ref[s], sizeof(ref[s]));
+		if (size[s] <= 0) {
+			TIFFClose(tif);
+			return fail("Can't read old-style JPEG strips in order.");
+		}
+	}
+	for (i = NSTRIPS; i > 0; i--) {
+		s = i - 1;
+		if (TIFFReadEncodedStrip(tif, s, buf, sizeof(buf)) != size[s] ||
+		    memcmp(buf, ref[s], size[s]) != 0) {
+			TIFFClose(tif);
+			fprintf (stderr, "Strip %u differs read backwards.\n", s);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+
+	/* A fresh handle whose first read is not of the first strip */
+	tif = TIFFOpen(filename, "r");
+	if (!tif)
+		return fail("Can't open old-style JPEG file.");
+	for (i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+		s = order[i];
+		if (TIFFReadEncodedStrip(tif, s, buf, sizeof(buf)) != size[s] ||
+		    memcmp(buf, ref[s], size[s]) != 0) {
+			TIFFClose(tif);
+			fprintf (stderr, "Strip %u differs read out of order.\n", s);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+int
+main()
+{
+	if (!TIFFIsCODECConfigured(COMPRESSION_JPEG) ||
+	    !TIFFIsCODECConfigured(COMPRESSION_OJPEG))
+		return 0;
+	/* suppress the deprecation warning of every handle */
+	TIFFSetWarningHandler(NULL);
+
+	if (!check_order(1) || !check_order(3))
+		return 1;
+
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
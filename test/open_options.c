@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that handles opened with TIFFOpenOptionsSetAllocator() allocate
+ * and release all their memory through the supplied callbacks, that
+ * TIFFOpenOptionsSetMaxCumulatedMemAlloc() limits it, and that files
+ * opened with an access pattern hint read the same.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "open_options.tif";
+static const char bigfile[] = "open_options_big.tif";
+
+#define	WIDTH		64
+#define	LENGTH		48
+#define	ROWSPERSTRIP	8
+#define	MAGIC		0x74696666
+#define	BIGSIZE		512
+#define	MEMLIMIT	(256 * 1024)
+
+typedef struct {
+	long	nallocs;	/* total number of allocations */
+	long	live;		/* blocks currently allocated */
+	int	bad;		/* a foreign pointer was passed in */
+} Arena;
+
+/* Each block is preceded by a header so that foreign pointers are caught */
+typedef union {
+	struct {
+		unsigned long	magic;
+		Arena*		arena;
+	} h;
+	double	align;
+} BlockHeader;
+
+static void*
+arena_malloc(void* ctx, tmsize_t size)
+{
+	Arena* a = (Arena*) ctx;
+	BlockHeader* b = (BlockHeader*) malloc(sizeof(BlockHeader) + size);
+
+	if (!b)
+		return NULL;
+	b->h.magic = MAGIC;
+	b->h.arena = a;
+	a->nallocs++;
+	a->live++;
+	return b + 1;
+}
+
+static int
+check_block(Arena* a, void* p)
+{
+	BlockHeader* b = (BlockHeader*) p - 1;
+
+	if (b->h.magic != MAGIC || b->h.arena != a) {
+		a->bad = 1;
+		return 0;
+	}
+	return 1;
+}
+
+static void*
+arena_realloc(void* ctx, void* p, tmsize_t size)
+{
+	Arena* a = (Arena*) ctx;
+	BlockHeader* b;
+
+	if (p == NULL)
+		return arena_malloc(ctx, size);
+	if (!check_block(a, p))
+		return NULL;
+	b = (BlockHeader*) realloc((BlockHeader*) p - 1,
+				   sizeof(BlockHeader) + size);
+	return b ? b + 1 : NULL;
+}
+
+static void
+arena_free(void* ctx, void* p)
+{
+	Arena* a = (Arena*) ctx;
+
+	if (p == NULL) {
+		a->bad = 1;
+		return;
+	}
+	if (!check_block(a, p))
+		return;
+	((BlockHeader*) p - 1)->h.magic = 0;
+	a->live--;
+	free((BlockHeader*) p - 1);
+}
+
+static unsigned char
+pixel(uint32 x, uint32 y, uint32 s)
+{
+	return (unsigned char)((x * 7 + y * 3 + s * 50) & 0xff);
+}
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	uint32 x, y, s;
+
+	(void) arg;
+	for (y = 0; y < c->length; y++)
+		for (x = 0; x < c->width; x++)
+			for (s = 0; s < 3; s++)
+				c->buf[(y * c->width + x) * 3 + s] =
+				    pixel(x, c->y + y, s);
+}
+
+static int
+write_image(TIFFOpenOptions* opts, uint16 compression)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 3, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_RGB, 0, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpenExt(filename, "w", opts);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.compression = compression;
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, "allocator test");
+	ok = write_image_data(tif, fill_strip, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+read_image(TIFFOpenOptions* opts)
+{
+	uint32 raster[WIDTH * LENGTH];
+	unsigned char buf[WIDTH * 3];
+	TIFF* tif;
+	uint32 x, y;
+
+	tif = TIFFOpenExt(filename, "r", opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	for (y = 0; y < LENGTH; y++) {
+		if (TIFFReadScanline(tif, buf, y, 0) == -1) {
+			fprintf (stderr, "Can't read scanline %lu.\n",
+				 (unsigned long) y);
+			TIFFClose(tif);
+			return 0;
+		}
+		for (x = 0; x < WIDTH; x++)
+			if (buf[x * 3 + 1] != pixel(x, y, 1)) {
+				fprintf (stderr, "Wrong pixel at %lu,%lu.\n",
+					 (unsigned long) x, (unsigned long) y);
+				TIFFClose(tif);
+				return 0;
+			}
+	}
+	if (!TIFFReadRGBAImage(tif, WIDTH, LENGTH, raster, 0) ||
+	    TIFFGetG(raster[0]) != pixel(0, LENGTH - 1, 1)) {
+		fprintf (stderr, "TIFFReadRGBAImage() failed.\n");
+		TIFFClose(tif);
+		return 0;
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+/*
+ * Write a single uncompressed strip larger than MEMLIMIT.
+ */
+static int
+write_big_image(void)
+{
+	unsigned char* buf;
+	TIFF* tif;
+	tmsize_t size = BIGSIZE * BIGSIZE * 3;
+
+	tif = TIFFOpen(bigfile, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", bigfile);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, BIGSIZE);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, BIGSIZE);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, BIGSIZE);
+	buf = (unsigned char*) calloc(1, size);
+	if (!buf || TIFFWriteEncodedStrip(tif, 0, buf, size) != size) {
+		fprintf (stderr, "Can't write %s.\n", bigfile);
+		free(buf);
+		TIFFClose(tif);
+		return 0;
+	}
+	free(buf);
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+check_memory_limit(void)
+{
+	TIFFOpenOptions* opts;
+	unsigned char* buf = NULL;
+	void* bufs[LENGTH / ROWSPERSTRIP];
+	uint32 strips[LENGTH / ROWSPERSTRIP];
+	tmsize_t current, peak, size;
+	TIFF* tif = NULL;
+	uint32 i, n = LENGTH / ROWSPERSTRIP;
+	int ret = 0;
+
+	opts = TIFFOpenOptionsAlloc();
+	if (!opts)
+		return 0;
+	TIFFOpenOptionsSetMaxCumulatedMemAlloc(opts, MEMLIMIT);
+	memset(bufs, 0, sizeof(bufs));
+
+	/* Small strips decoded by worker handles stay within the limit */
+	tif = TIFFOpenExt(filename, "r", opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	size = TIFFStripSize(tif);
+	for (i = 0; i < n; i++) {
+		strips[i] = i;
+		bufs[i] = malloc(size);
+		if (!bufs[i])
+			goto failure;
+	}
+	if (!TIFFReadEncodedStripsParallel(tif, strips, n, bufs, size, 4)) {
+		fprintf (stderr, "Parallel decoding within the limit failed.\n");
+		goto failure;
+	}
+	TIFFGetMemoryUsage(tif, &current, &peak);
+	if (current <= 0 || peak < current || peak > MEMLIMIT) {
+		fprintf (stderr, "Unexpected memory usage %ld, peak %ld.\n",
+			 (long) current, (long) peak);
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	/* A strip larger than the limit cannot be buffered, unless chopped */
+	tif = TIFFOpenExt(bigfile, "rmc", opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", bigfile);
+		goto failure;
+	}
+	size = TIFFStripSize(tif);
+	buf = (unsigned char*) malloc(size);
+	if (!buf)
+		goto failure;
+	if (TIFFReadRawStrip(tif, 0, buf, size) != size) {
+		fprintf (stderr, "Reading into a caller buffer failed.\n");
+		goto failure;
+	}
+	if (TIFFReadScanline(tif, buf, 0, 0) != -1) {
+		fprintf (stderr, "Memory limit was not enforced.\n");
+		goto failure;
+	}
+	TIFFGetMemoryUsage(tif, &current, &peak);
+	if (peak > MEMLIMIT) {
+		fprintf (stderr, "Peak usage %ld beyond the limit.\n",
+			 (long) peak);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	for (i = 0; i < n; i++)
+		free(bufs[i]);
+	free(buf);
+	if (tif)
+		TIFFClose(tif);
+	TIFFOpenOptionsFree(opts);
+	return ret;
+}
+
+int
+main()
+{
+	uint16 compressions[] = { COMPRESSION_LZW, COMPRESSION_ADOBE_DEFLATE };
+	TIFFOpenOptions* opts;
+	Arena arena;
+	int c;
+
+	memset(&arena, 0, sizeof(arena));
+	opts = TIFFOpenOptionsAlloc();
+	if (!opts) {
+		fprintf (stderr, "TIFFOpenOptionsAlloc() failed.\n");
+		return 1;
+	}
+	TIFFOpenOptionsSetAllocator(opts, arena_malloc, arena_realloc,
+				    arena_free, &arena);
+	for (c = 0; c < 2; c++) {
+		if (!TIFFIsCODECConfigured(compressions[c]))
+			continue;
+		if (!write_image(opts, compressions[c]) || !read_image(opts))
+			goto failure;
+	}
+	TIFFOpenOptionsSetAccessPattern(opts, TIFF_ACCESS_SEQUENTIAL);
+	if (!read_image(opts))
+		goto failure;
+	TIFFOpenOptionsSetAccessPattern(opts, TIFF_ACCESS_RANDOM);
+	if (!read_image(opts))
+		goto failure;
+	TIFFOpenOptionsFree(opts);
+	opts = NULL;
+	if (!write_big_image() || !check_memory_limit())
+		goto failure;
+
+	if (arena.nallocs == 0) {
+		fprintf (stderr, "Allocator was never called.\n");
+		goto failure;
+	}
+	if (arena.bad) {
+		fprintf (stderr, "Foreign pointer passed to the allocator.\n");
+		goto failure;
+	}
+	if (arena.live != 0) {
+		fprintf (stderr, "%ld blocks leaked.\n", arena.live);
+		goto failure;
+	}
+	unlink(filename);
+	unlink(bigfile);
+	return 0;
+
+failure:
+	if (opts)
+		TIFFOpenOptionsFree(opts);
+	return 1;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
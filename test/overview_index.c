@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check TIFFGetOverviewCount(), TIFFGetOverviewInfo(),
+ * TIFFGetOverviewForScale() and TIFFOpenOverview() on overviews stored
+ * as SubIFDs and as reduced-resolution images following their image.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "overview_index.tif";
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	(void) arg;
+	/* Tell the images apart by their first sample */
+	memset(c->buf, (int) (c->width & 0xff), c->size);
+}
+
+static int
+write_image(TIFF* tif, uint32 width, uint32 length, uint32 subfiletype)
+{
+	TestImage im = { 0, 0, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, 0, 0, 0 };
+
+	im.width = width;
+	im.length = im.rowsperstrip = length;
+	TIFFSetField(tif, TIFFTAG_SUBFILETYPE, subfiletype);
+	set_image_fields(tif, &im);
+	return write_image_data(tif, fill_strip, NULL) && TIFFWriteDirectory(tif);
+}
+
+static int
+write_file(void)
+{
+	TIFF* tif;
+	uint64 subifd[3] = { 0, 0, 0 };
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	/* Directory 0, with smallest first SubIFD overviews and a mask */
+	TIFFSetField(tif, TIFFTAG_SUBIFD, 3, subifd);
+	ok = write_image(tif, 400, 300, 0) &&
+	    write_image(tif, 100, 75, FILETYPE_REDUCEDIMAGE) &&
+	    write_image(tif, 200, 150, FILETYPE_REDUCEDIMAGE|FILETYPE_MASK) &&
+	    write_image(tif, 200, 150, FILETYPE_REDUCEDIMAGE) &&
+	    /* Directory 1, then its overviews, a mask among them */
+	    write_image(tif, 256, 256, 0) &&
+	    write_image(tif, 128, 128, FILETYPE_REDUCEDIMAGE) &&
+	    write_image(tif, 256, 256, FILETYPE_MASK) &&
+	    write_image(tif, 64, 64, FILETYPE_REDUCEDIMAGE) &&
+	    /* Directory 5, without overviews */
+	    write_image(tif, 10, 10, 0);
+	TIFFClose(tif);
+	if (!ok)
+		fprintf (stderr, "Can't write %s.\n", filename);
+	return ok;
+}
+
+static int
+check_level(TIFF* tif, int level, uint32 width, uint32 length,
+	    tdir_t dirn)
+{
+	uint32 w = 0, l = 0;
+	uint64 diroff = 0;
+	unsigned char value = 0;
+
+	if (!TIFFGetOverviewInfo(tif, level, &w, &l, &diroff) ||
+	    w != width || l != length) {
+		fprintf (stderr, "Level %d is not %lux%lu.\n", level,
+			 (unsigned long) width, (unsigned long) length);
+		return 0;
+	}
+	if (!TIFFOpenOverview(tif, level) ||
+	    TIFFCurrentDirOffset(tif) != diroff ||
+	    TIFFCurrentDirectory(tif) != dirn) {
+		fprintf (stderr, "Can't switch to level %d.\n", level);
+		return 0;
+	}
+	TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &w);
+	if (w != width || TIFFReadEncodedStrip(tif, 0, &value, 1) != 1 ||
+	    value != (width & 0xff)) {
+		fprintf (stderr, "Level %d has the wrong image.\n", level);
+		return 0;
+	}
+	return 1;
+}
+
+static int
+check_scale(TIFF* tif, double scale, int level)
+{
+	int got = TIFFGetOverviewForScale(tif, scale);
+
+	if (got != level) {
+		fprintf (stderr, "Scale %g gave level %d, not %d.\n",
+			 scale, got, level);
+		return 0;
+	}
+	return 1;
+}
+
+int
+main()
+{
+	TIFF* tif;
+	int ret = 1;
+
+	if (!write_file())
+		return 1;
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 1;
+	}
+
+	if (TIFFGetOverviewCount(tif) != 2 ||
+	    TIFFCurrentDirectory(tif) != 0) {
+		fprintf (stderr, "Directory 0 should have 2 overviews.\n");
+		goto failure;
+	}
+	if (!check_scale(tif, 1.0, 0) || !check_scale(tif, 0.6, 0) ||
+	    !check_scale(tif, 0.5, 1) || !check_scale(tif, 0.3, 1) ||
+	    !check_scale(tif, 0.25, 2) || !check_scale(tif, 0.01, 2) ||
+	    TIFFGetOverviewForScale(tif, 0.0) != -1)
+		goto failure;
+	/* The index is kept while one of its levels is current */
+	if (!check_level(tif, 2, 100, 75, 0) ||
+	    TIFFGetOverviewCount(tif) != 2 ||
+	    !check_level(tif, 1, 200, 150, 0) ||
+	    !check_level(tif, 0, 400, 300, 0) ||
+	    TIFFGetOverviewInfo(tif, 3, NULL, NULL, NULL))
+		goto failure;
+
+	if (!TIFFSetDirectory(tif, 1) || TIFFGetOverviewCount(tif) != 2 ||
+	    TIFFCurrentDirectory(tif) != 1) {
+		fprintf (stderr, "Directory 1 should have 2 overviews.\n");
+		goto failure;
+	}
+	if (!check_scale(tif, 0.5, 1) || !check_scale(tif, 0.2, 2) ||
+	    !check_level(tif, 1, 128, 128, 2) ||
+	    !check_level(tif, 2, 64, 64, 4))
+		goto failure;
+	/* Reading on from the last overview reaches the next image */
+	if (!TIFFReadDirectory(tif) || TIFFCurrentDirectory(tif) != 5 ||
+	    TIFFGetOverviewCount(tif) != 0 || !check_level(tif, 0, 10, 10, 5))
+		goto failure;
+	ret = 0;
+
+failure:
+	TIFFClose(tif);
+	if (ret == 0)
+		unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
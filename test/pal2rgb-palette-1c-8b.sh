@@ -0,0 +1,7 @@
+#!/bin/sh
+# Generated file, master is Makefile.am
+. ${srcdir:-.}/common.sh
+infile="$srcdir/images/palette-1c-8b.tiff"
+outfile="o-pal2rgb-palette-1c-8b.tiff"
+f_test_convert "$PAL2RGB" $infile $outfile
+f_tiffinfo_validate $outfile
@@ -0,0 +1,25 @@
+#!/bin/sh
+#
+# Check that pal2rgb converts the same on one or more threads, and
+# that the planes of separate output hold the same samples
+#
+. ${srcdir:-.}/common.sh
+for img in ${IMG_PALETTE_1C_1B} ${IMG_PALETTE_1C_4B} ${IMG_PALETTE_1C_8B}
+do
+  f_test_convert "${PAL2RGB} -j 1 -r 3 -c lzw" "${img}" "o-pal2rgb-threads-1.tiff"
+  f_test_convert "${PAL2RGB} -j 3 -r 3 -c lzw" "${img}" "o-pal2rgb-threads-3.tiff"
+  echo "cmp o-pal2rgb-threads-1.tiff o-pal2rgb-threads-3.tiff"
+  if ! cmp o-pal2rgb-threads-1.tiff o-pal2rgb-threads-3.tiff
+  then
+    echo "Image ${img} converted on threads differs"
+    exit 1
+  fi
+  f_test_convert "${PAL2RGB} -j 3 -r 3 -p separate" "${img}" "o-pal2rgb-threads-separate.tiff"
+  f_test_convert "${TIFFCP} -p contig -c lzw -r 3" "o-pal2rgb-threads-separate.tiff" "o-pal2rgb-threads-contig.tiff"
+  echo "${TIFFCMP} o-pal2rgb-threads-3.tiff o-pal2rgb-threads-contig.tiff"
+  if ! ${TIFFCMP} o-pal2rgb-threads-3.tiff o-pal2rgb-threads-contig.tiff
+  then
+    echo "Separate planes of ${img} differ"
+    exit 1
+  fi
+done
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFReadEncodedTilesParallel(),
+ * TIFFReadEncodedStripsParallel() and TIFFRGBAImageGetParallel()
+ * return the same data as their serial counterparts.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char tiledfile[] = "parallel_decode_tiled.tif";
+static const char stripfile[] = "parallel_decode_strip.tif";
+
+#define	WIDTH		256
+#define	LENGTH		200
+#define	TILESIZE	32
+#define	ROWSPERSTRIP	8
+#define	NTHREADS	4
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	tmsize_t i;
+
+	(void) arg;
+	for (i = 0; i < c->size; i++)
+		c->buf[i] = (unsigned char)((i / 7 + c->index * 13 + (i % 3) * 41) & 0xff);
+}
+
+static int
+write_image(const char* filename, int tiled)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 3, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_RGB, COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	if (tiled)
+		im.tilewidth = im.tilelength = TILESIZE;
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	ok = write_image_data(tif, fill_chunk, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+check_image(const char* filename, const char* mode, int tiled)
+{
+	TIFF* tif;
+	tmsize_t size;
+	uint32 n, i;
+	uint32* list = NULL;
+	void** bufs = NULL;
+	unsigned char* ref = NULL;
+	int ret = 0;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	list = (uint32*) calloc(n, sizeof(uint32));
+	bufs = (void**) calloc(n, sizeof(void*));
+	ref = (unsigned char*) malloc(size);
+	if (!list || !bufs || !ref)
+		goto failure;
+	/* Decode in reverse order to exercise the random access path */
+	for (i = 0; i < n; i++) {
+		list[i] = n - 1 - i;
+		bufs[i] = malloc(size);
+		if (!bufs[i])
+			goto failure;
+	}
+
+	if (!(tiled ?
+	      TIFFReadEncodedTilesParallel(tif, list, n, bufs, -1, NTHREADS) :
+	      TIFFReadEncodedStripsParallel(tif, list, n, bufs, -1, NTHREADS))) {
+		fprintf (stderr, "Parallel decoding of %s failed.\n", filename);
+		goto failure;
+	}
+	for (i = 0; i < n; i++) {
+		tmsize_t got = tiled ?
+		    TIFFReadEncodedTile(tif, list[i], ref, size) :
+		    TIFFReadEncodedStrip(tif, list[i], ref, size);
+		if (got == -1) {
+			fprintf (stderr, "Serial decoding of chunk %lu failed.\n",
+				 (unsigned long) list[i]);
+			goto failure;
+		}
+		if (memcmp(ref, bufs[i], got) != 0) {
+			fprintf (stderr, "%s (mode %s): chunk %lu differs.\n",
+				 filename, mode, (unsigned long) list[i]);
+			goto failure;
+		}
+	}
+
+	/* Second call reuses the cached decoding handles */
+	if (!(tiled ?
+	      TIFFReadEncodedTilesParallel(tif, list, n, bufs, -1, 0) :
+	      TIFFReadEncodedStripsParallel(tif, list, n, bufs, -1, 0))) {
+		fprintf (stderr, "Second parallel decoding of %s failed.\n",
+			 filename);
+		goto failure;
+	}
+
+	/* Strip/tile API mismatch must be refused */
+	if (tiled ?
+	    TIFFReadEncodedStripsParallel(tif, list, 1, bufs, -1, NTHREADS) :
+	    TIFFReadEncodedTilesParallel(tif, list, 1, bufs, -1, NTHREADS)) {
+		fprintf (stderr, "Mismatched chunk type was accepted.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	if (bufs) {
+		for (i = 0; i < n; i++)
+			free(bufs[i]);
+		free(bufs);
+	}
+	free(list);
+	free(ref);
+	TIFFClose(tif);
+	return ret;
+}
+
+static int
+check_rgba(const char* filename, const char* mode, int orientation,
+	   uint32 row_offset)
+{
+	TIFF* tif;
+	TIFFRGBAImage img;
+	char emsg[1024];
+	uint32 h = LENGTH - row_offset;
+	uint32* ref = NULL;
+	uint32* raster = NULL;
+	int ret = 0;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	ref = (uint32*) malloc(WIDTH * LENGTH * sizeof(uint32));
+	raster = (uint32*) malloc(WIDTH * LENGTH * sizeof(uint32));
+	if (!ref || !raster)
+		goto failure;
+	memset(ref, 0, WIDTH * LENGTH * sizeof(uint32));
+	memset(raster, 0xff, WIDTH * LENGTH * sizeof(uint32));
+
+	if (!TIFFRGBAImageBegin(&img, tif, 1, emsg)) {
+		fprintf (stderr, "%s: %s\n", filename, emsg);
+		goto failure;
+	}
+	img.req_orientation = (uint16) orientation;
+	img.row_offset = row_offset;
+	if (!TIFFRGBAImageGet(&img, ref, WIDTH, h) ||
+	    !TIFFRGBAImageGetParallel(&img, raster, WIDTH, h, NTHREADS)) {
+		fprintf (stderr, "%s: RGBA conversion failed.\n", filename);
+		TIFFRGBAImageEnd(&img);
+		goto failure;
+	}
+	TIFFRGBAImageEnd(&img);
+	if (memcmp(ref, raster, WIDTH * h * sizeof(uint32)) != 0) {
+		fprintf (stderr,
+			 "%s (mode %s, orientation %d, row offset %lu): "
+			 "RGBA rasters differ.\n", filename, mode, orientation,
+			 (unsigned long) row_offset);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	free(ref);
+	free(raster);
+	TIFFClose(tif);
+	return ret;
+}
+
+static int
+check_rgba_all(const char* filename)
+{
+	return check_rgba(filename, "r", ORIENTATION_TOPLEFT, 0) &&
+	    check_rgba(filename, "rm", ORIENTATION_BOTLEFT, 0) &&
+	    check_rgba(filename, "r", ORIENTATION_BOTLEFT, 5) &&
+	    check_rgba(filename, "rm", ORIENTATION_TOPLEFT, 5);
+}
+
+int
+main()
+{
+	if (!write_image(tiledfile, 1) || !write_image(stripfile, 0))
+		return 1;
+	if (!check_image(tiledfile, "r", 1) || !check_image(tiledfile, "rm", 1))
+		return 1;
+	if (!check_image(stripfile, "r", 0) || !check_image(stripfile, "rm", 0))
+		return 1;
+	if (!check_rgba_all(tiledfile) || !check_rgba_all(stripfile))
+		return 1;
+	unlink(tiledfile);
+	unlink(stripfile);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
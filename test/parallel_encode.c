@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFWriteEncodedTilesParallel() and
+ * TIFFWriteEncodedStripsParallel() produce the same files as their
+ * serial counterparts.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char serialfile[] = "parallel_encode_serial.tif";
+static const char parallelfile[] = "parallel_encode_parallel.tif";
+
+#define	WIDTH		256
+#define	LENGTH		200
+#define	TILESIZE	32
+#define	ROWSPERSTRIP	8
+#define	BIGROWSPERSTRIP	64	/* strips flushed in several pieces */
+#define	NTHREADS	4
+
+static uint32 rowsperstrip = ROWSPERSTRIP;
+
+static void
+fill_chunk(unsigned char* buf, tmsize_t size, uint32 chunk)
+{
+	tmsize_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)((i / 5 + chunk * 11 + (i % 3) * 37) & 0xff);
+}
+
+static int
+write_image(const char* filename, uint16 compression, int tiled, int parallel)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 3, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_RGB, 0, 0, 0, 0 };
+	TIFF* tif;
+	uint32 n, i, nrows;
+	uint32* list = NULL;
+	void** bufs = NULL;
+	tmsize_t* sizes = NULL;
+	int ret = 0;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.compression = compression;
+	im.rowsperstrip = rowsperstrip;
+	if (tiled)
+		im.tilewidth = im.tilelength = TILESIZE;
+	set_image_fields(tif, &im);
+	if (compression == COMPRESSION_JPEG)
+		TIFFSetField(tif, TIFFTAG_JPEGQUALITY, 90);
+	else if (compression != COMPRESSION_PACKBITS)
+		TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	list = (uint32*) calloc(n, sizeof(uint32));
+	bufs = (void**) calloc(n, sizeof(void*));
+	sizes = (tmsize_t*) calloc(n, sizeof(tmsize_t));
+	if (!list || !bufs || !sizes)
+		goto failure;
+	for (i = 0; i < n; i++) {
+		if (tiled)
+			sizes[i] = TIFFTileSize(tif);
+		else {
+			nrows = LENGTH - i * rowsperstrip;
+			if (nrows > rowsperstrip)
+				nrows = rowsperstrip;
+			sizes[i] = TIFFVStripSize(tif, nrows);
+		}
+		list[i] = i;
+		bufs[i] = malloc(sizes[i]);
+		if (!bufs[i])
+			goto failure;
+		fill_chunk(bufs[i], sizes[i], i);
+	}
+	if (parallel) {
+		if (!(tiled ?
+		      TIFFWriteEncodedTilesParallel(tif, list, n, bufs, sizes, NTHREADS) :
+		      TIFFWriteEncodedStripsParallel(tif, list, n, bufs, sizes, NTHREADS))) {
+			fprintf (stderr, "Parallel encoding of %s failed.\n", filename);
+			goto failure;
+		}
+	} else {
+		for (i = 0; i < n; i++) {
+			if ((tiled ?
+			     TIFFWriteEncodedTile(tif, i, bufs[i], sizes[i]) :
+			     TIFFWriteEncodedStrip(tif, i, bufs[i], sizes[i])) == -1) {
+				fprintf (stderr, "Can't write chunk %lu.\n",
+					 (unsigned long) i);
+				goto failure;
+			}
+		}
+	}
+	ret = 1;
+
+failure:
+	if (bufs) {
+		for (i = 0; i < n; i++)
+			free(bufs[i]);
+		free(bufs);
+	}
+	free(list);
+	free(sizes);
+	TIFFClose(tif);
+	return ret;
+}
+
+/*
+ * Compare the raw chunks of both files, then check that the parallel
+ * one also decodes to the original data.  For JPEG, check instead that
+ * both files carry the same JPEGTables.
+ */
+static int
+compare_images(uint16 compression, int tiled)
+{
+	TIFF* s = TIFFOpen(serialfile, "r");
+	TIFF* p = TIFFOpen(parallelfile, "r");
+	unsigned char *a = NULL, *b = NULL;
+	tmsize_t size, na, nb;
+	uint32 n, i;
+	int ret = 0;
+
+	if (!s || !p) {
+		fprintf (stderr, "Can't open test files.\n");
+		goto failure;
+	}
+	if (compression == COMPRESSION_JPEG) {
+		uint32 sn, pn;
+		void *st, *pt;
+
+		if (!TIFFGetField(s, TIFFTAG_JPEGTABLES, &sn, &st) ||
+		    !TIFFGetField(p, TIFFTAG_JPEGTABLES, &pn, &pt) ||
+		    sn != pn || memcmp(st, pt, sn) != 0) {
+			fprintf (stderr, "JPEGTables differ.\n");
+			goto failure;
+		}
+	}
+	n = tiled ? TIFFNumberOfTiles(s) : TIFFNumberOfStrips(s);
+	size = tiled ? TIFFTileSize(s) : TIFFStripSize(s);
+	a = (unsigned char*) malloc(size * 2);
+	b = (unsigned char*) malloc(size * 2);
+	if (!a || !b)
+		goto failure;
+	for (i = 0; i < n; i++) {
+		na = tiled ? TIFFReadRawTile(s, i, a, size * 2) :
+		    TIFFReadRawStrip(s, i, a, size * 2);
+		nb = tiled ? TIFFReadRawTile(p, i, b, size * 2) :
+		    TIFFReadRawStrip(p, i, b, size * 2);
+		if (na <= 0 || na != nb || memcmp(a, b, na) != 0) {
+			fprintf (stderr, "Raw chunk %lu differs.\n",
+				 (unsigned long) i);
+			goto failure;
+		}
+		if (compression == COMPRESSION_JPEG)
+			continue;
+		nb = tiled ? TIFFReadEncodedTile(p, i, b, size) :
+		    TIFFReadEncodedStrip(p, i, b, size);
+		if (nb <= 0) {
+			fprintf (stderr, "Can't decode chunk %lu.\n",
+				 (unsigned long) i);
+			goto failure;
+		}
+		fill_chunk(a, nb, i);
+		if (memcmp(a, b, nb) != 0) {
+			fprintf (stderr, "Decoded chunk %lu differs.\n",
+				 (unsigned long) i);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	free(a);
+	free(b);
+	if (s)
+		TIFFClose(s);
+	if (p)
+		TIFFClose(p);
+	return ret;
+}
+
+int
+main()
+{
+	uint16 compressions[] = { COMPRESSION_LZW, COMPRESSION_PACKBITS,
+				  COMPRESSION_ADOBE_DEFLATE, COMPRESSION_JPEG };
+	int c, tiled;
+
+	for (c = 0; c < 4; c++) {
+		if (!TIFFIsCODECConfigured(compressions[c]))
+			continue;
+		for (tiled = 0; tiled < 2; tiled++) {
+			if (!write_image(serialfile, compressions[c], tiled, 0) ||
+			    !write_image(parallelfile, compressions[c], tiled, 1) ||
+			    !compare_images(compressions[c], tiled)) {
+				fprintf (stderr, "Failed for compression %d, %s.\n",
+					 compressions[c], tiled ? "tiles" : "strips");
+				return 1;
+			}
+		}
+	}
+	rowsperstrip = BIGROWSPERSTRIP;
+	for (c = 0; c < 2; c++) {
+		if (!write_image(serialfile, compressions[c], 0, 0) ||
+		    !write_image(parallelfile, compressions[c], 0, 1) ||
+		    !compare_images(compressions[c], 0)) {
+			fprintf (stderr, "Failed for compression %d, big strips.\n",
+				 compressions[c]);
+			return 1;
+		}
+	}
+	unlink(serialfile);
+	unlink(parallelfile);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check handles opened with TIFFOpenOptionsSetPositionalIO() sharing
+ * one file descriptor, and parallel decoding through the positional
+ * read methods of TIFFFdOpen() and TIFFOpenOptionsSetReadAtProc().
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_IO_H
+# include <io.h>
+#endif
+
+#if defined(THREADS_SUPPORT) && defined(HAVE_PTHREAD)
+# include <pthread.h>
+# define MemLock		pthread_mutex_t
+# define LOCK_INIT(l)		pthread_mutex_init(l, NULL)
+# define LOCK(l)		pthread_mutex_lock(l)
+# define UNLOCK(l)		pthread_mutex_unlock(l)
+# define LOCK_FREE(l)		pthread_mutex_destroy(l)
+#elif defined(THREADS_SUPPORT) && defined(_WIN32)
+# include <windows.h>
+# define MemLock		CRITICAL_SECTION
+# define LOCK_INIT(l)		InitializeCriticalSection(l)
+# define LOCK(l)		EnterCriticalSection(l)
+# define UNLOCK(l)		LeaveCriticalSection(l)
+# define LOCK_FREE(l)		DeleteCriticalSection(l)
+#else
+# define MemLock		int
+# define LOCK_INIT(l)		((void) 0)
+# define LOCK(l)		((void) 0)
+# define UNLOCK(l)		((void) 0)
+# define LOCK_FREE(l)		((void) 0)
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
+static const char filename[] = "positional_io.tif";
+
+#define	WIDTH		160
+#define	LENGTH		96
+#define	TILESIZE	32
+#define	NTHREADS	4
+
+static unsigned char* ref;		/* all tiles, decoded serially */
+static tmsize_t tilesize;
+static uint32 ntiles;
+
+static void
+fill_tile(TestChunk* c, void* arg)
+{
+	tmsize_t i;
+
+	(void) arg;
+	for (i = 0; i < c->size; i++)
+		c->buf[i] = (unsigned char)((i / 5 + c->index * 29 + (i % 7) * 3) & 0xff);
+	memcpy(ref + c->index * tilesize, c->buf, c->size);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, 0, TILESIZE, TILESIZE };
+	TIFF* tif = TIFFOpen(filename, "w");
+	int ok;
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	set_image_fields(tif, &im);
+	tilesize = TIFFTileSize(tif);
+	ntiles = TIFFNumberOfTiles(tif);
+	ref = (unsigned char*) malloc(tilesize * ntiles);
+	if (!ref) {
+		fprintf (stderr, "Out of memory.\n");
+		TIFFClose(tif);
+		return 0;
+	}
+	ok = write_image_data(tif, fill_tile, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+/*
+ * Decode all tiles with TIFFReadEncodedTilesParallel() and compare.
+ */
+static int
+check_parallel(TIFF* tif, const char* what)
+{
+	uint32* list = (uint32*) malloc(ntiles * sizeof (uint32));
+	void** bufs = (void**) calloc(ntiles, sizeof (void*));
+	int ret = 0;
+	uint32 t;
+
+	if (!list || !bufs)
+		goto done;
+	for (t = 0; t < ntiles; t++) {
+		list[t] = t;
+		if ((bufs[t] = malloc(tilesize)) == NULL)
+			goto done;
+	}
+	if (!TIFFReadEncodedTilesParallel(tif, list, ntiles, bufs, -1,
+					  NTHREADS)) {
+		fprintf (stderr, "%s: parallel decoding failed.\n", what);
+		goto done;
+	}
+	for (t = 0; t < ntiles; t++)
+		if (memcmp(bufs[t], ref + t * tilesize, tilesize) != 0) {
+			fprintf (stderr, "%s: tile %lu differs.\n", what,
+				 (unsigned long) t);
+			goto done;
+		}
+	ret = 1;
+done:
+	if (bufs) {
+		for (t = 0; t < ntiles; t++)
+			free(bufs[t]);
+		free(bufs);
+	}
+	free(list);
+	return ret;
+}
+
+/*
+ * Read handles on a descriptor and on a duplicate of it, which share
+ * the file offset, used alternately.
+ */
+static int
+check_shared_fd(void)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	unsigned char* buf = (unsigned char*) malloc(tilesize);
+	TIFF* a = NULL;
+	TIFF* b = NULL;
+	int fd, fd2 = -1, ret = 0;
+	uint32 t;
+
+	if (!opts || !buf) {
+		fprintf (stderr, "Out of memory.\n");
+		goto done;
+	}
+	fd = open(filename, O_RDONLY | O_BINARY);
+	if (fd < 0) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto done;
+	}
+	TIFFOpenOptionsSetPositionalIO(opts, 1);
+	a = TIFFFdOpenExt(fd, filename, "r", opts);
+	if (!a) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		close(fd);
+		goto done;
+	}
+	fd2 = dup(fd);
+	b = fd2 >= 0 ? TIFFFdOpenExt(fd2, filename, "r", opts) : NULL;
+	if (!b) {
+		fprintf (stderr, "Can't open %s twice.\n", filename);
+		if (fd2 >= 0)
+			close(fd2);
+		goto done;
+	}
+	if (TIFFFileno(a) != fd) {
+		fprintf (stderr, "TIFFFileno() does not return the descriptor.\n");
+		goto done;
+	}
+	for (t = 0; t < ntiles; t++) {
+		uint32 u = ntiles - 1 - t;
+
+		if (TIFFReadEncodedTile(a, t, buf, tilesize) != tilesize ||
+		    memcmp(buf, ref + t * tilesize, tilesize) != 0 ||
+		    TIFFReadEncodedTile(b, u, buf, tilesize) != tilesize ||
+		    memcmp(buf, ref + u * tilesize, tilesize) != 0) {
+			fprintf (stderr, "Interleaved reads of tiles %lu and "
+				 "%lu failed.\n", (unsigned long) t,
+				 (unsigned long) u);
+			goto done;
+		}
+	}
+#ifdef HAVE_PREAD
+	if (lseek(fd, 0, SEEK_CUR) != 0) {
+		fprintf (stderr, "Positional reads moved the file offset.\n");
+		goto done;
+	}
+#endif
+	if (!check_parallel(a, "positional handle"))
+		goto done;
+	ret = 1;
+done:
+	if (a)
+		TIFFClose(a);
+	if (b)
+		TIFFClose(b);
+	if (opts)
+		TIFFOpenOptionsFree(opts);
+	free(buf);
+	return ret;
+}
+
+/* An in-memory file for TIFFClientOpenExt() */
+typedef struct {
+	unsigned char* data;
+	toff_t size;
+	toff_t off;
+	MemLock lock;			/* protects readat */
+	int readat;			/* a positional read was made */
+} MemFile;
+
+static tmsize_t
+memRead(thandle_t h, void* buf, tmsize_t size)
+{
+	MemFile* m = (MemFile*) h;
+
+	if (m->off >= m->size)
+		return 0;
+	if ((toff_t) size > m->size - m->off)
+		size = (tmsize_t)(m->size - m->off);
+	memcpy(buf, m->data + m->off, size);
+	m->off += size;
+	return size;
+}
+
+static tmsize_t
+memReadAt(thandle_t h, void* buf, tmsize_t size, toff_t off)
+{
+	MemFile* m = (MemFile*) h;
+
+	/* called from the decoding threads at once */
+	LOCK(&m->lock);
+	m->readat = 1;
+	UNLOCK(&m->lock);
+	if (off >= m->size)
+		return 0;
+	if ((toff_t) size > m->size - off)
+		size = (tmsize_t)(m->size - off);
+	memcpy(buf, m->data + off, size);
+	return size;
+}
+
+static tmsize_t
+memWrite(thandle_t h, void* buf, tmsize_t size)
+{
+	(void) h; (void) buf; (void) size;
+	return -1;
+}
+
+static toff_t
+memSeek(thandle_t h, toff_t off, int whence)
+{
+	MemFile* m = (MemFile*) h;
+
+	if (whence == SEEK_CUR)
+		off += m->off;
+	else if (whence == SEEK_END)
+		off += m->size;
+	m->off = off;
+	return off;
+}
+
+static int
+memClose(thandle_t h)
+{
+	(void) h;
+	return 0;
+}
+
+static toff_t
+memSize(thandle_t h)
+{
+	return ((MemFile*) h)->size;
+}
+
+static int
+check_client_readat(void)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	FILE* f = fopen(filename, "rb");
+	MemFile m;
+	TIFF* tif = NULL;
+	long size;
+	int ret = 0;
+
+	m.data = NULL;
+	LOCK_INIT(&m.lock);
+	if (!opts || !f || fseek(f, 0, SEEK_END) != 0 ||
+	    (size = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET) != 0 ||
+	    (m.data = (unsigned char*) malloc(size)) == NULL ||
+	    fread(m.data, 1, size, f) != (size_t) size) {
+		fprintf (stderr, "Can't load %s.\n", filename);
+		goto done;
+	}
+	m.size = (toff_t) size;
+	m.off = 0;
+	m.readat = 0;
+	TIFFOpenOptionsSetReadAtProc(opts, memReadAt);
+	/* no mapping, so that the raw data is read */
+	tif = TIFFClientOpenExt(filename, "rm", (thandle_t) &m, memRead,
+				memWrite, memSeek, memClose, memSize, NULL,
+				NULL, opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s from memory.\n", filename);
+		goto done;
+	}
+	if (!check_parallel(tif, "client handle"))
+		goto done;
+#ifdef THREADS_SUPPORT
+	if (!m.readat) {
+		fprintf (stderr, "The positional read method was not used.\n");
+		goto done;
+	}
+#endif
+	ret = 1;
+done:
+	if (tif)
+		TIFFClose(tif);
+	if (f)
+		fclose(f);
+	if (opts)
+		TIFFOpenOptionsFree(opts);
+	free(m.data);
+	LOCK_FREE(&m.lock);
+	return ret;
+}
+
+int
+main()
+{
+	TIFF* tif;
+
+	if (!write_image())
+		return 1;
+	tif = TIFFOpen(filename, "rm");
+	if (!tif || !check_parallel(tif, "TIFFOpen handle"))
+		return 1;
+	TIFFClose(tif);
+	if (!check_shared_fd() || !check_client_readat())
+		return 1;
+	free(ref);
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+# Check that ppm2tiff and raw2tiff write the same image on one or more
+# threads and as tiles
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${PPM2TIFF} -j 1 -c lzw:2 -r 5" "${IMG_RGB_3C_8B_PPM}" "o-ppm2tiff-threads-1.tiff"
+f_test_convert "${PPM2TIFF} -j 3 -c lzw:2 -r 5" "${IMG_RGB_3C_8B_PPM}" "o-ppm2tiff-threads-3.tiff"
+echo "cmp o-ppm2tiff-threads-1.tiff o-ppm2tiff-threads-3.tiff"
+if ! cmp o-ppm2tiff-threads-1.tiff o-ppm2tiff-threads-3.tiff
+then
+  echo "Image compressed on threads differs"
+  exit 1
+fi
+f_test_convert "${PPM2TIFF} -j 3 -c zip -w 32 -l 48" "${IMG_RGB_3C_8B_PPM}" "o-ppm2tiff-threads-tile.tiff"
+f_test_convert "${RAW2TIFF} -j 3 -c packbits -H 15 -w 157 -l 151 -b 3 -p rgb" "${IMG_RGB_3C_8B_PPM}" "o-ppm2tiff-threads-raw.tiff"
+f_test_convert "${RAW2TIFF} -j 3 -c zip -T 64 -H 15 -w 157 -l 151 -b 3 -p rgb" "${IMG_RGB_3C_8B_PPM}" "o-ppm2tiff-threads-rawtile.tiff"
+digest=`${TIFFCMP} -h o-ppm2tiff-threads-1.tiff | cut -d: -f2-`
+for img in tile raw rawtile
+do
+  other=`${TIFFCMP} -h o-ppm2tiff-threads-${img}.tiff | cut -d: -f2-`
+  echo "${digest} ${other}"
+  if test "${digest}" != "${other}"
+  then
+    echo "Image written as ${img} differs"
+    exit 1
+  fi
+done
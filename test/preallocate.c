@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFPreallocate() passes the estimated image size to the
+ * preallocation method and leaves the size of the file alone.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "preallocate.tif";
+
+#define	WIDTH		256
+#define	LENGTH		100
+#define	ROWSPERSTRIP	10
+
+static toff_t got_off, got_len;
+static int calls;
+
+static int
+record_preallocate(thandle_t fd, toff_t off, toff_t len)
+{
+	(void) fd;
+	got_off = off;
+	got_len = len;
+	calls++;
+	return 1;
+}
+
+static void
+setup_image(TIFF* tif)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+}
+
+static int
+write_strips(TIFF* tif)
+{
+	unsigned char buf[WIDTH * ROWSPERSTRIP];
+	uint32 s;
+
+	for (s = 0; s < LENGTH / ROWSPERSTRIP; s++) {
+		memset(buf, (int) s, sizeof(buf));
+		if (TIFFWriteEncodedStrip(tif, s, buf, sizeof(buf)) == -1) {
+			fprintf (stderr, "Can't write strip %lu.\n",
+				 (unsigned long) s);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static long
+write_file(int preallocate)
+{
+	TIFF* tif;
+	FILE* fd;
+	long size;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return -1;
+	}
+	setup_image(tif);
+	/* whether the file system supports it or not, nothing changes */
+	if (preallocate)
+		(void) TIFFPreallocate(tif, 0);
+	if (!write_strips(tif)) {
+		TIFFClose(tif);
+		return -1;
+	}
+	TIFFClose(tif);
+	fd = fopen(filename, "rb");
+	if (!fd)
+		return -1;
+	fseek(fd, 0, SEEK_END);
+	size = ftell(fd);
+	fclose(fd);
+	return size;
+}
+
+static int
+check_method(void)
+{
+	TIFFOpenOptions* opts;
+	TIFF* tif;
+	uint64 expected;
+	int ret = 0;
+
+	opts = TIFFOpenOptionsAlloc();
+	if (!opts)
+		return 0;
+	TIFFOpenOptionsSetPreallocateProc(opts, record_preallocate);
+	tif = TIFFOpenMemoryExt(NULL, 0, "w", opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't create memory file.\n");
+		return 0;
+	}
+	setup_image(tif);
+	if (!TIFFPreallocate(tif, 0) || calls != 1) {
+		fprintf (stderr, "Preallocation method not called.\n");
+		goto failure;
+	}
+	expected = (uint64) (LENGTH / ROWSPERSTRIP) *
+	    (WIDTH * ROWSPERSTRIP + 16) + 4096;
+	if (got_off != 8 || got_len != expected) {
+		fprintf (stderr, "Preallocated %lu bytes at %lu, expected "
+			 "%lu at 8.\n", (unsigned long) got_len,
+			 (unsigned long) got_off, (unsigned long) expected);
+		goto failure;
+	}
+	if (!write_strips(tif))
+		goto failure;
+	if (!TIFFPreallocate(tif, 12345) || got_len != 12345 ||
+	    got_off != 8 + (LENGTH / ROWSPERSTRIP) * WIDTH * ROWSPERSTRIP) {
+		fprintf (stderr, "Explicit preallocation at %lu of %lu "
+			 "bytes.\n", (unsigned long) got_off,
+			 (unsigned long) got_len);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	long plain, preallocated;
+
+	plain = write_file(0);
+	preallocated = write_file(1);
+	if (plain < 0 || preallocated < 0)
+		return 1;
+	if (plain != preallocated) {
+		fprintf (stderr, "File is %ld bytes with preallocation, %ld "
+			 "without.\n", preallocated, plain);
+		return 1;
+	}
+	if (!check_method())
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
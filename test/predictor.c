@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the horizontal predictor for the sample sizes and strides that
+ * have optimized code paths.  The differenced data is compared with a
+ * straightforward computation, and decoding must give back the image.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "predictor.tif";
+static const char rawfilename[] = "predictor_raw.tif";
+
+#define	LENGTH		3
+
+static void
+set_fields(TIFF* tif, uint32 width, uint16 bps, uint16 spp)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, bps);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, spp);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, LENGTH);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+}
+
+static uint64
+sample(uint8* buf, uint16 bps, tmsize_t i)
+{
+	switch (bps) {
+	case 8:
+		return buf[i];
+	case 16:
+		return ((uint16*) buf)[i];
+	case 32:
+		return ((uint32*) buf)[i];
+	default:
+		return ((uint64*) buf)[i];
+	}
+}
+
+static void
+set_sample(uint8* buf, uint16 bps, tmsize_t i, uint64 v)
+{
+	switch (bps) {
+	case 8:
+		buf[i] = (uint8) v;
+		break;
+	case 16:
+		((uint16*) buf)[i] = (uint16) v;
+		break;
+	case 32:
+		((uint32*) buf)[i] = (uint32) v;
+		break;
+	default:
+		((uint64*) buf)[i] = v;
+		break;
+	}
+}
+
+/*
+ * Mode that writes the file in the byte order opposite to the host's,
+ * to exercise the byte-swapping variants of the predictor.
+ */
+static const char*
+swapped_mode(void)
+{
+	static const uint16 one = 1;
+
+	return *(const uint8*) &one ? "wb" : "wl";
+}
+
+static int
+check(uint32 width, uint16 bps, uint16 spp, int swapped)
+{
+	TIFF* tif;
+	tmsize_t size, nsamples = (tmsize_t) width * spp * LENGTH;
+	tmsize_t rowsamples = (tmsize_t) width * spp, i;
+	uint8 *image, *buf, *raw;
+	tmsize_t rawsize;
+	uint32 seed = width * 31 + bps * 7 + spp;
+	const char* mode = swapped ? swapped_mode() : "w";
+	int ret = 0;
+
+	size = nsamples * (bps / 8);
+	image = (uint8*) malloc(size);
+	buf = (uint8*) malloc(size);
+	raw = (uint8*) malloc(2 * size + 1024);
+	if (!image || !buf || !raw) {
+		fprintf (stderr, "Out of memory.\n");
+		goto failure;
+	}
+	for (i = 0; i < nsamples; i++) {
+		uint64 v;
+
+		seed = seed * 1103515245 + 12345;
+		v = seed >> 8;
+		seed = seed * 1103515245 + 12345;
+		v = (v << 32) | seed;
+		set_sample(image, bps, i, v);
+	}
+
+	/* Encode with the predictor */
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", filename);
+		goto failure;
+	}
+	set_fields(tif, width, bps, spp);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	memcpy(buf, image, size);
+	if (TIFFWriteEncodedStrip(tif, 0, buf, size) != size) {
+		fprintf (stderr, "Can't write %s.\n", filename);
+		TIFFClose(tif);
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	/* Decoding must give back the image */
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	if (TIFFReadEncodedStrip(tif, 0, buf, size) != size ||
+	    memcmp(buf, image, size) != 0) {
+		fprintf (stderr, "Decoding differs.\n");
+		TIFFClose(tif);
+		goto failure;
+	}
+	rawsize = TIFFReadRawStrip(tif, 0, raw, 2 * size + 1024);
+	TIFFClose(tif);
+	if (rawsize <= 0) {
+		fprintf (stderr, "Can't read raw strip.\n");
+		goto failure;
+	}
+
+	/* Decode the same codes without the predictor to see the differences */
+	tif = TIFFOpen(rawfilename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", rawfilename);
+		goto failure;
+	}
+	set_fields(tif, width, bps, spp);
+	if (TIFFWriteRawStrip(tif, 0, raw, rawsize) != rawsize) {
+		fprintf (stderr, "Can't write %s.\n", rawfilename);
+		TIFFClose(tif);
+		goto failure;
+	}
+	TIFFClose(tif);
+	tif = TIFFOpen(rawfilename, "r");
+	if (!tif || TIFFReadEncodedStrip(tif, 0, buf, size) != size) {
+		fprintf (stderr, "Can't read %s.\n", rawfilename);
+		if (tif)
+			TIFFClose(tif);
+		goto failure;
+	}
+	TIFFClose(tif);
+	for (i = 0; i < nsamples; i++) {
+		tmsize_t col = i % rowsamples;
+		uint64 expected = sample(image, bps, i);
+		uint64 mask = bps == 64 ? ~(uint64) 0 :
+		    ((uint64) 1 << bps) - 1;
+
+		if (col >= spp)
+			expected = (expected - sample(image, bps, i - spp)) & mask;
+		if (sample(buf, bps, i) != expected) {
+			fprintf (stderr, "Differencing error at sample %ld.\n",
+				 (long) i);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	if (!ret)
+		fprintf (stderr, "Failed for width %lu, %d bits, %d samples%s.\n",
+			 (unsigned long) width, bps, spp,
+			 swapped ? ", swapped" : "");
+	free(image);
+	free(buf);
+	free(raw);
+	return ret;
+}
+
+/*
+ * Chunks larger than the batch the library decodes at a time, with the
+ * codec, predictor, bit reversal and byte swapping all involved.
+ */
+static int
+check_batches(uint16 compression, uint16 predictor, uint16 fillorder)
+{
+	const uint32 width = 600, length = 300;
+	tmsize_t size = (tmsize_t) width * length * 2, i;
+	uint16 *image, *buf;
+	TIFF* tif;
+	uint32 row;
+	int ret = 0;
+
+	image = (uint16*) malloc(size);
+	buf = (uint16*) malloc(size);
+	if (!image || !buf) {
+		fprintf (stderr, "Out of memory.\n");
+		goto failure;
+	}
+	for (i = 0; i < size / 2; i++)
+		image[i] = (uint16) ((i % width) * 97 + (i / width) * 13 +
+		    (i % 7) * 1000);
+
+	tif = TIFFOpen(filename, swapped_mode());
+	if (!tif) {
+		fprintf (stderr, "Can't create %s.\n", filename);
+		goto failure;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, length);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, length);
+	TIFFSetField(tif, TIFFTAG_FILLORDER, fillorder);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, compression);
+	if (predictor != PREDICTOR_NONE)
+		TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor);
+	memcpy(buf, image, size);
+	if (TIFFWriteEncodedStrip(tif, 0, buf, size) != size) {
+		fprintf (stderr, "Can't write %s.\n", filename);
+		TIFFClose(tif);
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	/* No strip chopping, so that the one strip is decoded in a call */
+	tif = TIFFOpen(filename, "rc");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	if (TIFFReadEncodedStrip(tif, 0, buf, size) != size ||
+	    memcmp(buf, image, size) != 0) {
+		fprintf (stderr, "Strip decoding differs.\n");
+		TIFFClose(tif);
+		goto failure;
+	}
+	TIFFClose(tif);
+
+	/* Scanline at a time, which goes through the codec row by row */
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto failure;
+	}
+	for (row = 0; row < length; row++) {
+		if (TIFFReadScanline(tif, buf, row, 0) != 1 ||
+		    memcmp(buf, image + (tmsize_t) row * width,
+			   width * 2) != 0) {
+			fprintf (stderr, "Scanline %lu differs.\n",
+				 (unsigned long) row);
+			TIFFClose(tif);
+			goto failure;
+		}
+	}
+	TIFFClose(tif);
+	ret = 1;
+
+failure:
+	if (!ret)
+		fprintf (stderr, "Failed for compression %d, predictor %d, "
+			 "fill order %d.\n", compression, predictor, fillorder);
+	free(image);
+	free(buf);
+	return ret;
+}
+
+int
+main()
+{
+	static const uint32 widths[] = { 1, 2, 5, 6, 17, 33, 100, 257 };
+	uint16 bps, spp;
+	size_t w;
+	int swapped;
+
+	for (swapped = 0; swapped <= 1; swapped++)
+		for (bps = 8; bps <= 64; bps *= 2)
+			for (spp = 1; spp <= 5; spp++)
+				for (w = 0;
+				     w < sizeof(widths) / sizeof(widths[0]);
+				     w++)
+					if (!check(widths[w], bps, spp,
+						   swapped))
+						return 1;
+	if (!check_batches(COMPRESSION_LZW, PREDICTOR_HORIZONTAL,
+			   FILLORDER_MSB2LSB) ||
+	    !check_batches(COMPRESSION_ADOBE_DEFLATE, PREDICTOR_HORIZONTAL,
+			   FILLORDER_LSB2MSB) ||
+	    !check_batches(COMPRESSION_NONE, PREDICTOR_NONE,
+			   FILLORDER_LSB2MSB))
+		return 1;
+	if (TIFFIsCODECConfigured(COMPRESSION_LZMA) &&
+	    !check_batches(COMPRESSION_LZMA, PREDICTOR_HORIZONTAL,
+			   FILLORDER_MSB2LSB))
+		return 1;
+	unlink(filename);
+	unlink(rawfilename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that scanline reading with read-ahead enabled by
+ * TIFFSetPrefetch() returns the same data as without it, both for
+ * POSIX file descriptors and for client supplied I/O procedures.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "prefetch.tif";
+
+#define	WIDTH		300
+#define	LENGTH		257
+#define	ROWSPERSTRIP	3
+
+static tmsize_t
+stdioRead(thandle_t fd, void* buf, tmsize_t size)
+{
+	return (tmsize_t) fread(buf, 1, (size_t) size, (FILE*) fd);
+}
+
+static tmsize_t
+stdioWrite(thandle_t fd, void* buf, tmsize_t size)
+{
+	(void) fd; (void) buf; (void) size;
+	return 0;
+}
+
+static toff_t
+stdioSeek(thandle_t fd, toff_t off, int whence)
+{
+	if (fseek((FILE*) fd, (long) off, whence) != 0)
+		return (toff_t) -1;
+	return (toff_t) ftell((FILE*) fd);
+}
+
+static int
+stdioClose(thandle_t fd)
+{
+	return fclose((FILE*) fd);
+}
+
+static toff_t
+stdioSize(thandle_t fd)
+{
+	long pos = ftell((FILE*) fd);
+	long size;
+
+	fseek((FILE*) fd, 0, SEEK_END);
+	size = ftell((FILE*) fd);
+	fseek((FILE*) fd, pos, SEEK_SET);
+	return (toff_t) size;
+}
+
+static int
+noMap(thandle_t fd, void** base, toff_t* size)
+{
+	(void) fd; (void) base; (void) size;
+	return 0;
+}
+
+static void
+noUnmap(thandle_t fd, void* base, toff_t size)
+{
+	(void) fd; (void) base; (void) size;
+}
+
+static unsigned char
+pixel(uint32 x, uint32 y)
+{
+	return (unsigned char)((x * 3 + y * 7 + (x * y) / 11) & 0xff);
+}
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	uint32 x, y;
+
+	(void) arg;
+	for (y = 0; y < c->length; y++)
+		for (x = 0; x < c->width; x++)
+			c->buf[y * c->width + x] = pixel(x, c->y + y);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, 0, PHOTOMETRIC_MINISBLACK,
+	    COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+
+	return write_test_image(filename, &im, fill_strip, NULL);
+}
+
+static int
+check_rows(TIFF* tif, const char* what, uint32 from, uint32 to)
+{
+	unsigned char buf[WIDTH];
+	uint32 x, y;
+
+	for (y = from; y < to; y++) {
+		if (TIFFReadScanline(tif, buf, y, 0) == -1) {
+			fprintf (stderr, "%s: can't read row %lu.\n", what,
+				 (unsigned long) y);
+			return 0;
+		}
+		for (x = 0; x < WIDTH; x++) {
+			if (buf[x] != pixel(x, y)) {
+				fprintf (stderr, "%s: wrong pixel at %lu,%lu.\n",
+					 what, (unsigned long) x,
+					 (unsigned long) y);
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static int
+check_image(TIFF* tif, const char* what)
+{
+	if (!TIFFSetPrefetch(tif, 4)) {
+		fprintf (stderr, "%s: TIFFSetPrefetch() failed.\n", what);
+		return 0;
+	}
+	/* Jump back to an earlier strip half way to exercise invalidation */
+	return check_rows(tif, what, 0, LENGTH / 2) &&
+	    check_rows(tif, what, 2 * ROWSPERSTRIP, LENGTH);
+}
+
+int
+main()
+{
+	TIFF* tif;
+	FILE* fp;
+	int ok;
+
+	if (!write_image())
+		return 1;
+
+	tif = TIFFOpen(filename, "rm");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 1;
+	}
+	ok = check_image(tif, "descriptor");
+	TIFFClose(tif);
+	if (!ok)
+		return 1;
+
+	fp = fopen(filename, "rb");
+	if (!fp) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 1;
+	}
+	tif = TIFFClientOpen(filename, "r", (thandle_t) fp,
+			     stdioRead, stdioWrite, stdioSeek, stdioClose,
+			     stdioSize, noMap, noUnmap);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s with client I/O.\n", filename);
+		fclose(fp);
+		return 1;
+	}
+	ok = check_image(tif, "client I/O");
+	TIFFClose(tif);
+	if (!ok)
+		return 1;
+
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
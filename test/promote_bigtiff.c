@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Write past 4 GiB in a file opened with the "A" mode flag and check
+ * that it turned into a BigTIFF file with all its directories, SubIFDs
+ * and tag values intact, while smaller files stay ClassicTIFF.  The
+ * file lives in memory, with the large strips, all zeros, kept as holes.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiffio.h"
+
+#define	BIGWIDTH	65536
+#define	BIGROWS		1024		/* rows per strip of 64 MiB */
+#define	BIGSTRIPS	66		/* 4.125 GiB */
+#define	SMALL		16
+#define	HOLE		(1 << 20)	/* writes from this size on are zeros */
+
+typedef struct {
+	uint64	off;
+	uint64	len;
+	uint8*	data;		/* NULL for zeros */
+} Extent;
+
+typedef struct {
+	uint64	size;
+	uint64	pos;
+	Extent*	ext;
+	int	next;
+	int	alloc;
+} VFile;
+
+static tmsize_t
+vf_read(thandle_t h, void* buf, tmsize_t size)
+{
+	VFile* f = (VFile*) h;
+	uint64 end;
+	int i;
+
+	if (f->pos >= f->size)
+		return 0;
+	if ((uint64) size > f->size - f->pos)
+		size = (tmsize_t) (f->size - f->pos);
+	end = f->pos + (uint64) size;
+	memset(buf, 0, (size_t) size);
+	/* later writes take precedence */
+	for (i = 0; i < f->next; i++) {
+		Extent* e = &f->ext[i];
+		uint64 a = e->off > f->pos ? e->off : f->pos;
+		uint64 b = e->off + e->len < end ? e->off + e->len : end;
+
+		if (a >= b || e->data == NULL)
+			continue;
+		memcpy((uint8*) buf + (a - f->pos), e->data + (a - e->off),
+		       (size_t) (b - a));
+	}
+	f->pos = end;
+	return size;
+}
+
+static tmsize_t
+vf_write(thandle_t h, void* buf, tmsize_t size)
+{
+	VFile* f = (VFile*) h;
+	Extent* e;
+
+	if (f->next == f->alloc) {
+		int alloc = f->alloc ? 2 * f->alloc : 64;
+		Extent* p = (Extent*) realloc(f->ext, alloc * sizeof(Extent));
+		if (!p)
+			return -1;
+		f->ext = p;
+		f->alloc = alloc;
+	}
+	e = &f->ext[f->next];
+	e->off = f->pos;
+	e->len = (uint64) size;
+	e->data = NULL;
+	if (size < HOLE) {
+		e->data = (uint8*) malloc((size_t) size + 1);
+		if (!e->data)
+			return -1;
+		memcpy(e->data, buf, (size_t) size);
+	}
+	f->next++;
+	f->pos += (uint64) size;
+	if (f->pos > f->size)
+		f->size = f->pos;
+	return size;
+}
+
+static toff_t
+vf_seek(thandle_t h, toff_t off, int whence)
+{
+	VFile* f = (VFile*) h;
+
+	if (whence == SEEK_CUR)
+		off += f->pos;
+	else if (whence == SEEK_END)
+		off += f->size;
+	f->pos = off;
+	return off;
+}
+
+static int
+vf_close(thandle_t h)
+{
+	(void) h;
+	return 0;
+}
+
+static toff_t
+vf_size(thandle_t h)
+{
+	return ((VFile*) h)->size;
+}
+
+static int
+vf_map(thandle_t h, void** base, toff_t* size)
+{
+	(void) h; (void) base; (void) size;
+	return 0;
+}
+
+static void
+vf_unmap(thandle_t h, void* base, toff_t size)
+{
+	(void) h; (void) base; (void) size;
+}
+
+static void
+vf_free(VFile* f)
+{
+	int i;
+
+	for (i = 0; i < f->next; i++)
+		free(f->ext[i].data);
+	free(f->ext);
+	memset(f, 0, sizeof(*f));
+}
+
+static TIFF*
+vf_open(VFile* f, const char* mode)
+{
+	f->pos = 0;
+	return TIFFClientOpen("promote_bigtiff", mode, (thandle_t) f,
+			      vf_read, vf_write, vf_seek, vf_close, vf_size,
+			      vf_map, vf_unmap);
+}
+
+/* The version number of the header as it is in the file */
+static int
+is_big(VFile* f)
+{
+	uint64 pos = f->pos;
+	unsigned char hdr[4];
+
+	f->pos = 0;
+	if (vf_read((thandle_t) f, hdr, 4) != 4)
+		hdr[2] = hdr[3] = 0;
+	f->pos = pos;
+	return hdr[0] == 'I' ? hdr[2] == 43 : hdr[3] == 43;
+}
+
+static void
+set_image(TIFF* tif, uint32 width, uint32 length, uint32 rows)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, length);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rows);
+}
+
+static void
+fill(unsigned char* buf, tmsize_t n, int seed)
+{
+	tmsize_t i;
+
+	for (i = 0; i < n; i++)
+		buf[i] = (unsigned char) (i * 3 + seed);
+}
+
+/*
+ * A small image with values of 5 to 8 bytes stored out of the
+ * directory in ClassicTIFF, and within it in BigTIFF.
+ */
+static int
+write_small(TIFF* tif, int seed, int subifd)
+{
+	unsigned char buf[SMALL * SMALL];
+	uint64 subifds[1] = { 0 };
+
+	set_image(tif, SMALL, SMALL, SMALL);
+	TIFFSetField(tif, TIFFTAG_XRESOLUTION, 300.0f + seed);
+	TIFFSetField(tif, TIFFTAG_YRESOLUTION, 150.0f);
+	TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION,
+		     "A description long enough to stay out of the entry");
+	if (subifd)
+		TIFFSetField(tif, TIFFTAG_SUBIFD, 1, subifds);
+	fill(buf, sizeof(buf), seed);
+	return TIFFWriteEncodedStrip(tif, 0, buf, sizeof(buf)) != -1 &&
+	       TIFFWriteDirectory(tif);
+}
+
+static int
+check_small(TIFF* tif, int seed)
+{
+	unsigned char buf[SMALL * SMALL], expected[SMALL * SMALL];
+	float xres = 0, yres = 0;
+	char* desc = NULL;
+
+	if (!TIFFGetField(tif, TIFFTAG_XRESOLUTION, &xres) ||
+	    !TIFFGetField(tif, TIFFTAG_YRESOLUTION, &yres) ||
+	    xres != 300.0f + seed || yres != 150.0f) {
+		fprintf (stderr, "Wrong resolution %g x %g.\n", xres, yres);
+		return 0;
+	}
+	if (!TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &desc) ||
+	    strcmp(desc, "A description long enough to stay out of the "
+		   "entry") != 0) {
+		fprintf (stderr, "Wrong description.\n");
+		return 0;
+	}
+	fill(expected, sizeof(expected), seed);
+	if (TIFFReadEncodedStrip(tif, 0, buf, sizeof(buf)) != sizeof(buf) ||
+	    memcmp(buf, expected, sizeof(buf)) != 0) {
+		fprintf (stderr, "Wrong pixels of image %d.\n", seed);
+		return 0;
+	}
+	return 1;
+}
+
+/* Write strips of zeros past 4 GiB and a last one of 4 kilobytes */
+static int
+write_big(TIFF* tif, const unsigned char* zeros)
+{
+	unsigned char last[4096];
+	uint32 s;
+
+	set_image(tif, BIGWIDTH, BIGROWS * BIGSTRIPS, BIGROWS);
+	for (s = 0; s + 1 < BIGSTRIPS; s++)
+		if (TIFFWriteRawStrip(tif, s, (void*) zeros,
+		    (tmsize_t) BIGWIDTH * BIGROWS) == -1)
+			return 0;
+	fill(last, sizeof(last), 7);
+	return TIFFWriteRawStrip(tif, s, last, sizeof(last)) != -1 &&
+	       TIFFWriteDirectory(tif);
+}
+
+static int
+check_big(TIFF* tif)
+{
+	unsigned char last[4096], expected[4096];
+	uint64 off = TIFFGetStrileOffset(tif, BIGSTRIPS - 1);
+
+	if (off <= 0xFFFFFFFFU ||
+	    TIFFGetStrileByteCount(tif, BIGSTRIPS - 1) != sizeof(last) ||
+	    TIFFGetStrileByteCount(tif, 0) != (uint64) BIGWIDTH * BIGROWS) {
+		fprintf (stderr, "Wrong strips of the large image.\n");
+		return 0;
+	}
+	fill(expected, sizeof(expected), 7);
+	if (TIFFReadRawStrip(tif, BIGSTRIPS - 1, last, sizeof(last)) !=
+	    sizeof(last) || memcmp(last, expected, sizeof(last)) != 0) {
+		fprintf (stderr, "Wrong last strip of the large image.\n");
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * An image with a SubIFD, then one past 4 GiB, then one more, with
+ * the "A" flag and the byte order given.
+ */
+static int
+test_promote(const char* mode, const unsigned char* zeros)
+{
+	VFile f;
+	TIFF* tif;
+	uint16 nsubifd = 0;
+	uint64* subifds = NULL;
+	uint64 subifd;
+	int ok;
+
+	memset(&f, 0, sizeof(f));
+	tif = vf_open(&f, mode);
+	if (!tif)
+		return 0;
+	ok = write_small(tif, 1, 1) && write_small(tif, 2, 0) &&
+	     !is_big(&f) && write_big(tif, zeros) &&
+	     is_big(&f) && write_small(tif, 3, 0);
+	TIFFClose(tif);
+	if (!ok) {
+		fprintf (stderr, "Can't write in mode %s.\n", mode);
+		vf_free(&f);
+		return 0;
+	}
+
+	tif = vf_open(&f, "r");
+	ok = tif != NULL && is_big(&f) &&
+	     TIFFNumberOfDirectories(tif) == 3 && check_small(tif, 1) &&
+	     TIFFGetField(tif, TIFFTAG_SUBIFD, &nsubifd, &subifds) &&
+	     nsubifd == 1;
+	if (ok) {
+		subifd = subifds[0];
+		ok = TIFFSetSubDirectory(tif, subifd) && check_small(tif, 2) &&
+		     TIFFSetDirectory(tif, 1) && check_big(tif) &&
+		     TIFFSetDirectory(tif, 2) && check_small(tif, 3);
+	}
+	if (tif)
+		TIFFClose(tif);
+	vf_free(&f);
+	if (!ok)
+		fprintf (stderr, "Wrong read back of mode %s.\n", mode);
+	return ok;
+}
+
+/* Without the flag the large image cannot be written */
+static int
+test_classic(const unsigned char* zeros)
+{
+	VFile f;
+	TIFF* tif;
+	TIFFErrorHandler handler;
+	int ok;
+
+	memset(&f, 0, sizeof(f));
+	tif = vf_open(&f, "w");
+	if (!tif)
+		return 0;
+	handler = TIFFSetErrorHandler(NULL);
+	ok = write_small(tif, 1, 0) && !write_big(tif, zeros);
+	TIFFClose(tif);
+	TIFFSetErrorHandler(handler);
+	vf_free(&f);
+	if (!ok)
+		fprintf (stderr, "Wrote past 4 GiB without the A flag.\n");
+	return ok;
+}
+
+/* Small enough files stay ClassicTIFF */
+static int
+test_small(void)
+{
+	VFile f;
+	TIFF* tif;
+	int ok;
+
+	memset(&f, 0, sizeof(f));
+	tif = vf_open(&f, "wA");
+	if (!tif)
+		return 0;
+	ok = write_small(tif, 1, 0) && write_small(tif, 2, 0);
+	TIFFClose(tif);
+	tif = ok ? vf_open(&f, "r") : NULL;
+	ok = tif != NULL && !is_big(&f) &&
+	     TIFFNumberOfDirectories(tif) == 2 && check_small(tif, 1) &&
+	     TIFFReadDirectory(tif) && check_small(tif, 2);
+	if (tif)
+		TIFFClose(tif);
+	vf_free(&f);
+	if (!ok)
+		fprintf (stderr, "Wrong small file in mode wA.\n");
+	return ok;
+}
+
+int
+main()
+{
+	unsigned char* zeros = (unsigned char*)
+	    calloc(1, (size_t) BIGWIDTH * BIGROWS);
+	int ret = 1;
+
+	if (!zeros)
+		return 1;
+	if (test_small() && test_classic(zeros) &&
+	    test_promote("wAl", zeros) && test_promote("wAb", zeros))
+		ret = 0;
+	free(zeros);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFReadRawChunks() and TIFFGetMappedRawStrip() return
+ * the same data as TIFFReadRawStrip(), whatever the request order
+ * and merge gap.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "raw_chunks.tif";
+
+#define	WIDTH		64
+#define	LENGTH		100
+#define	ROWSPERSTRIP	4
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	int j;
+
+	(void) arg;
+	/* Strips of varying compressed size */
+	for (j = 0; j < (int) c->size; j++)
+		c->buf[j] = (unsigned char)((j % (int)(c->index + 2)) * 37 + c->index);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, 0, PHOTOMETRIC_MINISBLACK,
+	    COMPRESSION_PACKBITS, ROWSPERSTRIP, 0, 0 };
+
+	return write_test_image(filename, &im, fill_strip, NULL);
+}
+
+static int
+check_chunks(const char* mode, tmsize_t maxgap)
+{
+	TIFF* tif;
+	uint32 n, i;
+	uint32* list = NULL;
+	void** bufs = NULL;
+	tmsize_t* sizes = NULL;
+	unsigned char ref[2 * WIDTH * ROWSPERSTRIP];
+	int ret = 0;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	n = TIFFNumberOfStrips(tif);
+	list = (uint32*) calloc(n + 1, sizeof(uint32));
+	bufs = (void**) calloc(n + 1, sizeof(void*));
+	sizes = (tmsize_t*) calloc(n + 1, sizeof(tmsize_t));
+	if (!list || !bufs || !sizes)
+		goto failure;
+	/* Interleaved order, a skipped strip and one duplicate */
+	for (i = 0; i < n; i++) {
+		list[i] = (i * 7) % n;
+		if (list[i] == 3)
+			list[i] = 5;
+		sizes[i] = (tmsize_t)(-1);
+		bufs[i] = malloc(sizeof(ref));
+		if (!bufs[i])
+			goto failure;
+	}
+	list[n] = 1;
+	sizes[n] = 10;		/* truncated request */
+	bufs[n] = malloc(sizeof(ref));
+	if (!bufs[n])
+		goto failure;
+
+	if (!TIFFReadRawChunks(tif, list, n + 1, bufs, sizes, maxgap)) {
+		fprintf (stderr, "TIFFReadRawChunks() failed (mode %s).\n", mode);
+		goto failure;
+	}
+	for (i = 0; i <= n; i++) {
+		tmsize_t got = TIFFReadRawStrip(tif, list[i], ref,
+						i == n ? 10 : (tmsize_t) sizeof(ref));
+		if (got == -1 || got != sizes[i] ||
+		    memcmp(ref, bufs[i], got) != 0) {
+			fprintf (stderr, "Mode %s, gap %ld: strip %lu differs.\n",
+				 mode, (long) maxgap, (unsigned long) list[i]);
+			goto failure;
+		}
+	}
+
+	/* Borrowed pointers are only available for mapped files */
+	for (i = 0; i < n; i++) {
+		const void* ptr = NULL;
+		tmsize_t size = 0;
+		tmsize_t got;
+
+		if (!TIFFGetMappedRawStrip(tif, i, &ptr, &size)) {
+			if (strchr(mode, 'm') == NULL) {
+				fprintf (stderr, "TIFFGetMappedRawStrip() failed.\n");
+				goto failure;
+			}
+			continue;
+		}
+		if (strchr(mode, 'm') != NULL) {
+			fprintf (stderr, "TIFFGetMappedRawStrip() succeeded on unmapped file.\n");
+			goto failure;
+		}
+		got = TIFFReadRawStrip(tif, i, ref, sizeof(ref));
+		if (got != size || memcmp(ref, ptr, size) != 0) {
+			fprintf (stderr, "Mapped strip %lu differs.\n",
+				 (unsigned long) i);
+			goto failure;
+		}
+	}
+
+	/* Out of range strip must be refused */
+	list[0] = n;
+	if (TIFFReadRawChunks(tif, list, 1, bufs, sizes, maxgap)) {
+		fprintf (stderr, "Out of range strip was accepted.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	if (bufs) {
+		for (i = 0; i <= n; i++)
+			free(bufs[i]);
+		free(bufs);
+	}
+	free(list);
+	free(sizes);
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image())
+		return 1;
+	if (!check_chunks("r", -1) || !check_chunks("rm", -1) ||
+	    !check_chunks("rm", 0) || !check_chunks("rm", 1 << 20))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
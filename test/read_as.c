@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check TIFFReadEncodedTileAs() and TIFFReadEncodedStripAs() against a
+ * plain conversion of the decoded samples, for each sample type the
+ * library converts, with the optimized code and the portable code.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "read_as.tif";
+
+#define	WIDTH		37
+#define	LENGTH		29
+#define	TILESIZE	16
+#define	ROWSPERSTRIP	5
+#define	NSAMPLES	(TILESIZE * TILESIZE)
+
+static double
+sample(uint32 i, uint16 bps, uint16 format)
+{
+	double v = (double) ((i * 2654435761U) >> 7);
+
+	if (format == SAMPLEFORMAT_IEEEFP)
+		return (float) (v / 1000.0 - 40.0);
+	v = fmod(v, ldexp(1.0, bps));
+	if (format == SAMPLEFORMAT_INT)
+		v -= ldexp(1.0, bps - 1);
+	return (v);
+}
+
+static void
+store(unsigned char* buf, uint32 i, uint16 bps, uint16 format, double v)
+{
+	switch (bps) {
+	case 8:
+		if (format == SAMPLEFORMAT_INT)
+			((int8*) buf)[i] = (int8) v;
+		else
+			buf[i] = (uint8) v;
+		break;
+	case 16:
+		if (format == SAMPLEFORMAT_INT)
+			((int16*) buf)[i] = (int16) v;
+		else
+			((uint16*) buf)[i] = (uint16) v;
+		break;
+	case 32:
+		if (format == SAMPLEFORMAT_IEEEFP)
+			((float*) buf)[i] = (float) v;
+		else if (format == SAMPLEFORMAT_INT)
+			((int32*) buf)[i] = (int32) v;
+		else
+			((uint32*) buf)[i] = (uint32) v;
+		break;
+	}
+}
+
+typedef struct {
+	uint16	bps;
+	uint16	format;
+	uint32	n;		/* samples per chunk */
+} SampleLayout;
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	const SampleLayout* l = (const SampleLayout*) arg;
+	uint32 i, n = (uint32) (c->size * 8 / l->bps);
+
+	for (i = 0; i < n; i++)
+		store(c->buf, i, l->bps, l->format,
+		    sample(c->index * l->n + i, l->bps, l->format));
+}
+
+static int
+write_image(uint16 bps, uint16 format, int tiled)
+{
+	TestImage im = { WIDTH, LENGTH, 0, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+	SampleLayout l;
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.bitspersample = l.bps = bps;
+	l.format = format;
+	l.n = WIDTH * ROWSPERSTRIP;
+	if (tiled) {
+		im.tilewidth = im.tilelength = TILESIZE;
+		l.n = NSAMPLES;
+	}
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, format);
+	ok = write_image_data(tif, fill_chunk, &l);
+	TIFFClose(tif);
+	return ok;
+}
+
+static double
+expected(double v, TIFFDataType type, double scale, double offset)
+{
+	double lo = 0, hi = 0;
+
+	if (type == TIFF_FLOAT)
+		return ((float) v * (float) scale + (float) offset);
+	v = v * scale + offset;
+	switch (type) {
+	case TIFF_BYTE: lo = 0; hi = 255; break;
+	case TIFF_SHORT: lo = 0; hi = 65535; break;
+	default: lo = -32768; hi = 32767; break;
+	}
+	v = v < 0 ? -floor(-v + 0.5) : floor(v + 0.5);
+	return (v < lo ? lo : v > hi ? hi : v);
+}
+
+static double
+fetch(const unsigned char* buf, uint32 i, TIFFDataType type)
+{
+	switch (type) {
+	case TIFF_BYTE: return (buf[i]);
+	case TIFF_SHORT: return (((const uint16*) buf)[i]);
+	case TIFF_SSHORT: return (((const int16*) buf)[i]);
+	default: return (((const float*) buf)[i]);
+	}
+}
+
+static int
+check_image(uint16 bps, uint16 format, int tiled)
+{
+	static const TIFFDataType types[] = { TIFF_BYTE, TIFF_SHORT,
+					      TIFF_SSHORT, TIFF_FLOAT };
+	static const int sizes[] = { 1, 2, 2, 4 };
+	static const double scales[][2] = { { 1.0, 0.0 }, { 0.25, -3.0 },
+					    { 3.0, 100.0 } };
+	unsigned char buf[NSAMPLES * 4 + 1];
+	TIFF* tif;
+	uint32 c, i, nchunks, n;
+	int t, k;
+	tmsize_t got;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open test TIFF file %s.\n", filename);
+		return 0;
+	}
+	n = tiled ? NSAMPLES : WIDTH * ROWSPERSTRIP;
+	nchunks = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	for (t = 0; t < 4; t++)
+	for (k = 0; k < 3; k++)
+	for (c = 0; c < nchunks; c++) {
+		uint32 count = n;
+		tmsize_t size = (tmsize_t) -1;
+
+		/* the last strip is short; a small buffer limits the read */
+		if (!tiled && c == nchunks - 1)
+			count = WIDTH * (LENGTH - c * ROWSPERSTRIP);
+		if (c == 1) {
+			count = 50;
+			size = count * sizes[t] + sizes[t] - 1;
+		}
+		buf[count * sizes[t]] = 0xa5;
+		got = tiled ?
+		    TIFFReadEncodedTileAs(tif, c, buf, size, types[t],
+		    scales[k][0], scales[k][1]) :
+		    TIFFReadEncodedStripAs(tif, c, buf, size, types[t],
+		    scales[k][0], scales[k][1]);
+		if (got != (tmsize_t) (count * sizes[t])) {
+			fprintf (stderr, "%d-bit format %d chunk %lu as type %d: "
+			    "read %ld bytes instead of %ld.\n", bps, format,
+			    (unsigned long) c, (int) types[t], (long) got,
+			    (long) (count * sizes[t]));
+			TIFFClose(tif);
+			return 0;
+		}
+		if (buf[count * sizes[t]] != 0xa5) {
+			fprintf (stderr, "%d-bit format %d chunk %lu as type %d: "
+			    "converted past the buffer.\n", bps, format,
+			    (unsigned long) c, (int) types[t]);
+			TIFFClose(tif);
+			return 0;
+		}
+		for (i = 0; i < count; i++) {
+			double want = expected(sample(c * n + i, bps, format),
+			    types[t], scales[k][0], scales[k][1]);
+			double v = fetch(buf, i, types[t]);
+
+			if (fabs(v - want) > fabs(want) * 1e-6) {
+				fprintf (stderr, "%d-bit format %d chunk %lu as "
+				    "type %d, scale %g offset %g: sample %lu "
+				    "is %g instead of %g.\n", bps, format,
+				    (unsigned long) c, (int) types[t],
+				    scales[k][0], scales[k][1],
+				    (unsigned long) i, v, want);
+				TIFFClose(tif);
+				return 0;
+			}
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+int
+main()
+{
+	static const uint16 formats[][2] = {
+		{ 8, SAMPLEFORMAT_UINT }, { 8, SAMPLEFORMAT_INT },
+		{ 16, SAMPLEFORMAT_UINT }, { 16, SAMPLEFORMAT_INT },
+		{ 32, SAMPLEFORMAT_UINT }, { 32, SAMPLEFORMAT_INT },
+		{ 32, SAMPLEFORMAT_IEEEFP }
+	};
+	int pass, f, tiled;
+
+	for (pass = 0; pass < 2; pass++) {
+		if (pass == 1)
+			TIFFSetCPUFeatures(0);
+		for (f = 0; f < 7; f++)
+			for (tiled = 0; tiled < 2; tiled++) {
+				if (!write_image(formats[f][0], formats[f][1],
+				    tiled) ||
+				    !check_image(formats[f][0], formats[f][1],
+				    tiled))
+					goto failure;
+			}
+	}
+	TIFFSetCPUFeatures(TIFF_CPU_ALL);
+	unlink(filename);
+	return 0;
+
+failure:
+	unlink(filename);
+	return 1;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
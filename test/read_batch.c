@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check TIFFReadRawChunks() through the batched read method of
+ * TIFFOpen() and of TIFFOpenOptionsSetReadBatchProc().
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "read_batch.tif";
+
+#define	WIDTH		64
+#define	LENGTH		300
+
+static unsigned char ref[WIDTH * LENGTH];
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	(void) arg;
+	memcpy(c->buf, ref + c->index * WIDTH, c->size);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, 1, 0, 0 };
+	int i;
+
+	for (i = 0; i < WIDTH * LENGTH; i++)
+		ref[i] = (unsigned char)((i / 3 + (i % 11) * 17) & 0xff);
+	return write_test_image(filename, &im, fill_strip, NULL);
+}
+
+/*
+ * Read every step-th strip, in reverse order, and compare.  A step of
+ * 0 selects strips 5k, 5k+1 and 5k+3, which make both merged ranges
+ * and single strips.
+ */
+static int
+check_chunks(TIFF* tif, uint32 step, tmsize_t maxgap, int expect,
+	     const char* what)
+{
+	static unsigned char data[WIDTH * LENGTH];
+	uint32 list[LENGTH];
+	void* bufs[LENGTH];
+	tmsize_t sizes[LENGTH];
+	uint32 i, n = 0;
+	int ok;
+
+	for (i = 0; i < LENGTH; i++) {
+		if (step ? i % step != 0 : i % 5 == 2 || i % 5 == 4)
+			continue;
+		list[n] = LENGTH - 1 - i;
+		bufs[n] = data + n * WIDTH;
+		sizes[n] = -1;
+		n++;
+	}
+	memset(data, 0, sizeof (data));
+	ok = TIFFReadRawChunks(tif, list, n, bufs, sizes, maxgap);
+	if (ok != expect) {
+		fprintf (stderr, "%s: TIFFReadRawChunks() returned %d.\n",
+			 what, ok);
+		return 0;
+	}
+	if (!ok)
+		return 1;
+	for (i = 0; i < n; i++)
+		if (sizes[i] != WIDTH ||
+		    memcmp(bufs[i], ref + list[i] * WIDTH, WIDTH) != 0) {
+			fprintf (stderr, "%s: strip %lu differs.\n", what,
+				 (unsigned long) list[i]);
+			return 0;
+		}
+	return 1;
+}
+
+/* An in-memory file for TIFFClientOpenExt() */
+typedef struct {
+	unsigned char* data;
+	toff_t size;
+	toff_t off;
+	int batches;			/* calls of the batched read method */
+	uint32 maxbatch;		/* largest number of requests */
+	int fail;			/* fail the next batch */
+} MemFile;
+
+static tmsize_t
+memRead(thandle_t h, void* buf, tmsize_t size)
+{
+	MemFile* m = (MemFile*) h;
+
+	if (m->off >= m->size)
+		return 0;
+	if ((toff_t) size > m->size - m->off)
+		size = (tmsize_t)(m->size - m->off);
+	memcpy(buf, m->data + m->off, size);
+	m->off += size;
+	return size;
+}
+
+static int
+memReadBatch(thandle_t h, TIFFIORequest* reqs, uint32 n)
+{
+	MemFile* m = (MemFile*) h;
+	uint32 i;
+
+	m->batches++;
+	if (n > m->maxbatch)
+		m->maxbatch = n;
+	for (i = 0; i < n; i++) {
+		tmsize_t size = reqs[i].size;
+
+		if (reqs[i].offset >= m->size) {
+			reqs[i].result = 0;
+			continue;
+		}
+		if ((toff_t) size > m->size - reqs[i].offset)
+			size = (tmsize_t)(m->size - reqs[i].offset);
+		memcpy(reqs[i].buf, m->data + reqs[i].offset, size);
+		reqs[i].result = size;
+	}
+	if (m->fail) {
+		m->fail = 0;
+		reqs[n / 2].result = -1;
+	}
+	return 1;
+}
+
+static tmsize_t
+memWrite(thandle_t h, void* buf, tmsize_t size)
+{
+	(void) h; (void) buf; (void) size;
+	return -1;
+}
+
+static toff_t
+memSeek(thandle_t h, toff_t off, int whence)
+{
+	MemFile* m = (MemFile*) h;
+
+	if (whence == SEEK_CUR)
+		off += m->off;
+	else if (whence == SEEK_END)
+		off += m->size;
+	m->off = off;
+	return off;
+}
+
+static int
+memClose(thandle_t h)
+{
+	(void) h;
+	return 0;
+}
+
+static toff_t
+memSize(thandle_t h)
+{
+	return ((MemFile*) h)->size;
+}
+
+static int
+check_client_batch(void)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	FILE* f = fopen(filename, "rb");
+	MemFile m;
+	TIFF* tif = NULL;
+	long size;
+	int ret = 0;
+
+	m.data = NULL;
+	if (!opts || !f || fseek(f, 0, SEEK_END) != 0 ||
+	    (size = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET) != 0 ||
+	    (m.data = (unsigned char*) malloc(size)) == NULL ||
+	    fread(m.data, 1, size, f) != (size_t) size) {
+		fprintf (stderr, "Can't load %s.\n", filename);
+		goto done;
+	}
+	m.size = (toff_t) size;
+	m.off = 0;
+	m.batches = 0;
+	m.maxbatch = 0;
+	m.fail = 0;
+	TIFFOpenOptionsSetReadBatchProc(opts, memReadBatch);
+	/* no mapping, so that the raw data is read */
+	tif = TIFFClientOpenExt(filename, "rm", (thandle_t) &m, memRead,
+				memWrite, memSeek, memClose, memSize, NULL,
+				NULL, opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s from memory.\n", filename);
+		goto done;
+	}
+	/* contiguous strips make one merged range */
+	if (!check_chunks(tif, 1, -1, 1, "client, merged"))
+		goto done;
+	if (m.batches != 1 || m.maxbatch != 1) {
+		fprintf (stderr, "Merged strips took %d batches of up to %lu "
+			 "requests.\n", m.batches, (unsigned long) m.maxbatch);
+		goto done;
+	}
+	/* every other strip without merging: 150 ranges in 3 batches */
+	m.batches = 0;
+	m.maxbatch = 0;
+	if (!check_chunks(tif, 2, 0, 1, "client, separate"))
+		goto done;
+	if (m.batches != 3 || m.maxbatch != 64) {
+		fprintf (stderr, "Separate strips took %d batches of up to %lu "
+			 "requests.\n", m.batches, (unsigned long) m.maxbatch);
+		goto done;
+	}
+	/* both kinds of ranges in one batch */
+	if (!check_chunks(tif, 0, 0, 1, "client, mixed"))
+		goto done;
+	m.fail = 1;
+	if (!check_chunks(tif, 2, 0, 0, "client, failing"))
+		goto done;
+	ret = 1;
+done:
+	if (tif)
+		TIFFClose(tif);
+	if (f)
+		fclose(f);
+	if (opts)
+		TIFFOpenOptionsFree(opts);
+	free(m.data);
+	return ret;
+}
+
+static int
+check_file(TIFFOpenOptions* opts, const char* what)
+{
+	TIFF* tif = TIFFOpenExt(filename, "rm", opts);
+	int ret;
+
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	ret = check_chunks(tif, 1, -1, 1, what) &&
+	    check_chunks(tif, 2, 0, 1, what) &&
+	    check_chunks(tif, 0, 0, 1, what);
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	TIFFOpenOptions* opts;
+
+	if (!write_image())
+		return 1;
+	if (!check_client_batch() || !check_file(NULL, "TIFFOpen handle"))
+		return 1;
+	opts = TIFFOpenOptionsAlloc();
+	if (!opts)
+		return 1;
+	TIFFOpenOptionsSetPositionalIO(opts, 1);
+	if (!check_file(opts, "positional handle"))
+		return 1;
+	TIFFOpenOptionsFree(opts);
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFReadRegion() returns the right pixels for strip and tile
+ * organized images, with and without a codec that can skip rows.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "region_read.tif";
+
+#define	WIDTH		100
+#define	LENGTH		90
+#define	SPP		3
+#define	TILESIZE	16
+#define	ROWSPERSTRIP	7
+
+static unsigned char
+pixel(uint32 x, uint32 y, uint32 s)
+{
+	return (unsigned char)((x * 3 + y * 5 + s * 71) & 0xff);
+}
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	unsigned char* p = c->buf;
+	uint32 x, y;
+	uint16 k;
+
+	(void) arg;
+	for (y = c->y; y < c->y + c->length; y++)
+		for (x = c->x; x < c->x + c->width; x++)
+			for (k = 0; k < c->samples; k++)
+				*p++ = pixel(x, y, c->plane + k);
+}
+
+static int
+write_image(uint16 compression, uint16 planar, int tiled)
+{
+	TestImage im = { WIDTH, LENGTH, 8, SPP, 0, PHOTOMETRIC_RGB,
+	    0, ROWSPERSTRIP, 0, 0 };
+
+	im.planarconfig = planar;
+	im.compression = compression;
+	if (tiled)
+		im.tilewidth = im.tilelength = TILESIZE;
+	return write_test_image(filename, &im, fill_chunk, NULL);
+}
+
+static int
+check_region(TIFF* tif, uint16 planar, uint32 x0, uint32 y0,
+	     uint32 w, uint32 h, uint16 sample, tmsize_t stride)
+{
+	uint32 spp = planar == PLANARCONFIG_SEPARATE ? 1 : SPP;
+	unsigned char* buf;
+	uint32 x, y, k;
+	int ok = 1;
+
+	if (stride == 0)
+		stride = w * spp;
+	buf = (unsigned char*) malloc(stride * h);
+	if (!buf)
+		return 0;
+	if (!TIFFReadRegion(tif, x0, y0, w, h, sample, buf, stride)) {
+		fprintf (stderr, "TIFFReadRegion(%lu,%lu,%lu,%lu) failed.\n",
+			 (unsigned long) x0, (unsigned long) y0,
+			 (unsigned long) w, (unsigned long) h);
+		free(buf);
+		return 0;
+	}
+	for (y = 0; y < h && ok; y++)
+	for (x = 0; x < w && ok; x++)
+	for (k = 0; k < spp && ok; k++) {
+		unsigned char expected =
+		    pixel(x0 + x, y0 + y, spp == 1 ? sample : k);
+		if (buf[y * stride + x * spp + k] != expected) {
+			fprintf (stderr, "Wrong pixel at %lu,%lu in region "
+				 "(%lu,%lu,%lu,%lu).\n",
+				 (unsigned long) (x0 + x),
+				 (unsigned long) (y0 + y),
+				 (unsigned long) x0, (unsigned long) y0,
+				 (unsigned long) w, (unsigned long) h);
+			ok = 0;
+		}
+	}
+	free(buf);
+	return ok;
+}
+
+static int
+test_layout(uint16 compression, uint16 planar, int tiled)
+{
+	TIFF* tif;
+	uint16 s = planar == PLANARCONFIG_SEPARATE ? 2 : 0;
+	unsigned char dummy[SPP];
+	int ok;
+
+	if (!write_image(compression, planar, tiled))
+		return 0;
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	ok = check_region(tif, planar, 0, 0, WIDTH, LENGTH, s, 0) &&
+	    check_region(tif, planar, 17, 9, 40, 33, s, 0) &&
+	    check_region(tif, planar, 3, 12, 5, 2, s, 0) &&
+	    check_region(tif, planar, 0, 50, WIDTH, 11, s, 0) &&
+	    check_region(tif, planar, 99, 89, 1, 1, s, 0) &&
+	    check_region(tif, planar, 10, 20, 30, 11, s, 4 * WIDTH);
+	/* Read the same strip twice, starting inside it the second time */
+	ok = ok && check_region(tif, planar, 0, 14, WIDTH, 7, s, 0) &&
+	    check_region(tif, planar, 0, 16, WIDTH, 3, s, 0);
+	/* Out of range requests must fail */
+	if (ok && (TIFFReadRegion(tif, 90, 0, 11, 1, s, dummy, 0) ||
+		   TIFFReadRegion(tif, 0, 0, 0, 1, s, dummy, 0))) {
+		fprintf (stderr, "Invalid region was accepted.\n");
+		ok = 0;
+	}
+	TIFFClose(tif);
+	if (!ok)
+		fprintf (stderr, "Failed for compression %d, planar %d, %s.\n",
+			 compression, planar, tiled ? "tiles" : "strips");
+	return ok;
+}
+
+int
+main()
+{
+	uint16 compressions[] = { COMPRESSION_NONE, COMPRESSION_LZW };
+	int c, tiled;
+
+	for (c = 0; c < 2; c++)
+	for (tiled = 0; tiled < 2; tiled++) {
+		if (!test_layout(compressions[c], PLANARCONFIG_CONTIG, tiled) ||
+		    !test_layout(compressions[c], PLANARCONFIG_SEPARATE, tiled))
+			return 1;
+	}
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
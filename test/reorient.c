@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFReorientDirectory() writes the pixels of strip and
+ * tile images of whole-byte samples as each orientation shows them.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char infile[] = "reorient_in.tif";
+static const char outfile[] = "reorient_out.tif";
+
+struct image {
+	uint32 width, length;
+	uint16 bps, spp, planar, orientation;
+	uint32 tilesize;	/* tile width and length, 0 for strips */
+};
+
+static const struct image images[] = {
+	{ 157, 83, 8, 1, PLANARCONFIG_CONTIG, ORIENTATION_TOPLEFT, 0 },
+	{ 100, 70, 16, 3, PLANARCONFIG_CONTIG, ORIENTATION_TOPLEFT, 32 },
+	{ 61, 45, 8, 3, PLANARCONFIG_SEPARATE, ORIENTATION_RIGHTBOT, 0 },
+	{ 96, 64, 8, 1, PLANARCONFIG_CONTIG, ORIENTATION_LEFTBOT, 16 },
+	{ 80, 48, 16, 1, PLANARCONFIG_CONTIG, ORIENTATION_TOPLEFT, 0 },
+};
+#define NIMAGES (sizeof (images) / sizeof (images[0]))
+
+static uint16
+sample_value(uint32 col, uint32 row, uint16 s, uint16 bps)
+{
+	uint32 v = col * 7 + row * 131 + s * 57;
+
+	return (uint16)(bps == 8 ? v & 0xff : v & 0xffff);
+}
+
+/* The stored column and row that orientation shows at x, y */
+static void
+source_pixel(const struct image* im, uint16 orientation, uint32 x, uint32 y,
+	     uint32* col, uint32* row)
+{
+	uint32 w = im->width, h = im->length;
+
+	switch (orientation) {
+	case ORIENTATION_TOPLEFT:  *col = x;         *row = y;         break;
+	case ORIENTATION_TOPRIGHT: *col = w - 1 - x; *row = y;         break;
+	case ORIENTATION_BOTRIGHT: *col = w - 1 - x; *row = h - 1 - y; break;
+	case ORIENTATION_BOTLEFT:  *col = x;         *row = h - 1 - y; break;
+	case ORIENTATION_LEFTTOP:  *col = y;         *row = x;         break;
+	case ORIENTATION_RIGHTTOP: *col = y;         *row = h - 1 - x; break;
+	case ORIENTATION_RIGHTBOT: *col = w - 1 - y; *row = h - 1 - x; break;
+	default:                   *col = w - 1 - y; *row = x;         break;
+	}
+}
+
+static void
+fill_pixels(TestChunk* c, void* arg)
+{
+	const struct image* im = (const struct image*) arg;
+	uint8* buf = c->buf;
+	uint32 x, y;
+	int i;
+
+	for (y = 0; y < c->length; y++)
+		for (x = 0; x < c->width; x++)
+			for (i = 0; i < c->samples; i++) {
+				uint16 v = sample_value(c->x + x, c->y + y,
+				    (uint16)(c->plane + i), im->bps);
+
+				if (im->bps == 8)
+					*buf++ = (uint8) v;
+				else {
+					memcpy(buf, &v, 2);
+					buf += 2;
+				}
+			}
+}
+
+static int
+write_image(const struct image* im)
+{
+	TestImage ti = { 0, 0, 0, 0, 0, PHOTOMETRIC_MINISBLACK,
+	    COMPRESSION_LZW, 7, 0, 0 };
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(infile, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", infile);
+		return 0;
+	}
+	ti.width = im->width;
+	ti.length = im->length;
+	ti.bitspersample = im->bps;
+	ti.samplesperpixel = im->spp;
+	ti.planarconfig = im->planar;
+	if (im->spp == 3)
+		ti.photometric = PHOTOMETRIC_RGB;
+	/* Tiles are padded with more of the pattern */
+	ti.tilewidth = ti.tilelength = im->tilesize;
+	set_image_fields(tif, &ti);
+	TIFFSetField(tif, TIFFTAG_ORIENTATION, im->orientation);
+	TIFFSetField(tif, TIFFTAG_XRESOLUTION, 300.0);
+	TIFFSetField(tif, TIFFTAG_YRESOLUTION, 150.0);
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, "reorient");
+	ok = write_image_data(tif, fill_pixels, (void*) im);
+	TIFFClose(tif);
+	if (!ok)
+		fprintf (stderr, "Can't write %s.\n", infile);
+	return ok;
+}
+
+static int
+check_image(const struct image* im, int orientation)
+{
+	uint16 o = (uint16)(orientation ? orientation : im->orientation);
+	int transposed = o >= ORIENTATION_LEFTTOP;
+	uint32 w = transposed ? im->length : im->width;
+	uint32 h = transposed ? im->width : im->length;
+	uint16 nplanes = im->planar == PLANARCONFIG_SEPARATE ? im->spp : 1;
+	int nsamples = im->planar == PLANARCONFIG_SEPARATE ? 1 : im->spp;
+	uint32 width = 0, length = 0, x, y, col, row;
+	uint16 value = 0, s;
+	int i, ret = 0;
+	float xres = 0;
+	char* description = NULL;
+	uint8* buf = NULL;
+	uint8* p;
+	TIFF* in;
+	TIFF* out;
+
+	in = TIFFOpen(infile, "r");
+	out = TIFFOpen(outfile, "w");
+	if (!in || !out) {
+		fprintf (stderr, "Can't open test files.\n");
+		if (in)
+			TIFFClose(in);
+		if (out)
+			TIFFClose(out);
+		return 0;
+	}
+	if (!TIFFReorientDirectory(in, out, orientation)) {
+		fprintf (stderr, "Re-orientation %d failed.\n", orientation);
+		TIFFClose(in);
+		TIFFClose(out);
+		return 0;
+	}
+	TIFFClose(in);
+	TIFFClose(out);
+
+	out = TIFFOpen(outfile, "r");
+	if (!out) {
+		fprintf (stderr, "Can't open %s.\n", outfile);
+		return 0;
+	}
+	TIFFGetField(out, TIFFTAG_IMAGEWIDTH, &width);
+	TIFFGetField(out, TIFFTAG_IMAGELENGTH, &length);
+	TIFFGetFieldDefaulted(out, TIFFTAG_ORIENTATION, &value);
+	TIFFGetField(out, TIFFTAG_XRESOLUTION, &xres);
+	TIFFGetField(out, TIFFTAG_IMAGEDESCRIPTION, &description);
+	if (width != w || length != h || value != ORIENTATION_TOPLEFT ||
+	    xres != (transposed ? 150.0 : 300.0) || !description ||
+	    strcmp(description, "reorient") != 0 ||
+	    !TIFFIsTiled(out) != !im->tilesize) {
+		fprintf (stderr, "Orientation %d: wrong tags.\n", (int) o);
+		goto failure;
+	}
+	buf = (uint8*) malloc((size_t) w * h * nsamples * (im->bps / 8));
+	if (!buf)
+		goto failure;
+	for (s = 0; s < nplanes; s++) {
+		if (!TIFFReadRegion(out, 0, 0, w, h, s, buf, 0))
+			goto failure;
+		p = buf;
+		for (y = 0; y < h; y++)
+			for (x = 0; x < w; x++) {
+				source_pixel(im, o, x, y, &col, &row);
+				for (i = 0; i < nsamples; i++) {
+					uint16 expect = sample_value(col, row,
+					    (uint16)(s + i), im->bps);
+
+					if (im->bps == 8)
+						value = *p++;
+					else {
+						memcpy(&value, p, 2);
+						p += 2;
+					}
+					if (value != expect) {
+						fprintf (stderr,
+						    "Orientation %d: pixel %lu,%lu "
+						    "sample %d is %u, expected %u.\n",
+						    (int) o, (unsigned long) x,
+						    (unsigned long) y, s + i,
+						    value, expect);
+						goto failure;
+					}
+				}
+			}
+	}
+	ret = 1;
+
+failure:
+	free(buf);
+	TIFFClose(out);
+	return ret;
+}
+
+static int
+check_refused(void)
+{
+	static const uint8 row[2] = { 0xa5, 0x5a };
+	TIFF* in;
+	TIFF* out;
+	int ret;
+
+	in = TIFFOpen(infile, "w");
+	if (!in)
+		return 0;
+	TIFFSetField(in, TIFFTAG_IMAGEWIDTH, 16);
+	TIFFSetField(in, TIFFTAG_IMAGELENGTH, 1);
+	TIFFSetField(in, TIFFTAG_BITSPERSAMPLE, 1);
+	TIFFSetField(in, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(in, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISWHITE);
+	TIFFSetField(in, TIFFTAG_ROWSPERSTRIP, 1);
+	if (TIFFWriteEncodedStrip(in, 0, (void*) row, 2) == -1) {
+		TIFFClose(in);
+		return 0;
+	}
+	TIFFClose(in);
+
+	in = TIFFOpen(infile, "r");
+	out = TIFFOpen(outfile, "w");
+	if (!in || !out) {
+		if (in)
+			TIFFClose(in);
+		if (out)
+			TIFFClose(out);
+		return 0;
+	}
+	/* Sub-byte samples and unknown orientations are refused */
+	ret = !TIFFReorientDirectory(in, out, ORIENTATION_RIGHTTOP);
+	TIFFClose(in);
+	TIFFClose(out);
+	if (!ret)
+		fprintf (stderr, "1-bit image was accepted.\n");
+	return ret;
+}
+
+int
+main()
+{
+	size_t i;
+	int o;
+
+	for (i = 0; i < NIMAGES; i++) {
+		if (!write_image(&images[i]))
+			return 1;
+		for (o = 0; o <= ORIENTATION_LEFTBOT; o++)
+			if (!check_image(&images[i], o))
+				return 1;
+	}
+
+	/* The portable code gives the same result */
+	TIFFSetCPUFeatures(0);
+	if (!write_image(&images[NIMAGES - 2]))
+		return 1;
+	for (o = ORIENTATION_LEFTTOP; o <= ORIENTATION_LEFTBOT; o++)
+		if (!check_image(&images[NIMAGES - 2], o))
+			return 1;
+	TIFFSetCPUFeatures(TIFF_CPU_ALL);
+
+	if (!check_refused())
+		return 1;
+	unlink(infile);
+	unlink(outfile);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,19 @@
+#!/bin/sh
+#
+# Check that rgb2ycbcr converts the same on one or more threads, for
+# each subsampling
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${TIFFCP} -c lzw -r 5" "${IMG_RGB_3C_8B}" "o-rgb2ycbcr-threads-lzw.tiff"
+for opts in "-h 1 -v 1" "-h 2 -v 2" "-h 4 -v 2 -z" "-h 2 -v 4 -c zip"
+do
+  f_test_convert "${RGB2YCBCR} -j 1 -r 8 ${opts}" "o-rgb2ycbcr-threads-lzw.tiff" "o-rgb2ycbcr-threads-1.tiff"
+  f_test_convert "${RGB2YCBCR} -j 3 -r 8 ${opts}" "o-rgb2ycbcr-threads-lzw.tiff" "o-rgb2ycbcr-threads-3.tiff"
+  echo "cmp o-rgb2ycbcr-threads-1.tiff o-rgb2ycbcr-threads-3.tiff"
+  if ! cmp o-rgb2ycbcr-threads-1.tiff o-rgb2ycbcr-threads-3.tiff
+  then
+    echo "Image converted on threads (${opts}) differs"
+    exit 1
+  fi
+  f_tiffinfo_validate o-rgb2ycbcr-threads-3.tiff
+done
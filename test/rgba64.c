@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check TIFFReadRGBA64ImageOriented() on 8 and 16-bit images, against
+ * the samples for the directly converted cases and against
+ * TIFFReadRGBAImageOriented() for the others.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "rgba64.tif";
+
+#define	WIDTH		37
+#define	LENGTH		23
+
+static uint16
+sample(uint32 x, uint32 y, int s)
+{
+	return (uint16)(x * 1703 + y * 401 + s * 16411 + x * y * 7);
+}
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	uint16 bps = *(uint16*) arg;
+	uint32 x, y;
+	tmsize_t i;
+	int s;
+
+	/* Tiles are padded with zeros */
+	memset(c->buf, 0, c->size);
+	for (y = 0; y < c->length && c->y + y < LENGTH; y++) {
+		i = y * c->rowsize / (bps / 8);
+		for (x = 0; x < c->width && c->x + x < WIDTH; x++)
+			for (s = 0; s < c->samples; s++, i++) {
+				uint16 v = sample(c->x + x, c->y + y,
+				    c->plane + s);
+
+				if (bps == 16)
+					((uint16*) c->buf)[i] = v;
+				else
+					c->buf[i] = (unsigned char)(v >> 8);
+			}
+	}
+}
+
+static int
+write_image(uint16 bps, uint16 spp, uint16 photometric, uint16 extra,
+	    uint16 planar, int tiled)
+{
+	TestImage im = { WIDTH, LENGTH, 0, 0, 0, 0, COMPRESSION_LZW, 5, 0, 0 };
+	TIFF* tif = TIFFOpen(filename, "w");
+	int i, ok;
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.bitspersample = bps;
+	im.samplesperpixel = spp;
+	im.planarconfig = planar;
+	im.photometric = photometric;
+	if (tiled)
+		im.tilewidth = im.tilelength = 16;
+	set_image_fields(tif, &im);
+	if (extra != EXTRASAMPLE_UNSPECIFIED)
+		TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, 1, &extra);
+	if (photometric == PHOTOMETRIC_YCBCR)
+		TIFFSetField(tif, TIFFTAG_YCBCRSUBSAMPLING, 1, 1);
+	if (photometric == PHOTOMETRIC_PALETTE) {
+		uint16 cmap[3][256];
+
+		for (i = 0; i < 256; i++) {
+			cmap[0][i] = (uint16)(i * 257);
+			cmap[1][i] = (uint16)((255 - i) * 257);
+			cmap[2][i] = (uint16)(((i * 5) & 0xff) * 257);
+		}
+		TIFFSetField(tif, TIFFTAG_COLORMAP, cmap[0], cmap[1], cmap[2]);
+	}
+	ok = write_image_data(tif, fill_chunk, &bps);
+	TIFFClose(tif);
+	if (!ok)
+		fprintf (stderr, "Can't write %s.\n", filename);
+	return ok;
+}
+
+/*
+ * Expected 16-bit value of channel c of pixel x, y of an RGB or
+ * greyscale image.
+ */
+static uint64
+expected(uint16 bps, uint16 spp, uint16 photometric, uint16 extra,
+	 uint32 x, uint32 y)
+{
+	int grey = photometric != PHOTOMETRIC_RGB;
+	uint32 v[4], a = 0xffff;
+	int c;
+
+	for (c = 0; c < 3; c++) {
+		v[c] = sample(x, y, grey ? 0 : c);
+		if (bps == 8)
+			v[c] = (v[c] >> 8) * 257;
+		if (photometric == PHOTOMETRIC_MINISWHITE)
+			v[c] = 0xffff - v[c];
+	}
+	if (extra != EXTRASAMPLE_UNSPECIFIED && spp > (grey ? 1 : 3)) {
+		a = sample(x, y, grey ? 1 : 3);
+		if (bps == 8)
+			a = (a >> 8) * 257;
+		if (extra == EXTRASAMPLE_UNASSALPHA)
+			for (c = 0; c < 3; c++)
+				v[c] = (v[c] * a + 32767) / 65535;
+	}
+	return (uint64) v[0] | ((uint64) v[1] << 16) | ((uint64) v[2] << 32) |
+	    ((uint64) a << 48);
+}
+
+static int
+check_image(uint16 bps, uint16 spp, uint16 photometric, uint16 extra,
+	    uint16 planar, int tiled, int direct)
+{
+	uint64* got = (uint64*) malloc(WIDTH * LENGTH * sizeof (uint64));
+	uint64* flipped = (uint64*) malloc(WIDTH * LENGTH * sizeof (uint64));
+	uint32* ref = (uint32*) malloc(WIDTH * LENGTH * sizeof (uint32));
+	TIFF* tif = NULL;
+	uint32 x, y;
+	int ret = 0;
+
+	if (!got || !flipped || !ref) {
+		fprintf (stderr, "Out of memory.\n");
+		goto done;
+	}
+	if (!write_image(bps, spp, photometric, extra, planar, tiled))
+		goto done;
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		goto done;
+	}
+	if (!TIFFReadRGBA64ImageOriented(tif, WIDTH, LENGTH, got,
+					 ORIENTATION_TOPLEFT, 1) ||
+	    !TIFFReadRGBA64ImageOriented(tif, WIDTH, LENGTH, flipped,
+					 ORIENTATION_BOTRIGHT, 1) ||
+	    !TIFFReadRGBAImageOriented(tif, WIDTH, LENGTH, ref,
+				       ORIENTATION_TOPLEFT, 1)) {
+		fprintf (stderr, "Can't read %s.\n", filename);
+		goto done;
+	}
+	for (y = 0; y < LENGTH; y++)
+		for (x = 0; x < WIDTH; x++) {
+			uint64 v = got[y * WIDTH + x];
+			uint32 r = ref[y * WIDTH + x];
+			uint64 want = direct ?
+			    expected(bps, spp, photometric, extra, x, y) :
+			    (uint64) TIFFGetR(r) * 257 |
+			    ((uint64) TIFFGetG(r) * 257) << 16 |
+			    ((uint64) TIFFGetB(r) * 257) << 32 |
+			    ((uint64) TIFFGetA(r) * 257) << 48;
+
+			if (v != want) {
+				fprintf (stderr, "bps %d spp %d photometric %d "
+					 "extra %d planar %d tiled %d: pixel "
+					 "%lu,%lu is %04x %04x %04x %04x.\n",
+					 bps, spp, photometric, extra, planar,
+					 tiled, (unsigned long) x,
+					 (unsigned long) y, TIFFGetR64(v),
+					 TIFFGetG64(v), TIFFGetB64(v),
+					 TIFFGetA64(v));
+				goto done;
+			}
+			if (flipped[(LENGTH - 1 - y) * WIDTH + WIDTH - 1 - x]
+			    != v) {
+				fprintf (stderr, "bps %d spp %d photometric %d: "
+					 "flipped image differs.\n", bps, spp,
+					 photometric);
+				goto done;
+			}
+		}
+	ret = 1;
+done:
+	if (tif)
+		TIFFClose(tif);
+	free(got);
+	free(flipped);
+	free(ref);
+	return ret;
+}
+
+int
+main()
+{
+	static const int tiled[] = { 0, 1 };
+	int t;
+
+	for (t = 0; t < 2; t++) {
+		if (!check_image(16, 3, PHOTOMETRIC_RGB, EXTRASAMPLE_UNSPECIFIED,
+				 PLANARCONFIG_CONTIG, tiled[t], 1) ||
+		    !check_image(16, 4, PHOTOMETRIC_RGB, EXTRASAMPLE_UNASSALPHA,
+				 PLANARCONFIG_CONTIG, tiled[t], 1) ||
+		    !check_image(8, 4, PHOTOMETRIC_RGB, EXTRASAMPLE_ASSOCALPHA,
+				 PLANARCONFIG_CONTIG, tiled[t], 1) ||
+		    !check_image(16, 1, PHOTOMETRIC_MINISWHITE,
+				 EXTRASAMPLE_UNSPECIFIED, PLANARCONFIG_CONTIG,
+				 tiled[t], 1) ||
+		    !check_image(16, 2, PHOTOMETRIC_MINISBLACK,
+				 EXTRASAMPLE_ASSOCALPHA, PLANARCONFIG_CONTIG,
+				 tiled[t], 1) ||
+		    !check_image(8, 3, PHOTOMETRIC_RGB, EXTRASAMPLE_UNSPECIFIED,
+				 PLANARCONFIG_SEPARATE, tiled[t], 1) ||
+		    !check_image(16, 4, PHOTOMETRIC_RGB, EXTRASAMPLE_UNASSALPHA,
+				 PLANARCONFIG_SEPARATE, tiled[t], 1) ||
+		    /* Widened output of the 8-bit conversions */
+		    !check_image(8, 1, PHOTOMETRIC_PALETTE,
+				 EXTRASAMPLE_UNSPECIFIED, PLANARCONFIG_CONTIG,
+				 tiled[t], 0) ||
+		    !check_image(8, 3, PHOTOMETRIC_YCBCR,
+				 EXTRASAMPLE_UNSPECIFIED, PLANARCONFIG_CONTIG,
+				 tiled[t], 0) ||
+		    !check_image(8, 4, PHOTOMETRIC_SEPARATED,
+				 EXTRASAMPLE_UNSPECIFIED, PLANARCONFIG_CONTIG,
+				 tiled[t], 0))
+			return 1;
+	}
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that the bands returned by TIFFRGBAIteratorNext() make up the
+ * raster of TIFFReadRGBAImageOriented().
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "rgba_iterator.tif";
+
+#define	WIDTH		100
+#define	LENGTH		70
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	tmsize_t i;
+
+	(void) arg;
+	for (i = 0; i < c->size; i++)
+		c->buf[i] = (unsigned char) ((i * 7 + c->index * 31) & 0xff);
+}
+
+static int
+write_image(int tiled)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 3, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_RGB, COMPRESSION_LZW, 9, 0, 0 };
+
+	if (tiled) {
+		im.tilewidth = 32;
+		im.tilelength = 16;
+	}
+	return write_test_image(filename, &im, fill_chunk, NULL);
+}
+
+static int
+check_image(const char* what, int orientation)
+{
+	TIFF* tif;
+	TIFFRGBAIterator* it;
+	char emsg[1024];
+	uint32* ref = NULL;
+	uint32* band;
+	uint32 row, nrows, next = 0;
+	int got, ret = 0;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	ref = (uint32*) malloc(WIDTH * LENGTH * sizeof(uint32));
+	if (!ref)
+		goto failure;
+	if (!TIFFReadRGBAImageOriented(tif, WIDTH, LENGTH, ref,
+				       orientation, 1)) {
+		fprintf (stderr, "%s: can't read the image.\n", what);
+		goto failure;
+	}
+	it = TIFFRGBAIteratorBegin(tif, orientation, 1, emsg);
+	if (!it) {
+		fprintf (stderr, "%s: %s\n", what, emsg);
+		goto failure;
+	}
+	while ((got = TIFFRGBAIteratorNext(it, &band, &row, &nrows)) == 1) {
+		if (row != next || nrows == 0 || row + nrows > LENGTH ||
+		    memcmp(band, ref + row * WIDTH,
+			   nrows * WIDTH * sizeof(uint32)) != 0) {
+			fprintf (stderr, "%s: band at row %lu is wrong.\n",
+				 what, (unsigned long) row);
+			TIFFRGBAIteratorEnd(it);
+			goto failure;
+		}
+		next += nrows;
+	}
+	TIFFRGBAIteratorEnd(it);
+	if (got != 0 || next != LENGTH) {
+		fprintf (stderr, "%s: iteration stopped at row %lu.\n",
+			 what, (unsigned long) next);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	free(ref);
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image(0) ||
+	    !check_image("stripped, top left", ORIENTATION_TOPLEFT) ||
+	    !check_image("stripped, bottom left", ORIENTATION_BOTLEFT))
+		return 1;
+	if (!write_image(1) ||
+	    !check_image("tiled, top left", ORIENTATION_TOPLEFT) ||
+	    !check_image("tiled, bottom right", ORIENTATION_BOTRIGHT))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFReadRGBAImageScaled() returns box averages of the
+ * raster produced by TIFFReadRGBAImage(), for stripped and tiled
+ * images in different orientations, and close ones for JPEG data
+ * reduced by the codec.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "rgba_scaled.tif";
+
+#define	WIDTH		200
+#define	LENGTH		150
+
+static const uint32 sizes[][2] = {
+	{ 50, 30 }, { 64, 64 }, { 7, 149 }, { WIDTH, LENGTH }, { 333, 211 }
+};
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	tmsize_t spp = c->samples, i;
+
+	(void) arg;
+	/* Smooth gradients, so that JPEG keeps them well */
+	for (i = 0; i < c->size; i++) {
+		tmsize_t p = i / spp;
+
+		c->buf[i] = (unsigned char) ((p % 32 + p / 32 + c->index * 5 +
+		    (i % spp) * 60) & 0xff);
+	}
+	if (spp == 4)
+		for (i = 0; i < c->size; i += 4)
+			c->buf[i + 3] = 255;
+}
+
+static int
+write_image(int tiled, int spp, int orientation, uint16 compression,
+	    uint32 width, uint32 length)
+{
+	TestImage im = { 0, 0, 8, 0, PLANARCONFIG_CONTIG, PHOTOMETRIC_RGB,
+	    0, 16, 0, 0 };
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.width = width;
+	im.length = length;
+	im.samplesperpixel = (uint16) spp;
+	im.compression = compression;
+	if (compression == COMPRESSION_JPEG)
+		im.photometric = PHOTOMETRIC_YCBCR;
+	if (tiled)
+		im.tilewidth = im.tilelength = 32;
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_ORIENTATION, orientation);
+	if (compression == COMPRESSION_JPEG) {
+		TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+		TIFFSetField(tif, TIFFTAG_JPEGQUALITY, 90);
+	}
+	if (spp == 4) {
+		uint16 extra = EXTRASAMPLE_ASSOCALPHA;
+
+		TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, 1, &extra);
+	}
+	ok = write_image_data(tif, fill_chunk, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+static uint32
+box_start(uint32 o, uint32 in, uint32 out)
+{
+	return (uint32) ((uint64) o * in / out);
+}
+
+static uint32
+box_end(uint32 o, uint32 in, uint32 out)
+{
+	uint32 end = box_start(o + 1, in, out);
+
+	return end > box_start(o, in, out) ? end : box_start(o, in, out) + 1;
+}
+
+/*
+ * Compare the scaled raster with box averages of the full one, both
+ * with bottom left origin.  Returns the mean absolute difference.
+ */
+static double
+compare(const uint32* full, uint32 width, uint32 length,
+	const uint32* scaled, uint32 outw, uint32 outh)
+{
+	uint32 ox, oy, x, y;
+	int c;
+	double total = 0.0;
+
+	for (oy = 0; oy < outh; oy++)
+		for (ox = 0; ox < outw; ox++) {
+			uint32 x0 = box_start(ox, width, outw);
+			uint32 x1 = box_end(ox, width, outw);
+			uint32 y0 = box_start(oy, length, outh);
+			uint32 y1 = box_end(oy, length, outh);
+			uint32 n = (x1 - x0) * (y1 - y0);
+			uint32 v = scaled[(outh - 1 - oy) * outw + ox];
+
+			for (c = 0; c < 32; c += 8) {
+				uint32 sum = 0, avg;
+
+				for (y = y0; y < y1; y++)
+					for (x = x0; x < x1; x++)
+						sum += (full[(length - 1 - y) *
+						    width + x] >> c) & 0xff;
+				avg = (sum + n / 2) / n;
+				total += avg > ((v >> c) & 0xff) ?
+				    avg - ((v >> c) & 0xff) :
+				    ((v >> c) & 0xff) - avg;
+			}
+		}
+	return total / (outw * outh * 4);
+}
+
+static int
+check_image(const char* what, uint32 width, uint32 length, double tolerance)
+{
+	TIFF* tif;
+	uint32* full = NULL;
+	uint32* scaled = NULL;
+	size_t i;
+	int ret = 0;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	full = (uint32*) malloc(width * length * sizeof(uint32));
+	scaled = (uint32*) malloc(333 * 211 * sizeof(uint32));
+	if (!full || !scaled)
+		goto failure;
+	if (!TIFFReadRGBAImage(tif, width, length, full, 1)) {
+		fprintf (stderr, "%s: can't read the image.\n", what);
+		goto failure;
+	}
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		uint32 outw = sizes[i][0], outh = sizes[i][1];
+		double diff;
+
+		if (!TIFFReadRGBAImageScaled(tif, outw, outh, scaled, 1)) {
+			fprintf (stderr, "%s: scaling to %lux%lu failed.\n",
+				 what, (unsigned long) outw,
+				 (unsigned long) outh);
+			goto failure;
+		}
+		diff = compare(full, width, length, scaled, outw, outh);
+		if (diff > tolerance) {
+			fprintf (stderr,
+				 "%s: %lux%lu differs by %.2f on average.\n",
+				 what, (unsigned long) outw,
+				 (unsigned long) outh, diff);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	free(full);
+	free(scaled);
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image(0, 3, ORIENTATION_TOPLEFT, COMPRESSION_LZW,
+			 WIDTH, LENGTH) ||
+	    !check_image("stripped RGB", WIDTH, LENGTH, 0.0))
+		return 1;
+	if (!write_image(1, 4, ORIENTATION_BOTRIGHT, COMPRESSION_LZW,
+			 WIDTH, LENGTH) ||
+	    !check_image("tiled RGBA", WIDTH, LENGTH, 0.0))
+		return 1;
+	if (!write_image(0, 3, ORIENTATION_TOPRIGHT, COMPRESSION_NONE,
+			 WIDTH, LENGTH) ||
+	    !check_image("stripped RGB, top right", WIDTH, LENGTH, 0.0))
+		return 1;
+	/* Boxes over the reduced JPEG data only approximate those at full size */
+	if (TIFFIsCODECConfigured(COMPRESSION_JPEG) &&
+	    (!write_image(1, 3, ORIENTATION_TOPLEFT, COMPRESSION_JPEG,
+			  256, 256) ||
+	     !check_image("tiled JPEG", 256, 256, 6.0)))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * TIFFReadRGBAImage() benchmark: read synthetic images of each
+ * photometric interpretation, sample layout and extra sample kind that
+ * tif_getimage.c has a separate conversion routine for, and report the
+ * throughput of each as JSON.
+ *
+ *   rgbabench [-q] [-s size] [-t seconds] [-p path] [-o file]
+ *
+ * -s gives the width and height of the images (default 1024), -t the
+ * minimum time each measurement runs for (default 0.2), -p restricts
+ * the run to one path, and -o writes the report to a file instead of
+ * the standard output.  -q is a quick run on small images, used as a
+ * smoke test.  Images are uncompressed, except LogLuv ones, so that the
+ * times are those of the conversion to RGBA; they are held in memory
+ * and read in strips and in tiles.  Rates are in megapixels per second
+ * of processor time.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tiffio.h"
+#include "test_image.h"
+
+#define	ROWSPERSTRIP	16
+#define	TILESIZE	64
+
+typedef struct {
+	const char*	name;
+	uint16		photometric;
+	uint16		bitspersample;
+	uint16		samplesperpixel;
+	uint16		extrasample;	/* EXTRASAMPLE_xxx of the last sample */
+	uint16		planarconfig;
+	uint16		subsampling;	/* YCbCr, horizontal << 4 | vertical */
+} BenchPath;
+
+/* One image per put routine picked by PickContigCase/PickSeparateCase */
+static const BenchPath paths[] = {
+	{ "grey1", PHOTOMETRIC_MINISBLACK, 1, 1, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "grey2", PHOTOMETRIC_MINISBLACK, 2, 1, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "grey4", PHOTOMETRIC_MINISBLACK, 4, 1, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "grey8", PHOTOMETRIC_MINISBLACK, 8, 1, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "grey16", PHOTOMETRIC_MINISBLACK, 16, 1, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "miniswhite8", PHOTOMETRIC_MINISWHITE, 8, 1, 0,
+	  PLANARCONFIG_CONTIG, 0 },
+	{ "greyalpha8", PHOTOMETRIC_MINISBLACK, 8, 2, EXTRASAMPLE_ASSOCALPHA,
+	  PLANARCONFIG_CONTIG, 0 },
+	{ "palette1", PHOTOMETRIC_PALETTE, 1, 1, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "palette2", PHOTOMETRIC_PALETTE, 2, 1, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "palette4", PHOTOMETRIC_PALETTE, 4, 1, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "palette8", PHOTOMETRIC_PALETTE, 8, 1, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "rgb8", PHOTOMETRIC_RGB, 8, 3, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "rgba8", PHOTOMETRIC_RGB, 8, 4, EXTRASAMPLE_ASSOCALPHA,
+	  PLANARCONFIG_CONTIG, 0 },
+	{ "rgbua8", PHOTOMETRIC_RGB, 8, 4, EXTRASAMPLE_UNASSALPHA,
+	  PLANARCONFIG_CONTIG, 0 },
+	{ "rgb16", PHOTOMETRIC_RGB, 16, 3, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "rgba16", PHOTOMETRIC_RGB, 16, 4, EXTRASAMPLE_ASSOCALPHA,
+	  PLANARCONFIG_CONTIG, 0 },
+	{ "rgbua16", PHOTOMETRIC_RGB, 16, 4, EXTRASAMPLE_UNASSALPHA,
+	  PLANARCONFIG_CONTIG, 0 },
+	{ "rgb8-separate", PHOTOMETRIC_RGB, 8, 3, 0, PLANARCONFIG_SEPARATE, 0 },
+	{ "rgba8-separate", PHOTOMETRIC_RGB, 8, 4, EXTRASAMPLE_ASSOCALPHA,
+	  PLANARCONFIG_SEPARATE, 0 },
+	{ "rgbua8-separate", PHOTOMETRIC_RGB, 8, 4, EXTRASAMPLE_UNASSALPHA,
+	  PLANARCONFIG_SEPARATE, 0 },
+	{ "rgb16-separate", PHOTOMETRIC_RGB, 16, 3, 0,
+	  PLANARCONFIG_SEPARATE, 0 },
+	{ "rgba16-separate", PHOTOMETRIC_RGB, 16, 4, EXTRASAMPLE_ASSOCALPHA,
+	  PLANARCONFIG_SEPARATE, 0 },
+	{ "rgbua16-separate", PHOTOMETRIC_RGB, 16, 4, EXTRASAMPLE_UNASSALPHA,
+	  PLANARCONFIG_SEPARATE, 0 },
+	{ "ycbcr11", PHOTOMETRIC_YCBCR, 8, 3, 0, PLANARCONFIG_CONTIG, 0x11 },
+	{ "ycbcr21", PHOTOMETRIC_YCBCR, 8, 3, 0, PLANARCONFIG_CONTIG, 0x21 },
+	{ "ycbcr22", PHOTOMETRIC_YCBCR, 8, 3, 0, PLANARCONFIG_CONTIG, 0x22 },
+	{ "ycbcr41", PHOTOMETRIC_YCBCR, 8, 3, 0, PLANARCONFIG_CONTIG, 0x41 },
+	{ "ycbcr42", PHOTOMETRIC_YCBCR, 8, 3, 0, PLANARCONFIG_CONTIG, 0x42 },
+	{ "ycbcr44", PHOTOMETRIC_YCBCR, 8, 3, 0, PLANARCONFIG_CONTIG, 0x44 },
+	{ "ycbcr11-separate", PHOTOMETRIC_YCBCR, 8, 3, 0,
+	  PLANARCONFIG_SEPARATE, 0x11 },
+	{ "cielab8", PHOTOMETRIC_CIELAB, 8, 3, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "cmyk8", PHOTOMETRIC_SEPARATED, 8, 4, 0, PLANARCONFIG_CONTIG, 0 },
+	{ "cmyk8-separate", PHOTOMETRIC_SEPARATED, 8, 4, 0,
+	  PLANARCONFIG_SEPARATE, 0 },
+	{ "logluv", PHOTOMETRIC_LOGLUV, 32, 3, 0, PLANARCONFIG_CONTIG, 0 },
+};
+
+static const struct {
+	const char*	name;
+	uint32		tilesize;	/* 0 for strips */
+} layouts[] = {
+	{ "strip16", 0 },
+	{ "tile64", TILESIZE },
+};
+
+static uint32 width = 1024;
+static uint32 length = 1024;
+static double mintime = 0.2;
+
+#define	NITEMS(a)	(sizeof(a) / sizeof((a)[0]))
+
+static uint32
+noise(uint32* state)
+{
+	*state = *state * 1103515245U + 12345U;
+	return (*state >> 16) & 0x7fff;
+}
+
+/*
+ * Fill a strip or tile with noise; LogLuv images are written from
+ * floating point XYZ values.
+ */
+typedef struct {
+	const BenchPath*	path;
+	uint32			state;
+} NoiseSource;
+
+static void
+fill_chunk(TestChunk* c, void* arg)
+{
+	NoiseSource* src = (NoiseSource*) arg;
+	tmsize_t i;
+
+	if (src->path->photometric == PHOTOMETRIC_LOGLUV) {
+		for (i = 0; i + (tmsize_t) sizeof(float) <= c->size;
+		     i += sizeof(float)) {
+			float v = 0.05f + (float) noise(&src->state) / 40000.0f;
+
+			memcpy(c->buf + i, &v, sizeof(v));
+		}
+	} else {
+		for (i = 0; i < c->size; i++)
+			c->buf[i] = (unsigned char) noise(&src->state);
+	}
+}
+
+/*
+ * Write the image of a path in a layout to memory.
+ */
+static int
+write_image(const BenchPath* path, uint32 tilesize, void** pbuf,
+	    tmsize_t* psize)
+{
+	TestImage im = { 0, 0, 0, 0, 0, 0, 0, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif = TIFFOpenMemory(NULL, 0, "w");
+	uint16 colormap[3][256];
+	NoiseSource src;
+	uint32 i;
+
+	if (!tif)
+		return 0;
+	im.width = width;
+	im.length = length;
+	im.bitspersample = path->bitspersample;
+	im.samplesperpixel = path->samplesperpixel;
+	im.planarconfig = path->planarconfig;
+	im.photometric = path->photometric;
+	if (path->photometric == PHOTOMETRIC_LOGLUV)
+		im.compression = COMPRESSION_SGILOG;
+	im.tilewidth = im.tilelength = tilesize;
+	set_image_fields(tif, &im);
+	if (path->extrasample)
+		TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, 1, &path->extrasample);
+	switch (path->photometric) {
+	case PHOTOMETRIC_PALETTE:
+		for (i = 0; i < 256; i++) {
+			colormap[0][i] = (uint16) (i * 257);
+			colormap[1][i] = (uint16) ((255 - i) * 257);
+			colormap[2][i] = (uint16) ((i * 7 & 0xff) * 257);
+		}
+		TIFFSetField(tif, TIFFTAG_COLORMAP, colormap[0], colormap[1],
+		    colormap[2]);
+		break;
+	case PHOTOMETRIC_YCBCR:
+		TIFFSetField(tif, TIFFTAG_YCBCRSUBSAMPLING,
+		    path->subsampling >> 4, path->subsampling & 0xf);
+		break;
+	case PHOTOMETRIC_LOGLUV:
+		TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
+		TIFFSetField(tif, TIFFTAG_SGILOGDATAFMT, SGILOGDATAFMT_FLOAT);
+		break;
+	}
+	src.path = path;
+	src.state = 1;
+	if (!write_image_data(tif, fill_chunk, &src)) {
+		TIFFClose(tif);
+		return 0;
+	}
+	return TIFFCloseMemory(tif, pbuf, psize);
+}
+
+static void
+print_json_string(FILE* out, const char* s)
+{
+	putc('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(out, "\\%c", *s);
+		else if (*s == '\n')
+			fputs("\\n", out);
+		else if ((unsigned char) *s >= 0x20)
+			putc(*s, out);
+	}
+	putc('"', out);
+}
+
+/*
+ * Time TIFFReadRGBAImage() on the image of one path in one layout and
+ * print the result; returns 0 if the image could not be written or
+ * read.
+ */
+static int
+run_path(FILE* out, int* first, const BenchPath* path, int la,
+	 uint32* raster)
+{
+	char emsg[1024];
+	void* buf = NULL;
+	tmsize_t size = 0;
+	TIFF* tif = NULL;
+	int reads = 0;
+	clock_t start;
+	double seconds;
+
+	if (!write_image(path, layouts[la].tilesize, &buf, &size))
+		goto failure;
+	tif = TIFFOpenMemory(buf, size, "r");
+	if (!tif)
+		goto failure;
+	if (!TIFFRGBAImageOK(tif, emsg)) {
+		fprintf (stderr, "%s: %s.\n", path->name, emsg);
+		goto failure;
+	}
+	start = clock();
+	do {
+		if (!TIFFReadRGBAImage(tif, width, length, raster, 0))
+			goto failure;
+		reads++;
+		seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	} while (seconds < mintime);
+
+	fprintf(out, "%s    {\"path\": \"%s\", \"layout\": \"%s\", "
+	    "\"reads\": %d, \"mpixels_per_second\": %.2f}",
+	    *first ? "" : ",\n", path->name, layouts[la].name, reads,
+	    seconds > 0 ? (double) width * length * reads / seconds / 1e6 : 0);
+	*first = 0;
+	TIFFClose(tif);
+	_TIFFfree(buf);
+	return 1;
+
+failure:
+	fprintf (stderr, "%s, %s: %s failed.\n", path->name,
+		 layouts[la].name, tif ? "reading" : "writing");
+	if (tif)
+		TIFFClose(tif);
+	if (buf)
+		_TIFFfree(buf);
+	return 0;
+}
+
+static void
+usage(void)
+{
+	fprintf (stderr,
+		 "usage: rgbabench [-q] [-s size] [-t seconds] [-p path] "
+		 "[-o file]\n");
+	exit(1);
+}
+
+int
+main(int argc, char* argv[])
+{
+	const char* only = NULL;
+	const char* outname = NULL;
+	FILE* out = stdout;
+	uint32* raster;
+	int first = 1, ok = 1, i, la;
+	size_t p;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-q") == 0) {
+			width = length = 160;
+			mintime = 0;
+		} else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+			width = length = (uint32) atol(argv[++i]);
+			if (width == 0)
+				usage();
+		} else if (i + 1 < argc && strcmp(argv[i], "-t") == 0)
+			mintime = atof(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-p") == 0)
+			only = argv[++i];
+		else if (i + 1 < argc && strcmp(argv[i], "-o") == 0)
+			outname = argv[++i];
+		else
+			usage();
+	}
+	raster = (uint32*) malloc((size_t) width * length * sizeof(uint32));
+	if (!raster) {
+		fprintf (stderr, "Out of memory.\n");
+		return 1;
+	}
+	if (outname && (out = fopen(outname, "w")) == NULL) {
+		fprintf (stderr, "Can't create %s.\n", outname);
+		return 1;
+	}
+
+	fputs("{\n  \"version\": ", out);
+	print_json_string(out, TIFFGetVersion());
+	fprintf(out, ",\n  \"width\": %lu, \"height\": %lu, "
+	    "\"mintime\": %.3f,\n  \"results\": [\n",
+	    (unsigned long) width, (unsigned long) length, mintime);
+	for (p = 0; p < NITEMS(paths); p++) {
+		if ((only && strcmp(only, paths[p].name) != 0) ||
+		    (paths[p].photometric == PHOTOMETRIC_LOGLUV &&
+		     !TIFFIsCODECConfigured(COMPRESSION_SGILOG)))
+			continue;
+		for (la = 0; la < (int) NITEMS(layouts); la++) {
+			if (!run_path(out, &first, &paths[p], la, raster))
+				ok = 0;
+		}
+	}
+	fputs("\n  ]\n}\n", out);
+	if (outname)
+		fclose(out);
+	free(raster);
+	return ok ? 0 : 1;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
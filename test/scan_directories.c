@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the directory entries reported by TIFFScanDirectories().
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "scan_directories.tif";
+
+#define	NDIRS		3
+#define	LENGTH		16
+
+typedef struct {
+	int ndirs;
+	int stopafter;
+	uint64 diroffs[NDIRS];
+	uint32 widths[NDIRS];
+	int ok;
+} ScanState;
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	memset(c->buf, (int) *(uint32*) arg, c->size);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { 0, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, 4, 0, 0 };
+	TIFF* tif;
+	uint32 d;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	for (d = 0; d < NDIRS; d++) {
+		im.width = 16 * (d + 1);
+		set_image_fields(tif, &im);
+		TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION,
+			     "a description longer than four bytes");
+		if (!write_image_data(tif, fill_strip, &d)) {
+			TIFFClose(tif);
+			return 0;
+		}
+		if (!TIFFWriteDirectory(tif)) {
+			fprintf (stderr, "Can't write directory %lu.\n",
+				 (unsigned long) d);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+scan_proc(TIFF* tif, void* clientdata, uint16 dirnum, uint64 diroff,
+	  uint16 nentries, const TIFFScanEntry* entries, uint64 nextdiroff)
+{
+	ScanState* state = (ScanState*) clientdata;
+	uint16 i;
+
+	(void) nextdiroff;
+	if (dirnum != state->ndirs || dirnum >= NDIRS) {
+		state->ok = 0;
+		return 0;
+	}
+	state->diroffs[dirnum] = diroff;
+	for (i = 0; i < nentries; i++) {
+		const TIFFScanEntry* e = &entries[i];
+
+		if (e->tag == TIFFTAG_IMAGEWIDTH && e->isinline) {
+			if (e->type == TIFF_SHORT) {
+				uint16 v;
+				memcpy(&v, e->value, 2);
+				if (TIFFIsByteSwapped(tif))
+					TIFFSwabShort(&v);
+				state->widths[dirnum] = v;
+			} else if (e->type == TIFF_LONG) {
+				uint32 v;
+				memcpy(&v, e->value, 4);
+				if (TIFFIsByteSwapped(tif))
+					TIFFSwabLong(&v);
+				state->widths[dirnum] = v;
+			}
+		}
+		if (e->tag == TIFFTAG_IMAGEDESCRIPTION &&
+		    (e->isinline || e->offset == 0 || e->count < 5))
+			state->ok = 0;
+	}
+	state->ndirs++;
+	return state->ndirs != state->stopafter;
+}
+
+static int
+check_image(const char* mode)
+{
+	TIFF* tif;
+	ScanState state;
+	uint32 width = 0;
+	int d, ret = 0;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	memset(&state, 0, sizeof(state));
+	state.ok = 1;
+	if (!TIFFScanDirectories(tif, scan_proc, &state) || !state.ok ||
+	    state.ndirs != NDIRS) {
+		fprintf (stderr, "Mode %s: scan failed.\n", mode);
+		goto failure;
+	}
+	/* The current directory is left alone */
+	if (TIFFCurrentDirectory(tif) != 0 ||
+	    TIFFCurrentDirOffset(tif) != state.diroffs[0] ||
+	    !TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width) || width != 16) {
+		fprintf (stderr, "Mode %s: current directory changed.\n", mode);
+		goto failure;
+	}
+	for (d = 0; d < NDIRS; d++) {
+		if (!TIFFSetDirectory(tif, (uint16) d) ||
+		    TIFFCurrentDirOffset(tif) != state.diroffs[d] ||
+		    state.widths[d] != (uint32)(16 * (d + 1))) {
+			fprintf (stderr, "Mode %s: directory %d differs.\n",
+				 mode, d);
+			goto failure;
+		}
+	}
+	/* The callback can stop the scan */
+	memset(&state, 0, sizeof(state));
+	state.ok = 1;
+	state.stopafter = 2;
+	if (!TIFFScanDirectories(tif, scan_proc, &state) || state.ndirs != 2) {
+		fprintf (stderr, "Mode %s: scan was not stopped.\n", mode);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image())
+		return 1;
+	if (!check_image("r") || !check_image("rm"))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFSetScanlineCheckpoints() lets the scanlines of single
+ * strip LZW, Deflate and PackBits images be read in any order, with and
+ * without a predictor.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "scanline_checkpoints.tif";
+
+#define	WIDTH		211
+#define	LENGTH		397
+#define	INTERVAL	16
+
+static unsigned char
+pixel(uint32 x, uint32 y)
+{
+	return (unsigned char)((x * 5 + y * 3 + (x * y) / 7 + (y / 50) * x) & 0xff);
+}
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	uint32 x, y;
+
+	(void) arg;
+	for (y = 0; y < c->length; y++)
+		for (x = 0; x < c->width; x++)
+			c->buf[y * c->width + x] = pixel(x, c->y + y);
+}
+
+static int
+write_image(uint16 compression, uint16 predictor)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, 0, PHOTOMETRIC_MINISBLACK,
+	    0, LENGTH, 0, 0 };
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	im.compression = compression;
+	set_image_fields(tif, &im);
+	if (predictor != PREDICTOR_NONE)
+		TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor);
+	ok = write_image_data(tif, fill_strip, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+check_row(TIFF* tif, const char* what, uint32 y)
+{
+	unsigned char buf[WIDTH];
+	uint32 x;
+
+	if (TIFFReadScanline(tif, buf, y, 0) == -1) {
+		fprintf (stderr, "%s: can't read row %lu.\n", what,
+			 (unsigned long) y);
+		return 0;
+	}
+	for (x = 0; x < WIDTH; x++) {
+		if (buf[x] != pixel(x, y)) {
+			fprintf (stderr, "%s: wrong pixel at %lu,%lu.\n",
+				 what, (unsigned long) x, (unsigned long) y);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int
+check_image(const char* what, const char* mode)
+{
+	TIFF* tif;
+	uint32 y;
+	int ok = 0;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (!TIFFSetScanlineCheckpoints(tif, INTERVAL)) {
+		fprintf (stderr, "%s: TIFFSetScanlineCheckpoints() failed.\n",
+			 what);
+		goto done;
+	}
+	/* Jump forward first, taking checkpoints on the way */
+	if (!check_row(tif, what, LENGTH - 2))
+		goto done;
+	/* Then backwards, landing on and between checkpoints */
+	for (y = LENGTH; y-- > 0; )
+		if (!check_row(tif, what, y))
+			goto done;
+	/* Then in a scattered order */
+	for (y = 0; y < LENGTH; y++)
+		if (!check_row(tif, what, (y * 149) % LENGTH))
+			goto done;
+	/* Without checkpoints, rows can still be read from the start */
+	if (!TIFFSetScanlineCheckpoints(tif, 0) ||
+	    !check_row(tif, what, 0) || !check_row(tif, what, 1))
+		goto done;
+	ok = 1;
+done:
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+check_codec(uint16 compression, uint16 predictor, const char* what)
+{
+	if (!TIFFIsCODECConfigured(compression))
+		return 1;
+	if (!write_image(compression, predictor))
+		return 0;
+	return check_image(what, "r") && check_image(what, "rm");
+}
+
+int
+main()
+{
+	TIFF* tif;
+	int ret = 1;
+
+	if (!check_codec(COMPRESSION_LZW, PREDICTOR_NONE, "LZW") ||
+	    !check_codec(COMPRESSION_LZW, PREDICTOR_HORIZONTAL, "LZW predictor") ||
+	    !check_codec(COMPRESSION_ADOBE_DEFLATE, PREDICTOR_NONE, "Deflate") ||
+	    !check_codec(COMPRESSION_ADOBE_DEFLATE, PREDICTOR_HORIZONTAL,
+			 "Deflate predictor") ||
+	    !check_codec(COMPRESSION_PACKBITS, PREDICTOR_NONE, "PackBits"))
+		goto done;
+
+	/* Only read-only handles keep checkpoints */
+	tif = TIFFOpen(filename, "r+");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s for update.\n", filename);
+		goto done;
+	}
+	if (TIFFSetScanlineCheckpoints(tif, INTERVAL)) {
+		fprintf (stderr, "TIFFSetScanlineCheckpoints() accepted a "
+			 "handle open for update.\n");
+		TIFFClose(tif);
+		goto done;
+	}
+	TIFFClose(tif);
+	ret = 0;
+done:
+	unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that encoding and decoding tiles with the floating point
+ * predictor reuse the work buffers of the handle instead of allocating
+ * them for each tile.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "scratch_buffers.tif";
+
+#define	WIDTH		256
+#define	LENGTH		256
+#define	TILESIZE	32
+
+static unsigned long nallocs;
+
+static void*
+count_malloc(void* ctx, tmsize_t size)
+{
+	(void) ctx;
+	nallocs++;
+	return malloc((size_t) size);
+}
+
+static void*
+count_realloc(void* ctx, void* ptr, tmsize_t size)
+{
+	(void) ctx;
+	nallocs++;
+	return realloc(ptr, (size_t) size);
+}
+
+static void
+count_free(void* ctx, void* ptr)
+{
+	(void) ctx;
+	free(ptr);
+}
+
+static TIFF*
+open_counted(const char* mode)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFF* tif;
+
+	if (!opts)
+		return NULL;
+	TIFFOpenOptionsSetAllocator(opts, count_malloc, count_realloc,
+	    count_free, NULL);
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif)
+		fprintf (stderr, "Can't open %s.\n", filename);
+	return tif;
+}
+
+static void
+fill_tile(float* buf, uint32 tile)
+{
+	int i;
+
+	for (i = 0; i < TILESIZE * TILESIZE; i++)
+		buf[i] = 100.0f + (float) tile + (float) (i % TILESIZE) / 8.0f;
+}
+
+int
+main()
+{
+	float buf[TILESIZE * TILESIZE], ref[TILESIZE * TILESIZE];
+	unsigned long first;
+	uint32 ntiles, i;
+	TIFF* tif;
+
+	tif = open_counted("w");
+	if (!tif)
+		return 1;
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 32);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	ntiles = TIFFNumberOfTiles(tif);
+	first = 0;
+	for (i = 0; i < ntiles; i++) {
+		fill_tile(buf, i);
+		if (TIFFWriteEncodedTile(tif, i, buf, sizeof(buf)) == -1) {
+			fprintf (stderr, "Can't write tile %lu.\n",
+				 (unsigned long) i);
+			TIFFClose(tif);
+			return 1;
+		}
+		if (i == 0)
+			first = nallocs;
+	}
+	if (nallocs != first) {
+		fprintf (stderr, "Encoding %lu more tiles made %lu "
+			 "allocations.\n", (unsigned long) ntiles - 1,
+			 nallocs - first);
+		TIFFClose(tif);
+		return 1;
+	}
+	TIFFClose(tif);
+
+	tif = open_counted("r");
+	if (!tif)
+		return 1;
+	for (i = 0; i < ntiles; i++) {
+		if (TIFFReadEncodedTile(tif, i, buf, sizeof(buf)) !=
+		    (tmsize_t) sizeof(buf)) {
+			fprintf (stderr, "Can't read tile %lu.\n",
+				 (unsigned long) i);
+			TIFFClose(tif);
+			return 1;
+		}
+		fill_tile(ref, i);
+		if (memcmp(buf, ref, sizeof(buf)) != 0) {
+			fprintf (stderr, "Tile %lu differs.\n",
+				 (unsigned long) i);
+			TIFFClose(tif);
+			return 1;
+		}
+		if (i == 0)
+			first = nallocs;
+	}
+	TIFFClose(tif);
+	if (nallocs != first) {
+		fprintf (stderr, "Decoding %lu more tiles made %lu "
+			 "allocations.\n", (unsigned long) ntiles - 1,
+			 nallocs - first);
+		return 1;
+	}
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
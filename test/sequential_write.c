@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFOpenSequential() produces the same bytes as a regular
+ * file, in order, sending each page once its directory is written, with
+ * and without spilling to a temporary file, that TIFFFdOpen() uses
+ * it for pipes, and that writing to a pipe by name fails instead of
+ * blocking once its reader is gone.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32)
+# include <signal.h>
+# include <sys/stat.h>
+# include <sys/wait.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "sequential_write.tif";
+static const char fifoname[] = "sequential_write.fifo";
+
+#define	WIDTH		256
+#define	LENGTH		64
+#define	ROWSPERSTRIP	16
+#define	NPAGES		3
+
+typedef struct {
+	unsigned char*	data;
+	tmsize_t	len;
+	tmsize_t	alloc;
+	int		closed;
+} Sink;
+
+static tmsize_t
+sink_write(thandle_t h, void* buf, tmsize_t size)
+{
+	Sink* s = (Sink*) h;
+
+	if (s->closed)
+		return -1;
+	if (s->len + size > s->alloc) {
+		tmsize_t alloc = 2 * (s->len + size);
+		unsigned char* p = (unsigned char*) realloc(s->data, alloc);
+
+		if (!p)
+			return -1;
+		s->data = p;
+		s->alloc = alloc;
+	}
+	memcpy(s->data + s->len, buf, size);
+	s->len += size;
+	return size;
+}
+
+static int
+sink_close(thandle_t h)
+{
+	((Sink*) h)->closed = 1;
+	return 0;
+}
+
+static void
+setup_page(TIFF* tif, int page)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+	TIFFSetField(tif, TIFFTAG_PAGENUMBER, page, NPAGES);
+}
+
+static int
+write_strips(TIFF* tif, int page)
+{
+	unsigned char buf[WIDTH * ROWSPERSTRIP];
+	uint32 s, i;
+
+	for (s = 0; s < LENGTH / ROWSPERSTRIP; s++) {
+		for (i = 0; i < sizeof(buf); i++)
+			buf[i] = (unsigned char)((i * i + s * 13 + page * 31) >> 3);
+		if (TIFFWriteEncodedStrip(tif, s, buf, sizeof(buf)) == -1) {
+			fprintf (stderr, "Can't write strip %lu of page %d.\n",
+				 (unsigned long) s, page);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Write npages pages, recording in sent[] how much of the file the sink
+ * had received after each directory was written.  With reserve, all
+ * directories are written ahead of the data.
+ */
+static int
+write_pages(TIFF* tif, int npages, int reserve, Sink* sink, tmsize_t* sent)
+{
+	int page;
+
+	if (reserve) {
+		for (page = 0; page < npages; page++) {
+			setup_page(tif, page);
+			if (!TIFFReserveDirectory(tif))
+				goto failure;
+		}
+		for (page = 0; page < npages; page++) {
+			if (!TIFFSetDirectory(tif, (uint16) page) ||
+			    !write_strips(tif, page) || !TIFFFlush(tif))
+				goto failure;
+			if (sink && sink->len != 0) {
+				fprintf (stderr, "Data sent ahead of the "
+					 "reserved directories.\n");
+				goto failure;
+			}
+		}
+	} else {
+		for (page = 0; page < npages; page++) {
+			setup_page(tif, page);
+			if (!write_strips(tif, page) ||
+			    !TIFFWriteDirectory(tif))
+				goto failure;
+			if (sink)
+				sent[page] = sink->len;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	fprintf (stderr, "Can't write %s.\n", TIFFFileName(tif));
+	TIFFClose(tif);
+	return 0;
+}
+
+static unsigned char*
+read_file(const char* name, tmsize_t* len)
+{
+	unsigned char* data;
+	FILE* f = fopen(name, "rb");
+	long size;
+
+	if (!f)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = (unsigned char*) malloc(size > 0 ? size : 1);
+	if (data && fread(data, 1, size, f) != (size_t) size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	*len = size;
+	return data;
+}
+
+/*
+ * Write the pages to a regular file and to a sink, and compare.
+ */
+static int
+check_sequential(int npages, int reserve, tmsize_t limit)
+{
+	TIFFOpenOptions* opts;
+	unsigned char* ref = NULL;
+	tmsize_t reflen, sent[NPAGES];
+	Sink sink;
+	TIFF* tif;
+	int page, ret = 0;
+
+	memset(&sink, 0, sizeof(sink));
+	tif = TIFFOpen(filename, "w");
+	if (!tif || !write_pages(tif, npages, reserve, NULL, NULL))
+		return 0;
+	ref = read_file(filename, &reflen);
+	if (!ref)
+		return 0;
+
+	opts = TIFFOpenOptionsAlloc();
+	if (!opts)
+		goto failure;
+	TIFFOpenOptionsSetSpillLimit(opts, limit);
+	tif = TIFFOpenSequential("sink", "w", (thandle_t) &sink,
+				 sink_write, sink_close, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "TIFFOpenSequential() failed.\n");
+		goto failure;
+	}
+	if (!write_pages(tif, npages, reserve, &sink, sent))
+		goto failure;
+	if (!sink.closed) {
+		fprintf (stderr, "The close method was not called.\n");
+		goto failure;
+	}
+	if (sink.len != reflen || memcmp(sink.data, ref, reflen) != 0) {
+		fprintf (stderr, "Limit %ld: the output differs from the "
+			 "regular file.\n", (long) limit);
+		goto failure;
+	}
+	/* each page went out once its directory was written */
+	for (page = 0; !reserve && page < npages; page++)
+		if (sent[page] <= (page > 0 ? sent[page - 1] : 0) ||
+		    sent[page] >= reflen) {
+			fprintf (stderr, "Limit %ld: %ld bytes sent after "
+				 "page %d.\n", (long) limit,
+				 (long) sent[page], page);
+			goto failure;
+		}
+	ret = 1;
+
+failure:
+	free(ref);
+	free(sink.data);
+	return ret;
+}
+
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32)
+/*
+ * A single page fits into the buffer of a pipe, so it can be written
+ * and then read back in one thread.
+ */
+static int
+check_pipe(void)
+{
+	unsigned char* ref;
+	unsigned char* buf;
+	tmsize_t reflen, len = 0;
+	TIFF* tif;
+	int fds[2];
+	ssize_t n;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif || !write_pages(tif, 1, 0, NULL, NULL))
+		return 0;
+	ref = read_file(filename, &reflen);
+	if (!ref)
+		return 0;
+	buf = (unsigned char*) malloc(reflen + 1);
+	if (!buf || pipe(fds) != 0) {
+		free(buf);
+		free(ref);
+		return 0;
+	}
+	tif = TIFFFdOpen(fds[1], "pipe", "w");
+	if (!tif || !write_pages(tif, 1, 0, NULL, NULL)) {
+		fprintf (stderr, "Can't write to a pipe.\n");
+		close(fds[0]);
+		free(buf);
+		free(ref);
+		return 0;
+	}
+	while ((n = read(fds[0], buf + len, reflen + 1 - len)) > 0)
+		len += n;
+	close(fds[0]);
+	n = len == reflen && memcmp(buf, ref, reflen) == 0;
+	if (!n)
+		fprintf (stderr, "The pipe got %ld bytes instead of %ld.\n",
+			 (long) len, (long) reflen);
+	free(buf);
+	free(ref);
+	return (int) n;
+}
+
+/*
+ * A reader that stops after a few bytes must make the writer of a
+ * named pipe fail: TIFFOpen() must not keep a read end of its own.
+ */
+static int
+check_fifo_closed(void)
+{
+	static unsigned char buf[WIDTH * 1024];
+	TIFF* tif;
+	pid_t pid;
+	int page, ok = 0;
+
+	unlink(fifoname);
+	if (mkfifo(fifoname, 0600) != 0) {
+		fprintf (stderr, "Can't create %s.\n", fifoname);
+		return 0;
+	}
+	pid = fork();
+	if (pid == 0) {
+		char head[100];
+		int fd = open(fifoname, O_RDONLY);
+
+		if (fd >= 0) {
+			(void) read(fd, head, sizeof(head));
+			close(fd);
+		}
+		_exit(0);
+	}
+	if (pid < 0) {
+		unlink(fifoname);
+		return 0;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	alarm(60);			/* a blocked write ends the test */
+	tif = TIFFOpen(fifoname, "w");
+	if (tif) {
+		/* far more than the buffer of the pipe holds */
+		for (page = 0; page < 64 && !ok; page++) {
+			TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+			TIFFSetField(tif, TIFFTAG_IMAGELENGTH, 1024);
+			TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+			TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+			TIFFSetField(tif, TIFFTAG_PHOTOMETRIC,
+				     PHOTOMETRIC_MINISBLACK);
+			TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1024);
+			if (TIFFWriteEncodedStrip(tif, 0, buf,
+			    sizeof(buf)) == -1 || !TIFFWriteDirectory(tif))
+				ok = 1;
+		}
+		TIFFClose(tif);
+	} else
+		ok = 1;
+	alarm(0);
+	kill(pid, SIGKILL);
+	(void) waitpid(pid, NULL, 0);
+	unlink(fifoname);
+	if (!ok)
+		fprintf (stderr, "Writing to a closed pipe did not fail.\n");
+	return ok;
+}
+#endif
+
+int
+main()
+{
+	Sink sink;
+
+	if (!TIFFIsCODECConfigured(COMPRESSION_LZW))
+		return 0;
+	if (!check_sequential(NPAGES, 0, 0) ||
+	    !check_sequential(NPAGES, 0, 1000) ||
+	    !check_sequential(NPAGES, 0, -1) ||
+	    !check_sequential(2, 1, 0) ||
+	    !check_sequential(2, 1, 1000))
+		return 1;
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32)
+	if (!check_pipe() || !check_fifo_closed())
+		return 1;
+#endif
+	memset(&sink, 0, sizeof(sink));
+	if (TIFFOpenSequential("sink", "r", (thandle_t) &sink, sink_write,
+			       sink_close, NULL) != NULL) {
+		fprintf (stderr, "A sequential file was opened for reading.\n");
+		return 1;
+	}
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that a TIFF built in a shared memory file is read back through
+ * a mapping of the same pages, and that closing the writing handle
+ * seals the file against changes.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "tiffiop.h"
+#include "test_image.h"
+
+#define	WIDTH		512
+#define	LENGTH		384
+#define	ROWSPERSTRIP	64
+
+static unsigned char
+pixel(uint32 x, uint32 y)
+{
+	return (unsigned char) ((x * 3 + y * 7 + (x ^ y)) & 0xff);
+}
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	uint32 x, y;
+
+	(void) arg;
+	for (y = 0; y < c->length; y++)
+		for (x = 0; x < c->width; x++)
+			c->buf[y * c->width + x] = pixel(x, c->y + y);
+}
+
+static int
+write_image(int fd)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif = TIFFOpenSharedMemory(fd, "shared", "w");
+	int ok;
+
+	if (!tif) {
+		fprintf (stderr, "Can't create shared memory file.\n");
+		return 0;
+	}
+	set_image_fields(tif, &im);
+	ok = write_image_data(tif, fill_strip, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+read_image(int fd)
+{
+	TIFF* tif = TIFFOpenSharedMemory(fd, "shared", "r");
+	unsigned char buf[WIDTH];
+	uint32 x, y;
+	int ret = 0;
+
+	if (!tif) {
+		fprintf (stderr, "Can't open shared memory file.\n");
+		return 0;
+	}
+	if (!isMapped(tif)) {
+		fprintf (stderr, "Shared memory file not mapped.\n");
+		goto failure;
+	}
+	for (y = 0; y < LENGTH; y++) {
+		if (TIFFReadScanline(tif, buf, y, 0) == -1) {
+			fprintf (stderr, "Can't read row %lu.\n",
+				 (unsigned long) y);
+			goto failure;
+		}
+		for (x = 0; x < WIDTH; x++)
+			if (buf[x] != pixel(x, y)) {
+				fprintf (stderr, "Row %lu differs.\n",
+					 (unsigned long) y);
+				goto failure;
+			}
+	}
+	/* uncompressed strips are decoded straight out of the mapping */
+	if (tif->tif_rawdata < (uint8*) tif->tif_base ||
+	    tif->tif_rawdata >= (uint8*) tif->tif_base + tif->tif_size) {
+		fprintf (stderr, "Strip data copied out of the mapping.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+#ifdef HAVE_MEMFD_CREATE
+	int fd = TIFFCreateSharedMemory("shared_memory");
+	int ret = 1;
+
+	if (fd < 0)
+		return 1;
+	if (!write_image(fd) || !read_image(fd))
+		goto failure;
+	/* the writer's handle sealed the file */
+	if (ftruncate(fd, 0) == 0 || write(fd, "x", 1) == 1) {
+		fprintf (stderr, "Shared memory file not sealed.\n");
+		goto failure;
+	}
+	if (TIFFOpenSharedMemory(fd, "shared", "w") != NULL) {
+		fprintf (stderr, "Sealed file opened for writing.\n");
+		goto failure;
+	}
+	/* and a second reader sees the same file */
+	if (!read_image(fd))
+		goto failure;
+	ret = 0;
+
+failure:
+	close(fd);
+	return ret;
+#else
+	return 0;
+#endif
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that strips and tiles holding only zeros are left out of files
+ * written in sparse mode ("S"), and that strips and tiles with no data
+ * read as zeros through the strip, tile, scanline and parallel readers.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "sparse_chunks.tif";
+
+#define	WIDTH		96
+#define	LENGTH		80
+#define	TILESIZE	32
+#define	ROWSPERSTRIP	16
+
+/* every third strip or tile is empty */
+#define	ISEMPTY(t)	((t) % 3 == 1)
+
+static void
+fill(unsigned char* buf, tmsize_t size, uint32 t)
+{
+	tmsize_t i;
+
+	if (ISEMPTY(t)) {
+		memset(buf, 0, size);
+		return;
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)((i / 7 + t * 29 + 1) & 0xff);
+}
+
+static int
+write_file(const char* mode, int tiled, uint16 compression, int parallel)
+{
+	TIFF* tif;
+	unsigned char** bufs;
+	tmsize_t* sizes;
+	uint32* list;
+	tmsize_t size;
+	uint32 n, t;
+	int ok = 1;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf(stderr, "Can't create %s\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, compression);
+	if (tiled) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	} else
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	bufs = (unsigned char**) calloc(n, sizeof(unsigned char*));
+	sizes = (tmsize_t*) calloc(n, sizeof(tmsize_t));
+	list = (uint32*) calloc(n, sizeof(uint32));
+	if (!bufs || !sizes || !list)
+		ok = 0;
+	for (t = 0; ok && t < n; t++) {
+		bufs[t] = (unsigned char*) malloc(size);
+		if (!bufs[t]) {
+			ok = 0;
+			break;
+		}
+		fill(bufs[t], size, t);
+		sizes[t] = size;
+		list[t] = t;
+	}
+	if (ok && parallel)
+		ok = tiled ? TIFFWriteEncodedTilesParallel(tif, list, n,
+		    (void**) bufs, sizes, 3) :
+		    TIFFWriteEncodedStripsParallel(tif, list, n,
+		    (void**) bufs, sizes, 3);
+	for (t = 0; ok && !parallel && t < n; t++)
+		if ((tiled ? TIFFWriteEncodedTile(tif, t, bufs[t], size) :
+		    TIFFWriteEncodedStrip(tif, t, bufs[t], size)) != size)
+			ok = 0;
+	if (!ok)
+		fprintf(stderr, "Can't write %s\n", filename);
+	for (t = 0; bufs && t < n; t++)
+		free(bufs[t]);
+	free(bufs);
+	free(sizes);
+	free(list);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+check_file(const char* label, int tiled, int sparse)
+{
+	TIFF* tif;
+	unsigned char* buf;
+	unsigned char* ref;
+	unsigned char** bufs;
+	uint32* list;
+	tmsize_t size;
+	uint32 n, t, row;
+	int ok = 1;
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf(stderr, "%s: Can't open %s\n", label, filename);
+		return 0;
+	}
+	size = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	n = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+	buf = (unsigned char*) malloc(size);
+	ref = (unsigned char*) malloc(size);
+	bufs = (unsigned char**) calloc(n, sizeof(unsigned char*));
+	list = (uint32*) calloc(n, sizeof(uint32));
+	if (!buf || !ref || !bufs || !list) {
+		fprintf(stderr, "%s: Out of memory\n", label);
+		ok = 0;
+		goto done;
+	}
+	for (t = 0; t < n; t++) {
+		uint64 count = TIFFGetStrileByteCount(tif, t);
+		uint64 offset = TIFFGetStrileOffset(tif, t);
+
+		if (ISEMPTY(t) && sparse && (count != 0 || offset != 0)) {
+			fprintf(stderr, "%s: Empty chunk %lu was written\n",
+			    label, (unsigned long) t);
+			ok = 0;
+		}
+		if ((!ISEMPTY(t) || !sparse) && count == 0) {
+			fprintf(stderr, "%s: Chunk %lu is missing\n", label,
+			    (unsigned long) t);
+			ok = 0;
+		}
+		fill(ref, size, t);
+		memset(buf, 0xAA, size);
+		if ((tiled ? TIFFReadEncodedTile(tif, t, buf, size) :
+		    TIFFReadEncodedStrip(tif, t, buf, size)) != size ||
+		    memcmp(buf, ref, size) != 0) {
+			fprintf(stderr, "%s: Chunk %lu reads back wrong\n",
+			    label, (unsigned long) t);
+			ok = 0;
+		}
+		/* a partial read of an empty chunk only touches what it asked for */
+		memset(buf, 0xAA, size);
+		if ((tiled ? TIFFReadEncodedTile(tif, t, buf, size / 2) :
+		    TIFFReadEncodedStrip(tif, t, buf, size / 2)) != size / 2 ||
+		    memcmp(buf, ref, size / 2) != 0 ||
+		    buf[size / 2] != 0xAA) {
+			fprintf(stderr, "%s: Partial read of chunk %lu is wrong\n",
+			    label, (unsigned long) t);
+			ok = 0;
+		}
+		list[t] = t;
+		bufs[t] = (unsigned char*) malloc(size);
+		if (!bufs[t]) {
+			ok = 0;
+			goto done;
+		}
+		memset(bufs[t], 0xAA, size);
+	}
+	if (!(tiled ? TIFFReadEncodedTilesParallel(tif, list, n,
+	    (void**) bufs, size, 3) :
+	    TIFFReadEncodedStripsParallel(tif, list, n,
+	    (void**) bufs, size, 3))) {
+		fprintf(stderr, "%s: Parallel read failed\n", label);
+		ok = 0;
+	}
+	for (t = 0; ok && t < n; t++) {
+		fill(ref, size, t);
+		if (memcmp(bufs[t], ref, size) != 0) {
+			fprintf(stderr, "%s: Parallel read of chunk %lu is wrong\n",
+			    label, (unsigned long) t);
+			ok = 0;
+		}
+	}
+	/* scanlines of empty strips read as zeros */
+	for (row = 0; ok && !tiled && row < LENGTH; row++) {
+		tmsize_t linesize = TIFFScanlineSize(tif);
+
+		fill(ref, size, row / ROWSPERSTRIP);
+		if (TIFFReadScanline(tif, buf, row, 0) != 1 ||
+		    memcmp(buf, ref + (row % ROWSPERSTRIP) * linesize,
+		    linesize) != 0) {
+			fprintf(stderr, "%s: Scanline %lu is wrong\n", label,
+			    (unsigned long) row);
+			ok = 0;
+		}
+	}
+done:
+	for (t = 0; bufs && t < n; t++)
+		free(bufs[t]);
+	free(bufs);
+	free(list);
+	free(buf);
+	free(ref);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+check_unwritten(void)
+{
+	TIFF* tif;
+	unsigned char buf[TILESIZE * TILESIZE];
+	unsigned char zero[TILESIZE * TILESIZE];
+	uint32 t;
+	int ok = 1;
+
+	/* tiles never written have no offset nor byte count */
+	tif = TIFFOpen(filename, "w");
+	if (!tif)
+		return 0;
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+	memset(buf, 7, sizeof(buf));
+	if (TIFFWriteEncodedTile(tif, 0, buf, sizeof(buf)) != sizeof(buf))
+		ok = 0;
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif)
+		return 0;
+	memset(zero, 0, sizeof(zero));
+	for (t = 1; ok && t < TIFFNumberOfTiles(tif); t++) {
+		memset(buf, 0xAA, sizeof(buf));
+		if (TIFFReadTile(tif, buf, (t % 3) * TILESIZE,
+		    (t / 3) * TILESIZE, 0, 0) != sizeof(buf) ||
+		    memcmp(buf, zero, sizeof(buf)) != 0) {
+			fprintf(stderr, "Unwritten tile %lu is not zero\n",
+			    (unsigned long) t);
+			ok = 0;
+		}
+	}
+	TIFFClose(tif);
+	return ok;
+}
+
+int
+main()
+{
+	static const uint16 codecs[] = { COMPRESSION_NONE, COMPRESSION_LZW };
+	int ret = 0, tiled, c;
+
+	for (tiled = 0; tiled <= 1; tiled++)
+		for (c = 0; c < 2; c++) {
+			char label[64];
+
+			sprintf(label, "%s/%u", tiled ? "tiles" : "strips",
+			    (unsigned) codecs[c]);
+			if (!write_file("wS", tiled, codecs[c], 0) ||
+			    !check_file(label, tiled, 1))
+				ret = 1;
+			strcat(label, "/parallel");
+			if (!write_file("wS", tiled, codecs[c], 1) ||
+			    !check_file(label, tiled, 1))
+				ret = 1;
+			strcat(label, "/dense");
+			if (!write_file("w", tiled, codecs[c], 0) ||
+			    !check_file(label, tiled, 0))
+				ret = 1;
+		}
+	if (!check_unwritten())
+		ret = 1;
+
+	if (ret == 0)
+		unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the counters returned by TIFFGetStatistics() for a handle
+ * opened with TIFFOpenOptionsSetStatistics(), and that handles opened
+ * without it keep none.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "statistics.tif";
+
+#define	WIDTH		256
+#define	LENGTH		100
+#define	ROWSPERSTRIP	10
+#define	NSTRIPS		(LENGTH / ROWSPERSTRIP)
+
+static TIFF*
+open_with_statistics(const char* mode)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFF* tif;
+
+	if (!opts)
+		return NULL;
+	TIFFOpenOptionsSetStatistics(opts, 1);
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif)
+		fprintf (stderr, "Can't open %s.\n", filename);
+	return tif;
+}
+
+static void
+fill_strip(TestChunk* c, void* arg)
+{
+	int i;
+
+	(void) arg;
+	for (i = 0; i < (int) c->size; i++)
+		c->buf[i] = (unsigned char)(i * 7);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, ROWSPERSTRIP, 0, 0 };
+	TIFF* tif = open_with_statistics("w");
+	TIFFStatistics stats;
+
+	if (!tif)
+		return 0;
+	set_image_fields(tif, &im);
+	TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	if (!write_image_data(tif, fill_strip, NULL)) {
+		TIFFClose(tif);
+		return 0;
+	}
+	if (!TIFFWriteDirectory(tif) || !TIFFGetStatistics(tif, &stats)) {
+		fprintf (stderr, "Can't write the directory.\n");
+		TIFFClose(tif);
+		return 0;
+	}
+	TIFFClose(tif);
+	if (stats.stripsencoded != NSTRIPS || stats.tilesencoded != 0) {
+		fprintf (stderr, "Encoded %lu strips, expected %d.\n",
+			 (unsigned long) stats.stripsencoded, NSTRIPS);
+		return 0;
+	}
+	if (stats.writecalls == 0 || stats.writebytes == 0 ||
+	    stats.readcalls != 0) {
+		fprintf (stderr, "Unexpected write counts.\n");
+		return 0;
+	}
+	return 1;
+}
+
+static int
+read_image(void)
+{
+	/* not memory mapped, so that strips are read into a raw buffer */
+	TIFF* tif = open_with_statistics("rm");
+	TIFFStatistics stats;
+	unsigned char buf[WIDTH * ROWSPERSTRIP];
+	uint32 s;
+
+	if (!tif)
+		return 0;
+	for (s = 0; s < NSTRIPS; s++) {
+		if (TIFFReadEncodedStrip(tif, s, buf, sizeof(buf)) == -1) {
+			fprintf (stderr, "Can't read strip %lu.\n",
+				 (unsigned long) s);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	(void) TIFFGetStatistics(tif, &stats);
+	TIFFClose(tif);
+	if (stats.stripsdecoded != NSTRIPS || stats.tilesdecoded != 0) {
+		fprintf (stderr, "Decoded %lu strips, expected %d.\n",
+			 (unsigned long) stats.stripsdecoded, NSTRIPS);
+		return 0;
+	}
+	if (stats.directoriesread != 1 || stats.rawbufferallocs == 0) {
+		fprintf (stderr, "Read %lu directories, %lu raw buffers.\n",
+			 (unsigned long) stats.directoriesread,
+			 (unsigned long) stats.rawbufferallocs);
+		return 0;
+	}
+	if (stats.readcalls == 0 || stats.readbytes == 0 ||
+	    stats.seekcalls == 0 || stats.writecalls != 0) {
+		fprintf (stderr, "Unexpected read counts.\n");
+		return 0;
+	}
+	if (stats.predictortime > stats.decodetime) {
+		fprintf (stderr, "Predictor time exceeds decoding time.\n");
+		return 0;
+	}
+	return 1;
+}
+
+static int
+check_disabled(void)
+{
+	TIFF* tif = TIFFOpen(filename, "r");
+	TIFFStatistics stats;
+	int ret;
+
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	stats.readcalls = 1;
+	ret = TIFFGetStatistics(tif, &stats);
+	TIFFClose(tif);
+	if (ret || stats.readcalls != 0) {
+		fprintf (stderr, "Statistics kept without being enabled.\n");
+		return 0;
+	}
+	return 1;
+}
+
+int
+main()
+{
+	if (!write_image() || !read_image() || !check_disabled())
+		return 1;
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check reading through TIFFStreamOpen(): string streams are used in
+ * place as the mapped file image, and other streams are read through
+ * a block cache, so that the streambuf sees few reads and seeks.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <string.h>
+#include <sstream>
+#include <string>
+
+#include "tiffio.h"
+#include "tiffio.hxx"
+
+#define	WIDTH		96
+#define	LENGTH		64
+#define	ROWSPERSTRIP	4
+#define	PREFIX		"prefix"
+
+/* A streambuf over a string without a buffer of its own, counting calls */
+class countbuf : public std::streambuf
+{
+public:
+	countbuf(const std::string& s) : data(s), pos(0), reads(0), seeks(0) {}
+
+	const std::string& data;
+	size_t pos;
+	int reads;
+	int seeks;
+
+protected:
+	virtual int_type underflow()
+	{
+		if (pos >= data.size())
+			return traits_type::eof();
+		return traits_type::to_int_type(data[pos]);
+	}
+	virtual int_type uflow()
+	{
+		reads++;
+		if (pos >= data.size())
+			return traits_type::eof();
+		return traits_type::to_int_type(data[pos++]);
+	}
+	virtual std::streamsize xsgetn(char* s, std::streamsize n)
+	{
+		size_t left = pos < data.size() ? data.size() - pos : 0;
+
+		reads++;
+		if (static_cast<size_t>(n) > left)
+			n = static_cast<std::streamsize>(left);
+		memcpy(s, data.data() + pos, n);
+		pos += n;
+		return n;
+	}
+	virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+				 std::ios_base::openmode)
+	{
+		off_type base = dir == std::ios_base::beg ? 0 :
+		    dir == std::ios_base::cur ? static_cast<off_type>(pos) :
+		    static_cast<off_type>(data.size());
+
+		seeks++;
+		if (base + off < 0)
+			return pos_type(off_type(-1));
+		pos = static_cast<size_t>(base + off);
+		return pos_type(static_cast<off_type>(pos));
+	}
+	virtual pos_type seekpos(pos_type p, std::ios_base::openmode which)
+	{
+		return seekoff(off_type(p), std::ios_base::beg, which);
+	}
+};
+
+static unsigned char
+pixel(uint32 x, uint32 y)
+{
+	return (unsigned char)((x * 3 + y * 7) & 0xff);
+}
+
+static int
+write_file(std::string& out)
+{
+	std::ostringstream os;
+	unsigned char row[WIDTH];
+
+	os << PREFIX;
+	TIFF* tif = TIFFStreamOpen("stream_io", &os);
+	if (!tif) {
+		fprintf (stderr, "Can't open the output stream.\n");
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, "stream test");
+	for (uint32 y = 0; y < LENGTH; y++) {
+		for (uint32 x = 0; x < WIDTH; x++)
+			row[x] = pixel(x, y);
+		if (TIFFWriteScanline(tif, row, y, 0) < 0) {
+			fprintf (stderr, "Can't write row %lu.\n",
+				 (unsigned long) y);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	out = os.str();
+	return 1;
+}
+
+static int
+check_file(TIFF* tif, const char* what)
+{
+	unsigned char row[WIDTH];
+
+	for (uint32 y = 0; y < LENGTH; y++) {
+		if (TIFFReadScanline(tif, row, y, 0) < 0) {
+			fprintf (stderr, "%s: can't read row %lu.\n",
+				 what, (unsigned long) y);
+			return 0;
+		}
+		for (uint32 x = 0; x < WIDTH; x++)
+			if (row[x] != pixel(x, y)) {
+				fprintf (stderr, "%s: row %lu differs.\n",
+					 what, (unsigned long) y);
+				return 0;
+			}
+	}
+	return 1;
+}
+
+int
+main()
+{
+	std::string file;
+
+	if (!write_file(file))
+		return 1;
+
+	/* a string stream is mapped */
+	{
+		std::istringstream is(file);
+		is.seekg(strlen(PREFIX));
+		TIFF* tif = TIFFStreamOpen("stream_io", &is);
+		if (!tif)
+			return 1;
+		const void* raw;
+		tmsize_t rawsize;
+		/* the mapping starts at the TIFF header, after the prefix */
+		if (!TIFFGetMappedRawStrip(tif, 0, &raw, &rawsize) ||
+		    memcmp(raw, file.data() + strlen(PREFIX) +
+			   TIFFGetStrileOffset(tif, 0), rawsize) != 0) {
+			fprintf (stderr, "istringstream is not mapped.\n");
+			TIFFClose(tif);
+			return 1;
+		}
+		if (!check_file(tif, "istringstream")) {
+			TIFFClose(tif);
+			return 1;
+		}
+		TIFFClose(tif);
+	}
+
+	/* other streams go through the cache */
+	{
+		countbuf sb(file);
+		std::istream is(&sb);
+		is.seekg(strlen(PREFIX));
+		sb.seeks = 0;
+		TIFF* tif = TIFFStreamOpen("stream_io", &is);
+		if (!tif)
+			return 1;
+		if (!check_file(tif, "countbuf")) {
+			TIFFClose(tif);
+			return 1;
+		}
+		TIFFClose(tif);
+		/* the whole file fits in one block */
+		if (sb.reads > 2 || sb.seeks > 8) {
+			fprintf (stderr, "countbuf: %d reads and %d seeks.\n",
+				 sb.reads, sb.seeks);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the memory used by strip/tile offsets and byte counts loaded
+ * on demand (TIFFOpen() 'O' flag): 32-bit values for a ClassicTIFF
+ * file, and none at all when the file is memory mapped.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "strile_storage.tif";
+
+#define	WIDTH		1024
+#define	LENGTH		1024
+#define	TILESIZE	16
+#define	NTILES		((WIDTH / TILESIZE) * (LENGTH / TILESIZE))
+
+static tmsize_t allocated;
+
+static void*
+count_malloc(void* ctx, tmsize_t size)
+{
+	(void) ctx;
+	allocated += size;
+	return malloc((size_t) size);
+}
+
+static void*
+count_realloc(void* ctx, void* ptr, tmsize_t size)
+{
+	(void) ctx;
+	allocated += size;
+	return realloc(ptr, (size_t) size);
+}
+
+static void
+count_free(void* ctx, void* ptr)
+{
+	(void) ctx;
+	free(ptr);
+}
+
+static TIFF*
+open_counted(const char* mode)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFF* tif;
+
+	if (!opts)
+		return NULL;
+	TIFFOpenOptionsSetAllocator(opts, count_malloc, count_realloc,
+	    count_free, NULL);
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif)
+		fprintf (stderr, "Can't open %s.\n", filename);
+	return tif;
+}
+
+static void
+fill_tile(TestChunk* c, void* arg)
+{
+	(void) arg;
+	/* Vary the compressed size from tile to tile */
+	memset(c->buf, (int)(c->index & 0xff), c->size);
+	c->buf[c->index % c->size] ^= 0x55;
+}
+
+static int
+write_image(const char* mode)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_PACKBITS, 0,
+	    TILESIZE, TILESIZE };
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	set_image_fields(tif, &im);
+	ok = write_image_data(tif, fill_tile, NULL);
+	TIFFClose(tif);
+	return ok;
+}
+
+/*
+ * Look up every tile, and check the values and the memory allocated
+ * for them against maxbytes.
+ */
+static int
+check_image(const char* mode, tmsize_t maxbytes)
+{
+	TIFF* ref;
+	TIFF* tif;
+	uint64* offsets;
+	uint64* bytecounts;
+	uint32 i;
+	int ret = 0;
+
+	ref = TIFFOpen(filename, "r");
+	tif = open_counted(mode);
+	if (!ref || !tif)
+		goto failure;
+	if (!TIFFGetField(ref, TIFFTAG_TILEOFFSETS, &offsets) ||
+	    !TIFFGetField(ref, TIFFTAG_TILEBYTECOUNTS, &bytecounts)) {
+		fprintf (stderr, "No tile arrays.\n");
+		goto failure;
+	}
+	allocated = 0;
+	for (i = 0; i < NTILES; i++) {
+		if (TIFFGetStrileOffset(tif, i) != offsets[i] ||
+		    TIFFGetStrileByteCount(tif, i) != bytecounts[i]) {
+			fprintf (stderr, "Mode %s: location of tile %lu differs.\n",
+				 mode, (unsigned long) i);
+			goto failure;
+		}
+	}
+	if (allocated > maxbytes) {
+		fprintf (stderr,
+			 "Mode %s: %lu bytes allocated for %d tiles, "
+			 "expected at most %lu.\n", mode,
+			 (unsigned long) allocated, NTILES,
+			 (unsigned long) maxbytes);
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	if (ref)
+		TIFFClose(ref);
+	if (tif)
+		TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	/* two arrays, plus their page tables */
+	const tmsize_t pagetables = 2 * 1024;
+
+	if (!write_image("w") ||
+	    !check_image("rO", 0) ||
+	    !check_image("rmO", 2 * NTILES * 4 + pagetables))
+		return 1;
+	if (!write_image("w8") ||
+	    !check_image("rO", 0) ||
+	    !check_image("rmO", 2 * NTILES * 8 + pagetables))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Write images with more tiles than the window set with
+ * TIFFOpenOptionsSetStrileWindow(), out of order and rewriting some
+ * tiles after the window moved on, and check that they read back with
+ * their arrays set aside ahead of the image data.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "strile_window.tif";
+
+#define	TILE		16
+#define	WIDTH		(20 * TILE)
+#define	LENGTH		(10 * TILE)
+#define	NTILES		200
+#define	WINDOW		16
+
+static void
+fill_tile(unsigned char* buf, uint32 tile, int pass, int dir)
+{
+	int i;
+
+	for (i = 0; i < TILE * TILE; i++)
+		buf[i] = (unsigned char)(tile * 7 + i + pass * 31 + dir * 101);
+}
+
+static int
+write_image(TIFF* tif, int dir, uint32 width, uint32 length)
+{
+	TestImage im = { 0, 0, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, 0, 0, TILE, TILE };
+	unsigned char buf[TILE * TILE];
+	uint32 ntiles, t;
+	uint64* offsets = NULL;
+
+	im.width = width;
+	im.length = length;
+	set_image_fields(tif, &im);
+	ntiles = TIFFNumberOfTiles(tif);
+
+	/* The even tiles in order, the odd ones backwards */
+	for (t = 0; t < ntiles; t += 2) {
+		fill_tile(buf, t, 0, dir);
+		if (TIFFWriteEncodedTile(tif, t, buf, sizeof(buf)) == -1)
+			return 0;
+	}
+	for (t = ntiles - ntiles % 2; t >= 2; t -= 2) {
+		if (t - 1 >= ntiles)
+			continue;
+		fill_tile(buf, t - 1, 0, dir);
+		if (TIFFWriteEncodedTile(tif, t - 1, buf, sizeof(buf)) == -1)
+			return 0;
+	}
+	/* Rewrite every fifth tile, far apart from the window held */
+	for (t = 0; t < ntiles; t += 5) {
+		fill_tile(buf, t, 1, dir);
+		if (TIFFWriteEncodedTile(tif, t, buf, sizeof(buf)) == -1)
+			return 0;
+	}
+	if (TIFFGetStrileByteCount(tif, ntiles - 1) != sizeof(buf)) {
+		fprintf (stderr, "Wrong byte count of the last tile.\n");
+		return 0;
+	}
+	/* The arrays are not in memory when streamed */
+	if (ntiles > WINDOW) {
+		TIFFErrorHandler handler = TIFFSetErrorHandler(NULL);
+		int got = TIFFGetField(tif, TIFFTAG_TILEOFFSETS, &offsets);
+
+		TIFFSetErrorHandler(handler);
+		if (got) {
+			fprintf (stderr, "Got the streamed offset array.\n");
+			return 0;
+		}
+	}
+	return TIFFWriteDirectory(tif);
+}
+
+static int
+check_image(TIFF* tif, int dir, int bigtiff)
+{
+	unsigned char buf[TILE * TILE], expected[TILE * TILE];
+	uint32 ntiles = TIFFNumberOfTiles(tif), t;
+	uint64 first = 0;
+
+	for (t = 0; t < ntiles; t++) {
+		uint64 off = TIFFGetStrileOffset(tif, t);
+
+		if (first == 0 || off < first)
+			first = off;
+		if (TIFFReadEncodedTile(tif, t, buf, sizeof(buf)) !=
+		    (tmsize_t) sizeof(buf)) {
+			fprintf (stderr, "Can't read tile %lu of directory "
+				 "%d.\n", (unsigned long) t, dir);
+			return 0;
+		}
+		fill_tile(expected, t, t % 5 == 0, dir);
+		if (memcmp(buf, expected, sizeof(buf)) != 0) {
+			fprintf (stderr, "Wrong tile %lu of directory %d.\n",
+				 (unsigned long) t, dir);
+			return 0;
+		}
+	}
+	/* Both arrays were set aside before the first tile */
+	if (ntiles > WINDOW && dir == 0 &&
+	    first < (bigtiff ? 16 : 8) + 2 * ntiles * (bigtiff ? 8 : 4)) {
+		fprintf (stderr, "Tile data at %lu, in the arrays.\n",
+			 (unsigned long) first);
+		return 0;
+	}
+	return 1;
+}
+
+static int
+test(const char* mode)
+{
+	TIFFOpenOptions* opts = TIFFOpenOptionsAlloc();
+	TIFF* tif;
+	int bigtiff = strchr(mode, '8') != NULL;
+	int ok;
+
+	if (!opts)
+		return 0;
+	TIFFOpenOptionsSetStrileWindow(opts, WINDOW);
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	/* Two streamed images and one small enough to be held whole */
+	ok = write_image(tif, 0, WIDTH, LENGTH) &&
+	     write_image(tif, 1, WIDTH + 5, LENGTH - 3) &&
+	     write_image(tif, 2, 3 * TILE, 2 * TILE);
+	TIFFClose(tif);
+	if (!ok) {
+		fprintf (stderr, "Can't write %s in mode %s.\n", filename,
+			 mode);
+		return 0;
+	}
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	ok = TIFFNumberOfTiles(tif) == NTILES &&
+	     check_image(tif, 0, bigtiff) &&
+	     TIFFReadDirectory(tif) && check_image(tif, 1, bigtiff) &&
+	     TIFFReadDirectory(tif) && check_image(tif, 2, bigtiff) &&
+	     !TIFFReadDirectory(tif);
+	TIFFClose(tif);
+	if (!ok)
+		fprintf (stderr, "Wrong read back of mode %s.\n", mode);
+	return ok;
+}
+
+int
+main()
+{
+	int ret = 1;
+
+	if (!test("w") || !test("w8") || !test("wb") || !test("w8b"))
+		goto done;
+	ret = 0;
+done:
+	unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the TIFFSwabArrayOf*() routines against a plain byte reversal,
+ * and TIFFReverseBits() against the bit reversal table, for all lengths
+ * up to a few vectors and all buffer alignments, so that both the
+ * vector code and the scalar remainder are exercised.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiffio.h"
+
+#define	MAXELEMS	200
+#define	BUFSIZE		(MAXELEMS * 8 + 32)
+
+static void
+reverse(unsigned char* p, tmsize_t n, int size)
+{
+	tmsize_t i;
+	int j;
+
+	for (i = 0; i < n; i++, p += size)
+		for (j = 0; j < size / 2; j++) {
+			unsigned char t = p[j];
+			p[j] = p[size - 1 - j];
+			p[size - 1 - j] = t;
+		}
+}
+
+static void
+swab(unsigned char* p, tmsize_t n, int kind)
+{
+	switch (kind) {
+	case 0: TIFFSwabArrayOfShort((uint16*) p, n); break;
+	case 1: TIFFSwabArrayOfTriples((uint8*) p, n); break;
+	case 2: TIFFSwabArrayOfLong((uint32*) p, n); break;
+	case 3: TIFFSwabArrayOfFloat((float*) p, n); break;
+	case 4: TIFFSwabArrayOfLong8((uint64*) p, n); break;
+	case 5: TIFFSwabArrayOfDouble((double*) p, n); break;
+	}
+}
+
+int
+main()
+{
+	static const int sizes[] = { 2, 3, 4, 4, 8, 8 };
+	static const char* names[] = { "Short", "Triples", "Long", "Float",
+				       "Long8", "Double" };
+	unsigned char* got = (unsigned char*) malloc(BUFSIZE);
+	unsigned char* expected = (unsigned char*) malloc(BUFSIZE);
+	int kind, off, i;
+	tmsize_t n;
+
+	if (!got || !expected) {
+		fprintf (stderr, "Out of memory.\n");
+		return 1;
+	}
+	for (kind = 0; kind < 6; kind++)
+		for (off = 0; off < 16; off++)
+			for (n = 0; n <= MAXELEMS; n++) {
+				for (i = 0; i < BUFSIZE; i++)
+					got[i] = expected[i] =
+					    (unsigned char)(i * 37 + n);
+				swab(got + off, n, kind);
+				reverse(expected + off, n, sizes[kind]);
+				if (memcmp(got, expected, BUFSIZE) != 0) {
+					fprintf (stderr,
+					    "TIFFSwabArrayOf%s: wrong result "
+					    "for %lu elements at offset %d.\n",
+					    names[kind], (unsigned long) n, off);
+					return 1;
+				}
+			}
+	for (off = 0; off < 16; off++)
+		for (n = 0; n <= BUFSIZE - 16; n++) {
+			const unsigned char* rev = TIFFGetBitRevTable(1);
+
+			for (i = 0; i < BUFSIZE; i++)
+				got[i] = expected[i] =
+				    (unsigned char)(i * 37 + n);
+			TIFFReverseBits(got + off, n);
+			for (i = 0; i < n; i++)
+				expected[off + i] = rev[expected[off + i]];
+			if (memcmp(got, expected, BUFSIZE) != 0) {
+				fprintf (stderr,
+				    "TIFFReverseBits: wrong result "
+				    "for %lu bytes at offset %d.\n",
+				    (unsigned long) n, off);
+				return 1;
+			}
+		}
+	free(got);
+	free(expected);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Writer of the images the tests read back.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tiffio.h"
+#include "test_image.h"
+
+/*
+ * Set the fields describing the layout of the image.  Tags specific to
+ * a test, codec tags among them, are set by the caller afterwards.
+ */
+void
+set_image_fields(TIFF* tif, const TestImage* im)
+{
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, im->width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, im->length);
+	if (im->bitspersample)
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, im->bitspersample);
+	if (im->samplesperpixel)
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, im->samplesperpixel);
+	if (im->planarconfig)
+		TIFFSetField(tif, TIFFTAG_PLANARCONFIG, im->planarconfig);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, im->photometric);
+	if (im->compression)
+		TIFFSetField(tif, TIFFTAG_COMPRESSION, im->compression);
+	if (im->tilewidth) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, im->tilewidth);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, im->tilelength);
+	} else if (im->rowsperstrip)
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, im->rowsperstrip);
+}
+
+/*
+ * Write every strip or tile of the current directory, in order, after
+ * fill() has stored its data.
+ */
+int
+write_image_data(TIFF* tif, TestFillProc fill, void* arg)
+{
+	uint32 width, length, cw, cl;
+	uint16 spp, planar, nplanes;
+	int tiled = TIFFIsTiled(tif);
+	TestChunk c;
+	tmsize_t size;
+	unsigned char* buf;
+
+	TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &length);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar);
+	if (tiled) {
+		TIFFGetField(tif, TIFFTAG_TILEWIDTH, &cw);
+		TIFFGetField(tif, TIFFTAG_TILELENGTH, &cl);
+		size = TIFFTileSize(tif);
+	} else {
+		TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &cl);
+		if (cl > length)
+			cl = length;
+		cw = width;
+		size = TIFFStripSize(tif);
+	}
+	buf = (unsigned char*) malloc(size);
+	if (!buf) {
+		fprintf (stderr, "Out of memory.\n");
+		return 0;
+	}
+	nplanes = planar == PLANARCONFIG_SEPARATE ? spp : 1;
+	c.samples = planar == PLANARCONFIG_SEPARATE ? 1 : spp;
+	c.rowsize = tiled ? TIFFTileRowSize(tif) : TIFFScanlineSize(tif);
+	c.buf = buf;
+	for (c.plane = 0; c.plane < nplanes; c.plane++)
+		for (c.y = 0; c.y < length; c.y += cl)
+			for (c.x = 0; c.x < width; c.x += cw) {
+				c.width = cw;
+				c.length = cl;
+				c.size = size;
+				if (tiled)
+					c.index = TIFFComputeTile(tif, c.x, c.y,
+					    0, c.plane);
+				else {
+					c.index = TIFFComputeStrip(tif, c.y,
+					    c.plane);
+					if (length - c.y < cl) {
+						c.length = length - c.y;
+						c.size = TIFFVStripSize(tif,
+						    c.length);
+					}
+				}
+				(*fill)(&c, arg);
+				if ((tiled ?
+				    TIFFWriteEncodedTile(tif, c.index, buf, c.size) :
+				    TIFFWriteEncodedStrip(tif, c.index, buf,
+				    c.size)) == -1) {
+					fprintf (stderr, "Can't write %s %lu.\n",
+						 tiled ? "tile" : "strip",
+						 (unsigned long) c.index);
+					free(buf);
+					return 0;
+				}
+			}
+	free(buf);
+	return 1;
+}
+
+/*
+ * Create filename holding one image with the given layout.
+ */
+int
+write_test_image(const char* filename, const TestImage* im,
+		 TestFillProc fill, void* arg)
+{
+	TIFF* tif = TIFFOpen(filename, "w");
+	int ok;
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	set_image_fields(tif, im);
+	ok = write_image_data(tif, fill, arg);
+	TIFFClose(tif);
+	return ok;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Declarations for the writer of the test images.
+ */
+
+#ifndef _TEST_IMAGE_
+#define _TEST_IMAGE_
+
+#include "tiffio.h"
+
+/*
+ * Layout of a test image.  Fields other than the size and the
+ * photometric interpretation are left unset when zero; the image is
+ * tiled when tilewidth is not.
+ */
+typedef struct {
+	uint32		width;
+	uint32		length;
+	uint16		bitspersample;
+	uint16		samplesperpixel;
+	uint16		planarconfig;
+	uint16		photometric;
+	uint16		compression;
+	uint32		rowsperstrip;
+	uint32		tilewidth;
+	uint32		tilelength;
+} TestImage;
+
+/*
+ * A strip or tile to be filled before it is written.  Strips hold only
+ * the rows of the image, tiles their whole size.
+ */
+typedef struct {
+	uint32		index;		/* strip or tile number */
+	uint16		plane;		/* sample plane, 0 when contiguous */
+	uint16		samples;	/* samples per pixel in buf */
+	uint32		x, y;		/* column and row of the first pixel */
+	uint32		width, length;	/* columns and rows in buf */
+	tmsize_t	rowsize;	/* bytes per row */
+	unsigned char*	buf;
+	tmsize_t	size;		/* bytes in buf */
+} TestChunk;
+
+typedef void (*TestFillProc)(TestChunk*, void*);
+
+extern void set_image_fields(TIFF*, const TestImage*);
+extern int write_image_data(TIFF*, TestFillProc, void*);
+extern int write_test_image(const char*, const TestImage*,
+			    TestFillProc, void*);
+
+#endif /* _TEST_IMAGE_ */
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
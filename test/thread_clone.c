@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that handles made by TIFFCloneForThread() decode like their
+ * template, that the shared directory is protected, and that closing
+ * the template is deferred until its clones are closed.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "thread_clone.tif";
+
+#define	WIDTH		160
+#define	LENGTH		96
+#define	TILESIZE	32
+#define	NCLONES		3
+
+static void
+fill_tile(TestChunk* c, void* arg)
+{
+	tmsize_t i;
+
+	(void) arg;
+	for (i = 0; i < c->size; i++)
+		c->buf[i] = (unsigned char)((i / 5 + c->index * 29 + (i % 3) * 70) & 0xff);
+}
+
+static int
+write_directory(TIFF* tif, uint16 compression)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 3, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_RGB, 0, 0, TILESIZE, TILESIZE };
+
+	im.compression = compression;
+	set_image_fields(tif, &im);
+	if (compression == COMPRESSION_LZW)
+		TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, "cloned");
+	return write_image_data(tif, fill_tile, NULL) && TIFFWriteDirectory(tif);
+}
+
+static int
+write_image(void)
+{
+	TIFF* tif;
+	int ok;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	ok = write_directory(tif, COMPRESSION_LZW) &&
+#ifdef JPEG_SUPPORT
+	    write_directory(tif, COMPRESSION_JPEG);
+#else
+	    write_directory(tif, COMPRESSION_PACKBITS);
+#endif
+	TIFFClose(tif);
+	if (!ok)
+		fprintf (stderr, "Can't write %s.\n", filename);
+	return ok;
+}
+
+/*
+ * Decode every tile of the current directory of ref with one of the
+ * clones, round robin, and compare with the tiles of ref.
+ */
+static int
+compare_tiles(TIFF* ref, TIFF** clones, int nclones)
+{
+	tmsize_t size = TIFFTileSize(ref);
+	uint32 n = TIFFNumberOfTiles(ref);
+	unsigned char* a = (unsigned char*) malloc(size);
+	unsigned char* b = (unsigned char*) malloc(size);
+	uint32 t;
+	int ret = 0;
+
+	if (!a || !b)
+		goto failure;
+	for (t = 0; t < n; t++) {
+		tmsize_t got = TIFFReadEncodedTile(ref, t, a, size);
+
+		if (got == -1 ||
+		    TIFFReadEncodedTile(clones[t % nclones], t, b, size) != got) {
+			fprintf (stderr, "Can't decode tile %lu.\n",
+				 (unsigned long) t);
+			goto failure;
+		}
+		if (memcmp(a, b, got) != 0) {
+			fprintf (stderr, "Tile %lu differs.\n", (unsigned long) t);
+			goto failure;
+		}
+	}
+	ret = 1;
+
+failure:
+	free(a);
+	free(b);
+	return ret;
+}
+
+static int
+check_clones(const char* mode)
+{
+	TIFF* tif;
+	TIFF* ref = NULL;
+	TIFF* clones[NCLONES];
+	uint32 tiles[2] = { 3, 0 };
+	void* bufs[2] = { NULL, NULL };
+	unsigned char* serial = NULL;
+	char* desc;
+	tmsize_t size;
+	int i, nclones = 0, ret = 0;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif || !TIFFSetDirectory(tif, 1)) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	for (; nclones < NCLONES; nclones++) {
+		clones[nclones] = TIFFCloneForThread(tif);
+		if (!clones[nclones]) {
+			fprintf (stderr, "Can't clone %s (mode %s).\n",
+				 filename, mode);
+			goto failure;
+		}
+	}
+	if (TIFFCurrentDirectory(clones[0]) != 1 ||
+	    !TIFFGetField(clones[1], TIFFTAG_IMAGEDESCRIPTION, &desc) ||
+	    strcmp(desc, "cloned") != 0) {
+		fprintf (stderr, "Clone does not share the directory.\n");
+		goto failure;
+	}
+	if (!compare_tiles(tif, clones, nclones))
+		goto failure;
+
+	/* The shared directory cannot change */
+	if (TIFFSetDirectory(tif, 0) ||
+	    TIFFSetField(clones[0], TIFFTAG_IMAGEDESCRIPTION, "changed")) {
+		fprintf (stderr, "Shared directory was modified.\n");
+		goto failure;
+	}
+
+	/* Parallel decoding through a clone */
+	size = TIFFTileSize(tif);
+	bufs[0] = malloc(size);
+	bufs[1] = malloc(size);
+	serial = (unsigned char*) malloc(size);
+	if (!bufs[0] || !bufs[1] || !serial)
+		goto failure;
+	if (!TIFFReadEncodedTilesParallel(clones[2], tiles, 2, bufs, size, 2)) {
+		fprintf (stderr, "Parallel decoding on a clone failed.\n");
+		goto failure;
+	}
+	for (i = 0; i < 2; i++) {
+		if (TIFFReadEncodedTile(tif, tiles[i], serial, size) == -1 ||
+		    memcmp(serial, bufs[i], size) != 0) {
+			fprintf (stderr, "Parallel tile %lu differs.\n",
+				 (unsigned long) tiles[i]);
+			goto failure;
+		}
+	}
+
+	/* A clone moving to another directory reads its own */
+	if (!TIFFSetDirectory(clones[0], 0)) {
+		fprintf (stderr, "Clone can't change directory.\n");
+		goto failure;
+	}
+	ref = TIFFOpen(filename, mode);
+	if (!ref || !compare_tiles(ref, clones, 1))
+		goto failure;
+
+	/* Closing the template waits for the clones */
+	TIFFClose(tif);
+	tif = NULL;
+	for (i = 0; i < nclones; i++)
+		if (!TIFFSetDirectory(ref, (uint16) (i == 0 ? 0 : 1)) ||
+		    !compare_tiles(ref, &clones[i], 1))
+			goto failure;
+	ret = 1;
+
+failure:
+	free(bufs[0]);
+	free(bufs[1]);
+	free(serial);
+	if (ref)
+		TIFFClose(ref);
+	for (i = 0; i < nclones; i++)
+		TIFFClose(clones[i]);
+	if (tif)
+		TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image())
+		return 1;
+	if (!check_clones("r") || !check_clones("rm") || !check_clones("rO"))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that the parallel routines run their tasks on the thread pool
+ * of the handle, else on the default thread pool.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "thread_pool.tif";
+
+#define	NSTRIPS		8
+#define	WIDTH		64
+#define	ROWS		4
+#define	MAXTASKS	16
+
+/*
+ * A pool that runs tasks on the calling thread: at once without
+ * groups, when the group is waited for with them.
+ */
+typedef struct {
+	int		submitted;
+	int		groups;
+	int		npending;
+	void		(*funcs[MAXTASKS])(void*);
+	void*		args[MAXTASKS];
+} TestPool;
+
+static int
+submit(void* user_data, void* group, void (*func)(void*), void* arg)
+{
+	TestPool* p = (TestPool*) user_data;
+
+	p->submitted++;
+	if (group == NULL) {
+		(*func)(arg);
+		return 1;
+	}
+	if (p->npending == MAXTASKS)
+		return 0;
+	p->funcs[p->npending] = func;
+	p->args[p->npending++] = arg;
+	return 1;
+}
+
+static void*
+group_create(void* user_data)
+{
+	TestPool* p = (TestPool*) user_data;
+
+	p->groups++;
+	return p;
+}
+
+static void
+group_wait(void* user_data, void* group)
+{
+	TestPool* p = (TestPool*) user_data;
+	int i;
+
+	(void) group;
+	for (i = 0; i < p->npending; i++)
+		(*p->funcs[i])(p->args[i]);
+	p->npending = 0;
+}
+
+static int
+write_file(void)
+{
+	unsigned char buf[WIDTH * ROWS];
+	TIFF* tif;
+	uint32 s;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, NSTRIPS * ROWS);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWS);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	for (s = 0; s < NSTRIPS; s++) {
+		memset(buf, (int) s + 1, sizeof(buf));
+		if (TIFFWriteEncodedStrip(tif, s, buf, sizeof(buf)) == -1) {
+			fprintf (stderr, "Can't write strip %lu.\n",
+				 (unsigned long) s);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+read_file(TIFFOpenOptions* opts)
+{
+	static unsigned char data[NSTRIPS][WIDTH * ROWS];
+	uint32 strips[NSTRIPS];
+	void* bufs[NSTRIPS];
+	TIFF* tif;
+	uint32 s;
+	int ok;
+
+	tif = TIFFOpenExt(filename, "r", opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	memset(data, 0, sizeof(data));
+	for (s = 0; s < NSTRIPS; s++) {
+		strips[s] = s;
+		bufs[s] = data[s];
+	}
+	ok = TIFFReadEncodedStripsParallel(tif, strips, NSTRIPS, bufs,
+	    WIDTH * ROWS, 0);
+	TIFFClose(tif);
+	if (!ok) {
+		fprintf (stderr, "Can't read the strips in parallel.\n");
+		return 0;
+	}
+	for (s = 0; s < NSTRIPS; s++)
+		if (data[s][0] != s + 1 || data[s][WIDTH * ROWS - 1] != s + 1) {
+			fprintf (stderr, "Wrong data in strip %lu.\n",
+				 (unsigned long) s);
+			return 0;
+		}
+	return 1;
+}
+
+int
+main()
+{
+	TestPool handlepool, defaultpool;
+	TIFFThreadPool pool;
+	TIFFOpenOptions* opts;
+	int ret = 1;
+
+	memset(&handlepool, 0, sizeof(handlepool));
+	memset(&defaultpool, 0, sizeof(defaultpool));
+	if (!write_file())
+		goto done;
+
+	/* The default pool, without groups */
+	memset(&pool, 0, sizeof(pool));
+	pool.user_data = &defaultpool;
+	pool.concurrency = 4;
+	pool.submit = submit;
+	TIFFSetDefaultThreadPool(&pool);
+	if (!read_file(NULL))
+		goto done;
+	if (defaultpool.submitted != 3 || defaultpool.groups != 0) {
+		fprintf (stderr, "Default pool got %d tasks in %d groups.\n",
+			 defaultpool.submitted, defaultpool.groups);
+		goto done;
+	}
+
+	/* The pool of the handle, with groups, comes first */
+	pool.user_data = &handlepool;
+	pool.concurrency = 3;
+	pool.group_create = group_create;
+	pool.group_wait = group_wait;
+	opts = TIFFOpenOptionsAlloc();
+	TIFFOpenOptionsSetThreadPool(opts, &pool);
+	ret = !read_file(opts);
+	TIFFOpenOptionsFree(opts);
+	if (ret)
+		goto done;
+	ret = 1;
+	if (handlepool.submitted != 2 || handlepool.groups != 1 ||
+	    handlepool.npending != 0 || defaultpool.submitted != 3) {
+		fprintf (stderr, "Handle pool got %d tasks in %d groups.\n",
+			 handlepool.submitted, handlepool.groups);
+		goto done;
+	}
+
+	/* Back to threads of the library */
+	TIFFSetDefaultThreadPool(NULL);
+	if (!read_file(NULL) || defaultpool.submitted != 3)
+		goto done;
+	ret = 0;
+done:
+	TIFFSetDefaultThreadPool(NULL);
+	unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
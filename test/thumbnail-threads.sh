@@ -0,0 +1,19 @@
+#!/bin/sh
+#
+# Check that thumbnail makes the same thumbnails of a multi-page file
+# of facsimile and colour pages on one or more threads
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${TIFFCP} -c g3:1d -r 5" "${IMG_MINISWHITE_1C_1B}" "o-thumbnail-threads-g3.tiff"
+f_test_convert "${TIFFCP}" "o-thumbnail-threads-g3.tiff ${IMG_RGB_3C_8B} ${IMG_PALETTE_1C_8B} o-thumbnail-threads-g3.tiff" "o-thumbnail-threads-in.tiff"
+for opts in "" "-w 40 -h 30 -c exp50"
+do
+  f_test_convert "${THUMBNAIL} -j 1 ${opts}" "o-thumbnail-threads-in.tiff" "o-thumbnail-threads-1.tiff"
+  f_test_convert "${THUMBNAIL} -j 3 ${opts}" "o-thumbnail-threads-in.tiff" "o-thumbnail-threads-3.tiff"
+  echo "cmp o-thumbnail-threads-1.tiff o-thumbnail-threads-3.tiff"
+  if ! cmp o-thumbnail-threads-1.tiff o-thumbnail-threads-3.tiff
+  then
+    echo "Thumbnails made on threads (${opts}) differ"
+    exit 1
+  fi
+done
@@ -0,0 +1,16 @@
+#!/bin/sh
+#
+# Check that tiff2pdf writes the same PDF when pages are prepared on threads
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${TIFFCP}" "${IMG_RGB_3C_8B} ${IMG_MINISBLACK_1C_8B} ${IMG_PALETTE_1C_8B}" "o-tiff2pdf-threads-strips.tiff"
+f_test_convert "${TIFFCP} -t" "${IMG_MINISWHITE_1C_1B}" "o-tiff2pdf-threads-tiles.tiff"
+f_test_convert "${TIFFCP}" "o-tiff2pdf-threads-strips.tiff o-tiff2pdf-threads-tiles.tiff ${IMG_RGB_3C_8B}" "o-tiff2pdf-threads.tiff"
+f_test_stdout "${TIFF2PDF} -z -e 20260101000000" "o-tiff2pdf-threads.tiff" "o-tiff2pdf-threads.pdf"
+f_test_stdout "${TIFF2PDF} -z -e 20260101000000 -T 2" "o-tiff2pdf-threads.tiff" "o-tiff2pdf-threads-2.pdf"
+echo "cmp o-tiff2pdf-threads.pdf o-tiff2pdf-threads-2.pdf"
+if ! cmp o-tiff2pdf-threads.pdf o-tiff2pdf-threads-2.pdf
+then
+  echo "PDF written on threads differs"
+  exit 1
+fi
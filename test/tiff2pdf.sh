@@ -3,4 +3,5 @@
 # Basic sanity check for tiff2pdf
 #
 . ${srcdir:-.}/common.sh
-f_test_stdout "${TIFF2PDF}" "${IMG_MINISWHITE_1C_1B}" "o-tiff2pdf.pdf"
\ No newline at end of file
+f_test_stdout "${TIFF2PDF}" "${IMG_MINISWHITE_1C_1B}" "o-tiff2pdf.pdf"
+f_test_stdout "${TIFF2PDF} -z" "${IMG_RGB_3C_8B}" "o-tiff2pdf-zip.pdf"
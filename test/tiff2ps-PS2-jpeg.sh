@@ -0,0 +1,6 @@
+#!/bin/sh
+#
+# Basic sanity check for tiffps passing JPEG tiles to PostScript Level 2
+#
+. ${srcdir:-.}/common.sh
+f_test_stdout "${TIFF2PS} -a -p -2" "${IMAGES}/quad-tile.jpg.tiff" "o-tiff2ps-PS2-jpeg.ps"
@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+# Check that tiff2rgba converts the same on one or more threads and
+# with the layout of the input
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${TIFFCP} -c lzw -r 5" "${IMG_RGB_3C_8B}" "o-tiff2rgba-threads-strip.tiff"
+f_test_convert "${TIFFCP} -c zip -t -w 32 -l 16" "${IMG_RGB_3C_8B}" "o-tiff2rgba-threads-tile.tiff"
+for img in strip tile
+do
+  f_test_convert "${TIFF2RGBA} -j 1 -r 7" "o-tiff2rgba-threads-${img}.tiff" "o-tiff2rgba-threads-1.tiff"
+  f_test_convert "${TIFF2RGBA} -j 3 -r 7" "o-tiff2rgba-threads-${img}.tiff" "o-tiff2rgba-threads-3.tiff"
+  echo "cmp o-tiff2rgba-threads-1.tiff o-tiff2rgba-threads-3.tiff"
+  if ! cmp o-tiff2rgba-threads-1.tiff o-tiff2rgba-threads-3.tiff
+  then
+    echo "Image of ${img}s converted on threads differs"
+    exit 1
+  fi
+  f_test_convert "${TIFF2RGBA} -j 3 -b" "o-tiff2rgba-threads-${img}.tiff" "o-tiff2rgba-threads-b.tiff"
+  digest1=`${TIFFCMP} -h o-tiff2rgba-threads-1.tiff | cut -d: -f2-`
+  digestb=`${TIFFCMP} -h o-tiff2rgba-threads-b.tiff | cut -d: -f2-`
+  echo "${digest1} ${digestb}"
+  if test "${digest1}" != "${digestb}"
+  then
+    echo "Image of ${img}s converted by block differs"
+    exit 1
+  fi
+done
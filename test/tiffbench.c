@@ -0,0 +1,553 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Codec benchmark: encode and decode synthetic images in memory with
+ * each configured codec, predictor and strip/tile layout, and report
+ * the throughput as JSON.
+ *
+ *   tiffbench [-q] [-s size] [-t seconds] [-c codec] [-o file]
+ *
+ * -s gives the width and height of the images (default 1024), -t the
+ * minimum time each measurement runs for (default 0.2), -c restricts
+ * the run to one codec, and -o writes the report to a file instead of
+ * the standard output.  -q is a quick run on small images, used as a
+ * smoke test.  Rates are in megabytes of image data per second of
+ * processor time.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tiffio.h"
+
+#define	IMG_PHOTO	0x1		/* 8-bit RGB, smooth with noise */
+#define	IMG_LINEART	0x2		/* 8-bit grey, flat with lines */
+#define	IMG_DEM		0x4		/* 32-bit float elevations */
+#define	IMG_FAX		0x8		/* bilevel, short black runs */
+#define	IMG_ALL		0xf
+
+#define	ROWSPERSTRIP	16
+
+typedef struct {
+	const char*	name;
+	int		kind;
+	uint16		bitspersample;
+	uint16		samplesperpixel;
+	uint16		sampleformat;
+	uint16		photometric;
+} BenchImage;
+
+typedef struct {
+	const char*	name;
+	uint16		compression;
+	int		kinds;		/* images it is run on */
+	int		predictor;	/* takes the Predictor tag */
+	int		lossless;
+	int		tiles;		/* can write tiled images */
+} BenchCodec;
+
+typedef struct {
+	const char*	name;
+	uint32		tilesize;	/* 0 for strips */
+} BenchLayout;
+
+/* The chunks of an image in a layout, each at a stride of chunksize */
+typedef struct {
+	uint32		nchunks;
+	tmsize_t	chunksize;
+	tmsize_t*	sizes;
+	unsigned char*	data;
+} BenchChunks;
+
+static const BenchImage images[] = {
+	{ "photo", IMG_PHOTO, 8, 3, SAMPLEFORMAT_UINT, PHOTOMETRIC_RGB },
+	{ "lineart", IMG_LINEART, 8, 1, SAMPLEFORMAT_UINT,
+	  PHOTOMETRIC_MINISBLACK },
+	{ "dem", IMG_DEM, 32, 1, SAMPLEFORMAT_IEEEFP, PHOTOMETRIC_MINISBLACK },
+	{ "fax", IMG_FAX, 1, 1, SAMPLEFORMAT_UINT, PHOTOMETRIC_MINISWHITE },
+};
+
+static const BenchCodec codecs[] = {
+	{ "none", COMPRESSION_NONE, IMG_ALL, 0, 1, 1 },
+	{ "packbits", COMPRESSION_PACKBITS, IMG_ALL, 0, 1, 1 },
+	{ "lzw", COMPRESSION_LZW, IMG_ALL, 1, 1, 1 },
+	{ "deflate", COMPRESSION_ADOBE_DEFLATE, IMG_ALL, 1, 1, 1 },
+	{ "zstd", COMPRESSION_ZSTD, IMG_ALL, 1, 1, 1 },
+	{ "lz4", COMPRESSION_LZ4, IMG_ALL, 1, 1, 1 },
+	{ "lerc", COMPRESSION_LERC, IMG_PHOTO | IMG_LINEART | IMG_DEM, 0, 1, 1 },
+	{ "webp", COMPRESSION_WEBP, IMG_PHOTO, 0, 0, 1 },
+	{ "lzma", COMPRESSION_LZMA, IMG_ALL, 1, 1, 1 },
+	{ "jpeg", COMPRESSION_JPEG, IMG_PHOTO | IMG_LINEART, 0, 0, 1 },
+	/* PixarLogSetupEncode() sizes its buffer from RowsPerStrip */
+	{ "pixarlog", COMPRESSION_PIXARLOG, IMG_PHOTO, 0, 0, 0 },
+	{ "sgilog", COMPRESSION_SGILOG, IMG_DEM, 0, 0, 1 },
+	{ "g3", COMPRESSION_CCITTFAX3, IMG_FAX, 0, 1, 1 },
+	{ "g4", COMPRESSION_CCITTFAX4, IMG_FAX, 0, 1, 1 },
+};
+
+static const BenchLayout layouts[] = {
+	{ "strip16", 0 },
+	{ "tile64", 64 },
+	{ "tile256", 256 },
+};
+
+static uint32 width = 1024;
+static uint32 length = 1024;
+static double mintime = 0.2;
+
+#define	NITEMS(a)	(sizeof(a) / sizeof((a)[0]))
+
+static uint32
+noise(uint32* state)
+{
+	*state = *state * 1103515245U + 12345U;
+	return (*state >> 16) & 0x7fff;
+}
+
+static tmsize_t
+scanline_size(const BenchImage* img, uint32 w)
+{
+	return (tmsize_t)(((uint64) w * img->bitspersample *
+	    img->samplesperpixel + 7) / 8);
+}
+
+/*
+ * Fill the image, one scanline after the other, with data whose
+ * statistics resemble those of the kind of image it stands for.
+ */
+static void
+fill_image(const BenchImage* img, unsigned char* buf)
+{
+	tmsize_t scanline = scanline_size(img, width);
+	uint32 state = 1;
+	uint32 x, y;
+
+	for (y = 0; y < length; y++) {
+		unsigned char* row = buf + (tmsize_t) y * scanline;
+
+		switch (img->kind) {
+		case IMG_PHOTO:
+			for (x = 0; x < width; x++) {
+				uint32 n = noise(&state) & 7;
+
+				row[3 * x] = (unsigned char)((x + y) / 8 + n);
+				row[3 * x + 1] = (unsigned char)(x / 5 + n);
+				row[3 * x + 2] = (unsigned char)
+				    (255 - y / 6 + (n >> 1));
+			}
+			break;
+		case IMG_LINEART:
+			for (x = 0; x < width; x++)
+				row[x] = (x % 64 < 2 || y % 48 < 2 ||
+				    (x + 2 * y) % 181 < 3) ? 0 : 255;
+			break;
+		case IMG_DEM:
+			for (x = 0; x < width; x++) {
+				float v = 1000.0f +
+				    (float)((x * x + y * 3 * x) % 40000) / 50.0f +
+				    (float)(noise(&state) % 100) / 100.0f;
+
+				memcpy(row + 4 * x, &v, sizeof(v));
+			}
+			break;
+		case IMG_FAX:
+			memset(row, 0, scanline);
+			if (y % 24 < 14) {
+				/* a line of text: runs of black in words */
+				for (x = 0; x < width; x++) {
+					if ((x / 40) % 4 != 3 &&
+					    noise(&state) % 3 == 0)
+						row[x / 8] |= (unsigned char)
+						    (0x80 >> (x % 8));
+				}
+			}
+			break;
+		}
+	}
+}
+
+/*
+ * Split the image into the strips or tiles of the layout.  Tiles past
+ * the edges of the image are padded with zeros.
+ */
+static int
+split_image(const BenchImage* img, const BenchLayout* lay,
+	    const unsigned char* buf, BenchChunks* ch)
+{
+	tmsize_t scanline = scanline_size(img, width);
+	uint32 i;
+
+	if (lay->tilesize == 0) {
+		ch->nchunks = (length + ROWSPERSTRIP - 1) / ROWSPERSTRIP;
+		ch->chunksize = scanline * ROWSPERSTRIP;
+	} else {
+		ch->nchunks = ((width + lay->tilesize - 1) / lay->tilesize) *
+		    ((length + lay->tilesize - 1) / lay->tilesize);
+		ch->chunksize = scanline_size(img, lay->tilesize) *
+		    lay->tilesize;
+	}
+	ch->sizes = (tmsize_t*) malloc(ch->nchunks * sizeof(tmsize_t));
+	ch->data = (unsigned char*) calloc(ch->nchunks, ch->chunksize);
+	if (!ch->sizes || !ch->data) {
+		fprintf (stderr, "Out of memory.\n");
+		return 0;
+	}
+	for (i = 0; i < ch->nchunks; i++) {
+		unsigned char* out = ch->data + (tmsize_t) i * ch->chunksize;
+
+		if (lay->tilesize == 0) {
+			uint32 rows = length - i * ROWSPERSTRIP;
+
+			if (rows > ROWSPERSTRIP)
+				rows = ROWSPERSTRIP;
+			ch->sizes[i] = scanline * rows;
+			memcpy(out, buf + (tmsize_t) i * ch->chunksize,
+			    ch->sizes[i]);
+		} else {
+			uint32 across = (width + lay->tilesize - 1) /
+			    lay->tilesize;
+			uint32 x0 = (i % across) * lay->tilesize;
+			uint32 y0 = (i / across) * lay->tilesize;
+			tmsize_t rowsize = scanline_size(img, lay->tilesize);
+			tmsize_t xoff = scanline_size(img, x0);
+			tmsize_t n = rowsize;
+			uint32 y;
+
+			if (xoff + n > scanline)
+				n = scanline - xoff;
+			for (y = y0; y < y0 + lay->tilesize && y < length; y++)
+				memcpy(out + (tmsize_t)(y - y0) * rowsize,
+				    buf + (tmsize_t) y * scanline + xoff, n);
+			ch->sizes[i] = ch->chunksize;
+		}
+	}
+	return 1;
+}
+
+static void
+free_chunks(BenchChunks* ch)
+{
+	free(ch->sizes);
+	free(ch->data);
+	ch->sizes = NULL;
+	ch->data = NULL;
+}
+
+/*
+ * Set the codec specific fields of a handle, for writing or for reading
+ * back the samples the image was written from.
+ */
+static void
+set_codec_fields(TIFF* tif, const BenchImage* img, const BenchCodec* codec,
+		 int writing)
+{
+	switch (codec->compression) {
+	case COMPRESSION_JPEG:
+		if (img->samplesperpixel == 3) {
+			if (writing)
+				TIFFSetField(tif, TIFFTAG_PHOTOMETRIC,
+				    PHOTOMETRIC_YCBCR);
+			TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE,
+			    JPEGCOLORMODE_RGB);
+		}
+		break;
+	case COMPRESSION_PIXARLOG:
+		TIFFSetField(tif, TIFFTAG_PIXARLOGDATAFMT, PIXARLOGDATAFMT_8BIT);
+		break;
+	case COMPRESSION_SGILOG:
+		if (writing)
+			TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_LOGL);
+		TIFFSetField(tif, TIFFTAG_SGILOGDATAFMT, SGILOGDATAFMT_FLOAT);
+		break;
+	}
+}
+
+static int
+encode_image(const BenchImage* img, const BenchCodec* codec,
+	     uint16 predictor, const BenchLayout* lay, const BenchChunks* ch,
+	     void** pbuf, tmsize_t* psize)
+{
+	TIFF* tif = TIFFOpenMemory(NULL, 0, "w");
+	uint32 i;
+
+	if (!tif)
+		return 0;
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, length);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, img->bitspersample);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, img->samplesperpixel);
+	TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, img->sampleformat);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, img->photometric);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, codec->compression);
+	if (codec->predictor)
+		TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor);
+	set_codec_fields(tif, img, codec, 1);
+	if (lay->tilesize) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, lay->tilesize);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, lay->tilesize);
+	} else
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+	for (i = 0; i < ch->nchunks; i++) {
+		void* data = ch->data + (tmsize_t) i * ch->chunksize;
+
+		if ((lay->tilesize ?
+		     TIFFWriteEncodedTile(tif, i, data, ch->sizes[i]) :
+		     TIFFWriteEncodedStrip(tif, i, data, ch->sizes[i])) == -1) {
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	return TIFFCloseMemory(tif, pbuf, psize);
+}
+
+/*
+ * Decode all chunks of the encoded image into scratch, comparing them
+ * with the source chunks if verify is set.
+ */
+static int
+decode_image(const BenchImage* img, const BenchCodec* codec,
+	     const BenchLayout* lay, const BenchChunks* ch, void* buf,
+	     tmsize_t size, unsigned char* scratch, int verify)
+{
+	TIFF* tif = TIFFOpenMemory(buf, size, "rc");
+	uint32 i;
+
+	if (!tif)
+		return 0;
+	set_codec_fields(tif, img, codec, 0);
+	for (i = 0; i < ch->nchunks; i++) {
+		tmsize_t got = lay->tilesize ?
+		    TIFFReadEncodedTile(tif, i, scratch, ch->chunksize) :
+		    TIFFReadEncodedStrip(tif, i, scratch, ch->chunksize);
+
+		if (got != ch->sizes[i] ||
+		    (verify && memcmp(scratch, ch->data +
+		    (tmsize_t) i * ch->chunksize, got) != 0)) {
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static double
+rate(double bytes, int iterations, double seconds)
+{
+	return seconds > 0 ? bytes * iterations / seconds / 1e6 : 0;
+}
+
+static void
+print_json_string(FILE* out, const char* s)
+{
+	putc('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(out, "\\%c", *s);
+		else if (*s == '\n')
+			fputs("\\n", out);
+		else if ((unsigned char) *s >= 0x20)
+			putc(*s, out);
+	}
+	putc('"', out);
+}
+
+/*
+ * Run one case and print its result; returns 0 if an image could not
+ * be coded or did not decode to its source.
+ */
+static int
+run_case(FILE* out, int* first, const BenchImage* img,
+	 const BenchCodec* codec, uint16 predictor, const BenchLayout* lay,
+	 const BenchChunks* ch)
+{
+	double imagebytes = (double) scanline_size(img, width) * length;
+	unsigned char* scratch;
+	void* buf = NULL;
+	tmsize_t size = 0;
+	int encodes = 0, decodes = 0;
+	clock_t start;
+	double encodetime, decodetime;
+
+	scratch = (unsigned char*) malloc(ch->chunksize);
+	if (!scratch) {
+		fprintf (stderr, "Out of memory.\n");
+		return 0;
+	}
+	start = clock();
+	do {
+		if (buf)
+			_TIFFfree(buf);
+		buf = NULL;
+		if (!encode_image(img, codec, predictor, lay, ch, &buf, &size))
+			goto failure;
+		encodes++;
+		encodetime = (double)(clock() - start) / CLOCKS_PER_SEC;
+	} while (encodetime < mintime);
+	start = clock();
+	do {
+		if (!decode_image(img, codec, lay, ch, buf, size, scratch,
+		    codec->lossless && decodes == 0))
+			goto failure;
+		decodes++;
+		decodetime = (double)(clock() - start) / CLOCKS_PER_SEC;
+	} while (decodetime < mintime);
+
+	fprintf(out, "%s    {\"image\": \"%s\", \"codec\": \"%s\", "
+	    "\"predictor\": %d, \"layout\": \"%s\",\n", *first ? "" : ",\n",
+	    img->name, codec->name, codec->predictor ? predictor : 0,
+	    lay->name);
+	fprintf(out, "     \"imagebytes\": %.0f, \"filebytes\": %ld, "
+	    "\"ratio\": %.3f,\n", imagebytes, (long) size,
+	    size > 0 ? imagebytes / (double) size : 0);
+	fprintf(out, "     \"encode_mbps\": %.2f, \"decode_mbps\": %.2f}",
+	    rate(imagebytes, encodes, encodetime),
+	    rate(imagebytes, decodes, decodetime));
+	*first = 0;
+	_TIFFfree(buf);
+	free(scratch);
+	return 1;
+
+failure:
+	fprintf (stderr, "%s, %s, predictor %d, %s: %s failed.\n", img->name,
+		 codec->name, (int) predictor, lay->name,
+		 buf ? "decoding" : "encoding");
+	if (buf)
+		_TIFFfree(buf);
+	free(scratch);
+	return 0;
+}
+
+static void
+usage(void)
+{
+	fprintf (stderr,
+		 "usage: tiffbench [-q] [-s size] [-t seconds] [-c codec] "
+		 "[-o file]\n");
+	exit(1);
+}
+
+int
+main(int argc, char* argv[])
+{
+	const char* only = NULL;
+	const char* outname = NULL;
+	FILE* out = stdout;
+	int first = 1, ok = 1, i;
+	size_t im, co, la;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-q") == 0) {
+			width = length = 160;
+			mintime = 0;
+		} else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+			width = length = (uint32) atol(argv[++i]);
+			if (width == 0)
+				usage();
+		} else if (i + 1 < argc && strcmp(argv[i], "-t") == 0)
+			mintime = atof(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-c") == 0)
+			only = argv[++i];
+		else if (i + 1 < argc && strcmp(argv[i], "-o") == 0)
+			outname = argv[++i];
+		else
+			usage();
+	}
+	if (outname && (out = fopen(outname, "w")) == NULL) {
+		fprintf (stderr, "Can't create %s.\n", outname);
+		return 1;
+	}
+
+	fputs("{\n  \"version\": ", out);
+	print_json_string(out, TIFFGetVersion());
+	fprintf(out, ",\n  \"width\": %lu, \"height\": %lu, "
+	    "\"mintime\": %.3f,\n  \"results\": [\n",
+	    (unsigned long) width, (unsigned long) length, mintime);
+	for (im = 0; im < NITEMS(images); im++) {
+		const BenchImage* img = &images[im];
+		unsigned char* buf;
+
+		buf = (unsigned char*) malloc(scanline_size(img, width) *
+		    length);
+		if (!buf) {
+			fprintf (stderr, "Out of memory.\n");
+			return 1;
+		}
+		fill_image(img, buf);
+		for (la = 0; la < NITEMS(layouts); la++) {
+			BenchChunks ch;
+
+			memset(&ch, 0, sizeof(ch));
+			if (!split_image(img, &layouts[la], buf, &ch)) {
+				free_chunks(&ch);
+				ok = 0;
+				continue;
+			}
+			for (co = 0; co < NITEMS(codecs); co++) {
+				const BenchCodec* codec = &codecs[co];
+				uint16 predictor;
+
+				if (!(codec->kinds & img->kind) ||
+				    (layouts[la].tilesize && !codec->tiles) ||
+				    !TIFFIsCODECConfigured(codec->compression) ||
+				    (only && strcmp(only, codec->name) != 0))
+					continue;
+				for (predictor = PREDICTOR_NONE;
+				     predictor <= PREDICTOR_FLOATINGPOINT;
+				     predictor++) {
+					if (predictor != PREDICTOR_NONE &&
+					    (!codec->predictor ||
+					     img->kind == IMG_FAX ||
+					     (predictor == PREDICTOR_FLOATINGPOINT)
+					     != (img->kind == IMG_DEM)))
+						continue;
+					if (!run_case(out, &first, img, codec,
+					    predictor, &layouts[la], &ch))
+						ok = 0;
+				}
+			}
+			free_chunks(&ch);
+		}
+		free(buf);
+	}
+	fputs("\n  ]\n}\n", out);
+	if (outname)
+		fclose(out);
+	return ok ? 0 : 1;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
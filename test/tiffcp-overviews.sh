@@ -0,0 +1,9 @@
+#!/bin/sh
+#
+# Basic sanity check for tiffcp writing reduced resolution levels
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${TIFFCP} -t -w 16 -l 16 -O 3" "${IMG_RGB_3C_8B}" "o-tiffcp-overviews.tiff"
+f_tiffinfo_validate "o-tiffcp-overviews.tiff"
+f_test_convert "${TIFFCP} -r 8 -c lzw:2 -O 2:subifd" "${IMG_MINISBLACK_1C_16B}" "o-tiffcp-overviews-subifd.tiff"
+f_test_reader "${TIFFCMP}" "${IMG_MINISBLACK_1C_16B} o-tiffcp-overviews-subifd.tiff"
@@ -0,0 +1,23 @@
+#!/bin/sh
+#
+# Basic sanity check for tiffcp copying compressed tiles without decoding
+#
+. ${srcdir:-.}/common.sh
+infile="$srcdir/images/quad-tile.jpg.tiff"
+outfile="o-tiffcp-raw.tiff"
+f_test_convert "${TIFFCP} -8" $infile $outfile
+f_tiffinfo_validate $outfile
+
+# Old-style LZW strips are recoded, not copied
+compatfile="$srcdir/images/quad-lzw-compat.tiff"
+recodedfile="o-tiffcp-raw-lzw-compat.tiff"
+for opts in "" "-c lzw"
+do
+  f_test_convert "${TIFFCP} $opts" $compatfile $recodedfile
+  f_tiffinfo_validate $recodedfile
+  if ${TIFFINFO} -D $recodedfile 2>&1 | grep "Old-style LZW" > /dev/null
+  then
+    echo "tiffcp $opts kept the old-style LZW codes"
+    exit 1
+  fi
+done
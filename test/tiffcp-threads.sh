@@ -0,0 +1,11 @@
+#!/bin/sh
+#
+# Basic sanity check for tiffcp decoding and encoding on threads
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${TIFFCP} -c lzw" "${IMG_RGB_3C_8B}" "o-tiffcp-threads-lzw.tiff"
+f_test_convert "${TIFFCP} -j 2 -c zip" "o-tiffcp-threads-lzw.tiff" "o-tiffcp-threads-zip.tiff"
+f_test_reader "${TIFFCMP}" "o-tiffcp-threads-lzw.tiff o-tiffcp-threads-zip.tiff"
+f_test_convert "${TIFFCP} -t -w 32 -l 32 -c lzw" "${IMG_RGB_3C_8B}" "o-tiffcp-threads-lzw-tiled.tiff"
+f_test_convert "${TIFFCP} -j 2 -t -w 32 -l 32 -c zip" "o-tiffcp-threads-lzw-tiled.tiff" "o-tiffcp-threads-zip-tiled.tiff"
+f_test_reader "${TIFFCMP}" "o-tiffcp-threads-lzw-tiled.tiff o-tiffcp-threads-zip-tiled.tiff"
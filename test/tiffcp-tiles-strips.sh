@@ -0,0 +1,8 @@
+#!/bin/sh
+#
+# Basic sanity check for tiffcp converting between strips and tiles
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${TIFFCP} -t -w 32 -l 48 -p separate" "${IMG_RGB_3C_8B}" "o-tiffcp-tiles-strips-tiled.tiff"
+f_test_convert "${TIFFCP} -s -r 5 -p contig" "o-tiffcp-tiles-strips-tiled.tiff" "o-tiffcp-tiles-strips.tiff"
+f_test_reader "${TIFFCMP}" "${IMG_RGB_3C_8B} o-tiffcp-tiles-strips.tiff"
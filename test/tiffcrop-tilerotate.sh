@@ -0,0 +1,24 @@
+#!/bin/sh
+#
+# Check that tiffcrop -T rotates into tiles like rotating the whole image
+#
+. ${srcdir:-.}/common.sh
+for image in "${IMG_MINISBLACK_1C_8B}" "${IMG_RGB_3C_16B}"
+do
+  for angle in 90 180 270
+  do
+    base="o-tiffcrop-tilerotate-`basename $image .tiff`-$angle"
+    f_test_convert "${TIFFCROP} -t -w 32 -l 16 -R $angle" $image "$base.tiff"
+    f_test_convert "${TIFFCROP} -t -w 32 -l 16 -T -R $angle" $image "$base-T.tiff"
+    f_tiffinfo_validate "$base-T.tiff"
+    # Compare the pixels without the padding of the edge tiles
+    f_test_convert "${TIFFCP} -s" "$base.tiff" "$base-s.tiff"
+    f_test_convert "${TIFFCP} -s" "$base-T.tiff" "$base-T-s.tiff"
+    echo "cmp $base-s.tiff $base-T-s.tiff"
+    if ! cmp "$base-s.tiff" "$base-T-s.tiff"
+    then
+      echo "Image rotated tile by tile differs"
+      exit 1
+    fi
+  done
+done
@@ -0,0 +1,25 @@
+#!/bin/sh
+#
+# Check that tiff2bw gives the same image for contiguous and separate
+# samples and that tiffdither dithers the same on one or more threads
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${TIFFCP} -p separate -r 1" "${IMG_RGB_3C_8B}" "o-tiffdither-threads-separate.tiff"
+f_test_convert "${TIFF2BW}" "${IMG_RGB_3C_8B}" "o-tiffdither-threads-grey.tiff"
+f_test_convert "${TIFF2BW}" "o-tiffdither-threads-separate.tiff" "o-tiffdither-threads-grey-separate.tiff"
+f_test_stdout "${TIFFCMP} -h" "o-tiffdither-threads-grey.tiff" "o-tiffdither-threads-grey.digest"
+f_test_stdout "${TIFFCMP} -h" "o-tiffdither-threads-grey-separate.tiff" "o-tiffdither-threads-grey-separate.digest"
+echo "compare digests of o-tiffdither-threads-grey.tiff and o-tiffdither-threads-grey-separate.tiff"
+if test "`cut -d: -f2- o-tiffdither-threads-grey.digest`" != "`cut -d: -f2- o-tiffdither-threads-grey-separate.digest`"
+then
+  echo "Greyscale of separate samples differs"
+  exit 1
+fi
+f_test_convert "${TIFFDITHER} -j 1" "o-tiffdither-threads-grey.tiff" "o-tiffdither-threads-1.tiff"
+f_test_convert "${TIFFDITHER} -j 3" "o-tiffdither-threads-grey.tiff" "o-tiffdither-threads-3.tiff"
+echo "cmp o-tiffdither-threads-1.tiff o-tiffdither-threads-3.tiff"
+if ! cmp o-tiffdither-threads-1.tiff o-tiffdither-threads-3.tiff
+then
+  echo "Image dithered on threads differs"
+  exit 1
+fi
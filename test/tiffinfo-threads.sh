@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# Check that tiffinfo -P passes intact images on one or more threads
+# and lists the strips that cannot be decoded
+#
+. ${srcdir:-.}/common.sh
+for img in ${IMG_RGB_3C_8B} ${IMG_QUAD_LZW_COMPAT}
+do
+  for n in 1 3
+  do
+    echo "${TIFFINFO} -P ${n} ${img}"
+    if ! ${TIFFINFO} -P ${n} ${img} > o-tiffinfo-threads.txt
+    then
+      echo "Image ${img} failed the data check on ${n} threads"
+      exit 1
+    fi
+    grep "0 failed" o-tiffinfo-threads.txt || exit 1
+  done
+done
+
+# Garble the data of the first LZW strip
+f_test_convert "${TIFFCP} -c lzw -r 16" "${IMG_RGB_3C_8B}" "o-tiffinfo-threads.tiff"
+dd if=/dev/zero of=o-tiffinfo-threads.tiff bs=1 seek=8 count=64 conv=notrunc
+echo "${TIFFINFO} -P 3 o-tiffinfo-threads.tiff"
+if ${TIFFINFO} -P 3 o-tiffinfo-threads.tiff > o-tiffinfo-threads.txt
+then
+  echo "Garbled data passed the data check"
+  exit 1
+fi
+cat o-tiffinfo-threads.txt
+grep "Strip 0: decode error" o-tiffinfo-threads.txt || exit 1
+grep "1 failed" o-tiffinfo-threads.txt || exit 1
+rm -f o-tiffinfo-threads.txt
@@ -0,0 +1,18 @@
+#!/bin/sh
+#
+# Check that tiffmedian quantizes and dithers the same on one or more
+# threads
+#
+. ${srcdir:-.}/common.sh
+f_test_convert "${TIFFCP} -c lzw -r 4" "${IMG_RGB_3C_8B}" "o-tiffmedian-threads-lzw.tiff"
+for opts in "" "-f" "-f -C 40"
+do
+  f_test_convert "${TIFFMEDIAN} -j 1 ${opts}" "o-tiffmedian-threads-lzw.tiff" "o-tiffmedian-threads-1.tiff"
+  f_test_convert "${TIFFMEDIAN} -j 3 ${opts}" "o-tiffmedian-threads-lzw.tiff" "o-tiffmedian-threads-3.tiff"
+  echo "cmp o-tiffmedian-threads-1.tiff o-tiffmedian-threads-3.tiff"
+  if ! cmp o-tiffmedian-threads-1.tiff o-tiffmedian-threads-3.tiff
+  then
+    echo "Image quantized on threads (${opts}) differs"
+    exit 1
+  fi
+done
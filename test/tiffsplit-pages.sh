@@ -0,0 +1,24 @@
+#!/bin/sh
+#
+# Check tiffsplit -N
+#
+# First we use tiffcp to join our test files into a multi-frame TIFF,
+# then we split out all pages and then only some of them, which must
+# be given the same names and contents.
+#
+. ${srcdir:-.}/common.sh
+conjoined=o-tiffsplit-pages-conjoined.tif
+splitfile=o-tiffsplit-pages-split-
+pagefile=o-tiffsplit-pages-page-
+
+f_test_convert "${TIFFCP}" "${IMG_UNCOMPRESSED}" "${conjoined}"
+f_test_convert "${TIFFSPLIT}" "${conjoined}" "${splitfile}"
+f_test_convert "${TIFFSPLIT} -N 2,4-5,last" "${conjoined}" "${pagefile}"
+for page in aab aad aae aah
+do
+  if ! cmp -s "${pagefile}${page}.tif" "${splitfile}${page}.tif"
+  then
+    echo "Page ${page} differs from the full split"
+    exit 1
+  fi
+done
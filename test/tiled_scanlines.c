@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check that TIFFWriteScanline() writes tiled images, gathering a row
+ * of tiles before encoding it, for contiguous, separate and bilevel
+ * images, and that an incomplete image is flushed on close.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "tiled_scanlines.tif";
+
+#define	WIDTH		100
+#define	LENGTH		70
+#define	TILEWIDTH	32
+#define	TILELENGTH	16
+
+typedef struct {
+	const char*	name;
+	uint16		spp;
+	uint16		bps;
+	uint16		planar;
+	uint16		compression;
+} Layout;
+
+static const Layout layouts[] = {
+	{ "contig RGB", 3, 8, PLANARCONFIG_CONTIG, COMPRESSION_LZW },
+	{ "separate", 2, 8, PLANARCONFIG_SEPARATE, COMPRESSION_ADOBE_DEFLATE },
+	{ "bilevel", 1, 1, PLANARCONFIG_CONTIG, COMPRESSION_PACKBITS },
+	{ "uncompressed", 1, 16, PLANARCONFIG_CONTIG, COMPRESSION_NONE },
+};
+
+/*
+ * Row y of a plane (all samples if contiguous), written with scanline
+ * bytes per row.
+ */
+static void
+make_row(const Layout* l, unsigned char* buf, tmsize_t scanline, uint32 y,
+	 uint16 plane)
+{
+	uint32 x;
+	uint16 s;
+
+	memset(buf, 0, scanline);
+	for (x = 0; x < WIDTH; x++) {
+		if (l->bps == 1) {
+			if ((x + y) % 3 == 0)
+				buf[x / 8] |= (unsigned char)(0x80 >> (x % 8));
+			continue;
+		}
+		for (s = 0; s < l->spp; s++) {
+			unsigned char v = (unsigned char)
+			    ((x * 3 + y * 5 + s * 70 + plane * 40) & 0xff);
+
+			if (l->planar == PLANARCONFIG_SEPARATE) {
+				if (s == 0)
+					buf[x * (l->bps / 8)] = v;
+			} else
+				buf[(x * l->spp + s) * (l->bps / 8)] = v;
+		}
+	}
+}
+
+static TIFF*
+create(const Layout* l)
+{
+	TIFF* tif = TIFFOpen(filename, "w");
+
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return NULL;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, l->bps);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, l->spp);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, l->planar);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, l->spp == 3 ?
+		     PHOTOMETRIC_RGB : PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, l->compression);
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILEWIDTH);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, TILELENGTH);
+	return tif;
+}
+
+/*
+ * Write the first nrows rows; separate planes row by row, so that all
+ * bands are held at the same time.
+ */
+static int
+write_rows(const Layout* l, uint32 nrows)
+{
+	unsigned char* buf;
+	tmsize_t scanline;
+	uint16 plane, nplanes;
+	uint32 y;
+	TIFF* tif = create(l);
+
+	if (!tif)
+		return 0;
+	nplanes = l->planar == PLANARCONFIG_SEPARATE ? l->spp : 1;
+	scanline = TIFFScanlineSize(tif);
+	buf = (unsigned char*) malloc(scanline);
+	if (!buf)
+		goto failure;
+	for (y = 0; y < nrows; y++)
+		for (plane = 0; plane < nplanes; plane++) {
+			make_row(l, buf, scanline, y, plane);
+			if (TIFFWriteScanline(tif, buf, y, plane) != 1) {
+				fprintf (stderr, "%s: can't write row %lu.\n",
+					 l->name, (unsigned long) y);
+				goto failure;
+			}
+		}
+	/* rows have to come in order */
+	if (nrows > 0 && nrows < LENGTH &&
+	    TIFFWriteScanline(tif, buf, nrows + 1, 0) != -1) {
+		fprintf (stderr, "%s: a row was skipped.\n", l->name);
+		goto failure;
+	}
+	free(buf);
+	TIFFClose(tif);
+	return 1;
+
+failure:
+	free(buf);
+	TIFFClose(tif);
+	return 0;
+}
+
+/*
+ * Compare every tile with the rows written, which are followed by zeros.
+ */
+static int
+check_tiles(const Layout* l, uint32 nrows)
+{
+	unsigned char *tile = NULL, *row = NULL;
+	tmsize_t scanline, tilerow, n;
+	uint32 across, down, t, ntiles, y;
+	TIFF* tif = TIFFOpen(filename, "r");
+	int ret = 0;
+
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	scanline = TIFFScanlineSize(tif);
+	tilerow = TIFFTileRowSize(tif);
+	across = (WIDTH + TILEWIDTH - 1) / TILEWIDTH;
+	down = (LENGTH + TILELENGTH - 1) / TILELENGTH;
+	ntiles = TIFFNumberOfTiles(tif);
+	tile = (unsigned char*) malloc(TIFFTileSize(tif));
+	row = (unsigned char*) malloc(scanline);
+	if (!tile || !row)
+		goto failure;
+	for (t = 0; t < ntiles; t++) {
+		uint16 plane = (uint16)(t / (across * down));
+		uint32 c = t % across, r = (t / across) % down;
+		tmsize_t off = (tmsize_t) c * tilerow;
+
+		if (TIFFReadEncodedTile(tif, t, tile, -1) != TIFFTileSize(tif)) {
+			fprintf (stderr, "%s: can't read tile %lu.\n",
+				 l->name, (unsigned long) t);
+			goto failure;
+		}
+		n = scanline - off < tilerow ? scanline - off : tilerow;
+		for (y = 0; y < TILELENGTH; y++) {
+			uint32 iy = r * TILELENGTH + y;
+
+			if (iy < nrows)
+				make_row(l, row, scanline, iy, plane);
+			else
+				memset(row, 0, scanline);
+			if (memcmp(tile + y * tilerow, row + off, n) != 0) {
+				fprintf (stderr, "%s: tile %lu differs in "
+					 "row %lu.\n", l->name,
+					 (unsigned long) t, (unsigned long) iy);
+				goto failure;
+			}
+		}
+	}
+	ret = 1;
+
+failure:
+	free(tile);
+	free(row);
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+		const Layout* l = &layouts[i];
+
+		if (!TIFFIsCODECConfigured(l->compression))
+			continue;
+		if (!write_rows(l, LENGTH) || !check_tiles(l, LENGTH))
+			return 1;
+		/* an incomplete row of tiles is written on close */
+		if (!write_rows(l, 2 * TILELENGTH + 5) ||
+		    !check_tiles(l, 2 * TILELENGTH + 5))
+			return 1;
+	}
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the events reported to the callback of TIFFSetTraceCallback()
+ * when writing and reading a tiled image, serially and in parallel.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+#include "test_image.h"
+
+static const char filename[] = "trace.tif";
+
+#define	WIDTH		128
+#define	LENGTH		96
+#define	TILESIZE	32
+#define	NTILES		((WIDTH / TILESIZE) * (LENGTH / TILESIZE))
+#define	NTHREADS	3
+
+typedef struct {
+	TIFF*	tif;
+	int	badhandle;		/* events for another handle */
+	int	open[6];		/* stages begun and not ended */
+	int	ended[6];		/* stages ended */
+	int	failed;
+	int	badstrile;
+	uint32	tilesdecoded[NTILES];
+} TraceLog;
+
+static void
+record_event(TIFF* tif, void* clientdata, int stage, int phase,
+	     uint32 strile, uint64 bytes)
+{
+	TraceLog* log = (TraceLog*) clientdata;
+
+	if (tif != log->tif)
+		log->badhandle++;
+	if (stage < TIFF_TRACE_FILL || stage > TIFF_TRACE_WRITEDIR)
+		return;
+	if ((stage == TIFF_TRACE_FILL || stage == TIFF_TRACE_DECODE ||
+	     stage == TIFF_TRACE_ENCODE) && (strile >= NTILES || bytes == 0))
+		log->badstrile++;
+	switch (phase) {
+	case TIFF_TRACE_BEGIN:
+		log->open[stage]++;
+		break;
+	case TIFF_TRACE_END:
+		log->open[stage]--;
+		log->ended[stage]++;
+		if (stage == TIFF_TRACE_DECODE && strile < NTILES)
+			log->tilesdecoded[strile]++;
+		break;
+	default:
+		log->open[stage]--;
+		log->failed++;
+		break;
+	}
+}
+
+/*
+ * Called from the decoding threads: only touch the counter of the tile,
+ * which is decoded by a single thread.
+ */
+static void
+record_parallel(TIFF* tif, void* clientdata, int stage, int phase,
+		uint32 strile, uint64 bytes)
+{
+	TraceLog* log = (TraceLog*) clientdata;
+
+	(void) bytes;
+	if (tif == log->tif && stage == TIFF_TRACE_DECODE &&
+	    phase == TIFF_TRACE_END && strile < NTILES)
+		log->tilesdecoded[strile]++;
+}
+
+static int
+check_log(const TraceLog* log, const char* what, int fills, int decodes,
+	  int encodes, int readdirs, int writedirs)
+{
+	int i;
+
+	for (i = TIFF_TRACE_FILL; i <= TIFF_TRACE_WRITEDIR; i++) {
+		if (log->open[i] != 0) {
+			fprintf (stderr, "%s: stage %d not ended.\n", what, i);
+			return 0;
+		}
+	}
+	if (log->badhandle || log->badstrile || log->failed) {
+		fprintf (stderr, "%s: unexpected events.\n", what);
+		return 0;
+	}
+	if (log->ended[TIFF_TRACE_FILL] != fills ||
+	    log->ended[TIFF_TRACE_DECODE] != decodes ||
+	    log->ended[TIFF_TRACE_ENCODE] != encodes ||
+	    log->ended[TIFF_TRACE_READDIR] != readdirs ||
+	    log->ended[TIFF_TRACE_WRITEDIR] != writedirs) {
+		fprintf (stderr, "%s: got %d/%d/%d/%d/%d events.\n", what,
+			 log->ended[TIFF_TRACE_FILL],
+			 log->ended[TIFF_TRACE_DECODE],
+			 log->ended[TIFF_TRACE_ENCODE],
+			 log->ended[TIFF_TRACE_READDIR],
+			 log->ended[TIFF_TRACE_WRITEDIR]);
+		return 0;
+	}
+	return 1;
+}
+
+static void
+fill_tile(TestChunk* c, void* arg)
+{
+	int i;
+
+	(void) arg;
+	for (i = 0; i < (int) c->size; i++)
+		c->buf[i] = (unsigned char)(i / 5 + c->index * 3);
+}
+
+static int
+write_image(void)
+{
+	TestImage im = { WIDTH, LENGTH, 8, 1, PLANARCONFIG_CONTIG,
+	    PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, 0, TILESIZE, TILESIZE };
+	TIFF* tif;
+	TraceLog log;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	memset(&log, 0, sizeof(log));
+	log.tif = tif;
+	TIFFSetTraceCallback(tif, record_event, &log);
+	set_image_fields(tif, &im);
+	if (!write_image_data(tif, fill_tile, NULL)) {
+		TIFFClose(tif);
+		return 0;
+	}
+	if (!TIFFWriteDirectory(tif)) {
+		fprintf (stderr, "Can't write the directory.\n");
+		TIFFClose(tif);
+		return 0;
+	}
+	TIFFClose(tif);
+	return check_log(&log, "write", 0, 0, NTILES, 0, 1);
+}
+
+static int
+read_image(const char* mode)
+{
+	TIFF* tif;
+	TraceLog log;
+	unsigned char buf[TILESIZE * TILESIZE];
+	uint32 list[NTILES];
+	void* bufs[NTILES];
+	uint32 t;
+	int ret = 0;
+
+	memset(bufs, 0, sizeof(bufs));
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	memset(&log, 0, sizeof(log));
+	log.tif = tif;
+	TIFFSetTraceCallback(tif, record_event, &log);
+	if (!TIFFSetDirectory(tif, 0))
+		goto failure;
+	for (t = 0; t < NTILES; t++) {
+		if (TIFFReadEncodedTile(tif, t, buf, sizeof(buf)) == -1) {
+			fprintf (stderr, "Can't read tile %lu.\n",
+				 (unsigned long) t);
+			goto failure;
+		}
+	}
+	if (!check_log(&log, mode, NTILES, NTILES, 0, 1, 0))
+		goto failure;
+
+	for (t = 0; t < NTILES; t++) {
+		list[t] = t;
+		bufs[t] = malloc(sizeof(buf));
+		if (!bufs[t])
+			goto failure;
+	}
+	memset(&log, 0, sizeof(log));
+	log.tif = tif;
+	TIFFSetTraceCallback(tif, record_parallel, &log);
+	if (!TIFFReadEncodedTilesParallel(tif, list, NTILES, bufs, -1,
+					  NTHREADS)) {
+		fprintf (stderr, "Parallel decoding failed.\n");
+		goto failure;
+	}
+	for (t = 0; t < NTILES; t++) {
+		if (log.tilesdecoded[t] != 1) {
+			fprintf (stderr, "Tile %lu decoded %lu times.\n",
+				 (unsigned long) t,
+				 (unsigned long) log.tilesdecoded[t]);
+			goto failure;
+		}
+	}
+
+	/* No more events once the callback is removed */
+	memset(&log, 0, sizeof(log));
+	TIFFSetTraceCallback(tif, NULL, NULL);
+	if (TIFFReadEncodedTile(tif, 0, buf, sizeof(buf)) == -1 ||
+	    log.ended[TIFF_TRACE_DECODE] != 0 || log.badhandle) {
+		fprintf (stderr, "Events after removing the callback.\n");
+		goto failure;
+	}
+	ret = 1;
+
+failure:
+	for (t = 0; t < NTILES; t++)
+		free(bufs[t]);
+	TIFFClose(tif);
+	return ret;
+}
+
+int
+main()
+{
+	if (!write_image() || !read_image("r") || !read_image("rm"))
+		return 1;
+	unlink(filename);
+	return 0;
+}
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check TIFFUnpackSamples8() and TIFFUnpackSamples16() against a plain
+ * bit extraction for every sample size, option and length up to a few
+ * vectors, with the optimized code and with the portable code only.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiffio.h"
+
+#define	MAXSAMPLES	300
+#define	SRCSIZE		(MAXSAMPLES * 2 + 16)
+
+static uint32
+extract(const unsigned char* src, tmsize_t i, int bps)
+{
+	uint32 v = 0;
+	tmsize_t bit;
+
+	if (bps == 16)
+		return ((const uint16*) src)[i];
+	for (bit = i * bps; bit < (i + 1) * bps; bit++)
+		v = (v << 1) | ((src[bit / 8] >> (7 - bit % 8)) & 1);
+	return (v);
+}
+
+static uint32
+expected(uint32 v, int bps, int flags, int outbits)
+{
+	uint32 max = ((uint32) 1 << bps) - 1;
+
+	if (flags & TIFF_UNPACK_SCALE) {
+		uint32 omax = ((uint32) 1 << outbits) - 1;
+		/* bit replication rounds 12 to 16 bits slightly differently */
+		v = bps == 12 ? (v << 4) | (v >> 8) : v * (omax / max);
+		max = omax;
+	}
+	if (flags & TIFF_UNPACK_INVERT)
+		v = max - v;
+	return (v);
+}
+
+static int
+check(const unsigned char* src, int bps, int outbits, int flags,
+      int usemap, const uint16* map)
+{
+	static uint8 map8[256];
+	uint8 got8[MAXSAMPLES + 1];
+	uint16 got16[MAXSAMPLES + 1];
+	tmsize_t n, i;
+	uint32 v, want;
+	int j;
+
+	for (j = 0; j < 256; j++)
+		map8[j] = (uint8) (255 - j * 7);
+	for (n = 0; n <= MAXSAMPLES; n++) {
+		got8[n] = 0x5a;
+		got16[n] = 0x5a5a;
+		if (outbits == 8 ? !TIFFUnpackSamples8(got8, src, n, (uint16) bps,
+		    flags, usemap ? map8 : NULL) :
+		    !TIFFUnpackSamples16(got16, src, n, (uint16) bps, flags,
+		    usemap ? map : NULL)) {
+			fprintf(stderr, "%d-bit samples to %d bits refused.\n",
+			    bps, outbits);
+			return 0;
+		}
+		for (i = 0; i <= n; i++) {
+			v = outbits == 8 ? got8[i] : got16[i];
+			if (i == n)
+				want = outbits == 8 ? 0x5a : 0x5a5a;
+			else if (usemap)
+				want = outbits == 8 ? map8[extract(src, i, bps)] :
+				    map[extract(src, i, bps)];
+			else
+				want = expected(extract(src, i, bps), bps,
+				    flags, outbits);
+			if (v != want) {
+				fprintf(stderr, "%d-bit samples to %d bits, "
+				    "flags %d%s: sample %lu of %lu is %lu, "
+				    "expected %lu.\n", bps, outbits, flags,
+				    usemap ? ", mapped" : "",
+				    (unsigned long) i, (unsigned long) n,
+				    (unsigned long) v, (unsigned long) want);
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+int
+main()
+{
+	static const int bps8[] = { 1, 2, 4, 8 };
+	static const int bps16[] = { 1, 2, 4, 8, 12, 16 };
+	unsigned char* src = (unsigned char*) malloc(SRCSIZE);
+	uint16* map = (uint16*) malloc(65536 * sizeof (uint16));
+	uint16 dummy;
+	int pass, i, flags;
+
+	if (!src || !map) {
+		fprintf (stderr, "Out of memory.\n");
+		return 1;
+	}
+	for (i = 0; i < SRCSIZE; i++)
+		src[i] = (unsigned char)(i * 37 + (i >> 3) * 11);
+	for (i = 0; i < 65536; i++)
+		map[i] = (uint16)(i * 40503);
+	/* the optimized code paths first, then the portable ones */
+	for (pass = 0; pass < 2; pass++) {
+		if (pass == 1)
+			TIFFSetCPUFeatures(0);
+		for (flags = 0; flags < 4; flags++) {
+			for (i = 0; i < 4; i++) {
+				if (!check(src, bps8[i], 8, flags, 0, NULL))
+					return 1;
+				if (flags == 0 &&
+				    !check(src, bps8[i], 8, 0, 1, NULL))
+					return 1;
+			}
+			for (i = 0; i < 6; i++) {
+				if (!check(src, bps16[i], 16, flags, 0, NULL))
+					return 1;
+				if (flags == 0 &&
+				    !check(src, bps16[i], 16, 0, 1, map))
+					return 1;
+			}
+		}
+	}
+	if (TIFFUnpackSamples8(&src[0], &src[1], 1, 12, 0, NULL) ||
+	    TIFFUnpackSamples16(&dummy, src, 1, 3, 0, NULL)) {
+		fprintf(stderr, "Unsupported sample size accepted.\n");
+		return 1;
+	}
+	TIFFSetCPUFeatures(TIFF_CPU_ALL);
+	free(src);
+	free(map);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
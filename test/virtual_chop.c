@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that a single uncompressed tile is read as a column of smaller
+ * tiles, and that the scanlines of a large compressed single strip are
+ * read without loading the whole strip.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "virtual_chop.tif";
+
+#define	TWIDTH		200
+#define	TLENGTH		300
+#define	TILEWIDTH	208
+#define	TILELENGTH	304
+
+#define	SWIDTH		1024
+#define	SLENGTH		1200
+
+static unsigned char
+pixel(uint32 x, uint32 y)
+{
+	return (unsigned char)((x * 3 + y * 7 + (x * y) / 11) & 0xff);
+}
+
+/* Poorly compressible data, so that the strip is large */
+static unsigned char
+noise(uint32 x, uint32 y)
+{
+	uint32 v = (x + 1) * 2654435761U ^ (y + 1) * 40503U;
+
+	v ^= v >> 15;
+	v *= 2246822519U;
+	v ^= v >> 13;
+	return (unsigned char) v;
+}
+
+static int
+write_tile(void)
+{
+	TIFF* tif;
+	unsigned char* buf;
+	uint32 x, y;
+	int ok;
+
+	buf = (unsigned char*) calloc(TILEWIDTH * TILELENGTH * 3, 1);
+	if (!buf)
+		return 0;
+	for (y = 0; y < TLENGTH; y++)
+		for (x = 0; x < TWIDTH * 3; x++)
+			buf[(y * TILEWIDTH) * 3 + x] = pixel(x, y);
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		free(buf);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, TWIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, TLENGTH);
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILEWIDTH);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, TILELENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	ok = TIFFWriteTile(tif, buf, 0, 0, 0, 0) != -1;
+	TIFFClose(tif);
+	free(buf);
+	if (!ok)
+		fprintf (stderr, "Can't write the tile.\n");
+	return ok;
+}
+
+static int
+check_tile(const char* mode, int chopped)
+{
+	TIFF* tif;
+	unsigned char* buf = NULL;
+	uint32 tilelength, x, y, row;
+	int ok = 0;
+
+	tif = TIFFOpen(filename, mode);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	TIFFGetField(tif, TIFFTAG_TILELENGTH, &tilelength);
+	if (chopped ? (tilelength >= TILELENGTH || TILELENGTH % tilelength != 0 ||
+		       TIFFNumberOfTiles(tif) != (TLENGTH + tilelength - 1) / tilelength)
+	    : (tilelength != TILELENGTH || TIFFNumberOfTiles(tif) != 1)) {
+		fprintf (stderr, "%s: unexpected tile length %lu, %lu tiles.\n",
+			 mode, (unsigned long) tilelength,
+			 (unsigned long) TIFFNumberOfTiles(tif));
+		goto done;
+	}
+	buf = (unsigned char*) malloc(TIFFTileSize(tif));
+	if (!buf)
+		goto done;
+	for (row = 0; row < TLENGTH; row += tilelength) {
+		if (TIFFReadTile(tif, buf, 0, row, 0, 0) == -1) {
+			fprintf (stderr, "%s: can't read tile at row %lu.\n",
+				 mode, (unsigned long) row);
+			goto done;
+		}
+		for (y = row; y < row + tilelength && y < TLENGTH; y++) {
+			for (x = 0; x < TWIDTH * 3; x++) {
+				if (buf[((y - row) * TILEWIDTH) * 3 + x] !=
+				    pixel(x, y)) {
+					fprintf (stderr, "%s: wrong sample at "
+						 "%lu,%lu.\n", mode,
+						 (unsigned long) x,
+						 (unsigned long) y);
+					goto done;
+				}
+			}
+		}
+	}
+	ok = 1;
+done:
+	free(buf);
+	TIFFClose(tif);
+	return ok;
+}
+
+static int
+write_strip(uint16 compression)
+{
+	TIFF* tif;
+	unsigned char buf[SWIDTH];
+	uint32 x, y;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, SWIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, SLENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, compression);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, SLENGTH);
+	for (y = 0; y < SLENGTH; y++) {
+		for (x = 0; x < SWIDTH; x++)
+			buf[x] = noise(x, y);
+		if (TIFFWriteScanline(tif, buf, y, 0) == -1) {
+			fprintf (stderr, "Can't write row %lu.\n",
+				 (unsigned long) y);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+check_strip(const char* what, const char* mode)
+{
+	TIFFOpenOptions* opts;
+	TIFF* tif;
+	unsigned char buf[SWIDTH];
+	tmsize_t peak;
+	uint64 bytecount;
+	uint32 x, y;
+	int ok = 0;
+
+	/* Options make the handle keep track of its memory */
+	opts = TIFFOpenOptionsAlloc();
+	if (!opts)
+		return 0;
+	tif = TIFFOpenExt(filename, mode, opts);
+	TIFFOpenOptionsFree(opts);
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	bytecount = TIFFGetStrileByteCount(tif, 0);
+	if (bytecount <= 1024 * 1024) {
+		fprintf (stderr, "%s: strip of " TIFF_UINT64_FORMAT
+			 " bytes is too small for the test.\n", what,
+			 (TIFF_UINT64_T) bytecount);
+		goto done;
+	}
+	for (y = 0; y < SLENGTH; y++) {
+		if (TIFFReadScanline(tif, buf, y, 0) == -1) {
+			fprintf (stderr, "%s: can't read row %lu.\n", what,
+				 (unsigned long) y);
+			goto done;
+		}
+		for (x = 0; x < SWIDTH; x++) {
+			if (buf[x] != noise(x, y)) {
+				fprintf (stderr, "%s: wrong pixel at %lu,%lu.\n",
+					 what, (unsigned long) x,
+					 (unsigned long) y);
+				goto done;
+			}
+		}
+	}
+	/* Going back restarts the strip from its first piece */
+	if (TIFFReadScanline(tif, buf, 0, 0) == -1 || buf[1] != noise(1, 0)) {
+		fprintf (stderr, "%s: can't read row 0 again.\n", what);
+		goto done;
+	}
+	TIFFGetMemoryUsage(tif, NULL, &peak);
+	if ((uint64) peak >= bytecount / 2) {
+		fprintf (stderr, "%s: " TIFF_SSIZE_FORMAT " bytes used for a "
+			 TIFF_UINT64_FORMAT " byte strip.\n", what, peak,
+			 (TIFF_UINT64_T) bytecount);
+		goto done;
+	}
+	/* Checkpoints outside the loaded piece reload the raw data */
+	if (!TIFFSetScanlineCheckpoints(tif, 64))
+		goto done;
+	for (x = 0; x * 97 < SLENGTH; x++) {
+		y = SLENGTH - 1 - x * 97;
+		if (TIFFReadScanline(tif, buf, y, 0) == -1 ||
+		    buf[SWIDTH - 1] != noise(SWIDTH - 1, y)) {
+			fprintf (stderr, "%s: can't seek to row %lu.\n", what,
+				 (unsigned long) y);
+			goto done;
+		}
+	}
+	ok = 1;
+done:
+	TIFFClose(tif);
+	return ok;
+}
+
+int
+main()
+{
+	int ret = 1;
+
+	if (!write_tile() || !check_tile("r", 1) || !check_tile("rc", 0))
+		goto done;
+	/* Mapped files are decoded in place, the others piecewise */
+	if (!write_strip(COMPRESSION_LZW) || !check_strip("LZW", "r") ||
+	    !check_strip("LZW", "rm"))
+		goto done;
+	if (TIFFIsCODECConfigured(COMPRESSION_ADOBE_DEFLATE) &&
+	    (!write_strip(COMPRESSION_ADOBE_DEFLATE) ||
+	     !check_strip("Deflate", "r") || !check_strip("Deflate", "rm")))
+		goto done;
+	ret = 0;
+done:
+	unlink(filename);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
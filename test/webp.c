@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * TIFF Library
+ *
+ * Check the WebP codec: lossless RGBA tiles, transparent pixels
+ * included, and lossless RGB strips written and read a scanline at a
+ * time must read back unchanged, lossy tiles must stay close to the
+ * original and be smaller, and layouts WebP cannot store are rejected.
+ * Does nothing if the library is built without WebP support.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "webp.tif";
+
+#define	WIDTH		200	/* last column of tiles is partial */
+#define	LENGTH		150
+#define	ROWSPERSTRIP	40
+#define	TILESIZE	64
+
+static unsigned char image[WIDTH * LENGTH * 4];
+
+/* Smooth gradients with some noise, and an alpha channel with holes */
+static void
+fill_image(void)
+{
+	uint32 seed = 7;
+	uint32 x, y;
+	unsigned char* p = image;
+
+	for (y = 0; y < LENGTH; y++)
+		for (x = 0; x < WIDTH; x++) {
+			seed = seed * 1103515245 + 12345;
+			*p++ = (unsigned char) (x + ((seed >> 16) & 3));
+			*p++ = (unsigned char) (y + ((seed >> 18) & 3));
+			*p++ = (unsigned char) ((x + y) / 2);
+			*p++ = (x / 16 + y / 16) % 5 == 0 ? 0 : 255;
+		}
+}
+
+typedef struct {
+	int tiled;
+	int nsamples;
+	int lossless;
+	int level;
+} options_t;
+
+/* Copy pixels between the image and a buffer of nsamples per pixel */
+static void
+copy_pixels(unsigned char* dst, const unsigned char* src, uint32 npixels,
+	    int nsamples, int to_image)
+{
+	uint32 i;
+
+	for (i = 0; i < npixels; i++)
+		if (to_image)
+			memcpy(dst + i * 4, src + i * nsamples, nsamples);
+		else
+			memcpy(dst + i * nsamples, src + i * 4, nsamples);
+}
+
+/*
+ * Write the image, read it back into out and return the file size, or
+ * 0 on failure.
+ */
+static long
+round_trip(const options_t* opt, unsigned char* out)
+{
+	TIFF* tif;
+	unsigned char buf[TILESIZE * TILESIZE * 4];
+	uint32 row, x, y, w;
+	int level, n = opt->nsamples;
+	long size = 0;
+	FILE* fd;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, n);
+	if (n == 4) {
+		uint16 extra = EXTRASAMPLE_UNASSALPHA;
+		TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, 1, &extra);
+	}
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_WEBP);
+	TIFFSetField(tif, TIFFTAG_WEBP_LOSSLESS, opt->lossless);
+	if (!TIFFSetField(tif, TIFFTAG_WEBP_LEVEL, opt->level) ||
+	    !TIFFGetField(tif, TIFFTAG_WEBP_LEVEL, &level) ||
+	    level != opt->level) {
+		fprintf (stderr, "Can't set WebP level %d.\n", opt->level);
+		goto failure;
+	}
+	if (opt->tiled) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+		for (y = 0; y < LENGTH; y += TILESIZE)
+			for (x = 0; x < WIDTH; x += TILESIZE) {
+				w = WIDTH - x < TILESIZE ? WIDTH - x : TILESIZE;
+				memset(buf, 0, sizeof(buf));
+				for (row = 0; row < TILESIZE &&
+				     y + row < LENGTH; row++)
+					copy_pixels(buf + row * TILESIZE * n,
+					    image + ((y + row) * WIDTH + x) * 4,
+					    w, n, 0);
+				if (TIFFWriteTile(tif, buf, x, y, 0, 0) == -1)
+					goto failure;
+			}
+	} else {
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+		for (y = 0; y < LENGTH; y++) {
+			copy_pixels(buf, image + y * WIDTH * 4, WIDTH, n, 0);
+			if (TIFFWriteScanline(tif, buf, y, 0) == -1)
+				goto failure;
+		}
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	memcpy(out, image, sizeof(image));
+	if (opt->tiled) {
+		for (y = 0; y < LENGTH; y += TILESIZE)
+			for (x = 0; x < WIDTH; x += TILESIZE) {
+				w = WIDTH - x < TILESIZE ? WIDTH - x : TILESIZE;
+				if (TIFFReadTile(tif, buf, x, y, 0, 0) == -1)
+					goto failure;
+				for (row = 0; row < TILESIZE &&
+				     y + row < LENGTH; row++)
+					copy_pixels(out + ((y + row) * WIDTH + x) * 4,
+					    buf + row * TILESIZE * n, w, n, 1);
+			}
+	} else {
+		for (y = 0; y < LENGTH; y++) {
+			if (TIFFReadScanline(tif, buf, y, 0) == -1)
+				goto failure;
+			copy_pixels(out + y * WIDTH * 4, buf, WIDTH, n, 1);
+		}
+	}
+	TIFFClose(tif);
+
+	fd = fopen(filename, "rb");
+	if (fd) {
+		fseek(fd, 0, SEEK_END);
+		size = ftell(fd);
+		fclose(fd);
+	}
+	return size;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+/* Mean absolute difference of the colour samples */
+static double
+mean_error(const unsigned char* out)
+{
+	double sum = 0;
+	uint32 i;
+
+	for (i = 0; i < WIDTH * LENGTH * 4; i++)
+		if (i % 4 != 3)
+			sum += abs((int) out[i] - (int) image[i]);
+	return sum / (WIDTH * LENGTH * 3);
+}
+
+int
+main()
+{
+	static unsigned char out[WIDTH * LENGTH * 4];
+	options_t opt;
+	long lossless, lossy;
+	double err;
+	TIFF* tif;
+
+	if (!TIFFIsCODECConfigured(COMPRESSION_WEBP))
+		return 0;
+	fill_image();
+
+	opt.tiled = 1;
+	opt.nsamples = 4;
+	opt.lossless = 1;
+	opt.level = 75;
+	lossless = round_trip(&opt, out);
+	if (!lossless)
+		return 1;
+	if (memcmp(out, image, sizeof(image)) != 0) {
+		fprintf (stderr, "Lossless RGBA tiles differ.\n");
+		return 1;
+	}
+
+	opt.tiled = 0;
+	opt.nsamples = 3;
+	opt.level = 20;
+	if (!round_trip(&opt, out))
+		return 1;
+	if (memcmp(out, image, sizeof(image)) != 0) {
+		fprintf (stderr, "Lossless RGB strips differ.\n");
+		return 1;
+	}
+
+	opt.tiled = 1;
+	opt.nsamples = 4;
+	opt.lossless = 0;
+	opt.level = 90;
+	lossy = round_trip(&opt, out);
+	if (!lossy)
+		return 1;
+	err = mean_error(out);
+	if (err > 4.0 || lossy >= lossless) {
+		fprintf (stderr, "Lossy tiles: mean error %g, %ld bytes against "
+			 "%ld lossless.\n", err, lossy, lossless);
+		return 1;
+	}
+
+	/* Invalid settings and layouts are rejected */
+	tif = TIFFOpen(filename, "w");
+	if (!tif)
+		return 1;
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_WEBP);
+	if (TIFFSetField(tif, TIFFTAG_WEBP_LEVEL, 0) ||
+	    TIFFWriteScanline(tif, out, 0, 0) != -1) {
+		fprintf (stderr, "Invalid WebP settings accepted.\n");
+		TIFFClose(tif);
+		return 1;
+	}
+	TIFFClose(tif);
+
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
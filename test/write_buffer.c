@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check that handles opened with a write buffer produce the same file
+ * with fewer calls to the write method, when writing, checkpointing
+ * and updating images, also with the write-behind thread, and that
+ * errors of the thread are reported.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiffio.h"
+
+#define	WIDTH		48
+#define	LENGTH		40
+#define	BUFSIZE		(64 * 1024)
+#define	BEHINDSIZE	512
+#define	NBUFFERS	3
+
+typedef struct {
+	unsigned char* data;
+	uint64 size;
+	uint64 alloc;
+	uint64 pos;
+	int writes;
+	int maxwrites;		/* writes fail beyond, if not 0 */
+} client_t;
+
+static tmsize_t
+client_read(thandle_t fd, void* buf, tmsize_t size)
+{
+	client_t* c = (client_t*) fd;
+	tmsize_t n = 0;
+
+	if (c->pos < c->size) {
+		n = c->size - c->pos < (uint64) size ?
+		    (tmsize_t)(c->size - c->pos) : size;
+		memcpy(buf, c->data + c->pos, n);
+		c->pos += n;
+	}
+	return n;
+}
+
+static tmsize_t
+client_write(thandle_t fd, void* buf, tmsize_t size)
+{
+	client_t* c = (client_t*) fd;
+
+	c->writes++;
+	if (c->maxwrites != 0 && c->writes > c->maxwrites)
+		return -1;
+	if (c->pos + size > c->alloc) {
+		uint64 alloc = 2 * (c->pos + size);
+		unsigned char* p = (unsigned char*) realloc(c->data,
+		    (size_t) alloc);
+		if (!p)
+			return -1;
+		memset(p + c->alloc, 0, (size_t)(alloc - c->alloc));
+		c->data = p;
+		c->alloc = alloc;
+	}
+	memcpy(c->data + c->pos, buf, size);
+	c->pos += size;
+	if (c->pos > c->size)
+		c->size = c->pos;
+	return size;
+}
+
+static uint64
+client_seek(thandle_t fd, uint64 off, int whence)
+{
+	client_t* c = (client_t*) fd;
+
+	if (whence == SEEK_CUR)
+		off += c->pos;
+	else if (whence == SEEK_END)
+		off += c->size;
+	c->pos = off;
+	return off;
+}
+
+static int
+client_close(thandle_t fd)
+{
+	(void) fd;
+	return 0;
+}
+
+static uint64
+client_size(thandle_t fd)
+{
+	return ((client_t*) fd)->size;
+}
+
+static unsigned char
+pixel(uint16 dirn, uint32 row, uint32 col, int updated)
+{
+	return (unsigned char)((row * 7 + col * 3 + dirn * 51 + updated) & 0xff);
+}
+
+static TIFF*
+client_open(client_t* c, const char* mode, tmsize_t bufsize, int nbuffers)
+{
+	TIFFOpenOptions* opts;
+	TIFF* tif;
+
+	c->pos = 0;
+	opts = TIFFOpenOptionsAlloc();
+	if (!opts)
+		return NULL;
+	TIFFOpenOptionsSetWriteBuffer(opts, bufsize);
+	TIFFOpenOptionsSetWriteBehind(opts, nbuffers);
+	tif = TIFFClientOpenExt("write_buffer", mode, (thandle_t) c,
+	    client_read, client_write, client_seek, client_close,
+	    client_size, NULL, NULL, opts);
+	TIFFOpenOptionsFree(opts);
+	return tif;
+}
+
+/*
+ * Write two single row per strip images, the second compressed when
+ * possible, checkpointing each halfway, then rewrite the strips of
+ * the first one in update mode.
+ */
+static int
+write_file(client_t* c, tmsize_t bufsize, int nbuffers)
+{
+	unsigned char buf[WIDTH];
+	TIFF* tif;
+	uint32 row, col;
+	uint16 dirn;
+
+	tif = client_open(c, "w", bufsize, nbuffers);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file.\n");
+		return 0;
+	}
+	for (dirn = 0; dirn < 2; dirn++) {
+		TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+		TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+		TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1);
+#ifdef LZW_SUPPORT
+		if (dirn == 1)
+			TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+#endif
+		for (row = 0; row < LENGTH; row++) {
+			for (col = 0; col < WIDTH; col++)
+				buf[col] = pixel(dirn, row, col, 0);
+			if (TIFFWriteScanline(tif, buf, row, 0) == -1) {
+				fprintf (stderr, "Can't write row %lu.\n",
+					 (unsigned long) row);
+				TIFFClose(tif);
+				return 0;
+			}
+			if (row == LENGTH / 2 && !TIFFCheckpointDirectory(tif)) {
+				fprintf (stderr, "Can't checkpoint directory.\n");
+				TIFFClose(tif);
+				return 0;
+			}
+		}
+		if (!TIFFWriteDirectory(tif)) {
+			fprintf (stderr, "Can't write directory.\n");
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+
+	tif = client_open(c, "r+", bufsize, nbuffers);
+	if (!tif) {
+		fprintf (stderr, "Can't open test TIFF file for update.\n");
+		return 0;
+	}
+	for (row = 0; row < LENGTH; row++) {
+		for (col = 0; col < WIDTH; col++)
+			buf[col] = pixel(0, row, col, 1);
+		if (TIFFWriteEncodedStrip(tif, row, buf, WIDTH) == -1) {
+			fprintf (stderr, "Can't rewrite strip %lu.\n",
+				 (unsigned long) row);
+			TIFFClose(tif);
+			return 0;
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+static int
+check_file(client_t* c)
+{
+	unsigned char buf[WIDTH];
+	TIFF* tif;
+	uint32 row, col;
+	uint16 dirn;
+
+	tif = TIFFOpenMemory(c->data, (tmsize_t) c->size, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't read back test TIFF file.\n");
+		return 0;
+	}
+	for (dirn = 0; dirn < 2; dirn++) {
+		if (dirn > 0 && !TIFFReadDirectory(tif)) {
+			fprintf (stderr, "Can't read directory %d.\n", dirn);
+			TIFFClose(tif);
+			return 0;
+		}
+		for (row = 0; row < LENGTH; row++) {
+			if (TIFFReadScanline(tif, buf, row, 0) == -1) {
+				TIFFClose(tif);
+				return 0;
+			}
+			for (col = 0; col < WIDTH; col++)
+				if (buf[col] != pixel(dirn, row, col,
+				    dirn == 0)) {
+					fprintf (stderr, "Directory %d, row "
+						 "%lu differs.\n", dirn,
+						 (unsigned long) row);
+					TIFFClose(tif);
+					return 0;
+				}
+		}
+	}
+	TIFFClose(tif);
+	return 1;
+}
+
+/*
+ * Writes failing on the write-behind thread make the directory fail.
+ */
+static int
+check_error(void)
+{
+	unsigned char buf[WIDTH * LENGTH];
+	client_t failing;
+	TIFF* tif;
+	int ret = 0;
+
+	memset(&failing, 0, sizeof(failing));
+	failing.maxwrites = 2;
+	memset(buf, 0, sizeof(buf));
+	tif = client_open(&failing, "w", BEHINDSIZE, NBUFFERS);
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file.\n");
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, LENGTH);
+	/* the write may or may not see the error yet */
+	(void) TIFFWriteEncodedStrip(tif, 0, buf, sizeof(buf));
+	if (TIFFWriteDirectory(tif))
+		fprintf (stderr, "Write error not reported.\n");
+	else
+		ret = 1;
+	TIFFClose(tif);
+	free(failing.data);
+	return ret;
+}
+
+int
+main()
+{
+	client_t plain, buffered, behind;
+	int ret = 1;
+
+	memset(&plain, 0, sizeof(plain));
+	memset(&buffered, 0, sizeof(buffered));
+	memset(&behind, 0, sizeof(behind));
+	if (!write_file(&plain, 0, 0) || !write_file(&buffered, BUFSIZE, 0) ||
+	    !write_file(&behind, BEHINDSIZE, NBUFFERS))
+		goto failure;
+	if (plain.size != buffered.size ||
+	    memcmp(plain.data, buffered.data, (size_t) plain.size) != 0) {
+		fprintf (stderr, "Buffered file differs.\n");
+		goto failure;
+	}
+	if (plain.size != behind.size ||
+	    memcmp(plain.data, behind.data, (size_t) plain.size) != 0) {
+		fprintf (stderr, "File written behind differs.\n");
+		goto failure;
+	}
+	if (!check_file(&buffered))
+		goto failure;
+	if (buffered.writes * 8 > plain.writes) {
+		fprintf (stderr, "%d buffered writes, %d without buffer.\n",
+			 buffered.writes, plain.writes);
+		goto failure;
+	}
+	if (!check_error())
+		goto failure;
+	ret = 0;
+
+failure:
+	free(plain.data);
+	free(buffered.data);
+	free(behind.data);
+	return ret;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+
+/*
+ * TIFF Library
+ *
+ * Check the ZSTD codec pseudo-tags: strips and tiles written with
+ * long distance matching, worker threads or a shared dictionary must
+ * read back unchanged, whole or a scanline at a time.  Does nothing
+ * if the library is built without ZSTD support.
+ */
+
+#include "tif_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "tiffio.h"
+
+static const char filename[] = "zstd.tif";
+
+#define	WIDTH		256
+#define	LENGTH		256
+#define	ROWSPERSTRIP	32
+#define	TILESIZE	32
+
+static unsigned char image[WIDTH * LENGTH];
+static unsigned char dictionary[TILESIZE * TILESIZE];
+
+/*
+ * Every tile repeats the same texture with a little noise, so a
+ * dictionary built from the texture helps a lot.
+ */
+static void
+fill_image(void)
+{
+	uint32 seed = 99;
+	uint32 x, y;
+
+	for (y = 0; y < TILESIZE; y++)
+		for (x = 0; x < TILESIZE; x++) {
+			seed = seed * 1103515245 + 12345;
+			dictionary[y * TILESIZE + x] = (unsigned char) (seed >> 16);
+		}
+	for (y = 0; y < LENGTH; y++)
+		for (x = 0; x < WIDTH; x++) {
+			seed = seed * 1103515245 + 12345;
+			image[y * WIDTH + x] =
+			    dictionary[(y % TILESIZE) * TILESIZE + x % TILESIZE];
+			if ((seed >> 16) % 64 == 0)
+				image[y * WIDTH + x] ^= 0x55;
+		}
+}
+
+typedef struct {
+	int tiled;
+	int window_log;
+	int long_distance;
+	int nb_workers;
+	int use_dictionary;
+} options_t;
+
+static int
+set_options(TIFF* tif, const options_t* opt)
+{
+	if (opt->window_log &&
+	    !TIFFSetField(tif, TIFFTAG_ZSTD_WINDOWLOG, opt->window_log))
+		return 0;
+	if (opt->long_distance &&
+	    !TIFFSetField(tif, TIFFTAG_ZSTD_LONGDISTANCE, 1))
+		return 0;
+	if (opt->nb_workers &&
+	    !TIFFSetField(tif, TIFFTAG_ZSTD_NBWORKERS, opt->nb_workers))
+		return 0;
+	if (opt->use_dictionary &&
+	    !TIFFSetField(tif, TIFFTAG_ZSTD_DICTIONARY,
+			  (uint32) sizeof(dictionary), dictionary))
+		return 0;
+	return 1;
+}
+
+/*
+ * Write the image, read it back and return the file size, or 0 on
+ * failure.
+ */
+static long
+round_trip(const options_t* opt, int scanlines)
+{
+	TIFF* tif;
+	unsigned char buf[WIDTH * ROWSPERSTRIP];
+	uint32 row, x, y;
+	uint32 n;
+	long size = 0;
+	FILE* fd;
+
+	tif = TIFFOpen(filename, "w");
+	if (!tif) {
+		fprintf (stderr, "Can't create test TIFF file %s.\n", filename);
+		return 0;
+	}
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, WIDTH);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, LENGTH);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ZSTD);
+	if (!set_options(tif, opt)) {
+		fprintf (stderr, "Can't set ZSTD options.\n");
+		goto failure;
+	}
+	if (opt->tiled) {
+		TIFFSetField(tif, TIFFTAG_TILEWIDTH, TILESIZE);
+		TIFFSetField(tif, TIFFTAG_TILELENGTH, TILESIZE);
+		for (y = 0; y < LENGTH; y += TILESIZE)
+			for (x = 0; x < WIDTH; x += TILESIZE) {
+				for (row = 0; row < TILESIZE; row++)
+					memcpy(buf + row * TILESIZE,
+					       image + (y + row) * WIDTH + x,
+					       TILESIZE);
+				if (TIFFWriteTile(tif, buf, x, y, 0, 0) == -1)
+					goto failure;
+			}
+	} else {
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, ROWSPERSTRIP);
+		for (row = 0; row < LENGTH; row++)
+			if (scanlines ?
+			    TIFFWriteScanline(tif, image + row * WIDTH,
+					      row, 0) == -1 :
+			    (row % ROWSPERSTRIP == 0 &&
+			     TIFFWriteEncodedStrip(tif, row / ROWSPERSTRIP,
+				 image + row * WIDTH,
+				 WIDTH * ROWSPERSTRIP) == -1))
+				goto failure;
+	}
+	TIFFClose(tif);
+
+	tif = TIFFOpen(filename, "r");
+	if (!tif) {
+		fprintf (stderr, "Can't open %s.\n", filename);
+		return 0;
+	}
+	if (!set_options(tif, opt)) {
+		fprintf (stderr, "Can't set ZSTD options for reading.\n");
+		goto failure;
+	}
+	if (opt->tiled) {
+		n = TIFFNumberOfTiles(tif);
+		for (y = 0; y < LENGTH; y += TILESIZE)
+			for (x = 0; x < WIDTH; x += TILESIZE) {
+				if (TIFFReadTile(tif, buf, x, y, 0, 0) == -1)
+					goto failure;
+				for (row = 0; row < TILESIZE; row++)
+					if (memcmp(buf + row * TILESIZE,
+					    image + (y + row) * WIDTH + x,
+					    TILESIZE) != 0) {
+						fprintf (stderr, "Tile differs.\n");
+						goto failure;
+					}
+			}
+	} else {
+		n = TIFFNumberOfStrips(tif);
+		for (row = 0; row < n; row++)
+			if (TIFFReadEncodedStrip(tif, row, buf, -1) == -1 ||
+			    memcmp(buf, image + row * ROWSPERSTRIP * WIDTH,
+				   sizeof(buf)) != 0) {
+				fprintf (stderr, "Strip %lu differs.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+		for (row = 0; row < LENGTH; row++)
+			if (TIFFReadScanline(tif, buf, row, 0) == -1 ||
+			    memcmp(buf, image + row * WIDTH, WIDTH) != 0) {
+				fprintf (stderr, "Row %lu differs.\n",
+					 (unsigned long) row);
+				goto failure;
+			}
+	}
+	TIFFClose(tif);
+
+	fd = fopen(filename, "rb");
+	if (fd) {
+		fseek(fd, 0, SEEK_END);
+		size = ftell(fd);
+		fclose(fd);
+	}
+	return size;
+
+failure:
+	TIFFClose(tif);
+	return 0;
+}
+
+int
+main()
+{
+	options_t opt;
+	long plain, shared;
+	TIFF* tif;
+	unsigned char buf[TILESIZE * TILESIZE];
+
+	if (!TIFFIsCODECConfigured(COMPRESSION_ZSTD))
+		return 0;
+	fill_image();
+
+	memset(&opt, 0, sizeof(opt));
+	if (!round_trip(&opt, 0) || !round_trip(&opt, 1))
+		return 1;
+	opt.window_log = 20;
+	opt.long_distance = 1;
+	if (!round_trip(&opt, 0) || !round_trip(&opt, 1))
+		return 1;
+	memset(&opt, 0, sizeof(opt));
+	opt.nb_workers = 2;
+	if (!round_trip(&opt, 0))
+		return 1;
+
+	memset(&opt, 0, sizeof(opt));
+	opt.tiled = 1;
+	plain = round_trip(&opt, 0);
+	opt.use_dictionary = 1;
+	shared = round_trip(&opt, 0);
+	if (!plain || !shared)
+		return 1;
+	if (shared >= plain) {
+		fprintf (stderr, "Dictionary did not help: %ld >= %ld bytes.\n",
+			 shared, plain);
+		return 1;
+	}
+
+	/* Tiles written with a dictionary need it to be read back */
+	tif = TIFFOpen(filename, "r");
+	if (!tif)
+		return 1;
+	if (TIFFReadEncodedTile(tif, 0, buf, sizeof(buf)) != -1) {
+		fprintf (stderr, "Tile decoded without its dictionary.\n");
+		TIFFClose(tif);
+		return 1;
+	}
+	if (TIFFSetField(tif, TIFFTAG_ZSTD_WINDOWLOG, 5)) {
+		fprintf (stderr, "Invalid window log accepted.\n");
+		TIFFClose(tif);
+		return 1;
+	}
+	TIFFClose(tif);
+	unlink(filename);
+	return 0;
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
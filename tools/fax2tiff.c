@@ -57,9 +57,26 @@
 
 #define TIFFhowmany8(x) (((x)&0x07)?((uint32)(x)>>3)+1:(uint32)(x)>>3)
 
+/* Size of the output buffer: compressed pages are written in one go */
+#define	OUTBUFSIZE	(1024*1024)
+
+/*
+ * Runs of a decoded row, for re-encoding to Group 3 or 4
+ * without going through the pixels.
+ */
+typedef struct _FAX_Runs
+{
+	uint32	*runs;
+	uint32	nruns;
+	uint32	size;		/* # entries allocated */
+} FAX_Runs;
+
 TIFF	*faxTIFF;
 char	*rowbuf;
 char	*refbuf;
+FAX_Runs faxruns[2];
+FAX_Runs *currow = &faxruns[0];	/* row just decoded */
+FAX_Runs *refrow = &faxruns[1];	/* last good row */
 
 uint32	xsize = 1728;
 int	verbose;
@@ -71,17 +88,17 @@ int	copyFaxFile(TIFF* tifin, TIFF* tifout);
 static	void usage(void);
 
 /*
-  Struct to carry client data.  Note that it does not appear that the client
-  data is actually used in this program.
+  Client data of the fake input file: the input file descriptor, as the
+  I/O procedures of the output file expect to find it in the handle.
 */
-typedef struct _FAX_Client_Data
+typedef union _FAX_Client_Data
 {
 #if defined(_WIN32) && defined(USE_WIN32_FILEIO)
         intptr_t fh; /* Operating system file handle */
 #else
         int fd;      /* Integer file descriptor */
 #endif
-
+        thandle_t h;
 } FAX_Client_Data;
 
 int
@@ -279,12 +296,13 @@ main(int argc, char* argv[])
 			    "%s: %s: Can not open\n", argv[0], argv[optind]);
 			continue;
 		}
+                client_data.h = NULL;
 #if defined(_WIN32) && defined(USE_WIN32_FILEIO)
                 client_data.fh = _get_osfhandle(fileno(in));
 #else
                 client_data.fd = fileno(in);
 #endif
-                TIFFSetClientdata(faxTIFF, (thandle_t) &client_data);
+                TIFFSetClientdata(faxTIFF, client_data.h);
 		TIFFSetFileName(faxTIFF, (const char*)argv[optind]);
 		TIFFSetField(out, TIFFTAG_IMAGEWIDTH, xsize);
 		TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, 1);
@@ -356,18 +374,68 @@ main(int argc, char* argv[])
 	TIFFClose(out);
 	_TIFFfree(rowbuf);
 	_TIFFfree(refbuf);
+	_TIFFfree(faxruns[0].runs);
+	_TIFFfree(faxruns[1].runs);
 	return (EXIT_SUCCESS);
 }
 
+/*
+ * TIFFTAG_FAXRUNSFUNC callback: keep the runs of the row.
+ */
+static int
+saveRuns(void* clientdata, uint32 row, const uint32* runs, uint32 nruns,
+    uint32 width)
+{
+	(void) clientdata; (void) row; (void) width;
+	if (nruns > currow->size) {
+		uint32* p = (uint32*) _TIFFCheckRealloc(faxTIFF, currow->runs,
+		    nruns, sizeof (uint32), "for run lengths");
+		if (p == NULL)
+			return (0);
+		currow->runs = p;
+		currow->size = nruns;
+	}
+	_TIFFmemcpy(currow->runs, runs, nruns * sizeof (uint32));
+	currow->nruns = nruns;
+	return (1);
+}
+
+/*
+ * Write the rows decoded so far into the current strip.
+ * The image length grows as each strip is added.
+ */
+static int
+writeStrip(TIFF* tifout, char* buf, uint32 row, uint32 nrows,
+    uint32 rowsperstrip, uint32 linesize)
+{
+	TIFFSetField(tifout, TIFFTAG_IMAGELENGTH, row);
+	if (TIFFWriteEncodedStrip(tifout, (row - 1) / rowsperstrip, buf,
+	    (tmsize_t) nrows * linesize) < 0) {
+		fprintf(stderr, "%s: Write error at row %ld.\n",
+		    tifout->tif_name, (long) (row - nrows));
+		return (0);
+	}
+	return (1);
+}
+
+/*
+ * Group 3 and 4 output is encoded straight from the runs of the
+ * decoded rows; other output is decoded into whole strips that are
+ * then written at once.
+ */
 int
 copyFaxFile(TIFF* tifin, TIFF* tifout)
 {
-	uint32 row;
+	uint32 row, nrows, rowsperstrip;
 	uint32 linesize = TIFFhowmany8(xsize);
+	uint16 compression;
 	uint16 badrun;
-	int ok;
+	char* stripbuf = NULL;
+	char* bp = rowbuf;
+	int ok, userows, i;
 
-	tifin->tif_rawdatasize = (tmsize_t)TIFFGetFileSize(tifin);
+	tifin->tif_rawdatasize =
+	    (tmsize_t)(*TIFFGetSizeProc(tifin))(TIFFClientdata(tifin));
 	if (tifin->tif_rawdatasize == 0) {
 		TIFFError(tifin->tif_name, "Empty input file");
 		return (0);
@@ -377,13 +445,38 @@ copyFaxFile(TIFF* tifin, TIFF* tifout)
 		TIFFError(tifin->tif_name, "Not enough memory");
 		return (0);
 	}
-	if (!ReadOK(tifin, tifin->tif_rawdata, tifin->tif_rawdatasize)) {
+	if ((*TIFFGetReadProc(tifin))(TIFFClientdata(tifin), tifin->tif_rawdata,
+	    tifin->tif_rawdatasize) != tifin->tif_rawdatasize) {
 		TIFFError(tifin->tif_name, "Read error at scanline 0");
 		return (0);
 	}
 	tifin->tif_rawcp = tifin->tif_rawdata;
 	tifin->tif_rawcc = tifin->tif_rawdatasize;
 
+	TIFFGetField(tifout, TIFFTAG_COMPRESSION, &compression);
+	TIFFGetField(tifout, TIFFTAG_ROWSPERSTRIP, &rowsperstrip);
+	userows = (compression == COMPRESSION_CCITTFAX3 ||
+	    compression == COMPRESSION_CCITTFAX4);
+	if (userows) {
+		TIFFSetField(tifin, TIFFTAG_FAXRUNSFUNC, saveRuns, NULL);
+		refrow->nruns = 0;		/* all white */
+	} else {
+		TIFFSetField(tifin, TIFFTAG_FAXRUNSFUNC, NULL, NULL);
+		stripbuf = (char*) _TIFFCheckMalloc(tifout, rowsperstrip,
+		    linesize, "for strip buffer");
+		if (stripbuf == NULL) {
+			_TIFFfree(tifin->tif_rawdata);
+			return (0);
+		}
+		/* the decoder leaves the pad bits of each row alone */
+		_TIFFmemset(stripbuf, 0, (tmsize_t) rowsperstrip * linesize);
+	}
+	if (!TIFFWriteBufferSetup(tifout, NULL, (tmsize_t) OUTBUFSIZE)) {
+		_TIFFfree(stripbuf);
+		_TIFFfree(tifin->tif_rawdata);
+		return (0);
+	}
+
 	(*tifin->tif_setupdecode)(tifin);
 	(*tifin->tif_predecode)(tifin, (tsample_t) 0);
 	tifin->tif_row = 0;
@@ -392,40 +485,64 @@ copyFaxFile(TIFF* tifin, TIFF* tifout)
 
 	_TIFFmemset(refbuf, 0, linesize);
 	row = 0;
+	nrows = 0;		/* rows waiting in stripbuf */
 	badrun = 0;		/* current run of bad lines */
 	while (tifin->tif_rawcc > 0) {
-		ok = (*tifin->tif_decoderow)(tifin, (tdata_t) rowbuf, 
+		if (!userows)
+			bp = stripbuf + (tmsize_t) nrows * linesize;
+		ok = (*tifin->tif_decoderow)(tifin, (tdata_t) bp,
 					     linesize, 0);
 		if (!ok) {
 			badfaxlines++;
 			badrun++;
 			/* regenerate line from previous good line */
-			_TIFFmemcpy(rowbuf, refbuf, linesize);
+			if (!userows)
+				_TIFFmemcpy(bp, refbuf, linesize);
 		} else {
+			FAX_Runs* t = currow;
 			if (badrun > badfaxrun)
 				badfaxrun = badrun;
 			badrun = 0;
-			_TIFFmemcpy(refbuf, rowbuf, linesize);
+			if (userows) {
+				currow = refrow;
+				refrow = t;
+			} else
+				_TIFFmemcpy(refbuf, bp, linesize);
 		}
 		tifin->tif_row++;
 
-		if (TIFFWriteScanline(tifout, rowbuf, row, 0) < 0) {
-			fprintf(stderr, "%s: Write error at row %ld.\n",
-			    tifout->tif_name, (long) row);
-			break;
-		}
-		row++;
-		if (stretch) {
-			if (TIFFWriteScanline(tifout, rowbuf, row, 0) < 0) {
-				fprintf(stderr, "%s: Write error at row %ld.\n",
-				    tifout->tif_name, (long) row);
-				break;
+		for (i = 0; i < (stretch ? 2 : 1); i++) {
+			if (userows) {
+				if (TIFFWriteFaxRuns(tifout, row, refrow->runs,
+				    refrow->nruns) < 0) {
+					fprintf(stderr,
+					    "%s: Write error at row %ld.\n",
+					    tifout->tif_name, (long) row);
+					goto done;
+				}
+			} else {
+				char* dst = stripbuf + (tmsize_t) nrows * linesize;
+				if (dst != bp)
+					_TIFFmemcpy(dst, bp, linesize);
+				if (++nrows == rowsperstrip) {
+					if (!writeStrip(tifout, stripbuf, row + 1,
+					    nrows, rowsperstrip, linesize)) {
+						row = row + 1 - nrows;
+						goto done;
+					}
+					nrows = 0;
+				}
 			}
 			row++;
 		}
 	}
+	if (nrows > 0 && !writeStrip(tifout, stripbuf, row, nrows,
+	    rowsperstrip, linesize))
+		row -= nrows;
+done:
 	if (badrun > badfaxrun)
 		badfaxrun = badrun;
+	_TIFFfree(stripbuf);
 	_TIFFfree(tifin->tif_rawdata);
 	return (row);
 }
@@ -38,6 +38,7 @@
 #endif
 
 #include "tiffio.h"
+#include "toolthreads.h"
 
 #define	streq(a,b)	(strcmp(a,b) == 0)
 #define	strneq(a,b,n)	(strncmp(a,b,n) == 0)
@@ -45,6 +46,16 @@
 static	void usage(void);
 static	void cpTags(TIFF* in, TIFF* out);
 
+static tmsize_t
+multiply_ms(tmsize_t m1, tmsize_t m2)
+{
+	tmsize_t bytes = m1 * m2;
+
+	if (m1 && bytes / m1 != m2)
+		bytes = 0;
+	return bytes;
+}
+
 static int
 checkcmap(int n, uint16* r, uint16* g, uint16* b)
 {
@@ -60,22 +71,26 @@ checkcmap(int n, uint16* r, uint16* g, uint16* b)
 #define	CopyField3(tag, v1, v2, v3) \
     if (TIFFGetField(in, tag, &v1, &v2, &v3)) TIFFSetField(out, tag, v1, v2, v3)
 
+static	uint16 bitspersample;
+static	uint16 config = PLANARCONFIG_CONTIG;
+static	uint32 rgbmap[256];	/* colormap packed as by TIFFRGBAImage */
+static	int nthreads = 0;	/* default is one per processor */
 static	uint16 compression = (uint16) -1;
 static	uint16 predictor = 0;
 static	int quality = 75;	/* JPEG quality */
 static	int jpegcolormode = JPEGCOLORMODE_RGB;
 static	int processCompressOptions(char*);
+static	int cvtImage(TIFF* in, TIFF* out, uint32 imagewidth,
+    uint32 imagelength, uint32 rowsperstrip);
 
 int
 main(int argc, char* argv[])
 {
-	uint16 bitspersample, shortv;
+	uint16 shortv;
 	uint32 imagewidth, imagelength;
-	uint16 config = PLANARCONFIG_CONTIG;
 	uint32 rowsperstrip = (uint32) -1;
 	uint16 photometric = PHOTOMETRIC_RGB;
 	uint16 *rmap, *gmap, *bmap;
-	uint32 row;
 	int cmap = -1;
 	TIFF *in, *out;
 	int c;
@@ -85,7 +100,7 @@ main(int argc, char* argv[])
 	extern char* optarg;
 #endif
 
-	while ((c = getopt(argc, argv, "C:c:p:r:")) != -1)
+	while ((c = getopt(argc, argv, "C:c:j:p:r:")) != -1)
 		switch (c) {
 		case 'C':		/* force colormap interpretation */
 			cmap = atoi(optarg);
@@ -94,6 +109,9 @@ main(int argc, char* argv[])
 			if (!processCompressOptions(optarg))
 				usage();
 			break;
+		case 'j':		/* threads */
+			nthreads = atoi(optarg);
+			break;
 		case 'p':		/* planar configuration */
 			if (streq(optarg, "separate"))
 				config = PLANARCONFIG_SEPARATE;
@@ -128,8 +146,10 @@ main(int argc, char* argv[])
 	}
 	bitspersample = 0;
 	TIFFGetField(in, TIFFTAG_BITSPERSAMPLE, &bitspersample);
-	if (bitspersample != 8) {
-		fprintf(stderr, "%s: Sorry, can only handle 8-bit images.\n",
+	if (bitspersample != 1 && bitspersample != 2 &&
+	    bitspersample != 4 && bitspersample != 8) {
+		fprintf(stderr,
+		    "%s: Sorry, can only handle 1, 2, 4 and 8-bit images.\n",
 		    argv[optind]);
 		return (-1);
 	}
@@ -137,6 +157,7 @@ main(int argc, char* argv[])
 	if (out == NULL)
 		return (-2);
 	cpTags(in, out);
+	TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, 8);
 	TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &imagewidth);
 	TIFFGetField(in, TIFFTAG_IMAGELENGTH, &imagelength);
 	if (compression != (uint16)-1)
@@ -179,65 +200,157 @@ main(int argc, char* argv[])
 			bmap[i] = CVT(bmap[i]);
 		}
 	}
-	{ unsigned char *ibuf, *obuf;
-	  register unsigned char* pp;
-	  register uint32 x;
-	  tmsize_t tss_in = TIFFScanlineSize(in);
-	  tmsize_t tss_out = TIFFScanlineSize(out);
-	  if (tss_out / tss_in < 3) {
+	for (c = 0; c < 256; c++)
+		rgbmap[c] = c >> bitspersample ? 0 : (uint32) (rmap[c] & 0xff) |
+		    (uint32) (gmap[c] & 0xff) << 8 |
+		    (uint32) (bmap[c] & 0xff) << 16;
+	if (!cvtImage(in, out, imagewidth, imagelength, rowsperstrip)) {
+		(void) TIFFClose(in);
+		(void) TIFFClose(out);
+		return (-1);
+	}
+
+	(void) TIFFClose(in);
+	(void) TIFFClose(out);
+	return (0);
+}
+
+/*
+ * The image is converted a band of output strips at a time, one strip
+ * per thread: the rows of the band are read, their colormap indices
+ * expanded on nthreads threads, and the strips of each plane are
+ * compressed and written by TIFFWriteEncodedStripsParallel().
+ */
+#define	MAX_THREADS	64
+
+typedef struct {
+	unsigned char* in;	/* rows of the input strip */
+	uint32	nrows;
+	uint32	width;
+	tmsize_t insize;	/* bytes per input and output row */
+	tmsize_t outsize;
+	unsigned char* out[3];	/* output strip of each plane */
+	unsigned char* ipix;	/* colormap indices of a row */
+} StripWork;
+
+static void
+cvtStrip(void* arg)
+{
+	StripWork* w = (StripWork*) arg;
+	unsigned char* ip = w->in;
+	unsigned char* pix;
+	uint32 row, x;
+
+	for (row = 0; row < w->nrows; row++, ip += w->insize) {
+		tmsize_t o = row * w->outsize;
+
+		pix = ip;
+		if (bitspersample != 8) {
+			TIFFUnpackSamples8(w->ipix, ip, w->width,
+			    bitspersample, 0, NULL);
+			pix = w->ipix;
+		}
+		if (config == PLANARCONFIG_CONTIG) {
+			TIFFPaletteToRGB8(w->out[0] + o, pix, w->width,
+			    rgbmap);
+			continue;
+		}
+		for (x = 0; x < w->width; x++) {
+			uint32 v = rgbmap[pix[x]];
+
+			w->out[0][o + x] = (unsigned char) TIFFGetR(v);
+			w->out[1][o + x] = (unsigned char) TIFFGetG(v);
+			w->out[2][o + x] = (unsigned char) TIFFGetB(v);
+		}
+	}
+}
+
+static int
+cvtImage(TIFF* in, TIFF* out, uint32 imagewidth, uint32 imagelength,
+    uint32 rowsperstrip)
+{
+	StripWork work[MAX_THREADS];
+	void* args[MAX_THREADS];
+	uint32 strips[3 * MAX_THREADS];
+	void* bufs[3 * MAX_THREADS];
+	tmsize_t sizes[3 * MAX_THREADS];
+	tmsize_t tss_in = TIFFScanlineSize(in);
+	tmsize_t tss_out = TIFFScanlineSize(out);
+	tmsize_t stripsize;
+	unsigned char *ibuf = NULL, *obuf = NULL, *ipix = NULL;
+	uint32 nstrips, strip, row, r, n;
+	int nplanes = config == PLANARCONFIG_SEPARATE ? 3 : 1;
+	int t, p, ok = 0;
+
+	if (tss_in <= 0 ||
+	    tss_out < (tmsize_t) imagewidth * (nplanes == 1 ? 3 : 1)) {
 		/*
 		 * BUG 2750: The following code does not know about chroma
 		 * subsampling of JPEG data. It assumes that the output buffer is 3x
 		 * the length of the input buffer due to exploding the palette into
-		 * RGB tuples. If this assumption is incorrect, it could lead to a
-		 * buffer overflow. Go ahead and fail now to prevent that.
+		 * RGB tuples (or a plane of them). If this assumption is incorrect,
+		 * it could lead to a buffer overflow. Go ahead and fail now to
+		 * prevent that.
 		 */
 		fprintf(stderr, "Could not determine correct image size for output. Exiting.\n");
-		return -1;
-      }
-	  ibuf = (unsigned char*)_TIFFmalloc(tss_in);
-	  obuf = (unsigned char*)_TIFFmalloc(tss_out);
-	  switch (config) {
-	  case PLANARCONFIG_CONTIG:
-		for (row = 0; row < imagelength; row++) {
-			if (!TIFFReadScanline(in, ibuf, row, 0))
-				goto done;
-			pp = obuf;
-			for (x = 0; x < imagewidth; x++) {
-				*pp++ = (unsigned char) rmap[ibuf[x]];
-				*pp++ = (unsigned char) gmap[ibuf[x]];
-				*pp++ = (unsigned char) bmap[ibuf[x]];
+		return (0);
+	}
+	if (nthreads <= 0)
+		nthreads = toolGetNumCPUs();
+	if (nthreads > MAX_THREADS)
+		nthreads = MAX_THREADS;
+	if (rowsperstrip > imagelength)
+		rowsperstrip = imagelength;
+	nstrips = (imagelength + rowsperstrip - 1) / rowsperstrip;
+	stripsize = multiply_ms(rowsperstrip, tss_out);
+	ibuf = (unsigned char*)_TIFFmalloc(multiply_ms(
+	    (tmsize_t) nthreads * rowsperstrip, tss_in));
+	obuf = (unsigned char*)_TIFFmalloc(multiply_ms(
+	    (tmsize_t) nthreads * nplanes, stripsize));
+	ipix = (unsigned char*)_TIFFmalloc((tmsize_t) nthreads * imagewidth);
+	if (stripsize == 0 || ibuf == NULL || obuf == NULL || ipix == NULL) {
+		fprintf(stderr, "No space for strip buffers.\n");
+		goto done;
+	}
+	for (strip = 0; strip < nstrips; strip += n) {
+		n = nstrips - strip < (uint32) nthreads ?
+		    nstrips - strip : (uint32) nthreads;
+		for (t = 0; t < (int) n; t++) {
+			row = (strip + t) * rowsperstrip;
+			work[t].nrows = imagelength - row < rowsperstrip ?
+			    imagelength - row : rowsperstrip;
+			work[t].width = imagewidth;
+			work[t].insize = tss_in;
+			work[t].outsize = tss_out;
+			work[t].in = ibuf + (tmsize_t) t * rowsperstrip * tss_in;
+			work[t].ipix = ipix + (tmsize_t) t * imagewidth;
+			for (r = 0; r < work[t].nrows; r++)
+				if (TIFFReadScanline(in, work[t].in + r * tss_in,
+				    row + r, 0) < 0)
+					goto done;
+			for (p = 0; p < nplanes; p++) {
+				work[t].out[p] = obuf +
+				    ((tmsize_t) t * nplanes + p) * stripsize;
+				strips[p * n + t] = p * nstrips + strip + t;
+				bufs[p * n + t] = work[t].out[p];
+				sizes[p * n + t] = work[t].nrows * tss_out;
 			}
-			if (!TIFFWriteScanline(out, obuf, row, 0))
-				goto done;
-		}
-		break;
-	  case PLANARCONFIG_SEPARATE:
-		for (row = 0; row < imagelength; row++) {
-			if (!TIFFReadScanline(in, ibuf, row, 0))
-				goto done;
-			for (pp = obuf, x = 0; x < imagewidth; x++)
-				*pp++ = (unsigned char) rmap[ibuf[x]];
-			if (!TIFFWriteScanline(out, obuf, row, 0))
-				goto done;
-			for (pp = obuf, x = 0; x < imagewidth; x++)
-				*pp++ = (unsigned char) gmap[ibuf[x]];
-			if (!TIFFWriteScanline(out, obuf, row, 0))
-				goto done;
-			for (pp = obuf, x = 0; x < imagewidth; x++)
-				*pp++ = (unsigned char) bmap[ibuf[x]];
-			if (!TIFFWriteScanline(out, obuf, row, 0))
-				goto done;
+			args[t] = &work[t];
 		}
-		break;
-	  }
-	  _TIFFfree(ibuf);
-	  _TIFFfree(obuf);
+		toolRunThreads((int) n, cvtStrip, args);
+		if (!TIFFWriteEncodedStripsParallel(out, strips, n * nplanes,
+		    bufs, sizes, nthreads))
+			goto done;
 	}
+	ok = 1;
 done:
-	(void) TIFFClose(in);
-	(void) TIFFClose(out);
-	return (0);
+	if (ipix != NULL)
+		_TIFFfree(ipix);
+	if (ibuf != NULL)
+		_TIFFfree(ibuf);
+	if (obuf != NULL)
+		_TIFFfree(obuf);
+	return (ok);
 }
 
 static int
@@ -412,6 +525,7 @@ char* stuff[] = {
 " -p contig	pack samples contiguously (e.g. RGBRGB...)",
 " -p separate	store samples separately (e.g. RRR...GGG...BBB...)",
 " -r #		make each strip have no more than # rows",
+" -j #		convert on # threads (default one per processor)",
 " -C 8		assume 8-bit colormap values (instead of 16-bit)",
 " -C 16		assume 16-bit colormap values",
 "",
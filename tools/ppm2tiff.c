@@ -46,6 +46,7 @@
 #endif
 
 #include "tiffio.h"
+#include "toolthreads.h"
 
 #ifndef HAVE_GETOPT
 extern int getopt(int, char**, char*);
@@ -54,14 +55,20 @@ extern int getopt(int, char**, char*);
 #define	streq(a,b)	(strcmp(a,b) == 0)
 #define	strneq(a,b,n)	(strncmp(a,b,n) == 0)
 
+#define	BATCH_SIZE	(16*1024*1024)	/* bytes of input per batch */
+#define	CHUNKSPERTHREAD	4
+
 static	uint16 compression = COMPRESSION_PACKBITS;
 static	uint16 predictor = 0;
 static	int quality = 75;	/* JPEG quality */
 static	int jpegcolormode = JPEGCOLORMODE_RGB;
 static  uint32 g3opts;
+static	int nthreads = 0;	/* threads, 0 for one per processor */
 
 static	void usage(void);
 static	int processCompressOptions(char*);
+static	int writeImage(FILE*, const char*, TIFF*, uint32, uint32, uint32,
+		       uint32, tmsize_t, int);
 
 static void
 BadPPM(char* file)
@@ -81,19 +88,26 @@ multiply_ms(tmsize_t m1, tmsize_t m2)
 	return bytes;
 }
 
+static uint32
+howmany(uint32 x, uint32 y)
+{
+	return x / y + (x % y != 0);
+}
+
 int
 main(int argc, char* argv[])
 {
 	uint16 photometric = 0;
 	uint32 rowsperstrip = (uint32) -1;
 	double resolution = -1;
-	unsigned char *buf = NULL;
 	tmsize_t linebytes = 0;
+	uint32 tilewidth = (uint32) -1, tilelength = (uint32) -1;
+	int tiled = 0, status;
 	uint16 spp = 1;
 	uint16 bpp = 8;
 	TIFF *out;
 	FILE *in;
-	unsigned int w, h, prec, row;
+	unsigned int w, h, prec;
 	char *infile;
 	int c;
 #if !HAVE_DECL_OPTARG
@@ -106,7 +120,7 @@ main(int argc, char* argv[])
 	    fprintf(stderr, "%s: Too few arguments\n", argv[0]);
 	    usage();
 	}
-	while ((c = getopt(argc, argv, "c:r:R:")) != -1)
+	while ((c = getopt(argc, argv, "c:r:R:tw:l:j:")) != -1)
 		switch (c) {
 		case 'c':		/* compression scheme */
 			if (!processCompressOptions(optarg))
@@ -118,6 +132,20 @@ main(int argc, char* argv[])
 		case 'R':		/* resolution */
 			resolution = atof(optarg);
 			break;
+		case 't':		/* write tiles */
+			tiled = 1;
+			break;
+		case 'w':		/* tile width */
+			tilewidth = atoi(optarg);
+			tiled = 1;
+			break;
+		case 'l':		/* tile length */
+			tilelength = atoi(optarg);
+			tiled = 1;
+			break;
+		case 'j':		/* threads */
+			nthreads = atoi(optarg);
+			break;
 		case '?':
 			usage();
 			/*NOTREACHED*/
@@ -235,19 +263,23 @@ main(int argc, char* argv[])
 		case 1:
 			/* if round-up overflows, result will be zero, OK */
 			linebytes = (multiply_ms(spp, w) + (8 - 1)) / 8;
-			if (rowsperstrip == (uint32) -1) {
-				TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, h);
-			} else {
-				TIFFSetField(out, TIFFTAG_ROWSPERSTRIP,
-				    TIFFDefaultStripSize(out, rowsperstrip));
-			}
+			if (rowsperstrip == (uint32) -1)
+				rowsperstrip = h;
+			else
+				rowsperstrip = TIFFDefaultStripSize(out, rowsperstrip);
 			break;
 		case 8:
 			linebytes = multiply_ms(spp, w);
-			TIFFSetField(out, TIFFTAG_ROWSPERSTRIP,
-			    TIFFDefaultStripSize(out, rowsperstrip));
+			rowsperstrip = TIFFDefaultStripSize(out, rowsperstrip);
 			break;
 	}
+	if (tiled) {
+		TIFFDefaultTileSize(out, &tilewidth, &tilelength);
+		TIFFSetField(out, TIFFTAG_TILEWIDTH, tilewidth);
+		TIFFSetField(out, TIFFTAG_TILELENGTH, tilelength);
+		rowsperstrip = tilelength;
+	} else
+		TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
 	if (linebytes == 0) {
 		fprintf(stderr, "%s: scanline size overflow\n", infile);
 		(void) TIFFClose(out);
@@ -259,33 +291,136 @@ main(int argc, char* argv[])
 		(void) TIFFClose(out);
 		exit(-2);					
 	}
-	if (scanline_size < linebytes)
-		buf = (unsigned char *)_TIFFmalloc(linebytes);
-	else
-		buf = (unsigned char *)_TIFFmalloc(scanline_size);
-	if (buf == NULL) {
-		fprintf(stderr, "%s: Not enough memory\n", infile);
-		(void) TIFFClose(out);
-		exit(-2);
-	}
 	if (resolution > 0) {
 		TIFFSetField(out, TIFFTAG_XRESOLUTION, resolution);
 		TIFFSetField(out, TIFFTAG_YRESOLUTION, resolution);
 		TIFFSetField(out, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
 	}
-	for (row = 0; row < h; row++) {
-		if (fread(buf, linebytes, 1, in) != 1) {
+	status = writeImage(in, infile, out, w, h, rowsperstrip,
+			    tiled ? tilewidth : 0, linebytes, spp * bpp);
+	(void) TIFFClose(out);
+	if (status < 0) {
+		fprintf(stderr, "%s: Not enough memory\n", infile);
+		exit(-2);
+	}
+	return (0);
+}
+
+/*
+ * Write the image in batches of whole strips or rows of tiles read with
+ * large reads, compressing the strips or tiles of each batch on threads.
+ * Returns -1 if out of memory; a read error stops the image at the last
+ * row read, as does a write error.
+ */
+static int
+writeImage(FILE* in, const char* infile, TIFF* out, uint32 w, uint32 h,
+	   uint32 rowsperstrip, uint32 tilewidth, tmsize_t linebytes,
+	   int bitsperpixel)
+{
+	tmsize_t chunksize, bandbytes, nchunks;
+	uint32 across, perbatch, batchrows, row, nrows, nread, i, n;
+	unsigned char *buf = NULL, *tilebuf = NULL;
+	uint32 *list = NULL;
+	void **bufs = NULL;
+	tmsize_t *sizes = NULL;
+	int threads = nthreads > 0 ? nthreads : toolGetNumCPUs();
+	int status = -1;
+
+	if (!tilewidth && rowsperstrip > h)
+		rowsperstrip = h;
+	if (h == 0 || rowsperstrip == 0)
+		return 0;
+	bandbytes = multiply_ms(rowsperstrip, linebytes);
+	if (tilewidth) {
+		across = howmany(w, tilewidth);
+		chunksize = TIFFTileSize(out);
+	} else {
+		across = 1;
+		chunksize = bandbytes;
+	}
+	if (bandbytes == 0 || chunksize == 0)
+		return 0;
+	/* at least a few chunks per thread, at most about BATCH_SIZE bytes */
+	perbatch = (uint32) (BATCH_SIZE / bandbytes);
+	if (perbatch < (uint32) threads * CHUNKSPERTHREAD / across)
+		perbatch = (uint32) threads * CHUNKSPERTHREAD / across;
+	if (perbatch == 0)
+		perbatch = 1;
+	if (perbatch > howmany(h, rowsperstrip))
+		perbatch = howmany(h, rowsperstrip);
+	batchrows = perbatch * rowsperstrip;
+
+	nchunks = (tmsize_t) perbatch * across;
+	buf = (unsigned char *)_TIFFmalloc(multiply_ms(batchrows, linebytes));
+	list = (uint32 *)_TIFFmalloc(multiply_ms(nchunks, sizeof (uint32)));
+	bufs = (void **)_TIFFmalloc(multiply_ms(nchunks, sizeof (void *)));
+	sizes = (tmsize_t *)_TIFFmalloc(multiply_ms(nchunks, sizeof (tmsize_t)));
+	if (tilewidth)
+		tilebuf = (unsigned char *)_TIFFmalloc(multiply_ms(nchunks, chunksize));
+	if (!buf || !list || !bufs || !sizes || (tilewidth && !tilebuf))
+		goto bad;
+
+	status = 0;
+	for (row = 0; row < h; row += nrows) {
+		nrows = h - row < batchrows ? h - row : batchrows;
+		nread = (uint32) fread(buf, linebytes, nrows, in);
+		if (nread < nrows)
 			fprintf(stderr, "%s: scanline %lu: Read error.\n",
-			    infile, (unsigned long) row);
-			break;
+			    infile, (unsigned long) (row + nread));
+		n = 0;
+		if (tilewidth) {
+			tmsize_t tilerowbytes = TIFFTileRowSize(out);
+			uint32 r, t, col;
+
+			_TIFFmemset(tilebuf, 0, perbatch * across * chunksize);
+			for (r = 0; r < nread; r += rowsperstrip) {
+				for (col = 0; col < w; col += tilewidth) {
+					unsigned char *tile = tilebuf + n * chunksize;
+					tmsize_t off = ((tmsize_t) col * bitsperpixel) / 8;
+					tmsize_t bytes = linebytes - off;
+
+					if (bytes > tilerowbytes)
+						bytes = tilerowbytes;
+					for (t = 0; t < rowsperstrip && r + t < nread; t++)
+						_TIFFmemcpy(tile + t * tilerowbytes,
+						    buf + (r + t) * linebytes + off, bytes);
+					list[n] = TIFFComputeTile(out, col, row + r, 0, 0);
+					bufs[n] = tile;
+					sizes[n] = chunksize;
+					n++;
+				}
+			}
+		} else {
+			for (i = 0; i < nread; i += rowsperstrip) {
+				list[n] = (row + i) / rowsperstrip;
+				bufs[n] = buf + i * linebytes;
+				sizes[n] = (nread - i < rowsperstrip ?
+				    nread - i : rowsperstrip) * linebytes;
+				n++;
+			}
 		}
-		if (TIFFWriteScanline(out, buf, row, 0) < 0)
+		if (n > 0 && !(tilewidth ?
+		    TIFFWriteEncodedTilesParallel(out, list, n, bufs, sizes,
+			nthreads) :
+		    TIFFWriteEncodedStripsParallel(out, list, n, bufs, sizes,
+			nthreads)))
+			break;
+		if (nread < nrows)
 			break;
 	}
-	(void) TIFFClose(out);
+
+bad:
 	if (buf)
 		_TIFFfree(buf);
-	return (0);
+	if (tilebuf)
+		_TIFFfree(tilebuf);
+	if (list)
+		_TIFFfree(list);
+	if (bufs)
+		_TIFFfree(bufs);
+	if (sizes)
+		_TIFFfree(sizes);
+	return status;
 }
 
 static void
@@ -354,6 +489,10 @@ char* stuff[] = {
 "where options are:",
 " -r #		make each strip have no more than # rows",
 " -R #		set x&y resolution (dpi)",
+" -t		write output as tiles",
+" -w #		set output tile width (pixels)",
+" -l #		set output tile length (pixels)",
+" -j #		compress on # threads (default one per processor)",
 "",
 " -c jpeg[:opts]  compress output with JPEG encoding",
 " -c lzw[:opts]	compress output with Lempel-Ziv & Welch encoding",
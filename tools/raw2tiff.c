@@ -58,6 +58,7 @@
 
 #include "tiffiop.h"
 #include "tiffio.h"
+#include "toolthreads.h"
 
 #ifndef HAVE_GETOPT
 extern int getopt(int, char**, char*);
@@ -67,16 +68,35 @@ extern int getopt(int, char**, char*);
 # define O_BINARY 0
 #endif
 
+#define	BATCH_SIZE	(16*1024*1024)	/* bytes of input per batch */
+#define	CHUNKSPERTHREAD	4
+
 typedef enum {
 	PIXEL,
 	BAND
 } InterleavingType;
 
+typedef struct {
+	int	fd;
+	const char* name;
+	_TIFF_off_t hdr_size;		/* size of the header to skip */
+	uint32	width;
+	uint32	length;
+	uint32	nbands;			/* number of bands in input image*/
+	int16	depth;			/* bytes per sample in input image */
+	TIFFDataType dtype;
+	int	swab;			/* byte swapping flag */
+	InterleavingType interleaving;
+	unsigned char* bandbuf;		/* rows of a band with -i band */
+} RawInput;
+
 static	uint16 compression = (uint16) -1;
 static	int jpegcolormode = JPEGCOLORMODE_RGB;
 static	int quality = 75;		/* JPEG quality */
 static	uint16 predictor = 0;
+static	int nthreads = 0;		/* threads, 0 for one per processor */
 
+static int writeImage(RawInput*, TIFF*, const char*, uint32, uint32);
 static void swapBytesInScanline(void *, uint32, TIFFDataType);
 static int guessSize(int, TIFFDataType, _TIFF_off_t, uint32, int,
 		     uint32 *, uint32 *);
@@ -87,7 +107,7 @@ static	int processCompressOptions(char*);
 int
 main(int argc, char* argv[])
 {
-	uint32	width = 0, length = 0, linebytes, bufsize;
+	uint32	width = 0, length = 0;
 	uint32	nbands = 1;		    /* number of bands in input image*/
 	_TIFF_off_t hdr_size = 0;	    /* size of the header to skip */
 	TIFFDataType dtype = TIFF_BYTE;
@@ -101,16 +121,15 @@ main(int argc, char* argv[])
 	int	fd;
 	char	*outfilename = NULL;
 	TIFF	*out;
-
-	uint32 row, col, band;
-	int	c;
-	unsigned char *buf = NULL, *buf1 = NULL;
+	RawInput input;
+	uint32	tilesize = 0, tilewidth, tilelength;
+	int	c, status;
 #if !HAVE_DECL_OPTARG
 	extern int optind;
 	extern char* optarg;
 #endif
 
-	while ((c = getopt(argc, argv, "c:r:H:w:l:b:d:LMp:si:o:h")) != -1) {
+	while ((c = getopt(argc, argv, "c:r:H:w:l:b:d:LMp:si:o:htT:j:")) != -1) {
 		switch (c) {
 		case 'c':		/* compression scheme */
 			if (!processCompressOptions(optarg))
@@ -192,6 +211,16 @@ main(int argc, char* argv[])
 		case 'o':
 			outfilename = optarg;
 			break;
+		case 't':		/* write tiles */
+			if (tilesize == 0)
+				tilesize = (uint32) -1;
+			break;
+		case 'T':		/* tile width and length */
+			tilesize = atoi(optarg);
+			break;
+		case 'j':		/* threads */
+			nthreads = atoi(optarg);
+			break;
 		case 'h':
 			usage();
 		default:
@@ -264,79 +293,235 @@ main(int argc, char* argv[])
 			TIFFSetField(out, TIFFTAG_PREDICTOR, predictor);
 		break;
 	}
-	switch(interleaving) {
-	case BAND:				/* band interleaved data */
-		linebytes = width * depth;
-		buf = (unsigned char *)_TIFFmalloc(linebytes);
-		break;
-	case PIXEL:				/* pixel interleaved data */
-	default:
-		linebytes = width * nbands * depth;
-		break;
+	if (tilesize) {
+		tilewidth = tilelength = tilesize == (uint32) -1 ? 0 : tilesize;
+		TIFFDefaultTileSize(out, &tilewidth, &tilelength);
+		TIFFSetField(out, TIFFTAG_TILEWIDTH, tilewidth);
+		TIFFSetField(out, TIFFTAG_TILELENGTH, tilelength);
+		rowsperstrip = tilelength;
+	} else {
+		rowsperstrip = TIFFDefaultStripSize(out, rowsperstrip);
+		if (rowsperstrip > length) {
+			rowsperstrip = length;
+		}
+		TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rowsperstrip );
 	}
-	bufsize = width * nbands * depth;
-	buf1 = (unsigned char *)_TIFFmalloc(bufsize);
 
-	rowsperstrip = TIFFDefaultStripSize(out, rowsperstrip);
-	if (rowsperstrip > length) {
-		rowsperstrip = length;
-	}
-	TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rowsperstrip );
-
-	_TIFF_lseek_f(fd, hdr_size, SEEK_SET);		/* Skip the file header */
-	for (row = 0; row < length; row++) {
-		switch(interleaving) {
-		case BAND:			/* band interleaved data */
-			for (band = 0; band < nbands; band++) {
-				if (_TIFF_lseek_f(fd,
-                                          hdr_size + (length*band+row)*linebytes,
-                                          SEEK_SET) == (_TIFF_off_t)-1) {
-                                        fprintf(stderr,
-                                                "%s: %s: scanline %lu: seek error.\n",
-                                                argv[0], argv[optind],
-                                                (unsigned long) row);
-                                        break;
-                                }
-				if (read(fd, buf, linebytes) < 0) {
+	input.fd = fd;
+	input.name = argv[optind];
+	input.hdr_size = hdr_size;
+	input.width = width;
+	input.length = length;
+	input.nbands = nbands;
+	input.depth = depth;
+	input.dtype = dtype;
+	input.swab = swab;
+	input.interleaving = interleaving;
+	status = writeImage(&input, out, outfilename, rowsperstrip,
+			    tilesize ? tilewidth : 0);
+	TIFFClose(out);
+	return (status ? 0 : 1);
+}
+
+/*
+ * Read rows [row, row+nrows) of the input, pixel interleaved, into buf.
+ * Rows past the end of the file are zeros.
+ */
+static int
+readRows(RawInput* in, unsigned char* buf, uint32 row, uint32 nrows)
+{
+	tmsize_t linebytes = (tmsize_t) in->width * in->depth;
+	tmsize_t rowbytes = linebytes * in->nbands;
+	uint32	band, r, col;
+
+	if (in->interleaving != BAND) {
+		tmsize_t size = rowbytes * nrows, got = 0, n;
+
+		while (got < size) {
+			n = read(in->fd, buf + got, (size_t)(size - got));
+			if (n < 0) {
+				fprintf(stderr, "%s: scanline %lu: Read error.\n",
+					in->name, (unsigned long) (row + got / rowbytes));
+				return 0;
+			}
+			if (n == 0)
+				break;
+			got += n;
+		}
+		if (got < size)
+			_TIFFmemset(buf + got, 0, size - got);
+	} else {
+		for (band = 0; band < in->nbands; band++) {
+			tmsize_t size = linebytes * nrows, got = 0, n;
+			unsigned char* src = in->bandbuf;
+
+			if (_TIFF_lseek_f(in->fd, in->hdr_size +
+			    ((_TIFF_off_t) in->length * band + row) * linebytes,
+			    SEEK_SET) == (_TIFF_off_t)-1) {
+				fprintf(stderr, "%s: scanline %lu: seek error.\n",
+					in->name, (unsigned long) row);
+				return 0;
+			}
+			while (got < size) {
+				n = read(in->fd, src + got, (size_t)(size - got));
+				if (n < 0) {
 					fprintf(stderr,
-                                                "%s: %s: scanline %lu: Read error.\n",
-                                                argv[0], argv[optind],
-                                                (unsigned long) row);
-                                        break;
+						"%s: scanline %lu: Read error.\n",
+						in->name,
+						(unsigned long) (row + got / linebytes));
+					return 0;
 				}
-				if (swab)	/* Swap bytes if needed */
-					swapBytesInScanline(buf, width, dtype);
-				for (col = 0; col < width; col++)
-					memcpy(buf1 + (col*nbands+band)*depth,
-					       buf + col * depth, depth);
+				if (n == 0)
+					break;
+				got += n;
 			}
-			break;
-		case PIXEL:			/* pixel interleaved data */
-		default:
-			if (read(fd, buf1, bufsize) < 0) {
-				fprintf(stderr,
-					"%s: %s: scanline %lu: Read error.\n",
-					argv[0], argv[optind],
-					(unsigned long) row);
-				break;
+			if (got < size)
+				_TIFFmemset(src + got, 0, size - got);
+			for (r = 0; r < nrows; r++) {
+				unsigned char* dst = buf + r * rowbytes +
+				    band * in->depth;
+				for (col = 0; col < in->width; col++) {
+					memcpy(dst, src, in->depth);
+					dst += in->nbands * in->depth;
+					src += in->depth;
+				}
 			}
-			if (swab)		/* Swap bytes if needed */
-				swapBytesInScanline(buf1, width, dtype);
-			break;
 		}
-				
-		if (TIFFWriteScanline(out, buf1, row, 0) < 0) {
-			fprintf(stderr,	"%s: %s: scanline %lu: Write error.\n",
-				argv[0], outfilename, (unsigned long) row);
-			break;
+	}
+	if (in->swab)		/* Swap bytes if needed */
+		swapBytesInScanline(buf, in->width * in->nbands * nrows,
+				    in->dtype);
+	return 1;
+}
+
+/*
+ * Write the image in batches of whole strips or rows of tiles read with
+ * large reads, compressing the strips or tiles of each batch on threads.
+ */
+static int
+writeImage(RawInput* in, TIFF* out, const char* outname, uint32 rowsperstrip,
+	   uint32 tilewidth)
+{
+	tmsize_t rowbytes = (tmsize_t) in->width * in->nbands * in->depth;
+	tmsize_t chunksize;
+	uint32	nchunks, across, perbatch, batchrows, row, nrows, i, n;
+	unsigned char* buf = NULL;
+	unsigned char* tilebuf = NULL;
+	uint32*	list = NULL;
+	void**	bufs = NULL;
+	tmsize_t* sizes = NULL;
+	int	threads = nthreads > 0 ? nthreads : toolGetNumCPUs();
+	int	status = 0;
+
+	if (tilewidth) {
+		across = TIFFhowmany_32(in->width, tilewidth);
+		chunksize = TIFFTileSize(out);
+		nchunks = TIFFNumberOfTiles(out);
+	} else {
+		across = 1;
+		chunksize = rowsperstrip * rowbytes;
+		nchunks = TIFFNumberOfStrips(out);
+	}
+	if (rowbytes == 0 || rowbytes / in->width / in->nbands != in->depth ||
+	    chunksize <= 0 || nchunks == 0) {
+		fprintf(stderr, "%s: Invalid image size.\n", in->name);
+		return 0;
+	}
+	/* at least a few chunks per thread, at most about BATCH_SIZE bytes */
+	perbatch = (uint32) (BATCH_SIZE / (rowsperstrip * rowbytes));
+	if (perbatch < (uint32) threads * CHUNKSPERTHREAD / across)
+		perbatch = (uint32) threads * CHUNKSPERTHREAD / across;
+	if (perbatch == 0)
+		perbatch = 1;
+	if (perbatch > TIFFhowmany_32(in->length, rowsperstrip))
+		perbatch = TIFFhowmany_32(in->length, rowsperstrip);
+	batchrows = perbatch * rowsperstrip;
+
+	buf = (unsigned char*) _TIFFCheckMalloc(out, batchrows, rowbytes,
+						"input buffer");
+	list = (uint32*) _TIFFCheckMalloc(out, perbatch * across,
+					  sizeof (uint32), "chunk list");
+	bufs = (void**) _TIFFCheckMalloc(out, perbatch * across,
+					 sizeof (void*), "chunk list");
+	sizes = (tmsize_t*) _TIFFCheckMalloc(out, perbatch * across,
+					     sizeof (tmsize_t), "chunk list");
+	if (tilewidth)
+		tilebuf = (unsigned char*) _TIFFCheckMalloc(out,
+		    (tmsize_t) perbatch * across, chunksize, "tile buffer");
+	if (in->interleaving == BAND)
+		in->bandbuf = (unsigned char*) _TIFFCheckMalloc(out,
+		    batchrows, (tmsize_t) in->width * in->depth, "band buffer");
+	if (!buf || !list || !bufs || !sizes || (tilewidth && !tilebuf) ||
+	    (in->interleaving == BAND && !in->bandbuf))
+		goto bad;
+
+	_TIFF_lseek_f(in->fd, in->hdr_size, SEEK_SET);	/* Skip the file header */
+	for (row = 0; row < in->length; row += nrows) {
+		nrows = in->length - row < batchrows ? in->length - row : batchrows;
+		if (!readRows(in, buf, row, nrows))
+			goto bad;
+		n = 0;
+		if (tilewidth) {
+			tmsize_t tilerowbytes = (tmsize_t) tilewidth *
+			    in->nbands * in->depth;
+			uint32 r, t, col;
+
+			_TIFFmemset(tilebuf, 0, perbatch * across * chunksize);
+			for (r = 0; r < nrows; r += rowsperstrip) {
+				for (col = 0; col < in->width; col += tilewidth) {
+					unsigned char* tile = tilebuf + n * chunksize;
+					tmsize_t bytes = tilerowbytes;
+
+					if (col + tilewidth > in->width)
+						bytes = (tmsize_t) (in->width - col) *
+						    in->nbands * in->depth;
+					for (t = 0; t < rowsperstrip && r + t < nrows; t++)
+						_TIFFmemcpy(tile + t * tilerowbytes,
+						    buf + (r + t) * rowbytes +
+						    (tmsize_t) col * in->nbands * in->depth,
+						    bytes);
+					list[n] = TIFFComputeTile(out, col, row + r, 0, 0);
+					bufs[n] = tile;
+					sizes[n] = chunksize;
+					n++;
+				}
+			}
+		} else {
+			for (i = 0; i < nrows; i += rowsperstrip) {
+				list[n] = (row + i) / rowsperstrip;
+				bufs[n] = buf + i * rowbytes;
+				sizes[n] = (nrows - i < rowsperstrip ?
+				    nrows - i : rowsperstrip) * rowbytes;
+				n++;
+			}
+		}
+		if (!(tilewidth ?
+		    TIFFWriteEncodedTilesParallel(out, list, n, bufs, sizes,
+			nthreads) :
+		    TIFFWriteEncodedStripsParallel(out, list, n, bufs, sizes,
+			nthreads))) {
+			fprintf(stderr,	"%s: scanline %lu: Write error.\n",
+				outname, (unsigned long) row);
+			goto bad;
 		}
 	}
+	status = 1;
+
+bad:
+	if (in->bandbuf)
+		_TIFFfree(in->bandbuf);
+	in->bandbuf = NULL;
 	if (buf)
 		_TIFFfree(buf);
-	if (buf1)
-		_TIFFfree(buf1);
-	TIFFClose(out);
-	return (0);
+	if (tilebuf)
+		_TIFFfree(tilebuf);
+	if (list)
+		_TIFFfree(list);
+	if (bufs)
+		_TIFFfree(bufs);
+	if (sizes)
+		_TIFFfree(sizes);
+	return status;
 }
 
 static void
@@ -661,6 +846,9 @@ static char* stuff[] = {
 "LZW and deflate options:",
 " #		set predictor value",
 "For example, -c lzw:2 to get LZW-encoded data with horizontal differencing",
+" -t		write output as tiles",
+" -T #		write output as tiles of # by # pixels",
+" -j #		compress on # threads (default one per processor)",
 " -o out.tif	write output to out.tif",
 " -h		this help message",
 NULL
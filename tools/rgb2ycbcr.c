@@ -38,6 +38,7 @@
 
 #include "tiffiop.h"
 #include "tiffio.h"
+#include "toolthreads.h"
 
 #define	streq(a,b)	(strcmp(a,b) == 0)
 #define	CopyField(tag, v) \
@@ -48,12 +49,9 @@
 #endif
 #define	roundup(x, y)	(howmany(x,y)*((uint32)(y)))
 
-#define	LumaRed		ycbcrCoeffs[0]
-#define	LumaGreen	ycbcrCoeffs[1]
-#define	LumaBlue	ycbcrCoeffs[2]
-
 uint16	compression = COMPRESSION_PACKBITS;
 uint32	rowsperstrip = (uint32) -1;
+int	nthreads = 0;			/* default is one per processor */
 
 uint16	horizSubSampling = 2;		/* YCbCr horizontal subsampling */
 uint16	vertSubSampling = 2;		/* YCbCr vertical subsampling */
@@ -63,7 +61,6 @@ float	refBlackWhite[6] = { 0.F, 255.F, 128.F, 255.F, 128.F, 255.F };
 
 static	int tiffcvt(TIFF* in, TIFF* out);
 static	void usage(int code);
-static	void setupLumaTables(void);
 
 int
 main(int argc, char* argv[])
@@ -75,7 +72,7 @@ main(int argc, char* argv[])
 	extern char *optarg;
 #endif
 
-	while ((c = getopt(argc, argv, "c:h:r:v:z")) != -1)
+	while ((c = getopt(argc, argv, "c:h:j:r:v:z")) != -1)
 		switch (c) {
 		case 'c':
 			if (streq(optarg, "none"))
@@ -101,6 +98,9 @@ main(int argc, char* argv[])
             if( vertSubSampling != 1 && vertSubSampling != 2 && vertSubSampling != 4 )
                 usage(-1);
 			break;
+		case 'j':
+			nthreads = atoi(optarg);
+			break;
 		case 'r':
 			rowsperstrip = atoi(optarg);
 			break;
@@ -121,7 +121,6 @@ main(int argc, char* argv[])
 	out = TIFFOpen(argv[argc-1], "w");
 	if (out == NULL)
 		return (-2);
-	setupLumaTables();
 	for (; optind < argc-1; optind++) {
 		in = TIFFOpen(argv[optind], "r");
 		if (in != NULL) {
@@ -139,144 +138,104 @@ main(int argc, char* argv[])
 	return (0);
 }
 
-float	*lumaRed;
-float	*lumaGreen;
-float	*lumaBlue;
-float	D1, D2;
-int	Yzero;
-
-static float*
-setupLuma(float c)
-{
-	float *v = (float *)_TIFFmalloc(256 * sizeof (float));
-	int i;
-	for (i = 0; i < 256; i++)
-		v[i] = c * i;
-	return (v);
-}
-
-static unsigned
-V2Code(float f, float RB, float RW, int CR)
-{
-	unsigned int c = (unsigned int)((((f)*(RW-RB)/CR)+RB)+.5);
-	return (c > 255 ? 255 : c);
-}
+/*
+ * The strips of an image are converted from the RGBA raster on nthreads
+ * threads, each converting a share of the strips, and then compressed
+ * and written by TIFFWriteEncodedStripsParallel().
+ */
+#define	MAX_THREADS	64
+
+typedef struct {
+	uint32*	raster;		/* RGBA image, bottom row first */
+	uint32	width;
+	uint32	height;
+	uint32	nrows;		/* rows per strip */
+	uint32	first;		/* first strip of the share */
+	uint32	nstrips;
+	void**	bufs;		/* converted strips */
+} StripWork;
 
 static void
-setupLumaTables(void)
+cvtStrips(void* arg)
 {
-	lumaRed = setupLuma(LumaRed);
-	lumaGreen = setupLuma(LumaGreen);
-	lumaBlue = setupLuma(LumaBlue);
-	D1 = 1.F/(2.F - 2.F*LumaBlue);
-	D2 = 1.F/(2.F - 2.F*LumaRed);
-	Yzero = V2Code(0, refBlackWhite[0], refBlackWhite[1], 255);
-}
+	StripWork* w = (StripWork*) arg;
+	uint32 s;
 
-static void
-cvtClump(unsigned char* op, uint32* raster, uint32 ch, uint32 cw, uint32 w)
-{
-	float Y, Cb = 0, Cr = 0;
-	uint32 j, k;
-	/*
-	 * Convert ch-by-cw block of RGB
-	 * to YCbCr and sample accordingly.
-	 */
-	for (k = 0; k < ch; k++) {
-		for (j = 0; j < cw; j++) {
-			uint32 RGB = (raster - k*w)[j];
-			Y = lumaRed[TIFFGetR(RGB)] +
-			    lumaGreen[TIFFGetG(RGB)] +
-			    lumaBlue[TIFFGetB(RGB)];
-			/* accumulate chrominance */
-			Cb += (TIFFGetB(RGB) - Y) * D1;
-			Cr += (TIFFGetR(RGB) - Y) * D2;
-			/* emit luminence */
-			*op++ = V2Code(Y,
-			    refBlackWhite[0], refBlackWhite[1], 255);
-		}
-		for (; j < horizSubSampling; j++)
-			*op++ = Yzero;
-	}
-	for (; k < vertSubSampling; k++) {
-		for (j = 0; j < horizSubSampling; j++)
-			*op++ = Yzero;
-	}
-	/* emit sampled chrominance values */
-	*op++ = V2Code(Cb / (ch*cw), refBlackWhite[2], refBlackWhite[3], 127);
-	*op++ = V2Code(Cr / (ch*cw), refBlackWhite[4], refBlackWhite[5], 127);
-}
-#undef LumaRed
-#undef LumaGreen
-#undef LumaBlue
-#undef V2Code
+	for (s = w->first; s < w->first + w->nstrips; s++) {
+		uint32 y = w->height - s * w->nrows;	/* rows above strip */
+		uint32 nr = (y > w->nrows ? w->nrows : y);
 
-/*
- * Convert a strip of RGB data to YCbCr and
- * sample to generate the output data.
- */
-static void
-cvtStrip(unsigned char* op, uint32* raster, uint32 nrows, uint32 width)
-{
-	uint32 x;
-	int clumpSize = vertSubSampling * horizSubSampling + 2;
-	uint32 *tp;
-
-	for (; nrows >= vertSubSampling; nrows -= vertSubSampling) {
-		tp = raster;
-		for (x = width; x >= horizSubSampling; x -= horizSubSampling) {
-			cvtClump(op, tp,
-			    vertSubSampling, horizSubSampling, width);
-			op += clumpSize;
-			tp += horizSubSampling;
-		}
-		if (x > 0) {
-			cvtClump(op, tp, vertSubSampling, x, width);
-			op += clumpSize;
-		}
-		raster -= vertSubSampling*width;
-	}
-	if (nrows > 0) {
-		tp = raster;
-		for (x = width; x >= horizSubSampling; x -= horizSubSampling) {
-			cvtClump(op, tp, nrows, horizSubSampling, width);
-			op += clumpSize;
-			tp += horizSubSampling;
-		}
-		if (x > 0)
-			cvtClump(op, tp, nrows, x, width);
+		TIFFRGBAToYCbCr8((uint8*) w->bufs[s],
+		    w->raster + (tmsize_t) (y - 1) * w->width,
+		    -(tmsize_t) w->width, w->width, nr, horizSubSampling,
+		    vertSubSampling, ycbcrCoeffs, refBlackWhite);
 	}
 }
 
 static int
 cvtRaster(TIFF* tif, uint32* raster, uint32 width, uint32 height)
 {
-	uint32 y;
-	tstrip_t strip = 0;
-	tsize_t cc, acc;
+	StripWork work[MAX_THREADS];
+	void* args[MAX_THREADS];
+	uint32 s, first, nstrips;
+	tsize_t cc;
 	unsigned char* buf;
+	uint32* strips;
+	void** bufs;
+	tmsize_t* sizes;
 	uint32 rwidth = roundup(width, horizSubSampling);
 	uint32 rheight = roundup(height, vertSubSampling);
 	uint32 nrows = (rowsperstrip > rheight ? rheight : rowsperstrip);
-        uint32 rnrows = roundup(nrows,vertSubSampling);
+	uint32 rnrows = roundup(nrows,vertSubSampling);
+	int t, ok;
 
+	if (nthreads <= 0)
+		nthreads = toolGetNumCPUs();
+	if (nthreads > MAX_THREADS)
+		nthreads = MAX_THREADS;
 	cc = rnrows*rwidth +
 	    2*((rnrows*rwidth) / (horizSubSampling*vertSubSampling));
-	buf = (unsigned char*)_TIFFmalloc(cc);
-	// FIXME unchecked malloc
-	for (y = height; (int32) y > 0; y -= nrows) {
-		uint32 nr = (y > nrows ? nrows : y);
-		cvtStrip(buf, raster + (y-1)*width, nr, width);
-		nr = roundup(nr, vertSubSampling);
-		acc = nr*rwidth +
-			2*((nr*rwidth)/(horizSubSampling*vertSubSampling));
-		if (!TIFFWriteEncodedStrip(tif, strip++, buf, acc)) {
-			_TIFFfree(buf);
-			return (0);
-		}
+	nstrips = howmany(height, nrows);
+	buf = (unsigned char*)_TIFFmalloc(
+	    TIFFSafeMultiply(tmsize_t, nstrips, cc));
+	strips = (uint32*)_TIFFmalloc(nstrips * sizeof (uint32));
+	bufs = (void**)_TIFFmalloc(nstrips * sizeof (void*));
+	sizes = (tmsize_t*)_TIFFmalloc(nstrips * sizeof (tmsize_t));
+	ok = buf != NULL && strips != NULL && bufs != NULL && sizes != NULL;
+	if (!ok) {
+		TIFFError(TIFFFileName(tif), "No space for strip buffers");
+		goto done;
+	}
+	for (s = 0; s < nstrips; s++) {
+		uint32 nr = height - s * nrows;
+
+		nr = roundup(nr > nrows ? nrows : nr, vertSubSampling);
+		strips[s] = s;
+		bufs[s] = buf + (tmsize_t) s * cc;
+		sizes[s] = nr*rwidth +
+		    2*((nr*rwidth)/(horizSubSampling*vertSubSampling));
 	}
+	for (t = 0, first = 0; t < nthreads; t++) {
+		work[t].raster = raster;
+		work[t].width = width;
+		work[t].height = height;
+		work[t].nrows = nrows;
+		work[t].first = first;
+		work[t].nstrips = nstrips / nthreads +
+		    ((uint32) t < nstrips % nthreads);
+		work[t].bufs = bufs;
+		args[t] = &work[t];
+		first += work[t].nstrips;
+	}
+	toolRunThreads(nthreads, cvtStrips, args);
+	ok = TIFFWriteEncodedStripsParallel(tif, strips, nstrips, bufs, sizes,
+	    nthreads);
+done:
 	_TIFFfree(buf);
-	return (1);
+	_TIFFfree(strips);
+	_TIFFfree(bufs);
+	_TIFFfree(sizes);
+	return (ok);
 }
 
 static int
@@ -314,9 +273,21 @@ tiffcvt(TIFF* in, TIFF* out)
   		return (0);
   	}
 
-	if (!TIFFReadRGBAImage(in, width, height, raster, 0)) {
+	{ TIFFRGBAImage img;
+	  char emsg[1024];
+
+	  if (!TIFFRGBAImageBegin(&img, in, 0, emsg)) {
+		TIFFError(TIFFFileName(in), "%s", emsg);
+		_TIFFfree(raster);
+		return (0);
+	  }
+	  result = TIFFRGBAImageGetParallel(&img, raster, width, height,
+	      nthreads);
+	  TIFFRGBAImageEnd(&img);
+	  if (!result) {
 		_TIFFfree(raster);
 		return (0);
+	  }
 	}
 
 	CopyField(TIFFTAG_SUBFILETYPE, longv);
@@ -357,7 +328,7 @@ tiffcvt(TIFF* in, TIFF* out)
 }
 
 char* stuff[] = {
-    "usage: rgb2ycbcr [-c comp] [-r rows] [-h N] [-v N] input... output\n",
+    "usage: rgb2ycbcr [-c comp] [-r rows] [-h N] [-v N] [-j threads] input... output\n",
     "where comp is one of the following compression algorithms:\n",
     " jpeg\t\tJPEG encoding\n",
     " lzw\t\tLempel-Ziv & Welch encoding\n",
@@ -368,6 +339,7 @@ char* stuff[] = {
     " -r\trows/strip\n",
     " -h\thorizontal sampling factor (1,2,4)\n",
     " -v\tvertical sampling factor (1,2,4)\n",
+    " -j\tconvert on # threads (default one per processor)\n",
     NULL
 };
 
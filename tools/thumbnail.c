@@ -38,6 +38,7 @@
 #endif
 
 #include "tiffio.h"
+#include "toolthreads.h"
 
 #ifndef HAVE_GETOPT
 extern int getopt(int, char**, char*);
@@ -45,10 +46,7 @@ extern int getopt(int, char**, char*);
 
 #define	streq(a,b)	(strcmp(a,b) == 0)
 
-#ifndef TIFFhowmany8
-# define TIFFhowmany8(x) (((x)&0x07)?((uint32)(x)>>3)+1:(uint32)(x)>>3)
-#endif
-
+#define	MAX_THREADS	64
 typedef enum {
     EXP50,
     EXP60,
@@ -62,11 +60,11 @@ typedef enum {
 static	uint32 tnw = 216;		/* thumbnail width */
 static	uint32 tnh = 274;		/* thumbnail height */
 static	Contrast contrast = LINEAR;	/* current contrast */
-static	uint8* thumbnail;
+static	int nthreads = 0;		/* threads, 0 for one per processor */
 
+static	tmsize_t multiply_ms(tmsize_t, tmsize_t);
 static	int cpIFD(TIFF*, TIFF*);
-static	int generateThumbnail(TIFF*, TIFF*);
-static	void initScale();
+static	int generateThumbnails(TIFF*, TIFF*, const char*);
 static	void usage(void);
 
 #if !HAVE_DECL_OPTARG
@@ -81,7 +79,7 @@ main(int argc, char* argv[])
     TIFF* out;
     int c;
 
-    while ((c = getopt(argc, argv, "w:h:c:")) != -1) {
+    while ((c = getopt(argc, argv, "w:h:c:j:")) != -1) {
 	switch (c) {
 	case 'w':	tnw = strtoul(optarg, NULL, 0); break;
 	case 'h':	tnh = strtoul(optarg, NULL, 0); break;
@@ -94,6 +92,7 @@ main(int argc, char* argv[])
 				   streq(optarg, "linear")? LINEAR :
 							    EXP;
 			break;
+	case 'j':	nthreads = atoi(optarg); break;
 	default:	usage();
 	}
     }
@@ -107,28 +106,14 @@ main(int argc, char* argv[])
     if( in == NULL )
         return 2;
 
-    thumbnail = (uint8*) _TIFFmalloc(tnw * tnh);
-    if (!thumbnail) {
-	    TIFFError(TIFFFileName(in),
-		      "Can't allocate space for thumbnail buffer.");
-	    return 1;
-    }
-
-    if (in != NULL) {
-	initScale();
-	do {
-	    if (!generateThumbnail(in, out))
-		goto bad;
-	    if (!cpIFD(in, out) || !TIFFWriteDirectory(out))
-		goto bad;
-	} while (TIFFReadDirectory(in));
+    if (!generateThumbnails(in, out, argv[optind])) {
 	(void) TIFFClose(in);
+	(void) TIFFClose(out);
+	return 1;
     }
+    (void) TIFFClose(in);
     (void) TIFFClose(out);
     return 0;
-bad:
-    (void) TIFFClose(out);
-    return 1;
 }
 
 #define	CopyField(tag, v) \
@@ -151,6 +136,9 @@ cpTag(TIFF* in, TIFF* out, uint16 tag, uint16 count, TIFFDataType type)
 		} else if (count == 2) {
 			uint16 shortv1, shortv2;
 			CopyField2(tag, shortv1, shortv2);
+		} else if (count == 3) {
+			uint16 *tr, *tg, *tb;
+			CopyField3(tag, tr, tg, tb);
 		} else if (count == 4) {
 			uint16 *tr, *tg, *tb, *ta;
 			CopyField4(tag, tr, tg, tb, ta);
@@ -226,6 +214,8 @@ static struct cpTag {
     { TIFFTAG_FILLORDER,		1, TIFF_SHORT },
     { TIFFTAG_SAMPLESPERPIXEL,		1, TIFF_SHORT },
     { TIFFTAG_ROWSPERSTRIP,		1, TIFF_LONG },
+    { TIFFTAG_TILEWIDTH,		1, TIFF_LONG },
+    { TIFFTAG_TILELENGTH,		1, TIFF_LONG },
     { TIFFTAG_PLANARCONFIG,		1, TIFF_SHORT },
     { TIFFTAG_GROUP3OPTIONS,		1, TIFF_LONG },
     { TIFFTAG_SUBFILETYPE,		1, TIFF_LONG },
@@ -266,6 +256,7 @@ static struct cpTag {
     { TIFFTAG_YCBCRPOSITIONING,		1, TIFF_SHORT },
     { TIFFTAG_REFERENCEBLACKWHITE,	(uint16) -1,TIFF_RATIONAL },
     { TIFFTAG_EXTRASAMPLES,		(uint16) -1, TIFF_SHORT },
+    { TIFFTAG_COLORMAP,			3, TIFF_SHORT },
 };
 #define	NTAGS	(sizeof (tags) / sizeof (tags[0]))
 
@@ -294,6 +285,17 @@ cpTags(TIFF* in, TIFF* out)
 		}
 		cpTag(in, out, p->tag, p->count, p->type);
 	}
+	{
+		/* the raw strips or tiles of JPEG pages need their tables */
+		uint16 compression;
+		uint32 count;
+		void* table;
+		if( TIFFGetField(in, TIFFTAG_COMPRESSION, &compression) &&
+			compression == COMPRESSION_JPEG &&
+			TIFFGetField(in, TIFFTAG_JPEGTABLES, &count, &table) &&
+			count > 0 && table )
+			TIFFSetField(out, TIFFTAG_JPEGTABLES, count, table);
+	}
 }
 #undef NTAGS
 
@@ -379,15 +381,21 @@ cpIFD(TIFF* in, TIFF* out)
     return (1);
 }
 
-static	uint16	photometric;		/* current photometric of raster */
-static	uint16	filterWidth;		/* filter width in pixels */
-static	uint32	stepSrcWidth;		/* src image stepping width */
-static	uint32	stepDstWidth;		/* dest stepping width */
-static	uint8* src0;			/* horizontal bit stepping (start) */
-static	uint8* src1;			/* horizontal bit stepping (middle) */
-static	uint8* src2;			/* horizontal bit stepping (end) */
-static	uint32* rowoff;			/* row offset for stepping */
-static	uint8 cmap[256];		/* colormap indexes */
+/*
+ * State of the scaling of a page; each thread has its own.
+ */
+typedef struct {
+    uint16	photometric;		/* current photometric of raster */
+    uint16	filterWidth;		/* filter width in pixels */
+    uint32	stepSrcWidth;		/* src image stepping width */
+    uint32	stepDstWidth;		/* dest stepping width */
+    uint8*	src0;			/* horizontal bit stepping (start) */
+    uint8*	src1;			/* horizontal bit stepping (middle) */
+    uint8*	src2;			/* horizontal bit stepping (end) */
+    uint32*	rowoff;			/* row offset for stepping */
+    uint8	cmap[256];		/* colormap indexes */
+} Scale;
+
 static	uint8 bits[256];		/* count of bits set */
 
 static void
@@ -427,7 +435,7 @@ expFill(float pct[], uint32 p, uint32 n)
 }
 
 static void
-setupCmap()
+setupCmap(Scale* sc)
 {
     float pct[256];			/* known to be large enough */
     uint32 i;
@@ -444,28 +452,37 @@ setupCmap()
 	    pct[i] = 1-((float)i)/(256-1);
 	break;
     }
-    switch (photometric) {
+    switch (sc->photometric) {
     case PHOTOMETRIC_MINISWHITE:
 	for (i = 0; i < 256; i++)
-	    cmap[i] = clamp(255*pct[(256-1)-i], 0, 255);
+	    sc->cmap[i] = clamp(255*pct[(256-1)-i], 0, 255);
 	break;
     case PHOTOMETRIC_MINISBLACK:
 	for (i = 0; i < 256; i++)
-	    cmap[i] = clamp(255*pct[i], 0, 255);
+	    sc->cmap[i] = clamp(255*pct[i], 0, 255);
 	break;
     }
 }
 
+static int
+initScale(Scale* sc)
+{
+    sc->src0 = (uint8*) _TIFFmalloc(sizeof (uint8) * tnw);
+    sc->src1 = (uint8*) _TIFFmalloc(sizeof (uint8) * tnw);
+    sc->src2 = (uint8*) _TIFFmalloc(sizeof (uint8) * tnw);
+    sc->rowoff = (uint32*) _TIFFmalloc(sizeof (uint32) * tnw);
+    sc->filterWidth = 0;
+    sc->stepDstWidth = sc->stepSrcWidth = 0;
+    return (sc->src0 && sc->src1 && sc->src2 && sc->rowoff);
+}
+
 static void
-initScale()
+freeScale(Scale* sc)
 {
-    src0 = (uint8*) _TIFFmalloc(sizeof (uint8) * tnw);
-    src1 = (uint8*) _TIFFmalloc(sizeof (uint8) * tnw);
-    src2 = (uint8*) _TIFFmalloc(sizeof (uint8) * tnw);
-    rowoff = (uint32*) _TIFFmalloc(sizeof (uint32) * tnw);
-    filterWidth = 0;
-    stepDstWidth = stepSrcWidth = 0;
-    setupBitsTables();
+    _TIFFfree(sc->src0);
+    _TIFFfree(sc->src1);
+    _TIFFfree(sc->src2);
+    _TIFFfree(sc->rowoff);
 }
 
 /*
@@ -473,9 +490,9 @@ initScale()
  * according to the widths of the src and dst images.
  */
 static void
-setupStepTables(uint32 sw)
+setupStepTables(Scale* sc, uint32 sw)
 {
-    if (stepSrcWidth != sw || stepDstWidth != tnw) {
+    if (sc->stepSrcWidth != sw || sc->stepDstWidth != tnw) {
 	int step = sw;
 	int limit = tnw;
 	int err = 0;
@@ -490,32 +507,32 @@ setupStepTables(uint32 sw)
 		err -= limit;
 		sx++;
 	    }
-	    rowoff[x] = sx0 >> 3;
+	    sc->rowoff[x] = sx0 >> 3;
 	    fw = sx - sx0;		/* width */
 	    b = (fw < 8) ? 0xff<<(8-fw) : 0xff;
-	    src0[x] = b >> (sx0&7);
+	    sc->src0[x] = b >> (sx0&7);
 	    fw -= 8 - (sx0&7);
 	    if (fw < 0)
 		fw = 0;
-	    src1[x] = fw >> 3;
+	    sc->src1[x] = fw >> 3;
 	    fw -= (fw>>3)<<3;
-	    src2[x] = 0xff << (8-fw);
+	    sc->src2[x] = 0xff << (8-fw);
 	}
-	stepSrcWidth = sw;
-	stepDstWidth = tnw;
+	sc->stepSrcWidth = sw;
+	sc->stepDstWidth = tnw;
     }
 }
 
 static void
-setrow(uint8* row, uint32 nrows, const uint8* rows[])
+setrow(Scale* sc, uint8* row, uint32 nrows, const uint8* rows[])
 {
     uint32 x;
-    uint32 area = nrows * filterWidth;
+    uint32 area = nrows * sc->filterWidth;
     for (x = 0; x < tnw; x++) {
-	uint32 mask0 = src0[x];
-	uint32 fw = src1[x];
-	uint32 mask1 = src1[x];
-	uint32 off = rowoff[x];
+	uint32 mask0 = sc->src0[x];
+	uint32 fw = sc->src1[x];
+	uint32 mask1 = sc->src2[x];
+	uint32 off = sc->rowoff[x];
 	uint32 acc = 0;
 	uint32 y, i;
 	for (y = 0; y < nrows; y++) {
@@ -538,8 +555,39 @@ setrow(uint8* row, uint32 nrows, const uint8* rows[])
 	    }
 	    acc += bits[*src & mask1];
 	}
-	*row++ = cmap[(255*acc)/area];
+	*row++ = sc->cmap[(255*acc)/area];
+    }
+}
+
+/*
+ * The rows of a bilevel image are decoded a strip at a time as the
+ * box filter gets to them, and kept only while it needs them, so only
+ * a strip and the rows of one box are in memory.  Strips none of whose
+ * rows are in a box are not read.
+ */
+typedef struct {
+    TIFF*	tif;
+    uint32	rps;
+    tmsize_t	rowsize;
+    tstrip_t	strip;			/* strip in buf */
+    uint8*	buf;
+} StripReader;
+
+static void
+getRow(StripReader* sr, uint32 row, uint8* dst)
+{
+    tstrip_t s = row / sr->rps;
+
+    if (s >= TIFFNumberOfStrips(sr->tif)) {
+	_TIFFmemset(dst, 0, sr->rowsize);
+	return;
+    }
+    if (s != sr->strip) {
+	if (TIFFReadEncodedStrip(sr->tif, s, sr->buf, -1) < 0)
+	    _TIFFmemset(sr->buf, 0, TIFFStripSize(sr->tif));
+	sr->strip = s;
     }
+    _TIFFmemcpy(dst, sr->buf + (row % sr->rps) * sr->rowsize, sr->rowsize);
 }
 
 /*
@@ -548,21 +596,30 @@ setrow(uint8* row, uint32 nrows, const uint8* rows[])
  * a box filter.  The resultant pixels are mapped
  * with a user-selectable contrast curve.
  */
-static void
-setImage1(const uint8* br, uint32 rw, uint32 rh)
+static int
+setImage1(Scale* sc, StripReader* sr, uint8* thumbnail, uint32 rh)
 {
     int step = rh;
     int limit = tnh;
     int err = 0;
-    int bpr = TIFFhowmany8(rw);
     int sy = 0;
     uint8* row = thumbnail;
+    uint8* box;
     uint32 dy;
+	/* +3 : add a few guard bytes since setrow() can read a bit */
+	/* outside a row */
+    box = (uint8*) _TIFFmalloc(256 * sr->rowsize + 3);
+    if (!box) {
+	TIFFError(TIFFFileName(sr->tif),
+		  "Can't allocate space for raster buffer.");
+	return 0;
+    }
+    _TIFFmemset(box + 256 * sr->rowsize, 0, 3);
     for (dy = 0; dy < tnh; dy++) {
 	const uint8* rows[256];
 	uint32 nrows = 1;
-	fprintf(stderr, "bpr=%d, sy=%d, bpr*sy=%d\n", bpr, sy, bpr*sy);
-	rows[0] = br + bpr*sy;
+	getRow(sr, sy, box);
+	rows[0] = box;
 	err += step;
 	while (err >= limit) {
 	    err -= limit;
@@ -573,63 +630,143 @@ setImage1(const uint8* br, uint32 rw, uint32 rh)
 			/* code... */
 			if( nrows == 256 )
 				break;
-			rows[nrows++] = br + bpr*sy;
+			rows[nrows] = box + nrows * sr->rowsize;
+			getRow(sr, sy, box + nrows * sr->rowsize);
+			nrows++;
 		}
 	}
-	setrow(row, nrows, rows);
+	setrow(sc, row, nrows, rows);
 	row += tnw;
     }
+    _TIFFfree(box);
+    return 1;
 }
 
-static void
-setImage(const uint8* br, uint32 rw, uint32 rh)
+static int
+setImage(Scale* sc, TIFF* in, uint8* thumbnail, uint32 rw, uint32 rh)
+{
+    StripReader sr;
+    int ok;
+
+    sr.tif = in;
+    TIFFGetFieldDefaulted(in, TIFFTAG_ROWSPERSTRIP, &sr.rps);
+    if (sr.rps > rh)
+	sr.rps = rh;
+    sr.rowsize = TIFFScanlineSize(in);
+    sr.strip = (tstrip_t) -1;
+    sr.buf = (uint8*) _TIFFmalloc(TIFFStripSize(in));
+    if (!sr.buf || sr.rps == 0) {
+	TIFFError(TIFFFileName(in),
+		  "Can't allocate space for strip buffer.");
+	_TIFFfree(sr.buf);
+	return 0;
+    }
+    sc->filterWidth = (uint16) ceil((double) rw / (double) tnw);
+    setupStepTables(sc, rw);
+    ok = setImage1(sc, &sr, thumbnail, rh);
+    _TIFFfree(sr.buf);
+    return ok;
+}
+
+static tmsize_t
+multiply_ms(tmsize_t m1, tmsize_t m2)
 {
-    filterWidth = (uint16) ceil((double) rw / (double) tnw);
-    setupStepTables(rw);
-    setImage1(br, rw, rh);
+    tmsize_t bytes = m1 * m2;
+
+    if (m1 && bytes / m1 != m2)
+	bytes = 0;
+    return bytes;
 }
 
+/*
+ * Other images are read scaled by TIFFReadRGBAImageScaled(), which
+ * averages boxes of pixels as the strips or tiles are decoded and
+ * lets the JPEG codec scale in the DCT.  The luminance of the result
+ * goes through the contrast curve.
+ */
 static int
-generateThumbnail(TIFF* in, TIFF* out)
+setImageScaled(Scale* sc, TIFF* in, uint8* thumbnail)
 {
-    unsigned char* raster;
-    unsigned char* rp;
-    uint32 sw, sh, rps;
-    uint16 bps, spp;
-    tsize_t rowsize, rastersize;
-    tstrip_t s, ns = TIFFNumberOfStrips(in);
-    toff_t diroff[1];
+    uint32* raster;
+    uint32 x, y;
+    char emsg[1024];
 
-    TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &sw);
-    TIFFGetField(in, TIFFTAG_IMAGELENGTH, &sh);
-    TIFFGetFieldDefaulted(in, TIFFTAG_BITSPERSAMPLE, &bps);
-    TIFFGetFieldDefaulted(in, TIFFTAG_SAMPLESPERPIXEL, &spp);
-    TIFFGetFieldDefaulted(in, TIFFTAG_ROWSPERSTRIP, &rps);
-    if (spp != 1 || bps != 1)
+    if (!TIFFRGBAImageOK(in, emsg)) {
+	TIFFError(TIFFFileName(in), "%s", emsg);
 	return 0;
-    rowsize = TIFFScanlineSize(in);
-    rastersize = sh * rowsize;
-    fprintf(stderr, "rastersize=%u\n", (unsigned int)rastersize);
-	/* +3 : add a few guard bytes since setrow() can read a bit */
-	/* outside buffer */
-    raster = (unsigned char*)_TIFFmalloc(rastersize+3);
+    }
+    raster = (uint32*) _TIFFmalloc(multiply_ms(multiply_ms(tnw, tnh),
+					       sizeof (uint32)));
     if (!raster) {
-	    TIFFError(TIFFFileName(in),
-		      "Can't allocate space for raster buffer.");
-	    return 0;
+	TIFFError(TIFFFileName(in), "No space for raster buffer");
+	return 0;
+    }
+    if (!TIFFReadRGBAImageScaled(in, tnw, tnh, raster, 0)) {
+	_TIFFfree(raster);
+	return 0;
     }
-    raster[rastersize] = 0;
-    raster[rastersize+1] = 0;
-    raster[rastersize+2] = 0;
-    rp = raster;
-    for (s = 0; s < ns; s++) {
-	(void) TIFFReadEncodedStrip(in, s, rp, -1);
-	rp += rps * rowsize;
+    sc->photometric = PHOTOMETRIC_MINISBLACK;
+    setupCmap(sc);
+    /* the raster has its origin at the lower left */
+    for (y = 0; y < tnh; y++) {
+	const uint32* rp = raster + (tnh - 1 - y) * tnw;
+	uint8* row = thumbnail + y * tnw;
+	for (x = 0; x < tnw; x++, rp++)
+	    row[x] = sc->cmap[(77 * TIFFGetR(*rp) + 150 * TIFFGetG(*rp) +
+				29 * TIFFGetB(*rp) + 128) >> 8];
     }
-    TIFFGetField(in, TIFFTAG_PHOTOMETRIC, &photometric);
-    setupCmap();
-    setImage(raster, sw, sh);
     _TIFFfree(raster);
+    return 1;
+}
+
+static int
+makeThumbnail(TIFF* in, Scale* sc, uint8* thumbnail)
+{
+    uint32 sw, sh;
+    uint16 bps, spp;
+
+    TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &sw);
+    TIFFGetField(in, TIFFTAG_IMAGELENGTH, &sh);
+    TIFFGetFieldDefaulted(in, TIFFTAG_BITSPERSAMPLE, &bps);
+    TIFFGetFieldDefaulted(in, TIFFTAG_SAMPLESPERPIXEL, &spp);
+    if (spp != 1 || bps != 1 || TIFFIsTiled(in))
+	return setImageScaled(sc, in, thumbnail);
+    TIFFGetField(in, TIFFTAG_PHOTOMETRIC, &sc->photometric);
+    setupCmap(sc);
+    return setImage(sc, in, thumbnail, sw, sh);
+}
+
+/*
+ * With -j the thumbnails of a batch of pages are made on threads, each
+ * with its handle on the input file, thread t doing pages t, t +
+ * nthreads, ...  The pages are then written in order.
+ */
+typedef struct {
+    TIFF*	tif;
+    Scale	scale;
+    uint32	first;			/* first page of the batch */
+    uint32	npages;
+    int		thread;
+    uint8*	thumbnails;		/* thumbnails of the batch */
+    char*	ok;			/* pages that were done */
+} Worker;
+
+static void
+makeThumbnails(void* arg)
+{
+    Worker* w = (Worker*) arg;
+    uint32 p;
+
+    for (p = w->thread; p < w->npages; p += nthreads)
+	w->ok[p] = TIFFSetDirectory(w->tif, (uint16) (w->first + p)) &&
+	    makeThumbnail(w->tif, &w->scale,
+			  w->thumbnails + (tmsize_t) p * tnw * tnh);
+}
+
+static int
+writeThumbnail(TIFF* in, TIFF* out, uint8* thumbnail)
+{
+    toff_t diroff[1];
 
     TIFFSetField(out, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE);
     TIFFSetField(out, TIFFTAG_IMAGEWIDTH, (uint32) tnw);
@@ -650,11 +787,86 @@ generateThumbnail(TIFF* in, TIFF* out)
             TIFFWriteDirectory(out) != -1);
 }
 
+static int
+generateThumbnails(TIFF* in, TIFF* out, const char* name)
+{
+    Worker workers[MAX_THREADS];
+    void* args[MAX_THREADS];
+    uint8* thumbnails = NULL;
+    char* ok = NULL;
+    uint32 npages = TIFFNumberOfDirectories(in), batch, first, p;
+    int t, ret = 0;
+
+    if (nthreads <= 0)
+	nthreads = toolGetNumCPUs();
+    if (nthreads > MAX_THREADS)
+	nthreads = MAX_THREADS;
+    if ((uint32) nthreads > npages)
+	nthreads = npages > 0 ? npages : 1;
+    batch = 4 * nthreads;
+    setupBitsTables();
+    memset(workers, 0, sizeof (workers));
+    for (t = 0; t < nthreads; t++) {
+	workers[t].tif = t == 0 ? in : TIFFOpen(name, "r");
+	if (!workers[t].tif || !initScale(&workers[t].scale)) {
+	    if (t == 0) {
+		TIFFError(TIFFFileName(in), "Can't allocate space for scaling.");
+		goto done;
+	    }
+	    if (workers[t].tif)
+		TIFFClose(workers[t].tif);
+	    workers[t].tif = NULL;
+	    freeScale(&workers[t].scale);
+	    nthreads = t;
+	    break;
+	}
+	workers[t].thread = t;
+	args[t] = &workers[t];
+    }
+    thumbnails = (uint8*) _TIFFmalloc(multiply_ms(batch,
+						  multiply_ms(tnw, tnh)));
+    ok = (char*) _TIFFmalloc(batch);
+    if (!thumbnails || !ok) {
+	TIFFError(TIFFFileName(in), "No space for thumbnail buffer");
+	goto done;
+    }
+    for (first = 0; first < npages; first += batch) {
+	uint32 n = npages - first < batch ? npages - first : batch;
+
+	for (t = 0; t < nthreads; t++) {
+	    workers[t].first = first;
+	    workers[t].npages = n;
+	    workers[t].thumbnails = thumbnails;
+	    workers[t].ok = ok;
+	}
+	toolRunThreads(nthreads, makeThumbnails, args);
+	for (p = 0; p < n; p++) {
+	    if (!ok[p] || !TIFFSetDirectory(in, (uint16) (first + p)))
+		goto done;
+	    if (!writeThumbnail(in, out, thumbnails + (tmsize_t) p * tnw * tnh))
+		goto done;
+	    if (!cpIFD(in, out) || !TIFFWriteDirectory(out))
+		goto done;
+	}
+    }
+    ret = 1;
+done:
+    for (t = 0; t < MAX_THREADS; t++) {
+	if (workers[t].tif && workers[t].tif != in)
+	    TIFFClose(workers[t].tif);
+	freeScale(&workers[t].scale);
+    }
+    _TIFFfree(thumbnails);
+    _TIFFfree(ok);
+    return ret;
+}
+
 char* stuff[] = {
 "usage: thumbnail [options] input.tif output.tif",
 "where options are:",
 " -h #		specify thumbnail image height (default is 274)",
 " -w #		specify thumbnail image width (default is 216)",
+" -j #		work on # threads (default one per processor)",
 "",
 " -c linear	use linear contrast curve",
 " -c exp50	use 50% exponential contrast curve",
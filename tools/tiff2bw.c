@@ -39,7 +39,7 @@
 
 #include "tiffio.h"
 
-#define	streq(a,b)	(strcmp((a),(b)) == 0)
+#define	streq(a,b)	(strcmp(a,b) == 0)
 #define	strneq(a,b,n)	(strncmp(a,b,n) == 0)
 
 /* x% weighting -> fraction of full color */
@@ -51,28 +51,31 @@ int	BLUE = PCT(11);		/* 11% */
 static	void usage(void);
 static	int processCompressOptions(char*);
 
+/*
+ * The weighted sums are done by the library, with SIMD instructions
+ * where the CPU has them.
+ */
 static void
 compresscontig(unsigned char* out, unsigned char* rgb, uint32 n)
 {
-	register int v, red = RED, green = GREEN, blue = BLUE;
+	int32 weights[3];
 
-	while (n-- > 0) {
-		v = red*(*rgb++);
-		v += green*(*rgb++);
-		v += blue*(*rgb++);
-		*out++ = v>>8;
-	}
+	weights[0] = RED;
+	weights[1] = GREEN;
+	weights[2] = BLUE;
+	TIFFRGBToGrey8(out, rgb, rgb+1, rgb+2, n, 3, weights);
 }
 
 static void
 compresssep(unsigned char* out,
 	    unsigned char* r, unsigned char* g, unsigned char* b, uint32 n)
 {
-	register uint32 red = RED, green = GREEN, blue = BLUE;
+	int32 weights[3];
 
-	while (n-- > 0)
-		*out++ = (unsigned char)
-			((red*(*r++) + green*(*g++) + blue*(*b++)) >> 8);
+	weights[0] = RED;
+	weights[1] = GREEN;
+	weights[2] = BLUE;
+	TIFFRGBToGrey8(out, r, g, b, n, 1, weights);
 }
 
 static int
@@ -85,20 +88,30 @@ checkcmap(TIFF* tif, int n, uint16* r, uint16* g, uint16* b)
 	return (8);
 }
 
+/*
+ * Grey value of each of the 256 colormap entries.
+ */
 static void
-compresspalette(unsigned char* out, unsigned char* data, uint32 n, uint16* rmap, uint16* gmap, uint16* bmap)
+greypalette(unsigned char* grey, uint16* rmap, uint16* gmap, uint16* bmap)
 {
 	register int v, red = RED, green = GREEN, blue = BLUE;
+	unsigned int ix;
 
-	while (n-- > 0) {
-		unsigned int ix = *data++;
+	for (ix = 0; ix < 256; ix++) {
 		v = red*rmap[ix];
 		v += green*gmap[ix];
 		v += blue*bmap[ix];
-		*out++ = v>>8;
+		grey[ix] = v>>8;
 	}
 }
 
+static void
+compresspalette(unsigned char* out, unsigned char* data, uint32 n, unsigned char* grey)
+{
+	while (n-- > 0)
+		*out++ = grey[*data++];
+}
+
 static	uint16 compression = (uint16) -1;
 static	uint16 predictor = 0;
 static	int jpegcolormode = JPEGCOLORMODE_RGB;
@@ -123,6 +136,7 @@ main(int argc, char* argv[])
 	register uint32 row;
 	register tsample_t s;
 	unsigned char *inbuf, *outbuf;
+	unsigned char grey[256];
 	char thing[1024];
 	int c;
 #if !HAVE_DECL_OPTARG
@@ -243,11 +257,12 @@ main(int argc, char* argv[])
 			}
 #undef CVT
 		}
+		greypalette(grey, red, green, blue);
 		inbuf = (unsigned char *)_TIFFmalloc(TIFFScanlineSize(in));
 		for (row = 0; row < h; row++) {
 			if (TIFFReadScanline(in, inbuf, row, 0) < 0)
 				break;
-			compresspalette(outbuf, inbuf, w, red, green, blue);
+			compresspalette(outbuf, inbuf, w, grey);
 			if (TIFFWriteScanline(out, outbuf, row, 0) < 0)
 				break;
 		}
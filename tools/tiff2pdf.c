@@ -52,6 +52,7 @@
 
 #include "tiffiop.h"
 #include "tiffio.h"
+#include "toolthreads.h"
 
 #ifndef HAVE_GETOPT
 extern int getopt(int, char**, char*);
@@ -242,6 +243,7 @@ typedef struct {
 	uint16* tiff_transferfunction[3];
 	int pdf_image_interpolate;	/* 0 (default) : do not interpolate,
 					   1 : interpolate */
+	int pdf_threads;		/* pages whose images are prepared at once */
 	uint16 tiff_transferfunctioncount;
 	uint32 pdf_icccs;
 	uint32 tiff_iccprofilelength;
@@ -253,6 +255,16 @@ typedef struct {
 	tsize_t outputwritten;
 } T2P;
 
+/* This struct holds the image stream of a page prepared on another thread. */
+typedef struct {
+	T2P* t2p;		/* context of the PDF being written */
+	const char* filename;	/* input file */
+	tdir_t page;
+	FILE* file;		/* the stream, or NULL if it was not prepared */
+	tsize_t written;	/* length of the stream */
+	t2p_err_t error;	/* set if preparing the stream failed */
+} T2P_STREAM;
+
 /* These functions are called by main. */
 
 void tiff2pdf_usage(void);
@@ -283,7 +295,11 @@ int t2p_tile_is_bottom_edge(T2P_TILES, ttile_t);
 int t2p_tile_is_edge(T2P_TILES, ttile_t);
 int t2p_tile_is_corner_edge(T2P_TILES, ttile_t);
 tsize_t t2p_readwrite_pdf_image(T2P*, TIFF*, TIFF*);
+tsize_t t2p_readwrite_pdf_image_strips(T2P*, TIFF*, TIFF*);
 tsize_t t2p_readwrite_pdf_image_tile(T2P*, TIFF*, TIFF*, ttile_t);
+void t2p_prepare_pdf_image(void*);
+int t2p_prepare_pdf_images(T2P*, TIFF*, T2P_STREAM*);
+tsize_t t2p_write_pdf_prepared_image(T2P_STREAM*, TIFF*);
 #ifdef OJPEG_SUPPORT
 int t2p_process_ojpeg_tables(T2P*, TIFF*);
 #endif
@@ -427,6 +443,14 @@ t2p_closeproc(thandle_t handle)
 	return fclose(t2p->outputfile);
 }
 
+static int 
+t2p_preparedcloseproc(thandle_t handle)
+{ 
+	/* the stream is kept until it is copied to the output */
+	(void) handle;
+	return 0;
+}
+
 static uint64 
 t2p_sizeproc(thandle_t handle) 
 {
@@ -565,6 +589,7 @@ checkMultiply64(uint64 first, uint64 second, T2P* t2p)
     -F: make the tiff fill the PDF page
     -f: set pdf "fit window" user preference
     -b:	set PDF "Interpolate" user preference
+    -T: prepare the images of this many pages at once (0: one per processor)
     -e: date, overrides image or current date/time default, YYYYMMDDHHMMSS
     -c: creator, overrides image software default
     -a: author, overrides image artist default
@@ -617,7 +642,7 @@ int main(int argc, char** argv){
 
 	while (argv &&
 	       (c = getopt(argc, argv,
-			   "o:q:u:x:y:w:l:r:p:e:c:a:t:s:k:jzndifbhF")) != -1){
+			   "o:q:u:x:y:w:l:r:p:e:c:a:t:s:k:T:jzndifbhF")) != -1){
 		switch (c) {
 			case 'o':
 				outfilename = optarg;
@@ -738,6 +763,17 @@ int main(int argc, char** argv){
 			case 'b':
 				t2p->pdf_image_interpolate = 1;
 				break;
+			case 'T':
+				t2p->pdf_threads = atoi(optarg);
+				if (t2p->pdf_threads < 0) {
+					TIFFError(TIFF2PDF_MODULE,
+						  "Bad number of threads %s",
+						  optarg);
+					goto fail;
+				}
+				if (t2p->pdf_threads == 0)
+					t2p->pdf_threads = toolGetNumCPUs();
+				break;
 			case 'h': 
 			case '?': 
 				tiff2pdf_usage();
@@ -859,6 +895,7 @@ void tiff2pdf_usage(){
 	" -s: sets document subject, overrides image image description default",
 	" -k: sets document keywords",
 	" -b: set PDF \"Interpolate\" user preference",
+	" -T: prepare the images of # pages at once (0: one per processor)",
 	" -h: usage",
 	NULL
 	};
@@ -1789,9 +1826,22 @@ void t2p_read_tiff_data(T2P* t2p, TIFF* input){
 #ifdef ZIP_SUPPORT
 		if(t2p->tiff_compression== COMPRESSION_ADOBE_DEFLATE 
 			|| t2p->tiff_compression==COMPRESSION_DEFLATE){
-			if(TIFFIsTiled(input) || (TIFFNumberOfStrips(input)==1) ){
+			uint16 predictor=PREDICTOR_NONE;
+
+			/*
+			 * The PDF Flate filter undoes the TIFF horizontal
+			 * predictor, but there is no filter for the floating
+			 * point one, and the deflate streams of several
+			 * strips can't be joined.
+			 */
+			TIFFGetFieldDefaulted(input, TIFFTAG_PREDICTOR, &predictor);
+			if((TIFFIsTiled(input) || (TIFFNumberOfStrips(input)==1))
+			   && (predictor==PREDICTOR_NONE
+			       || predictor==PREDICTOR_HORIZONTAL)){
 				t2p->pdf_transcode = T2P_TRANSCODE_RAW;
 				t2p->pdf_compression=T2P_COMPRESS_ZIP;
+				t2p->pdf_compressionquality=
+					(predictor==PREDICTOR_HORIZONTAL) ? 2 : 0;
 			}
 		}
 #endif
@@ -1813,6 +1863,7 @@ void t2p_read_tiff_data(T2P* t2p, TIFF* input){
 
 	if(t2p->pdf_transcode!=T2P_TRANSCODE_RAW){
 		t2p->pdf_compression = t2p->pdf_defaultcompression;
+		t2p->pdf_compressionquality = t2p->pdf_defaultcompressionquality;
 	}
 
 #ifdef JPEG_SUPPORT
@@ -2212,6 +2263,7 @@ tsize_t t2p_readwrite_pdf_image(T2P* t2p, TIFF* input, TIFF* output){
 	tsize_t stripsize=0;
 	tsize_t sepstripcount=0;
 	tsize_t sepstripsize=0;
+	int streamstrips=0;
 #ifdef OJPEG_SUPPORT
 	toff_t inputoffset=0;
 	uint16 h_samp=1;
@@ -2416,23 +2468,12 @@ tsize_t t2p_readwrite_pdf_image(T2P* t2p, TIFF* input, TIFF* output){
 #ifdef JPEG_SUPPORT
 		if(t2p->tiff_compression == COMPRESSION_JPEG) {
 			uint32 count = 0;
-			buffer = (unsigned char*)
-				_TIFFmalloc(t2p->tiff_datasize);
-			if(buffer==NULL){
-				TIFFError(TIFF2PDF_MODULE, 
-	"Can't allocate %lu bytes of memory for t2p_readwrite_pdf_image, %s", 
-					(unsigned long) t2p->tiff_datasize, 
-					TIFFFileName(input));
-				t2p->t2p_error = T2P_ERR_ERROR;
-				return(0);
-			}
-                        memset(buffer, 0, t2p->tiff_datasize);
-			if (TIFFGetField(input, TIFFTAG_JPEGTABLES, &count, &jpt) != 0) {
-				if(count > 4) {
-					_TIFFmemcpy(buffer, jpt, count);
-					bufferoffset += count - 2;
-				}
-			}
+
+			/*
+			 * The strips are joined into a single JPEG stream with
+			 * restart markers; each is written out as soon as it
+			 * is processed, so that only one strip is in memory.
+			 */
 			stripcount=TIFFNumberOfStrips(input);
 			TIFFGetField(input, TIFFTAG_STRIPBYTECOUNTS, &sbc);
 			for(i=0;i<stripcount;i++){
@@ -2440,45 +2481,71 @@ tsize_t t2p_readwrite_pdf_image(T2P* t2p, TIFF* input, TIFF* output){
 			}
 			stripbuffer = (unsigned char*)
 				_TIFFmalloc(max_striplength);
-			if(stripbuffer==NULL){
+			/* room for the DRI marker added to the first strip */
+			buffer = (unsigned char*)
+				_TIFFmalloc((tsize_t) max_striplength + 6);
+			if(stripbuffer==NULL || buffer==NULL){
 				TIFFError(TIFF2PDF_MODULE, 
 	"Can't allocate %u bytes of memory for t2p_readwrite_pdf_image, %s", 
 					max_striplength, 
 					TIFFFileName(input));
+				_TIFFfree(stripbuffer);
 				_TIFFfree(buffer);
 				t2p->t2p_error = T2P_ERR_ERROR;
 				return(0);
 			}
+			if (TIFFGetField(input, TIFFTAG_JPEGTABLES, &count, &jpt) != 0) {
+				if(count > 4) {
+					/* don't use EOI of the tables */
+					written += t2pWriteFile(output, (tdata_t) jpt,
+								count - 2);
+				}
+			}
 			for(i=0;i<stripcount;i++){
 				striplength=TIFFReadRawStrip(input, i, (tdata_t) stripbuffer, -1);
+				bufferoffset=0;
 				if(!t2p_process_jpeg_strip(
 					stripbuffer, 
 					&striplength, 
 					buffer,
-                    t2p->tiff_datasize,
+                    (tsize_t) max_striplength + 6,
 					&bufferoffset, 
 					i, 
 					t2p->tiff_length)){
 						TIFFError(TIFF2PDF_MODULE, 
 				"Can't process JPEG data in input file %s", 
 							TIFFFileName(input));
-						_TIFFfree(samplebuffer);
+						_TIFFfree(stripbuffer);
 						_TIFFfree(buffer);
 						t2p->t2p_error = T2P_ERR_ERROR;
 						return(0);
 				}
+				written += t2pWriteFile(output, (tdata_t) buffer,
+							bufferoffset);
 			}
-			buffer[bufferoffset++]=0xff; 
-			buffer[bufferoffset++]=0xd9;
-			t2pWriteFile(output, (tdata_t) buffer, bufferoffset);
+			buffer[0]=0xff; 
+			buffer[1]=0xd9;
+			written += t2pWriteFile(output, (tdata_t) buffer, 2);
 			_TIFFfree(stripbuffer);
 			_TIFFfree(buffer);
-			return(bufferoffset);
+			return(written);
 		}
 #endif /* ifdef JPEG_SUPPORT */
 		(void)0;
 	}
 
+	/*
+	 * Uncompressed and Flate output can be fed a row at a time: the
+	 * strips are then decoded one by one while the output is written,
+	 * rather than into a buffer for the whole image.
+	 */
+	if(t2p->pdf_sample==T2P_SAMPLE_NOTHING
+	   && (t2p->pdf_compression==T2P_COMPRESS_NONE
+	       || t2p->pdf_compression==T2P_COMPRESS_ZIP)){
+		streamstrips=1;
+		goto dataready;
+	}
+
 	if(t2p->pdf_sample==T2P_SAMPLE_NOTHING){
 		buffer = (unsigned char*) _TIFFmalloc(t2p->tiff_datasize);
 		if(buffer==NULL){
@@ -2742,10 +2809,10 @@ dataready:
 #ifdef ZIP_SUPPORT
 	case T2P_COMPRESS_ZIP:
 		TIFFSetField(output, TIFFTAG_COMPRESSION, COMPRESSION_DEFLATE);
-		if(t2p->pdf_defaultcompressionquality%100 != 0){
+		if(t2p->pdf_compressionquality%100 != 0){
 			TIFFSetField(output, 
 				TIFFTAG_PREDICTOR, 
-				t2p->pdf_defaultcompressionquality % 100);
+				t2p->pdf_compressionquality % 100);
 		}
 		if(t2p->pdf_defaultcompressionquality/100 != 0){
 			TIFFSetField(output, 
@@ -2760,6 +2827,11 @@ dataready:
 
 	t2p_enable(output);
 	t2p->outputwritten = 0;
+	if(streamstrips){
+		bufferoffset = t2p_readwrite_pdf_image_strips(t2p, input, output);
+		if(t2p->t2p_error != T2P_ERR_OK)
+			return(0);
+	} else
 #ifdef JPEG_SUPPORT
 	if(t2p->pdf_compression == T2P_COMPRESS_JPEG
 	   && t2p->tiff_photometric == PHOTOMETRIC_YCBCR){
@@ -2790,6 +2862,215 @@ dataready:
 	return(written);
 }
 
+/*
+ * This function decodes the strips of the input TIFF one at a time and
+ * writes their rows to the output set up by t2p_readwrite_pdf_image, so
+ * that only one strip is held in memory.  It returns -1 if writing the
+ * output failed and sets t2p_error if decoding the input failed.
+ */
+
+tsize_t t2p_readwrite_pdf_image_strips(T2P* t2p, TIFF* input, TIFF* output){
+
+	unsigned char* buffer=NULL;
+	tsize_t stripsize=TIFFStripSize(input);
+	tsize_t scanlinesize=TIFFScanlineSize(input);
+	tstrip_t stripcount=TIFFNumberOfStrips(input);
+	tstrip_t i=0;
+	tsize_t read=0;
+	tsize_t k=0;
+	uint32 row=0;
+
+	buffer = (unsigned char*) _TIFFmalloc(stripsize);
+	if(buffer==NULL || scanlinesize==0){
+		TIFFError(TIFF2PDF_MODULE, 
+	"Can't allocate %lu bytes of memory for t2p_readwrite_pdf_image_strips, %s", 
+			(unsigned long) stripsize, 
+			TIFFFileName(input));
+		_TIFFfree(buffer);
+		t2p->t2p_error = T2P_ERR_ERROR;
+		return(0);
+	}
+	for(i=0;i<stripcount && row<t2p->tiff_length;i++){
+		read = TIFFReadEncodedStrip(input, i, (tdata_t) buffer, stripsize);
+		if(read==-1){
+			TIFFError(TIFF2PDF_MODULE, 
+				"Error on decoding strip %u of %s", 
+				i, 
+				TIFFFileName(input));
+			_TIFFfree(buffer);
+			t2p->t2p_error=T2P_ERR_ERROR;
+			return(0);
+		}
+		for(k=0;k+scanlinesize<=read && row<t2p->tiff_length;k+=scanlinesize){
+			if(TIFFWriteScanline(output, &buffer[k], row++, 0)==-1){
+				_TIFFfree(buffer);
+				return(-1);
+			}
+		}
+	}
+	/* rows missing from the input are written blank */
+	memset(buffer, 0, scanlinesize);
+	while(row<t2p->tiff_length){
+		if(TIFFWriteScanline(output, buffer, row++, 0)==-1){
+			_TIFFfree(buffer);
+			return(-1);
+		}
+	}
+	_TIFFfree(buffer);
+	if(!TIFFFlushData(output))
+		return(-1);
+
+	return(1);
+}
+
+/*
+ * This function prepares the image stream of a strip page on a thread of
+ * its own.  It opens the input file again and writes the stream to a
+ * temporary file with a copy of the context, so that it is the same as if
+ * t2p_readwrite_pdf_image had been called when the page is written.
+ */
+
+void t2p_prepare_pdf_image(void* arg){
+
+	T2P_STREAM* stream = (T2P_STREAM*) arg;
+	T2P* t2p = NULL;
+	TIFF* input = NULL;
+	TIFF* output = NULL;
+
+	t2p = (T2P*) _TIFFmalloc(sizeof(T2P));
+	if(t2p == NULL){
+		return;
+	}
+	_TIFFmemcpy(t2p, stream->t2p, sizeof(T2P));
+	t2p->tiff_pages = (T2P_PAGE*) _TIFFmalloc(
+		TIFFSafeMultiply(tmsize_t,t2p->tiff_pagecount,sizeof(T2P_PAGE)));
+	t2p->pdf_palette = NULL;
+#ifdef OJPEG_SUPPORT
+	t2p->pdf_ojpegdata = NULL;
+#endif
+	t2p->pdf_page = stream->page;
+	t2p->t2p_error = T2P_ERR_OK;
+	t2p->outputwritten = 0;
+	t2p->outputfile = tmpfile();
+	if(t2p->tiff_pages == NULL || t2p->outputfile == NULL){
+		goto done;
+	}
+	_TIFFmemcpy(t2p->tiff_pages, stream->t2p->tiff_pages,
+		    t2p->tiff_pagecount * sizeof(T2P_PAGE));
+
+	input = TIFFOpen(stream->filename, "r");
+	if(input == NULL){
+		goto done;
+	}
+	t2p_read_tiff_data(t2p, input);
+	if(t2p->t2p_error == T2P_ERR_OK){
+		t2p_read_tiff_size(t2p, input);
+		t2p->outputdisable = 1;
+		output = TIFFClientOpen(stream->filename, "w", (thandle_t) t2p,
+					t2p_readproc, t2p_writeproc, t2p_seekproc, 
+					t2p_preparedcloseproc, t2p_sizeproc, 
+					t2p_mapproc, t2p_unmapproc);
+		t2p->outputdisable = 0;
+		if(output == NULL){
+			goto done;
+		}
+		stream->written = t2p_readwrite_pdf_image(t2p, input, output);
+		t2p_disable(output);
+		TIFFClose(output);
+	}
+	if(t2p->t2p_error == T2P_ERR_OK){
+		stream->file = t2p->outputfile;
+		t2p->outputfile = NULL;
+	} else {
+		stream->error = t2p->t2p_error;
+	}
+
+done:
+	if(t2p->outputfile != NULL){
+		fclose(t2p->outputfile);
+	}
+	if(input != NULL){
+		TIFFClose(input);
+	}
+	_TIFFfree(t2p->tiff_pages);
+	if(t2p->pdf_palette != NULL){
+		_TIFFfree(t2p->pdf_palette);
+	}
+#ifdef OJPEG_SUPPORT
+	if(t2p->pdf_ojpegdata != NULL){
+		_TIFFfree(t2p->pdf_ojpegdata);
+	}
+#endif
+	_TIFFfree(t2p);
+	return;
+}
+
+/*
+ * This function prepares the image streams of the strip pages from the
+ * current one on, one page per thread.  It returns the number of pages
+ * the streams are for; a page whose stream could not be prepared, such as
+ * a tiled one, is left to be done in turn.
+ */
+
+int t2p_prepare_pdf_images(T2P* t2p, TIFF* input, T2P_STREAM* streams){
+
+	void** args=NULL;
+	int n=0;
+	int i=0;
+	int nargs=0;
+
+	while(n < t2p->pdf_threads && t2p->pdf_page + n < t2p->tiff_pagecount){
+		streams[n].t2p = t2p;
+		streams[n].filename = TIFFFileName(input);
+		streams[n].page = (tdir_t) (t2p->pdf_page + n);
+		streams[n].file = NULL;
+		streams[n].written = 0;
+		streams[n].error = T2P_ERR_OK;
+		n++;
+	}
+	args = (void**) _TIFFmalloc(TIFFSafeMultiply(tmsize_t,n,sizeof(void*)));
+	if(args == NULL){
+		return(n);
+	}
+	for(i=0;i<n;i++){
+		if(t2p->tiff_tiles[streams[i].page].tiles_tilecount == 0){
+			args[nargs++] = &streams[i];
+		}
+	}
+	if(nargs > 0){
+		toolRunThreads(nargs, t2p_prepare_pdf_image, args);
+	}
+	_TIFFfree(args);
+
+	return(n);
+}
+
+/*
+ * This function copies a prepared image stream to the output PDF.  It
+ * returns the amount written.
+ */
+
+tsize_t t2p_write_pdf_prepared_image(T2P_STREAM* stream, TIFF* output){
+
+	tsize_t written=0;
+	unsigned char buffer[16384];
+	size_t read=0;
+
+	rewind(stream->file);
+	while((read = fread(buffer, 1, sizeof(buffer), stream->file)) > 0){
+		written += t2pWriteFile(output, (tdata_t) buffer, (tmsize_t) read);
+	}
+	if(written != stream->written){
+		TIFFError(TIFF2PDF_MODULE, 
+			"Can't copy the prepared image of page %u to %s", 
+			(unsigned int) stream->page, 
+			TIFFFileName(output));
+		stream->t2p->t2p_error = T2P_ERR_ERROR;
+	}
+
+	return(written);
+}
+
 /*
  * This function reads the raster image data from the input TIFF for an image
  * tile and writes the data to the output PDF XObject image dictionary stream
@@ -3204,10 +3485,10 @@ tsize_t t2p_readwrite_pdf_image_tile(T2P* t2p, TIFF* input, TIFF* output, ttile_
 #ifdef ZIP_SUPPORT
 	case T2P_COMPRESS_ZIP:
 		TIFFSetField(output, TIFFTAG_COMPRESSION, COMPRESSION_DEFLATE);
-		if(t2p->pdf_defaultcompressionquality%100 != 0){
+		if(t2p->pdf_compressionquality%100 != 0){
 			TIFFSetField(output, 
 				TIFFTAG_PREDICTOR, 
-				t2p->pdf_defaultcompressionquality % 100);
+				t2p->pdf_compressionquality % 100);
 		}
 		if(t2p->pdf_defaultcompressionquality/100 != 0){
 			TIFFSetField(output, 
@@ -5249,6 +5530,9 @@ tsize_t t2p_write_pdf_xobject_stream_filter(ttile_t tile, T2P* t2p, TIFF* output
 	tsize_t written=0;
 	char buffer[32];
 	int buflen=0;
+#ifdef ZIP_SUPPORT
+	uint32 columns=0;
+#endif
 
 	if(t2p->pdf_compression==T2P_COMPRESS_NONE){
 		return(written);
@@ -5325,8 +5609,15 @@ tsize_t t2p_write_pdf_xobject_stream_filter(ttile_t tile, T2P* t2p, TIFF* output
 				check_snprintf_ret(t2p, buflen, buffer);
 				written += t2pWriteFile(output, (tdata_t) buffer, buflen);
 				written += t2pWriteFile(output, (tdata_t) " /Columns ", 10);
+				if(tile==0){
+					columns=t2p->tiff_width;
+				} else if(t2p_tile_is_right_edge(t2p->tiff_tiles[t2p->pdf_page], tile-1)==0){
+					columns=t2p->tiff_tiles[t2p->pdf_page].tiles_tilewidth;
+				} else {
+					columns=t2p->tiff_tiles[t2p->pdf_page].tiles_edgetilewidth;
+				}
 				buflen = snprintf(buffer, sizeof(buffer), "%lu",
-						 (unsigned long)t2p->tiff_width);
+						 (unsigned long)columns);
 				check_snprintf_ret(t2p, buflen, buffer);
 				written += t2pWriteFile(output, (tdata_t) buffer, buflen);
 				written += t2pWriteFile(output, (tdata_t) " /Colors ", 9);
@@ -5461,6 +5752,9 @@ tsize_t t2p_write_pdf(T2P* t2p, TIFF* input, TIFF* output){
 	ttile_t i2=0;
 	tsize_t streamlen=0;
 	uint16 i=0;
+	T2P_STREAM* streams=NULL;
+	int nstreams=0;
+	int s=0;
 
 	t2p_read_tiff_init(t2p, input);
 	if(t2p->t2p_error!=T2P_ERR_OK){return(0);}
@@ -5493,9 +5787,29 @@ tsize_t t2p_write_pdf(T2P* t2p, TIFF* input, TIFF* output){
 	written += t2p_write_pdf_obj_start(t2p->pdf_xrefcount, output);
 	written += t2p_write_pdf_pages(t2p, output);
 	written += t2p_write_pdf_obj_end(output);
+	if(t2p->pdf_threads > 1 && t2p->tiff_pagecount > 1){
+		streams = (T2P_STREAM*) _TIFFmalloc(
+			TIFFSafeMultiply(tmsize_t,t2p->pdf_threads,sizeof(T2P_STREAM)));
+		if(streams==NULL){
+			TIFFError(
+				TIFF2PDF_MODULE, 
+				"Can't allocate memory for t2p_write_pdf");
+			t2p->t2p_error = T2P_ERR_ERROR;
+			return(written);
+		}
+	}
 	for(t2p->pdf_page=0;t2p->pdf_page<t2p->tiff_pagecount;t2p->pdf_page++){
+		if(streams != NULL && s == nstreams){
+			nstreams=t2p_prepare_pdf_images(t2p, input, streams);
+			s=0;
+		}
+		if(s < nstreams && streams[s].error != T2P_ERR_OK){
+			/* the error has been reported by the thread */
+			t2p->t2p_error = streams[s].error;
+			goto fail;
+		}
 		t2p_read_tiff_data(t2p, input);
-		if(t2p->t2p_error!=T2P_ERR_OK){return(0);}
+		if(t2p->t2p_error!=T2P_ERR_OK){goto fail;}
 		t2p->pdf_xrefoffsets[t2p->pdf_xrefcount++]=written;
 		written += t2p_write_pdf_obj_start(t2p->pdf_xrefcount, output);
 		written += t2p_write_pdf_page(t2p->pdf_xrefcount, t2p, output);
@@ -5577,7 +5891,7 @@ tsize_t t2p_write_pdf(T2P* t2p, TIFF* input, TIFF* output){
 				t2p_read_tiff_size_tile(t2p, input, i2);
 				written += t2p_readwrite_pdf_image_tile(t2p, input, output, i2);
 				t2p_write_advance_directory(t2p, output);
-				if(t2p->t2p_error!=T2P_ERR_OK){return(0);}
+				if(t2p->t2p_error!=T2P_ERR_OK){goto fail;}
 				streamlen=written-streamlen;
 				written += t2p_write_pdf_stream_end(output);
 				written += t2p_write_pdf_obj_end(output);
@@ -5598,9 +5912,13 @@ tsize_t t2p_write_pdf(T2P* t2p, TIFF* input, TIFF* output){
 			written += t2p_write_pdf_stream_start(output);
 			streamlen=written;
 			t2p_read_tiff_size(t2p, input);
-			written += t2p_readwrite_pdf_image(t2p, input, output);
-			t2p_write_advance_directory(t2p, output);
-			if(t2p->t2p_error!=T2P_ERR_OK){return(0);}
+			if(s < nstreams && streams[s].file != NULL){
+				written += t2p_write_pdf_prepared_image(&streams[s], output);
+			} else {
+				written += t2p_readwrite_pdf_image(t2p, input, output);
+				t2p_write_advance_directory(t2p, output);
+			}
+			if(t2p->t2p_error!=T2P_ERR_OK){goto fail;}
 			streamlen=written-streamlen;
 			written += t2p_write_pdf_stream_end(output);
 			written += t2p_write_pdf_obj_end(output);
@@ -5609,13 +5927,27 @@ tsize_t t2p_write_pdf(T2P* t2p, TIFF* input, TIFF* output){
 			written += t2p_write_pdf_stream_length(streamlen, output);
 			written += t2p_write_pdf_obj_end(output);
 		}
+		if(s < nstreams){
+			if(streams[s].file != NULL)
+				fclose(streams[s].file);
+			s++;
+		}
 	}
 	t2p->pdf_startxref = written;
 	written += t2p_write_pdf_xreftable(t2p, output);
 	written += t2p_write_pdf_trailer(t2p, output);
 	t2p_disable(output);
+	_TIFFfree(streams);
 
 	return(written);
+
+fail:
+	for(;s<nstreams;s++){
+		if(streams[s].file != NULL)
+			fclose(streams[s].file);
+	}
+	_TIFFfree(streams);
+	return(0);
 }
 
 /* vim: set ts=8 sts=8 sw=8 noet: */
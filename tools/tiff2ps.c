@@ -231,6 +231,7 @@ int     exportMaskedImage(FILE *, double, double, double, double, int, int,
 #if	defined( EXP_ASCII85ENCODER)
 tsize_t Ascii85EncodeBlock( uint8 * ascii85_p, unsigned f_eod, const uint8 * raw_p, tsize_t raw_l );
 #endif
+tsize_t	HexEncodeBlock(uint8 *, const uint8 *, tsize_t, int *);
 
 static	void usage(int);
 
@@ -1712,6 +1713,40 @@ checkcmap(TIFF* tif, int n, uint16* r, uint16* g, uint16* b)
 	return (8);
 }
 
+/*
+ * Return whether the JPEG strips or tiles can be given as they are to the
+ * DCTDecode filter, that is 8-bit greyscale or RGB/YCbCr data without
+ * extra samples in a single plane, with any tables in JPEGTables.
+ */
+static int
+PS_JPEGPassthrough(TIFF* tif)
+{
+	uint16 tiffphotometric;
+	uint32 count;
+	unsigned char* tables;
+
+	if (compression != COMPRESSION_JPEG || bitspersample != 8 ||
+	    extrasamples != 0 || (planarconfiguration == PLANARCONFIG_SEPARATE &&
+	    samplesperpixel > 1))
+		return (0);
+	if (TIFFGetField(tif, TIFFTAG_JPEGTABLES, &count, &tables) &&
+	    count > 0) {
+		if (count < 4 || tables[count-2] != 0xff || tables[count-1] != 0xd9)
+			return (0);
+	}
+	TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &tiffphotometric);
+	switch (tiffphotometric) {
+	case PHOTOMETRIC_MINISBLACK:
+	case PHOTOMETRIC_MINISWHITE:
+		return (samplesperpixel == 1);
+	case PHOTOMETRIC_RGB:
+	case PHOTOMETRIC_YCBCR:
+		return (samplesperpixel == 3);
+	default:
+		return (0);
+	}
+}
+
 static void
 PS_Lvl2colorspace(FILE* fd, TIFF* tif)
 {
@@ -2040,17 +2075,27 @@ PS_Lvl2ImageDict(FILE* fd, TIFF* tif, uint32 w, uint32 h)
 		fputs(" /RunLengthDecode filter", fd);
 		use_rawdata = TRUE;
 	    break;
-	case COMPRESSION_OJPEG:		/* 6: !6.0 JPEG */
 	case COMPRESSION_JPEG:		/* 7: %JPEG DCT compression */
-#ifdef notdef
 		/*
-		 * Code not tested yet
+		 * PS_Lvl2page puts the tables back in front of each
+		 * strip or tile; the filter undoes any subsampling.
 		 */
-		fputs(" /DCTDecode filter", fd);
-		use_rawdata = TRUE;
-#else
+		if (PS_JPEGPassthrough(tif)) {
+			if (samplesperpixel == 3) {
+				uint16 tiffphotometric;
+
+				TIFFGetField(tif, TIFFTAG_PHOTOMETRIC,
+					     &tiffphotometric);
+				fprintf(fd, "\n\t<< /ColorTransform %d >>",
+				    tiffphotometric == PHOTOMETRIC_YCBCR);
+			}
+			fputs(" /DCTDecode filter", fd);
+		} else {
+			use_rawdata = FALSE;
+		}
+		break;
+	case COMPRESSION_OJPEG:		/* 6: !6.0 JPEG */
 		use_rawdata = FALSE;
-#endif
 		break;
 	case COMPRESSION_NEXT:		/* 32766: NeXT 2-bit RLE */
 	case COMPRESSION_THUNDERSCAN:	/* 32809: ThunderScan RLE */
@@ -2150,8 +2195,12 @@ PS_Lvl2page(FILE* fd, TIFF* tif, uint32 w, uint32 h)
 	int use_rawdata, tiled_image, breaklen = MAXLINE;
 	uint32 chunk_no, num_chunks;
         uint64 *bc;
-	unsigned char *buf_data, *cp;
+	unsigned char *buf_data;
 	tsize_t chunk_size, byte_count;
+	unsigned char *jpegtables = NULL;
+	uint32 jpegtables_size = 0;
+	tsize_t hex_l;			/* Length, in bytes, of hex_p[] data */
+	uint8 *hex_p = NULL;		/* Holds hex encoded data */
 
 #if defined( EXP_ASCII85ENCODER )
 	tsize_t			ascii85_l;	/* Length, in bytes, of ascii85_p[] data */
@@ -2181,6 +2230,18 @@ PS_Lvl2page(FILE* fd, TIFF* tif, uint32 w, uint32 h)
 		for (chunk_no = 1; chunk_no < num_chunks; chunk_no++)
 			if ((tsize_t) bc[chunk_no] > chunk_size)
 				chunk_size = (tsize_t) bc[chunk_no];
+		/*
+		 * The strips or tiles of a JPEG image are abbreviated
+		 * streams; DCTDecode needs the tables, less their EOI
+		 * marker, in front of each of them.
+		 */
+		if (compression == COMPRESSION_JPEG &&
+		    TIFFGetField(tif, TIFFTAG_JPEGTABLES, &jpegtables_size,
+				 &jpegtables) && jpegtables_size > 0) {
+			jpegtables_size -= 2;
+			chunk_size += jpegtables_size;
+		} else
+			jpegtables_size = 0;
 	} else {
 		if (tiled_image)
 			chunk_size = TIFFTileSize(tif);
@@ -2215,6 +2276,20 @@ PS_Lvl2page(FILE* fd, TIFF* tif, uint32 w, uint32 h)
 	    }
 	}
 #endif
+	if ( !ascii85 ) {
+	    /*
+	     * Two characters for each byte, a newline for every MAXLINE
+	     * bytes and the end of data marker.
+	     */
+	    hex_p = _TIFFmalloc( 2*chunk_size + chunk_size/MAXLINE + 2 );
+
+	    if ( !hex_p ) {
+		_TIFFfree( buf_data );
+
+		TIFFError( filename, "Cannot allocate hex encoding buffer." );
+		return ( FALSE );
+	    }
+	}
 
 	TIFFGetFieldDefaulted(tif, TIFFTAG_FILLORDER, &fillorder);
 	for (chunk_no = 0; chunk_no < num_chunks; chunk_no++) {
@@ -2223,13 +2298,27 @@ PS_Lvl2page(FILE* fd, TIFF* tif, uint32 w, uint32 h)
 		else
 			breaklen = MAXLINE;
 		if (use_rawdata) {
+			unsigned char *chunk_data = buf_data + jpegtables_size;
+			tsize_t chunk_max = chunk_size - jpegtables_size;
+
 			if (tiled_image)
 				byte_count = TIFFReadRawTile(tif, chunk_no,
-						  buf_data, chunk_size);
+						  chunk_data, chunk_max);
 			else
 				byte_count = TIFFReadRawStrip(tif, chunk_no,
-						  buf_data, chunk_size);
-			if (fillorder == FILLORDER_LSB2MSB)
+						  chunk_data, chunk_max);
+			if (jpegtables_size > 0 && byte_count >= 0) {
+				_TIFFmemcpy(buf_data, jpegtables,
+					    jpegtables_size);
+				if (byte_count >= 2 && chunk_data[0] == 0xff &&
+				    chunk_data[1] == 0xd8) {
+					/* Drop the SOI marker of the strip */
+					memmove(chunk_data, chunk_data + 2,
+						byte_count - 2);
+					byte_count -= 2;
+				}
+				byte_count += jpegtables_size;
+			} else if (fillorder == FILLORDER_LSB2MSB)
 			    TIFFReverseBits(buf_data, byte_count);
 		} else {
 			if (tiled_image)
@@ -2291,39 +2380,30 @@ PS_Lvl2page(FILE* fd, TIFF* tif, uint32 w, uint32 h)
 			if ( ascii85_l > 0 )
 				fwrite( ascii85_p, ascii85_l, 1, fd );
 #else
+			unsigned char *cp;
+
 			for (cp = buf_data; byte_count > 0; byte_count--)
 				Ascii85Put(*cp++, fd);
+			Ascii85Flush(fd);
 #endif
 		}
 		else
 		{
-			for (cp = buf_data; byte_count > 0; byte_count--) {
-				putc(hex[((*cp)>>4)&0xf], fd);
-				putc(hex[(*cp)&0xf], fd);
-				cp++;
-
-				if (--breaklen <= 0) {
-					putc('\n', fd);
-					breaklen = MAXLINE;
-				}
-			}
-		}
-
-		if ( !ascii85 ) {
+			hex_l = HexEncodeBlock(hex_p, buf_data, byte_count,
+					       &breaklen);
 			if ( level2 || level3 )
-				putc( '>', fd );
-			putc('\n', fd);
+				hex_p[hex_l++] = '>';
+			hex_p[hex_l++] = '\n';
+			fwrite(hex_p, hex_l, 1, fd);
 		}
-#if !defined( EXP_ASCII85ENCODER )
-		else
-			Ascii85Flush(fd);
-#endif
 	}
 
 #if defined( EXP_ASCII85ENCODER )
 	if ( ascii85_p )
 	    _TIFFfree( ascii85_p );
 #endif
+	if ( hex_p )
+	    _TIFFfree( hex_p );
        
 	_TIFFfree(buf_data);
 #ifdef ENABLE_BROKEN_BEGINENDDATA
@@ -2979,20 +3059,22 @@ tsize_t Ascii85EncodeBlock( uint8 * ascii85_p, unsigned f_eod, const uint8 * raw
     
             else
             {
-                ascii85[4] = (char) ((val32 % 85) + 33);
-                val32 /= 85;
-    
-                ascii85[3] = (char) ((val32 % 85) + 33);
-                val32 /= 85;
-    
-                ascii85[2] = (char) ((val32 % 85) + 33);
-                val32 /= 85;
-    
-                ascii85[1] = (char) ((val32 % 85) + 33);
-                ascii85[0] = (char) ((val32 / 85) + 33);
-
-                _TIFFmemcpy( &ascii85_p[ascii85_l], ascii85, sizeof(ascii85) );
-                rc = sizeof(ascii85);
+                /*
+                 * Split the tuple in two so that the low and high
+                 * digits are not one long chain of divisions, and
+                 * store them in place.
+                 */
+                uint32  lo = val32 % (85*85);
+                uint32  hi = val32 / (85*85);   /* < 85*85*85 */
+                uint8 * out = &ascii85_p[ascii85_l];
+
+                out[4] = (uint8) ((lo % 85) + 33);
+                out[3] = (uint8) ((lo / 85) + 33);
+                out[2] = (uint8) ((hi % 85) + 33);
+                hi /= 85;
+                out[1] = (uint8) ((hi % 85) + 33);
+                out[0] = (uint8) ((hi / 85) + 33);
+                rc = 5;
             }
     
             ascii85_l += rc;
@@ -3052,6 +3134,36 @@ tsize_t Ascii85EncodeBlock( uint8 * ascii85_p, unsigned f_eod, const uint8 * raw
 
 #endif	/* EXP_ASCII85ENCODER */
 
+/*
+ * Encode raw_l bytes of raw_p in hex into hex_p, with a newline after every
+ * MAXLINE bytes as counted by *breaklen across calls, and return the number
+ * of characters stored.  hex_p must hold 2*raw_l + raw_l/MAXLINE + 1 bytes.
+ */
+tsize_t
+HexEncodeBlock(uint8 *hex_p, const uint8 *raw_p, tsize_t raw_l, int *breaklen)
+{
+	uint8 *out = hex_p;
+	int left = *breaklen;
+
+	while (raw_l > 0) {
+		tsize_t n = raw_l < left ? raw_l : left;
+
+		raw_l -= n;
+		left -= (int) n;
+		for (; n > 0; n--) {
+			*out++ = hex[(*raw_p >> 4) & 0xf];
+			*out++ = hex[*raw_p & 0xf];
+			raw_p++;
+		}
+		if (left <= 0) {
+			*out++ = '\n';
+			left = MAXLINE;
+		}
+	}
+	*breaklen = left;
+	return (out - hex_p);
+}
+
 
 char* stuff[] = {
 "usage: tiff2ps [options] input.tif ...",
@@ -48,11 +48,14 @@
 #endif
 #define	roundup(x, y)	(howmany(x,y)*((uint32)(y)))
 
+#define	BAND_SIZE	(4*1024*1024)	/* bytes of RGBA raster in memory */
+
 uint16 compression = COMPRESSION_PACKBITS;
 uint32 rowsperstrip = (uint32) -1;
-int process_by_block = 0; /* default is whole image at once */
+int process_by_block = 0; /* default is strips of rowsperstrip */
 int no_alpha = 0;
 int bigtiff_output = 0;
+int nthreads = 0; /* default is one per processor */
 
 
 static int tiffcvt(TIFF* in, TIFF* out);
@@ -68,7 +71,7 @@ main(int argc, char* argv[])
 	extern char *optarg;
 #endif
 
-	while ((c = getopt(argc, argv, "c:r:t:bn8")) != -1)
+	while ((c = getopt(argc, argv, "c:j:r:t:bn8")) != -1)
 		switch (c) {
 			case 'b':
 				process_by_block = 1;
@@ -89,6 +92,10 @@ main(int argc, char* argv[])
 					usage(-1);
 				break;
 
+			case 'j':
+				nthreads = atoi(optarg);
+				break;
+
 			case 'r':
 				rowsperstrip = atoi(optarg);
 				break;
@@ -135,347 +142,261 @@ main(int argc, char* argv[])
 	return (0);
 }
 
+/*
+ * Is the first row of the file the bottom row of the image?
+ */
 static int
-cvt_by_tile( TIFF *in, TIFF *out )
+bottom_origin( TIFFRGBAImage *img )
 
 {
-    uint32* raster;			/* retrieve RGBA image */
-    uint32  width, height;		/* image width & height */
-    uint32  tile_width, tile_height;
-    uint32  row, col;
-    uint32  *wrk_line;
-    int	    ok = 1;
-    uint32  rastersize, wrk_linesize;
-
-    TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &width);
-    TIFFGetField(in, TIFFTAG_IMAGELENGTH, &height);
-
-    if( !TIFFGetField(in, TIFFTAG_TILEWIDTH, &tile_width)
-        || !TIFFGetField(in, TIFFTAG_TILELENGTH, &tile_height) ) {
-        TIFFError(TIFFFileName(in), "Source image not tiled");
-        return (0);
-    }
-    
-    TIFFSetField(out, TIFFTAG_TILEWIDTH, tile_width );
-    TIFFSetField(out, TIFFTAG_TILELENGTH, tile_height );
-
-    /*
-     * Allocate tile buffer
-     */
-    rastersize = tile_width * tile_height * sizeof (uint32);
-    if (tile_width != (rastersize / tile_height) / sizeof( uint32))
-    {
-	TIFFError(TIFFFileName(in), "Integer overflow when calculating raster buffer");
-	exit(-1);
-    }
-    raster = (uint32*)_TIFFmalloc(rastersize);
-    if (raster == 0) {
-        TIFFError(TIFFFileName(in), "No space for raster buffer");
-        return (0);
-    }
-
-    /*
-     * Allocate a scanline buffer for swapping during the vertical
-     * mirroring pass.
-     */
-    wrk_linesize = tile_width * sizeof (uint32);
-    if (tile_width != wrk_linesize / sizeof (uint32))
+    switch( img->orientation )
     {
-        TIFFError(TIFFFileName(in), "Integer overflow when calculating wrk_line buffer");
-	exit(-1);
-    }
-    wrk_line = (uint32*)_TIFFmalloc(wrk_linesize);
-    if (!wrk_line) {
-        TIFFError(TIFFFileName(in), "No space for raster scanline buffer");
-        ok = 0;
+      case ORIENTATION_BOTLEFT:
+      case ORIENTATION_BOTRIGHT:
+      case ORIENTATION_LEFTBOT:
+      case ORIENTATION_RIGHTBOT:
+        return 1;
+      default:
+        return 0;
     }
-    
-    /*
-     * Loop over the tiles.
-     */
-    for( row = 0; ok && row < height; row += tile_height )
-    {
-        for( col = 0; ok && col < width; col += tile_width )
-        {
-            uint32 i_row;
-
-            /* Read the tile into an RGBA array */
-            if (!TIFFReadRGBATile(in, col, row, raster)) {
-                ok = 0;
-                break;
-            }
-
-
-	    /*
-	     * XXX: raster array has 4-byte unsigned integer type, that is why
-	     * we should rearrange it here.
-	     */
-#if HOST_BIGENDIAN
-	    TIFFSwabArrayOfLong(raster, tile_width * tile_height);
-#endif
-
-            /*
-             * For some reason the TIFFReadRGBATile() function chooses the
-             * lower left corner as the origin.  Vertically mirror scanlines.
-             */
-            for( i_row = 0; i_row < tile_height / 2; i_row++ )
-            {
-                uint32	*top_line, *bottom_line;
-
-                top_line = raster + tile_width * i_row;
-                bottom_line = raster + tile_width * (tile_height-i_row-1);
+}
 
-                _TIFFmemcpy(wrk_line, top_line, 4*tile_width);
-                _TIFFmemcpy(top_line, bottom_line, 4*tile_width);
-                _TIFFmemcpy(bottom_line, wrk_line, 4*tile_width);
-            }
+/*
+ * Drop the alpha component of count pixels, in place.
+ */
+static void
+strip_alpha( uint32 *raster, tmsize_t count )
 
-            /*
-             * Write out the result in a tile.
-             */
+{
+    unsigned char *src, *dst;
 
-            if( TIFFWriteEncodedTile( out,
-                                      TIFFComputeTile( out, col, row, 0, 0),
-                                      raster,
-                                      4 * tile_width * tile_height ) == -1 )
-            {
-                ok = 0;
-                break;
-            }
-        }
+    src = dst = (unsigned char *) raster;
+    while (count > 0)
+    {
+        *(dst++) = *(src++);
+        *(dst++) = *(src++);
+        *(dst++) = *(src++);
+        src++;
+        count--;
     }
-
-    _TIFFfree( raster );
-    _TIFFfree( wrk_line );
-
-    return ok;
 }
 
+/*
+ * Write the tiles of a band of rows, padding the tiles that cross the
+ * right or bottom edge of the image with zeros.
+ */
 static int
-cvt_by_strip( TIFF *in, TIFF *out )
+write_band_tiles( TIFF *out, uint32 *raster, uint32 width, uint32 row,
+                  uint32 rows, uint32 tile_width, uint32 tile_height,
+                  uint32 *tile )
 
 {
-    uint32* raster;			/* retrieve RGBA image */
-    uint32  width, height;		/* image width & height */
-    uint32  row;
-    uint32  *wrk_line;
-    int	    ok = 1;
-    uint32  rastersize, wrk_linesize;
-
-    TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &width);
-    TIFFGetField(in, TIFFTAG_IMAGELENGTH, &height);
-
-    if( !TIFFGetField(in, TIFFTAG_ROWSPERSTRIP, &rowsperstrip) ) {
-        TIFFError(TIFFFileName(in), "Source image not in strips");
-        return (0);
-    }
-    
-    TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
+    int     bytes_per_pixel = no_alpha ? 3 : 4;
+    uint32  r, col, i_row;
 
-    /*
-     * Allocate strip buffer
-     */
-    rastersize = width * rowsperstrip * sizeof (uint32);
-    if (width != (rastersize / rowsperstrip) / sizeof( uint32))
+    for( r = 0; r < rows; r += tile_height )
     {
-	TIFFError(TIFFFileName(in), "Integer overflow when calculating raster buffer");
-	exit(-1);
-    }
-    raster = (uint32*)_TIFFmalloc(rastersize);
-    if (raster == 0) {
-        TIFFError(TIFFFileName(in), "No space for raster buffer");
-        return (0);
-    }
-
-    /*
-     * Allocate a scanline buffer for swapping during the vertical
-     * mirroring pass.
-     */
-    wrk_linesize = width * sizeof (uint32);
-    if (width != wrk_linesize / sizeof (uint32))
-    {
-        TIFFError(TIFFFileName(in), "Integer overflow when calculating wrk_line buffer");
-	exit(-1);
-    }
-    wrk_line = (uint32*)_TIFFmalloc(wrk_linesize);
-    if (!wrk_line) {
-        TIFFError(TIFFFileName(in), "No space for raster scanline buffer");
-        ok = 0;
-    }
-    
-    /*
-     * Loop over the strips.
-     */
-    for( row = 0; ok && row < height; row += rowsperstrip )
-    {
-        int	rows_to_write, i_row;
-
-        /* Read the strip into an RGBA array */
-        if (!TIFFReadRGBAStrip(in, row, raster)) {
-            ok = 0;
-            break;
-        }
-
-	/*
-	 * XXX: raster array has 4-byte unsigned integer type, that is why
-	 * we should rearrange it here.
-	 */
-#if HOST_BIGENDIAN
-	TIFFSwabArrayOfLong(raster, width * rowsperstrip);
-#endif
-
-        /*
-         * Figure out the number of scanlines actually in this strip.
-         */
-        if( row + rowsperstrip > height )
-            rows_to_write = height - row;
-        else
-            rows_to_write = rowsperstrip;
-
-        /*
-         * For some reason the TIFFReadRGBAStrip() function chooses the
-         * lower left corner as the origin.  Vertically mirror scanlines.
-         */
-
-        for( i_row = 0; i_row < rows_to_write / 2; i_row++ )
-        {
-            uint32	*top_line, *bottom_line;
-
-            top_line = raster + width * i_row;
-            bottom_line = raster + width * (rows_to_write-i_row-1);
-
-            _TIFFmemcpy(wrk_line, top_line, 4*width);
-            _TIFFmemcpy(top_line, bottom_line, 4*width);
-            _TIFFmemcpy(bottom_line, wrk_line, 4*width);
-        }
-
-        /*
-         * Write out the result in a strip
-         */
+        uint32 read_ysize = rows - r < tile_height ? rows - r : tile_height;
 
-        if( TIFFWriteEncodedStrip( out, row / rowsperstrip, raster,
-                                   4 * rows_to_write * width ) == -1 )
+        for( col = 0; col < width; col += tile_width )
         {
-            ok = 0;
-            break;
+            uint32 read_xsize = width - col < tile_width ?
+                width - col : tile_width;
+
+            _TIFFmemset( tile, 0, 4 * tile_width * tile_height );
+            for( i_row = 0; i_row < read_ysize; i_row++ )
+                _TIFFmemcpy( tile + tile_width * i_row,
+                             raster + (r + i_row) * width + col,
+                             4 * read_xsize );
+            if( no_alpha )
+                strip_alpha( tile, tile_width * tile_height );
+            if( TIFFWriteEncodedTile( out,
+                                      TIFFComputeTile( out, col, row + r, 0, 0),
+                                      tile,
+                                      bytes_per_pixel * tile_width * tile_height ) == -1 )
+                return 0;
         }
     }
-
-    _TIFFfree( raster );
-    _TIFFfree( wrk_line );
-
-    return ok;
+    return 1;
 }
 
 /*
- * cvt_whole_image()
+ * cvt_image()
+ *
+ * Convert the image a band of rows at a time with one TIFFRGBAImage,
+ * so the state of the conversion is set up once per image and only a
+ * band of BAND_SIZE bytes of RGBA raster is in memory.  Each band is a
+ * whole number of output strips or rows of tiles, and is decoded and
+ * converted on nthreads threads by TIFFRGBAImageGetParallel().
  *
- * read the whole image into one big RGBA buffer and then write out
- * strips from that.  This is using the traditional TIFFReadRGBAImage()
- * API that we trust.
+ * By default the output is stripped with rowsperstrip rows per strip;
+ * with -b the output has the strip or tile layout of the input.
  */
 
 static int
-cvt_whole_image( TIFF *in, TIFF *out )
+cvt_image( TIFF *in, TIFF *out )
 
 {
-    uint32* raster;			/* retrieve RGBA image */
+    TIFFRGBAImage img;
+    char    emsg[1024] = "";
+    uint32* raster;			/* band of RGBA image */
+    uint32* tile = NULL;		/* output tile with -b */
     uint32  width, height;		/* image width & height */
-    uint32  row;
-    size_t pixel_count;
-        
+    uint32  chunk_width, chunk_height;	/* output strip or tile */
+    uint32  band, row;
+    uint16  subsamplinghor, subsamplingver;
+    int     tiled = 0, flip, ok = 1;
+
     TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &width);
     TIFFGetField(in, TIFFTAG_IMAGELENGTH, &height);
-    pixel_count = width * height;
-
-    /* XXX: Check the integer overflow. */
-    if (!width || !height || pixel_count / width != height) {
+    if (!width || !height) {
         TIFFError(TIFFFileName(in),
 		  "Malformed input file; can't allocate buffer for raster of %lux%lu size",
 		  (unsigned long)width, (unsigned long)height);
         return 0;
     }
 
-    rowsperstrip = TIFFDefaultStripSize(out, rowsperstrip);
-    TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
-
-    raster = (uint32*)_TIFFCheckMalloc(in, pixel_count, sizeof(uint32), "raster buffer");
-    if (raster == 0) {
-        TIFFError(TIFFFileName(in), "Failed to allocate buffer (%lu elements of %lu each)",
-		  (unsigned long)pixel_count, (unsigned long)sizeof(uint32));
+    if( process_by_block && TIFFIsTiled( in ) )
+    {
+        if( !TIFFGetField(in, TIFFTAG_TILEWIDTH, &chunk_width)
+            || !TIFFGetField(in, TIFFTAG_TILELENGTH, &chunk_height) ) {
+            TIFFError(TIFFFileName(in), "Source image not tiled");
+            return (0);
+        }
+        TIFFSetField(out, TIFFTAG_TILEWIDTH, chunk_width );
+        TIFFSetField(out, TIFFTAG_TILELENGTH, chunk_height );
+        tiled = 1;
+    }
+    else
+    {
+        if( process_by_block )
+        {
+            if( !TIFFGetField(in, TIFFTAG_ROWSPERSTRIP, &chunk_height) ) {
+                TIFFError(TIFFFileName(in), "Source image not in strips");
+                return (0);
+            }
+        }
+        else
+            chunk_height = TIFFDefaultStripSize(out, rowsperstrip);
+        TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, chunk_height);
+        if( chunk_height > height )
+            chunk_height = height;
+        chunk_width = width;
+    }
+    if( chunk_width == 0 || chunk_height == 0 ) {
+        TIFFError(TIFFFileName(in), "Invalid strip or tile size");
         return (0);
     }
 
-    /* Read the image in one chunk into an RGBA array */
-    if (!TIFFReadRGBAImageOriented(in, width, height, raster,
-                                   ORIENTATION_TOPLEFT, 0)) {
-        _TIFFfree(raster);
+    if (!TIFFRGBAImageOK(in, emsg) || !TIFFRGBAImageBegin(&img, in, 0, emsg)) {
+        TIFFError(TIFFFileName(in), "%s", emsg);
         return (0);
     }
+    img.req_orientation = ORIENTATION_TOPLEFT;
+    flip = bottom_origin( &img );
 
     /*
-     * XXX: raster array has 4-byte unsigned integer type, that is why
-     * we should rearrange it here.
+     * A few output chunks per band, but at least a chunk.
      */
-#if HOST_BIGENDIAN
-    TIFFSwabArrayOfLong(raster, width * height);
-#endif
+    band = chunk_height;
+    if( (uint64) band * width * 4 < BAND_SIZE )
+        band *= (uint32) (BAND_SIZE / ((uint64) band * width * 4));
+    if( band > height )
+        band = roundup(height, chunk_height);
 
     /*
-     * Do we want to strip away alpha components?
+     * Bands of subsampled YCbCr data must start on a row of blocks,
+     * otherwise convert the image whole.
      */
-    if (no_alpha)
+    TIFFGetFieldDefaulted(in, TIFFTAG_YCBCRSUBSAMPLING,
+                          &subsamplinghor, &subsamplingver);
+    if( img.photometric == PHOTOMETRIC_YCBCR && subsamplingver > 1
+        && (band % subsamplingver != 0
+            || (flip && height % subsamplingver != 0)) )
+        band = roundup(height, chunk_height);
+
+    raster = (uint32*)_TIFFCheckMalloc(in, (tmsize_t) band * width,
+                                       sizeof(uint32), "raster buffer");
+    if (raster == 0) {
+        TIFFError(TIFFFileName(in), "No space for raster buffer");
+        TIFFRGBAImageEnd(&img);
+        return (0);
+    }
+    if( tiled )
     {
-        size_t count = pixel_count;
-        unsigned char *src, *dst;
-
-	src = dst = (unsigned char *) raster;
-        while (count > 0)
-        {
-	    *(dst++) = *(src++);
-	    *(dst++) = *(src++);
-	    *(dst++) = *(src++);
-	    src++;
-	    count--;
+        tile = (uint32*)_TIFFCheckMalloc(in, (tmsize_t) chunk_width * chunk_height,
+                                         sizeof(uint32), "tile buffer");
+        if (tile == 0) {
+            TIFFError(TIFFFileName(in), "No space for tile buffer");
+            ok = 0;
         }
     }
 
-    /*
-     * Write out the result in strips
-     */
-    for (row = 0; row < height; row += rowsperstrip)
+    for( row = 0; ok && row < height; row += band )
     {
-        unsigned char * raster_strip;
-        int	rows_to_write;
-        int	bytes_per_pixel;
+        uint32 rows = height - row < band ? height - row : band;
+        uint32 r;
 
-        if (no_alpha)
-        {
-            raster_strip = ((unsigned char *) raster) + 3 * row * width;
-            bytes_per_pixel = 3;
+        /* Read the band into an RGBA array, top row first */
+        img.row_offset = flip ? height - row - rows : row;
+        if (!TIFFRGBAImageGetParallel(&img, raster, width, rows, nthreads)) {
+            ok = 0;
+            break;
         }
-        else
+
+	/*
+	 * XXX: raster array has 4-byte unsigned integer type, that is why
+	 * we should rearrange it here.
+	 */
+#if HOST_BIGENDIAN
+	TIFFSwabArrayOfLong(raster, width * rows);
+#endif
+
+        if( tiled )
         {
-            raster_strip = (unsigned char *) (raster + row * width);
-            bytes_per_pixel = 4;
+            ok = write_band_tiles( out, raster, width, row, rows,
+                                   chunk_width, chunk_height, tile );
+            continue;
         }
 
-        if( row + rowsperstrip > height )
-            rows_to_write = height - row;
-        else
-            rows_to_write = rowsperstrip;
+        /*
+         * Do we want to strip away alpha components?
+         */
+        if (no_alpha)
+            strip_alpha( raster, (tmsize_t) width * rows );
 
-        if( TIFFWriteEncodedStrip( out, row / rowsperstrip, raster_strip,
-                             bytes_per_pixel * rows_to_write * width ) == -1 )
+        /*
+         * Write out the result in strips
+         */
+        for( r = 0; r < rows; r += chunk_height )
         {
-            _TIFFfree( raster );
-            return 0;
+            unsigned char * raster_strip;
+            int	rows_to_write;
+            int	bytes_per_pixel = no_alpha ? 3 : 4;
+
+            raster_strip = ((unsigned char *) raster)
+                + (tmsize_t) bytes_per_pixel * r * width;
+            if( r + chunk_height > rows )
+                rows_to_write = rows - r;
+            else
+                rows_to_write = chunk_height;
+
+            if( TIFFWriteEncodedStrip( out, (row + r) / chunk_height,
+                                       raster_strip,
+                                       bytes_per_pixel * rows_to_write * width ) == -1 )
+            {
+                ok = 0;
+                break;
+            }
         }
     }
 
+    TIFFRGBAImageEnd(&img);
     _TIFFfree( raster );
+    if( tile )
+        _TIFFfree( tile );
 
-    return 1;
+    return ok;
 }
 
 
@@ -520,16 +441,11 @@ tiffcvt(TIFF* in, TIFF* out)
 	TIFFSetField(out, TIFFTAG_SOFTWARE, TIFFGetVersion());
 	CopyField(TIFFTAG_DOCUMENTNAME, stringv);
 
-        if( process_by_block && TIFFIsTiled( in ) )
-            return( cvt_by_tile( in, out ) );
-        else if( process_by_block )
-            return( cvt_by_strip( in, out ) );
-        else
-            return( cvt_whole_image( in, out ) );
+        return( cvt_image( in, out ) );
 }
 
 static char* stuff[] = {
-    "usage: tiff2rgba [-c comp] [-r rows] [-b] [-n] [-8] input... output",
+    "usage: tiff2rgba [-c comp] [-r rows] [-b] [-n] [-j threads] [-8] input... output",
     "where comp is one of the following compression algorithms:",
     " jpeg\t\tJPEG encoding",
     " zip\t\tZip/Deflate encoding",
@@ -538,7 +454,8 @@ static char* stuff[] = {
     " none\t\tno compression",
     "and the other options are:",
     " -r\trows/strip",
-    " -b (progress by block rather than as a whole image)",
+    " -b (keep the strip or tile layout of the input)",
+    " -j convert on # threads (default one per processor)",
     " -n don't emit alpha component.",
     " -8 write BigTIFF file instead of ClassicTIFF",
     NULL
@@ -44,6 +44,9 @@ extern int getopt(int, char**, char*);
 #endif
 
 static	int stopondiff = 1;
+static	int fastcompare = 0;
+static	int printdigest = 0;
+static	int nthreads = 0;
 static	int stoponfirsttag = 1;
 static	uint16 bitspersample = 1;
 static	uint16 samplesperpixel = 1;
@@ -54,6 +57,9 @@ static	uint32 imagelength;
 static	void usage(void);
 static	int tiffcmp(TIFF*, TIFF*);
 static	int cmptags(TIFF*, TIFF*);
+static	int cmpdata(TIFF*, TIFF*);
+static	int cmpraw(TIFF*, TIFF*);
+static	int printdigests(TIFF*);
 static	int ContigCompare(int, uint32, unsigned char*, unsigned char*, tsize_t);
 static	int SeparateCompare(int, int, uint32, unsigned char*, unsigned char*);
 static	void PrintIntDiff(uint32, int, uint32, uint32, uint32);
@@ -71,8 +77,19 @@ main(int argc, char* argv[])
 	extern char* optarg;
 #endif
 
-	while ((c = getopt(argc, argv, "ltz:")) != -1)
+	while ((c = getopt(argc, argv, "fhj:ltz:")) != -1)
 		switch (c) {
+		case 'f':
+			fastcompare = 1;
+			break;
+		case 'h':
+			printdigest = 1;
+			break;
+		case 'j':
+			nthreads = atoi(optarg);
+			if (nthreads < 0)
+				usage();
+			break;
 		case 'l':
 			stopondiff = 0;
 			break;
@@ -86,6 +103,14 @@ main(int argc, char* argv[])
 			usage();
 			/*NOTREACHED*/
 		}
+	if (printdigest && argc - optind == 1) {
+		tif1 = TIFFOpen(argv[optind], "r");
+		if (tif1 == NULL)
+			return (-1);
+		c = printdigests(tif1);
+		TIFFClose(tif1);
+		return (c);
+	}
 	if (argc - optind < 2)
 		usage();
 	tif1 = TIFFOpen(argv[optind], "r");
@@ -121,6 +146,11 @@ char* stuff[] = {
 " -l		list each byte of image data that differs between the files",
 " -z #		list specified number of bytes that differs between the files",
 " -t		ignore any differences in directory tags",
+" -f		compare raw data, then digests of the decoded data, and stop",
+"		at the first difference",
+" -h		print the digest of the decoded data of each directory",
+"		(of a single file if only one is given); implies -f",
+" -j #		decode on # threads for -f and -h (0 = one per processor)",
 NULL
 };
 
@@ -173,6 +203,17 @@ tiffcmp(TIFF* tif1, TIFF* tif2)
 	(void) TIFFGetField(tif1, TIFFTAG_IMAGELENGTH, &imagelength);
 	(void) TIFFGetField(tif1, TIFFTAG_PLANARCONFIG, &config1);
 	(void) TIFFGetField(tif2, TIFFTAG_PLANARCONFIG, &config2);
+	if (fastcompare || printdigest) {
+		switch (cmpdata(tif1, tif2)) {
+		case 1:
+			return (1);
+		case 0:
+			if (stopondiff)
+				exit(1);
+			return (0);
+		}
+		/* Fall back to comparing scanlines */
+	}
 	buf1 = (unsigned char *)_TIFFmalloc(size1 = TIFFScanlineSize(tif1));
 	buf2 = (unsigned char *)_TIFFmalloc(TIFFScanlineSize(tif2));
 	if (buf1 == NULL || buf2 == NULL) {
@@ -244,6 +285,169 @@ bad1:
 	return (0);
 }
 
+/*
+ * Print the digest of the decoded data of each directory of tif.
+ */
+static int
+printdigests(TIFF* tif)
+{
+	uint64 digest;
+	int dirnum = 0;
+
+	do {
+		if (!TIFFDigestDirectory(tif, &digest, nthreads))
+			return (1);
+		printf("%s: directory %d: %08lx%08lx\n", TIFFFileName(tif),
+		    dirnum++, (unsigned long) (digest >> 32),
+		    (unsigned long) (digest & 0xffffffff));
+	} while (TIFFReadDirectory(tif));
+	return (0);
+}
+
+/*
+ * Compare the image data of the current directories without listing
+ * the differences: the raw data first, then digests of the decoded
+ * data.  Returns 1 if they are the same, 0 if they differ and -1 if
+ * the data must be compared scanline by scanline.
+ */
+static int
+cmpdata(TIFF* tif1, TIFF* tif2)
+{
+	uint16 config1 = PLANARCONFIG_CONTIG, config2 = PLANARCONFIG_CONTIG;
+	uint64 digest1, digest2;
+
+	if (!printdigest && cmpraw(tif1, tif2))
+		return (1);
+	(void) TIFFGetField(tif1, TIFFTAG_PLANARCONFIG, &config1);
+	(void) TIFFGetField(tif2, TIFFTAG_PLANARCONFIG, &config2);
+	if (config1 != config2 && samplesperpixel > 1)
+		return (-1);
+	if (!TIFFDigestDirectory(tif1, &digest1, nthreads) ||
+	    !TIFFDigestDirectory(tif2, &digest2, nthreads))
+		return (-1);
+	if (printdigest) {
+		printf("%s: directory %d: %08lx%08lx\n", TIFFFileName(tif1),
+		    (int) TIFFCurrentDirectory(tif1),
+		    (unsigned long) (digest1 >> 32),
+		    (unsigned long) (digest1 & 0xffffffff));
+		printf("%s: directory %d: %08lx%08lx\n", TIFFFileName(tif2),
+		    (int) TIFFCurrentDirectory(tif2),
+		    (unsigned long) (digest2 >> 32),
+		    (unsigned long) (digest2 & 0xffffffff));
+	}
+	if (digest1 != digest2) {
+		printf("Image data differs\n");
+		return (0);
+	}
+	return (1);
+}
+
+#define	SameField(tif1, tif2, tag, v1, v2) \
+	(TIFFGetField(tif1, tag, &v1) == TIFFGetField(tif2, tag, &v2) && v1 == v2)
+
+/*
+ * Return 1 if both directories have the same raw data, stored and
+ * coded the same way, so that they decode to the same image.
+ */
+static int
+cmpraw(TIFF* tif1, TIFF* tif2)
+{
+	uint16 s1 = 0, s2 = 0, h1 = 0, h2 = 0;
+	uint32 l1 = 0, l2 = 0, n, i;
+	unsigned char *buf1 = NULL, *buf2 = NULL;
+	tmsize_t bufsize = 0, got1, got2;
+	uint64 size;
+	int tiled = TIFFIsTiled(tif1), same = 0;
+
+	if (tiled != TIFFIsTiled(tif2) ||
+	    !SameField(tif1, tif2, TIFFTAG_COMPRESSION, s1, s2) ||
+	    !SameField(tif1, tif2, TIFFTAG_PHOTOMETRIC, s1, s2) ||
+	    !SameField(tif1, tif2, TIFFTAG_PLANARCONFIG, s1, s2) ||
+	    !SameField(tif1, tif2, TIFFTAG_FILLORDER, s1, s2) ||
+	    !SameField(tif1, tif2, TIFFTAG_SAMPLEFORMAT, s1, s2) ||
+	    !SameField(tif1, tif2, TIFFTAG_PREDICTOR, s1, s2) ||
+	    !SameField(tif1, tif2, TIFFTAG_IMAGELENGTH, l1, l2))
+		return (0);
+	if (tiled ? !SameField(tif1, tif2, TIFFTAG_TILEWIDTH, l1, l2) ||
+	    !SameField(tif1, tif2, TIFFTAG_TILELENGTH, l1, l2) :
+	    !SameField(tif1, tif2, TIFFTAG_ROWSPERSTRIP, l1, l2))
+		return (0);
+	if (TIFFGetField(tif1, TIFFTAG_YCBCRSUBSAMPLING, &s1, &h1) !=
+	    TIFFGetField(tif2, TIFFTAG_YCBCRSUBSAMPLING, &s2, &h2) ||
+	    s1 != s2 || h1 != h2)
+		return (0);
+	(void) TIFFGetField(tif1, TIFFTAG_COMPRESSION, &s1);
+	switch (s1) {
+	case COMPRESSION_CCITTFAX3:
+		if (!SameField(tif1, tif2, TIFFTAG_GROUP3OPTIONS, l1, l2))
+			return (0);
+		break;
+	case COMPRESSION_JPEG: {
+		uint32 count1 = 0, count2 = 0;
+		void *table1 = NULL, *table2 = NULL;
+
+		(void) TIFFGetField(tif1, TIFFTAG_JPEGTABLES, &count1, &table1);
+		(void) TIFFGetField(tif2, TIFFTAG_JPEGTABLES, &count2, &table2);
+		if (count1 != count2 ||
+		    (count1 > 0 && memcmp(table1, table2, count1) != 0))
+			return (0);
+		break;
+	}
+	case COMPRESSION_NONE:
+	case COMPRESSION_CCITTRLE:
+	case COMPRESSION_CCITTRLEW:
+	case COMPRESSION_CCITTFAX4:
+	case COMPRESSION_LZW:
+	case COMPRESSION_PACKBITS:
+	case COMPRESSION_ADOBE_DEFLATE:
+	case COMPRESSION_DEFLATE:
+	case COMPRESSION_LZMA:
+	case COMPRESSION_ZSTD:
+	case COMPRESSION_LZ4:
+		break;
+	default:
+		/* Other codecs may depend on tags not compared here */
+		return (0);
+	}
+
+	n = tiled ? TIFFNumberOfTiles(tif1) : TIFFNumberOfStrips(tif1);
+	if (n != (tiled ? TIFFNumberOfTiles(tif2) : TIFFNumberOfStrips(tif2)))
+		return (0);
+	for (i = 0; i < n; i++)
+		if (TIFFGetStrileByteCount(tif1, i) !=
+		    TIFFGetStrileByteCount(tif2, i))
+			return (0);
+	for (i = 0; i < n; i++) {
+		size = TIFFGetStrileByteCount(tif1, i);
+		if ((uint64) (tmsize_t) size != size)
+			goto done;
+		if ((tmsize_t) size > bufsize) {
+			unsigned char *p1, *p2;
+
+			p1 = (unsigned char *)_TIFFrealloc(buf1, (tmsize_t) size);
+			if (p1 != NULL)
+				buf1 = p1;
+			p2 = (unsigned char *)_TIFFrealloc(buf2, (tmsize_t) size);
+			if (p2 != NULL)
+				buf2 = p2;
+			if (p1 == NULL || p2 == NULL)
+				goto done;
+			bufsize = (tmsize_t) size;
+		}
+		got1 = tiled ? TIFFReadRawTile(tif1, i, buf1, (tmsize_t) size) :
+		    TIFFReadRawStrip(tif1, i, buf1, (tmsize_t) size);
+		got2 = tiled ? TIFFReadRawTile(tif2, i, buf2, (tmsize_t) size) :
+		    TIFFReadRawStrip(tif2, i, buf2, (tmsize_t) size);
+		if (got1 < 0 || got1 != got2 || memcmp(buf1, buf2, got1) != 0)
+			goto done;
+	}
+	same = 1;
+done:
+	if (buf1) _TIFFfree(buf1);
+	if (buf2) _TIFFfree(buf2);
+	return (same);
+}
+
 #define	CmpShortField(tag, name) \
 	if (!CheckShortTag(tif1, tif2, tag, name) && stoponfirsttag) return (0)
 #define	CmpShortField2(tag, name) \
@@ -77,14 +77,23 @@ static uint16 orientation;
 static uint32 rowsperstrip;
 static uint32 g3opts;
 static int ignore = FALSE;		/* if true, ignore read errors */
+static int nthreads = -1;		/* if >= 0, threads for coding chunks */
+static int noverviews = 0;		/* reduced resolution levels to add */
+static int overviewsubifds = FALSE;	/* if true, write them as SubIFDs */
 static uint32 defg3opts = (uint32) -1;
 static int quality = 75;		/* JPEG quality */
 static int jpegcolormode = JPEGCOLORMODE_RGB;
 static uint16 defcompression = (uint16) -1;
 static uint16 defpredictor = (uint16) -1;
 static int defpreset =  -1;
+static double lercmaxzerror = 0.0;	/* LERC max error, 0 is lossless */
+static int lercaddcompression = LERC_ADD_COMPRESSION_NONE;
+static int webplossless = FALSE;	/* if true, lossless WebP */
 
 static int tiffcp(TIFF*, TIFF*);
+static int openOverviews(TIFF*, uint32, uint32, uint16, uint16);
+static int writeOverviews(TIFF*);
+static void freeOverviews(void);
 static int processCompressOptions(char*);
 static void usage(void);
 
@@ -164,6 +173,7 @@ main(int argc, char* argv[])
 	TIFF* out;
 	char mode[10];
 	char* mp = mode;
+	char* cp;
 	int c;
 #if !HAVE_DECL_OPTARG
 	extern int optind;
@@ -172,7 +182,7 @@ main(int argc, char* argv[])
 
 	*mp++ = 'w';
 	*mp = '\0';
-	while ((c = getopt(argc, argv, ",:b:c:f:l:o:p:r:w:aistBLMC8x")) != -1)
+	while ((c = getopt(argc, argv, ",:b:c:f:j:l:o:p:r:w:O:aistBLMC8x")) != -1)
 		switch (c) {
 		case ',':
 			if (optarg[0] != '=') usage();
@@ -214,6 +224,22 @@ main(int argc, char* argv[])
 			else
 				usage();
 			break;
+		case 'j':   /* decode and encode chunks on threads */
+			nthreads = atoi(optarg);
+			if (nthreads < 0)
+				usage();
+			break;
+		case 'O':   /* reduced resolution levels */
+			noverviews = atoi(optarg);
+			if (noverviews <= 0)
+				usage();
+			if ((cp = strchr(optarg, ':')) != NULL) {
+				if (streq(cp + 1, "subifd"))
+					overviewsubifds = TRUE;
+				else
+					usage();
+			}
+			break;
 		case 'i':   /* ignore errors */
 			ignore = TRUE;
 			break;
@@ -298,7 +324,9 @@ main(int argc, char* argv[])
 			tilewidth = deftilewidth;
 			tilelength = deftilelength;
 			g3opts = defg3opts;
-			if (!tiffcp(in, out) || !TIFFWriteDirectory(out)) {
+			if (!tiffcp(in, out) || !TIFFWriteDirectory(out) ||
+			    !writeOverviews(out)) {
+				freeOverviews();
 				(void) TIFFClose(in);
 				(void) TIFFClose(out);
 				return (1);
@@ -331,6 +359,41 @@ processZIPOptions(char* cp)
 	}
 }
 
+static void
+processLERCOptions(char* cp)
+{
+	if ( (cp = strchr(cp, ':')) ) {
+		do {
+			cp++;
+			if (strneq(cp, "zip", 3) || strneq(cp, "deflate", 7))
+				lercaddcompression = LERC_ADD_COMPRESSION_DEFLATE;
+			else if (strneq(cp, "zstd", 4))
+				lercaddcompression = LERC_ADD_COMPRESSION_ZSTD;
+			else if (*cp == 'e')
+				lercmaxzerror = atof(++cp);
+			else if (*cp == 'p')
+				defpreset = atoi(++cp);
+			else
+				usage();
+		} while( (cp = strchr(cp, ':')) );
+	}
+}
+
+static void
+setLERCOptions(TIFF* out)
+{
+	TIFFSetField(out, TIFFTAG_LERC_MAXZERROR, lercmaxzerror);
+	if (lercaddcompression != LERC_ADD_COMPRESSION_NONE)
+		TIFFSetField(out, TIFFTAG_LERC_ADD_COMPRESSION,
+		    lercaddcompression);
+	if (preset != -1) {
+		if (lercaddcompression == LERC_ADD_COMPRESSION_DEFLATE)
+			TIFFSetField(out, TIFFTAG_ZIPQUALITY, preset);
+		else if (lercaddcompression == LERC_ADD_COMPRESSION_ZSTD)
+			TIFFSetField(out, TIFFTAG_ZSTD_LEVEL, preset);
+	}
+}
+
 static void
 processG3Options(char* cp)
 {
@@ -392,6 +455,27 @@ processCompressOptions(char* opt)
 	} else if (strneq(opt, "zstd", 4)) {
 		processZIPOptions(opt);
 		defcompression = COMPRESSION_ZSTD;
+	} else if (strneq(opt, "lz4", 3)) {
+		processZIPOptions(opt);
+		defcompression = COMPRESSION_LZ4;
+	} else if (strneq(opt, "lerc", 4)) {
+		processLERCOptions(opt);
+		defcompression = COMPRESSION_LERC;
+	} else if (strneq(opt, "webp", 4)) {
+		char* cp = strchr(opt, ':');
+
+		defcompression = COMPRESSION_WEBP;
+		while( cp )
+		{
+			if (isdigit((int)cp[1]))
+				quality = atoi(cp+1);
+			else if (strneq(cp+1, "lossless", 8))
+				webplossless = TRUE;
+			else
+				usage();
+
+			cp = strchr(cp+1,':');
+		}
 	} else if (strneq(opt, "jbig", 4)) {
 		defcompression = COMPRESSION_JBIG;
 	} else if (strneq(opt, "sgilog", 6)) {
@@ -417,6 +501,8 @@ char* stuff[] = {
 " -M              disable use of memory-mapped files",
 " -C              disable strip chopping",
 " -i              ignore read errors",
+" -j #            decode and encode on # threads (0 = one per processor)",
+" -O #[:subifd]   add # reduced resolution levels (as SubIFDs)",
 " -b file[,#]     bias (dark) monochrome image to be subtracted from all others",
 " -,=%            use % rather than , to separate image #'s (per Note below)",
 "",
@@ -431,6 +517,9 @@ char* stuff[] = {
 " -c zip[:opts]   compress output with deflate encoding",
 " -c lzma[:opts]  compress output with LZMA2 encoding",
 " -c zstd[:opts]  compress output with ZSTD encoding",
+" -c lz4[:opts]   compress output with LZ4 encoding",
+" -c lerc[:opts]  compress output with LERC encoding",
+" -c webp[:opts]  compress output with WEBP encoding",
 " -c jpeg[:opts]  compress output with JPEG encoding",
 " -c jbig         compress output with ISO JBIG encoding",
 " -c packbits     compress output with packbits encoding",
@@ -450,13 +539,25 @@ char* stuff[] = {
 " r               output color image as RGB rather than YCbCr",
 "For example, -c jpeg:r:50 to get JPEG-encoded RGB data with 50% comp. quality",
 "",
-"LZW, Deflate (ZIP), LZMA2 and ZSTD options:",
+"LZW, Deflate (ZIP), LZMA2, ZSTD and LZ4 options:",
 " #               set predictor value",
 " p#              set compression level (preset)",
 "For example, -c lzw:2 to get LZW-encoded data with horizontal differencing,",
 "-c zip:3:p9 for Deflate encoding with maximum compression level and floating",
 "point predictor.",
 "",
+"LERC options:",
+" e#              set maximum error (default 0, lossless)",
+" zip, zstd       compress the LERC data further with Deflate or ZSTD",
+" p#              set Deflate or ZSTD compression level",
+"For example, -c lerc:e0.01:zstd to get LERC-encoded data within 0.01 of the",
+"input, further compressed with ZSTD.",
+"",
+"WEBP options:",
+" #               set compression quality level (1-100, default 75)",
+" lossless        use lossless compression",
+"For example, -c webp:90 to get WEBP-encoded data with 90% quality",
+"",
 "Note that input filenames may be of the form filename,x,y,z",
 "where x, y, and z specify image numbers in the filename to copy.",
 "example:  tiffcp -c none -b esp.tif,1 esp.tif,0 test.tif",
@@ -587,6 +688,8 @@ static struct cpTag {
 typedef int (*copyFunc)
     (TIFF* in, TIFF* out, uint32 l, uint32 w, uint16 samplesperpixel);
 static	copyFunc pickCopyFunc(TIFF*, TIFF*, uint16, uint16);
+static	int canCopyRaw(TIFF*, TIFF*, uint16, uint16);
+static	int cpRawChunks(TIFF*, TIFF*, uint32, uint32, tsample_t);
 
 /* PODD */
 
@@ -736,6 +839,7 @@ tiffcp(TIFF* in, TIFF* out)
 		case COMPRESSION_DEFLATE:
                 case COMPRESSION_LZMA:
                 case COMPRESSION_ZSTD:
+                case COMPRESSION_LZ4:
 			if (predictor != (uint16)-1)
 				TIFFSetField(out, TIFFTAG_PREDICTOR, predictor);
 			else
@@ -748,8 +852,17 @@ tiffcp(TIFF* in, TIFF* out)
 					TIFFSetField(out, TIFFTAG_LZMAPRESET, preset);
 				else if (compression == COMPRESSION_ZSTD)
 					TIFFSetField(out, TIFFTAG_ZSTD_LEVEL, preset);
+				else if (compression == COMPRESSION_LZ4)
+					TIFFSetField(out, TIFFTAG_LZ4_LEVEL, preset);
                         }
 			break;
+		case COMPRESSION_LERC:
+			setLERCOptions(out);
+			break;
+		case COMPRESSION_WEBP:
+			TIFFSetField(out, TIFFTAG_WEBP_LEVEL, quality);
+			TIFFSetField(out, TIFFTAG_WEBP_LOSSLESS, webplossless);
+			break;
 		case COMPRESSION_CCITTFAX3:
 		case COMPRESSION_CCITTFAX4:
 			if (compression == COMPRESSION_CCITTFAX3) {
@@ -815,7 +928,22 @@ tiffcp(TIFF* in, TIFF* out)
 	for (p = tags; p < &tags[NTAGS]; p++)
 		CopyTag(p->tag, p->count, p->type);
 
-	cf = pickCopyFunc(in, out, bitspersample, samplesperpixel);
+	if (noverviews > 0 &&
+	    !openOverviews(out, width, length, bitspersample, samplesperpixel))
+		return FALSE;
+	if (canCopyRaw(in, out, input_compression, bitspersample)) {
+		/* the data is not decoded: keep its colour space and tables */
+		TIFFSetField(out, TIFFTAG_PHOTOMETRIC, input_photometric);
+		if (input_compression == COMPRESSION_JPEG) {
+			uint32 count;
+			void* table;
+			if (TIFFGetField(in, TIFFTAG_JPEGTABLES, &count, &table)
+			    && count > 0)
+				TIFFSetField(out, TIFFTAG_JPEGTABLES, count, table);
+		}
+		cf = cpRawChunks;
+	} else
+		cf = pickCopyFunc(in, out, bitspersample, samplesperpixel);
 	return (cf ? (*cf)(in, out, length, width, samplesperpixel) : FALSE);
 }
 
@@ -826,15 +954,19 @@ tiffcp(TIFF* in, TIFF* out)
 static int x(TIFF* in, TIFF* out, \
     uint32 imagelength, uint32 imagewidth, tsample_t spp)
 
+/*
+ * Read and write functions move the band of imagelength rows starting
+ * at row startrow of the image between the file and buf.
+ */
 #define	DECLAREreadFunc(x) \
-static int x(TIFF* in, \
-    uint8* buf, uint32 imagelength, uint32 imagewidth, tsample_t spp)
-typedef int (*readFunc)(TIFF*, uint8*, uint32, uint32, tsample_t);
+static int x(TIFF* in, uint8* buf, uint32 startrow, \
+    uint32 imagelength, uint32 imagewidth, tsample_t spp)
+typedef int (*readFunc)(TIFF*, uint8*, uint32, uint32, uint32, tsample_t);
 
 #define	DECLAREwriteFunc(x) \
-static int x(TIFF* out, \
-    uint8* buf, uint32 imagelength, uint32 imagewidth, tsample_t spp)
-typedef int (*writeFunc)(TIFF*, uint8*, uint32, uint32, tsample_t);
+static int x(TIFF* out, uint8* buf, uint32 startrow, \
+    uint32 imagelength, uint32 imagewidth, tsample_t spp)
+typedef int (*writeFunc)(TIFF*, uint8*, uint32, uint32, uint32, tsample_t);
 
 /*
  * Contig -> contig by scanline for rows/strip change.
@@ -1021,6 +1153,154 @@ bad:
 	return 0;
 }
 
+/*
+ * Strip -> strip or tile -> tile without decoding.
+ */
+DECLAREcpFunc(cpRawChunks)
+{
+	int tiled = TIFFIsTiled(in);
+	uint32 nchunks = tiled ? TIFFNumberOfTiles(in) : TIFFNumberOfStrips(in);
+	uint64 bufsize = 0;
+	tdata_t buf = NULL;
+	uint32 c;
+
+	(void) imagelength; (void) imagewidth; (void) spp;
+	for (c = 0; c < nchunks; c++) {
+		uint64 cc = TIFFGetStrileByteCount(in, c);
+		tmsize_t got;
+
+		if (cc == 0)
+			continue;
+		if (cc > bufsize) {
+			tdata_t newbuf;
+			if ((uint64)(tmsize_t) cc != cc ||
+			    (newbuf = _TIFFrealloc(buf, (tmsize_t) cc)) == NULL) {
+				TIFFError(TIFFFileName(in),
+				    "Error, can't allocate memory buffer of size "
+				    TIFF_UINT64_FORMAT " to read raw %s", cc,
+				    tiled ? "tiles" : "strips");
+				goto bad;
+			}
+			buf = newbuf;
+			bufsize = cc;
+		}
+		got = tiled ? TIFFReadRawTile(in, c, buf, (tmsize_t) cc) :
+		    TIFFReadRawStrip(in, c, buf, (tmsize_t) cc);
+		if (got < 0) {
+			if (ignore)
+				continue;
+			TIFFError(TIFFFileName(in),
+			    "Error, can't read raw %s %lu",
+			    tiled ? "tile" : "strip", (unsigned long) c);
+			goto bad;
+		}
+		if ((tiled ? TIFFWriteRawTile(out, c, buf, got) :
+		    TIFFWriteRawStrip(out, c, buf, got)) < 0) {
+			TIFFError(TIFFFileName(out),
+			    "Error, can't write raw %s %lu",
+			    tiled ? "tile" : "strip", (unsigned long) c);
+			goto bad;
+		}
+	}
+	_TIFFfree(buf);
+	return 1;
+
+bad:
+	_TIFFfree(buf);
+	return 0;
+}
+
+/*
+ * Strip -> strip or tile -> tile of the same geometry for change in
+ * encoding, with batches of chunks decoded and then encoded on threads.
+ */
+#define	CHUNKSPERTHREAD	4
+
+DECLAREcpFunc(cpDecodedChunksParallel)
+{
+	int tiled = TIFFIsTiled(in);
+	tmsize_t chunksize = tiled ? TIFFTileSize(in) : TIFFStripSize(in);
+	uint32 nchunks = tiled ? TIFFNumberOfTiles(in) : TIFFNumberOfStrips(in);
+	uint32 stripsperplane = nchunks;
+	uint32 batch = (uint32)(nthreads > 0 ? nthreads : 16) * CHUNKSPERTHREAD;
+	uint32* list = NULL;
+	void** bufs = NULL;
+	tmsize_t* sizes = NULL;
+	uint32 first, n, i;
+	int status = 0;
+
+	(void) imagewidth;
+	if (batch > nchunks)
+		batch = nchunks;
+	if (!tiled && config == PLANARCONFIG_SEPARATE && spp > 0)
+		stripsperplane = nchunks / spp;
+	list = (uint32*) _TIFFmalloc(batch * sizeof (uint32));
+	bufs = (void**) _TIFFmalloc(batch * sizeof (void*));
+	sizes = (tmsize_t*) _TIFFmalloc(batch * sizeof (tmsize_t));
+	if (!list || !bufs || !sizes) {
+		TIFFError(TIFFFileName(in),
+		    "Error, can't allocate memory for chunk lists");
+		goto bad;
+	}
+	for (i = 0; i < batch; i++)
+		bufs[i] = NULL;
+	for (i = 0; i < batch; i++) {
+		bufs[i] = _TIFFmalloc(chunksize);
+		if (!bufs[i]) {
+			TIFFError(TIFFFileName(in),
+			    "Error, can't allocate memory buffer of size %lu "
+			    "to read chunks", (unsigned long) chunksize);
+			goto bad;
+		}
+		_TIFFmemset(bufs[i], 0, chunksize);
+	}
+	for (first = 0; first < nchunks; first += n) {
+		n = nchunks - first < batch ? nchunks - first : batch;
+		for (i = 0; i < n; i++) {
+			list[i] = first + i;
+			sizes[i] = chunksize;
+			if (!tiled && stripsperplane > 0) {
+				uint32 row = (list[i] % stripsperplane) * rowsperstrip;
+				if (row + rowsperstrip > imagelength)
+					sizes[i] = TIFFVStripSize(in, imagelength - row);
+			}
+		}
+		if (!(tiled ?
+		    TIFFReadEncodedTilesParallel(in, list, n, bufs, chunksize,
+			nthreads) :
+		    TIFFReadEncodedStripsParallel(in, list, n, bufs, chunksize,
+			nthreads)) && !ignore) {
+			TIFFError(TIFFFileName(in),
+			    "Error, can't read %s %lu to %lu",
+			    tiled ? "tiles" : "strips",
+			    (unsigned long) first, (unsigned long) (first + n - 1));
+			goto bad;
+		}
+		if (!(tiled ?
+		    TIFFWriteEncodedTilesParallel(out, list, n, bufs, sizes,
+			nthreads) :
+		    TIFFWriteEncodedStripsParallel(out, list, n, bufs, sizes,
+			nthreads))) {
+			TIFFError(TIFFFileName(out),
+			    "Error, can't write %s %lu to %lu",
+			    tiled ? "tiles" : "strips",
+			    (unsigned long) first, (unsigned long) (first + n - 1));
+			goto bad;
+		}
+	}
+	status = 1;
+
+bad:
+	if (bufs) {
+		for (i = 0; i < batch; i++)
+			_TIFFfree(bufs[i]);
+		_TIFFfree(bufs);
+	}
+	_TIFFfree(list);
+	_TIFFfree(sizes);
+	return status;
+}
+
 /*
  * Separate -> separate by row for rows/strip change.
  */
@@ -1219,26 +1499,331 @@ cpContigBufToSeparateBuf(uint8* out, uint8* in,
 	}
 }
 
+/*
+ * Number of rows read or written at once: a whole tile row, a strip or,
+ * when scanlines are read, a single row.
+ */
+static uint32
+chunkRows(TIFF* tif, int scanlines, uint32 imagelength)
+{
+	uint32 rows = 1;
+
+	if (TIFFIsTiled(tif))
+		(void) TIFFGetField(tif, TIFFTAG_TILELENGTH, &rows);
+	else if (!scanlines)
+		(void) TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rows);
+	if (rows == 0 || rows > imagelength)
+		rows = imagelength;
+	return rows;
+}
+
+/*
+ * Reduced resolution levels.  Each level is half the size of the level
+ * above; its rows are computed from the rows of the level above as the
+ * full image is copied, and written to a temporary file until the
+ * directory of the full image is done and the levels can follow it.
+ */
+struct overview {
+	TIFF*	tif;		/* temporary file holding the level */
+	char*	name;
+	uint32	width, length;
+	uint32	abovewidth, abovelength;
+	tsize_t	rowsize;
+	uint8*	rows;		/* band of rows of the level */
+	uint32	bandrows;	/* rows written at once */
+	uint32	nrows;		/* rows in the band */
+	uint32	startrow;	/* first row of the band */
+	uint8*	prev;		/* row of the level above awaiting its pair */
+	uint32	rowsin;		/* rows received from the level above */
+	uint16	spp;
+	int	bytes;		/* bytes per sample */
+};
+
+static struct overview* overviews = NULL;
+static int nlevels = 0;
+static writeFunc overviewfout;
+
+/* fields describing the data of a level, copied from the full image */
+static struct cpTag overviewtags[] = {
+	{ TIFFTAG_BITSPERSAMPLE,	1, TIFF_SHORT },
+	{ TIFFTAG_SAMPLESPERPIXEL,	1, TIFF_SHORT },
+	{ TIFFTAG_COMPRESSION,		1, TIFF_SHORT },
+	{ TIFFTAG_PHOTOMETRIC,		1, TIFF_SHORT },
+	{ TIFFTAG_FILLORDER,		1, TIFF_SHORT },
+	{ TIFFTAG_PLANARCONFIG,		1, TIFF_SHORT },
+	{ TIFFTAG_PREDICTOR,		1, TIFF_SHORT },
+	{ TIFFTAG_SAMPLEFORMAT,		1, TIFF_SHORT },
+	{ TIFFTAG_EXTRASAMPLES,		(uint16) -1, TIFF_SHORT },
+	{ TIFFTAG_WHITEPOINT,		(uint16) -1, TIFF_RATIONAL },
+	{ TIFFTAG_PRIMARYCHROMATICITIES,(uint16) -1,TIFF_RATIONAL },
+	{ TIFFTAG_YCBCRCOEFFICIENTS,	(uint16) -1,TIFF_RATIONAL },
+	{ TIFFTAG_YCBCRSUBSAMPLING,	2, TIFF_SHORT },
+	{ TIFFTAG_YCBCRPOSITIONING,	1, TIFF_SHORT },
+	{ TIFFTAG_REFERENCEBLACKWHITE,	(uint16) -1,TIFF_RATIONAL },
+};
+#define	NOVERVIEWTAGS	(sizeof (overviewtags) / sizeof (overviewtags[0]))
+
 static void
-cpSeparateBufToContigBuf(uint8* out, uint8* in,
-    uint32 rows, uint32 cols, int outskew, int inskew, tsample_t spp,
-    int bytes_per_sample)
+freeOverviews(void)
 {
-	while (rows-- > 0) {
-		uint32 j = cols;
-		while (j-- > 0) {
-			int n = bytes_per_sample;
+	int i;
 
-			while( n-- ) {
-				*out++ = *in++;
+	for (i = 0; i < nlevels; i++) {
+		struct overview* o = &overviews[i];
+		if (o->tif) {
+			TIFFClose(o->tif);
+			unlink(o->name);
+		}
+		_TIFFfree(o->name);
+		_TIFFfree(o->rows);
+		_TIFFfree(o->prev);
+	}
+	_TIFFfree(overviews);
+	overviews = NULL;
+	nlevels = 0;
+}
+
+/*
+ * Create the temporary files for the reduced resolution levels of the
+ * image being set up in out.
+ */
+static int
+openOverviews(TIFF* out, uint32 width, uint32 length, uint16 bitspersample,
+	      uint16 samplesperpixel)
+{
+	const char* name = TIFFFileName(out);
+	char mode[4];
+	uint16 shortv;
+	uint32 rows;
+	uint64* offsets;
+	int i;
+	size_t p;
+
+	(void) TIFFGetFieldDefaulted(out, TIFFTAG_SAMPLEFORMAT, &shortv);
+	if (bias || (bitspersample != 8 && bitspersample != 16) ||
+	    shortv != SAMPLEFORMAT_UINT) {
+		TIFFError(name, "Can't build reduced resolution levels of "
+		    "images other than 8 or 16 bits/sample unsigned integer");
+		return FALSE;
+	}
+	(void) TIFFGetFieldDefaulted(out, TIFFTAG_PHOTOMETRIC, &shortv);
+	if (shortv == PHOTOMETRIC_PALETTE) {
+		TIFFError(name,
+		    "Can't build reduced resolution levels of palette images");
+		return FALSE;
+	}
+	overviews = (struct overview*)
+	    _TIFFmalloc(noverviews * sizeof (struct overview));
+	if (overviews == NULL) {
+		TIFFError(name, "Out of memory");
+		return FALSE;
+	}
+	_TIFFmemset(overviews, 0, noverviews * sizeof (struct overview));
+	mode[0] = 'w';
+	mode[1] = '8';
+	mode[2] = TIFFIsBigEndian(out) ? 'b' : 'l';
+	mode[3] = '\0';
+	for (i = 0; i < noverviews && (width > 1 || length > 1); i++) {
+		struct overview* o = &overviews[nlevels++];
+		struct cpTag* t;
+
+		o->abovewidth = width;
+		o->abovelength = length;
+		o->width = width = (width + 1) / 2;
+		o->length = length = (length + 1) / 2;
+		o->spp = samplesperpixel;
+		o->bytes = bitspersample / 8;
+		o->rowsize = (tsize_t) o->width * o->spp * o->bytes;
+		o->name = (char*) _TIFFmalloc(strlen(name) + 16);
+		if (o->name == NULL)
+			goto bad;
+		sprintf(o->name, "%s.level%d", name, i + 1);
+		o->tif = TIFFOpen(o->name, mode);
+		if (o->tif == NULL)
+			goto bad;
+		TIFFSetField(o->tif, TIFFTAG_IMAGEWIDTH, o->width);
+		TIFFSetField(o->tif, TIFFTAG_IMAGELENGTH, o->length);
+		for (t = overviewtags; t < &overviewtags[NOVERVIEWTAGS]; t++)
+			cpTag(out, o->tif, t->tag, t->count, t->type);
+		switch (compression) {
+		case COMPRESSION_JPEG:
+			TIFFSetField(o->tif, TIFFTAG_JPEGQUALITY, quality);
+			TIFFSetField(o->tif, TIFFTAG_JPEGCOLORMODE, jpegcolormode);
+			break;
+		case COMPRESSION_ADOBE_DEFLATE:
+		case COMPRESSION_DEFLATE:
+			if (preset != -1)
+				TIFFSetField(o->tif, TIFFTAG_ZIPQUALITY, preset);
+			break;
+		case COMPRESSION_LZMA:
+			if (preset != -1)
+				TIFFSetField(o->tif, TIFFTAG_LZMAPRESET, preset);
+			break;
+		case COMPRESSION_ZSTD:
+			if (preset != -1)
+				TIFFSetField(o->tif, TIFFTAG_ZSTD_LEVEL, preset);
+			break;
+		case COMPRESSION_LZ4:
+			if (preset != -1)
+				TIFFSetField(o->tif, TIFFTAG_LZ4_LEVEL, preset);
+			break;
+		case COMPRESSION_LERC:
+			setLERCOptions(o->tif);
+			break;
+		case COMPRESSION_WEBP:
+			TIFFSetField(o->tif, TIFFTAG_WEBP_LEVEL, quality);
+			TIFFSetField(o->tif, TIFFTAG_WEBP_LOSSLESS, webplossless);
+			break;
+		}
+		if (TIFFIsTiled(out)) {
+			(void) TIFFGetField(out, TIFFTAG_TILEWIDTH, &rows);
+			TIFFSetField(o->tif, TIFFTAG_TILEWIDTH, rows);
+			(void) TIFFGetField(out, TIFFTAG_TILELENGTH, &rows);
+			TIFFSetField(o->tif, TIFFTAG_TILELENGTH, rows);
+		} else {
+			rows = chunkRows(out, 0, o->length);
+			TIFFSetField(o->tif, TIFFTAG_ROWSPERSTRIP, rows);
+		}
+		o->bandrows = chunkRows(o->tif, 0, o->length);
+		o->rows = (uint8*) _TIFFmalloc(o->rowsize * o->bandrows);
+		o->prev = (uint8*) _TIFFmalloc(
+		    (tsize_t) o->abovewidth * o->spp * o->bytes);
+		if (o->rows == NULL || o->prev == NULL)
+			goto bad;
+		_TIFFmemset(o->rows, 0, o->rowsize * o->bandrows);
+	}
+	if (overviewsubifds && nlevels > 0) {
+		offsets = (uint64*) _TIFFmalloc(nlevels * sizeof (uint64));
+		if (offsets == NULL)
+			goto bad;
+		for (p = 0; p < (size_t) nlevels; p++)
+			offsets[p] = 0;
+		TIFFSetField(out, TIFFTAG_SUBIFD, (uint16) nlevels, offsets);
+		_TIFFfree(offsets);
+	}
+	return TRUE;
+
+bad:
+	TIFFError(name, "Can't set up reduced resolution levels");
+	freeOverviews();
+	return FALSE;
+}
+
+/*
+ * Average the 2x2 boxes of rows a and b of the level above into a row
+ * of the level.
+ */
+static void
+reduceRows(struct overview* o, const uint8* a, const uint8* b, uint8* row)
+{
+	uint32 x;
+	uint16 s;
+
+	for (x = 0; x < o->width; x++) {
+		uint32 x0 = 2 * x * o->spp;
+		uint32 x1 = (2 * x + 1 < o->abovewidth ? 2 * x + 1 : 2 * x) *
+		    o->spp;
+		for (s = 0; s < o->spp; s++) {
+			if (o->bytes == 1)
+				row[x * o->spp + s] = (uint8)
+				    ((a[x0 + s] + a[x1 + s] + b[x0 + s] +
+				      b[x1 + s] + 2) >> 2);
+			else {
+				const uint16* a16 = (const uint16*) a;
+				const uint16* b16 = (const uint16*) b;
+				((uint16*) row)[x * o->spp + s] = (uint16)
+				    (((uint32) a16[x0 + s] + a16[x1 + s] +
+				      b16[x0 + s] + b16[x1 + s] + 2) >> 2);
 			}
-			out += (spp-1)*bytes_per_sample;
 		}
-		out += outskew;
-		in += inskew;
 	}
 }
 
+/*
+ * Hand a row of the level above to the given level, writing the rows of
+ * the level a band at a time.
+ */
+static int
+feedOverview(int level, uint8* row)
+{
+	struct overview* o = &overviews[level];
+	const uint8* a;
+	uint8* dst;
+
+	o->rowsin++;
+	if (o->rowsin % 2 == 1) {
+		if (o->rowsin < o->abovelength) {
+			_TIFFmemcpy(o->prev, row,
+			    (tsize_t) o->abovewidth * o->spp * o->bytes);
+			return 1;
+		}
+		a = row;	/* last row of an odd length */
+	} else
+		a = o->prev;
+	dst = o->rows + o->nrows * o->rowsize;
+	reduceRows(o, a, row, dst);
+	o->nrows++;
+	if (level + 1 < nlevels && !feedOverview(level + 1, dst))
+		return 0;
+	if (o->nrows == o->bandrows || o->startrow + o->nrows == o->length) {
+		if (!(*overviewfout)(o->tif, o->rows, o->startrow, o->nrows,
+		    o->width, o->spp))
+			return 0;
+		o->startrow += o->nrows;
+		o->nrows = 0;
+	}
+	return 1;
+}
+
+/*
+ * Append the reduced resolution levels after the directory just written
+ * to out, copying their compressed data from the temporary files.
+ */
+static int
+writeOverviews(TIFF* out)
+{
+	int i, status = 1;
+
+	for (i = 0; status && i < nlevels; i++) {
+		struct overview* o = &overviews[i];
+		struct cpTag* t;
+		uint32 longv, count;
+		uint16 shortv;
+		void* table;
+		TIFF* in;
+
+		status = TIFFWriteDirectory(o->tif);
+		TIFFClose(o->tif);
+		o->tif = NULL;
+		in = status ? TIFFOpen(o->name, "r") : NULL;
+		unlink(o->name);
+		if (in == NULL) {
+			status = 0;
+			break;
+		}
+		TIFFSetField(out, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE);
+		CopyField(TIFFTAG_IMAGEWIDTH, longv);
+		CopyField(TIFFTAG_IMAGELENGTH, longv);
+		for (t = overviewtags; t < &overviewtags[NOVERVIEWTAGS]; t++)
+			cpTag(in, out, t->tag, t->count, t->type);
+		if (TIFFIsTiled(in)) {
+			CopyField(TIFFTAG_TILEWIDTH, longv);
+			CopyField(TIFFTAG_TILELENGTH, longv);
+		} else
+			CopyField(TIFFTAG_ROWSPERSTRIP, longv);
+		if (TIFFGetField(in, TIFFTAG_COMPRESSION, &shortv) &&
+		    shortv == COMPRESSION_JPEG &&
+		    TIFFGetField(in, TIFFTAG_JPEGTABLES, &count, &table) &&
+		    count > 0)
+			TIFFSetField(out, TIFFTAG_JPEGTABLES, count, table);
+		status = cpRawChunks(in, out, o->length, o->width, o->spp) &&
+		    TIFFWriteDirectory(out);
+		TIFFClose(in);
+	}
+	freeOverviews();
+	return status;
+}
+
 static int
 cpImage(TIFF* in, TIFF* out, readFunc fin, writeFunc fout,
 	uint32 imagelength, uint32 imagewidth, tsample_t spp)
@@ -1246,19 +1831,53 @@ cpImage(TIFF* in, TIFF* out, readFunc fin, writeFunc fout,
 	int status = 0;
 	tdata_t buf = NULL;
 	tsize_t scanlinesize = TIFFRasterScanlineSize(in);
-	tsize_t bytes = scanlinesize * (tsize_t)imagelength;
+	tsize_t bytes;
+	uint32 inrows = chunkRows(in, 1, imagelength);
+	uint32 outrows = chunkRows(out, 0, imagelength);
+	uint32 a, b, bandrows;
+
+	/*
+	 * Go through the image in bands that hold whole chunks of both
+	 * files, so that only the rows of one band are kept in memory.
+	 */
+	for (a = inrows, b = outrows; b != 0; ) {
+		uint32 r = a % b;
+		a = b;
+		b = r;
+	}
+	if (imagelength == 0 || a == 0 || inrows / a > imagelength / outrows)
+		bandrows = imagelength;
+	else {
+		bandrows = (inrows / a) * outrows;
+		if (bandrows > imagelength)
+			bandrows = imagelength;
+	}
+	bytes = scanlinesize * (tsize_t)bandrows;
 	/*
 	 * XXX: Check for integer overflow.
 	 */
 	if (scanlinesize
-	    && imagelength
-	    && bytes / (tsize_t)imagelength == scanlinesize) {
+	    && bandrows
+	    && bytes / (tsize_t)bandrows == scanlinesize) {
 		buf = _TIFFmalloc(bytes);
 		if (buf) {
-			if ((*fin)(in, (uint8*)buf, imagelength,
-			    imagewidth, spp)) {
-				status = (*fout)(out, (uint8*)buf,
-				    imagelength, imagewidth, spp);
+			uint32 row;
+
+			status = 1;
+			for (row = 0; status && row < imagelength;
+			    row += bandrows) {
+				uint32 nrows = imagelength - row < bandrows ?
+				    imagelength - row : bandrows;
+				uint32 r;
+
+				status = (*fin)(in, (uint8*)buf, row, nrows,
+				    imagewidth, spp) &&
+				    (*fout)(out, (uint8*)buf, row, nrows,
+				    imagewidth, spp);
+				for (r = 0; status && nlevels > 0 && r < nrows;
+				    r++)
+					status = feedOverview(0,
+					    (uint8*)buf + r * scanlinesize);
 			}
 			_TIFFfree(buf);
 		} else {
@@ -1280,11 +1899,11 @@ DECLAREreadFunc(readContigStripsIntoBuffer)
 
 	(void) imagewidth; (void) spp;
 	for (row = 0; row < imagelength; row++) {
-		if (TIFFReadScanline(in, (tdata_t) bufp, row, 0) < 0
+		if (TIFFReadScanline(in, (tdata_t) bufp, startrow + row, 0) < 0
 		    && !ignore) {
 			TIFFError(TIFFFileName(in),
 			    "Error, can't read scanline %lu",
-			    (unsigned long) row);
+			    (unsigned long) (startrow + row));
 			return 0;
 		}
 		bufp += scanlinesize;
@@ -1317,11 +1936,11 @@ DECLAREreadFunc(readSeparateStripsIntoBuffer)
 				tsize_t n = scanlinesize;
 				uint8* sbuf = scanline;
 
-				if (TIFFReadScanline(in, scanline, row, s) < 0
-				    && !ignore) {
+				if (TIFFReadScanline(in, scanline, startrow + row,
+				    s) < 0 && !ignore) {
 					TIFFError(TIFFFileName(in),
 					    "Error, can't read scanline %lu",
-					    (unsigned long) row);
+					    (unsigned long) (startrow + row));
 					    status = 0;
 					goto done;
 				}
@@ -1363,12 +1982,12 @@ DECLAREreadFunc(readContigTilesIntoBuffer)
 		uint32 col;
 
 		for (col = 0; col < imagewidth && colb < imagew; col += tw) {
-			if (TIFFReadTile(in, tilebuf, col, row, 0, 0) < 0
-			    && !ignore) {
+			if (TIFFReadTile(in, tilebuf, col, startrow + row,
+			    0, 0) < 0 && !ignore) {
 				TIFFError(TIFFFileName(in),
 				    "Error, can't read tile at %lu %lu",
 				    (unsigned long) col,
-				    (unsigned long) row);
+				    (unsigned long) (startrow + row));
 				status = 0;
 				goto done;
 			}
@@ -1395,14 +2014,14 @@ DECLAREreadFunc(readSeparateTilesIntoBuffer)
 {
 	int status = 1;
 	uint32 imagew = TIFFRasterScanlineSize(in);
-	uint32 tilew = TIFFTileRowSize(in);
-	int iskew  = imagew - tilew*spp;
-	tsize_t tilesize = TIFFTileSize(in);
+	uint32 tilew = TIFFTileRowSize(in) * spp;
+	int iskew  = imagew - tilew;
+	tsize_t tilesize = TIFFTileSize(in) * spp;
 	tdata_t tilebuf;
 	uint8* bufp = (uint8*) buf;
 	uint32 tw, tl;
 	uint32 row;
-	uint16 bps = 0, bytes_per_sample;
+	uint16 bps = 0;
 
 	tilebuf = _TIFFmalloc(tilesize);
 	if (tilebuf == 0)
@@ -1423,7 +2042,6 @@ DECLAREreadFunc(readSeparateTilesIntoBuffer)
             status = 0;
             goto done;
         }
-	bytes_per_sample = bps/8;
 
 	for (row = 0; row < imagelength; row += tl) {
 		uint32 nrow = (row+tl > imagelength) ? imagelength-row : tl;
@@ -1431,42 +2049,35 @@ DECLAREreadFunc(readSeparateTilesIntoBuffer)
 		uint32 col;
 
 		for (col = 0; col < imagewidth; col += tw) {
-			tsample_t s;
-
-			for (s = 0; s < spp; s++) {
-				if (TIFFReadTile(in, tilebuf, col, row, 0, s) < 0
-				    && !ignore) {
-					TIFFError(TIFFFileName(in),
-					    "Error, can't read tile at %lu %lu, "
-					    "sample %lu",
-					    (unsigned long) col,
-					    (unsigned long) row,
-					    (unsigned long) s);
-					status = 0;
-					goto done;
-				}
-				/*
-				 * Tile is clipped horizontally.  Calculate
-				 * visible portion and skewing factors.
-				 */
-				if (colb + tilew*spp > imagew) {
-					uint32 width = imagew - colb;
-					int oskew = tilew*spp - width;
-					cpSeparateBufToContigBuf(
-					    bufp+colb+s*bytes_per_sample,
-					    tilebuf, nrow,
-					    width/(spp*bytes_per_sample),
-					    oskew + iskew,
-					    oskew/spp, spp,
-					    bytes_per_sample);
-				} else
-					cpSeparateBufToContigBuf(
-					    bufp+colb+s*bytes_per_sample,
-					    tilebuf, nrow, tw,
-					    iskew, 0, spp,
-					    bytes_per_sample);
+			/*
+			 * Read the tile of every sample at once, already
+			 * interleaved, and copy it like a contiguous one.
+			 */
+			if (TIFFReadEncodedTileInterleaved(in,
+			    TIFFComputeTile(in, col, startrow + row, 0, 0),
+			    tilebuf, tilesize) < 0 && !ignore) {
+				TIFFError(TIFFFileName(in),
+				    "Error, can't read tile at %lu %lu",
+				    (unsigned long) col,
+				    (unsigned long) (startrow + row));
+				status = 0;
+				goto done;
 			}
-			colb += tilew*spp;
+			/*
+			 * Tile is clipped horizontally.  Calculate
+			 * visible portion and skewing factors.
+			 */
+			if (colb + tilew > imagew) {
+				uint32 width = imagew - colb;
+				int oskew = tilew - width;
+				cpStripToTile(bufp + colb,
+				    tilebuf, nrow, width,
+				    oskew + iskew, oskew);
+			} else
+				cpStripToTile(bufp + colb,
+				    tilebuf, nrow, tilew,
+				    iskew, 0);
+			colb += tilew;
 		}
 		bufp += imagew * nrow;
 	}
@@ -1478,7 +2089,7 @@ done:
 DECLAREwriteFunc(writeBufferToContigStrips)
 {
 	uint32 row, rowsperstrip;
-	tstrip_t strip = 0;
+	tstrip_t strip = TIFFComputeStrip(out, startrow, 0);
 
 	(void) imagewidth; (void) spp;
 	(void) TIFFGetFieldDefaulted(out, TIFFTAG_ROWSPERSTRIP, &rowsperstrip);
@@ -1502,7 +2113,7 @@ DECLAREwriteFunc(writeBufferToSeparateStrips)
 	uint32 rowsperstrip;
 	tsize_t stripsize = TIFFStripSize(out);
 	tdata_t obuf;
-	tstrip_t strip = 0;
+	tstrip_t strip;
 	tsample_t s;
 
 	obuf = _TIFFmalloc(stripsize);
@@ -1512,6 +2123,7 @@ DECLAREwriteFunc(writeBufferToSeparateStrips)
 	(void) TIFFGetFieldDefaulted(out, TIFFTAG_ROWSPERSTRIP, &rowsperstrip);
 	for (s = 0; s < spp; s++) {
 		uint32 row;
+		strip = TIFFComputeStrip(out, startrow, s);
 		for (row = 0; row < imagelength; row += rowsperstrip) {
 			uint32 nrows = (row+rowsperstrip > imagelength) ?
 			    imagelength-row : rowsperstrip;
@@ -1571,11 +2183,12 @@ DECLAREwriteFunc(writeBufferToContigTiles)
 			} else
 				cpStripToTile(obuf, bufp + colb, nrow, tilew,
 				    0, iskew);
-			if (TIFFWriteTile(out, obuf, col, row, 0, 0) < 0) {
+			if (TIFFWriteTile(out, obuf, col, startrow + row,
+			    0, 0) < 0) {
 				TIFFError(TIFFFileName(out),
 				    "Error, can't write tile at %lu %lu",
 				    (unsigned long) col,
-				    (unsigned long) row);
+				    (unsigned long) (startrow + row));
 				_TIFFfree(obuf);
 				return 0;
 			}
@@ -1589,18 +2202,17 @@ DECLAREwriteFunc(writeBufferToContigTiles)
 
 DECLAREwriteFunc(writeBufferToSeparateTiles)
 {
-	uint32 imagew = TIFFScanlineSize(out);
-	tsize_t tilew  = TIFFTileRowSize(out);
 	uint32 iimagew = TIFFRasterScanlineSize(out);
-	int iskew = iimagew - tilew*spp;
-	tsize_t tilesize = TIFFTileSize(out);
+	uint32 tilew  = TIFFTileRowSize(out) * spp;
+	int iskew = iimagew - tilew;
+	tsize_t tilesize = TIFFTileSize(out) * spp;
 	tdata_t obuf;
 	uint8* bufp = (uint8*) buf;
 	uint32 tl, tw;
 	uint32 row;
-	uint16 bps = 0, bytes_per_sample;
+	uint16 bps = 0;
 
-	obuf = _TIFFmalloc(TIFFTileSize(out));
+	obuf = _TIFFmalloc(tilesize);
 	if (obuf == NULL)
 		return 0;
 	_TIFFmemset(obuf, 0, tilesize);
@@ -1619,7 +2231,6 @@ DECLAREwriteFunc(writeBufferToSeparateTiles)
             _TIFFfree(obuf);
             return 0;
         }
-	bytes_per_sample = bps/8;
 
 	for (row = 0; row < imagelength; row += tl) {
 		uint32 nrow = (row+tl > imagelength) ? imagelength-row : tl;
@@ -1627,37 +2238,31 @@ DECLAREwriteFunc(writeBufferToSeparateTiles)
 		uint32 col;
 
 		for (col = 0; col < imagewidth; col += tw) {
-			tsample_t s;
-			for (s = 0; s < spp; s++) {
-				/*
-				 * Tile is clipped horizontally.  Calculate
-				 * visible portion and skewing factors.
-				 */
-				if (colb + tilew > imagew) {
-					uint32 width = (imagew - colb);
-					int oskew = tilew - width;
-
-					cpContigBufToSeparateBuf(obuf,
-					    bufp + (colb*spp) + s,
-					    nrow, width/bytes_per_sample,
-					    oskew, (oskew*spp)+iskew, spp,
-					    bytes_per_sample);
-				} else
-					cpContigBufToSeparateBuf(obuf,
-					    bufp + (colb*spp) + s,
-					    nrow, tilewidth,
-					    0, iskew, spp,
-					    bytes_per_sample);
-				if (TIFFWriteTile(out, obuf, col, row, 0, s) < 0) {
-					TIFFError(TIFFFileName(out),
-					    "Error, can't write tile at %lu %lu "
-					    "sample %lu",
-					    (unsigned long) col,
-					    (unsigned long) row,
-					    (unsigned long) s);
-					_TIFFfree(obuf);
-					return 0;
-				}
+			/*
+			 * Tile is clipped horizontally.  Calculate
+			 * visible portion and skewing factors.
+			 */
+			if (colb + tilew > iimagew) {
+				uint32 width = iimagew - colb;
+				int oskew = tilew - width;
+				cpStripToTile(obuf, bufp + colb, nrow, width,
+				    oskew, oskew + iskew);
+			} else
+				cpStripToTile(obuf, bufp + colb, nrow, tilew,
+				    0, iskew);
+			/*
+			 * Split the interleaved tile into the tiles of
+			 * the samples and write them all at once.
+			 */
+			if (TIFFWriteEncodedTileInterleaved(out,
+			    TIFFComputeTile(out, col, startrow + row, 0, 0),
+			    obuf, tilesize) < 0) {
+				TIFFError(TIFFFileName(out),
+				    "Error, can't write tile at %lu %lu",
+				    (unsigned long) col,
+				    (unsigned long) (startrow + row));
+				_TIFFfree(obuf);
+				return 0;
 			}
 			colb += tilew;
 		}
@@ -1799,6 +2404,114 @@ DECLAREcpFunc(cpSeparateTiles2SeparateStrips)
 	    imagelength, imagewidth, spp);
 }
 
+/*
+ * Any layout -> any layout, feeding the rows to the reduced resolution
+ * levels on the way.
+ */
+DECLAREcpFunc(cpImageWithOverviews)
+{
+	uint16 inconfig;
+	readFunc fin;
+	writeFunc fout;
+
+	(void) TIFFGetFieldDefaulted(in, TIFFTAG_PLANARCONFIG, &inconfig);
+	if (TIFFIsTiled(in))
+		fin = inconfig == PLANARCONFIG_SEPARATE ?
+		    readSeparateTilesIntoBuffer : readContigTilesIntoBuffer;
+	else
+		fin = inconfig == PLANARCONFIG_SEPARATE ?
+		    readSeparateStripsIntoBuffer : readContigStripsIntoBuffer;
+	if (TIFFIsTiled(out))
+		fout = config == PLANARCONFIG_SEPARATE ?
+		    writeBufferToSeparateTiles : writeBufferToContigTiles;
+	else
+		fout = config == PLANARCONFIG_SEPARATE ?
+		    writeBufferToSeparateStrips : writeBufferToContigStrips;
+	if (spp > 1 && overviews[0].bytes > 1 &&
+	    ((inconfig == PLANARCONFIG_SEPARATE && !TIFFIsTiled(in)) ||
+	     (config == PLANARCONFIG_SEPARATE && !TIFFIsTiled(out)))) {
+		TIFFError(TIFFFileName(in),
+		    "Can't build reduced resolution levels of separate strips "
+		    "with more than 8 bits/sample");
+		return 0;
+	}
+	overviewfout = fout;
+	return cpImage(in, out, fin, fout, imagelength, imagewidth, spp);
+}
+
+/*
+ * Check whether any strip or tile of the input is coded with the
+ * old-style (compat) LZW codes, the way LZWPreDecode() tells them
+ * apart.  Those are decoded and written again with standard codes.
+ */
+static int
+hasOldStyleLZW(TIFF* in)
+{
+	uint32 n = TIFFIsTiled(in) ? TIFFNumberOfTiles(in) :
+	    TIFFNumberOfStrips(in);
+	uint32 i;
+
+	for (i = 0; i < n; i++) {
+		unsigned char raw[2];
+		tmsize_t cc = TIFFIsTiled(in) ?
+		    TIFFReadRawTile(in, i, raw, sizeof (raw)) :
+		    TIFFReadRawStrip(in, i, raw, sizeof (raw));
+
+		if (cc == sizeof (raw) && raw[0] == 0 && (raw[1] & 0x1))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Check whether the compressed strips or tiles of the input can be
+ * copied as they are: same codec and coding options, same layout of
+ * the data and, for samples wider than a byte, same byte order.
+ */
+static int
+canCopyRaw(TIFF* in, TIFF* out, uint16 input_compression, uint16 bitspersample)
+{
+	uint16 invalue, outvalue;
+	uint32 in1, in2, out1, out2;
+
+	if (bias || noverviews > 0 || input_compression == COMPRESSION_OJPEG)
+		return FALSE;
+	if (compression != input_compression ||
+	    defcompression == COMPRESSION_JPEG)
+		return FALSE;
+	if (defpredictor != (uint16) -1 || defpreset != -1 ||
+	    defg3opts != (uint32) -1)
+		return FALSE;
+	(void) TIFFGetFieldDefaulted(in, TIFFTAG_FILLORDER, &invalue);
+	(void) TIFFGetFieldDefaulted(out, TIFFTAG_FILLORDER, &outvalue);
+	if (invalue != outvalue)
+		return FALSE;
+	(void) TIFFGetFieldDefaulted(in, TIFFTAG_PLANARCONFIG, &invalue);
+	if (invalue != config)
+		return FALSE;
+	if (TIFFIsTiled(in) != TIFFIsTiled(out))
+		return FALSE;
+	if (TIFFIsTiled(in)) {
+		if (!TIFFGetField(in, TIFFTAG_TILEWIDTH, &in1) ||
+		    !TIFFGetField(in, TIFFTAG_TILELENGTH, &in2) ||
+		    !TIFFGetField(out, TIFFTAG_TILEWIDTH, &out1) ||
+		    !TIFFGetField(out, TIFFTAG_TILELENGTH, &out2) ||
+		    in1 != out1 || in2 != out2)
+			return FALSE;
+	} else {
+		(void) TIFFGetField(in, TIFFTAG_IMAGELENGTH, &in2);
+		(void) TIFFGetFieldDefaulted(in, TIFFTAG_ROWSPERSTRIP, &in1);
+		(void) TIFFGetFieldDefaulted(out, TIFFTAG_ROWSPERSTRIP, &out1);
+		if ((in1 < in2 ? in1 : in2) != (out1 < in2 ? out1 : in2))
+			return FALSE;
+	}
+	if (bitspersample > 8 && TIFFIsBigEndian(in) != TIFFIsBigEndian(out))
+		return FALSE;
+	if (input_compression == COMPRESSION_LZW && hasOldStyleLZW(in))
+		return FALSE;
+	return TRUE;
+}
+
 /*
  * Select the appropriate copy function to use.
  */
@@ -1842,6 +2555,13 @@ pickCopyFunc(TIFF* in, TIFF* out, uint16 bitspersample, uint16 samplesperpixel)
 			bychunk = (tw == w && tl == rowsperstrip);
 		}
 	}
+	/* the rows of the whole image are needed to reduce it */
+	if (noverviews > 0)
+		return cpImageWithOverviews;
+	/* chunks can be copied one for one: spread them on threads */
+	if (nthreads >= 0 && bychunk && shortv == config &&
+	    TIFFIsTiled(in) == TIFFIsTiled(out))
+		return cpDecodedChunksParallel;
 #define	T 1
 #define	F 0
 #define pack(a,b,c,d,e)	((long)(((a)<<11)|((b)<<3)|((c)<<2)|((d)<<1)|(e)))
@@ -85,6 +85,8 @@
  *                image in the file without knowing how many images there are.
  * -R #           Rotate image or crop selection by 90,180,or 270 degrees
  *                clockwise  
+ * -T             Rotate a whole image tile by tile into a tiled output
+ *                image without reading all of it into memory
  * -F h|v         Flip (mirror) image or crop selection horizontally
  *                or vertically 
  * -I [black|white|data|both]
@@ -202,6 +204,7 @@ extern int getopt(int argc, char * const argv[], const char *optstring);
 
 #define STRIP    1
 #define TILE     2
+#define AREA     3  /* bounding box of the crop selections */
 
 #define MAX_REGIONS   8  /* number of regions to extract from a single page */
 #define MAX_OUTBUFFS  8  /* must match larger of zones or regions */
@@ -404,6 +407,7 @@ struct image_data {
   uint16 orientation;
   uint16 compression;
   uint16 adjustments;
+  uint16 selected;     /* only the area of the crop selections was loaded */
 };
 
 /* Structure to define the output image modifiers */
@@ -445,6 +449,8 @@ static uint16 fillorder = 0;
 static uint32 rowsperstrip = 0;
 static uint32 g3opts = 0;
 static int    ignore = FALSE;		/* if true, ignore read errors */
+static int    rotatetiles = FALSE;	/* if true, rotate tile by tile */
+static uint16 tilerotation = 0;		/* angle used by writeRotatedTiles */
 static uint32 defg3opts = (uint32) -1;
 static int    quality = 100;		/* JPEG quality */
 /* static int    jpegcolormode = -1;        was JPEGCOLORMODE_RGB;  */
@@ -456,6 +462,7 @@ static int    little_endian = 1;
 
 /* Functions adapted from tiffcp with additions or significant modifications */
 static int  readContigStripsIntoBuffer   (TIFF*, uint8*);
+static int  readContigStripRowsIntoBuffer (TIFF*, uint8*, uint32, uint32);
 static int  readSeparateStripsIntoBuffer (TIFF*, uint8*, uint32, uint32, tsample_t, struct dump_opts *);
 static int  readContigTilesIntoBuffer    (TIFF*, uint8*, uint32, uint32, uint32, uint32, tsample_t, uint16);
 static int  readSeparateTilesIntoBuffer  (TIFF*, uint8*, uint32, uint32, uint32, uint32, tsample_t, uint16);
@@ -490,7 +497,10 @@ static int  computeInputPixelOffsets(struct crop_mask *, struct image_data *,
 static int  computeOutputPixelOffsets (struct crop_mask *, struct image_data *,
 				       struct pagedef *, struct pageseg *,
                                        struct dump_opts *);
-static int  loadImage(TIFF *, struct image_data *, struct dump_opts *, unsigned char **);
+static int  loadImage(TIFF *, struct image_data *, struct crop_mask *,
+                      struct dump_opts *, unsigned char **);
+static int  getSelectionBounds(struct crop_mask *, uint32 *, uint32 *,
+                               uint32 *, uint32 *);
 static int  correct_orientation(struct image_data *, unsigned char **);
 static int  getCropOffsets(struct image_data *, struct crop_mask *, struct dump_opts *);
 static int  processCropSelections(struct image_data *, struct crop_mask *, 
@@ -516,6 +526,9 @@ static int  createCroppedImage(struct image_data *, struct crop_mask *,
 static int  writeCroppedImage(TIFF *, TIFF *, struct image_data *image,
                               struct dump_opts * dump,
                               uint32, uint32, unsigned char *, int, int);
+static int  canRotateTiles(TIFF *, struct crop_mask *, struct pagedef *);
+static int  writeRotatedTiles(TIFF *, TIFF *, struct image_data *,
+                              uint32, uint32, uint16);
 
 /* Image manipulation functions */
 static int rotateContigSamples8bits(uint16, uint16, uint16, uint32, 
@@ -526,6 +539,8 @@ static int rotateContigSamples24bits(uint16, uint16, uint16, uint32,
                                      uint32,   uint32, uint8 *, uint8 *);
 static int rotateContigSamples32bits(uint16, uint16, uint16, uint32, 
                                      uint32,   uint32, uint8 *, uint8 *);
+static void rotateBytePixels(uint16, uint32, uint32, uint32, const uint8 *,
+                             tmsize_t, uint8 *, tmsize_t);
 static int rotateImage(uint16, struct image_data *, uint32 *, uint32 *,
  		       unsigned char **);
 static int mirrorImage(uint16, uint16, uint16, uint32, uint32,
@@ -717,6 +732,7 @@ static   char* usage_info[] = {
 " -F hor|vert|both",
 "             flip (mirror) image or region horizontally, vertically, or both",
 " -R #        [90,180,or 270] degrees clockwise rotation of image or extracted region",
+" -T          rotate a whole image tile by tile into tiled output (with -R and -t)",
 " -I [black|white|data|both]",
 "             invert color space, eg dark to light for bilevel and grayscale images",
 "             If argument is white or black, set the PHOTOMETRIC_INTERPRETATION ",
@@ -1616,7 +1632,7 @@ void  process_command_opts (int argc, char *argv[], char *mp, char *mode, uint32
     *mp++ = 'w';
     *mp = '\0';
     while ((c = getopt(argc, argv,
-       "ac:d:e:f:hil:m:p:r:stvw:z:BCD:E:F:H:I:J:K:LMN:O:P:R:S:U:V:X:Y:Z:")) != -1)
+       "ac:d:e:f:hil:m:p:r:stvw:z:BCD:E:F:H:I:J:K:LMN:O:P:R:S:TU:V:X:Y:Z:")) != -1)
       {
     good_args++;
     switch (c) {
@@ -2039,6 +2055,9 @@ void  process_command_opts (int argc, char *argv[], char *mp, char *mode, uint32
                   }
                 page->mode |= PAGE_MODE_ROWSCOLS;
 		break;
+      case 'T':	/* rotate tile by tile into tiled output */
+		rotatetiles = TRUE;
+		break;
       case 'U':	/* units for measurements and offsets */
 		if (streq(optarg, "in"))
                   {
@@ -2350,7 +2369,12 @@ main(int argc, char* argv[])
       if (dump.debug)
          TIFFError("main", "Reading image %4d of %4d total pages.", dirnum + 1, total_pages);
 
-      if (loadImage(in, &image, &dump, &read_buff))
+      /* With -T the image is rotated from the input as it is written */
+      tilerotation = canRotateTiles(in, &crop, &page) ? crop.rotation : 0;
+
+      /* Sections of the output page are taken from the whole image */
+      if (loadImage(in, &image, (page.mode == PAGE_MODE_NONE) ? &crop : NULL,
+                    &dump, (tilerotation != 0) ? NULL : &read_buff))
         {
         TIFFError("main", "Unable to load source image");
         exit (-1);
@@ -2364,7 +2388,8 @@ main(int argc, char* argv[])
 	    TIFFError("main", "Unable to correct image orientation");
         }
 
-      if (getCropOffsets(&image, &crop, &dump))
+      /* loadImage has already located the selections it read */
+      if (!image.selected && getCropOffsets(&image, &crop, &dump))
         {
         TIFFError("main", "Unable to define crop regions");
         exit (-1);
@@ -2378,6 +2403,11 @@ main(int argc, char* argv[])
           exit (-1);
 	  }
 	}
+      else if (tilerotation != 0)
+        {  /* The dimensions of the whole image after rotation */
+        crop.combined_width = (tilerotation == 180) ? image.width : image.length;
+        crop.combined_length = (tilerotation == 180) ? image.length : image.width;
+        }
       else  /* Single image segment without zones or regions */
         {
         if (createCroppedImage(&image, &crop, &read_buff, &crop_buff))
@@ -2399,7 +2429,9 @@ main(int argc, char* argv[])
                                   &next_page))
              exit (1);
           if (writeCroppedImage(in, out, &image, &dump,crop.combined_width, 
-                                crop.combined_length, crop_buff, next_page, total_pages))
+                                crop.combined_length,
+                                (tilerotation != 0) ? NULL : crop_buff,
+                                next_page, total_pages))
             {
              TIFFError("main", "Unable to write new image");
              exit (-1);
@@ -3712,6 +3744,54 @@ static int readContigStripsIntoBuffer (TIFF* in, uint8* buf)
         return 1;
 } /* end readContigStripsIntoBuffer */
 
+/* Read nrows full rows starting at row from the strips that hold them */
+static int readContigStripRowsIntoBuffer (TIFF* in, uint8* buf, uint32 row,
+                                          uint32 nrows)
+{
+        uint8*  bufp = buf;
+        uint8*  strip_buff;
+        uint32  length = 0, rps = 0;
+        uint32  strip_row, first, last;
+        tsize_t scanline_size = TIFFScanlineSize(in);
+
+        if (scanline_size == 0) {
+                TIFFError("", "TIFF scanline size is zero!");    
+                return 0;
+        }
+        TIFFGetField(in, TIFFTAG_IMAGELENGTH, &length);
+        TIFFGetFieldDefaulted(in, TIFFTAG_ROWSPERSTRIP, &rps);
+        if (rps == 0 || rps > length)
+                rps = length;
+        strip_buff = (uint8*) _TIFFmalloc(TIFFStripSize(in));
+        if (strip_buff == NULL) {
+                TIFFError("readContigStripRowsIntoBuffer",
+                          "Unable to allocate strip buffer");
+                return 0;
+        }
+
+        for (strip_row = (row / rps) * rps; strip_row < row + nrows;
+             strip_row += rps) {
+                first = (strip_row < row) ? row - strip_row : 0;
+                last = (row + nrows - strip_row < rps) ?
+                        row + nrows - strip_row : rps;
+                /* Only decode the strip up to the last row needed */
+                if (TIFFReadEncodedStrip (in, TIFFComputeStrip(in, strip_row, 0),
+                                          strip_buff, last * scanline_size) < 0
+                    && !ignore) {
+                        TIFFError("", "Error reading strip at row %lu",
+                                  (unsigned long) strip_row);
+                        _TIFFfree(strip_buff);
+                        return 0;
+                }
+                _TIFFmemcpy(bufp, strip_buff + first * scanline_size,
+                            (last - first) * scanline_size);
+                bufp += (last - first) * scanline_size;
+        }
+
+        _TIFFfree(strip_buff);
+        return 1;
+} /* end readContigStripRowsIntoBuffer */
+
 static int 
 combineSeparateSamplesBytes (unsigned char *srcbuffs[], unsigned char *out,
                              uint32 cols, uint32 rows, uint16 spp, uint16 bps,
@@ -5589,6 +5669,44 @@ getCropOffsets(struct image_data *image, struct crop_mask *crop, struct dump_opt
   return (0);
   } /* end getCropOffsets */
 
+/* Compute the smallest rectangle of the image that holds all the crop
+ * selections.  Return 0 if there are none.
+ */
+static int
+getSelectionBounds(struct crop_mask *crop, uint32 *x, uint32 *y,
+                   uint32 *width, uint32 *length)
+  {
+  int    i;
+  uint32 x1, x2, y1, y2;
+
+  if (crop->selections <= 0)
+    return (0);
+
+  x1 = crop->regionlist[0].x1;
+  x2 = crop->regionlist[0].x2;
+  y1 = crop->regionlist[0].y1;
+  y2 = crop->regionlist[0].y2;
+  for (i = 1; i < crop->selections; i++)
+    {
+    if (crop->regionlist[i].x1 < x1)
+      x1 = crop->regionlist[i].x1;
+    if (crop->regionlist[i].x2 > x2)
+      x2 = crop->regionlist[i].x2;
+    if (crop->regionlist[i].y1 < y1)
+      y1 = crop->regionlist[i].y1;
+    if (crop->regionlist[i].y2 > y2)
+      y2 = crop->regionlist[i].y2;
+    }
+  if ((x2 < x1) || (y2 < y1))
+    return (0);
+
+  *x = x1;
+  *y = y1;
+  *width = x2 - x1 + 1;
+  *length = y2 - y1 + 1;
+  return (1);
+  } /* end getSelectionBounds */
+
 
 static int
 computeOutputPixelOffsets (struct crop_mask *crop, struct image_data *image,
@@ -5821,9 +5939,11 @@ computeOutputPixelOffsets (struct crop_mask *crop, struct image_data *image,
   } /* end computeOutputPixelOffsets */
 
 static int
-loadImage(TIFF* in, struct image_data *image, struct dump_opts *dump, unsigned char **read_ptr)
+loadImage(TIFF* in, struct image_data *image, struct crop_mask *crop,
+          struct dump_opts *dump, unsigned char **read_ptr)
   {
   uint32   i;
+  uint32   sel_x = 0, sel_y = 0, sel_width = 0, sel_length = 0;
   float    xres = 0.0, yres = 0.0;
   uint32   nstrips = 0, ntiles = 0;
   uint16   planar = 0;
@@ -6129,6 +6249,45 @@ loadImage(TIFF* in, struct image_data *image, struct dump_opts *dump, unsigned c
         }
 	}
     }
+
+  /* The pixels of an image rotated with -T are read as it is written */
+  image->selected = FALSE;
+  if (read_ptr == NULL)
+    return (0);
+
+  /* If the crop selections can be located before the image is read, which
+   * rules out orientation corrections, only read the area that bounds them.
+   * TIFFReadRegion needs whole bytes per sample; other depths are read as
+   * whole rows of strips.
+   */
+  if ((crop != NULL) && (image->adjustments == 0) &&
+      (planar == PLANARCONFIG_CONTIG) &&
+      (((bps % 8) == 0) || (readunit == STRIP)))
+    {
+    if (getCropOffsets(image, crop, dump))
+      {
+      TIFFError("loadImage", "Unable to define crop regions");
+      return (-1);
+      }
+    if (getSelectionBounds(crop, &sel_x, &sel_y, &sel_width, &sel_length))
+      {
+      uint64 areasize;
+
+      if ((bps % 8) != 0)
+        {
+        sel_x = 0;
+        sel_width = width;
+        }
+      areasize = (uint64)sel_length * ((((uint64)sel_width * spp * bps) + 7) / 8);
+      if (((sel_width < width) || (sel_length < length)) &&
+          (areasize <= 0xFFFFFFFFU - 3))
+        {
+        image->selected = TRUE;
+        readunit = AREA;
+        buffsize = (uint32)areasize;
+        }
+      }
+    }
  
   read_buff = *read_ptr;
   /* +3 : add a few guard bytes since reverseSamples16bits() can read a bit */
@@ -6179,6 +6338,41 @@ loadImage(TIFF* in, struct image_data *image, struct dump_opts *dump, unsigned c
    * regardless of the way the data are organized in the input file.
    */
   switch (readunit) {
+    case AREA:
+         if ((bps % 8) == 0)
+           {
+           if (!TIFFReadRegion(in, sel_x, sel_y, sel_width, sel_length, 0,
+                               read_buff, 0) && !ignore)
+             {
+	     TIFFError("loadImage", "Unable to read the area of the crop selections");
+	     return (-1);
+             }
+           }
+         else
+           {
+           if (!(readContigStripRowsIntoBuffer(in, read_buff, sel_y, sel_length)))
+             {
+	     TIFFError("loadImage", "Unable to read the rows of the crop selections");
+	     return (-1);
+             }
+           }
+         /* From here on the area read is the image */
+         for (i = 0; i < (uint32)crop->selections; i++)
+           {
+           crop->regionlist[i].x1 -= sel_x;
+           crop->regionlist[i].x2 -= sel_x;
+           crop->regionlist[i].y1 -= sel_y;
+           crop->regionlist[i].y2 -= sel_y;
+           }
+         if (dump->infile != NULL)
+           dump_info (dump->infile, dump->format, "", 
+                      "Area of the selections: x: %u, y: %u, width: %u, length: %u",
+                      sel_x, sel_y, sel_width, sel_length);
+         width = image->width = sel_width;
+         length = image->length = sel_length;
+         scanlinesize = ((width * spp * bps) + 7) / 8;
+         break;
+
     case STRIP:
          if (planar == PLANARCONFIG_CONTIG)
            {
@@ -7976,7 +8170,12 @@ writeCroppedImage(TIFF *in, TIFF *out, struct image_data *image,
   /* Compute the tile or strip dimensions and write to disk */
   if (outtiled)
     {
-    if (config == PLANARCONFIG_CONTIG)
+    if (crop_buff == NULL) /* -T, the image was not read into memory */
+      {
+      if (writeRotatedTiles (in, out, image, width, length, tilerotation))
+        TIFFError("","Unable to write rotated tile data for page %d", pagenum);
+      }
+    else if (config == PLANARCONFIG_CONTIG)
       {
       if (writeBufferToContigTiles (out, crop_buff, length, width, spp, dump))
         TIFFError("","Unable to write contiguous tile data for page %d", pagenum);
@@ -8010,6 +8209,140 @@ writeCroppedImage(TIFF *in, TIFF *out, struct image_data *image,
   return (0);
   } /* end writeCroppedImage */
 
+/* Return TRUE if the current image of in can be rotated tile by tile
+ * into the output (-T), that is if a whole image with byte aligned
+ * contiguous samples is only rotated and written to tiles.
+ */
+static int
+canRotateTiles(TIFF *in, struct crop_mask *crop, struct pagedef *page)
+  {
+  uint16 bps = 0, planar = 0, orientation = 0;
+
+  if (!rotatetiles || crop->crop_mode != CROP_ROTATE ||
+      page->mode != PAGE_MODE_NONE)
+    return (FALSE);
+  if (!(outtiled == TRUE || (outtiled == -1 && TIFFIsTiled(in))))
+    return (FALSE);
+  if (config == PLANARCONFIG_SEPARATE)
+    return (FALSE);
+
+  TIFFGetFieldDefaulted(in, TIFFTAG_BITSPERSAMPLE, &bps);
+  TIFFGetFieldDefaulted(in, TIFFTAG_PLANARCONFIG, &planar);
+  TIFFGetFieldDefaulted(in, TIFFTAG_ORIENTATION, &orientation);
+  if ((bps == 0) || (bps % 8) != 0 || planar != PLANARCONFIG_CONTIG ||
+      orientation != ORIENTATION_TOPLEFT)
+    return (FALSE);
+  return (TRUE);
+  } /* end canRotateTiles */
+
+/* Write the input image rotated by 90, 180 or 270 degrees to the tiles
+ * of out, whose dimensions after rotation are width by length. Each row
+ * of output tiles is made from one band of the input, so only two tile
+ * rows worth of pixels are held in memory. The input is best tiled too:
+ * for 90 and 270 degrees the band is a column of the input image.
+ */
+static int
+writeRotatedTiles(TIFF *in, TIFF *out, struct image_data *image,
+                  uint32 width, uint32 length, uint16 rotation)
+  {
+  uint32   tw = 0, tl = 0;
+  uint32   row, col, nrows, ncols, i;
+  uint32   in_x, in_y, in_width, in_length;
+  uint32   bytes_per_pixel = (image->spp * image->bps) / 8;
+  tmsize_t band_rowsize, tile_rowsize, bandsize, tilesize;
+  uint8   *band_in = NULL, *band_out = NULL, *tilebuf = NULL;
+  int      status = 0;
+
+  TIFFGetField(out, TIFFTAG_TILEWIDTH, &tw);
+  TIFFGetField(out, TIFFTAG_TILELENGTH, &tl);
+  tilesize = TIFFTileSize(out);
+  if (tw == 0 || tl == 0 || tilesize == 0 || bytes_per_pixel == 0)
+    {
+    TIFFError("writeRotatedTiles", "Invalid tile or pixel size");
+    return (1);
+    }
+  tile_rowsize = (tmsize_t)tw * bytes_per_pixel;
+  if (tilesize < tile_rowsize * tl)  /* subsampled output */
+    tilesize = tile_rowsize * tl;
+  band_rowsize = (tmsize_t)width * bytes_per_pixel;
+  bandsize = band_rowsize * tl;
+  if (bandsize / tl != band_rowsize)
+    {
+    TIFFError("writeRotatedTiles", "Integer overflow computing band size");
+    return (1);
+    }
+
+  band_in = (uint8 *)_TIFFmalloc(bandsize);
+  band_out = (uint8 *)_TIFFmalloc(bandsize);
+  tilebuf = (uint8 *)_TIFFmalloc(tilesize);
+  if (!band_in || !band_out || !tilebuf)
+    {
+    TIFFError("writeRotatedTiles", "Unable to allocate rotation buffers");
+    status = 1;
+    }
+
+  for (row = 0; row < length && status == 0; row += tl)
+    {
+    nrows = (length - row > tl) ? tl : length - row;
+    /* The input area that becomes output rows row to row + nrows - 1 */
+    switch (rotation)
+      {
+      case 90:  in_x = row;
+                in_y = 0;
+                in_width = nrows;
+                in_length = image->length;
+                break;
+      case 270: in_x = image->width - row - nrows;
+                in_y = 0;
+                in_width = nrows;
+                in_length = image->length;
+                break;
+      default:  in_x = 0;
+                in_y = image->length - row - nrows;
+                in_width = image->width;
+                in_length = nrows;
+                break;
+      }
+    if (!TIFFReadRegion(in, in_x, in_y, in_width, in_length, 0, band_in, 0)
+        && !ignore)
+      {
+      TIFFError("writeRotatedTiles", "Unable to read rows %lu to %lu",
+                (unsigned long)in_y, (unsigned long)(in_y + in_length - 1));
+      status = 1;
+      break;
+      }
+    rotateBytePixels(rotation, bytes_per_pixel, in_width, in_length, band_in,
+                     (tmsize_t)in_width * bytes_per_pixel, band_out,
+                     band_rowsize);
+
+    for (col = 0; col < width; col += tw)
+      {
+      ncols = (width - col > tw) ? tw : width - col;
+      if (ncols < tw || nrows < tl)
+        _TIFFmemset(tilebuf, 0, tilesize);
+      for (i = 0; i < nrows; i++)
+        _TIFFmemcpy(tilebuf + i * tile_rowsize,
+                    band_out + i * band_rowsize + (tmsize_t)col * bytes_per_pixel,
+                    (tmsize_t)ncols * bytes_per_pixel);
+      if (TIFFWriteTile(out, tilebuf, col, row, 0, 0) < 0)
+        {
+        TIFFError("writeRotatedTiles", "Cannot write tile at %lu %lu",
+                  (unsigned long)col, (unsigned long)row);
+        status = 1;
+        break;
+        }
+      }
+    }
+
+  if (band_in)
+    _TIFFfree(band_in);
+  if (band_out)
+    _TIFFfree(band_out);
+  if (tilebuf)
+    _TIFFfree(tilebuf);
+  return (status);
+  } /* end writeRotatedTiles */
+
 static int
 rotateContigSamples8bits(uint16 rotation, uint16 spp, uint16 bps, uint32 width, 
                          uint32 length,   uint32 col, uint8 *src, uint8 *dst)
@@ -8368,6 +8701,33 @@ rotateContigSamples32bits(uint16 rotation, uint16 spp, uint16 bps, uint32 width,
   } /* end rotateContigSamples32bits */
 
 
+/* Rotate width by length pixels of a whole number of bytes from src to
+ * dst, whose rows are src_rowsize and dst_rowsize bytes apart, with the
+ * cache blocked kernels of the library: rotating clockwise shows the
+ * pixels as the matching orientation would.
+ */
+static void
+rotateBytePixels(uint16 rotation, uint32 bytes_per_pixel, uint32 width,
+                 uint32 length, const uint8 *src, tmsize_t src_rowsize,
+                 uint8 *dst, tmsize_t dst_rowsize)
+  {
+  int orientation;
+
+  switch (rotation)
+    {
+    case 90:  orientation = ORIENTATION_RIGHTTOP;
+              break;
+    case 180: orientation = ORIENTATION_BOTRIGHT;
+              break;
+    case 270: orientation = ORIENTATION_LEFTBOT;
+              break;
+    default:  orientation = ORIENTATION_TOPLEFT;
+              break;
+    }
+  TIFFOrientPixels(dst, dst_rowsize, src, src_rowsize, width, length,
+                    bytes_per_pixel, orientation);
+  } /* end rotateBytePixels */
+
 /* Rotate an image by a multiple of 90 degrees clockwise */
 static int
 rotateImage(uint16 rotation, struct image_data *image, uint32 *img_width, 
@@ -8376,8 +8736,8 @@ rotateImage(uint16 rotation, struct image_data *image, uint32 *img_width,
   int      shift_width;
   uint32   bytes_per_pixel, bytes_per_sample;
   uint32   row, rowsize, src_offset, dst_offset;
-  uint32   i, col, width, length;
-  uint32   colsize, buffsize, col_offset, pix_offset;
+  uint32   col, width, length;
+  uint32   colsize, buffsize;
   unsigned char *ibuff;
   unsigned char *src;
   unsigned char *dst;
@@ -8426,22 +8786,8 @@ rotateImage(uint16 rotation, struct image_data *image, uint32 *img_width,
   switch (rotation)
     {
     case 180: if ((bps % 8) == 0) /* byte aligned data */
-                { 
-                src = ibuff;
-                pix_offset = (spp * bps) / 8;
-                for (row = 0; row < length; row++)
-                   {
-		   dst_offset = (length - row - 1) * rowsize;
-                   for (col = 0; col < width; col++)
-                     { 
-		     col_offset = (width - col - 1) * pix_offset;
-                     dst = rbuff + dst_offset + col_offset;
-
-		     for (i = 0; i  < bytes_per_pixel; i++)
-		       *dst++ = *src++;
-                     }
-                   }
-                }
+                rotateBytePixels(rotation, bytes_per_pixel, width, length,
+                                 ibuff, rowsize, rbuff, rowsize);
 	      else
                 { /* non 8 bit per sample data */ 
                 for (row = 0; row < length; row++)
@@ -8492,21 +8838,8 @@ rotateImage(uint16 rotation, struct image_data *image, uint32 *img_width,
               break;
 
     case 90:  if ((bps % 8) == 0) /* byte aligned data */
-                {
-                for (col = 0; col < width; col++)
-                  {
-		  src_offset = ((length - 1) * rowsize) + (col * bytes_per_pixel);
-                  dst_offset = col * colsize;
-		  src = ibuff + src_offset;
-		  dst = rbuff + dst_offset;
-                  for (row = length; row > 0; row--)
-                    {
-                    for (i = 0; i < bytes_per_pixel; i++)
-                      *dst++ = *(src + i);
-		    src -= rowsize;
-                    }
-		  }
-		}
+                rotateBytePixels(rotation, bytes_per_pixel, width, length,
+                                 ibuff, rowsize, rbuff, colsize);
               else
                 { /* non 8 bit per sample data */ 
                 for (col = 0; col < width; col++)
@@ -8569,21 +8902,8 @@ rotateImage(uint16 rotation, struct image_data *image, uint32 *img_width,
 	      break;
 
     case 270: if ((bps % 8) == 0) /* byte aligned data */
-                {
-                for (col = 0; col < width; col++)
-                  {
-		  src_offset = col * bytes_per_pixel;
-                  dst_offset = (width - col - 1) * colsize;
-		  src = ibuff + src_offset;
-		  dst = rbuff + dst_offset;
-                  for (row = length; row > 0; row--)
-                    {
-                    for (i = 0; i < bytes_per_pixel; i++)
-                      *dst++ = *(src + i);
-		    src += rowsize;
-                    }
-		  }
-		}
+                rotateBytePixels(rotation, bytes_per_pixel, width, length,
+                                 ibuff, rowsize, rbuff, colsize);
               else
                 { /* non 8 bit per sample data */ 
                 for (col = 0; col < width; col++)
@@ -38,6 +38,7 @@
 
 #include "tiffio.h"
 #include "tiffiop.h"
+#include "toolthreads.h"
 
 #define	streq(a,b)	(strcmp(a,b) == 0)
 #define	strneq(a,b,n)	(strncmp(a,b,n) == 0)
@@ -51,35 +52,165 @@ int	threshold = 128;
 
 static	void usage(void);
 
+/*
+ * Rows are dithered in bands of DITHER_BAND rows, read and written by
+ * the main thread.  Within a band the rows are dithered by up to
+ * nthreads threads at the same time, each row DITHER_CHUNK pixels at
+ * a time behind the one above it.
+ */
+#define	DITHER_BAND	256
+#define	DITHER_CHUNK	256
+
+int	nthreads = 0;
+
 /* 
  * Floyd-Steinberg error propragation with threshold.
  * This code is stolen from tiffmedian.
+ *
+ * Dither pixels j0 to j1-1 of a row, spreading the errors to the
+ * following pixels of the row and to nextline (unless it is NULL, for
+ * the last row).  As pixel j adds to pixels j-1 to j+1 and takes from
+ * pixels j-1 to j+1 of the row above, pixel j of a row can be done
+ * once the pixels of the row above up to j+2 are; the sums are then
+ * the same as if the rows were done one after the other.
  */
+static void
+ditherrow(short* thisline, short* nextline, unsigned char* outline,
+    uint32 j0, uint32 j1)
+{
+	register unsigned char	*outptr = outline + (j0 >> 3);
+	register short *thisptr = thisline + j0;
+	register short *nextptr = nextline ? nextline + j0 : NULL;
+	register uint32 j;
+	uint32 jmax = imagewidth - 1;
+	int lastline = (nextline == NULL);
+	int lastpixel;
+	int bit = 0x80 >> (j0 & 7);
+
+	for (j = j0; j < j1; ++j) {
+		register int v;
+
+		lastpixel = (j == jmax);
+		v = *thisptr++;
+		if (v < 0)
+			v = 0;
+		else if (v > 255)
+			v = 255;
+		if (v > threshold) {
+			*outptr |= bit;
+			v -= 255;
+		}
+		bit >>= 1;
+		if (bit == 0) {
+			outptr++;
+			bit = 0x80;
+		}
+		if (!lastpixel)
+			thisptr[0] += v * 7 / 16;
+		if (!lastline) {
+			if (j != 0)
+				nextptr[-1] += v * 3 / 16;
+			*nextptr++ += v * 5 / 16;
+			if (!lastpixel)
+				nextptr[0] += v / 16;
+		}
+	}
+}
+
+typedef struct {
+	short**	errors;		/* rows of the band, and the next one */
+	unsigned char** outlines;
+	uint32	nrows;		/* rows to dither */
+	int	lastband;	/* errors of the last row are dropped */
+	uint32	nextrow;	/* next row for a thread to take */
+	uint32*	done;		/* pixels dithered in each row */
+	ToolMutex* mutex;
+	ToolCond* cond;
+} DitherBand;
+
+static void
+ditherband(void* arg)
+{
+	DitherBand* band = (DitherBand*) arg;
+	uint32 row, j, j1, above;
+
+	for (;;) {
+		toolMutexLock(band->mutex);
+		row = band->nextrow++;
+		toolMutexUnlock(band->mutex);
+		if (row >= band->nrows)
+			break;
+		for (j = 0; j < imagewidth; j = j1) {
+			above = imagewidth;
+			if (row > 0) {
+				toolMutexLock(band->mutex);
+				while ((above = band->done[row-1]) < imagewidth &&
+				    above < j + 3)
+					toolCondWait(band->cond, band->mutex);
+				toolMutexUnlock(band->mutex);
+				if (above < imagewidth)
+					above -= 2;
+			}
+			j1 = above - j > DITHER_CHUNK ? j + DITHER_CHUNK : above;
+			ditherrow(band->errors[row],
+			    band->lastband && row == band->nrows - 1 ?
+			    NULL : band->errors[row+1],
+			    band->outlines[row], j, j1);
+			toolMutexLock(band->mutex);
+			band->done[row] = j1;
+			toolCondBroadcast(band->cond);
+			toolMutexUnlock(band->mutex);
+		}
+	}
+}
+
 static int
 fsdither(TIFF* in, TIFF* out)
 {
-	unsigned char *outline, *inputline, *inptr;
-	short *thisline, *nextline, *tmpptr;
-	register unsigned char	*outptr;
-	register short *thisptr, *nextptr;
+	unsigned char *inputline = NULL, *inptr;
+	short *tmpptr;
+	register short *nextptr;
 	register uint32 i, j;
-	uint32 imax, jmax;
-	int lastline, lastpixel;
-	int bit;
+	uint32 imax, first, nrows = DITHER_BAND;
 	tsize_t outlinesize;
+	DitherBand band;
+	void* args[64];
+	int n;
 	int errcode = 0;
 
+	_TIFFmemset(&band, 0, sizeof (band));
+	if (nthreads <= 0)
+		nthreads = toolGetNumCPUs();
+	if (nthreads > 64)
+		nthreads = 64;
+	for (n = 0; n < nthreads; n++)
+		args[n] = &band;
 	imax = imagelength - 1;
-	jmax = imagewidth - 1;
-	inputline = (unsigned char *)_TIFFmalloc(TIFFScanlineSize(in));
-	thisline = (short *)_TIFFmalloc(TIFFSafeMultiply(tmsize_t, imagewidth, sizeof (short)));
-	nextline = (short *)_TIFFmalloc(TIFFSafeMultiply(tmsize_t, imagewidth, sizeof (short)));
+	if (nrows > imax)
+		nrows = imax;
 	outlinesize = TIFFScanlineSize(out);
-	outline = (unsigned char *) _TIFFmalloc(outlinesize);
-	if (! (inputline && thisline && nextline && outline)) {
+	inputline = (unsigned char *)_TIFFmalloc(TIFFScanlineSize(in));
+	band.errors = (short **)_TIFFmalloc((nrows + 1) * sizeof (short *));
+	band.outlines = (unsigned char **)_TIFFmalloc(
+	    (nrows + 1) * sizeof (unsigned char *));
+	band.done = (uint32 *)_TIFFmalloc((nrows + 1) * sizeof (uint32));
+	band.mutex = toolMutexCreate();
+	band.cond = toolCondCreate();
+	if (! (inputline && band.errors && band.outlines && band.done &&
+	    band.mutex && band.cond)) {
 	    fprintf(stderr, "Out of memory.\n");
 	    goto skip_on_error;
 	}
+	_TIFFmemset(band.errors, 0, (nrows + 1) * sizeof (short *));
+	_TIFFmemset(band.outlines, 0, (nrows + 1) * sizeof (unsigned char *));
+	for (i = 0; i <= nrows; i++) {
+		band.errors[i] = (short *)_TIFFmalloc(TIFFSafeMultiply(tmsize_t, imagewidth, sizeof (short)));
+		band.outlines[i] = (unsigned char *) _TIFFmalloc(outlinesize);
+		if (! (band.errors[i] && band.outlines[i])) {
+		    fprintf(stderr, "Out of memory.\n");
+		    goto skip_on_error;
+		}
+	}
 
 	/*
 	 * Get first line
@@ -88,54 +219,34 @@ fsdither(TIFF* in, TIFF* out)
             goto skip_on_error;
 
 	inptr = inputline;
-	nextptr = nextline;
+	nextptr = band.errors[0];
 	for (j = 0; j < imagewidth; ++j)
 		*nextptr++ = *inptr++;
-	for (i = 1; i < imagelength; ++i) {
-		tmpptr = thisline;
-		thisline = nextline;
-		nextline = tmpptr;
-		lastline = (i == imax);
-		if (TIFFReadScanline(in, inputline, i, 0) <= 0)
-			goto skip_on_error;
-		inptr = inputline;
-		nextptr = nextline;
-		for (j = 0; j < imagewidth; ++j)
-			*nextptr++ = *inptr++;
-		thisptr = thisline;
-		nextptr = nextline;
-		_TIFFmemset(outptr = outline, 0, outlinesize);
-		bit = 0x80;
-		for (j = 0; j < imagewidth; ++j) {
-			register int v;
-
-			lastpixel = (j == jmax);
-			v = *thisptr++;
-			if (v < 0)
-				v = 0;
-			else if (v > 255)
-				v = 255;
-			if (v > threshold) {
-				*outptr |= bit;
-				v -= 255;
-			}
-			bit >>= 1;
-			if (bit == 0) {
-				outptr++;
-				bit = 0x80;
-			}
-			if (!lastpixel)
-				thisptr[0] += v * 7 / 16;
-			if (!lastline) {
-				if (j != 0)
-					nextptr[-1] += v * 3 / 16;
-				*nextptr++ += v * 5 / 16;
-				if (!lastpixel)
-					nextptr[0] += v / 16;
-			}
+	for (first = 0; first < imax; first += band.nrows) {
+		band.nrows = imax - first < nrows ? imax - first : nrows;
+		band.lastband = (first + band.nrows == imax);
+		band.nextrow = 0;
+		for (i = 1; i <= band.nrows; i++) {
+			if (TIFFReadScanline(in, inputline, first+i, 0) <= 0)
+				goto skip_on_error;
+			inptr = inputline;
+			nextptr = band.errors[i];
+			for (j = 0; j < imagewidth; ++j)
+				*nextptr++ = *inptr++;
 		}
-		if (TIFFWriteScanline(out, outline, i-1, 0) < 0)
-			goto skip_on_error;
+		for (i = 0; i < band.nrows; i++) {
+			_TIFFmemset(band.outlines[i], 0, outlinesize);
+			band.done[i] = 0;
+		}
+		toolRunThreads(nthreads, ditherband, args);
+		for (i = 0; i < band.nrows; i++)
+			if (TIFFWriteScanline(out, band.outlines[i],
+			    first+i, 0) < 0)
+				goto skip_on_error;
+		/* the row after the band starts the next one */
+		tmpptr = band.errors[0];
+		band.errors[0] = band.errors[band.nrows];
+		band.errors[band.nrows] = tmpptr;
 	}
 	goto exit_label;
 
@@ -143,9 +254,19 @@ fsdither(TIFF* in, TIFF* out)
 	errcode = 1;
   exit_label:
 	_TIFFfree(inputline);
-	_TIFFfree(thisline);
-	_TIFFfree(nextline);
-	_TIFFfree(outline);
+	if (band.errors) {
+		for (i = 0; i <= nrows; i++)
+			_TIFFfree(band.errors[i]);
+		_TIFFfree(band.errors);
+	}
+	if (band.outlines) {
+		for (i = 0; i <= nrows; i++)
+			_TIFFfree(band.outlines[i]);
+		_TIFFfree(band.outlines);
+	}
+	_TIFFfree(band.done);
+	toolCondDestroy(band.cond);
+	toolMutexDestroy(band.mutex);
 	return errcode;
 }
 
@@ -213,7 +334,7 @@ main(int argc, char* argv[])
 	extern char *optarg;
 #endif
 
-	while ((c = getopt(argc, argv, "c:f:r:t:")) != -1)
+	while ((c = getopt(argc, argv, "c:f:j:r:t:")) != -1)
 		switch (c) {
 		case 'c':		/* compression scheme */
 			if (!processCompressOptions(optarg))
@@ -227,6 +348,9 @@ main(int argc, char* argv[])
 			else
 				usage();
 			break;
+		case 'j':		/* threads */
+			nthreads = atoi(optarg);
+			break;
 		case 'r':		/* rows/strip */
 			rowsperstrip = atoi(optarg);
 			break;
@@ -301,6 +425,7 @@ char* stuff[] = {
 "where options are:",
 " -r #		make each strip have no more than # rows",
 " -t #		set the threshold value for dithering (default 128)",
+" -j #		dither on # threads (default one per processor)",
 " -f lsb2msb	force lsb-to-msb FillOrder for output",
 " -f msb2lsb	force msb-to-lsb FillOrder for output",
 " -c lzw[:opts]	compress output with Lempel-Ziv & Welch encoding",
@@ -46,6 +46,11 @@
 # include <io.h>
 #endif
 
+#ifdef HAVE_MMAP
+# include <sys/stat.h>
+# include <sys/mman.h>
+#endif
+
 #ifdef NEED_LIBPORT
 # include "libport.h"
 #endif
@@ -95,6 +100,10 @@ const char* floatfmt = "%s%g";		/* FLOAT */
 const char* doublefmt = "%s%g";		/* DOUBLE */
 
 static void dump(int, uint64);
+static int FileMap(int);
+static void FileUnmap(void);
+static int FileSeek(int, uint64);
+static tmsize_t FileRead(int, void*, tmsize_t);
 
 #if !HAVE_DECL_OPTARG
 extern int optind;
@@ -149,12 +158,85 @@ main(int argc, char* argv[])
 		curfile = argv[optind];
 		swabflag = 0;
 		bigtiff = 0;
+		FileMap(fd);
 		dump(fd, diroff);
+		FileUnmap();
 		close(fd);
 	}
 	return (0);
 }
 
+/*
+ * Where the system has mmap() the file is mapped and directories and
+ * out-of-line tag values are copied straight from the mapping; files
+ * with many directories then cost no system call per IFD.  Otherwise,
+ * or if the mapping fails, the file is read with lseek() and read().
+ */
+static const unsigned char* filemap = NULL;
+static uint64 filemapsize = 0;
+static uint64 filepos = 0;
+
+static int
+FileMap(int fd)
+{
+#ifdef HAVE_MMAP
+	_TIFF_stat_s sb;
+	void* base;
+
+	filemap = NULL;
+	filepos = 0;
+	if (_TIFF_fstat_f(fd, &sb) < 0 || sb.st_size <= 0 ||
+	    (uint64) sb.st_size != (uint64) (size_t) sb.st_size)
+		return (0);
+	base = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+		return (0);
+	filemap = (const unsigned char*) base;
+	filemapsize = (uint64) sb.st_size;
+	return (1);
+#else
+	(void) fd;
+	return (0);
+#endif
+}
+
+static void
+FileUnmap(void)
+{
+#ifdef HAVE_MMAP
+	if (filemap)
+		munmap((void*) filemap, (size_t) filemapsize);
+#endif
+	filemap = NULL;
+	filemapsize = 0;
+}
+
+static int
+FileSeek(int fd, uint64 off)
+{
+	if (filemap) {
+		filepos = off;
+		return (1);
+	}
+	return (_TIFF_lseek_f(fd, (_TIFF_off_t) off, SEEK_SET) ==
+	    (_TIFF_off_t) off);
+}
+
+static tmsize_t
+FileRead(int fd, void* buf, tmsize_t size)
+{
+	if (filemap) {
+		if (size < 0 || filepos >= filemapsize)
+			return (0);
+		if ((uint64) size > filemapsize - filepos)
+			size = (tmsize_t) (filemapsize - filepos);
+		_TIFFmemcpy(buf, filemap + filepos, size);
+		filepos += (uint64) size;
+		return (size);
+	}
+	return ((tmsize_t) read(fd, buf, (size_t) size));
+}
+
 #define ord(e) ((int)e)
 
 static uint64 ReadDirectory(int, unsigned, uint64);
@@ -169,8 +251,8 @@ dump(int fd, uint64 diroff)
 	uint64* visited_diroff = NULL;
 	unsigned int count_visited_dir = 0;
 
-	_TIFF_lseek_f(fd, (_TIFF_off_t) 0, 0);
-	if (read(fd, (char*) &hdr, sizeof (TIFFHeaderCommon)) != sizeof (TIFFHeaderCommon))
+	FileSeek(fd, 0);
+	if (FileRead(fd, (char*) &hdr, sizeof (TIFFHeaderCommon)) != sizeof (TIFFHeaderCommon))
 		ReadError("TIFF header");
 	if (hdr.common.tiff_magic != TIFF_BIGENDIAN
 	    && hdr.common.tiff_magic != TIFF_LITTLEENDIAN &&
@@ -193,7 +275,7 @@ dump(int fd, uint64 diroff)
 		TIFFSwabShort(&hdr.common.tiff_version);
 	if (hdr.common.tiff_version==42)
 	{
-		if (read(fd, (char*) &hdr.classic.tiff_diroff, 4) != 4)
+		if (FileRead(fd, (char*) &hdr.classic.tiff_diroff, 4) != 4)
 			ReadError("TIFF header");
 		if (swabflag)
 			TIFFSwabLong(&hdr.classic.tiff_diroff);
@@ -206,7 +288,7 @@ dump(int fd, uint64 diroff)
 	}
 	else if (hdr.common.tiff_version==43)
 	{
-		if (read(fd, (char*) &hdr.big.tiff_offsetsize, 12) != 12)
+		if (FileRead(fd, (char*) &hdr.big.tiff_offsetsize, 12) != 12)
 			ReadError("TIFF header");
 		if (swabflag)
 		{
@@ -307,12 +389,12 @@ ReadDirectory(int fd, unsigned int ix, uint64 off)
 
 	if (off == 0)			/* no more directories */
 		goto done;
-	if (_TIFF_lseek_f(fd, (_TIFF_off_t)off, SEEK_SET) != (_TIFF_off_t)off) {
+	if (!FileSeek(fd, off)) {
 		Fatal("Seek error accessing TIFF directory");
 		goto done;
 	}
 	if (!bigtiff) {
-		if (read(fd, (char*) &dircount, sizeof (uint16)) != sizeof (uint16)) {
+		if (FileRead(fd, (char*) &dircount, sizeof (uint16)) != sizeof (uint16)) {
 			ReadError("directory count");
 			goto done;
 		}
@@ -321,7 +403,7 @@ ReadDirectory(int fd, unsigned int ix, uint64 off)
 		direntrysize = 12;
 	} else {
 		uint64 dircount64 = 0;
-		if (read(fd, (char*) &dircount64, sizeof (uint64)) != sizeof (uint64)) {
+		if (FileRead(fd, (char*) &dircount64, sizeof (uint64)) != sizeof (uint64)) {
 			ReadError("directory count");
 			goto done;
 		}
@@ -339,7 +421,7 @@ ReadDirectory(int fd, unsigned int ix, uint64 off)
 		Fatal("No space for TIFF directory");
 		goto done;
 	}
-	n = read(fd, (char*) dirmem, dircount*direntrysize);
+	n = (uint32) FileRead(fd, (char*) dirmem, dircount*direntrysize);
 	if (n != dircount*direntrysize) {
 		n /= direntrysize;
 		Error(
@@ -355,13 +437,13 @@ ReadDirectory(int fd, unsigned int ix, uint64 off)
 	} else {
 		if (!bigtiff) {
 			uint32 nextdiroff32;
-			if (read(fd, (char*) &nextdiroff32, sizeof (uint32)) != sizeof (uint32))
+			if (FileRead(fd, (char*) &nextdiroff32, sizeof (uint32)) != sizeof (uint32))
 				nextdiroff32 = 0;
 			if (swabflag)
 				TIFFSwabLong(&nextdiroff32);
 			nextdiroff = nextdiroff32;
 		} else {
-			if (read(fd, (char*) &nextdiroff, sizeof (uint64)) != sizeof (uint64))
+			if (FileRead(fd, (char*) &nextdiroff, sizeof (uint64)) != sizeof (uint64))
 				nextdiroff = 0;
 			if (swabflag)
 				TIFFSwabLong8(&nextdiroff);
@@ -473,15 +555,15 @@ ReadDirectory(int fd, unsigned int ix, uint64 off)
 		{
 			datamem = _TIFFmalloc(datasize);
 			if (datamem) {
-				if (_TIFF_lseek_f(fd, (_TIFF_off_t)dataoffset, 0) !=
-				    (_TIFF_off_t)dataoffset)
+				if (!FileSeek(fd, dataoffset))
 				{
 					Error(
 				"Seek error accessing tag %u value", tag);
 					_TIFFfree(datamem);
 					datamem = NULL;
 				}
-				else if (read(fd, datamem, (size_t)datasize) != (TIFF_SSIZE_T)datasize)
+				else if (FileRead(fd, datamem, (tmsize_t)datasize) !=
+				    (tmsize_t)datasize)
 				{
 					Error(
 				"Read error accessing tag %u value", tag);
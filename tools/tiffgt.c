@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -54,7 +55,18 @@ extern int getopt(int, char**, char*);
 
 static  uint32  width = 0, height = 0;          /* window width & height */
 static  uint32* raster = NULL;                  /* displayable image */
-static TIFFRGBAImage img;
+static  uint32  rwidth, rheight;                /* raster width & height */
+static  GLfloat rzoomx, rzoomy;                 /* window pixels per raster pixel */
+static  GLfloat rposx, rposy;                   /* raster position */
+static  uint32  imgwidth, imglength;            /* full resolution image */
+static  int     nlevels;                        /* overview levels, 0 is the image */
+static  int     refinelevel = -1;               /* level still to show */
+static  int     zoomsteps;                      /* zoom is fit * 2^zoomsteps */
+static  double  zoom;                           /* window pixels per image pixel */
+static  double  centerx, centery;               /* view center, image pixels */
+static  TIFFChunkCache* cache = NULL;           /* decoded strips and tiles */
+#define CACHE_SIZE      (256 * 1024 * 1024)
+#define MAX_ZOOM        16.0
 static int      order0 = 0, order;
 static uint16   photo0 = (uint16) -1, photo;
 static int      stoponerr = 0;                  /* stop on read error */
@@ -73,12 +85,16 @@ static int	initImage(void);
 static int	prevImage(void);
 static int	nextImage(void);
 static void	setWindowSize(void);
+static void	showView(void);
+static void	setTitle(void);
+static void	flushCache(void);
 static void	usage(void);
 static uint16	photoArg(const char*);
 static void	raster_draw(void);
 static void	raster_reshape(int, int);
 static void	raster_keys(unsigned char, int, int);
 static void	raster_special(int, int, int);
+static void	raster_refine(void);
 
 #if !HAVE_DECL_OPTARG
 extern  char* optarg;
@@ -154,6 +170,12 @@ main(int argc, char* argv[])
         xmax = xmax - xmax / 10.0;
         ymax = ymax - ymax / 10.0;
 
+        /*
+         * Keep the strips and tiles decoded for a view, so panning and
+         * zooming decode only the ones that come into it
+         */
+        cache = TIFFChunkCacheCreate(CACHE_SIZE);
+
         filelist = (char **) _TIFFmalloc(filenum * sizeof(char*));
         if (!filelist) {
                 TIFFError(argv[0], "Can not allocate space for the file list.");
@@ -191,6 +213,8 @@ main(int argc, char* argv[])
         glutReshapeFunc(raster_reshape);
         glutKeyboardFunc(raster_keys);
         glutSpecialFunc(raster_special);
+        if (refinelevel >= 0)
+                glutIdleFunc(raster_refine);
         glutMainLoop();
 
         cleanup_and_exit();
@@ -200,13 +224,14 @@ main(int argc, char* argv[])
 static void 
 cleanup_and_exit(void)
 {
-        TIFFRGBAImageEnd(&img);
         if (filelist != NULL)
                 _TIFFfree(filelist);
         if (raster != NULL)
                 _TIFFfree(raster);
         if (tif != NULL)
                 TIFFClose(tif);
+        if (cache != NULL)
+                TIFFChunkCacheFree(cache);
         exit(0);
 }
 
@@ -214,23 +239,28 @@ static int
 initImage(void)
 {
         uint32 w, h;
+        int n;
 
         if (order)
                 TIFFSetField(tif, TIFFTAG_FILLORDER, order);
         if (photo != (uint16) -1)
                 TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, photo);
-        if (!TIFFRGBAImageBegin(&img, tif, stoponerr, title)) {
+        if (!TIFFRGBAImageOK(tif, title)) {
                 TIFFError(filelist[fileindex], "%s", title);
                 TIFFClose(tif);
                 tif = NULL;
                 return -1;
         }
+        TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &imgwidth);
+        TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &imglength);
+        n = TIFFGetOverviewCount(tif);
+        nlevels = n > 0 ? n + 1 : 1;
 
         /*
-         * Setup the image raster as required.
+         * Size the window to fit the image.
          */
-        h = img.height;
-        w = img.width;
+        h = imglength;
+        w = imgwidth;
         if (h > ymax) {
                 w = (int)(w * ((float)ymax / h));
                 h = ymax;
@@ -239,27 +269,178 @@ initImage(void)
                 h = (int)(h * ((float)xmax / w));
                 w = xmax;
         }
+        width = w > 0 ? w : 1;
+        height = h > 0 ? h : 1;
+
+        zoomsteps = 0;
+        centerx = imgwidth / 2.0;
+        centery = imglength / 2.0;
+        showView();
+        if (glutGetWindow())
+                setWindowSize();
+        return 0;
+}
+
+/*
+ * Decode the part of overview level lvl that the view shows into the
+ * raster.  The whole of a level much larger than the window, as when
+ * the image has no overviews, is reduced while it is decoded so that
+ * only the window's worth of it is held in memory.
+ */
+static int
+decodeView(int lvl)
+{
+        TIFFRGBAImage img;
+        uint32 lw, ll, x0 = 0, y0 = 0, rw, rh, *r;
+        double sx, sy, vw = width / zoom, vh = height / zoom;
+        int scaled, ok;
+
+        if (nlevels > 1 && !TIFFOpenOverview(tif, lvl))
+                return -1;
+        if (order)
+                TIFFSetField(tif, TIFFTAG_FILLORDER, order);
+        if (photo != (uint16) -1)
+                TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, photo);
+        TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &lw);
+        TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &ll);
+        sx = (double) lw / imgwidth;
+        sy = (double) ll / imglength;
+        rw = lw;
+        rh = ll;
+        if (vw < imgwidth) {
+                x0 = (uint32) ((centerx - vw / 2) * sx);
+                rw = (uint32) ceil(vw * sx) + 1;
+                if (x0 >= lw)
+                        x0 = lw - 1;
+                if (rw > lw - x0)
+                        rw = lw - x0;
+        }
+        if (vh < imglength) {
+                y0 = (uint32) ((centery - vh / 2) * sy);
+                rh = (uint32) ceil(vh * sy) + 1;
+                if (y0 >= ll)
+                        y0 = ll - 1;
+                if (rh > ll - y0)
+                        rh = ll - y0;
+        }
+        rzoomx = (GLfloat) (zoom / sx);
+        rzoomy = (GLfloat) (zoom / sy);
+        scaled = rw == lw && rh == ll && (rzoomx < 0.5 || rzoomy < 0.5);
+        if (scaled) {
+                rw = (uint32) ceil(imgwidth * zoom);
+                rh = (uint32) ceil(imglength * zoom);
+                rzoomx = rzoomy = 1;
+        }
 
-	if (w != width || h != height) {
-		uint32 rastersize =
-			_TIFFMultiply32(tif, img.width, img.height, "allocating raster buffer");
-		if (raster != NULL)
-			_TIFFfree(raster), raster = NULL;
-		raster = (uint32*) _TIFFCheckMalloc(tif, rastersize, sizeof (uint32),
-						    "allocating raster buffer");
-		if (raster == NULL) {
-			width = height = 0;
-			TIFFError(filelist[fileindex], "No space for raster buffer");
-			cleanup_and_exit();
-		}
-		width = w;
-		height = h;
-	}
-	TIFFRGBAImageGet(&img, raster, img.width, img.height);
+        r = (uint32*) _TIFFCheckMalloc(tif, (tmsize_t) rw * rh,
+            sizeof (uint32), "allocating raster buffer");
+        if (r == NULL) {
+                TIFFError(filelist[fileindex], "No space for raster buffer");
+                ok = 0;
+        } else if (scaled) {
+                ok = TIFFReadRGBAImageScaled(tif, rw, rh, r, stoponerr);
+        } else if (TIFFRGBAImageBegin(&img, tif, stoponerr, title)) {
+                img.col_offset = x0;
+                img.row_offset = y0;
+                ok = TIFFRGBAImageGetParallel(&img, r, rw, rh, 0);
+                TIFFRGBAImageEnd(&img);
+        } else {
+                TIFFError(filelist[fileindex], "%s", title);
+                ok = 0;
+        }
+        if (nlevels > 1)
+                TIFFOpenOverview(tif, 0);
+        if (r == NULL)
+                return -1;
+        if (!ok && stoponerr) {
+                _TIFFfree(r);
+                return -1;
+        }
 #if HOST_BIGENDIAN
-	TIFFSwabArrayOfLong(raster,img.width*img.height);
+        TIFFSwabArrayOfLong(r, rw * rh);
 #endif
-	return 0;
+        if (raster != NULL)
+                _TIFFfree(raster);
+        raster = r;
+        rwidth = rw;
+        rheight = rh;
+
+        /*
+         * Center an image smaller than the window.
+         */
+        rposx = rposy = -1;
+        if (vw >= imgwidth)
+                rposx += (GLfloat) (width - rw * rzoomx) / width;
+        if (vh >= imglength)
+                rposy += (GLfloat) (height - rh * rzoomy) / height;
+        return 0;
+}
+
+/*
+ * Show the view at the current zoom and center: first from the
+ * coarsest overview, which is quick to decode, then from the idle
+ * callback from the smallest overview with at least a pixel per window
+ * pixel, decoding only the strips or tiles in view.
+ */
+static void
+showView(void)
+{
+        double fit = (double) width / imgwidth;
+        double vw, vh;
+        int target = 0, coarse = nlevels - 1;
+
+        if ((double) height / imglength < fit)
+                fit = (double) height / imglength;
+        zoom = ldexp(fit, zoomsteps);
+        vw = width / zoom;
+        vh = height / zoom;
+        if (vw >= imgwidth)
+                centerx = imgwidth / 2.0;
+        else if (centerx < vw / 2)
+                centerx = vw / 2;
+        else if (centerx > imgwidth - vw / 2)
+                centerx = imgwidth - vw / 2;
+        if (vh >= imglength)
+                centery = imglength / 2.0;
+        else if (centery < vh / 2)
+                centery = vh / 2;
+        else if (centery > imglength - vh / 2)
+                centery = imglength - vh / 2;
+
+        if (nlevels > 1) {
+                target = TIFFGetOverviewForScale(tif, zoom < 1 ? zoom : 1);
+                if (target < 0)
+                        target = 0;
+        }
+        refinelevel = -1;
+        if (coarse > target && decodeView(coarse) == 0)
+                refinelevel = target;
+        else
+                decodeView(target);
+        if (glutGetWindow()) {
+                glutIdleFunc(refinelevel >= 0 ? raster_refine : NULL);
+                setTitle();
+        }
+}
+
+static void
+setTitle(void)
+{
+        snprintf(title, TITLE_LENGTH, "%s [%u] %d%%", filelist[fileindex],
+                (unsigned int) TIFFCurrentDirectory(tif), (int) (zoom * 100));
+        glutSetWindowTitle(title);
+}
+
+/*
+ * Drop the decoded strips and tiles, as they change with FillOrder.
+ */
+static void
+flushCache(void)
+{
+        if (cache != NULL) {
+                TIFFSetChunkCache(tif, NULL);
+                TIFFSetChunkCache(tif, cache);
+        }
 }
 
 static int
@@ -274,6 +455,8 @@ prevImage(void)
         tif = TIFFOpen(filelist[fileindex], "r");
         if (tif == NULL)
                 return -1;
+        if (cache != NULL)
+                TIFFSetChunkCache(tif, cache);
         return fileindex;
 }
 
@@ -289,6 +472,8 @@ nextImage(void)
         tif = TIFFOpen(filelist[fileindex], "r");
         if (tif == NULL)
                 return -1;
+        if (cache != NULL)
+                TIFFSetChunkCache(tif, cache);
         return fileindex;
 }
 
@@ -301,22 +486,36 @@ setWindowSize(void)
 static void
 raster_draw(void)
 {
-  glDrawPixels(img.width, img.height, GL_RGBA, GL_UNSIGNED_BYTE, (const GLvoid *) raster);
-  glFlush();
+        glClear(GL_COLOR_BUFFER_BIT);
+        glRasterPos2f(rposx, rposy);
+        glPixelZoom(rzoomx, rzoomy);
+        glDrawPixels(rwidth, rheight, GL_RGBA, GL_UNSIGNED_BYTE,
+            (const GLvoid *) raster);
+        glFlush();
 }
 
 static void
 raster_reshape(int win_w, int win_h)
 {
-        GLfloat xratio = (GLfloat)win_w/img.width;
-        GLfloat yratio = (GLfloat)win_h/img.height;
-        int     ratio = (int)(((xratio > yratio)?xratio:yratio) * 100);
-
-        glPixelZoom(xratio, yratio);
         glViewport(0, 0, win_w, win_h);
-        snprintf(title, 1024, "%s [%u] %d%%", filelist[fileindex],
-                (unsigned int) TIFFCurrentDirectory(tif), ratio);
-        glutSetWindowTitle(title);
+        if ((uint32) win_w == width && (uint32) win_h == height) {
+                setTitle();             /* the view is shown already */
+                return;
+        }
+        width = win_w > 0 ? win_w : 1;
+        height = win_h > 0 ? win_h : 1;
+        showView();
+}
+
+static void
+raster_refine(void)
+{
+        glutIdleFunc(NULL);
+        if (refinelevel >= 0) {
+                decodeView(refinelevel);
+                refinelevel = -1;
+                glutPostRedisplay();
+        }
 }
 
 static void
@@ -331,10 +530,12 @@ raster_keys(unsigned char key, int x, int y)
                     break;
                 case 'l':                       /* lsb-to-msb FillOrder */
                     order = FILLORDER_LSB2MSB;
+                    flushCache();
                     initImage();
                     break;
                 case 'm':                       /* msb-to-lsb FillOrder */
                     order = FILLORDER_MSB2LSB;
+                    flushCache();
                     initImage();
                     break;
                 case 'w':                       /* photometric MinIsWhite */
@@ -357,8 +558,22 @@ raster_keys(unsigned char key, int x, int y)
                         owarning = TIFFSetWarningHandler(NULL);
                     if (oerror == NULL)
                         oerror = TIFFSetErrorHandler(NULL);
+                    flushCache();
                     initImage();
                     break;
+                case '+':                       /* zoom in */
+                case '=':
+                    if (zoom * 2 <= MAX_ZOOM) {
+                        zoomsteps++;
+                        showView();
+                    }
+                    break;
+                case '-':                       /* zoom out */
+                    if (zoomsteps > 0) {
+                        zoomsteps--;
+                        showView();
+                    }
+                    break;
                 case 'q':                       /* exit */
                 case '\033':
                     cleanup_and_exit();
@@ -372,6 +587,22 @@ raster_special(int key, int x, int y)
         (void) x;
         (void) y;
         switch (key) {
+                case GLUT_KEY_LEFT:             /* pan by half a window */
+                    centerx -= width / zoom / 2;
+                    showView();
+                break;
+                case GLUT_KEY_RIGHT:
+                    centerx += width / zoom / 2;
+                    showView();
+                break;
+                case GLUT_KEY_UP:
+                    centery -= height / zoom / 2;
+                    showView();
+                break;
+                case GLUT_KEY_DOWN:
+                    centery += height / zoom / 2;
+                    showView();
+                break;
                 case GLUT_KEY_PAGE_UP:          /* previous logical image */
                     if (TIFFCurrentDirectory(tif) > 0) {
                             if (TIFFSetDirectory(tif,
@@ -380,7 +611,6 @@ raster_special(int key, int x, int y)
                                     setWindowSize();
                         }
                     } else {
-                            TIFFRGBAImageEnd(&img);
                             prevImage();
                             initImage();
                             setWindowSize();
@@ -393,7 +623,6 @@ raster_special(int key, int x, int y)
                                     setWindowSize();
                             }
                     } else {
-                            TIFFRGBAImageEnd(&img);
                             nextImage();
                             initImage();
                             setWindowSize();
@@ -401,13 +630,11 @@ raster_special(int key, int x, int y)
                 break;
                 case GLUT_KEY_HOME:             /* 1st image in current file */
                         if (TIFFSetDirectory(tif, 0)) {
-                                TIFFRGBAImageEnd(&img);
-                                initImage();
+                                    initImage();
                                 setWindowSize();
                         }
                 break;
                 case GLUT_KEY_END:              /* last image in current file */
-                        TIFFRGBAImageEnd(&img);
                         while (!TIFFLastDirectory(tif))
                                 TIFFReadDirectory(tif);
                         initImage();
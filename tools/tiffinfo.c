@@ -36,11 +36,18 @@
 # include <unistd.h>
 #endif
 
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
 #ifdef NEED_LIBPORT
 # include "libport.h"
 #endif
 
 #include "tiffiop.h"
+#include "toolthreads.h"
 
 static TIFFErrorHandler old_error_handler = 0;
 static int status = 0;                  /* exit status */
@@ -49,6 +56,7 @@ static int rawdata = 0;			/* show raw/decoded data */
 static int showwords = 0;		/* show data as bytes/words */
 static int readdata = 0;		/* read data in file */
 static int stoponerr = 1;		/* stop on first read error */
+static int scanthreads = -1;		/* check data on # threads */
 
 static	void usage(void);
 static	void tiffinfo(TIFF*, uint16, long, int);
@@ -75,7 +83,7 @@ main(int argc, char* argv[])
 	uint64 diroff = 0;
 	int chopstrips = 0;		/* disable strip chopping */
 
-	while ((c = getopt(argc, argv, "f:o:cdDSjilmrsvwz0123456789")) != -1)
+	while ((c = getopt(argc, argv, "f:o:cdDP:Sjilmrsvwz0123456789")) != -1)
 		switch (c) {
 		case '0': case '1': case '2': case '3':
 		case '4': case '5': case '6': case '7':
@@ -102,6 +110,11 @@ main(int argc, char* argv[])
 		case 'i':
 			stoponerr = 0;
 			break;
+		case 'P':
+			scanthreads = atoi(optarg);
+			if (scanthreads < 0)
+				usage();
+			break;
 		case 'o':
 			diroff = strtoul(optarg, NULL, 0);
 			break;
@@ -167,6 +180,7 @@ char* stuff[] = {
 "where options are:",
 " -D		read data",
 " -i		ignore read errors",
+" -P #		check all data on # threads (0: one per processor)",
 " -c		display data for grey/color response curve or colormap",
 " -d		display raw/decoded image data",
 " -f lsb2msb	force lsb-to-msb FillOrder for input",
@@ -455,11 +469,256 @@ TIFFReadRawData(TIFF* tif, int bitrev)
 	}
 }
 
+/*
+ * Check that every strip or tile of the directory can be read and
+ * decoded.  The raw data is fetched a batch of up to SCAN_BATCH_CHUNKS
+ * chunks and SCAN_BATCH_BYTES bytes at a time by TIFFReadRawChunks(),
+ * which merges neighbouring chunks into large reads, and the chunks of
+ * a batch are decoded on scanthreads threads with TIFFDecodeChunk().
+ * Unlike -D, the check goes on past errors: each chunk that fails is
+ * listed, followed by a summary with the throughput.
+ */
+#define	SCAN_BATCH_CHUNKS	1024
+#define	SCAN_BATCH_BYTES	(64*1024*1024)
+#define	MAX_THREADS		64
+
+#define	SCAN_OK		0
+#define	SCAN_READ	1		/* cannot read raw data */
+#define	SCAN_DECODE	2		/* cannot decode raw data */
+
+typedef struct {
+	TIFF*		tif;
+	const uint32*	chunks;		/* batch of chunks */
+	void**		bufs;		/* their raw data */
+	const tmsize_t*	sizes;
+	char*		result;		/* SCAN_xxx for each chunk */
+	uint32		first;		/* share: first, first+step, ... */
+	uint32		step;
+	uint32		nchunks;
+	void*		buf;		/* decoded data */
+	tmsize_t	bufsize;
+	uint64		decoded;	/* bytes decoded */
+} ScanWork;
+
+static void
+ScanChunks(void* arg)
+{
+	ScanWork* w = (ScanWork*) arg;
+	uint32 i;
+
+	for (i = w->first; i < w->nchunks; i += w->step) {
+		tmsize_t cc;
+
+		if (w->result[i] != SCAN_OK)
+			continue;
+		cc = TIFFDecodeChunk(w->tif, w->chunks[i], w->bufs[i],
+		    w->sizes[i], w->buf, w->bufsize);
+		if (cc < 0)
+			w->result[i] = SCAN_DECODE;
+		else
+			w->decoded += (uint64) cc;
+	}
+}
+
+/*
+ * Return a monotonic time in seconds.
+ */
+static double
+ScanClock(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER freq, now;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return ((double) now.QuadPart / (double) freq.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return (0);
+	return ((double) ts.tv_sec + (double) ts.tv_nsec / 1e9);
+#else
+	return ((double) clock() / CLOCKS_PER_SEC);
+#endif
+}
+
+static void
+TIFFScanData(TIFF* tif)
+{
+	int tiled = TIFFIsTiled(tif);
+	const char* what = tiled ? "Tile" : "Strip";
+	uint32 nchunks = tiled ? TIFFNumberOfTiles(tif) :
+	    TIFFNumberOfStrips(tif);
+	tmsize_t chunksize = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+	uint64 filesize = (*TIFFGetSizeProc(tif))(TIFFClientdata(tif));
+	ScanWork work[MAX_THREADS];
+	void* args[MAX_THREADS];
+	uint32 chunks[SCAN_BATCH_CHUNKS];
+	void* bufs[SCAN_BATCH_CHUNKS];
+	tmsize_t sizes[SCAN_BATCH_CHUNKS];
+	char result[SCAN_BATCH_CHUNKS];
+	uint8* raw = NULL;
+	uint64 rawsize = 0, readbytes = 0, decoded = 0;
+	uint32 s, i, n, nempty = 0, nfailed = 0;
+	uint64 bytes;
+	double start, secs;
+	int nthreads = scanthreads, t;
+	uint16 compression = COMPRESSION_NONE;
+	int noreadraw;
+
+	TIFFGetField(tif, TIFFTAG_COMPRESSION, &compression);
+	noreadraw = compression == COMPRESSION_OJPEG;
+	if (nthreads <= 0)
+		nthreads = toolGetNumCPUs();
+	if (nthreads > MAX_THREADS)
+		nthreads = MAX_THREADS;
+	if (nthreads > (int) nchunks)
+		nthreads = nchunks > 0 ? (int) nchunks : 1;
+	if (chunksize <= 0) {
+		fprintf(stderr, "Cannot compute %s size\n", what);
+		status = 1;
+		return;
+	}
+	for (t = 0; t < nthreads; t++) {
+		work[t].buf = _TIFFmalloc(chunksize);
+		if (work[t].buf == NULL) {
+			fprintf(stderr,
+			    "Cannot allocate buffer to decode data\n");
+			status = 1;
+			nthreads = t;
+			goto done;
+		}
+	}
+
+	start = ScanClock();
+	for (s = 0; s < nchunks; ) {
+		/* Next batch, leaving out empty chunks and chunks past EOF */
+		n = 0;
+		bytes = 0;
+		for (; s < nchunks && n < SCAN_BATCH_CHUNKS; s++) {
+			uint64 offset = TIFFGetStrileOffset(tif, s);
+			uint64 bytecount = TIFFGetStrileByteCount(tif, s);
+
+			if (bytecount == 0) {
+				nempty++;
+				continue;
+			}
+			if (offset > filesize || bytecount > filesize - offset ||
+			    (uint64)(tmsize_t) bytecount != bytecount) {
+				printf("  %s %lu: data past end of file\n",
+				    what, (unsigned long) s);
+				nfailed++;
+				continue;
+			}
+			if (n > 0 && bytes + bytecount > SCAN_BATCH_BYTES)
+				break;
+			chunks[n] = s;
+			sizes[n] = (tmsize_t) bytecount;
+			bytes += bytecount;
+			n++;
+		}
+		if (n == 0)
+			continue;
+		if (bytes > rawsize) {
+			uint8* p = (uint8*) _TIFFrealloc(raw, (tmsize_t) bytes);
+			if (p == NULL) {
+				fprintf(stderr,
+				    "Cannot allocate buffer to read data\n");
+				status = 1;
+				break;
+			}
+			raw = p;
+			rawsize = bytes;
+		}
+		for (i = 0, bytes = 0; i < n; i++) {
+			bufs[i] = raw + bytes;
+			bytes += (uint64) sizes[i];
+			result[i] = SCAN_OK;
+		}
+
+		if (noreadraw) {
+			/* The codec reads its own data: check one at a time */
+			for (i = 0; i < n; i++) {
+				tmsize_t cc = tiled ?
+				    TIFFReadEncodedTile(tif, chunks[i],
+					work[0].buf, chunksize) :
+				    TIFFReadEncodedStrip(tif, chunks[i],
+					work[0].buf, chunksize);
+				if (cc < 0)
+					result[i] = SCAN_DECODE;
+				else
+					decoded += (uint64) cc;
+			}
+		} else {
+			if (!TIFFReadRawChunks(tif, chunks, n, bufs, sizes, -1)) {
+				/* Find out which of them cannot be read */
+				for (i = 0; i < n; i++) {
+					sizes[i] = (tmsize_t)
+					    TIFFGetStrileByteCount(tif, chunks[i]);
+					if (!TIFFReadRawChunks(tif, &chunks[i], 1,
+					    &bufs[i], &sizes[i], -1))
+						result[i] = SCAN_READ;
+				}
+			}
+			for (t = 0; t < nthreads; t++) {
+				work[t].tif = tif;
+				work[t].chunks = chunks;
+				work[t].bufs = bufs;
+				work[t].sizes = sizes;
+				work[t].result = result;
+				work[t].first = (uint32) t;
+				work[t].step = (uint32) nthreads;
+				work[t].nchunks = n;
+				work[t].bufsize = chunksize;
+				work[t].decoded = 0;
+				args[t] = &work[t];
+			}
+			toolRunThreads(nthreads, ScanChunks, args);
+			for (t = 0; t < nthreads; t++)
+				decoded += work[t].decoded;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (result[i] == SCAN_OK) {
+				readbytes += (uint64) sizes[i];
+				continue;
+			}
+			printf("  %s %lu: %s error\n", what,
+			    (unsigned long) chunks[i],
+			    result[i] == SCAN_READ ? "read" : "decode");
+			nfailed++;
+		}
+	}
+	secs = ScanClock() - start;
+
+	printf("  Data check: %lu %s, %lu empty, %lu failed\n",
+	    (unsigned long) nchunks, tiled ? "tiles" : "strips",
+	    (unsigned long) nempty, (unsigned long) nfailed);
+	printf("  %.1f MB read, %.1f MB decoded in %.3f s",
+	    (double) readbytes / 1e6, (double) decoded / 1e6, secs);
+	if (secs > 0)
+		printf(" (%.1f MB/s)", (double) readbytes / 1e6 / secs);
+	printf(" on %d thread%s\n", nthreads, nthreads == 1 ? "" : "s");
+	if (nfailed)
+		status = 1;
+
+done:
+	for (t = 0; t < nthreads; t++)
+		_TIFFfree(work[t].buf);
+	if (raw != NULL)
+		_TIFFfree(raw);
+}
+
 static void
 tiffinfo(TIFF* tif, uint16 order, long flags, int is_image)
 {
 	TIFFPrintDirectory(tif, stdout, flags);
-	if (!readdata || !is_image)
+	if (!is_image)
+		return;
+	if (scanthreads >= 0)
+		TIFFScanData(tif);
+	if (!readdata)
 		return;
 	if (rawdata) {
 		if (order) {
@@ -4,6 +4,7 @@
  * tiffmedian [-c n] [-f] input output
  *     -C n		- set colortable size.  Default is 256.
  *     -f		- use Floyd-Steinberg dithering.
+ *     -j n		- work on n threads
  *     -c lzw		- compress output with LZW 
  *     -c none		- use no compression on output
  *     -c packbits	- use packbits compression on output
@@ -53,6 +54,7 @@
 #endif
 
 #include "tiffio.h"
+#include "toolthreads.h"
 
 #define	MAX_CMAP_SIZE	256
 
@@ -97,11 +99,21 @@ uint16	samplesperpixel;
 uint32	imagewidth;
 uint32	imagelength;
 uint16	predictor = 0;
+int	nthreads = 0;
+unsigned char *band;		/* rows read at a time */
+tmsize_t scanlinesize;
+uint32	bandrows;
+int	stripbands;		/* bands are whole strips */
+uint32	bandrps;
+uint32	*bandstrips;
+void	**bandbufs;
 
 static	void get_histogram(TIFF*, Colorbox*);
 static	void splitbox(Colorbox*);
 static	void shrinkbox(Colorbox*);
 static	void map_colortable(void);
+static	void fill_colortable(void);
+static	int setup_band(TIFF*);
 static	void quant(TIFF*, TIFF*);
 static	void quant_fsdither(TIFF*, TIFF*);
 static	Colorbox* largest_box(void);
@@ -127,7 +139,7 @@ main(int argc, char* argv[])
 #endif
 
 	num_colors = MAX_CMAP_SIZE;
-	while ((c = getopt(argc, argv, "c:C:r:f")) != -1)
+	while ((c = getopt(argc, argv, "c:C:j:r:f")) != -1)
 		switch (c) {
 		case 'c':		/* compression scheme */
 			if (!processCompressOptions(optarg))
@@ -145,6 +157,9 @@ main(int argc, char* argv[])
 		case 'f':		/* dither */
 			dither = 1;
 			break;
+		case 'j':		/* threads */
+			nthreads = atoi(optarg);
+			break;
 		case 'r':		/* rows/strip */
 			rowsperstrip = atoi(optarg);
 			break;
@@ -178,6 +193,11 @@ main(int argc, char* argv[])
 		return (-5);
 	}
 
+	if (!setup_band(in)) {
+		fprintf(stderr, "No space for scanline buffer\n");
+		return (-1);
+	}
+
 	/*
 	 * STEP 1:  create empty boxes
 	 */
@@ -239,6 +259,8 @@ main(int argc, char* argv[])
 	/* 5b: create mapping from truncated pixel space to color
 	   table entries */
 	map_colortable();
+	if (dither)
+		fill_colortable();
 
 	/*
 	 * STEP 6: scan image, match input values to table entries
@@ -290,6 +312,9 @@ main(int argc, char* argv[])
 	}
 	TIFFSetField(out, TIFFTAG_COLORMAP, rm, gm, bm);
 	(void) TIFFClose(out);
+	_TIFFfree(band);
+	_TIFFfree(bandstrips);
+	_TIFFfree(bandbufs);
 	return (0);
 }
 
@@ -321,6 +346,7 @@ char* stuff[] = {
 " -r #		make each strip have no more than # rows",
 " -C #		create a colormap with # entries",
 " -f		use Floyd-Steinberg dithering",
+" -j #		work on # threads (default one per processor)",
 " -c lzw[:opts]	compress output with Lempel-Ziv & Welch encoding",
 " -c zip[:opts]	compress output with deflate encoding",
 " -c packbits	compress output with packbits encoding",
@@ -345,57 +371,197 @@ usage(void)
 	exit(-1);
 }
 
+/*
+ * The image is read in bands of whole strips of about BAND_SIZE bytes,
+ * at least one strip per thread, which are decoded on nthreads
+ * threads; images with larger strips are read a row at a time.  The
+ * rows of a band are then counted, mapped or dithered on the same
+ * threads.
+ */
+#define	BAND_SIZE	((tmsize_t) 4 * 1024 * 1024)
+#define	MAX_THREADS	64
+
+static tmsize_t
+multiply_ms(tmsize_t m1, tmsize_t m2)
+{
+	tmsize_t bytes = m1 * m2;
+
+	if (m1 && bytes / m1 != m2)
+		bytes = 0;
+	return bytes;
+}
+
+static int
+setup_band(TIFF* in)
+{
+	uint32 n;
+
+	if (nthreads <= 0)
+		nthreads = toolGetNumCPUs();
+	if (nthreads > MAX_THREADS)
+		nthreads = MAX_THREADS;
+	scanlinesize = TIFFScanlineSize(in);
+	if (scanlinesize <= 0 || imagelength == 0)
+		return (0);
+	bandrows = (uint32) (BAND_SIZE / scanlinesize);
+	if (bandrows == 0)
+		bandrows = 1;
+	stripbands = !TIFFIsTiled(in) && TIFFStripSize(in) <= BAND_SIZE;
+	if (stripbands) {
+		TIFFGetFieldDefaulted(in, TIFFTAG_ROWSPERSTRIP, &bandrps);
+		if (bandrps > imagelength)
+			bandrps = imagelength;
+		n = (bandrows + bandrps - 1) / bandrps;
+		if (n < (uint32) nthreads)
+			n = nthreads;
+		bandrows = n * bandrps;
+	}
+	if (bandrows > imagelength)
+		bandrows = imagelength;
+	band = (unsigned char *)_TIFFmalloc(
+	    multiply_ms(bandrows, scanlinesize));
+	if (stripbands) {
+		n = (bandrows + bandrps - 1) / bandrps;
+		bandstrips = (uint32 *)_TIFFmalloc(n * sizeof (uint32));
+		bandbufs = (void **)_TIFFmalloc(n * sizeof (void *));
+		if (bandstrips == NULL || bandbufs == NULL)
+			return (0);
+	}
+	return (band != NULL);
+}
+
+/*
+ * Read rows first to first+nrows-1 into band; first is a multiple of
+ * bandrows.
+ */
+static int
+read_band(TIFF* in, uint32 first, uint32 nrows)
+{
+	uint32 i, n;
+
+	if (!stripbands) {
+		for (i = 0; i < nrows; i++)
+			if (TIFFReadScanline(in, band + i * scanlinesize,
+			    first + i, 0) <= 0)
+				return (0);
+		return (1);
+	}
+	n = (nrows + bandrps - 1) / bandrps;
+	for (i = 0; i < n; i++) {
+		bandstrips[i] = first / bandrps + i;
+		bandbufs[i] = band + (tmsize_t) i * bandrps * scanlinesize;
+	}
+	return (TIFFReadEncodedStripsParallel(in, bandstrips, n, bandbufs,
+	    -1, nthreads));
+}
+
+typedef struct {
+	unsigned char* rows;	/* first row of the share */
+	uint32	nrows;
+	uint32*	counts;		/* histogram of the share of this thread */
+	unsigned char* outrows;	/* mapped rows */
+} BandWork;
+
+/*
+ * Split the rows of a band between the threads and run func on them.
+ */
 static void
-get_histogram(TIFF* in, Colorbox* box)
+run_band(void (*func)(void*), BandWork* work, uint32 nrows,
+    unsigned char* outband)
 {
+	void* args[MAX_THREADS];
+	uint32 first = 0, n;
+	int t;
+
+	for (t = 0; t < nthreads; t++) {
+		n = nrows / nthreads + ((uint32) t < nrows % nthreads);
+		work[t].rows = band + first * scanlinesize;
+		work[t].nrows = n;
+		if (outband)
+			work[t].outrows = outband + first * imagewidth;
+		args[t] = &work[t];
+		first += n;
+	}
+	toolRunThreads(nthreads, func, args);
+}
+
+static void
+count_rows(void* arg)
+{
+	BandWork* work = (BandWork*) arg;
 	register unsigned char *inptr;
-	register int red, green, blue;
+	register uint32 *counts = work->counts;
 	register uint32 j, i;
-	unsigned char *inputline;
+	register int red, green, blue;
 
-	inputline = (unsigned char *)_TIFFmalloc(TIFFScanlineSize(in));
-	if (inputline == NULL) {
-		fprintf(stderr, "No space for scanline buffer\n");
-		exit(-1);
+	for (i = 0; i < work->nrows; i++) {
+		inptr = work->rows + i * scanlinesize;
+		for (j = imagewidth; j-- > 0; inptr += samplesperpixel) {
+			red = inptr[0] >> COLOR_SHIFT;
+			green = inptr[1] >> COLOR_SHIFT;
+			blue = inptr[2] >> COLOR_SHIFT;
+			counts[(red << (2*B_DEPTH)) | (green << B_DEPTH) | blue]++;
+		}
 	}
+}
+
+static void
+get_histogram(TIFF* in, Colorbox* box)
+{
+	BandWork work[MAX_THREADS];
+	register uint32 *ptr;
+	register uint32 i;
+	uint32 first, nrows;
+	int red, green, blue, t;
+
 	box->rmin = box->gmin = box->bmin = 999;
 	box->rmax = box->gmax = box->bmax = -1;
 	box->total = imagewidth * imagelength;
 
-	{ register uint32 *ptr = &histogram[0][0][0];
-	  for (i = B_LEN*B_LEN*B_LEN; i-- > 0;)
-		*ptr++ = 0;
+	_TIFFmemset(histogram, 0, sizeof (histogram));
+	_TIFFmemset(work, 0, sizeof (work));
+	for (t = 0; t < nthreads; t++) {
+		work[t].counts = (uint32 *)_TIFFmalloc(sizeof (histogram));
+		if (work[t].counts == NULL) {
+			fprintf(stderr, "No space for histogram\n");
+			exit(-1);
+		}
+		_TIFFmemset(work[t].counts, 0, sizeof (histogram));
 	}
-	for (i = 0; i < imagelength; i++) {
-		if (TIFFReadScanline(in, inputline, i, 0) <= 0)
+	for (first = 0; first < imagelength; first += nrows) {
+		nrows = imagelength - first < bandrows ?
+		    imagelength - first : bandrows;
+		if (!read_band(in, first, nrows))
 			break;
-		inptr = inputline;
-		for (j = imagewidth; j-- > 0;) {
-			red = (*inptr++) & 0xff >> COLOR_SHIFT;
-			green = (*inptr++) & 0xff >> COLOR_SHIFT;
-			blue = (*inptr++) & 0xff >> COLOR_SHIFT;
-                        if ((red | green | blue) >= B_LEN) {
-                                fprintf(stderr,
-                                        "Logic error. "
-                                        "Histogram array overflow!\n");
-                                exit(-6);
-                        }
-			if (red < box->rmin)
-				box->rmin = red;
-		        if (red > box->rmax)
-				box->rmax = red;
-		        if (green < box->gmin)
-				box->gmin = green;
-		        if (green > box->gmax)
-				box->gmax = green;
-		        if (blue < box->bmin)
-				box->bmin = blue;
-		        if (blue > box->bmax)
-				box->bmax = blue;
-		        histogram[red][green][blue]++;
-		}
+		run_band(count_rows, work, nrows, NULL);
 	}
-	_TIFFfree(inputline);
+	for (t = 0; t < nthreads; t++) {
+		ptr = &histogram[0][0][0];
+		for (i = 0; i < B_LEN*B_LEN*B_LEN; i++)
+			*ptr++ += work[t].counts[i];
+		_TIFFfree(work[t].counts);
+	}
+
+	/* first box is the extent of the colors seen */
+	ptr = &histogram[0][0][0];
+	for (red = 0; red < B_LEN; ++red)
+		for (green = 0; green < B_LEN; ++green)
+			for (blue = 0; blue < B_LEN; ++blue) {
+				if (*ptr++ == 0)
+					continue;
+				if (red < box->rmin)
+					box->rmin = red;
+				if (red > box->rmax)
+					box->rmax = red;
+				if (green < box->gmin)
+					box->gmin = green;
+				if (green > box->gmax)
+					box->gmax = green;
+				if (blue < box->bmin)
+					box->bmin = blue;
+				if (blue > box->bmax)
+					box->bmax = blue;
+			}
 }
 
 static Colorbox *
@@ -750,53 +916,121 @@ map_colortable(void)
 			}
 }
 
+/*
+ * Closest color to a histogram cell in the Floyd-Steinberg dither,
+ * for colors the image does not have.
+ */
+static int
+nearest_color(int r2, int g2, int b2)
+{
+	register int cj, tmp, d2, dist;
+	register C_cell	*cell;
+	int ci, oval = 0;
+
+	cell = *(ColorCells +
+	    (((r2>>(B_DEPTH-C_DEPTH)) << C_DEPTH*2) +
+	    ((g2>>(B_DEPTH-C_DEPTH)) << C_DEPTH ) +
+	    (b2>>(B_DEPTH-C_DEPTH))));
+	if (cell == NULL)
+		cell = create_colorcell(r2 << COLOR_SHIFT,
+		    g2 << COLOR_SHIFT, b2 << COLOR_SHIFT);
+	dist = 9999999;
+	for (ci = 0; ci < cell->num_ents && dist > cell->entries[ci][1]; ++ci) {
+		cj = cell->entries[ci][0];
+		d2 = (rm[cj] >> COLOR_SHIFT) - r2;
+		d2 *= d2;
+		tmp = (gm[cj] >> COLOR_SHIFT) - g2;
+		d2 += tmp*tmp;
+		tmp = (bm[cj] >> COLOR_SHIFT) - b2;
+		d2 += tmp*tmp;
+		if (d2 < dist) {
+			dist = d2;
+			oval = cj;
+		}
+	}
+	return (oval);
+}
+
+/*
+ * Complete the histogram into an inverse colormap of all the cells,
+ * which the threads then only read.
+ */
+static void
+fill_colortable(void)
+{
+	register uint32 *histp = &histogram[0][0][0];
+	int ir, ig, ib;
+
+	for (ir = 0; ir < B_LEN; ++ir)
+		for (ig = 0; ig < B_LEN; ++ig)
+			for (ib = 0; ib < B_LEN; ++ib, histp++)
+				if (*histp == (uint32) -1)
+					*histp = nearest_color(ir, ig, ib);
+}
+
 /*
  * straight quantization.  Each pixel is mapped to the colors
  * closest to it.  Color values are rounded to the nearest color
  * table entry.
  */
 static void
-quant(TIFF* in, TIFF* out)
+quant_rows(void* arg)
 {
-	unsigned char	*outline, *inputline;
-	register unsigned char	*outptr, *inptr;
+	BandWork* work = (BandWork*) arg;
+	register unsigned char	*outptr = work->outrows, *inptr;
 	register uint32 i, j;
 	register int red, green, blue;
 
-	inputline = (unsigned char *)_TIFFmalloc(TIFFScanlineSize(in));
-	outline = (unsigned char *)_TIFFmalloc(imagewidth);
-	for (i = 0; i < imagelength; i++) {
-		if (TIFFReadScanline(in, inputline, i, 0) <= 0)
-			break;
-		inptr = inputline;
-		outptr = outline;
-		for (j = 0; j < imagewidth; j++) {
-			red = *inptr++ >> COLOR_SHIFT;
-			green = *inptr++ >> COLOR_SHIFT;
-			blue = *inptr++ >> COLOR_SHIFT;
+	for (i = 0; i < work->nrows; i++) {
+		inptr = work->rows + i * scanlinesize;
+		for (j = 0; j < imagewidth; j++, inptr += samplesperpixel) {
+			red = inptr[0] >> COLOR_SHIFT;
+			green = inptr[1] >> COLOR_SHIFT;
+			blue = inptr[2] >> COLOR_SHIFT;
 			*outptr++ = (unsigned char)histogram[red][green][blue];
 		}
-		if (TIFFWriteScanline(out, outline, i, 0) < 0)
+	}
+}
+
+static void
+quant(TIFF* in, TIFF* out)
+{
+	BandWork work[MAX_THREADS];
+	unsigned char *outband;
+	uint32 first, nrows, i;
+
+	outband = (unsigned char *)_TIFFmalloc(
+	    multiply_ms(bandrows, imagewidth));
+	if (outband == NULL) {
+		fprintf(stderr, "No space for output rows\n");
+		return;
+	}
+	_TIFFmemset(work, 0, sizeof (work));
+	for (first = 0; first < imagelength; first += nrows) {
+		nrows = imagelength - first < bandrows ?
+		    imagelength - first : bandrows;
+		if (!read_band(in, first, nrows))
 			break;
+		run_band(quant_rows, work, nrows, outband);
+		for (i = 0; i < nrows; i++)
+			if (TIFFWriteScanline(out, outband + i * imagewidth,
+			    first + i, 0) < 0)
+				goto bad;
 	}
-	_TIFFfree(inputline);
-	_TIFFfree(outline);
+bad:
+	_TIFFfree(outband);
 }
 
-#define	SWAP(type,a,b)	{ type p; p = a; a = b; b = p; }
-
-#define	GetInputLine(tif, row, bad)                                     \
-        do {                                                            \
-                if (TIFFReadScanline(tif, inputline, row, 0) <= 0)	\
-                        bad;						\
-                inptr = inputline;					\
-                nextptr = nextline;					\
-                for (j = 0; j < imagewidth; ++j) {			\
-                        *nextptr++ = *inptr++;				\
-                        *nextptr++ = *inptr++;				\
-                        *nextptr++ = *inptr++;				\
-                }                                                       \
-        } while (0);
+/*
+ * Floyd-Steinberg dither of pixels j0 to j1-1 of a row, spreading the
+ * errors to the following pixels of the row and to nextline (unless
+ * it is NULL).  Pixel j of a row can be done once the pixels up to j+2
+ * of the row above are: the sums are then the same as if the rows were
+ * done one after the other, so the rows of a band are dithered at the
+ * same time, each DITHER_CHUNK pixels at a time behind the one above.
+ */
+#define	DITHER_CHUNK	256
+
 #define	GetComponent(raw, cshift, c)				\
         do {                                                    \
                 cshift = raw;                                   \
@@ -809,103 +1043,191 @@ quant(TIFF* in, TIFF* out)
         } while (0);
 
 static void
-quant_fsdither(TIFF* in, TIFF* out)
+dither_row(short* thisline, short* nextline, unsigned char* outline,
+    uint32 j0, uint32 j1)
 {
-	unsigned char *outline, *inputline, *inptr;
-	short *thisline, *nextline;
-	register unsigned char	*outptr;
-	register short *thisptr, *nextptr;
-	register uint32 i, j;
-	uint32 imax, jmax;
-	int lastline, lastpixel;
-
-	imax = imagelength - 1;
-	jmax = imagewidth - 1;
-	inputline = (unsigned char *)_TIFFmalloc(TIFFScanlineSize(in));
-	thisline = (short *)_TIFFmalloc(imagewidth * 3 * sizeof (short));
-	nextline = (short *)_TIFFmalloc(imagewidth * 3 * sizeof (short));
-	outline = (unsigned char *) _TIFFmalloc(TIFFScanlineSize(out));
-
-	GetInputLine(in, 0, goto bad);		/* get first line */
-	for (i = 1; i <= imagelength; ++i) {
-		SWAP(short *, thisline, nextline);
-		lastline = (i >= imax);
-		if (i <= imax)
-			GetInputLine(in, i, break);
-		thisptr = thisline;
-		nextptr = nextline;
-		outptr = outline;
-		for (j = 0; j < imagewidth; ++j) {
-			int red, green, blue;
-			register int oval, r2, g2, b2;
-
-			lastpixel = (j == jmax);
-			GetComponent(*thisptr++, r2, red);
-			GetComponent(*thisptr++, g2, green);
-			GetComponent(*thisptr++, b2, blue);
-			oval = histogram[r2][g2][b2];
-			if (oval == -1) {
-				int ci;
-				register int cj, tmp, d2, dist;
-				register C_cell	*cell;
+	register unsigned char	*outptr = outline + j0;
+	register short *thisptr = thisline + 3 * j0;
+	register short *nextptr = nextline ? nextline + 3 * j0 : NULL;
+	register uint32 j;
+	uint32 jmax = imagewidth - 1;
+	int lastline = (nextline == NULL);
+	int lastpixel;
 
-				cell = *(ColorCells +
-				    (((r2>>(B_DEPTH-C_DEPTH)) << C_DEPTH*2) +
-				    ((g2>>(B_DEPTH-C_DEPTH)) << C_DEPTH ) +
-				    (b2>>(B_DEPTH-C_DEPTH))));
-				if (cell == NULL)
-					cell = create_colorcell(red,
-					    green, blue);
-				dist = 9999999;
-				for (ci = 0; ci < cell->num_ents && dist > cell->entries[ci][1]; ++ci) {
-					cj = cell->entries[ci][0];
-					d2 = (rm[cj] >> COLOR_SHIFT) - r2;
-					d2 *= d2;
-					tmp = (gm[cj] >> COLOR_SHIFT) - g2;
-					d2 += tmp*tmp;
-					tmp = (bm[cj] >> COLOR_SHIFT) - b2;
-					d2 += tmp*tmp;
-					if (d2 < dist) {
-						dist = d2;
-						oval = cj;
-					}
-				}
-				histogram[r2][g2][b2] = oval;
+	for (j = j0; j < j1; ++j) {
+		int red, green, blue;
+		register int oval, r2, g2, b2;
+
+		lastpixel = (j == jmax);
+		GetComponent(*thisptr++, r2, red);
+		GetComponent(*thisptr++, g2, green);
+		GetComponent(*thisptr++, b2, blue);
+		oval = histogram[r2][g2][b2];
+		*outptr++ = oval;
+		red -= rm[oval];
+		green -= gm[oval];
+		blue -= bm[oval];
+		if (!lastpixel) {
+			thisptr[0] += blue * 7 / 16;
+			thisptr[1] += green * 7 / 16;
+			thisptr[2] += red * 7 / 16;
+		}
+		if (!lastline) {
+			if (j != 0) {
+				nextptr[-3] += blue * 3 / 16;
+				nextptr[-2] += green * 3 / 16;
+				nextptr[-1] += red * 3 / 16;
 			}
-			*outptr++ = oval;
-			red -= rm[oval];
-			green -= gm[oval];
-			blue -= bm[oval];
+			nextptr[0] += blue * 5 / 16;
+			nextptr[1] += green * 5 / 16;
+			nextptr[2] += red * 5 / 16;
 			if (!lastpixel) {
-				thisptr[0] += blue * 7 / 16;
-				thisptr[1] += green * 7 / 16;
-				thisptr[2] += red * 7 / 16;
+				nextptr[3] += blue / 16;
+			        nextptr[4] += green / 16;
+			        nextptr[5] += red / 16;
 			}
-			if (!lastline) {
-				if (j != 0) {
-					nextptr[-3] += blue * 3 / 16;
-					nextptr[-2] += green * 3 / 16;
-					nextptr[-1] += red * 3 / 16;
-				}
-				nextptr[0] += blue * 5 / 16;
-				nextptr[1] += green * 5 / 16;
-				nextptr[2] += red * 5 / 16;
-				if (!lastpixel) {
-					nextptr[3] += blue / 16;
-				        nextptr[4] += green / 16;
-				        nextptr[5] += red / 16;
-				}
-				nextptr += 3;
+			nextptr += 3;
+		}
+	}
+}
+
+typedef struct {
+	short**	errors;		/* rows of the band, and the next one */
+	unsigned char* outrows;
+	uint32	nrows;		/* rows to dither */
+	uint32	nspread;	/* rows whose errors go to the next one */
+	uint32	nextrow;	/* next row for a thread to take */
+	uint32*	done;		/* pixels dithered in each row */
+	ToolMutex* mutex;
+	ToolCond* cond;
+} DitherBand;
+
+static void
+dither_band(void* arg)
+{
+	DitherBand* db = (DitherBand*) arg;
+	uint32 row, j, j1, above;
+
+	for (;;) {
+		toolMutexLock(db->mutex);
+		row = db->nextrow++;
+		toolMutexUnlock(db->mutex);
+		if (row >= db->nrows)
+			break;
+		for (j = 0; j < imagewidth; j = j1) {
+			above = imagewidth;
+			if (row > 0) {
+				toolMutexLock(db->mutex);
+				while ((above = db->done[row-1]) < imagewidth &&
+				    above < j + 3)
+					toolCondWait(db->cond, db->mutex);
+				toolMutexUnlock(db->mutex);
+				if (above < imagewidth)
+					above -= 2;
 			}
+			j1 = above - j > DITHER_CHUNK ? j + DITHER_CHUNK : above;
+			dither_row(db->errors[row],
+			    row < db->nspread ? db->errors[row+1] : NULL,
+			    db->outrows + row * imagewidth, j, j1);
+			toolMutexLock(db->mutex);
+			db->done[row] = j1;
+			toolCondBroadcast(db->cond);
+			toolMutexUnlock(db->mutex);
+		}
+	}
+}
+
+/*
+ * Add the samples of a row to its errors.
+ */
+static void
+add_row(short* errors, unsigned char* inptr)
+{
+	register uint32 j;
+
+	for (j = 0; j < imagewidth; ++j, inptr += samplesperpixel) {
+		*errors++ += inptr[0];
+		*errors++ += inptr[1];
+		*errors++ += inptr[2];
+	}
+}
+
+/*
+ * The last row of a band spreads its errors to a row of zeros, to
+ * which the next band adds its first row of samples; the sums are the
+ * same in any order.  The errors of the last two rows of the image
+ * are not spread down.
+ */
+static void
+quant_fsdither(TIFF* in, TIFF* out)
+{
+	DitherBand db;
+	short *tmpptr;
+	void* args[MAX_THREADS];
+	uint32 first, nrows, i;
+	int t;
+
+	_TIFFmemset(&db, 0, sizeof (db));
+	for (t = 0; t < nthreads; t++)
+		args[t] = &db;
+	db.errors = (short **)_TIFFmalloc((bandrows + 1) * sizeof (short *));
+	db.outrows = (unsigned char *)_TIFFmalloc(
+	    multiply_ms(bandrows, imagewidth));
+	db.done = (uint32 *)_TIFFmalloc(bandrows * sizeof (uint32));
+	db.mutex = toolMutexCreate();
+	db.cond = toolCondCreate();
+	if (! (db.errors && db.outrows && db.done && db.mutex && db.cond)) {
+		fprintf(stderr, "No space for dither rows\n");
+		goto bad;
+	}
+	_TIFFmemset(db.errors, 0, (bandrows + 1) * sizeof (short *));
+	for (i = 0; i <= bandrows; i++) {
+		db.errors[i] = (short *)_TIFFmalloc(
+		    multiply_ms(imagewidth, 3 * sizeof (short)));
+		if (db.errors[i] == NULL) {
+			fprintf(stderr, "No space for dither rows\n");
+			goto bad;
 		}
-		if (TIFFWriteScanline(out, outline, i-1, 0) < 0)
+	}
+
+	for (first = 0; first < imagelength; first += nrows) {
+		nrows = imagelength - first < bandrows ?
+		    imagelength - first : bandrows;
+		if (!read_band(in, first, nrows))
 			break;
+		for (i = 0; i <= nrows; i++) {
+			if (i > 0 || first == 0)
+				_TIFFmemset(db.errors[i], 0,
+				    imagewidth * 3 * sizeof (short));
+			if (i < nrows)
+				add_row(db.errors[i], band + i * scanlinesize);
+		}
+		db.nrows = nrows;
+		db.nspread = imagelength < first + 2 ? 0 : imagelength - first - 2;
+		if (db.nspread > nrows)
+			db.nspread = nrows;
+		db.nextrow = 0;
+		for (i = 0; i < nrows; i++)
+			db.done[i] = 0;
+		toolRunThreads(nthreads, dither_band, args);
+		for (i = 0; i < nrows; i++)
+			if (TIFFWriteScanline(out, db.outrows + i * imagewidth,
+			    first + i, 0) < 0)
+				goto bad;
+		tmpptr = db.errors[0];
+		db.errors[0] = db.errors[nrows];
+		db.errors[nrows] = tmpptr;
 	}
 bad:
-	_TIFFfree(inputline);
-	_TIFFfree(thisline);
-	_TIFFfree(nextline);
-	_TIFFfree(outline);
+	if (db.errors) {
+		for (i = 0; i <= bandrows; i++)
+			_TIFFfree(db.errors[i]);
+		_TIFFfree(db.errors);
+	}
+	_TIFFfree(db.outrows);
+	_TIFFfree(db.done);
+	toolCondDestroy(db.cond);
+	toolMutexDestroy(db.mutex);
 }
 /*
  * Local Variables:
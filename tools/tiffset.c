@@ -82,7 +82,7 @@ main(int argc, char* argv[])
     if (argc < 2)
         usage();
 
-    tiff = TIFFOpen(argv[argc-1], "r+");
+    tiff = TIFFOpen(argv[argc-1], "r+I");
     if (tiff == NULL)
         return 2;
 
@@ -28,6 +28,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifdef NEED_LIBPORT
+# include "libport.h"
+#endif
+
 #include "tiffio.h"
 
 #ifndef HAVE_GETOPT
@@ -46,59 +54,154 @@ extern int getopt(int, char**, char*);
 static const char TIFF_SUFFIX[] = ".tif";
 
 static	char fname[PATH_LENGTH];
+static	unsigned char *rawbuf;
+static	tmsize_t rawbufsize;
 
+static	int split(TIFF*, long);
+static	int splitPages(TIFF*, char*);
 static	int tiffcp(TIFF*, TIFF*);
-static	void newfilename(void);
+static	void newfilename(long);
+static	unsigned char* rawbuffer(uint64);
 static	int cpStrips(TIFF*, TIFF*);
 static	int cpTiles(TIFF*, TIFF*);
+static	void usage(void);
 
 int
 main(int argc, char* argv[])
 {
-	TIFF *in, *out;
+	TIFF *in;
+	char *pages = NULL;
+	int c, status = 0;
+#if !HAVE_DECL_OPTARG
+	extern int optind;
+	extern char *optarg;
+#endif
 
-	if (argc < 2) {
-                fprintf(stderr, "%s\n\n", TIFFGetVersion());
-		fprintf(stderr, "usage: tiffsplit input.tif [prefix]\n");
-		return (-3);
-	}
-	if (argc > 2) {
-		strncpy(fname, argv[2], sizeof(fname));
+	while ((c = getopt(argc, argv, "N:")) != -1)
+		switch (c) {
+		case 'N':
+			pages = optarg;
+			break;
+		case '?':
+			usage();
+			/*NOTREACHED*/
+		}
+	if (argc - optind < 1)
+		usage();
+	if (argc - optind > 1) {
+		strncpy(fname, argv[optind + 1], sizeof(fname));
 		fname[sizeof(fname) - 1] = '\0';
 	}
-	in = TIFFOpen(argv[1], "r");
+	in = TIFFOpen(argv[optind], "r");
 	if (in != NULL) {
-		do {
-			size_t path_len;
-			char *path;
-			
-			newfilename();
-
-			path_len = strlen(fname) + sizeof(TIFF_SUFFIX);
-			path = (char *) _TIFFmalloc(path_len);
-			strncpy(path, fname, path_len);
-			path[path_len - 1] = '\0';
-			strncat(path, TIFF_SUFFIX, path_len - strlen(path) - 1);
-			out = TIFFOpen(path, TIFFIsBigEndian(in)?"wb":"wl");
-			_TIFFfree(path);
-
-			if (out == NULL)
-				return (-2);
-			if (!tiffcp(in, out))
-				return (-1);
-			TIFFClose(out);
-		} while (TIFFReadDirectory(in));
+		if (pages != NULL)
+			status = splitPages(in, pages);
+		else {
+			long page = 0;
+
+			do {
+				status = split(in, page++);
+			} while (status == 0 && TIFFReadDirectory(in));
+		}
 		(void) TIFFClose(in);
 	}
+	if (rawbuf)
+		_TIFFfree(rawbuf);
+	return (status);
+}
+
+/*
+ * Write the current directory of in to the file named after page,
+ * counting from zero.
+ */
+static int
+split(TIFF* in, long page)
+{
+	TIFF *out;
+	size_t path_len;
+	char *path;
+
+	newfilename(page);
+
+	path_len = strlen(fname) + sizeof(TIFF_SUFFIX);
+	path = (char *) _TIFFmalloc(path_len);
+	if (path == NULL)
+		return (-2);
+	strncpy(path, fname, path_len);
+	path[path_len - 1] = '\0';
+	strncat(path, TIFF_SUFFIX, path_len - strlen(path) - 1);
+	out = TIFFOpen(path, TIFFIsBigEndian(in)?"wb":"wl");
+	_TIFFfree(path);
+
+	if (out == NULL)
+		return (-2);
+	if (!tiffcp(in, out)) {
+		TIFFClose(out);
+		return (-1);
+	}
+	TIFFClose(out);
+	return (0);
+}
+
+/*
+ * Split out the pages of a list of numbers and ranges counted from
+ * one, such as "1,4-6,last".  Each page is reached through the
+ * directory index of in, without reading the directories before it,
+ * and is given the file name it has when all pages are split.
+ */
+static int
+splitPages(TIFF* in, char* pages)
+{
+	long npages = (long) TIFFNumberOfDirectories(in);
+	long first, last, page;
+	char *item, *sep, *end;
+	int status;
+
+	for (item = strtok(pages, ","); item; item = strtok(NULL, ",")) {
+		sep = strchr(item, '-');
+		if (sep)
+			*sep++ = '\0';
+		if (strcmp(item, "last") == 0)
+			first = npages;
+		else {
+			first = strtol(item, &end, 10);
+			if (end == item || *end != '\0')
+				usage();
+		}
+		if (sep == NULL)
+			last = first;
+		else if (strcmp(sep, "last") == 0)
+			last = npages;
+		else {
+			last = strtol(sep, &end, 10);
+			if (end == sep || *end != '\0')
+				usage();
+		}
+		if (first < 1 || last < first || last > npages) {
+			fprintf(stderr,
+			    "tiffsplit: page range %ld-%ld is not in 1-%ld.\n",
+			    first, last, npages);
+			return (-3);
+		}
+		for (page = first; page <= last; page++) {
+			if (!TIFFSetDirectory(in, (uint16) (page - 1)))
+				return (-1);
+			status = split(in, page - 1);
+			if (status != 0)
+				return (status);
+		}
+	}
 	return (0);
 }
 
+/*
+ * Name the files with the prefix and aaa, aab, ..., zzz in page order;
+ * the default prefix x is followed by y and z when the letters run out.
+ */
 static void
-newfilename(void)
+newfilename(long page)
 {
 	static int first = 1;
-	static long lastTurn;
-	static long fnum;
 	static short defname;
 	static char *fpnt;
 
@@ -114,42 +217,16 @@ newfilename(void)
 		first = 0;
 	}
 #define	MAXFILES	17576
-	if (fnum == MAXFILES) {
-		if (!defname || fname[0] == 'z') {
-			fprintf(stderr, "tiffsplit: too many files.\n");
-			exit(1);
-		}
-		fname[0]++;
-		fnum = 0;
+	if (page >= (defname ? 3 * MAXFILES : MAXFILES)) {
+		fprintf(stderr, "tiffsplit: too many files.\n");
+		exit(1);
 	}
-	if (fnum % 676 == 0) {
-		if (fnum != 0) {
-			/*
-                         * advance to next letter every 676 pages
-			 * condition for 'z'++ will be covered above
-                         */
-			fpnt[0]++;
-		} else {
-			/*
-                         * set to 'a' if we are on the very first file
-                         */
-			fpnt[0] = 'a';
-		}
-		/*
-                 * set the value of the last turning point
-                 */
-		lastTurn = fnum;
-	}
-	/* 
-         * start from 0 every 676 times (provided by lastTurn)
-         * this keeps us within a-z boundaries
-         */
-	fpnt[1] = (char)((fnum - lastTurn) / 26) + 'a';
-	/* 
-         * cycle last letter every file, from a-z, then repeat
-         */
-	fpnt[2] = (char)(fnum % 26) + 'a';
-	fnum++;
+	if (defname)
+		fname[0] = (char)('x' + page / MAXFILES);
+	page %= MAXFILES;
+	fpnt[0] = (char)(page / 676) + 'a';
+	fpnt[1] = (char)((page % 676) / 26) + 'a';
+	fpnt[2] = (char)(page % 26) + 'a';
 }
 
 static int
@@ -197,6 +274,13 @@ tiffcp(TIFF* in, TIFF* out)
 	CopyField(TIFFTAG_TILEDEPTH, longv);
 	CopyField(TIFFTAG_SAMPLEFORMAT, shortv);
 	CopyField2(TIFFTAG_EXTRASAMPLES, shortv, shortav);
+	{ uint16 shortv2;
+	  float *floatav;
+	  /* Raw YCbCr data must keep the layout the samples were coded with */
+	  CopyField2(TIFFTAG_YCBCRSUBSAMPLING, shortv, shortv2);
+	  CopyField(TIFFTAG_YCBCRPOSITIONING, shortv);
+	  CopyField(TIFFTAG_REFERENCEBLACKWHITE, floatav);
+	}
 	{ uint16 *red, *green, *blue;
 	  CopyField3(TIFFTAG_COLORMAP, red, green, blue);
 	}
@@ -225,72 +309,82 @@ tiffcp(TIFF* in, TIFF* out)
 		return (cpStrips(in, out));
 }
 
+/*
+ * Return the buffer for raw strips and tiles, grown to size bytes.  It
+ * is kept from one page to the next.
+ */
+static unsigned char*
+rawbuffer(uint64 size)
+{
+	if (size > (uint64) rawbufsize) {
+		unsigned char *buf;
+
+		if ((uint64) (tmsize_t) size != size) {
+			fprintf(stderr, "tiffsplit: raw chunk is too large\n");
+			return (NULL);
+		}
+		buf = (unsigned char *)_TIFFrealloc(rawbuf, (tmsize_t) size);
+		if (!buf) {
+			fprintf(stderr, "tiffsplit: out of memory\n");
+			return (NULL);
+		}
+		rawbuf = buf;
+		rawbufsize = (tmsize_t) size;
+	}
+	return (rawbuf ? rawbuf : rawbuffer(1));
+}
+
 static int
 cpStrips(TIFF* in, TIFF* out)
 {
-	tmsize_t bufsize  = TIFFStripSize(in);
-	unsigned char *buf = (unsigned char *)_TIFFmalloc(bufsize);
+	tstrip_t s, ns = TIFFNumberOfStrips(in);
+	uint64 *bytecounts;
+	unsigned char *buf;
 
-	if (buf) {
-		tstrip_t s, ns = TIFFNumberOfStrips(in);
-		uint64 *bytecounts;
-
-		if (!TIFFGetField(in, TIFFTAG_STRIPBYTECOUNTS, &bytecounts)) {
-			fprintf(stderr, "tiffsplit: strip byte counts are missing\n");
-                        _TIFFfree(buf);
+	if (!TIFFGetField(in, TIFFTAG_STRIPBYTECOUNTS, &bytecounts)) {
+		fprintf(stderr, "tiffsplit: strip byte counts are missing\n");
+		return (0);
+	}
+	for (s = 0; s < ns; s++) {
+		buf = rawbuffer(bytecounts[s]);
+		if (!buf)
+			return (0);
+		if (TIFFReadRawStrip(in, s, buf, (tmsize_t)bytecounts[s]) < 0 ||
+		    TIFFWriteRawStrip(out, s, buf, (tmsize_t)bytecounts[s]) < 0)
 			return (0);
-		}
-		for (s = 0; s < ns; s++) {
-			if (bytecounts[s] > (uint64)bufsize) {
-				buf = (unsigned char *)_TIFFrealloc(buf, (tmsize_t)bytecounts[s]);
-				if (!buf)
-					return (0);
-				bufsize = (tmsize_t)bytecounts[s];
-			}
-			if (TIFFReadRawStrip(in, s, buf, (tmsize_t)bytecounts[s]) < 0 ||
-			    TIFFWriteRawStrip(out, s, buf, (tmsize_t)bytecounts[s]) < 0) {
-				_TIFFfree(buf);
-				return (0);
-			}
-		}
-		_TIFFfree(buf);
-		return (1);
 	}
-	return (0);
+	return (1);
 }
 
 static int
 cpTiles(TIFF* in, TIFF* out)
 {
-	tmsize_t bufsize = TIFFTileSize(in);
-	unsigned char *buf = (unsigned char *)_TIFFmalloc(bufsize);
+	ttile_t t, nt = TIFFNumberOfTiles(in);
+	uint64 *bytecounts;
+	unsigned char *buf;
 
-	if (buf) {
-		ttile_t t, nt = TIFFNumberOfTiles(in);
-		uint64 *bytecounts;
-
-		if (!TIFFGetField(in, TIFFTAG_TILEBYTECOUNTS, &bytecounts)) {
-			fprintf(stderr, "tiffsplit: tile byte counts are missing\n");
-                        _TIFFfree(buf);
+	if (!TIFFGetField(in, TIFFTAG_TILEBYTECOUNTS, &bytecounts)) {
+		fprintf(stderr, "tiffsplit: tile byte counts are missing\n");
+		return (0);
+	}
+	for (t = 0; t < nt; t++) {
+		buf = rawbuffer(bytecounts[t]);
+		if (!buf)
+			return (0);
+		if (TIFFReadRawTile(in, t, buf, (tmsize_t)bytecounts[t]) < 0 ||
+		    TIFFWriteRawTile(out, t, buf, (tmsize_t)bytecounts[t]) < 0)
 			return (0);
-		}
-		for (t = 0; t < nt; t++) {
-			if (bytecounts[t] > (uint64) bufsize) {
-				buf = (unsigned char *)_TIFFrealloc(buf, (tmsize_t)bytecounts[t]);
-				if (!buf)
-					return (0);
-				bufsize = (tmsize_t)bytecounts[t];
-			}
-			if (TIFFReadRawTile(in, t, buf, (tmsize_t)bytecounts[t]) < 0 ||
-			    TIFFWriteRawTile(out, t, buf, (tmsize_t)bytecounts[t]) < 0) {
-				_TIFFfree(buf);
-				return (0);
-			}
-		}
-		_TIFFfree(buf);
-		return (1);
 	}
-	return (0);
+	return (1);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "%s\n\n", TIFFGetVersion());
+	fprintf(stderr, "usage: tiffsplit [-N pages] input.tif [prefix]\n");
+	fprintf(stderr, "where pages is a list of page numbers and ranges counted from one, e.g. 2,5-7,last\n");
+	exit(-3);
 }
 
 /* vim: set ts=8 sts=8 sw=8 noet: */
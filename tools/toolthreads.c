@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include "tif_config.h"
+
+#include <stdlib.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifdef _WIN32
+# include <windows.h>
+#endif
+
+#if defined(THREADS_SUPPORT) && defined(HAVE_PTHREAD)
+# include <pthread.h>
+# define TOOL_THREADS_PTHREAD
+#elif defined(THREADS_SUPPORT) && defined(_WIN32)
+# define TOOL_THREADS_WIN32
+#endif
+
+#include "toolthreads.h"
+
+struct _ToolMutex {
+#if defined(TOOL_THREADS_PTHREAD)
+	pthread_mutex_t      mutex;
+#elif defined(TOOL_THREADS_WIN32)
+	CRITICAL_SECTION     cs;
+#else
+	int                  dummy;
+#endif
+};
+
+ToolMutex*
+toolMutexCreate(void)
+{
+	ToolMutex* m = (ToolMutex*) malloc(sizeof(ToolMutex));
+
+	if (m == NULL)
+		return (NULL);
+#if defined(TOOL_THREADS_PTHREAD)
+	if (pthread_mutex_init(&m->mutex, NULL) != 0) {
+		free(m);
+		return (NULL);
+	}
+#elif defined(TOOL_THREADS_WIN32)
+	InitializeCriticalSection(&m->cs);
+#else
+	m->dummy = 0;
+#endif
+	return (m);
+}
+
+void
+toolMutexDestroy(ToolMutex* m)
+{
+	if (m == NULL)
+		return;
+#if defined(TOOL_THREADS_PTHREAD)
+	pthread_mutex_destroy(&m->mutex);
+#elif defined(TOOL_THREADS_WIN32)
+	DeleteCriticalSection(&m->cs);
+#endif
+	free(m);
+}
+
+void
+toolMutexLock(ToolMutex* m)
+{
+#if defined(TOOL_THREADS_PTHREAD)
+	pthread_mutex_lock(&m->mutex);
+#elif defined(TOOL_THREADS_WIN32)
+	EnterCriticalSection(&m->cs);
+#else
+	(void) m;
+#endif
+}
+
+void
+toolMutexUnlock(ToolMutex* m)
+{
+#if defined(TOOL_THREADS_PTHREAD)
+	pthread_mutex_unlock(&m->mutex);
+#elif defined(TOOL_THREADS_WIN32)
+	LeaveCriticalSection(&m->cs);
+#else
+	(void) m;
+#endif
+}
+
+struct _ToolCond {
+#if defined(TOOL_THREADS_PTHREAD)
+	pthread_cond_t       cond;
+#elif defined(TOOL_THREADS_WIN32)
+	CONDITION_VARIABLE   cv;
+#else
+	int                  dummy;
+#endif
+};
+
+/*
+ * Condition variables.  Without thread support toolCondWait() returns
+ * at once: the state waited for can only have been changed by the
+ * caller itself.
+ */
+ToolCond*
+toolCondCreate(void)
+{
+	ToolCond* c = (ToolCond*) malloc(sizeof(ToolCond));
+
+	if (c == NULL)
+		return (NULL);
+#if defined(TOOL_THREADS_PTHREAD)
+	if (pthread_cond_init(&c->cond, NULL) != 0) {
+		free(c);
+		return (NULL);
+	}
+#elif defined(TOOL_THREADS_WIN32)
+	InitializeConditionVariable(&c->cv);
+#else
+	c->dummy = 0;
+#endif
+	return (c);
+}
+
+void
+toolCondDestroy(ToolCond* c)
+{
+	if (c == NULL)
+		return;
+#if defined(TOOL_THREADS_PTHREAD)
+	pthread_cond_destroy(&c->cond);
+#endif
+	free(c);
+}
+
+void
+toolCondWait(ToolCond* c, ToolMutex* m)
+{
+#if defined(TOOL_THREADS_PTHREAD)
+	pthread_cond_wait(&c->cond, &m->mutex);
+#elif defined(TOOL_THREADS_WIN32)
+	SleepConditionVariableCS(&c->cv, &m->cs, INFINITE);
+#else
+	(void) c;
+	(void) m;
+#endif
+}
+
+void
+toolCondBroadcast(ToolCond* c)
+{
+#if defined(TOOL_THREADS_PTHREAD)
+	pthread_cond_broadcast(&c->cond);
+#elif defined(TOOL_THREADS_WIN32)
+	WakeAllConditionVariable(&c->cv);
+#else
+	(void) c;
+#endif
+}
+
+/*
+ * Return the number of online processors, or 1 if unknown.
+ */
+int
+toolGetNumCPUs(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0 ? (int) info.dwNumberOfProcessors : 1);
+#elif defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0 ? (int) n : 1);
+#else
+	return (1);
+#endif
+}
+
+typedef struct {
+	void (*func)(void*);
+	void* arg;
+} ToolThreadStart;
+
+#if defined(TOOL_THREADS_PTHREAD)
+static void*
+toolThreadMain(void* p)
+{
+	ToolThreadStart* start = (ToolThreadStart*) p;
+
+	(*start->func)(start->arg);
+	return (NULL);
+}
+#elif defined(TOOL_THREADS_WIN32)
+static DWORD WINAPI
+toolThreadMain(LPVOID p)
+{
+	ToolThreadStart* start = (ToolThreadStart*) p;
+
+	(*start->func)(start->arg);
+	return (0);
+}
+#endif
+
+/*
+ * Run func(args[i]) for i in [0, nthreads) concurrently and wait for
+ * all of them to complete.  The first invocation runs on the calling
+ * thread.  An invocation whose thread cannot be started is run on the
+ * calling thread once the others have been, so every invocation
+ * happens exactly once.  Returns the number of threads used.
+ */
+int
+toolRunThreads(int nthreads, void (*func)(void*), void** args)
+{
+#if defined(TOOL_THREADS_PTHREAD) || defined(TOOL_THREADS_WIN32)
+	ToolThreadStart* starts;
+# if defined(TOOL_THREADS_PTHREAD)
+	pthread_t* threads;
+# else
+	HANDLE* threads;
+# endif
+	char* started;
+	int i, nstarted = 1;
+
+	if (nthreads <= 1)
+		goto serial;
+	starts = (ToolThreadStart*) malloc(nthreads * sizeof(ToolThreadStart));
+	threads = malloc(nthreads * sizeof(*threads));
+	started = (char*) malloc(nthreads);
+	if (starts == NULL || threads == NULL || started == NULL) {
+		free(starts);
+		free(threads);
+		free(started);
+		goto serial;
+	}
+	for (i = 1; i < nthreads; i++) {
+		starts[i].func = func;
+		starts[i].arg = args[i];
+# if defined(TOOL_THREADS_PTHREAD)
+		started[i] = pthread_create(&threads[i], NULL,
+		    toolThreadMain, &starts[i]) == 0;
+# else
+		threads[i] = CreateThread(NULL, 0, toolThreadMain,
+		    &starts[i], 0, NULL);
+		started[i] = threads[i] != NULL;
+# endif
+		nstarted += started[i];
+	}
+	(*func)(args[0]);
+	for (i = 1; i < nthreads; i++) {
+		if (!started[i]) {
+			(*func)(args[i]);
+			continue;
+		}
+# if defined(TOOL_THREADS_PTHREAD)
+		pthread_join(threads[i], NULL);
+# else
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+# endif
+	}
+	free(starts);
+	free(threads);
+	free(started);
+	return (nstarted);
+serial:
+#endif
+	{
+		int j;
+
+		for (j = 0; j < nthreads; j++)
+			(*func)(args[j]);
+	}
+	return (1);
+}
+
+/* vim: set ts=8 sts=8 sw=8 noet: */
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 8
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that (i) the above copyright notices and this permission notice appear in
+ * all copies of the software and related documentation, and (ii) the names of
+ * Sam Leffler and Silicon Graphics may not be used in any advertising or
+ * publicity relating to the software without the specific, prior written
+ * permission of Sam Leffler and Silicon Graphics.
+ *
+ * THE SOFTWARE IS PROVIDED "AS-IS" AND WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS, IMPLIED OR OTHERWISE, INCLUDING WITHOUT LIMITATION, ANY
+ * WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * IN NO EVENT SHALL SAM LEFFLER OR SILICON GRAPHICS BE LIABLE FOR
+ * ANY SPECIAL, INCIDENTAL, INDIRECT OR CONSEQUENTIAL DAMAGES OF ANY KIND,
+ * OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER OR NOT ADVISED OF THE POSSIBILITY OF DAMAGE, AND ON ANY THEORY OF
+ * LIABILITY, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#ifndef _TOOLTHREADS_
+#define	_TOOLTHREADS_
+
+/*
+ * Threading helpers shared by the tools that split their work over
+ * several processors.  POSIX threads are used when available, native
+ * threads on Windows; otherwise everything runs on the calling thread.
+ */
+typedef struct _ToolMutex ToolMutex;
+typedef struct _ToolCond ToolCond;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+extern ToolMutex* toolMutexCreate(void);
+extern void toolMutexDestroy(ToolMutex*);
+extern void toolMutexLock(ToolMutex*);
+extern void toolMutexUnlock(ToolMutex*);
+extern ToolCond* toolCondCreate(void);
+extern void toolCondDestroy(ToolCond*);
+extern void toolCondWait(ToolCond*, ToolMutex*);
+extern void toolCondBroadcast(ToolCond*);
+extern int toolGetNumCPUs(void);
+extern int toolRunThreads(int nthreads, void (*func)(void*), void** args);
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* _TOOLTHREADS_ */